@@ -0,0 +1,93 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Benchmarks of the attention mask updates run before every prefill and
+// decode step, on masks of shape [1, seq_len, 1, max_kv_len].
+
+#include "benchmark/benchmark.h"  // from @com_google_benchmark
+#include "runtime/executor/litert_compiled_model_executor_utils.h"
+#include "runtime/util/convert_tensor_buffer.h"
+
+namespace litert::lm {
+namespace {
+
+// The benchmark arguments: the sequence length and the kv-cache length.
+void AttentionMaskArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"seq_len", "max_kv_len"});
+  benchmark->ArgsProduct({{1, 128}, {1280, 4096}});
+}
+
+// Initializes and fills the mask from scratch, for the steps at the middle of
+// the kv-cache.
+void BM_InitializeAndFillAttentionMask(benchmark::State& state) {
+  const int seq_len = state.range(0);
+  const int max_kv_len = state.range(1);
+  auto mask = CreateTensorBuffer<float>({1, seq_len, 1, max_kv_len});
+  if (!mask) {
+    state.SkipWithError(mask.Error().Message().c_str());
+    return;
+  }
+  const int start_timestep = (max_kv_len - seq_len) / 2;
+  for (auto _ : state) {
+    auto status = InitializeAttentionMask(*mask, AttentionMaskDataType::FLOAT,
+                                          /*is_f16=*/true);
+    benchmark::DoNotOptimize(status);
+    status = FillAttentionMask(*mask, start_timestep, seq_len,
+                               AttentionMaskDataType::FLOAT);
+    benchmark::DoNotOptimize(status);
+  }
+  state.SetBytesProcessed(state.iterations() * seq_len * max_kv_len *
+                          sizeof(float));
+}
+BENCHMARK(BM_InitializeAndFillAttentionMask)->Apply(AttentionMaskArgs);
+
+// Updates the mask of the previous steps to the next ones, as the executor
+// does between the consecutive steps.
+void BM_UpdateAttentionMask(benchmark::State& state) {
+  const int seq_len = state.range(0);
+  const int max_kv_len = state.range(1);
+  auto mask = CreateTensorBuffer<float>({1, seq_len, 1, max_kv_len});
+  if (!mask) {
+    state.SkipWithError(mask.Error().Message().c_str());
+    return;
+  }
+  auto status = InitializeAttentionMask(*mask, AttentionMaskDataType::FLOAT,
+                                        /*is_f16=*/true);
+  if (!status.ok()) {
+    state.SkipWithError(status.ToString().c_str());
+    return;
+  }
+  int previous_start_timestep = 0;
+  int previous_steps = 0;
+  for (auto _ : state) {
+    // Wraps around at the end of the kv-cache.
+    const int start_timestep =
+        previous_start_timestep + previous_steps + seq_len > max_kv_len
+            ? 0
+            : previous_start_timestep + previous_steps;
+    status = UpdateAttentionMask(*mask, previous_start_timestep,
+                                 previous_steps, start_timestep, seq_len,
+                                 AttentionMaskDataType::FLOAT,
+                                 /*is_f16=*/true);
+    benchmark::DoNotOptimize(status);
+    previous_start_timestep = start_timestep;
+    previous_steps = seq_len;
+  }
+  state.SetItemsProcessed(state.iterations() * seq_len);
+}
+BENCHMARK(BM_UpdateAttentionMask)->Apply(AttentionMaskArgs);
+
+}  // namespace
+}  // namespace litert::lm
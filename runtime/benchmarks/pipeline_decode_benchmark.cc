@@ -0,0 +1,352 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Benchmarks of the host-side work of the decode loops of the pipeline, i.e.
+// the detokenization, the stop token detection, the updates of the Responses
+// and the observer calls, on a FakeLlmExecutor which costs almost nothing.
+//
+// Run with `--baseline=<file>` to fail when the time per token of a benchmark
+// is above its budget in the file, e.g.
+//   bazel run -c opt //runtime/benchmarks:pipeline_decode_benchmark --
+//     --baseline=runtime/benchmarks/pipeline_decode_benchmark_baseline.txt
+
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/flags/flag.h"  // from @com_google_absl
+#include "absl/flags/parse.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_split.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "benchmark/benchmark.h"  // from @com_google_benchmark
+#include "runtime/components/sentencepiece_tokenizer.h"
+#include "runtime/components/stop_token_detector.h"
+#include "runtime/components/tokenizer.h"
+#include "runtime/components/top_p_cpu_sampler.h"
+#include "runtime/core/pipeline.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/executor/fake_llm_executor.h"
+#include "runtime/util/convert_tensor_buffer.h"
+
+ABSL_FLAG(std::string, baseline, "",
+          "The file of the budgets of the time per token, in nanoseconds. "
+          "When set, the binary fails if a benchmark is above its budget.");
+
+namespace litert::lm {
+namespace {
+
+constexpr char kTestdataDir[] = "runtime/components/testdata/";
+
+// The stop token of the decodes, which is not in the decoded text.
+constexpr int kStopTokenId = 2294;
+
+// Returns the path of the test data file `name`, from the runfiles of the
+// binary when run by `bazel test`, or relative to the working directory when
+// run by `bazel run`.
+std::string GetTestdataPath(const std::string& name) {
+  const char* srcdir = std::getenv("TEST_SRCDIR");
+  if (srcdir == nullptr) {
+    return absl::StrCat(kTestdataDir, name);
+  }
+  return (std::filesystem::path(srcdir) / "litert_lm" / kTestdataDir / name)
+      .string();
+}
+
+// Returns the token ids of `num_tokens` decode steps of an English text,
+// followed by the stop token.
+absl::StatusOr<std::vector<std::vector<int>>> MakeDecodeTokens(
+    Tokenizer& tokenizer, int num_tokens) {
+  constexpr char kSentence[] =
+      "The quick brown fox jumps over the lazy dog, and then it runs back "
+      "into the forest to find 42 berries before the sun sets. ";
+  auto text_ids = tokenizer.TextToTokenIds(kSentence);
+  if (!text_ids.ok()) {
+    return text_ids.status();
+  }
+  std::vector<std::vector<int>> decode_tokens;
+  decode_tokens.reserve(num_tokens + 1);
+  while (decode_tokens.size() < static_cast<size_t>(num_tokens)) {
+    for (int id : *text_ids) {
+      if (decode_tokens.size() < static_cast<size_t>(num_tokens) &&
+          id != kStopTokenId) {
+        decode_tokens.push_back({id});
+      }
+    }
+  }
+  decode_tokens.push_back({kStopTokenId});
+  return decode_tokens;
+}
+
+// The state shared by the benchmarks: the tokenizer, the stop token detector
+// and the tokens decoded by the fake executors.
+class DecodeFixture {
+ public:
+  // Returns an error to skip the benchmark with.
+  absl::Status Init(int num_tokens, int vocab_size) {
+    auto tokenizer = SentencePieceTokenizer::CreateFromFile(
+        GetTestdataPath("sentencepiece.model"));
+    if (!tokenizer.ok()) {
+      return tokenizer.status();
+    }
+    tokenizer_ = std::move(*tokenizer);
+    auto decode_tokens = MakeDecodeTokens(*tokenizer_, num_tokens);
+    if (!decode_tokens.ok()) {
+      return decode_tokens.status();
+    }
+    decode_tokens_ = std::move(*decode_tokens);
+    vocab_size_ = vocab_size;
+    return stop_token_detector_.AddStopTokenSequence({kStopTokenId});
+  }
+
+  // Returns a new executor decoding the tokens, as the fake executors only
+  // decode them once.
+  std::unique_ptr<FakeLlmExecutor> CreateExecutor() {
+    auto executor = std::make_unique<FakeLlmExecutor>(
+        vocab_size_, /*prefill_tokens_set=*/std::vector<std::vector<int>>(),
+        decode_tokens_);
+    (*executor->GetMutableExecutorSettings())
+        ->SetMaxNumTokens(decode_tokens_.size() + 1);
+    return executor;
+  }
+
+  Tokenizer& tokenizer() { return *tokenizer_; }
+  StopTokenDetector& stop_token_detector() { return stop_token_detector_; }
+
+  // Resets the detector for the next decode.
+  void Reset() { stop_token_detector_.ResetBatch(/*batch_size=*/1); }
+
+ private:
+  std::unique_ptr<Tokenizer> tokenizer_;
+  StopTokenDetector stop_token_detector_{/*batch_size=*/1};
+  std::vector<std::vector<int>> decode_tokens_;
+  int vocab_size_ = 0;
+};
+
+// Reports the time per decoded token, in seconds, as the counter checked
+// against the baseline.
+void SetTokensProcessed(benchmark::State& state, int num_tokens) {
+  state.SetItemsProcessed(state.iterations() * num_tokens);
+  state.counters["time_per_token"] = benchmark::Counter(
+      num_tokens, benchmark::Counter::kIsIterationInvariantRate |
+                      benchmark::Counter::kInvert);
+}
+
+// An observer which only reads the streamed texts, as the clients do.
+class NullObserver : public InferenceObservable {
+ public:
+  void OnNext(const Responses& responses) override {
+    auto text = responses.GetResponseTextAt(0);
+    benchmark::DoNotOptimize(text);
+  }
+};
+
+// Decodes `range(0)` tokens sampled by the executor.
+void BM_Decode(benchmark::State& state) {
+  const int num_tokens = state.range(0);
+  DecodeFixture fixture;
+  if (auto status = fixture.Init(num_tokens, /*vocab_size=*/32000);
+      !status.ok()) {
+    state.SkipWithError(status.ToString().c_str());
+    return;
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto executor = fixture.CreateExecutor();
+    fixture.Reset();
+    std::optional<BenchmarkInfo> benchmark_info;
+    state.ResumeTiming();
+    auto responses = Decode(*executor, fixture.tokenizer(),
+                            fixture.stop_token_detector(), benchmark_info);
+    if (!responses.ok()) {
+      state.SkipWithError(responses.status().ToString().c_str());
+      return;
+    }
+    benchmark::DoNotOptimize(responses);
+  }
+  SetTokensProcessed(state, num_tokens);
+}
+BENCHMARK(BM_Decode)->ArgName("tokens")->Arg(256)->Arg(1024);
+
+// Streams `range(0)` tokens sampled by the executor to an observer.
+void BM_DecodeStreaming(benchmark::State& state) {
+  const int num_tokens = state.range(0);
+  DecodeFixture fixture;
+  if (auto status = fixture.Init(num_tokens, /*vocab_size=*/32000);
+      !status.ok()) {
+    state.SkipWithError(status.ToString().c_str());
+    return;
+  }
+  NullObserver observer;
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto executor = fixture.CreateExecutor();
+    fixture.Reset();
+    std::optional<BenchmarkInfo> benchmark_info;
+    state.ResumeTiming();
+    auto status = DecodeStreaming(*executor, fixture.tokenizer(),
+                                  fixture.stop_token_detector(),
+                                  benchmark_info, &observer);
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      return;
+    }
+  }
+  SetTokensProcessed(state, num_tokens);
+}
+BENCHMARK(BM_DecodeStreaming)->ArgName("tokens")->Arg(256)->Arg(1024);
+
+// Decodes `range(1)` tokens greedily sampled on the host from the logits of a
+// vocab of `range(0)`. The time includes the fake executor writing the logits
+// and the sampling, which grow with the vocab.
+void BM_DecodeCustomSampling(benchmark::State& state) {
+  const int vocab_size = state.range(0);
+  const int num_tokens = state.range(1);
+  DecodeFixture fixture;
+  if (auto status = fixture.Init(num_tokens, vocab_size); !status.ok()) {
+    state.SkipWithError(status.ToString().c_str());
+    return;
+  }
+  auto sampler = TopPSampler::Create(/*k=*/1, /*p=*/1.0, /*temperature=*/1.0,
+                                     /*batch_size=*/1, /*seed=*/1);
+  if (!sampler.ok()) {
+    state.SkipWithError(sampler.status().ToString().c_str());
+    return;
+  }
+  auto decoded_ids = CreateTensorBuffer<int>({1, 1});
+  if (!decoded_ids) {
+    state.SkipWithError("Failed to create the decoded ids.");
+    return;
+  }
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto executor = fixture.CreateExecutor();
+    fixture.Reset();
+    std::optional<BenchmarkInfo> benchmark_info;
+    state.ResumeTiming();
+    auto responses = DecodeCustomSampling(
+        *executor, fixture.tokenizer(), fixture.stop_token_detector(),
+        /*num_output_candidates=*/1, **sampler, *decoded_ids, benchmark_info);
+    if (!responses.ok()) {
+      state.SkipWithError(responses.status().ToString().c_str());
+      return;
+    }
+    benchmark::DoNotOptimize(responses);
+  }
+  SetTokensProcessed(state, num_tokens);
+}
+BENCHMARK(BM_DecodeCustomSampling)
+    ->ArgNames({"vocab", "tokens"})
+    ->ArgsProduct({{32000, 262144}, {256, 1024}});
+
+// Reads the budgets of the baseline file, one "<benchmark name> <nanoseconds
+// per token>" per line. The empty lines and those starting with '#' are
+// skipped.
+absl::StatusOr<std::map<std::string, double>> ReadBaseline(
+    const std::string& path) {
+  std::ifstream file(path);
+  if (!file) {
+    return absl::NotFoundError(absl::StrCat("Failed to open ", path));
+  }
+  std::map<std::string, double> budgets;
+  std::string line;
+  while (std::getline(file, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    double budget_ns;
+    if (fields.size() != 2 || !absl::SimpleAtod(fields[1], &budget_ns)) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid baseline line: ", line));
+    }
+    budgets[std::string(fields[0])] = budget_ns;
+  }
+  return budgets;
+}
+
+// Prints the runs on the console, and records the time per token of each one.
+class BaselineReporter : public benchmark::ConsoleReporter {
+ public:
+  void ReportRuns(const std::vector<Run>& reports) override {
+    ConsoleReporter::ReportRuns(reports);
+    for (const Run& run : reports) {
+      auto counter = run.counters.find("time_per_token");
+      if (run.error_occurred || counter == run.counters.end()) {
+        continue;
+      }
+      time_per_token_ns_.emplace_back(run.benchmark_name(),
+                                      counter->second.value * 1e9);
+    }
+  }
+
+  // Returns the number of runs above their budget, and prints them.
+  int CountRegressions(const std::map<std::string, double>& budgets) const {
+    int num_regressions = 0;
+    for (const auto& [name, time_ns] : time_per_token_ns_) {
+      auto budget = budgets.find(name);
+      if (budget == budgets.end()) {
+        std::cerr << "No baseline for " << name << ".\n";
+      } else if (time_ns > budget->second) {
+        std::cerr << "Regression of " << name << ": " << time_ns
+                  << " ns per token, above the budget of " << budget->second
+                  << " ns.\n";
+        ++num_regressions;
+      }
+    }
+    return num_regressions;
+  }
+
+ private:
+  std::vector<std::pair<std::string, double>> time_per_token_ns_;
+};
+
+}  // namespace
+}  // namespace litert::lm
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  absl::ParseCommandLine(argc, argv);
+
+  std::map<std::string, double> budgets;
+  const std::string baseline = absl::GetFlag(FLAGS_baseline);
+  if (!baseline.empty()) {
+    auto read_budgets = litert::lm::ReadBaseline(baseline);
+    if (!read_budgets.ok()) {
+      std::cerr << read_budgets.status() << "\n";
+      return EXIT_FAILURE;
+    }
+    budgets = std::move(*read_budgets);
+  }
+
+  litert::lm::BaselineReporter reporter;
+  benchmark::RunSpecifiedBenchmarks(&reporter);
+  benchmark::Shutdown();
+  if (!baseline.empty() && reporter.CountRegressions(budgets) > 0) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
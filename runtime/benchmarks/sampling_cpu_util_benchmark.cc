@@ -0,0 +1,132 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Benchmarks of the CPU sampling kernels, across the vocab sizes of the
+// supported models, the batch sizes and the top-k.
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/random/random.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "benchmark/benchmark.h"  // from @com_google_benchmark
+#include "runtime/components/sampling_cpu_util.h"
+
+namespace litert::lm {
+namespace {
+
+// Returns random logits of shape [batch_size, vocab_size].
+std::vector<float> MakeLogits(int vocab_size, int batch_size) {
+  absl::BitGen gen;
+  std::vector<float> logits(static_cast<int64_t>(vocab_size) * batch_size);
+  for (float& logit : logits) {
+    logit = absl::Gaussian<float>(gen, 0.0f, 4.0f);
+  }
+  return logits;
+}
+
+// The benchmark arguments: the vocab size, the batch size and k.
+void SamplingArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"vocab", "batch", "k"});
+  for (int vocab_size : {32000, 128256, 262144}) {
+    for (int batch_size : {1, 4}) {
+      for (int k : {1, 40}) {
+        benchmark->Args({vocab_size, batch_size, k});
+      }
+    }
+  }
+}
+
+void SetItemsProcessed(benchmark::State& state) {
+  // The logits read per iteration.
+  state.SetItemsProcessed(state.iterations() * state.range(0) *
+                          state.range(1));
+}
+
+void BM_TopKIndicies(benchmark::State& state) {
+  const int vocab_size = state.range(0);
+  const int batch_size = state.range(1);
+  const int k = state.range(2);
+  const std::vector<float> logits = MakeLogits(vocab_size, batch_size);
+  for (auto _ : state) {
+    auto indices = TopKIndicies(logits, k, batch_size);
+    benchmark::DoNotOptimize(indices);
+  }
+  SetItemsProcessed(state);
+}
+BENCHMARK(BM_TopKIndicies)->Apply(SamplingArgs);
+
+void BM_Softmax(benchmark::State& state) {
+  const int vocab_size = state.range(0);
+  const int batch_size = state.range(1);
+  const int k = state.range(2);
+  const std::vector<float> logits = MakeLogits(vocab_size, batch_size);
+  auto topk_indices = TopKIndicies(logits, k, batch_size);
+  if (!topk_indices.ok()) {
+    state.SkipWithError(topk_indices.status().ToString().c_str());
+    return;
+  }
+  std::vector<float> max_logit_values;
+  for (auto _ : state) {
+    auto probabilities =
+        Softmax(logits, *topk_indices, /*temperature=*/0.8f, batch_size,
+                max_logit_values);
+    benchmark::DoNotOptimize(probabilities);
+  }
+  SetItemsProcessed(state);
+}
+BENCHMARK(BM_Softmax)->Apply(SamplingArgs);
+
+void BM_TopKTopPSampling(benchmark::State& state) {
+  const int vocab_size = state.range(0);
+  const int batch_size = state.range(1);
+  const int k = state.range(2);
+  const std::vector<float> logits = MakeLogits(vocab_size, batch_size);
+  absl::BitGen rng;
+  std::vector<float> sampled_scores;
+  for (auto _ : state) {
+    auto sampled_ids =
+        TopKTopPSampling(logits, k, /*p=*/0.95f, /*temperature=*/0.8f, rng,
+                         batch_size, sampled_scores);
+    benchmark::DoNotOptimize(sampled_ids);
+  }
+  SetItemsProcessed(state);
+}
+BENCHMARK(BM_TopKTopPSampling)->Apply(SamplingArgs);
+
+// The single pass kernel the CPU sampler uses, against the three above.
+void BM_FusedTopKTopPSampling(benchmark::State& state) {
+  const int vocab_size = state.range(0);
+  const int batch_size = state.range(1);
+  const int k = state.range(2);
+  const std::vector<float> logits = MakeLogits(vocab_size, batch_size);
+  absl::BitGen rng;
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(batch_size);
+  std::vector<float> sampled_scores(batch_size);
+  for (auto _ : state) {
+    auto status = FusedTopKTopPSampling(
+        absl::MakeConstSpan(logits), k, /*p=*/0.95f, /*temperature=*/0.8f,
+        rng, batch_size, scratch, absl::MakeSpan(sampled_ids),
+        absl::MakeSpan(sampled_scores));
+    benchmark::DoNotOptimize(status);
+    benchmark::DoNotOptimize(sampled_ids.data());
+  }
+  SetItemsProcessed(state);
+}
+BENCHMARK(BM_FusedTopKTopPSampling)->Apply(SamplingArgs);
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,70 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Benchmarks of the stop token detection run on every decode step.
+
+#include <vector>
+
+#include "absl/random/random.h"  // from @com_google_absl
+#include "benchmark/benchmark.h"  // from @com_google_benchmark
+#include "runtime/components/stop_token_detector.h"
+
+namespace litert::lm {
+namespace {
+
+// Processes random tokens, none of them stopping, with the stop sequences of
+// lengths 1 to `range(1)` on a batch of `range(0)`.
+void BM_StopTokenDetectorProcessTokens(benchmark::State& state) {
+  const int batch_size = state.range(0);
+  const int max_stop_sequence_length = state.range(1);
+  StopTokenDetector detector(batch_size);
+  // The stop tokens are outside of the range of the decoded tokens.
+  constexpr int kVocabSize = 32000;
+  for (int length = 1; length <= max_stop_sequence_length; ++length) {
+    std::vector<int> stop_sequence(length, kVocabSize + length);
+    if (!detector.AddStopTokenSequence(stop_sequence).ok()) {
+      state.SkipWithError("Failed to add the stop sequence.");
+      return;
+    }
+  }
+  // The tokens of the steps are drawn up front, such that only the detection
+  // is timed.
+  constexpr int kNumSteps = 1024;
+  absl::BitGen gen;
+  std::vector<std::vector<int>> steps(kNumSteps, std::vector<int>(batch_size));
+  for (auto& step : steps) {
+    for (int& token : step) {
+      token = absl::Uniform(gen, 0, kVocabSize);
+    }
+  }
+  int step = 0;
+  for (auto _ : state) {
+    auto status = detector.ProcessTokens(steps[step]);
+    benchmark::DoNotOptimize(status);
+    if (++step == kNumSteps) {
+      step = 0;
+      state.PauseTiming();
+      detector.ResetBatch(batch_size);
+      state.ResumeTiming();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+BENCHMARK(BM_StopTokenDetectorProcessTokens)
+    ->ArgNames({"batch", "max_stop_length"})
+    ->ArgsProduct({{1, 4, 16}, {1, 4}});
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,96 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Benchmarks of the scheduling overhead of the thread pools, with callbacks
+// that do almost no work.
+
+#include <atomic>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "benchmark/benchmark.h"  // from @com_google_benchmark
+#include "runtime/framework/threadpool.h"
+#include "runtime/framework/work_stealing_threadpool.h"
+
+namespace litert::lm {
+namespace {
+
+constexpr absl::Duration kTimeout = absl::Seconds(60);
+constexpr int kNumCallbacks = 256;
+
+// The benchmark arguments: the number of threads of the pool.
+void PoolArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgName("threads")->Arg(1)->Arg(4)->Arg(8)->UseRealTime();
+}
+
+// Schedules a batch of callbacks and waits for all of them.
+template <typename Pool>
+void ScheduleAndWait(benchmark::State& state, Pool& pool) {
+  std::atomic<int> counter = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < kNumCallbacks; ++i) {
+      auto status = pool.Schedule(
+          [&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+      benchmark::DoNotOptimize(status);
+    }
+    auto status = pool.WaitUntilDone(kTimeout);
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      return;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumCallbacks);
+}
+
+void BM_ThreadPoolSchedule(benchmark::State& state) {
+  ThreadPool pool("benchmark", state.range(0));
+  ScheduleAndWait(state, pool);
+}
+BENCHMARK(BM_ThreadPoolSchedule)->Apply(PoolArgs);
+
+void BM_WorkStealingThreadPoolSchedule(benchmark::State& state) {
+  WorkStealingThreadPool pool("benchmark", state.range(0));
+  ScheduleAndWait(state, pool);
+}
+BENCHMARK(BM_WorkStealingThreadPoolSchedule)->Apply(PoolArgs);
+
+// Submits a batch of tasks and waits for each of their futures, as the
+// engine does for the tasks of the sessions.
+void BM_ThreadPoolSubmit(benchmark::State& state) {
+  ThreadPool pool("benchmark", state.range(0));
+  std::vector<TaskFuture<absl::Status>> futures;
+  futures.reserve(kNumCallbacks);
+  for (auto _ : state) {
+    futures.clear();
+    for (int i = 0; i < kNumCallbacks; ++i) {
+      auto future = pool.Submit([]() { return absl::OkStatus(); });
+      if (!future.ok()) {
+        state.SkipWithError(future.status().ToString().c_str());
+        return;
+      }
+      futures.push_back(*std::move(future));
+    }
+    for (auto& future : futures) {
+      auto status = future.Get(kTimeout);
+      benchmark::DoNotOptimize(status);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * kNumCallbacks);
+}
+BENCHMARK(BM_ThreadPoolSubmit)->Apply(PoolArgs);
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,117 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// Benchmarks of the encoding and the decoding of the tokenizers, on the
+// models of runtime/components/testdata.
+
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "benchmark/benchmark.h"  // from @com_google_benchmark
+#include "runtime/components/huggingface_tokenizer.h"
+#include "runtime/components/sentencepiece_tokenizer.h"
+#include "runtime/components/tokenizer.h"
+
+namespace litert::lm {
+namespace {
+
+constexpr char kTestdataDir[] = "runtime/components/testdata/";
+
+// Returns the path of the test data file `name`, from the runfiles of the
+// binary when run by `bazel test`, or relative to the working directory when
+// run by `bazel run`.
+std::string GetTestdataPath(const std::string& name) {
+  const char* srcdir = std::getenv("TEST_SRCDIR");
+  if (srcdir == nullptr) {
+    return absl::StrCat(kTestdataDir, name);
+  }
+  return (std::filesystem::path(srcdir) / "litert_lm" / kTestdataDir / name)
+      .string();
+}
+
+absl::StatusOr<std::unique_ptr<Tokenizer>> CreateTokenizer(
+    benchmark::State& state) {
+  // The tokenizer benchmarked, 0 for SentencePiece and 1 for HuggingFace.
+  if (state.range(0) == 0) {
+    state.SetLabel("sentencepiece");
+    return SentencePieceTokenizer::CreateFromFile(
+        GetTestdataPath("sentencepiece.model"));
+  }
+  state.SetLabel("huggingface");
+  return HuggingFaceTokenizer::CreateFromFile(
+      GetTestdataPath("tokenizer.json"));
+}
+
+// Returns an English text of about `num_bytes` bytes.
+std::string MakeText(size_t num_bytes) {
+  constexpr char kSentence[] =
+      "The quick brown fox jumps over the lazy dog, and then it runs back "
+      "into the forest to find 42 berries before the sun sets. ";
+  std::string text;
+  while (text.size() < num_bytes) {
+    text += kSentence;
+  }
+  return text;
+}
+
+// The benchmark arguments: the tokenizer and the size of the text in bytes.
+void TokenizerArgs(benchmark::internal::Benchmark* benchmark) {
+  benchmark->ArgNames({"tokenizer", "bytes"});
+  benchmark->ArgsProduct({{0, 1}, {128, 4096, 65536}});
+}
+
+void BM_TextToTokenIds(benchmark::State& state) {
+  auto tokenizer = CreateTokenizer(state);
+  if (!tokenizer.ok()) {
+    state.SkipWithError(tokenizer.status().ToString().c_str());
+    return;
+  }
+  const std::string text = MakeText(state.range(1));
+  for (auto _ : state) {
+    auto token_ids = (*tokenizer)->TextToTokenIds(text);
+    benchmark::DoNotOptimize(token_ids);
+  }
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+BENCHMARK(BM_TextToTokenIds)->Apply(TokenizerArgs);
+
+void BM_TokenIdsToText(benchmark::State& state) {
+  auto tokenizer = CreateTokenizer(state);
+  if (!tokenizer.ok()) {
+    state.SkipWithError(tokenizer.status().ToString().c_str());
+    return;
+  }
+  const std::string text = MakeText(state.range(1));
+  auto token_ids = (*tokenizer)->TextToTokenIds(text);
+  if (!token_ids.ok()) {
+    state.SkipWithError(token_ids.status().ToString().c_str());
+    return;
+  }
+  for (auto _ : state) {
+    auto decoded = (*tokenizer)->TokenIdsToText(*token_ids);
+    benchmark::DoNotOptimize(decoded);
+  }
+  state.SetItemsProcessed(state.iterations() * token_ids->size());
+}
+BENCHMARK(BM_TokenIdsToText)->Apply(TokenizerArgs);
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,124 @@
+#include "runtime/components/beam_search.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/sampling_cpu_util.h"
+#include "runtime/components/stop_token_detector.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// A hypothesis extended by one token, or kept as is if `token_id` is -1.
+struct Candidate {
+  float score;
+  int row;
+  int token_id;
+};
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<BeamSearch>> BeamSearch::Create(
+    int num_beams, const StopTokenDetector& stop_token_detector) {
+  RET_CHECK_GT(num_beams, 0).SetCode(absl::StatusCode::kInvalidArgument)
+      << "The number of beams must be positive.";
+  // Each hypothesis tracks its own stop sequences, since the hypotheses are
+  // reordered between the steps.
+  StopTokenDetector beam_stop_token_detector = stop_token_detector;
+  beam_stop_token_detector.ResetBatch(/*batch_size=*/1);
+  std::vector<Beam> beams(num_beams,
+                          Beam{{}, 0.0f, beam_stop_token_detector});
+  return absl::WrapUnique(new BeamSearch(std::move(beams)));
+}
+
+absl::Status BeamSearch::Step(absl::Span<const float> logits) {
+  const int num_beams = beams_.size();
+  RET_CHECK(!logits.empty() && logits.size() % num_beams == 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Expected logits of shape [" << num_beams
+      << ", vocab_size], but got " << logits.size() << " logits.";
+  const int vocab_size = logits.size() / num_beams;
+  // No more than num_beams tokens of a hypothesis can make it into the next
+  // step, so only those are considered.
+  const int k = std::min(num_beams, vocab_size);
+  // All the rows hold the same prompt before the first step, so only the first
+  // one is extended to keep the hypotheses distinct.
+  const int num_rows = num_steps_ == 0 ? 1 : num_beams;
+  std::vector<Candidate> candidates;
+  candidates.reserve(num_rows * k);
+  for (int row = 0; row < num_rows; ++row) {
+    const Beam& beam = beams_[row];
+    if (IsDone(beam)) {
+      candidates.push_back({beam.score, row, -1});
+      continue;
+    }
+    auto row_logits = logits.subspan(row * vocab_size, vocab_size);
+    // The log-softmax normalizer, computed stably from the max logit.
+    const float max_logit = *std::max_element(row_logits.begin(),
+                                              row_logits.end());
+    double sum = 0.0;
+    for (float logit : row_logits) {
+      sum += std::exp(logit - max_logit);
+    }
+    const float log_normalizer = max_logit + std::log(sum);
+    ASSIGN_OR_RETURN(std::vector<int> top_ids, TopKIndicies(row_logits, k));
+    for (int token_id : top_ids) {
+      candidates.push_back(
+          {beam.score + row_logits[token_id] - log_normalizer, row, token_id});
+    }
+  }
+  RET_CHECK_GE(candidates.size(), num_beams)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The vocabulary of " << vocab_size << " tokens is too small for "
+      << num_beams << " beams.";
+  // Ties keep the order of the rows, so that the result is deterministic.
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const Candidate& a, const Candidate& b) {
+                     return a.score > b.score;
+                   });
+
+  std::vector<Beam> next_beams;
+  next_beams.reserve(num_beams);
+  for (int i = 0; i < num_beams; ++i) {
+    const Candidate& candidate = candidates[i];
+    Beam beam = beams_[candidate.row];
+    if (candidate.token_id >= 0) {
+      beam.token_ids.push_back(candidate.token_id);
+      beam.score = candidate.score;
+      const int token_ids[] = {candidate.token_id};
+      RETURN_IF_ERROR(beam.stop_token_detector.ProcessTokens(token_ids));
+    }
+    source_rows_[i] = candidate.row;
+    next_input_token_ids_[i] =
+        beam.token_ids.empty() ? 0 : beam.token_ids.back();
+    next_beams.push_back(std::move(beam));
+  }
+  beams_ = std::move(next_beams);
+  ++num_steps_;
+  return absl::OkStatus();
+}
+
+bool BeamSearch::AllDone() const {
+  return std::all_of(beams_.begin(), beams_.end(), IsDone);
+}
+
+std::vector<int> BeamSearch::GetTokenIds(int index) const {
+  const Beam& beam = beams_[index];
+  std::vector<int> token_ids = beam.token_ids;
+  if (IsDone(beam)) {
+    token_ids.resize(token_ids.size() -
+                     beam.stop_token_detector.GetStepsBeforeStopTokens()[0]);
+  }
+  return token_ids;
+}
+
+}  // namespace litert::lm
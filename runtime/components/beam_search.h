@@ -0,0 +1,87 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_BEAM_SEARCH_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_BEAM_SEARCH_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/stop_token_detector.h"
+
+namespace litert::lm {
+
+// Keeps the `num_beams` most likely hypotheses of a beam search, one per batch
+// row of the executor. Each Step() extends the hypotheses by one token given
+// the logits of their last tokens, after which the batch rows of the executor
+// must be reordered to follow GetSourceRows(). A hypothesis is finished once it
+// ends with a stop token sequence, and keeps competing with its final score.
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto beam_search,
+//                    BeamSearch::Create(num_beams, stop_token_detector));
+//   while (!beam_search->AllDone()) {
+//     // ... decode the logits of GetNextInputTokenIds() ...
+//     RETURN_IF_ERROR(beam_search->Step(logits));
+//     RETURN_IF_ERROR(executor.ReorderBatchRows(beam_search->GetSourceRows()));
+//   }
+//
+class BeamSearch {
+ public:
+  // Creates the beam search of `num_beams` hypotheses, which all start from
+  // the same prompt. The stop sequences are taken from `stop_token_detector`.
+  static absl::StatusOr<std::unique_ptr<BeamSearch>> Create(
+      int num_beams, const StopTokenDetector& stop_token_detector);
+
+  // Extends the hypotheses by one token. `logits` is a 2D tensor (in a
+  // flattened buffer) of shape [num_beams, vocab_size], the logits of the next
+  // token of each hypothesis. The hypotheses are then sorted by score, from the
+  // most likely one.
+  absl::Status Step(absl::Span<const float> logits);
+
+  // Returns the row each hypothesis continues from after the last Step().
+  absl::Span<const int> GetSourceRows() const { return source_rows_; }
+
+  // Returns the token to feed into each row in the next decode step, i.e. the
+  // last token of each hypothesis.
+  absl::Span<const int> GetNextInputTokenIds() const {
+    return next_input_token_ids_;
+  }
+
+  // Returns true if all the hypotheses are finished.
+  bool AllDone() const;
+
+  int GetNumBeams() const { return beams_.size(); }
+
+  // Returns the token ids of hypothesis `index`, without the stop sequence.
+  std::vector<int> GetTokenIds(int index) const;
+
+  // Returns the cumulative log-probability of hypothesis `index`.
+  float GetScore(int index) const { return beams_[index].score; }
+
+ private:
+  struct Beam {
+    std::vector<int> token_ids;
+    float score = 0.0f;
+    StopTokenDetector stop_token_detector;
+  };
+
+  explicit BeamSearch(std::vector<Beam> beams)
+      : beams_(std::move(beams)),
+        source_rows_(beams_.size(), 0),
+        next_input_token_ids_(beams_.size(), 0) {}
+
+  static bool IsDone(const Beam& beam) {
+    return beam.stop_token_detector.GetStopTokensFound()[0];
+  }
+
+  std::vector<Beam> beams_;
+  std::vector<int> source_rows_;
+  std::vector<int> next_input_token_ids_;
+  int num_steps_ = 0;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_BEAM_SEARCH_H_
@@ -0,0 +1,93 @@
+#include "runtime/components/beam_search.h"
+
+#include <cmath>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/components/stop_token_detector.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::FloatNear;
+using ::testing::IsEmpty;
+using ::testing::status::StatusIs;
+
+// Returns the logits of the given rows of probabilities.
+std::vector<float> Logits(const std::vector<std::vector<float>>& probs) {
+  std::vector<float> logits;
+  for (const auto& row : probs) {
+    for (float prob : row) {
+      logits.push_back(std::log(prob));
+    }
+  }
+  return logits;
+}
+
+TEST(BeamSearchTest, CreateRejectsInvalidNumBeams) {
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_THAT(BeamSearch::Create(/*num_beams=*/0, stop_token_detector),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(BeamSearchTest, KeepsMostLikelyHypotheses) {
+  StopTokenDetector stop_token_detector(1);
+  ASSERT_OK(stop_token_detector.AddStopTokenSequence({3}));
+  ASSERT_OK_AND_ASSIGN(auto beam_search,
+                       BeamSearch::Create(/*num_beams=*/2,
+                                          stop_token_detector));
+
+  // Only the first row is extended in the first step, since both rows hold
+  // the same prompt.
+  ASSERT_OK(beam_search->Step(
+      Logits({{0.5, 0.3, 0.15, 0.05}, {0.05, 0.05, 0.05, 0.85}})));
+  EXPECT_THAT(beam_search->GetSourceRows(), ElementsAre(0, 0));
+  EXPECT_THAT(beam_search->GetNextInputTokenIds(), ElementsAre(0, 1));
+  EXPECT_FALSE(beam_search->AllDone());
+
+  // The first hypothesis stops with a probability of 0.5 * 0.6, ahead of the
+  // second one continuing with 0.3 * 0.9.
+  ASSERT_OK(beam_search->Step(
+      Logits({{0.1, 0.1, 0.2, 0.6}, {0.9, 0.05, 0.03, 0.02}})));
+  EXPECT_THAT(beam_search->GetSourceRows(), ElementsAre(0, 1));
+  EXPECT_THAT(beam_search->GetNextInputTokenIds(), ElementsAre(3, 0));
+  EXPECT_FALSE(beam_search->AllDone());
+
+  // The finished hypothesis keeps its score and stays ahead.
+  ASSERT_OK(beam_search->Step(
+      Logits({{0.25, 0.25, 0.25, 0.25}, {0.1, 0.1, 0.1, 0.7}})));
+  EXPECT_THAT(beam_search->GetSourceRows(), ElementsAre(0, 1));
+  EXPECT_TRUE(beam_search->AllDone());
+  EXPECT_THAT(beam_search->GetTokenIds(0), ElementsAre(0));
+  EXPECT_THAT(beam_search->GetTokenIds(1), ElementsAre(1, 0));
+  EXPECT_THAT(beam_search->GetScore(0), FloatNear(std::log(0.3), 1e-5));
+  EXPECT_THAT(beam_search->GetScore(1), FloatNear(std::log(0.189), 1e-5));
+}
+
+TEST(BeamSearchTest, StopSequenceIsDropped) {
+  StopTokenDetector stop_token_detector(1);
+  ASSERT_OK(stop_token_detector.AddStopTokenSequence({1, 2}));
+  ASSERT_OK_AND_ASSIGN(auto beam_search,
+                       BeamSearch::Create(/*num_beams=*/1,
+                                          stop_token_detector));
+  ASSERT_OK(beam_search->Step(Logits({{0.1, 0.8, 0.1}})));
+  ASSERT_OK(beam_search->Step(Logits({{0.1, 0.1, 0.8}})));
+  EXPECT_TRUE(beam_search->AllDone());
+  EXPECT_THAT(beam_search->GetTokenIds(0), IsEmpty());
+}
+
+TEST(BeamSearchTest, StepRejectsMismatchedLogits) {
+  StopTokenDetector stop_token_detector(1);
+  ASSERT_OK_AND_ASSIGN(auto beam_search,
+                       BeamSearch::Create(/*num_beams=*/2,
+                                          stop_token_detector));
+  EXPECT_THAT(beam_search->Step(Logits({{0.2, 0.3, 0.5}})),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,155 @@
+#include "runtime/components/constrained_sampler.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_element_type.h"  // from @litert
+#include "litert/cc/litert_macros.h"  // from @litert
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/sampler.h"
+#include "runtime/components/token_constraint.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<ConstrainedSampler>> ConstrainedSampler::Create(
+    std::unique_ptr<Sampler> sampler,
+    std::shared_ptr<TokenConstraint> constraint,
+    std::vector<int> end_token_ids, int batch_size) {
+  RET_CHECK(sampler != nullptr && constraint != nullptr)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The sampler and the constraint must be set.";
+  RET_CHECK(!end_token_ids.empty()).SetCode(absl::StatusCode::kInvalidArgument)
+      << "The constrained decoding needs a token to end the texts.";
+  RET_CHECK_GT(batch_size, 0).SetCode(absl::StatusCode::kInvalidArgument)
+      << "The batch size must be positive.";
+  return absl::WrapUnique(new ConstrainedSampler(
+      std::move(sampler), std::move(constraint), std::move(end_token_ids),
+      batch_size));
+}
+
+void ConstrainedSampler::Reset() {
+  std::fill(states_.begin(), states_.end(), constraint_->GetStartState());
+  std::fill(ended_.begin(), ended_.end(), false);
+  std::fill(active_rows_.begin(), active_rows_.end(), true);
+  sampler_->Reset();
+}
+
+void ConstrainedSampler::SetActiveRows(const std::vector<bool>& active_rows) {
+  if (active_rows.size() == batch_size_) {
+    active_rows_ = active_rows;
+  }
+  sampler_->SetActiveRows(active_rows);
+}
+
+absl::StatusOr<std::vector<int>> ConstrainedSampler::TakeForcedTokenIds(
+    int max_num_tokens) {
+  std::vector<int> token_ids;
+  if (batch_size_ != 1 || ended_[0]) {
+    return token_ids;
+  }
+  while (token_ids.size() < max_num_tokens) {
+    std::optional<int> token_id = constraint_->GetForcedToken(states_[0]);
+    if (!token_id.has_value()) {
+      break;
+    }
+    ASSIGN_OR_RETURN(states_[0], constraint_->Next(states_[0], *token_id));
+    token_ids.push_back(*token_id);
+  }
+  return token_ids;
+}
+
+absl::Status ConstrainedSampler::SampleToIdAndScoreBuffer(
+    const TensorBuffer& logits_tensor, TensorBuffer& ids_tensor,
+    TensorBuffer* scores_tensor) {
+  LITERT_ASSIGN_OR_RETURN(auto logits_type, logits_tensor.TensorType());
+  if (logits_type.ElementType() != ElementType::Float32) {
+    return absl::UnimplementedError(
+        "The constrained decoding only supports float32 logits.");
+  }
+  LITERT_ASSIGN_OR_RETURN(auto logits_size, logits_tensor.PackedSize());
+  const size_t num_logits = logits_size / sizeof(float);
+  RET_CHECK(num_logits > 0 && num_logits % batch_size_ == 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Expected logits of shape [" << batch_size_
+      << ", vocab_size], but got " << num_logits << " logits.";
+  const int vocab_size = num_logits / batch_size_;
+  if (masked_logits_.size() != num_logits) {
+    masked_logits_.resize(num_logits);
+    LITERT_ASSIGN_OR_RETURN(
+        auto masked_logits_tensor,
+        CreateTensorBuffer<float>({batch_size_, vocab_size}));
+    masked_logits_tensor_ = std::move(masked_logits_tensor);
+  }
+  TensorBuffer& mutable_logits_tensor =
+      const_cast<TensorBuffer&>(logits_tensor);
+  if (!mutable_logits_tensor.Read(absl::MakeSpan(masked_logits_))) {
+    return absl::InternalError("Failed to read the logits.");
+  }
+
+  for (int row = 0; row < batch_size_; ++row) {
+    if (!active_rows_[row]) {
+      continue;
+    }
+    auto row_logits =
+        absl::MakeSpan(masked_logits_).subspan(row * vocab_size, vocab_size);
+    // The end tokens are masked along with the rest, and restored when the
+    // text can end.
+    const bool can_end = ended_[row] || constraint_->IsAccepting(states_[row]);
+    for (int i = 0; i < end_token_ids_.size(); ++i) {
+      const int token_id = end_token_ids_[i];
+      end_logits_[i] = token_id < vocab_size ? row_logits[token_id] : 0.0f;
+    }
+    if (ended_[row]) {
+      std::fill(row_logits.begin(), row_logits.end(),
+                -std::numeric_limits<float>::infinity());
+    } else {
+      const TokenMask& mask = constraint_->GetTokenMask(states_[row]);
+      RET_CHECK(can_end || mask.num_allowed_tokens > 0)
+              .SetCode(absl::StatusCode::kFailedPrecondition)
+          << "No token can continue the constrained text of row " << row;
+      ApplyTokenMask(mask, row_logits);
+    }
+    if (can_end) {
+      for (int i = 0; i < end_token_ids_.size(); ++i) {
+        if (end_token_ids_[i] < vocab_size) {
+          row_logits[end_token_ids_[i]] = end_logits_[i];
+        }
+      }
+    }
+  }
+  if (!masked_logits_tensor_->Write(absl::MakeConstSpan(masked_logits_))) {
+    return absl::InternalError("Failed to write the masked logits.");
+  }
+  RETURN_IF_ERROR(sampler_->SampleToIdAndScoreBuffer(
+      *masked_logits_tensor_, ids_tensor, scores_tensor));
+
+  LITERT_ASSIGN_OR_RETURN(auto sampled_ids,
+                          CopyFromTensorBuffer<int>(ids_tensor));
+  for (int row = 0; row < batch_size_; ++row) {
+    const int token_id = sampled_ids[row];
+    if (ended_[row] || !active_rows_[row]) {
+      continue;
+    }
+    if (std::find(end_token_ids_.begin(), end_token_ids_.end(), token_id) !=
+        end_token_ids_.end()) {
+      ended_[row] = true;
+      continue;
+    }
+    ASSIGN_OR_RETURN(states_[row], constraint_->Next(states_[row], token_id));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
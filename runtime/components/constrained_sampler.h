@@ -0,0 +1,111 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_CONSTRAINED_SAMPLER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_CONSTRAINED_SAMPLER_H_
+
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/sampler.h"
+#include "runtime/components/token_constraint.h"
+
+namespace litert::lm {
+
+// A sampler restricting another one to the tokens allowed by a
+// TokenConstraint, such that each row of the batch decodes a text matching
+// the constraint. The logits of the other tokens are masked to -infinity
+// before sampling. The end tokens are only allowed once the text of the row
+// is a full match, and are the only ones allowed after it.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto constraint,
+//                    cache.GetOrCompileJsonSchema(json_schema));
+//   ASSIGN_OR_RETURN(auto sampler,
+//                    ConstrainedSampler::Create(std::move(top_p_sampler),
+//                                               constraint, {eos_id},
+//                                               batch_size));
+class ConstrainedSampler : public Sampler {
+ public:
+  // - sampler: The sampler applied to the masked logits.
+  // - constraint: The constraint of the decoded texts.
+  // - end_token_ids: The tokens ending the decoded texts, e.g. the EOS.
+  // - batch_size: The batch size of the logits.
+  static absl::StatusOr<std::unique_ptr<ConstrainedSampler>> Create(
+      std::unique_ptr<Sampler> sampler,
+      std::shared_ptr<TokenConstraint> constraint,
+      std::vector<int> end_token_ids, int batch_size);
+
+  // Samples a batch of token ids from float32 logits of shape [batch_size,
+  // vocab_size], and advances the constraint of each row by its sampled
+  // token.
+  absl::Status SampleToIdAndScoreBuffer(const TensorBuffer& logits_tensor,
+                                        TensorBuffer& ids_tensor,
+                                        TensorBuffer* scores_tensor) override;
+
+  // The inactive rows are neither masked nor advanced, and the mask is
+  // forwarded to the sampler of the masked logits.
+  void SetActiveRows(const std::vector<bool>& active_rows) override;
+
+  // The top log-probabilities are those of the masked logits, so only the
+  // tokens the constraint allows are reported.
+  absl::Status SetNumTopLogProbs(int num_top_log_probs) override {
+    return sampler_->SetNumTopLogProbs(num_top_log_probs);
+  }
+  int GetNumTopLogProbs() const override {
+    return sampler_->GetNumTopLogProbs();
+  }
+  absl::Span<const std::pair<int, float>> GetTopLogProbs(
+      int row) const override {
+    return sampler_->GetTopLogProbs(row);
+  }
+
+  // Returns the tokens the constraint leaves as the only continuation of the
+  // text, until it can end or another token can follow. They are not given
+  // to the sampler of the masked logits, e.g. not counted by its penalties.
+  absl::StatusOr<std::vector<int>> TakeForcedTokenIds(
+      int max_num_tokens) override;
+
+  // Restarts the texts of all the rows, and the sampler they are sampled
+  // with.
+  void Reset() override;
+
+ private:
+  ConstrainedSampler(std::unique_ptr<Sampler> sampler,
+                     std::shared_ptr<TokenConstraint> constraint,
+                     std::vector<int> end_token_ids, int batch_size)
+      : sampler_(std::move(sampler)),
+        constraint_(std::move(constraint)),
+        end_token_ids_(std::move(end_token_ids)),
+        batch_size_(batch_size),
+        states_(batch_size, constraint_->GetStartState()),
+        ended_(batch_size, false),
+        active_rows_(batch_size, true),
+        end_logits_(end_token_ids_.size()) {}
+
+  std::unique_ptr<Sampler> sampler_;
+  std::shared_ptr<TokenConstraint> constraint_;
+  const std::vector<int> end_token_ids_;
+  const int batch_size_;
+
+  // The constraint state and whether the text has ended, per row.
+  std::vector<int> states_;
+  std::vector<bool> ended_;
+  // Whether each row is still sampled.
+  std::vector<bool> active_rows_;
+
+  // The masked logits, kept across the calls such that each step only
+  // copies the logits.
+  std::vector<float> masked_logits_;
+  std::optional<TensorBuffer> masked_logits_tensor_;
+  // The logits of the end tokens of a row, before masking.
+  std::vector<float> end_logits_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_CONSTRAINED_SAMPLER_H_
@@ -0,0 +1,141 @@
+#include "runtime/components/constrained_sampler.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/regex_automaton.h"
+#include "runtime/components/token_constraint.h"
+#include "runtime/components/token_vocab_index.h"
+#include "runtime/components/top_p_cpu_sampler.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::status::IsOkAndHolds;
+using ::testing::status::StatusIs;
+
+constexpr int kEosId = 0;
+
+std::unique_ptr<ConstrainedSampler> CreateSampler(absl::string_view regex,
+                                                  int batch_size) {
+  auto automaton = RegexAutomaton::Create(regex);
+  EXPECT_OK(automaton);
+  // The token 0 is the EOS, of no text.
+  auto vocab_index = TokenVocabIndex::Create({"", "a", "b", "ab"});
+  EXPECT_OK(vocab_index);
+  auto constraint =
+      TokenConstraint::Create(std::move(*automaton), std::move(*vocab_index));
+  EXPECT_OK(constraint);
+  // The greedy sampling makes the masked argmax the sampled token.
+  auto top_p_sampler =
+      TopPSampler::Create(/*k=*/1, /*p=*/1.0, /*temperature=*/1.0, batch_size,
+                          /*seed=*/1);
+  EXPECT_OK(top_p_sampler);
+  auto sampler = ConstrainedSampler::Create(
+      std::move(*top_p_sampler), std::move(*constraint), {kEosId}, batch_size);
+  EXPECT_OK(sampler);
+  return std::move(*sampler);
+}
+
+// Samples a step of `sampler` from `logits` of shape [batch_size, 4].
+absl::StatusOr<std::vector<int>> Sample(ConstrainedSampler& sampler,
+                                        const std::vector<float>& logits) {
+  const int batch_size = logits.size() / 4;
+  auto logits_tensor = CopyToTensorBuffer<float>(logits, {batch_size, 4});
+  std::vector<int> ids_vector(batch_size);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {batch_size});
+  RETURN_IF_ERROR(sampler.SampleToIdAndScoreBuffer(
+      *logits_tensor, *ids_tensor, /*scores_tensor=*/nullptr));
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  if (!ids) {
+    return absl::InternalError("Failed to read the sampled ids.");
+  }
+  return std::move(*ids);
+}
+
+TEST(ConstrainedSamplerTest, SamplesTheAllowedTokens) {
+  auto sampler = CreateSampler("ab", /*batch_size=*/2);
+  // The EOS and "b" are preferred, but only "a" and "ab" can start the text.
+  const std::vector<float> logits = {10.0, 1.0, 5.0, 2.0,
+                                     10.0, 3.0, 5.0, 2.0};
+  ASSERT_OK_AND_ASSIGN(auto ids, Sample(*sampler, logits));
+  EXPECT_THAT(ids, testing::ElementsAre(3, 1));
+  // The first row is a match and may only end, the second needs a "b".
+  ASSERT_OK_AND_ASSIGN(ids, Sample(*sampler, logits));
+  EXPECT_THAT(ids, testing::ElementsAre(kEosId, 2));
+  // The ended row keeps sampling the EOS.
+  ASSERT_OK_AND_ASSIGN(ids, Sample(*sampler, logits));
+  EXPECT_THAT(ids, testing::ElementsAre(kEosId, kEosId));
+
+  // The texts restart after a reset.
+  sampler->Reset();
+  ASSERT_OK_AND_ASSIGN(ids, Sample(*sampler, logits));
+  EXPECT_THAT(ids, testing::ElementsAre(3, 1));
+}
+
+TEST(ConstrainedSamplerTest, TakesTheForcedTokens) {
+  auto sampler = CreateSampler("aaab", /*batch_size=*/1);
+  // Only "a" can start the text, and follow it.
+  EXPECT_THAT(sampler->TakeForcedTokenIds(/*max_num_tokens=*/1),
+              IsOkAndHolds(ElementsAre(1)));
+  EXPECT_THAT(sampler->TakeForcedTokenIds(/*max_num_tokens=*/10),
+              IsOkAndHolds(ElementsAre(1)));
+  // "a" and "ab" can follow "aa".
+  EXPECT_THAT(sampler->TakeForcedTokenIds(/*max_num_tokens=*/10),
+              IsOkAndHolds(IsEmpty()));
+  ASSERT_OK_AND_ASSIGN(auto ids, Sample(*sampler, {10.0, 1.0, 5.0, 2.0}));
+  EXPECT_THAT(ids, ElementsAre(3));
+  // The text is a match, so it may end.
+  EXPECT_THAT(sampler->TakeForcedTokenIds(/*max_num_tokens=*/10),
+              IsOkAndHolds(IsEmpty()));
+  ASSERT_OK_AND_ASSIGN(ids, Sample(*sampler, {10.0, 1.0, 5.0, 2.0}));
+  EXPECT_THAT(ids, ElementsAre(kEosId));
+
+  // The rows of a batch are sampled one token at a time.
+  auto batch_sampler = CreateSampler("aaab", /*batch_size=*/2);
+  EXPECT_THAT(batch_sampler->TakeForcedTokenIds(/*max_num_tokens=*/10),
+              IsOkAndHolds(IsEmpty()));
+}
+
+TEST(ConstrainedSamplerTest, FailsWhenNoTokenCanContinue) {
+  auto sampler = CreateSampler("c", /*batch_size=*/1);
+  EXPECT_THAT(Sample(*sampler, {1.0, 2.0, 3.0, 4.0}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(ConstrainedSamplerTest, CreateFailsWithoutEndTokens) {
+  auto automaton = RegexAutomaton::Create("a");
+  ASSERT_OK(automaton);
+  auto vocab_index = TokenVocabIndex::Create({"a"});
+  ASSERT_OK(vocab_index);
+  auto constraint =
+      TokenConstraint::Create(std::move(*automaton), std::move(*vocab_index));
+  ASSERT_OK(constraint);
+  auto top_p_sampler = TopPSampler::Create(/*k=*/1, /*p=*/1.0,
+                                           /*temperature=*/1.0,
+                                           /*batch_size=*/1, /*seed=*/1);
+  ASSERT_OK(top_p_sampler);
+  EXPECT_THAT(ConstrainedSampler::Create(std::move(*top_p_sampler),
+                                         std::move(*constraint),
+                                         /*end_token_ids=*/{},
+                                         /*batch_size=*/1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
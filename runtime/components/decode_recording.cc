@@ -0,0 +1,213 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/components/decode_recording.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/strings/strip.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/util/binary_serialization.h"
+
+namespace litert::lm {
+namespace {
+
+// The magic and the version of the serialized recordings.
+constexpr absl::string_view kRecordingMagic = "LMDR";
+constexpr uint32_t kRecordingVersion = 1;
+
+void AppendBytes(absl::string_view bytes, std::string& out) {
+  AppendValue<uint32_t>(bytes.size(), out);
+  out.append(bytes.data(), bytes.size());
+}
+
+bool ConsumeBytes(absl::string_view& in, std::string& bytes) {
+  uint32_t size = 0;
+  if (!ConsumeValue(in, size) || in.size() < size) {
+    return false;
+  }
+  bytes = std::string(in.substr(0, size));
+  in.remove_prefix(size);
+  return true;
+}
+
+// Reads a count of values of `value_size` bytes each, which must fit in `in`.
+bool ConsumeCount(absl::string_view& in, size_t value_size, uint32_t& count) {
+  return ConsumeValue(in, count) && in.size() / value_size >= count;
+}
+
+absl::Status InvalidRecordingError(absl::string_view reason) {
+  return absl::InvalidArgumentError(
+      absl::StrCat("Invalid decode recording: ", reason));
+}
+
+}  // namespace
+
+std::string SerializeDecodeRecording(const DecodeRecording& recording) {
+  std::string out(kRecordingMagic);
+  AppendValue(kRecordingVersion, out);
+  AppendBytes(recording.sampler_params, out);
+  AppendValue<uint32_t>(recording.turns.size(), out);
+  for (const DecodeRecordingTurn& turn : recording.turns) {
+    AppendBytes(turn.prompt, out);
+    AppendValue<uint32_t>(turn.prompt_token_ids.size(), out);
+    for (int token_id : turn.prompt_token_ids) {
+      AppendValue<int32_t>(token_id, out);
+    }
+    // Each sampled id is followed by the latency of its step.
+    AppendValue<uint32_t>(turn.sampled_token_ids.size(), out);
+    for (int i = 0; i < turn.sampled_token_ids.size(); ++i) {
+      AppendValue<int32_t>(turn.sampled_token_ids[i], out);
+      const int64_t latency_us =
+          i < turn.step_latencies.size()
+              ? absl::ToInt64Microseconds(turn.step_latencies[i])
+              : 0;
+      AppendValue<uint32_t>(
+          std::clamp<int64_t>(latency_us, 0,
+                              std::numeric_limits<uint32_t>::max()),
+          out);
+    }
+  }
+  return out;
+}
+
+absl::StatusOr<DecodeRecording> ParseDecodeRecording(
+    absl::string_view serialized_recording) {
+  absl::string_view in = serialized_recording;
+  if (!absl::ConsumePrefix(&in, kRecordingMagic)) {
+    return InvalidRecordingError("bad magic");
+  }
+  uint32_t version = 0;
+  if (!ConsumeValue(in, version) || version != kRecordingVersion) {
+    return InvalidRecordingError(
+        absl::StrCat("unsupported version ", version));
+  }
+  DecodeRecording recording;
+  uint32_t num_turns = 0;
+  if (!ConsumeBytes(in, recording.sampler_params) ||
+      !ConsumeValue(in, num_turns)) {
+    return InvalidRecordingError("truncated header");
+  }
+  for (uint32_t t = 0; t < num_turns; ++t) {
+    DecodeRecordingTurn turn;
+    uint32_t num_prompt_tokens = 0;
+    if (!ConsumeBytes(in, turn.prompt) ||
+        !ConsumeCount(in, sizeof(int32_t), num_prompt_tokens)) {
+      return InvalidRecordingError(absl::StrCat("truncated turn ", t));
+    }
+    for (uint32_t i = 0; i < num_prompt_tokens; ++i) {
+      int32_t token_id = 0;
+      ConsumeValue(in, token_id);
+      turn.prompt_token_ids.push_back(token_id);
+    }
+    uint32_t num_sampled_tokens = 0;
+    if (!ConsumeCount(in, sizeof(int32_t) + sizeof(uint32_t),
+                      num_sampled_tokens)) {
+      return InvalidRecordingError(absl::StrCat("truncated turn ", t));
+    }
+    for (uint32_t i = 0; i < num_sampled_tokens; ++i) {
+      int32_t token_id = 0;
+      uint32_t latency_us = 0;
+      ConsumeValue(in, token_id);
+      ConsumeValue(in, latency_us);
+      turn.sampled_token_ids.push_back(token_id);
+      turn.step_latencies.push_back(absl::Microseconds(latency_us));
+    }
+    recording.turns.push_back(std::move(turn));
+  }
+  if (!in.empty()) {
+    return InvalidRecordingError("trailing bytes");
+  }
+  return recording;
+}
+
+DecodeRecorder::DecodeRecorder(std::string sampler_params) {
+  recording_.sampler_params = std::move(sampler_params);
+}
+
+DecodeRecorder::DecodeRecorder(DecodeRecording recording)
+    : replayed_recording_(std::move(recording)) {
+  recording_.sampler_params = replayed_recording_->sampler_params;
+}
+
+absl::Status DecodeRecorder::StartTurn(absl::string_view prompt,
+                                       absl::Span<const int> prompt_token_ids) {
+  absl::MutexLock lock(&mutex_);
+  if (IsReplaying()) {
+    const int turn_index = recording_.turns.size();
+    if (turn_index >= replayed_recording_->turns.size()) {
+      return absl::FailedPreconditionError(absl::StrCat(
+          "The recording has ", turn_index, " turns, all of them replayed."));
+    }
+    if (absl::MakeConstSpan(
+            replayed_recording_->turns[turn_index].prompt_token_ids) !=
+        prompt_token_ids) {
+      return absl::FailedPreconditionError(absl::StrCat(
+          "The prompt of turn ", turn_index,
+          " is not encoded to the recorded token ids, e.g. with another "
+          "tokenizer."));
+    }
+  }
+  DecodeRecordingTurn& turn = recording_.turns.emplace_back();
+  turn.prompt = std::string(prompt);
+  turn.prompt_token_ids.assign(prompt_token_ids.begin(),
+                               prompt_token_ids.end());
+  return absl::OkStatus();
+}
+
+absl::StatusOr<int> DecodeRecorder::GetReplayedTokenId() const {
+  absl::MutexLock lock(&mutex_);
+  if (!IsReplaying() || recording_.turns.empty()) {
+    return absl::FailedPreconditionError("No recorded turn is replayed.");
+  }
+  const int turn_index = recording_.turns.size() - 1;
+  const std::vector<int>& recorded_token_ids =
+      replayed_recording_->turns[turn_index].sampled_token_ids;
+  const int step = recording_.turns.back().sampled_token_ids.size();
+  if (step >= recorded_token_ids.size()) {
+    return absl::OutOfRangeError(absl::StrCat(
+        "Turn ", turn_index, " is replayed past its ",
+        recorded_token_ids.size(),
+        " recorded tokens; replay with the settings of the recording."));
+  }
+  return recorded_token_ids[step];
+}
+
+void DecodeRecorder::RecordStep(int token_id, absl::Duration latency) {
+  absl::MutexLock lock(&mutex_);
+  // The decode of a session restored without a prompt starts its own turn.
+  if (recording_.turns.empty()) {
+    recording_.turns.emplace_back();
+  }
+  recording_.turns.back().sampled_token_ids.push_back(token_id);
+  recording_.turns.back().step_latencies.push_back(latency);
+}
+
+DecodeRecording DecodeRecorder::GetRecording() const {
+  absl::MutexLock lock(&mutex_);
+  return recording_;
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,106 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_DECODE_RECORDING_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_DECODE_RECORDING_H_
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// A prompt of a recorded session, and the tokens decoded after it.
+struct DecodeRecordingTurn {
+  // The prompt text, and the token ids it is encoded to.
+  std::string prompt;
+  std::vector<int> prompt_token_ids;
+  // The sampled token ids, and the latency of the decode step of each, from
+  // the end of the previous step, or from the start of the decode for the
+  // first one.
+  std::vector<int> sampled_token_ids;
+  std::vector<absl::Duration> step_latencies;
+};
+
+// The tokens and the timings of the turns of a session, to reproduce its
+// decode with the same tokens on another build or device.
+struct DecodeRecording {
+  // The serialized proto::SamplerParameters of the session, seed included.
+  std::string sampler_params;
+  std::vector<DecodeRecordingTurn> turns;
+};
+
+// Serializes `recording` into a compact binary form, with the step latencies
+// in microseconds.
+std::string SerializeDecodeRecording(const DecodeRecording& recording);
+
+// Parses a recording serialized by SerializeDecodeRecording(). Returns an
+// InvalidArgument error if `serialized_recording` is not one.
+absl::StatusOr<DecodeRecording> ParseDecodeRecording(
+    absl::string_view serialized_recording);
+
+// Collects the DecodeRecording of a session, or replays one: the sampled
+// tokens of each turn are then taken from the recording, and the replayed
+// turns are recorded with their own timings, to be compared with the
+// recorded ones. Thread-safe.
+class DecodeRecorder {
+ public:
+  // Records the turns of a session sampling with `sampler_params`, the
+  // serialized proto::SamplerParameters.
+  explicit DecodeRecorder(std::string sampler_params);
+  // Replays the turns of `recording`.
+  explicit DecodeRecorder(DecodeRecording recording);
+
+  bool IsReplaying() const { return replayed_recording_.has_value(); }
+  // The recording replayed, if any.
+  const std::optional<DecodeRecording>& GetReplayedRecording() const {
+    return replayed_recording_;
+  }
+
+  // Starts a turn of `prompt`. When replaying, returns a FailedPrecondition
+  // error unless the prompt is encoded to the token ids of the next recorded
+  // turn, e.g. with another tokenizer.
+  absl::Status StartTurn(absl::string_view prompt,
+                         absl::Span<const int> prompt_token_ids);
+
+  // Returns the recorded token id of the next step of the current turn when
+  // replaying. Returns an OutOfRange error past the recorded tokens, e.g. if
+  // the replay does not stop where the recording did.
+  absl::StatusOr<int> GetReplayedTokenId() const;
+
+  // Records the token id of a decode step, and its latency.
+  void RecordStep(int token_id, absl::Duration latency);
+
+  // Returns the turns recorded so far, i.e. the replayed turns with their own
+  // timings when replaying.
+  DecodeRecording GetRecording() const;
+
+ private:
+  const std::optional<DecodeRecording> replayed_recording_;
+
+  mutable absl::Mutex mutex_;
+  DecodeRecording recording_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_DECODE_RECORDING_H_
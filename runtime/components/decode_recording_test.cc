@@ -0,0 +1,127 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/components/decode_recording.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::status::StatusIs;
+
+DecodeRecording MakeRecording() {
+  DecodeRecording recording;
+  recording.sampler_params = "params";
+  recording.turns.push_back(DecodeRecordingTurn{
+      .prompt = "Hello",
+      .prompt_token_ids = {2, 10, 11},
+      .sampled_token_ids = {20, 21, 1},
+      .step_latencies = {absl::Milliseconds(30), absl::Milliseconds(12),
+                         absl::Microseconds(11500)},
+  });
+  recording.turns.push_back(DecodeRecordingTurn{
+      .prompt = "More",
+      .prompt_token_ids = {12},
+      .sampled_token_ids = {22},
+      .step_latencies = {absl::Milliseconds(13)},
+  });
+  return recording;
+}
+
+TEST(DecodeRecordingTest, SerializationRoundTrip) {
+  const DecodeRecording recording = MakeRecording();
+  ASSERT_OK_AND_ASSIGN(
+      DecodeRecording parsed,
+      ParseDecodeRecording(SerializeDecodeRecording(recording)));
+  EXPECT_EQ(parsed.sampler_params, "params");
+  ASSERT_EQ(parsed.turns.size(), 2);
+  EXPECT_EQ(parsed.turns[0].prompt, "Hello");
+  EXPECT_THAT(parsed.turns[0].prompt_token_ids, ElementsAre(2, 10, 11));
+  EXPECT_THAT(parsed.turns[0].sampled_token_ids, ElementsAre(20, 21, 1));
+  EXPECT_THAT(parsed.turns[0].step_latencies,
+              ElementsAre(absl::Milliseconds(30), absl::Milliseconds(12),
+                          absl::Microseconds(11500)));
+  EXPECT_THAT(parsed.turns[1].sampled_token_ids, ElementsAre(22));
+}
+
+TEST(DecodeRecordingTest, ParseRejectsInvalidRecordings) {
+  const std::string serialized = SerializeDecodeRecording(MakeRecording());
+  EXPECT_THAT(ParseDecodeRecording("not a recording"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      ParseDecodeRecording(serialized.substr(0, serialized.size() - 1)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseDecodeRecording(serialized + "x"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(DecodeRecorderTest, RecordsTheTurns) {
+  DecodeRecorder recorder("params");
+  EXPECT_FALSE(recorder.IsReplaying());
+  EXPECT_OK(recorder.StartTurn("Hello", {2, 10, 11}));
+  recorder.RecordStep(20, absl::Milliseconds(30));
+  recorder.RecordStep(21, absl::Milliseconds(12));
+  EXPECT_THAT(recorder.GetReplayedTokenId(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+
+  const DecodeRecording recording = recorder.GetRecording();
+  EXPECT_EQ(recording.sampler_params, "params");
+  ASSERT_EQ(recording.turns.size(), 1);
+  EXPECT_EQ(recording.turns[0].prompt, "Hello");
+  EXPECT_THAT(recording.turns[0].sampled_token_ids, ElementsAre(20, 21));
+}
+
+TEST(DecodeRecorderTest, ReplaysTheRecordedTokens) {
+  DecodeRecorder recorder(MakeRecording());
+  EXPECT_TRUE(recorder.IsReplaying());
+  ASSERT_TRUE(recorder.GetReplayedRecording().has_value());
+  EXPECT_EQ(recorder.GetReplayedRecording()->turns.size(), 2);
+  // The prompt must be encoded as recorded.
+  EXPECT_THAT(recorder.StartTurn("Hello", {2, 10}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_OK(recorder.StartTurn("Hello", {2, 10, 11}));
+  for (int token_id : {20, 21, 1}) {
+    ASSERT_OK_AND_ASSIGN(int replayed_token_id, recorder.GetReplayedTokenId());
+    EXPECT_EQ(replayed_token_id, token_id);
+    recorder.RecordStep(replayed_token_id, absl::Milliseconds(5));
+  }
+  EXPECT_THAT(recorder.GetReplayedTokenId(),
+              StatusIs(absl::StatusCode::kOutOfRange));
+
+  EXPECT_OK(recorder.StartTurn("More", {12}));
+  ASSERT_OK_AND_ASSIGN(int replayed_token_id, recorder.GetReplayedTokenId());
+  EXPECT_EQ(replayed_token_id, 22);
+  recorder.RecordStep(replayed_token_id, absl::Milliseconds(5));
+  EXPECT_THAT(recorder.StartTurn("Extra", {13}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+
+  // The replayed turns are recorded with their own timings.
+  const DecodeRecording replayed = recorder.GetRecording();
+  ASSERT_EQ(replayed.turns.size(), 2);
+  EXPECT_THAT(replayed.turns[0].sampled_token_ids, ElementsAre(20, 21, 1));
+  EXPECT_THAT(replayed.turns[0].step_latencies,
+              ElementsAre(absl::Milliseconds(5), absl::Milliseconds(5),
+                          absl::Milliseconds(5)));
+}
+
+}  // namespace
+}  // namespace litert::lm
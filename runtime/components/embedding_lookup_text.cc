@@ -2,12 +2,17 @@
 
 #include <sys/types.h>
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
@@ -21,16 +26,25 @@
 #include "litert/cc/litert_model.h"  // from @litert
 #include "litert/cc/litert_options.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/embedding_table.h"
 #include "runtime/util/status_macros.h"  //NOLINT
 
 namespace litert::lm {
 
 using ::litert::TensorBuffer;
 
+namespace {
+
+// The size of the pages the mapped rows are read in by.
+constexpr size_t kPageSize = 4096;
+
+}  // namespace
+
 absl::Status EmbeddingLookupText::LookupInternal(int token,
                                                  absl::Span<uint8_t> buffer) {
-  if (!compiled_model_.has_value() || input_buffers_.size() != 1 ||
-      output_buffers_.size() != 1) {
+  if (table_ == nullptr &&
+      (!compiled_model_.has_value() || input_buffers_.size() != 1 ||
+       output_buffers_.size() != 1)) {
     return absl::InvalidArgumentError(
         "The Embedding model must be initialized before being used.");
   }
@@ -40,10 +54,32 @@ absl::Status EmbeddingLookupText::LookupInternal(int token,
     return absl::OkStatus();
   }
 
+  if (table_ != nullptr) {
+    if (buffer.size() != table_->GetRowSize() * sizeof(float)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The requested tensor must hold one embedding of ",
+          table_->GetRowSize() * sizeof(float),
+          " bytes. Requested tensor bytes: ", buffer.size()));
+    }
+    RETURN_IF_ERROR(table_->LookupRow(
+        token, absl::MakeSpan(reinterpret_cast<float*>(buffer.data()),
+                              table_->GetRowSize())));
+    if (max_mapped_row_bytes_ > 0) {
+      // A row takes at least a page once read in.
+      mapped_row_bytes_ += (table_->GetRowSizeInBytes() + kPageSize - 1) /
+                           kPageSize * kPageSize;
+      if (mapped_row_bytes_ >= max_mapped_row_bytes_) {
+        release_mapped_rows_();
+        mapped_row_bytes_ = 0;
+      }
+    }
+    return absl::OkStatus();
+  }
+
   // The input tensor size was verified when the model was loaded.
   input_buffers_[0].Write(absl::MakeSpan(const_cast<const int*>(&token), 1));
 
-  compiled_model_->Run(input_buffers_, output_buffers_);
+  compiled_model_->Run(signature_index_, input_buffers_, output_buffers_);
 
   LITERT_ASSIGN_OR_RETURN(auto output_buffer_size, output_buffers_[0].Size());
 
@@ -63,8 +99,14 @@ absl::Status EmbeddingLookupText::LookupInternal(int token,
 absl::Status EmbeddingLookupText::LookupDecode(
     int token, std::vector<float>& decode_output_vector) {
   // For text embedding, looking up a single token during decode is the same as
-  // prefill.
-  return LookupPrefill(token, decode_output_vector);
+  // prefill, besides the decode cache.
+  if (decode_output_vector.size() != floats_per_token_output_) {
+    return LookupPrefill(token, decode_output_vector);
+  }
+  uint8_t* output_ptr = reinterpret_cast<uint8_t*>(decode_output_vector.data());
+  return LookupDecodeInternal(
+      token, absl::MakeSpan(output_ptr, floats_per_token_output_ *
+                                            sizeof(float)));
 }
 
 absl::Status EmbeddingLookupText::LookupDecode(int token,
@@ -103,10 +145,69 @@ absl::Status EmbeddingLookupText::LookupDecode(int token,
 
   LITERT_ASSIGN_OR_RETURN(auto decode_output_size, decode_output->Size());
 
-  return LookupInternal(
+  return LookupDecodeInternal(
       token, absl::Span<uint8_t>(decode_output_ptr, decode_output_size));
 }
 
+void EmbeddingLookupText::SetDecodeCacheCapacity(size_t max_num_tokens) {
+  decode_cache_capacity_ = max_num_tokens;
+  while (decode_cache_entries_.size() > decode_cache_capacity_) {
+    decode_cache_index_.erase(decode_cache_entries_.back().first);
+    decode_cache_entries_.pop_back();
+  }
+}
+
+void EmbeddingLookupText::ClearDecodeCache() {
+  decode_cache_entries_.clear();
+  decode_cache_index_ = {};
+}
+
+void EmbeddingLookupText::SetMappedRowBudget(
+    size_t max_mapped_bytes, absl::AnyInvocable<void()> release_mapped_rows) {
+  if (table_ == nullptr || release_mapped_rows == nullptr) {
+    return;
+  }
+  max_mapped_row_bytes_ = max_mapped_bytes;
+  mapped_row_bytes_ = 0;
+  release_mapped_rows_ = std::move(release_mapped_rows);
+}
+
+absl::Status EmbeddingLookupText::LookupDecodeInternal(
+    int token, absl::Span<uint8_t> buffer) {
+  if (decode_cache_capacity_ == 0 || token < 0) {
+    return LookupInternal(token, buffer);
+  }
+  if (auto it = decode_cache_index_.find(token);
+      it != decode_cache_index_.end() &&
+      it->second->second.size() == buffer.size()) {
+    ++decode_cache_hits_;
+    decode_cache_entries_.splice(decode_cache_entries_.begin(),
+                                 decode_cache_entries_, it->second);
+    memcpy(buffer.data(), it->second->second.data(), buffer.size());
+    return absl::OkStatus();
+  }
+
+  ++decode_cache_misses_;
+  RETURN_IF_ERROR(LookupInternal(token, buffer));
+  if (auto it = decode_cache_index_.find(token);
+      it != decode_cache_index_.end()) {
+    decode_cache_entries_.erase(it->second);
+    decode_cache_index_.erase(it);
+  }
+  // The storage of the least recently decoded token is reused once the cache
+  // is full.
+  std::vector<uint8_t> embedding;
+  if (decode_cache_entries_.size() == decode_cache_capacity_) {
+    decode_cache_index_.erase(decode_cache_entries_.back().first);
+    embedding = std::move(decode_cache_entries_.back().second);
+    decode_cache_entries_.pop_back();
+  }
+  embedding.assign(buffer.begin(), buffer.end());
+  decode_cache_entries_.emplace_front(token, std::move(embedding));
+  decode_cache_index_[token] = decode_cache_entries_.begin();
+  return absl::OkStatus();
+}
+
 absl::Status EmbeddingLookupText::LookupPrefill(
     int token, std::vector<float>& prefill_output_vector) {
   if (prefill_output_vector.size() != floats_per_token_output_) {
@@ -128,6 +229,15 @@ size_t EmbeddingLookupText::GetFloatsPerToken() {
 absl::Status EmbeddingLookupText::LookupPrefill(absl::Span<const int> tokens,
                                                 TensorBuffer* prefill_output,
                                                 size_t token_offset) {
+  return LookupPrefillWithPlaceholders(tokens, /*placeholder_token=*/-1,
+                                       /*placeholder_embeddings=*/{},
+                                       prefill_output, token_offset);
+}
+
+absl::Status EmbeddingLookupText::LookupPrefillWithPlaceholders(
+    absl::Span<const int> tokens, int placeholder_token,
+    absl::Span<const float> placeholder_embeddings,
+    TensorBuffer* prefill_output, size_t token_offset) {
   if (prefill_output == nullptr) {
     return absl::InvalidArgumentError("Prefill output tensor buffer is null.");
   }
@@ -189,6 +299,19 @@ absl::Status EmbeddingLookupText::LookupPrefill(absl::Span<const int> tokens,
   LITERT_ASSIGN_OR_RETURN(auto prefill_output_size, prefill_output->Size());
   const size_t bytes_per_token = GetFloatsPerToken() * sizeof(float);
 
+  if (!placeholder_embeddings.empty()) {
+    const size_t num_placeholders =
+        std::count(tokens.begin(), tokens.end(), placeholder_token);
+    if (placeholder_embeddings.size() !=
+        num_placeholders * GetFloatsPerToken()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The placeholder embeddings must hold one embedding of ",
+          GetFloatsPerToken(), " floats per placeholder token. Number of "
+          "placeholder tokens: ", num_placeholders,
+          ". Placeholder embedding floats: ", placeholder_embeddings.size()));
+    }
+  }
+
   if (byte_offset + bytes_per_token * tokens.size() > prefill_output_size) {
     return absl::InvalidArgumentError(
         absl::StrCat("The byte offset and the total number of bytes to be "
@@ -205,12 +328,32 @@ absl::Status EmbeddingLookupText::LookupPrefill(absl::Span<const int> tokens,
       reinterpret_cast<uint8_t*>(prefill_output_lock_and_addr->second);
 
   prefill_output_ptr += byte_offset;
-  for (int token : tokens) {
-      absl::Span<uint8_t> output_buffer(
-          reinterpret_cast<uint8_t*>(prefill_output_ptr), bytes_per_token);
-      RETURN_IF_ERROR(LookupInternal(token, output_buffer));
-    prefill_output_ptr += bytes_per_token;
+  if (placeholder_embeddings.empty()) {
+    RETURN_IF_ERROR(LookupTokens(tokens, prefill_output_ptr));
+  } else {
+    // The placeholder rows are copied straight into their positions, and
+    // only the runs of tokens between them are looked up, such that e.g. the
+    // rows of an image are neither looked up nor written twice.
+    const float* placeholder_row = placeholder_embeddings.data();
+    size_t run_start = 0;
+    for (size_t i = 0; i <= tokens.size(); ++i) {
+      if (i < tokens.size() && tokens[i] != placeholder_token) {
+        continue;
+      }
+      if (i > run_start) {
+        RETURN_IF_ERROR(
+            LookupTokens(tokens.subspan(run_start, i - run_start),
+                         prefill_output_ptr + run_start * bytes_per_token));
+      }
+      if (i < tokens.size()) {
+        memcpy(prefill_output_ptr + i * bytes_per_token, placeholder_row,
+               bytes_per_token);
+        placeholder_row += GetFloatsPerToken();
+      }
+      run_start = i + 1;
+    }
   }
+  prefill_output_ptr += bytes_per_token * tokens.size();
 
   // If there are fewer tokens than the output tensor can hold, we need to treat
   // the remaining tokens as if they were 0.
@@ -225,6 +368,61 @@ absl::Status EmbeddingLookupText::LookupPrefill(absl::Span<const int> tokens,
   return absl::OkStatus();
 }
 
+absl::Status EmbeddingLookupText::LookupTokens(absl::Span<const int> tokens,
+                                               uint8_t* output) {
+  const size_t bytes_per_token = GetFloatsPerToken() * sizeof(float);
+  if (prefill_signature_index_.has_value()) {
+    std::vector<int> chunk(prefill_tokens_per_run_);
+    for (size_t start = 0; start < tokens.size();
+         start += prefill_tokens_per_run_) {
+      const size_t num_tokens =
+          std::min(prefill_tokens_per_run_, tokens.size() - start);
+      // The unused tail of the chunk and the negative tokens are looked up as
+      // token 0, and the latter are overwritten with the default embedding.
+      std::fill(chunk.begin(), chunk.end(), 0);
+      for (size_t i = 0; i < num_tokens; ++i) {
+        chunk[i] = std::max(tokens[start + i], 0);
+      }
+      prefill_input_buffers_[0].Write(absl::MakeConstSpan(chunk));
+      compiled_model_->Run(*prefill_signature_index_, prefill_input_buffers_,
+                           prefill_output_buffers_);
+      LITERT_ASSIGN_OR_RETURN(
+          auto lock_and_addr,
+          ::litert::TensorBufferScopedLock::Create(
+              prefill_output_buffers_[0], TensorBuffer::LockMode::kRead));
+      memcpy(output + start * bytes_per_token, lock_and_addr.second,
+             num_tokens * bytes_per_token);
+      for (size_t i = 0; i < num_tokens; ++i) {
+        if (tokens[start + i] < 0) {
+          memcpy(output + (start + i) * bytes_per_token,
+                 default_embedding_vector_.data(), bytes_per_token);
+        }
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  // Prompts tend to repeat tokens, e.g. the control tokens of every turn.
+  absl::flat_hash_map<int, const uint8_t*> looked_up_tokens;
+  for (int token : tokens) {
+    auto it = looked_up_tokens.find(token);
+    if (it != looked_up_tokens.end()) {
+      memcpy(output, it->second, bytes_per_token);
+    } else {
+      // With a bound on the mapped rows, the hot rows are taken from the
+      // decode cache rather than read in from the file again.
+      const absl::Span<uint8_t> embedding =
+          absl::MakeSpan(output, bytes_per_token);
+      RETURN_IF_ERROR(max_mapped_row_bytes_ > 0
+                          ? LookupDecodeInternal(token, embedding)
+                          : LookupInternal(token, embedding));
+      looked_up_tokens.emplace(token, output);
+    }
+    output += bytes_per_token;
+  }
+  return absl::OkStatus();
+}
+
 absl::StatusOr<std::unique_ptr<EmbeddingLookupText>>
 EmbeddingLookupText::Create(const litert::Model* model) {
   LITERT_ASSIGN_OR_RETURN(auto env, ::litert::Environment::Create({}));
@@ -235,6 +433,15 @@ EmbeddingLookupText::Create(const litert::Model* model) {
 }
 
 absl::Status EmbeddingLookupText::Initialize() {
+  // Embedders that only gather rows of a constant table are read in place
+  // from the model weights, which stay memory mapped from the model file, so
+  // neither the compiled model nor its buffers are needed.
+  absl::StatusOr<std::unique_ptr<EmbeddingTable>> table =
+      EmbeddingTable::CreateFromModel(model_);
+  if (table.ok()) {
+    return InitializeFromTable(*std::move(table));
+  }
+
   LITERT_ASSIGN_OR_RETURN(auto options, Options::Create());
   options.SetHardwareAccelerators(kLiteRtHwAcceleratorCpu);
 
@@ -242,39 +449,56 @@ absl::Status EmbeddingLookupText::Initialize() {
                           litert::CompiledModel::Create(env_, model_, options));
   LITERT_ASSIGN_OR_RETURN(auto signatures, model_.GetSignatures());
 
-  if (signatures.size() != 1) {
-    return absl::InvalidArgumentError(absl::StrCat(
-        "The Embedding model must have exactly one signature but got ",
-        signatures.size()));
+  if (signatures.empty()) {
+    return absl::InvalidArgumentError(
+        "The Embedding model must have at least one signature.");
   }
 
-  LITERT_ASSIGN_OR_RETURN(input_buffers_, compiled_model_->CreateInputBuffers(
-                                              /*signature_index=*/0));
-
-  LITERT_ASSIGN_OR_RETURN(auto input_buffer_size, input_buffers_[0].Size());
-
-  if (input_buffers_.size() != 1) {
-    return absl::InvalidArgumentError(absl::StrCat(
-        "The Embedding model must have exactly one input tensor but got ",
-        input_buffers_.size()));
+  // The signature taking a single token is used for the decode, and the one
+  // taking the most tokens, if any, for the prefill.
+  std::optional<size_t> signature_index;
+  for (size_t i = 0; i < signatures.size(); ++i) {
+    LITERT_ASSIGN_OR_RETURN(auto input_buffers,
+                            compiled_model_->CreateInputBuffers(i));
+    if (input_buffers.size() != 1) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The Embedding model must have exactly one input tensor but got ",
+          input_buffers.size()));
+    }
+    LITERT_ASSIGN_OR_RETURN(auto output_buffers,
+                            compiled_model_->CreateOutputBuffers(i));
+    if (output_buffers.size() != 1) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The Embedding model must have exactly one output tensor but got ",
+          output_buffers.size()));
+    }
+    LITERT_ASSIGN_OR_RETURN(auto input_buffer_size, input_buffers[0].Size());
+    if (input_buffer_size % sizeof(int32_t) != 0) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Input tensor bytes must be a multiple of 4 but got ",
+          input_buffer_size));
+    }
+    const size_t num_tokens = input_buffer_size / sizeof(int32_t);
+    if (num_tokens == 1 && !signature_index.has_value()) {
+      signature_index = i;
+      input_buffers_ = std::move(input_buffers);
+      output_buffers_ = std::move(output_buffers);
+    } else if (num_tokens > prefill_tokens_per_run_) {
+      prefill_signature_index_ = i;
+      prefill_tokens_per_run_ = num_tokens;
+      prefill_input_buffers_ = std::move(input_buffers);
+      prefill_output_buffers_ = std::move(output_buffers);
+    }
   }
-
-  if (input_buffer_size != 4) {
-    return absl::InvalidArgumentError(absl::StrCat(
-        "Input tensor bytes must be 4 but got ", input_buffers_[0].Size()));
+  if (!signature_index.has_value()) {
+    return absl::InvalidArgumentError(
+        "The Embedding model must have a signature taking a single token.");
   }
+  signature_index_ = *signature_index;
 
-  LITERT_ASSIGN_OR_RETURN(output_buffers_, compiled_model_->CreateOutputBuffers(
-                                               /*signature_index=*/0));
   LITERT_ASSIGN_OR_RETURN(output_buffer_type_, output_buffers_[0].TensorType());
   const auto& output_buffer_layout = output_buffer_type_.value().Layout();
 
-  if (output_buffers_.size() != 1) {
-    return absl::InvalidArgumentError(absl::StrCat(
-        "The Embedding model must have exactly one output tensor but got ",
-        output_buffers_.size()));
-  }
-
   if (output_buffer_type_.value().ElementType() !=
       litert::ElementType::Float32) {
     return absl::InvalidArgumentError(
@@ -286,6 +510,24 @@ absl::Status EmbeddingLookupText::Initialize() {
     floats_per_token_output_ *= output_buffer_layout.Dimensions()[i];
   }
 
+  if (prefill_signature_index_.has_value()) {
+    // The prefill signature must output [1, prefill_tokens_per_run_, ...] with
+    // the same embeddings as the single token one.
+    LITERT_ASSIGN_OR_RETURN(auto prefill_output_size,
+                            prefill_output_buffers_[0].Size());
+    LITERT_ASSIGN_OR_RETURN(auto prefill_output_type,
+                            prefill_output_buffers_[0].TensorType());
+    if (prefill_output_type.ElementType() != litert::ElementType::Float32 ||
+        prefill_output_size != prefill_tokens_per_run_ *
+                                   floats_per_token_output_ * sizeof(float)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The output tensor of the multi-token signature of the Embedding "
+          "model must hold ",
+          prefill_tokens_per_run_, " float32 embeddings of ",
+          floats_per_token_output_, " floats."));
+    }
+  }
+
   // Initialize the default embedding vector to be the embedding of token 0.
   default_embedding_vector_.resize(floats_per_token_output_);
   RETURN_IF_ERROR(LookupInternal(
@@ -296,4 +538,36 @@ absl::Status EmbeddingLookupText::Initialize() {
   return absl::OkStatus();
 }
 
+absl::Status EmbeddingLookupText::InitializeFromTable(
+    std::unique_ptr<EmbeddingTable> table) {
+  LITERT_ASSIGN_OR_RETURN(auto subgraph, model_.MainSubgraph());
+  const auto outputs = subgraph.Outputs();
+  if (outputs.size() != 1) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The Embedding model must have exactly one output tensor but got ",
+        outputs.size()));
+  }
+  LITERT_ASSIGN_OR_RETURN(output_buffer_type_, outputs[0].RankedTensorType());
+  if (output_buffer_type_->ElementType() != litert::ElementType::Float32) {
+    return absl::InvalidArgumentError(
+        "The output tensor from the Embedding model must be of type float32.");
+  }
+  const auto& output_buffer_layout = output_buffer_type_->Layout();
+  floats_per_token_output_ = 1;
+  for (size_t i = 2; i < output_buffer_layout.Rank(); ++i) {
+    floats_per_token_output_ *= output_buffer_layout.Dimensions()[i];
+  }
+  if (floats_per_token_output_ != table->GetRowSize()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The rows of the embedding table hold ", table->GetRowSize(),
+        " values, but the Embedding model outputs ", floats_per_token_output_,
+        " floats per token."));
+  }
+  table_ = std::move(table);
+
+  // Initialize the default embedding vector to be the embedding of token 0.
+  default_embedding_vector_.resize(floats_per_token_output_);
+  return table_->LookupRow(0, absl::MakeSpan(default_embedding_vector_));
+}
+
 }  // namespace litert::lm
@@ -5,12 +5,15 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <list>
 #include <memory>
 #include <optional>
 #include <utility>
 #include <vector>
 
 #include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
@@ -19,6 +22,7 @@
 #include "litert/cc/litert_model.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/components/embedding_lookup.h"
+#include "runtime/components/embedding_table.h"
 
 namespace litert::lm {
 
@@ -81,6 +85,17 @@ class EmbeddingLookupText : public EmbeddingLookup {
                              litert::TensorBuffer* prefill_output,
                              size_t token_offset) override;
 
+  // Same as LookupPrefill() above, but the embedding of each token equal to
+  // `placeholder_token` is the next row of `placeholder_embeddings` instead of
+  // being looked up, e.g. a soft prompt or a document encoding computed
+  // outside of the model. The rows are copied straight into the locked
+  // `prefill_output`, and there must be one per placeholder token, unless
+  // there are none, in which case the placeholders get the default embedding.
+  absl::Status LookupPrefillWithPlaceholders(
+      absl::Span<const int> tokens, int placeholder_token,
+      absl::Span<const float> placeholder_embeddings,
+      litert::TensorBuffer* prefill_output, size_t token_offset);
+
   // Returns number of floats per token in the output tensor.
   size_t GetFloatsPerToken();
 
@@ -90,6 +105,36 @@ class EmbeddingLookupText : public EmbeddingLookup {
     return default_embedding_vector_;
   }
 
+  // Caches the embeddings of up to `max_num_tokens` of the most recently
+  // decoded tokens, such that LookupDecode copies the embedding of a cached
+  // token instead of running the model. 0 disables the cache.
+  void SetDecodeCacheCapacity(size_t max_num_tokens);
+
+  // Drops the cached embeddings and frees their memory, e.g. under memory
+  // pressure. The capacity is kept, so the cache fills up again.
+  void ClearDecodeCache();
+
+  // Bounds the memory of the rows read in place from the embedding table,
+  // for the tables larger than the rest of the model, e.g. the per-layer
+  // embeddings of a mapped model file. Once the rows read since the last
+  // release exceed `max_mapped_bytes`, counted in whole pages,
+  // `release_mapped_rows` is called to drop the pages of the mapped table,
+  // which are read from the file again when accessed. The prefill lookups
+  // then also go through the decode cache, which keeps the hot rows resident.
+  // 0 disables the bound. No-op if the model is run instead of the table
+  // being read in place.
+  void SetMappedRowBudget(size_t max_mapped_bytes,
+                          absl::AnyInvocable<void()> release_mapped_rows);
+
+  // Returns the number of LookupDecode calls served from, or missing, the
+  // decode cache, and the memory held by its embeddings.
+  uint64_t GetDecodeCacheHits() const { return decode_cache_hits_; }
+  uint64_t GetDecodeCacheMisses() const { return decode_cache_misses_; }
+  size_t GetDecodeCacheSizeInBytes() const {
+    return decode_cache_entries_.size() * floats_per_token_output_ *
+           sizeof(float);
+  }
+
  protected:
   EmbeddingLookupText(litert::Environment env,
                       const litert::Model* absl_nonnull model)
@@ -98,10 +143,23 @@ class EmbeddingLookupText : public EmbeddingLookup {
   // Loads the provided model. This must be called before Lookup.
   absl::Status Initialize();
 
+  // Uses `table` instead of running the model, whose signature output gives
+  // the shape of the embeddings.
+  absl::Status InitializeFromTable(std::unique_ptr<EmbeddingTable> table);
+
   // Internal implementation of Lookup for both the single and multiple token
   // cases.
   absl::Status LookupInternal(int token, absl::Span<uint8_t> buffer);
 
+  // LookupInternal through the decode cache, if it is enabled.
+  absl::Status LookupDecodeInternal(int token, absl::Span<uint8_t> buffer);
+
+  // Looks up the embeddings of `tokens` into `output`, which holds
+  // `tokens.size()` embeddings back to back. The tokens are fed to the prefill
+  // signature in chunks if the model has one, and otherwise each distinct
+  // token is looked up once and copied to its repetitions.
+  absl::Status LookupTokens(absl::Span<const int> tokens, uint8_t* output);
+
   // The environment for the embedding lookup.
   litert::Environment env_;
   // The model for the embedding lookup. The actual model instance is owned by
@@ -110,11 +168,25 @@ class EmbeddingLookupText : public EmbeddingLookup {
   // The compiled model for the embedding model.
   std::optional<litert::CompiledModel> compiled_model_;
 
+  // The embedding table read in place from the model weights, if the model
+  // only gathers its rows. The model is not compiled then.
+  std::unique_ptr<EmbeddingTable> table_;
+
+  // The signature of the embedding model taking a single token.
+  size_t signature_index_ = 0;
+
   // The input buffer for the embedding model.
   std::vector<litert::TensorBuffer> input_buffers_;
 
   // The output buffers for the embedding model.
   std::vector<litert::TensorBuffer> output_buffers_;
+
+  // The signature of the embedding model taking the most tokens per run, if
+  // it takes more than one, with its buffers.
+  std::optional<size_t> prefill_signature_index_;
+  size_t prefill_tokens_per_run_ = 1;
+  std::vector<litert::TensorBuffer> prefill_input_buffers_;
+  std::vector<litert::TensorBuffer> prefill_output_buffers_;
   // The output buffer type for the embedding model.
   std::optional<litert::RankedTensorType> output_buffer_type_;
 
@@ -124,6 +196,21 @@ class EmbeddingLookupText : public EmbeddingLookup {
   // The default embedding vector to use when a token is not found in the
   // lookup table. This is set to the value of token id 0.
   std::vector<float> default_embedding_vector_;
+
+  // The decode cache, holding the embeddings of the tokens from the most to
+  // the least recently decoded, with the position of each token in the list.
+  size_t decode_cache_capacity_ = 0;
+  std::list<std::pair<int, std::vector<uint8_t>>> decode_cache_entries_;
+  absl::flat_hash_map<int, decltype(decode_cache_entries_)::iterator>
+      decode_cache_index_;
+  uint64_t decode_cache_hits_ = 0;
+  uint64_t decode_cache_misses_ = 0;
+
+  // The bound of the memory of the mapped rows read since the last release,
+  // and the function releasing them.
+  size_t max_mapped_row_bytes_ = 0;
+  size_t mapped_row_bytes_ = 0;
+  absl::AnyInvocable<void()> release_mapped_rows_;
 };
 
 }  // namespace litert::lm
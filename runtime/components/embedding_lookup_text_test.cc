@@ -1,5 +1,6 @@
 #include "runtime/components/embedding_lookup_text.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -660,6 +661,64 @@ TEST_F(EmbeddingLookupTextTest, LookupPrefillWithOffsetAndDefaultEmbedding) {
   }
 }
 
+TEST_F(EmbeddingLookupTextTest, LookupDecodeWithCache) {
+  std::unique_ptr<EmbeddingLookupText> embedding = GetEmbeddingLookupText();
+  ASSERT_NE(embedding, nullptr);
+  embedding->SetDecodeCacheCapacity(/*max_num_tokens=*/2);
+
+  std::vector<float> output_vector(4 * 32);
+  // Token 1 is evicted by tokens 2 and 3, which stay cached.
+  for (int token : {1, 2, 3, 2, 3, 1}) {
+    ASSERT_OK(embedding->LookupDecode(token, output_vector));
+    EXPECT_NEAR(output_vector[4 * 32 - 1], 10000.0 * token + 100.0 * 3 + 31,
+                1e-5);
+  }
+  EXPECT_EQ(embedding->GetDecodeCacheHits(), 2);
+  EXPECT_EQ(embedding->GetDecodeCacheMisses(), 4);
+  EXPECT_EQ(embedding->GetDecodeCacheSizeInBytes(), 2 * 4 * 32 * sizeof(float));
+
+  // The cleared cache fills up again.
+  embedding->ClearDecodeCache();
+  EXPECT_EQ(embedding->GetDecodeCacheSizeInBytes(), 0);
+  ASSERT_OK(embedding->LookupDecode(1, output_vector));
+  ASSERT_OK(embedding->LookupDecode(1, output_vector));
+  EXPECT_EQ(embedding->GetDecodeCacheHits(), 3);
+  EXPECT_EQ(embedding->GetDecodeCacheSizeInBytes(), 4 * 32 * sizeof(float));
+}
+
+TEST_F(EmbeddingLookupTextTest, LookupReleasesTheMappedRows) {
+  std::unique_ptr<EmbeddingLookupText> embedding = GetEmbeddingLookupText();
+  ASSERT_NE(embedding, nullptr);
+  int num_releases = 0;
+  // Each row of 512 bytes is counted as a page of 4096 bytes.
+  embedding->SetMappedRowBudget(/*max_mapped_bytes=*/2 * 4096,
+                                [&num_releases]() { ++num_releases; });
+
+  std::vector<float> output_vector(4 * 32);
+  for (int token : {1, 2, 3, 4, 5}) {
+    ASSERT_OK(embedding->LookupDecode(token, output_vector));
+    EXPECT_NEAR(output_vector[4 * 32 - 1], 10000.0 * token + 100.0 * 3 + 31,
+                1e-5);
+  }
+  EXPECT_EQ(num_releases, 2);
+
+  // The prefill lookups fill the decode cache, whose rows are not read from
+  // the table again.
+  embedding->SetDecodeCacheCapacity(/*max_num_tokens=*/2);
+  embedding->SetMappedRowBudget(/*max_mapped_bytes=*/2 * 4096,
+                                [&num_releases]() { ++num_releases; });
+  Dimensions dimensions({1, 4, 4, 32});
+  LITERT_ASSERT_OK_AND_ASSIGN(TensorBuffer output_tensor,
+                              GetTensorBuffer(dimensions));
+  std::vector<int> tokens = {6, 7, 6, 7};
+  ASSERT_OK(embedding->LookupPrefill(tokens, &output_tensor, 0));
+  EXPECT_EQ(num_releases, 3);
+  ASSERT_OK(embedding->LookupDecode(6, output_vector));
+  EXPECT_NEAR(output_vector[0], 60000.0, 1e-5);
+  EXPECT_EQ(num_releases, 3);
+  EXPECT_EQ(embedding->GetDecodeCacheHits(), 1);
+}
+
 TEST_F(EmbeddingLookupTextTest, LookupPrefillWithBadOffset) {
   std::unique_ptr<EmbeddingLookupText> embedding = GetEmbeddingLookupText();
   EXPECT_NE(embedding, nullptr);
@@ -681,4 +740,97 @@ TEST_F(EmbeddingLookupTextTest, LookupPrefillWithBadOffset) {
               "must not exceed the size of the output tensor")));
 }
 
+TEST_F(EmbeddingLookupTextTest, LookupPrefillWithPlaceholders) {
+  std::unique_ptr<EmbeddingLookupText> embedding = GetEmbeddingLookupText();
+  EXPECT_NE(embedding, nullptr);
+
+  Dimensions dimensions({1, 4, 4, 32});
+  LITERT_ASSERT_OK_AND_ASSIGN(TensorBuffer output_tensor,
+                              GetTensorBuffer(dimensions));
+
+  // Two placeholders, whose embeddings are all 0.5 and all 1.5.
+  const size_t floats_per_token = embedding->GetFloatsPerToken();
+  std::vector<float> placeholder_embeddings(2 * floats_per_token, 0.5f);
+  std::fill(placeholder_embeddings.begin() + floats_per_token,
+            placeholder_embeddings.end(), 1.5f);
+  std::vector<int> tokens = {-1, 2, -1, 3};
+  EXPECT_OK(embedding->LookupPrefillWithPlaceholders(
+      tokens, /*placeholder_token=*/-1, placeholder_embeddings, &output_tensor,
+      0));
+
+  auto output_tensor_lock_and_addr = ::litert::TensorBufferScopedLock::Create(
+      output_tensor, ::litert::TensorBuffer::LockMode::kRead);
+  auto output_tensor_ptr =
+      reinterpret_cast<float*>(output_tensor_lock_and_addr->second);
+  for (int idx2 = 0; idx2 < dimensions[2]; ++idx2) {
+    for (int idx3 = 0; idx3 < dimensions[3]; ++idx3) {
+      const size_t offset = idx2 * dimensions[3] + idx3;
+      EXPECT_NEAR(output_tensor_ptr[offset], 0.5f, 1e-5);
+      EXPECT_NEAR(output_tensor_ptr[floats_per_token + offset],
+                  20000.0 + 100.0 * idx2 + idx3, 1e-5);
+      EXPECT_NEAR(output_tensor_ptr[2 * floats_per_token + offset], 1.5f,
+                  1e-5);
+      EXPECT_NEAR(output_tensor_ptr[3 * floats_per_token + offset],
+                  30000.0 + 100.0 * idx2 + idx3, 1e-5);
+    }
+  }
+}
+
+TEST_F(EmbeddingLookupTextTest, LookupPrefillWithConsecutivePlaceholders) {
+  std::unique_ptr<EmbeddingLookupText> embedding = GetEmbeddingLookupText();
+  EXPECT_NE(embedding, nullptr);
+
+  Dimensions dimensions({1, 5, 4, 32});
+  LITERT_ASSERT_OK_AND_ASSIGN(TensorBuffer output_tensor,
+                              GetTensorBuffer(dimensions));
+
+  // The rows of an image between two tokens, all 0.5 and then all 1.5.
+  const size_t floats_per_token = embedding->GetFloatsPerToken();
+  std::vector<float> placeholder_embeddings(2 * floats_per_token, 0.5f);
+  std::fill(placeholder_embeddings.begin() + floats_per_token,
+            placeholder_embeddings.end(), 1.5f);
+  std::vector<int> tokens = {2, -1, -1, 3};
+  EXPECT_OK(embedding->LookupPrefillWithPlaceholders(
+      tokens, /*placeholder_token=*/-1, placeholder_embeddings, &output_tensor,
+      0));
+
+  auto output_tensor_lock_and_addr = ::litert::TensorBufferScopedLock::Create(
+      output_tensor, ::litert::TensorBuffer::LockMode::kRead);
+  auto output_tensor_ptr =
+      reinterpret_cast<float*>(output_tensor_lock_and_addr->second);
+  const std::vector<float> default_embedding =
+      embedding->GetDefaultEmbeddingVector();
+  for (int idx2 = 0; idx2 < dimensions[2]; ++idx2) {
+    for (int idx3 = 0; idx3 < dimensions[3]; ++idx3) {
+      const size_t offset = idx2 * dimensions[3] + idx3;
+      EXPECT_NEAR(output_tensor_ptr[offset], 20000.0 + 100.0 * idx2 + idx3,
+                  1e-5);
+      EXPECT_NEAR(output_tensor_ptr[floats_per_token + offset], 0.5f, 1e-5);
+      EXPECT_NEAR(output_tensor_ptr[2 * floats_per_token + offset], 1.5f,
+                  1e-5);
+      EXPECT_NEAR(output_tensor_ptr[3 * floats_per_token + offset],
+                  30000.0 + 100.0 * idx2 + idx3, 1e-5);
+      // The row past the tokens gets the default embedding.
+      EXPECT_NEAR(output_tensor_ptr[4 * floats_per_token + offset],
+                  default_embedding[offset], 1e-5);
+    }
+  }
+}
+
+TEST_F(EmbeddingLookupTextTest, LookupPrefillWithMissingPlaceholders) {
+  std::unique_ptr<EmbeddingLookupText> embedding = GetEmbeddingLookupText();
+  EXPECT_NE(embedding, nullptr);
+
+  Dimensions dimensions({1, 2, 4, 32});
+  LITERT_ASSERT_OK_AND_ASSIGN(TensorBuffer output_tensor,
+                              GetTensorBuffer(dimensions));
+
+  std::vector<float> placeholder_embeddings(embedding->GetFloatsPerToken());
+  std::vector<int> tokens = {-1, -1};
+  EXPECT_THAT(embedding->LookupPrefillWithPlaceholders(
+                  tokens, /*placeholder_token=*/-1, placeholder_embeddings,
+                  &output_tensor, 0),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 }  // namespace litert::lm
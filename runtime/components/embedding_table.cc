@@ -0,0 +1,257 @@
+#include "runtime/components/embedding_table.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/c/litert_model.h"  // from @litert
+#include "litert/c/litert_op_code.h"  // from @litert
+#include "litert/cc/litert_element_type.h"  // from @litert
+#include "litert/cc/litert_macros.h"  // from @litert
+#include "litert/cc/litert_model.h"  // from @litert
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// The number of int4 values unpacked to int8 at once before dequantizing.
+constexpr int kInt4ChunkSize = 256;
+
+}  // namespace
+
+void DequantizeInt8(absl::Span<const int8_t> input, float scale,
+                    int zero_point, float* output) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 scale_v = _mm256_set1_ps(scale);
+  const __m256i zero_point_v = _mm256_set1_epi32(zero_point);
+  for (; i + 8 <= input.size(); i += 8) {
+    const __m128i bytes =
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(input.data() + i));
+    const __m256i values =
+        _mm256_sub_epi32(_mm256_cvtepi8_epi32(bytes), zero_point_v);
+    _mm256_storeu_ps(output + i,
+                     _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale_v));
+  }
+#elif defined(__ARM_NEON)
+  const float32x4_t scale_v = vdupq_n_f32(scale);
+  const int32x4_t zero_point_v = vdupq_n_s32(zero_point);
+  for (; i + 8 <= input.size(); i += 8) {
+    const int16x8_t values = vmovl_s8(vld1_s8(input.data() + i));
+    const int32x4_t low =
+        vsubq_s32(vmovl_s16(vget_low_s16(values)), zero_point_v);
+    const int32x4_t high =
+        vsubq_s32(vmovl_s16(vget_high_s16(values)), zero_point_v);
+    vst1q_f32(output + i, vmulq_f32(vcvtq_f32_s32(low), scale_v));
+    vst1q_f32(output + i + 4, vmulq_f32(vcvtq_f32_s32(high), scale_v));
+  }
+#endif
+  // The tail, with the same arithmetic as the vector kernels.
+  for (; i < input.size(); ++i) {
+    output[i] = static_cast<float>(input[i] - zero_point) * scale;
+  }
+}
+
+// static
+absl::StatusOr<std::unique_ptr<EmbeddingTable>> EmbeddingTable::Create(
+    absl::Span<const uint8_t> data, DataType data_type, int num_rows,
+    int row_size, std::vector<float> scales, std::vector<int> zero_points) {
+  RET_CHECK(num_rows > 0 && row_size > 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The embedding table must be non-empty, but got " << num_rows
+      << " rows of " << row_size << " values.";
+  const int64_t num_values = static_cast<int64_t>(num_rows) * row_size;
+  int64_t num_bytes = num_values;
+  switch (data_type) {
+    case DataType::kFloat32:
+      num_bytes = num_values * sizeof(float);
+      break;
+    case DataType::kInt8:
+      break;
+    case DataType::kInt4:
+      num_bytes = (num_values + 1) / 2;
+      break;
+  }
+  RET_CHECK_GE(static_cast<int64_t>(data.size()), num_bytes)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The embedding table holds " << data.size() << " bytes, but "
+      << num_bytes << " are needed.";
+  if (data_type != DataType::kFloat32) {
+    const int num_scales = scales.size();
+    RET_CHECK(num_scales == 1 || num_scales == num_rows)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Expected 1 or " << num_rows << " scales, but got " << num_scales;
+    if (zero_points.empty()) {
+      zero_points.assign(scales.size(), 0);
+    }
+    RET_CHECK_EQ(zero_points.size(), scales.size())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Expected as many zero points as scales.";
+  }
+  return absl::WrapUnique(new EmbeddingTable(data, data_type, num_rows,
+                                             row_size, std::move(scales),
+                                             std::move(zero_points)));
+}
+
+// static
+absl::StatusOr<std::unique_ptr<EmbeddingTable>>
+EmbeddingTable::CreateFromModel(const litert::Model& model) {
+  RET_CHECK_EQ(model.NumSubgraphs(), 1)
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "Only embedding models of a single subgraph are read in place.";
+  LITERT_ASSIGN_OR_RETURN(auto subgraph, model.MainSubgraph());
+  std::optional<litert::Tensor> table;
+  for (const auto& op : subgraph.Ops()) {
+    const auto inputs = op.Inputs();
+    std::optional<litert::Tensor> op_table;
+    switch (op.Code()) {
+      case kLiteRtOpCodeTflReshape:
+      // Dequantizes the gathered rows with the parameters of the table.
+      case kLiteRtOpCodeTflDequantize:
+        continue;
+      case kLiteRtOpCodeTflGather:
+        // GATHER(params, indices), with the rows gathered along axis 0.
+        op_table = inputs[0];
+        break;
+      case kLiteRtOpCodeTflEmbeddingLookup:
+        // EMBEDDING_LOOKUP(ids, values).
+        op_table = inputs[1];
+        break;
+      default:
+        return absl::UnimplementedError(
+            "The embedding model does more than gathering rows.");
+    }
+    RET_CHECK(!table.has_value()).SetCode(absl::StatusCode::kUnimplemented)
+        << "The embedding model gathers from more than one table.";
+    table = std::move(op_table);
+  }
+  RET_CHECK(table.has_value() && table->HasWeights())
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "The embedding model does not gather from a constant table.";
+
+  LITERT_ASSIGN_OR_RETURN(auto table_type, table->RankedTensorType());
+  const auto dims = table_type.Layout().Dimensions();
+  RET_CHECK_GE(dims.size(), 2).SetCode(absl::StatusCode::kUnimplemented)
+      << "The embedding table must have at least 2 dimensions.";
+  int row_size = 1;
+  for (size_t i = 1; i < dims.size(); ++i) {
+    row_size *= dims[i];
+  }
+  const int num_rows = dims[0];
+
+  DataType data_type;
+  switch (table_type.ElementType()) {
+    case litert::ElementType::Float32:
+      data_type = DataType::kFloat32;
+      break;
+    case litert::ElementType::Int8:
+      data_type = DataType::kInt8;
+      break;
+    case litert::ElementType::Int4:
+      data_type = DataType::kInt4;
+      break;
+    default:
+      return absl::UnimplementedError(
+          "The embedding table must be float32, int8 or int4.");
+  }
+  std::vector<float> scales;
+  std::vector<int> zero_points;
+  if (data_type != DataType::kFloat32) {
+    RET_CHECK(table->HasQuantization())
+            .SetCode(absl::StatusCode::kUnimplemented)
+        << "The quantized embedding table has no quantization parameters.";
+    if (table->QTypeId() == kLiteRtQuantizationPerTensor) {
+      const auto quantization = table->PerTensorQuantization();
+      scales.push_back(quantization.scale);
+      zero_points.push_back(quantization.zero_point);
+    } else if (table->QTypeId() == kLiteRtQuantizationPerChannel) {
+      const auto quantization = table->PerChannelQuantization();
+      RET_CHECK_EQ(quantization.quantized_dimension, 0)
+              .SetCode(absl::StatusCode::kUnimplemented)
+          << "The embedding table must be quantized per row.";
+      scales.assign(quantization.scales,
+                    quantization.scales + quantization.num_channels);
+      zero_points.assign(quantization.zero_points,
+                         quantization.zero_points + quantization.num_channels);
+    } else {
+      return absl::UnimplementedError(
+          "The embedding table must be quantized per tensor or per row.");
+    }
+  }
+  return Create(table->Weights().Bytes(), data_type, num_rows, row_size,
+                std::move(scales), std::move(zero_points));
+}
+
+size_t EmbeddingTable::GetRowSizeInBytes() const {
+  switch (data_type_) {
+    case DataType::kFloat32:
+      return row_size_ * sizeof(float);
+    case DataType::kInt8:
+      return row_size_;
+    case DataType::kInt4:
+      return (row_size_ + 1) / 2;
+  }
+  return row_size_;
+}
+
+absl::Status EmbeddingTable::LookupRow(int token,
+                                       absl::Span<float> output) const {
+  RET_CHECK(token >= 0 && token < num_rows_)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Token " << token << " is out of the range of the " << num_rows_
+      << " rows of the embedding table.";
+  RET_CHECK_EQ(static_cast<int>(output.size()), row_size_)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The output must hold a row of the embedding table.";
+  const size_t row_start = static_cast<size_t>(token) * row_size_;
+  if (data_type_ == DataType::kFloat32) {
+    memcpy(output.data(), data_.data() + row_start * sizeof(float),
+           row_size_ * sizeof(float));
+    return absl::OkStatus();
+  }
+
+  const int param_index = scales_.size() == 1 ? 0 : token;
+  const float scale = scales_[param_index];
+  const int zero_point = zero_points_[param_index];
+  if (data_type_ == DataType::kInt8) {
+    DequantizeInt8(absl::MakeConstSpan(
+                       reinterpret_cast<const int8_t*>(data_.data()) +
+                           row_start,
+                       row_size_),
+                   scale, zero_point, output.data());
+    return absl::OkStatus();
+  }
+
+  // The int4 values are sign extended to int8 in chunks, which then go
+  // through the int8 kernel.
+  int8_t unpacked[kInt4ChunkSize];
+  for (int start = 0; start < row_size_; start += kInt4ChunkSize) {
+    const int num_values = std::min(kInt4ChunkSize, row_size_ - start);
+    for (int i = 0; i < num_values; ++i) {
+      const size_t index = row_start + start + i;
+      const uint8_t byte = data_[index / 2];
+      const uint8_t nibble = index % 2 == 0 ? byte & 0x0f : byte >> 4;
+      unpacked[i] = static_cast<int8_t>(nibble << 4) >> 4;
+    }
+    DequantizeInt8(absl::MakeConstSpan(unpacked, num_values), scale,
+                   zero_point, output.data() + start);
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
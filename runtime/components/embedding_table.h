@@ -0,0 +1,86 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_EMBEDDING_TABLE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_EMBEDDING_TABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_model.h"  // from @litert
+
+namespace litert::lm {
+
+// An embedding table read in place, e.g. from the memory mapped weights of a
+// model, with one row of `row_size` values per token. Quantized rows are
+// dequantized to float on lookup, with NEON or AVX2 kernels when available.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto table, EmbeddingTable::CreateFromModel(model));
+//   std::vector<float> embedding(table->GetRowSize());
+//   RETURN_IF_ERROR(table->LookupRow(token, absl::MakeSpan(embedding)));
+class EmbeddingTable {
+ public:
+  enum class DataType {
+    kFloat32,
+    kInt8,
+    // Two signed values per byte, the first one in the low nibble.
+    kInt4,
+  };
+
+  // Creates a table over `data`, which must outlive the table.
+  // - scales, zero_points: The quantization parameters of the int8 and int4
+  //   tables, either one per row or a single one for the whole table. Ignored
+  //   for float32 tables.
+  static absl::StatusOr<std::unique_ptr<EmbeddingTable>> Create(
+      absl::Span<const uint8_t> data, DataType data_type, int num_rows,
+      int row_size, std::vector<float> scales, std::vector<int> zero_points);
+
+  // Creates a table over the weights of `model`, if its only signature just
+  // gathers rows of a constant table, i.e. it is made of a single GATHER or
+  // EMBEDDING_LOOKUP op on a constant, besides RESHAPE and DEQUANTIZE ops.
+  // The weights are not copied, so `model` must outlive the table. Returns an
+  // error otherwise, in which case the model has to be run instead.
+  static absl::StatusOr<std::unique_ptr<EmbeddingTable>> CreateFromModel(
+      const litert::Model& model);
+
+  // Writes the dequantized row of `token` to `output`, which must hold
+  // GetRowSize() floats.
+  absl::Status LookupRow(int token, absl::Span<float> output) const;
+
+  int GetNumRows() const { return num_rows_; }
+  int GetRowSize() const { return row_size_; }
+  // Returns the number of bytes a row takes in the table data.
+  size_t GetRowSizeInBytes() const;
+
+ private:
+  EmbeddingTable(absl::Span<const uint8_t> data, DataType data_type,
+                 int num_rows, int row_size, std::vector<float> scales,
+                 std::vector<int> zero_points)
+      : data_(data),
+        data_type_(data_type),
+        num_rows_(num_rows),
+        row_size_(row_size),
+        scales_(std::move(scales)),
+        zero_points_(std::move(zero_points)) {}
+
+  absl::Span<const uint8_t> data_;
+  DataType data_type_;
+  int num_rows_;
+  int row_size_;
+  std::vector<float> scales_;
+  std::vector<int> zero_points_;
+};
+
+// Dequantizes `input.size()` int8 values to `output` as
+// (input - zero_point) * scale.
+void DequantizeInt8(absl::Span<const int8_t> input, float scale,
+                    int zero_point, float* output);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_EMBEDDING_TABLE_H_
@@ -0,0 +1,115 @@
+#include "runtime/components/embedding_table.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::status::StatusIs;
+
+absl::Span<const uint8_t> AsBytes(const std::vector<float>& values) {
+  return absl::MakeConstSpan(reinterpret_cast<const uint8_t*>(values.data()),
+                             values.size() * sizeof(float));
+}
+
+absl::Span<const uint8_t> AsBytes(const std::vector<int8_t>& values) {
+  return absl::MakeConstSpan(reinterpret_cast<const uint8_t*>(values.data()),
+                             values.size());
+}
+
+TEST(EmbeddingTableTest, LookupFloat32Row) {
+  const std::vector<float> data = {0.0f, 0.5f, 1.0f, 1.5f, 2.0f, 2.5f};
+  ASSERT_OK_AND_ASSIGN(
+      auto table, EmbeddingTable::Create(AsBytes(data),
+                                         EmbeddingTable::DataType::kFloat32,
+                                         /*num_rows=*/3, /*row_size=*/2,
+                                         /*scales=*/{}, /*zero_points=*/{}));
+  std::vector<float> row(2);
+  ASSERT_OK(table->LookupRow(2, absl::MakeSpan(row)));
+  EXPECT_THAT(row, ElementsAre(2.0f, 2.5f));
+}
+
+TEST(EmbeddingTableTest, LookupInt8RowWithPerRowScales) {
+  // Rows of 19 values cover both the vector kernels and their tail.
+  constexpr int kRowSize = 19;
+  std::vector<int8_t> data(2 * kRowSize);
+  std::vector<float> expected_row(kRowSize);
+  for (int i = 0; i < kRowSize; ++i) {
+    data[i] = i;
+    data[kRowSize + i] = i - 9;
+    expected_row[i] = (i - 9 - 1) * 0.5f;
+  }
+  ASSERT_OK_AND_ASSIGN(
+      auto table,
+      EmbeddingTable::Create(AsBytes(data), EmbeddingTable::DataType::kInt8,
+                             /*num_rows=*/2, kRowSize,
+                             /*scales=*/{0.25f, 0.5f},
+                             /*zero_points=*/{0, 1}));
+  std::vector<float> row(kRowSize);
+  ASSERT_OK(table->LookupRow(1, absl::MakeSpan(row)));
+  EXPECT_THAT(row, ElementsAreArray(expected_row));
+}
+
+TEST(EmbeddingTableTest, LookupInt4RowWithPerTensorScale) {
+  // The rows {1, -2, 3} and {-8, 7, 0}, of odd size so that the second row
+  // starts in the high nibble of a byte.
+  const std::vector<uint8_t> data = {0xe1, 0x83, 0x07};
+  ASSERT_OK_AND_ASSIGN(
+      auto table,
+      EmbeddingTable::Create(data, EmbeddingTable::DataType::kInt4,
+                             /*num_rows=*/2, /*row_size=*/3,
+                             /*scales=*/{2.0f}, /*zero_points=*/{}));
+  std::vector<float> row(3);
+  ASSERT_OK(table->LookupRow(0, absl::MakeSpan(row)));
+  EXPECT_THAT(row, ElementsAre(2.0f, -4.0f, 6.0f));
+  ASSERT_OK(table->LookupRow(1, absl::MakeSpan(row)));
+  EXPECT_THAT(row, ElementsAre(-16.0f, 14.0f, 0.0f));
+}
+
+TEST(EmbeddingTableTest, LookupRejectsOutOfRangeToken) {
+  const std::vector<float> data = {0.0f, 1.0f};
+  ASSERT_OK_AND_ASSIGN(
+      auto table, EmbeddingTable::Create(AsBytes(data),
+                                         EmbeddingTable::DataType::kFloat32,
+                                         /*num_rows=*/2, /*row_size=*/1,
+                                         /*scales=*/{}, /*zero_points=*/{}));
+  std::vector<float> row(1);
+  EXPECT_THAT(table->LookupRow(2, absl::MakeSpan(row)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(table->LookupRow(-1, absl::MakeSpan(row)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(EmbeddingTableTest, CreateRejectsShortData) {
+  const std::vector<int8_t> data(5);
+  EXPECT_THAT(
+      EmbeddingTable::Create(AsBytes(data), EmbeddingTable::DataType::kInt8,
+                             /*num_rows=*/2, /*row_size=*/3,
+                             /*scales=*/{1.0f}, /*zero_points=*/{}),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(EmbeddingTableTest, DequantizeInt8MatchesScalarArithmetic) {
+  constexpr int kNumValues = 37;
+  std::vector<int8_t> input(kNumValues);
+  for (int i = 0; i < kNumValues; ++i) {
+    input[i] = static_cast<int8_t>(i * 7 - 128);
+  }
+  std::vector<float> output(input.size());
+  DequantizeInt8(input, /*scale=*/0.1f, /*zero_point=*/-3, output.data());
+  for (int i = 0; i < kNumValues; ++i) {
+    EXPECT_EQ(output[i], static_cast<float>(input[i] + 3) * 0.1f);
+  }
+}
+
+}  // namespace
+}  // namespace litert::lm
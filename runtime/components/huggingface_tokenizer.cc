@@ -1,9 +1,9 @@
 #include "runtime/components/huggingface_tokenizer.h"
 
-#include <cstring>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
-#include <utility>
 #include <vector>
 
 #include "absl/debugging/leak_check.h"  // from @com_google_absl
@@ -11,9 +11,12 @@
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/tokenizer.h"
 #include "runtime/util/memory_mapped_file.h"
 #include "runtime/util/status_macros.h"  // NOLINT
-#include "include/tokenizers_cpp.h"  // from @tokenizers_cpp
+#include "include/tokenizers_c.h"  // from @tokenizers_cpp
 
 namespace litert::lm {
 
@@ -25,58 +28,189 @@ const char kReplacementCharacter[] = "\xef\xbf\xbd";
 // Checks if the decoded string ends with the replacement character, which
 // indicates that the set of token IDs passed to the tokenizer is part of a BPE
 // sequence and needs more tokens to be decoded.
-static bool has_bpe_suffix(const std::string& decoded) {
+static bool has_bpe_suffix(absl::string_view decoded) {
   return decoded.ends_with(kReplacementCharacter);
 }
 
+static absl::Status IncompleteBpeSequenceError() {
+  return absl::DataLossError(
+      "The set of token IDs passed to the tokenizer is part of a BPE "
+      "sequence and needs more tokens to be decoded.");
+}
+
+// Decodes a window of the recent tokens, such that each token is decoded a
+// bounded number of times, as for the DecodeStream of HuggingFace. The text of
+// the tokens before `read_offset_` was already returned, and is decoded again
+// for the context of the following tokens, e.g. the spaces between words.
+// It is decoded once per window, and the texts are decoded into buffers kept
+// across the tokens.
+class HuggingFaceTokenizer::Detokenizer : public StreamingDetokenizer {
+ public:
+  explicit Detokenizer(HuggingFaceTokenizer& tokenizer)
+      : tokenizer_(tokenizer) {}
+
+  absl::StatusOr<std::string> Add(int token_id) override {
+    // See TokenIdsToText() for the leak check.
+    absl::LeakCheckDisabler disabler;
+    token_ids_.push_back(token_id);
+    {
+      absl::MutexLock lock(&tokenizer_.decode_mutex_);
+      if (!read_text_is_decoded_) {
+        read_text_.clear();
+        tokenizer_.AppendDecodedText(
+            absl::MakeConstSpan(token_ids_).first(read_offset_), read_text_);
+        read_text_is_decoded_ = true;
+      }
+      text_.clear();
+      tokenizer_.AppendDecodedText(token_ids_, text_);
+    }
+    if (text_.size() <= read_text_.size() || has_bpe_suffix(text_)) {
+      return "";
+    }
+    std::string text = text_.substr(read_text_.size());
+    token_ids_.erase(token_ids_.begin(), token_ids_.begin() + read_offset_);
+    read_offset_ = token_ids_.size();
+    read_text_is_decoded_ = false;
+    return text;
+  }
+
+ private:
+  HuggingFaceTokenizer& tokenizer_;
+  // The tokens of the window, the ones past `read_offset_` being pending.
+  std::vector<int> token_ids_;
+  size_t read_offset_ = 0;
+  // The text of the tokens before `read_offset_`, and of all the tokens.
+  std::string read_text_;
+  bool read_text_is_decoded_ = false;
+  std::string text_;
+};
+
+HuggingFaceTokenizer::~HuggingFaceTokenizer() {
+  absl::LeakCheckDisabler disabler;
+  tokenizers_free(handle_);
+}
+
 absl::StatusOr<std::unique_ptr<HuggingFaceTokenizer>>
 HuggingFaceTokenizer::CreateFromFile(absl::string_view json_path) {
   ASSIGN_OR_RETURN(auto memory_mapped_file,  // NOLINT
                    MemoryMappedFile::Create(json_path));
-  std::string json_data(memory_mapped_file->length(), '\0');
-  memcpy(json_data.data(), memory_mapped_file->data(),
-         memory_mapped_file->length());
-  return CreateFromJson(json_data);
+  return CreateFromJson(
+      absl::string_view(static_cast<const char*>(memory_mapped_file->data()),
+                        memory_mapped_file->length()));
 }
 
 absl::StatusOr<std::unique_ptr<HuggingFaceTokenizer>>
-HuggingFaceTokenizer::CreateFromJson(std::string json) {
-  auto tokenizer = tokenizers::Tokenizer::FromBlobJSON(json);
-  if (!tokenizer) {
+HuggingFaceTokenizer::CreateFromJson(absl::string_view json) {
+  absl::LeakCheckDisabler disabler;
+  TokenizerHandle handle = tokenizers_new_from_str(json.data(), json.size());
+  if (handle == nullptr) {
     return absl::InvalidArgumentError("Failed to create tokenizer from JSON.");
   }
-  return absl::WrapUnique(new HuggingFaceTokenizer(std::move(tokenizer)));
+  return absl::WrapUnique(new HuggingFaceTokenizer(handle));
 }
 
 // Encodes the given text into a TensorBuffer of token ids.
 absl::StatusOr<std::vector<int>> HuggingFaceTokenizer::TextToTokenIds(
     absl::string_view text) {
+  std::vector<int> token_ids;
+  RETURN_IF_ERROR(AppendTokenIds(text, token_ids));
+  return token_ids;
+}
+
+absl::Status HuggingFaceTokenizer::AppendTokenIds(absl::string_view text,
+                                                  std::vector<int>& token_ids) {
+  // Disable leak check as Google's default leak checker does not properly
+  // support Rust's lazy_static initialization.
+  // TODO(b/379364190) - Remove this once the leak checker is fixed.
+  absl::LeakCheckDisabler disabler;
+  // The encoding is returned in a buffer of its own, so it does not need the
+  // decode lock.
+  TokenizerEncodeResult result;
+  tokenizers_encode(handle_, text.data(), text.size(),
+                    /*add_special_token=*/0, &result);
+  token_ids.insert(token_ids.end(), result.token_ids,
+                   result.token_ids + result.len);
+  tokenizers_free_encode_results(&result, /*num_seqs=*/1);
+  return absl::OkStatus();
+}
+
+void HuggingFaceTokenizer::AppendDecodedText(absl::Span<const int> token_ids,
+                                             std::string& text) {
+  tokenizers_decode(handle_,
+                    reinterpret_cast<const uint32_t*>(token_ids.data()),
+                    token_ids.size(), /*skip_special_token=*/0);
+  const char* data = nullptr;
+  size_t size = 0;
+  tokenizers_get_decode_str(handle_, &data, &size);
+  text.append(data, size);
+}
+
+absl::Status HuggingFaceTokenizer::AppendText(absl::Span<const int> token_ids,
+                                              std::string& text) {
+  // See AppendTokenIds() for the leak check.
+  absl::LeakCheckDisabler disabler;
+  const size_t size = text.size();
   {
-    // Disable leak check as Google's default leak checker does not properly
-    // support Rust's lazy_static initialization.
-    // TODO(b/379364190) - Remove this once the leak checker is fixed.
-    absl::LeakCheckDisabler disabler;
-    return tokenizer_->Encode(std::string{text});
+    absl::MutexLock lock(&decode_mutex_);
+    AppendDecodedText(token_ids, text);
+  }
+  if (has_bpe_suffix(absl::string_view(text).substr(size))) {
+    text.resize(size);
+    return IncompleteBpeSequenceError();
   }
+  return absl::OkStatus();
 }
 
 // Decodes the given TensorBuffer of token ids into a vector of strings.
 absl::StatusOr<std::string> HuggingFaceTokenizer::TokenIdsToText(
     const std::vector<int>& token_ids) {
-  {
-    absl::LeakCheckDisabler disabler;
-    // Disable leak check as Google's default leak checker does not properly
-    // support Rust's lazy_static initialization.
-    // TODO(b/379364190) - Remove this once the leak checker is fixed.
-    std::string decoded = tokenizer_->Decode(token_ids);
-    if (has_bpe_suffix(decoded)) {
-      return absl::DataLossError(
-          "The set of token IDs passed to the tokenizer is part of a BPE "
-          "sequence and needs more tokens to be decoded.");
-    } else {
-      return decoded;
+  std::string text;
+  RETURN_IF_ERROR(AppendText(token_ids, text));
+  return text;
+}
+
+absl::StatusOr<std::vector<std::string>> HuggingFaceTokenizer::TokenIdsToTexts(
+    int batch_size, const std::vector<TokenIds>& token_ids) {
+  if (token_ids.size() != batch_size) {
+    return absl::InvalidArgumentError(
+        "The token ID vector must have the same number of rows as the batch "
+        "size.");
+  }
+  // See AppendTokenIds() for the leak check.
+  absl::LeakCheckDisabler disabler;
+  std::vector<std::string> texts(batch_size);
+  absl::MutexLock lock(&decode_mutex_);
+  for (int i = 0; i < batch_size; ++i) {
+    AppendDecodedText(token_ids[i], texts[i]);
+    if (has_bpe_suffix(texts[i])) {
+      return IncompleteBpeSequenceError();
+    }
+  }
+  return texts;
+}
+
+std::unique_ptr<StreamingDetokenizer>
+HuggingFaceTokenizer::CreateStreamingDetokenizer() {
+  return std::make_unique<Detokenizer>(*this);
+}
+
+absl::StatusOr<std::vector<std::string>>
+HuggingFaceTokenizer::GetTokenTexts() {
+  // See AppendTokenIds() for the leak check.
+  absl::LeakCheckDisabler disabler;
+  size_t vocab_size = 0;
+  tokenizers_get_vocab_size(handle_, &vocab_size);
+  std::vector<std::string> token_texts(vocab_size);
+  std::string decoded;
+  absl::MutexLock lock(&decode_mutex_);
+  for (int id = 0; id < token_texts.size(); ++id) {
+    decoded.clear();
+    AppendDecodedText(absl::MakeConstSpan(&id, 1), decoded);
+    if (decoded.find(kReplacementCharacter) == std::string::npos) {
+      token_texts[id] = decoded;
     }
   }
+  return token_texts;
 }
 
 }  // namespace litert::lm
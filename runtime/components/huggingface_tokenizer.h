@@ -3,26 +3,34 @@
 
 #include <memory>
 #include <string>
-#include <utility>
 #include <vector>
 
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "runtime/components/tokenizer.h"
-#include "include/tokenizers_cpp.h"  // from @tokenizers_cpp
 
 namespace litert::lm {
 
-// A Tokenizer implementation using HuggingFace.
+// A Tokenizer implementation using HuggingFace, through the C API of
+// tokenizers-cpp, which takes the texts and token ids as pointers and sizes
+// and lends the decoded text, such that they are not copied into temporary
+// strings and vectors on the way.
 class HuggingFaceTokenizer : public Tokenizer {
  public:
+  ~HuggingFaceTokenizer() override;
+
   // Creates a HuggingFaceTokenizer from the JSON file
   static absl::StatusOr<std::unique_ptr<HuggingFaceTokenizer>> CreateFromFile(
       absl::string_view json_path);
 
-  // Creates a HuggingFaceTokenizer from a JSON string.
+  // Creates a HuggingFaceTokenizer from a JSON string, which is parsed in
+  // place and not kept.
   static absl::StatusOr<std::unique_ptr<HuggingFaceTokenizer>> CreateFromJson(
-      std::string json);
+      absl::string_view json);
 
   // Encodes the given text into a sequence of token ids.
   absl::StatusOr<std::vector<int>> TextToTokenIds(
@@ -34,14 +42,43 @@ class HuggingFaceTokenizer : public Tokenizer {
   absl::StatusOr<std::string> TokenIdsToText(
       const std::vector<int>& token_ids) override;
 
+  // Decodes each row of token ids with a single lock of the decoder.
+  absl::StatusOr<std::vector<std::string>> TokenIdsToTexts(
+      int batch_size, const std::vector<TokenIds>& token_ids) override;
+
+  // Appends the token ids of `text` to `token_ids`, such that a buffer reused
+  // across the calls keeps its capacity.
+  absl::Status AppendTokenIds(absl::string_view text,
+                              std::vector<int>& token_ids);
+
+  // Appends the text of `token_ids` to `text`. Returns absl::DataLossError,
+  // and leaves `text` as is, if any of the tokens are part of an incomplete
+  // BPE sequence.
+  absl::Status AppendText(absl::Span<const int> token_ids, std::string& text)
+      ABSL_LOCKS_EXCLUDED(decode_mutex_);
+
+  // Creates a detokenizer decoding a window of the last tokens, which ends
+  // past the tokens whose text is complete.
+  std::unique_ptr<StreamingDetokenizer> CreateStreamingDetokenizer() override;
+
+  // Returns the decoded text of each token on its own. The tokens holding a
+  // part of a multi-byte character are left empty.
+  absl::StatusOr<std::vector<std::string>> GetTokenTexts() override;
+
  private:
-  // Constructor.
-  explicit HuggingFaceTokenizer(
-      std::unique_ptr<tokenizers::Tokenizer> tokenizer)
-      : tokenizer_(std::move(tokenizer)) {};
+  class Detokenizer;
+
+  // Takes the TokenizerHandle of tokenizers-cpp.
+  explicit HuggingFaceTokenizer(void* handle) : handle_(handle) {}
+
+  // Appends the text of `token_ids` to `text`, as decoded. The handle keeps
+  // the decoded text until the next decode, hence the lock.
+  void AppendDecodedText(absl::Span<const int> token_ids, std::string& text)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(decode_mutex_);
 
-  // HuggingFace processor.
-  std::unique_ptr<tokenizers::Tokenizer> tokenizer_;
+  // The TokenizerHandle of tokenizers-cpp, owned.
+  void* const handle_;
+  absl::Mutex decode_mutex_;
 };
 
 }  // namespace litert::lm
@@ -86,5 +86,51 @@ TEST(HuggingFaceTokenizerTest, TokenIdsToText) {
   EXPECT_EQ(text_or.value(), "How's it going?");
 }
 
+TEST(HuggingFaceTokenizerTest, AppendTokenIds) {
+  ASSERT_OK_AND_ASSIGN(
+      auto tokenizer,
+      HuggingFaceTokenizer::CreateFromFile(GetHuggingFaceModelPath()));
+
+  std::vector<int> ids = {1};
+  ASSERT_OK(tokenizer->AppendTokenIds("How's it going?", ids));
+  EXPECT_THAT(ids, ::testing::ElementsAre(1, 2020, 506, 357, 2045, 47));
+}
+
+TEST(HuggingFaceTokenizerTest, AppendText) {
+  ASSERT_OK_AND_ASSIGN(
+      auto tokenizer,
+      HuggingFaceTokenizer::CreateFromFile(GetHuggingFaceModelPath()));
+
+  std::string text = "Q: ";
+  ASSERT_OK(tokenizer->AppendText({2020, 506, 357, 2045, 47}, text));
+  EXPECT_EQ(text, "Q: How's it going?");
+}
+
+TEST(HuggingFaceTokenizerTest, TokenIdsToTexts) {
+  ASSERT_OK_AND_ASSIGN(
+      auto tokenizer,
+      HuggingFaceTokenizer::CreateFromFile(GetHuggingFaceModelPath()));
+
+  ASSERT_OK_AND_ASSIGN(
+      auto texts,
+      tokenizer->TokenIdsToTexts(2, {{2020, 506, 357, 2045, 47}, {}}));
+  EXPECT_THAT(texts, ::testing::ElementsAre("How's it going?", ""));
+  EXPECT_FALSE(tokenizer->TokenIdsToTexts(1, {}).ok());
+}
+
+TEST(HuggingFaceTokenizerTest, StreamingDetokenizer) {
+  auto tokenizer_or =
+      HuggingFaceTokenizer::CreateFromFile(GetHuggingFaceModelPath());
+  ASSERT_OK(tokenizer_or);
+  auto detokenizer = tokenizer_or.value()->CreateStreamingDetokenizer();
+
+  std::string text;
+  for (int id : {2020, 506, 357, 2045, 47}) {
+    ASSERT_OK_AND_ASSIGN(std::string piece, detokenizer->Add(id));
+    text += piece;
+  }
+  EXPECT_EQ(text, "How's it going?");
+}
+
 }  // namespace
 }  // namespace litert::lm
@@ -0,0 +1,244 @@
+#include "runtime/components/image_preprocessor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_element_type.h"  // from @litert
+#include "litert/cc/litert_layout.h"  // from @litert
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/litert_status_util.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// The two source pixels an output pixel is interpolated from along an axis,
+// and the weight of the second one.
+struct Tap {
+  int low;
+  int high;
+  float weight;
+};
+
+// Maps the `output_size` pixels of an axis to the [crop_begin, crop_begin +
+// crop_size) pixels of the source, with the pixel centers aligned.
+std::vector<Tap> ComputeTaps(int crop_begin, int crop_size, int output_size) {
+  std::vector<Tap> taps(output_size);
+  const float ratio = static_cast<float>(crop_size) / output_size;
+  const int last = crop_begin + crop_size - 1;
+  for (int i = 0; i < output_size; ++i) {
+    const float position = std::clamp(
+        (i + 0.5f) * ratio - 0.5f + crop_begin, static_cast<float>(crop_begin),
+        static_cast<float>(last));
+    const int low = static_cast<int>(position);
+    taps[i] = {.low = low,
+               .high = std::min(low + 1, last),
+               .weight = position - low};
+  }
+  return taps;
+}
+
+// Interpolates the source row `source_row` along the width into `row`, which
+// holds the first `channels` channels of each output pixel.
+void ResizeRow(const uint8_t* source_row, int source_channels,
+               absl::Span<const Tap> taps, int channels, float* row) {
+  for (const Tap& tap : taps) {
+    const uint8_t* low = source_row + tap.low * source_channels;
+    const uint8_t* high = source_row + tap.high * source_channels;
+    for (int c = 0; c < channels; ++c) {
+      *row++ = low[c] + (high[c] - low[c]) * tap.weight;
+    }
+  }
+}
+
+// Interpolates between the resized rows `top` and `bottom`, and normalizes
+// the result: output = (top + (bottom - top) * weight) * scale + bias.
+void BlendAndNormalize(const float* top, const float* bottom, float weight,
+                       const float* scale, const float* bias, size_t size,
+                       float* output) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  const __m256 weight_v = _mm256_set1_ps(weight);
+  for (; i + 8 <= size; i += 8) {
+    const __m256 top_v = _mm256_loadu_ps(top + i);
+    const __m256 bottom_v = _mm256_loadu_ps(bottom + i);
+    const __m256 value = _mm256_add_ps(
+        top_v, _mm256_mul_ps(_mm256_sub_ps(bottom_v, top_v), weight_v));
+    _mm256_storeu_ps(output + i,
+                     _mm256_add_ps(_mm256_mul_ps(value,
+                                                 _mm256_loadu_ps(scale + i)),
+                                   _mm256_loadu_ps(bias + i)));
+  }
+#elif defined(__ARM_NEON)
+  const float32x4_t weight_v = vdupq_n_f32(weight);
+  for (; i + 4 <= size; i += 4) {
+    const float32x4_t top_v = vld1q_f32(top + i);
+    const float32x4_t bottom_v = vld1q_f32(bottom + i);
+    const float32x4_t value =
+        vmlaq_f32(top_v, vsubq_f32(bottom_v, top_v), weight_v);
+    vst1q_f32(output + i,
+              vmlaq_f32(vld1q_f32(bias + i), value, vld1q_f32(scale + i)));
+  }
+#endif
+  for (; i < size; ++i) {
+    const float value = top[i] + (bottom[i] - top[i]) * weight;
+    output[i] = value * scale[i] + bias[i];
+  }
+}
+
+}  // namespace
+
+absl::Status PreprocessImage(const ImageView& image,
+                             const ImagePreprocessOptions& options,
+                             int output_height, int output_width,
+                             int output_channels, absl::Span<float> output) {
+  RET_CHECK(image.height > 0 && image.width > 0 && image.channels > 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Invalid image of " << image.height << "x" << image.width << "x"
+      << image.channels << " pixels.";
+  RET_CHECK_GE(image.pixels.size(), static_cast<size_t>(image.height) *
+                                        image.width * image.channels)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The image pixels are truncated.";
+  RET_CHECK(output_height > 0 && output_width > 0 && output_channels > 0 &&
+            output_channels <= image.channels)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Cannot preprocess an image of " << image.channels
+      << " channels into " << output_height << "x" << output_width << "x"
+      << output_channels << " values.";
+  const size_t row_size = static_cast<size_t>(output_width) * output_channels;
+  RET_CHECK_EQ(output.size(), row_size * output_height)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The output must hold the preprocessed image.";
+  for (const std::vector<float>* values : {&options.mean, &options.stddev}) {
+    RET_CHECK(values->size() == 1 ||
+              values->size() == static_cast<size_t>(output_channels))
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Expected 1 or " << output_channels
+        << " normalization values, but got " << values->size() << ".";
+  }
+
+  // The scale and bias of each value of an output row, such that the kernel
+  // does not go through the channels.
+  std::vector<float> scale(row_size);
+  std::vector<float> bias(row_size);
+  for (int c = 0; c < output_channels; ++c) {
+    const float mean = options.mean[options.mean.size() == 1 ? 0 : c];
+    const float stddev = options.stddev[options.stddev.size() == 1 ? 0 : c];
+    RET_CHECK_NE(stddev, 0.0f).SetCode(absl::StatusCode::kInvalidArgument)
+        << "The normalization stddev must not be 0.";
+    for (size_t i = c; i < row_size; i += output_channels) {
+      scale[i] = 1.0f / (255.0f * stddev);
+      bias[i] = -mean / stddev;
+    }
+  }
+
+  int crop_top = 0;
+  int crop_left = 0;
+  int crop_height = image.height;
+  int crop_width = image.width;
+  if (options.center_crop) {
+    const double output_aspect =
+        static_cast<double>(output_width) / output_height;
+    if (image.width > image.height * output_aspect) {
+      crop_width = std::max(
+          1, static_cast<int>(std::lround(image.height * output_aspect)));
+      crop_left = (image.width - crop_width) / 2;
+    } else {
+      crop_height = std::max(
+          1, static_cast<int>(std::lround(image.width / output_aspect)));
+      crop_top = (image.height - crop_height) / 2;
+    }
+  }
+  const std::vector<Tap> x_taps =
+      ComputeTaps(crop_left, crop_width, output_width);
+  const std::vector<Tap> y_taps =
+      ComputeTaps(crop_top, crop_height, output_height);
+
+  // The source rows resized along the width, kept while the next output row
+  // is interpolated from the same ones, e.g. when upscaling.
+  const size_t source_row_size =
+      static_cast<size_t>(image.width) * image.channels;
+  auto resize_row = [&](int y, std::vector<float>& row) {
+    ResizeRow(image.pixels.data() + y * source_row_size, image.channels,
+              x_taps, output_channels, row.data());
+  };
+  std::vector<float> rows[2] = {std::vector<float>(row_size),
+                                std::vector<float>(row_size)};
+  int row_ys[2] = {-1, -1};
+  for (int y = 0; y < output_height; ++y) {
+    const Tap& tap = y_taps[y];
+    if (row_ys[0] != tap.low) {
+      if (row_ys[1] == tap.low) {
+        std::swap(rows[0], rows[1]);
+        std::swap(row_ys[0], row_ys[1]);
+      } else {
+        resize_row(tap.low, rows[0]);
+        row_ys[0] = tap.low;
+      }
+    }
+    if (row_ys[1] != tap.high) {
+      resize_row(tap.high, rows[1]);
+      row_ys[1] = tap.high;
+    }
+    BlendAndNormalize(rows[0].data(), rows[1].data(), tap.weight, scale.data(),
+                      bias.data(), row_size, output.data() + y * row_size);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status PreprocessImageIntoTensorBuffer(
+    const ImageView& image, const ImagePreprocessOptions& options,
+    ::litert::TensorBuffer& tensor_buffer) {
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, tensor_buffer.TensorType());
+  RET_CHECK(tensor_type.ElementType() == ::litert::ElementType::Float32)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The encoder input must be float32.";
+  const auto layout = tensor_type.Layout();
+  const auto dimensions = layout.Dimensions();
+  RET_CHECK(dimensions.size() == 4 && dimensions[0] == 1)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The encoder input must be of dimensions [1, height, width, "
+         "channels].";
+  LITERT_ASSIGN_OR_RETURN_ABSL(
+      auto lock_and_addr,
+      ::litert::TensorBufferScopedLock::Create(
+          tensor_buffer, ::litert::TensorBuffer::LockMode::kWrite));
+  const size_t size =
+      static_cast<size_t>(dimensions[1]) * dimensions[2] * dimensions[3];
+  return PreprocessImage(
+      image, options, dimensions[1], dimensions[2], dimensions[3],
+      absl::MakeSpan(static_cast<float*>(lock_and_addr.second), size));
+}
+
+absl::StatusOr<::litert::TensorBuffer> PreprocessImageForEncoder(
+    const ImageView& image, const ImagePreprocessOptions& options,
+    absl::Span<const int> input_dimension) {
+  RET_CHECK_EQ(input_dimension.size(), 4)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The encoder input must be of dimensions [1, height, width, "
+         "channels].";
+  LITERT_ASSIGN_OR_RETURN_ABSL(
+      auto tensor_buffer,
+      CreateTensorBuffer<float>(::litert::Dimensions(input_dimension.begin(),
+                                                     input_dimension.end())));
+  RETURN_IF_ERROR(
+      PreprocessImageIntoTensorBuffer(image, options, tensor_buffer));
+  return tensor_buffer;
+}
+
+}  // namespace litert::lm
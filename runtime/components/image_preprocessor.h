@@ -0,0 +1,62 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_IMAGE_PREPROCESSOR_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_IMAGE_PREPROCESSOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+
+namespace litert::lm {
+
+// A decoded image of 8-bit channels, row major with interleaved channels,
+// e.g. RGB or RGBA.
+struct ImageView {
+  absl::Span<const uint8_t> pixels;
+  int height = 0;
+  int width = 0;
+  int channels = 0;
+};
+
+// How an image is turned into the input of a vision encoder.
+struct ImagePreprocessOptions {
+  // Whether the image is center cropped to the aspect ratio of the output
+  // before it is resized, instead of being stretched.
+  bool center_crop = false;
+  // The output values are (pixel / 255 - mean[c]) / stddev[c], with one value
+  // per output channel, or a single one for all of them.
+  std::vector<float> mean = {0.0f};
+  std::vector<float> stddev = {1.0f};
+};
+
+// Resizes `image` to `output_height` x `output_width` with bilinear
+// interpolation, and normalizes it into `output`, which holds the
+// [output_height, output_width, output_channels] floats. The first
+// `output_channels` channels of the image are kept, e.g. the alpha channel of
+// an RGBA image is dropped for an RGB output. The resize, crop and normalize
+// are fused in a single pass over the output, with NEON or AVX2 kernels when
+// available.
+absl::Status PreprocessImage(const ImageView& image,
+                             const ImagePreprocessOptions& options,
+                             int output_height, int output_width,
+                             int output_channels, absl::Span<float> output);
+
+// Same as PreprocessImage(), but straight into `tensor_buffer`, e.g. the input
+// buffer of the encoder, a float32 host buffer of dimensions [1, height,
+// width, channels], which is locked for writing.
+absl::Status PreprocessImageIntoTensorBuffer(
+    const ImageView& image, const ImagePreprocessOptions& options,
+    ::litert::TensorBuffer& tensor_buffer);
+
+// Same as PreprocessImage(), into a new host buffer of `input_dimension`, the
+// [1, height, width, channels] returned by
+// VisionExecutor::GetExpectedInputDimension().
+absl::StatusOr<::litert::TensorBuffer> PreprocessImageForEncoder(
+    const ImageView& image, const ImagePreprocessOptions& options,
+    absl::Span<const int> input_dimension);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_IMAGE_PREPROCESSOR_H_
@@ -0,0 +1,131 @@
+#include "runtime/components/image_preprocessor.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/test/matchers.h"  // from @litert
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::FloatNear;
+using ::testing::Pointwise;
+using ::testing::status::StatusIs;
+
+TEST(ImagePreprocessorTest, NormalizesWithoutResizing) {
+  const std::vector<uint8_t> pixels = {0, 51, 255, 102, 204, 0};
+  ImagePreprocessOptions options;
+  options.mean = {0.5f};
+  options.stddev = {0.5f};
+  std::vector<float> output(6);
+  EXPECT_OK(PreprocessImage(
+      {.pixels = pixels, .height = 1, .width = 2, .channels = 3}, options,
+      /*output_height=*/1, /*output_width=*/2, /*output_channels=*/3,
+      absl::MakeSpan(output)));
+  EXPECT_THAT(output, Pointwise(FloatNear(1e-5),
+                                {-1.0f, -0.6f, 1.0f, -0.2f, 0.6f, -1.0f}));
+}
+
+TEST(ImagePreprocessorTest, DownscalesWithBilinearInterpolation) {
+  // A 2x4 image of 1 channel, downscaled to 1x2: each output pixel is the
+  // average of a 2x2 block.
+  const std::vector<uint8_t> pixels = {0, 10, 20, 30, 40, 50, 60, 70};
+  ImagePreprocessOptions options;
+  options.stddev = {1.0f / 255};
+  std::vector<float> output(2);
+  EXPECT_OK(PreprocessImage(
+      {.pixels = pixels, .height = 2, .width = 4, .channels = 1}, options,
+      /*output_height=*/1, /*output_width=*/2, /*output_channels=*/1,
+      absl::MakeSpan(output)));
+  EXPECT_THAT(output, Pointwise(FloatNear(1e-5), {25.0f, 45.0f}));
+}
+
+TEST(ImagePreprocessorTest, UpscalesEveryRow) {
+  // More than a vector of values per row, with the source rows reused.
+  const std::vector<uint8_t> pixels = {0, 0, 100, 100};
+  ImagePreprocessOptions options;
+  options.stddev = {1.0f / 255};
+  std::vector<float> output(4 * 10);
+  EXPECT_OK(PreprocessImage(
+      {.pixels = pixels, .height = 2, .width = 2, .channels = 1}, options,
+      /*output_height=*/4, /*output_width=*/10, /*output_channels=*/1,
+      absl::MakeSpan(output)));
+  // The rows are at 0, 0.25, 0.75 and 1 of the way down.
+  for (int x = 0; x < 10; ++x) {
+    EXPECT_FLOAT_EQ(output[x], 0.0f);
+    EXPECT_FLOAT_EQ(output[10 + x], 25.0f);
+    EXPECT_FLOAT_EQ(output[20 + x], 75.0f);
+    EXPECT_FLOAT_EQ(output[30 + x], 100.0f);
+  }
+}
+
+TEST(ImagePreprocessorTest, CenterCropsAndDropsAlpha) {
+  // A 1x3 RGBA image, cropped to its middle pixel.
+  const std::vector<uint8_t> pixels = {10, 20, 30, 255, 40, 50, 60, 255,
+                                       70, 80, 90, 255};
+  ImagePreprocessOptions options;
+  options.center_crop = true;
+  options.stddev = {1.0f / 255};
+  std::vector<float> output(3);
+  EXPECT_OK(PreprocessImage(
+      {.pixels = pixels, .height = 1, .width = 3, .channels = 4}, options,
+      /*output_height=*/1, /*output_width=*/1, /*output_channels=*/3,
+      absl::MakeSpan(output)));
+  EXPECT_THAT(output, Pointwise(FloatNear(1e-5), {40.0f, 50.0f, 60.0f}));
+}
+
+TEST(ImagePreprocessorTest, RejectsInvalidArguments) {
+  const std::vector<uint8_t> pixels = {0, 0, 0};
+  const ImageView image = {
+      .pixels = pixels, .height = 1, .width = 1, .channels = 3};
+  std::vector<float> output(3);
+  // Truncated pixels.
+  EXPECT_THAT(PreprocessImage({.pixels = pixels,
+                               .height = 2,
+                               .width = 1,
+                               .channels = 3},
+                              {}, 1, 1, 3, absl::MakeSpan(output)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // More output channels than the image has.
+  std::vector<float> large_output(4);
+  EXPECT_THAT(
+      PreprocessImage(image, {}, 1, 1, 4, absl::MakeSpan(large_output)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  // A wrong output size.
+  EXPECT_THAT(PreprocessImage(image, {}, 1, 2, 3, absl::MakeSpan(output)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // Normalization values of another number of channels.
+  ImagePreprocessOptions options;
+  options.mean = {0.0f, 0.0f};
+  EXPECT_THAT(
+      PreprocessImage(image, options, 1, 1, 3, absl::MakeSpan(output)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ImagePreprocessorTest, WritesTheEncoderInput) {
+  const std::vector<uint8_t> pixels = {0, 255, 255, 0};
+  ImagePreprocessOptions options;
+  ASSERT_OK_AND_ASSIGN(
+      auto tensor_buffer,
+      PreprocessImageForEncoder(
+          {.pixels = pixels, .height = 2, .width = 1, .channels = 2}, options,
+          /*input_dimension=*/{1, 2, 1, 1}));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto values,
+                              CopyFromTensorBuffer<float>(tensor_buffer));
+  EXPECT_THAT(values, ElementsAre(0.0f, 1.0f));
+
+  EXPECT_THAT(PreprocessImageForEncoder(
+                  {.pixels = pixels, .height = 2, .width = 1, .channels = 2},
+                  options, /*input_dimension=*/{2, 2, 1, 1}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,239 @@
+#include "runtime/components/json_schema_regex.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_format.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/components/json_value.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// The limit on the nesting of the schema, which is converted recursively.
+constexpr int kMaxDepth = 64;
+
+// The optional whitespace after the ':' and ',' separators. A single space at
+// most, such that the model cannot loop on whitespace.
+constexpr absl::string_view kSpace = "[ ]?";
+
+constexpr absl::string_view kIntegerRegex = "-?(?:0|[1-9][0-9]*)";
+constexpr absl::string_view kNumberRegex =
+    "-?(?:0|[1-9][0-9]*)(?:\\.[0-9]+)?(?:[eE][+-]?[0-9]+)?";
+// A character of a JSON string: an unescaped ASCII character, the UTF-8
+// encoding of a non-ASCII one, or an escape.
+constexpr absl::string_view kStringCharRegex =
+    "(?:[^\"\\\\\\x00-\\x1f\\x80-\\xff]|[\\xc0-\\xdf][\\x80-\\xbf]|"
+    "[\\xe0-\\xef][\\x80-\\xbf]{2}|[\\xf0-\\xf7][\\x80-\\xbf]{3}|"
+    "\\\\[\"\\\\/bfnrt]|\\\\u[0-9a-fA-F]{4})";
+
+// Returns the regex matching `text` literally.
+std::string EscapeRegex(absl::string_view text) {
+  std::string regex;
+  for (char c : text) {
+    const uint8_t byte = static_cast<uint8_t>(c);
+    if (absl::string_view("\\.^$|?*+()[]{}").find(c) !=
+        absl::string_view::npos) {
+      absl::StrAppend(&regex, "\\", absl::string_view(&c, 1));
+    } else if (byte < 0x20 || byte >= 0x7f) {
+      absl::StrAppendFormat(&regex, "\\x%02x", byte);
+    } else {
+      regex += c;
+    }
+  }
+  return regex;
+}
+
+absl::StatusOr<int> GetCount(const JsonValue& schema, absl::string_view key,
+                             int default_count) {
+  const JsonValue* value = schema.Find(key);
+  if (value == nullptr) {
+    return default_count;
+  }
+  int count;
+  if (value->type != JsonValue::Type::kNumber ||
+      !absl::SimpleAtoi(value->text, &count) || count < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("The ", key, " of the JSON schema must be a count."));
+  }
+  return count;
+}
+
+// Returns "{min,max}", or "{min,}" when max is -1.
+std::string Bounds(int min_count, int max_count) {
+  return max_count < 0 ? absl::StrCat("{", min_count, ",}")
+                       : absl::StrCat("{", min_count, ",", max_count, "}");
+}
+
+absl::StatusOr<std::string> SchemaToRegex(const JsonValue& schema, int depth);
+
+absl::StatusOr<std::string> AlternationToRegex(const JsonValue& schemas,
+                                               int depth) {
+  if (schemas.type != JsonValue::Type::kArray || schemas.items.empty()) {
+    return absl::InvalidArgumentError(
+        "anyOf and oneOf must hold a non-empty array of schemas.");
+  }
+  std::vector<std::string> alternatives;
+  for (const JsonValue& item : schemas.items) {
+    ASSIGN_OR_RETURN(std::string regex, SchemaToRegex(item, depth + 1));
+    alternatives.push_back(std::move(regex));
+  }
+  return absl::StrCat("(?:", absl::StrJoin(alternatives, "|"), ")");
+}
+
+absl::StatusOr<std::string> TypeToRegex(const JsonValue& schema,
+                                        absl::string_view type, int depth) {
+  if (type == "null") {
+    return std::string("null");
+  }
+  if (type == "boolean") {
+    return std::string("(?:true|false)");
+  }
+  if (type == "integer") {
+    return std::string(kIntegerRegex);
+  }
+  if (type == "number") {
+    return std::string(kNumberRegex);
+  }
+  if (type == "string") {
+    if (const JsonValue* pattern = schema.Find("pattern")) {
+      if (pattern->type != JsonValue::Type::kString) {
+        return absl::InvalidArgumentError("The pattern must be a string.");
+      }
+      return absl::StrCat("\"(?:", pattern->text, ")\"");
+    }
+    ASSIGN_OR_RETURN(const int min_length,
+                     GetCount(schema, "minLength", /*default_count=*/0));
+    ASSIGN_OR_RETURN(const int max_length,
+                     GetCount(schema, "maxLength", /*default_count=*/-1));
+    if (min_length == 0 && max_length < 0) {
+      return absl::StrCat("\"", kStringCharRegex, "*\"");
+    }
+    return absl::StrCat("\"", kStringCharRegex, Bounds(min_length, max_length),
+                        "\"");
+  }
+  if (type == "array") {
+    const JsonValue* items = schema.Find("items");
+    if (items == nullptr) {
+      return absl::UnimplementedError(
+          "Arrays without items are not supported in the JSON schema.");
+    }
+    ASSIGN_OR_RETURN(std::string item, SchemaToRegex(*items, depth + 1));
+    ASSIGN_OR_RETURN(const int min_items,
+                     GetCount(schema, "minItems", /*default_count=*/0));
+    ASSIGN_OR_RETURN(const int max_items,
+                     GetCount(schema, "maxItems", /*default_count=*/-1));
+    if (max_items == 0) {
+      return std::string("\\[\\]");
+    }
+    std::string rest = absl::StrCat("(?:,", kSpace, item, ")");
+    if (min_items <= 1 && max_items < 0) {
+      absl::StrAppend(&rest, "*");
+    } else {
+      absl::StrAppend(&rest, Bounds(min_items > 0 ? min_items - 1 : 0,
+                                    max_items < 0 ? -1 : max_items - 1));
+    }
+    std::string body = absl::StrCat(item, rest);
+    if (min_items == 0) {
+      body = absl::StrCat("(?:", body, ")?");
+    }
+    return absl::StrCat("\\[", body, "\\]");
+  }
+  if (type == "object") {
+    const JsonValue* properties = schema.Find("properties");
+    if (properties == nullptr) {
+      return std::string("\\{\\}");
+    }
+    if (properties->type != JsonValue::Type::kObject) {
+      return absl::InvalidArgumentError("The properties must be an object.");
+    }
+    std::vector<std::string> members;
+    for (const auto& [key, property] : properties->members) {
+      JsonValue key_value;
+      key_value.type = JsonValue::Type::kString;
+      key_value.text = key;
+      ASSIGN_OR_RETURN(std::string value, SchemaToRegex(property, depth + 1));
+      members.push_back(absl::StrCat(EscapeRegex(SerializeJson(key_value)),
+                                     ":", kSpace, value));
+    }
+    return absl::StrCat("\\{",
+                        absl::StrJoin(members, absl::StrCat(",", kSpace)),
+                        "\\}");
+  }
+  return absl::InvalidArgumentError(
+      absl::StrCat("Unknown type in the JSON schema: ", type));
+}
+
+absl::StatusOr<std::string> SchemaToRegex(const JsonValue& schema,
+                                          int depth) {
+  if (depth > kMaxDepth) {
+    return absl::InvalidArgumentError("The JSON schema is nested too deeply.");
+  }
+  if (schema.type != JsonValue::Type::kObject) {
+    return absl::UnimplementedError(
+        "Only the JSON schemas that are objects are supported.");
+  }
+  if (schema.Find("$ref") != nullptr) {
+    return absl::UnimplementedError("$ref is not supported in JSON schemas.");
+  }
+  if (const JsonValue* value = schema.Find("const")) {
+    return EscapeRegex(SerializeJson(*value));
+  }
+  if (const JsonValue* values = schema.Find("enum")) {
+    if (values->type != JsonValue::Type::kArray || values->items.empty()) {
+      return absl::InvalidArgumentError(
+          "The enum of the JSON schema must be a non-empty array.");
+    }
+    std::vector<std::string> alternatives;
+    for (const JsonValue& value : values->items) {
+      alternatives.push_back(EscapeRegex(SerializeJson(value)));
+    }
+    return absl::StrCat("(?:", absl::StrJoin(alternatives, "|"), ")");
+  }
+  if (const JsonValue* schemas = schema.Find("anyOf")) {
+    return AlternationToRegex(*schemas, depth);
+  }
+  if (const JsonValue* schemas = schema.Find("oneOf")) {
+    return AlternationToRegex(*schemas, depth);
+  }
+  const JsonValue* type = schema.Find("type");
+  if (type == nullptr) {
+    return absl::UnimplementedError(
+        "The JSON schemas without a type, which accept any value, are not "
+        "supported.");
+  }
+  if (type->type == JsonValue::Type::kString) {
+    return TypeToRegex(schema, type->text, depth);
+  }
+  if (type->type != JsonValue::Type::kArray || type->items.empty()) {
+    return absl::InvalidArgumentError(
+        "The type of the JSON schema must be a string or an array of them.");
+  }
+  std::vector<std::string> alternatives;
+  for (const JsonValue& item : type->items) {
+    if (item.type != JsonValue::Type::kString) {
+      return absl::InvalidArgumentError(
+          "The type of the JSON schema must be a string or an array of them.");
+    }
+    ASSIGN_OR_RETURN(std::string regex, TypeToRegex(schema, item.text, depth));
+    alternatives.push_back(std::move(regex));
+  }
+  return absl::StrCat("(?:", absl::StrJoin(alternatives, "|"), ")");
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> JsonSchemaToRegex(absl::string_view json_schema) {
+  ASSIGN_OR_RETURN(JsonValue schema, ParseJson(json_schema));
+  return SchemaToRegex(schema, /*depth=*/0);
+}
+
+}  // namespace litert::lm
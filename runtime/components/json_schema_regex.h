@@ -0,0 +1,32 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_JSON_SCHEMA_REGEX_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_JSON_SCHEMA_REGEX_H_
+
+#include <string>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// Converts a JSON schema into a regex, in the syntax of RegexAutomaton, that
+// only matches the JSON texts valid under the schema.
+//
+// The texts are compact, besides an optional space after each ':' and ','.
+// The supported keywords are:
+// - type: "null", "boolean", "integer", "number", "string", "array" and
+//   "object", or an array of those.
+// - enum and const, of any JSON values.
+// - anyOf and oneOf, matched as the alternation of their schemas.
+// - minLength, maxLength and pattern for the strings. The pattern must not
+//   match a character that needs escaping in JSON.
+// - items, minItems and maxItems for the arrays.
+// - properties for the objects. All of them are emitted in the order of the
+//   schema, which is valid whether they are required or not. The objects
+//   without properties are emitted empty.
+// Returns an error for the other schemas, including the ones that accept any
+// value, since arbitrarily nested JSON is not regular, and $ref.
+absl::StatusOr<std::string> JsonSchemaToRegex(absl::string_view json_schema);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_JSON_SCHEMA_REGEX_H_
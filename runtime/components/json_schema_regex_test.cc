@@ -0,0 +1,92 @@
+#include "runtime/components/json_schema_regex.h"
+
+#include <memory>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/components/regex_automaton.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+std::unique_ptr<RegexAutomaton> CompileSchema(absl::string_view json_schema) {
+  auto regex = JsonSchemaToRegex(json_schema);
+  EXPECT_OK(regex);
+  auto automaton = RegexAutomaton::Create(*regex);
+  EXPECT_OK(automaton);
+  return std::move(*automaton);
+}
+
+TEST(JsonSchemaRegexTest, Scalars) {
+  auto automaton = CompileSchema(R"({"type": ["integer", "null"]})");
+  EXPECT_TRUE(automaton->Matches("-12"));
+  EXPECT_TRUE(automaton->Matches("null"));
+  EXPECT_FALSE(automaton->Matches("012"));
+  EXPECT_FALSE(automaton->Matches("1.5"));
+
+  automaton = CompileSchema(R"({"type": "number"})");
+  EXPECT_TRUE(automaton->Matches("1.5e-3"));
+  EXPECT_FALSE(automaton->Matches("1."));
+
+  automaton = CompileSchema(R"({"type": "string", "maxLength": 3})");
+  EXPECT_TRUE(automaton->Matches(R"("a\"é")"));
+  EXPECT_FALSE(automaton->Matches(R"("abcd")"));
+  EXPECT_FALSE(automaton->Matches("\"a\nb\""));
+}
+
+TEST(JsonSchemaRegexTest, EnumAndConst) {
+  auto automaton =
+      CompileSchema(R"({"enum": ["a.b", 1, {"k": [true, null]}]})");
+  EXPECT_TRUE(automaton->Matches(R"("a.b")"));
+  EXPECT_TRUE(automaton->Matches("1"));
+  EXPECT_TRUE(automaton->Matches(R"({"k":[true,null]})"));
+  EXPECT_FALSE(automaton->Matches(R"("axb")"));
+
+  automaton = CompileSchema(R"({"const": "tab\t"})");
+  EXPECT_TRUE(automaton->Matches(R"("tab\u0009")"));
+}
+
+TEST(JsonSchemaRegexTest, ObjectsAndArrays) {
+  auto automaton = CompileSchema(R"({
+    "type": "object",
+    "properties": {
+      "name": {"type": "string"},
+      "tags": {"type": "array", "items": {"type": "boolean"}, "maxItems": 2},
+      "nested": {"anyOf": [{"type": "object"}, {"type": "null"}]}
+    },
+    "required": ["name"]
+  })");
+  EXPECT_TRUE(automaton->Matches(R"({"name":"x","tags":[],"nested":{}})"));
+  EXPECT_TRUE(automaton->Matches(
+      R"({"name": "x", "tags": [true, false], "nested": null})"));
+  EXPECT_FALSE(automaton->Matches(R"({"name":"x","tags":[true,true,true],)"
+                                  R"("nested":null})"));
+  EXPECT_FALSE(automaton->Matches(R"({"tags":[],"name":"x","nested":{}})"));
+  EXPECT_FALSE(automaton->Matches(R"({"name":  "x","tags":[],"nested":{}})"));
+
+  automaton = CompileSchema(
+      R"({"type": "array", "items": {"type": "integer"}, "minItems": 2})");
+  EXPECT_TRUE(automaton->Matches("[1,2,3]"));
+  EXPECT_FALSE(automaton->Matches("[1]"));
+  EXPECT_FALSE(automaton->Matches("[]"));
+}
+
+TEST(JsonSchemaRegexTest, RejectsUnsupportedSchemas) {
+  EXPECT_THAT(JsonSchemaToRegex("{}"),
+              StatusIs(absl::StatusCode::kUnimplemented));
+  EXPECT_THAT(JsonSchemaToRegex(R"({"$ref": "#/defs/a"})"),
+              StatusIs(absl::StatusCode::kUnimplemented));
+  EXPECT_THAT(JsonSchemaToRegex(R"({"type": "string")"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(JsonSchemaToRegex(R"({"type": "date"})"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
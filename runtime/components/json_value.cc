@@ -0,0 +1,284 @@
+#include "runtime/components/json_value.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_format.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// The limit on the nesting of the values, which are parsed recursively.
+constexpr int kMaxDepth = 64;
+
+void AppendUtf8(uint32_t code_point, std::string& output) {
+  if (code_point < 0x80) {
+    output += static_cast<char>(code_point);
+  } else if (code_point < 0x800) {
+    output += static_cast<char>(0xc0 | (code_point >> 6));
+    output += static_cast<char>(0x80 | (code_point & 0x3f));
+  } else if (code_point < 0x10000) {
+    output += static_cast<char>(0xe0 | (code_point >> 12));
+    output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+    output += static_cast<char>(0x80 | (code_point & 0x3f));
+  } else {
+    output += static_cast<char>(0xf0 | (code_point >> 18));
+    output += static_cast<char>(0x80 | ((code_point >> 12) & 0x3f));
+    output += static_cast<char>(0x80 | ((code_point >> 6) & 0x3f));
+    output += static_cast<char>(0x80 | (code_point & 0x3f));
+  }
+}
+
+// A recursive descent parser of JSON texts.
+class JsonParser {
+ public:
+  explicit JsonParser(absl::string_view json) : json_(json) {}
+
+  absl::StatusOr<JsonValue> Parse() {
+    ASSIGN_OR_RETURN(JsonValue value, ParseValue(/*depth=*/0));
+    SkipWhitespace();
+    if (pos_ != json_.size()) {
+      return Error("Unexpected trailing characters");
+    }
+    return value;
+  }
+
+ private:
+  absl::Status Error(absl::string_view message) const {
+    return absl::InvalidArgumentError(
+        absl::StrCat(message, " at position ", pos_, " of the JSON text."));
+  }
+
+  void SkipWhitespace() {
+    while (pos_ < json_.size() &&
+           absl::string_view(" \t\n\r").find(json_[pos_]) !=
+               absl::string_view::npos) {
+      ++pos_;
+    }
+  }
+
+  bool Consume(absl::string_view token) {
+    if (json_.substr(pos_, token.size()) == token) {
+      pos_ += token.size();
+      return true;
+    }
+    return false;
+  }
+
+  absl::StatusOr<JsonValue> ParseValue(int depth) {
+    if (depth > kMaxDepth) {
+      return Error("The JSON is nested too deeply");
+    }
+    SkipWhitespace();
+    if (pos_ >= json_.size()) {
+      return Error("Unexpected end");
+    }
+    JsonValue value;
+    const char c = json_[pos_];
+    if (c == '{') {
+      ++pos_;
+      value.type = JsonValue::Type::kObject;
+      SkipWhitespace();
+      if (Consume("}")) {
+        return value;
+      }
+      do {
+        SkipWhitespace();
+        ASSIGN_OR_RETURN(std::string key, ParseString());
+        SkipWhitespace();
+        if (!Consume(":")) {
+          return Error("Expected ':'");
+        }
+        ASSIGN_OR_RETURN(JsonValue member, ParseValue(depth + 1));
+        value.members.emplace_back(std::move(key), std::move(member));
+        SkipWhitespace();
+      } while (Consume(","));
+      if (!Consume("}")) {
+        return Error("Expected '}'");
+      }
+    } else if (c == '[') {
+      ++pos_;
+      value.type = JsonValue::Type::kArray;
+      SkipWhitespace();
+      if (Consume("]")) {
+        return value;
+      }
+      do {
+        ASSIGN_OR_RETURN(JsonValue item, ParseValue(depth + 1));
+        value.items.push_back(std::move(item));
+        SkipWhitespace();
+      } while (Consume(","));
+      if (!Consume("]")) {
+        return Error("Expected ']'");
+      }
+    } else if (c == '"') {
+      value.type = JsonValue::Type::kString;
+      ASSIGN_OR_RETURN(value.text, ParseString());
+    } else if (Consume("true")) {
+      value.type = JsonValue::Type::kBool;
+      value.bool_value = true;
+    } else if (Consume("false")) {
+      value.type = JsonValue::Type::kBool;
+    } else if (Consume("null")) {
+      value.type = JsonValue::Type::kNull;
+    } else {
+      const size_t start = pos_;
+      while (pos_ < json_.size() &&
+             absl::string_view("+-.eE0123456789").find(json_[pos_]) !=
+                 absl::string_view::npos) {
+        ++pos_;
+      }
+      double number;
+      if (pos_ == start ||
+          !absl::SimpleAtod(json_.substr(start, pos_ - start), &number)) {
+        return Error("Invalid value");
+      }
+      value.type = JsonValue::Type::kNumber;
+      value.text = std::string(json_.substr(start, pos_ - start));
+    }
+    return value;
+  }
+
+  absl::StatusOr<uint32_t> ParseHex4() {
+    uint32_t code_unit = 0;
+    if (pos_ + 4 > json_.size()) {
+      return Error("Invalid \\u escape");
+    }
+    for (int i = 0; i < 4; ++i) {
+      const char c = json_[pos_++];
+      if (!absl::ascii_isxdigit(c)) {
+        return Error("Invalid \\u escape");
+      }
+      code_unit = code_unit * 16 +
+                  (absl::ascii_isdigit(c) ? c - '0'
+                                          : absl::ascii_tolower(c) - 'a' + 10);
+    }
+    return code_unit;
+  }
+
+  absl::StatusOr<std::string> ParseString() {
+    if (!Consume("\"")) {
+      return Error("Expected a string");
+    }
+    std::string text;
+    while (pos_ < json_.size() && json_[pos_] != '"') {
+      const char c = json_[pos_++];
+      if (c != '\\') {
+        text += c;
+        continue;
+      }
+      if (pos_ >= json_.size()) {
+        break;
+      }
+      const char escaped = json_[pos_++];
+      switch (escaped) {
+        case 'b':
+          text += '\b';
+          break;
+        case 'f':
+          text += '\f';
+          break;
+        case 'n':
+          text += '\n';
+          break;
+        case 'r':
+          text += '\r';
+          break;
+        case 't':
+          text += '\t';
+          break;
+        case 'u': {
+          ASSIGN_OR_RETURN(uint32_t code_point, ParseHex4());
+          // A surrogate pair encodes a code point past the BMP.
+          if (code_point >= 0xd800 && code_point < 0xdc00 && Consume("\\u")) {
+            ASSIGN_OR_RETURN(const uint32_t low, ParseHex4());
+            code_point = 0x10000 + ((code_point - 0xd800) << 10) +
+                         (low - 0xdc00);
+          }
+          AppendUtf8(code_point, text);
+          break;
+        }
+        default:
+          text += escaped;
+      }
+    }
+    if (!Consume("\"")) {
+      return Error("Unterminated string");
+    }
+    return text;
+  }
+
+  absl::string_view json_;
+  size_t pos_ = 0;
+};
+
+}  // namespace
+
+const JsonValue* JsonValue::Find(absl::string_view key) const {
+  for (const auto& [member_key, value] : members) {
+    if (member_key == key) {
+      return &value;
+    }
+  }
+  return nullptr;
+}
+
+absl::StatusOr<JsonValue> ParseJson(absl::string_view json) {
+  return JsonParser(json).Parse();
+}
+
+std::string SerializeJson(const JsonValue& value) {
+  switch (value.type) {
+    case JsonValue::Type::kNull:
+      return "null";
+    case JsonValue::Type::kBool:
+      return value.bool_value ? "true" : "false";
+    case JsonValue::Type::kNumber:
+      return value.text;
+    case JsonValue::Type::kString: {
+      std::string text = "\"";
+      for (char c : value.text) {
+        if (c == '"' || c == '\\') {
+          absl::StrAppend(&text, "\\", absl::string_view(&c, 1));
+        } else if (static_cast<uint8_t>(c) < 0x20) {
+          absl::StrAppendFormat(&text, "\\u%04x", static_cast<uint8_t>(c));
+        } else {
+          text += c;
+        }
+      }
+      return text + "\"";
+    }
+    case JsonValue::Type::kArray: {
+      std::vector<std::string> items;
+      for (const JsonValue& item : value.items) {
+        items.push_back(SerializeJson(item));
+      }
+      return absl::StrCat("[", absl::StrJoin(items, ","), "]");
+    }
+    case JsonValue::Type::kObject: {
+      std::vector<std::string> members;
+      for (const auto& [key, member] : value.members) {
+        JsonValue key_value;
+        key_value.type = JsonValue::Type::kString;
+        key_value.text = key;
+        members.push_back(
+            absl::StrCat(SerializeJson(key_value), ":", SerializeJson(member)));
+      }
+      return absl::StrCat("{", absl::StrJoin(members, ","), "}");
+    }
+  }
+  return "";
+}
+
+}  // namespace litert::lm
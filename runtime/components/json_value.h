@@ -0,0 +1,37 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_JSON_VALUE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_JSON_VALUE_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// A parsed JSON value.
+struct JsonValue {
+  enum class Type { kNull, kBool, kNumber, kString, kArray, kObject };
+  Type type = Type::kNull;
+  bool bool_value = false;
+  // The text of a number, or the decoded value of a string.
+  std::string text;
+  std::vector<JsonValue> items;
+  // The members of an object, in the order of the text.
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+  // Returns the first member of the object named `key`, or null if none.
+  const JsonValue* Find(absl::string_view key) const;
+};
+
+// Parses the JSON text `json`, nested at most 64 levels deep. Returns
+// InvalidArgumentError with the position of the first error.
+absl::StatusOr<JsonValue> ParseJson(absl::string_view json);
+
+// Serializes `value` as compact JSON.
+std::string SerializeJson(const JsonValue& value);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_JSON_VALUE_H_
@@ -0,0 +1,51 @@
+#include "runtime/components/json_value.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+TEST(JsonValueTest, ParsesNestedValues) {
+  auto value = ParseJson(
+      R"( {"a": [1, -2.5e3, true, null], "b": {"c": "x\nyé"}} )");
+  ASSERT_OK(value);
+  ASSERT_EQ(value->type, JsonValue::Type::kObject);
+  const JsonValue* a = value->Find("a");
+  ASSERT_NE(a, nullptr);
+  ASSERT_EQ(a->items.size(), 4);
+  EXPECT_EQ(a->items[0].text, "1");
+  EXPECT_EQ(a->items[1].text, "-2.5e3");
+  EXPECT_TRUE(a->items[2].bool_value);
+  EXPECT_EQ(a->items[3].type, JsonValue::Type::kNull);
+  const JsonValue* b = value->Find("b");
+  ASSERT_NE(b, nullptr);
+  ASSERT_NE(b->Find("c"), nullptr);
+  EXPECT_EQ(b->Find("c")->text, "x\ny\xc3\xa9");
+  EXPECT_EQ(value->Find("d"), nullptr);
+}
+
+TEST(JsonValueTest, SerializesCompactly) {
+  auto value = ParseJson(R"({ "a" : [1, "q\"\u0001"], "b": false })");
+  ASSERT_OK(value);
+  EXPECT_EQ(SerializeJson(*value), R"({"a":[1,"q\"\u0001"],"b":false})");
+}
+
+TEST(JsonValueTest, RejectsInvalidText) {
+  EXPECT_THAT(ParseJson(R"({"a": 1)"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseJson("[1] 2"), StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseJson(R"("abc)"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseJson(std::string(100, '[')),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
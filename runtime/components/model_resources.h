@@ -17,7 +17,9 @@
 
 // All the loaded model resources the executor needs to hold to avoid the model
 // being destroyed.
+#include <cstdint>
 #include <string>
+#include <vector>
 
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
@@ -26,6 +28,7 @@
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "litert/cc/litert_model.h"  // from @litert
 #include "runtime/components/tokenizer.h"
+#include "runtime/util/memory_usage.h"
 #include "runtime/proto/llm_metadata.pb.h"
 
 namespace litert::lm {
@@ -36,6 +39,12 @@ enum class ModelType {
   kTfLiteEmbedder = 2,
   kTfLitePerLayerEmbedder = 3,
   kTfLiteAux = 4,
+  kTfLiteDraft = 5,  // The draft model used for speculative decoding.
+  // The stages of a base model split by layers, which run on different
+  // executors, see PipelineLlmExecutor. The first stage takes the token ids
+  // and outputs activations, which the second stage takes to output logits.
+  kTfLitePipelineFirstStage = 6,
+  kTfLitePipelineSecondStage = 7,
 };
 
 // Utility function to convert a string to ModelType. It's case insensitive.
@@ -51,6 +60,12 @@ inline absl::StatusOr<ModelType> StringToModelType(
     return ModelType::kTfLitePerLayerEmbedder;
   } else if (lower_case_model_type_str == "tf_lite_aux") {
     return ModelType::kTfLiteAux;
+  } else if (lower_case_model_type_str == "tf_lite_draft") {
+    return ModelType::kTfLiteDraft;
+  } else if (lower_case_model_type_str == "tf_lite_pipeline_first_stage") {
+    return ModelType::kTfLitePipelineFirstStage;
+  } else if (lower_case_model_type_str == "tf_lite_pipeline_second_stage") {
+    return ModelType::kTfLitePipelineSecondStage;
   } else {
     return absl::InvalidArgumentError(
         absl::StrCat("Unknown model type: ", model_type_str));
@@ -68,6 +83,12 @@ inline std::string ModelTypeToString(ModelType model_type) {
       return "TF_LITE_PER_LAYER_EMBEDDER";
     case ModelType::kTfLiteAux:
       return "TF_LITE_AUX";
+    case ModelType::kTfLiteDraft:
+      return "TF_LITE_DRAFT";
+    case ModelType::kTfLitePipelineFirstStage:
+      return "TF_LITE_PIPELINE_FIRST_STAGE";
+    case ModelType::kTfLitePipelineSecondStage:
+      return "TF_LITE_PIPELINE_SECOND_STAGE";
     case ModelType::kUnknown:
       return "UNKNOWN";
     default:
@@ -82,7 +103,8 @@ inline std::string ModelTypeToString(ModelType model_type) {
 // Get*() functions are called, the models are not created yet. And once the
 // models are created, they will be re-used for all the following calls.
 //
-// It's not thread-safe.
+// It's not thread-safe, but the getters of different resources, i.e. the
+// tokenizer, the llm metadata and the models, may be called concurrently.
 class ModelResources {
  public:
   virtual ~ModelResources() = default;
@@ -98,6 +120,39 @@ class ModelResources {
 
   // Returns the llm metadata.
   virtual absl::StatusOr<const proto::LlmMetadata*> GetLlmMetadata() = 0;
+
+  // Returns the LoRA adapters shipped with the model, each a serialized
+  // schema::LoraAdapter that stays valid as long as the resources.
+  virtual std::vector<absl::string_view> GetLoraAdapters() { return {}; }
+
+  // Hints that the memory of the model is not read any more, e.g. once its
+  // weights are uploaded to the GPU, such that it can be released. The model
+  // stays usable.
+  virtual void ReleaseTFLiteModelMemory(ModelType model_type) {}
+
+  // Returns the number of bytes of the model memory which are in RAM, e.g.
+  // to release it once beyond a budget. Fails if the memory of the model is
+  // not paged from the model file.
+  virtual absl::StatusOr<uint64_t> GetTFLiteModelResidentBytes(
+      ModelType model_type) {
+    return absl::UnimplementedError("The resident memory is not known.");
+  }
+
+  // Returns whether the buffer of the model is page-aligned in a mapping of
+  // the model file that lives as long as the resources, such that a GPU
+  // sharing the memory of the host can import its weights in place instead of
+  // copying them. The memory of such a model must then not be released.
+  virtual bool IsTFLiteModelPageAligned(ModelType model_type) { return false; }
+
+  // Hints that the model is read soon, such that its memory is read in on a
+  // background thread while the other resources are created. The model stays
+  // usable concurrently.
+  virtual void PrefetchTFLiteModel(ModelType model_type) {}
+
+  // Returns the memory of the resources created so far, i.e. the weights of
+  // the models and the tokenizer as read from the model file. Empty if the
+  // resources do not account their memory.
+  virtual MemoryUsage GetMemoryUsage() { return MemoryUsage(); }
 };
 
 }  // namespace litert::lm
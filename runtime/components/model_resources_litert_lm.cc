@@ -18,17 +18,25 @@
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/memory/memory.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_buffer_ref.h"  // from @litert
 #include "litert/cc/litert_macros.h"  // from @litert
 #include "litert/cc/litert_model.h"  // from @litert
 #include "runtime/components/model_resources.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/util/fake_weights.h"
+#include "runtime/util/init_phase.h"
 #include "runtime/util/litert_lm_loader.h"
+#include "runtime/util/memory_usage.h"
 #include "runtime/util/status_macros.h"  //NOLINT
 
 #ifdef ENABLE_SENTENCEPIECE_TOKENIZER
@@ -43,9 +51,10 @@ namespace litert::lm {
 
 // static
 absl::StatusOr<std::unique_ptr<ModelResources>> ModelResourcesLitertLm::Create(
-    std::unique_ptr<LitertLmLoader> litert_lm_loader) {
-  return absl::WrapUnique(
-      new ModelResourcesLitertLm(std::move(litert_lm_loader)));
+    std::unique_ptr<LitertLmLoader> litert_lm_loader,
+    FakeWeightsMode fake_weights_mode) {
+  return absl::WrapUnique(new ModelResourcesLitertLm(
+      std::move(litert_lm_loader), fake_weights_mode));
 };
 
 absl::StatusOr<const litert::Model*> ModelResourcesLitertLm::GetTFLiteModel(
@@ -59,6 +68,22 @@ absl::StatusOr<const litert::Model*> ModelResourcesLitertLm::GetTFLiteModel(
       litert_lm_loader_->GetTFLiteModel(model_type);
   ABSL_LOG(INFO) << "model_type: " << ModelTypeToString(model_type);
   ABSL_LOG(INFO) << "litert model size: " << buffer_ref.Size();
+  if (fake_weights_mode_ != FakeWeightsMode::FAKE_WEIGHTS_NONE) {
+    InitPhaseScope phase(
+        absl::StrCat("Fake weights: ", ModelTypeToString(model_type)));
+    ASSIGN_OR_RETURN(  // NOLINT
+        fake_weights_models_[model_type],
+        CreateModelWithFakeWeights(
+            absl::MakeConstSpan(buffer_ref.Data(), buffer_ref.Size()),
+            fake_weights_mode_));
+    const std::vector<uint8_t>& fake_weights_model =
+        fake_weights_models_[model_type];
+    buffer_ref = litert::BufferRef<uint8_t>(fake_weights_model.data(),
+                                            fake_weights_model.size());
+    ABSL_LOG(INFO) << "Weights replaced with " << fake_weights_mode_;
+  }
+  InitPhaseScope phase(
+      absl::StrCat("Model parsing: ", ModelTypeToString(model_type)));
   LITERT_ASSIGN_OR_RETURN(auto model, Model::CreateFromBuffer(buffer_ref));
   model_map_[model_type] = std::make_unique<litert::Model>(std::move(model));
   return model_map_[model_type].get();
@@ -79,6 +104,7 @@ absl::StatusOr<Tokenizer*> ModelResourcesLitertLm::GetTokenizer() {
   auto sp_tokenizer = litert_lm_loader_->GetSentencePieceTokenizer();
 #ifdef ENABLE_SENTENCEPIECE_TOKENIZER
   if (sp_tokenizer) {
+    InitPhaseScope phase("Tokenizer construction");
     ASSIGN_OR_RETURN(  // NOLINT
         auto tokenizer,
         SentencePieceTokenizer::CreateFromBuffer(sp_tokenizer->StrView()));
@@ -90,9 +116,11 @@ absl::StatusOr<Tokenizer*> ModelResourcesLitertLm::GetTokenizer() {
   auto hf_tokenizer = litert_lm_loader_->GetHuggingFaceTokenizer();
 #ifdef ENABLE_HUGGINGFACE_TOKENIZER
   if (hf_tokenizer) {
-    std::string json_data(hf_tokenizer->StrData(), hf_tokenizer->Size());
+    InitPhaseScope phase("Tokenizer construction");
+    // The JSON is parsed in place, from the mapped or inflated section.
     ASSIGN_OR_RETURN(  // NOLINT
-        auto tokenizer, HuggingFaceTokenizer::CreateFromJson(json_data));
+        auto tokenizer,
+        HuggingFaceTokenizer::CreateFromJson(hf_tokenizer->StrView()));
     tokenizer_ = std::move(tokenizer);
     return tokenizer_.get();
   }
@@ -115,6 +143,7 @@ absl::StatusOr<const proto::LlmMetadata*>
 ModelResourcesLitertLm::GetLlmMetadata() {
   if (llm_metadata_ == nullptr) {
     auto buffer_ref = litert_lm_loader_->GetLlmMetadata();
+    InitPhaseScope phase("Metadata parsing");
     auto llm_metadata = std::make_unique<proto::LlmMetadata>();
     if (!llm_metadata->ParseFromString(std::string(buffer_ref.StrView()))) {  // NOLINT
       return absl::InternalError("Failed to parse LlmMetadata");
@@ -124,4 +153,59 @@ ModelResourcesLitertLm::GetLlmMetadata() {
   return llm_metadata_.get();
 };
 
+std::vector<absl::string_view> ModelResourcesLitertLm::GetLoraAdapters() {
+  std::vector<absl::string_view> lora_adapters;
+  for (const auto& buffer_ref : litert_lm_loader_->GetLoraAdapters()) {
+    lora_adapters.push_back(buffer_ref.StrView());
+  }
+  return lora_adapters;
+}
+
+void ModelResourcesLitertLm::ReleaseTFLiteModelMemory(ModelType model_type) {
+  litert_lm_loader_->ReleaseTFLiteModel(model_type);
+}
+
+absl::StatusOr<uint64_t> ModelResourcesLitertLm::GetTFLiteModelResidentBytes(
+    ModelType model_type) {
+  return litert_lm_loader_->GetTFLiteModelResidentBytes(model_type);
+}
+
+bool ModelResourcesLitertLm::IsTFLiteModelPageAligned(ModelType model_type) {
+  // The fake weights are held in a vector instead.
+  return fake_weights_mode_ == FakeWeightsMode::FAKE_WEIGHTS_NONE &&
+         litert_lm_loader_->IsTFLiteModelPageAligned(model_type);
+}
+
+void ModelResourcesLitertLm::PrefetchTFLiteModel(ModelType model_type) {
+  litert_lm_loader_->PrefetchTFLiteModel(model_type);
+}
+
+MemoryUsage ModelResourcesLitertLm::GetMemoryUsage() {
+  MemoryUsage memory_usage;
+  // The models stay mapped from the file once created, even when their
+  // weights are uploaded to the device, so they are counted on the host.
+  for (const auto& [model_type, model] : model_map_) {
+    const bool is_embedder = model_type == ModelType::kTfLiteEmbedder ||
+                             model_type == ModelType::kTfLitePerLayerEmbedder;
+    auto fake_weights_model = fake_weights_models_.find(model_type);
+    const uint64_t size =
+        fake_weights_model != fake_weights_models_.end()
+            ? fake_weights_model->second.size()
+            : litert_lm_loader_->GetTFLiteModel(model_type).Size();
+    memory_usage.Add(is_embedder ? kEmbedderMemory : kWeightsMemory,
+                     MemoryLocation::kHost, size);
+  }
+  if (tokenizer_ != nullptr) {
+    if (auto sp_tokenizer = litert_lm_loader_->GetSentencePieceTokenizer()) {
+      memory_usage.Add(kTokenizerMemory, MemoryLocation::kHost,
+                       sp_tokenizer->Size());
+    } else if (auto hf_tokenizer =
+                   litert_lm_loader_->GetHuggingFaceTokenizer()) {
+      memory_usage.Add(kTokenizerMemory, MemoryLocation::kHost,
+                       hf_tokenizer->Size());
+    }
+  }
+  return memory_usage;
+}
+
 }  // namespace litert::lm
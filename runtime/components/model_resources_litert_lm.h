@@ -15,24 +15,32 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_MODEL_RESOURCES_LITERT_LM_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_MODEL_RESOURCES_LITERT_LM_H_
 
+#include <cstdint>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
 #include "litert/cc/litert_model.h"  // from @litert
 #include "runtime/components/model_resources.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/executor/executor_settings_base.h"
 #include "runtime/proto/llm_metadata.pb.h"
 #include "runtime/util/litert_lm_loader.h"
+#include "runtime/util/memory_usage.h"
 
 namespace litert::lm {
 
 // Model resources for the litert lm model.
 class ModelResourcesLitertLm : public ModelResources {
  public:
+  // With a `fake_weights_mode`, the weights of the TFLite models are replaced
+  // with fake ones, see CreateModelWithFakeWeights().
   static absl::StatusOr<std::unique_ptr<ModelResources>> Create(
-      std::unique_ptr<LitertLmLoader> litert_lm_loader);
+      std::unique_ptr<LitertLmLoader> litert_lm_loader,
+      FakeWeightsMode fake_weights_mode = FakeWeightsMode::FAKE_WEIGHTS_NONE);
 
   absl::StatusOr<const litert::Model*> GetTFLiteModel(
       ModelType model_type) override;
@@ -44,11 +52,29 @@ class ModelResourcesLitertLm : public ModelResources {
 
   absl::StatusOr<const proto::LlmMetadata*> GetLlmMetadata() override;
 
+  std::vector<absl::string_view> GetLoraAdapters() override;
+
+  void ReleaseTFLiteModelMemory(ModelType model_type) override;
+
+  absl::StatusOr<uint64_t> GetTFLiteModelResidentBytes(
+      ModelType model_type) override;
+
+  bool IsTFLiteModelPageAligned(ModelType model_type) override;
+
+  void PrefetchTFLiteModel(ModelType model_type) override;
+
+  MemoryUsage GetMemoryUsage() override;
+
  private:
-  explicit ModelResourcesLitertLm(
-      std::unique_ptr<LitertLmLoader> litert_lm_loader)
-      : litert_lm_loader_(std::move(litert_lm_loader)) {}
+  ModelResourcesLitertLm(std::unique_ptr<LitertLmLoader> litert_lm_loader,
+                         FakeWeightsMode fake_weights_mode)
+      : fake_weights_mode_(fake_weights_mode),
+        litert_lm_loader_(std::move(litert_lm_loader)) {}
 
+  const FakeWeightsMode fake_weights_mode_;
+  // The models with fake weights the models of model_map_ are created from,
+  // if any.
+  absl::flat_hash_map<ModelType, std::vector<uint8_t>> fake_weights_models_;
   absl::flat_hash_map<ModelType, std::unique_ptr<litert::Model>> model_map_;
   std::unique_ptr<Tokenizer> tokenizer_;
   std::unique_ptr<proto::LlmMetadata> llm_metadata_;
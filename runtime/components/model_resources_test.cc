@@ -136,6 +136,18 @@ TEST(ModelTypeConversionTest, StringToModelType) {
   ASSERT_OK(result);
   EXPECT_EQ(result.value(), ModelType::kTfLitePerLayerEmbedder);
 
+  result = StringToModelType("tf_lite_draft");
+  ASSERT_OK(result);
+  EXPECT_EQ(result.value(), ModelType::kTfLiteDraft);
+
+  result = StringToModelType("tf_lite_pipeline_first_stage");
+  ASSERT_OK(result);
+  EXPECT_EQ(result.value(), ModelType::kTfLitePipelineFirstStage);
+
+  result = StringToModelType("TF_LITE_PIPELINE_SECOND_STAGE");
+  ASSERT_OK(result);
+  EXPECT_EQ(result.value(), ModelType::kTfLitePipelineSecondStage);
+
   result = StringToModelType("unknown");
   EXPECT_FALSE(result.ok());
 }
@@ -146,6 +158,11 @@ TEST(ModelTypeConversionTest, ModelTypeToString) {
   EXPECT_EQ(ModelTypeToString(ModelType::kTfLiteEmbedder), "TF_LITE_EMBEDDER");
   EXPECT_EQ(ModelTypeToString(ModelType::kTfLitePerLayerEmbedder),
             "TF_LITE_PER_LAYER_EMBEDDER");
+  EXPECT_EQ(ModelTypeToString(ModelType::kTfLiteDraft), "TF_LITE_DRAFT");
+  EXPECT_EQ(ModelTypeToString(ModelType::kTfLitePipelineFirstStage),
+            "TF_LITE_PIPELINE_FIRST_STAGE");
+  EXPECT_EQ(ModelTypeToString(ModelType::kTfLitePipelineSecondStage),
+            "TF_LITE_PIPELINE_SECOND_STAGE");
   EXPECT_EQ(ModelTypeToString(ModelType::kUnknown), "UNKNOWN");
 }
 
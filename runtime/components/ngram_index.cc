@@ -0,0 +1,70 @@
+#include "runtime/components/ngram_index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/hash/hash.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<NgramIndex>> NgramIndex::Create(
+    int min_ngram_size, int max_ngram_size) {
+  RET_CHECK(min_ngram_size > 0 && min_ngram_size <= max_ngram_size)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Invalid n-gram sizes [" << min_ngram_size << ", " << max_ngram_size
+      << "].";
+  return absl::WrapUnique(new NgramIndex(min_ngram_size, max_ngram_size));
+}
+
+size_t NgramIndex::HashNgram(size_t start, int ngram_size) const {
+  return absl::HashOf(
+      absl::MakeConstSpan(token_ids_).subspan(start, ngram_size));
+}
+
+void NgramIndex::AddTokens(absl::Span<const int> token_ids) {
+  for (int token_id : token_ids) {
+    // The new token makes the n-grams ending before it proposable.
+    const size_t position = token_ids_.size();
+    token_ids_.push_back(token_id);
+    const int max_ngram_size = std::min<size_t>(max_ngram_size_, position);
+    for (int n = min_ngram_size_; n <= max_ngram_size; ++n) {
+      continuations_[n - min_ngram_size_][HashNgram(position - n, n)] =
+          position;
+    }
+  }
+}
+
+std::vector<int> NgramIndex::Propose(int max_num_tokens) const {
+  const size_t size = token_ids_.size();
+  if (max_num_tokens <= 0) {
+    return {};
+  }
+  for (int n = std::min<size_t>(max_ngram_size_, size); n >= min_ngram_size_;
+       --n) {
+    const auto& continuations = continuations_[n - min_ngram_size_];
+    auto it = continuations.find(HashNgram(size - n, n));
+    if (it == continuations.end()) {
+      continue;
+    }
+    // The hashes may collide, so the n-grams are compared.
+    const size_t start = it->second;
+    if (!std::equal(token_ids_.begin() + (start - n),
+                    token_ids_.begin() + start, token_ids_.end() - n)) {
+      continue;
+    }
+    const size_t end = std::min(size, start + max_num_tokens);
+    return std::vector<int>(token_ids_.begin() + start,
+                            token_ids_.begin() + end);
+  }
+  return {};
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,63 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_NGRAM_INDEX_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_NGRAM_INDEX_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// An index of the n-grams of a growing token sequence, used to propose the
+// continuation of the sequence from its own earlier text, e.g. for prompt
+// lookup decoding where the output copies spans of the prompt.
+//
+// For each n in [min_ngram_size, max_ngram_size], the index maps the hash of
+// each n-gram to the position following its latest occurrence. It is updated
+// in O(max_ngram_size^2) per added token, and a proposal is a lookup per n.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto index, NgramIndex::Create(/*min_ngram_size=*/2,
+//                                                   /*max_ngram_size=*/4));
+//   index->AddTokens(prompt_token_ids);
+//   std::vector<int> draft_token_ids = index->Propose(/*max_num_tokens=*/8);
+class NgramIndex {
+ public:
+  static absl::StatusOr<std::unique_ptr<NgramIndex>> Create(int min_ngram_size,
+                                                            int max_ngram_size);
+
+  // Appends the tokens to the sequence.
+  void AddTokens(absl::Span<const int> token_ids);
+
+  // Returns up to `max_num_tokens` tokens that followed the latest earlier
+  // occurrence of the longest indexed n-gram ending the sequence, or nothing
+  // if no such n-gram occurred before.
+  std::vector<int> Propose(int max_num_tokens) const;
+
+  absl::Span<const int> GetTokenIds() const { return token_ids_; }
+
+ private:
+  NgramIndex(int min_ngram_size, int max_ngram_size)
+      : min_ngram_size_(min_ngram_size),
+        max_ngram_size_(max_ngram_size),
+        continuations_(max_ngram_size - min_ngram_size + 1) {}
+
+  // Returns the hash of the n-gram of `ngram_size` tokens starting at `start`.
+  size_t HashNgram(size_t start, int ngram_size) const;
+
+  const int min_ngram_size_;
+  const int max_ngram_size_;
+  std::vector<int> token_ids_;
+  // The position following the latest occurrence of each n-gram, by n-gram
+  // hash, with one map per n-gram size from min_ngram_size_. The n-gram
+  // ending the sequence is only indexed once a token follows it.
+  std::vector<absl::flat_hash_map<size_t, size_t>> continuations_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_NGRAM_INDEX_H_
@@ -0,0 +1,49 @@
+#include "runtime/components/ngram_index.h"
+
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::status::StatusIs;
+
+TEST(NgramIndexTest, CreateFailsWithInvalidNgramSizes) {
+  EXPECT_THAT(NgramIndex::Create(0, 2),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(NgramIndex::Create(3, 2),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(NgramIndexTest, ProposesTheContinuationOfTheLongestNgram) {
+  ASSERT_OK_AND_ASSIGN(auto index, NgramIndex::Create(1, 3));
+  // The bigram {1, 2} is followed by 3 and then by 7. The trigram {0, 1, 2}
+  // is only followed by 3.
+  index->AddTokens({0, 1, 2, 3, 4, 5, 1, 2, 7, 0, 1, 2});
+  EXPECT_THAT(index->Propose(/*max_num_tokens=*/3), ElementsAre(3, 4, 5));
+  // The latest occurrence of the bigram is followed by 9, and the proposal
+  // stops at the end of the sequence.
+  index->AddTokens({9, 1, 2});
+  EXPECT_THAT(index->Propose(/*max_num_tokens=*/5), ElementsAre(9, 1, 2));
+  EXPECT_EQ(index->GetTokenIds().size(), 15);
+}
+
+TEST(NgramIndexTest, ProposesNothingWithoutAMatch) {
+  ASSERT_OK_AND_ASSIGN(auto index, NgramIndex::Create(2, 3));
+  EXPECT_THAT(index->Propose(/*max_num_tokens=*/4), IsEmpty());
+  index->AddTokens({1, 2, 3, 1});
+  // Only the unigram {1} occurred before, which is shorter than the minimum.
+  EXPECT_THAT(index->Propose(/*max_num_tokens=*/4), IsEmpty());
+  index->AddTokens({2});
+  EXPECT_THAT(index->Propose(/*max_num_tokens=*/4), ElementsAre(3, 1, 2));
+  EXPECT_THAT(index->Propose(/*max_num_tokens=*/0), IsEmpty());
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,176 @@
+#include "runtime/components/penalty_sampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_element_type.h"  // from @litert
+#include "litert/cc/litert_macros.h"  // from @litert
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/sampler.h"
+#include "runtime/components/sampling_cpu_util.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<PenaltySampler>> PenaltySampler::Create(
+    std::unique_ptr<Sampler> sampler, const SamplingPenalties& penalties,
+    float temperature, int batch_size) {
+  RET_CHECK(sampler != nullptr).SetCode(absl::StatusCode::kInvalidArgument)
+      << "The sampler must be set.";
+  RET_CHECK_GT(penalties.repetition_penalty, 0.0f)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The repetition penalty must be positive.";
+  RET_CHECK(penalties.min_p >= 0.0f && penalties.min_p <= 1.0f)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The min-p must be in [0, 1], but got " << penalties.min_p;
+  RET_CHECK_GT(batch_size, 0).SetCode(absl::StatusCode::kInvalidArgument)
+      << "The batch size must be positive.";
+  return absl::WrapUnique(
+      new PenaltySampler(std::move(sampler), penalties, temperature,
+                         batch_size));
+}
+
+void PenaltySampler::Reset() {
+  for (auto& token_counts : token_counts_) {
+    token_counts.clear();
+  }
+  std::fill(active_rows_.begin(), active_rows_.end(), true);
+  sampler_->Reset();
+}
+
+void PenaltySampler::SetActiveRows(const std::vector<bool>& active_rows) {
+  if (active_rows.size() == batch_size_) {
+    active_rows_ = active_rows;
+  }
+  sampler_->SetActiveRows(active_rows);
+}
+
+int PenaltySampler::GetTokenCount(int row, int token_id) const {
+  auto it = token_counts_[row].find(token_id);
+  return it == token_counts_[row].end() ? 0 : it->second;
+}
+
+absl::Status PenaltySampler::ReadLogits(const TensorBuffer& logits_tensor) {
+  LITERT_ASSIGN_OR_RETURN(auto logits_type, logits_tensor.TensorType());
+  LITERT_ASSIGN_OR_RETURN(auto logits_size, logits_tensor.PackedSize());
+  TensorBuffer& mutable_logits_tensor =
+      const_cast<TensorBuffer&>(logits_tensor);
+  const ElementType element_type = logits_type.ElementType();
+  if (element_type == ElementType::Float32) {
+    logits_.resize(logits_size / sizeof(float));
+    if (!mutable_logits_tensor.Read(absl::MakeSpan(logits_))) {
+      return absl::InternalError("Failed to read the logits.");
+    }
+    return absl::OkStatus();
+  }
+  RET_CHECK(element_type == ElementType::Float16 ||
+            element_type == ElementType::BFloat16)
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "The penalties only support float32, float16 and bfloat16 logits.";
+  half_logits_.resize(logits_size / sizeof(uint16_t));
+  if (!mutable_logits_tensor.Read(absl::MakeSpan(half_logits_))) {
+    return absl::InternalError("Failed to read the logits.");
+  }
+  logits_.resize(half_logits_.size());
+  for (size_t i = 0; i < half_logits_.size(); ++i) {
+    logits_[i] = element_type == ElementType::Float16
+                     ? ToFloat(Fp16{half_logits_[i]})
+                     : ToFloat(Bf16{half_logits_[i]});
+  }
+  return absl::OkStatus();
+}
+
+void PenaltySampler::ApplyPenalties(int row,
+                                    absl::Span<float> row_logits) const {
+  for (const auto& [token_id, count] : token_counts_[row]) {
+    if (token_id < 0 || token_id >= row_logits.size()) {
+      continue;
+    }
+    float& logit = row_logits[token_id];
+    if (logit > 0.0f) {
+      logit /= penalties_.repetition_penalty;
+    } else {
+      logit *= penalties_.repetition_penalty;
+    }
+    logit -= penalties_.frequency_penalty * count + penalties_.presence_penalty;
+  }
+  if (penalties_.min_p > 0.0f) {
+    // p_i / p_max = exp((logit_i - logit_max) / temperature), so the tokens
+    // below min_p are the ones below a logit threshold.
+    const float max_logit =
+        *std::max_element(row_logits.begin(), row_logits.end());
+    const float threshold =
+        max_logit + std::max(temperature_, 0.0f) * std::log(penalties_.min_p);
+    for (float& logit : row_logits) {
+      if (logit < threshold) {
+        logit = -std::numeric_limits<float>::infinity();
+      }
+    }
+  }
+}
+
+absl::Status PenaltySampler::SampleToIdAndScoreBuffer(
+    const TensorBuffer& logits_tensor, TensorBuffer& ids_tensor,
+    TensorBuffer* scores_tensor) {
+  const bool has_counts = std::any_of(
+      token_counts_.begin(), token_counts_.end(),
+      [](const auto& token_counts) { return !token_counts.empty(); });
+  if (!has_counts && penalties_.min_p == 0.0f) {
+    // Nothing to adjust, e.g. at the first step, so the logits are sampled as
+    // they are.
+    RETURN_IF_ERROR(sampler_->SampleToIdAndScoreBuffer(logits_tensor,
+                                                       ids_tensor,
+                                                       scores_tensor));
+  } else {
+    RETURN_IF_ERROR(ReadLogits(logits_tensor));
+    RET_CHECK(!logits_.empty() && logits_.size() % batch_size_ == 0)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Expected logits of shape [" << batch_size_
+        << ", vocab_size], but got " << logits_.size() << " logits.";
+    const int vocab_size = logits_.size() / batch_size_;
+    if (!logits_tensor_.has_value() ||
+        logits_tensor_->PackedSize().Value() !=
+            logits_.size() * sizeof(float)) {
+      LITERT_ASSIGN_OR_RETURN(
+          auto adjusted_logits_tensor,
+          CreateTensorBuffer<float>({batch_size_, vocab_size}));
+      logits_tensor_ = std::move(adjusted_logits_tensor);
+    }
+    for (int row = 0; row < batch_size_; ++row) {
+      if (!active_rows_[row]) {
+        continue;
+      }
+      ApplyPenalties(
+          row, absl::MakeSpan(logits_).subspan(row * vocab_size, vocab_size));
+    }
+    if (!logits_tensor_->Write(absl::MakeConstSpan(logits_))) {
+      return absl::InternalError("Failed to write the adjusted logits.");
+    }
+    RETURN_IF_ERROR(sampler_->SampleToIdAndScoreBuffer(
+        *logits_tensor_, ids_tensor, scores_tensor));
+  }
+
+  if (!ids_tensor.Read(absl::MakeSpan(sampled_ids_))) {
+    return absl::InternalError("Failed to read the sampled ids.");
+  }
+  for (int row = 0; row < batch_size_; ++row) {
+    if (active_rows_[row]) {
+      ++token_counts_[row][sampled_ids_[row]];
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,124 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_PENALTY_SAMPLER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_PENALTY_SAMPLER_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/sampler.h"
+
+namespace litert::lm {
+
+// The adjustments of the logits by the tokens a candidate has already
+// sampled, and the min-p filtering. The defaults disable all of them.
+struct SamplingPenalties {
+  // Divides the positive logits, and multiplies the negative ones, of the
+  // tokens already sampled. Must be positive, 1 disables it.
+  float repetition_penalty = 1.0f;
+  // Subtracted from the logit of a token once per time it was sampled.
+  float frequency_penalty = 0.0f;
+  // Subtracted from the logit of the tokens sampled at least once.
+  float presence_penalty = 0.0f;
+  // Drops the tokens less likely than min_p times the most likely one, after
+  // the temperature scaling. In [0, 1], 0 disables it.
+  float min_p = 0.0f;
+
+  // Whether any of the adjustments is enabled.
+  bool IsEnabled() const {
+    return repetition_penalty != 1.0f || frequency_penalty != 0.0f ||
+           presence_penalty != 0.0f || min_p != 0.0f;
+  }
+};
+
+// A sampler applying SamplingPenalties to the logits given to another one.
+//
+// Each row of the batch keeps a sparse table of the counts of the tokens it
+// has sampled, updated with each sampled token, such that a step only touches
+// the logits of the tokens seen so far rather than rescanning the history.
+class PenaltySampler : public Sampler {
+ public:
+  // - sampler: The sampler applied to the adjusted logits.
+  // - penalties: The adjustments of the logits.
+  // - temperature: The temperature of `sampler`, which min-p applies with.
+  // - batch_size: The batch size of the logits.
+  static absl::StatusOr<std::unique_ptr<PenaltySampler>> Create(
+      std::unique_ptr<Sampler> sampler, const SamplingPenalties& penalties,
+      float temperature, int batch_size);
+
+  // Samples a batch of token ids from logits of shape [batch_size,
+  // vocab_size], of float32, float16 or bfloat16 values, and counts the
+  // sampled tokens.
+  absl::Status SampleToIdAndScoreBuffer(const TensorBuffer& logits_tensor,
+                                        TensorBuffer& ids_tensor,
+                                        TensorBuffer* scores_tensor) override;
+
+  // Clears the counts of the sampled tokens, and restarts the sampler they
+  // are sampled with.
+  void Reset() override;
+
+  // The inactive rows are neither penalized nor counted, and the mask is
+  // forwarded to the sampler of the adjusted logits.
+  void SetActiveRows(const std::vector<bool>& active_rows) override;
+
+  // The top log-probabilities are those of the penalized logits.
+  absl::Status SetNumTopLogProbs(int num_top_log_probs) override {
+    return sampler_->SetNumTopLogProbs(num_top_log_probs);
+  }
+  int GetNumTopLogProbs() const override {
+    return sampler_->GetNumTopLogProbs();
+  }
+  absl::Span<const std::pair<int, float>> GetTopLogProbs(
+      int row) const override {
+    return sampler_->GetTopLogProbs(row);
+  }
+
+  // Returns the number of times `row` sampled `token_id` since the last
+  // reset.
+  int GetTokenCount(int row, int token_id) const;
+
+ private:
+  PenaltySampler(std::unique_ptr<Sampler> sampler,
+                 const SamplingPenalties& penalties, float temperature,
+                 int batch_size)
+      : sampler_(std::move(sampler)),
+        penalties_(penalties),
+        temperature_(temperature),
+        batch_size_(batch_size),
+        token_counts_(batch_size),
+        active_rows_(batch_size, true),
+        sampled_ids_(batch_size) {}
+
+  // Reads the logits of `logits_tensor` into logits_ as float32.
+  absl::Status ReadLogits(const TensorBuffer& logits_tensor);
+
+  // Applies the penalties to the logits of a row.
+  void ApplyPenalties(int row, absl::Span<float> row_logits) const;
+
+  std::unique_ptr<Sampler> sampler_;
+  const SamplingPenalties penalties_;
+  const float temperature_;
+  const int batch_size_;
+
+  // The counts of the sampled tokens, per row.
+  std::vector<absl::flat_hash_map<int, int>> token_counts_;
+  // Whether each row is still sampled.
+  std::vector<bool> active_rows_;
+
+  // The buffers of the sampling, kept across the calls such that each step
+  // only copies the logits.
+  std::vector<float> logits_;
+  std::vector<uint16_t> half_logits_;
+  std::optional<TensorBuffer> logits_tensor_;
+  std::vector<int> sampled_ids_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_PENALTY_SAMPLER_H_
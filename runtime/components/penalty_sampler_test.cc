@@ -0,0 +1,129 @@
+#include "runtime/components/penalty_sampler.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/top_p_cpu_sampler.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+std::unique_ptr<PenaltySampler> CreateSampler(
+    const SamplingPenalties& penalties, int k, int batch_size) {
+  auto top_p_sampler = TopPSampler::Create(k, /*p=*/1.0, /*temperature=*/1.0,
+                                           batch_size, /*seed=*/1);
+  EXPECT_OK(top_p_sampler);
+  auto sampler = PenaltySampler::Create(std::move(*top_p_sampler), penalties,
+                                        /*temperature=*/1.0, batch_size);
+  EXPECT_OK(sampler);
+  return std::move(*sampler);
+}
+
+// Samples a step of `sampler` from `logits` of shape [batch_size, 4].
+absl::StatusOr<std::vector<int>> Sample(PenaltySampler& sampler,
+                                        const std::vector<float>& logits) {
+  const int batch_size = logits.size() / 4;
+  auto logits_tensor = CopyToTensorBuffer<float>(logits, {batch_size, 4});
+  std::vector<int> ids_vector(batch_size);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {batch_size});
+  RETURN_IF_ERROR(sampler.SampleToIdAndScoreBuffer(
+      *logits_tensor, *ids_tensor, /*scores_tensor=*/nullptr));
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  if (!ids) {
+    return absl::InternalError("Failed to read the sampled ids.");
+  }
+  return std::move(*ids);
+}
+
+TEST(PenaltySamplerTest, PresencePenaltyPenalizesTheSampledTokens) {
+  SamplingPenalties penalties;
+  penalties.presence_penalty = 1.0f;
+  auto sampler = CreateSampler(penalties, /*k=*/1, /*batch_size=*/2);
+  const std::vector<float> logits = {3.0, 2.9, 0.0, 0.0,  //
+                                     0.0, 0.0, 0.0, 5.0};
+  ASSERT_OK_AND_ASSIGN(auto ids, Sample(*sampler, logits));
+  EXPECT_THAT(ids, testing::ElementsAre(0, 3));
+  // The penalty applies once whatever the count, so the second row keeps its
+  // token.
+  ASSERT_OK_AND_ASSIGN(ids, Sample(*sampler, logits));
+  EXPECT_THAT(ids, testing::ElementsAre(1, 3));
+  ASSERT_OK_AND_ASSIGN(ids, Sample(*sampler, logits));
+  EXPECT_THAT(ids, testing::ElementsAre(0, 3));
+  EXPECT_EQ(sampler->GetTokenCount(/*row=*/0, /*token_id=*/0), 2);
+  EXPECT_EQ(sampler->GetTokenCount(/*row=*/1, /*token_id=*/3), 3);
+  EXPECT_EQ(sampler->GetTokenCount(/*row=*/1, /*token_id=*/0), 0);
+
+  sampler->Reset();
+  EXPECT_EQ(sampler->GetTokenCount(/*row=*/0, /*token_id=*/0), 0);
+  ASSERT_OK_AND_ASSIGN(ids, Sample(*sampler, logits));
+  EXPECT_THAT(ids, testing::ElementsAre(0, 3));
+}
+
+TEST(PenaltySamplerTest, FrequencyPenaltyGrowsWithTheCount) {
+  SamplingPenalties penalties;
+  penalties.frequency_penalty = 1.0f;
+  auto sampler = CreateSampler(penalties, /*k=*/1, /*batch_size=*/1);
+  const std::vector<float> logits = {5.0, 3.5, 0.0, 0.0};
+  std::vector<int> sampled_ids;
+  for (int step = 0; step < 4; ++step) {
+    ASSERT_OK_AND_ASSIGN(auto ids, Sample(*sampler, logits));
+    sampled_ids.push_back(ids[0]);
+  }
+  // The logits of the token 0 drop to 4 and 3 after being sampled once and
+  // twice, and the token 1 to 2.5 after once.
+  EXPECT_THAT(sampled_ids, testing::ElementsAre(0, 0, 1, 0));
+}
+
+TEST(PenaltySamplerTest, RepetitionPenaltyScalesTheLogits) {
+  SamplingPenalties penalties;
+  penalties.repetition_penalty = 2.0f;
+  auto sampler = CreateSampler(penalties, /*k=*/1, /*batch_size=*/1);
+  // The positive logits are divided, the negative ones multiplied.
+  const std::vector<float> logits = {4.0, 3.0, -1.0, -1.5};
+  std::vector<int> sampled_ids;
+  for (int step = 0; step < 3; ++step) {
+    ASSERT_OK_AND_ASSIGN(auto ids, Sample(*sampler, logits));
+    sampled_ids.push_back(ids[0]);
+  }
+  EXPECT_THAT(sampled_ids, testing::ElementsAre(0, 1, 0));
+}
+
+TEST(PenaltySamplerTest, MinPDropsTheUnlikelyTokens) {
+  SamplingPenalties penalties;
+  penalties.min_p = 0.5f;
+  auto sampler = CreateSampler(penalties, /*k=*/4, /*batch_size=*/1);
+  // Only the token 3 is at least half as likely as the token 0.
+  const std::vector<float> logits = {1.0, -2.0, -2.0, 0.5};
+  for (int step = 0; step < 20; ++step) {
+    ASSERT_OK_AND_ASSIGN(auto ids, Sample(*sampler, logits));
+    EXPECT_THAT(ids, testing::ElementsAre(testing::AnyOf(0, 3)));
+  }
+}
+
+TEST(PenaltySamplerTest, CreateFailsWithInvalidPenalties) {
+  SamplingPenalties penalties;
+  penalties.repetition_penalty = 0.0f;
+  auto top_p_sampler = TopPSampler::Create(/*k=*/1, /*p=*/1.0,
+                                           /*temperature=*/1.0,
+                                           /*batch_size=*/1, /*seed=*/1);
+  ASSERT_OK(top_p_sampler);
+  EXPECT_THAT(PenaltySampler::Create(std::move(*top_p_sampler), penalties,
+                                     /*temperature=*/1.0, /*batch_size=*/1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
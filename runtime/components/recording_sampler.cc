@@ -0,0 +1,81 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/components/recording_sampler.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/decode_recording.h"
+#include "runtime/components/sampler.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/litert_status_util.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<RecordingSampler>> RecordingSampler::Create(
+    std::unique_ptr<Sampler> sampler,
+    std::shared_ptr<DecodeRecorder> recorder) {
+  RET_CHECK(sampler != nullptr && recorder != nullptr)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The sampler and the recorder must be set.";
+  return absl::WrapUnique(
+      new RecordingSampler(std::move(sampler), std::move(recorder)));
+}
+
+void RecordingSampler::Reset() {
+  sampler_->Reset();
+  last_step_end_ = absl::Now();
+}
+
+absl::Status RecordingSampler::SampleToIdAndScoreBuffer(
+    const TensorBuffer& logits_tensor, TensorBuffer& ids_tensor,
+    TensorBuffer* scores_tensor) {
+  RETURN_IF_ERROR(sampler_->SampleToIdAndScoreBuffer(logits_tensor, ids_tensor,
+                                                     scores_tensor));
+  return RecordStep(ids_tensor);
+}
+
+absl::Status RecordingSampler::SampleToIdAndScoreBufferFromTopK(
+    const TensorBuffer& topk_logits_tensor,
+    const TensorBuffer& topk_ids_tensor, TensorBuffer& ids_tensor,
+    TensorBuffer* scores_tensor) {
+  RETURN_IF_ERROR(sampler_->SampleToIdAndScoreBufferFromTopK(
+      topk_logits_tensor, topk_ids_tensor, ids_tensor, scores_tensor));
+  return RecordStep(ids_tensor);
+}
+
+absl::Status RecordingSampler::RecordStep(TensorBuffer& ids_tensor) {
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto ids,
+                               ReferTensorBufferAsSpan<int32_t>(ids_tensor));
+  RET_CHECK_EQ(ids.size(), 1).SetCode(absl::StatusCode::kUnimplemented)
+      << "Only a batch of 1 is recorded.";
+  if (recorder_->IsReplaying()) {
+    ASSIGN_OR_RETURN(ids[0], recorder_->GetReplayedTokenId());
+  }
+  const absl::Time now = absl::Now();
+  recorder_->RecordStep(ids[0], now - last_step_end_);
+  last_step_end_ = now;
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
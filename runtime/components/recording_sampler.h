@@ -0,0 +1,102 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_RECORDING_SAMPLER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_RECORDING_SAMPLER_H_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/decode_recording.h"
+#include "runtime/components/sampler.h"
+
+namespace litert::lm {
+
+// A sampler recording the ids another one samples into a DecodeRecorder,
+// with the latency of each decode step, i.e. the time from the end of the
+// previous sampling, or from Reset() for the first one. When the recorder
+// replays a recording, the sampled ids are replaced by the recorded ones,
+// such that the decode runs the same tokens through the executor. The other
+// sampler still samples, so that its cost is part of the replayed timings,
+// and the scores are those of its ids.
+//
+// Only for a batch of 1.
+class RecordingSampler : public Sampler {
+ public:
+  // - sampler: The sampler the ids are sampled with.
+  // - recorder: The recorder of the sampled ids.
+  static absl::StatusOr<std::unique_ptr<RecordingSampler>> Create(
+      std::unique_ptr<Sampler> sampler,
+      std::shared_ptr<DecodeRecorder> recorder);
+
+  absl::Status SampleToIdAndScoreBuffer(const TensorBuffer& logits_tensor,
+                                        TensorBuffer& ids_tensor,
+                                        TensorBuffer* scores_tensor) override;
+
+  int GetTopK() const override { return sampler_->GetTopK(); }
+  absl::Status SampleToIdAndScoreBufferFromTopK(
+      const TensorBuffer& topk_logits_tensor,
+      const TensorBuffer& topk_ids_tensor, TensorBuffer& ids_tensor,
+      TensorBuffer* scores_tensor) override;
+
+  void SetActiveRows(const std::vector<bool>& active_rows) override {
+    sampler_->SetActiveRows(active_rows);
+  }
+
+  absl::Status SetNumTopLogProbs(int num_top_log_probs) override {
+    return sampler_->SetNumTopLogProbs(num_top_log_probs);
+  }
+  int GetNumTopLogProbs() const override {
+    return sampler_->GetNumTopLogProbs();
+  }
+  absl::Span<const std::pair<int, float>> GetTopLogProbs(
+      int row) const override {
+    return sampler_->GetTopLogProbs(row);
+  }
+
+  absl::Status SetLogitsQuantization(float scale, int32_t zero_point) override {
+    return sampler_->SetLogitsQuantization(scale, zero_point);
+  }
+
+  // Restarts the sampler, and the timing of the first step of the decode.
+  void Reset() override;
+
+ private:
+  RecordingSampler(std::unique_ptr<Sampler> sampler,
+                   std::shared_ptr<DecodeRecorder> recorder)
+      : sampler_(std::move(sampler)),
+        recorder_(std::move(recorder)),
+        last_step_end_(absl::Now()) {}
+
+  // Replaces the sampled id of `ids_tensor` by the recorded one when
+  // replaying, and records it with the latency of the step.
+  absl::Status RecordStep(TensorBuffer& ids_tensor);
+
+  std::unique_ptr<Sampler> sampler_;
+  std::shared_ptr<DecodeRecorder> recorder_;
+  // The end of the previous step, or the last reset.
+  absl::Time last_step_end_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_RECORDING_SAMPLER_H_
@@ -0,0 +1,116 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/components/recording_sampler.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/decode_recording.h"
+#include "runtime/components/top_p_cpu_sampler.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::status::StatusIs;
+
+std::unique_ptr<RecordingSampler> CreateSampler(
+    std::shared_ptr<DecodeRecorder> recorder) {
+  // The greedy sampling makes the argmax the sampled token.
+  auto top_p_sampler =
+      TopPSampler::Create(/*k=*/1, /*p=*/1.0, /*temperature=*/1.0,
+                          /*batch_size=*/1, /*seed=*/1);
+  EXPECT_OK(top_p_sampler);
+  auto sampler =
+      RecordingSampler::Create(std::move(*top_p_sampler), std::move(recorder));
+  EXPECT_OK(sampler);
+  return std::move(*sampler);
+}
+
+// Samples a step of `sampler` from `logits` of shape [1, 4].
+absl::StatusOr<int> Sample(RecordingSampler& sampler,
+                           const std::vector<float>& logits) {
+  auto logits_tensor = CopyToTensorBuffer<float>(logits, {1, 4});
+  std::vector<int> ids_vector(1);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {1});
+  RETURN_IF_ERROR(sampler.SampleToIdAndScoreBuffer(
+      *logits_tensor, *ids_tensor, /*scores_tensor=*/nullptr));
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  if (!ids) {
+    return absl::InternalError("Failed to read the sampled ids.");
+  }
+  return (*ids)[0];
+}
+
+TEST(RecordingSamplerTest, RejectsMissingArguments) {
+  EXPECT_THAT(RecordingSampler::Create(
+                  nullptr, std::make_shared<DecodeRecorder>("params")),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(RecordingSamplerTest, RecordsTheSampledTokens) {
+  auto recorder = std::make_shared<DecodeRecorder>("params");
+  auto sampler = CreateSampler(recorder);
+  ASSERT_OK(recorder->StartTurn("Hello", {2, 3}));
+  sampler->Reset();
+  ASSERT_OK_AND_ASSIGN(int id, Sample(*sampler, {0.0, 5.0, 1.0, 2.0}));
+  EXPECT_EQ(id, 1);
+  ASSERT_OK_AND_ASSIGN(id, Sample(*sampler, {0.0, 1.0, 1.0, 7.0}));
+  EXPECT_EQ(id, 3);
+
+  const DecodeRecording recording = recorder->GetRecording();
+  ASSERT_EQ(recording.turns.size(), 1);
+  EXPECT_THAT(recording.turns[0].sampled_token_ids, ElementsAre(1, 3));
+  ASSERT_EQ(recording.turns[0].step_latencies.size(), 2);
+  EXPECT_GE(recording.turns[0].step_latencies[0], absl::ZeroDuration());
+}
+
+TEST(RecordingSamplerTest, ReplaysTheRecordedTokens) {
+  DecodeRecording recording;
+  recording.turns.push_back(DecodeRecordingTurn{
+      .prompt = "Hello",
+      .prompt_token_ids = {2, 3},
+      .sampled_token_ids = {2, 0},
+      .step_latencies = {absl::Milliseconds(10), absl::Milliseconds(10)},
+  });
+  auto recorder = std::make_shared<DecodeRecorder>(std::move(recording));
+  auto sampler = CreateSampler(recorder);
+  ASSERT_OK(recorder->StartTurn("Hello", {2, 3}));
+  sampler->Reset();
+  // The recorded ids are output whatever the logits.
+  ASSERT_OK_AND_ASSIGN(int id, Sample(*sampler, {0.0, 5.0, 1.0, 2.0}));
+  EXPECT_EQ(id, 2);
+  ASSERT_OK_AND_ASSIGN(id, Sample(*sampler, {0.0, 5.0, 1.0, 2.0}));
+  EXPECT_EQ(id, 0);
+  EXPECT_THAT(Sample(*sampler, {0.0, 5.0, 1.0, 2.0}),
+              StatusIs(absl::StatusCode::kOutOfRange));
+  EXPECT_THAT(recorder->GetRecording().turns[0].sampled_token_ids,
+              ElementsAre(2, 0));
+}
+
+}  // namespace
+}  // namespace litert::lm
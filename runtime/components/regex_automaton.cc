@@ -0,0 +1,579 @@
+#include "runtime/components/regex_automaton.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+using ByteSet = std::bitset<256>;
+
+// The largest bound of a counted repetition, which is expanded into copies of
+// the repeated expression.
+constexpr int kMaxRepeatCount = 1000;
+// The limit on the number of NFA states, such that the expansion of the
+// repetitions stays bounded.
+constexpr int kMaxNumNfaStates = 1 << 20;
+
+// A node of the parsed expression.
+struct RegexNode {
+  enum class Kind {
+    // Matches one byte of `bytes`.
+    kBytes,
+    // Matches the children one after the other, or the empty text without
+    // children.
+    kConcat,
+    // Matches any of the children.
+    kAlternate,
+    // Matches the only child [min_count, max_count] times, or at least
+    // min_count times if max_count is -1.
+    kRepeat,
+  };
+  Kind kind;
+  ByteSet bytes;
+  std::vector<RegexNode> children;
+  int min_count = 0;
+  int max_count = 0;
+};
+
+ByteSet RangeSet(uint8_t first, uint8_t last) {
+  ByteSet set;
+  for (int byte = first; byte <= last; ++byte) {
+    set.set(byte);
+  }
+  return set;
+}
+
+int HexValue(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// A recursive descent parser of the supported syntax.
+class RegexParser {
+ public:
+  explicit RegexParser(absl::string_view regex) : regex_(regex) {}
+
+  absl::StatusOr<RegexNode> Parse() {
+    // The expression always matches the whole text, so the anchors at its
+    // ends are redundant.
+    if (!regex_.empty() && regex_.front() == '^') {
+      ++pos_;
+    }
+    if (regex_.size() > pos_ && regex_.back() == '$' &&
+        !IsEscaped(regex_.size() - 1)) {
+      regex_.remove_suffix(1);
+    }
+    ASSIGN_OR_RETURN(RegexNode node, ParseAlternation());
+    if (pos_ != regex_.size()) {
+      return Error("Unexpected ')'");
+    }
+    return node;
+  }
+
+ private:
+  // Whether the character at `index` is escaped by an odd number of
+  // backslashes.
+  bool IsEscaped(size_t index) const {
+    size_t num_backslashes = 0;
+    while (index > num_backslashes &&
+           regex_[index - num_backslashes - 1] == '\\') {
+      ++num_backslashes;
+    }
+    return num_backslashes % 2 == 1;
+  }
+
+  absl::Status Error(absl::string_view message) const {
+    return absl::InvalidArgumentError(absl::StrCat(
+        message, " at position ", pos_, " of the regex: ", regex_));
+  }
+
+  bool AtEnd() const { return pos_ >= regex_.size(); }
+  char Peek() const { return regex_[pos_]; }
+
+  absl::StatusOr<RegexNode> ParseAlternation() {
+    RegexNode alternation{RegexNode::Kind::kAlternate};
+    ASSIGN_OR_RETURN(RegexNode first, ParseConcat());
+    alternation.children.push_back(std::move(first));
+    while (!AtEnd() && Peek() == '|') {
+      ++pos_;
+      ASSIGN_OR_RETURN(RegexNode next, ParseConcat());
+      alternation.children.push_back(std::move(next));
+    }
+    if (alternation.children.size() == 1) {
+      return std::move(alternation.children[0]);
+    }
+    return alternation;
+  }
+
+  absl::StatusOr<RegexNode> ParseConcat() {
+    RegexNode concat{RegexNode::Kind::kConcat};
+    while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+      ASSIGN_OR_RETURN(RegexNode atom, ParseAtom());
+      ASSIGN_OR_RETURN(atom, ParseQuantifiers(std::move(atom)));
+      concat.children.push_back(std::move(atom));
+    }
+    if (concat.children.size() == 1) {
+      return std::move(concat.children[0]);
+    }
+    return concat;
+  }
+
+  absl::StatusOr<RegexNode> ParseQuantifiers(RegexNode atom) {
+    while (!AtEnd()) {
+      int min_count = 0;
+      int max_count = -1;
+      const char c = Peek();
+      if (c == '*') {
+        ++pos_;
+      } else if (c == '+') {
+        ++pos_;
+        min_count = 1;
+      } else if (c == '?') {
+        ++pos_;
+        max_count = 1;
+      } else if (c == '{') {
+        ++pos_;
+        ASSIGN_OR_RETURN(min_count, ParseCount());
+        max_count = min_count;
+        if (!AtEnd() && Peek() == ',') {
+          ++pos_;
+          max_count = -1;
+          if (!AtEnd() && Peek() != '}') {
+            ASSIGN_OR_RETURN(max_count, ParseCount());
+          }
+        }
+        if (AtEnd() || Peek() != '}') {
+          return Error("Expected '}'");
+        }
+        ++pos_;
+        if (max_count != -1 && max_count < min_count) {
+          return Error("Invalid repetition bounds");
+        }
+      } else {
+        break;
+      }
+      RegexNode repeat{RegexNode::Kind::kRepeat};
+      repeat.min_count = min_count;
+      repeat.max_count = max_count;
+      repeat.children.push_back(std::move(atom));
+      atom = std::move(repeat);
+    }
+    return atom;
+  }
+
+  absl::StatusOr<int> ParseCount() {
+    int count = 0;
+    const size_t start = pos_;
+    while (!AtEnd() && Peek() >= '0' && Peek() <= '9') {
+      count = count * 10 + (Peek() - '0');
+      if (count > kMaxRepeatCount) {
+        return Error(
+            absl::StrCat("Repetitions are limited to ", kMaxRepeatCount));
+      }
+      ++pos_;
+    }
+    if (pos_ == start) {
+      return Error("Expected a repetition count");
+    }
+    return count;
+  }
+
+  absl::StatusOr<RegexNode> ParseAtom() {
+    RegexNode node{RegexNode::Kind::kBytes};
+    const char c = regex_[pos_++];
+    switch (c) {
+      case '(': {
+        if (regex_.substr(pos_, 2) == "?:") {
+          pos_ += 2;
+        } else if (!AtEnd() && Peek() == '?') {
+          return Error("Unsupported group");
+        }
+        ASSIGN_OR_RETURN(node, ParseAlternation());
+        if (AtEnd() || Peek() != ')') {
+          return Error("Expected ')'");
+        }
+        ++pos_;
+        return node;
+      }
+      case '[': {
+        ASSIGN_OR_RETURN(node.bytes, ParseClass());
+        return node;
+      }
+      case '.':
+        node.bytes.set();
+        node.bytes.reset('\n');
+        return node;
+      case '\\': {
+        ASSIGN_OR_RETURN(node.bytes, ParseEscape());
+        return node;
+      }
+      case '*':
+      case '+':
+      case '?':
+      case '{':
+        --pos_;
+        return Error("Nothing to repeat");
+      case '^':
+      case '$':
+        --pos_;
+        return Error("Anchors are only supported at the ends");
+      default:
+        node.bytes.set(static_cast<uint8_t>(c));
+        return node;
+    }
+  }
+
+  // Parses the escape following a backslash.
+  absl::StatusOr<ByteSet> ParseEscape() {
+    if (AtEnd()) {
+      return Error("Trailing backslash");
+    }
+    const char c = regex_[pos_++];
+    ByteSet set;
+    switch (c) {
+      case 'd':
+      case 'D':
+        set = RangeSet('0', '9');
+        break;
+      case 'w':
+      case 'W':
+        set = RangeSet('a', 'z') | RangeSet('A', 'Z') | RangeSet('0', '9');
+        set.set('_');
+        break;
+      case 's':
+      case 'S':
+        for (char space : {' ', '\t', '\n', '\r', '\f', '\v'}) {
+          set.set(static_cast<uint8_t>(space));
+        }
+        break;
+      case 'n':
+        set.set('\n');
+        return set;
+      case 'r':
+        set.set('\r');
+        return set;
+      case 't':
+        set.set('\t');
+        return set;
+      case 'f':
+        set.set('\f');
+        return set;
+      case 'v':
+        set.set('\v');
+        return set;
+      case 'x': {
+        const int high = AtEnd() ? -1 : HexValue(regex_[pos_]);
+        const int low =
+            pos_ + 1 >= regex_.size() ? -1 : HexValue(regex_[pos_ + 1]);
+        if (high < 0 || low < 0) {
+          return Error("Expected two hex digits after \\x");
+        }
+        pos_ += 2;
+        set.set(high * 16 + low);
+        return set;
+      }
+      default:
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9')) {
+          --pos_;
+          return Error("Unsupported escape");
+        }
+        set.set(static_cast<uint8_t>(c));
+        return set;
+    }
+    // The upper case classes are the negations of the lower case ones.
+    if (c >= 'A' && c <= 'Z') {
+      set.flip();
+    }
+    return set;
+  }
+
+  // Parses a bracket class following its '['.
+  absl::StatusOr<ByteSet> ParseClass() {
+    ByteSet set;
+    const bool negated = !AtEnd() && Peek() == '^';
+    if (negated) {
+      ++pos_;
+    }
+    bool first = true;
+    while (!AtEnd() && (Peek() != ']' || first)) {
+      first = false;
+      ByteSet item;
+      int single_byte = -1;
+      const char c = regex_[pos_++];
+      if (c == '\\') {
+        ASSIGN_OR_RETURN(item, ParseEscape());
+        if (item.count() == 1) {
+          for (int byte = 0; byte < 256; ++byte) {
+            if (item.test(byte)) single_byte = byte;
+          }
+        }
+      } else {
+        single_byte = static_cast<uint8_t>(c);
+        item.set(single_byte);
+      }
+      // A range, unless the '-' ends the class.
+      if (single_byte >= 0 && pos_ + 1 < regex_.size() && Peek() == '-' &&
+          regex_[pos_ + 1] != ']') {
+        ++pos_;
+        int last_byte = static_cast<uint8_t>(regex_[pos_++]);
+        if (last_byte == '\\') {
+          ASSIGN_OR_RETURN(ByteSet last, ParseEscape());
+          if (last.count() != 1) {
+            return Error("Invalid class range");
+          }
+          for (int byte = 0; byte < 256; ++byte) {
+            if (last.test(byte)) last_byte = byte;
+          }
+        }
+        if (last_byte < single_byte) {
+          return Error("Invalid class range");
+        }
+        item = RangeSet(single_byte, last_byte);
+      }
+      set |= item;
+    }
+    if (AtEnd()) {
+      return Error("Expected ']'");
+    }
+    ++pos_;
+    return negated ? ~set : set;
+  }
+
+  absl::string_view regex_;
+  size_t pos_ = 0;
+};
+
+// A state of the NFA, with a byte transition to `next` or epsilon transitions.
+struct NfaState {
+  ByteSet bytes;
+  int next = -1;
+  std::vector<int> epsilons;
+};
+
+// The states of a sub-expression, entered from `start` and left from `end`.
+struct NfaFragment {
+  int start;
+  int end;
+};
+
+// Builds the Thompson NFA of the parsed expression.
+class NfaBuilder {
+ public:
+  absl::StatusOr<NfaFragment> Build(const RegexNode& node) {
+    switch (node.kind) {
+      case RegexNode::Kind::kBytes: {
+        ASSIGN_OR_RETURN(const int start, AddState());
+        ASSIGN_OR_RETURN(const int end, AddState());
+        states_[start].bytes = node.bytes;
+        states_[start].next = end;
+        return NfaFragment{start, end};
+      }
+      case RegexNode::Kind::kConcat: {
+        ASSIGN_OR_RETURN(const int start, AddState());
+        int end = start;
+        for (const RegexNode& child : node.children) {
+          ASSIGN_OR_RETURN(NfaFragment fragment, Build(child));
+          states_[end].epsilons.push_back(fragment.start);
+          end = fragment.end;
+        }
+        return NfaFragment{start, end};
+      }
+      case RegexNode::Kind::kAlternate: {
+        ASSIGN_OR_RETURN(const int start, AddState());
+        ASSIGN_OR_RETURN(const int end, AddState());
+        for (const RegexNode& child : node.children) {
+          ASSIGN_OR_RETURN(NfaFragment fragment, Build(child));
+          states_[start].epsilons.push_back(fragment.start);
+          states_[fragment.end].epsilons.push_back(end);
+        }
+        return NfaFragment{start, end};
+      }
+      case RegexNode::Kind::kRepeat: {
+        const RegexNode& child = node.children[0];
+        ASSIGN_OR_RETURN(const int start, AddState());
+        int end = start;
+        for (int i = 0; i < node.min_count; ++i) {
+          ASSIGN_OR_RETURN(NfaFragment fragment, Build(child));
+          states_[end].epsilons.push_back(fragment.start);
+          end = fragment.end;
+        }
+        if (node.max_count == -1) {
+          // A loop back to the state the child is entered from.
+          ASSIGN_OR_RETURN(NfaFragment fragment, Build(child));
+          ASSIGN_OR_RETURN(const int loop_end, AddState());
+          states_[end].epsilons.push_back(fragment.start);
+          states_[end].epsilons.push_back(loop_end);
+          states_[fragment.end].epsilons.push_back(end);
+          return NfaFragment{start, loop_end};
+        }
+        // The optional copies, each of which can skip to the end.
+        ASSIGN_OR_RETURN(const int repeat_end, AddState());
+        for (int i = node.min_count; i < node.max_count; ++i) {
+          ASSIGN_OR_RETURN(NfaFragment fragment, Build(child));
+          states_[end].epsilons.push_back(fragment.start);
+          states_[end].epsilons.push_back(repeat_end);
+          end = fragment.end;
+        }
+        states_[end].epsilons.push_back(repeat_end);
+        return NfaFragment{start, repeat_end};
+      }
+    }
+    return absl::InternalError("Unknown regex node.");
+  }
+
+  const std::vector<NfaState>& states() const { return states_; }
+
+ private:
+  absl::StatusOr<int> AddState() {
+    if (states_.size() >= kMaxNumNfaStates) {
+      return absl::ResourceExhaustedError(
+          "The regex expands to too many states.");
+    }
+    states_.emplace_back();
+    return states_.size() - 1;
+  }
+
+  std::vector<NfaState> states_;
+};
+
+// Returns the sorted states reachable from `states` by epsilon transitions.
+std::vector<int> EpsilonClosure(const std::vector<NfaState>& nfa,
+                                std::vector<int> states,
+                                std::vector<bool>& visited) {
+  std::vector<int> closure;
+  while (!states.empty()) {
+    const int state = states.back();
+    states.pop_back();
+    if (visited[state]) {
+      continue;
+    }
+    visited[state] = true;
+    closure.push_back(state);
+    for (int next : nfa[state].epsilons) {
+      states.push_back(next);
+    }
+  }
+  for (int state : closure) {
+    visited[state] = false;
+  }
+  std::sort(closure.begin(), closure.end());
+  return closure;
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<RegexAutomaton>> RegexAutomaton::Create(
+    absl::string_view regex, int max_num_states) {
+  ASSIGN_OR_RETURN(RegexNode root, RegexParser(regex).Parse());
+  NfaBuilder builder;
+  ASSIGN_OR_RETURN(NfaFragment fragment, builder.Build(root));
+  const std::vector<NfaState>& nfa = builder.states();
+
+  // The subset construction, where each DFA state is the set of the NFA
+  // states it stands for.
+  std::vector<bool> visited(nfa.size(), false);
+  std::vector<std::vector<int>> dfa_states;
+  absl::flat_hash_map<std::vector<int>, int> dfa_state_ids;
+  dfa_states.push_back(EpsilonClosure(nfa, {fragment.start}, visited));
+  dfa_state_ids[dfa_states[0]] = 0;
+  std::vector<int> transitions;
+  for (size_t state = 0; state < dfa_states.size(); ++state) {
+    transitions.resize((state + 1) * 256, kDeadState);
+    for (int byte = 0; byte < 256; ++byte) {
+      std::vector<int> next_states;
+      for (int nfa_state : dfa_states[state]) {
+        if (nfa[nfa_state].next >= 0 && nfa[nfa_state].bytes.test(byte)) {
+          next_states.push_back(nfa[nfa_state].next);
+        }
+      }
+      if (next_states.empty()) {
+        continue;
+      }
+      std::vector<int> closure =
+          EpsilonClosure(nfa, std::move(next_states), visited);
+      auto [it, inserted] =
+          dfa_state_ids.try_emplace(closure, dfa_states.size());
+      if (inserted) {
+        RET_CHECK_LE(dfa_states.size() + 1, max_num_states)
+                .SetCode(absl::StatusCode::kResourceExhausted)
+            << "The regex needs more than " << max_num_states
+            << " states: " << regex;
+        dfa_states.push_back(std::move(closure));
+      }
+      transitions[state * 256 + byte] = it->second;
+    }
+  }
+
+  const int num_states = dfa_states.size();
+  std::vector<bool> accepting(num_states, false);
+  for (int state = 0; state < num_states; ++state) {
+    accepting[state] = std::binary_search(
+        dfa_states[state].begin(), dfa_states[state].end(), fragment.end);
+  }
+
+  // The states that cannot reach an accepting one are dead, such that a byte
+  // is only accepted if the text can still be completed into a match.
+  std::vector<std::vector<int>> predecessors(num_states);
+  for (int state = 0; state < num_states; ++state) {
+    for (int byte = 0; byte < 256; ++byte) {
+      const int next = transitions[state * 256 + byte];
+      if (next != kDeadState) {
+        predecessors[next].push_back(state);
+      }
+    }
+  }
+  std::vector<bool> live = accepting;
+  std::vector<int> pending;
+  for (int state = 0; state < num_states; ++state) {
+    if (live[state]) pending.push_back(state);
+  }
+  while (!pending.empty()) {
+    const int state = pending.back();
+    pending.pop_back();
+    for (int predecessor : predecessors[state]) {
+      if (!live[predecessor]) {
+        live[predecessor] = true;
+        pending.push_back(predecessor);
+      }
+    }
+  }
+  RET_CHECK(live[0]).SetCode(absl::StatusCode::kInvalidArgument)
+      << "The regex matches no text: " << regex;
+  for (int& next : transitions) {
+    if (next != kDeadState && !live[next]) {
+      next = kDeadState;
+    }
+  }
+  return absl::WrapUnique(
+      new RegexAutomaton(std::move(transitions), std::move(accepting)));
+}
+
+int RegexAutomaton::Next(int state, absl::string_view text) const {
+  for (char c : text) {
+    if (state == kDeadState) {
+      break;
+    }
+    state = Next(state, static_cast<uint8_t>(c));
+  }
+  return state;
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,73 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_REGEX_AUTOMATON_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_REGEX_AUTOMATON_H_
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// A deterministic automaton over bytes, compiled from a regular expression
+// that must match the whole text.
+//
+// The supported syntax is the common subset of the ECMAScript and RE2 ones:
+// literals, `.`, the `\d \w \s` classes and their negations, `\xHH` and the
+// usual control escapes, bracket classes with ranges and negation, groups
+// (capturing or not), alternation and the `* + ? {n} {n,} {n,m}` quantifiers.
+// The expression is matched byte by byte, so a non-ASCII literal matches its
+// UTF-8 encoding, and `.` or a negated class matches any single byte.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto automaton, RegexAutomaton::Create("[0-9]+"));
+//   int state = automaton->Next(automaton->GetStartState(), "42");
+//   bool matched = automaton->IsAccepting(state);
+class RegexAutomaton {
+ public:
+  // The state reached from any state by a byte that cannot lead to a match.
+  static constexpr int kDeadState = -1;
+  // The default limit on the number of states, past which the expression is
+  // rejected rather than taking unbounded time and memory to compile.
+  static constexpr int kDefaultMaxNumStates = 1 << 14;
+
+  static absl::StatusOr<std::unique_ptr<RegexAutomaton>> Create(
+      absl::string_view regex, int max_num_states = kDefaultMaxNumStates);
+
+  int GetStartState() const { return 0; }
+  int GetNumStates() const { return accepting_.size(); }
+
+  // Returns the state after `byte` from `state`, which must not be dead.
+  int Next(int state, uint8_t byte) const {
+    return transitions_[static_cast<size_t>(state) * 256 + byte];
+  }
+  // Returns the state after all the bytes of `text` from `state`, or
+  // kDeadState as soon as one of them cannot lead to a match.
+  int Next(int state, absl::string_view text) const;
+
+  // Whether the text read up to `state` matches the whole expression.
+  bool IsAccepting(int state) const {
+    return state != kDeadState && accepting_[state];
+  }
+
+  // Whether the whole `text` matches the expression.
+  bool Matches(absl::string_view text) const {
+    return IsAccepting(Next(GetStartState(), text));
+  }
+
+ private:
+  RegexAutomaton(std::vector<int> transitions, std::vector<bool> accepting)
+      : transitions_(std::move(transitions)),
+        accepting_(std::move(accepting)) {}
+
+  // The next state of each state and byte, 256 per state.
+  std::vector<int> transitions_;
+  std::vector<bool> accepting_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_REGEX_AUTOMATON_H_
@@ -0,0 +1,75 @@
+#include "runtime/components/regex_automaton.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+TEST(RegexAutomatonTest, MatchesWholeText) {
+  ASSERT_OK_AND_ASSIGN(auto automaton, RegexAutomaton::Create("ab|cd"));
+  EXPECT_TRUE(automaton->Matches("ab"));
+  EXPECT_TRUE(automaton->Matches("cd"));
+  EXPECT_FALSE(automaton->Matches("abcd"));
+  EXPECT_FALSE(automaton->Matches("a"));
+  EXPECT_FALSE(automaton->Matches(""));
+}
+
+TEST(RegexAutomatonTest, Quantifiers) {
+  ASSERT_OK_AND_ASSIGN(auto automaton,
+                       RegexAutomaton::Create("a*b+c?d{2}e{1,2}f{2,}"));
+  EXPECT_TRUE(automaton->Matches("bddeff"));
+  EXPECT_TRUE(automaton->Matches("aabbbcddeeffff"));
+  EXPECT_FALSE(automaton->Matches("ddeff"));
+  EXPECT_FALSE(automaton->Matches("bdeff"));
+  EXPECT_FALSE(automaton->Matches("bddeeeff"));
+  EXPECT_FALSE(automaton->Matches("bddef"));
+}
+
+TEST(RegexAutomatonTest, ClassesAndEscapes) {
+  ASSERT_OK_AND_ASSIGN(
+      auto automaton,
+      RegexAutomaton::Create(R"(^[a-c\d_-]+\.[^"\\]\x41\s?(?:\w|\[)$)"));
+  EXPECT_TRUE(automaton->Matches("a1_-.xA z"));
+  EXPECT_TRUE(automaton->Matches("cc.\xc3" "A["));
+  EXPECT_FALSE(automaton->Matches("d.xAz"));
+  EXPECT_FALSE(automaton->Matches("a.\"Az"));
+  EXPECT_FALSE(automaton->Matches("a.xBz"));
+}
+
+TEST(RegexAutomatonTest, DeadStateOnceNoMatchIsPossible) {
+  ASSERT_OK_AND_ASSIGN(auto automaton, RegexAutomaton::Create("\"[0-9]+\""));
+  const int state = automaton->Next(automaton->GetStartState(), "\"12");
+  EXPECT_NE(state, RegexAutomaton::kDeadState);
+  EXPECT_FALSE(automaton->IsAccepting(state));
+  EXPECT_TRUE(automaton->IsAccepting(automaton->Next(state, '"')));
+  EXPECT_EQ(automaton->Next(state, 'x'), RegexAutomaton::kDeadState);
+  EXPECT_EQ(automaton->Next(state, "\"3"), RegexAutomaton::kDeadState);
+}
+
+TEST(RegexAutomatonTest, CreateRejectsInvalidRegex) {
+  EXPECT_THAT(RegexAutomaton::Create("(ab"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(RegexAutomaton::Create("ab)"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(RegexAutomaton::Create("*a"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(RegexAutomaton::Create("[z-a]"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(RegexAutomaton::Create("a{3,2}"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(RegexAutomaton::Create("[^\\x00-\\xff]"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(RegexAutomatonTest, CreateRejectsTooManyStates) {
+  EXPECT_THAT(RegexAutomaton::Create("[ab]*a[ab]{12}", /*max_num_states=*/64),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -1,7 +1,13 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SAMPLER_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SAMPLER_H_
 
+#include <cstdint>
+#include <utility>
+#include <vector>
+
 #include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 
 namespace litert::lm {
@@ -20,6 +26,84 @@ class Sampler {
   virtual absl::Status SampleToIdAndScoreBuffer(
       const TensorBuffer& logits_tensor, TensorBuffer& ids_tensor,
       TensorBuffer* scores_tensor) = 0;
+
+  // Returns k if the sampler only looks at the k largest logits of each batch,
+  // in which case it also accepts them in the compact form through
+  // SampleToIdAndScoreBufferFromTopK(). Returns 0 if it needs all the logits.
+  virtual int GetTopK() const { return 0; }
+
+  // Same as SampleToIdAndScoreBuffer(), but given only the top-k logits of
+  // each batch in `topk_logits_tensor` and their token ids in
+  // `topk_ids_tensor`, both of shape [batch_size, k], in any order.
+  virtual absl::Status SampleToIdAndScoreBufferFromTopK(
+      const TensorBuffer& topk_logits_tensor,
+      const TensorBuffer& topk_ids_tensor, TensorBuffer& ids_tensor,
+      TensorBuffer* scores_tensor) {
+    return absl::UnimplementedError(
+        "Sampling from the top-k logits is not supported.");
+  }
+
+  // Marks the rows of the batch whose sampled ids are still used, e.g. once the
+  // other candidates reached their stop tokens, such that the sampler may
+  // skip the others. The ids and scores of the skipped rows are unspecified.
+  // Reset() makes all the rows active again.
+  virtual void SetActiveRows(const std::vector<bool>& active_rows) {}
+
+  // Returns the token ids the sampled sequence is bound to continue with, up
+  // to `max_num_tokens` of them, and advances the sampler over them as if they
+  // were sampled, e.g. the fixed keys and punctuation of a constrained JSON
+  // output. The decoding prefills them at once instead of sampling them one by
+  // one. Only for a batch of 1; returns no token by default.
+  virtual absl::StatusOr<std::vector<int>> TakeForcedTokenIds(
+      int max_num_tokens) {
+    return std::vector<int>();
+  }
+
+  // Makes the next calls also keep the `num_top_log_probs` most likely tokens
+  // of each row with their log-probabilities, found in the same pass over the
+  // logits as the sampling, to be read by GetTopLogProbs(). 0 turns it off.
+  // Returns UnimplementedError if the sampler cannot report them.
+  virtual absl::Status SetNumTopLogProbs(int num_top_log_probs) {
+    if (num_top_log_probs == 0) {
+      return absl::OkStatus();
+    }
+    return absl::UnimplementedError(
+        "The sampler does not report the top log-probabilities.");
+  }
+
+  // Returns the number set by SetNumTopLogProbs().
+  virtual int GetNumTopLogProbs() const { return 0; }
+
+  // Returns the most likely tokens of `row` at the last call, from the most
+  // likely, as (token id, log-probability) pairs. The entries past the
+  // candidates of the sampler have the token id -1.
+  virtual absl::Span<const std::pair<int, float>> GetTopLogProbs(
+      int row) const {
+    return {};
+  }
+
+  // Makes the next calls accept int8 and int16 logits, e.g. of a model with
+  // quantized activations, whose values are scale * (logit - zero_point).
+  // Returns UnimplementedError if the sampler only takes float logits.
+  virtual absl::Status SetLogitsQuantization(float scale, int32_t zero_point) {
+    return absl::UnimplementedError(
+        "The sampler does not sample quantized logits.");
+  }
+
+  // Restarts the state the sampler keeps about the sequences sampled so far,
+  // at the start of the decoding of new responses.
+  virtual void Reset() {}
+
+  // Reconfigures the sampler in place with the top-k `k`, the top-p `p`, the
+  // `temperature` and the `seed`, as if it was created again with them: the
+  // random streams restart from `seed` and Reset() is applied. Returns
+  // UnimplementedError if the sampler cannot be reconfigured, in which case a
+  // new one has to be created.
+  virtual absl::Status Reconfigure(int k, float p, float temperature,
+                                   int seed) {
+    return absl::UnimplementedError(
+        "The sampler cannot be reconfigured in place.");
+  }
 };
 
 }  // namespace litert::lm
@@ -1,12 +1,16 @@
 #include "runtime/components/sampler_factory.h"
 
 #include <cstdlib>
+#include <limits>
 #include <memory>
 #include <optional>
+#include <string>
 #include <utility>
+#include <vector>
 
-#include "absl/base/attributes.h"  // from @com_google_absl
+#include "absl/algorithm/container.h"  // from @com_google_absl
 #include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
 #include "absl/cleanup/cleanup.h"  // from @com_google_absl
 #include "absl/log/absl_check.h"  // from @com_google_absl
 #include "absl/log/absl_log.h"  // from @com_google_absl
@@ -14,12 +18,18 @@
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
 #include "litert/c/litert_common.h"  // from @litert
+#include "litert/c/litert_tensor_buffer_types.h"  // from @litert
 #include "litert/cc/litert_shared_library.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/penalty_sampler.h"
 #include "runtime/components/sampler.h"
+#include "runtime/components/sampling_cpu_util.h"
 #include "runtime/components/top_p_cpu_sampler.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/framework/threadpool.h"
 #include "runtime/proto/sampler_params.pb.h"
 #include "runtime/util/litert_status_util.h"
 #include "runtime/util/status_macros.h"  // IWYU pragma: keep
@@ -95,8 +105,9 @@ class TopKOpenClCApiSampler : public Sampler {
                                        &sampler_params, &sampler, &error_msg);
     RETURN_IF_ERROR(CreateStatusAndFreeErrorMsg(error_code, error_msg));
     ABSL_CHECK(sampler);
-    return absl::WrapUnique(
-        new TopKOpenClCApiSampler(std::move(capi), sampler));
+    return absl::WrapUnique(new TopKOpenClCApiSampler(
+        std::move(capi), sampler, env, batch_size, vocab_size,
+        activation_data_type, std::move(sampler_params)));
   }
 
   ~TopKOpenClCApiSampler() override { capi_->destroy_func(sampler_); }
@@ -115,6 +126,36 @@ class TopKOpenClCApiSampler : public Sampler {
     return CreateStatusAndFreeErrorMsg(error_code, error_msg);
   }
 
+  // The C API cannot update a sampler, so a new one is created from the
+  // loaded library, unless both the old and new parameters are greedy and
+  // the same, in which case there is no random stream to restart.
+  absl::Status Reconfigure(int k, float p, float temperature,
+                           int seed) override {
+    if (k == 1 && sampler_params_.k() == 1 && p == sampler_params_.p() &&
+        temperature == sampler_params_.temperature() &&
+        seed == sampler_params_.seed()) {
+      return absl::OkStatus();
+    }
+    proto::SamplerParameters sampler_params = sampler_params_;
+    sampler_params.set_k(k);
+    sampler_params.set_p(p);
+    sampler_params.set_temperature(temperature);
+    sampler_params.set_seed(seed);
+    LiteRtTopKOpenClSampler_Sampler* sampler = nullptr;
+    char* error_msg = nullptr;
+    int error_code = capi_->create_func(
+        env_, batch_size_, vocab_size_,
+        activation_data_type_.has_value() ? &activation_data_type_.value()
+                                          : nullptr,
+        &sampler_params, &sampler, &error_msg);
+    RETURN_IF_ERROR(CreateStatusAndFreeErrorMsg(error_code, error_msg));
+    ABSL_CHECK(sampler);
+    capi_->destroy_func(sampler_);
+    sampler_ = sampler;
+    sampler_params_ = std::move(sampler_params);
+    return absl::OkStatus();
+  }
+
  private:
   using LiteRtTopKOpenClSampler_Create =
       int (*)(LiteRtEnvironment env, int batch_size, int vocab_size,
@@ -150,8 +191,17 @@ class TopKOpenClCApiSampler : public Sampler {
   };
 
   TopKOpenClCApiSampler(std::unique_ptr<TopKOpenClSamplerCApi> capi,
-                        LiteRtTopKOpenClSampler_Sampler* sampler)
-      : capi_(std::move(capi)), sampler_(sampler) {}
+                        LiteRtTopKOpenClSampler_Sampler* sampler,
+                        LiteRtEnvironment env, int batch_size, int vocab_size,
+                        std::optional<ActivationDataType> activation_data_type,
+                        proto::SamplerParameters sampler_params)
+      : capi_(std::move(capi)),
+        sampler_(sampler),
+        env_(env),
+        batch_size_(batch_size),
+        vocab_size_(vocab_size),
+        activation_data_type_(activation_data_type),
+        sampler_params_(std::move(sampler_params)) {}
 
   static absl::StatusOr<std::unique_ptr<TopKOpenClSamplerCApi>>
   GetTopKOpenClSamplerCApi() {
@@ -206,20 +256,67 @@ class TopKOpenClCApiSampler : public Sampler {
   }
 
   std::unique_ptr<TopKOpenClSamplerCApi> capi_;
-  LiteRtTopKOpenClSampler_Sampler* const sampler_;
+  LiteRtTopKOpenClSampler_Sampler* sampler_;
+  // The arguments the sampler was created with, to create it again in
+  // Reconfigure().
+  const LiteRtEnvironment env_;
+  const int batch_size_;
+  const int vocab_size_;
+  const std::optional<ActivationDataType> activation_data_type_;
+  proto::SamplerParameters sampler_params_;
 };
 
+bool HasLogitBiases(const proto::SamplerParameters& sampler_params) {
+  return !sampler_params.logit_biases().empty() ||
+         !sampler_params.banned_token_ids().empty() ||
+         sampler_params.restrict_to_logit_biases();
+}
+
+absl::StatusOr<LogitBiases> GetLogitBiases(
+    const proto::SamplerParameters& sampler_params) {
+  std::vector<std::pair<int, float>> biases;
+  biases.reserve(sampler_params.logit_biases_size() +
+                 sampler_params.banned_token_ids_size());
+  for (const auto& logit_bias : sampler_params.logit_biases()) {
+    biases.push_back({logit_bias.token_id(), logit_bias.bias()});
+  }
+  for (int token_id : sampler_params.banned_token_ids()) {
+    biases.push_back({token_id, -std::numeric_limits<float>::infinity()});
+  }
+  return CreateLogitBiases(std::move(biases),
+                           sampler_params.restrict_to_logit_biases());
+}
+
 absl::StatusOr<std::unique_ptr<Sampler>> CreateCpuSampler(
-    int batch_size, proto::SamplerParameters sampler_params) {
+    int batch_size, proto::SamplerParameters sampler_params,
+    ThreadPool* absl_nullable thread_pool) {
   switch (sampler_params.type()) {
     case proto::SamplerParameters::TYPE_UNSPECIFIED:
       ABSL_LOG(INFO) << "Sampler type is unspecified. Assume the LLM Executor "
                         "handles the sampling logic.";
       return nullptr;
-    case proto::SamplerParameters::TOP_P:
-      return TopPSampler::Create(sampler_params.k(), sampler_params.p(),
-                                 sampler_params.temperature(), batch_size,
-                                 sampler_params.seed());
+    case proto::SamplerParameters::TOP_P: {
+      ASSIGN_OR_RETURN(LogitBiases logit_biases,
+                       GetLogitBiases(sampler_params));
+      ASSIGN_OR_RETURN(
+          std::unique_ptr<Sampler> sampler,
+          TopPSampler::Create(sampler_params.k(), sampler_params.p(),
+                              sampler_params.temperature(), batch_size,
+                              sampler_params.seed(), thread_pool,
+                              std::move(logit_biases)));
+      SamplingPenalties penalties;
+      if (sampler_params.has_repetition_penalty()) {
+        penalties.repetition_penalty = sampler_params.repetition_penalty();
+      }
+      penalties.frequency_penalty = sampler_params.frequency_penalty();
+      penalties.presence_penalty = sampler_params.presence_penalty();
+      penalties.min_p = sampler_params.min_p();
+      if (!penalties.IsEnabled()) {
+        return sampler;
+      }
+      return PenaltySampler::Create(std::move(sampler), penalties,
+                                    sampler_params.temperature(), batch_size);
+    }
     default:
       return absl::UnimplementedError(absl::StrCat(
           "Sampler type: ", sampler_params.type(), " not implemented yet."));
@@ -227,45 +324,189 @@ absl::StatusOr<std::unique_ptr<Sampler>> CreateCpuSampler(
 }
 
 absl::StatusOr<std::unique_ptr<Sampler>> CreateOpenClSampler(
-    int batch_size, proto::SamplerParameters sampler_params,
-    LiteRtEnvironment env, int vocab_size,
-    std::optional<ActivationDataType> activation_data_type) {
-  return TopKOpenClCApiSampler::Create(env, batch_size, vocab_size,
-                                       activation_data_type, sampler_params);
+    const SamplerPluginArgs& args) {
+  // The OpenCL sampler only takes the top-k, top-p and temperature, so the
+  // logit biases are applied by the CPU sampler.
+  if (HasLogitBiases(args.sampler_params)) {
+    return absl::UnavailableError(
+        "The OpenCL sampler does not apply logit biases.");
+  }
+  RET_CHECK(args.env != nullptr)
+      << "LiteRT environment is needed for GPU sampling.";
+  RET_CHECK(args.vocab_size.has_value())
+      << "Vocabulary size is needed for GPU sampling.";
+  auto sampler_or = TopKOpenClCApiSampler::Create(
+      args.env, args.batch_size, *args.vocab_size, args.activation_data_type,
+      args.sampler_params);
+  if (!sampler_or.ok() &&
+      sampler_or.status().code() == absl::StatusCode::kUnavailable) {
+    return absl::UnavailableError(absl::StrCat(
+        sampler_or.status().message(),
+        " To use GPU sampling, please make sure libLiteRtTopKOpenClSampler.so "
+        "is available at LD_LIBRARY_PATH on device. You can find the shared "
+        "library under prebuilt/"));
+  }
+  return std::move(sampler_or);
 }
+
+bool Matches(const SamplerPlugin& plugin, Backend backend,
+             std::optional<LiteRtTensorBufferType> logits_buffer_type,
+             std::optional<ActivationDataType> logits_data_type) {
+  if (plugin.backend != backend) {
+    return false;
+  }
+  if (logits_buffer_type.has_value() && !plugin.logits_buffer_types.empty() &&
+      absl::c_find(plugin.logits_buffer_types, *logits_buffer_type) ==
+          plugin.logits_buffer_types.end()) {
+    return false;
+  }
+  return !logits_data_type.has_value() || plugin.logits_data_types.empty() ||
+         absl::c_find(plugin.logits_data_types, *logits_data_type) !=
+             plugin.logits_data_types.end();
+}
+
+// The registered sampler plugins, starting with the built-in ones.
+class SamplerPluginRegistry {
+ public:
+  static SamplerPluginRegistry& Get() {
+    static SamplerPluginRegistry* registry = new SamplerPluginRegistry();
+    return *registry;
+  }
+
+  absl::Status Register(SamplerPlugin plugin) ABSL_LOCKS_EXCLUDED(mutex_) {
+    RET_CHECK(plugin.create != nullptr)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The sampler plugin " << plugin.name << " has no create function.";
+    absl::MutexLock lock(&mutex_);
+    if (FindLocked(plugin.name) != plugins_.end()) {
+      return absl::AlreadyExistsError(absl::StrCat(
+          "A sampler plugin named ", plugin.name, " is already registered."));
+    }
+    plugins_.push_back(std::move(plugin));
+    return absl::OkStatus();
+  }
+
+  absl::Status Unregister(absl::string_view name) ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    auto it = FindLocked(name);
+    if (it == plugins_.end()) {
+      return absl::NotFoundError(
+          absl::StrCat("No sampler plugin named ", name, " is registered."));
+    }
+    plugins_.erase(it);
+    return absl::OkStatus();
+  }
+
+  bool HasBackend(Backend backend) const ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    return absl::c_any_of(plugins_, [backend](const SamplerPlugin& plugin) {
+      return plugin.backend == backend;
+    });
+  }
+
+  // Returns copies of the matching plugins, such that they are created
+  // without holding the lock.
+  std::vector<SamplerPlugin> GetMatching(
+      Backend backend, std::optional<LiteRtTensorBufferType> logits_buffer_type,
+      std::optional<ActivationDataType> logits_data_type) const
+      ABSL_LOCKS_EXCLUDED(mutex_) {
+    absl::MutexLock lock(&mutex_);
+    std::vector<SamplerPlugin> matching;
+    for (const SamplerPlugin& plugin : plugins_) {
+      if (Matches(plugin, backend, logits_buffer_type, logits_data_type)) {
+        matching.push_back(plugin);
+      }
+    }
+    return matching;
+  }
+
+ private:
+  SamplerPluginRegistry() {
+    SamplerPlugin cpu_plugin;
+    cpu_plugin.name = "cpu_top_p";
+    cpu_plugin.backend = Backend::CPU;
+    cpu_plugin.create = [](const SamplerPluginArgs& args) {
+      return CreateCpuSampler(args.batch_size, args.sampler_params,
+                              args.thread_pool);
+    };
+    plugins_.push_back(std::move(cpu_plugin));
+
+    SamplerPlugin opencl_plugin;
+    opencl_plugin.name = "opencl_top_k";
+    opencl_plugin.backend = Backend::GPU;
+    opencl_plugin.logits_buffer_types = {
+        kLiteRtTensorBufferTypeOpenClBuffer,
+        kLiteRtTensorBufferTypeOpenClBufferFp16,
+        kLiteRtTensorBufferTypeOpenClBufferPacked};
+    opencl_plugin.logits_data_types = {ActivationDataType::FLOAT32,
+                                       ActivationDataType::FLOAT16};
+    opencl_plugin.create = CreateOpenClSampler;
+    plugins_.push_back(std::move(opencl_plugin));
+  }
+
+  std::vector<SamplerPlugin>::iterator FindLocked(absl::string_view name)
+      ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return absl::c_find_if(plugins_, [name](const SamplerPlugin& plugin) {
+      return plugin.name == name;
+    });
+  }
+
+  mutable absl::Mutex mutex_;
+  std::vector<SamplerPlugin> plugins_ ABSL_GUARDED_BY(mutex_);
+};
+
 }  // namespace
 
+absl::Status RegisterSamplerPlugin(SamplerPlugin plugin) {
+  return SamplerPluginRegistry::Get().Register(std::move(plugin));
+}
+
+absl::Status UnregisterSamplerPlugin(absl::string_view name) {
+  return SamplerPluginRegistry::Get().Unregister(name);
+}
+
+std::vector<std::string> GetMatchingSamplerPlugins(
+    Backend backend, std::optional<LiteRtTensorBufferType> logits_buffer_type,
+    std::optional<ActivationDataType> logits_data_type) {
+  std::vector<std::string> names;
+  for (const SamplerPlugin& plugin : SamplerPluginRegistry::Get().GetMatching(
+           backend, logits_buffer_type, logits_data_type)) {
+    names.push_back(plugin.name);
+  }
+  return names;
+}
+
 absl::StatusOr<std::unique_ptr<Sampler>> CreateSampler(
     Backend backend, int batch_size, proto::SamplerParameters sampler_params,
     LiteRtEnvironment env, std::optional<int> vocab_size,
-    std::optional<ActivationDataType> activation_data_type) {
-  switch (backend) {
-    case Backend::GPU: {
-      RET_CHECK(env != nullptr)
-          << "LiteRT environment is needed for GPU sampling.";
-      RET_CHECK(vocab_size.has_value())
-          << "Vocabulary size is needed for GPU sampling.";
-      auto sampler_or =
-          CreateOpenClSampler(batch_size, sampler_params, env,
-                              vocab_size.value(), activation_data_type);
-      if (sampler_or.ok() ||
-          sampler_or.status().code() != absl::StatusCode::kUnavailable) {
-        // For a normal failure or success, return the result.
-        return sampler_or;
-      }
+    std::optional<ActivationDataType> activation_data_type,
+    ThreadPool* absl_nullable thread_pool,
+    std::optional<LiteRtTensorBufferType> logits_buffer_type) {
+  SamplerPluginRegistry& registry = SamplerPluginRegistry::Get();
+  if (!registry.HasBackend(backend)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unsupported backend: ", backend));
+  }
+  const SamplerPluginArgs args{batch_size, sampler_params, env, vocab_size,
+                               activation_data_type, thread_pool};
+  for (const SamplerPlugin& plugin : registry.GetMatching(
+           backend, logits_buffer_type, activation_data_type)) {
+    auto sampler_or = plugin.create(args);
+    if (sampler_or.ok() ||
+        sampler_or.status().code() != absl::StatusCode::kUnavailable) {
+      // For a normal failure or success, return the result.
+      return sampler_or;
     }
-      // For a failure due to GPU sampler unavailable, fall back to CPU.
-      ABSL_LOG(WARNING)
-          << "GPU sampler unavailable. Falling back to CPU sampling. To use "
-             "GPU sampling, please make sure libLiteRtTopKOpenClSampler.so is "
-             "available at LD_LIBRARY_PATH on device. You can find the shared "
-             "library under prebuilt/";
-      ABSL_FALLTHROUGH_INTENDED;
-    case Backend::CPU:
-      return CreateCpuSampler(batch_size, sampler_params);
-    default:
-      return absl::InvalidArgumentError(
-          absl::StrCat("Unsupported backend: ", backend));
+    ABSL_LOG(INFO) << "Sampler plugin " << plugin.name
+                   << " unavailable: " << sampler_or.status().message();
+  }
+  if (backend == Backend::CPU) {
+    return absl::UnavailableError("No CPU sampler is available.");
   }
+  // If no sampler of the backend can sample the logits, fall back to CPU.
+  ABSL_LOG(WARNING) << "No " << backend
+                    << " sampler available for the logits. Falling back to "
+                       "CPU sampling.";
+  return CreateCpuSampler(batch_size, sampler_params, thread_pool);
 }
 }  // namespace litert::lm
@@ -1,17 +1,72 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SAMPLER_FACTORY_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SAMPLER_FACTORY_H_
 
+#include <functional>
 #include <memory>
 #include <optional>
+#include <string>
+#include <vector>
 
+#include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
 #include "litert/c/litert_common.h"  // from @litert
+#include "litert/c/litert_tensor_buffer_types.h"  // from @litert
 #include "runtime/components/sampler.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/framework/threadpool.h"
 #include "runtime/proto/sampler_params.pb.h"
 
 namespace litert::lm {
 
+// The arguments a sampler plugin is created with. See CreateSampler() below.
+struct SamplerPluginArgs {
+  int batch_size;
+  const proto::SamplerParameters& sampler_params;
+  LiteRtEnvironment env;
+  std::optional<int> vocab_size;
+  std::optional<ActivationDataType> activation_data_type;
+  ThreadPool* absl_nullable thread_pool;
+};
+
+// A sampler implementation that can be registered for a backend, e.g. a
+// Vulkan, Metal, WebGPU or NPU-resident sampler linked in as a plugin.
+struct SamplerPlugin {
+  // The unique name of the plugin, e.g. "opencl_top_k".
+  std::string name;
+  // The backend the plugin samples on.
+  Backend backend;
+  // The locations and data types of the logits the plugin reads without
+  // copies. Empty means any.
+  std::vector<LiteRtTensorBufferType> logits_buffer_types;
+  std::vector<ActivationDataType> logits_data_types;
+  // Creates the sampler. Returns an Unavailable error if the plugin cannot
+  // sample here, e.g. its library is missing or it lacks a sampling option,
+  // so that the next matching plugin is tried.
+  std::function<absl::StatusOr<std::unique_ptr<Sampler>>(
+      const SamplerPluginArgs& args)>
+      create;
+};
+
+// Registers a sampler plugin for CreateSampler(). The plugins of a backend are
+// tried in the order they are registered, after the built-in ones. Returns an
+// AlreadyExists error if a plugin of the same name is registered. It is
+// thread-safe, and may be called from a static initializer.
+absl::Status RegisterSamplerPlugin(SamplerPlugin plugin);
+
+// Unregisters the sampler plugin of `name`. Returns a NotFound error if there
+// is none.
+absl::Status UnregisterSamplerPlugin(absl::string_view name);
+
+// Returns the names of the registered plugins of `backend` that can read the
+// logits of `logits_buffer_type` and `logits_data_type`, in the order they
+// are tried. An unset location or data type matches any.
+std::vector<std::string> GetMatchingSamplerPlugins(
+    Backend backend,
+    std::optional<LiteRtTensorBufferType> logits_buffer_type = std::nullopt,
+    std::optional<ActivationDataType> logits_data_type = std::nullopt);
+
 // Creates a Sampler instance based on the provided parameters.
 //
 // Args:
@@ -22,6 +77,17 @@ namespace litert::lm {
 //   env: The litert environment to use for the sampler.
 //   vocab_size: The vocabulary size for the sampler.
 //   activation_data_type: The activation data type for the sampler.
+//   The following parameter is optional and only used for CPU backend.
+//   thread_pool: The pool the candidates of the batch are sampled on in
+//     parallel. It must not be the pool the sampler is called from.
+//
+//   The following parameter is optional.
+//   logits_buffer_type: Where the logits to sample are. If set, only the
+//     plugins that can read them in place are used.
+//
+// The sampler is created by the first registered plugin of `backend` that
+// matches the logits and is available. Falls back to the CPU sampler if there
+// is none.
 //
 // Returns:
 //   The created Sampler instance.
@@ -29,7 +95,9 @@ absl::StatusOr<std::unique_ptr<Sampler>> CreateSampler(
     Backend backend, int batch_size, proto::SamplerParameters sampler_params,
     LiteRtEnvironment env = nullptr,
     std::optional<int> vocab_size = std::nullopt,
-    std::optional<ActivationDataType> activation_data_type = std::nullopt);
+    std::optional<ActivationDataType> activation_data_type = std::nullopt,
+    ThreadPool* absl_nullable thread_pool = nullptr,
+    std::optional<LiteRtTensorBufferType> logits_buffer_type = std::nullopt);
 
 }  // namespace litert::lm
 
@@ -13,6 +13,7 @@
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
 #include "litert/c/litert_common.h"  // from @litert
+#include "litert/c/litert_tensor_buffer_types.h"  // from @litert
 #include "litert/cc/litert_compiled_model.h"  // from @litert
 #include "litert/cc/litert_environment.h"  // from @litert
 #include "litert/cc/litert_expected.h"  // from @litert
@@ -20,6 +21,7 @@
 #include "litert/cc/options/litert_gpu_options.h"  // from @litert
 #include "runtime/components/model_resources.h"
 #include "runtime/components/model_resources_task.h"
+#include "runtime/components/sampler.h"
 #include "runtime/components/top_p_cpu_sampler.h"
 #include "runtime/executor/executor_settings_base.h"
 #include "runtime/proto/sampler_params.pb.h"
@@ -31,7 +33,9 @@
 namespace litert::lm {
 namespace {
 
+using ::testing::ElementsAre;
 using ::testing::HasSubstr;
+using ::testing::IsEmpty;
 using ::testing::status::StatusIs;
 
 TEST(SamplerFactoryTest, CreateSamplerForCpuWorksCorrectly) {
@@ -77,5 +81,86 @@ TEST(SamplerFactoryTest,
   EXPECT_EQ(sampler, nullptr);
 }
 
+proto::SamplerParameters GreedySamplerParams() {
+  proto::SamplerParameters sampler_params;
+  sampler_params.set_k(1);
+  sampler_params.set_p(0.0);
+  sampler_params.set_temperature(1.0);
+  sampler_params.set_seed(12345);
+  sampler_params.set_type(proto::SamplerParameters::TOP_P);
+  return sampler_params;
+}
+
+SamplerPlugin CreateFakeNpuPlugin(absl::string_view name,
+                                  absl::StatusCode create_code) {
+  SamplerPlugin plugin;
+  plugin.name = std::string(name);
+  plugin.backend = Backend::NPU;
+  plugin.logits_buffer_types = {kLiteRtTensorBufferTypeHostMemory};
+  plugin.create = [create_code](const SamplerPluginArgs& args)
+      -> absl::StatusOr<std::unique_ptr<Sampler>> {
+    if (create_code != absl::StatusCode::kOk) {
+      return absl::Status(create_code, "Fake plugin error.");
+    }
+    return TopPSampler::Create(/*k=*/1, /*p=*/0.0f, /*temperature=*/1.0f,
+                               args.batch_size, /*seed=*/0);
+  };
+  return plugin;
+}
+
+TEST(SamplerFactoryTest, CreateSamplerUsesTheRegisteredPlugins) {
+  EXPECT_THAT(CreateSampler(Backend::NPU, /*batch_size=*/1,
+                            GreedySamplerParams()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  ASSERT_OK(RegisterSamplerPlugin(
+      CreateFakeNpuPlugin("unavailable", absl::StatusCode::kUnavailable)));
+  ASSERT_OK(RegisterSamplerPlugin(
+      CreateFakeNpuPlugin("available", absl::StatusCode::kOk)));
+  EXPECT_THAT(RegisterSamplerPlugin(
+                  CreateFakeNpuPlugin("available", absl::StatusCode::kOk)),
+              StatusIs(absl::StatusCode::kAlreadyExists));
+  EXPECT_THAT(GetMatchingSamplerPlugins(Backend::NPU),
+              ElementsAre("unavailable", "available"));
+  EXPECT_THAT(GetMatchingSamplerPlugins(Backend::NPU,
+                                        kLiteRtTensorBufferTypeOpenClBuffer),
+              IsEmpty());
+
+  // The unavailable plugin is skipped.
+  ASSERT_OK_AND_ASSIGN(
+      auto sampler,
+      CreateSampler(Backend::NPU, /*batch_size=*/1, GreedySamplerParams(),
+                    /*env=*/nullptr, /*vocab_size=*/std::nullopt,
+                    /*activation_data_type=*/std::nullopt,
+                    /*thread_pool=*/nullptr,
+                    kLiteRtTensorBufferTypeHostMemory));
+  EXPECT_NE(dynamic_cast<TopPSampler*>(sampler.get()), nullptr);
+
+  ASSERT_OK(UnregisterSamplerPlugin("available"));
+  ASSERT_OK(UnregisterSamplerPlugin("unavailable"));
+  EXPECT_THAT(UnregisterSamplerPlugin("available"),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(SamplerFactoryTest, CreateSamplerForGpuSamplesHostLogitsOnCpu) {
+  EXPECT_THAT(GetMatchingSamplerPlugins(Backend::GPU,
+                                        kLiteRtTensorBufferTypeOpenClBuffer,
+                                        ActivationDataType::FLOAT16),
+              ElementsAre("opencl_top_k"));
+  EXPECT_THAT(GetMatchingSamplerPlugins(Backend::GPU,
+                                        kLiteRtTensorBufferTypeHostMemory),
+              IsEmpty());
+
+  // No GPU sampler reads host logits, so no environment is needed.
+  ASSERT_OK_AND_ASSIGN(
+      auto sampler,
+      CreateSampler(Backend::GPU, /*batch_size=*/1, GreedySamplerParams(),
+                    /*env=*/nullptr, /*vocab_size=*/std::nullopt,
+                    /*activation_data_type=*/std::nullopt,
+                    /*thread_pool=*/nullptr,
+                    kLiteRtTensorBufferTypeHostMemory));
+  EXPECT_NE(dynamic_cast<TopPSampler*>(sampler.get()), nullptr);
+}
+
 }  // namespace
 }  // namespace litert::lm
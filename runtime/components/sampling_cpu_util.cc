@@ -1,14 +1,27 @@
 #include "runtime/components/sampling_cpu_util.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <limits>
 #include <numeric>
 #include <random>
+#include <utility>
 #include <vector>
 
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define LITERT_LM_SAMPLING_X86_DISPATCH 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LITERT_LM_SAMPLING_NEON 1
+#endif
+
+#include "absl/random/distributions.h"  // from @com_google_absl
 #include "absl/random/random.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
@@ -17,6 +30,628 @@
 #include "absl/types/span.h"  // from @com_google_absl
 
 namespace litert::lm {
+namespace {
+
+// The number of values whose max is computed with vector ops before being
+// compared with the running max, such that only the chunk holding the max is
+// scanned again for its index.
+constexpr int kArgMaxChunkSize = 256;
+
+// The top-k is selected with a heap of size k when k is small in front of the
+// vocab, such that most of the logits are skipped by the vectorized threshold
+// scan, and with std::nth_element otherwise.
+constexpr int kHeapTopKMaxRatio = 16;
+
+float ToFloat(float value) { return value; }
+
+// The kernels selected at runtime for the CPU in use, for logits of type T.
+// The half-precision logits are only widened to float in registers.
+template <typename T>
+struct SamplingKernels {
+  // Returns the max of values[0, n), n > 0.
+  float (*max)(const T* values, int n);
+  // Returns the first index in [start, n) whose value is greater than
+  // `threshold`, or n if there is none.
+  int (*find_greater)(const T* values, int start, int n, float threshold);
+};
+
+template <typename T>
+float MaxScalar(const T* values, int n) {
+  float max_value = ToFloat(values[0]);
+  for (int i = 1; i < n; ++i) {
+    max_value = std::max(max_value, ToFloat(values[i]));
+  }
+  return max_value;
+}
+
+template <typename T>
+int FindGreaterScalar(const T* values, int start, int n, float threshold) {
+  for (int i = start; i < n; ++i) {
+    if (ToFloat(values[i]) > threshold) {
+      return i;
+    }
+  }
+  return n;
+}
+
+#if defined(LITERT_LM_SAMPLING_X86_DISPATCH)
+
+__attribute__((target("avx2,f16c"))) inline __m256 LoadAvx2(
+    const float* values) {
+  return _mm256_loadu_ps(values);
+}
+
+__attribute__((target("avx2,f16c"))) inline __m256 LoadAvx2(
+    const Fp16* values) {
+  return _mm256_cvtph_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(values)));
+}
+
+__attribute__((target("avx2,f16c"))) inline __m256 LoadAvx2(
+    const Bf16* values) {
+  // The bfloat16 bits are the upper half of the float bits.
+  return _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_cvtepu16_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(values))),
+      16));
+}
+
+template <typename T>
+__attribute__((target("avx2,f16c"))) float MaxAvx2(const T* values, int n) {
+  int i = 0;
+  float max_value = ToFloat(values[0]);
+  if (n >= 8) {
+    __m256 max_v = LoadAvx2(values);
+    for (i = 8; i + 8 <= n; i += 8) {
+      max_v = _mm256_max_ps(max_v, LoadAvx2(values + i));
+    }
+    __m128 max_4 = _mm_max_ps(_mm256_castps256_ps128(max_v),
+                              _mm256_extractf128_ps(max_v, 1));
+    max_4 = _mm_max_ps(max_4, _mm_movehl_ps(max_4, max_4));
+    max_4 = _mm_max_ss(max_4, _mm_shuffle_ps(max_4, max_4, 1));
+    max_value = _mm_cvtss_f32(max_4);
+  }
+  for (; i < n; ++i) {
+    max_value = std::max(max_value, ToFloat(values[i]));
+  }
+  return max_value;
+}
+
+template <typename T>
+__attribute__((target("avx2,f16c"))) int FindGreaterAvx2(const T* values,
+                                                         int start, int n,
+                                                         float threshold) {
+  const __m256 threshold_v = _mm256_set1_ps(threshold);
+  int i = start;
+  for (; i + 8 <= n; i += 8) {
+    const int mask = _mm256_movemask_ps(
+        _mm256_cmp_ps(LoadAvx2(values + i), threshold_v, _CMP_GT_OQ));
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return FindGreaterScalar(values, i, n, threshold);
+}
+
+__attribute__((target("avx512f"))) inline __m512 LoadAvx512(
+    const float* values) {
+  return _mm512_loadu_ps(values);
+}
+
+__attribute__((target("avx512f"))) inline __m512 LoadAvx512(
+    const Fp16* values) {
+  return _mm512_cvtph_ps(
+      _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values)));
+}
+
+__attribute__((target("avx512f"))) inline __m512 LoadAvx512(
+    const Bf16* values) {
+  return _mm512_castsi512_ps(_mm512_slli_epi32(
+      _mm512_cvtepu16_epi32(
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values))),
+      16));
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) float MaxAvx512(const T* values, int n) {
+  int i = 0;
+  float max_value = ToFloat(values[0]);
+  if (n >= 16) {
+    __m512 max_v = LoadAvx512(values);
+    for (i = 16; i + 16 <= n; i += 16) {
+      max_v = _mm512_max_ps(max_v, LoadAvx512(values + i));
+    }
+    max_value = _mm512_reduce_max_ps(max_v);
+  }
+  for (; i < n; ++i) {
+    max_value = std::max(max_value, ToFloat(values[i]));
+  }
+  return max_value;
+}
+
+template <typename T>
+__attribute__((target("avx512f"))) int FindGreaterAvx512(const T* values,
+                                                         int start, int n,
+                                                         float threshold) {
+  const __m512 threshold_v = _mm512_set1_ps(threshold);
+  int i = start;
+  for (; i + 16 <= n; i += 16) {
+    const __mmask16 mask =
+        _mm512_cmp_ps_mask(LoadAvx512(values + i), threshold_v, _CMP_GT_OQ);
+    if (mask != 0) {
+      return i + __builtin_ctz(mask);
+    }
+  }
+  return FindGreaterScalar(values, i, n, threshold);
+}
+
+#elif defined(LITERT_LM_SAMPLING_NEON)
+
+inline float32x4_t LoadNeon(const float* values) { return vld1q_f32(values); }
+
+inline float32x4_t LoadNeon(const Fp16* values) {
+  return vcvt_f32_f16(vreinterpret_f16_u16(
+      vld1_u16(reinterpret_cast<const uint16_t*>(values))));
+}
+
+inline float32x4_t LoadNeon(const Bf16* values) {
+  // The bfloat16 bits are the upper half of the float bits.
+  return vreinterpretq_f32_u32(
+      vshll_n_u16(vld1_u16(reinterpret_cast<const uint16_t*>(values)), 16));
+}
+
+template <typename T>
+float MaxNeon(const T* values, int n) {
+  int i = 0;
+  float max_value = ToFloat(values[0]);
+  if (n >= 4) {
+    float32x4_t max_v = LoadNeon(values);
+    for (i = 4; i + 4 <= n; i += 4) {
+      max_v = vmaxq_f32(max_v, LoadNeon(values + i));
+    }
+    max_value = vmaxvq_f32(max_v);
+  }
+  for (; i < n; ++i) {
+    max_value = std::max(max_value, ToFloat(values[i]));
+  }
+  return max_value;
+}
+
+template <typename T>
+int FindGreaterNeon(const T* values, int start, int n, float threshold) {
+  const float32x4_t threshold_v = vdupq_n_f32(threshold);
+  int i = start;
+  for (; i + 4 <= n; i += 4) {
+    if (vmaxvq_u32(vcgtq_f32(LoadNeon(values + i), threshold_v)) != 0) {
+      return FindGreaterScalar(values, i, i + 4, threshold);
+    }
+  }
+  return FindGreaterScalar(values, i, n, threshold);
+}
+
+#endif
+
+template <typename T>
+SamplingKernels<T> SelectSamplingKernels() {
+#if defined(LITERT_LM_SAMPLING_X86_DISPATCH)
+  if (__builtin_cpu_supports("avx512f")) {
+    return {MaxAvx512<T>, FindGreaterAvx512<T>};
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")) {
+    return {MaxAvx2<T>, FindGreaterAvx2<T>};
+  }
+#elif defined(LITERT_LM_SAMPLING_NEON)
+  return {MaxNeon<T>, FindGreaterNeon<T>};
+#endif
+  return {MaxScalar<T>, FindGreaterScalar<T>};
+}
+
+template <typename T>
+const SamplingKernels<T>& GetSamplingKernels() {
+  static const SamplingKernels<T> kernels = SelectSamplingKernels<T>();
+  return kernels;
+}
+
+// Whether candidate `a` comes before `b` from the most likely, the ties broken
+// towards the smaller indices.
+bool IsMoreLikely(const std::pair<float, int>& a,
+                  const std::pair<float, int>& b) {
+  return a.first > b.first || (a.first == b.first && a.second < b.second);
+}
+
+// Leaves the k largest values with their indices in `heap`, in no particular
+// order. Ties are broken towards the smaller indices.
+template <typename T>
+void HeapTopK(const T* values, int n, int k,
+              std::vector<std::pair<float, int>>& heap) {
+  const SamplingKernels<T>& kernels = GetSamplingKernels<T>();
+  // A min-heap of the k largest values seen so far, whose top is the
+  // threshold that the remaining values must exceed.
+  heap.resize(k);
+  for (int i = 0; i < k; ++i) {
+    heap[i] = {ToFloat(values[i]), i};
+  }
+  // Among equal values, the larger index is evicted first.
+  auto greater = [](const std::pair<float, int>& a,
+                    const std::pair<float, int>& b) {
+    return a.first > b.first || (a.first == b.first && a.second < b.second);
+  };
+  std::make_heap(heap.begin(), heap.end(), greater);
+  for (int i = kernels.find_greater(values, k, n, heap.front().first); i < n;
+       i = kernels.find_greater(values, i + 1, n, heap.front().first)) {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    heap.back() = {ToFloat(values[i]), i};
+    std::push_heap(heap.begin(), heap.end(), greater);
+  }
+}
+
+// Leaves the k largest values with their indices in `scratch.candidates`,
+// sorted from the largest, with ties towards the smaller indices.
+template <typename T>
+void SortedTopK(const T* values, int n, int k, TopKTopPScratch& scratch) {
+  auto& candidates = scratch.candidates;
+  if (static_cast<int64_t>(k) * kHeapTopKMaxRatio <= n) {
+    HeapTopK(values, n, k, candidates);
+  } else {
+    auto& indices = scratch.indices;
+    indices.resize(n);
+    std::iota(indices.begin(), indices.end(), 0);
+    std::nth_element(indices.begin(), indices.begin() + k - 1, indices.end(),
+                     [values](int i1, int i2) {
+                       const float v1 = ToFloat(values[i1]);
+                       const float v2 = ToFloat(values[i2]);
+                       return v1 > v2 || (v1 == v2 && i1 < i2);
+                     });
+    candidates.resize(k);
+    for (int i = 0; i < k; ++i) {
+      candidates[i] = {ToFloat(values[indices[i]]), indices[i]};
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), IsMoreLikely);
+}
+
+// Leaves the k largest biased values with their indices in
+// `scratch.candidates`, sorted as by SortedTopK(). Only the values of the
+// biased indices, and of the k + |biases| largest ones without
+// restrict_vocab, are read.
+template <typename T>
+absl::Status BiasedTopK(const T* values, int n, int k,
+                        const LogitBiases& logit_biases,
+                        TopKTopPScratch& scratch) {
+  auto& candidates = scratch.candidates;
+  const auto& biases = logit_biases.biases;
+  if (logit_biases.restrict_vocab) {
+    candidates.clear();
+  } else {
+    // The k largest unbiased values are among the k + |biases| largest ones.
+    SortedTopK(values, n,
+               static_cast<int>(std::min<int64_t>(
+                   n, static_cast<int64_t>(k) + biases.size())),
+               scratch);
+    auto is_biased = [&biases](const std::pair<float, int>& candidate) {
+      auto it = std::lower_bound(
+          biases.begin(), biases.end(), candidate.second,
+          [](const std::pair<int, float>& bias, int index) {
+            return bias.first < index;
+          });
+      return it != biases.end() && it->first == candidate.second;
+    };
+    candidates.erase(
+        std::remove_if(candidates.begin(), candidates.end(), is_biased),
+        candidates.end());
+    if (static_cast<int>(candidates.size()) > k) {
+      candidates.resize(k);
+    }
+  }
+  for (const auto& [index, bias] : biases) {
+    if (index >= n) {
+      continue;
+    }
+    const float value = ToFloat(values[index]) + bias;
+    // The banned tokens are left out.
+    if (value > -std::numeric_limits<float>::infinity()) {
+      candidates.push_back({value, index});
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(), IsMoreLikely);
+  if (static_cast<int>(candidates.size()) > k) {
+    candidates.resize(k);
+  }
+  if (candidates.empty()) {
+    return absl::InvalidArgumentError(
+        "The logit biases leave no token to sample.");
+  }
+  return absl::OkStatus();
+}
+
+template <typename T>
+int ArgMaxImpl(absl::Span<const T> values) {
+  const SamplingKernels<T>& kernels = GetSamplingKernels<T>();
+  const int n = values.size();
+  int max_chunk_start = 0;
+  float max_value = -std::numeric_limits<float>::infinity();
+  for (int start = 0; start < n; start += kArgMaxChunkSize) {
+    const float chunk_max = kernels.max(
+        values.data() + start, std::min(kArgMaxChunkSize, n - start));
+    // Strictly greater, such that the first max wins as in std::max_element.
+    if (start == 0 || chunk_max > max_value) {
+      max_value = chunk_max;
+      max_chunk_start = start;
+    }
+  }
+  const int max_chunk_end = std::min(max_chunk_start + kArgMaxChunkSize, n);
+  for (int i = max_chunk_start; i < max_chunk_end; ++i) {
+    if (ToFloat(values[i]) == max_value) {
+      return i;
+    }
+  }
+  return max_chunk_start;
+}
+
+// One block of the Philox4x32-10 counter-based generator (Salmon et al.,
+// "Parallel random numbers: as easy as 1, 2, 3"), i.e. 4 random words derived
+// from `counter` and `key` alone, so that the noise of each logit is computed
+// independently of the others, without a generator state to carry.
+std::array<uint32_t, 4> Philox4x32(std::array<uint32_t, 4> counter,
+                                   uint64_t key) {
+  constexpr uint32_t kMultiplier0 = 0xD2511F53;
+  constexpr uint32_t kMultiplier1 = 0xCD9E8D57;
+  constexpr uint32_t kWeyl0 = 0x9E3779B9;
+  constexpr uint32_t kWeyl1 = 0xBB67AE85;
+  uint32_t key0 = static_cast<uint32_t>(key);
+  uint32_t key1 = static_cast<uint32_t>(key >> 32);
+  for (int round = 0; round < 10; ++round) {
+    const uint64_t product0 = static_cast<uint64_t>(kMultiplier0) * counter[0];
+    const uint64_t product1 = static_cast<uint64_t>(kMultiplier1) * counter[2];
+    counter = {static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key0,
+               static_cast<uint32_t>(product1),
+               static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key1,
+               static_cast<uint32_t>(product0)};
+    key0 += kWeyl0;
+    key1 += kWeyl1;
+  }
+  return counter;
+}
+
+// Samples an index of values[0, n) from the softmax of the values at the
+// temperature with the Gumbel-max trick, i.e. the argmax of the scaled values
+// perturbed by Gumbel noise, in a single pass without sorting the values nor
+// normalizing their exps. The noise of values[i] comes from the Philox block
+// i / 4 of `key`. Also sets `max_value` to the max of the values.
+template <typename T>
+int GumbelMaxSample(const T* values, int n, float temperature, uint64_t key,
+                    float& max_value) {
+  const SamplingKernels<float>& kernels = GetSamplingKernels<float>();
+  const float inverse_temperature = 1.0f / temperature;
+  // The perturbed values of a chunk, whose max is taken with vector ops.
+  float perturbed[kArgMaxChunkSize];
+  static_assert(kArgMaxChunkSize % 4 == 0);
+  int sampled = 0;
+  float sampled_value = -std::numeric_limits<float>::infinity();
+  max_value = -std::numeric_limits<float>::infinity();
+  for (int start = 0; start < n; start += kArgMaxChunkSize) {
+    const int size = std::min(kArgMaxChunkSize, n - start);
+    for (int i = 0; i < size; i += 4) {
+      const std::array<uint32_t, 4> words = Philox4x32(
+          {static_cast<uint32_t>((start + i) / 4), 0, 0, 0}, key);
+      for (int j = 0; j < 4 && i + j < size; ++j) {
+        const float value = ToFloat(values[start + i + j]);
+        max_value = std::max(max_value, value);
+        // Uniform in (0, 1) from the 23 high bits, exact in float, so never 0
+        // nor 1.
+        const float uniform = ((words[j] >> 9) + 0.5f) * 0x1p-23f;
+        perturbed[i + j] =
+            value * inverse_temperature - std::log(-std::log(uniform));
+      }
+    }
+    const float chunk_max = kernels.max(perturbed, size);
+    if (chunk_max > sampled_value) {
+      sampled_value = chunk_max;
+      sampled = start + (std::find(perturbed, perturbed + size, chunk_max) -
+                         perturbed);
+    }
+  }
+  return sampled;
+}
+
+template <typename T>
+absl::Status FusedTopKTopPSamplingImpl(
+    absl::Span<const T> logits, int k, float p, float temperature,
+    absl::BitGen& rng, int batch_size, TopKTopPScratch& scratch,
+    absl::Span<int> sampled_ids, absl::Span<float> sampled_scores,
+    const LogitBiases* logit_biases,
+    absl::Span<std::pair<int, float>> top_log_probs) {
+  if (logits.empty()) {
+    return absl::InvalidArgumentError("Logits vector cannot be empty.");
+  }
+  if (batch_size <= 0 || logits.size() % batch_size != 0) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Logits vector size must be a multiple of batch "
+                        "size. But got %d and "
+                        "%d.",
+                        logits.size(), batch_size));
+  }
+  if (k <= 0) {
+    return absl::InvalidArgumentError("k must be greater than 0.");
+  }
+  if (p < 0.0 || p > 1.0) {
+    return absl::InvalidArgumentError("p must be in the range [0.0, 1.0].");
+  }
+  if (temperature <= 0.0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Temperature must be positive, but got ", temperature));
+  }
+  if (static_cast<int>(sampled_ids.size()) != batch_size ||
+      static_cast<int>(sampled_scores.size()) != batch_size) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "The sampled ids and scores must hold %d entries, but got %d and %d.",
+        batch_size, sampled_ids.size(), sampled_scores.size()));
+  }
+  if (top_log_probs.size() % batch_size != 0) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "The top log-probabilities must hold a multiple of %d entries, but "
+        "got %d.",
+        batch_size, top_log_probs.size()));
+  }
+  const int vocab_size = logits.size() / batch_size;
+  // Ensure k is not larger than the number of probabilities
+  k = std::min(k, vocab_size);
+  temperature = std::max(temperature, std::numeric_limits<float>::epsilon());
+  const int num_top = top_log_probs.size() / batch_size;
+  // Greedy sampling selects the top-n to report them, and takes the first.
+  const bool greedy_top = k == 1 && num_top > 1;
+
+  const bool has_biases = logit_biases != nullptr && !logit_biases->empty();
+  for (int b = 0; b < batch_size; ++b) {
+    const T* row = logits.data() + b * vocab_size;
+    if (has_biases) {
+      absl::Status status =
+          BiasedTopK(row, vocab_size, k, *logit_biases, scratch);
+      if (!status.ok()) {
+        return status;
+      }
+    } else if (k == 1 && !greedy_top) {  // Greedy sampling.
+      sampled_ids[b] = ArgMaxImpl(absl::MakeConstSpan(row, vocab_size));
+      sampled_scores[b] = 1.0f;
+      if (num_top == 1) {
+        top_log_probs[b] = {sampled_ids[b], 0.0f};
+      }
+      continue;
+    } else if (k == vocab_size && p >= 1.0f && num_top == 0) {
+      // Pure temperature sampling over the whole vocab, which needs neither
+      // the sorted survivors nor their probabilities.
+      float max_logit;
+      const int sampled = GumbelMaxSample(row, vocab_size, temperature,
+                                          absl::Uniform<uint64_t>(rng),
+                                          max_logit);
+      sampled_ids[b] = sampled;
+      // The score is relative to the max logit, as from Softmax().
+      sampled_scores[b] =
+          std::exp((ToFloat(row[sampled]) - max_logit) / temperature);
+      continue;
+    } else {
+      // The only pass over the logits, after which the k survivors are sorted
+      // from the most likely.
+      SortedTopK(row, vocab_size,
+                 greedy_top ? std::min(num_top, vocab_size) : k, scratch);
+    }
+    const auto& candidates = scratch.candidates;
+    // Fewer than k when the biases ban or restrict the tokens.
+    const int num_candidates = candidates.size();
+    const int num_sampled = greedy_top && !has_biases ? 1 : num_candidates;
+    const float max_logit = candidates[0].first;
+
+    // The softmax of the survivors, relative to the max logit, such that the
+    // sum is in [1, k] and neither underflows nor overflows.
+    auto& probabilities = scratch.probabilities;
+    probabilities.resize(num_candidates);
+    double sum_of_exps = 0.0;
+    double sum_of_all_exps = 0.0;
+    for (int i = 0; i < num_candidates; ++i) {
+      probabilities[i] =
+          std::exp((candidates[i].first - max_logit) / temperature);
+      if (i < num_sampled) {
+        sum_of_exps += probabilities[i];
+      }
+      sum_of_all_exps += probabilities[i];
+    }
+    if (num_top > 0) {
+      const float log_sum_of_exps = std::log(sum_of_all_exps);
+      auto row_top_log_probs = top_log_probs.subspan(b * num_top, num_top);
+      for (int i = 0; i < num_top; ++i) {
+        if (i < num_candidates) {
+          row_top_log_probs[i] = {
+              candidates[i].second,
+              (candidates[i].first - max_logit) / temperature -
+                  log_sum_of_exps};
+        } else {
+          row_top_log_probs[i] = {-1, -std::numeric_limits<float>::infinity()};
+        }
+      }
+    }
+
+    // The smallest prefix of the survivors holding at least p of the mass.
+    double nucleus_sum = 0.0;
+    int nucleus_size = 0;
+    while (nucleus_size < num_sampled) {
+      nucleus_sum += probabilities[nucleus_size++] / sum_of_exps;
+      if (nucleus_sum >= p) {
+        break;
+      }
+    }
+
+    std::uniform_real_distribution<double> dist(0.0, nucleus_sum);
+    const double random_sample = dist(rng);
+    double cumulative_prob = 0.0;
+    // Falls back to the last survivor of the nucleus on rounding errors.
+    int sampled = nucleus_size - 1;
+    for (int i = 0; i < nucleus_size; ++i) {
+      cumulative_prob += probabilities[i] / sum_of_exps;
+      if (random_sample <= cumulative_prob) {
+        sampled = i;
+        break;
+      }
+    }
+    sampled_ids[b] = candidates[sampled].second;
+    // The score is relative to the max logit, as from Softmax().
+    sampled_scores[b] = probabilities[sampled];
+  }
+  return absl::OkStatus();
+}
+
+template <typename T>
+void DequantizeLogitsImpl(absl::Span<const T> logits, float scale,
+                          int32_t zero_point, absl::Span<float> output) {
+  // A single multiply-add per logit, which the compiler vectorizes.
+  const float offset = -scale * zero_point;
+  const size_t n = std::min(logits.size(), output.size());
+  for (size_t i = 0; i < n; ++i) {
+    output[i] = scale * logits[i] + offset;
+  }
+}
+
+}  // namespace
+
+float ToFloat(Fp16 value) {
+  const uint32_t sign = static_cast<uint32_t>(value.bits & 0x8000) << 16;
+  const uint32_t exponent = (value.bits >> 10) & 0x1f;
+  const uint32_t mantissa = value.bits & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0x1f) {  // Infinity or NaN.
+    bits = sign | 0x7f800000 | (mantissa << 13);
+  } else if (exponent != 0) {  // Normal, rebiased from 15 to 127.
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else {  // Zero or subnormal, i.e. mantissa * 2^-24.
+    const float magnitude = static_cast<float>(mantissa) / (1 << 24);
+    return sign != 0 ? -magnitude : magnitude;
+  }
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+float ToFloat(Bf16 value) {
+  const uint32_t bits = static_cast<uint32_t>(value.bits) << 16;
+  float result;
+  std::memcpy(&result, &bits, sizeof(result));
+  return result;
+}
+
+void DequantizeLogits(absl::Span<const int8_t> logits, float scale,
+                      int32_t zero_point, absl::Span<float> output) {
+  DequantizeLogitsImpl(logits, scale, zero_point, output);
+}
+
+void DequantizeLogits(absl::Span<const int16_t> logits, float scale,
+                      int32_t zero_point, absl::Span<float> output) {
+  DequantizeLogitsImpl(logits, scale, zero_point, output);
+}
+
+int ArgMax(absl::Span<const float> values) { return ArgMaxImpl(values); }
+
+int ArgMax(absl::Span<const Fp16> values) { return ArgMaxImpl(values); }
+
+int ArgMax(absl::Span<const Bf16> values) { return ArgMaxImpl(values); }
 
 absl::StatusOr<std::vector<int>> TopKIndicies(absl::Span<const float> logits,
                                               int k, int batch_size) {
@@ -28,16 +663,22 @@ absl::StatusOr<std::vector<int>> TopKIndicies(absl::Span<const float> logits,
                         logits.size(), batch_size));
   }
   const int vocab_size = logits.size() / batch_size;
+  if (k <= 0 || k > vocab_size) {
+    return absl::InvalidArgumentError(absl::StrFormat(
+        "k must be in the range [1, %d], but got %d.", vocab_size, k));
+  }
   std::vector<int> output_indices(batch_size * k);
-  if (k == 1) {  // Greedy sampling. Use std::max_element to be more efficient.
+  if (k == 1) {  // Greedy sampling.
     for (int b = 0; b < batch_size; ++b) {
-      auto max_iterator =
-          std::max_element(logits.begin() + b * vocab_size,
-                           logits.begin() + (b + 1) * vocab_size);
-      // Gets the index of the max element in the logits of each batch.
-      const int max_logit_idx =
-          std::distance(logits.begin() + b * vocab_size, max_iterator);
-      output_indices[b] = max_logit_idx;
+      output_indices[b] = ArgMax(logits.subspan(b * vocab_size, vocab_size));
+    }
+  } else if (static_cast<int64_t>(k) * kHeapTopKMaxRatio <= vocab_size) {
+    std::vector<std::pair<float, int>> heap;
+    for (int b = 0; b < batch_size; ++b) {
+      HeapTopK(logits.data() + b * vocab_size, vocab_size, k, heap);
+      for (int i = 0; i < k; ++i) {
+        output_indices[b * k + i] = heap[i].second;
+      }
     }
   } else {
     std::vector<int> indices(vocab_size);
@@ -136,101 +777,72 @@ absl::StatusOr<std::vector<float>> Softmax(
 absl::StatusOr<std::vector<int>> TopKTopPSampling(
     absl::Span<const float> logits, int k, float p, float temperature,
     absl::BitGen& rng, int batch_size, std::vector<float>& sampled_scores) {
-  if (logits.empty()) {
-    return absl::InvalidArgumentError("Logits vector cannot be empty.");
-  }
-  if (logits.size() % batch_size != 0) {
-    return absl::InvalidArgumentError(
-        absl::StrFormat("Logits vector size must be a multiple of batch "
-                        "size. But got %d and "
-                        "%d.",
-                        logits.size(), batch_size));
-  }
-  if (k <= 0) {
-    return absl::InvalidArgumentError("k must be greater than 0.");
-  }
-  if (p < 0.0 || p > 1.0) {
-    return absl::InvalidArgumentError("p must be in the range [0.0, 1.0].");
-  }
-  const int vocab_size = logits.size() / batch_size;
-  // Ensure k is not larger than the number of probabilities
-  k = std::min(k, vocab_size);
-
-  auto topk_indices = TopKIndicies(logits, k, batch_size);
-  if (!topk_indices.ok()) return topk_indices.status();
-
-  std::vector<float> max_logit_values;
-  auto probabilities =
-      Softmax(logits, *topk_indices, temperature, batch_size, max_logit_values);
-  if (!probabilities.ok()) return probabilities.status();
+  std::vector<int> sampled_ids(batch_size > 0 ? batch_size : 0);
+  sampled_scores.resize(sampled_ids.size());
+  TopKTopPScratch scratch;
+  auto status =
+      FusedTopKTopPSampling(logits, k, p, temperature, rng, batch_size,
+                            scratch, absl::MakeSpan(sampled_ids),
+                            absl::MakeSpan(sampled_scores));
+  if (!status.ok()) return status;
+  return sampled_ids;
+}
 
-  std::vector<int> sampled_ids;
-  if (k == 1) {  // Greedy sampling. Return the topk_indices directly.
-    sampled_ids.assign(topk_indices->begin(), topk_indices->end());
-    sampled_scores = std::vector<float>(batch_size, 1.0f);
-    return sampled_ids;
+absl::StatusOr<LogitBiases> CreateLogitBiases(
+    std::vector<std::pair<int, float>> biases, bool restrict_vocab) {
+  std::sort(biases.begin(), biases.end(),
+            [](const std::pair<int, float>& a, const std::pair<int, float>& b) {
+              return a.first < b.first;
+            });
+  LogitBiases logit_biases;
+  logit_biases.restrict_vocab = restrict_vocab;
+  for (const auto& [token_id, bias] : biases) {
+    if (token_id < 0) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "The token ids of the logit biases must not be negative, but got ",
+          token_id));
+    }
+    if (!logit_biases.biases.empty() &&
+        logit_biases.biases.back().first == token_id) {
+      logit_biases.biases.back().second += bias;
+    } else {
+      logit_biases.biases.push_back({token_id, bias});
+    }
   }
-  sampled_ids.resize(batch_size);
-  sampled_scores.resize(batch_size);
-  for (int b = 0; b < batch_size; ++b) {
-    // Define the comparator for descending probability
-    auto desc_prob_comp = [&probabilities, k, b](int i1, int i2) {
-      return (*probabilities)[b * k + i1] > (*probabilities)[b * k + i2];
-    };
-
-    // Sort Only the Top-K.
-    // O(k log k) time complexity.
-    // Sorts only the first k indices, which now correspond to the top k
-    // probabilities.
-    std::sort((*topk_indices).begin() + b * k,
-              (*topk_indices).begin() + (b * 1) * k, desc_prob_comp);
-
-    // Determine Top-P Cutoff Index within Top-K.
-    // O(k) time complexity.
-    double cumulative_prob = 0.0;
-    double nucleus_sum = 0.0;
-    int final_nucleus_size = 0;  // Actual number of elements to sample from
+  return logit_biases;
+}
 
-    for (int i = 0; i < k; ++i) {
-      // Check if adding this probability would exceed the threshold p. It
-      // stops when cumulative_prob >= p.
-      cumulative_prob += (*probabilities)[b * k + i];
-      nucleus_sum += (*probabilities)[b * k + i];
-      final_nucleus_size = i + 1;  // Include this element
-
-      if (cumulative_prob >= p) {
-        break;  // Found the smallest set within Top-K satisfying Top-P
-      }
-    }
-    // final_nucleus_size now holds min(p_cutoff_within_top_k, k)
+absl::Status FusedTopKTopPSampling(
+    absl::Span<const float> logits, int k, float p, float temperature,
+    absl::BitGen& rng, int batch_size, TopKTopPScratch& scratch,
+    absl::Span<int> sampled_ids, absl::Span<float> sampled_scores,
+    const LogitBiases* logit_biases,
+    absl::Span<std::pair<int, float>> top_log_probs) {
+  return FusedTopKTopPSamplingImpl(logits, k, p, temperature, rng, batch_size,
+                                   scratch, sampled_ids, sampled_scores,
+                                   logit_biases, top_log_probs);
+}
 
-    // Handle Edge Case: Zero Nucleus Sum.
-    if (nucleus_sum <= std::numeric_limits<double>::epsilon()) {
-      // Fallback: Return the index with the absolute highest probability
-      // (indices[0] after sorting top-k).
-      sampled_ids[b] = (*topk_indices)[b * k];
-      sampled_scores[b] = std::exp(
-          (logits[b * vocab_size + sampled_ids[b]] - max_logit_values[b]) /
-          temperature);
-      continue;
-    }
+absl::Status FusedTopKTopPSampling(
+    absl::Span<const Fp16> logits, int k, float p, float temperature,
+    absl::BitGen& rng, int batch_size, TopKTopPScratch& scratch,
+    absl::Span<int> sampled_ids, absl::Span<float> sampled_scores,
+    const LogitBiases* logit_biases,
+    absl::Span<std::pair<int, float>> top_log_probs) {
+  return FusedTopKTopPSamplingImpl(logits, k, p, temperature, rng, batch_size,
+                                   scratch, sampled_ids, sampled_scores,
+                                   logit_biases, top_log_probs);
+}
 
-    // O(final_nucleus_size) which is O(k) time complexity.
-    std::uniform_real_distribution<double> dist(0.0, nucleus_sum);
-    double random_sample = dist(rng);
-    double current_cumulative = 0.0;
-    for (int i = 0; i < final_nucleus_size; ++i) {
-      current_cumulative += (*probabilities)[b * k + i];
-      if (random_sample <= current_cumulative) {
-        sampled_ids[b] = (*topk_indices)[b * k + i];
-        sampled_scores[b] = std::exp(
-            (logits[b * vocab_size + sampled_ids[b]] - max_logit_values[b]) /
-            temperature);
-        break;
-      }
-    }
-  }
-  return sampled_ids;
+absl::Status FusedTopKTopPSampling(
+    absl::Span<const Bf16> logits, int k, float p, float temperature,
+    absl::BitGen& rng, int batch_size, TopKTopPScratch& scratch,
+    absl::Span<int> sampled_ids, absl::Span<float> sampled_scores,
+    const LogitBiases* logit_biases,
+    absl::Span<std::pair<int, float>> top_log_probs) {
+  return FusedTopKTopPSamplingImpl(logits, k, p, temperature, rng, batch_size,
+                                   scratch, sampled_ids, sampled_scores,
+                                   logit_biases, top_log_probs);
 }
 
 }  // namespace litert::lm
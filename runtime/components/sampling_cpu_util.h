@@ -1,17 +1,50 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SAMPLING_CPU_UTIL_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SAMPLING_CPU_UTIL_H_
 
+#include <cstdint>
+#include <utility>
 #include <vector>
 
 #include "absl/random/random.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
 
 namespace litert::lm {
 
+// The raw bits of half-precision logits, as stored in their tensors. They are
+// read in place by the kernels below, and only widened to float in registers
+// or for the top-k candidates.
+struct Fp16 {
+  uint16_t bits;
+};
+struct Bf16 {
+  uint16_t bits;
+};
+static_assert(sizeof(Fp16) == 2 && sizeof(Bf16) == 2);
+
+float ToFloat(Fp16 value);
+float ToFloat(Bf16 value);
+
+// Dequantizes the int8 or int16 logits of a model with quantized activations,
+// whose values are scale * (logit - zero_point), into `output` of the same
+// size.
+void DequantizeLogits(absl::Span<const int8_t> logits, float scale,
+                      int32_t zero_point, absl::Span<float> output);
+void DequantizeLogits(absl::Span<const int16_t> logits, float scale,
+                      int32_t zero_point, absl::Span<float> output);
+
+// Returns the index of the first largest value of `values`, which must not be
+// empty, as std::max_element does. Vectorized with AVX-512, AVX2 or NEON,
+// depending on the CPU.
+int ArgMax(absl::Span<const float> values);
+int ArgMax(absl::Span<const Fp16> values);
+int ArgMax(absl::Span<const Bf16> values);
+
 // Computes the top k indices of the given logits. The logits must be a 2D
 // tensor (in a flattened buffer) of shape [batch_size, vocab_size]. The output
-// is a vector of indices of shape [batch_size, k].
+// is a vector of indices of shape [batch_size, k], in no particular order
+// within a row.
 absl::StatusOr<std::vector<int>> TopKIndicies(absl::Span<const float> logits,
                                               int k, int batch_size = 1);
 
@@ -47,6 +80,70 @@ absl::StatusOr<std::vector<int>> TopKTopPSampling(
     absl::Span<const float> logits, int k, float p, float temperature,
     absl::BitGen& rng, int batch_size, std::vector<float>& sampled_scores);
 
+// The scratch buffers of FusedTopKTopPSampling(). Keeping them across calls
+// avoids any allocation once they have grown to the size of k (or of the
+// vocab, when k is a large fraction of it).
+struct TopKTopPScratch {
+  // The top-k logits of a batch with their token ids.
+  std::vector<std::pair<float, int>> candidates;
+  std::vector<int> indices;
+  std::vector<float> probabilities;
+};
+
+// The sparse biases of the logits of some tokens, added by the sampling
+// kernels as they select the top-k rather than to a copy of the logits. A
+// bias of -infinity bans the token.
+struct LogitBiases {
+  // The token ids with their biases, sorted by token id without duplicates.
+  std::vector<std::pair<int, float>> biases;
+  // Whether only the tokens of `biases` can be sampled, e.g. the labels of a
+  // classification, in which case the other logits are never read.
+  bool restrict_vocab = false;
+
+  bool empty() const { return biases.empty() && !restrict_vocab; }
+};
+
+// Creates the LogitBiases of the given (token id, bias) pairs, in any order.
+// The biases of a token listed more than once add up.
+absl::StatusOr<LogitBiases> CreateLogitBiases(
+    std::vector<std::pair<int, float>> biases, bool restrict_vocab);
+
+// Same as TopKTopPSampling(), but in a single pass over the logits of each
+// batch, and writing to `sampled_ids` and `sampled_scores`, which must hold
+// batch_size entries. The top-k selection, the softmax over the k survivors,
+// the top-p cutoff and the draw all work out of `scratch`. The half-precision
+// overloads read the logits as they are, without converting the whole vocab.
+// The optional `logit_biases` apply to the logits of each batch. Without
+// restrict_vocab, the top-k selection then keeps k plus the number of biased
+// tokens, among which the biased ones are replaced by their biased logits.
+// The optional `top_log_probs` of batch_size * n entries receive the n most
+// likely survivors of each batch, from the most likely, as (token id, log of
+// the probability among the survivors at the temperature). With greedy
+// sampling, i.e. k = 1, the top-n are selected instead of the argmax. The
+// entries past the number of survivors are set to (-1, -infinity). Without
+// biases nor top log-probabilities, the pure temperature sampling, i.e. k of
+// at least the vocab size and p = 1, draws the token with the Gumbel-max trick
+// instead, in a single pass over the logits with counter-based noise seeded
+// from `rng`.
+absl::Status FusedTopKTopPSampling(
+    absl::Span<const float> logits, int k, float p, float temperature,
+    absl::BitGen& rng, int batch_size, TopKTopPScratch& scratch,
+    absl::Span<int> sampled_ids, absl::Span<float> sampled_scores,
+    const LogitBiases* logit_biases = nullptr,
+    absl::Span<std::pair<int, float>> top_log_probs = {});
+absl::Status FusedTopKTopPSampling(
+    absl::Span<const Fp16> logits, int k, float p, float temperature,
+    absl::BitGen& rng, int batch_size, TopKTopPScratch& scratch,
+    absl::Span<int> sampled_ids, absl::Span<float> sampled_scores,
+    const LogitBiases* logit_biases = nullptr,
+    absl::Span<std::pair<int, float>> top_log_probs = {});
+absl::Status FusedTopKTopPSampling(
+    absl::Span<const Bf16> logits, int k, float p, float temperature,
+    absl::BitGen& rng, int batch_size, TopKTopPScratch& scratch,
+    absl::Span<int> sampled_ids, absl::Span<float> sampled_scores,
+    const LogitBiases* logit_biases = nullptr,
+    absl::Span<std::pair<int, float>> top_log_probs = {});
+
 }  // namespace litert::lm
 
 #endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SAMPLING_CPU_UTIL_H_
@@ -1,9 +1,17 @@
 #include "runtime/components/sampling_cpu_util.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <random>
+#include <utility>
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/base/casts.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
 #include "absl/random/random.h"  // from @com_google_absl
 
@@ -29,6 +37,48 @@ TEST(SamplingCpuUtilTest, TopKIndicies_BatchSize2) {
   EXPECT_THAT(*indices, ElementsAre(1, 0));
 }
 
+TEST(SamplingCpuUtilTest, TopKIndicies_InvalidK) {
+  const std::vector<float> logits = {0.1, 0.5, 0.4, 0.2};
+  EXPECT_FALSE(TopKIndicies(absl::MakeConstSpan(logits), /*k=*/0).ok());
+  EXPECT_FALSE(TopKIndicies(absl::MakeConstSpan(logits), /*k=*/5).ok());
+}
+
+TEST(SamplingCpuUtilTest, TopKIndicies_LargeVocab) {
+  // A vocab large enough for the heap selection, of a size that is not a
+  // multiple of the vector width, with ties around the k-th value.
+  constexpr int kVocabSize = 4099;
+  constexpr int kK = 40;
+  absl::BitGen rng;
+  std::vector<float> logits(kVocabSize);
+  for (float& logit : logits) {
+    logit = absl::Uniform<int>(rng, -100, 100) * 0.5f;
+  }
+  auto indices = TopKIndicies(absl::MakeConstSpan(logits), kK);
+  ASSERT_TRUE(indices.ok());
+  std::vector<float> top_logits;
+  for (int index : *indices) {
+    top_logits.push_back(logits[index]);
+  }
+  std::vector<float> expected_logits = logits;
+  std::sort(expected_logits.begin(), expected_logits.end(),
+            std::greater<float>());
+  expected_logits.resize(kK);
+  std::sort(top_logits.begin(), top_logits.end(), std::greater<float>());
+  EXPECT_EQ(top_logits, expected_logits);
+}
+
+TEST(SamplingCpuUtilTest, ArgMax_ReturnsFirstMax) {
+  // The max is repeated across the chunks scanned by the vector kernels.
+  std::vector<float> values(1000, -1.0f);
+  values[3] = 2.0f;
+  values[517] = 5.0f;
+  values[518] = 5.0f;
+  values[999] = 5.0f;
+  EXPECT_EQ(ArgMax(values), 517);
+  EXPECT_EQ(ArgMax(absl::MakeConstSpan(values).subspan(0, 517)), 3);
+  EXPECT_EQ(ArgMax(absl::MakeConstSpan(values).subspan(998)), 1);
+}
+
 TEST(SamplingCpuUtilTest, Softmax_BatchSize1) {
   const std::vector<float> logits = {0.1f, 0.1f};
   const std::vector<int> topk_indices = {0, 1};
@@ -156,5 +206,310 @@ TEST(SamplingCpuUtilTest, TopKTopPSampling_BatchSize2) {
   EXPECT_THAT(sampled_scores, ElementsAre(1.0, 1.0, 1.0));
 }
 
+TEST(SamplingCpuUtilTest, FusedTopKTopPSampling_SamplesFromNucleus) {
+  // The top-2 logits of each batch hold more than p of the mass, so that the
+  // sampled ids are always among them.
+  const std::vector<float> logits = {5.0, 0.0, 5.0, -1.0, 0.0,
+                                     0.0, 0.0, 9.0, 0.0, 9.0};
+  absl::BitGen rng;
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(2);
+  std::vector<float> sampled_scores(2);
+  for (int i = 0; i < 20; ++i) {
+    ASSERT_TRUE(FusedTopKTopPSampling(absl::MakeConstSpan(logits), /*k=*/3,
+                                      /*p=*/0.9, /*temperature=*/1.0f, rng,
+                                      /*batch_size=*/2, scratch,
+                                      absl::MakeSpan(sampled_ids),
+                                      absl::MakeSpan(sampled_scores))
+                    .ok());
+    EXPECT_THAT(sampled_ids[0], testing::AnyOf(0, 2));
+    EXPECT_THAT(sampled_ids[1], testing::AnyOf(2, 4));
+    EXPECT_THAT(sampled_scores, ElementsAre(1.0, 1.0));
+  }
+}
+
+TEST(SamplingCpuUtilTest, FusedTopKTopPSampling_GumbelMaxMatchesSoftmax) {
+  // With k of the vocab size and p = 1, the ids are drawn with the Gumbel-max
+  // trick, at the frequencies of the softmax of the logits at the temperature.
+  constexpr int kVocabSize = 300;
+  constexpr int kNumSamples = 10000;
+  std::vector<float> logits(kVocabSize, -100.0f);
+  logits[7] = std::log(0.2f) * 2.0f;
+  logits[150] = std::log(0.3f) * 2.0f;
+  logits[299] = std::log(0.5f) * 2.0f;
+  absl::BitGen rng;
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(1);
+  std::vector<float> sampled_scores(1);
+  std::vector<int> counts(kVocabSize);
+  for (int i = 0; i < kNumSamples; ++i) {
+    ASSERT_TRUE(FusedTopKTopPSampling(absl::MakeConstSpan(logits),
+                                      /*k=*/kVocabSize, /*p=*/1.0,
+                                      /*temperature=*/2.0f, rng,
+                                      /*batch_size=*/1, scratch,
+                                      absl::MakeSpan(sampled_ids),
+                                      absl::MakeSpan(sampled_scores))
+                    .ok());
+    ++counts[sampled_ids[0]];
+    EXPECT_NEAR(sampled_scores[0],
+                std::exp((logits[sampled_ids[0]] - logits[299]) / 2.0f),
+                1e-5);
+  }
+  EXPECT_EQ(counts[7] + counts[150] + counts[299], kNumSamples);
+  EXPECT_NEAR(counts[7] / static_cast<float>(kNumSamples), 0.2f, 0.025f);
+  EXPECT_NEAR(counts[150] / static_cast<float>(kNumSamples), 0.3f, 0.025f);
+  EXPECT_NEAR(counts[299] / static_cast<float>(kNumSamples), 0.5f, 0.025f);
+}
+
+TEST(SamplingCpuUtilTest, FusedTopKTopPSampling_GumbelMaxIsSeeded) {
+  constexpr int kVocabSize = 1000;
+  std::vector<float> logits(kVocabSize, 0.0f);
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(4);
+  std::vector<float> sampled_scores(4);
+  auto sample = [&](absl::BitGen& rng) {
+    EXPECT_TRUE(FusedTopKTopPSampling(absl::MakeConstSpan(logits),
+                                      /*k=*/kVocabSize, /*p=*/1.0,
+                                      /*temperature=*/1.0f, rng,
+                                      /*batch_size=*/4, scratch,
+                                      absl::MakeSpan(sampled_ids),
+                                      absl::MakeSpan(sampled_scores))
+                    .ok());
+    return sampled_ids;
+  };
+  std::vector<float> batch_logits;
+  for (int b = 0; b < 4; ++b) {
+    batch_logits.insert(batch_logits.end(), logits.begin(), logits.end());
+  }
+  logits = batch_logits;
+  std::seed_seq seed = {42};
+  absl::BitGen rng(seed);
+  std::seed_seq same_seed = {42};
+  absl::BitGen same_rng(same_seed);
+  const std::vector<int> ids = sample(rng);
+  EXPECT_EQ(sample(same_rng), ids);
+  // The rows draw different noise.
+  EXPECT_FALSE(ids[0] == ids[1] && ids[1] == ids[2] && ids[2] == ids[3]);
+}
+
+TEST(SamplingCpuUtilTest, FusedTopKTopPSampling_ReportsTopLogProbs) {
+  const std::vector<float> logits = {1.0, 3.0, 2.0, 0.0};
+  absl::BitGen rng;
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(1);
+  std::vector<float> sampled_scores(1);
+  std::vector<std::pair<int, float>> top_log_probs(3);
+  // Greedy sampling still takes the argmax.
+  ASSERT_TRUE(FusedTopKTopPSampling(
+                  absl::MakeConstSpan(logits), /*k=*/1, /*p=*/1.0,
+                  /*temperature=*/1.0f, rng, /*batch_size=*/1, scratch,
+                  absl::MakeSpan(sampled_ids), absl::MakeSpan(sampled_scores),
+                  /*logit_biases=*/nullptr, absl::MakeSpan(top_log_probs))
+                  .ok());
+  EXPECT_EQ(sampled_ids[0], 1);
+  const float log_sum = std::log(1.0f + std::exp(-1.0f) + std::exp(-2.0f));
+  EXPECT_EQ(top_log_probs[0].first, 1);
+  EXPECT_NEAR(top_log_probs[0].second, -log_sum, 1e-5);
+  EXPECT_EQ(top_log_probs[1].first, 2);
+  EXPECT_NEAR(top_log_probs[1].second, -1.0f - log_sum, 1e-5);
+  EXPECT_EQ(top_log_probs[2].first, 0);
+  EXPECT_NEAR(top_log_probs[2].second, -2.0f - log_sum, 1e-5);
+
+  // The top-2 survivors only leave room for two of them.
+  ASSERT_TRUE(FusedTopKTopPSampling(
+                  absl::MakeConstSpan(logits), /*k=*/2, /*p=*/1.0,
+                  /*temperature=*/1.0f, rng, /*batch_size=*/1, scratch,
+                  absl::MakeSpan(sampled_ids), absl::MakeSpan(sampled_scores),
+                  /*logit_biases=*/nullptr, absl::MakeSpan(top_log_probs))
+                  .ok());
+  EXPECT_THAT(sampled_ids[0], testing::AnyOf(1, 2));
+  EXPECT_EQ(top_log_probs[0].first, 1);
+  EXPECT_NEAR(top_log_probs[0].second, -std::log(1.0f + std::exp(-1.0f)),
+              1e-5);
+  EXPECT_EQ(top_log_probs[1].first, 2);
+  EXPECT_EQ(top_log_probs[2].first, -1);
+}
+
+// Returns the half-precision bits of `value`, which must be exactly
+// representable, and normal unless zero.
+Fp16 ToFp16(float value) {
+  const uint32_t bits = absl::bit_cast<uint32_t>(value);
+  if ((bits & 0x7fffffff) == 0) {
+    return {static_cast<uint16_t>(bits >> 16)};
+  }
+  const uint32_t exponent = (bits >> 23) & 0xff;
+  return {static_cast<uint16_t>(((bits >> 16) & 0x8000) |
+                                ((exponent - 112) << 10) |
+                                ((bits >> 13) & 0x3ff))};
+}
+
+Bf16 ToBf16(float value) {
+  return {static_cast<uint16_t>(absl::bit_cast<uint32_t>(value) >> 16)};
+}
+
+TEST(SamplingCpuUtilTest, ToFloat_HalfPrecision) {
+  EXPECT_EQ(ToFloat(Fp16{0x3c00}), 1.0f);
+  EXPECT_EQ(ToFloat(Fp16{0xc100}), -2.5f);
+  EXPECT_EQ(ToFloat(Fp16{0x0001}), 1.0f / (1 << 24));
+  EXPECT_EQ(ToFloat(Fp16{0xfc00}), -std::numeric_limits<float>::infinity());
+  EXPECT_EQ(ToFloat(Bf16{0x3f80}), 1.0f);
+  EXPECT_EQ(ToFloat(Bf16{0xc020}), -2.5f);
+}
+
+TEST(SamplingCpuUtilTest, HalfPrecisionLogitsMatchFloat) {
+  // Values exactly representable in both half-precision formats.
+  constexpr int kVocabSize = 1029;
+  absl::BitGen rng;
+  std::vector<float> logits(kVocabSize);
+  std::vector<Fp16> fp16_logits(kVocabSize);
+  std::vector<Bf16> bf16_logits(kVocabSize);
+  for (int i = 0; i < kVocabSize; ++i) {
+    logits[i] = absl::Uniform<int>(rng, -200, 200) * 0.25f;
+    fp16_logits[i] = ToFp16(logits[i]);
+    bf16_logits[i] = ToBf16(logits[i]);
+    ASSERT_EQ(ToFloat(fp16_logits[i]), logits[i]);
+    ASSERT_EQ(ToFloat(bf16_logits[i]), logits[i]);
+  }
+  const int expected_id = ArgMax(logits);
+  EXPECT_EQ(ArgMax(absl::MakeConstSpan(fp16_logits)), expected_id);
+  EXPECT_EQ(ArgMax(absl::MakeConstSpan(bf16_logits)), expected_id);
+
+  // With p = 0, only the most likely of the top-k is sampled.
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(1);
+  std::vector<float> sampled_scores(1);
+  ASSERT_TRUE(FusedTopKTopPSampling(absl::MakeConstSpan(fp16_logits),
+                                    /*k=*/40, /*p=*/0.0, /*temperature=*/1.0f,
+                                    rng, /*batch_size=*/1, scratch,
+                                    absl::MakeSpan(sampled_ids),
+                                    absl::MakeSpan(sampled_scores))
+                  .ok());
+  EXPECT_EQ(sampled_ids[0], expected_id);
+  ASSERT_TRUE(FusedTopKTopPSampling(absl::MakeConstSpan(bf16_logits),
+                                    /*k=*/40, /*p=*/0.0, /*temperature=*/1.0f,
+                                    rng, /*batch_size=*/1, scratch,
+                                    absl::MakeSpan(sampled_ids),
+                                    absl::MakeSpan(sampled_scores))
+                  .ok());
+  EXPECT_EQ(sampled_ids[0], expected_id);
+}
+
+TEST(SamplingCpuUtilTest, DequantizeLogits) {
+  const std::vector<int8_t> int8_logits = {-128, -3, 0, 5, 127};
+  std::vector<float> logits(int8_logits.size());
+  DequantizeLogits(absl::MakeConstSpan(int8_logits), /*scale=*/0.5f,
+                   /*zero_point=*/-3, absl::MakeSpan(logits));
+  EXPECT_THAT(logits, ElementsAre(-62.5f, 0.0f, 1.5f, 4.0f, 65.0f));
+
+  const std::vector<int16_t> int16_logits = {-32768, 0, 1000, 32767};
+  logits.resize(int16_logits.size());
+  DequantizeLogits(absl::MakeConstSpan(int16_logits), /*scale=*/0.25f,
+                   /*zero_point=*/0, absl::MakeSpan(logits));
+  EXPECT_THAT(logits, ElementsAre(-8192.0f, 0.0f, 250.0f, 8191.75f));
+}
+
+TEST(SamplingCpuUtilTest, FusedTopKTopPSampling_InvalidOutputSize) {
+  const std::vector<float> logits = {0.1, 0.5, 0.4, 0.2};
+  absl::BitGen rng;
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(1);
+  std::vector<float> sampled_scores(1);
+  EXPECT_FALSE(FusedTopKTopPSampling(absl::MakeConstSpan(logits), /*k=*/2,
+                                     /*p=*/0.5, /*temperature=*/1.0f, rng,
+                                     /*batch_size=*/2, scratch,
+                                     absl::MakeSpan(sampled_ids),
+                                     absl::MakeSpan(sampled_scores))
+                   .ok());
+}
+
+TEST(SamplingCpuUtilTest, CreateLogitBiases) {
+  auto logit_biases = CreateLogitBiases({{7, 1.0f}, {2, -1.0f}, {7, 0.5f}},
+                                        /*restrict_vocab=*/false);
+  ASSERT_TRUE(logit_biases.ok());
+  EXPECT_THAT(logit_biases->biases,
+              ElementsAre(std::make_pair(2, -1.0f), std::make_pair(7, 1.5f)));
+  EXPECT_FALSE(logit_biases->empty());
+  EXPECT_FALSE(
+      CreateLogitBiases({{-1, 1.0f}}, /*restrict_vocab=*/false).ok());
+}
+
+TEST(SamplingCpuUtilTest, FusedTopKTopPSampling_LogitBiases) {
+  constexpr float kBanned = -std::numeric_limits<float>::infinity();
+  const std::vector<float> logits = {5.0, 4.0, 3.0, 0.0, 0.0};
+  absl::BitGen rng;
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(1);
+  std::vector<float> sampled_scores(1);
+  auto sample = [&](int k, const LogitBiases& logit_biases) {
+    // With p = 0, only the most likely of the top-k is sampled.
+    EXPECT_TRUE(FusedTopKTopPSampling(
+                    absl::MakeConstSpan(logits), k, /*p=*/0.0,
+                    /*temperature=*/1.0f, rng, /*batch_size=*/1, scratch,
+                    absl::MakeSpan(sampled_ids),
+                    absl::MakeSpan(sampled_scores), &logit_biases)
+                    .ok());
+    return sampled_ids[0];
+  };
+  // The token 3 is boosted past the others, from outside the top-k.
+  auto logit_biases =
+      CreateLogitBiases({{0, kBanned}, {3, 10.0f}}, /*restrict_vocab=*/false);
+  ASSERT_TRUE(logit_biases.ok());
+  EXPECT_EQ(sample(/*k=*/2, *logit_biases), 3);
+  EXPECT_EQ(sample(/*k=*/1, *logit_biases), 3);
+  // The greedy sampling skips the banned tokens.
+  logit_biases =
+      CreateLogitBiases({{0, kBanned}, {1, kBanned}}, /*restrict_vocab=*/false);
+  ASSERT_TRUE(logit_biases.ok());
+  EXPECT_EQ(sample(/*k=*/1, *logit_biases), 2);
+
+  // Only the listed tokens are sampled with a restricted vocab.
+  logit_biases =
+      CreateLogitBiases({{4, 0.0f}, {3, 0.5f}}, /*restrict_vocab=*/true);
+  ASSERT_TRUE(logit_biases.ok());
+  EXPECT_EQ(sample(/*k=*/40, *logit_biases), 3);
+
+  logit_biases = CreateLogitBiases({{3, kBanned}}, /*restrict_vocab=*/true);
+  ASSERT_TRUE(logit_biases.ok());
+  EXPECT_FALSE(FusedTopKTopPSampling(absl::MakeConstSpan(logits), /*k=*/2,
+                                     /*p=*/0.0, /*temperature=*/1.0f, rng,
+                                     /*batch_size=*/1, scratch,
+                                     absl::MakeSpan(sampled_ids),
+                                     absl::MakeSpan(sampled_scores),
+                                     &*logit_biases)
+                   .ok());
+}
+
+TEST(SamplingCpuUtilTest, LogitBiasesMatchBiasedLogits) {
+  constexpr int kVocabSize = 1000;
+  absl::BitGen rng;
+  std::vector<float> logits(kVocabSize);
+  for (float& logit : logits) {
+    logit = absl::Uniform<float>(rng, -10.0f, 10.0f);
+  }
+  std::vector<std::pair<int, float>> biases;
+  for (int i = 0; i < 20; ++i) {
+    biases.push_back({absl::Uniform<int>(rng, 0, kVocabSize),
+                      absl::Uniform<float>(rng, -20.0f, 20.0f)});
+  }
+  auto logit_biases = CreateLogitBiases(biases, /*restrict_vocab=*/false);
+  ASSERT_TRUE(logit_biases.ok());
+  std::vector<float> biased_logits = logits;
+  for (const auto& [token_id, bias] : logit_biases->biases) {
+    biased_logits[token_id] += bias;
+  }
+
+  TopKTopPScratch scratch;
+  std::vector<int> sampled_ids(1);
+  std::vector<float> sampled_scores(1);
+  ASSERT_TRUE(FusedTopKTopPSampling(absl::MakeConstSpan(logits), /*k=*/40,
+                                    /*p=*/0.0, /*temperature=*/1.0f, rng,
+                                    /*batch_size=*/1, scratch,
+                                    absl::MakeSpan(sampled_ids),
+                                    absl::MakeSpan(sampled_scores),
+                                    &*logit_biases)
+                  .ok());
+  EXPECT_EQ(sampled_ids[0], ArgMax(biased_logits));
+}
+
 }  // namespace
 }  // namespace litert::lm
@@ -1,5 +1,8 @@
 #include "runtime/components/sentencepiece_tokenizer.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <utility>
@@ -8,10 +11,138 @@
 #include "absl/memory/memory.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_replace.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/components/token_piece_table.h"
+#include "runtime/components/tokenizer.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "sentencepiece_model.pb.h"  // from @sentencepiece
 #include "sentencepiece_processor.h"  // from @sentencepiece
 
 namespace litert::lm {
+namespace {
+
+// The marker SentencePiece substitutes for the spaces, U+2581.
+constexpr absl::string_view kSpaceMarker = "\xe2\x96\x81";
+
+// Parses the byte of a byte fallback piece, of the form <0xAB>.
+bool ParseBytePiece(absl::string_view piece, char* byte) {
+  int value;
+  if (piece.size() != 6 || !absl::SimpleHexAtoi(piece.substr(3, 2), &value)) {
+    return false;
+  }
+  *byte = static_cast<char>(value);
+  return true;
+}
+
+// Returns the decoded bytes of each piece, with the whitespace marker
+// replaced by a space and the byte fallback pieces by their byte.
+absl::StatusOr<std::unique_ptr<TokenPieceTable>> CreatePieceTable(
+    const sentencepiece::SentencePieceProcessor& processor) {
+  std::vector<std::string> pieces(processor.GetPieceSize());
+  for (int id = 0; id < pieces.size(); ++id) {
+    const std::string& piece = processor.IdToPiece(id);
+    char byte;
+    if (processor.IsByte(id) && ParseBytePiece(piece, &byte)) {
+      pieces[id] = std::string(1, byte);
+    } else {
+      pieces[id] = absl::StrReplaceAll(piece, {{kSpaceMarker, " "}});
+    }
+  }
+  return TokenPieceTable::Create(pieces);
+}
+
+// Whether NFKC leaves the text as is, i.e. all of it is printable ASCII. The
+// control characters are not, as the normalization of NMT rewrites them.
+bool IsPrintableAscii(absl::string_view text) {
+  return std::all_of(text.begin(), text.end(), [](char c) {
+    return c >= 0x20 && c <= 0x7e;
+  });
+}
+
+// Returns a copy of `processor` without normalization rules, if they leave
+// the printable ASCII as is, or nullptr if they may not or there are none.
+absl::StatusOr<std::unique_ptr<sentencepiece::SentencePieceProcessor>>
+CreateAsciiProcessor(const sentencepiece::SentencePieceProcessor& processor) {
+  const sentencepiece::NormalizerSpec& spec =
+      processor.model_proto().normalizer_spec();
+  // The case folding variants rewrite the upper case letters.
+  if ((spec.name() != "nfkc" && spec.name() != "nmt_nfkc") ||
+      spec.precompiled_charsmap().empty()) {
+    return nullptr;
+  }
+  auto model_proto =
+      std::make_unique<sentencepiece::ModelProto>(processor.model_proto());
+  model_proto->mutable_normalizer_spec()->set_name("identity");
+  model_proto->mutable_normalizer_spec()->clear_precompiled_charsmap();
+  auto ascii_processor =
+      std::make_unique<sentencepiece::SentencePieceProcessor>();
+  RETURN_IF_ERROR(ascii_processor->Load(std::move(model_proto)));
+  return ascii_processor;
+}
+
+// Decodes the pieces one at a time from the piece table. The bytes of the
+// byte fallback pieces are kept until they complete a UTF-8 character.
+class SentencePieceStreamingDetokenizer : public StreamingDetokenizer {
+ public:
+  explicit SentencePieceStreamingDetokenizer(const TokenPieceTable& table)
+      : table_(table) {}
+
+  absl::StatusOr<std::string> Add(int token_id) override {
+    RETURN_IF_ERROR(table_.AppendPieces({token_id}, &pending_bytes_));
+    // Only the bytes of an incomplete character are left pending, so each
+    // token is handled in time proportional to its piece.
+    const size_t length = CompleteUtf8PrefixLength(pending_bytes_);
+    std::string text = pending_bytes_.substr(0, length);
+    pending_bytes_.erase(0, length);
+    return text;
+  }
+
+ private:
+  const TokenPieceTable& table_;
+  std::string pending_bytes_;
+};
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<SentencePieceTokenizer>>
+SentencePieceTokenizer::Create(
+    std::unique_ptr<sentencepiece::SentencePieceProcessor> processor) {
+  ASSIGN_OR_RETURN(std::unique_ptr<TokenPieceTable> piece_table,
+                   CreatePieceTable(*processor));
+  ASSIGN_OR_RETURN(auto ascii_processor, CreateAsciiProcessor(*processor));
+  const sentencepiece::ModelProto& model_proto = processor->model_proto();
+  auto tokenizer = absl::WrapUnique(
+      new SentencePieceTokenizer(std::move(processor), std::move(piece_table)));
+  tokenizer->ascii_processor_ = std::move(ascii_processor);
+  const sentencepiece::NormalizerSpec& spec = model_proto.normalizer_spec();
+  if (spec.add_dummy_prefix() || spec.remove_extra_whitespaces()) {
+    return tokenizer;
+  }
+  using SentencePiece = sentencepiece::ModelProto::SentencePiece;
+  for (int id = 0; id < model_proto.pieces_size(); ++id) {
+    const SentencePiece& piece = model_proto.pieces(id);
+    if (piece.type() != SentencePiece::USER_DEFINED || piece.piece().empty()) {
+      continue;
+    }
+    const uint8_t first_byte = static_cast<uint8_t>(piece.piece()[0]);
+    tokenizer->special_tokens_[first_byte].push_back({piece.piece(), id});
+  }
+  for (int byte = 0; byte < 256; ++byte) {
+    std::vector<SpecialToken>& tokens = tokenizer->special_tokens_[byte];
+    if (tokens.empty()) {
+      continue;
+    }
+    // SentencePiece matches the longest of the user-defined pieces.
+    std::stable_sort(tokens.begin(), tokens.end(),
+                     [](const SpecialToken& a, const SpecialToken& b) {
+                       return a.text.size() > b.text.size();
+                     });
+    tokenizer->special_token_first_bytes_.push_back(static_cast<char>(byte));
+  }
+  return tokenizer;
+}
 
 absl::StatusOr<std::unique_ptr<SentencePieceTokenizer>>
 SentencePieceTokenizer::CreateFromFile(absl::string_view model_path) {
@@ -20,7 +151,7 @@ SentencePieceTokenizer::CreateFromFile(absl::string_view model_path) {
   if (!status.ok()) {
     return status;
   }
-  return absl::WrapUnique(new SentencePieceTokenizer(std::move(processor)));
+  return Create(std::move(processor));
 }
 
 absl::StatusOr<std::unique_ptr<SentencePieceTokenizer>>
@@ -30,20 +161,56 @@ SentencePieceTokenizer::CreateFromBuffer(absl::string_view model_buffer) {
   if (!status.ok()) {
     return status;
   }
-  return absl::WrapUnique(new SentencePieceTokenizer(std::move(processor)));
+  return Create(std::move(processor));
 }
 
 // Encodes the given text into a TensorBuffer of token ids.
 absl::StatusOr<std::vector<int>> SentencePieceTokenizer::TextToTokenIds(
     absl::string_view text) {
   std::vector<int> ids;
-  auto status = processor_->Encode(text, &ids);
-  if (!status.ok()) {
-    return status;
+  size_t segment_begin = 0;
+  size_t pos = 0;
+  while (!special_token_first_bytes_.empty() &&
+         (pos = text.find_first_of(special_token_first_bytes_, pos)) !=
+             absl::string_view::npos) {
+    const std::vector<SpecialToken>& tokens =
+        special_tokens_[static_cast<uint8_t>(text[pos])];
+    auto token = std::find_if(
+        tokens.begin(), tokens.end(), [&](const SpecialToken& token) {
+          return text.substr(pos).starts_with(token.text);
+        });
+    if (token == tokens.end()) {
+      ++pos;
+      continue;
+    }
+    RETURN_IF_ERROR(EncodeSegment(
+        text.substr(segment_begin, pos - segment_begin), ids));
+    ids.push_back(token->id);
+    pos += token->text.size();
+    segment_begin = pos;
   }
+  RETURN_IF_ERROR(EncodeSegment(text.substr(segment_begin), ids));
   return ids;
 }
 
+absl::Status SentencePieceTokenizer::EncodeSegment(
+    absl::string_view segment, std::vector<int>& ids) const {
+  if (segment.empty()) {
+    return absl::OkStatus();
+  }
+  const sentencepiece::SentencePieceProcessor& processor =
+      ascii_processor_ != nullptr && IsPrintableAscii(segment)
+          ? *ascii_processor_
+          : *processor_;
+  if (ids.empty()) {
+    return processor.Encode(segment, &ids);
+  }
+  std::vector<int> segment_ids;
+  RETURN_IF_ERROR(processor.Encode(segment, &segment_ids));
+  ids.insert(ids.end(), segment_ids.begin(), segment_ids.end());
+  return absl::OkStatus();
+}
+
 // Decodes the given TensorBuffer of token ids into a string.
 absl::StatusOr<std::string> SentencePieceTokenizer::TokenIdsToText(
     const std::vector<int>& token_ids) {
@@ -64,4 +231,22 @@ absl::StatusOr<int> SentencePieceTokenizer::EosId() const {
   return processor_->eos_id();
 };
 
+std::unique_ptr<StreamingDetokenizer>
+SentencePieceTokenizer::CreateStreamingDetokenizer() {
+  return std::make_unique<SentencePieceStreamingDetokenizer>(*piece_table_);
+}
+
+absl::StatusOr<std::vector<std::string>>
+SentencePieceTokenizer::GetTokenTexts() {
+  std::vector<std::string> token_texts(processor_->GetPieceSize());
+  for (int id = 0; id < token_texts.size(); ++id) {
+    if (processor_->IsControl(id) || processor_->IsUnknown(id) ||
+        processor_->IsUnused(id)) {
+      continue;
+    }
+    token_texts[id] = std::string(piece_table_->GetPiece(id));
+  }
+  return token_texts;
+}
+
 }  // namespace litert::lm
@@ -1,19 +1,31 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SENTENCEPIECE_TOKENIZER_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_SENTENCEPIECE_TOKENIZER_H_
 
+#include <array>
 #include <memory>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/components/token_piece_table.h"
 #include "runtime/components/tokenizer.h"
 #include "sentencepiece_processor.h"  // from @sentencepiece
 
 namespace litert::lm {
 
 // A Tokenizer implementation using SentencePiece.
+//
+// The encoding takes two shortcuts, which give the same token ids as the
+// processor on the whole text:
+// - The user-defined pieces, e.g. the turn markers of the prompt templates,
+//   are matched in the text and emitted directly, and only the text between
+//   them is encoded, if the model neither adds a dummy prefix nor removes the
+//   extra whitespaces, which would apply to each of the segments.
+// - The segments of printable ASCII, which NFKC leaves as is, are encoded by
+//   a copy of the processor without the normalization rules.
 class SentencePieceTokenizer : public Tokenizer {
  public:
   // Creates a SentencePieceTokenizer from the given model path.
@@ -39,14 +51,49 @@ class SentencePieceTokenizer : public Tokenizer {
   // Returns EOS id.
   absl::StatusOr<int> EosId() const override;
 
+  // Creates a detokenizer appending the pieces from a table built when the
+  // model is loaded, with the whitespace marker replaced by a space and the
+  // byte pieces by their bytes.
+  std::unique_ptr<StreamingDetokenizer> CreateStreamingDetokenizer() override;
+
+  // Returns the text of the pieces, with the whitespace marker replaced by a
+  // space and the byte pieces by their byte.
+  absl::StatusOr<std::vector<std::string>> GetTokenTexts() override;
+
  private:
+  // Creates the tokenizer of a loaded processor, and its piece table.
+  static absl::StatusOr<std::unique_ptr<SentencePieceTokenizer>> Create(
+      std::unique_ptr<sentencepiece::SentencePieceProcessor> processor);
+
+  // A user-defined piece, matched in the text.
+  struct SpecialToken {
+    std::string text;
+    int id;
+  };
+
   // Constructor.
-  explicit SentencePieceTokenizer(
-      std::unique_ptr<sentencepiece::SentencePieceProcessor> processor)
-      : processor_(std::move(processor)) {};
+  SentencePieceTokenizer(
+      std::unique_ptr<sentencepiece::SentencePieceProcessor> processor,
+      std::unique_ptr<TokenPieceTable> piece_table)
+      : processor_(std::move(processor)),
+        piece_table_(std::move(piece_table)) {};
+
+  // Appends the token ids of a segment without user-defined pieces.
+  absl::Status EncodeSegment(absl::string_view segment,
+                             std::vector<int>& ids) const;
 
   // SentencePiece processor.
   std::unique_ptr<sentencepiece::SentencePieceProcessor> processor_;
+  // The processor without normalization rules, for the segments of printable
+  // ASCII, or nullptr if the normalization may change them or is already the
+  // identity.
+  std::unique_ptr<sentencepiece::SentencePieceProcessor> ascii_processor_;
+  // The user-defined pieces by their first byte, the longest first, and the
+  // first bytes, both empty if the text is not split on them.
+  std::array<std::vector<SpecialToken>, 256> special_tokens_;
+  std::string special_token_first_bytes_;
+  // The decoded bytes of each piece.
+  std::unique_ptr<TokenPieceTable> piece_table_;
 };
 
 }  // namespace litert::lm
@@ -16,6 +16,9 @@
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+#include "sentencepiece_model.pb.h"  // from @sentencepiece
+#include "sentencepiece_processor.h"  // from @sentencepiece
 
 namespace litert::lm {
 namespace {
@@ -63,6 +66,27 @@ absl::StatusOr<std::string> GetContents(absl::string_view path) {
   return std::move(contents);
 }
 
+// Returns the test model with the user-defined piece "<turn>", and neither
+// the dummy prefix nor the removal of the extra whitespaces, such that the
+// text is split on the piece.
+absl::StatusOr<std::string> GetModelWithUserDefinedPiece() {
+  absl::StatusOr<std::string> model_buffer =
+      GetContents(GetSentencePieceModelPath());
+  if (!model_buffer.ok()) {
+    return model_buffer.status();
+  }
+  sentencepiece::ModelProto model_proto;
+  if (!model_proto.ParseFromString(*model_buffer)) {
+    return absl::InternalError("Failed to parse the model.");
+  }
+  sentencepiece::ModelProto::SentencePiece* piece = model_proto.add_pieces();
+  piece->set_piece("<turn>");
+  piece->set_type(sentencepiece::ModelProto::SentencePiece::USER_DEFINED);
+  model_proto.mutable_normalizer_spec()->set_add_dummy_prefix(false);
+  model_proto.mutable_normalizer_spec()->set_remove_extra_whitespaces(false);
+  return model_proto.SerializeAsString();
+}
+
 TEST(SentencePieceTokenizerTtest, CreateFromFile) {
   auto tokenizer_or =
       SentencePieceTokenizer::CreateFromFile(GetSentencePieceModelPath());
@@ -97,6 +121,42 @@ TEST(SentencePieceTokenizerTest, TextToTokenIds) {
               ::testing::ElementsAre(224, 24, 8, 66, 246, 18, 2295));
 }
 
+TEST(SentencePieceTokenizerTest, TextToTokenIdsMatchesTheProcessor) {
+  ASSERT_OK_AND_ASSIGN(std::string model_buffer,
+                       GetContents(GetSentencePieceModelPath()));
+  ASSERT_OK_AND_ASSIGN(std::string split_model_buffer,
+                       GetModelWithUserDefinedPiece());
+  for (const std::string& buffer : {model_buffer, split_model_buffer}) {
+    ASSERT_OK_AND_ASSIGN(auto tokenizer,
+                         SentencePieceTokenizer::CreateFromBuffer(buffer));
+    sentencepiece::SentencePieceProcessor processor;
+    ASSERT_OK(processor.LoadFromSerializedProto(buffer));
+    for (absl::string_view text :
+         {"How's it going?", "<turn>user\nHi  there<turn>model\n",
+          "Caf\xc3\xa9 au\tlait", "<tur<turn>>", ""}) {
+      std::vector<int> expected_ids;
+      ASSERT_OK(processor.Encode(text, &expected_ids));
+      ASSERT_OK_AND_ASSIGN(std::vector<int> ids,
+                           tokenizer->TextToTokenIds(text));
+      EXPECT_EQ(ids, expected_ids) << text;
+    }
+  }
+}
+
+TEST(SentencePieceTokenizerTest, TextToTokenIdsEmitsUserDefinedPieces) {
+  ASSERT_OK_AND_ASSIGN(std::string model_buffer,
+                       GetModelWithUserDefinedPiece());
+  ASSERT_OK_AND_ASSIGN(auto tokenizer,
+                       SentencePieceTokenizer::CreateFromBuffer(model_buffer));
+
+  ASSERT_OK_AND_ASSIGN(std::vector<int> ids,
+                       tokenizer->TextToTokenIds("<turn>Hi<turn>"));
+  ASSERT_GE(ids.size(), 3);
+  EXPECT_EQ(ids.front(), 4000);
+  EXPECT_EQ(ids.back(), 4000);
+  EXPECT_THAT(ids, ::testing::Contains(4000).Times(2));
+}
+
 TEST(SentencePieceTokenizerTest, TokenIdsToText) {
   auto tokenizer_or =
       SentencePieceTokenizer::CreateFromFile(GetSentencePieceModelPath());
@@ -110,6 +170,22 @@ TEST(SentencePieceTokenizerTest, TokenIdsToText) {
   EXPECT_EQ(text_or.value(), "▁Hello▁World!");
 }
 
+TEST(SentencePieceTokenizerTest, StreamingDetokenizer) {
+  auto tokenizer_or =
+      SentencePieceTokenizer::CreateFromFile(GetSentencePieceModelPath());
+  ASSERT_OK(tokenizer_or);
+  auto detokenizer = tokenizer_or.value()->CreateStreamingDetokenizer();
+
+  std::string text;
+  for (int id : {90, 547, 58, 735, 210, 466, 2294}) {
+    ASSERT_OK_AND_ASSIGN(std::string piece, detokenizer->Add(id));
+    text += piece;
+  }
+  EXPECT_EQ(text, " Hello World!");
+  EXPECT_THAT(detokenizer->Add(-1),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 TEST(SentencePieceTokenizerTest, BosId) {
   auto tokenizer_or =
       SentencePieceTokenizer::CreateFromFile(GetSentencePieceModelPath());
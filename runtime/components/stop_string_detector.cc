@@ -0,0 +1,87 @@
+#include "runtime/components/stop_string_detector.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+absl::Status StopStringDetector::AddStopString(absl::string_view stop_string) {
+  if (stop_string.empty()) {
+    return absl::InvalidArgumentError("Cannot add an empty stop string.");
+  }
+  if (std::find(stop_strings_.begin(), stop_strings_.end(), stop_string) !=
+      stop_strings_.end()) {
+    return absl::AlreadyExistsError(
+        absl::StrCat("Stop string \"", stop_string, "\" already exists."));
+  }
+  stop_strings_.emplace_back(stop_string);
+  return absl::OkStatus();
+}
+
+std::string StopStringDetector::ProcessText(absl::string_view text) {
+  if (stop_string_found_) {
+    return "";
+  }
+  held_back_text_.append(text.data(), text.size());
+  // The held back text matched no stop string, so a match ends in `text`. The
+  // one ending first is the one the decoding stops at.
+  size_t stop_begin = std::string::npos;
+  size_t stop_end = std::string::npos;
+  for (const std::string& stop_string : stop_strings_) {
+    const size_t begin = held_back_text_.find(stop_string);
+    if (begin == std::string::npos) {
+      continue;
+    }
+    const size_t end = begin + stop_string.size();
+    if (end < stop_end || (end == stop_end && begin < stop_begin)) {
+      stop_begin = begin;
+      stop_end = end;
+    }
+  }
+  std::string released;
+  if (stop_begin != std::string::npos) {
+    released = held_back_text_.substr(0, stop_begin);
+    held_back_text_.clear();
+    stop_string_found_ = true;
+    return released;
+  }
+  const size_t num_released =
+      held_back_text_.size() - GetHeldBackLength(held_back_text_);
+  released = held_back_text_.substr(0, num_released);
+  held_back_text_.erase(0, num_released);
+  return released;
+}
+
+std::string StopStringDetector::Flush() {
+  std::string released;
+  released.swap(held_back_text_);
+  return released;
+}
+
+void StopStringDetector::Reset() {
+  held_back_text_.clear();
+  stop_string_found_ = false;
+}
+
+size_t StopStringDetector::GetHeldBackLength(absl::string_view text) const {
+  size_t held_back_length = 0;
+  for (const std::string& stop_string : stop_strings_) {
+    for (size_t length = std::min(text.size(), stop_string.size() - 1);
+         length > held_back_length; --length) {
+      if (absl::EndsWith(text,
+                         absl::string_view(stop_string).substr(0, length))) {
+        held_back_length = length;
+        break;
+      }
+    }
+  }
+  return held_back_length;
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,66 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_STOP_STRING_DETECTOR_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_STOP_STRING_DETECTOR_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// Detects stop strings in the text streamed by a detokenizer. Unlike the
+// StopTokenDetector, the stop strings are matched on the text, so they are
+// found however they are tokenized. The text that may begin a stop string is
+// held back until the following text tells whether it does, such that the
+// text before a stop string is released, but none of the stop string itself.
+// Example usage:
+//
+//   StopStringDetector detector;
+//   RETURN_IF_ERROR(detector.AddStopString("\nUser:"));
+//   // ... for each piece of decoded text ...
+//   observer->OnNext(detector.ProcessText(text));
+//   if (detector.StopStringFound()) {
+//     // Stop the decoding.
+//   }
+//   // ... at the end of the decoding without a stop string ...
+//   observer->OnNext(detector.Flush());
+class StopStringDetector {
+ public:
+  // Adds a stop string.
+  // Returns InvalidArgumentError if the string is empty, or AlreadyExistsError
+  // if it was added before.
+  absl::Status AddStopString(absl::string_view stop_string);
+
+  bool HasStopStrings() const { return !stop_strings_.empty(); }
+
+  // Adds the next piece of text, and returns the text that is released, i.e.
+  // the text that cannot be part of a stop string, or the text before the
+  // stop string completed by `text`. Returns an empty string once a stop
+  // string is found.
+  std::string ProcessText(absl::string_view text);
+
+  // Whether a stop string has been found since the last Reset().
+  bool StopStringFound() const { return stop_string_found_; }
+
+  // Releases the text held back, e.g. when the decoding ends on a stop token.
+  std::string Flush();
+
+  // Clears the state for a new text. The stop strings are kept.
+  void Reset();
+
+ private:
+  // Returns the length of the longest suffix of `text` that is a proper
+  // prefix of a stop string.
+  size_t GetHeldBackLength(absl::string_view text) const;
+
+  std::vector<std::string> stop_strings_;
+  // The text held back, which matches no stop string.
+  std::string held_back_text_;
+  bool stop_string_found_ = false;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_STOP_STRING_DETECTOR_H_
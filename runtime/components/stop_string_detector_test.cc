@@ -0,0 +1,65 @@
+#include "runtime/components/stop_string_detector.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+TEST(StopStringDetectorTest, AddStopString) {
+  StopStringDetector detector;
+  EXPECT_FALSE(detector.HasStopStrings());
+  EXPECT_OK(detector.AddStopString("</s>"));
+  EXPECT_TRUE(detector.HasStopStrings());
+  EXPECT_EQ(detector.AddStopString("").code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_EQ(detector.AddStopString("</s>").code(),
+            absl::StatusCode::kAlreadyExists);
+}
+
+TEST(StopStringDetectorTest, HoldsBackOnlyTheBeginningOfAStopString) {
+  StopStringDetector detector;
+  EXPECT_OK(detector.AddStopString("\nUser:"));
+  EXPECT_EQ(detector.ProcessText("Hello"), "Hello");
+  // "\nUs" may begin the stop string.
+  EXPECT_EQ(detector.ProcessText(" world\nUs"), " world");
+  // "\nUse" is held back until the next text tells.
+  EXPECT_EQ(detector.ProcessText("e"), "");
+  EXPECT_EQ(detector.ProcessText("d"), "\nUsed");
+  EXPECT_FALSE(detector.StopStringFound());
+
+  EXPECT_EQ(detector.ProcessText(".\n"), ".");
+  EXPECT_EQ(detector.ProcessText("User: next"), "");
+  EXPECT_TRUE(detector.StopStringFound());
+  EXPECT_EQ(detector.ProcessText("more"), "");
+  EXPECT_EQ(detector.Flush(), "");
+}
+
+TEST(StopStringDetectorTest, StopsAtTheFirstStopStringToEnd) {
+  StopStringDetector detector;
+  EXPECT_OK(detector.AddStopString("abcd"));
+  EXPECT_OK(detector.AddStopString("bc"));
+  EXPECT_EQ(detector.ProcessText("xab"), "x");
+  EXPECT_EQ(detector.ProcessText("cd"), "a");
+  EXPECT_TRUE(detector.StopStringFound());
+}
+
+TEST(StopStringDetectorTest, FlushAndReset) {
+  StopStringDetector detector;
+  EXPECT_OK(detector.AddStopString("###"));
+  EXPECT_EQ(detector.ProcessText("text #"), "text ");
+  EXPECT_EQ(detector.Flush(), "#");
+  EXPECT_EQ(detector.ProcessText("###"), "");
+  EXPECT_TRUE(detector.StopStringFound());
+
+  detector.Reset();
+  EXPECT_FALSE(detector.StopStringFound());
+  EXPECT_EQ(detector.ProcessText("#a"), "#a");
+}
+
+}  // namespace
+}  // namespace litert::lm
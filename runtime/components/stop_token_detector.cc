@@ -2,7 +2,9 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <deque>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/log/absl_check.h"  // from @com_google_absl
@@ -29,7 +31,8 @@ inline std::string PrintSequence(const std::vector<int>& sequence) {
 
 }  // namespace
 
-StopTokenDetector::StopTokenDetector(size_t batch_size) {
+StopTokenDetector::StopTokenDetector(size_t batch_size)
+    : children_(1), stop_sequence_lengths_(1, 0), match_lengths_(1, 0) {
   ABSL_CHECK_GT(batch_size, 0) << "Batch size must be greater than 0.";
   ResetBatch(batch_size);
 }
@@ -41,33 +44,96 @@ absl::Status StopTokenDetector::AddStopTokenSequence(
         "Cannot add an empty stop token sequence.");
   }
 
+  int state = 0;
+  for (int token_id : stop_sequence) {
+    auto [child, inserted] =
+        children_[state].try_emplace(token_id, children_.size());
+    state = child->second;
+    if (inserted) {
+      children_.emplace_back();
+      stop_sequence_lengths_.push_back(0);
+    }
+  }
   // Check if the sequence already exists
-  if (std::find(stop_sequences_storage_.begin(), stop_sequences_storage_.end(),
-                stop_sequence) != stop_sequences_storage_.end()) {
+  if (stop_sequence_lengths_[state] > 0) {
     return absl::AlreadyExistsError(
         absl::StrFormat("Stop token sequence %s already exists.",
                         PrintSequence(stop_sequence)));
   }
+  stop_sequence_lengths_[state] = stop_sequence.size();
+  token_ids_.insert(stop_sequence.begin(), stop_sequence.end());
+  BuildTransitions();
+  return absl::OkStatus();
+}
 
-  stop_sequences_storage_.push_back(stop_sequence);
+int StopTokenDetector::NextState(int state, int token_id) const {
+  auto it = transitions_.find(std::make_pair(state, token_id));
+  return it == transitions_.end() ? 0 : it->second;
+}
 
-  // Add a progress tracker for the new stop sequence for each batch item.
-  for (auto& progress_vector_for_item : batch_item_match_progress_) {
-    progress_vector_for_item.push_back(0);
+void StopTokenDetector::BuildTransitions() {
+  transitions_.clear();
+  match_lengths_.assign(children_.size(), 0);
+  // failures[s]: the state of the longest proper suffix of the prefix of s,
+  // which is shallower than s and so complete when s is reached breadth
+  // first.
+  std::vector<int> failures(children_.size(), 0);
+  std::deque<int> queue = {0};
+  while (!queue.empty()) {
+    const int state = queue.front();
+    queue.pop_front();
+    match_lengths_[state] = stop_sequence_lengths_[state] > 0
+                                ? stop_sequence_lengths_[state]
+                                : match_lengths_[failures[state]];
+    for (int token_id : token_ids_) {
+      const int failure_next_state =
+          state == 0 ? 0 : NextState(failures[state], token_id);
+      int next_state = failure_next_state;
+      if (auto child = children_[state].find(token_id);
+          child != children_[state].end()) {
+        next_state = child->second;
+        failures[next_state] = failure_next_state;
+        queue.push_back(next_state);
+      }
+      if (next_state != 0) {
+        transitions_[std::make_pair(state, token_id)] = next_state;
+      }
+    }
   }
-  return absl::OkStatus();
 }
 
 void StopTokenDetector::ResetBatch(size_t batch_size) {
   int new_batch_size = batch_size == 0 ? stop_token_found_.size() : batch_size;
   stop_token_found_.assign(new_batch_size, false);
-  // Initialize progress for each batch item for all currently defined stop
-  // sequences.
-  batch_item_match_progress_.assign(
-      new_batch_size, std::vector<int>(stop_sequences_storage_.size(), 0));
+  batch_item_states_.assign(new_batch_size, 0);
   matched_stop_sequence_length_.assign(new_batch_size, 0);
 }
 
+absl::Status StopTokenDetector::ResetBatchItem(size_t index) {
+  if (index >= stop_token_found_.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Batch item %d is out of range for batch size %d.",
+                        index, stop_token_found_.size()));
+  }
+  stop_token_found_[index] = false;
+  batch_item_states_[index] = 0;
+  matched_stop_sequence_length_[index] = 0;
+  return absl::OkStatus();
+}
+
+absl::Status StopTokenDetector::StopBatchItem(size_t index) {
+  if (index >= stop_token_found_.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Batch item %d is out of range for batch size %d.",
+                        index, stop_token_found_.size()));
+  }
+  if (!stop_token_found_[index]) {
+    stop_token_found_[index] = true;
+    matched_stop_sequence_length_[index] = 0;
+  }
+  return absl::OkStatus();
+}
+
 // Processes the latest incoming token for each sequence in the batch.
 absl::Status StopTokenDetector::ProcessTokens(
     absl::Span<const int> latest_tokens) {
@@ -76,7 +142,7 @@ absl::Status StopTokenDetector::ProcessTokens(
         "Size of latest_tokens (%d) does not match configured batch size (%d).",
         latest_tokens.size(), stop_token_found_.size()));
   }
-  if (stop_sequences_storage_.empty()) {  // No stop sequences to check against.
+  if (token_ids_.empty()) {  // No stop sequences to check against.
     return absl::InvalidArgumentError(
         "No stop sequences to check against. Did you forget to call "
         "AddStopTokenSequence()?");
@@ -89,30 +155,12 @@ absl::Status StopTokenDetector::ProcessTokens(
       continue;
     }
 
-    int current_token_id = latest_tokens[i];
-    for (size_t k = 0; k < stop_sequences_storage_.size(); ++k) {
-      const auto& stop_seq_k =
-          stop_sequences_storage_[k];  // Guaranteed non-empty
-      int& current_match_len_for_k = batch_item_match_progress_[i][k];
-
-      if (current_match_len_for_k < stop_seq_k.size() &&
-          stop_seq_k[current_match_len_for_k] == current_token_id) {
-        current_match_len_for_k++;
-      } else {
-        // Mismatch or sequence completed; reset progress for this stop_seq_k.
-        // Check if current token starts stop_seq_k anew.
-        if (stop_seq_k[0] == current_token_id) {
-          current_match_len_for_k = 1;
-        } else {
-          current_match_len_for_k = 0;
-        }
-      }
-
-      if (current_match_len_for_k > 0 &&
-          current_match_len_for_k == stop_seq_k.size()) {
-        stop_token_found_[i] = true;
-        matched_stop_sequence_length_[i] = stop_seq_k.size();
-      }
+    int& state = batch_item_states_[i];
+    state = NextState(state, latest_tokens[i]);
+    // The longest of the stop sequences ending at this token.
+    if (match_lengths_[state] > 0) {
+      stop_token_found_[i] = true;
+      matched_stop_sequence_length_[i] = match_lengths_[state];
     }
   }
   return absl::OkStatus();
@@ -2,8 +2,11 @@
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_STOP_TOKEN_DETECTOR_H_
 
 #include <cstddef>
+#include <utility>
 #include <vector>
 
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/container/flat_hash_set.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
@@ -11,8 +14,11 @@
 namespace litert::lm {
 
 // Detects stop token sequences in a batch of token streams.
-// Tracks match progress for each potential stop sequence independently per
-// batch item. Stop sequences can be added dynamically. Example usage:
+// The stop sequences are compiled into an Aho-Corasick automaton over the
+// token ids, such that each batch item keeps a single state and each token
+// costs one transition, however many stop sequences there are. Overlapping
+// stop sequences are all detected. Stop sequences can be added dynamically.
+// Example usage:
 //
 //   StopTokenDetector detector(batch_size);
 //   RETURN_IF_ERROR(detector.AddStopTokenSequence({1}));
@@ -46,6 +52,19 @@ class StopTokenDetector {
   //     passed, the detector will be reset with the same batch size.
   void ResetBatch(size_t batch_size = 0);
 
+  // Resets the detector state of a single batch item, e.g. when a new sequence
+  // takes over the item in a continuous batch. The other items are untouched.
+  //   - index: The batch item to reset. Must be less than the batch size.
+  // Returns InvalidArgumentError if the index is out of range.
+  absl::Status ResetBatchItem(size_t index);
+
+  // Marks a single batch item as stopped, e.g. when its text hits a stop
+  // string, such that it is done as if it had matched a stop sequence. The
+  // tokens it got so far are kept.
+  //   - index: The batch item to stop. Must be less than the batch size.
+  // Returns InvalidArgumentError if the index is out of range.
+  absl::Status StopBatchItem(size_t index);
+
   // Processes the latest incoming token for each sequence in the batch.
   //   - latest_tokens Span of token IDs, one per batch sequence. Size must
   //     match batch_size.
@@ -70,12 +89,32 @@ class StopTokenDetector {
   }
 
  private:
-  // Stores all added stop sequences.
-  std::vector<std::vector<int>> stop_sequences_storage_;
-
-  // batch_item_match_progress_[i][k]: current match length for batch item 'i'
-  // against stop_sequences_storage_[k].
-  std::vector<std::vector<int>> batch_item_match_progress_;
+  // Returns the state after `token_id` from `state`.
+  int NextState(int state, int token_id) const;
+
+  // Recomputes the transitions and the match lengths of all the states from
+  // the trie of the stop sequences.
+  void BuildTransitions();
+
+  // The trie of the stop sequences, where state 0 is the root and each state
+  // stands for the prefix of a stop sequence. The states are only appended,
+  // such that the states of the batch items stay valid across additions.
+  std::vector<absl::flat_hash_map<int, int>> children_;
+  // stop_sequence_lengths_[s]: the length of the stop sequence ending at
+  // state s, or 0 if s is not the end of a stop sequence.
+  std::vector<int> stop_sequence_lengths_;
+  // The token ids of the stop sequences.
+  absl::flat_hash_set<int> token_ids_;
+
+  // The transitions of the automaton leading to a state other than the root.
+  // All the other transitions lead to the root.
+  absl::flat_hash_map<std::pair<int, int>, int> transitions_;
+  // match_lengths_[s]: the length of the longest stop sequence that is a
+  // suffix of the prefix of state s, or 0 if none.
+  std::vector<int> match_lengths_;
+
+  // batch_item_states_[i]: the automaton state of batch item 'i'.
+  std::vector<int> batch_item_states_;
 
   // stop_token_found_[i]: true if batch item 'i' has matched a stop sequence.
   std::vector<bool> stop_token_found_;
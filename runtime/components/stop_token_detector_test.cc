@@ -92,6 +92,26 @@ TEST(StopTokenDetectorTest, ProcessTokensMultipleStopTokens) {
   EXPECT_EQ(1, steps_before_stop_tokens[1]);
 }
 
+TEST(StopTokenDetectorTest, ProcessTokensOverlappingStopTokens) {
+  StopTokenDetector detector(3);
+  EXPECT_OK(detector.AddStopTokenSequence({1, 1, 2}));
+  EXPECT_OK(detector.AddStopTokenSequence({3, 4, 5, 6}));
+  EXPECT_OK(detector.AddStopTokenSequence({4, 5}));
+
+  // Item 0 restarts {1, 1, 2} in the middle of a partial match, item 1 ends
+  // {4, 5} inside a partial match of {3, 4, 5, 6}, and item 2 matches a
+  // repeated partial match.
+  const std::vector<std::vector<int>> steps = {
+      {1, 3, 1}, {1, 4, 1}, {1, 5, 1}, {2, 6, 1}, {0, 0, 2}};
+  for (const auto& step : steps) {
+    EXPECT_OK(detector.ProcessTokens(absl::MakeConstSpan(step)));
+  }
+  EXPECT_TRUE(detector.AllDone().value());
+  // Item 0 matched at step 3, item 1 at step 2 and item 2 at step 4.
+  EXPECT_THAT(detector.GetStepsBeforeStopTokens(),
+              testing::ElementsAre(4, 4, 3));
+}
+
 TEST(StopTokenDetectorTest, ResetBatch) {
   StopTokenDetector detector(1);
   EXPECT_OK(detector.AddStopTokenSequence({1}));
@@ -112,5 +132,47 @@ TEST(StopTokenDetectorTest, ResetBatch) {
   EXPECT_EQ(0, detector.GetStepsBeforeStopTokens()[0]);
 }
 
+TEST(StopTokenDetectorTest, ResetBatchItem) {
+  StopTokenDetector detector(2);
+  EXPECT_OK(detector.AddStopTokenSequence({7, 8}));
+  std::vector<int> tokens = {7, 7};
+  EXPECT_OK(detector.ProcessTokens(absl::MakeSpan(tokens)));
+  tokens = {8, 8};
+  EXPECT_OK(detector.ProcessTokens(absl::MakeSpan(tokens)));
+  EXPECT_TRUE(detector.AllDone().value());
+
+  // Only batch item 1 is reset, including its partial match progress.
+  EXPECT_OK(detector.ResetBatchItem(1));
+  EXPECT_TRUE(detector.GetStopTokensFound()[0]);
+  EXPECT_FALSE(detector.GetStopTokensFound()[1]);
+  EXPECT_EQ(0, detector.GetStepsBeforeStopTokens()[1]);
+  tokens = {8, 8};
+  EXPECT_OK(detector.ProcessTokens(absl::MakeSpan(tokens)));
+  EXPECT_FALSE(detector.GetStopTokensFound()[1]);
+
+  EXPECT_EQ(absl::StatusCode::kInvalidArgument,
+            detector.ResetBatchItem(2).code());
+}
+
+TEST(StopTokenDetectorTest, StopBatchItem) {
+  StopTokenDetector detector(2);
+  EXPECT_OK(detector.AddStopTokenSequence({7}));
+  std::vector<int> tokens = {1, 2};
+  EXPECT_OK(detector.ProcessTokens(absl::MakeSpan(tokens)));
+
+  // Batch item 0 stops with no stop sequence, and counts as done.
+  EXPECT_OK(detector.StopBatchItem(0));
+  EXPECT_TRUE(detector.GetStopTokensFound()[0]);
+  EXPECT_FALSE(detector.AllDone().value());
+  EXPECT_EQ(0, detector.GetStepsBeforeStopTokens()[0]);
+  tokens = {3, 7};
+  EXPECT_OK(detector.ProcessTokens(absl::MakeSpan(tokens)));
+  EXPECT_TRUE(detector.AllDone().value());
+  EXPECT_EQ(1, detector.GetStepsBeforeStopTokens()[0]);
+
+  EXPECT_EQ(absl::StatusCode::kInvalidArgument,
+            detector.StopBatchItem(2).code());
+}
+
 }  // namespace
 }  // namespace litert::lm
@@ -0,0 +1,218 @@
+#include "runtime/components/token_constraint.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define LITERT_LM_TOKEN_MASK_X86_DISPATCH 1
+#endif
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/numeric/bits.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/json_schema_regex.h"
+#include "runtime/components/regex_automaton.h"
+#include "runtime/components/token_vocab_index.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+constexpr float kMaskedLogit = -std::numeric_limits<float>::infinity();
+
+// Masks the 32 logits of a word that is neither all set nor all clear.
+void ApplyMaskWordScalar(uint32_t word, float* logits) {
+  for (int bit = 0; bit < 32; ++bit) {
+    if ((word & (1u << bit)) == 0) {
+      logits[bit] = kMaskedLogit;
+    }
+  }
+}
+
+#if defined(LITERT_LM_TOKEN_MASK_X86_DISPATCH)
+__attribute__((target("avx2"))) void ApplyMaskWordAvx2(uint32_t word,
+                                                         float* logits) {
+  const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  const __m256 masked = _mm256_set1_ps(kMaskedLogit);
+  for (int lane = 0; lane < 32; lane += 8) {
+    const __m256i bits = _mm256_and_si256(
+        _mm256_set1_epi32(static_cast<int>(word >> lane)), lane_bits);
+    const __m256 keep =
+        _mm256_castsi256_ps(_mm256_cmpeq_epi32(bits, lane_bits));
+    _mm256_storeu_ps(logits + lane,
+                     _mm256_blendv_ps(masked, _mm256_loadu_ps(logits + lane),
+                                      keep));
+  }
+}
+#endif
+
+using ApplyMaskWordFn = void (*)(uint32_t word, float* logits);
+
+ApplyMaskWordFn GetApplyMaskWord() {
+#if defined(LITERT_LM_TOKEN_MASK_X86_DISPATCH)
+  static const ApplyMaskWordFn apply_mask_word =
+      __builtin_cpu_supports("avx2") ? ApplyMaskWordAvx2 : ApplyMaskWordScalar;
+  return apply_mask_word;
+#else
+  return ApplyMaskWordScalar;
+#endif
+}
+
+}  // namespace
+
+void ApplyTokenMask(const TokenMask& mask, absl::Span<float> logits) {
+  const size_t num_masked = std::min(logits.size(), mask.words.size() * 32);
+  const ApplyMaskWordFn apply_mask_word = GetApplyMaskWord();
+  size_t i = 0;
+  // Most of the words of a mask are all clear, or all set for the states that
+  // allow free text, so those skip the per-bit work.
+  for (; i + 32 <= num_masked; i += 32) {
+    const uint32_t word = mask.words[i / 32];
+    if (word == 0) {
+      std::fill_n(logits.data() + i, 32, kMaskedLogit);
+    } else if (word != ~0u) {
+      apply_mask_word(word, logits.data() + i);
+    }
+  }
+  for (; i < num_masked; ++i) {
+    if ((mask.words[i / 32] & (1u << (i % 32))) == 0) {
+      logits[i] = kMaskedLogit;
+    }
+  }
+  std::fill(logits.begin() + num_masked, logits.end(), kMaskedLogit);
+}
+
+// static
+absl::StatusOr<std::unique_ptr<TokenConstraint>> TokenConstraint::Create(
+    std::unique_ptr<RegexAutomaton> automaton,
+    std::shared_ptr<const TokenVocabIndex> vocab_index) {
+  RET_CHECK(automaton != nullptr && vocab_index != nullptr)
+      << "The automaton and the vocabulary index must be set.";
+  return absl::WrapUnique(
+      new TokenConstraint(std::move(automaton), std::move(vocab_index)));
+}
+
+std::unique_ptr<TokenMask> TokenConstraint::ComputeTokenMask(int state) const {
+  const TokenVocabIndex& index = *vocab_index_;
+  absl::Span<const int> sorted_token_ids = index.GetSortedTokenIds();
+  absl::Span<const int> common_prefix_lengths = index.GetCommonPrefixLengths();
+  auto mask = std::make_unique<TokenMask>();
+  mask->words.assign((index.GetVocabSize() + 31) / 32, 0);
+  // prefix_states[d] is the state after the first d bytes of the current
+  // text, valid up to `depth`. A dead prefix stays dead for all the following
+  // texts sharing it, which are then rejected without running the automaton.
+  std::vector<int> prefix_states(1, state);
+  size_t depth = 0;
+  for (size_t i = 0; i < sorted_token_ids.size(); ++i) {
+    const int token_id = sorted_token_ids[i];
+    const absl::string_view text = index.GetSortedText(i);
+    depth = std::min<size_t>(depth, common_prefix_lengths[i]);
+    if (prefix_states.size() < text.size() + 1) {
+      prefix_states.resize(text.size() + 1);
+    }
+    int next_state = prefix_states[depth];
+    while (depth < text.size() && next_state != RegexAutomaton::kDeadState) {
+      next_state =
+          automaton_->Next(next_state, static_cast<uint8_t>(text[depth]));
+      prefix_states[++depth] = next_state;
+    }
+    if (!text.empty() && depth == text.size() &&
+        next_state != RegexAutomaton::kDeadState) {
+      mask->words[token_id / 32] |= 1u << (token_id % 32);
+      ++mask->num_allowed_tokens;
+    }
+  }
+  return mask;
+}
+
+const TokenMask& TokenConstraint::GetTokenMask(int state) {
+  absl::MutexLock lock(&mutex_);
+  std::unique_ptr<TokenMask>& mask = masks_[state];
+  if (mask == nullptr) {
+    mask = ComputeTokenMask(state);
+  }
+  return *mask;
+}
+
+std::optional<int> TokenConstraint::GetForcedToken(int state) {
+  if (IsAccepting(state)) {
+    return std::nullopt;
+  }
+  const TokenMask& mask = GetTokenMask(state);
+  if (mask.num_allowed_tokens != 1) {
+    return std::nullopt;
+  }
+  for (int i = 0; i < mask.words.size(); ++i) {
+    if (mask.words[i] != 0) {
+      return i * 32 + absl::countr_zero(mask.words[i]);
+    }
+  }
+  return std::nullopt;
+}
+
+absl::StatusOr<int> TokenConstraint::Next(int state, int token_id) const {
+  RET_CHECK(token_id >= 0 && token_id < GetVocabSize())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Token " << token_id << " is out of the vocabulary.";
+  const absl::string_view text = vocab_index_->GetText(token_id);
+  const int next_state = automaton_->Next(state, text);
+  RET_CHECK(!text.empty() && next_state != RegexAutomaton::kDeadState)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Token " << token_id << " is not allowed by the constraint.";
+  return next_state;
+}
+
+int TokenConstraint::GetNumCachedMasks() const {
+  absl::MutexLock lock(&mutex_);
+  return std::count_if(masks_.begin(), masks_.end(),
+                       [](const auto& mask) { return mask != nullptr; });
+}
+
+absl::StatusOr<std::shared_ptr<TokenConstraint>>
+TokenConstraintCache::GetOrCompileRegex(absl::string_view regex) {
+  absl::MutexLock lock(&mutex_);
+  if (auto it = index_.find(regex); it != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->second;
+  }
+  ASSIGN_OR_RETURN(std::shared_ptr<const TokenVocabIndex> vocab_index,
+                   tokenizer_.GetTokenVocabIndex());
+  ASSIGN_OR_RETURN(std::unique_ptr<RegexAutomaton> automaton,
+                   RegexAutomaton::Create(regex));
+  ASSIGN_OR_RETURN(
+      std::shared_ptr<TokenConstraint> constraint,
+      TokenConstraint::Create(std::move(automaton), std::move(vocab_index)));
+  entries_.emplace_front(std::string(regex), constraint);
+  index_[entries_.front().first] = entries_.begin();
+  while (entries_.size() > max_num_constraints_) {
+    index_.erase(entries_.back().first);
+    entries_.pop_back();
+  }
+  return constraint;
+}
+
+absl::StatusOr<std::shared_ptr<TokenConstraint>>
+TokenConstraintCache::GetOrCompileJsonSchema(absl::string_view json_schema) {
+  ASSIGN_OR_RETURN(std::string regex, JsonSchemaToRegex(json_schema));
+  return GetOrCompileRegex(regex);
+}
+
+size_t TokenConstraintCache::GetNumConstraints() const {
+  absl::MutexLock lock(&mutex_);
+  return entries_.size();
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,131 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_CONSTRAINT_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_CONSTRAINT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/regex_automaton.h"
+#include "runtime/components/token_vocab_index.h"
+#include "runtime/components/tokenizer.h"
+
+namespace litert::lm {
+
+// The tokens allowed in a state of a TokenConstraint, as a packed bitset of
+// the vocabulary: token i is allowed if bit i % 32 of word i / 32 is set.
+struct TokenMask {
+  std::vector<uint32_t> words;
+  // The number of bits set.
+  int num_allowed_tokens = 0;
+};
+
+// Lifts a RegexAutomaton over bytes to the tokens of a vocabulary, such that
+// the decoding can be restricted to the tokens that keep the text matchable.
+//
+// The mask of each automaton state is computed the first time the state is
+// reached and kept for the lifetime of the constraint, which is meant to be
+// shared by all the decodes with the same regex. The methods are thread-safe.
+class TokenConstraint {
+ public:
+  // Creates a constraint over the texts of `vocab_index`, the bytes each
+  // token id adds to the text. The tokens of empty text, e.g. the special
+  // ones, are never allowed.
+  static absl::StatusOr<std::unique_ptr<TokenConstraint>> Create(
+      std::unique_ptr<RegexAutomaton> automaton,
+      std::shared_ptr<const TokenVocabIndex> vocab_index);
+
+  int GetStartState() const { return automaton_->GetStartState(); }
+  int GetVocabSize() const { return vocab_index_->GetVocabSize(); }
+
+  // Whether the text read up to `state` is a full match, i.e. the text may
+  // end there.
+  bool IsAccepting(int state) const { return automaton_->IsAccepting(state); }
+
+  // Returns the mask of the tokens that can follow `state`.
+  const TokenMask& GetTokenMask(int state) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the only token that can follow `state`, e.g. a fixed key or
+  // punctuation of a JSON schema, or std::nullopt if the text can also end
+  // there or another token can follow.
+  std::optional<int> GetForcedToken(int state) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the state after `token_id` from `state`, or an error if the token
+  // is not allowed in `state`.
+  absl::StatusOr<int> Next(int state, int token_id) const;
+
+  // Returns the number of states whose mask has been computed.
+  int GetNumCachedMasks() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  TokenConstraint(std::unique_ptr<RegexAutomaton> automaton,
+                  std::shared_ptr<const TokenVocabIndex> vocab_index)
+      : automaton_(std::move(automaton)),
+        vocab_index_(std::move(vocab_index)),
+        masks_(automaton_->GetNumStates()) {}
+
+  std::unique_ptr<TokenMask> ComputeTokenMask(int state) const;
+
+  const std::unique_ptr<RegexAutomaton> automaton_;
+  // The texts are read in their lexicographic order, such that the automaton
+  // runs once per distinct prefix.
+  const std::shared_ptr<const TokenVocabIndex> vocab_index_;
+
+  mutable absl::Mutex mutex_;
+  std::vector<std::unique_ptr<TokenMask>> masks_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Sets the logits of the tokens not allowed by `mask` to -infinity, including
+// the ones past the vocabulary of the mask.
+void ApplyTokenMask(const TokenMask& mask, absl::Span<float> logits);
+
+// Compiles and keeps the TokenConstraints of the regexes decoded with the
+// vocabulary of a tokenizer, such that each regex or JSON schema is compiled
+// once for all the sessions. The least recently used constraints are dropped
+// past `max_num_constraints`. The methods are thread-safe.
+class TokenConstraintCache {
+ public:
+  // The tokenizer must outlive the cache. Its vocabulary index is read on the
+  // first compilation.
+  TokenConstraintCache(Tokenizer* absl_nonnull tokenizer,
+                       size_t max_num_constraints)
+      : tokenizer_(*tokenizer), max_num_constraints_(max_num_constraints) {}
+
+  // Returns the constraint of `regex`, compiling it if not cached.
+  absl::StatusOr<std::shared_ptr<TokenConstraint>> GetOrCompileRegex(
+      absl::string_view regex) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Returns the constraint of the JSON texts valid under `json_schema`.
+  absl::StatusOr<std::shared_ptr<TokenConstraint>> GetOrCompileJsonSchema(
+      absl::string_view json_schema) ABSL_LOCKS_EXCLUDED(mutex_);
+
+  size_t GetNumConstraints() const ABSL_LOCKS_EXCLUDED(mutex_);
+
+ private:
+  using Entry = std::pair<std::string, std::shared_ptr<TokenConstraint>>;
+
+  Tokenizer& tokenizer_;
+  const size_t max_num_constraints_;
+
+  mutable absl::Mutex mutex_;
+  // The constraints by regex, the most recently used first.
+  std::list<Entry> entries_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, std::list<Entry>::iterator> index_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_CONSTRAINT_H_
@@ -0,0 +1,175 @@
+#include "runtime/components/token_constraint.h"
+
+#include <cmath>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/regex_automaton.h"
+#include "runtime/components/token_vocab_index.h"
+#include "runtime/components/tokenizer.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+// The vocabulary of the tests, where the token 0 is a special token.
+const std::vector<std::string>& TestTokenTexts() {
+  static const auto* const kTokenTexts = new std::vector<std::string>{
+      "", "{", "}", "\"a\"", "\"", "a", ":", "1", "12", "x", ":1"};
+  return *kTokenTexts;
+}
+
+class FakeTokenizer : public Tokenizer {
+ public:
+  absl::StatusOr<std::vector<int>> TextToTokenIds(
+      absl::string_view text) override {
+    return absl::UnimplementedError("Not used.");
+  }
+
+  absl::StatusOr<std::string> TokenIdsToText(
+      const std::vector<int>& token_ids) override {
+    return absl::UnimplementedError("Not used.");
+  }
+
+  absl::StatusOr<std::vector<std::string>> GetTokenTexts() override {
+    ++num_get_token_texts_calls;
+    return TestTokenTexts();
+  }
+
+  int num_get_token_texts_calls = 0;
+};
+
+std::unique_ptr<TokenConstraint> CreateConstraint(absl::string_view regex) {
+  auto automaton = RegexAutomaton::Create(regex);
+  EXPECT_OK(automaton);
+  auto vocab_index = TokenVocabIndex::Create(TestTokenTexts());
+  EXPECT_OK(vocab_index);
+  auto constraint =
+      TokenConstraint::Create(std::move(*automaton), std::move(*vocab_index));
+  EXPECT_OK(constraint);
+  return std::move(*constraint);
+}
+
+// Returns the ids of the tokens allowed by `mask`.
+std::vector<int> AllowedTokens(const TokenMask& mask) {
+  std::vector<int> token_ids;
+  for (int i = 0; i < mask.words.size() * 32; ++i) {
+    if (mask.words[i / 32] & (1u << (i % 32))) {
+      token_ids.push_back(i);
+    }
+  }
+  return token_ids;
+}
+
+TEST(TokenConstraintTest, MasksFollowTheRegex) {
+  auto constraint = CreateConstraint(R"(\{"a":[0-9]+\})");
+  int state = constraint->GetStartState();
+  EXPECT_THAT(AllowedTokens(constraint->GetTokenMask(state)),
+              testing::ElementsAre(1));
+
+  ASSERT_OK_AND_ASSIGN(state, constraint->Next(state, 1));
+  EXPECT_THAT(AllowedTokens(constraint->GetTokenMask(state)),
+              testing::ElementsAre(3, 4));
+
+  ASSERT_OK_AND_ASSIGN(state, constraint->Next(state, 3));
+  const TokenMask& mask = constraint->GetTokenMask(state);
+  EXPECT_THAT(AllowedTokens(mask), testing::ElementsAre(6, 10));
+  EXPECT_EQ(mask.num_allowed_tokens, 2);
+  EXPECT_THAT(constraint->Next(state, 7),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  ASSERT_OK_AND_ASSIGN(state, constraint->Next(state, 10));
+  EXPECT_THAT(AllowedTokens(constraint->GetTokenMask(state)),
+              testing::ElementsAre(2, 7, 8));
+  EXPECT_FALSE(constraint->IsAccepting(state));
+  ASSERT_OK_AND_ASSIGN(state, constraint->Next(state, 2));
+  EXPECT_TRUE(constraint->IsAccepting(state));
+  EXPECT_EQ(constraint->GetTokenMask(state).num_allowed_tokens, 0);
+  EXPECT_EQ(constraint->GetNumCachedMasks(), 5);
+}
+
+TEST(TokenConstraintTest, ForcedTokens) {
+  auto constraint = CreateConstraint(R"(\{"a":1\}?)");
+  int state = constraint->GetStartState();
+  EXPECT_EQ(constraint->GetForcedToken(state), 1);
+  ASSERT_OK_AND_ASSIGN(state, constraint->Next(state, 1));
+  // Both "\"a\"" and "\"" can follow.
+  EXPECT_EQ(constraint->GetForcedToken(state), std::nullopt);
+  ASSERT_OK_AND_ASSIGN(state, constraint->Next(state, 3));
+  EXPECT_EQ(constraint->GetForcedToken(state), std::nullopt);
+  ASSERT_OK_AND_ASSIGN(state, constraint->Next(state, 6));
+  EXPECT_EQ(constraint->GetForcedToken(state), 7);
+  ASSERT_OK_AND_ASSIGN(state, constraint->Next(state, 7));
+  // The text may end before the "}".
+  EXPECT_TRUE(constraint->IsAccepting(state));
+  EXPECT_EQ(constraint->GetForcedToken(state), std::nullopt);
+}
+
+TEST(TokenConstraintTest, SpecialTokensAreNeverAllowed) {
+  auto constraint = CreateConstraint("x*");
+  EXPECT_THAT(AllowedTokens(constraint->GetTokenMask(0)),
+              testing::ElementsAre(9));
+  EXPECT_THAT(constraint->Next(0, 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(constraint->Next(0, 11),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(TokenConstraintTest, ApplyTokenMask) {
+  // An all set word, an all clear word and a mixed word.
+  TokenMask mask;
+  mask.words = {~0u, 0u, 0x5};
+  // 80 logits end in the middle of the mixed word, and 100 go past the
+  // vocabulary of the mask.
+  for (int num_logits : {80, 100}) {
+    std::vector<float> logits(num_logits, 1.0f);
+    ApplyTokenMask(mask, absl::MakeSpan(logits));
+    for (int i = 0; i < num_logits; ++i) {
+      const bool allowed = i < 32 || i == 64 || i == 66;
+      EXPECT_EQ(std::isinf(logits[i]), !allowed) << "at " << i;
+    }
+  }
+}
+
+TEST(TokenConstraintCacheTest, CompilesEachRegexOnce) {
+  FakeTokenizer tokenizer;
+  TokenConstraintCache cache(&tokenizer, /*max_num_constraints=*/2);
+  ASSERT_OK_AND_ASSIGN(auto first, cache.GetOrCompileRegex("x+"));
+  ASSERT_OK_AND_ASSIGN(auto again, cache.GetOrCompileRegex("x+"));
+  EXPECT_EQ(first, again);
+  EXPECT_EQ(first->GetVocabSize(), TestTokenTexts().size());
+
+  ASSERT_OK_AND_ASSIGN(auto json,
+                       cache.GetOrCompileJsonSchema(R"({"type": "integer"})"));
+  EXPECT_NE(json, first);
+  EXPECT_EQ(cache.GetNumConstraints(), 2);
+  // The vocabulary is read once for all the constraints.
+  EXPECT_EQ(tokenizer.num_get_token_texts_calls, 1);
+
+  // The least recently used constraint, of the JSON schema, is dropped.
+  ASSERT_OK(cache.GetOrCompileRegex("x+").status());
+  ASSERT_OK(cache.GetOrCompileRegex("a").status());
+  EXPECT_EQ(cache.GetNumConstraints(), 2);
+  ASSERT_OK_AND_ASSIGN(auto still_cached, cache.GetOrCompileRegex("x+"));
+  EXPECT_EQ(still_cached, first);
+  ASSERT_OK_AND_ASSIGN(auto recompiled,
+                       cache.GetOrCompileJsonSchema(R"({"type": "integer"})"));
+  EXPECT_NE(recompiled, json);
+
+  EXPECT_THAT(cache.GetOrCompileRegex("(x"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
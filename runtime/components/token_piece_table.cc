@@ -0,0 +1,60 @@
+#include "runtime/components/token_piece_table.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<TokenPieceTable>> TokenPieceTable::Create(
+    absl::Span<const std::string> pieces) {
+  size_t arena_size = 0;
+  for (const std::string& piece : pieces) {
+    arena_size += piece.size();
+  }
+  RET_CHECK_LE(arena_size, std::numeric_limits<uint32_t>::max())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The pieces of the vocabulary take " << arena_size << " bytes.";
+  std::string arena;
+  arena.reserve(arena_size);
+  std::vector<uint32_t> offsets;
+  offsets.reserve(pieces.size() + 1);
+  offsets.push_back(0);
+  for (const std::string& piece : pieces) {
+    arena += piece;
+    offsets.push_back(arena.size());
+  }
+  return absl::WrapUnique(
+      new TokenPieceTable(std::move(arena), std::move(offsets)));
+}
+
+absl::Status TokenPieceTable::AppendPieces(absl::Span<const int> token_ids,
+                                           std::string* text) const {
+  size_t size = text->size();
+  for (int token_id : token_ids) {
+    RET_CHECK(token_id >= 0 && token_id < GetVocabSize())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Token id " << token_id << " is out of the vocabulary.";
+    size += offsets_[token_id + 1] - offsets_[token_id];
+  }
+  text->reserve(size);
+  for (int token_id : token_ids) {
+    const absl::string_view piece = GetPiece(token_id);
+    text->append(piece.data(), piece.size());
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,57 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_PIECE_TABLE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_PIECE_TABLE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// The decoded bytes of each token of a vocabulary, built once when the
+// tokenizer is loaded, such that detokenizing a token is a lookup and an
+// append. The bytes of all the tokens are stored in one arena, and token i
+// spans [offsets[i], offsets[i + 1]) of it.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto table, TokenPieceTable::Create(token_texts));
+//   std::string text;
+//   RETURN_IF_ERROR(table->AppendPieces(token_ids, &text));
+class TokenPieceTable {
+ public:
+  // Creates the table of `pieces`, the decoded bytes indexed by token id.
+  static absl::StatusOr<std::unique_ptr<TokenPieceTable>> Create(
+      absl::Span<const std::string> pieces);
+
+  int GetVocabSize() const { return offsets_.size() - 1; }
+
+  // Returns the bytes of `token_id`, which must be in the vocabulary.
+  absl::string_view GetPiece(int token_id) const {
+    return absl::string_view(arena_).substr(
+        offsets_[token_id], offsets_[token_id + 1] - offsets_[token_id]);
+  }
+
+  // Appends the bytes of the tokens to `text`, or returns an error if one of
+  // them is out of the vocabulary.
+  absl::Status AppendPieces(absl::Span<const int> token_ids,
+                            std::string* text) const;
+
+ private:
+  TokenPieceTable(std::string arena, std::vector<uint32_t> offsets)
+      : arena_(std::move(arena)), offsets_(std::move(offsets)) {}
+
+  const std::string arena_;
+  // The vocabulary size + 1 offsets of the pieces in `arena_`.
+  const std::vector<uint32_t> offsets_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_PIECE_TABLE_H_
@@ -0,0 +1,35 @@
+#include "runtime/components/token_piece_table.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+TEST(TokenPieceTableTest, AppendsThePiecesOfTheTokens) {
+  const std::vector<std::string> pieces = {"", " Hello", "\xc3", "!"};
+  ASSERT_OK_AND_ASSIGN(auto table, TokenPieceTable::Create(pieces));
+  EXPECT_EQ(table->GetVocabSize(), 4);
+  EXPECT_EQ(table->GetPiece(0), "");
+  EXPECT_EQ(table->GetPiece(1), " Hello");
+
+  std::string text = ">";
+  ASSERT_OK(table->AppendPieces({1, 0, 3, 2}, &text));
+  EXPECT_EQ(text, "> Hello!\xc3");
+
+  EXPECT_THAT(table->AppendPieces({1, 4}, &text),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(table->AppendPieces({-1}, &text),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // Nothing is appended on error.
+  EXPECT_EQ(text, "> Hello!\xc3");
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,219 @@
+#include "runtime/components/token_vocab_index.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/strings/strip.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/util/binary_serialization.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// The magic and the version of the serialized indexes.
+constexpr absl::string_view kIndexMagic = "LMVI";
+constexpr uint32_t kIndexVersion = 1;
+
+absl::Status InvalidIndexError(absl::string_view reason) {
+  return absl::InvalidArgumentError(
+      absl::StrCat("Invalid token vocabulary index: ", reason));
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<TokenVocabIndex>> TokenVocabIndex::Create(
+    absl::Span<const std::string> token_texts) {
+  size_t arena_size = 0;
+  for (const std::string& text : token_texts) {
+    arena_size += text.size();
+  }
+  RET_CHECK_LE(arena_size, std::numeric_limits<uint32_t>::max())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The texts of the vocabulary take " << arena_size << " bytes.";
+  std::vector<int> sorted_token_ids(token_texts.size());
+  std::iota(sorted_token_ids.begin(), sorted_token_ids.end(), 0);
+  std::stable_sort(sorted_token_ids.begin(), sorted_token_ids.end(),
+                   [&token_texts](int a, int b) {
+                     return token_texts[a] < token_texts[b];
+                   });
+  std::string arena;
+  arena.reserve(arena_size);
+  std::vector<uint32_t> offsets;
+  offsets.reserve(token_texts.size() + 1);
+  offsets.push_back(0);
+  for (int token_id : sorted_token_ids) {
+    arena += token_texts[token_id];
+    offsets.push_back(arena.size());
+  }
+  return absl::WrapUnique(new TokenVocabIndex(
+      std::move(arena), std::move(offsets), std::move(sorted_token_ids)));
+}
+
+// static
+absl::StatusOr<std::unique_ptr<TokenVocabIndex>> TokenVocabIndex::Parse(
+    absl::string_view serialized_index) {
+  absl::string_view in = serialized_index;
+  if (!absl::ConsumePrefix(&in, kIndexMagic)) {
+    return InvalidIndexError("bad magic");
+  }
+  uint32_t version = 0;
+  if (!ConsumeValue(in, version) || version != kIndexVersion) {
+    return InvalidIndexError(absl::StrCat("unsupported version ", version));
+  }
+  uint32_t vocab_size = 0;
+  if (!ConsumeValue(in, vocab_size) ||
+      in.size() / (sizeof(int32_t) + sizeof(uint32_t)) < vocab_size) {
+    return InvalidIndexError("truncated header");
+  }
+  std::vector<int> sorted_token_ids(vocab_size);
+  std::vector<bool> seen(vocab_size, false);
+  for (int& token_id : sorted_token_ids) {
+    int32_t value = 0;
+    ConsumeValue(in, value);
+    if (value < 0 || value >= vocab_size || seen[value]) {
+      return InvalidIndexError(absl::StrCat("bad token id ", value));
+    }
+    seen[value] = true;
+    token_id = value;
+  }
+  std::vector<uint32_t> offsets(vocab_size + 1, 0);
+  for (uint32_t i = 1; i <= vocab_size; ++i) {
+    ConsumeValue(in, offsets[i]);
+    if (offsets[i] < offsets[i - 1]) {
+      return InvalidIndexError("decreasing offsets");
+    }
+  }
+  if (in.size() != offsets.back()) {
+    return InvalidIndexError("the texts do not match the offsets");
+  }
+  std::string arena(in);
+  for (uint32_t i = 1; i < vocab_size; ++i) {
+    const absl::string_view arena_view(arena);
+    if (arena_view.substr(offsets[i], offsets[i + 1] - offsets[i]) <
+        arena_view.substr(offsets[i - 1], offsets[i] - offsets[i - 1])) {
+      return InvalidIndexError("unsorted texts");
+    }
+  }
+  return absl::WrapUnique(new TokenVocabIndex(
+      std::move(arena), std::move(offsets), std::move(sorted_token_ids)));
+}
+
+TokenVocabIndex::TokenVocabIndex(std::string arena,
+                                 std::vector<uint32_t> offsets,
+                                 std::vector<int> sorted_token_ids)
+    : arena_(std::move(arena)),
+      offsets_(std::move(offsets)),
+      sorted_token_ids_(std::move(sorted_token_ids)),
+      ranks_(sorted_token_ids_.size()),
+      common_prefix_lengths_(sorted_token_ids_.size(), 0) {
+  for (int i = 0; i < sorted_token_ids_.size(); ++i) {
+    ranks_[sorted_token_ids_[i]] = i;
+    const absl::string_view text = GetSortedText(i);
+    if (text.empty()) {
+      ++num_empty_texts_;
+    }
+    if (i > 0) {
+      const absl::string_view previous = GetSortedText(i - 1);
+      const size_t max_length = std::min(previous.size(), text.size());
+      int length = 0;
+      while (length < max_length && previous[length] == text[length]) {
+        ++length;
+      }
+      common_prefix_lengths_[i] = length;
+    }
+  }
+}
+
+std::string TokenVocabIndex::Serialize() const {
+  std::string out(kIndexMagic);
+  AppendValue(kIndexVersion, out);
+  AppendValue<uint32_t>(sorted_token_ids_.size(), out);
+  for (int token_id : sorted_token_ids_) {
+    AppendValue<int32_t>(token_id, out);
+  }
+  for (size_t i = 1; i < offsets_.size(); ++i) {
+    AppendValue<uint32_t>(offsets_[i], out);
+  }
+  out += arena_;
+  return out;
+}
+
+std::pair<int, int> TokenVocabIndex::NarrowRange(int begin, int end,
+                                                 int depth, char c) const {
+  // The texts compare as unsigned bytes, and the ones of `depth` bytes, which
+  // have no byte at `depth`, come first.
+  const uint8_t byte = static_cast<uint8_t>(c);
+  auto byte_at_depth = [this, depth](int i) {
+    const absl::string_view text = GetSortedText(i);
+    return text.size() > depth ? static_cast<int>(
+                                     static_cast<uint8_t>(text[depth]))
+                               : -1;
+  };
+  int low = begin;
+  int high = end;
+  while (low < high) {
+    const int mid = low + (high - low) / 2;
+    if (byte_at_depth(mid) < byte) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  const int range_begin = low;
+  high = end;
+  while (low < high) {
+    const int mid = low + (high - low) / 2;
+    if (byte_at_depth(mid) <= byte) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+  return {range_begin, low};
+}
+
+absl::Span<const int> TokenVocabIndex::GetTokensWithPrefix(
+    absl::string_view prefix) const {
+  int begin = num_empty_texts_;
+  int end = GetVocabSize();
+  for (int depth = 0; depth < prefix.size() && begin < end; ++depth) {
+    std::tie(begin, end) = NarrowRange(begin, end, depth, prefix[depth]);
+  }
+  return absl::MakeConstSpan(sorted_token_ids_).subspan(begin, end - begin);
+}
+
+std::vector<int> TokenVocabIndex::GetTokensPrefixOf(
+    absl::string_view text) const {
+  std::vector<int> token_ids;
+  int begin = num_empty_texts_;
+  int end = GetVocabSize();
+  for (int depth = 0; depth < text.size(); ++depth) {
+    std::tie(begin, end) = NarrowRange(begin, end, depth, text[depth]);
+    if (begin == end) {
+      break;
+    }
+    // The texts of exactly `depth` + 1 bytes sort first in the range.
+    for (int i = begin; i < end && GetSortedText(i).size() == depth + 1;
+         ++i) {
+      token_ids.push_back(sorted_token_ids_[i]);
+    }
+  }
+  return token_ids;
+}
+
+}  // namespace litert::lm
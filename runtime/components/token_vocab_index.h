@@ -0,0 +1,94 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_VOCAB_INDEX_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_VOCAB_INDEX_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// The texts of the tokens of a vocabulary in lexicographic byte order, such
+// that the tokens sharing a prefix are contiguous, e.g. for the constrained
+// decoding, the token healing or the stop strings. The texts are stored in
+// one arena in that order, so a prefix range is scanned sequentially. Built
+// once per tokenizer, see Tokenizer::GetTokenVocabIndex(), and immutable, so
+// it is shared by all the sessions.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto index, TokenVocabIndex::Create(token_texts));
+//   for (int token_id : index->GetTokensWithPrefix(" wor")) { ... }
+class TokenVocabIndex {
+ public:
+  // Creates the index of `token_texts`, the bytes each token id adds to the
+  // text, indexed by token id.
+  static absl::StatusOr<std::unique_ptr<TokenVocabIndex>> Create(
+      absl::Span<const std::string> token_texts);
+
+  // Parses an index serialized by Serialize(). Returns an InvalidArgument
+  // error if `serialized_index` is not one.
+  static absl::StatusOr<std::unique_ptr<TokenVocabIndex>> Parse(
+      absl::string_view serialized_index);
+
+  // Serializes the index into a compact binary form, which Parse() reads
+  // without sorting the texts again.
+  std::string Serialize() const;
+
+  int GetVocabSize() const { return sorted_token_ids_.size(); }
+
+  // Returns the text of `token_id`, which must be in the vocabulary.
+  absl::string_view GetText(int token_id) const {
+    return GetSortedText(ranks_[token_id]);
+  }
+
+  // The token ids in the lexicographic order of their texts, the tokens of
+  // empty text first, and the text of the i-th of them.
+  absl::Span<const int> GetSortedTokenIds() const { return sorted_token_ids_; }
+  absl::string_view GetSortedText(int i) const {
+    return absl::string_view(arena_).substr(offsets_[i],
+                                            offsets_[i + 1] - offsets_[i]);
+  }
+  // The length of the prefix the i-th sorted text shares with the previous
+  // one, 0 for the first one.
+  absl::Span<const int> GetCommonPrefixLengths() const {
+    return common_prefix_lengths_;
+  }
+
+  // Returns the tokens whose text starts with `prefix`, in the order of their
+  // texts. The tokens of empty text are never returned.
+  absl::Span<const int> GetTokensWithPrefix(absl::string_view prefix) const;
+
+  // Returns the tokens whose text is a prefix of `text`, the shortest first.
+  // The tokens of empty text are never returned.
+  std::vector<int> GetTokensPrefixOf(absl::string_view text) const;
+
+ private:
+  TokenVocabIndex(std::string arena, std::vector<uint32_t> offsets,
+                  std::vector<int> sorted_token_ids);
+
+  // Returns the range [begin, end) of the sorted texts in [begin, end)
+  // having the byte `c` at `depth`, where they all share their first `depth`
+  // bytes.
+  std::pair<int, int> NarrowRange(int begin, int end, int depth,
+                                  char c) const;
+
+  const std::string arena_;
+  // The vocabulary size + 1 offsets of the sorted texts in `arena_`.
+  const std::vector<uint32_t> offsets_;
+  const std::vector<int> sorted_token_ids_;
+  // The position of each token id in `sorted_token_ids_`.
+  std::vector<int> ranks_;
+  std::vector<int> common_prefix_lengths_;
+  // The number of tokens of empty text, which are sorted first.
+  int num_empty_texts_ = 0;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKEN_VOCAB_INDEX_H_
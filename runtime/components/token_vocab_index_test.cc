@@ -0,0 +1,92 @@
+#include "runtime/components/token_vocab_index.h"
+
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::UnorderedElementsAre;
+using ::testing::status::StatusIs;
+
+const std::vector<std::string>& GetTokenTexts() {
+  static const auto* const kTokenTexts = new std::vector<std::string>{
+      "", " w", " wor", " world", "a", "\xc3\xa9", " wo", "", " wor", "b"};
+  return *kTokenTexts;
+}
+
+TEST(TokenVocabIndexTest, SortsTheTexts) {
+  ASSERT_OK_AND_ASSIGN(auto index, TokenVocabIndex::Create(GetTokenTexts()));
+  EXPECT_EQ(index->GetVocabSize(), 10);
+  EXPECT_EQ(index->GetText(3), " world");
+  EXPECT_EQ(index->GetText(7), "");
+  // The bytes compare unsigned, so "\xc3\xa9" sorts last.
+  EXPECT_THAT(index->GetSortedTokenIds(),
+              ElementsAre(0, 7, 1, 6, 2, 8, 3, 4, 9, 5));
+  EXPECT_THAT(index->GetCommonPrefixLengths(),
+              ElementsAre(0, 0, 0, 2, 3, 4, 4, 0, 0, 0));
+  EXPECT_EQ(index->GetSortedText(3), " wo");
+}
+
+TEST(TokenVocabIndexTest, GetsTheTokensWithAPrefix) {
+  ASSERT_OK_AND_ASSIGN(auto index, TokenVocabIndex::Create(GetTokenTexts()));
+  EXPECT_THAT(index->GetTokensWithPrefix(" wor"), ElementsAre(2, 8, 3));
+  EXPECT_THAT(index->GetTokensWithPrefix(" w"), ElementsAre(1, 6, 2, 8, 3));
+  EXPECT_THAT(index->GetTokensWithPrefix("\xc3"), ElementsAre(5));
+  EXPECT_THAT(index->GetTokensWithPrefix(" worlds"), IsEmpty());
+  EXPECT_THAT(index->GetTokensWithPrefix("c"), IsEmpty());
+  // All the tokens but the ones of empty text.
+  EXPECT_EQ(index->GetTokensWithPrefix("").size(), 8);
+}
+
+TEST(TokenVocabIndexTest, GetsTheTokensPrefixOfAText) {
+  ASSERT_OK_AND_ASSIGN(auto index, TokenVocabIndex::Create(GetTokenTexts()));
+  EXPECT_THAT(index->GetTokensPrefixOf(" worlds"),
+              ElementsAre(1, 6, 2, 8, 3));
+  EXPECT_THAT(index->GetTokensPrefixOf(" wx"), ElementsAre(1));
+  EXPECT_THAT(index->GetTokensPrefixOf("ab"), ElementsAre(4));
+  EXPECT_THAT(index->GetTokensPrefixOf("c"), IsEmpty());
+  EXPECT_THAT(index->GetTokensPrefixOf(""), IsEmpty());
+}
+
+TEST(TokenVocabIndexTest, ParsesTheSerializedIndex) {
+  ASSERT_OK_AND_ASSIGN(auto index, TokenVocabIndex::Create(GetTokenTexts()));
+  ASSERT_OK_AND_ASSIGN(auto parsed,
+                       TokenVocabIndex::Parse(index->Serialize()));
+  EXPECT_EQ(parsed->GetVocabSize(), index->GetVocabSize());
+  for (int token_id = 0; token_id < index->GetVocabSize(); ++token_id) {
+    EXPECT_EQ(parsed->GetText(token_id), index->GetText(token_id));
+  }
+  EXPECT_THAT(parsed->GetTokensWithPrefix(" wo"),
+              UnorderedElementsAre(6, 2, 8, 3));
+  EXPECT_THAT(parsed->GetCommonPrefixLengths(),
+              ElementsAre(0, 0, 0, 2, 3, 4, 4, 0, 0, 0));
+}
+
+TEST(TokenVocabIndexTest, RejectsACorruptedIndex) {
+  ASSERT_OK_AND_ASSIGN(auto index, TokenVocabIndex::Create(GetTokenTexts()));
+  const std::string serialized = index->Serialize();
+  EXPECT_THAT(TokenVocabIndex::Parse("LMVX"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TokenVocabIndex::Parse(serialized.substr(0, 20)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TokenVocabIndex::Parse(serialized + "x"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // Swaps the texts "a" and "b", which are next to each other.
+  std::string unsorted = serialized;
+  const size_t a = unsorted.rfind("ab");
+  ASSERT_NE(a, std::string::npos);
+  std::swap(unsorted[a], unsorted[a + 1]);
+  EXPECT_THAT(TokenVocabIndex::Parse(unsorted),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
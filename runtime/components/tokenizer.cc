@@ -0,0 +1,167 @@
+#include "runtime/components/tokenizer.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/blocking_counter.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/token_vocab_index.h"
+#include "runtime/framework/threadpool.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// Decodes the pending tokens with TokenIdsToText until they are a complete
+// BPE sequence.
+class RetryingStreamingDetokenizer : public StreamingDetokenizer {
+ public:
+  explicit RetryingStreamingDetokenizer(Tokenizer& tokenizer)
+      : tokenizer_(tokenizer) {}
+
+  absl::StatusOr<std::string> Add(int token_id) override {
+    pending_token_ids_.push_back(token_id);
+    absl::StatusOr<std::string> text =
+        tokenizer_.TokenIdsToText(pending_token_ids_);
+    if (Tokenizer::IsIncompleteBpeSequence(text)) {
+      return std::string();
+    }
+    pending_token_ids_.clear();
+    return text;
+  }
+
+ private:
+  Tokenizer& tokenizer_;
+  TokenIds pending_token_ids_;
+};
+
+}  // namespace
+
+size_t CompleteUtf8PrefixLength(absl::string_view text) {
+  // An incomplete character is at most 3 bytes, so only the last ones are
+  // looked at.
+  const size_t min_start = text.size() < 3 ? 0 : text.size() - 3;
+  for (size_t start = text.size(); start > min_start; --start) {
+    const uint8_t byte = static_cast<uint8_t>(text[start - 1]);
+    if ((byte & 0xC0) == 0x80) {
+      // A continuation byte, the lead byte is further back.
+      continue;
+    }
+    size_t length = 1;
+    if ((byte & 0xE0) == 0xC0) {
+      length = 2;
+    } else if ((byte & 0xF0) == 0xE0) {
+      length = 3;
+    } else if ((byte & 0xF8) == 0xF0) {
+      length = 4;
+    }
+    return text.size() - (start - 1) < length ? start - 1 : text.size();
+  }
+  return text.size();
+}
+
+std::vector<absl::string_view> SplitTextForEncoding(absl::string_view text,
+                                                    size_t min_chunk_size) {
+  std::vector<absl::string_view> chunks;
+  size_t start = 0;
+  size_t end = min_chunk_size;
+  // The last chunk is left at least `min_chunk_size` long too.
+  while (min_chunk_size > 0 && end + min_chunk_size < text.size()) {
+    // A single space between two words, such that the runs of spaces, which
+    // the tokenizers may merge, are not split.
+    if (text[end] == ' ' && !absl::ascii_isspace(text[end - 1]) &&
+        !absl::ascii_isspace(text[end + 1])) {
+      chunks.push_back(text.substr(start, end - start));
+      start = end;
+      end += min_chunk_size;
+    } else {
+      ++end;
+    }
+  }
+  chunks.push_back(text.substr(start));
+  return chunks;
+}
+
+absl::StatusOr<std::vector<TokenIds>> Tokenizer::TextsToTokenIds(
+    absl::Span<const absl::string_view> texts,
+    ThreadPool* absl_nullable thread_pool) {
+  std::vector<absl::StatusOr<TokenIds>> results(texts.size());
+  if (thread_pool == nullptr || texts.size() <= 1) {
+    for (int i = 0; i < texts.size(); ++i) {
+      results[i] = TextToTokenIds(texts[i]);
+    }
+  } else {
+    // The first text is encoded on the calling thread while the others are
+    // on the pool.
+    absl::BlockingCounter pending_texts(texts.size() - 1);
+    auto encode = [this, &texts, &results, &pending_texts](int i) {
+      results[i] = TextToTokenIds(texts[i]);
+      pending_texts.DecrementCount();
+    };
+    for (int i = 1; i < texts.size(); ++i) {
+      if (!thread_pool->Schedule([&encode, i] { encode(i); }).ok()) {
+        encode(i);
+      }
+    }
+    results[0] = TextToTokenIds(texts[0]);
+    pending_texts.Wait();
+  }
+  std::vector<TokenIds> token_ids(texts.size());
+  for (int i = 0; i < texts.size(); ++i) {
+    if (!results[i].ok()) {
+      return results[i].status();
+    }
+    token_ids[i] = *std::move(results[i]);
+  }
+  return token_ids;
+}
+
+absl::StatusOr<TokenIds> Tokenizer::TextToTokenIdsInChunks(
+    absl::string_view text, ThreadPool* absl_nullable thread_pool,
+    size_t min_chunk_size) {
+  if (thread_pool == nullptr || text.size() < 2 * min_chunk_size) {
+    return TextToTokenIds(text);
+  }
+  const std::vector<absl::string_view> chunks =
+      SplitTextForEncoding(text, min_chunk_size);
+  ASSIGN_OR_RETURN(std::vector<TokenIds> chunk_token_ids,
+                   TextsToTokenIds(chunks, thread_pool));
+  TokenIds token_ids;
+  for (const TokenIds& ids : chunk_token_ids) {
+    token_ids.insert(token_ids.end(), ids.begin(), ids.end());
+  }
+  return token_ids;
+}
+
+std::unique_ptr<StreamingDetokenizer> Tokenizer::CreateStreamingDetokenizer() {
+  return std::make_unique<RetryingStreamingDetokenizer>(*this);
+}
+
+absl::StatusOr<std::shared_ptr<const TokenVocabIndex>>
+Tokenizer::GetTokenVocabIndex() {
+  // Held while the index is built, such that it is built once.
+  absl::MutexLock lock(&token_vocab_index_mutex_);
+  if (token_vocab_index_ == nullptr) {
+    ASSIGN_OR_RETURN(std::vector<std::string> token_texts, GetTokenTexts());
+    ASSIGN_OR_RETURN(token_vocab_index_, TokenVocabIndex::Create(token_texts));
+  }
+  return token_vocab_index_;
+}
+
+void Tokenizer::SetTokenVocabIndex(
+    std::shared_ptr<const TokenVocabIndex> index) {
+  absl::MutexLock lock(&token_vocab_index_mutex_);
+  token_vocab_index_ = std::move(index);
+}
+
+}  // namespace litert::lm
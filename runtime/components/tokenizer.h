@@ -1,21 +1,56 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKENIZER_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOKENIZER_H_
 
+#include <cstddef>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_macros.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/token_vocab_index.h"
+#include "runtime/framework/threadpool.h"
 #include "runtime/util/convert_tensor_buffer.h"
 
 namespace litert::lm {
 
 typedef std::vector<int> TokenIds;
 
+// Decodes the token ids of a text one at a time, e.g. as the model samples
+// them. The bytes that do not complete a character yet, e.g. the first byte
+// fallback pieces of a multi-byte character, are kept until a later token
+// completes it, so each token is decoded once.
+class StreamingDetokenizer {
+ public:
+  virtual ~StreamingDetokenizer() = default;
+
+  // Appends the token to the text, and returns the text it completes, which
+  // is empty while a character is incomplete.
+  virtual absl::StatusOr<std::string> Add(int token_id) = 0;
+};
+
+// Returns the length of the longest prefix of `text` that does not end with
+// an incomplete UTF-8 character, i.e. a lead byte missing some of its
+// continuation bytes. The invalid bytes are not held back.
+size_t CompleteUtf8PrefixLength(absl::string_view text);
+
+// The chunks of a long text encoded in parallel are at least this long.
+constexpr size_t kDefaultMinEncodeChunkSize = 4096;
+
+// Splits `text` into chunks of at least `min_chunk_size` bytes, except the
+// last one. Each chunk but the first starts with the single space before a
+// word, which SentencePiece and the pretokenizers of HuggingFace both keep
+// with the word, so the chunks encode to the same tokens as the whole text.
+std::vector<absl::string_view> SplitTextForEncoding(absl::string_view text,
+                                                    size_t min_chunk_size);
+
 class Tokenizer {
  public:
   virtual ~Tokenizer() = default;
@@ -23,6 +58,20 @@ class Tokenizer {
   // Encodes the given text into a sequence of token ids.
   virtual absl::StatusOr<TokenIds> TextToTokenIds(absl::string_view text) = 0;
 
+  // Encodes each of the texts, in parallel on `thread_pool` if set, in which
+  // case TextToTokenIds must be safe to call concurrently, as it is for the
+  // SentencePiece and HuggingFace tokenizers.
+  absl::StatusOr<std::vector<TokenIds>> TextsToTokenIds(
+      absl::Span<const absl::string_view> texts,
+      ThreadPool* absl_nullable thread_pool = nullptr);
+
+  // Encodes a long text as the chunks of SplitTextForEncoding(), in parallel
+  // on `thread_pool`. The text is encoded whole without a pool or when it is
+  // shorter than two chunks.
+  absl::StatusOr<TokenIds> TextToTokenIdsInChunks(
+      absl::string_view text, ThreadPool* absl_nullable thread_pool,
+      size_t min_chunk_size = kDefaultMinEncodeChunkSize);
+
   // Returns BOS id.
   virtual absl::StatusOr<int> BosId() const {
     return absl::UnimplementedError("BosId is not implemented.");
@@ -33,13 +82,14 @@ class Tokenizer {
     return absl::UnimplementedError("EosId is not implemented.");
   };
 
-  // Helper function to convert a vector of token ids into a 1D
-  // litert::TensorBuffer of shape [batch_size(==1), num_tokens].
+  // Helper function to convert a span of token ids into a 1D
+  // litert::TensorBuffer of shape [batch_size(==1), num_tokens]. The ids are
+  // copied once, and the executor reads them in place from the buffer.
   absl::StatusOr<TensorBuffer> TokenIdsToTensorBuffer(
-      const TokenIds& token_ids) {
+      absl::Span<const int> token_ids) {
     LITERT_ASSIGN_OR_RETURN(auto tensor,
                             CopyToTensorBuffer<int>(
-                                absl::MakeConstSpan(token_ids),
+                                token_ids,
                                 {1, static_cast<int>(token_ids.size())}));
     return tensor;
   }
@@ -50,6 +100,31 @@ class Tokenizer {
   virtual absl::StatusOr<std::string> TokenIdsToText(
       const TokenIds& token_ids) = 0;
 
+  // Creates a detokenizer of the token ids of one text. The default one
+  // decodes the tokens with TokenIdsToText, and retries the ones of an
+  // incomplete BPE sequence together with the next token.
+  virtual std::unique_ptr<StreamingDetokenizer> CreateStreamingDetokenizer();
+
+  // Returns the text each token id adds when decoded after other tokens,
+  // indexed by token id. The text is empty for the tokens without text of
+  // their own, e.g. the control ones. The constrained decoding matches these
+  // texts against its constraint.
+  virtual absl::StatusOr<std::vector<std::string>> GetTokenTexts() {
+    return absl::UnimplementedError("GetTokenTexts is not implemented.");
+  }
+
+  // Returns the index of the texts of GetTokenTexts(), sorted for the prefix
+  // queries over the vocabulary. It is built on the first call and kept by
+  // the tokenizer, which the model resources own, so all the sessions share
+  // it. Thread-safe.
+  absl::StatusOr<std::shared_ptr<const TokenVocabIndex>> GetTokenVocabIndex()
+      ABSL_LOCKS_EXCLUDED(token_vocab_index_mutex_);
+
+  // Sets the index returned by GetTokenVocabIndex(), e.g. one parsed from a
+  // file, instead of building it. It must index the texts of GetTokenTexts().
+  void SetTokenVocabIndex(std::shared_ptr<const TokenVocabIndex> index)
+      ABSL_LOCKS_EXCLUDED(token_vocab_index_mutex_);
+
   // Converts a tensor buffer of token ids into a vector of token ids. The input
   // is a 2D litert::TensorBuffer shape [batch_size, decode_steps].
   static absl::StatusOr<std::vector<TokenIds>> TensorBufferToTokenIds(
@@ -89,7 +164,7 @@ class Tokenizer {
   // corresponding batch.
   // Returns absl::DataLossError if any of the tokens are part of an incomplete
   // BPE sequence.
-  absl::StatusOr<std::vector<std::string>> TokenIdsToTexts(
+  virtual absl::StatusOr<std::vector<std::string>> TokenIdsToTexts(
       int batch_size, const std::vector<TokenIds>& token_ids) {
     std::vector<std::string> decoded_strings(batch_size);
     if (token_ids.size() != batch_size) {
@@ -111,6 +186,11 @@ class Tokenizer {
   static bool IsIncompleteBpeSequence(const absl::StatusOr<T>& result) {
     return result.status().code() == absl::StatusCode::kDataLoss;
   }
+
+ private:
+  absl::Mutex token_vocab_index_mutex_;
+  std::shared_ptr<const TokenVocabIndex> token_vocab_index_
+      ABSL_GUARDED_BY(token_vocab_index_mutex_);
 };
 
 }  // namespace litert::lm
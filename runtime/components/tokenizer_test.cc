@@ -11,21 +11,28 @@
 #include <gtest/gtest.h>
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "litert/cc/litert_layout.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "litert/test/matchers.h"  // from @litert
+#include "runtime/framework/threadpool.h"
 #include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/test_utils.h"  // NOLINT
 
 namespace litert::lm {
 namespace {
 
+using ::testing::status::IsOkAndHolds;
+
 class MockTokenizer : public Tokenizer {
  public:
   MOCK_METHOD(absl::StatusOr<std::vector<int>>, TextToTokenIds,
               (absl::string_view text), (override));
   MOCK_METHOD(absl::StatusOr<std::string>, TokenIdsToText,
               (const std::vector<int>& token_ids), (override));
+  MOCK_METHOD(absl::StatusOr<std::vector<std::string>>, GetTokenTexts, (),
+              (override));
 };
 
 TEST(TokenizerTest, TextToTensorBuffer) {
@@ -86,6 +93,71 @@ TEST(TokenizerTest, TokenIdsToTexts) {
   EXPECT_EQ(texts.value()[1], "▁How's▁it▁going?");
 }
 
+TEST(TokenizerTest, CompleteUtf8PrefixLength) {
+  EXPECT_EQ(CompleteUtf8PrefixLength(""), 0);
+  EXPECT_EQ(CompleteUtf8PrefixLength("abc"), 3);
+  // "é" is \xc3\xa9 and "€" is \xe2\x82\xac.
+  EXPECT_EQ(CompleteUtf8PrefixLength("a\xc3\xa9"), 3);
+  EXPECT_EQ(CompleteUtf8PrefixLength("a\xc3"), 1);
+  EXPECT_EQ(CompleteUtf8PrefixLength("a\xe2\x82"), 1);
+  EXPECT_EQ(CompleteUtf8PrefixLength("\xe2\x82\xac"), 3);
+  // A stray continuation byte is not held back.
+  EXPECT_EQ(CompleteUtf8PrefixLength("a\x82"), 2);
+}
+
+TEST(TokenizerTest, StreamingDetokenizerRetriesIncompleteBpeSequences) {
+  MockTokenizer tokenizer;
+  EXPECT_CALL(tokenizer, TokenIdsToText(std::vector<int>{1}))
+      .WillOnce(testing::Return(absl::DataLossError("Incomplete")));
+  EXPECT_CALL(tokenizer, TokenIdsToText(std::vector<int>{1, 2}))
+      .WillOnce(testing::Return("\xc3\xa9"));
+  EXPECT_CALL(tokenizer, TokenIdsToText(std::vector<int>{3}))
+      .WillOnce(testing::Return("a"));
+  std::unique_ptr<StreamingDetokenizer> detokenizer =
+      tokenizer.CreateStreamingDetokenizer();
+  EXPECT_THAT(detokenizer->Add(1), IsOkAndHolds(""));
+  EXPECT_THAT(detokenizer->Add(2), IsOkAndHolds("\xc3\xa9"));
+  EXPECT_THAT(detokenizer->Add(3), IsOkAndHolds("a"));
+}
+
+TEST(TokenizerTest, SplitTextForEncoding) {
+  // The runs of spaces are not split, and the last chunk is at least as long
+  // as the others.
+  EXPECT_THAT(SplitTextForEncoding("aaa bbb  ccc ddd ee", /*min_chunk_size=*/3),
+              testing::ElementsAre("aaa", " bbb  ccc", " ddd ee"));
+  EXPECT_THAT(SplitTextForEncoding("a b", /*min_chunk_size=*/3),
+              testing::ElementsAre("a b"));
+}
+
+TEST(TokenizerTest, TextToTokenIdsInChunks) {
+  MockTokenizer tokenizer;
+  // Encodes each byte to a token.
+  EXPECT_CALL(tokenizer, TextToTokenIds(testing::_))
+      .WillRepeatedly([](absl::string_view text) {
+        return std::vector<int>(text.begin(), text.end());
+      });
+  std::string text;
+  for (int i = 0; i < 100; ++i) {
+    absl::StrAppend(&text, "word", i, " ");
+  }
+  ThreadPool thread_pool(/*name_prefix=*/"tokenizer_test",
+                         /*max_num_threads=*/3);
+  ASSERT_OK_AND_ASSIGN(auto token_ids,
+                       tokenizer.TextToTokenIdsInChunks(
+                           text, &thread_pool, /*min_chunk_size=*/16));
+  EXPECT_EQ(std::string(token_ids.begin(), token_ids.end()), text);
+}
+
+TEST(TokenizerTest, GetTokenVocabIndexBuildsTheIndexOnce) {
+  MockTokenizer tokenizer;
+  EXPECT_CALL(tokenizer, GetTokenTexts())
+      .WillOnce(testing::Return(std::vector<std::string>{"", "ab", "a"}));
+  ASSERT_OK_AND_ASSIGN(auto index, tokenizer.GetTokenVocabIndex());
+  EXPECT_THAT(index->GetTokensWithPrefix("a"), testing::ElementsAre(2, 1));
+  ASSERT_OK_AND_ASSIGN(auto again, tokenizer.GetTokenVocabIndex());
+  EXPECT_EQ(again, index);
+}
+
 TEST(TokenizerTest, MergeTokenIds) {
   const std::vector<std::vector<int>> previous_ids = {{90, 547, 58, 735},
                                                       {224, 24}};
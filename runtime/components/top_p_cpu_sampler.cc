@@ -1,26 +1,36 @@
 #include "runtime/components/top_p_cpu_sampler.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <memory>
-#include <string>
+#include <utility>
 #include <vector>
 
 #include "absl/memory/memory.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/blocking_counter.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
+#include "litert/c/litert_tensor_buffer_types.h"  // from @litert
+#include "litert/cc/litert_element_type.h"  // from @litert
 #include "litert/cc/litert_macros.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/components/sampling_cpu_util.h"
+#include "runtime/framework/threadpool.h"
 #include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
 #include "runtime/util/tensor_buffer_util.h"
 
 namespace litert::lm {
 namespace {
 
 absl::Status ValidateTensor(const TensorBuffer& tensor, int max_num_dims,
-                            int batch_size, const std::string& tensor_name) {
+                            int batch_size, absl::string_view tensor_name) {
   LITERT_ASSIGN_OR_RETURN(auto tensor_type, tensor.TensorType());
   auto dims = tensor_type.Layout().Dimensions();
   if (NumSignificantDims(tensor) > max_num_dims) {
@@ -38,24 +48,157 @@ absl::Status ValidateTensor(const TensorBuffer& tensor, int max_num_dims,
   return absl::OkStatus();
 }
 
-}  // namespace
-
-absl::StatusOr<std::unique_ptr<TopPSampler>> TopPSampler::Create(
-    int k, float p, float temperature, int batch_size, int seed) {
+absl::Status ValidateParams(int k, float p, float temperature) {
   if (k <= 0) {
     return absl::InvalidArgumentError("k must be positive.");
   }
   if (p < 0.0f || p > 1.0f) {
     return absl::InvalidArgumentError("p must be in [0, 1].");
   }
+  if (temperature <= 0.0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Temperature must be positive, but got ", temperature));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<TopPSampler>> TopPSampler::Create(
+    int k, float p, float temperature, int batch_size, int seed,
+    ThreadPool* absl_nullable thread_pool, LogitBiases logit_biases) {
+  RETURN_IF_ERROR(ValidateParams(k, p, temperature));
   if (batch_size <= 0) {
     return absl::InvalidArgumentError("batch_size must be positive.");
   }
-  if (temperature <= 0.0) {
+  return absl::WrapUnique(new TopPSampler(k, p, temperature, batch_size, seed,
+                                          thread_pool,
+                                          std::move(logit_biases)));
+}
+
+template <typename T>
+absl::Status TopPSampler::SampleRows(absl::Span<const T> logits, int k) {
+  if (logits.size() % batch_size_ != 0) {
     return absl::InvalidArgumentError(
-        absl::StrCat("Temperature must be positive, but got ", temperature));
+        absl::StrCat("The logits size ", logits.size(),
+                     " is not divisible by the batch size ", batch_size_));
+  }
+  const size_t vocab_size = logits.size() / batch_size_;
+  const LogitBiases* logit_biases =
+      logit_biases_.empty() ? nullptr : &logit_biases_;
+  auto sample_row = [this, logits, k, vocab_size, logit_biases](int row) {
+    row_statuses_[row] = FusedTopKTopPSampling(
+        logits.subspan(row * vocab_size, vocab_size), k, p_, temperature_,
+        generators_[row], /*batch_size=*/1, scratches_[row],
+        absl::MakeSpan(sampled_ids_).subspan(row, 1),
+        absl::MakeSpan(sampled_scores_).subspan(row, 1), logit_biases,
+        absl::MakeSpan(top_log_probs_)
+            .subspan(row * num_top_log_probs_, num_top_log_probs_));
+  };
+  // The inactive rows are not sampled, and their generators do not advance.
+  active_row_indices_.clear();
+  for (int row = 0; row < batch_size_; ++row) {
+    if (active_rows_[row]) {
+      active_row_indices_.push_back(row);
+    } else {
+      row_statuses_[row] = absl::OkStatus();
+      sampled_ids_[row] = 0;
+      sampled_scores_[row] = 1.0f;
+    }
+  }
+  const int num_active_rows = active_row_indices_.size();
+  if (thread_pool_ == nullptr || num_active_rows <= 1) {
+    for (int row : active_row_indices_) {
+      sample_row(row);
+    }
+  } else {
+    // The first active row is sampled on the calling thread while the others
+    // are on the pool. The counter waits for this call's rows only, whatever
+    // else the pool runs.
+    absl::BlockingCounter pending_rows(num_active_rows - 1);
+    for (int i = 1; i < num_active_rows; ++i) {
+      const int row = active_row_indices_[i];
+      auto status = thread_pool_->Schedule([&sample_row, &pending_rows, row] {
+        sample_row(row);
+        pending_rows.DecrementCount();
+      });
+      if (!status.ok()) {
+        sample_row(row);
+        pending_rows.DecrementCount();
+      }
+    }
+    sample_row(active_row_indices_[0]);
+    pending_rows.Wait();
+  }
+  for (const auto& status : row_statuses_) {
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+void TopPSampler::SetActiveRows(const std::vector<bool>& active_rows) {
+  if (active_rows.size() == batch_size_) {
+    active_rows_ = active_rows;
+  }
+}
+
+absl::Status TopPSampler::SetNumTopLogProbs(int num_top_log_probs) {
+  if (num_top_log_probs < 0) {
+    return absl::InvalidArgumentError(
+        "The number of top log-probabilities must not be negative.");
+  }
+  num_top_log_probs_ = num_top_log_probs;
+  top_log_probs_.assign(batch_size_ * num_top_log_probs,
+                        {-1, -std::numeric_limits<float>::infinity()});
+  return absl::OkStatus();
+}
+
+absl::Span<const std::pair<int, float>> TopPSampler::GetTopLogProbs(
+    int row) const {
+  if (row < 0 || row >= batch_size_) {
+    return {};
+  }
+  return absl::MakeConstSpan(top_log_probs_)
+      .subspan(row * num_top_log_probs_, num_top_log_probs_);
+}
+
+void TopPSampler::Reset() {
+  std::fill(active_rows_.begin(), active_rows_.end(), true);
+}
+
+absl::Status TopPSampler::SetLogitsQuantization(float scale,
+                                                int32_t zero_point) {
+  if (!(scale > 0.0f)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("The logits scale must be positive, but got ", scale));
+  }
+  logits_quantization_ = {scale, zero_point};
+  return absl::OkStatus();
+}
+
+absl::Status TopPSampler::Reconfigure(int k, float p, float temperature,
+                                      int seed) {
+  RETURN_IF_ERROR(ValidateParams(k, p, temperature));
+  k_ = k;
+  p_ = p;
+  temperature_ = temperature;
+  SeedGenerators(seed);
+  Reset();
+  return absl::OkStatus();
+}
+
+void TopPSampler::SeedGenerators(int seed) {
+  generators_.clear();
+  generators_.reserve(batch_size_);
+  for (int row = 0; row < batch_size_; ++row) {
+    // The first row keeps the stream of the seed alone, such that a single
+    // candidate samples the same as before the rows had their own streams.
+    absl::SeedSeq proper_seed_seq =
+        row == 0 ? absl::SeedSeq({seed}) : absl::SeedSeq({seed, row});
+    generators_.emplace_back(proper_seed_seq);
   }
-  return absl::WrapUnique(new TopPSampler(k, p, temperature, batch_size, seed));
 }
 
 absl::Status TopPSampler::SampleToIdAndScoreBuffer(
@@ -72,6 +215,25 @@ absl::Status TopPSampler::SampleToIdAndScoreBuffer(
     return status;
   }
 
+  LITERT_ASSIGN_OR_RETURN(auto logits_type, logits_tensor.TensorType());
+  if (logits_type.ElementType() == ElementType::Float16) {
+    return SampleHalfPrecisionLogits<Fp16>(logits_tensor, ids_tensor,
+                                           scores_tensor);
+  }
+  if (logits_type.ElementType() == ElementType::BFloat16) {
+    return SampleHalfPrecisionLogits<Bf16>(logits_tensor, ids_tensor,
+                                           scores_tensor);
+  }
+
+  if (logits_type.ElementType() == ElementType::Int8) {
+    return SampleQuantizedLogits<int8_t>(logits_tensor, ids_tensor,
+                                         scores_tensor);
+  }
+  if (logits_type.ElementType() == ElementType::Int16) {
+    return SampleQuantizedLogits<int16_t>(logits_tensor, ids_tensor,
+                                          scores_tensor);
+  }
+
   auto logits_data_or = ReferTensorBufferAsSpan<float>(logits_tensor);
   absl::Span<float> logits_data;
   if (!logits_data_or) {  // Download the data if it is not in host memory.
@@ -86,25 +248,148 @@ absl::Status TopPSampler::SampleToIdAndScoreBuffer(
   } else {
     logits_data = logits_data_or.Value();
   }
-  std::vector<float> sampled_scores;
-  auto sampled_ids = TopKTopPSampling(logits_data, k_, p_, temperature_,
-                                      generator_, batch_size_, sampled_scores);
-  if (!sampled_ids.ok()) {
-    return sampled_ids.status();
+  status = SampleRows(absl::Span<const float>(logits_data), k_);
+  if (!status.ok()) {
+    return status;
+  }
+  return WriteSampledIdsAndScores(ids_tensor, scores_tensor);
+}
+
+template <typename T>
+absl::Status TopPSampler::SampleHalfPrecisionLogits(
+    const TensorBuffer& logits_tensor, TensorBuffer& ids_tensor,
+    TensorBuffer* scores_tensor) {
+  TensorBuffer& mutable_logits_tensor =
+      const_cast<TensorBuffer&>(logits_tensor);
+  LITERT_ASSIGN_OR_RETURN(auto logits_size, logits_tensor.PackedSize());
+  const size_t num_logits = logits_size / sizeof(T);
+  LITERT_ASSIGN_OR_RETURN(auto buffer_type, logits_tensor.BufferType());
+  absl::Status status;
+  if (buffer_type == kLiteRtTensorBufferTypeHostMemory) {
+    LITERT_ASSIGN_OR_RETURN(
+        auto logits_lock_and_addr,
+        TensorBufferScopedLock::Create(mutable_logits_tensor,
+                                       TensorBuffer::LockMode::kRead));
+    status = SampleRows(
+        absl::MakeConstSpan(static_cast<const T*>(logits_lock_and_addr.second),
+                            num_logits),
+        k_);
+  } else {  // Download the data if it is not in host memory.
+    half_logits_data_.resize(num_logits);
+    mutable_logits_tensor.Read(absl::MakeSpan(half_logits_data_));
+    const T* logits_data = reinterpret_cast<const T*>(half_logits_data_.data());
+    status = SampleRows(absl::MakeConstSpan(logits_data, num_logits), k_);
+  }
+  if (!status.ok()) {
+    return status;
+  }
+  return WriteSampledIdsAndScores(ids_tensor, scores_tensor);
+}
+
+template <typename T>
+absl::Status TopPSampler::SampleQuantizedLogits(
+    const TensorBuffer& logits_tensor, TensorBuffer& ids_tensor,
+    TensorBuffer* scores_tensor) {
+  if (!logits_quantization_.has_value()) {
+    return absl::FailedPreconditionError(
+        "The quantization of the logits is not set, see "
+        "SetLogitsQuantization().");
+  }
+  TensorBuffer& mutable_logits_tensor =
+      const_cast<TensorBuffer&>(logits_tensor);
+  LITERT_ASSIGN_OR_RETURN(auto logits_size, logits_tensor.PackedSize());
+  const size_t num_logits = logits_size / sizeof(T);
+  logits_data_.resize(num_logits);
+  const auto [scale, zero_point] = *logits_quantization_;
+  LITERT_ASSIGN_OR_RETURN(auto buffer_type, logits_tensor.BufferType());
+  if (buffer_type == kLiteRtTensorBufferTypeHostMemory) {
+    LITERT_ASSIGN_OR_RETURN(
+        auto logits_lock_and_addr,
+        TensorBufferScopedLock::Create(mutable_logits_tensor,
+                                       TensorBuffer::LockMode::kRead));
+    DequantizeLogits(
+        absl::MakeConstSpan(static_cast<const T*>(logits_lock_and_addr.second),
+                            num_logits),
+        scale, zero_point, absl::MakeSpan(logits_data_));
+  } else {  // Download the data if it is not in host memory.
+    std::vector<T> quantized_logits(num_logits);
+    mutable_logits_tensor.Read(absl::MakeSpan(quantized_logits));
+    DequantizeLogits(absl::MakeConstSpan(quantized_logits), scale, zero_point,
+                     absl::MakeSpan(logits_data_));
+  }
+  absl::Status status = SampleRows(absl::MakeConstSpan(logits_data_), k_);
+  if (!status.ok()) {
+    return status;
+  }
+  return WriteSampledIdsAndScores(ids_tensor, scores_tensor);
+}
+
+absl::Status TopPSampler::SampleToIdAndScoreBufferFromTopK(
+    const TensorBuffer& topk_logits_tensor,
+    const TensorBuffer& topk_ids_tensor, TensorBuffer& ids_tensor,
+    TensorBuffer* scores_tensor) {
+  if (!logit_biases_.empty()) {
+    return absl::FailedPreconditionError(
+        "The logit biases need all the logits, see GetTopK().");
   }
-  ids_tensor.Write(absl::MakeConstSpan(*sampled_ids));
+  auto status = ValidateTensor(topk_logits_tensor, /*max_num_dims=*/2,
+                               batch_size_, "input top-k logits");
+  if (!status.ok()) {
+    return status;
+  }
+  status = ValidateTensor(topk_ids_tensor, /*max_num_dims=*/2, batch_size_,
+                          "input top-k ids");
+  if (!status.ok()) {
+    return status;
+  }
+  status =
+      ValidateTensor(ids_tensor, /*max_num_dims=*/1, batch_size_, "output ids");
+  if (!status.ok()) {
+    return status;
+  }
+  LITERT_ASSIGN_OR_RETURN(auto topk_logits,
+                          ReferTensorBufferAsSpan<float>(topk_logits_tensor));
+  LITERT_ASSIGN_OR_RETURN(auto topk_ids,
+                          ReferTensorBufferAsSpan<int>(topk_ids_tensor));
+  if (topk_logits.size() != topk_ids.size()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The top-k logits and ids must have the same size, but got ",
+        topk_logits.size(), " vs ", topk_ids.size()));
+  }
+  // The top-k logits form a vocabulary of their own, whose sampled positions
+  // are mapped back to the token ids.
+  const int k = topk_logits.size() / batch_size_;
+  status = SampleRows(absl::Span<const float>(topk_logits), std::min(k_, k));
+  if (!status.ok()) {
+    return status;
+  }
+  // The sampled positions are mapped back to the token ids.
+  for (int b = 0; b < batch_size_; ++b) {
+    sampled_ids_[b] = topk_ids[b * k + sampled_ids_[b]];
+    for (int i = 0; i < num_top_log_probs_; ++i) {
+      int& token_id = top_log_probs_[b * num_top_log_probs_ + i].first;
+      if (token_id >= 0) {
+        token_id = topk_ids[b * k + token_id];
+      }
+    }
+  }
+  return WriteSampledIdsAndScores(ids_tensor, scores_tensor);
+}
+
+absl::Status TopPSampler::WriteSampledIdsAndScores(
+    TensorBuffer& ids_tensor, TensorBuffer* scores_tensor) {
+  ids_tensor.Write(absl::MakeConstSpan(sampled_ids_));
   if (scores_tensor != nullptr) {
-    status = ValidateTensor(*scores_tensor, /*max_num_dims=*/1, batch_size_,
-                            "output scores");
+    auto status = ValidateTensor(*scores_tensor, /*max_num_dims=*/1,
+                                 batch_size_, "output scores");
     if (!status.ok()) {
       return status;
     }
-    std::vector<float> scores(batch_size_);
     for (int i = 0; i < batch_size_; ++i) {
       // The scores are the log of the probability of the sampled token.
-      scores[i] = std::log(sampled_scores[i]);
+      log_scores_[i] = std::log(sampled_scores_[i]);
     }
-    scores_tensor->Write(absl::MakeConstSpan(scores));
+    scores_tensor->Write(absl::MakeConstSpan(log_scores_));
   }
   return absl::OkStatus();
 }
@@ -1,15 +1,21 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOP_P_CPU_SAMPLER_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_COMPONENTS_TOP_P_CPU_SAMPLER_H_
 
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <utility>
 #include <vector>
 
+#include "absl/base/nullability.h"  // from @com_google_absl
 #include "absl/random/random.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/components/sampler.h"
+#include "runtime/components/sampling_cpu_util.h"
+#include "runtime/framework/threadpool.h"
 
 namespace litert::lm {
 
@@ -19,14 +25,25 @@ class TopPSampler : public Sampler {
   // - k: The number of top logits to consider.
   // - p: The top-p probability mass to consider.
   // - batch_size: The batch size of the input logits.
-  // - seed: The seed for the random number generator.
-  static absl::StatusOr<std::unique_ptr<TopPSampler>> Create(int k, float p,
-                                                             float temperature,
-                                                             int batch_size,
-                                                             int seed);
+  // - seed: The seed for the random number generator. Each row of the batch
+  //   draws from its own stream derived from the seed, so the sampled ids do
+  //   not depend on whether the rows are sampled in parallel.
+  // - thread_pool: The optional pool the rows of the batch are sampled on in
+  //   parallel. It must outlive the sampler, and must not be the pool the
+  //   sampler is called from, since the calls wait for the rows.
+  // - logit_biases: The biases of the logits of all the rows, applied by the
+  //   top-k selection.
+  static absl::StatusOr<std::unique_ptr<TopPSampler>> Create(
+      int k, float p, float temperature, int batch_size, int seed,
+      ThreadPool* absl_nullable thread_pool = nullptr,
+      LogitBiases logit_biases = {});
 
   // Given a batch of logits, samples a batch of token ids.
-  // The expected shape of the logits is [batch_size, vocab_size].
+  // The expected shape of the logits is [batch_size, vocab_size], of float32,
+  // float16 or bfloat16 values, or of int8 or int16 values once their
+  // quantization is set. The half-precision logits are read as they are,
+  // without being converted to float32 first, while the quantized ones are
+  // dequantized into float32.
   // The output ids_tensor is a 1D litert::TensorBuffer of shape [batch_size].
   // The output scores_tensor is optional. If it is not nullptr, the sampled
   // scores are also written to it (in the same shape as the ids_tensor). The
@@ -35,25 +52,121 @@ class TopPSampler : public Sampler {
                                         TensorBuffer& ids_tensor,
                                         TensorBuffer* scores_tensor) override;
 
+  // The biased tokens may be outside of the top-k of the raw logits, so the
+  // sampler needs all the logits when it has biases.
+  int GetTopK() const override { return logit_biases_.empty() ? k_ : 0; }
+
+  // Samples from the top-k logits of each batch, which must hold at least
+  // min(k, vocab_size) entries per batch. The top-p and temperature are
+  // applied the same as in SampleToIdAndScoreBuffer().
+  absl::Status SampleToIdAndScoreBufferFromTopK(
+      const TensorBuffer& topk_logits_tensor,
+      const TensorBuffer& topk_ids_tensor, TensorBuffer& ids_tensor,
+      TensorBuffer* scores_tensor) override;
+
+  // The inactive rows are skipped, with the id 0 and the score 0 written for
+  // them. A mask of another size than the batch is ignored.
+  void SetActiveRows(const std::vector<bool>& active_rows) override;
+
+  // The log-probabilities are among the top-k survivors at the temperature,
+  // so at most k tokens are reported, unless k is 1, in which case the argmax
+  // is found among the top `num_top_log_probs` instead.
+  absl::Status SetNumTopLogProbs(int num_top_log_probs) override;
+  int GetNumTopLogProbs() const override { return num_top_log_probs_; }
+  absl::Span<const std::pair<int, float>> GetTopLogProbs(
+      int row) const override;
+
+  absl::Status SetLogitsQuantization(float scale, int32_t zero_point) override;
+
+  // Makes all the rows active again.
+  void Reset() override;
+
+  // Keeps the thread pool and the logit biases. Returns InvalidArgumentError
+  // for the same parameters Create() rejects, leaving the sampler unchanged.
+  absl::Status Reconfigure(int k, float p, float temperature,
+                           int seed) override;
+
  private:
   explicit TopPSampler(int k, float p, float temperature, int batch_size,
-                       int seed)
-      : k_(k), p_(p), temperature_(temperature), batch_size_(batch_size) {
-    absl::SeedSeq proper_seed_seq({seed});
-    absl::BitGen rng(proper_seed_seq);
-    generator_ = std::move(rng);
+                       int seed, ThreadPool* absl_nullable thread_pool,
+                       LogitBiases logit_biases)
+      : k_(k),
+        p_(p),
+        temperature_(temperature),
+        batch_size_(batch_size),
+        thread_pool_(thread_pool),
+        logit_biases_(std::move(logit_biases)),
+        scratches_(batch_size),
+        row_statuses_(batch_size),
+        sampled_ids_(batch_size),
+        sampled_scores_(batch_size),
+        log_scores_(batch_size),
+        active_rows_(batch_size, true) {
+    active_row_indices_.reserve(batch_size);
+    SeedGenerators(seed);
   }
 
+  // Creates the generators of the rows from `seed`.
+  void SeedGenerators(int seed);
+
   // The parameters for the sampler.
-  const int k_;
-  const float p_;
-  const float temperature_;
+  int k_;
+  float p_;
+  float temperature_;
   const int batch_size_;
-  absl::BitGen generator_;
+  ThreadPool* absl_nullable const thread_pool_;
+  const LogitBiases logit_biases_;
+  // One generator per row of the batch.
+  std::vector<absl::BitGen> generators_;
+
+  // Samples each active row of `logits` into sampled_ids_ and
+  // sampled_scores_, on thread_pool_ if set and more than one row is active.
+  template <typename T>
+  absl::Status SampleRows(absl::Span<const T> logits, int k);
+
+  // Samples from the half-precision logits of `logits_tensor`, where T is Fp16
+  // or Bf16.
+  template <typename T>
+  absl::Status SampleHalfPrecisionLogits(const TensorBuffer& logits_tensor,
+                                         TensorBuffer& ids_tensor,
+                                         TensorBuffer* scores_tensor);
+
+  // Samples from the quantized logits of `logits_tensor`, where T is int8_t or
+  // int16_t, dequantized into logits_data_.
+  template <typename T>
+  absl::Status SampleQuantizedLogits(const TensorBuffer& logits_tensor,
+                                     TensorBuffer& ids_tensor,
+                                     TensorBuffer* scores_tensor);
+
+  // Writes sampled_ids_ and, if `scores_tensor` is set, the log of
+  // sampled_scores_.
+  absl::Status WriteSampledIdsAndScores(TensorBuffer& ids_tensor,
+                                        TensorBuffer* scores_tensor);
+
+  // The quantization of the int8 and int16 logits, if set.
+  std::optional<std::pair<float, int32_t>> logits_quantization_;
 
   // The logits data to be used for sampling. Having it as a member to avoid
   // re-allocating the vector for each sampling call.
   std::vector<float> logits_data_;
+  // Same as logits_data_, for the half-precision logits.
+  std::vector<uint16_t> half_logits_data_;
+
+  // The buffers of the sampling, kept across the calls such that sampling a
+  // step does not allocate.
+  // One scratch and status per row, such that the rows can be sampled in
+  // parallel.
+  std::vector<TopKTopPScratch> scratches_;
+  std::vector<absl::Status> row_statuses_;
+  std::vector<int> sampled_ids_;
+  std::vector<float> sampled_scores_;
+  std::vector<float> log_scores_;
+  // Whether each row is sampled, and the indices of the sampled rows.
+  std::vector<bool> active_rows_;
+  std::vector<int> active_row_indices_;
+  // The top log-probabilities of the last call, num_top_log_probs_ per row.
+  int num_top_log_probs_ = 0;
+  std::vector<std::pair<int, float>> top_log_probs_;
 };
 
 }  // namespace litert::lm
@@ -1,6 +1,7 @@
 #include "runtime/components/top_p_cpu_sampler.h"
 
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <utility>
 #include <vector>
@@ -8,6 +9,13 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/types/span.h"  // from @com_google_absl
+#include "litert/c/litert_tensor_buffer_types.h"  // from @litert
+#include "litert/cc/litert_element_type.h"  // from @litert
+#include "litert/cc/litert_layout.h"  // from @litert
+#include "litert/cc/litert_model.h"  // from @litert
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/sampling_cpu_util.h"
+#include "runtime/framework/threadpool.h"
 #include "runtime/util/convert_tensor_buffer.h"
 
 namespace litert::lm {
@@ -75,5 +83,320 @@ TEST(TopPSamplerTest, SampleToIdAndScoreBuffer_BatchSize2) {
   EXPECT_THAT(*scores, testing::ElementsAre(std::log(1.0f), std::log(1.0f)));
 }
 
+TEST(TopPSamplerTest, SampleToIdAndScoreBuffer_Float16Logits) {
+  auto sampler_or = TopPSampler::Create(/*k=*/2, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  auto sampler = std::move(sampler_or.value());
+
+  // The float16 bits of {0, 0, 10, 0} and {11, 12, 1, 2}.
+  const std::vector<uint16_t> logits = {0x0000, 0x0000, 0x4900, 0x0000,
+                                        0x4980, 0x4a00, 0x3c00, 0x4000};
+  auto logits_tensor = TensorBuffer::CreateManaged(
+      kLiteRtTensorBufferTypeHostMemory,
+      RankedTensorType(ElementType::Float16, Layout(Dimensions({2, 4}))),
+      logits.size() * sizeof(uint16_t));
+  ASSERT_TRUE(logits_tensor.HasValue());
+  ASSERT_TRUE(logits_tensor->Write(absl::MakeConstSpan(logits)));
+
+  std::vector<int> ids_vector(2);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {2});
+  auto status = sampler->SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                                  /*scores_tensor=*/nullptr);
+  EXPECT_TRUE(status.ok());
+
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  EXPECT_TRUE(ids.HasValue());
+  // The most likely token holds more than p of the mass of the top-2.
+  EXPECT_THAT(*ids, testing::ElementsAre(2, 1));
+}
+
+TEST(TopPSamplerTest, SampleToIdAndScoreBuffer_Int8Logits) {
+  auto sampler_or = TopPSampler::Create(/*k=*/2, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  auto sampler = std::move(sampler_or.value());
+
+  // {0, 0, 10, 0} and {11, 12, 1, 2} once dequantized.
+  const std::vector<int8_t> logits = {-4, -4, 16, -4, 18, 20, -2, 0};
+  auto logits_tensor = TensorBuffer::CreateManaged(
+      kLiteRtTensorBufferTypeHostMemory,
+      RankedTensorType(ElementType::Int8, Layout(Dimensions({2, 4}))),
+      logits.size() * sizeof(int8_t));
+  ASSERT_TRUE(logits_tensor.HasValue());
+  ASSERT_TRUE(logits_tensor->Write(absl::MakeConstSpan(logits)));
+
+  std::vector<int> ids_vector(2);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {2});
+  // The quantization has to be set first.
+  EXPECT_FALSE(sampler
+                   ->SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                              /*scores_tensor=*/nullptr)
+                   .ok());
+  EXPECT_FALSE(sampler->SetLogitsQuantization(/*scale=*/0.0f, 0).ok());
+
+  ASSERT_TRUE(
+      sampler->SetLogitsQuantization(/*scale=*/0.5f, /*zero_point=*/-4).ok());
+  EXPECT_TRUE(sampler
+                  ->SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                             /*scores_tensor=*/nullptr)
+                  .ok());
+
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  EXPECT_TRUE(ids.HasValue());
+  EXPECT_THAT(*ids, testing::ElementsAre(2, 1));
+}
+
+TEST(TopPSamplerTest, SampleToIdAndScoreBufferFromTopK_BatchSize2) {
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  auto sampler = std::move(sampler_or.value());
+  EXPECT_EQ(sampler->GetTopK(), 1);
+
+  // The top-2 logits of each batch and their token ids, in any order.
+  const std::vector<float> topk_logits = {1.0, 10.0, 12.0, 11.0};
+  const std::vector<int> topk_ids = {7, 2, 5, 1};
+  auto topk_logits_tensor = CopyToTensorBuffer<float>(topk_logits, {2, 2});
+  auto topk_ids_tensor = CopyToTensorBuffer<int>(topk_ids, {2, 2});
+
+  std::vector<int> ids_vector(2);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {2});
+  std::vector<float> scores_vector(2);
+  auto scores_tensor =
+      CopyToTensorBuffer<float>(absl::MakeConstSpan(scores_vector), {2});
+  auto status = sampler->SampleToIdAndScoreBufferFromTopK(
+      *topk_logits_tensor, *topk_ids_tensor, *ids_tensor, &(*scores_tensor));
+  EXPECT_TRUE(status.ok());
+
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  EXPECT_TRUE(ids.HasValue());
+  EXPECT_THAT(*ids, testing::ElementsAre(2, 5));
+
+  auto scores = CopyFromTensorBuffer<float>(*scores_tensor);
+  EXPECT_TRUE(scores.HasValue());
+  EXPECT_THAT(*scores, testing::ElementsAre(std::log(1.0f), std::log(1.0f)));
+}
+
+TEST(TopPSamplerTest, SampleToIdAndScoreBufferFromTopK_TopLogProbs) {
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  auto sampler = std::move(sampler_or.value());
+  EXPECT_TRUE(sampler->SetNumTopLogProbs(2).ok());
+  EXPECT_EQ(sampler->GetNumTopLogProbs(), 2);
+
+  const std::vector<float> topk_logits = {1.0, 10.0, 12.0, 11.0};
+  const std::vector<int> topk_ids = {7, 2, 5, 1};
+  auto topk_logits_tensor = CopyToTensorBuffer<float>(topk_logits, {2, 2});
+  auto topk_ids_tensor = CopyToTensorBuffer<int>(topk_ids, {2, 2});
+  std::vector<int> ids_vector(2);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {2});
+  auto status = sampler->SampleToIdAndScoreBufferFromTopK(
+      *topk_logits_tensor, *topk_ids_tensor, *ids_tensor,
+      /*scores_tensor=*/nullptr);
+  EXPECT_TRUE(status.ok());
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  EXPECT_TRUE(ids.HasValue());
+  EXPECT_THAT(*ids, testing::ElementsAre(2, 5));
+
+  // The positions in the top-k logits are mapped back to the token ids.
+  auto row_0 = sampler->GetTopLogProbs(0);
+  ASSERT_EQ(row_0.size(), 2);
+  EXPECT_EQ(row_0[0].first, 2);
+  EXPECT_EQ(row_0[1].first, 7);
+  EXPECT_NEAR(std::exp(row_0[0].second) + std::exp(row_0[1].second), 1.0f,
+              1e-5);
+  auto row_1 = sampler->GetTopLogProbs(1);
+  ASSERT_EQ(row_1.size(), 2);
+  EXPECT_EQ(row_1[0].first, 5);
+  EXPECT_EQ(row_1[1].first, 1);
+  EXPECT_NEAR(row_1[0].second - row_1[1].second, 1.0f, 1e-5);
+}
+
+TEST(TopPSamplerTest, SampleToIdAndScoreBuffer_ThreadPoolMatchesSequential) {
+  constexpr int kBatchSize = 4;
+  constexpr int kVocabSize = 64;
+  std::vector<float> logits(kBatchSize * kVocabSize);
+  for (int i = 0; i < kBatchSize * kVocabSize; ++i) {
+    logits[i] = static_cast<float>((i * 37) % 23) / 4.0f;
+  }
+  auto logits_tensor =
+      CopyToTensorBuffer<float>(logits, {kBatchSize, kVocabSize});
+
+  // Samples a few steps with flat distributions, such that the sampled ids
+  // depend on the random stream of each row.
+  auto sample = [&](ThreadPool* thread_pool) {
+    auto sampler_or = TopPSampler::Create(
+        /*k=*/kVocabSize, /*p=*/1.0, /*temperature=*/1.0, kBatchSize,
+        /*seed=*/7, thread_pool);
+    EXPECT_TRUE(sampler_or.ok());
+    auto sampler = std::move(sampler_or.value());
+    std::vector<int> sampled_ids;
+    for (int step = 0; step < 8; ++step) {
+      std::vector<int> ids_vector(kBatchSize);
+      auto ids_tensor = CopyToTensorBuffer<int>(
+          absl::MakeConstSpan(ids_vector), {kBatchSize});
+      EXPECT_TRUE(sampler
+                      ->SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                                 /*scores_tensor=*/nullptr)
+                      .ok());
+      auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+      EXPECT_TRUE(ids.HasValue());
+      sampled_ids.insert(sampled_ids.end(), ids->begin(), ids->end());
+    }
+    return sampled_ids;
+  };
+
+  ThreadPool thread_pool(/*name_prefix=*/"sampler", /*max_num_threads=*/3);
+  EXPECT_EQ(sample(&thread_pool), sample(/*thread_pool=*/nullptr));
+}
+
+TEST(TopPSamplerTest, ReconfigureSamplesAsANewSampler) {
+  constexpr int kBatchSize = 2;
+  constexpr int kVocabSize = 64;
+  std::vector<float> logits(kBatchSize * kVocabSize);
+  for (int i = 0; i < kBatchSize * kVocabSize; ++i) {
+    logits[i] = static_cast<float>((i * 37) % 23) / 4.0f;
+  }
+  auto logits_tensor =
+      CopyToTensorBuffer<float>(logits, {kBatchSize, kVocabSize});
+  auto sample = [&](TopPSampler& sampler) {
+    std::vector<int> sampled_ids;
+    for (int step = 0; step < 8; ++step) {
+      std::vector<int> ids_vector(kBatchSize);
+      auto ids_tensor = CopyToTensorBuffer<int>(
+          absl::MakeConstSpan(ids_vector), {kBatchSize});
+      EXPECT_TRUE(sampler
+                      .SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                                /*scores_tensor=*/nullptr)
+                      .ok());
+      auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+      EXPECT_TRUE(ids.HasValue());
+      sampled_ids.insert(sampled_ids.end(), ids->begin(), ids->end());
+    }
+    return sampled_ids;
+  };
+
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        kBatchSize, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  auto sampler = std::move(sampler_or.value());
+  sampler->SetActiveRows({true, false});
+  sample(*sampler);
+  EXPECT_TRUE(sampler
+                  ->Reconfigure(/*k=*/kVocabSize, /*p=*/1.0,
+                                /*temperature=*/2.0, /*seed=*/7)
+                  .ok());
+
+  auto new_sampler_or = TopPSampler::Create(
+      /*k=*/kVocabSize, /*p=*/1.0, /*temperature=*/2.0, kBatchSize,
+      /*seed=*/7);
+  EXPECT_TRUE(new_sampler_or.ok());
+  EXPECT_EQ(sample(*sampler), sample(*new_sampler_or.value()));
+}
+
+TEST(TopPSamplerTest, ReconfigureRejectsInvalidParameters) {
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/1, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  auto sampler = std::move(sampler_or.value());
+  EXPECT_FALSE(sampler->Reconfigure(/*k=*/0, /*p=*/0.5, /*temperature=*/1.0,
+                                    /*seed=*/1)
+                   .ok());
+  EXPECT_FALSE(sampler->Reconfigure(/*k=*/1, /*p=*/1.5, /*temperature=*/1.0,
+                                    /*seed=*/1)
+                   .ok());
+  EXPECT_FALSE(sampler->Reconfigure(/*k=*/1, /*p=*/0.5, /*temperature=*/0.0,
+                                    /*seed=*/1)
+                   .ok());
+  EXPECT_EQ(sampler->GetTopK(), 1);
+}
+
+TEST(TopPSamplerTest, SampleToIdAndScoreBuffer_InactiveRows) {
+  ThreadPool thread_pool(/*name_prefix=*/"sampler", /*max_num_threads=*/2);
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/3, /*seed=*/1,
+                                        &thread_pool);
+  EXPECT_TRUE(sampler_or.ok());
+  auto sampler = std::move(sampler_or.value());
+
+  const std::vector<float> logits = {0.0, 0.0, 10.0, 0.0, 11.0, 12.0,
+                                     1.0, 2.0, 0.0,  0.0, 0.0,  9.0};
+  auto logits_tensor = CopyToTensorBuffer<float>(logits, {3, 4});
+  std::vector<int> ids_vector(3);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {3});
+
+  // The inactive row gets the id 0 instead of its sampled id.
+  sampler->SetActiveRows({true, false, true});
+  EXPECT_TRUE(sampler
+                  ->SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                             /*scores_tensor=*/nullptr)
+                  .ok());
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  EXPECT_TRUE(ids.HasValue());
+  EXPECT_THAT(*ids, testing::ElementsAre(2, 0, 3));
+
+  sampler->Reset();
+  EXPECT_TRUE(sampler
+                  ->SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                             /*scores_tensor=*/nullptr)
+                  .ok());
+  ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  EXPECT_TRUE(ids.HasValue());
+  EXPECT_THAT(*ids, testing::ElementsAre(2, 1, 3));
+}
+
+TEST(TopPSamplerTest, SampleToIdAndScoreBuffer_LogitBiases) {
+  // The token 3 is boosted and the token 2 banned, and only the tokens 2 and
+  // 3 may be sampled by the second sampler.
+  auto logit_biases =
+      CreateLogitBiases({{2, -std::numeric_limits<float>::infinity()},
+                         {3, 20.0f}},
+                        /*restrict_vocab=*/false);
+  ASSERT_TRUE(logit_biases.ok());
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1,
+                                        /*thread_pool=*/nullptr, *logit_biases);
+  ASSERT_TRUE(sampler_or.ok());
+  auto sampler = std::move(sampler_or.value());
+  // The biased tokens may come from outside of the top-k.
+  EXPECT_EQ(sampler->GetTopK(), 0);
+
+  const std::vector<float> logits = {0.0, 0.0, 10.0, 0.0,
+                                     11.0, 12.0, 1.0, -5.0};
+  auto logits_tensor = CopyToTensorBuffer<float>(logits, {2, 4});
+  std::vector<int> ids_vector(2);
+  auto ids_tensor =
+      CopyToTensorBuffer<int>(absl::MakeConstSpan(ids_vector), {2});
+  ASSERT_TRUE(sampler
+                  ->SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                             /*scores_tensor=*/nullptr)
+                  .ok());
+  auto ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  ASSERT_TRUE(ids.HasValue());
+  EXPECT_THAT(*ids, testing::ElementsAre(3, 3));
+
+  logit_biases = CreateLogitBiases({{2, 0.0f}, {3, 0.0f}},
+                                   /*restrict_vocab=*/true);
+  ASSERT_TRUE(logit_biases.ok());
+  sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                   /*batch_size=*/2, /*seed=*/1,
+                                   /*thread_pool=*/nullptr, *logit_biases);
+  ASSERT_TRUE(sampler_or.ok());
+  ASSERT_TRUE((*sampler_or)
+                  ->SampleToIdAndScoreBuffer(*logits_tensor, *ids_tensor,
+                                             /*scores_tensor=*/nullptr)
+                  .ok());
+  ids = CopyFromTensorBuffer<int>(*ids_tensor);
+  ASSERT_TRUE(ids.HasValue());
+  EXPECT_THAT(*ids, testing::ElementsAre(2, 2));
+}
+
 }  // namespace
 }  // namespace litert::lm
@@ -0,0 +1,117 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/backend_selection.h"
+
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/function_ref.h"  // from @com_google_absl
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_replace.h"  // from @com_google_absl
+#include "absl/strings/str_split.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+
+namespace litert::lm {
+namespace {
+
+// Separates the fingerprint of a device from its backend in a selection file,
+// which holds a line per device.
+constexpr char kFieldSeparator = '\t';
+
+// Returns the fingerprint with the separators of the selection file replaced,
+// such that it fits on a single field.
+std::string SanitizeFingerprint(absl::string_view device_fingerprint) {
+  return absl::StrReplaceAll(device_fingerprint,
+                             {{"\t", " "}, {"\n", " "}, {"\r", " "}});
+}
+
+}  // namespace
+
+std::vector<Backend> GetAutoBackendCandidates() {
+  return {Backend::NPU, Backend::GPU, Backend::CPU};
+}
+
+absl::StatusOr<Backend> ParseBackendSelection(
+    absl::string_view contents, absl::string_view device_fingerprint) {
+  const std::string fingerprint = SanitizeFingerprint(device_fingerprint);
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    std::pair<absl::string_view, absl::string_view> fields =
+        absl::StrSplit(line, absl::MaxSplits(kFieldSeparator, 1));
+    if (fields.first == fingerprint) {
+      return GetBackendFromString(absl::StripAsciiWhitespace(fields.second));
+    }
+  }
+  return absl::NotFoundError(
+      absl::StrCat("No backend is selected for the device ", fingerprint));
+}
+
+std::string UpdateBackendSelection(absl::string_view contents,
+                                   absl::string_view device_fingerprint,
+                                   Backend backend) {
+  const std::string fingerprint = SanitizeFingerprint(device_fingerprint);
+  std::string updated;
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    std::pair<absl::string_view, absl::string_view> fields =
+        absl::StrSplit(line, absl::MaxSplits(kFieldSeparator, 1));
+    if (line.empty() || fields.first == fingerprint) {
+      continue;
+    }
+    absl::StrAppend(&updated, line, "\n");
+  }
+  std::stringstream backend_name;
+  backend_name << backend;
+  absl::StrAppend(&updated, fingerprint, std::string(1, kFieldSeparator),
+                  backend_name.str(), "\n");
+  return updated;
+}
+
+absl::StatusOr<Backend> SelectFastestBackend(
+    absl::Span<const Backend> candidates,
+    absl::FunctionRef<absl::StatusOr<absl::Duration>(Backend)> calibrate) {
+  std::optional<Backend> fastest_backend;
+  absl::Duration fastest_latency = absl::InfiniteDuration();
+  absl::Status last_error =
+      absl::InvalidArgumentError("There is no backend to select from.");
+  for (Backend backend : candidates) {
+    absl::StatusOr<absl::Duration> latency = calibrate(backend);
+    if (!latency.ok()) {
+      ABSL_LOG(INFO) << "Backend " << backend
+                     << " is not available: " << latency.status();
+      last_error = latency.status();
+      continue;
+    }
+    ABSL_LOG(INFO) << "Backend " << backend << " calibrated in " << *latency;
+    if (!fastest_backend.has_value() || *latency < fastest_latency) {
+      fastest_backend = backend;
+      fastest_latency = *latency;
+    }
+  }
+  if (!fastest_backend.has_value()) {
+    return last_error;
+  }
+  return *fastest_backend;
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,65 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_BACKEND_SELECTION_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_BACKEND_SELECTION_H_
+
+#include <string>
+#include <vector>
+
+#include "absl/functional/function_ref.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+
+// The selection of the backend of Backend::AUTO. On the first run of a model
+// on a device, the engine builds the executor of each candidate backend, times
+// a short prefill and decode on it, and runs on the fastest one. The choice is
+// recorded next to the weight cache of the model, keyed by the device, so the
+// next runs pick it without measuring again.
+
+namespace litert::lm {
+
+// Returns the backends Backend::AUTO is selected from, in the order they are
+// calibrated: the accelerators first, then the CPU, which is always there to
+// fall back on.
+std::vector<Backend> GetAutoBackendCandidates();
+
+// Returns the backend the contents of a selection file record for the device
+// of `device_fingerprint`, see GetDeviceFingerprint(), or a NotFound error if
+// there is none.
+absl::StatusOr<Backend> ParseBackendSelection(
+    absl::string_view contents, absl::string_view device_fingerprint);
+
+// Returns the contents of a selection file recording `backend` for the device
+// of `device_fingerprint`, in place of what the previous `contents` record for
+// it, if any. The selections of the other devices are kept, e.g. for a model
+// directory shared between devices.
+std::string UpdateBackendSelection(absl::string_view contents,
+                                   absl::string_view device_fingerprint,
+                                   Backend backend);
+
+// Returns the candidate of the lowest latency measured by `calibrate`. The
+// candidates whose calibration fails, e.g. a GPU whose delegate can't be
+// created, are skipped. Returns the error of the last candidate if all of
+// them fail.
+absl::StatusOr<Backend> SelectFastestBackend(
+    absl::Span<const Backend> candidates,
+    absl::FunctionRef<absl::StatusOr<absl::Duration>(Backend)> calibrate);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_BACKEND_SELECTION_H_
@@ -0,0 +1,82 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/backend_selection.h"
+
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+TEST(BackendSelectionTest, FallsBackOnTheCpu) {
+  const std::vector<Backend> candidates = GetAutoBackendCandidates();
+  ASSERT_FALSE(candidates.empty());
+  EXPECT_EQ(candidates.back(), Backend::CPU);
+}
+
+TEST(BackendSelectionTest, RecordsTheSelectionOfEachDevice) {
+  EXPECT_THAT(ParseBackendSelection("", "phone"),
+              StatusIs(absl::StatusCode::kNotFound));
+  std::string contents = UpdateBackendSelection("", "phone", Backend::GPU);
+  contents = UpdateBackendSelection(contents, "laptop", Backend::CPU);
+  ASSERT_OK_AND_ASSIGN(Backend phone_backend,
+                       ParseBackendSelection(contents, "phone"));
+  EXPECT_EQ(phone_backend, Backend::GPU);
+
+  // The selection of a device replaces its previous one only.
+  contents = UpdateBackendSelection(contents, "phone", Backend::NPU);
+  ASSERT_OK_AND_ASSIGN(phone_backend, ParseBackendSelection(contents, "phone"));
+  EXPECT_EQ(phone_backend, Backend::NPU);
+  ASSERT_OK_AND_ASSIGN(Backend laptop_backend,
+                       ParseBackendSelection(contents, "laptop"));
+  EXPECT_EQ(laptop_backend, Backend::CPU);
+  EXPECT_THAT(ParseBackendSelection(contents, "tablet"),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST(BackendSelectionTest, SelectsTheFastestAvailableBackend) {
+  auto calibrate = [](Backend backend) -> absl::StatusOr<absl::Duration> {
+    switch (backend) {
+      case Backend::NPU:
+        return absl::UnavailableError("No NPU.");
+      case Backend::GPU:
+        return absl::Milliseconds(10);
+      default:
+        return absl::Milliseconds(30);
+    }
+  };
+  ASSERT_OK_AND_ASSIGN(
+      Backend backend,
+      SelectFastestBackend({Backend::NPU, Backend::GPU, Backend::CPU},
+                           calibrate));
+  EXPECT_EQ(backend, Backend::GPU);
+  ASSERT_OK_AND_ASSIGN(
+      backend, SelectFastestBackend({Backend::NPU, Backend::CPU}, calibrate));
+  EXPECT_EQ(backend, Backend::CPU);
+  EXPECT_THAT(SelectFastestBackend({Backend::NPU}, calibrate),
+              StatusIs(absl::StatusCode::kUnavailable));
+}
+
+}  // namespace
+}  // namespace litert::lm
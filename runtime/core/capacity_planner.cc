@@ -0,0 +1,377 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/capacity_planner.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_split.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "flatbuffers/flatbuffers.h"  // from @flatbuffers
+#include "runtime/components/model_resources.h"
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/proto/llm_metadata.pb.h"
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/memory_usage.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "schema/core/litertlm_header_schema_generated.h"
+#include "schema/core/litertlm_read.h"
+#include "schema/core/litertlm_utils.h"
+#include "tflite/model_builder.h"  // from @litert
+
+namespace litert::lm {
+namespace {
+
+constexpr double kBytesPerGigabyte = 1e9;
+constexpr uint64_t kBytesPerMegabyte = 1024 * 1024;
+
+// The prefixes of the names of the kv-cache inputs and outputs, as looked up
+// by the executor.
+constexpr absl::string_view kKvCachePrefixes[] = {"kv_cache_k_", "kv_cache_v_",
+                                                  "k_cache_", "v_cache_"};
+
+bool IsKvCacheName(absl::string_view name) {
+  return std::any_of(std::begin(kKvCachePrefixes), std::end(kKvCachePrefixes),
+                     [name](absl::string_view prefix) {
+                       return absl::StartsWith(name, prefix);
+                     });
+}
+
+absl::string_view ToStringView(const flatbuffers::String* absl_nullable str) {
+  return str == nullptr ? absl::string_view()
+                        : absl::string_view(str->c_str(), str->size());
+}
+
+// Returns the size of an element of `type`, 4 bytes for the types of no
+// fixed size.
+uint64_t GetElementSize(tflite::TensorType type) {
+  switch (type) {
+    case tflite::TensorType_BOOL:
+    case tflite::TensorType_INT8:
+    case tflite::TensorType_UINT8:
+      return 1;
+    case tflite::TensorType_FLOAT16:
+    case tflite::TensorType_INT16:
+      return 2;
+    case tflite::TensorType_INT64:
+    case tflite::TensorType_FLOAT64:
+      return 8;
+    default:
+      return 4;
+  }
+}
+
+// Returns the size of the tensor of `tensor_map` in `signature`. The dynamic
+// dimensions count as 1.
+absl::StatusOr<uint64_t> GetTensorSize(const tflite::Model& model,
+                                       const tflite::SignatureDef& signature,
+                                       const tflite::TensorMap& tensor_map) {
+  const auto* subgraphs = model.subgraphs();
+  RET_CHECK(subgraphs != nullptr &&
+            signature.subgraph_index() < subgraphs->size())
+          .SetCode(absl::StatusCode::kDataLoss)
+      << "Signature " << ToStringView(signature.signature_key())
+      << " refers to no subgraph.";
+  const tflite::SubGraph* subgraph =
+      subgraphs->Get(signature.subgraph_index());
+  RET_CHECK(subgraph->tensors() != nullptr &&
+            tensor_map.tensor_index() < subgraph->tensors()->size())
+          .SetCode(absl::StatusCode::kDataLoss)
+      << "Tensor " << ToStringView(tensor_map.name()) << " is not found.";
+  const tflite::Tensor* tensor =
+      subgraph->tensors()->Get(tensor_map.tensor_index());
+  uint64_t size = GetElementSize(tensor->type());
+  if (tensor->shape() != nullptr) {
+    for (int dim : *tensor->shape()) {
+      size *= std::max(dim, 1);
+    }
+  }
+  return size;
+}
+
+// Adds the sizes of the tensors of `signature` to the kv-cache size, for the
+// kv-cache inputs of the prefill signature, or else to `buffers_size`.
+absl::Status AddSignatureSizes(const tflite::Model& model,
+                               const tflite::SignatureDef& signature,
+                               bool is_prefill, ModelCapacityInfo& info,
+                               uint64_t& buffers_size) {
+  for (const auto* tensor_maps : {signature.inputs(), signature.outputs()}) {
+    if (tensor_maps == nullptr) {
+      continue;
+    }
+    const bool is_input = tensor_maps == signature.inputs();
+    for (const tflite::TensorMap* tensor_map : *tensor_maps) {
+      const bool is_kv_cache = IsKvCacheName(ToStringView(tensor_map->name()));
+      if (is_kv_cache && !(is_prefill && is_input)) {
+        // The kv-cache is shared by the signatures, and its second copy, if
+        // any, is counted by PlanCapacity().
+        continue;
+      }
+      ASSIGN_OR_RETURN(uint64_t size,
+                       GetTensorSize(model, signature, *tensor_map));
+      (is_kv_cache ? info.kv_cache_size : buffers_size) += size;
+    }
+  }
+  return absl::OkStatus();
+}
+
+// Reads the kv-cache and buffer sizes of the first prefill signature and of
+// the decode signature of `model`, as the executor allocates them.
+absl::Status ReadSignatureSizes(const tflite::Model& model,
+                                ModelCapacityInfo& info) {
+  const tflite::SignatureDef* prefill_signature = nullptr;
+  const tflite::SignatureDef* decode_signature = nullptr;
+  if (model.signature_defs() != nullptr) {
+    for (const tflite::SignatureDef* signature : *model.signature_defs()) {
+      const absl::string_view key = ToStringView(signature->signature_key());
+      if (prefill_signature == nullptr && absl::StartsWith(key, "prefill")) {
+        prefill_signature = signature;
+      } else if (key == "decode") {
+        decode_signature = signature;
+      }
+    }
+  }
+  RET_CHECK(prefill_signature != nullptr && decode_signature != nullptr)
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The model has no prefill and decode signatures.";
+  RETURN_IF_ERROR(AddSignatureSizes(model, *prefill_signature,
+                                    /*is_prefill=*/true, info,
+                                    info.prefill_buffers_size));
+  return AddSignatureSizes(model, *decode_signature, /*is_prefill=*/false, info,
+                           info.decode_buffers_size);
+}
+
+// Parses a bandwidth field in GB/s.
+absl::StatusOr<double> ParseGigabytesPerSecond(absl::string_view field) {
+  double value = 0;
+  if (!absl::SimpleAtod(field, &value) || value < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid bandwidth: ", field));
+  }
+  return value * kBytesPerGigabyte;
+}
+
+}  // namespace
+
+absl::StatusOr<ModelCapacityInfo> ReadModelCapacityInfo(
+    const std::string& litertlm_path) {
+  schema::LitertlmHeader header;
+  RETURN_IF_ERROR(schema::ReadHeaderFromLiteRTLM(litertlm_path, &header));
+  ModelCapacityInfo info;
+  std::optional<schema::SectionIndexEntry> main_model;
+  std::optional<int> metadata_section;
+  for (const schema::SectionIndexEntry& entry :
+       schema::BuildSectionIndex(*header.metadata)) {
+    const uint64_t size = entry.end_offset - entry.begin_offset;
+    info.has_compressed_sections |= !entry.compression.empty();
+    switch (entry.data_type) {
+      case schema::AnySectionDataType_TFLiteModel: {
+        ModelType model_type = ModelType::kTfLitePrefillDecode;
+        if (!entry.model_type.empty()) {
+          ASSIGN_OR_RETURN(model_type, StringToModelType(entry.model_type));
+        }
+        switch (model_type) {
+          case ModelType::kTfLitePrefillDecode:
+            info.model_weights_size += size;
+            main_model = entry;
+            break;
+          case ModelType::kTfLitePipelineFirstStage:
+          case ModelType::kTfLitePipelineSecondStage:
+            info.model_weights_size += size;
+            break;
+          case ModelType::kTfLiteEmbedder:
+          case ModelType::kTfLitePerLayerEmbedder:
+            info.embedder_weights_size += size;
+            break;
+          default:
+            // The draft and the auxiliary models are only loaded for the
+            // features using them.
+            break;
+        }
+        break;
+      }
+      case schema::AnySectionDataType_SP_Tokenizer:
+      case schema::AnySectionDataType_HF_Tokenizer_Zlib:
+      case schema::AnySectionDataType_HF_Tokenizer_Json:
+        info.tokenizer_size += size;
+        break;
+      case schema::AnySectionDataType_LlmMetadataProto:
+        metadata_section = entry.section_index;
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (metadata_section.has_value()) {
+    proto::LlmMetadata llm_metadata;
+    RETURN_IF_ERROR(schema::ReadLlmMetadataFromSection(
+        litertlm_path, *metadata_section, &llm_metadata));
+    info.max_num_tokens = llm_metadata.max_num_tokens();
+  }
+  // The signatures of a compressed model are only known once inflated.
+  if (main_model.has_value() && main_model->compression.empty()) {
+    std::unique_ptr<tflite::FlatBufferModel> tflite_model;
+    std::unique_ptr<MemoryMappedFile> mapped_file;
+    RETURN_IF_ERROR(schema::ReadTFLiteFileFromSection(
+        litertlm_path, main_model->section_index, &tflite_model,
+        &mapped_file));
+    RETURN_IF_ERROR(ReadSignatureSizes(*tflite_model->GetModel(), info));
+  }
+  return info;
+}
+
+std::vector<DeviceProfile> GetDefaultDeviceProfiles() {
+  return {
+      {.backend = Backend::CPU,
+       .decode_bytes_per_second = 15 * kBytesPerGigabyte,
+       .prefill_weight_bytes_per_second = 150 * kBytesPerGigabyte},
+      {.backend = Backend::GPU,
+       .decode_bytes_per_second = 30 * kBytesPerGigabyte,
+       .prefill_weight_bytes_per_second = 2500 * kBytesPerGigabyte},
+      {.backend = Backend::NPU,
+       .decode_bytes_per_second = 40 * kBytesPerGigabyte,
+       .prefill_weight_bytes_per_second = 8000 * kBytesPerGigabyte},
+  };
+}
+
+absl::StatusOr<std::vector<DeviceProfile>> ParseDeviceProfiles(
+    absl::string_view contents) {
+  std::vector<DeviceProfile> profiles;
+  int line_number = 0;
+  for (absl::string_view line : absl::StrSplit(contents, '\n')) {
+    ++line_number;
+    line = absl::StripTrailingAsciiWhitespace(line);
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    std::vector<absl::string_view> fields = absl::StrSplit(line, '\t');
+    if (fields.size() != 5) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Line ", line_number, " of the device profiles has ", fields.size(),
+          " fields instead of 5."));
+    }
+    DeviceProfile profile;
+    profile.device = std::string(fields[0]);
+    ASSIGN_OR_RETURN(profile.backend, GetBackendFromString(fields[1]));
+    ASSIGN_OR_RETURN(profile.decode_bytes_per_second,
+                     ParseGigabytesPerSecond(fields[2]));
+    ASSIGN_OR_RETURN(profile.prefill_weight_bytes_per_second,
+                     ParseGigabytesPerSecond(fields[3]));
+    uint64_t memory_budget_mb = 0;
+    if (!absl::SimpleAtoi(fields[4], &memory_budget_mb)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Invalid memory budget on line ", line_number, ": ", fields[4]));
+    }
+    profile.memory_budget = memory_budget_mb * kBytesPerMegabyte;
+    profiles.push_back(std::move(profile));
+  }
+  return profiles;
+}
+
+const DeviceProfile* absl_nullable FindDeviceProfile(
+    absl::Span<const DeviceProfile> profiles,
+    absl::string_view device_fingerprint, Backend backend) {
+  static const std::vector<DeviceProfile>* const kDefaultProfiles =
+      new std::vector<DeviceProfile>(GetDefaultDeviceProfiles());
+  for (absl::Span<const DeviceProfile> candidates :
+       {profiles, absl::MakeConstSpan(*kDefaultProfiles)}) {
+    for (const DeviceProfile& profile : candidates) {
+      if (profile.backend == backend &&
+          absl::StrContains(device_fingerprint, profile.device)) {
+        return &profile;
+      }
+    }
+  }
+  return nullptr;
+}
+
+CapacityPlan PlanCapacity(const ModelCapacityInfo& info,
+                          const LlmExecutorSettings& executor_settings,
+                          const DeviceProfile& profile) {
+  const Backend backend = executor_settings.GetBackend();
+  // The kv-cache is updated in place on CPU, and on GPU if the model supports
+  // it, as decided by the executor. Otherwise it has a second copy.
+  bool in_place_kv_cache_update = backend == Backend::CPU;
+  if (auto gpu_config = executor_settings.GetBackendConfig<GpuConfig>();
+      backend == Backend::GPU && gpu_config.ok()) {
+    in_place_kv_cache_update = gpu_config->in_place_kv_cache_update;
+  }
+  const MemoryLocation location =
+      backend == Backend::CPU ? MemoryLocation::kHost : MemoryLocation::kDevice;
+
+  CapacityPlan plan;
+  auto add = [&plan](absl::string_view component, MemoryLocation location,
+                     uint64_t size_in_bytes) {
+    if (size_in_bytes > 0) {
+      plan.memory_usage.Add(component, location, size_in_bytes);
+    }
+  };
+  add(kWeightsMemory, location, info.model_weights_size);
+  // The embedders are looked up on the host.
+  add(kEmbedderMemory, MemoryLocation::kHost, info.embedder_weights_size);
+  add(kTokenizerMemory, MemoryLocation::kHost, info.tokenizer_size);
+  add(kKvCacheMemory, location,
+      info.kv_cache_size * (in_place_kv_cache_update ? 1 : 2));
+  add(kPrefillBuffersMemory, location, info.prefill_buffers_size);
+  add(kDecodeBuffersMemory, location, info.decode_buffers_size);
+  plan.total_size_in_bytes =
+      plan.memory_usage.GetTotalSizeInBytes(MemoryLocation::kHost) +
+      plan.memory_usage.GetTotalSizeInBytes(MemoryLocation::kDevice);
+
+  // A decode step reads all the weights and the filled part of the
+  // kv-cache, while a prefill is bound by the compute over the weights.
+  const double decode_bytes_per_step =
+      info.model_weights_size + info.kv_cache_size / 2.0;
+  if (decode_bytes_per_step > 0) {
+    plan.decode_tokens_per_second =
+        profile.decode_bytes_per_second / decode_bytes_per_step;
+  }
+  if (info.model_weights_size > 0) {
+    plan.prefill_tokens_per_second =
+        profile.prefill_weight_bytes_per_second / info.model_weights_size;
+  }
+  return plan;
+}
+
+absl::Status CheckCapacity(const CapacityPlan& plan,
+                           const DeviceProfile& profile) {
+  if (profile.memory_budget == 0 ||
+      plan.total_size_in_bytes <= profile.memory_budget) {
+    return absl::OkStatus();
+  }
+  return absl::ResourceExhaustedError(absl::StrCat(
+      "The model needs about ", plan.total_size_in_bytes / kBytesPerMegabyte,
+      " MB on ", profile.device.empty() ? "the device" : profile.device,
+      ", more than its budget of ", profile.memory_budget / kBytesPerMegabyte,
+      " MB."));
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,125 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_CAPACITY_PLANNER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_CAPACITY_PLANNER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/memory_usage.h"
+
+// The estimation of the memory and the speed of a model on a device before
+// the engine is created, e.g. to pick a model or a backend that fits, or to
+// fail fast instead of running out of memory in the middle of the loading.
+// The estimates are rough: the memory is that of the weights and the buffers
+// the executor allocates, without the intermediate tensors of the delegates,
+// and the speed is extrapolated from the bandwidths of a device profile.
+
+namespace litert::lm {
+
+// The sizes of a .litertlm model, read from its header, its LLM metadata and
+// the signatures of its main TFLite model, without reading the weights.
+struct ModelCapacityInfo {
+  // The sizes of the sections, by what they hold, in bytes. The compressed
+  // sections count at their compressed size.
+  uint64_t model_weights_size = 0;
+  uint64_t embedder_weights_size = 0;
+  uint64_t tokenizer_size = 0;
+  // The max_num_tokens of the LLM metadata, 0 if not set.
+  int max_num_tokens = 0;
+  // The size of one copy of the kv-cache tensors, the inputs of the prefill
+  // signature named as the kv-cache.
+  uint64_t kv_cache_size = 0;
+  // The other inputs and outputs of the first prefill signature and of the
+  // decode signature, e.g. the logits.
+  uint64_t prefill_buffers_size = 0;
+  uint64_t decode_buffers_size = 0;
+  // Whether some sections are compressed, whose inflated size is larger.
+  bool has_compressed_sections = false;
+};
+
+// Reads the sizes of the model at `litertlm_path`. Only the header, the LLM
+// metadata and the signature tables of the main TFLite model are read.
+absl::StatusOr<ModelCapacityInfo> ReadModelCapacityInfo(
+    const std::string& litertlm_path);
+
+// The measured or typical bandwidths of a backend of a device.
+struct DeviceProfile {
+  // A part of the fingerprint of the devices the profile is for, see
+  // GetDeviceFingerprint(), e.g. the model of their CPU, or empty for all the
+  // devices.
+  std::string device;
+  Backend backend = Backend::CPU;
+  // The bytes per second the backend reads from its memory while decoding,
+  // i.e. the weights and the kv-cache read per step.
+  double decode_bytes_per_second = 0;
+  // The bytes of weights times the tokens per second the backend prefills,
+  // i.e. the prefill speed of a model of 1 byte of weights.
+  double prefill_weight_bytes_per_second = 0;
+  // The memory the backend can allocate, in bytes, or 0 if unknown.
+  uint64_t memory_budget = 0;
+};
+
+// Returns the profiles of a mid-range phone for each backend, with no memory
+// budget, which FindDeviceProfile() falls back on.
+std::vector<DeviceProfile> GetDefaultDeviceProfiles();
+
+// Parses the profiles of a database file, one per line of tab separated
+// fields: the device, the backend, the decode and prefill bandwidths in GB/s
+// and the memory budget in MB, e.g.
+//   Cortex-A78\tgpu\t25\t3000\t6144
+// The blank lines and the lines starting with '#' are skipped.
+absl::StatusOr<std::vector<DeviceProfile>> ParseDeviceProfiles(
+    absl::string_view contents);
+
+// Returns the first of `profiles` for `backend` whose device is a part of
+// `device_fingerprint`, or else the default profile of `backend`, or nullptr
+// if there is none.
+const DeviceProfile* absl_nullable FindDeviceProfile(
+    absl::Span<const DeviceProfile> profiles,
+    absl::string_view device_fingerprint, Backend backend);
+
+struct CapacityPlan {
+  // The memory of the weights, the kv-cache and the buffers, by component
+  // and location, see MemoryUsage.
+  MemoryUsage memory_usage;
+  uint64_t total_size_in_bytes = 0;
+  double prefill_tokens_per_second = 0;
+  // The speed of a decode step with a half full kv-cache.
+  double decode_tokens_per_second = 0;
+};
+
+// Estimates the memory and the speed of the model of `info` run with
+// `executor_settings` on the device of `profile`.
+CapacityPlan PlanCapacity(const ModelCapacityInfo& info,
+                          const LlmExecutorSettings& executor_settings,
+                          const DeviceProfile& profile);
+
+// Returns a ResourceExhausted error if `plan` does not fit in the memory
+// budget of `profile`, if it has one.
+absl::Status CheckCapacity(const CapacityPlan& plan,
+                           const DeviceProfile& profile);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_CAPACITY_PLANNER_H_
@@ -0,0 +1,144 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/capacity_planner.h"
+
+#include <cstdint>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/memory_usage.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+constexpr uint64_t kMegabyte = 1024 * 1024;
+
+LlmExecutorSettings CreateSettings(Backend backend) {
+  auto model_assets = ModelAssets::Create("/path/to/model.litertlm");
+  return *LlmExecutorSettings::CreateDefault(*std::move(model_assets),
+                                             backend);
+}
+
+TEST(CapacityPlannerTest, ReadModelCapacityInfo) {
+  const std::string model_path =
+      (std::filesystem::path(::testing::SrcDir()) /
+       "litert_lm/runtime/testdata/test_lm.litertlm")
+          .string();
+  ASSERT_OK_AND_ASSIGN(ModelCapacityInfo info,
+                       ReadModelCapacityInfo(model_path));
+  EXPECT_GT(info.model_weights_size, 0);
+  EXPECT_GT(info.tokenizer_size, 0);
+  EXPECT_GT(info.kv_cache_size, 0);
+  EXPECT_GT(info.decode_buffers_size, 0);
+  EXPECT_LT(info.model_weights_size + info.tokenizer_size,
+            std::filesystem::file_size(model_path));
+
+  EXPECT_FALSE(ReadModelCapacityInfo("/no/such/model.litertlm").ok());
+}
+
+TEST(CapacityPlannerTest, ParseAndFindDeviceProfiles) {
+  ASSERT_OK_AND_ASSIGN(std::vector<DeviceProfile> profiles,
+                       ParseDeviceProfiles("# device\tbackend\t...\n"
+                                           "\n"
+                                           "Cortex-A78\tgpu\t25\t3000\t6144\n"
+                                           "\tcpu\t10\t100\t0\n"));
+  ASSERT_EQ(profiles.size(), 2);
+  EXPECT_EQ(profiles[0].device, "Cortex-A78");
+  EXPECT_EQ(profiles[0].backend, Backend::GPU);
+  EXPECT_DOUBLE_EQ(profiles[0].decode_bytes_per_second, 25e9);
+  EXPECT_DOUBLE_EQ(profiles[0].prefill_weight_bytes_per_second, 3000e9);
+  EXPECT_EQ(profiles[0].memory_budget, 6144 * kMegabyte);
+
+  EXPECT_EQ(FindDeviceProfile(profiles, "arm64 Cortex-A78 x8", Backend::GPU),
+            &profiles[0]);
+  EXPECT_EQ(FindDeviceProfile(profiles, "x86_64", Backend::CPU),
+            &profiles[1]);
+  // The default profile of the backend.
+  const DeviceProfile* gpu_profile =
+      FindDeviceProfile(profiles, "x86_64", Backend::GPU);
+  ASSERT_NE(gpu_profile, nullptr);
+  EXPECT_TRUE(gpu_profile->device.empty());
+  EXPECT_EQ(gpu_profile->memory_budget, 0);
+  EXPECT_EQ(FindDeviceProfile(profiles, "x86_64", Backend::GPU_ARTISAN),
+            nullptr);
+
+  EXPECT_THAT(ParseDeviceProfiles("Cortex-A78\tgpu\t25\n"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseDeviceProfiles("Cortex-A78\ttpu\t25\t3000\t6144\n"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseDeviceProfiles("Cortex-A78\tgpu\tfast\t3000\t6144\n"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(CapacityPlannerTest, PlanCapacity) {
+  const ModelCapacityInfo info = {
+      .model_weights_size = 1000 * kMegabyte,
+      .embedder_weights_size = 100 * kMegabyte,
+      .tokenizer_size = 4 * kMegabyte,
+      .max_num_tokens = 4096,
+      .kv_cache_size = 200 * kMegabyte,
+      .prefill_buffers_size = 10 * kMegabyte,
+      .decode_buffers_size = 2 * kMegabyte,
+  };
+  const DeviceProfile profile = {
+      .decode_bytes_per_second = 1100.0 * kMegabyte,
+      .prefill_weight_bytes_per_second = 100000.0 * kMegabyte,
+      .memory_budget = 1400 * kMegabyte,
+  };
+
+  // The kv-cache is updated in place on CPU.
+  CapacityPlan cpu_plan =
+      PlanCapacity(info, CreateSettings(Backend::CPU), profile);
+  EXPECT_EQ(cpu_plan.memory_usage.GetSizeInBytes(kWeightsMemory,
+                                                 MemoryLocation::kHost),
+            1000 * kMegabyte);
+  EXPECT_EQ(cpu_plan.memory_usage.GetSizeInBytes(kKvCacheMemory,
+                                                 MemoryLocation::kHost),
+            200 * kMegabyte);
+  EXPECT_EQ(cpu_plan.total_size_in_bytes, 1316 * kMegabyte);
+  EXPECT_DOUBLE_EQ(cpu_plan.decode_tokens_per_second, 1.0);
+  EXPECT_DOUBLE_EQ(cpu_plan.prefill_tokens_per_second, 100.0);
+  EXPECT_OK(CheckCapacity(cpu_plan, profile));
+
+  // The GPU holds the weights and a second copy of the kv-cache.
+  CapacityPlan gpu_plan =
+      PlanCapacity(info, CreateSettings(Backend::GPU), profile);
+  EXPECT_EQ(gpu_plan.memory_usage.GetSizeInBytes(kWeightsMemory,
+                                                 MemoryLocation::kDevice),
+            1000 * kMegabyte);
+  EXPECT_EQ(gpu_plan.memory_usage.GetSizeInBytes(kKvCacheMemory,
+                                                 MemoryLocation::kDevice),
+            400 * kMegabyte);
+  EXPECT_EQ(gpu_plan.memory_usage.GetSizeInBytes(kEmbedderMemory,
+                                                 MemoryLocation::kHost),
+            100 * kMegabyte);
+  EXPECT_EQ(gpu_plan.total_size_in_bytes, 1516 * kMegabyte);
+  EXPECT_THAT(CheckCapacity(gpu_plan, profile),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+}
+
+}  // namespace
+}  // namespace litert::lm
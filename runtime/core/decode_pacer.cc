@@ -0,0 +1,59 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/decode_pacer.h"
+
+#include <algorithm>
+
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/engine_settings.h"
+
+namespace litert::lm {
+
+DecodePacer::DecodePacer(const DecodePacingConfig& config)
+    : target_step_interval_(config.target_steps_per_second > 0
+                                ? absl::Seconds(1.0 /
+                                                config.target_steps_per_second)
+                                : absl::ZeroDuration()),
+      throttle_latency_ratio_(config.throttle_latency_ratio) {}
+
+void DecodePacer::Restart() { last_step_start_.reset(); }
+
+absl::Duration DecodePacer::GetWaitBeforeStep(absl::Time now) {
+  if (!last_step_start_.has_value()) {
+    last_step_start_ = now;
+    return absl::ZeroDuration();
+  }
+  const absl::Duration latency = now - *last_step_start_;
+  if (num_measured_steps_ == 0) {
+    step_latency_ = latency;
+    lowest_step_latency_ = latency;
+  } else {
+    step_latency_ += (latency - step_latency_) * kLatencySmoothing;
+    lowest_step_latency_ = std::min(lowest_step_latency_, step_latency_);
+  }
+  ++num_measured_steps_;
+  throttled_ = step_latency_ > lowest_step_latency_ * throttle_latency_ratio_;
+
+  absl::Duration step_interval = target_step_interval_;
+  if (throttled_) {
+    step_interval = std::max(step_interval, step_latency_);
+  }
+  const absl::Duration wait =
+      std::max(absl::ZeroDuration(), step_interval - latency);
+  last_step_start_ = now + wait;
+  return wait;
+}
+
+}  // namespace litert::lm
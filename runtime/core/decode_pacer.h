@@ -0,0 +1,80 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DECODE_PACER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DECODE_PACER_H_
+
+#include <optional>
+
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/engine_settings.h"
+
+namespace litert::lm {
+
+// Paces the decode steps of a session as set by its DecodePacingConfig. The
+// step latency is measured from the start of one step to the start of the
+// next, and smoothed; the lowest smoothed latency seen is the one of the
+// device at full clocks. Once the smoothed latency exceeds it by the
+// throttle ratio, the device is taken as throttled, e.g. by DVFS or its
+// thermal governor, and the steps are held at the smoothed latency, so the
+// faster ones wait and the stream keeps a steady rate. The steps are also
+// held at the target rate, if any. The class is not thread-safe.
+//
+//   DecodePacer pacer(pacing_config);
+//   pacer.Restart();
+//   while (...) {
+//     absl::SleepFor(pacer.GetWaitBeforeStep(absl::Now()));
+//     // Run the decode step.
+//   }
+class DecodePacer {
+ public:
+  explicit DecodePacer(const DecodePacingConfig& config);
+
+  // Starts a decode call, such that the time since the last step of the
+  // previous call is not taken as a step latency. The measured latencies are
+  // kept, as the device stays as hot.
+  void Restart();
+
+  // Returns how long to wait from `now` before starting the next step, and
+  // takes the step as started after the wait. The first step after Restart()
+  // does not wait.
+  absl::Duration GetWaitBeforeStep(absl::Time now);
+
+  // Whether the last steps were slow enough for the device to be taken as
+  // throttled.
+  bool IsThrottled() const { return throttled_; }
+
+  // Returns the smoothed step latency, and the lowest one seen.
+  absl::Duration GetStepLatency() const { return step_latency_; }
+  absl::Duration GetLowestStepLatency() const { return lowest_step_latency_; }
+
+ private:
+  // The weight of the latest step in the smoothed latency.
+  static constexpr double kLatencySmoothing = 0.2;
+
+  // The interval of the target rate, or zero if there is none.
+  const absl::Duration target_step_interval_;
+  const double throttle_latency_ratio_;
+
+  // The start of the last step of the current decode call, if any.
+  std::optional<absl::Time> last_step_start_;
+  int num_measured_steps_ = 0;
+  absl::Duration step_latency_ = absl::ZeroDuration();
+  absl::Duration lowest_step_latency_ = absl::ZeroDuration();
+  bool throttled_ = false;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DECODE_PACER_H_
@@ -0,0 +1,84 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/decode_pacer.h"
+
+#include <gtest/gtest.h>
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/engine_settings.h"
+
+namespace litert::lm {
+namespace {
+
+TEST(DecodePacerTest, HoldsTheTargetRate) {
+  DecodePacingConfig config;
+  config.target_steps_per_second = 10;
+  DecodePacer pacer(config);
+  pacer.Restart();
+  absl::Time now = absl::UnixEpoch();
+  EXPECT_EQ(pacer.GetWaitBeforeStep(now), absl::ZeroDuration());
+  // The steps of 40ms wait for the rest of their 100ms.
+  for (int i = 0; i < 3; ++i) {
+    now += absl::Milliseconds(40);
+    const absl::Duration wait = pacer.GetWaitBeforeStep(now);
+    EXPECT_EQ(wait, absl::Milliseconds(60));
+    now += wait;
+  }
+  // The slower steps do not wait.
+  now += absl::Milliseconds(120);
+  EXPECT_EQ(pacer.GetWaitBeforeStep(now), absl::ZeroDuration());
+  EXPECT_FALSE(pacer.IsThrottled());
+}
+
+TEST(DecodePacerTest, HoldsTheThrottledRate) {
+  DecodePacer pacer(DecodePacingConfig{});
+  pacer.Restart();
+  absl::Time now = absl::UnixEpoch();
+  EXPECT_EQ(pacer.GetWaitBeforeStep(now), absl::ZeroDuration());
+  // The steps at full clocks are not paced.
+  for (int i = 0; i < 5; ++i) {
+    now += absl::Milliseconds(10);
+    EXPECT_EQ(pacer.GetWaitBeforeStep(now), absl::ZeroDuration());
+  }
+  EXPECT_FALSE(pacer.IsThrottled());
+  // The device throttles, so the steps get slower.
+  for (int i = 0; i < 10; ++i) {
+    now += absl::Milliseconds(30);
+    now += pacer.GetWaitBeforeStep(now);
+  }
+  EXPECT_TRUE(pacer.IsThrottled());
+  EXPECT_EQ(pacer.GetLowestStepLatency(), absl::Milliseconds(10));
+  EXPECT_GT(pacer.GetStepLatency(), absl::Milliseconds(15));
+  // A faster step is held at the throttled rate.
+  now += absl::Milliseconds(10);
+  EXPECT_GT(pacer.GetWaitBeforeStep(now), absl::ZeroDuration());
+}
+
+TEST(DecodePacerTest, RestartDoesNotCountTheTimeBetweenCalls) {
+  DecodePacer pacer(DecodePacingConfig{});
+  pacer.Restart();
+  absl::Time now = absl::UnixEpoch();
+  pacer.GetWaitBeforeStep(now);
+  now += absl::Milliseconds(10);
+  pacer.GetWaitBeforeStep(now);
+  // The next call starts a minute later.
+  now += absl::Minutes(1);
+  pacer.Restart();
+  EXPECT_EQ(pacer.GetWaitBeforeStep(now), absl::ZeroDuration());
+  EXPECT_EQ(pacer.GetStepLatency(), absl::Milliseconds(10));
+  EXPECT_FALSE(pacer.IsThrottled());
+}
+
+}  // namespace
+}  // namespace litert::lm
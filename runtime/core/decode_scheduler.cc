@@ -0,0 +1,265 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/decode_scheduler.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "runtime/components/stop_token_detector.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<DecodeScheduler>> DecodeScheduler::Create(
+    int num_slots, const std::vector<std::vector<int>>& stop_token_ids,
+    StepFunction step_function) {
+  return Create(num_slots, stop_token_ids, std::move(step_function),
+                /*prefill_function=*/nullptr,
+                /*max_prefill_tokens_per_step=*/0);
+}
+
+// static
+absl::StatusOr<std::unique_ptr<DecodeScheduler>> DecodeScheduler::Create(
+    int num_slots, const std::vector<std::vector<int>>& stop_token_ids,
+    StepFunction step_function, PrefillFunction prefill_function,
+    int max_prefill_tokens_per_step) {
+  if (num_slots <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Number of slots must be positive, got ", num_slots));
+  }
+  if (step_function == nullptr) {
+    return absl::InvalidArgumentError("Step function must be provided.");
+  }
+  if (prefill_function != nullptr && max_prefill_tokens_per_step <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Max number of prefill tokens per step must be positive, "
+                     "got ",
+                     max_prefill_tokens_per_step));
+  }
+  StopTokenDetector stop_token_detector(num_slots);
+  int max_stop_sequence_length = 0;
+  for (const auto& stop_token_sequence : stop_token_ids) {
+    RETURN_IF_ERROR(
+        stop_token_detector.AddStopTokenSequence(stop_token_sequence));
+    max_stop_sequence_length = std::max<int>(max_stop_sequence_length,
+                                             stop_token_sequence.size());
+  }
+  return absl::WrapUnique(new DecodeScheduler(
+      num_slots, std::move(stop_token_detector), max_stop_sequence_length,
+      std::move(step_function), std::move(prefill_function),
+      max_prefill_tokens_per_step));
+}
+
+absl::StatusOr<int> DecodeScheduler::Join(int last_token_id,
+                                          int max_num_tokens,
+                                          TokenCallback on_token,
+                                          DoneCallback on_done) {
+  if (max_num_tokens <= 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Max number of tokens must be positive, got ", max_num_tokens));
+  }
+  auto it = std::find_if(slots_.begin(), slots_.end(),
+                         [](const Slot& slot) { return !slot.active; });
+  if (it == slots_.end()) {
+    return absl::ResourceExhaustedError(
+        absl::StrCat("All ", slots_.size(), " decode slots are taken."));
+  }
+  const int slot_index = it - slots_.begin();
+  RETURN_IF_ERROR(stop_token_detector_.ResetBatchItem(slot_index));
+  it->active = true;
+  it->next_input_token_id = last_token_id;
+  it->remaining_num_tokens = max_num_tokens;
+  it->pending_token_ids.clear();
+  it->on_token = std::move(on_token);
+  it->on_done = std::move(on_done);
+  return slot_index;
+}
+
+absl::StatusOr<int> DecodeScheduler::JoinWithPrefill(
+    std::vector<int> prompt_ids, int max_num_tokens, TokenCallback on_token,
+    DoneCallback on_done) {
+  if (prefill_function_ == nullptr) {
+    return absl::FailedPreconditionError(
+        "The scheduler is created without a prefill function.");
+  }
+  if (prompt_ids.empty()) {
+    return absl::InvalidArgumentError("Prompt ids must be non-empty.");
+  }
+  ASSIGN_OR_RETURN(int slot_index,
+                   Join(prompt_ids.back(), max_num_tokens, std::move(on_token),
+                        std::move(on_done)));
+  Slot& slot = slots_[slot_index];
+  slot.prefilling = true;
+  slot.prompt_ids = std::move(prompt_ids);
+  slot.num_prefilled_tokens = 0;
+  prefill_queue_.push_back(slot_index);
+  return slot_index;
+}
+
+absl::Status DecodeScheduler::Leave(int slot) {
+  if (slot < 0 || slot >= slots_.size()) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Slot ", slot, " is out of range."));
+  }
+  if (!slots_[slot].active) {
+    return absl::FailedPreconditionError(
+        absl::StrCat("Slot ", slot, " is not active."));
+  }
+  if (slots_[slot].prefilling) {
+    prefill_queue_.erase(
+        std::find(prefill_queue_.begin(), prefill_queue_.end(), slot));
+  }
+  slots_[slot] = Slot();
+  return absl::OkStatus();
+}
+
+void DecodeScheduler::Finish(int slot, int num_dropped, absl::Status status) {
+  // Free the slot before calling the callbacks, such that on_done may join a
+  // new sequence into it.
+  Slot finished = std::move(slots_[slot]);
+  slots_[slot] = Slot();
+  const int num_delivered =
+      std::max<int>(finished.pending_token_ids.size() - num_dropped, 0);
+  for (int i = 0; i < num_delivered; ++i) {
+    if (finished.on_token != nullptr) {
+      finished.on_token(finished.pending_token_ids[i]);
+    }
+  }
+  if (finished.on_done != nullptr) {
+    finished.on_done(std::move(status));
+  }
+}
+
+void DecodeScheduler::PrefillChunks() {
+  int budget = max_prefill_tokens_per_step_;
+  while (budget > 0 && !prefill_queue_.empty()) {
+    const int slot_index = prefill_queue_.front();
+    Slot& slot = slots_[slot_index];
+    const int num_tokens = std::min<int>(
+        budget, slot.prompt_ids.size() - slot.num_prefilled_tokens);
+    absl::Status status = prefill_function_(
+        slot_index, absl::MakeConstSpan(slot.prompt_ids)
+                        .subspan(slot.num_prefilled_tokens, num_tokens));
+    budget -= num_tokens;
+    slot.num_prefilled_tokens += num_tokens;
+    const bool prefill_done =
+        slot.num_prefilled_tokens == slot.prompt_ids.size();
+    if (status.ok() && prefill_done) {
+      // The detector saw the padding outputs of the slot while it was
+      // prefilling.
+      status = stop_token_detector_.ResetBatchItem(slot_index);
+    }
+    if (!status.ok() || prefill_done) {
+      prefill_queue_.pop_front();
+    }
+    if (!status.ok()) {
+      Finish(slot_index, /*num_dropped=*/0, status);
+      continue;
+    }
+    if (prefill_done) {
+      slot.prefilling = false;
+      slot.prompt_ids = std::vector<int>();
+    }
+  }
+}
+
+absl::Status DecodeScheduler::Step() {
+  if (NumActiveSlots() == 0) {
+    return absl::OkStatus();
+  }
+  // Only the slots decoding at the start of this step get its output. A slot
+  // refilled by an on_done callback below, or done prefilling in this step,
+  // starts with the next step.
+  bool has_decoding_slots = false;
+  for (int i = 0; i < slots_.size(); ++i) {
+    stepped_slots_[i] = slots_[i].active && !slots_[i].prefilling;
+    has_decoding_slots = has_decoding_slots || stepped_slots_[i];
+    input_ids_[i] =
+        stepped_slots_[i] ? slots_[i].next_input_token_id : kPaddingTokenId;
+  }
+  PrefillChunks();
+  if (!has_decoding_slots) {
+    return absl::OkStatus();
+  }
+  absl::Status status = step_function_(input_ids_, absl::MakeSpan(output_ids_));
+  if (status.ok() && has_stop_sequences_) {
+    status = stop_token_detector_.ProcessTokens(output_ids_);
+  }
+  if (!status.ok()) {
+    for (int i = 0; i < slots_.size(); ++i) {
+      if (stepped_slots_[i]) {
+        Finish(i, /*num_dropped=*/0, status);
+      }
+    }
+    return status;
+  }
+
+  for (int i = 0; i < slots_.size(); ++i) {
+    if (!stepped_slots_[i]) {
+      continue;
+    }
+    Slot& slot = slots_[i];
+    const int token_id = output_ids_[i];
+    slot.next_input_token_id = token_id;
+    slot.pending_token_ids.push_back(token_id);
+    --slot.remaining_num_tokens;
+    if (has_stop_sequences_ && stop_token_detector_.GetStopTokensFound()[i]) {
+      Finish(i, stop_token_detector_.GetStepsBeforeStopTokens()[i],
+             absl::OkStatus());
+      continue;
+    }
+    if (slot.remaining_num_tokens <= 0) {
+      Finish(i, /*num_dropped=*/0, absl::OkStatus());
+      continue;
+    }
+    while (slot.pending_token_ids.size() > max_held_back_tokens_) {
+      const int delivered_token_id = slot.pending_token_ids.front();
+      slot.pending_token_ids.pop_front();
+      if (slot.on_token != nullptr) {
+        slot.on_token(delivered_token_id);
+      }
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status DecodeScheduler::RunUntilIdle() {
+  while (NumActiveSlots() > 0) {
+    RETURN_IF_ERROR(Step());
+  }
+  return absl::OkStatus();
+}
+
+int DecodeScheduler::NumActiveSlots() const {
+  return std::count_if(slots_.begin(), slots_.end(),
+                       [](const Slot& slot) { return slot.active; });
+}
+
+bool DecodeScheduler::IsActive(int slot) const {
+  return slot >= 0 && slot < slots_.size() && slots_[slot].active;
+}
+
+bool DecodeScheduler::IsPrefilling(int slot) const {
+  return IsActive(slot) && slots_[slot].prefilling;
+}
+
+}  // namespace litert::lm
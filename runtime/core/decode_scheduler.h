@@ -0,0 +1,203 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DECODE_SCHEDULER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DECODE_SCHEDULER_H_
+
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/stop_token_detector.h"
+
+namespace litert::lm {
+
+// DecodeScheduler merges the decode steps of several sequences into a single
+// batched decode call (continuous batching). Each sequence owns one slot, i.e.
+// one row of the batch and of the kv-cache, from Join() until it finishes or
+// Leave() is called. Sequences join and leave at token boundaries, between two
+// Step() calls, so a finished sequence frees its slot for a waiting one
+// without draining the rest of the batch.
+//
+// A sequence may also join with its prompt through JoinWithPrefill(). Its
+// prompt is then prefilled in chunks of at most `max_prefill_tokens_per_step`
+// tokens, one budget per Step() and ahead of the decode step of the other
+// slots, so that a long prompt does not stall the active sequences for its
+// whole duration. The sequence starts decoding at the step after its last
+// chunk.
+//
+// Stop sequences are detected with one StopTokenDetector over all the slots.
+// The tokens of a sequence are delivered with a delay of the longest stop
+// sequence minus one, so that the tokens of a matched stop sequence are never
+// delivered.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto scheduler,
+//                    DecodeScheduler::Create(num_slots, stop_token_ids,
+//                                            std::move(step_function)));
+//   ASSIGN_OR_RETURN(int slot, scheduler->Join(last_prefill_token_id,
+//                                              max_num_tokens, on_token,
+//                                              on_done));
+//   RETURN_IF_ERROR(scheduler->RunUntilIdle());
+//
+// The callbacks may call Join() to refill a slot, but must not call Leave() or
+// Step(). The class is not thread-safe.
+class DecodeScheduler {
+ public:
+  // Runs one batched decode step. `input_ids` holds the input token of every
+  // slot and `output_ids` receives the decoded token of every slot. Free slots
+  // are fed kPaddingTokenId and their output is ignored.
+  using StepFunction = absl::AnyInvocable<absl::Status(
+      absl::Span<const int> input_ids, absl::Span<int> output_ids)>;
+
+  // Prefills `input_ids`, the next chunk of the prompt, into the kv-cache of
+  // `slot`. The executor splits each chunk into its prefill signature work
+  // groups, so a budget that is a multiple of a signature length avoids
+  // padding.
+  using PrefillFunction = absl::AnyInvocable<absl::Status(
+      int slot, absl::Span<const int> input_ids)>;
+
+  // Called with each decoded token of a sequence.
+  using TokenCallback = absl::AnyInvocable<void(int token_id)>;
+
+  // Called once when a sequence finishes, with OkStatus on a stop token or on
+  // reaching its token budget, and with the error otherwise. Not called when
+  // the sequence leaves through Leave().
+  using DoneCallback = absl::AnyInvocable<void(absl::Status status)>;
+
+  // The token fed to the free slots.
+  static constexpr int kPaddingTokenId = 0;
+
+  // Creates a DecodeScheduler.
+  // - num_slots: The batch size of the step function.
+  // - stop_token_ids: The stop token sequences shared by all the sequences.
+  // - step_function: Runs one batched decode step.
+  static absl::StatusOr<std::unique_ptr<DecodeScheduler>> Create(
+      int num_slots, const std::vector<std::vector<int>>& stop_token_ids,
+      StepFunction step_function);
+
+  // Creates a DecodeScheduler that also accepts JoinWithPrefill().
+  // - prefill_function: Prefills one chunk of a prompt.
+  // - max_prefill_tokens_per_step: The number of prompt tokens prefilled per
+  //   Step(), shared by all the prefilling sequences in join order.
+  static absl::StatusOr<std::unique_ptr<DecodeScheduler>> Create(
+      int num_slots, const std::vector<std::vector<int>>& stop_token_ids,
+      StepFunction step_function, PrefillFunction prefill_function,
+      int max_prefill_tokens_per_step);
+
+  // Adds a sequence to a free slot and returns the slot index. Decoding starts
+  // from `last_token_id` at the next Step(). The sequence finishes on a stop
+  // sequence or after `max_num_tokens` decoded tokens.
+  // Returns ResourceExhaustedError if all the slots are taken.
+  absl::StatusOr<int> Join(int last_token_id, int max_num_tokens,
+                           TokenCallback on_token, DoneCallback on_done);
+
+  // Adds a sequence to a free slot and returns the slot index. `prompt_ids`
+  // are prefilled in chunks by the following Step() calls, and decoding
+  // starts from the last prompt token. If a chunk fails to prefill, the
+  // sequence finishes with the error while the other slots carry on.
+  // Returns FailedPreconditionError if the scheduler has no prefill function.
+  absl::StatusOr<int> JoinWithPrefill(std::vector<int> prompt_ids,
+                                      int max_num_tokens,
+                                      TokenCallback on_token,
+                                      DoneCallback on_done);
+
+  // Removes the sequence of `slot` from the batch and frees the slot. The
+  // tokens that are still held back for stop sequence detection are dropped.
+  absl::Status Leave(int slot);
+
+  // Prefills the next chunks of the prefilling slots, then runs one batched
+  // decode step for all the decoding slots and delivers the decoded tokens.
+  // Finished sequences leave the batch afterwards. If the step function
+  // fails, every decoding sequence finishes with the error.
+  absl::Status Step();
+
+  // Runs Step() until no sequence is active.
+  absl::Status RunUntilIdle();
+
+  int NumSlots() const { return slots_.size(); }
+  // Active slots include the prefilling ones.
+  int NumActiveSlots() const;
+  bool IsActive(int slot) const;
+  bool IsPrefilling(int slot) const;
+
+ private:
+  struct Slot {
+    bool active = false;
+    // Whether the prompt is still being prefilled, in which case the slot
+    // does not take part in the decode steps.
+    bool prefilling = false;
+    std::vector<int> prompt_ids;
+    int num_prefilled_tokens = 0;
+    // The input token of the next step.
+    int next_input_token_id = kPaddingTokenId;
+    // The number of tokens the sequence may still decode.
+    int remaining_num_tokens = 0;
+    // Decoded tokens held back until they cannot be part of a stop sequence.
+    std::deque<int> pending_token_ids;
+    TokenCallback on_token;
+    DoneCallback on_done;
+  };
+
+  DecodeScheduler(int num_slots, StopTokenDetector stop_token_detector,
+                  int max_stop_sequence_length, StepFunction step_function,
+                  PrefillFunction prefill_function,
+                  int max_prefill_tokens_per_step)
+      : slots_(num_slots),
+        stop_token_detector_(std::move(stop_token_detector)),
+        has_stop_sequences_(max_stop_sequence_length > 0),
+        max_held_back_tokens_(
+            max_stop_sequence_length > 0 ? max_stop_sequence_length - 1 : 0),
+        step_function_(std::move(step_function)),
+        prefill_function_(std::move(prefill_function)),
+        max_prefill_tokens_per_step_(max_prefill_tokens_per_step),
+        input_ids_(num_slots, kPaddingTokenId),
+        output_ids_(num_slots, kPaddingTokenId),
+        stepped_slots_(num_slots, false) {}
+
+  // Delivers the pending tokens of `slot`, except the last `num_dropped`
+  // ones, and frees the slot.
+  void Finish(int slot, int num_dropped, absl::Status status);
+
+  // Spends the prefill budget of one step on the prefilling slots in join
+  // order.
+  void PrefillChunks();
+
+  std::vector<Slot> slots_;
+  StopTokenDetector stop_token_detector_;
+  const bool has_stop_sequences_;
+  const int max_held_back_tokens_;
+  StepFunction step_function_;
+  PrefillFunction prefill_function_;
+  const int max_prefill_tokens_per_step_;
+
+  // The prefilling slots in join order.
+  std::deque<int> prefill_queue_;
+
+  // Scratch buffers of the step function, so that a step does not allocate.
+  std::vector<int> input_ids_;
+  std::vector<int> output_ids_;
+  // Whether each slot took part in the current step.
+  std::vector<bool> stepped_slots_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DECODE_SCHEDULER_H_
@@ -0,0 +1,243 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/decode_scheduler.h"
+
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::status::StatusIs;
+
+// A step function that decodes `input + 1` for every slot and records the
+// batched inputs.
+DecodeScheduler::StepFunction IncrementStep(
+    std::vector<std::vector<int>>* steps) {
+  return [steps](absl::Span<const int> input_ids, absl::Span<int> output_ids) {
+    steps->emplace_back(input_ids.begin(), input_ids.end());
+    for (int i = 0; i < input_ids.size(); ++i) {
+      output_ids[i] = input_ids[i] + 1;
+    }
+    return absl::OkStatus();
+  };
+}
+
+// Collects the tokens and the final status of one sequence.
+struct Sequence {
+  std::vector<int> tokens;
+  std::optional<absl::Status> status;
+
+  DecodeScheduler::TokenCallback OnToken() {
+    return [this](int token_id) { tokens.push_back(token_id); };
+  }
+  DecodeScheduler::DoneCallback OnDone() {
+    return [this](absl::Status done_status) { status = done_status; };
+  }
+};
+
+TEST(DecodeSchedulerTest, CreateRejectsInvalidArguments) {
+  std::vector<std::vector<int>> steps;
+  EXPECT_THAT(
+      DecodeScheduler::Create(/*num_slots=*/0, {}, IncrementStep(&steps)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(DecodeScheduler::Create(/*num_slots=*/2, {}, nullptr),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(
+      DecodeScheduler::Create(/*num_slots=*/2, {{}}, IncrementStep(&steps)),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(DecodeSchedulerTest, MergesSequencesIntoOneBatch) {
+  std::vector<std::vector<int>> steps;
+  ASSERT_OK_AND_ASSIGN(auto scheduler,
+                       DecodeScheduler::Create(/*num_slots=*/3, {},
+                                               IncrementStep(&steps)));
+  Sequence first, second;
+  ASSERT_OK_AND_ASSIGN(int slot_0,
+                       scheduler->Join(/*last_token_id=*/10,
+                                       /*max_num_tokens=*/2, first.OnToken(),
+                                       first.OnDone()));
+  ASSERT_OK_AND_ASSIGN(int slot_1,
+                       scheduler->Join(/*last_token_id=*/20,
+                                       /*max_num_tokens=*/3, second.OnToken(),
+                                       second.OnDone()));
+  EXPECT_EQ(slot_0, 0);
+  EXPECT_EQ(slot_1, 1);
+  EXPECT_EQ(scheduler->NumActiveSlots(), 2);
+
+  EXPECT_OK(scheduler->RunUntilIdle());
+  // The free slot is fed the padding token, and the first sequence leaves the
+  // batch after its budget of 2 tokens.
+  EXPECT_THAT(steps, ElementsAre(ElementsAre(10, 20, 0), ElementsAre(11, 21, 0),
+                                 ElementsAre(0, 22, 0)));
+  EXPECT_THAT(first.tokens, ElementsAre(11, 12));
+  EXPECT_THAT(second.tokens, ElementsAre(21, 22, 23));
+  EXPECT_OK(first.status.value());
+  EXPECT_OK(second.status.value());
+  EXPECT_EQ(scheduler->NumActiveSlots(), 0);
+}
+
+TEST(DecodeSchedulerTest, StopSequenceIsNotDelivered) {
+  std::vector<std::vector<int>> steps;
+  ASSERT_OK_AND_ASSIGN(auto scheduler,
+                       DecodeScheduler::Create(/*num_slots=*/2, {{3, 4}},
+                                               IncrementStep(&steps)));
+  Sequence sequence;
+  ASSERT_OK(scheduler->Join(/*last_token_id=*/0, /*max_num_tokens=*/10,
+                            sequence.OnToken(), sequence.OnDone()));
+  EXPECT_OK(scheduler->RunUntilIdle());
+  EXPECT_EQ(steps.size(), 4);
+  EXPECT_THAT(sequence.tokens, ElementsAre(1, 2));
+  EXPECT_OK(sequence.status.value());
+}
+
+TEST(DecodeSchedulerTest, JoinAndLeaveAtTokenBoundaries) {
+  std::vector<std::vector<int>> steps;
+  ASSERT_OK_AND_ASSIGN(auto scheduler,
+                       DecodeScheduler::Create(/*num_slots=*/1, {},
+                                               IncrementStep(&steps)));
+  Sequence first, second;
+  ASSERT_OK_AND_ASSIGN(int slot,
+                       scheduler->Join(/*last_token_id=*/5,
+                                       /*max_num_tokens=*/10, first.OnToken(),
+                                       first.OnDone()));
+  EXPECT_THAT(scheduler->Join(/*last_token_id=*/7, /*max_num_tokens=*/1,
+                              second.OnToken(), second.OnDone()),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+  EXPECT_OK(scheduler->Step());
+  EXPECT_OK(scheduler->Leave(slot));
+  EXPECT_FALSE(scheduler->IsActive(slot));
+  EXPECT_THAT(scheduler->Leave(slot),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_FALSE(first.status.has_value());
+
+  // The freed slot is taken over by the next sequence.
+  ASSERT_OK_AND_ASSIGN(
+      slot, scheduler->Join(/*last_token_id=*/7, /*max_num_tokens=*/1,
+                            second.OnToken(), second.OnDone()));
+  EXPECT_EQ(slot, 0);
+  EXPECT_OK(scheduler->RunUntilIdle());
+  EXPECT_THAT(first.tokens, ElementsAre(6));
+  EXPECT_THAT(second.tokens, ElementsAre(8));
+}
+
+TEST(DecodeSchedulerTest, StepFailureFinishesActiveSequences) {
+  ASSERT_OK_AND_ASSIGN(
+      auto scheduler,
+      DecodeScheduler::Create(
+          /*num_slots=*/2, {},
+          [](absl::Span<const int> input_ids, absl::Span<int> output_ids) {
+            return absl::InternalError("Decode failed.");
+          }));
+  Sequence sequence;
+  ASSERT_OK(scheduler->Join(/*last_token_id=*/0, /*max_num_tokens=*/10,
+                            sequence.OnToken(), sequence.OnDone()));
+  EXPECT_THAT(scheduler->Step(), StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(sequence.status.value(), StatusIs(absl::StatusCode::kInternal));
+  EXPECT_EQ(scheduler->NumActiveSlots(), 0);
+}
+
+// A prefill function that records the prefilled chunks of every slot.
+DecodeScheduler::PrefillFunction RecordPrefill(
+    std::vector<std::pair<int, std::vector<int>>>* chunks) {
+  return [chunks](int slot, absl::Span<const int> input_ids) {
+    chunks->emplace_back(slot,
+                         std::vector<int>(input_ids.begin(), input_ids.end()));
+    return absl::OkStatus();
+  };
+}
+
+TEST(DecodeSchedulerTest, ChunkedPrefillInterleavesWithDecode) {
+  std::vector<std::vector<int>> steps;
+  std::vector<std::pair<int, std::vector<int>>> chunks;
+  ASSERT_OK_AND_ASSIGN(
+      auto scheduler,
+      DecodeScheduler::Create(/*num_slots=*/2, {}, IncrementStep(&steps),
+                              RecordPrefill(&chunks),
+                              /*max_prefill_tokens_per_step=*/2));
+  Sequence decoding, prefilling;
+  ASSERT_OK(scheduler->Join(/*last_token_id=*/10, /*max_num_tokens=*/4,
+                            decoding.OnToken(), decoding.OnDone()));
+  ASSERT_OK_AND_ASSIGN(
+      int slot, scheduler->JoinWithPrefill({1, 2, 3, 4, 5},
+                                           /*max_num_tokens=*/2,
+                                           prefilling.OnToken(),
+                                           prefilling.OnDone()));
+  EXPECT_TRUE(scheduler->IsPrefilling(slot));
+
+  EXPECT_OK(scheduler->RunUntilIdle());
+  // The prompt is prefilled 2 tokens per step while the other slot keeps
+  // decoding, and decoding starts from the last prompt token.
+  EXPECT_THAT(chunks, ElementsAre(std::make_pair(1, std::vector<int>{1, 2}),
+                                  std::make_pair(1, std::vector<int>{3, 4}),
+                                  std::make_pair(1, std::vector<int>{5})));
+  EXPECT_THAT(steps, ElementsAre(ElementsAre(10, 0), ElementsAre(11, 0),
+                                 ElementsAre(12, 0), ElementsAre(13, 5),
+                                 ElementsAre(0, 6)));
+  EXPECT_THAT(decoding.tokens, ElementsAre(11, 12, 13, 14));
+  EXPECT_THAT(prefilling.tokens, ElementsAre(6, 7));
+  EXPECT_OK(prefilling.status.value());
+}
+
+TEST(DecodeSchedulerTest, PrefillFailureFinishesOnlyItsSequence) {
+  std::vector<std::vector<int>> steps;
+  ASSERT_OK_AND_ASSIGN(
+      auto scheduler,
+      DecodeScheduler::Create(
+          /*num_slots=*/2, {}, IncrementStep(&steps),
+          [](int slot, absl::Span<const int> input_ids) {
+            return absl::InternalError("Prefill failed.");
+          },
+          /*max_prefill_tokens_per_step=*/4));
+  Sequence decoding, prefilling;
+  ASSERT_OK(scheduler->Join(/*last_token_id=*/10, /*max_num_tokens=*/1,
+                            decoding.OnToken(), decoding.OnDone()));
+  ASSERT_OK(scheduler->JoinWithPrefill({1, 2}, /*max_num_tokens=*/1,
+                                       prefilling.OnToken(),
+                                       prefilling.OnDone()));
+  EXPECT_OK(scheduler->Step());
+  EXPECT_THAT(prefilling.status.value(),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(decoding.tokens, ElementsAre(11));
+  EXPECT_OK(decoding.status.value());
+  EXPECT_EQ(scheduler->NumActiveSlots(), 0);
+}
+
+TEST(DecodeSchedulerTest, JoinWithPrefillRequiresPrefillFunction) {
+  std::vector<std::vector<int>> steps;
+  ASSERT_OK_AND_ASSIGN(auto scheduler,
+                       DecodeScheduler::Create(/*num_slots=*/1, {},
+                                               IncrementStep(&steps)));
+  EXPECT_THAT(scheduler->JoinWithPrefill({1}, /*max_num_tokens=*/1, nullptr,
+                                         nullptr),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(DecodeScheduler::Create(/*num_slots=*/1, {},
+                                      IncrementStep(&steps),
+                                      RecordPrefill(nullptr),
+                                      /*max_prefill_tokens_per_step=*/0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
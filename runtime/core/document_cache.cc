@@ -0,0 +1,63 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/document_cache.h"
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<DocumentCache>> DocumentCache::Create(
+    size_t max_size_in_bytes) {
+  if (max_size_in_bytes == 0) {
+    return absl::InvalidArgumentError(
+        "The document cache budget must be positive.");
+  }
+  return absl::WrapUnique(new DocumentCache(max_size_in_bytes));
+}
+
+std::shared_ptr<const DocumentCache::Segment> DocumentCache::Lookup(
+    absl::Span<const int> prefix_token_ids, absl::Span<const int> token_ids) {
+  const std::shared_ptr<const Segment>* segment = cache_.Lookup(
+      Key(std::vector<int>(prefix_token_ids.begin(), prefix_token_ids.end()),
+          std::vector<int>(token_ids.begin(), token_ids.end())));
+  return segment == nullptr ? nullptr : *segment;
+}
+
+void DocumentCache::Insert(absl::Span<const int> prefix_token_ids,
+                           absl::Span<const int> token_ids,
+                           std::shared_ptr<const Segment> segment) {
+  size_t size_in_bytes =
+      (prefix_token_ids.size() + token_ids.size()) * sizeof(int);
+  for (const auto& [name, contents] : segment->kv_cache) {
+    size_in_bytes += contents.size();
+  }
+  cache_.Insert(
+      Key(std::vector<int>(prefix_token_ids.begin(), prefix_token_ids.end()),
+          std::vector<int>(token_ids.begin(), token_ids.end())),
+      std::move(segment), size_in_bytes);
+}
+
+void DocumentCache::Clear() { cache_.Clear(); }
+
+}  // namespace litert::lm
@@ -0,0 +1,91 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DOCUMENT_CACHE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DOCUMENT_CACHE_H_
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/util/lru_cache.h"
+
+namespace litert::lm {
+
+// An LRU cache of the kv-cache segments of documents, e.g. the retrieved
+// documents of RAG prompts, each prefilled on its own right after a shared
+// prefix. The segments are keyed by the token ids of the prefix and of the
+// document, such that a document recurring in another combination of
+// documents is copied into the kv-cache instead of being prefilled again, see
+// PrefillDocuments().
+//
+// The cache is bounded by the total size of the stored segments. The least
+// recently used entries are evicted first when a new entry does not fit.
+//
+// The class is not thread-safe. The engine only accesses it from its worker
+// thread.
+class DocumentCache {
+ public:
+  // The kv-cache of the token positions of one document, keyed by the
+  // kv-cache tensor name, with each tensor in the layout of the executor but
+  // holding only `num_tokens` positions.
+  struct Segment {
+    int num_tokens = 0;
+    ExecutorCheckpoint::KvCacheData kv_cache;
+  };
+
+  // Creates a DocumentCache that holds at most `max_size_in_bytes` of
+  // segments.
+  static absl::StatusOr<std::unique_ptr<DocumentCache>> Create(
+      size_t max_size_in_bytes);
+
+  // Returns the segment of `token_ids` prefilled after `prefix_token_ids`, or
+  // nullptr if there is none. The matched entry becomes the most recently
+  // used one. Every call is counted as either a hit or a miss.
+  std::shared_ptr<const Segment> Lookup(absl::Span<const int> prefix_token_ids,
+                                        absl::Span<const int> token_ids);
+
+  // Stores the segment of `token_ids` prefilled after `prefix_token_ids`,
+  // replacing any existing entry for the same token ids. Entries larger than
+  // the whole budget are dropped.
+  void Insert(absl::Span<const int> prefix_token_ids,
+              absl::Span<const int> token_ids,
+              std::shared_ptr<const Segment> segment);
+
+  // Removes all the entries. The hit and miss counters are kept.
+  void Clear();
+
+  int NumEntries() const { return cache_.NumEntries(); }
+  size_t SizeInBytes() const { return cache_.SizeInBytes(); }
+  size_t MaxSizeInBytes() const { return cache_.MaxSizeInBytes(); }
+  int NumHits() const { return cache_.NumHits(); }
+  int NumMisses() const { return cache_.NumMisses(); }
+
+ private:
+  // The prefix and the document token ids of a segment.
+  using Key = std::pair<std::vector<int>, std::vector<int>>;
+
+  explicit DocumentCache(size_t max_size_in_bytes)
+      : cache_(max_size_in_bytes) {}
+
+  LruCache<Key, std::shared_ptr<const Segment>> cache_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_DOCUMENT_CACHE_H_
@@ -0,0 +1,105 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/document_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+// Creates a segment of `num_tokens` tokens whose kv-cache holds
+// `size_in_bytes` bytes.
+std::shared_ptr<const DocumentCache::Segment> CreateSegment(
+    int num_tokens, size_t size_in_bytes) {
+  auto segment = std::make_shared<DocumentCache::Segment>();
+  segment->num_tokens = num_tokens;
+  segment->kv_cache["kv_cache_k_0"] = std::vector<uint8_t>(size_in_bytes);
+  return segment;
+}
+
+TEST(DocumentCacheTest, CreateRejectsZeroBudget) {
+  EXPECT_THAT(DocumentCache::Create(/*max_size_in_bytes=*/0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(DocumentCacheTest, LookupMatchesPrefixAndDocument) {
+  ASSERT_OK_AND_ASSIGN(auto cache, DocumentCache::Create(1024));
+  cache->Insert({1}, {2, 3}, CreateSegment(2, 16));
+  cache->Insert({1}, {4}, CreateSegment(1, 16));
+  EXPECT_EQ(cache->NumEntries(), 2);
+
+  auto segment = cache->Lookup({1}, {2, 3});
+  ASSERT_NE(segment, nullptr);
+  EXPECT_EQ(segment->num_tokens, 2);
+  EXPECT_NE(cache->Lookup({1}, {4}), nullptr);
+
+  // The same ids split differently between the prefix and the document, or
+  // after another prefix, are other entries.
+  EXPECT_EQ(cache->Lookup({1, 2}, {3}), nullptr);
+  EXPECT_EQ(cache->Lookup({5}, {2, 3}), nullptr);
+  EXPECT_EQ(cache->Lookup({1}, {2}), nullptr);
+  EXPECT_EQ(cache->NumHits(), 2);
+  EXPECT_EQ(cache->NumMisses(), 3);
+}
+
+TEST(DocumentCacheTest, InsertEvictsLeastRecentlyUsed) {
+  // Each entry takes 100 bytes of kv-cache plus the token ids.
+  ASSERT_OK_AND_ASSIGN(auto cache, DocumentCache::Create(250));
+  cache->Insert({1}, {2}, CreateSegment(1, 100));
+  cache->Insert({1}, {3}, CreateSegment(1, 100));
+  EXPECT_EQ(cache->SizeInBytes(), 2 * (100 + 2 * sizeof(int)));
+
+  // Touch {2} so that {3} becomes the least recently used entry.
+  EXPECT_NE(cache->Lookup({1}, {2}), nullptr);
+  cache->Insert({1}, {4}, CreateSegment(1, 100));
+  EXPECT_EQ(cache->NumEntries(), 2);
+  EXPECT_NE(cache->Lookup({1}, {2}), nullptr);
+  EXPECT_EQ(cache->Lookup({1}, {3}), nullptr);
+  EXPECT_NE(cache->Lookup({1}, {4}), nullptr);
+  EXPECT_LE(cache->SizeInBytes(), cache->MaxSizeInBytes());
+}
+
+TEST(DocumentCacheTest, InsertDropsEntryLargerThanBudget) {
+  ASSERT_OK_AND_ASSIGN(auto cache, DocumentCache::Create(64));
+  cache->Insert({1}, {2}, CreateSegment(1, 128));
+  EXPECT_EQ(cache->NumEntries(), 0);
+  EXPECT_EQ(cache->SizeInBytes(), 0);
+}
+
+TEST(DocumentCacheTest, InsertReplacesSameTokenIds) {
+  ASSERT_OK_AND_ASSIGN(auto cache, DocumentCache::Create(1024));
+  cache->Insert({1}, {2}, CreateSegment(1, 16));
+  cache->Insert({1}, {2}, CreateSegment(1, 32));
+  EXPECT_EQ(cache->NumEntries(), 1);
+  EXPECT_EQ(cache->SizeInBytes(), 32 + 2 * sizeof(int));
+
+  cache->Clear();
+  EXPECT_EQ(cache->NumEntries(), 0);
+  EXPECT_EQ(cache->SizeInBytes(), 0);
+  EXPECT_EQ(cache->Lookup({1}, {2}), nullptr);
+}
+
+}  // namespace
+}  // namespace litert::lm
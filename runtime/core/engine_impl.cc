@@ -12,43 +12,81 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cstddef>
 // TODO(b/417209286): Remove this once the model assets are stored in the
 // litertlm file format.
 #include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <ios>
 #include <memory>
 #include <optional>
+#include <sstream>
 #include <string>
+#include <system_error>
+#include <thread>  // NOLINT: Required for hardware_concurrency.
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "absl/log/absl_check.h"  // from @com_google_absl
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/log/check.h"  // from @com_google_absl
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
 #include "absl/log/log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "runtime/components/model_resources.h"
+#include "runtime/components/token_constraint.h"
+#include "runtime/core/backend_selection.h"
+#include "runtime/core/prefix_cache.h"
+#include "runtime/core/response_cache.h"
 #include "runtime/core/session_factory.h"
+#include "runtime/core/session_placement.h"
+#include "runtime/core/session_resource_pool.h"
 #include "runtime/engine/engine.h"
+#include "runtime/engine/engine_metrics.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
 #include "runtime/executor/executor_settings_base.h"
 #include "runtime/executor/litert_compiled_model_executor_utils.h"
 #include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/executor/llm_executor_settings.h"
 #include "runtime/executor/llm_litert_compiled_model_executor.h"
 #include "runtime/executor/llm_litert_npu_compiled_model_executor.h"
+#include "runtime/executor/split_llm_executor.h"
+#include "runtime/framework/cpu_topology.h"
+#include "runtime/framework/fair_task_scheduler.h"
+#include "runtime/framework/thread_options.h"
 #include "runtime/framework/threadpool.h"
 #include "runtime/proto/llm_metadata.pb.h"
 #include "runtime/proto/sampler_params.pb.h"
+#include "runtime/util/device_fingerprint.h"
 #include "runtime/util/file_format_util.h"
+#include "runtime/util/init_phase.h"
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/memory_usage.h"
+#include "runtime/util/shared_resource_registry.h"
 #include "runtime/util/status_macros.h"  // NOLINT
+#include "schema/core/litertlm_read.h"
+#include "schema/core/litertlm_utils.h"
 
 namespace litert::lm {
 namespace {
 
+// The number of distinct regexes and JSON schemas whose compiled constraints
+// are kept for the sessions of an engine.
+constexpr size_t kMaxNumCachedConstraints = 16;
+
 // Builds the LiteRT compiled model executor.
 absl::StatusOr<std::unique_ptr<LlmExecutor>> BuildLitertCompiledModelExecutor(
     LlmExecutorSettings executor_settings, ModelResources& model_resources) {
@@ -61,126 +99,1027 @@ absl::StatusOr<std::unique_ptr<LlmExecutor>> BuildLitertCompiledModelExecutor(
                                                 model_resources);
 }
 
+// Returns whether the executor of `backend` is a LiteRT compiled model
+// executor, which compiles the models read ahead by the engine.
+bool IsCompiledModelBackend(Backend backend) {
+  return backend == Backend::CPU || backend == Backend::GPU;
+}
+
+// Builds the executor of `executor_settings` from the loaded
+// `model_resources`.
+absl::StatusOr<std::unique_ptr<LlmExecutor>> BuildExecutor(
+    const LlmExecutorSettings& executor_settings,
+    ModelResources& model_resources) {
+  if (IsCompiledModelBackend(executor_settings.GetBackend())) {
+    return BuildLitertCompiledModelExecutor(executor_settings,
+                                            model_resources);
+  }
+  std::string model_path(
+      executor_settings.GetModelAssets().GetPath().value_or(""));
+  std::filesystem::path path(model_path);
+  RET_CHECK(std::filesystem::exists(path))
+      << "Model file " << model_path << " does not exist.";
+  return LlmLiteRtNpuCompiledModelExecutor::Create(
+      executor_settings, model_resources, path.parent_path().string());
+}
+
+// The number of decode steps of the short run each backend candidate of
+// Backend::AUTO is timed on, after the prefill of its prefill signatures.
+constexpr int kBackendCalibrationDecodeSteps = 8;
+
+// Returns the time `executor_settings` take to run a short prefill and decode
+// on their backend, once their executor is built and warm.
+absl::StatusOr<absl::Duration> CalibrateBackend(
+    const LlmExecutorSettings& executor_settings,
+    ModelResources& model_resources) {
+  ASSIGN_OR_RETURN(std::unique_ptr<LlmExecutor> executor,
+                   BuildExecutor(executor_settings, model_resources));
+  // The first run compiles the kernels and uploads the weights, which the
+  // next runs do not pay for.
+  RETURN_IF_ERROR(executor->Warmup(kBackendCalibrationDecodeSteps));
+  const absl::Time start = absl::Now();
+  RETURN_IF_ERROR(executor->Warmup(kBackendCalibrationDecodeSteps));
+  return absl::Now() - start;
+}
+
+// Returns the backend of Backend::AUTO for `executor_settings`, the one
+// recorded for the device next to the weight cache if any, or the fastest
+// candidate otherwise, which is then recorded.
+absl::StatusOr<Backend> SelectAutoBackend(
+    const LlmExecutorSettings& executor_settings,
+    ModelResources& model_resources) {
+  const std::string device_fingerprint = GetDeviceFingerprint();
+  // The selection is not recorded if there is no weight cache path, e.g. the
+  // cache is disabled or given as a file descriptor.
+  std::string selection_file_path;
+  auto selection_file =
+      executor_settings.GetWeightCacheFile(".backend_selection");
+  if (selection_file.ok() &&
+      std::holds_alternative<std::string>(*selection_file)) {
+    selection_file_path = std::get<std::string>(*selection_file);
+  }
+  std::string selections;
+  if (!selection_file_path.empty()) {
+    std::ifstream file(selection_file_path);
+    if (file.is_open()) {
+      std::stringstream contents;
+      contents << file.rdbuf();
+      selections = contents.str();
+      absl::StatusOr<Backend> backend =
+          ParseBackendSelection(selections, device_fingerprint);
+      if (backend.ok()) {
+        ABSL_LOG(INFO) << "Backend " << *backend << " is selected for "
+                       << device_fingerprint;
+        return backend;
+      }
+    }
+  }
+
+  // The candidates run with the number of tokens the engine defaults to.
+  LlmExecutorSettings candidate_settings = executor_settings;
+  if (candidate_settings.GetMaxNumTokens() == 0) {
+    int max_num_tokens = 4096;
+    if (auto llm_metadata = model_resources.GetLlmMetadata();
+        llm_metadata.ok() && (*llm_metadata)->max_num_tokens() > 0) {
+      max_num_tokens = (*llm_metadata)->max_num_tokens();
+    }
+    candidate_settings.SetMaxNumTokens(max_num_tokens);
+  }
+  ASSIGN_OR_RETURN(
+      Backend backend,
+      SelectFastestBackend(
+          GetAutoBackendCandidates(),
+          [&](Backend candidate) -> absl::StatusOr<absl::Duration> {
+            LlmExecutorSettings settings = candidate_settings;
+            RETURN_IF_ERROR(settings.ResolveBackend(candidate));
+            return CalibrateBackend(settings, model_resources);
+          }));
+  ABSL_LOG(INFO) << "Backend " << backend << " is the fastest on "
+                 << device_fingerprint;
+  if (!selection_file_path.empty()) {
+    std::ofstream file(selection_file_path, std::ios::trunc);
+    file << UpdateBackendSelection(selections, device_fingerprint, backend);
+    if (!file.good()) {
+      ABSL_LOG(WARNING) << "Failed to write backend selection file "
+                        << selection_file_path;
+    }
+  }
+  return backend;
+}
+
+// An executor of an engine, with the state its sessions only access from its
+// worker thread.
+struct ExecutorResources {
+  Backend backend = Backend::UNSPECIFIED;
+  std::unique_ptr<LlmExecutor> executor;
+  // Whether the executor has been warmed up, which uploads its weights on
+  // GPU.
+  bool weights_uploaded = false;
+  // Prefix cache shared by the sessions of the executor, or nullptr if
+  // disabled.
+  std::unique_ptr<PrefixCache> prefix_cache;
+  // Response cache shared by the sessions of the executor, or nullptr if
+  // disabled.
+  std::unique_ptr<ResponseCache> response_cache;
+  // Shares the worker thread among the sessions by their scheduling weights.
+  std::unique_ptr<FairTaskScheduler> task_scheduler;
+  // Thread pool to execute the works. Declared last so that it is destroyed,
+  // and its pending works done, before the executor and the scheduler.
+  std::unique_ptr<ThreadPool> worker_thread_pool;
+};
+
+// The resources an engine builds from its model, shared by all the engines of
+// the same model file and executor settings. Their sessions run on the same
+// worker threads, as the sessions of a single engine do.
+struct EngineResources {
+  std::unique_ptr<ModelResources> model_resources;
+  // Constraints of the constrained decoding, compiled once for all sessions.
+  std::unique_ptr<TokenConstraintCache> constraint_cache;
+  // Thread pool to sample the output candidates of the sessions in parallel,
+  // apart from the worker threads which the sampling is called from.
+  std::unique_ptr<ThreadPool> sampler_thread_pool;
+  // The samplers, stop detectors and prompt affixes of the destroyed sessions,
+  // recycled by the next sessions of the same config.
+  std::unique_ptr<SessionResourcePool> session_resource_pool =
+      std::make_unique<SessionResourcePool>();
+  // The executors the sessions are placed on, the main one first, then those
+  // of the pool. Declared last so that their pending works are done before
+  // the rest is destroyed.
+  std::vector<ExecutorResources> executors;
+};
+
+// Runs the nodes of the loading graph of an engine, each timed as an init
+// phase of the benchmark info if any, along with the InitPhaseScopes of its
+// steps, and reported to the loading observer if any. The nodes submitted
+// together run concurrently on the loader threads, so they must build
+// disjoint resources. The pending nodes are waited for when the graph is
+// destroyed.
+class EngineLoadingGraph : public InitPhaseSink {
+ public:
+  // The number of nodes that run concurrently at most.
+  static constexpr int kMaxNumConcurrentNodes = 3;
+
+  EngineLoadingGraph(BenchmarkInfo* benchmark_info,
+                     Engine::LoadingObserver* observer)
+      : benchmark_info_(benchmark_info),
+        observer_(observer),
+        loader_thread_pool_(/*name_prefix=*/"loader",
+                            /*max_num_threads=*/kMaxNumConcurrentNodes) {}
+
+  // Runs `node` on a loader thread. The returned future holds its status.
+  absl::StatusOr<TaskFuture<absl::Status>> Submit(
+      std::string name, absl::AnyInvocable<absl::Status() &&> node) {
+    return loader_thread_pool_.Submit(
+        [this, name = std::move(name), node = std::move(node)]() mutable {
+          return RunTimed(name, std::move(node));
+        });
+  }
+
+  // Runs `node` on the calling thread.
+  absl::Status Run(const std::string& name,
+                   absl::AnyInvocable<absl::Status() &&> node) {
+    return RunTimed(name, std::move(node));
+  }
+
+ private:
+  absl::Status RunTimed(const std::string& name,
+                        absl::AnyInvocable<absl::Status() &&> node) {
+    if (observer_ != nullptr) {
+      absl::MutexLock lock(&benchmark_info_mutex_);
+      observer_->OnProgress(name);
+    }
+    ScopedInitPhaseSink sink(benchmark_info_ != nullptr ? this : nullptr);
+    InitPhaseScope phase(name);
+    return std::move(node)();
+  }
+
+  void OnInitPhase(absl::string_view name, absl::Duration duration) override {
+    absl::MutexLock lock(&benchmark_info_mutex_);
+    benchmark_info_->AddInitPhase(std::string(name), duration);
+  }
+
+  // The nodes time and report their phases from several threads.
+  absl::Mutex benchmark_info_mutex_;
+  BenchmarkInfo* const benchmark_info_
+      ABSL_PT_GUARDED_BY(benchmark_info_mutex_);
+  Engine::LoadingObserver* const observer_
+      ABSL_PT_GUARDED_BY(benchmark_info_mutex_);
+  ThreadPool loader_thread_pool_;
+};
+
+// Records the fraction of the model file in the page cache before it is read,
+// i.e. whether the engine is cold started. Best effort, as some platforms do
+// not tell.
+void RecordModelPageCacheResidency(const ModelAssets& model_assets,
+                                   BenchmarkInfo& benchmark_info) {
+  auto scoped_file = model_assets.GetOrCreateScopedFile();
+  if (!scoped_file.ok()) {
+    return;
+  }
+  // Mapped with no read ahead, such that the mapping reads nothing in.
+  auto mapping = MemoryMappedFile::Create((*scoped_file)->file(), 0, 0, "",
+                                          MemoryMappedFile::Advice::kNormal);
+  if (!mapping.ok()) {
+    return;
+  }
+  auto resident_fraction = (*mapping)->GetResidentFraction();
+  if (!resident_fraction.ok()) {
+    ABSL_LOG(INFO) << "The model page cache residency is unknown: "
+                   << resident_fraction.status();
+    return;
+  }
+  benchmark_info.SetModelPageCacheResidency(*resident_fraction);
+}
+
+SharedResourceRegistry<EngineResources>& GetEngineResourcesRegistry() {
+  static auto* registry = new SharedResourceRegistry<EngineResources>();
+  return *registry;
+}
+
+// Returns the key identifying the model file of `executor_settings`, or an
+// empty string if the model is not given by a path.
+std::string GetModelFileKey(const LlmExecutorSettings& executor_settings) {
+  auto model_path = executor_settings.GetModelAssets().GetPath();
+  if (!model_path.ok()) {
+    return "";
+  }
+  // A LiteRT-LM file recording the content hashes of its sections is
+  // identified by them, read from its header only, so the same model is
+  // recognized wherever it is copied.
+  schema::LitertlmHeader header;
+  if (schema::ReadHeaderFromLiteRTLM(std::string(*model_path), &header)
+          .ok() &&
+      header.metadata != nullptr) {
+    if (std::optional<std::string> content_key =
+            schema::GetContentKey(schema::BuildSectionIndex(*header.metadata));
+        content_key.has_value()) {
+      return absl::StrCat("litertlm_content:", *content_key);
+    }
+  }
+  // Otherwise, the model file is identified by its path, size and
+  // modification time, so a file replaced in place is not mistaken for the
+  // loaded one.
+  std::error_code error;
+  const std::filesystem::path path(std::string(*model_path));
+  const auto file_size = std::filesystem::file_size(path, error);
+  if (error) {
+    return "";
+  }
+  const auto write_time = std::filesystem::last_write_time(path, error);
+  if (error) {
+    return "";
+  }
+  return absl::StrCat(*model_path, "|", file_size, "|",
+                      write_time.time_since_epoch().count());
+}
+
+// Persists `prefix_cache` to `directory`, keyed by the model file and the
+// executor settings the checkpoints fit, unless the model file is unknown.
+absl::Status MaybePersistPrefixCache(
+    absl::string_view directory, const LlmExecutorSettings& executor_settings,
+    PrefixCache& prefix_cache) {
+  const std::string model_file_key = GetModelFileKey(executor_settings);
+  if (model_file_key.empty()) {
+    ABSL_LOG(WARNING) << "The model is not given by a path, so the prefix "
+                         "cache is not persisted.";
+    return absl::OkStatus();
+  }
+  std::stringstream namespace_key;
+  namespace_key << model_file_key << "|" << executor_settings.GetBackend()
+                << "|" << executor_settings.GetMaxNumTokens();
+  return prefix_cache.EnablePersistence(directory, namespace_key.str());
+}
+
+// Returns the key identifying the resources built for `engine_settings`, or an
+// empty string if the model is not given by a path and cannot be shared.
+std::string GetEngineResourcesKey(const EngineSettings& engine_settings) {
+  const LlmExecutorSettings& executor_settings =
+      engine_settings.GetMainExecutorSettings();
+  const std::string model_file_key = GetModelFileKey(executor_settings);
+  if (model_file_key.empty()) {
+    return "";
+  }
+  std::stringstream key;
+  key << model_file_key << "|" << executor_settings
+      << "|prefix_cache_budget_bytes: "
+      << engine_settings.GetPrefixCacheBudgetBytes().value_or(0)
+      << "|prefix_cache_directory: "
+      << engine_settings.GetPrefixCacheDirectory().value_or("")
+      << "|response_cache_budget_bytes: "
+      << engine_settings.GetResponseCacheBudgetBytes().value_or(0);
+  for (const auto& pool_executor_settings :
+       engine_settings.GetPoolExecutorSettings()) {
+    key << "|pool_executor: " << pool_executor_settings;
+  }
+  if (engine_settings.GetSplitPrefillExecutorSettings().has_value()) {
+    key << "|split_prefill_executor: "
+        << engine_settings.GetSplitPrefillExecutorSettings().value()
+        << "|split_prefill_min_tokens: "
+        << engine_settings.GetSplitPrefillMinTokens();
+  }
+  return key.str();
+}
+
+// Builds the resources of `engine_settings` and updates the settings from the
+// model file. The loading phases are timed into `benchmark_info`, and
+// reported to `observer`, if set. The tokenizer, the metadata and the models
+// are read concurrently, and the executor is built once they are all loaded.
+absl::StatusOr<std::unique_ptr<EngineResources>> BuildEngineResources(
+    EngineSettings& engine_settings, BenchmarkInfo* benchmark_info,
+    Engine::LoadingObserver* observer) {
+  auto resources = std::make_unique<EngineResources>();
+  // Declared after the resources, such that its pending nodes are done before
+  // the resources they build are destroyed on error.
+  EngineLoadingGraph loading_graph(benchmark_info, observer);
+  auto& model_assets =
+      engine_settings.GetMutableMainExecutorSettings().GetMutableModelAssets();
+  if (benchmark_info != nullptr) {
+    RecordModelPageCacheResidency(model_assets, *benchmark_info);
+  }
+  RETURN_IF_ERROR(loading_graph.Run(
+      "Model resources initialization", [&]() -> absl::Status {
+        ASSIGN_OR_RETURN(
+            resources->model_resources,
+            BuildLiteRtCompiledModelResources(
+                model_assets, engine_settings.GetMainExecutorSettings()
+                                  .GetWeightMemoryOptions()));
+        return absl::OkStatus();
+      }));
+  for (const auto& pool_executor_settings :
+       engine_settings.GetPoolExecutorSettings()) {
+    RET_CHECK(pool_executor_settings.GetBackend() != Backend::AUTO)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Backend::AUTO is only supported by the main executor.";
+  }
+  RET_CHECK(!engine_settings.GetSplitPrefillExecutorSettings().has_value() ||
+            engine_settings.GetSplitPrefillExecutorSettings()->GetBackend() !=
+                Backend::AUTO)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Backend::AUTO is only supported by the main executor.";
+  if (engine_settings.GetMainExecutorSettings().GetBackend() ==
+      Backend::AUTO) {
+    // The backend is resolved before anything depends on it, e.g. the
+    // default sampler parameters.
+    RETURN_IF_ERROR(loading_graph.Run(
+        "Backend selection", [&]() -> absl::Status {
+          ASSIGN_OR_RETURN(
+              Backend backend,
+              SelectAutoBackend(engine_settings.GetMainExecutorSettings(),
+                                *resources->model_resources));
+          return engine_settings.GetMutableMainExecutorSettings()
+              .ResolveBackend(backend);
+        }));
+  }
+  ASSIGN_OR_RETURN(auto scoped_file, model_assets.GetOrCreateScopedFile());
+  ASSIGN_OR_RETURN(auto file_format,
+                   GetFileFormat(/*model_path=*/"", scoped_file));
+  // TODO(b/397975034): factor out the tokenizer creation logic once the
+  // model loading mechanism of the new file format is determined.
+  RET_CHECK(file_format == FileFormat::TASK ||
+            file_format == FileFormat::LITERT_LM)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Not supported file format: " << file_format;
+
+  // The nodes below each read other sections of the model file into other
+  // members of the model resources, so they may run concurrently.
+  ModelResources& model_resources = *resources->model_resources;
+  bool is_compiled_model_backend = IsCompiledModelBackend(
+      engine_settings.GetMainExecutorSettings().GetBackend());
+  for (const auto& pool_executor_settings :
+       engine_settings.GetPoolExecutorSettings()) {
+    is_compiled_model_backend |=
+        IsCompiledModelBackend(pool_executor_settings.GetBackend());
+  }
+  if (engine_settings.GetSplitPrefillExecutorSettings().has_value()) {
+    is_compiled_model_backend |= IsCompiledModelBackend(
+        engine_settings.GetSplitPrefillExecutorSettings()->GetBackend());
+  }
+  if (is_compiled_model_backend) {
+    // The weights of the main model are read in from the disk while the
+    // tokenizer and the metadata are created.
+    RETURN_IF_ERROR(loading_graph.Run("Model prefetch", [&]() {
+      model_resources.PrefetchTFLiteModel(ModelType::kTfLitePrefillDecode);
+      return absl::OkStatus();
+    }));
+  }
+  ASSIGN_OR_RETURN(auto tokenizer_loaded,
+                   loading_graph.Submit("Tokenizer initialization", [&]() {
+                     return model_resources.GetTokenizer().status();
+                   }));
+  ASSIGN_OR_RETURN(auto llm_metadata_loaded,
+                   loading_graph.Submit("LLM metadata initialization", [&]() {
+                     return model_resources.GetLlmMetadata().status();
+                   }));
+  // The models are only read ahead of the LiteRT compiled model executors,
+  // which compile them.
+  std::optional<TaskFuture<absl::Status>> models_loaded;
+  if (is_compiled_model_backend) {
+    ASSIGN_OR_RETURN(
+        models_loaded,
+        loading_graph.Submit("Model loading", [&]() -> absl::Status {
+          RETURN_IF_ERROR(
+              model_resources.GetTFLiteModel(ModelType::kTfLitePrefillDecode)
+                  .status());
+          // The embedders are optional, and only read if present.
+          model_resources.GetTFLiteModel(ModelType::kTfLiteEmbedder)
+              .status()
+              .IgnoreError();
+          model_resources.GetTFLiteModel(ModelType::kTfLitePerLayerEmbedder)
+              .status()
+              .IgnoreError();
+          return absl::OkStatus();
+        }));
+  }
+
+  RETURN_IF_ERROR(tokenizer_loaded.Get(Engine::kDefaultTimeout));
+  RETURN_IF_ERROR(llm_metadata_loaded.Get(Engine::kDefaultTimeout));
+  ASSIGN_OR_RETURN(auto* tokenizer, model_resources.GetTokenizer());
+  ASSIGN_OR_RETURN(auto llm_metadata, model_resources.GetLlmMetadata());
+  // Update and load the parameters from the model file and convert the
+  // tokens to ids.
+  RETURN_IF_ERROR(
+      engine_settings.MaybeUpdateAndValidate(*tokenizer, llm_metadata));
+  // The settings of the executors, the main one first. The executors of the
+  // pool are built from the model of the main one.
+  std::vector<LlmExecutorSettings> executor_settings = {
+      engine_settings.GetMainExecutorSettings()};
+  for (const auto& pool_executor_settings :
+       engine_settings.GetPoolExecutorSettings()) {
+    executor_settings.push_back(pool_executor_settings);
+    executor_settings.back().GetMutableModelAssets() = model_assets;
+  }
+
+  if (is_compiled_model_backend) {
+    RETURN_IF_ERROR(models_loaded->Get(Engine::kDefaultTimeout));
+  }
+  resources->executors.resize(executor_settings.size());
+  for (size_t i = 0; i < executor_settings.size(); ++i) {
+    const LlmExecutorSettings& settings = executor_settings[i];
+    ExecutorResources& executor = resources->executors[i];
+    executor.backend = settings.GetBackend();
+    RETURN_IF_ERROR(loading_graph.Run(
+        i == 0 ? "Executor initialization"
+               : absl::StrCat("Pool executor initialization: ", i),
+        [&]() -> absl::Status {
+          // Built on the NUMA node of the executor, if any, such that its
+          // buffers and the threads of its delegate are allocated and pinned
+          // there.
+          std::unique_ptr<ScopedNumaNodeBinding> numa_node_binding;
+          if (auto cpu_config = settings.GetBackendConfig<CpuConfig>();
+              cpu_config.ok() && cpu_config->numa_node >= 0) {
+            ASSIGN_OR_RETURN(
+                numa_node_binding,
+                ScopedNumaNodeBinding::Create(cpu_config->numa_node));
+          }
+          ASSIGN_OR_RETURN(executor.executor,
+                           BuildExecutor(settings, model_resources));
+          return absl::OkStatus();
+        }));
+    if (IsCompiledModelBackend(executor.backend)) {
+      // The adapters shipped with the model are selected per session through
+      // SessionConfig::SetLoraAdapterName().
+      for (absl::string_view lora_adapter :
+           resources->model_resources->GetLoraAdapters()) {
+        RETURN_IF_ERROR(executor.executor->LoadLoraAdapter(lora_adapter));
+      }
+    }
+    if (i == 0 &&
+        engine_settings.GetSplitPrefillExecutorSettings().has_value()) {
+      // The long prompts of the main executor are prefilled on another one,
+      // which hands their kv-cache over to it for the decode.
+      LlmExecutorSettings prefill_settings =
+          engine_settings.GetSplitPrefillExecutorSettings().value();
+      prefill_settings.GetMutableModelAssets() = model_assets;
+      std::unique_ptr<LlmExecutor> prefill_executor;
+      RETURN_IF_ERROR(loading_graph.Run(
+          "Split prefill executor initialization", [&]() -> absl::Status {
+            ASSIGN_OR_RETURN(prefill_executor,
+                             BuildExecutor(prefill_settings, model_resources));
+            return absl::OkStatus();
+          }));
+      ASSIGN_OR_RETURN(
+          executor.executor,
+          SplitLlmExecutor::Create(std::move(prefill_executor),
+                                   std::move(executor.executor),
+                                   engine_settings.GetSplitPrefillMinTokens()));
+    }
+
+    if (engine_settings.GetPrefixCacheBudgetBytes().has_value()) {
+      // Only the LiteRT compiled model executor supports saving and restoring
+      // its state, so each executor has a prefix cache of its own.
+      if (executor.backend == Backend::NPU) {
+        ABSL_LOG(WARNING) << "Prefix cache is not supported on NPU, ignored.";
+      } else {
+        const size_t budget_bytes =
+            engine_settings.GetPrefixCacheBudgetBytes().value();
+        ASSIGN_OR_RETURN(executor.prefix_cache,
+                         PrefixCache::Create(budget_bytes));
+        if (engine_settings.GetPrefixCacheDirectory().has_value()) {
+          RETURN_IF_ERROR(MaybePersistPrefixCache(
+              engine_settings.GetPrefixCacheDirectory().value(), settings,
+              *executor.prefix_cache));
+        }
+      }
+    }
+
+    if (engine_settings.GetResponseCacheBudgetBytes().has_value()) {
+      // The responses depend on the numerics of the backend, so each executor
+      // has a response cache of its own.
+      const size_t budget_bytes =
+          engine_settings.GetResponseCacheBudgetBytes().value();
+      ASSIGN_OR_RETURN(executor.response_cache,
+                       ResponseCache::Create(budget_bytes));
+    }
+
+    // Creating the thread pool of a single thread to execute the works. It
+    // runs the decode loop, so it is kept on the NUMA node of the executor or
+    // on the performance cores when asked.
+    ThreadOptions worker_thread_options;
+    if (auto cpu_config = settings.GetBackendConfig<CpuConfig>();
+        cpu_config.ok()) {
+      worker_thread_options.set_prefer_performance_cores(
+          cpu_config->prefer_performance_cores);
+      worker_thread_options.set_numa_node(cpu_config->numa_node);
+    }
+    executor.worker_thread_pool = std::make_unique<ThreadPool>(
+        /*name_prefix=*/i == 0 ? "engine" : absl::StrCat("engine_", i),
+        /*max_num_threads=*/1, worker_thread_options);
+    executor.task_scheduler = std::make_unique<FairTaskScheduler>(
+        executor.worker_thread_pool.get());
+    if (auto spin_duration = engine_settings.GetWorkerSpinDuration();
+        spin_duration.has_value()) {
+      executor.worker_thread_pool->SetSpinDuration(*spin_duration);
+      executor.worker_thread_pool->SetRunTasksInline(true);
+    }
+  }
+
+  resources->constraint_cache = std::make_unique<TokenConstraintCache>(
+      tokenizer, kMaxNumCachedConstraints);
+
+  // The calling thread samples one of the candidates itself, so the pool gets
+  // the rest of the cores. Its threads are only spawned once a session samples
+  // more than one candidate.
+  resources->sampler_thread_pool = std::make_unique<ThreadPool>(
+      /*name_prefix=*/"sampler",
+      /*max_num_threads=*/std::max(
+          1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+  return resources;
+}
+
 }  // namespace
 
 class EngineImpl : public Engine {
  public:
   ~EngineImpl() override {
-    ABSL_QCHECK_OK(WaitUntilDone(Engine::kDefaultTimeout));
+    // The loading is waited for first, as it may still build the resources.
+    loader_thread_pool_.reset();
+    if (resources_ != nullptr) {
+      ABSL_QCHECK_OK(WaitUntilDone(Engine::kDefaultTimeout));
+    }
   }
 
   explicit EngineImpl(EngineSettings engine_settings)
-      : engine_settings_(std::move(engine_settings)) {
-    if (engine_settings_.IsBenchmarkEnabled()) {
-      benchmark_info_ = std::make_optional<BenchmarkInfo>(
-          engine_settings_.GetBenchmarkParams().value());
-      ABSL_CHECK_OK(
-          benchmark_info_->TimeInitPhaseStart("Executor initialization"));
-    }
-    auto& model_assets = engine_settings_.GetMutableMainExecutorSettings()
-                             .GetMutableModelAssets();
-
-    auto model_resources = BuildLiteRtCompiledModelResources(model_assets);
-    ABSL_CHECK_OK(model_resources);
-    litert_model_resources_ = std::move(*model_resources);
-    auto scoped_file = model_assets.GetOrCreateScopedFile();
-    ABSL_CHECK_OK(scoped_file);
-
-    auto file_format = GetFileFormat(/*model_path=*/"", *scoped_file);
-    ABSL_CHECK_OK(file_format);
-    // TODO(b/397975034): factor out the tokenizer creation logic once the
-    // model loading mechanism of the new file format is determined.
-    if (*file_format != FileFormat::TASK &&
-        *file_format != FileFormat::LITERT_LM) {
-      ABSL_LOG(FATAL) << "Not supported file format: " << *file_format;
-    }
-    auto tokenizer = litert_model_resources_->GetTokenizer();
-    ABSL_CHECK_OK(tokenizer) << tokenizer.status();
-    auto llm_metadata = litert_model_resources_->GetLlmMetadata();
-    ABSL_CHECK_OK(llm_metadata) << llm_metadata.status();
-    // Update and load the parameters from the model file and convert the
-    // tokens to ids.
-    ABSL_CHECK_OK(
-        engine_settings_.MaybeUpdateAndValidate(**tokenizer, *llm_metadata));
-
-    if ((engine_settings_.GetMainExecutorSettings().GetBackend() ==
-         Backend::CPU) ||
-        (engine_settings_.GetMainExecutorSettings().GetBackend() ==
-         Backend::GPU)) {
-      auto executor = BuildLitertCompiledModelExecutor(
-          engine_settings_.GetMainExecutorSettings(), *litert_model_resources_);
-      ABSL_QCHECK_OK(executor);
-      executor_ = std::move(*executor);
-    } else {
-      std::string model_path(engine_settings_.GetMainExecutorSettings()
-                                 .GetModelAssets()
-                                 .GetPath()
-                                 .value_or(""));
+      : engine_settings_(std::move(engine_settings)) {}
 
-      std::filesystem::path path(model_path);
-      ABSL_CHECK(std::filesystem::exists(path));
-      auto executor = LlmLiteRtNpuCompiledModelExecutor::Create(
-          engine_settings_.GetMainExecutorSettings(), *litert_model_resources_,
-          path.parent_path().string());
-      ABSL_CHECK_OK(executor);
-      executor_ = std::move(executor.value());
+  // Loads the model resources, executors and worker threads of the engine, and
+  // reports the progress to `observer` if not null. Must be called once.
+  absl::Status Load(LoadingObserver* observer) {
+    absl::Status status = LoadResources(observer);
+    {
+      absl::MutexLock lock(&load_mutex_);
+      load_status_ = status;
     }
-    if (benchmark_info_.has_value()) {
-      ABSL_CHECK_OK(
-          benchmark_info_->TimeInitPhaseEnd("Executor initialization"));
-      ABSL_CHECK_OK(
-          benchmark_info_->TimeInitPhaseStart("Tokenizer initialization"));
+    loaded_.Notify();
+    if (status.ok() && engine_settings_.GetWarmupOptions().has_value()) {
+      // The engine is usable even if the warmup fails.
+      if (absl::Status warmup_status =
+              Warmup(*engine_settings_.GetWarmupOptions());
+          !warmup_status.ok()) {
+        ABSL_LOG(WARNING) << "Failed to warm the engine up: " << warmup_status;
+      }
+    } else if (status.ok()) {
+      if (absl::Status upload_status = UploadWeights(); !upload_status.ok()) {
+        ABSL_LOG(WARNING) << "Failed to upload the weights: " << upload_status;
+      }
     }
-
-    if (benchmark_info_.has_value()) {
-      ABSL_CHECK_OK(
-          benchmark_info_->TimeInitPhaseEnd("Tokenizer initialization"));
+    if (observer != nullptr) {
+      observer->OnReady(status);
     }
+    return status;
+  }
 
-    // Creating the thread pool of a single thread to execute the works.
-    worker_thread_pool_ = std::make_unique<ThreadPool>(/*name_prefix=*/"engine",
-                                                       /*max_num_threads=*/1);
+  // Loads the engine on a thread of its own. The sessions created in the
+  // meantime wait, or are queued behind the loading.
+  absl::Status LoadAsync(LoadingObserver* observer) {
+    loader_thread_pool_ = std::make_unique<ThreadPool>(
+        /*name_prefix=*/"engine_loader", /*max_num_threads=*/1);
+    return loader_thread_pool_->Schedule(
+        [this, observer]() { Load(observer).IgnoreError(); });
   }
 
   // Method to create the Session.
   absl::StatusOr<std::unique_ptr<Session>> CreateSession(
       const SessionConfig& session_config) const override {
+    loaded_.WaitForNotification();
+    {
+      absl::MutexLock lock(&load_mutex_);
+      RETURN_IF_ERROR(load_status_);
+    }
     SessionConfig config = session_config;
     // TODO(b/418794726): Move this logics to be part of the SessionConfig
     // class.
     RETURN_IF_ERROR(config.MaybeUpdateAndValidate(engine_settings_));  // NOLINT
 
-    ABSL_CHECK(litert_model_resources_ != nullptr);
+    ABSL_CHECK(resources_ != nullptr);
     ASSIGN_OR_RETURN(auto* tokenizer,  // NOLINT
-                     litert_model_resources_->GetTokenizer());
-    return InitializeSession(executor_.get(), tokenizer, config,
-                             benchmark_info_, worker_thread_pool_.get());
+                     resources_->model_resources->GetTokenizer());
+    std::optional<BenchmarkInfo> benchmark_info = benchmark_info_;
+    if (benchmark_info.has_value() && config.GetBenchmarkParams().has_value()) {
+      benchmark_info->SetBenchmarkParams(*config.GetBenchmarkParams());
+    }
+    // The sessions created concurrently may be placed on the same load.
+    std::vector<ExecutorPlacementInfo> placement_infos;
+    for (size_t i = 0; i < resources_->executors.size(); ++i) {
+      placement_infos.push_back(
+          {.backend = resources_->executors[i].backend,
+           .num_sessions =
+               executor_metrics_recorders_[i]->GetNumActiveSessions()});
+    }
+    const size_t executor_index =
+        PlaceSession(placement_infos, config.GetPreferredBackend(),
+                     config.GetExecutorAffinityKey());
+    const ExecutorResources& executor = resources_->executors[executor_index];
+    return InitializeSession(
+        executor.executor.get(), tokenizer, config, std::move(benchmark_info),
+        executor.worker_thread_pool.get(), executor.prefix_cache.get(),
+        resources_->sampler_thread_pool.get(),
+        resources_->constraint_cache.get(),
+        executor_metrics_recorders_[executor_index].get(),
+        resources_->session_resource_pool.get(),
+        executor.task_scheduler.get(), executor.response_cache.get());
+  }
+
+  void CreateSessionAsync(
+      const SessionConfig& session_config,
+      absl::AnyInvocable<void(absl::StatusOr<std::unique_ptr<Session>>) &&>
+          callback) const override {
+    if (loader_thread_pool_ == nullptr || loaded_.HasBeenNotified()) {
+      std::move(callback)(CreateSession(session_config));
+      return;
+    }
+    // The loader thread runs the creation once it is done loading.
+    auto create_session = [this, session_config,
+                           callback = std::move(callback)]() mutable {
+      std::move(callback)(CreateSession(session_config));
+    };
+    if (absl::Status status = loader_thread_pool_->Schedule(
+            std::move(create_session));
+        !status.ok()) {
+      ABSL_LOG(ERROR) << "Failed to queue the session creation: " << status;
+    }
   }
+
   absl::Status WaitUntilDone(absl::Duration timeout) override {
-    return worker_thread_pool_->WaitUntilDone(timeout);
+    const absl::Time deadline = absl::Now() + timeout;
+    if (!loaded_.WaitForNotificationWithDeadline(deadline)) {
+      return absl::DeadlineExceededError(
+          "Timeout waiting for the engine to be loaded.");
+    }
+    if (resources_ == nullptr) {
+      // The loading failed, so there is no task to wait for.
+      return absl::OkStatus();
+    }
+    for (const ExecutorResources& executor : resources_->executors) {
+      RETURN_IF_ERROR(
+          executor.worker_thread_pool->WaitUntilDone(deadline - absl::Now()));
+    }
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<EngineMetrics> GetMetrics() const override {
+    EngineMetrics metrics = metrics_recorder_.GetSnapshot();
+    metrics.kv_cache_max_num_tokens =
+        engine_settings_.GetMainExecutorSettings().GetMaxNumTokens();
+    // The worker threads are shared with the other engines of the same
+    // resources, so their queues hold their tasks too.
+    if (loaded_.HasBeenNotified() && resources_ != nullptr) {
+      for (const ExecutorResources& executor : resources_->executors) {
+        metrics.num_queued_tasks +=
+            executor.worker_thread_pool->num_pending_tasks();
+      }
+    }
+    return metrics;
+  }
+
+  absl::StatusOr<MemoryUsage> GetMemoryUsage() const override {
+    loaded_.WaitForNotification();
+    {
+      absl::MutexLock lock(&load_mutex_);
+      RETURN_IF_ERROR(load_status_);
+    }
+    // The executors and the prefix and response caches are only accessed
+    // from their worker threads, and the model resources from the one of the
+    // main executor. They are shared with the other engines of the same
+    // resources, so is their memory.
+    std::vector<TaskFuture<absl::StatusOr<MemoryUsage>>> futures;
+    for (const ExecutorResources& executor : resources_->executors) {
+      ModelResources* model_resources =
+          futures.empty() ? resources_->model_resources.get() : nullptr;
+      ASSIGN_OR_RETURN(
+          auto future,
+          executor.worker_thread_pool->Submit(
+              [&executor, model_resources]() -> absl::StatusOr<MemoryUsage> {
+                MemoryUsage memory_usage;
+                if (model_resources != nullptr) {
+                  memory_usage = model_resources->GetMemoryUsage();
+                }
+                absl::StatusOr<MemoryUsage> executor_memory_usage =
+                    executor.executor->GetMemoryUsage();
+                if (executor_memory_usage.ok()) {
+                  memory_usage.Merge(*executor_memory_usage);
+                } else if (!absl::IsUnimplemented(
+                               executor_memory_usage.status())) {
+                  return executor_memory_usage.status();
+                }
+                if (executor.prefix_cache != nullptr) {
+                  memory_usage.Add(kPrefixCacheMemory, MemoryLocation::kHost,
+                                   executor.prefix_cache->SizeInBytes());
+                }
+                if (executor.response_cache != nullptr) {
+                  memory_usage.Add(kResponseCacheMemory, MemoryLocation::kHost,
+                                   executor.response_cache->SizeInBytes());
+                }
+                return memory_usage;
+              }));
+      futures.push_back(std::move(future));
+    }
+    MemoryUsage memory_usage;
+    for (auto& future : futures) {
+      ASSIGN_OR_RETURN(MemoryUsage executor_memory_usage,
+                       future.Get(Engine::kDefaultTimeout));
+      memory_usage.Merge(executor_memory_usage);
+    }
+    return memory_usage;
+  }
+
+  absl::Status Warmup(const WarmupOptions& options) override {
+    loaded_.WaitForNotification();
+    {
+      absl::MutexLock lock(&load_mutex_);
+      RETURN_IF_ERROR(load_status_);
+    }
+    RET_CHECK_GE(options.num_decode_steps, 0)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The number of warmup decode steps must not be negative.";
+    std::vector<TaskFuture<absl::Status>> futures;
+    for (size_t i = 0; i < resources_->executors.size(); ++i) {
+      ASSIGN_OR_RETURN(auto future,
+                       ScheduleWarmup(i, options.num_decode_steps));
+      futures.push_back(std::move(future));
+    }
+    if (options.run_in_background) {
+      return absl::OkStatus();
+    }
+    for (auto& future : futures) {
+      RETURN_IF_ERROR(future.Get(Engine::kDefaultTimeout));
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status OnMemoryPressure(MemoryPressureLevel level) override {
+    if (!loaded_.HasBeenNotified()) {
+      return absl::OkStatus();
+    }
+    {
+      absl::MutexLock lock(&load_mutex_);
+      RETURN_IF_ERROR(load_status_);
+    }
+    // The executors and the prefix and response caches are only accessed
+    // from their worker threads, and the model resources from the one of the
+    // main executor.
+    bool weights_uploaded = true;
+    for (const ExecutorResources& executor : resources_->executors) {
+      weights_uploaded &= executor.backend == Backend::GPU;
+    }
+    for (size_t i = 0; i < resources_->executors.size(); ++i) {
+      const ExecutorResources& executor = resources_->executors[i];
+      ModelResources* model_resources =
+          i == 0 ? resources_->model_resources.get() : nullptr;
+      RETURN_IF_ERROR(executor.worker_thread_pool->Schedule(
+          [&executor, i, level, model_resources, weights_uploaded]() {
+            if (executor.prefix_cache != nullptr) {
+              executor.prefix_cache->Clear();
+            }
+            if (executor.response_cache != nullptr) {
+              executor.response_cache->Clear();
+            }
+            if (level >= MemoryPressureLevel::kHigh) {
+              absl::Status status = executor.executor->ReleaseCaches();
+              if (!status.ok() && !absl::IsUnimplemented(status)) {
+                ABSL_LOG(WARNING) << "Failed to release the caches of executor "
+                                  << i << ": " << status;
+              }
+            }
+            if (level >= MemoryPressureLevel::kCritical &&
+                model_resources != nullptr) {
+              // The weights are only read in place on CPU, so they are kept
+              // resident unless every executor has uploaded them.
+              if (weights_uploaded) {
+                model_resources->ReleaseTFLiteModelMemory(
+                    ModelType::kTfLitePrefillDecode);
+              }
+              model_resources->ReleaseTFLiteModelMemory(
+                  ModelType::kTfLiteEmbedder);
+              model_resources->ReleaseTFLiteModelMemory(
+                  ModelType::kTfLitePerLayerEmbedder);
+            }
+          },
+          TaskPriority::kHigh));
+    }
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<std::vector<std::vector<float>>> Embed(
+      absl::Span<const std::string> texts, EmbeddingPooling pooling) override {
+    loaded_.WaitForNotification();
+    {
+      absl::MutexLock lock(&load_mutex_);
+      RETURN_IF_ERROR(load_status_);
+    }
+    ASSIGN_OR_RETURN(auto* tokenizer,
+                     resources_->model_resources->GetTokenizer());
+    std::vector<std::vector<int>> token_ids;
+    token_ids.reserve(texts.size());
+    for (const std::string& text : texts) {
+      ASSIGN_OR_RETURN(std::vector<int> text_token_ids,
+                       tokenizer->TextToTokenIds(text));
+      token_ids.push_back(std::move(text_token_ids));
+    }
+    // The executors are only accessed from their worker threads. The inputs
+    // are embedded by the main executor, between the tasks of its sessions.
+    const ExecutorResources& executor = resources_->executors.front();
+    ASSIGN_OR_RETURN(auto future,
+                     executor.worker_thread_pool->Submit(
+                         [&executor, token_ids = std::move(token_ids),
+                          pooling]() {
+                           return executor.executor->EmbedTokens(token_ids,
+                                                                 pooling);
+                         }));
+    return future.Get(Engine::kDefaultTimeout);
   }
 
  private:
+  // Schedules the warmup of the executor `executor_index` on its worker
+  // thread, where the executor is only accessed from, and where the sessions
+  // created in the meantime are queued behind the warmup. Skipped if
+  // `skip_if_weights_uploaded` and the executor has been warmed up already.
+  absl::StatusOr<TaskFuture<absl::Status>> ScheduleWarmup(
+      size_t executor_index, int num_decode_steps,
+      bool skip_if_weights_uploaded = false) const {
+    ExecutorResources& executor = resources_->executors[executor_index];
+    return executor.worker_thread_pool->Submit(
+        [&executor, executor_index, num_decode_steps,
+         skip_if_weights_uploaded]() -> absl::Status {
+          if (skip_if_weights_uploaded && executor.weights_uploaded) {
+            return absl::OkStatus();
+          }
+          const absl::Time start = absl::Now();
+          absl::Status status = executor.executor->Warmup(num_decode_steps);
+          if (absl::IsUnimplemented(status) ||
+              absl::IsFailedPrecondition(status)) {
+            // The backend has no warmup, or a session holds the executor,
+            // which is then warm already.
+            ABSL_LOG(INFO) << "Executor " << executor_index
+                           << " is not warmed up: " << status;
+            return absl::OkStatus();
+          }
+          RETURN_IF_ERROR(status);
+          executor.weights_uploaded = true;
+          ABSL_LOG(INFO) << "Warmup of executor " << executor_index
+                         << " took " << absl::Now() - start;
+          return absl::OkStatus();
+        });
+  }
+
+  // Uploads the weights of the GPU executors by the warmup of their prefill
+  // signatures, waiting for those of GpuConfig::wait_for_weight_uploads only.
+  // The executors shared with another engine are only uploaded once.
+  absl::Status UploadWeights() const {
+    std::vector<TaskFuture<absl::Status>> futures;
+    for (size_t i = 0; i < resources_->executors.size(); ++i) {
+      const ExecutorResources& executor = resources_->executors[i];
+      if (executor.backend != Backend::GPU) {
+        continue;
+      }
+      ASSIGN_OR_RETURN(LlmExecutorSettings settings,
+                       executor.executor->GetExecutorSettings());
+      ASSIGN_OR_RETURN(GpuConfig gpu_config,
+                       settings.GetBackendConfig<GpuConfig>());
+      // The first run of any signature uploads the weights, and the decode
+      // signature is left to the first decode.
+      ASSIGN_OR_RETURN(auto future,
+                       ScheduleWarmup(i, /*num_decode_steps=*/0,
+                                      /*skip_if_weights_uploaded=*/true));
+      if (gpu_config.wait_for_weight_uploads) {
+        futures.push_back(std::move(future));
+      }
+    }
+    for (auto& future : futures) {
+      RETURN_IF_ERROR(future.Get(Engine::kDefaultTimeout));
+    }
+    return absl::OkStatus();
+  }
+
+  absl::Status LoadResources(LoadingObserver* observer) {
+    if (engine_settings_.IsBenchmarkEnabled()) {
+      benchmark_info_ = std::make_optional<BenchmarkInfo>(
+          engine_settings_.GetBenchmarkParams().value());
+    }
+
+    // Engines of the same model file and executor settings share one copy of
+    // the weights, the executor and the worker thread. The loading phases are
+    // only timed when the resources are built.
+    bool built_resources = false;
+    auto build_resources = [this, observer, &built_resources]() {
+      built_resources = true;
+      return BuildEngineResources(
+          engine_settings_,
+          benchmark_info_.has_value() ? &*benchmark_info_ : nullptr, observer);
+    };
+    const std::string resources_key = GetEngineResourcesKey(engine_settings_);
+    absl::StatusOr<std::shared_ptr<EngineResources>> resources;
+    if (resources_key.empty()) {
+      resources = build_resources();
+    } else {
+      resources = GetEngineResourcesRegistry().GetOrCreate(
+          resources_key, std::move(build_resources));
+    }
+    RETURN_IF_ERROR(resources.status());
+    if (!built_resources) {
+      // The shared resources were built for equal settings, which only need
+      // the same update from the model file.
+      ASSIGN_OR_RETURN(auto* tokenizer,
+                       (*resources)->model_resources->GetTokenizer());
+      ASSIGN_OR_RETURN(auto llm_metadata,
+                       (*resources)->model_resources->GetLlmMetadata());
+      RETURN_IF_ERROR(
+          engine_settings_.MaybeUpdateAndValidate(*tokenizer, llm_metadata));
+    }
+    resources_ = std::move(*resources);
+    for (size_t i = 0; i < resources_->executors.size(); ++i) {
+      executor_metrics_recorders_.push_back(
+          std::make_unique<EngineMetricsRecorder>(&metrics_recorder_));
+    }
+    return absl::OkStatus();
+  }
+
   // Stored engine settings.
   EngineSettings engine_settings_;
-  // Shared executor for all sessions.
-  std::unique_ptr<LlmExecutor> executor_;
   // Default stop token ids for all sessions loaded from the model file.
   std::vector<std::vector<int>> stop_token_ids_;
-  std::unique_ptr<ModelResources> litert_model_resources_;
   proto::SamplerParameters sampler_params_;
 
   // Benchmark info for the engine.
   std::optional<BenchmarkInfo> benchmark_info_;
 
-  // Thread pool for the engine to execute the works.
-  std::unique_ptr<ThreadPool> worker_thread_pool_;
+  // The metrics of the sessions of the engine. Declared before the resources,
+  // such that the sessions still running on the worker thread when the engine
+  // is destroyed can record into it.
+  mutable EngineMetricsRecorder metrics_recorder_;
+  // The metrics of the sessions of the engine on each executor, recorded into
+  // `metrics_recorder_` too, whose sessions alive are the load of the
+  // executors in the placement of the sessions.
+  std::vector<std::unique_ptr<EngineMetricsRecorder>>
+      executor_metrics_recorders_;
+
+  // The model resources, executors and worker threads, shared with the other
+  // engines of the same model and executor settings. Only set once the engine
+  // is loaded.
+  std::shared_ptr<EngineResources> resources_;
+
+  // Notified once the engine is loaded, with the status of the loading.
+  mutable absl::Notification loaded_;
+  mutable absl::Mutex load_mutex_;
+  absl::Status load_status_ ABSL_GUARDED_BY(load_mutex_);
+
+  // The thread loading the engine, and creating the sessions queued in the
+  // meantime, if created by CreateEngineAsync(). Declared last, such that it
+  // is done before the rest is destroyed.
+  std::unique_ptr<ThreadPool> loader_thread_pool_;
 };
 
 // Method to create Engine.
 absl::StatusOr<std::unique_ptr<Engine>> Engine::CreateEngine(
     EngineSettings settings_struct) {
   auto llm_impl = std::make_unique<EngineImpl>(std::move(settings_struct));
+  RETURN_IF_ERROR(llm_impl->Load(/*observer=*/nullptr));
+  return llm_impl;
+};
+
+absl::StatusOr<std::unique_ptr<Engine>> Engine::CreateEngineAsync(
+    EngineSettings settings, LoadingObserver* observer) {
+  auto llm_impl = std::make_unique<EngineImpl>(std::move(settings));
+  RETURN_IF_ERROR(llm_impl->LoadAsync(observer));
   return llm_impl;
 };
 
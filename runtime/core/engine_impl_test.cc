@@ -15,17 +15,24 @@
 #include <cstdlib>
 #include <filesystem>  // NOLINT: Required for path manipulation.
 #include <memory>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/cleanup/cleanup.h"  // from @com_google_absl
 #include "absl/log/absl_check.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
 #include "runtime/engine/engine.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/executor/llm_executor_settings.h"
 #include "runtime/proto/sampler_params.pb.h"
 #include "runtime/util/test_utils.h"  // NOLINT
@@ -81,6 +88,41 @@ TEST(EngineTest, CreateEngine_WithoutCache) {
   EXPECT_FALSE(responses->GetResponseTextAt(0)->empty());
 }
 
+TEST(EngineTest, CreateEngine_TimesTheInitSteps) {
+  auto task_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm_new_metadata.task";
+  auto model_assets = ModelAssets::Create(task_path.string());
+  ASSERT_OK(model_assets);
+  auto engine_settings =
+      EngineSettings::CreateDefault(*model_assets, Backend::CPU);
+  ASSERT_OK(engine_settings);
+  engine_settings->GetMutableMainExecutorSettings().SetMaxNumTokens(
+      kMaxNumTokens);
+  engine_settings->GetMutableMainExecutorSettings().SetCacheDir(":nocache");
+  // Enables the benchmark info.
+  engine_settings->GetMutableBenchmarkParams();
+
+  absl::StatusOr<std::unique_ptr<Engine>> llm =
+      Engine::CreateEngine(*engine_settings);
+  ABSL_CHECK_OK(llm);
+  absl::StatusOr<std::unique_ptr<Engine::Session>> session =
+      (*llm)->CreateSession(SessionConfig::CreateDefault());
+  ABSL_CHECK_OK(session);
+  absl::StatusOr<BenchmarkInfo> benchmark_info =
+      (*session)->GetBenchmarkInfo();
+  ASSERT_OK(benchmark_info);
+
+  // The steps are timed under the phase of the loading graph they ran in.
+  const auto& phases = benchmark_info->GetInitPhases();
+  EXPECT_TRUE(phases.contains("Model resources initialization/File open"));
+  EXPECT_TRUE(phases.contains("Executor initialization/Model compilation"));
+  EXPECT_TRUE(phases.contains("Executor initialization/Buffer allocation"));
+#if !defined(_WIN32)
+  EXPECT_TRUE(benchmark_info->GetModelPageCacheResidency().has_value());
+#endif  // !_WIN32
+}
+
 TEST(EngineTest, CreateEngine_WithCache) {
   auto cache_path = std::filesystem::path(::testing::TempDir()) /
        absl::StrCat("cache-", std::rand());
@@ -147,6 +189,214 @@ TEST(EngineTest, CreateEngine_WithCache) {
   EXPECT_FALSE(responses->GetResponseTextAt(0)->empty());
 }
 
+TEST(EngineTest, CreateEngine_TwoEnginesOfSameModel) {
+  auto task_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm_new_metadata.task";
+  auto model_assets = ModelAssets::Create(task_path.string());
+  ASSERT_OK(model_assets);
+  auto engine_settings =
+      EngineSettings::CreateDefault(*model_assets, Backend::CPU);
+  ASSERT_OK(engine_settings);
+  engine_settings->GetMutableMainExecutorSettings().SetMaxNumTokens(
+      kMaxNumTokens);
+  engine_settings->GetMutableMainExecutorSettings().SetCacheDir(":nocache");
+
+  // The second engine shares the model and executor of the first one.
+  absl::StatusOr<std::unique_ptr<Engine>> first =
+      Engine::CreateEngine(*engine_settings);
+  ABSL_CHECK_OK(first);
+  absl::StatusOr<std::unique_ptr<Engine>> second =
+      Engine::CreateEngine(*engine_settings);
+  ABSL_CHECK_OK(second);
+
+  absl::StatusOr<std::unique_ptr<Engine::Session>> session =
+      (*second)->CreateSession(SessionConfig::CreateDefault());
+  ABSL_CHECK_OK(session);
+  ABSL_CHECK_OK((*session)->RunPrefill({InputText("Hello world!")}));
+  auto responses = (*session)->RunDecode();
+  EXPECT_OK(responses);
+  EXPECT_FALSE(responses->GetResponseTextAt(0)->empty());
+
+  // The shared resources outlive the engine that built them.
+  session->reset();
+  first->reset();
+  session = (*second)->CreateSession(SessionConfig::CreateDefault());
+  ABSL_CHECK_OK(session);
+  ABSL_CHECK_OK((*session)->RunPrefill({InputText("Hello world!")}));
+  responses = (*session)->RunDecode();
+  EXPECT_OK(responses);
+  EXPECT_FALSE(responses->GetResponseTextAt(0)->empty());
+}
+
+TEST(EngineTest, CreateEngine_WithExecutorPool) {
+  auto task_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm_new_metadata.task";
+  auto model_assets = ModelAssets::Create(task_path.string());
+  ASSERT_OK(model_assets);
+  auto engine_settings =
+      EngineSettings::CreateDefault(*model_assets, Backend::CPU);
+  ASSERT_OK(engine_settings);
+  engine_settings->GetMutableMainExecutorSettings().SetMaxNumTokens(
+      kMaxNumTokens);
+  engine_settings->GetMutableMainExecutorSettings().SetCacheDir(":nocache");
+  // A second CPU executor, whose max number of tokens is the main one's.
+  auto pool_executor_settings =
+      LlmExecutorSettings::CreateDefault(*model_assets, Backend::CPU);
+  ASSERT_OK(pool_executor_settings);
+  pool_executor_settings->SetCacheDir(":nocache");
+  engine_settings->AddPoolExecutorSettings(*pool_executor_settings);
+
+  absl::StatusOr<std::unique_ptr<Engine>> llm =
+      Engine::CreateEngine(*engine_settings);
+  ABSL_CHECK_OK(llm);
+
+  // The sessions are placed on both executors, and run next to each other.
+  std::vector<std::unique_ptr<Engine::Session>> sessions;
+  for (int i = 0; i < 2; ++i) {
+    SessionConfig session_config = SessionConfig::CreateDefault();
+    session_config.SetPreferredBackend(Backend::CPU);
+    absl::StatusOr<std::unique_ptr<Engine::Session>> session =
+        (*llm)->CreateSession(session_config);
+    ABSL_CHECK_OK(session);
+    ABSL_CHECK_OK((*session)->RunPrefill({InputText("Hello world!")}));
+    sessions.push_back(*std::move(session));
+  }
+  for (auto& session : sessions) {
+    auto responses = session->RunDecode();
+    EXPECT_OK(responses);
+    EXPECT_FALSE(responses->GetResponseTextAt(0)->empty());
+  }
+  EXPECT_EQ((*llm)->GetMetrics()->num_active_sessions, 2);
+}
+
+class TestLoadingObserver : public Engine::LoadingObserver {
+ public:
+  void OnProgress(absl::string_view phase) override {
+    EXPECT_FALSE(ready_.HasBeenNotified());
+  }
+  void OnReady(absl::Status status) override {
+    status_ = status;
+    ready_.Notify();
+  }
+
+  absl::Status WaitUntilReady() {
+    ready_.WaitForNotification();
+    return status_;
+  }
+
+ private:
+  absl::Notification ready_;
+  absl::Status status_;
+};
+
+TEST(EngineTest, CreateEngineAsync_QueuesTheSessions) {
+  auto task_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm_new_metadata.task";
+  auto model_assets = ModelAssets::Create(task_path.string());
+  ASSERT_OK(model_assets);
+  auto engine_settings =
+      EngineSettings::CreateDefault(*model_assets, Backend::CPU);
+  ASSERT_OK(engine_settings);
+  engine_settings->GetMutableMainExecutorSettings().SetMaxNumTokens(
+      kMaxNumTokens);
+  engine_settings->GetMutableMainExecutorSettings().SetCacheDir(":nocache");
+
+  TestLoadingObserver observer;
+  absl::StatusOr<std::unique_ptr<Engine>> llm =
+      Engine::CreateEngineAsync(*engine_settings, &observer);
+  ABSL_CHECK_OK(llm);
+
+  // The session is created once the engine is loaded.
+  absl::Notification session_created;
+  absl::StatusOr<std::unique_ptr<Engine::Session>> session;
+  (*llm)->CreateSessionAsync(
+      SessionConfig::CreateDefault(),
+      [&](absl::StatusOr<std::unique_ptr<Engine::Session>> created_session) {
+        session = std::move(created_session);
+        session_created.Notify();
+      });
+  EXPECT_OK(observer.WaitUntilReady());
+  session_created.WaitForNotification();
+  ABSL_CHECK_OK(session);
+
+  ABSL_CHECK_OK((*session)->RunPrefill({InputText("Hello world!")}));
+  auto responses = (*session)->RunDecode();
+  EXPECT_OK(responses);
+  EXPECT_FALSE(responses->GetResponseTextAt(0)->empty());
+}
+
+TEST(EngineTest, OnMemoryPressure_KeepsTheEngineUsable) {
+  auto task_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm_new_metadata.task";
+  auto model_assets = ModelAssets::Create(task_path.string());
+  ASSERT_OK(model_assets);
+  auto engine_settings =
+      EngineSettings::CreateDefault(*model_assets, Backend::CPU);
+  ASSERT_OK(engine_settings);
+  engine_settings->GetMutableMainExecutorSettings().SetMaxNumTokens(
+      kMaxNumTokens);
+  engine_settings->GetMutableMainExecutorSettings().SetCacheDir(":nocache");
+  engine_settings->SetPrefixCacheBudgetBytes(1 << 20);
+
+  absl::StatusOr<std::unique_ptr<Engine>> llm =
+      Engine::CreateEngine(*engine_settings);
+  ABSL_CHECK_OK(llm);
+
+  absl::StatusOr<std::unique_ptr<Engine::Session>> session =
+      (*llm)->CreateSession(SessionConfig::CreateDefault());
+  ABSL_CHECK_OK(session);
+  ABSL_CHECK_OK((*session)->RunPrefill({InputText("Hello world!")}));
+  auto responses = (*session)->RunDecode();
+  EXPECT_OK(responses);
+
+  for (MemoryPressureLevel level :
+       {MemoryPressureLevel::kModerate, MemoryPressureLevel::kHigh,
+        MemoryPressureLevel::kCritical}) {
+    EXPECT_OK((*llm)->OnMemoryPressure(level));
+  }
+  EXPECT_OK((*llm)->WaitUntilDone(Engine::kDefaultTimeout));
+
+  // The session goes on after the memory is released.
+  ABSL_CHECK_OK((*session)->RunPrefill({InputText("Hello world!")}));
+  responses = (*session)->RunDecode();
+  EXPECT_OK(responses);
+  EXPECT_FALSE(responses->GetResponseTextAt(0)->empty());
+}
+
+TEST(EngineTest, Embed_RequiresTheEmbedSignature) {
+  auto task_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm_new_metadata.task";
+  auto model_assets = ModelAssets::Create(task_path.string());
+  ASSERT_OK(model_assets);
+  auto engine_settings =
+      EngineSettings::CreateDefault(*model_assets, Backend::CPU);
+  ASSERT_OK(engine_settings);
+  engine_settings->GetMutableMainExecutorSettings().SetMaxNumTokens(
+      kMaxNumTokens);
+  engine_settings->GetMutableMainExecutorSettings().SetCacheDir(":nocache");
+
+  absl::StatusOr<std::unique_ptr<Engine>> llm =
+      Engine::CreateEngine(*engine_settings);
+  ABSL_CHECK_OK(llm);
+
+  // The test model has no embed signature.
+  const std::vector<std::string> texts = {"Hello world!"};
+  EXPECT_EQ((*llm)->Embed(texts, EmbeddingPooling::kMean).status().code(),
+            absl::StatusCode::kUnimplemented);
+
+  // The engine is still usable.
+  absl::StatusOr<std::unique_ptr<Engine::Session>> session =
+      (*llm)->CreateSession(SessionConfig::CreateDefault());
+  ABSL_CHECK_OK(session);
+  ABSL_CHECK_OK((*session)->RunPrefill({InputText("Hello world!")}));
+  EXPECT_OK((*session)->RunDecode());
+}
+
 // TODO (b/397975034): Add more tests for Engine.
 
 }  // namespace
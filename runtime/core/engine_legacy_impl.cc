@@ -214,4 +214,10 @@ absl::StatusOr<std::unique_ptr<Engine>> Engine::CreateEngine(
   return std::make_unique<EngineImpl>(std::move(settings_struct));
 };
 
+absl::StatusOr<std::unique_ptr<Engine>> Engine::CreateEngineAsync(
+    EngineSettings settings, LoadingObserver* observer) {
+  return absl::UnimplementedError(
+      "The legacy engine can only be created with CreateEngine().");
+};
+
 }  // namespace litert::lm
@@ -15,6 +15,10 @@
 #include "runtime/core/pipeline.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <limits>
 #include <memory>
 #include <optional>
@@ -23,24 +27,40 @@
 #include <vector>
 
 #include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/str_replace.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_macros.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/components/beam_search.h"
+#include "runtime/components/ngram_index.h"
 #include "runtime/components/sampler.h"
+#include "runtime/components/stop_string_detector.h"
 #include "runtime/components/stop_token_detector.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/core/document_cache.h"
+#include "runtime/core/prefix_cache.h"
+#include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
+#include "runtime/executor/kv_cache_layout.h"
 #include "runtime/executor/llm_executor.h"
 #include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/executor/vision_executor.h"
+#include "runtime/framework/threadpool.h"
 #include "runtime/util/convert_tensor_buffer.h"
 #include "runtime/util/litert_status_util.h"
 #include "runtime/util/status_macros.h"  //NOLINT
+#include "runtime/util/trace.h"
 
 namespace litert::lm {
 namespace {
@@ -61,6 +81,137 @@ int TryGetMaxNumTokens(const LlmExecutor& executor) {
   return settings->GetMaxNumTokens();
 }
 
+// Returns the number of decode steps the executor runs per host sync, or 1 if
+// the executor settings do not ask for multi-step decode.
+int TryGetNumDecodeStepsPerSync(const LlmExecutor& executor) {
+  auto settings = executor.GetExecutorSettings();
+  if (!settings.ok()) {
+    return 1;
+  }
+  if (auto gpu_config = settings->GetBackendConfig<GpuConfig>();
+      gpu_config.ok()) {
+    return std::max<int>(gpu_config->num_decode_steps_per_sync, 1);
+  }
+  if (auto gpu_artisan_config = settings->GetBackendConfig<GpuArtisanConfig>();
+      gpu_artisan_config.ok()) {
+    return std::max<int>(gpu_artisan_config->num_decode_steps_per_sync, 1);
+  }
+  return 1;
+}
+
+// The compact top-k logits decoded by the executor for a sampler that only
+// looks at the top-k logits, of shape [num_output_candidates, k].
+struct TopKLogitsBuffers {
+  litert::TensorBuffer logits;
+  litert::TensorBuffer ids;
+};
+
+// Returns the top-k logits buffers if the sampler samples from the top-k
+// logits and k is within the vocabulary and the max top-k of the executor.
+// Returns std::nullopt if the full logits are needed.
+std::optional<TopKLogitsBuffers> MaybeCreateTopKLogitsBuffers(
+    LlmExecutor& executor, const Sampler& sampler, int num_output_candidates) {
+  const int k = sampler.GetTopK();
+  if (k <= 0) {
+    return std::nullopt;
+  }
+  auto vocab_size = executor.GetVocabSize();
+  if (!vocab_size.ok() || k > *vocab_size) {
+    return std::nullopt;
+  }
+  auto settings = executor.GetExecutorSettings();
+  if (settings.ok()) {
+    if (auto gpu_config = settings->GetBackendConfig<GpuConfig>();
+        gpu_config.ok() && k > gpu_config->max_top_k) {
+      return std::nullopt;
+    }
+  }
+  auto logits = CreateTensorBuffer<float>({num_output_candidates, k});
+  auto ids = CreateTensorBuffer<int>({num_output_candidates, k});
+  if (!logits || !ids) {
+    return std::nullopt;
+  }
+  TopKLogitsBuffers buffers;
+  buffers.logits = std::move(*logits);
+  buffers.ids = std::move(*ids);
+  return buffers;
+}
+
+// Runs one decode step and samples the next token ids into `decoded_ids`.
+// The executor only outputs the top-k logits if `topk_buffers` is set, which
+// is reset if the executor does not support them.
+absl::Status DecodeAndSample(LlmExecutor& executor, Sampler& sampler,
+                             const ExecutorInputs& inputs,
+                             std::optional<TopKLogitsBuffers>& topk_buffers,
+                             litert::TensorBuffer& decoded_ids,
+                             litert::TensorBuffer& scores_tensor,
+                             std::optional<BenchmarkInfo>& benchmark_info) {
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_decode"));
+  }
+  if (topk_buffers.has_value()) {
+    absl::Status status = executor.DecodeTopKLogits(
+        inputs, topk_buffers->logits, topk_buffers->ids);
+    if (absl::IsUnimplemented(status)) {
+      topk_buffers = std::nullopt;
+    } else {
+      RETURN_IF_ERROR(status);
+    }
+  }
+  std::optional<litert::TensorBuffer> output_logits;
+  if (!topk_buffers.has_value()) {
+    ASSIGN_OR_RETURN(output_logits, executor.DecodeLogits(inputs));
+  }
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_decode"));
+    RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("sampling"));
+  }
+  LITERT_LM_TRACE_SCOPE("sampling");
+  if (topk_buffers.has_value()) {
+    RETURN_IF_ERROR(sampler.SampleToIdAndScoreBufferFromTopK(
+        topk_buffers->logits, topk_buffers->ids, decoded_ids, &scores_tensor));
+  } else {
+    RETURN_IF_ERROR(sampler.SampleToIdAndScoreBuffer(
+        *output_logits, decoded_ids, &scores_tensor));
+  }
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("sampling"));
+  }
+  return absl::OkStatus();
+}
+
+// Shifts the context of the executor when context shifting is enabled and
+// `num_new_tokens` more tokens do not fit into the kv-cache after
+// `current_step`. The sink tokens are kept together with as many of the latest
+// tokens as the config asks for and the new tokens leave room for. Returns the
+// current step after the shift.
+absl::StatusOr<int> MaybeShiftContext(
+    LlmExecutor& executor, int current_step, int num_new_tokens,
+    int max_num_tokens,
+    const std::optional<ContextShiftConfig>& context_shift_config) {
+  if (!context_shift_config.has_value() ||
+      current_step + num_new_tokens < max_num_tokens) {
+    return current_step;
+  }
+  const int num_sink_tokens = context_shift_config->num_sink_tokens;
+  const int num_recent_tokens =
+      std::min(context_shift_config->num_recent_tokens,
+               max_num_tokens - 1 - num_new_tokens - num_sink_tokens);
+  if (num_recent_tokens < 1) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "No room to shift the context for ", num_new_tokens,
+        " new tokens after ", num_sink_tokens,
+        " sink tokens with the maximum number of tokens ", max_num_tokens));
+  }
+  const int num_discarded_tokens =
+      current_step - num_sink_tokens - num_recent_tokens;
+  ABSL_LOG(INFO) << "Shifting the context: discarding " << num_discarded_tokens
+                 << " tokens after " << num_sink_tokens << " sink tokens.";
+  RETURN_IF_ERROR(
+      executor.ShiftContext(num_sink_tokens, num_discarded_tokens));
+  return current_step - num_discarded_tokens;
+}
+
 // Check whether the decoding loop should stop.
 bool ShouldStop(bool hit_stop_tokens, int benchmark_decode_token_count,
                 int num_decoded_steps, int current_step, int max_num_tokens,
@@ -85,17 +236,114 @@ bool ShouldStop(bool hit_stop_tokens, int benchmark_decode_token_count,
   return false;
 }
 
+// Whether the decoding loop should stop as it has spent `decode_budget`.
+bool IsBudgetSpent(const DecodeBudget* absl_nullable decode_budget,
+                   int num_decoded_steps) {
+  if (decode_budget == nullptr) {
+    return false;
+  }
+  if (decode_budget->max_output_tokens.has_value() &&
+      num_decoded_steps >= *decode_budget->max_output_tokens) {
+    return true;
+  }
+  return decode_budget->end_time != absl::InfiniteFuture() &&
+         absl::Now() >= decode_budget->end_time;
+}
+
+// Waits before the next decode step, as paced by `decode_budget`.
+void PaceDecodeStep(const DecodeBudget* absl_nullable decode_budget) {
+  if (decode_budget == nullptr || decode_budget->pacer == nullptr) {
+    return;
+  }
+  const absl::Duration wait =
+      decode_budget->pacer->GetWaitBeforeStep(absl::Now());
+  if (wait > absl::ZeroDuration()) {
+    absl::SleepFor(wait);
+  }
+}
+
 // The result of a invocation of the decode process for a single batch of
 // tokens.
-// kPartial indicates that at least one output candidate needs to be re-decoded
-// with additional tokens, while kDone indicates that all output candidates are
-// complete. kContinue represents the steady state of the decoding loop.
 enum DecodeResult {
-  kPartial,   // BPE token encountered, need more tokens to complete decoding.
   kContinue,  // Next token decoded, but no stop token encountered.
   kDone,      // Stop token encountered, decoding is complete.
 };
 
+// Creates one streaming detokenizer per output candidate.
+std::vector<std::unique_ptr<StreamingDetokenizer>> CreateStreamingDetokenizers(
+    Tokenizer& tokenizer, int num_output_candidates) {
+  std::vector<std::unique_ptr<StreamingDetokenizer>> detokenizers;
+  detokenizers.reserve(num_output_candidates);
+  for (int i = 0; i < num_output_candidates; ++i) {
+    detokenizers.push_back(tokenizer.CreateStreamingDetokenizer());
+  }
+  return detokenizers;
+}
+
+// Adds the latest token of each output candidate to its detokenizer, and
+// sets `texts` to the text completed by each. The text of a candidate is empty
+// while its token is part of an incomplete BPE sequence. The candidates marked
+// in `finished_candidates`, if set, are not detokenized and have empty texts.
+// `texts` is reused from step to step.
+absl::Status DetokenizeLatestTokens(
+    absl::Span<const std::unique_ptr<StreamingDetokenizer>> detokenizers,
+    absl::Span<const int> token_ids, std::vector<std::string>& texts,
+    const std::vector<bool>* absl_nullable finished_candidates = nullptr) {
+  LITERT_LM_TRACE_SCOPE("detokenize");
+  RET_CHECK_EQ(detokenizers.size(), token_ids.size())
+      << "Expected one token per output candidate.";
+  texts.resize(token_ids.size());
+  for (int i = 0; i < token_ids.size(); ++i) {
+    texts[i].clear();
+    if (finished_candidates != nullptr && (*finished_candidates)[i]) {
+      continue;
+    }
+    ASSIGN_OR_RETURN(texts[i], detokenizers[i]->Add(token_ids[i]));
+  }
+  return absl::OkStatus();
+}
+
+// Lets the sampler skip the output candidates that reached their stop tokens,
+// since their next tokens are discarded. The batch of the executor is fixed,
+// so their rows are still decoded. `active_rows` is reused from step to step.
+void SkipFinishedCandidates(const std::vector<bool>& stop_tokens_found,
+                            Sampler& sampler, std::vector<bool>& active_rows) {
+  if (stop_tokens_found.size() <= 1) {
+    return;
+  }
+  active_rows.resize(stop_tokens_found.size());
+  for (int i = 0; i < stop_tokens_found.size(); ++i) {
+    active_rows[i] = !stop_tokens_found[i];
+  }
+  sampler.SetActiveRows(active_rows);
+}
+
+// Appends the decoded `text` to `response_text`, with the special character
+// "▁" the tokenizer may return for a space replaced by one. Unlike
+// absl::StrReplaceAll(), the text is appended in place, so the response grows
+// without a temporary string per token.
+void AppendDecodedText(absl::string_view text, std::string& response_text) {
+  constexpr absl::string_view kSpaceMarker = "▁";
+  for (size_t pos = text.find(kSpaceMarker); pos != absl::string_view::npos;
+       pos = text.find(kSpaceMarker)) {
+    response_text.append(text.data(), pos);
+    response_text.push_back(' ');
+    text.remove_prefix(pos + kSpaceMarker.size());
+  }
+  response_text.append(text.data(), text.size());
+}
+
+// Whether any output candidate has text to stream, such that the steps only
+// completing a part of a character are not reported.
+bool HasText(const Responses& responses) {
+  for (int i = 0; i < responses.GetNumOutputCandidates(); ++i) {
+    if (!responses.GetResponseTextAt(i)->empty()) {
+      return true;
+    }
+  }
+  return false;
+}
+
 // A wrapper class to run one step of the decode process. It allows us to reduce
 // the code duplication between different decode functions.
 // TODO(b/417568021): Refactor the class to make it more readable.
@@ -107,57 +355,103 @@ class DecodeExternalSampling {
                          const StopTokenDetector& stop_token_detector,
                          std::optional<BenchmarkInfo>& benchmark_info)
       : executor_(*executor),
-        tokenizer_(*tokenizer),
         num_output_candidates_(num_output_candidates),
+        max_num_tokens_(TryGetMaxNumTokens(*executor)),
         sampler_(sampler),
         benchmark_info_(benchmark_info),
+        detokenizers_(
+            CreateStreamingDetokenizers(*tokenizer, num_output_candidates)),
         stop_token_detector_(stop_token_detector) {
     auto scores_tensor = CreateTensorBuffer<float>({num_output_candidates_});
     scores_tensor_ = std::move(*scores_tensor);
+    topk_buffers_ = MaybeCreateTopKLogitsBuffers(executor_, sampler_,
+                                                 num_output_candidates_);
+    if (sampler_.GetNumTopLogProbs() > 0) {
+      top_log_probs_.resize(num_output_candidates_);
+    }
   }
 
   // Runs one step of the decode process with sampling done externally from the
-  // Executor.
+  // Executor. `decoded_ids` is the same buffer at every step, so the inputs
+  // referring to it are only created by the first step.
   absl::StatusOr<DecodeResult> Run(litert::TensorBuffer& decoded_ids) {
-    LITERT_ASSIGN_OR_RETURN(auto duplicate_decoded_ids,
-                            decoded_ids.Duplicate());
-    ExecutorInputs inputs(ExecutorTextData(std::move(duplicate_decoded_ids)),
-                          std::nullopt, std::nullopt);
-    if (benchmark_info_.has_value()) {
-      RETURN_IF_ERROR(benchmark_info_->TimeMarkDelta("executor_decode"));
-    }
-    ASSIGN_OR_RETURN(auto output_logits, executor_.DecodeLogits(inputs));  // NOLINT
-    if (benchmark_info_.has_value()) {
-      RETURN_IF_ERROR(benchmark_info_->TimeMarkDelta("executor_decode"));
-      RETURN_IF_ERROR(benchmark_info_->TimeMarkDelta("sampling"));
+    if (inputs_decoded_ids_ != &decoded_ids) {
+      LITERT_ASSIGN_OR_RETURN(auto duplicate_decoded_ids,
+                              decoded_ids.Duplicate());
+      inputs_.emplace(ExecutorTextData(std::move(duplicate_decoded_ids)),
+                      std::nullopt, std::nullopt);
+      inputs_decoded_ids_ = &decoded_ids;
     }
-    RETURN_IF_ERROR(sampler_.SampleToIdAndScoreBuffer(
-        output_logits, decoded_ids, &scores_tensor_));
-    if (benchmark_info_.has_value()) {
-      RETURN_IF_ERROR(benchmark_info_->TimeMarkDelta("sampling"));
-    }
-    ASSIGN_OR_RETURN(auto token_ids,
-                     tokenizer_.TensorBufferToTokenIds(decoded_ids));
-    auto decode_result =
-        tokenizer_.TokenIdsToTexts(num_output_candidates_, token_ids);
-    if (Tokenizer::IsIncompleteBpeSequence(decode_result)) {
-      return kContinue;
+    // The candidates done before this step are neither sampled nor
+    // detokenized.
+    const std::vector<bool>& stop_tokens_found =
+        stop_token_detector_.GetStopTokensFound();
+    SkipFinishedCandidates(stop_tokens_found, sampler_, active_rows_);
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto decoded_ids_span,
+                                 ReferTensorBufferAsSpan<int>(decoded_ids));
+    if (NumForcedTokens() > 0) {
+      // The forced tokens are already prefilled, and sure to be sampled.
+      decoded_ids_span[0] = forced_token_ids_[next_forced_token_++];
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto scores, ReferTensorBufferAsSpan<float>(scores_tensor_));
+      scores[0] = 0.0f;
+      if (sampler_.GetNumTopLogProbs() > 0) {
+        top_log_probs_[0].assign(
+            1, TokenLogProb{.token_id = decoded_ids_span[0], .log_prob = 0.0f});
+      }
+    } else {
+      RETURN_IF_ERROR(DecodeAndSample(executor_, sampler_, *inputs_,
+                                      topk_buffers_, decoded_ids,
+                                      scores_tensor_, benchmark_info_));
+      CollectTopLogProbs();
+      RETURN_IF_ERROR(PrefillForcedTokens(decoded_ids_span[0]));
     }
-    ASSIGN_OR_RETURN(auto decoded_text, decode_result);
-    result_tokens_ = decoded_text;
+    RETURN_IF_ERROR(DetokenizeLatestTokens(detokenizers_, decoded_ids_span,
+                                           result_tokens_,
+                                           &stop_tokens_found));
 
     // Update the stop_tokens_found vector with the latest decoded ids.
-    LITERT_ASSIGN_OR_RETURN_ABSL(auto decoded_ids_span,
-                                 ReferTensorBufferAsSpan<int>(decoded_ids));
     LITERT_ASSIGN_OR_RETURN_ABSL(
         scores_span_, ReferTensorBufferAsSpan<float>(scores_tensor_));
     RETURN_IF_ERROR(stop_token_detector_.ProcessTokens(decoded_ids_span));
     ASSIGN_OR_RETURN(bool hit_stop_tokens, stop_token_detector_.AllDone());
-    return hit_stop_tokens ? kDone : kPartial;
+    return hit_stop_tokens ? kDone : kContinue;
+  }
+
+  // Returns the current step of the executor, not counting the forced tokens
+  // that are prefilled but not yet returned by Run().
+  absl::StatusOr<int> GetCurrentStep() const {
+    ASSIGN_OR_RETURN(int current_step, executor_.GetCurrentStep());
+    return current_step - NumForcedTokens();
+  }
+
+  // Rolls the executor back over the forced tokens that are prefilled but not
+  // returned by Run(), e.g. when the decoding stops before them, such that
+  // the next turn continues from the last returned token.
+  absl::Status DiscardForcedTokens() {
+    const int num_forced_tokens = NumForcedTokens();
+    if (num_forced_tokens == 0) {
+      return absl::OkStatus();
+    }
+    ASSIGN_OR_RETURN(int current_step, executor_.GetCurrentStep());
+    // The last returned token becomes the pending input token.
+    const int last_token_id =
+        next_forced_token_ > 0 ? forced_token_ids_[next_forced_token_ - 1]
+                               : sampled_token_id_;
+    RETURN_IF_ERROR(executor_.Rollback(current_step - num_forced_tokens,
+                                       last_token_id));
+    next_forced_token_ = forced_token_ids_.size();
+    return absl::OkStatus();
   }
 
   absl::Span<float> GetScores() { return scores_span_; }
 
+  // Returns the most likely tokens of the latest step per candidate, empty
+  // unless the sampler reports them.
+  const std::vector<std::vector<TokenLogProb>>& GetTopLogProbs() const {
+    return top_log_probs_;
+  }
+
   const std::vector<std::string>& GetResultTokens() const {
     return result_tokens_;
   }
@@ -166,20 +460,98 @@ class DecodeExternalSampling {
     return stop_token_detector_.GetStopTokensFound();
   }
 
+  // Stops the output candidate `index` as if it had hit a stop token, e.g. at
+  // a stop string, such that it is no longer sampled nor detokenized.
+  absl::Status StopCandidate(int index) {
+    return stop_token_detector_.StopBatchItem(index);
+  }
+
  private:
+  int NumForcedTokens() const {
+    return forced_token_ids_.size() - next_forced_token_;
+  }
+
+  // Copies the most likely tokens the sampler selected with the latest ones.
+  // The entries past the vocabulary (id -1) are dropped.
+  void CollectTopLogProbs() {
+    if (sampler_.GetNumTopLogProbs() == 0) {
+      return;
+    }
+    for (int i = 0; i < num_output_candidates_; ++i) {
+      top_log_probs_[i].clear();
+      for (const auto& [token_id, log_prob] : sampler_.GetTopLogProbs(i)) {
+        if (token_id >= 0) {
+          top_log_probs_[i].push_back(
+              {.token_id = token_id, .log_prob = log_prob});
+        }
+      }
+    }
+  }
+
+  // Takes the tokens the sampler is bound to continue with after
+  // `sampled_token_id`, e.g. the fixed parts of a constrained output, and
+  // prefills them together with it in one executor call instead of decoding
+  // them one by one. The last forced token is left pending, as the input of
+  // the next decode step. Only for a single output candidate.
+  absl::Status PrefillForcedTokens(int sampled_token_id) {
+    if (num_output_candidates_ != 1) {
+      return absl::OkStatus();
+    }
+    ASSIGN_OR_RETURN(int current_step, executor_.GetCurrentStep());
+    const int max_num_forced_tokens = max_num_tokens_ - current_step;
+    if (max_num_forced_tokens <= 0) {
+      return absl::OkStatus();
+    }
+    ASSIGN_OR_RETURN(forced_token_ids_,
+                     sampler_.TakeForcedTokenIds(max_num_forced_tokens));
+    next_forced_token_ = 0;
+    if (forced_token_ids_.empty()) {
+      return absl::OkStatus();
+    }
+    sampled_token_id_ = sampled_token_id;
+    prefill_token_ids_.assign(1, sampled_token_id);
+    prefill_token_ids_.insert(prefill_token_ids_.end(),
+                              forced_token_ids_.begin(),
+                              forced_token_ids_.end());
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto prefill_ids_buffer,
+        CopyToTensorBuffer<int>(
+            prefill_token_ids_,
+            {1, static_cast<int>(prefill_token_ids_.size())}));
+    LITERT_LM_TRACE_SCOPE("prefill_forced_tokens");
+    return executor_.Prefill(ExecutorInputs(
+        ExecutorTextData(std::move(prefill_ids_buffer)), std::nullopt,
+        std::nullopt));
+  }
+
   LlmExecutor& executor_;
-  Tokenizer& tokenizer_;
   const int num_output_candidates_;
+  const int max_num_tokens_;
   Sampler& sampler_;
   std::optional<BenchmarkInfo> benchmark_info_;
   litert::TensorBuffer scores_tensor_;
+  std::optional<TopKLogitsBuffers> topk_buffers_;
+  // The decode inputs, referring to the decoded ids of the previous step.
+  std::optional<ExecutorInputs> inputs_;
+  const litert::TensorBuffer* inputs_decoded_ids_ = nullptr;
+  // The forced tokens prefilled after the sampled token `sampled_token_id_`,
+  // and the next of them to be returned by Run().
+  std::vector<int> forced_token_ids_;
+  int next_forced_token_ = 0;
+  int sampled_token_id_ = 0;
+  std::vector<int> prefill_token_ids_;
+  std::vector<bool> active_rows_;
+  std::vector<std::unique_ptr<StreamingDetokenizer>> detokenizers_;
   std::vector<std::string> result_tokens_;
   absl::Span<float> scores_span_;
+  std::vector<std::vector<TokenLogProb>> top_log_probs_;
   StopTokenDetector stop_token_detector_;
 };
 
 // A wrapper class to run one step of the decode process with sampling done
-// internally from the Executor.
+// internally from the Executor. When the executor decodes multiple steps per
+// host sync, the tokens of one executor call are buffered and returned one per
+// Run() call.
 class DecodeInternalSamplingOneStep {
  public:
   DecodeInternalSamplingOneStep(LlmExecutor* absl_nonnull executor,
@@ -188,50 +560,64 @@ class DecodeInternalSamplingOneStep {
                                 const StopTokenDetector& stop_token_detector,
                                 std::optional<BenchmarkInfo>& benchmark_info)
       : executor_(*executor),
-        tokenizer_(*tokenizer),
         num_output_candidates_(num_output_candidates),
+        // Multi-step decode only supports a single output candidate.
+        num_steps_per_sync_(num_output_candidates == 1
+                                ? TryGetNumDecodeStepsPerSync(*executor)
+                                : 1),
+        max_num_tokens_(TryGetMaxNumTokens(*executor)),
         benchmark_info_(benchmark_info),
+        detokenizers_(
+            CreateStreamingDetokenizers(*tokenizer, num_output_candidates)),
         stop_token_detector_(stop_token_detector) {
     stop_tokens_found_ = std::vector<bool>(num_output_candidates_, false);
-    auto output_tokens = CreateTensorBuffer<int>({num_output_candidates_, 1});
+    latest_token_ids_ = std::vector<int>(num_output_candidates_, 0);
+    auto output_tokens =
+        CreateTensorBuffer<int>({num_output_candidates_, num_steps_per_sync_});
     output_tokens_ = std::move(*output_tokens);
   }
 
-  // Runs one step of the decode process with sampling done externally from the
-  // Executor.
-  absl::StatusOr<DecodeResult> Run(
-      const std::vector<std::vector<int>>& previous_token_ids) {
-    if (benchmark_info_.has_value()) {
-      RETURN_IF_ERROR(
-          benchmark_info_->TimeMarkDelta("executor_decode_and_sample"));
-    }
-    RETURN_IF_ERROR(executor_.Decode(output_tokens_));
-    if (benchmark_info_.has_value()) {
-      RETURN_IF_ERROR(
-          benchmark_info_->TimeMarkDelta("executor_decode_and_sample"));
+  // Runs one step of the decode process with sampling done internally from
+  // the Executor.
+  absl::StatusOr<DecodeResult> Run() {
+    if (NumBufferedSteps() == 0) {
+      RETURN_IF_ERROR(DecodeNextTokens());
     }
-    LITERT_ASSIGN_OR_RETURN_ABSL(auto output_tokens_span,
-                                 ReferTensorBufferAsSpan<int>(output_tokens_));
-    if (output_tokens_span.size() != 1) {
-      return absl::InternalError("Unexpected number of decoded tokens.");
-    }
-
-    ASSIGN_OR_RETURN(auto token_ids,
-                     tokenizer_.TensorBufferToTokenIds(output_tokens_));
-    ASSIGN_OR_RETURN(token_ids_, previous_token_ids.empty()
-                                     ? token_ids
-                                     : tokenizer_.MergeTokenIds(
-                                           previous_token_ids, token_ids));
-    auto decoded_result =
-        tokenizer_.TokenIdsToTexts(num_output_candidates_, token_ids_);
-    if (Tokenizer::IsIncompleteBpeSequence(decoded_result)) {
-      return kContinue;
+    for (int i = 0; i < num_output_candidates_; ++i) {
+      latest_token_ids_[i] =
+          buffered_token_ids_[i * num_buffered_steps_ + next_buffered_step_];
     }
-    ASSIGN_OR_RETURN(result_tokens_, decoded_result);
+    ++next_buffered_step_;
+    RETURN_IF_ERROR(DetokenizeLatestTokens(detokenizers_, latest_token_ids_,
+                                           result_tokens_));
 
-    RETURN_IF_ERROR(stop_token_detector_.ProcessTokens(output_tokens_span));
+    RETURN_IF_ERROR(stop_token_detector_.ProcessTokens(latest_token_ids_));
     ASSIGN_OR_RETURN(bool hit_stop_tokens, stop_token_detector_.AllDone());
-    return hit_stop_tokens ? kDone : kPartial;
+    return hit_stop_tokens ? kDone : kContinue;
+  }
+
+  // Returns the current step of the executor, not counting the tokens that are
+  // decoded but not yet returned by Run().
+  absl::StatusOr<int> GetCurrentStep() const {
+    ASSIGN_OR_RETURN(int current_step, executor_.GetCurrentStep());
+    return current_step - NumBufferedSteps();
+  }
+
+  // Rolls the executor back over the tokens that are decoded but not returned
+  // by Run(), e.g. the tokens after a stop token in the last multi-step
+  // decode, such that the next turn continues from the last returned token.
+  absl::Status DiscardBufferedTokens() {
+    const int num_buffered_steps = NumBufferedSteps();
+    if (num_buffered_steps == 0) {
+      return absl::OkStatus();
+    }
+    ASSIGN_OR_RETURN(int current_step, executor_.GetCurrentStep());
+    // The last returned token becomes the pending input token.
+    RETURN_IF_ERROR(
+        executor_.Rollback(current_step - num_buffered_steps - 1,
+                           buffered_token_ids_[next_buffered_step_ - 1]));
+    next_buffered_step_ = num_buffered_steps_;
+    return absl::OkStatus();
   }
 
   absl::Span<float> GetScores() { return scores_span_; }
@@ -244,36 +630,606 @@ class DecodeInternalSamplingOneStep {
     return stop_token_detector_.GetStopTokensFound();
   }
 
-  const std::vector<std::vector<int>>& GetTokenIds() const {
-    return token_ids_;
+ private:
+  int NumBufferedSteps() const {
+    return num_buffered_steps_ - next_buffered_step_;
+  }
+
+  // Decodes the next tokens with one executor call, which runs up to
+  // `num_steps_per_sync_` steps without exceeding the kv-cache size.
+  absl::Status DecodeNextTokens() {
+    int num_steps = 1;
+    if (num_steps_per_sync_ > 1) {
+      ASSIGN_OR_RETURN(int current_step, executor_.GetCurrentStep());
+      num_steps =
+          std::clamp(max_num_tokens_ - current_step, 1, num_steps_per_sync_);
+    }
+    litert::TensorBuffer* output_tokens = &output_tokens_;
+    litert::TensorBuffer last_output_tokens;
+    if (num_steps != num_steps_per_sync_) {
+      // Only the last executor call before the kv-cache is full runs fewer
+      // steps, so the buffer is created for it on the fly.
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          last_output_tokens,
+          CreateTensorBuffer<int>({num_output_candidates_, num_steps}));
+      output_tokens = &last_output_tokens;
+    }
+    if (benchmark_info_.has_value()) {
+      RETURN_IF_ERROR(
+          benchmark_info_->TimeMarkDelta("executor_decode_and_sample"));
+    }
+    RETURN_IF_ERROR(executor_.Decode(*output_tokens));
+    if (benchmark_info_.has_value()) {
+      RETURN_IF_ERROR(
+          benchmark_info_->TimeMarkDelta("executor_decode_and_sample"));
+    }
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto output_tokens_span,
+                                 ReferTensorBufferAsSpan<int>(*output_tokens));
+    if (output_tokens_span.size() != num_output_candidates_ * num_steps) {
+      return absl::InternalError("Unexpected number of decoded tokens.");
+    }
+    buffered_token_ids_.assign(output_tokens_span.begin(),
+                               output_tokens_span.end());
+    num_buffered_steps_ = num_steps;
+    next_buffered_step_ = 0;
+    return absl::OkStatus();
   }
 
- private:
   LlmExecutor& executor_;
-  Tokenizer& tokenizer_;
   const int num_output_candidates_;
+  const int num_steps_per_sync_;
+  const int max_num_tokens_;
   std::optional<BenchmarkInfo> benchmark_info_;
   std::vector<bool> stop_tokens_found_;
   litert::TensorBuffer output_tokens_;
-  std::vector<std::vector<int>> token_ids_;
+  // The tokens of the last executor call in the layout of the output tokens,
+  // i.e. [num_output_candidates, num_buffered_steps], and the next step of
+  // them to be returned by Run().
+  std::vector<int> buffered_token_ids_;
+  int num_buffered_steps_ = 0;
+  int next_buffered_step_ = 0;
+  // The tokens returned by the latest Run(), one per output candidate.
+  std::vector<int> latest_token_ids_;
+  std::vector<std::unique_ptr<StreamingDetokenizer>> detokenizers_;
   std::vector<std::string> result_tokens_;
   absl::Span<float> scores_span_;
   StopTokenDetector stop_token_detector_;
 };
 
+// Runs the output processing of the decode steps, i.e. the detokenization and
+// the observer callback, on a separate thread, so that it overlaps with the
+// executor computing the next step. The steps are processed in the order they
+// are scheduled, one at a time.
+class DecodeOutputWorker {
+ public:
+  DecodeOutputWorker(Tokenizer& tokenizer, int num_output_candidates,
+                     InferenceObservable& observer)
+      : num_output_candidates_(num_output_candidates),
+        observer_(observer),
+        detokenizers_(
+            CreateStreamingDetokenizers(tokenizer, num_output_candidates)),
+        thread_pool_(/*name_prefix=*/"decode_output", /*max_num_threads=*/1) {}
+
+  // Schedules the output processing of one decode step, with the latest token
+  // id and score of each output candidate. The previous step must be
+  // finished with Wait() first, so its buffers are reused for this one.
+  absl::Status Schedule(absl::Span<const int> token_ids,
+                        const std::vector<bool>& stop_tokens_found,
+                        absl::Span<const float> scores) {
+    token_ids_.assign(token_ids.begin(), token_ids.end());
+    stop_tokens_found_ = stop_tokens_found;
+    scores_.assign(scores.begin(), scores.end());
+    return thread_pool_.Schedule([this]() { status_ = Process(); });
+  }
+
+  // Waits for the scheduled step and returns its status.
+  absl::Status Wait() {
+    RETURN_IF_ERROR(thread_pool_.WaitUntilDone(absl::InfiniteDuration()));
+    return status_;
+  }
+
+ private:
+  absl::Status Process() {
+    // The texts of the candidates done at this step are dropped, so they are
+    // not detokenized.
+    RETURN_IF_ERROR(DetokenizeLatestTokens(detokenizers_, token_ids_, texts_,
+                                           &stop_tokens_found_));
+
+    Responses responses(num_output_candidates_);
+    for (int j = 0; j < num_output_candidates_; ++j) {
+      // Only add the result if the stop token has not been found yet.
+      if (!stop_tokens_found_[j]) {
+        AppendDecodedText(texts_[j], responses.GetMutableResponseTexts()[j]);
+        responses.GetMutableScores()[j] = scores_[j];
+      }
+    }
+    if (HasText(responses)) {
+      LITERT_LM_TRACE_SCOPE("observer_on_next");
+      observer_.OnNext(responses);
+    }
+    // The candidates stopped at this step end their streams.
+    if (num_output_candidates_ > 1) {
+      candidates_done_.resize(num_output_candidates_);
+      for (int j = 0; j < num_output_candidates_; ++j) {
+        if (stop_tokens_found_[j] && !candidates_done_[j]) {
+          candidates_done_[j] = true;
+          observer_.OnCandidateDone(j);
+        }
+      }
+    }
+    return absl::OkStatus();
+  }
+
+  const int num_output_candidates_;
+  InferenceObservable& observer_;
+  std::vector<std::unique_ptr<StreamingDetokenizer>> detokenizers_;
+  // The step being processed, and its texts.
+  std::vector<int> token_ids_;
+  std::vector<bool> stop_tokens_found_;
+  std::vector<float> scores_;
+  std::vector<std::string> texts_;
+  // The candidates reported to the observer as stopped.
+  std::vector<bool> candidates_done_;
+  absl::Status status_;
+  // Declared last, such that the thread is joined before the members it uses
+  // are destroyed.
+  ThreadPool thread_pool_;
+};
+
+// Same as DecodeCustomSamplingStreaming, but the output processing of each
+// step runs on a DecodeOutputWorker while the executor computes the next step.
+// The stop tokens are still detected on the calling thread, so no step is
+// decoded past them.
+absl::Status DecodeCustomSamplingStreamingOverlapped(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector, int num_output_candidates,
+    Sampler& sampler, litert::TensorBuffer& decoded_ids,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    InferenceObservable* absl_nonnull observer,
+    const std::optional<ContextShiftConfig>& context_shift_config,
+    const CancelParams* absl_nullable cancel_params,
+    const DecodeBudget* absl_nullable decode_budget) {
+  int benchmark_decode_token_count = 0;
+  if (benchmark_info.has_value()) {
+    benchmark_decode_token_count =
+        benchmark_info->GetBenchmarkParams().num_decode_tokens();
+    RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnStart());
+  }
+  int num_decode_steps = 0;
+  const int max_num_tokens = TryGetMaxNumTokens(executor);
+  StopTokenDetector detector = stop_token_detector;
+  LITERT_ASSIGN_OR_RETURN_ABSL(
+      auto scores_tensor, CreateTensorBuffer<float>({num_output_candidates}));
+  std::optional<TopKLogitsBuffers> topk_buffers =
+      MaybeCreateTopKLogitsBuffers(executor, sampler, num_output_candidates);
+  DecodeOutputWorker output_worker(tokenizer, num_output_candidates, *observer);
+  bool has_scheduled_output = false;
+  // The decode inputs refer to the decoded ids of the previous step, so they
+  // are created once for all the steps.
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto duplicate_decoded_ids,
+                               decoded_ids.Duplicate());
+  const ExecutorInputs inputs(
+      ExecutorTextData(std::move(duplicate_decoded_ids)), std::nullopt,
+      std::nullopt);
+  std::vector<bool> active_rows;
+
+  // Finishes the output processing of the last scheduled step, and reports
+  // the first error to the observer.
+  auto wait_for_output = [&]() -> absl::Status {
+    if (!has_scheduled_output) {
+      return absl::OkStatus();
+    }
+    has_scheduled_output = false;
+    return output_worker.Wait();
+  };
+  auto fail = [&](absl::Status status) -> absl::Status {
+    wait_for_output().IgnoreError();
+    observer->OnError(status);
+    return status;
+  };
+
+  while (true) {
+    if (absl::Status status = CheckCancelled(cancel_params); !status.ok()) {
+      return fail(status);
+    }
+    PaceDecodeStep(decode_budget);
+    // The executor computes this step while the worker processes the output of
+    // the previous one.
+    SkipFinishedCandidates(detector.GetStopTokensFound(), sampler,
+                           active_rows);
+    absl::Status status =
+        DecodeAndSample(executor, sampler, inputs, topk_buffers, decoded_ids,
+                        scores_tensor, benchmark_info);
+    if (!status.ok()) {
+      return fail(status);
+    }
+    // The decoded ids are of shape [num_output_candidates, 1], i.e. the latest
+    // token id of each candidate, read in place.
+    auto latest_token_ids = ReferTensorBufferAsSpan<int>(decoded_ids);
+    if (!latest_token_ids) {
+      return fail(absl::InternalError(latest_token_ids.Error().Message()));
+    }
+    status = detector.ProcessTokens(*latest_token_ids);
+    if (!status.ok()) {
+      return fail(status);
+    }
+    absl::StatusOr<bool> hit_stop_tokens = detector.AllDone();
+    if (!hit_stop_tokens.ok()) {
+      return fail(hit_stop_tokens.status());
+    }
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto scores_span,
+                                 ReferTensorBufferAsSpan<float>(scores_tensor));
+
+    status = wait_for_output();
+    if (!status.ok()) {
+      return fail(status);
+    }
+    status = output_worker.Schedule(*latest_token_ids,
+                                    detector.GetStopTokensFound(),
+                                    scores_span);
+    if (!status.ok()) {
+      return fail(status);
+    }
+    has_scheduled_output = true;
+    num_decode_steps++;
+    if (benchmark_info.has_value()) {
+      status = benchmark_info->TimeDecodeStep();
+      if (!status.ok()) {
+        return fail(status);
+      }
+    }
+
+    auto current_step = executor.GetCurrentStep();
+    if (current_step.ok()) {
+      current_step = MaybeShiftContext(executor, *current_step,
+                                       /*num_new_tokens=*/0, max_num_tokens,
+                                       context_shift_config);
+    }
+    if (!current_step.ok()) {
+      return fail(current_step.status());
+    }
+    if (ShouldStop(*hit_stop_tokens, benchmark_decode_token_count,
+                   num_decode_steps, *current_step, max_num_tokens,
+                   /*observer=*/nullptr) ||
+        IsBudgetSpent(decode_budget, num_decode_steps)) {
+      status = wait_for_output();
+      if (!status.ok()) {
+        observer->OnError(status);
+        return status;
+      }
+      // Reports the error of a full kv-cache, now that all the outputs are
+      // delivered.
+      ShouldStop(*hit_stop_tokens, benchmark_decode_token_count,
+                 num_decode_steps, *current_step, max_num_tokens, observer);
+      break;
+    }
+  }
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnEnd(num_decode_steps *
+                                                      num_output_candidates));
+  }
+  observer->OnDone();
+  return absl::OkStatus();
+}
+
+// The number of encoded prompt chunks waiting to be prefilled, beyond which
+// the encoding waits for the prefill.
+constexpr int kMaxNumPendingChunks = 4;
+
+// A bounded queue of the token ids of the prompt chunks, from the thread
+// encoding them to the thread prefilling them.
+class EncodedChunkQueue {
+ public:
+  // Adds the token ids of the next chunk, blocking while the queue is full.
+  // Returns false if the queue is closed, i.e. the chunk is not needed.
+  bool Push(absl::StatusOr<std::vector<int>> token_ids) {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &EncodedChunkQueue::CanPush));
+    if (closed_) {
+      return false;
+    }
+    chunks_.push_back(std::move(token_ids));
+    return true;
+  }
+
+  // Marks that all the chunks are pushed.
+  void FinishPushing() {
+    absl::MutexLock lock(&mutex_);
+    finished_ = true;
+  }
+
+  // Returns the token ids of the next chunk, blocking until it is pushed, or
+  // std::nullopt once all the chunks are popped.
+  std::optional<absl::StatusOr<std::vector<int>>> Pop() {
+    absl::MutexLock lock(&mutex_);
+    mutex_.Await(absl::Condition(this, &EncodedChunkQueue::CanPop));
+    if (chunks_.empty()) {
+      return std::nullopt;
+    }
+    absl::StatusOr<std::vector<int>> token_ids = std::move(chunks_.front());
+    chunks_.pop_front();
+    return token_ids;
+  }
+
+  // Stops the pushing, e.g. when the prefill failed.
+  void Close() {
+    absl::MutexLock lock(&mutex_);
+    closed_ = true;
+  }
+
+ private:
+  bool CanPush() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return closed_ || chunks_.size() < kMaxNumPendingChunks;
+  }
+  bool CanPop() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_) {
+    return finished_ || !chunks_.empty();
+  }
+
+  absl::Mutex mutex_;
+  std::deque<absl::StatusOr<std::vector<int>>> chunks_ ABSL_GUARDED_BY(mutex_);
+  bool finished_ ABSL_GUARDED_BY(mutex_) = false;
+  bool closed_ ABSL_GUARDED_BY(mutex_) = false;
+};
+
+// Prefills the prompt while it is being encoded: the chunks of
+// SplitTextForEncoding() are encoded in order on `encode_thread_pool`, and the
+// calling thread prefills their token ids as they come, in runs of a multiple
+// of the longest prefill signature when the executor has one. Returns the
+// number of prefilled tokens, and sets `last_token_id`.
+absl::StatusOr<int> PrefillStreaming(
+    LlmExecutor& executor, Tokenizer& tokenizer, absl::string_view prompt,
+    int bos_token_id, bool wait_for_completion,
+    ThreadPool& encode_thread_pool,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const PromptAffixTokenIds* absl_nullable affix_token_ids,
+    std::vector<int>* absl_nullable prompt_token_ids,
+    const CancelParams* absl_nullable cancel_params, int& last_token_id) {
+  const int max_prefill_length = executor.GetMaxPrefillLength().value_or(0);
+  EncodedChunkQueue queue;
+  absl::Notification encoded;
+  RETURN_IF_ERROR(encode_thread_pool.Schedule([&]() {
+    for (absl::string_view chunk :
+         SplitTextForEncoding(prompt, kDefaultMinEncodeChunkSize)) {
+      absl::StatusOr<std::vector<int>> token_ids;
+      {
+        LITERT_LM_TRACE_SCOPE("tokenize");
+        token_ids = tokenizer.TextToTokenIds(chunk);
+      }
+      if (!queue.Push(std::move(token_ids))) {
+        break;
+      }
+    }
+    queue.FinishPushing();
+    encoded.Notify();
+  }));
+
+  // The pending ids are prefilled once the next chunk is encoded, such that
+  // the last call is the one waiting for the completion if asked to.
+  std::vector<int> pending_ids = {bos_token_id};
+  if (affix_token_ids != nullptr) {
+    pending_ids.insert(pending_ids.end(), affix_token_ids->prefix.begin(),
+                       affix_token_ids->prefix.end());
+  }
+  int num_prefill_tokens = pending_ids.size();
+  absl::Status status;
+  while (status.ok()) {
+    std::optional<absl::StatusOr<std::vector<int>>> chunk = queue.Pop();
+    if (!chunk.has_value()) {
+      break;
+    }
+    if (!chunk->ok()) {
+      status = chunk->status();
+      break;
+    }
+    const int num_ready_ids =
+        max_prefill_length > 0
+            ? pending_ids.size() / max_prefill_length * max_prefill_length
+            : pending_ids.size();
+    if (num_ready_ids > 0) {
+      const absl::Span<const int> ready_ids =
+          absl::MakeConstSpan(pending_ids).first(num_ready_ids);
+      if (prompt_token_ids != nullptr) {
+        prompt_token_ids->insert(prompt_token_ids->end(), ready_ids.begin(),
+                                 ready_ids.end());
+      }
+      status = PrefillTokenIds(executor, tokenizer, ready_ids,
+                               /*wait_for_completion=*/false, benchmark_info,
+                               cancel_params);
+      pending_ids.erase(pending_ids.begin(),
+                        pending_ids.begin() + num_ready_ids);
+    }
+    pending_ids.insert(pending_ids.end(), (*chunk)->begin(), (*chunk)->end());
+    num_prefill_tokens += (*chunk)->size();
+  }
+  // The encoding task refers to the locals, so it is joined before returning.
+  queue.Close();
+  encoded.WaitForNotification();
+  RETURN_IF_ERROR(status);
+
+  if (affix_token_ids != nullptr) {
+    pending_ids.insert(pending_ids.end(), affix_token_ids->suffix.begin(),
+                       affix_token_ids->suffix.end());
+    num_prefill_tokens += affix_token_ids->suffix.size();
+  }
+  // Each chunk starts with a word, so the last one has tokens.
+  RET_CHECK(!pending_ids.empty()) << "The last chunk of the prompt is empty.";
+  last_token_id = pending_ids.back();
+  if (prompt_token_ids != nullptr) {
+    prompt_token_ids->insert(prompt_token_ids->end(), pending_ids.begin(),
+                             pending_ids.end());
+  }
+  RETURN_IF_ERROR(PrefillTokenIds(executor, tokenizer, pending_ids,
+                                  wait_for_completion, benchmark_info,
+                                  cancel_params));
+  return num_prefill_tokens;
+}
+
+// Returns the layout of a document segment of `num_tokens` positions of the
+// kv-cache tensor of `layout`.
+KvCacheTensorLayout GetSegmentLayout(KvCacheTensorLayout layout,
+                                     int num_tokens) {
+  layout.dims[layout.seq_dim] = num_tokens;
+  return layout;
+}
+
+// Returns a kv-cache of `layouts` in host memory, filled with zeros.
+ExecutorCheckpoint::KvCacheData CreateKvCache(const KvCacheLayouts& layouts) {
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  for (const auto& [name, layout] : layouts) {
+    kv_cache[name].resize(layout.SizeInBytes());
+  }
+  return kv_cache;
+}
+
+// Copies `segment` into the positions of `kv_cache` from `begin` on.
+absl::Status CopySegmentIntoKvCache(const DocumentCache::Segment& segment,
+                                    const KvCacheLayouts& layouts, int begin,
+                                    ExecutorCheckpoint::KvCacheData& kv_cache) {
+  for (const auto& [name, layout] : layouts) {
+    auto it = segment.kv_cache.find(name);
+    RET_CHECK(it != segment.kv_cache.end())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The document segment has no kv-cache tensor " << name;
+    RETURN_IF_ERROR(CopyKvCacheTokens(
+        it->second, GetSegmentLayout(layout, segment.num_tokens),
+        /*source_begin=*/0, layout, begin, segment.num_tokens,
+        absl::MakeSpan(kv_cache[name])));
+  }
+  return absl::OkStatus();
+}
+
+// Prefills `token_ids` after the current state of the executor, and returns
+// the kv-cache segment of their positions from `begin` on. One more id is
+// prefilled and left pending, such that the last of `token_ids` is in the
+// kv-cache too.
+absl::StatusOr<DocumentCache::Segment> PrefillSegment(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    absl::Span<const int> token_ids, int begin, const KvCacheLayouts& layouts,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const CancelParams* absl_nullable cancel_params) {
+  std::vector<int> ids(token_ids.begin(), token_ids.end());
+  ids.push_back(token_ids.back());
+  RETURN_IF_ERROR(PrefillTokenIds(executor, tokenizer, ids,
+                                  /*wait_for_completion=*/true,
+                                  benchmark_info, cancel_params));
+  ASSIGN_OR_RETURN(auto checkpoint, executor.SaveState());
+  RET_CHECK(checkpoint->GetKvCacheScales().empty())
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "Document segments of an int8 kv-cache are not supported.";
+  DocumentCache::Segment segment;
+  segment.num_tokens = token_ids.size();
+  for (const auto& [name, layout] : layouts) {
+    ASSIGN_OR_RETURN(auto contents, checkpoint->GetKvCacheTensor(name));
+    const KvCacheTensorLayout segment_layout =
+        GetSegmentLayout(layout, segment.num_tokens);
+    std::vector<uint8_t>& segment_contents = segment.kv_cache[name];
+    segment_contents.resize(segment_layout.SizeInBytes());
+    RETURN_IF_ERROR(CopyKvCacheTokens(contents, layout, begin, segment_layout,
+                                      /*target_begin=*/0, segment.num_tokens,
+                                      absl::MakeSpan(segment_contents)));
+  }
+  return segment;
+}
+
 }  // namespace
 
+absl::Status CheckCancelled(const CancelParams* cancel_params) {
+  if (cancel_params == nullptr) {
+    return absl::OkStatus();
+  }
+  if (cancel_params->cancel != nullptr &&
+      cancel_params->cancel->load(std::memory_order_relaxed)) {
+    return absl::CancelledError("The request is cancelled.");
+  }
+  if (cancel_params->deadline != absl::InfiniteFuture() &&
+      absl::Now() >= cancel_params->deadline) {
+    return absl::DeadlineExceededError("The request deadline is exceeded.");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status PrefillTokenIds(
+    LlmExecutor& executor, Tokenizer& tokenizer, absl::Span<const int> ids,
+    bool wait_for_completion, std::optional<BenchmarkInfo>& benchmark_info,
+    const CancelParams* absl_nullable cancel_params) {
+  LITERT_LM_TRACE_SCOPE("prefill");
+  RETURN_IF_ERROR(CheckCancelled(cancel_params));
+  ASSIGN_OR_RETURN(auto ids_buffer, tokenizer.TokenIdsToTensorBuffer(ids));
+  ExecutorPrefillParams params;
+  params.SetWaitForCompletion(wait_for_completion);
+  if (cancel_params != nullptr) {
+    params.SetCancelFlag(cancel_params->cancel);
+    params.SetDeadline(cancel_params->deadline);
+  }
+  RETURN_IF_ERROR(executor.Prefill(
+      ExecutorInputs(ExecutorTextData(std::move(ids_buffer)), std::nullopt,
+                     std::nullopt),
+      params));
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimePrefillStep());
+  }
+  return absl::OkStatus();
+}
+
 absl::StatusOr<int> Prefill(LlmExecutor& executor, Tokenizer& tokenizer,
                             absl::string_view prompt, int bos_token_id,
                             bool wait_for_completion,
-                            std::optional<BenchmarkInfo>& benchmark_info) {
+                            std::optional<BenchmarkInfo>& benchmark_info,
+                            PrefixCache* absl_nullable prefix_cache,
+                            std::vector<int>* absl_nullable context_token_ids,
+                            const std::optional<ContextShiftConfig>&
+                                context_shift_config,
+                            std::vector<int>* absl_nullable prompt_token_ids,
+                            ThreadPool* absl_nullable encode_thread_pool,
+                            const PromptAffixTokenIds* absl_nullable
+                                affix_token_ids,
+                            const CancelParams* absl_nullable cancel_params) {
   int benchmark_prefill_token_count = 0;
   if (benchmark_info.has_value()) {
     benchmark_prefill_token_count =
         benchmark_info->GetBenchmarkParams().num_prefill_tokens();
     RETURN_IF_ERROR(benchmark_info->TimePrefillTurnStart());
   }
-  ASSIGN_OR_RETURN(std::vector<int> ids, tokenizer.TextToTokenIds(prompt));
+  const int max_num_tokens = TryGetMaxNumTokens(executor);
+  if (encode_thread_pool != nullptr && prefix_cache == nullptr &&
+      benchmark_prefill_token_count == 0 &&
+      prompt.size() >= 2 * kDefaultMinEncodeChunkSize) {
+    // No token is shorter than a byte, so a prompt of fewer bytes than the
+    // free kv-cache fits without knowing its number of tokens upfront.
+    ASSIGN_OR_RETURN(int current_step, executor.GetCurrentStep());
+    const int num_affix_tokens =
+        affix_token_ids == nullptr ? 0
+                                   : affix_token_ids->prefix.size() +
+                                         affix_token_ids->suffix.size();
+    if (current_step + static_cast<int>(prompt.size()) + num_affix_tokens + 1 <
+        max_num_tokens) {
+      int last_token_id;
+      ASSIGN_OR_RETURN(
+          int num_prefill_tokens,
+          PrefillStreaming(executor, tokenizer, prompt, bos_token_id,
+                           wait_for_completion, *encode_thread_pool,
+                           benchmark_info, affix_token_ids, prompt_token_ids,
+                           cancel_params, last_token_id));
+      if (benchmark_info.has_value()) {
+        RETURN_IF_ERROR(
+            benchmark_info->TimePrefillTurnEnd(num_prefill_tokens));
+      }
+      return last_token_id;
+    }
+  }
+  absl::StatusOr<std::vector<int>> tokenized_ids;
+  {
+    LITERT_LM_TRACE_SCOPE("tokenize");
+    tokenized_ids =
+        tokenizer.TextToTokenIdsInChunks(prompt, encode_thread_pool);
+  }
+  ASSIGN_OR_RETURN(std::vector<int> ids, std::move(tokenized_ids));
+  if (affix_token_ids != nullptr) {
+    ids.insert(ids.begin(), affix_token_ids->prefix.begin(),
+               affix_token_ids->prefix.end());
+    ids.insert(ids.end(), affix_token_ids->suffix.begin(),
+               affix_token_ids->suffix.end());
+  }
   if (benchmark_prefill_token_count > 0) {
     // If benchmark is enabled, we will use the benchmark prefill token count
     // to set the prefill token count.
@@ -281,35 +1237,268 @@ absl::StatusOr<int> Prefill(LlmExecutor& executor, Tokenizer& tokenizer,
   } else {
     ids.insert(ids.begin(), bos_token_id);
   }
-  const int max_num_tokens = TryGetMaxNumTokens(executor);
   if (ids.size() >= max_num_tokens) {
     return absl::InvalidArgumentError(absl::StrCat(
         "Input token ids are too long. Exceeding the maximum number of tokens "
         "allowed: ",
         ids.size(), " >= ", max_num_tokens));
   }
-  ASSIGN_OR_RETURN(auto ids_buffer, tokenizer.TokenIdsToTensorBuffer(ids));
-  LITERT_ASSIGN_OR_RETURN_ABSL(auto ids_buffer_span,
-                               ReferTensorBufferAsSpan<int>(ids_buffer));
-  if (ids_buffer_span.empty()) {
+  if (ids.empty()) {
     return absl::InternalError("Input token ids are empty.");
   }
-  const int last_token_id = ids_buffer_span.back();
-  ExecutorPrefillParams params;
-  params.SetWaitForCompletion(wait_for_completion);
-  RETURN_IF_ERROR(
-      executor.Prefill(ExecutorInputs(ExecutorTextData(std::move(ids_buffer)),
-                                      std::nullopt, std::nullopt),
-                       params));
+  const int last_token_id = ids.back();
+  if (prompt_token_ids != nullptr) {
+    prompt_token_ids->insert(prompt_token_ids->end(), ids.begin(), ids.end());
+  }
+
+  // The token ids of the whole context once this prefill is done, which is
+  // the key of the prefix cache.
+  std::vector<int> prefix_token_ids;
+  if (prefix_cache != nullptr) {
+    RET_CHECK(context_token_ids != nullptr)
+        << "The context token ids are required by the prefix cache.";
+    prefix_token_ids = *context_token_ids;
+    prefix_token_ids.insert(prefix_token_ids.end(), ids.begin(), ids.end());
+    // Only prefixes longer than the current context are worth restoring, the
+    // shorter ones are already in the executor.
+    std::optional<PrefixCache::Match> match = prefix_cache->Lookup(
+        prefix_token_ids, /*min_num_tokens=*/context_token_ids->size());
+    int num_reused_tokens = 0;
+    if (match.has_value()) {
+      RETURN_IF_ERROR(executor.RestoreState(*match->checkpoint));
+      num_reused_tokens =
+          match->num_tokens - static_cast<int>(context_token_ids->size());
+      ids.erase(ids.begin(), ids.begin() + num_reused_tokens);
+    }
+    if (benchmark_info.has_value()) {
+      benchmark_info->RecordPrefixCacheLookup(
+          match.has_value(), num_reused_tokens, prefix_cache->SizeInBytes());
+    }
+  }
+
+  const int num_prefill_tokens = ids.size();
+  if (prefix_cache == nullptr && !ids.empty()) {
+    // The prefix cache keys the checkpoints by the whole context, which a
+    // shift would break, so the context is only shifted without it.
+    ASSIGN_OR_RETURN(int current_step, executor.GetCurrentStep());
+    RETURN_IF_ERROR(MaybeShiftContext(executor, current_step,
+                                      num_prefill_tokens, max_num_tokens,
+                                      context_shift_config)
+                        .status());
+  }
+  if (!ids.empty()) {
+    RETURN_IF_ERROR(PrefillTokenIds(executor, tokenizer, ids,
+                                    wait_for_completion, benchmark_info,
+                                    cancel_params));
+    if (prefix_cache != nullptr && !prefix_cache->Contains(prefix_token_ids)) {
+      ASSIGN_OR_RETURN(auto checkpoint, executor.SaveState());
+      prefix_cache->Insert(prefix_token_ids, std::move(checkpoint));
+    }
+  }
+  if (prefix_cache != nullptr) {
+    *context_token_ids = std::move(prefix_token_ids);
+  }
   if (benchmark_info.has_value()) {
-    RETURN_IF_ERROR(benchmark_info->TimePrefillTurnEnd(ids_buffer_span.size()));
+    RETURN_IF_ERROR(benchmark_info->TimePrefillTurnEnd(num_prefill_tokens));
   }
   return last_token_id;
 }
 
-absl::StatusOr<Responses> Decode(LlmExecutor& executor, Tokenizer& tokenizer,
-                                 const StopTokenDetector& stop_token_detector,
-                                 std::optional<BenchmarkInfo>& benchmark_info) {
+absl::StatusOr<int> PrefillWithImages(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    VisionExecutor& vision_executor, absl::Span<const int> token_ids,
+    absl::Span<const ::litert::TensorBuffer> images, bool wait_for_completion,
+    ThreadPool& encode_thread_pool,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const CancelParams* absl_nullable cancel_params) {
+  RET_CHECK(!token_ids.empty()).SetCode(absl::StatusCode::kInvalidArgument)
+      << "There are no token ids to prefill.";
+  // The start of the run of special tokens of each image.
+  std::vector<size_t> image_starts;
+  for (size_t i = 0; i < token_ids.size(); ++i) {
+    if (token_ids[i] == ExecutorVisionData::kSpecialToken &&
+        (i == 0 || token_ids[i - 1] != ExecutorVisionData::kSpecialToken)) {
+      image_starts.push_back(i);
+    }
+  }
+  RET_CHECK_EQ(image_starts.size(), images.size())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Expected one run of vision special tokens per image.";
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimePrefillTurnStart());
+  }
+
+  // The images are encoded on the pool, all in one batch if the encoder has a
+  // batch dimension, or else one after the other, while the calling thread
+  // prefills the tokens before each of them.
+  absl::StatusOr<std::vector<int>> input_dimension =
+      vision_executor.GetExpectedInputDimension();
+  const size_t images_per_encoding =
+      input_dimension.ok() && !input_dimension->empty() &&
+              (*input_dimension)[0] > 1
+          ? images.size()
+          : 1;
+  std::vector<TaskFuture<absl::StatusOr<std::vector<ExecutorVisionData>>>>
+      encodings;
+  absl::Status status;
+  for (size_t first = 0; first < images.size(); first += images_per_encoding) {
+    absl::Span<const ::litert::TensorBuffer> batch =
+        images.subspan(first, images_per_encoding);
+    auto encoding = encode_thread_pool.Submit(
+        [&vision_executor,
+         batch]() -> absl::StatusOr<std::vector<ExecutorVisionData>> {
+          LITERT_LM_TRACE_SCOPE("vision_encode");
+          return vision_executor.EncodeBatch(batch);
+        });
+    if (!encoding.ok()) {
+      status = encoding.status();
+      break;
+    }
+    encodings.push_back(*std::move(encoding));
+  }
+
+  // Each segment runs from the start of an image to the start of the next
+  // one not filled yet, the first from the start of the ids, and the
+  // embeddings of the images of an encoding are filled in once the tokens
+  // before the first of them are prefilled.
+  size_t num_filled_images = 0;
+  size_t num_joined_encodings = 0;
+  size_t segment_begin = 0;
+  while (status.ok()) {
+    const size_t segment_end = num_filled_images < image_starts.size()
+                                   ? image_starts[num_filled_images]
+                                   : token_ids.size();
+    if (segment_end > segment_begin) {
+      status = PrefillTokenIds(
+          executor, tokenizer,
+          token_ids.subspan(segment_begin, segment_end - segment_begin),
+          wait_for_completion && segment_end == token_ids.size(),
+          benchmark_info, cancel_params);
+    }
+    segment_begin = segment_end;
+    if (!status.ok() || num_filled_images == image_starts.size()) {
+      break;
+    }
+    absl::StatusOr<std::vector<ExecutorVisionData>> vision_data =
+        encodings[num_joined_encodings++].Get(absl::InfiniteDuration());
+    const size_t num_images =
+        std::min(images_per_encoding, images.size() - num_filled_images);
+    if (!vision_data.ok()) {
+      status = vision_data.status();
+    } else if (vision_data->size() != num_images) {
+      status = absl::InternalError(absl::StrCat(
+          "The vision executor returned the vision data of ",
+          vision_data->size(), " images for ", num_images, "."));
+    } else {
+      status =
+          executor.FillVisionEmbeddingsBatch(*vision_data, num_filled_images);
+    }
+    num_filled_images += num_images;
+  }
+  // The encoding tasks refer to the images, so they are joined before
+  // returning.
+  for (size_t i = num_joined_encodings; i < encodings.size(); ++i) {
+    encodings[i].Get(absl::InfiniteDuration()).status().IgnoreError();
+  }
+  RETURN_IF_ERROR(status);
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimePrefillTurnEnd(token_ids.size()));
+  }
+  return token_ids.back();
+}
+
+absl::Status PrefillDocuments(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    absl::Span<const int> prefix_token_ids,
+    absl::Span<const std::vector<int>> documents,
+    DocumentCache& document_cache,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const CancelParams* absl_nullable cancel_params) {
+  RET_CHECK(!prefix_token_ids.empty())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The documents need a prefix holding at least the start token.";
+  const int prefix_size = prefix_token_ids.size();
+  int num_tokens = prefix_size;
+  for (const std::vector<int>& document : documents) {
+    RET_CHECK(!document.empty()).SetCode(absl::StatusCode::kInvalidArgument)
+        << "The documents must not be empty.";
+    num_tokens += document.size();
+  }
+  ASSIGN_OR_RETURN(const KvCacheLayouts layouts, executor.GetKvCacheLayouts());
+  for (const auto& [name, layout] : layouts) {
+    // The question needs at least one more position.
+    RET_CHECK_LT(num_tokens, layout.NumTokens())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The documents do not fit into the kv-cache.";
+  }
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimePrefillTurnStart());
+  }
+  int num_prefill_tokens = 0;
+  RETURN_IF_ERROR(executor.Reset());
+  std::shared_ptr<const DocumentCache::Segment> prefix_segment =
+      document_cache.Lookup({}, prefix_token_ids);
+  if (prefix_segment == nullptr) {
+    ASSIGN_OR_RETURN(auto segment,
+                     PrefillSegment(executor, tokenizer, prefix_token_ids,
+                                    /*begin=*/0, layouts, benchmark_info,
+                                    cancel_params));
+    num_prefill_tokens += prefix_size;
+    prefix_segment =
+        std::make_shared<const DocumentCache::Segment>(std::move(segment));
+    document_cache.Insert({}, prefix_token_ids, prefix_segment);
+  }
+
+  // The context is gathered in host memory, and restored into the executor
+  // once.
+  ExecutorCheckpoint::KvCacheData kv_cache = CreateKvCache(layouts);
+  RETURN_IF_ERROR(
+      CopySegmentIntoKvCache(*prefix_segment, layouts, /*begin=*/0, kv_cache));
+  // The state right after the prefix, with its last id pending, which the
+  // documents missing from the cache are prefilled from.
+  std::unique_ptr<ExecutorCheckpoint> prefix_checkpoint;
+  int begin = prefix_size;
+  for (const std::vector<int>& document : documents) {
+    std::shared_ptr<const DocumentCache::Segment> segment =
+        document_cache.Lookup(prefix_token_ids, document);
+    if (segment == nullptr) {
+      if (prefix_checkpoint == nullptr) {
+        ExecutorCheckpoint::KvCacheData prefix_kv_cache =
+            CreateKvCache(layouts);
+        RETURN_IF_ERROR(CopySegmentIntoKvCache(*prefix_segment, layouts,
+                                               /*begin=*/0, prefix_kv_cache));
+        prefix_checkpoint = std::make_unique<ExecutorCheckpoint>(
+            prefix_size - 1, prefix_token_ids.back(),
+            std::move(prefix_kv_cache));
+      }
+      RETURN_IF_ERROR(executor.RestoreState(*prefix_checkpoint));
+      ASSIGN_OR_RETURN(auto new_segment,
+                       PrefillSegment(executor, tokenizer, document,
+                                      /*begin=*/prefix_size, layouts,
+                                      benchmark_info, cancel_params));
+      num_prefill_tokens += document.size();
+      segment = std::make_shared<const DocumentCache::Segment>(
+          std::move(new_segment));
+      document_cache.Insert(prefix_token_ids, document, segment);
+    }
+    RETURN_IF_ERROR(CopySegmentIntoKvCache(*segment, layouts, begin, kv_cache));
+    begin += segment->num_tokens;
+  }
+  RETURN_IF_ERROR(executor.RestoreState(ExecutorCheckpoint(
+      num_tokens, /*next_input_token_id=*/-1, std::move(kv_cache))));
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimePrefillTurnEnd(num_prefill_tokens));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Responses> Decode(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const std::optional<ContextShiftConfig>& context_shift_config,
+    const CancelParams* absl_nullable cancel_params,
+    const DecodeBudget* absl_nullable decode_budget) {
   int benchmark_decode_token_count = 0;
   if (benchmark_info.has_value()) {
     benchmark_decode_token_count =
@@ -329,29 +1518,32 @@ absl::StatusOr<Responses> Decode(LlmExecutor& executor, Tokenizer& tokenizer,
       &executor, &tokenizer, num_output_candidates, stop_token_detector,
       benchmark_info);
 
-  // List of tokens from the previous step. Used for merging the current and
-  // previous token ids if needed for BPE encoding.
-  std::vector<std::vector<int>> previous_token_ids;
   while (true) {
-    ASSIGN_OR_RETURN(DecodeResult decode_result,
-                     run_one_step.Run(previous_token_ids));
-    if (decode_result == kContinue) {
-      previous_token_ids = run_one_step.GetTokenIds();
-      continue;
+    if (absl::Status status = CheckCancelled(cancel_params); !status.ok()) {
+      RETURN_IF_ERROR(run_one_step.DiscardBufferedTokens());
+      return status;
     }
-
-    previous_token_ids.resize(0);
-    response_texts[0] +=
-        absl::StrReplaceAll(run_one_step.GetResultTokens()[0], {{"▁", " "}});
+    PaceDecodeStep(decode_budget);
+    ASSIGN_OR_RETURN(DecodeResult decode_result, run_one_step.Run());
+    AppendDecodedText(run_one_step.GetResultTokens()[0], response_texts[0]);
     num_decoded_steps++;
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeDecodeStep());
+    }
 
+    ASSIGN_OR_RETURN(int current_step, run_one_step.GetCurrentStep());
+    ASSIGN_OR_RETURN(current_step,
+                     MaybeShiftContext(executor, current_step,
+                                       /*num_new_tokens=*/0, max_num_tokens,
+                                       context_shift_config));
     if (ShouldStop(decode_result == kDone, benchmark_decode_token_count,
-                   num_decoded_steps, executor.GetCurrentStep().value(),
-                   max_num_tokens,
-                   /*observer=*/nullptr)) {
+                   num_decoded_steps, current_step, max_num_tokens,
+                   /*observer=*/nullptr) ||
+        IsBudgetSpent(decode_budget, num_decoded_steps)) {
       break;
     }
   }
+  RETURN_IF_ERROR(run_one_step.DiscardBufferedTokens());
   if (benchmark_info.has_value()) {
     RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnEnd(num_decoded_steps *
                                                       num_output_candidates));
@@ -359,10 +1551,266 @@ absl::StatusOr<Responses> Decode(LlmExecutor& executor, Tokenizer& tokenizer,
   return responses;
 }
 
-absl::Status DecodeStreaming(LlmExecutor& executor, Tokenizer& tokenizer,
-                             const StopTokenDetector& stop_token_detector,
-                             std::optional<BenchmarkInfo>& benchmark_info,
-                             InferenceObservable* observer) {
+absl::StatusOr<Responses> DecodeSpeculative(
+    LlmExecutor& executor, LlmExecutor& draft_executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector, int num_draft_tokens,
+    std::optional<BenchmarkInfo>& benchmark_info) {
+  if (num_draft_tokens <= 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Number of draft tokens must be positive, got ", num_draft_tokens));
+  }
+  int benchmark_decode_token_count = 0;
+  if (benchmark_info.has_value()) {
+    benchmark_decode_token_count =
+        benchmark_info->GetBenchmarkParams().num_decode_tokens();
+    RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnStart());
+  }
+  // Speculative decoding only produces a single output candidate.
+  StopTokenDetector detector = stop_token_detector;
+  detector.ResetBatch(/*batch_size=*/1);
+  const int max_num_tokens = TryGetMaxNumTokens(executor);
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto draft_tokens,
+                               CreateTensorBuffer<int>({1, 1}));
+  std::vector<int> draft_token_ids;
+  draft_token_ids.reserve(num_draft_tokens + 1);
+  std::vector<int> decoded_ids;
+  int num_decoded_steps = 0;
+  bool done = false;
+  while (!done) {
+    ASSIGN_OR_RETURN(int current_step, executor.GetCurrentStep());
+    if (current_step + num_draft_tokens >= max_num_tokens) {
+      // Not enough kv-cache left to verify another set of draft tokens.
+      break;
+    }
+    // The draft proposes one more token than verified, so that its kv-cache
+    // covers all the draft tokens and the rollback below is a truncation.
+    draft_token_ids.clear();
+    for (int i = 0; i <= num_draft_tokens; ++i) {
+      RETURN_IF_ERROR(draft_executor.Decode(draft_tokens));
+      LITERT_ASSIGN_OR_RETURN_ABSL(auto draft_tokens_span,
+                                   ReferTensorBufferAsSpan<int>(draft_tokens));
+      draft_token_ids.push_back(draft_tokens_span[0]);
+    }
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_verify"));
+    }
+    ASSIGN_OR_RETURN(auto accepted_ids,
+                     executor.VerifyDraftTokens(absl::MakeConstSpan(
+                         draft_token_ids.data(), num_draft_tokens)));
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_verify"));
+      benchmark_info->RecordSpeculativeDecodingStep(num_draft_tokens,
+                                                    accepted_ids.size() - 1);
+    }
+    // Bring the draft back in sync with the accepted tokens. The current step
+    // counts the pending token, which is not in the kv-cache yet.
+    ASSIGN_OR_RETURN(current_step, executor.GetCurrentStep());
+    RETURN_IF_ERROR(
+        draft_executor.Rollback(current_step - 1, accepted_ids.back()));
+
+    for (int id : accepted_ids) {
+      const int ids[] = {id};
+      RETURN_IF_ERROR(detector.ProcessTokens(ids));
+      decoded_ids.push_back(id);
+      num_decoded_steps++;
+      if (benchmark_info.has_value()) {
+        RETURN_IF_ERROR(benchmark_info->TimeDecodeStep());
+      }
+      if (ShouldStop(detector.GetStopTokensFound()[0],
+                     benchmark_decode_token_count, num_decoded_steps,
+                     current_step, max_num_tokens, /*observer=*/nullptr)) {
+        done = true;
+        break;
+      }
+    }
+  }
+  // Drop the matched stop sequence from the response.
+  if (detector.GetStopTokensFound()[0]) {
+    decoded_ids.resize(decoded_ids.size() -
+                       detector.GetStepsBeforeStopTokens()[0]);
+  }
+  Responses responses(/*num_output_candidates=*/1);
+  ASSIGN_OR_RETURN(auto text, tokenizer.TokenIdsToText(decoded_ids));
+  responses.GetMutableResponseTexts()[0] =
+      absl::StrReplaceAll(text, {{"▁", " "}});
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnEnd(num_decoded_steps));
+  }
+  return responses;
+}
+
+absl::StatusOr<Responses> DecodePromptLookup(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector,
+    absl::Span<const int> prompt_token_ids, const PromptLookupConfig& config,
+    std::optional<BenchmarkInfo>& benchmark_info) {
+  if (config.max_num_draft_tokens <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Number of draft tokens must be positive, got ",
+                     config.max_num_draft_tokens));
+  }
+  ASSIGN_OR_RETURN(auto index, NgramIndex::Create(config.min_ngram_size,
+                                                  config.max_ngram_size));
+  index->AddTokens(prompt_token_ids);
+  int benchmark_decode_token_count = 0;
+  if (benchmark_info.has_value()) {
+    benchmark_decode_token_count =
+        benchmark_info->GetBenchmarkParams().num_decode_tokens();
+    RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnStart());
+  }
+  // Prompt lookup decoding only produces a single output candidate.
+  StopTokenDetector detector = stop_token_detector;
+  detector.ResetBatch(/*batch_size=*/1);
+  const int max_num_tokens = TryGetMaxNumTokens(executor);
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto output_tokens,
+                               CreateTensorBuffer<int>({1, 1}));
+  std::vector<int> decoded_ids;
+  int num_decoded_steps = 0;
+  bool done = false;
+  while (!done) {
+    ASSIGN_OR_RETURN(int current_step, executor.GetCurrentStep());
+    // The proposal is cut to the kv-cache left after the pending token.
+    const int max_num_draft_tokens = std::min(
+        config.max_num_draft_tokens, max_num_tokens - current_step - 1);
+    if (max_num_draft_tokens < 0) {
+      break;
+    }
+    const std::vector<int> draft_token_ids =
+        index->Propose(max_num_draft_tokens);
+    std::vector<int> accepted_ids;
+    if (draft_token_ids.empty()) {
+      if (benchmark_info.has_value()) {
+        RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_decode"));
+      }
+      RETURN_IF_ERROR(executor.Decode(output_tokens));
+      if (benchmark_info.has_value()) {
+        RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_decode"));
+      }
+      LITERT_ASSIGN_OR_RETURN_ABSL(auto output_tokens_span,
+                                   ReferTensorBufferAsSpan<int>(output_tokens));
+      accepted_ids.push_back(output_tokens_span[0]);
+    } else {
+      if (benchmark_info.has_value()) {
+        RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_verify"));
+      }
+      ASSIGN_OR_RETURN(accepted_ids,
+                       executor.VerifyDraftTokens(draft_token_ids));
+      if (benchmark_info.has_value()) {
+        RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_verify"));
+        benchmark_info->RecordSpeculativeDecodingStep(draft_token_ids.size(),
+                                                      accepted_ids.size() - 1);
+      }
+    }
+    index->AddTokens(accepted_ids);
+
+    ASSIGN_OR_RETURN(current_step, executor.GetCurrentStep());
+    for (int id : accepted_ids) {
+      const int ids[] = {id};
+      RETURN_IF_ERROR(detector.ProcessTokens(ids));
+      decoded_ids.push_back(id);
+      num_decoded_steps++;
+      if (benchmark_info.has_value()) {
+        RETURN_IF_ERROR(benchmark_info->TimeDecodeStep());
+      }
+      if (ShouldStop(detector.GetStopTokensFound()[0],
+                     benchmark_decode_token_count, num_decoded_steps,
+                     current_step, max_num_tokens, /*observer=*/nullptr)) {
+        done = true;
+        break;
+      }
+    }
+  }
+  // Drop the matched stop sequence from the response.
+  if (detector.GetStopTokensFound()[0]) {
+    decoded_ids.resize(decoded_ids.size() -
+                       detector.GetStepsBeforeStopTokens()[0]);
+  }
+  Responses responses(/*num_output_candidates=*/1);
+  ASSIGN_OR_RETURN(auto text, tokenizer.TokenIdsToText(decoded_ids));
+  responses.GetMutableResponseTexts()[0] =
+      absl::StrReplaceAll(text, {{"▁", " "}});
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnEnd(num_decoded_steps));
+  }
+  return responses;
+}
+
+absl::StatusOr<Responses> DecodeBeamSearch(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector, int num_beams,
+    int last_prefill_token_id, std::optional<BenchmarkInfo>& benchmark_info) {
+  int benchmark_decode_token_count = 0;
+  if (benchmark_info.has_value()) {
+    benchmark_decode_token_count =
+        benchmark_info->GetBenchmarkParams().num_decode_tokens();
+    RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnStart());
+  }
+  ASSIGN_OR_RETURN(auto beam_search,
+                   BeamSearch::Create(num_beams, stop_token_detector));
+  const int max_num_tokens = TryGetMaxNumTokens(executor);
+  std::vector<int> input_token_ids(num_beams, last_prefill_token_id);
+  int num_decoded_steps = 0;
+  while (true) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto input_ids_buffer,
+        CopyToTensorBuffer<int>(input_token_ids, {num_beams, 1}));
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_decode"));
+    }
+    ASSIGN_OR_RETURN(auto logits,
+                     executor.DecodeLogits(ExecutorInputs(
+                         ExecutorTextData(std::move(input_ids_buffer)),
+                         std::nullopt, std::nullopt)));
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("executor_decode"));
+      RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("beam_search"));
+    }
+    // The logits may live in device memory, so they are copied to the host.
+    LITERT_ASSIGN_OR_RETURN_ABSL(std::vector<float> logits_data,
+                                 CopyFromTensorBuffer<float>(logits));
+    RETURN_IF_ERROR(beam_search->Step(logits_data));
+    RETURN_IF_ERROR(executor.ReorderBatchRows(beam_search->GetSourceRows()));
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeMarkDelta("beam_search"));
+    }
+    num_decoded_steps++;
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeDecodeStep());
+    }
+    const auto next_input_token_ids = beam_search->GetNextInputTokenIds();
+    input_token_ids.assign(next_input_token_ids.begin(),
+                           next_input_token_ids.end());
+    ASSIGN_OR_RETURN(int current_step, executor.GetCurrentStep());
+    if (ShouldStop(beam_search->AllDone(), benchmark_decode_token_count,
+                   num_decoded_steps, current_step, max_num_tokens,
+                   /*observer=*/nullptr)) {
+      break;
+    }
+  }
+  Responses responses(num_beams);
+  for (int i = 0; i < num_beams; ++i) {
+    ASSIGN_OR_RETURN(auto text,
+                     tokenizer.TokenIdsToText(beam_search->GetTokenIds(i)));
+    responses.GetMutableResponseTexts()[i] =
+        absl::StrReplaceAll(text, {{"▁", " "}});
+    responses.GetMutableScores()[i] = beam_search->GetScore(i);
+  }
+  if (benchmark_info.has_value()) {
+    RETURN_IF_ERROR(
+        benchmark_info->TimeDecodeTurnEnd(num_decoded_steps * num_beams));
+  }
+  return responses;
+}
+
+absl::Status DecodeStreaming(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    InferenceObservable* observer,
+    const std::optional<ContextShiftConfig>& context_shift_config,
+    const StopStringDetector* absl_nullable stop_string_detector,
+    const CancelParams* absl_nullable cancel_params,
+    const DecodeBudget* absl_nullable decode_budget) {
   if (observer == nullptr) {
     return absl::InvalidArgumentError(
         "Observer must be provided for streaming.");
@@ -382,33 +1830,64 @@ absl::Status DecodeStreaming(LlmExecutor& executor, Tokenizer& tokenizer,
   DecodeInternalSamplingOneStep run_one_step(
       &executor, &tokenizer, num_output_candidates, stop_token_detector,
       benchmark_info);
+  std::optional<StopStringDetector> string_detector;
+  if (stop_string_detector != nullptr &&
+      stop_string_detector->HasStopStrings()) {
+    string_detector = *stop_string_detector;
+    string_detector->Reset();
+  }
 
-  // List of tokens from the previous step. Used for merging the current and
-  // previous token ids if needed for BPE encoding.
-  std::vector<std::vector<int>> previous_token_ids;
   while (true) {
+    if (absl::Status status = CheckCancelled(cancel_params); !status.ok()) {
+      RETURN_IF_ERROR(run_one_step.DiscardBufferedTokens());
+      observer->OnError(status);
+      return status;
+    }
+    PaceDecodeStep(decode_budget);
     Responses responses(num_output_candidates);
     std::vector<std::string>& response_texts =
         responses.GetMutableResponseTexts();
-    ASSIGN_OR_RETURN(DecodeResult decode_result,
-                     run_one_step.Run(previous_token_ids));
-    if (decode_result == kContinue) {
-      previous_token_ids = run_one_step.GetTokenIds();
-      continue;
-    }
-
-    previous_token_ids.resize(0);
-    response_texts[0] +=
+    ASSIGN_OR_RETURN(DecodeResult decode_result, run_one_step.Run());
+    std::string text =
         absl::StrReplaceAll(run_one_step.GetResultTokens()[0], {{"▁", " "}});
+    if (string_detector.has_value()) {
+      text = string_detector->ProcessText(text);
+      if (string_detector->StopStringFound()) {
+        decode_result = kDone;
+      }
+    }
+    response_texts[0] += text;
     num_decoded_steps++;
-    observer->OnNext(responses);
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeDecodeStep());
+    }
+    if (HasText(responses)) {
+      LITERT_LM_TRACE_SCOPE("observer_on_next");
+      observer->OnNext(responses);
+    }
 
+    ASSIGN_OR_RETURN(int current_step, run_one_step.GetCurrentStep());
+    ASSIGN_OR_RETURN(current_step,
+                     MaybeShiftContext(executor, current_step,
+                                       /*num_new_tokens=*/0, max_num_tokens,
+                                       context_shift_config));
     if (ShouldStop(decode_result == kDone, benchmark_decode_token_count,
-                   num_decoded_steps, executor.GetCurrentStep().value(),
-                   max_num_tokens, observer)) {
+                   num_decoded_steps, current_step, max_num_tokens,
+                   observer) ||
+        IsBudgetSpent(decode_budget, num_decoded_steps)) {
       break;
     }
   }
+  RETURN_IF_ERROR(run_one_step.DiscardBufferedTokens());
+  if (string_detector.has_value()) {
+    // The text held back for a stop string that did not complete.
+    Responses responses(num_output_candidates);
+    responses.GetMutableResponseTexts()[0] = string_detector->Flush();
+    if (HasText(responses)) {
+      LITERT_LM_TRACE_SCOPE("observer_on_next");
+      observer->OnNext(responses);
+    }
+  }
   if (benchmark_info.has_value()) {
     RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnEnd(num_decoded_steps *
                                                       num_output_candidates));
@@ -421,7 +1900,10 @@ absl::StatusOr<Responses> DecodeCustomSampling(
     LlmExecutor& executor, Tokenizer& tokenizer,
     const StopTokenDetector& stop_token_detector, int num_output_candidates,
     Sampler& sampler, litert::TensorBuffer& decoded_ids,
-    std::optional<BenchmarkInfo>& benchmark_info) {
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const std::optional<ContextShiftConfig>& context_shift_config,
+    const CancelParams* absl_nullable cancel_params,
+    const DecodeBudget* absl_nullable decode_budget) {
   int benchmark_decode_token_count = 0;
   if (benchmark_info.has_value()) {
     benchmark_decode_token_count =
@@ -440,10 +1922,12 @@ absl::StatusOr<Responses> DecodeCustomSampling(
                                       num_output_candidates, sampler,
                                       stop_token_detector, benchmark_info);
 
-  // List of tokens from the previous step. Used for merging the current and
-  // previous token ids if needed for BPE encoding.
-  std::vector<std::vector<int>> previous_token_ids;
   while (true) {
+    if (absl::Status status = CheckCancelled(cancel_params); !status.ok()) {
+      RETURN_IF_ERROR(run_one_step.DiscardForcedTokens());
+      return status;
+    }
+    PaceDecodeStep(decode_budget);
     ASSIGN_OR_RETURN(DecodeResult decode_result, run_one_step.Run(decoded_ids));
 
     // Append the results to the final results vector. Note that only the
@@ -454,22 +1938,33 @@ absl::StatusOr<Responses> DecodeCustomSampling(
     for (int j = 0; j < num_output_candidates; ++j) {
       // Only add the result if the stop token has not been found yet.
       if (!run_one_step.GetStopTokensFound()[j]) {
-        // The tokenizer may return a token with a special character "▁" that
-        // should be replaced with a space.
-        response_texts[j] += absl::StrReplaceAll(
-            run_one_step.GetResultTokens()[j], {{"▁", " "}});
+        AppendDecodedText(run_one_step.GetResultTokens()[j],
+                          response_texts[j]);
         num_decoded_tokens[j]++;
         scores[j] += run_one_step.GetScores()[j];
+        if (!run_one_step.GetTopLogProbs().empty()) {
+          responses.GetMutableTopLogProbs()[j].push_back(
+              run_one_step.GetTopLogProbs()[j]);
+        }
       }
     }
     num_decode_steps++;
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeDecodeStep());
+    }
+    ASSIGN_OR_RETURN(int current_step, run_one_step.GetCurrentStep());
+    ASSIGN_OR_RETURN(current_step,
+                     MaybeShiftContext(executor, current_step,
+                                       /*num_new_tokens=*/0, max_num_tokens,
+                                       context_shift_config));
     if (ShouldStop(decode_result == kDone, benchmark_decode_token_count,
-                   num_decode_steps, executor.GetCurrentStep().value(),
-                   max_num_tokens,
-                   /*observer=*/nullptr)) {
+                   num_decode_steps, current_step, max_num_tokens,
+                   /*observer=*/nullptr) ||
+        IsBudgetSpent(decode_budget, num_decode_steps)) {
       break;
     }
   }
+  RETURN_IF_ERROR(run_one_step.DiscardForcedTokens());
   for (int j = 0; j < num_output_candidates; ++j) {
     if (num_decoded_tokens[j] > 0) {
       scores[j] /= num_decoded_tokens[j];
@@ -489,11 +1984,34 @@ absl::Status DecodeCustomSamplingStreaming(
     const StopTokenDetector& stop_token_detector, int num_output_candidates,
     Sampler& sampler, litert::TensorBuffer& decoded_ids,
     std::optional<BenchmarkInfo>& benchmark_info,
-    InferenceObservable* observer) {
+    InferenceObservable* observer,
+    const std::optional<ContextShiftConfig>& context_shift_config,
+    bool overlap_output_processing,
+    const StopStringDetector* absl_nullable stop_string_detector,
+    const CancelParams* absl_nullable cancel_params,
+    const DecodeBudget* absl_nullable decode_budget) {
   if (observer == nullptr) {
     return absl::InvalidArgumentError(
         "Observer must be provided for streaming.");
   }
+  // One detector per output candidate, if any stop string is set.
+  std::vector<StopStringDetector> string_detectors;
+  if (stop_string_detector != nullptr &&
+      stop_string_detector->HasStopStrings()) {
+    string_detectors.assign(num_output_candidates, *stop_string_detector);
+    for (StopStringDetector& string_detector : string_detectors) {
+      string_detector.Reset();
+    }
+  }
+  // The output worker only takes the texts and scores, so the decoding with
+  // top log-probabilities is not overlapped.
+  if (overlap_output_processing && string_detectors.empty() &&
+      sampler.GetNumTopLogProbs() == 0) {
+    return DecodeCustomSamplingStreamingOverlapped(
+        executor, tokenizer, stop_token_detector, num_output_candidates,
+        sampler, decoded_ids, benchmark_info, observer, context_shift_config,
+        cancel_params, decode_budget);
+  }
   int benchmark_decode_token_count = 0;
   if (benchmark_info.has_value()) {
     benchmark_decode_token_count =
@@ -507,9 +2025,19 @@ absl::Status DecodeCustomSamplingStreaming(
   DecodeExternalSampling run_one_step(&executor, &tokenizer,
                                       num_output_candidates, sampler,
                                       stop_token_detector, benchmark_info);
+  // The candidates reported to the observer as stopped, when there are
+  // several.
+  std::vector<bool> candidates_done(num_output_candidates);
+  std::vector<int> newly_done_candidates;
 
   // Enter the loop to run the decode process.
   while (true) {
+    if (absl::Status status = CheckCancelled(cancel_params); !status.ok()) {
+      run_one_step.DiscardForcedTokens().IgnoreError();
+      observer->OnError(status);
+      return status;
+    }
+    PaceDecodeStep(decode_budget);
     absl::StatusOr<DecodeResult> decode_result = run_one_step.Run(decoded_ids);
     if (!decode_result.ok()) {
       observer->OnError(decode_result.status());
@@ -528,19 +2056,88 @@ absl::Status DecodeCustomSamplingStreaming(
       if (!run_one_step.GetStopTokensFound()[j]) {
         // The tokenizer may return a token with a special character "▁" that
         // should be replaced with a space.
-        response_texts[j] += absl::StrReplaceAll(
+        std::string text = absl::StrReplaceAll(
             run_one_step.GetResultTokens()[j], {{"▁", " "}});
+        if (!string_detectors.empty()) {
+          text = string_detectors[j].ProcessText(text);
+        }
+        response_texts[j] += text;
         scores[j] += run_one_step.GetScores()[j];
+        if (!run_one_step.GetTopLogProbs().empty()) {
+          responses.GetMutableTopLogProbs()[j].push_back(
+              run_one_step.GetTopLogProbs()[j]);
+        }
+      }
+    }
+    // The candidates stopping at this step end their streams with the text
+    // held back for the stop strings, while the others are still decoded.
+    // The ones at a stop string are no longer sampled either.
+    newly_done_candidates.clear();
+    if (num_output_candidates > 1) {
+      for (int j = 0; j < num_output_candidates; ++j) {
+        const bool stop_string_found =
+            !string_detectors.empty() && string_detectors[j].StopStringFound();
+        if (candidates_done[j] ||
+            !(run_one_step.GetStopTokensFound()[j] || stop_string_found)) {
+          continue;
+        }
+        candidates_done[j] = true;
+        newly_done_candidates.push_back(j);
+        if (!string_detectors.empty()) {
+          response_texts[j] += string_detectors[j].Flush();
+        }
+        if (stop_string_found) {
+          RETURN_IF_ERROR(run_one_step.StopCandidate(j));
+        }
       }
     }
     num_decode_steps++;
-    observer->OnNext(responses);
-    if (ShouldStop(*decode_result == kDone, benchmark_decode_token_count,
-                   num_decode_steps, executor.GetCurrentStep().value(),
-                   max_num_tokens, observer)) {
+    if (benchmark_info.has_value()) {
+      RETURN_IF_ERROR(benchmark_info->TimeDecodeStep());
+    }
+    // The tokens without text are still sent for their log-probabilities.
+    if (HasText(responses) || !run_one_step.GetTopLogProbs().empty()) {
+      LITERT_LM_TRACE_SCOPE("observer_on_next");
+      observer->OnNext(responses);
+    }
+    for (int j : newly_done_candidates) {
+      observer->OnCandidateDone(j);
+    }
+    bool hit_stop = *decode_result == kDone;
+    if (!string_detectors.empty()) {
+      // Each candidate also stops at its stop string.
+      hit_stop = true;
+      for (int j = 0; j < num_output_candidates; ++j) {
+        hit_stop &= run_one_step.GetStopTokensFound()[j] ||
+                    string_detectors[j].StopStringFound();
+      }
+    }
+    ASSIGN_OR_RETURN(int current_step, run_one_step.GetCurrentStep());
+    ASSIGN_OR_RETURN(current_step,
+                     MaybeShiftContext(executor, current_step,
+                                       /*num_new_tokens=*/0, max_num_tokens,
+                                       context_shift_config));
+    if (ShouldStop(hit_stop, benchmark_decode_token_count, num_decode_steps,
+                   current_step, max_num_tokens, observer) ||
+        IsBudgetSpent(decode_budget, num_decode_steps)) {
       break;
     }
   }
+  if (absl::Status status = run_one_step.DiscardForcedTokens(); !status.ok()) {
+    observer->OnError(status);
+    return status;
+  }
+  if (!string_detectors.empty()) {
+    // The text held back for the stop strings that did not complete.
+    Responses responses(num_output_candidates);
+    for (int j = 0; j < num_output_candidates; ++j) {
+      responses.GetMutableResponseTexts()[j] = string_detectors[j].Flush();
+    }
+    if (HasText(responses)) {
+      LITERT_LM_TRACE_SCOPE("observer_on_next");
+      observer->OnNext(responses);
+    }
+  }
   if (benchmark_info.has_value()) {
     RETURN_IF_ERROR(benchmark_info->TimeDecodeTurnEnd(num_decode_steps *
                                                       num_output_candidates));
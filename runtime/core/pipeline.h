@@ -17,21 +17,79 @@
 
 #include <stdbool.h>
 
+#include <atomic>
 #include <memory>
 #include <optional>
+#include <vector>
 
+#include "absl/base/nullability.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/components/sampler.h"
+#include "runtime/components/stop_string_detector.h"
 #include "runtime/components/stop_token_detector.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/core/decode_pacer.h"
+#include "runtime/core/document_cache.h"
+#include "runtime/core/prefix_cache.h"
+#include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
 #include "runtime/executor/llm_executor.h"
+#include "runtime/executor/vision_executor.h"
+#include "runtime/framework/threadpool.h"
 
 namespace litert::lm {
 
+// The token ids of the prompt template affixes around the input text, which
+// are the same for all the turns of a session, so they are encoded once.
+struct PromptAffixTokenIds {
+  // The ids before the input text, e.g. of the user prefix.
+  std::vector<int> prefix;
+  // The ids after the input text, e.g. of the user suffix and model prefix.
+  std::vector<int> suffix;
+};
+
+// Stops a prefill or a decode before it is done, e.g. when the user abandons
+// the request. The decodes check it before each step, and the prefills before
+// each executor call, which checks it again between its prefill work groups,
+// so the executor is left at the step the pipeline stopped at.
+struct CancelParams {
+  // The flag another thread sets to cancel, or nullptr. Cancelled requests
+  // fail with CancelledError.
+  const std::atomic_bool* absl_nullable cancel = nullptr;
+  // The requests still running at the deadline fail with
+  // DeadlineExceededError.
+  absl::Time deadline = absl::InfiniteFuture();
+};
+
+// Returns CancelledError or DeadlineExceededError if `cancel_params` asks to
+// stop, or OK, including when it is nullptr.
+absl::Status CheckCancelled(const CancelParams* absl_nullable cancel_params);
+
+// Bounds the length of a decode, which then ends as with a stop token, but
+// whatever the candidates decoded. Checked after each step.
+struct DecodeBudget {
+  // The maximum number of tokens decoded per output candidate. Not set means
+  // up to the kv-cache size.
+  std::optional<int> max_output_tokens;
+  // No step is started after this time.
+  absl::Time end_time = absl::InfiniteFuture();
+  // The pacer the steps wait for before they start, or nullptr to run them
+  // back to back.
+  DecodePacer* absl_nullable pacer = nullptr;
+};
+
+// Prefills `ids`, already encoded along with their prompt template affixes,
+// with one executor call, timed as a step of the prefill turn.
+absl::Status PrefillTokenIds(
+    LlmExecutor& executor, Tokenizer& tokenizer, absl::Span<const int> ids,
+    bool wait_for_completion, std::optional<BenchmarkInfo>& benchmark_info,
+    const CancelParams* absl_nullable cancel_params = nullptr);
+
 // Runs the pipeline to prefill the input prompt.
 // - executor: The initialized LLM Executor to call.
 // - tokenizer: The tokenizer to encode the text into token ids.
@@ -41,30 +99,183 @@ namespace litert::lm {
 //   the next decode process to determine the token id to start from.
 // - wait_for_completion: If true, wait for the prefill to complete before
 //   returning.
-absl::StatusOr<int> Prefill(LlmExecutor& executor, Tokenizer& tokenizer,
-                            absl::string_view prompt, int bos_token_id,
-                            bool wait_for_completion,
-                            std::optional<BenchmarkInfo>& benchmark_info);
+// - prefix_cache: Optional prefix cache. When set, the longest cached prefix of
+//   `context_token_ids` followed by the prompt ids is restored into the
+//   executor, only the remaining suffix is prefilled, and the resulting
+//   executor state is stored back into the cache.
+// - context_token_ids: The token ids already prefilled into the executor in
+//   the current context. Required when prefix_cache is set, and extended by
+//   the prompt ids on success.
+// - context_shift_config: Optional context shifting. When set, and the prompt
+//   does not fit into the kv-cache, the context is shifted before prefilling
+//   instead of failing. Ignored when prefix_cache is set.
+// - prompt_token_ids: Optional output, extended by the prompt ids, e.g. for
+//   the prompt lookup decoding.
+// - encode_thread_pool: Optional pool the chunks of a long prompt are encoded
+//   on in parallel. It must differ from the pool running the prefill.
+// - affix_token_ids: Optional token ids prefilled around the ones of the
+//   prompt, after the start token.
+// - cancel_params: Optional cancellation and deadline. The tokens prefilled
+//   before it stops stay in the executor.
+absl::StatusOr<int> Prefill(
+    LlmExecutor& executor, Tokenizer& tokenizer, absl::string_view prompt,
+    int bos_token_id, bool wait_for_completion,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    PrefixCache* absl_nullable prefix_cache = nullptr,
+    std::vector<int>* absl_nullable context_token_ids = nullptr,
+    const std::optional<ContextShiftConfig>& context_shift_config =
+        std::nullopt,
+    std::vector<int>* absl_nullable prompt_token_ids = nullptr,
+    ThreadPool* absl_nullable encode_thread_pool = nullptr,
+    const PromptAffixTokenIds* absl_nullable affix_token_ids = nullptr,
+    const CancelParams* absl_nullable cancel_params = nullptr);
+
+// Runs the pipeline to prefill token ids holding images, each as a run of
+// ExecutorVisionData::kSpecialToken, one run per image of `images` in order.
+// The images are encoded one after the other on `encode_thread_pool`, while
+// the calling thread prefills the tokens before each of them, such that the
+// encoding of the next image overlaps the prefill of the previous one. If the
+// encoder has a batch dimension, the images are rather encoded with a single
+// VisionExecutor::EncodeBatch() and filled in at once, while the tokens
+// before the first image are prefilled.
+// - vision_executor: The executor encoding the images. It is only called from
+//   the pool, whose tasks must run one at a time, e.g. with a single thread.
+// - token_ids: The token ids to prefill, including the start token.
+// - images: The image tensors, see VisionExecutor::Encode().
+// - cancel_params: Optional cancellation and deadline, checked before each
+//   prefill call.
+// Returns the last token id of the prefill ids.
+absl::StatusOr<int> PrefillWithImages(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    VisionExecutor& vision_executor, absl::Span<const int> token_ids,
+    absl::Span<const ::litert::TensorBuffer> images, bool wait_for_completion,
+    ThreadPool& encode_thread_pool,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const CancelParams* absl_nullable cancel_params = nullptr);
+
+// Runs the pipeline to prefill a context of documents, e.g. the retrieved
+// documents of a RAG prompt, from the start of the executor, which is reset.
+// Each document is prefilled on its own right after `prefix_token_ids`, at the
+// same positions as the other documents, and its kv-cache segment is cached in
+// `document_cache`, such that a later context holding the same document in
+// another combination only copies it. The segments are then concatenated
+// after the prefix, so each document attends to the prefix and to itself
+// only, and keeps the positions it was prefilled at. The question prefilled
+// next attends to all of them.
+// - prefix_token_ids: The ids shared by all the documents, including the start
+//   token, e.g. of the system prompt. Cached as a segment of its own.
+// - documents: The token ids of each document, in context order.
+// - cancel_params: Optional cancellation and deadline, checked before each
+//   prefill call.
+// The executor is left after the last document, with no pending token.
+// Requires an executor whose state can be saved in the layouts returned by
+// LlmExecutorBase::GetKvCacheLayouts().
+absl::Status PrefillDocuments(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    absl::Span<const int> prefix_token_ids,
+    absl::Span<const std::vector<int>> documents,
+    DocumentCache& document_cache,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const CancelParams* absl_nullable cancel_params = nullptr);
 
 // Runs the pipeline to decode the input prompt.
 // - executor: The initialized LLM Executor to call.
 // - tokenizer: The tokenizer to decode the token ids into text.
 // - stop_token_ids: The token ids to stop the decoding process.
 // - benchmark_info: The benchmark info to record the performance metrics.
+// - context_shift_config: Optional context shifting. When set, the context is
+//   shifted once the kv-cache is full instead of stopping the decoding.
+// - cancel_params: Optional cancellation and deadline, checked before each
+//   step. The executor is left after the last decoded token, which becomes
+//   the pending input token.
+// - decode_budget: Optional bound of the number of decoded tokens and of the
+//   decoding time.
 // TODO(b/397975034): support batched output and update the logic to avoid
 // detokenizing the stop tokens.
-absl::StatusOr<Responses> Decode(LlmExecutor& executor, Tokenizer& tokenizer,
-                                 const StopTokenDetector& stop_token_detector,
-                                 std::optional<BenchmarkInfo>& benchmark_info);
+absl::StatusOr<Responses> Decode(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const std::optional<ContextShiftConfig>& context_shift_config =
+        std::nullopt,
+    const CancelParams* absl_nullable cancel_params = nullptr,
+    const DecodeBudget* absl_nullable decode_budget = nullptr);
+
+// Runs the pipeline to decode the input prompt with speculative decoding. In
+// each step, the draft executor proposes num_draft_tokens tokens, which the
+// executor verifies in a single call and accepts the longest matching prefix
+// of. Both executors must have been prefilled with the same prompt, and the
+// decoding is greedy.
+// - executor: The initialized LLM Executor of the main model.
+// - draft_executor: The initialized LLM Executor of the draft model.
+// - tokenizer: The tokenizer to decode the token ids into text.
+// - stop_token_detector: The detector of the stop token sequences.
+// - num_draft_tokens: The number of tokens proposed in each step.
+// - benchmark_info: The benchmark info to record the performance metrics and
+//   the acceptance rate of the draft tokens.
+absl::StatusOr<Responses> DecodeSpeculative(
+    LlmExecutor& executor, LlmExecutor& draft_executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector, int num_draft_tokens,
+    std::optional<BenchmarkInfo>& benchmark_info);
+
+// Runs the pipeline to decode the input prompt with prompt lookup decoding. In
+// each step, the continuation of the latest n-gram of the prompt and the
+// decoded text is proposed from their earlier occurrences, and verified by the
+// executor in a single call. Steps without a proposal decode a single token.
+// The decoding is greedy.
+// - executor: The initialized LLM Executor, prefilled with the prompt.
+// - tokenizer: The tokenizer to decode the token ids into text.
+// - stop_token_detector: The detector of the stop token sequences.
+// - prompt_token_ids: The prefilled token ids the continuations are looked up
+//   in, ending with the pending input token.
+// - config: The n-gram sizes and the maximum number of proposed tokens.
+// - benchmark_info: The benchmark info to record the performance metrics and
+//   the acceptance rate of the proposed tokens.
+absl::StatusOr<Responses> DecodePromptLookup(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector,
+    absl::Span<const int> prompt_token_ids, const PromptLookupConfig& config,
+    std::optional<BenchmarkInfo>& benchmark_info);
+
+// Runs the pipeline to decode the input prompt with beam search. The
+// `num_beams` most likely hypotheses are kept in the batch rows of the
+// executor, which are reordered after each step as the hypotheses are pruned,
+// so that all the beams are decoded in a single call per step. The executor
+// must have been prefilled with the prompt in all its batch rows.
+// - executor: The initialized LLM Executor of batch size `num_beams`.
+// - tokenizer: The tokenizer to decode the token ids into text.
+// - stop_token_detector: The detector of the stop token sequences, which are
+//   tracked for each beam.
+// - num_beams: The number of hypotheses, which are all returned from the most
+//   likely one, with their cumulative log-probabilities as the scores.
+// - last_prefill_token_id: The last token id of the prompt.
+// - benchmark_info: The benchmark info to record the performance metrics.
+absl::StatusOr<Responses> DecodeBeamSearch(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector, int num_beams,
+    int last_prefill_token_id, std::optional<BenchmarkInfo>& benchmark_info);
 
 // Runs the pipeline to decode the input prompt. The function is similar to
 // Decode, but it outputs the result using the observer to achieve streaming
 // behavior.
 // - observer: The inference observer to receive the intermediate results.
-absl::Status DecodeStreaming(LlmExecutor& executor, Tokenizer& tokenizer,
-                             const StopTokenDetector& stop_token_detector,
-                             std::optional<BenchmarkInfo>& benchmark_info,
-                             InferenceObservable* observer);
+// - stop_string_detector: Optional stop strings, stopping the decoding as soon
+//   as the decoded text completes one. The text that may begin a stop string
+//   is sent once the following text tells it does not.
+// - cancel_params: Optional cancellation and deadline, as in Decode. The
+//   error is also sent to the observer.
+// - decode_budget: Optional bound, as in Decode. The observer gets OnDone()
+//   once it is spent.
+absl::Status DecodeStreaming(
+    LlmExecutor& executor, Tokenizer& tokenizer,
+    const StopTokenDetector& stop_token_detector,
+    std::optional<BenchmarkInfo>& benchmark_info,
+    InferenceObservable* observer,
+    const std::optional<ContextShiftConfig>& context_shift_config =
+        std::nullopt,
+    const StopStringDetector* absl_nullable stop_string_detector = nullptr,
+    const CancelParams* absl_nullable cancel_params = nullptr,
+    const DecodeBudget* absl_nullable decode_budget = nullptr);
 
 // Runs the pipeline to decode the input prompt.
 // - executor: The initialized LLM Executor to call.
@@ -74,22 +285,47 @@ absl::Status DecodeStreaming(LlmExecutor& executor, Tokenizer& tokenizer,
 // - sampler: The sampler to sample the token ids from the logits.
 // - decoded_ids: The decoded token ids from the external sampling process.
 // - benchmark_info: The benchmark info to record the performance metrics.
+// - context_shift_config: Optional context shifting, as in Decode.
+// - cancel_params: Optional cancellation and deadline, as in Decode.
+// - decode_budget: Optional bound, as in Decode.
 absl::StatusOr<Responses> DecodeCustomSampling(
     LlmExecutor& executor, Tokenizer& tokenizer,
     const StopTokenDetector& stop_token_detector, int num_output_candidates,
     Sampler& sampler, litert::TensorBuffer& decoded_ids,
-    std::optional<BenchmarkInfo>& benchmark_info);
+    std::optional<BenchmarkInfo>& benchmark_info,
+    const std::optional<ContextShiftConfig>& context_shift_config =
+        std::nullopt,
+    const CancelParams* absl_nullable cancel_params = nullptr,
+    const DecodeBudget* absl_nullable decode_budget = nullptr);
 
 // Runs the pipeline to decode the input prompt. The function is similar to
 // DecodeCustomSampling, but it outputs the result using the observer to achieve
-// streaming behavior.
+// streaming behavior. With several output candidates, each candidate stopping
+// on a stop token or a stop string is ended by OnCandidateDone() and no longer
+// sampled, while the others are decoded on in the same batch.
 // - observer: The inference observer to receive the intermediate results.
+// - overlap_output_processing: If true, the detokenization and the observer
+//   callback of each step run on a separate thread while the executor computes
+//   the next step. The observer is then called from that thread, still in
+//   order and before OnDone() or OnError().
+// - stop_string_detector: Optional stop strings, as in DecodeStreaming, matched
+//   per output candidate. The decoding stops once all the candidates hit a
+//   stop token or a stop string. The stop strings are matched on the decoded
+//   text, so the output processing is not overlapped when they are set.
+// - cancel_params: Optional cancellation and deadline, as in DecodeStreaming.
+// - decode_budget: Optional bound, as in DecodeStreaming.
 absl::Status DecodeCustomSamplingStreaming(
     LlmExecutor& executor, Tokenizer& tokenizer,
     const StopTokenDetector& stop_token_detector, int num_output_candidates,
     Sampler& sampler, litert::TensorBuffer& decoded_ids,
     std::optional<BenchmarkInfo>& benchmark_info,
-    InferenceObservable* observer);
+    InferenceObservable* observer,
+    const std::optional<ContextShiftConfig>& context_shift_config =
+        std::nullopt,
+    bool overlap_output_processing = false,
+    const StopStringDetector* absl_nullable stop_string_detector = nullptr,
+    const CancelParams* absl_nullable cancel_params = nullptr,
+    const DecodeBudget* absl_nullable decode_budget = nullptr);
 
 }  // namespace litert::lm
 
@@ -1,5 +1,9 @@
 #include "runtime/core/pipeline.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>  // NOLINT: Required for path manipulation.
 #include <memory>
 #include <optional>
@@ -11,19 +15,39 @@
 #include <gtest/gtest.h>
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/sampler.h"
 #include "runtime/components/sentencepiece_tokenizer.h"
+#include "runtime/components/stop_string_detector.h"
 #include "runtime/components/stop_token_detector.h"
 #include "runtime/components/tokenizer.h"
 #include "runtime/components/top_p_cpu_sampler.h"
+#include "runtime/core/document_cache.h"
+#include "runtime/core/prefix_cache.h"
+#include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "litert/test/matchers.h"  // from @litert
 #include "runtime/executor/fake_llm_executor.h"
+#include "runtime/executor/kv_cache_layout.h"
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/executor/vision_executor.h"
+#include "runtime/framework/threadpool.h"
+#include "runtime/proto/engine.pb.h"
 #include "runtime/util/convert_tensor_buffer.h"
 #include "runtime/util/test_utils.h"  // NOLINT
 
 namespace litert::lm {
 namespace {
 
+using ::testing::ElementsAre;
+using ::testing::Pair;
+using ::testing::status::IsOkAndHolds;
 using ::testing::status::StatusIs;
 
 constexpr char kTestdataDir[] =
@@ -48,10 +72,19 @@ class TestObserver : public InferenceObservable {
       responses_[i] += *(responses.GetResponseTextAt(i));
     }
   }
+  // Records the candidate with its text so far, which must be complete.
+  void OnCandidateDone(int candidate_index) override {
+    done_candidates_.emplace_back(candidate_index,
+                                  responses_[candidate_index]);
+  }
   const std::vector<std::string>& GetResponses() const { return responses_; }
+  const std::vector<std::pair<int, std::string>>& GetDoneCandidates() const {
+    return done_candidates_;
+  }
 
  private:
   std::vector<std::string> responses_;
+  std::vector<std::pair<int, std::string>> done_candidates_;
 };
 
 class PipelineTest : public testing::Test {
@@ -104,6 +137,39 @@ TEST_F(PipelineTest, PrefillSucceed) {
   EXPECT_EQ(*last_prefill_token_id, 2294);
 }
 
+TEST_F(PipelineTest, PrefillWithPrefixCache) {
+  const std::string prompt = "Hello World!";
+  std::optional<BenchmarkInfo> benchmark_info;
+  ASSERT_OK_AND_ASSIGN(auto prefix_cache,
+                       PrefixCache::Create(/*max_size_in_bytes=*/1024));
+
+  // The first prefill misses the cache and stores the executor state.
+  std::vector<int> context_token_ids;
+  ASSERT_OK_AND_ASSIGN(
+      int last_prefill_token_id,
+      Prefill(*executor_, *tokenizer_, prompt,
+              /*bos_token_id=*/2, /*wait_for_completion=*/true, benchmark_info,
+              prefix_cache.get(), &context_token_ids));
+  EXPECT_EQ(last_prefill_token_id, 2294);
+  EXPECT_EQ(context_token_ids.size(), 8);
+  EXPECT_EQ(prefix_cache->NumMisses(), 1);
+  EXPECT_EQ(prefix_cache->NumEntries(), 1);
+
+  // The same prompt in a new context is fully restored from the cache. The
+  // fake executor only expects one prefill call, so prefilling again would
+  // fail.
+  std::vector<int> new_context_token_ids;
+  ASSERT_OK_AND_ASSIGN(
+      last_prefill_token_id,
+      Prefill(*executor_, *tokenizer_, prompt,
+              /*bos_token_id=*/2, /*wait_for_completion=*/true, benchmark_info,
+              prefix_cache.get(), &new_context_token_ids));
+  EXPECT_EQ(last_prefill_token_id, 2294);
+  EXPECT_EQ(new_context_token_ids, context_token_ids);
+  EXPECT_EQ(prefix_cache->NumHits(), 1);
+  EXPECT_EQ(executor_->GetCurrentStep().value(), 8);
+}
+
 TEST_F(PipelineTest, Decode) {
   std::optional<BenchmarkInfo> benchmark_info;
   StopTokenDetector stop_token_detector(1);
@@ -127,6 +193,70 @@ TEST_F(PipelineTest, DecodeReachMaxNumTokens) {
   EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's");
 }
 
+TEST_F(PipelineTest, DecodeWithMaxOutputTokens) {
+  std::optional<BenchmarkInfo> benchmark_info;
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  DecodeBudget decode_budget;
+  decode_budget.max_output_tokens = 3;
+  auto responses =
+      Decode(*executor_, *tokenizer_, stop_token_detector, benchmark_info,
+             /*context_shift_config=*/std::nullopt, /*cancel_params=*/nullptr,
+             &decode_budget);
+  EXPECT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's");
+}
+
+TEST_F(PipelineTest, DecodeWithContextShift) {
+  // Set the max number of tokens to 3.
+  executor_->GetMutableExecutorSettings().value()->SetMaxNumTokens(3);
+  ContextShiftConfig context_shift_config;
+  context_shift_config.num_sink_tokens = 1;
+  context_shift_config.num_recent_tokens = 1;
+  std::optional<BenchmarkInfo> benchmark_info;
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  auto responses = Decode(*executor_, *tokenizer_, stop_token_detector,
+                          benchmark_info, context_shift_config);
+  EXPECT_OK(responses);
+  // The context is shifted instead of truncating the response.
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+  EXPECT_LT(executor_->GetCurrentStep().value(), 3);
+}
+
+TEST_F(PipelineTest, DecodeCancelled) {
+  std::optional<BenchmarkInfo> benchmark_info;
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  auto current_step = executor_->GetCurrentStep();
+  ASSERT_OK(current_step);
+  std::atomic_bool cancel = true;
+  CancelParams cancel_params;
+  cancel_params.cancel = &cancel;
+  EXPECT_THAT(Decode(*executor_, *tokenizer_, stop_token_detector,
+                     benchmark_info, /*context_shift_config=*/std::nullopt,
+                     &cancel_params),
+              StatusIs(absl::StatusCode::kCancelled));
+  // Nothing is decoded once cancelled.
+  EXPECT_THAT(executor_->GetCurrentStep(), IsOkAndHolds(*current_step));
+}
+
+TEST_F(PipelineTest, DecodeStreamingPastDeadline) {
+  std::optional<BenchmarkInfo> benchmark_info;
+  TestObserver observer(/*num_candidates=*/1);
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  CancelParams cancel_params;
+  cancel_params.deadline = absl::InfinitePast();
+  EXPECT_THAT(DecodeStreaming(*executor_, *tokenizer_, stop_token_detector,
+                              benchmark_info, &observer,
+                              /*context_shift_config=*/std::nullopt,
+                              /*stop_string_detector=*/nullptr,
+                              &cancel_params),
+              StatusIs(absl::StatusCode::kDeadlineExceeded));
+  EXPECT_EQ(observer.GetResponses()[0], "");
+}
+
 TEST_F(PipelineTest, DecodeStreaming) {
   std::optional<BenchmarkInfo> benchmark_info;
   TestObserver observer(/*num_candidates=*/1);
@@ -137,6 +267,37 @@ TEST_F(PipelineTest, DecodeStreaming) {
   EXPECT_EQ(observer.GetResponses()[0], " How's it going?!");
 }
 
+TEST_F(PipelineTest, DecodeStreamingWithStopStrings) {
+  std::optional<BenchmarkInfo> benchmark_info;
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  StopStringDetector stop_string_detector;
+  // A stop string that never completes, so its beginning is held back and
+  // flushed at the stop token.
+  EXPECT_OK(stop_string_detector.AddStopString("?!x"));
+  TestObserver observer(/*num_candidates=*/1);
+  EXPECT_OK(DecodeStreaming(*executor_, *tokenizer_, stop_token_detector,
+                            benchmark_info, &observer,
+                            /*context_shift_config=*/std::nullopt,
+                            &stop_string_detector));
+  EXPECT_EQ(observer.GetResponses()[0], " How's it going?!");
+}
+
+TEST_F(PipelineTest, DecodeStreamingStopsAtStopString) {
+  std::optional<BenchmarkInfo> benchmark_info;
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  StopStringDetector stop_string_detector;
+  // The stop string spans several tokens.
+  EXPECT_OK(stop_string_detector.AddStopString("'s it"));
+  TestObserver observer(/*num_candidates=*/1);
+  EXPECT_OK(DecodeStreaming(*executor_, *tokenizer_, stop_token_detector,
+                            benchmark_info, &observer,
+                            /*context_shift_config=*/std::nullopt,
+                            &stop_string_detector));
+  EXPECT_EQ(observer.GetResponses()[0], " How");
+}
+
 TEST_F(PipelineTest, DecodeStreamingReachMaxNumTokens) {
   // Set the max number of tokens to 3.
   executor_->GetMutableExecutorSettings().value()->SetMaxNumTokens(3);
@@ -150,6 +311,293 @@ TEST_F(PipelineTest, DecodeStreamingReachMaxNumTokens) {
   EXPECT_EQ(observer.GetResponses()[0], " How's");
 }
 
+TEST_F(PipelineTest, DecodeStreamingMultipleStepsPerSync) {
+  // The decode tokens of the fixture followed by one more token, since the
+  // executor decodes 3 steps per sync and the stop token is the 8th one.
+  FakeLlmExecutor executor(
+      /*vocab_size=*/2560, {{2, 90, 547, 58, 735, 210, 466, 2294}},
+      {{224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294}, {1}});
+  GpuConfig gpu_config;
+  gpu_config.num_decode_steps_per_sync = 3;
+  executor.GetMutableExecutorSettings().value()->SetBackendConfig(gpu_config);
+  std::optional<BenchmarkInfo> benchmark_info;
+  ASSERT_OK(Prefill(executor, *tokenizer_, "Hello World!", /*bos_token_id=*/2,
+                    /*wait_for_completion=*/true, benchmark_info));
+  TestObserver observer(/*num_candidates=*/1);
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  EXPECT_OK(DecodeStreaming(executor, *tokenizer_, stop_token_detector,
+                            benchmark_info, &observer));
+  EXPECT_EQ(observer.GetResponses()[0], " How's it going?!");
+  // The token decoded after the stop token is rolled back.
+  EXPECT_EQ(executor.GetCurrentStep().value(), 16);
+}
+
+TEST_F(PipelineTest, DecodeSpeculative) {
+  const std::string prompt = "Hello World!";
+  std::optional<BenchmarkInfo> benchmark_info;
+  // The draft proposes 3 tokens per step. The first step has its last draft
+  // token rejected, the second step is fully accepted, and the first draft
+  // token of the third step is rejected in favor of the stop token. The 4th
+  // proposal of each step is never verified.
+  FakeLlmExecutor draft_executor(
+      /*vocab_size=*/2560, {{2, 90, 547, 58, 735, 210, 466, 2294}},
+      {{224}, {24}, {9}, {1}, {66}, {246}, {18}, {1}, {7}, {1}, {1}, {1}});
+  ASSERT_OK(Prefill(*executor_, *tokenizer_, prompt, /*bos_token_id=*/2,
+                    /*wait_for_completion=*/true, benchmark_info));
+  ASSERT_OK(Prefill(draft_executor, *tokenizer_, prompt, /*bos_token_id=*/2,
+                    /*wait_for_completion=*/true, benchmark_info));
+
+  benchmark_info.emplace(proto::BenchmarkParams());
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  ASSERT_OK_AND_ASSIGN(
+      auto responses,
+      DecodeSpeculative(*executor_, draft_executor, *tokenizer_,
+                        stop_token_detector, /*num_draft_tokens=*/3,
+                        benchmark_info));
+  // The stop token is not part of the response.
+  EXPECT_EQ(*(responses.GetResponseTextAt(0)), " How's it going");
+  EXPECT_EQ(benchmark_info->GetSpeculativeDecodingSteps(), 3);
+  EXPECT_EQ(benchmark_info->GetSpeculativeDraftTokens(), 9);
+  EXPECT_EQ(benchmark_info->GetSpeculativeAcceptedTokens(), 5);
+  // Both executors are in sync after the last step.
+  EXPECT_EQ(executor_->GetCurrentStep().value(),
+            draft_executor.GetCurrentStep().value());
+}
+
+TEST_F(PipelineTest, DecodePromptLookup) {
+  std::optional<BenchmarkInfo> benchmark_info;
+  ASSERT_OK(Prefill(*executor_, *tokenizer_, "Hello World!",
+                    /*bos_token_id=*/2, /*wait_for_completion=*/true,
+                    benchmark_info));
+  // The prompt the proposals are looked up in, ending with the pending token.
+  // The first step proposes the 3 tokens after the earlier 2294, which are
+  // all accepted. The next 3 steps find no match and decode a single token.
+  // The last step proposes the tokens after 18, of which the 7 is rejected in
+  // favor of the stop token.
+  const std::vector<int> prompt_token_ids = {2,  2294, 224, 24,  8,   5,
+                                             18, 2295, 7,   466, 2294};
+  PromptLookupConfig config;
+  config.min_ngram_size = 1;
+  config.max_ngram_size = 2;
+  config.max_num_draft_tokens = 3;
+
+  benchmark_info.emplace(proto::BenchmarkParams());
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  ASSERT_OK_AND_ASSIGN(
+      auto responses,
+      DecodePromptLookup(*executor_, *tokenizer_, stop_token_detector,
+                         prompt_token_ids, config, benchmark_info));
+  // The stop token is not part of the response.
+  EXPECT_EQ(*(responses.GetResponseTextAt(0)), " How's it going");
+  EXPECT_EQ(benchmark_info->GetSpeculativeDecodingSteps(), 2);
+  EXPECT_EQ(benchmark_info->GetSpeculativeDraftTokens(), 6);
+  EXPECT_EQ(benchmark_info->GetSpeculativeAcceptedTokens(), 4);
+}
+
+TEST_F(PipelineTest, DecodeBeamSearch) {
+  const std::string prompt = "Hello World!";
+  std::optional<BenchmarkInfo> benchmark_info;
+  ASSERT_OK_AND_ASSIGN(
+      int last_prefill_token_id,
+      Prefill(*executor_, *tokenizer_, prompt, /*bos_token_id=*/2,
+              /*wait_for_completion=*/true, benchmark_info));
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({2294}));
+  // With a single beam, the beam search follows the most likely tokens.
+  ASSERT_OK_AND_ASSIGN(
+      auto responses,
+      DecodeBeamSearch(*executor_, *tokenizer_, stop_token_detector,
+                       /*num_beams=*/1, last_prefill_token_id,
+                       benchmark_info));
+  EXPECT_EQ(responses.GetNumOutputCandidates(), 1);
+  EXPECT_EQ(*(responses.GetResponseTextAt(0)), " How's it going?!");
+  // The fake logits put all the probability on the decoded token.
+  EXPECT_EQ(*(responses.GetScoreAt(0)), 0.0f);
+}
+
+TEST(PipelineStreamingPrefillTest, PrefillsEachChunkOnceEncoded) {
+  BytePairEncodingTokenizer tokenizer;
+  // Encodes each byte to a token.
+  EXPECT_CALL(tokenizer, TextToTokenIds(testing::_))
+      .WillRepeatedly([](absl::string_view text) {
+        return std::vector<int>(text.begin(), text.end());
+      });
+  std::string prompt;
+  while (prompt.size() < 3 * kDefaultMinEncodeChunkSize) {
+    absl::StrAppend(&prompt, "word ");
+  }
+  // The fake executor has no prefill signatures, so each chunk is prefilled
+  // on its own, the first one after the start token.
+  std::vector<std::vector<int>> prefill_tokens;
+  for (absl::string_view chunk :
+       SplitTextForEncoding(prompt, kDefaultMinEncodeChunkSize)) {
+    prefill_tokens.emplace_back(chunk.begin(), chunk.end());
+  }
+  ASSERT_GT(prefill_tokens.size(), 1);
+  prefill_tokens[0].insert(prefill_tokens[0].begin(), 2);
+  FakeLlmExecutor executor(/*vocab_size=*/256, prefill_tokens,
+                           /*decode_tokens_set=*/{});
+  executor.GetMutableExecutorSettings().value()->SetMaxNumTokens(
+      2 * prompt.size());
+  ThreadPool encode_thread_pool(/*name_prefix=*/"encode",
+                                /*max_num_threads=*/1);
+
+  std::optional<BenchmarkInfo> benchmark_info;
+  std::vector<int> prompt_token_ids;
+  ASSERT_OK_AND_ASSIGN(
+      int last_prefill_token_id,
+      Prefill(executor, tokenizer, prompt, /*bos_token_id=*/2,
+              /*wait_for_completion=*/false, benchmark_info,
+              /*prefix_cache=*/nullptr, /*context_token_ids=*/nullptr,
+              /*context_shift_config=*/std::nullopt, &prompt_token_ids,
+              &encode_thread_pool));
+  EXPECT_EQ(last_prefill_token_id, ' ');
+  EXPECT_EQ(prompt_token_ids.size(), prompt.size() + 1);
+  ASSERT_OK_AND_ASSIGN(int current_step, executor.GetCurrentStep());
+  EXPECT_EQ(current_step, static_cast<int>(prompt.size()) + 1);
+}
+
+// Encodes an image into one embedding holding its first value, and records
+// the encoded images and the number of images of each batch.
+class FakeVisionExecutor : public VisionExecutor {
+ public:
+  explicit FakeVisionExecutor(int batch_size = 1) : batch_size_(batch_size) {}
+
+  absl::StatusOr<std::vector<ExecutorVisionData>> EncodeBatch(
+      absl::Span<const ::litert::TensorBuffer> input_image_tensors) override {
+    batch_sizes_.push_back(input_image_tensors.size());
+    return VisionExecutor::EncodeBatch(input_image_tensors);
+  }
+
+  absl::StatusOr<ExecutorVisionData> Encode(
+      const ::litert::TensorBuffer& input_image_tensor) override {
+    auto image = ReferTensorBufferAsSpan<float>(input_image_tensor);
+    if (!image) {
+      return absl::InternalError(image.Error().Message());
+    }
+    encoded_images_.push_back((*image)[0]);
+    std::vector<float> embeddings = {(*image)[0]};
+    auto embeddings_buffer =
+        CopyToTensorBuffer<float>(absl::MakeSpan(embeddings), {1, 1});
+    if (!embeddings_buffer) {
+      return absl::InternalError(embeddings_buffer.Error().Message());
+    }
+    return ExecutorVisionData(std::move(*embeddings_buffer), std::nullopt);
+  }
+
+  absl::StatusOr<std::vector<int>> GetExpectedInputDimension()
+      const override {
+    return std::vector<int>{batch_size_, 1, 1, 1};
+  }
+
+  const std::vector<float>& encoded_images() const { return encoded_images_; }
+  const std::vector<int>& batch_sizes() const { return batch_sizes_; }
+
+ private:
+  const int batch_size_;
+  std::vector<float> encoded_images_;
+  std::vector<int> batch_sizes_;
+};
+
+// Records the step at which the embeddings of each image are filled in.
+class VisionFakeLlmExecutor : public FakeLlmExecutor {
+ public:
+  using FakeLlmExecutor::FakeLlmExecutor;
+
+  absl::Status FillVisionEmbeddings(const ExecutorVisionData& vision_input,
+                                    int image_index) override {
+    fill_steps_.push_back(*GetCurrentStep());
+    EXPECT_EQ(image_index, static_cast<int>(fill_steps_.size()) - 1);
+    return absl::OkStatus();
+  }
+
+  const std::vector<int>& fill_steps() const { return fill_steps_; }
+
+ private:
+  std::vector<int> fill_steps_;
+};
+
+TEST(PipelineVisionPrefillTest, FillsEachImageBeforeItsTokens) {
+  constexpr int kImage = ExecutorVisionData::kSpecialToken;
+  BytePairEncodingTokenizer tokenizer;
+  // The text before each image, then each image with the text after it.
+  VisionFakeLlmExecutor executor(
+      /*vocab_size=*/256,
+      /*prefill_tokens_set=*/{{2, 10}, {kImage, kImage, 11}, {kImage, 12}},
+      /*decode_tokens_set=*/{});
+  FakeVisionExecutor vision_executor;
+  std::vector<::litert::TensorBuffer> images;
+  for (float value : {1.0f, 2.0f}) {
+    std::vector<float> image = {value};
+    LITERT_ASSERT_OK_AND_ASSIGN(
+        auto image_buffer,
+        CopyToTensorBuffer<float>(absl::MakeSpan(image), {1, 1, 1, 1}));
+    images.push_back(std::move(image_buffer));
+  }
+  ThreadPool encode_thread_pool(/*name_prefix=*/"encode",
+                                /*max_num_threads=*/1);
+
+  std::optional<BenchmarkInfo> benchmark_info;
+  const std::vector<int> token_ids = {2, 10, kImage, kImage, 11, kImage, 12};
+  EXPECT_THAT(PrefillWithImages(executor, tokenizer, vision_executor,
+                                token_ids, images,
+                                /*wait_for_completion=*/true,
+                                encode_thread_pool, benchmark_info),
+              IsOkAndHolds(12));
+  EXPECT_THAT(vision_executor.encoded_images(),
+              testing::ElementsAre(1.0f, 2.0f));
+  EXPECT_THAT(vision_executor.batch_sizes(), testing::ElementsAre(1, 1));
+  EXPECT_THAT(executor.fill_steps(), testing::ElementsAre(2, 5));
+  ASSERT_OK_AND_ASSIGN(int current_step, executor.GetCurrentStep());
+  EXPECT_EQ(current_step, static_cast<int>(token_ids.size()));
+
+  // Each image needs its own run of special tokens.
+  EXPECT_THAT(PrefillWithImages(executor, tokenizer, vision_executor,
+                                token_ids, absl::MakeSpan(images).subspan(1),
+                                /*wait_for_completion=*/true,
+                                encode_thread_pool, benchmark_info),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(PipelineVisionPrefillTest, EncodesTheImagesInOneBatch) {
+  constexpr int kImage = ExecutorVisionData::kSpecialToken;
+  BytePairEncodingTokenizer tokenizer;
+  // The text before the first image, then all the images with the text after
+  // them.
+  VisionFakeLlmExecutor executor(
+      /*vocab_size=*/256,
+      /*prefill_tokens_set=*/{{2, 10}, {kImage, kImage, 11, kImage, 12}},
+      /*decode_tokens_set=*/{});
+  FakeVisionExecutor vision_executor(/*batch_size=*/4);
+  std::vector<::litert::TensorBuffer> images;
+  for (float value : {1.0f, 2.0f}) {
+    std::vector<float> image = {value};
+    LITERT_ASSERT_OK_AND_ASSIGN(
+        auto image_buffer,
+        CopyToTensorBuffer<float>(absl::MakeSpan(image), {1, 1, 1, 1}));
+    images.push_back(std::move(image_buffer));
+  }
+  ThreadPool encode_thread_pool(/*name_prefix=*/"encode",
+                                /*max_num_threads=*/1);
+
+  std::optional<BenchmarkInfo> benchmark_info;
+  const std::vector<int> token_ids = {2, 10, kImage, kImage, 11, kImage, 12};
+  EXPECT_THAT(PrefillWithImages(executor, tokenizer, vision_executor,
+                                token_ids, images,
+                                /*wait_for_completion=*/true,
+                                encode_thread_pool, benchmark_info),
+              IsOkAndHolds(12));
+  EXPECT_THAT(vision_executor.encoded_images(),
+              testing::ElementsAre(1.0f, 2.0f));
+  EXPECT_THAT(vision_executor.batch_sizes(), testing::ElementsAre(2));
+  EXPECT_THAT(executor.fill_steps(), testing::ElementsAre(2, 2));
+  ASSERT_OK_AND_ASSIGN(int current_step, executor.GetCurrentStep());
+  EXPECT_EQ(current_step, static_cast<int>(token_ids.size()));
+}
+
 TEST_F(PipelineTest, DecodeBytePairEncodingTokens) {
   auto tokenizer = std::make_unique<BytePairEncodingTokenizer>();
   // Pretend the first token is incomplete.
@@ -185,6 +633,132 @@ TEST_F(PipelineTest, DecodeBytePairEncodingTokens) {
   EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
 }
 
+// An executor whose kv-cache holds 100 * id + position for each token
+// position, restored and saved as a single int32 tensor.
+class TokenKvCacheExecutor : public LlmExecutor {
+ public:
+  static constexpr int kKvCacheLength = 16;
+
+  absl::Status Prefill(const ExecutorInputs& inputs) override {
+    return Prefill(inputs, ExecutorPrefillParams());
+  }
+  absl::Status Prefill(const ExecutorInputs& inputs,
+                       const ExecutorPrefillParams& params) override {
+    auto ids_buffer = inputs.GetTextTokenIdsPtr();
+    if (!ids_buffer.ok()) {
+      return ids_buffer.status();
+    }
+    auto ids = CopyFromTensorBuffer<int>(**ids_buffer);
+    if (!ids) {
+      return absl::InternalError(ids.Error().Message());
+    }
+    for (int id : *ids) {
+      if (next_input_token_id_ != -1) {
+        kv_cache_[current_step_] = 100 * next_input_token_id_ + current_step_;
+        ++current_step_;
+      }
+      next_input_token_id_ = id;
+    }
+    num_prefilled_tokens_ += ids->size();
+    return absl::OkStatus();
+  }
+  absl::Status Decode(::litert::TensorBuffer& output_tokens) override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+  absl::string_view ExecutorBackendName() const override {
+    return "TokenKvCacheExecutor";
+  }
+  absl::StatusOr<int> GetCurrentStep() const override { return current_step_; }
+
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() override {
+    const auto* data = reinterpret_cast<const uint8_t*>(kv_cache_.data());
+    ExecutorCheckpoint::KvCacheData kv_cache;
+    kv_cache["kv_cache"] =
+        std::vector<uint8_t>(data, data + kv_cache_.size() * sizeof(int32_t));
+    return std::make_unique<ExecutorCheckpoint>(
+        current_step_, next_input_token_id_, std::move(kv_cache));
+  }
+  absl::Status RestoreState(const ExecutorCheckpoint& checkpoint) override {
+    auto contents = checkpoint.GetKvCacheTensor("kv_cache");
+    if (!contents.ok()) {
+      return contents.status();
+    }
+    std::memcpy(kv_cache_.data(), contents->data(), contents->size());
+    current_step_ = checkpoint.GetCurrentStep();
+    next_input_token_id_ = checkpoint.GetNextInputTokenId();
+    return absl::OkStatus();
+  }
+  absl::StatusOr<KvCacheLayouts> GetKvCacheLayouts() const override {
+    return KvCacheLayouts{
+        {"kv_cache", {{1, kKvCacheLength}, /*seq_dim=*/1, sizeof(int32_t)}}};
+  }
+  absl::Status Reset() override {
+    std::fill(kv_cache_.begin(), kv_cache_.end(), 0);
+    current_step_ = 0;
+    next_input_token_id_ = -1;
+    return absl::OkStatus();
+  }
+
+  // The kv-cache up to the current step.
+  std::vector<int32_t> GetKvCache() const {
+    return std::vector<int32_t>(kv_cache_.begin(),
+                                kv_cache_.begin() + current_step_);
+  }
+  int GetNumPrefilledTokens() const { return num_prefilled_tokens_; }
+  int GetNextInputTokenId() const { return next_input_token_id_; }
+
+ private:
+  std::vector<int32_t> kv_cache_ = std::vector<int32_t>(kKvCacheLength, 0);
+  int current_step_ = 0;
+  int next_input_token_id_ = -1;
+  int num_prefilled_tokens_ = 0;
+};
+
+TEST(PipelineDocumentsPrefillTest, ConcatenatesCachedDocumentSegments) {
+  BytePairEncodingTokenizer tokenizer;
+  TokenKvCacheExecutor executor;
+  ASSERT_OK_AND_ASSIGN(auto document_cache, DocumentCache::Create(1024));
+  std::optional<BenchmarkInfo> benchmark_info;
+  const std::vector<int> prefix = {1, 2};
+
+  // Each document is prefilled at positions 2 and on, right after the prefix,
+  // and the extra pending id of each segment prefill is not part of it.
+  EXPECT_OK(PrefillDocuments(executor, tokenizer, prefix, {{3, 4}, {5}},
+                             *document_cache, benchmark_info));
+  EXPECT_THAT(executor.GetKvCache(), ElementsAre(100, 201, 302, 403, 502));
+  EXPECT_EQ(executor.GetNextInputTokenId(), -1);
+  EXPECT_EQ(document_cache->NumEntries(), 3);
+  const int num_prefilled_tokens = executor.GetNumPrefilledTokens();
+
+  // Another combination of the same documents is only copied.
+  EXPECT_OK(PrefillDocuments(executor, tokenizer, prefix, {{5}, {3, 4}},
+                             *document_cache, benchmark_info));
+  EXPECT_THAT(executor.GetKvCache(), ElementsAre(100, 201, 502, 302, 403));
+  EXPECT_EQ(executor.GetNumPrefilledTokens(), num_prefilled_tokens);
+
+  // A new document is prefilled after the cached prefix.
+  EXPECT_OK(PrefillDocuments(executor, tokenizer, prefix, {{5}, {6, 7}},
+                             *document_cache, benchmark_info));
+  EXPECT_THAT(executor.GetKvCache(), ElementsAre(100, 201, 502, 602, 703));
+  // The new document and its extra id.
+  EXPECT_EQ(executor.GetNumPrefilledTokens(), num_prefilled_tokens + 3);
+}
+
+TEST(PipelineDocumentsPrefillTest, RejectsDocumentsLongerThanKvCache) {
+  BytePairEncodingTokenizer tokenizer;
+  TokenKvCacheExecutor executor;
+  ASSERT_OK_AND_ASSIGN(auto document_cache, DocumentCache::Create(1024));
+  std::optional<BenchmarkInfo> benchmark_info;
+  const std::vector<int> document(TokenKvCacheExecutor::kKvCacheLength, 3);
+  EXPECT_THAT(PrefillDocuments(executor, tokenizer, {1}, {document},
+                               *document_cache, benchmark_info),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  const std::vector<std::vector<int>> empty_document = {std::vector<int>()};
+  EXPECT_THAT(PrefillDocuments(executor, tokenizer, {1}, empty_document,
+                               *document_cache, benchmark_info),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 class PipelineCustomSamplingTest : public testing::Test {
  protected:
   void SetUp() override {
@@ -262,6 +836,57 @@ TEST_F(PipelineCustomSamplingTest, DecodeCustomSampling) {
   EXPECT_EQ(*(responses->GetScoreAt(1)), 0.0f);
 }
 
+TEST_F(PipelineCustomSamplingTest, DecodeCustomSamplingReportsTopLogProbs) {
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  std::unique_ptr<TopPSampler> sampler = std::move(sampler_or.value());
+  ASSERT_OK(sampler->SetNumTopLogProbs(2));
+
+  auto decoded_ids = CreateTensorBuffer<int>({2, 1});
+  std::optional<BenchmarkInfo> benchmark_info;
+  StopTokenDetector stop_token_detector(2);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({0}));
+  auto responses = DecodeCustomSampling(
+      *executor_, *tokenizer_, stop_token_detector,
+      /*num_output_candidates=*/2, *sampler, *decoded_ids, benchmark_info);
+  EXPECT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+  for (int i = 0; i < 2; ++i) {
+    auto top_log_probs = responses->GetTopLogProbsAt(i);
+    ASSERT_OK(top_log_probs);
+    ASSERT_FALSE(top_log_probs->empty());
+    // One list per decoded token, most likely first.
+    for (const std::vector<TokenLogProb>& step : *top_log_probs) {
+      ASSERT_EQ(step.size(), 2);
+      EXPECT_LE(step[0].log_prob, 0.0f);
+      EXPECT_GE(step[0].log_prob, step[1].log_prob);
+    }
+  }
+}
+
+TEST_F(PipelineCustomSamplingTest, DecodeCustomSamplingFromTopKLogits) {
+  // The sampler only needs the top-4 logits, which the executor outputs in
+  // place of the full logits.
+  auto sampler_or = TopPSampler::Create(/*k=*/4, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  std::unique_ptr<TopPSampler> sampler = std::move(sampler_or.value());
+
+  auto decoded_ids = CreateTensorBuffer<int>({2, 1});
+  std::optional<BenchmarkInfo> benchmark_info;
+  StopTokenDetector stop_token_detector(2);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({0}));
+  auto responses = DecodeCustomSampling(
+      *executor_, *tokenizer_, stop_token_detector,
+      /*num_output_candidates=*/2, *sampler, *decoded_ids, benchmark_info);
+  EXPECT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+  EXPECT_EQ(*(responses->GetResponseTextAt(1)), " Hello World!");
+  EXPECT_EQ(*(responses->GetScoreAt(0)), 0.0f);
+  EXPECT_EQ(*(responses->GetScoreAt(1)), 0.0f);
+}
+
 TEST_F(PipelineCustomSamplingTest, DecodeCustomSamplingReachMaxNumTokens) {
   // Set the max number of tokens to 3.
   executor_->GetMutableExecutorSettings().value()->SetMaxNumTokens(3);
@@ -285,6 +910,73 @@ TEST_F(PipelineCustomSamplingTest, DecodeCustomSamplingReachMaxNumTokens) {
   EXPECT_EQ(*(responses->GetResponseTextAt(1)), " Hello");
 }
 
+// A sampler returning scripted token ids regardless of the logits, each
+// followed by scripted forced tokens.
+class ForcingSampler : public Sampler {
+ public:
+  ForcingSampler(std::vector<int> sampled_ids,
+                 std::vector<std::vector<int>> forced_ids)
+      : sampled_ids_(std::move(sampled_ids)),
+        forced_ids_(std::move(forced_ids)) {}
+
+  absl::Status SampleToIdAndScoreBuffer(const TensorBuffer& logits_tensor,
+                                        TensorBuffer& ids_tensor,
+                                        TensorBuffer* scores_tensor) override {
+    if (num_samples_ >= sampled_ids_.size()) {
+      return absl::OutOfRangeError("No more sampled ids.");
+    }
+    auto ids = ReferTensorBufferAsSpan<int>(ids_tensor);
+    (*ids)[0] = sampled_ids_[num_samples_++];
+    if (scores_tensor != nullptr) {
+      auto scores = ReferTensorBufferAsSpan<float>(*scores_tensor);
+      (*scores)[0] = 0.0f;
+    }
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<std::vector<int>> TakeForcedTokenIds(
+      int max_num_tokens) override {
+    std::vector<int> forced_ids = forced_ids_[num_samples_ - 1];
+    if (forced_ids.size() > max_num_tokens) {
+      forced_ids.resize(max_num_tokens);
+    }
+    return forced_ids;
+  }
+
+ private:
+  const std::vector<int> sampled_ids_;
+  const std::vector<std::vector<int>> forced_ids_;
+  int num_samples_ = 0;
+};
+
+TEST(PipelineForcedTokensTest, PrefillsTheForcedTokens) {
+  auto tokenizer = SentencePieceTokenizer::CreateFromFile(
+      (std::filesystem::path(::testing::SrcDir()) / kTestdataDir /
+       "sentencepiece.model")
+          .string());
+  ASSERT_OK(tokenizer);
+  // " How's it going?!", where the two tokens after 224 and 66 are forced,
+  // so they are prefilled with the sampled token before them, and the next
+  // decode step continues from the last forced token.
+  auto executor = std::make_unique<FakeLlmExecutor>(
+      /*vocab_size=*/2560,
+      std::vector<std::vector<int>>{{224, 24, 8}, {66, 246, 18}},
+      std::vector<std::vector<int>>{{8}, {18}, {2295}, {2294}, {0}});
+  ForcingSampler sampler({224, 66, 2295, 2294, 0},
+                         {{24, 8}, {246, 18}, {}, {}, {}});
+
+  auto decoded_ids = CreateTensorBuffer<int>({1, 1});
+  std::optional<BenchmarkInfo> benchmark_info;
+  StopTokenDetector stop_token_detector(1);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({0}));
+  auto responses = DecodeCustomSampling(
+      *executor, **tokenizer, stop_token_detector,
+      /*num_output_candidates=*/1, sampler, *decoded_ids, benchmark_info);
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+  EXPECT_EQ(*(responses->GetScoreAt(0)), 0.0f);
+}
+
 TEST_F(PipelineCustomSamplingTest, DecodeCustomSamplingStreaming) {
   auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
                                         /*batch_size=*/2, /*seed=*/1);
@@ -305,6 +997,62 @@ TEST_F(PipelineCustomSamplingTest, DecodeCustomSamplingStreaming) {
   EXPECT_EQ(observer.GetResponses()[0], " How's it going?!");
   // Second candidate: " Hello World!".
   EXPECT_EQ(observer.GetResponses()[1], " Hello World!");
+  // The second candidate stops first, and ends its stream before the decode.
+  EXPECT_THAT(observer.GetDoneCandidates(),
+              ElementsAre(Pair(1, " Hello World!"),
+                          Pair(0, " How's it going?!")));
+}
+
+TEST_F(PipelineCustomSamplingTest,
+       DecodeCustomSamplingStreamingStopsACandidateAtItsStopString) {
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  std::unique_ptr<TopPSampler> sampler = std::move(sampler_or.value());
+
+  auto decoded_ids = CreateTensorBuffer<int>({2, 1});
+  TestObserver observer(/*num_candidates=*/2);
+  std::optional<BenchmarkInfo> benchmark_info;
+
+  StopTokenDetector stop_token_detector(2);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({0}));
+  StopStringDetector stop_string_detector;
+  EXPECT_OK(stop_string_detector.AddStopString(" World"));
+  EXPECT_OK(DecodeCustomSamplingStreaming(
+      *executor_, *tokenizer_, stop_token_detector,
+      /*num_output_candidates=*/2, *sampler, *decoded_ids, benchmark_info,
+      &observer, /*context_shift_config=*/std::nullopt,
+      /*overlap_output_processing=*/false, &stop_string_detector));
+  // The second candidate stops at the stop string, the first one decodes on.
+  EXPECT_EQ(observer.GetResponses()[0], " How's it going?!");
+  EXPECT_EQ(observer.GetResponses()[1], " Hello");
+  EXPECT_THAT(observer.GetDoneCandidates(),
+              ElementsAre(Pair(1, " Hello"), Pair(0, " How's it going?!")));
+}
+
+TEST_F(PipelineCustomSamplingTest,
+       DecodeCustomSamplingStreamingOverlapOutputProcessing) {
+  auto sampler_or = TopPSampler::Create(/*k=*/1, /*p=*/0.5, /*temperature=*/1.0,
+                                        /*batch_size=*/2, /*seed=*/1);
+  EXPECT_TRUE(sampler_or.ok());
+  std::unique_ptr<TopPSampler> sampler = std::move(sampler_or.value());
+
+  auto decoded_ids = CreateTensorBuffer<int>({2, 1});
+  TestObserver observer(/*num_candidates=*/2);
+  std::optional<BenchmarkInfo> benchmark_info;
+
+  StopTokenDetector stop_token_detector(2);
+  EXPECT_OK(stop_token_detector.AddStopTokenSequence({0}));
+  EXPECT_OK(DecodeCustomSamplingStreaming(
+      *executor_, *tokenizer_, stop_token_detector,
+      /*num_output_candidates=*/2, *sampler, *decoded_ids, benchmark_info,
+      &observer, /*context_shift_config=*/std::nullopt,
+      /*overlap_output_processing=*/true));
+  EXPECT_EQ(observer.GetResponses()[0], " How's it going?!");
+  EXPECT_EQ(observer.GetResponses()[1], " Hello World!");
+  EXPECT_THAT(observer.GetDoneCandidates(),
+              ElementsAre(Pair(1, " Hello World!"),
+                          Pair(0, " How's it going?!")));
 }
 
 TEST_F(PipelineCustomSamplingTest,
@@ -330,6 +1078,8 @@ TEST_F(PipelineCustomSamplingTest,
   EXPECT_EQ(observer.GetResponses()[0], " How's");
   // Second candidate truncated at max number of tokens: " Hello".
   EXPECT_EQ(observer.GetResponses()[1], " Hello");
+  // The truncated candidates are only ended by OnDone().
+  EXPECT_TRUE(observer.GetDoneCandidates().empty());
 }
 
 }  // namespace
@@ -0,0 +1,318 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/prefix_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>  // NOLINT
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <system_error>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/strings/strip.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/util/binary_serialization.h"
+#include "runtime/util/status_macros.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+constexpr uint64_t kHashOffset = 0xcbf29ce484222325ULL;
+constexpr uint64_t kHashPrime = 0x100000001b3ULL;
+
+// Extends the FNV-1a hash of a token id prefix by one more token id, such that
+// the hashes of all the prefixes can be computed in a single pass.
+uint64_t ExtendHash(uint64_t hash, int token_id) {
+  return (hash ^ static_cast<uint32_t>(token_id)) * kHashPrime;
+}
+
+uint64_t HashTokenIds(absl::Span<const int> token_ids) {
+  uint64_t hash = kHashOffset;
+  for (int token_id : token_ids) {
+    hash = ExtendHash(hash, token_id);
+  }
+  return hash;
+}
+
+uint64_t HashBytes(absl::string_view bytes) {
+  uint64_t hash = kHashOffset;
+  for (char byte : bytes) {
+    hash = (hash ^ static_cast<uint8_t>(byte)) * kHashPrime;
+  }
+  return hash;
+}
+
+// The magic and the version of the files holding the token ids of the
+// persisted entries, next to their checkpoint files.
+constexpr absl::string_view kTokensFileMagic = "LMPT";
+constexpr uint32_t kTokensFileVersion = 1;
+constexpr absl::string_view kTokensFileExtension = ".tokens";
+constexpr absl::string_view kCheckpointFileExtension = ".ckpt";
+
+absl::Status RenameFile(const std::string& from, const std::string& to) {
+  std::error_code error;
+  std::filesystem::rename(from, to, error);
+  if (error) {
+    return absl::InternalError(absl::StrCat("Failed to rename ", from, " to ",
+                                            to, ": ", error.message()));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<PrefixCache>> PrefixCache::Create(
+    size_t max_size_in_bytes) {
+  if (max_size_in_bytes == 0) {
+    return absl::InvalidArgumentError(
+        "The prefix cache budget must be positive.");
+  }
+  return absl::WrapUnique(new PrefixCache(max_size_in_bytes));
+}
+
+std::optional<PrefixCache::Match> PrefixCache::Lookup(
+    absl::Span<const int> token_ids, int min_num_tokens) {
+  std::optional<std::list<Entry>::iterator> best;
+  uint64_t hash = kHashOffset;
+  for (int i = 0; i < token_ids.size(); ++i) {
+    hash = ExtendHash(hash, token_ids[i]);
+    const int num_tokens = i + 1;
+    if (num_tokens <= min_num_tokens) {
+      continue;
+    }
+    auto it = index_.find(hash);
+    if (it == index_.end()) {
+      continue;
+    }
+    // Guard against hash collisions.
+    if (it->second->token_ids == token_ids.subspan(0, num_tokens)) {
+      best = it->second;
+    }
+  }
+  if (!best.has_value()) {
+    ++num_misses_;
+    return std::nullopt;
+  }
+  ++num_hits_;
+  entries_.splice(entries_.begin(), entries_, *best);
+  Entry& entry = **best;
+  ++entry.num_hits;
+  if (persistence_.has_value() && !entry.persisted &&
+      entry.num_hits >= persistence_->min_num_hits_to_persist) {
+    // Only tried once, so that a failing disk does not slow every lookup.
+    entry.persisted = true;
+    if (absl::Status status = Persist(entry); !status.ok()) {
+      ABSL_LOG(WARNING) << "Failed to persist a prefix of "
+                        << entry.token_ids.size() << " tokens: " << status;
+    }
+  }
+  return Match{.num_tokens = static_cast<int>((*best)->token_ids.size()),
+               .checkpoint = (*best)->checkpoint};
+}
+
+bool PrefixCache::Contains(absl::Span<const int> token_ids) const {
+  auto it = index_.find(HashTokenIds(token_ids));
+  return it != index_.end() && it->second->token_ids == token_ids;
+}
+
+void PrefixCache::Insert(absl::Span<const int> token_ids,
+                         std::unique_ptr<ExecutorCheckpoint> checkpoint) {
+  const uint64_t hash = HashTokenIds(token_ids);
+  // The checkpoint of the same token ids holds the same state, so it does not
+  // need to be persisted again.
+  bool persisted = false;
+  if (auto it = index_.find(hash); it != index_.end()) {
+    persisted = it->second->token_ids == token_ids && it->second->persisted;
+    Erase(it->second);
+  }
+  const size_t size_in_bytes =
+      checkpoint->GetSizeInBytes() + token_ids.size() * sizeof(int);
+  if (size_in_bytes > max_size_in_bytes_) {
+    return;
+  }
+  while (size_in_bytes_ + size_in_bytes > max_size_in_bytes_) {
+    Erase(std::prev(entries_.end()));
+  }
+  entries_.push_front(Entry{
+      .hash = hash,
+      .token_ids = std::vector<int>(token_ids.begin(), token_ids.end()),
+      .checkpoint = std::move(checkpoint),
+      .size_in_bytes = size_in_bytes,
+      .persisted = persisted});
+  index_[hash] = entries_.begin();
+  size_in_bytes_ += size_in_bytes;
+}
+
+void PrefixCache::Clear() {
+  entries_.clear();
+  index_.clear();
+  size_in_bytes_ = 0;
+}
+
+void PrefixCache::Erase(std::list<Entry>::iterator it) {
+  size_in_bytes_ -= it->size_in_bytes;
+  index_.erase(it->hash);
+  entries_.erase(it);
+}
+
+absl::Status PrefixCache::EnablePersistence(absl::string_view directory,
+                                            absl::string_view namespace_key,
+                                            int min_num_hits_to_persist) {
+  if (persistence_.has_value()) {
+    return absl::FailedPreconditionError(
+        "The prefix cache persistence is already enabled.");
+  }
+  if (min_num_hits_to_persist < 1) {
+    return absl::InvalidArgumentError(
+        "The min number of hits to persist an entry must be positive.");
+  }
+  std::error_code error;
+  std::filesystem::create_directories(std::string(directory), error);
+  if (error) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to create the directory ", directory, ": ", error.message()));
+  }
+  persistence_ = Persistence{
+      .directory = std::string(directory),
+      .namespace_hash = HashBytes(namespace_key),
+      .min_num_hits_to_persist = min_num_hits_to_persist};
+
+  const std::string file_prefix =
+      absl::StrCat(absl::Hex(persistence_->namespace_hash, absl::kZeroPad16),
+                   "-");
+  std::vector<std::string> paths;
+  for (const auto& file :
+       std::filesystem::directory_iterator(persistence_->directory, error)) {
+    const std::filesystem::path& path = file.path();
+    if (path.extension().string() == kTokensFileExtension &&
+        absl::StartsWith(path.filename().string(), file_prefix)) {
+      paths.push_back(path.string());
+    }
+  }
+  if (error) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to list the directory ", directory, ": ", error.message()));
+  }
+  for (const std::string& path : paths) {
+    if (absl::Status status = LoadPersisted(path); !status.ok()) {
+      ABSL_LOG(WARNING) << "Skipped the persisted prefix " << path << ": "
+                        << status;
+    }
+  }
+  return absl::OkStatus();
+}
+
+std::string PrefixCache::GetPersistedPath(uint64_t hash) const {
+  return (std::filesystem::path(persistence_->directory) /
+          absl::StrCat(absl::Hex(persistence_->namespace_hash,
+                                 absl::kZeroPad16),
+                       "-", absl::Hex(hash, absl::kZeroPad16)))
+      .string();
+}
+
+absl::Status PrefixCache::Persist(const Entry& entry) {
+  const std::string path = GetPersistedPath(entry.hash);
+  const std::string checkpoint_path =
+      absl::StrCat(path, kCheckpointFileExtension);
+  const std::string tokens_path = absl::StrCat(path, kTokensFileExtension);
+  // Both files are written aside and renamed over the existing ones, so a
+  // loaded file still mapped by a checkpoint is never modified. The tokens
+  // file is renamed last, as it marks the entry as complete.
+  RETURN_IF_ERROR(
+      entry.checkpoint->SaveToFile(absl::StrCat(checkpoint_path, ".tmp")));
+  std::string tokens;
+  tokens.append(kTokensFileMagic.data(), kTokensFileMagic.size());
+  AppendValue<uint32_t>(kTokensFileVersion, tokens);
+  AppendValue<uint64_t>(persistence_->namespace_hash, tokens);
+  AppendValue<uint32_t>(entry.token_ids.size(), tokens);
+  for (int token_id : entry.token_ids) {
+    AppendValue<int32_t>(token_id, tokens);
+  }
+  std::ofstream file(absl::StrCat(tokens_path, ".tmp"),
+                     std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return absl::InternalError(
+        absl::StrCat("Failed to open ", tokens_path, ".tmp for writing."));
+  }
+  file.write(tokens.data(), tokens.size());
+  file.close();
+  if (!file) {
+    return absl::InternalError(
+        absl::StrCat("Failed to write ", tokens_path, ".tmp."));
+  }
+  RETURN_IF_ERROR(
+      RenameFile(absl::StrCat(checkpoint_path, ".tmp"), checkpoint_path));
+  RETURN_IF_ERROR(RenameFile(absl::StrCat(tokens_path, ".tmp"), tokens_path));
+  ++num_persisted_;
+  return absl::OkStatus();
+}
+
+absl::Status PrefixCache::LoadPersisted(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return absl::InternalError(absl::StrCat("Failed to open ", path, "."));
+  }
+  const std::string contents((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+  absl::string_view in = contents;
+  uint32_t version = 0;
+  uint64_t namespace_hash = 0;
+  uint32_t num_tokens = 0;
+  if (!absl::ConsumePrefix(&in, kTokensFileMagic) ||
+      !ConsumeValue(in, version) || !ConsumeValue(in, namespace_hash) ||
+      !ConsumeValue(in, num_tokens) ||
+      in.size() != num_tokens * sizeof(int32_t)) {
+    return absl::DataLossError(
+        absl::StrCat(path, " is not a valid prefix file."));
+  }
+  if (version != kTokensFileVersion ||
+      namespace_hash != persistence_->namespace_hash) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(path, " belongs to another version or model."));
+  }
+  std::vector<int> token_ids(num_tokens);
+  for (int& token_id : token_ids) {
+    int32_t value = 0;
+    ConsumeValue(in, value);
+    token_id = value;
+  }
+  const uint64_t hash = HashTokenIds(token_ids);
+  ASSIGN_OR_RETURN(std::unique_ptr<ExecutorCheckpoint> checkpoint,
+                   ExecutorCheckpoint::LoadFromFile(absl::StrCat(
+                       GetPersistedPath(hash), kCheckpointFileExtension)));
+  Insert(token_ids, std::move(checkpoint));
+  if (auto it = index_.find(hash); it != index_.end()) {
+    it->second->persisted = true;
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,151 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_PREFIX_CACHE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_PREFIX_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/llm_executor_io_types.h"
+
+namespace litert::lm {
+
+// An LRU cache of executor checkpoints keyed by the token ids that were
+// prefilled to produce them. The engine stores a checkpoint at the end of each
+// prefill chunk, and a later prefill can restore the longest cached prefix of
+// its token ids and only prefill the remaining suffix.
+//
+// The cache is bounded by the total size of the stored checkpoints. The least
+// recently used entries are evicted first when a new entry does not fit.
+//
+// The frequently used entries, e.g. those of a system prompt, can also be
+// persisted to disk with EnablePersistence(), so that they are loaded back by
+// the cache of the next process instead of being prefilled again.
+//
+// The class is not thread-safe. The engine only accesses it from its worker
+// thread.
+class PrefixCache {
+ public:
+  // A cached prefix returned by Lookup().
+  struct Match {
+    // The number of leading token ids covered by the checkpoint.
+    int num_tokens = 0;
+    std::shared_ptr<const ExecutorCheckpoint> checkpoint;
+  };
+
+  // Creates a PrefixCache that holds at most `max_size_in_bytes` of
+  // checkpoints.
+  static absl::StatusOr<std::unique_ptr<PrefixCache>> Create(
+      size_t max_size_in_bytes);
+
+  // Returns the longest cached prefix of `token_ids` that covers more than
+  // `min_num_tokens` tokens, or std::nullopt if there is none. The matched
+  // entry becomes the most recently used one. Every call is counted as either
+  // a hit or a miss.
+  std::optional<Match> Lookup(absl::Span<const int> token_ids,
+                              int min_num_tokens = 0);
+
+  // Returns true if a checkpoint for exactly `token_ids` is cached.
+  bool Contains(absl::Span<const int> token_ids) const;
+
+  // Stores the checkpoint produced by prefilling `token_ids`, replacing any
+  // existing entry for the same token ids. Entries larger than the whole
+  // budget are dropped.
+  void Insert(absl::Span<const int> token_ids,
+              std::unique_ptr<ExecutorCheckpoint> checkpoint);
+
+  // Removes all the entries. The hit and miss counters are kept. The persisted
+  // files are kept too.
+  void Clear();
+
+  // Persists the entries hit at least `min_num_hits_to_persist` times to files
+  // in `directory`, which is created if needed, named after the hashes of
+  // `namespace_key` and of their token ids. The key identifies the model and
+  // the executor the checkpoints are taken from, e.g. the model file and the
+  // executor settings, so that the files of another model are never loaded.
+  // The files of the same key already in the directory are loaded as entries,
+  // in the format of ExecutorCheckpoint::SaveToFile(), memory mapped such that
+  // they take little host memory until restored. Called once, before the other
+  // methods. A file that fails to load is skipped.
+  absl::Status EnablePersistence(absl::string_view directory,
+                                 absl::string_view namespace_key,
+                                 int min_num_hits_to_persist = 2);
+
+  int NumEntries() const { return entries_.size(); }
+  size_t SizeInBytes() const { return size_in_bytes_; }
+  size_t MaxSizeInBytes() const { return max_size_in_bytes_; }
+  int NumHits() const { return num_hits_; }
+  int NumMisses() const { return num_misses_; }
+  // The number of entries written to disk by this cache.
+  int NumPersisted() const { return num_persisted_; }
+
+ private:
+  struct Entry {
+    uint64_t hash;
+    std::vector<int> token_ids;
+    std::shared_ptr<const ExecutorCheckpoint> checkpoint;
+    size_t size_in_bytes;
+    int num_hits = 0;
+    // Whether the entry is on disk already, or failed to be written to it.
+    bool persisted = false;
+  };
+
+  struct Persistence {
+    std::string directory;
+    uint64_t namespace_hash;
+    int min_num_hits_to_persist;
+  };
+
+  explicit PrefixCache(size_t max_size_in_bytes)
+      : max_size_in_bytes_(max_size_in_bytes) {}
+
+  // Removes the entry pointed to by `it` from the cache.
+  void Erase(std::list<Entry>::iterator it);
+
+  // Returns the path of the files of the entry of `hash`, without extension.
+  std::string GetPersistedPath(uint64_t hash) const;
+
+  // Writes `entry` to disk.
+  absl::Status Persist(const Entry& entry);
+
+  // Loads the entry persisted at `path` of the `.tokens` file.
+  absl::Status LoadPersisted(const std::string& path);
+
+  const size_t max_size_in_bytes_;
+  size_t size_in_bytes_ = 0;
+  int num_hits_ = 0;
+  int num_misses_ = 0;
+  int num_persisted_ = 0;
+  std::optional<Persistence> persistence_;
+
+  // The entries ordered from the most to the least recently used.
+  std::list<Entry> entries_;
+  // The entries keyed by the hash of their token ids.
+  absl::flat_hash_map<uint64_t, std::list<Entry>::iterator> index_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_PREFIX_CACHE_H_
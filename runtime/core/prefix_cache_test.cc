@@ -0,0 +1,168 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/prefix_cache.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>  // NOLINT
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+// Creates a checkpoint covering `num_tokens` tokens whose kv-cache holds
+// `size_in_bytes` bytes.
+std::unique_ptr<ExecutorCheckpoint> CreateCheckpoint(int num_tokens,
+                                                     size_t size_in_bytes) {
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  kv_cache["kv_cache_k_0"] = std::vector<uint8_t>(size_in_bytes);
+  return std::make_unique<ExecutorCheckpoint>(
+      num_tokens, /*next_input_token_id=*/-1, std::move(kv_cache));
+}
+
+TEST(PrefixCacheTest, CreateRejectsZeroBudget) {
+  EXPECT_THAT(PrefixCache::Create(/*max_size_in_bytes=*/0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(PrefixCacheTest, LookupFindsLongestPrefix) {
+  ASSERT_OK_AND_ASSIGN(auto cache, PrefixCache::Create(1024));
+  cache->Insert({1, 2}, CreateCheckpoint(2, 16));
+  cache->Insert({1, 2, 3, 4}, CreateCheckpoint(4, 16));
+  cache->Insert({1, 5, 6}, CreateCheckpoint(3, 16));
+  EXPECT_EQ(cache->NumEntries(), 3);
+
+  auto match = cache->Lookup({1, 2, 3, 4, 5});
+  ASSERT_TRUE(match.has_value());
+  EXPECT_EQ(match->num_tokens, 4);
+  EXPECT_EQ(match->checkpoint->GetNumTokens(), 4);
+
+  match = cache->Lookup({1, 2, 3});
+  ASSERT_TRUE(match.has_value());
+  EXPECT_EQ(match->num_tokens, 2);
+
+  EXPECT_FALSE(cache->Lookup({2, 1}).has_value());
+  EXPECT_EQ(cache->NumHits(), 2);
+  EXPECT_EQ(cache->NumMisses(), 1);
+}
+
+TEST(PrefixCacheTest, LookupSkipsPrefixesNotLongerThanMinimum) {
+  ASSERT_OK_AND_ASSIGN(auto cache, PrefixCache::Create(1024));
+  cache->Insert({1, 2}, CreateCheckpoint(2, 16));
+  EXPECT_FALSE(cache->Lookup({1, 2, 3}, /*min_num_tokens=*/2).has_value());
+  EXPECT_TRUE(cache->Lookup({1, 2, 3}, /*min_num_tokens=*/1).has_value());
+}
+
+TEST(PrefixCacheTest, InsertEvictsLeastRecentlyUsed) {
+  // Each entry takes 100 bytes of kv-cache plus the token ids.
+  ASSERT_OK_AND_ASSIGN(auto cache, PrefixCache::Create(250));
+  cache->Insert({1}, CreateCheckpoint(1, 100));
+  cache->Insert({2}, CreateCheckpoint(1, 100));
+  EXPECT_EQ(cache->SizeInBytes(), 2 * (100 + sizeof(int)));
+
+  // Touch {1} so that {2} becomes the least recently used entry.
+  EXPECT_TRUE(cache->Lookup({1}).has_value());
+  cache->Insert({3}, CreateCheckpoint(1, 100));
+  EXPECT_EQ(cache->NumEntries(), 2);
+  EXPECT_TRUE(cache->Contains({1}));
+  EXPECT_FALSE(cache->Contains({2}));
+  EXPECT_TRUE(cache->Contains({3}));
+  EXPECT_LE(cache->SizeInBytes(), cache->MaxSizeInBytes());
+}
+
+TEST(PrefixCacheTest, InsertDropsEntryLargerThanBudget) {
+  ASSERT_OK_AND_ASSIGN(auto cache, PrefixCache::Create(64));
+  cache->Insert({1, 2}, CreateCheckpoint(2, 128));
+  EXPECT_EQ(cache->NumEntries(), 0);
+  EXPECT_EQ(cache->SizeInBytes(), 0);
+}
+
+TEST(PrefixCacheTest, InsertReplacesSameTokenIds) {
+  ASSERT_OK_AND_ASSIGN(auto cache, PrefixCache::Create(1024));
+  cache->Insert({1, 2}, CreateCheckpoint(2, 16));
+  cache->Insert({1, 2}, CreateCheckpoint(2, 32));
+  EXPECT_EQ(cache->NumEntries(), 1);
+  EXPECT_EQ(cache->SizeInBytes(), 32 + 2 * sizeof(int));
+
+  cache->Clear();
+  EXPECT_EQ(cache->NumEntries(), 0);
+  EXPECT_EQ(cache->SizeInBytes(), 0);
+  EXPECT_FALSE(cache->Contains({1, 2}));
+}
+
+TEST(PrefixCacheTest, PersistsFrequentlyUsedEntries) {
+  const std::string directory =
+      (std::filesystem::path(::testing::TempDir()) / "prefix_cache_persisted")
+          .string();
+  std::filesystem::remove_all(directory);
+  {
+    ASSERT_OK_AND_ASSIGN(auto cache, PrefixCache::Create(1024));
+    ASSERT_OK(cache->EnablePersistence(directory, "model_a"));
+    cache->Insert({1, 2}, CreateCheckpoint(2, 16));
+    cache->Insert({3, 4}, CreateCheckpoint(2, 16));
+    // Only {1, 2} is hit twice.
+    EXPECT_TRUE(cache->Lookup({1, 2, 5}).has_value());
+    EXPECT_EQ(cache->NumPersisted(), 0);
+    EXPECT_TRUE(cache->Lookup({1, 2, 6}).has_value());
+    EXPECT_TRUE(cache->Lookup({3, 4}).has_value());
+    EXPECT_EQ(cache->NumPersisted(), 1);
+    // Not written again.
+    EXPECT_TRUE(cache->Lookup({1, 2, 6}).has_value());
+    EXPECT_EQ(cache->NumPersisted(), 1);
+  }
+
+  ASSERT_OK_AND_ASSIGN(auto cache, PrefixCache::Create(1024));
+  ASSERT_OK(cache->EnablePersistence(directory, "model_a"));
+  EXPECT_EQ(cache->NumEntries(), 1);
+  auto match = cache->Lookup({1, 2, 3});
+  ASSERT_TRUE(match.has_value());
+  EXPECT_EQ(match->num_tokens, 2);
+  EXPECT_TRUE(match->checkpoint->IsOffloaded());
+  ASSERT_OK_AND_ASSIGN(auto tensor,
+                       match->checkpoint->GetKvCacheTensor("kv_cache_k_0"));
+  EXPECT_EQ(tensor.size(), 16);
+  EXPECT_FALSE(cache->Contains({3, 4}));
+
+  // The entries of another model are not loaded.
+  ASSERT_OK_AND_ASSIGN(auto other_cache, PrefixCache::Create(1024));
+  ASSERT_OK(other_cache->EnablePersistence(directory, "model_b"));
+  EXPECT_EQ(other_cache->NumEntries(), 0);
+}
+
+TEST(PrefixCacheTest, EnablePersistenceRejectsInvalidArguments) {
+  const std::string directory =
+      (std::filesystem::path(::testing::TempDir()) / "prefix_cache_invalid")
+          .string();
+  ASSERT_OK_AND_ASSIGN(auto cache, PrefixCache::Create(1024));
+  EXPECT_THAT(cache->EnablePersistence(directory, "model",
+                                       /*min_num_hits_to_persist=*/0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  ASSERT_OK(cache->EnablePersistence(directory, "model"));
+  EXPECT_THAT(cache->EnablePersistence(directory, "model"),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,137 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/core/response_cache.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/engine/engine_settings.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/proto/sampler_params.pb.h"
+
+namespace litert::lm {
+namespace {
+
+// Returns the bytes held by `responses`, without the fixed size of the
+// containers.
+size_t GetSizeInBytes(const Responses& responses) {
+  size_t size_in_bytes = 0;
+  for (int i = 0; i < responses.GetNumOutputCandidates(); ++i) {
+    if (auto text = responses.GetResponseTextAt(i); text.ok()) {
+      size_in_bytes += text->size();
+    }
+    if (auto top_log_probs = responses.GetTopLogProbsAt(i);
+        top_log_probs.ok()) {
+      for (const auto& step : *top_log_probs) {
+        size_in_bytes += step.size() * sizeof(TokenLogProb);
+      }
+    }
+  }
+  return size_in_bytes + responses.GetNumOutputCandidates() * sizeof(float);
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<ResponseCache>> ResponseCache::Create(
+    size_t max_size_in_bytes) {
+  if (max_size_in_bytes == 0) {
+    return absl::InvalidArgumentError(
+        "The response cache budget must be positive.");
+  }
+  return absl::WrapUnique(new ResponseCache(max_size_in_bytes));
+}
+
+// static
+std::string ResponseCache::GetDecodingKey(
+    const SessionConfig& session_config) {
+  const proto::SamplerParameters& sampler_params =
+      session_config.GetSamplerParams();
+  const proto::SamplerParameters::Type type = sampler_params.type();
+  // The GPU sampler ignores the sampler type, but not k.
+  const bool greedy =
+      ((type == proto::SamplerParameters::GREEDY ||
+        type == proto::SamplerParameters::TOP_K ||
+        type == proto::SamplerParameters::TOP_P) &&
+       sampler_params.k() == 1) ||
+      (type == proto::SamplerParameters::GREEDY &&
+       session_config.GetSamplerBackend() == Backend::CPU);
+  // The recorded or constrained decodes depend on more than the config.
+  if (!greedy || session_config.GetNumOutputCandidates() != 1 ||
+      session_config.GetDecodeTimeBudget() != absl::InfiniteDuration() ||
+      session_config.GetContextShiftConfig().has_value() ||
+      session_config.GetConstrainedDecodingOptions().has_value() ||
+      session_config.GetDecodeRecorder() != nullptr) {
+    return "";
+  }
+  // The strings are prefixed by their size, so that the key is unambiguous.
+  std::string key =
+      absl::StrCat(session_config.GetStartTokenId(), ";",
+                   session_config.GetNumTopLogProbs(), ";",
+                   session_config.GetMaxOutputTokens().value_or(-1), ";");
+  const std::string serialized_sampler_params =
+      sampler_params.SerializeAsString();
+  absl::StrAppend(&key, serialized_sampler_params.size(), ":",
+                  serialized_sampler_params);
+  for (const std::vector<int>& stop_token_ids :
+       session_config.GetStopTokenIds()) {
+    absl::StrAppend(&key, "[", absl::StrJoin(stop_token_ids, ","), "]");
+  }
+  absl::StrAppend(&key, ";");
+  for (const std::string& stop_string : session_config.GetStopStrings()) {
+    absl::StrAppend(&key, stop_string.size(), ":", stop_string);
+  }
+  const std::string prompt_templates =
+      session_config.GetPromptTemplates().SerializeAsString();
+  const std::string& lora_adapter_name = session_config.GetLoraAdapterName();
+  absl::StrAppend(&key, ";", prompt_templates.size(), ":", prompt_templates,
+                  ";", lora_adapter_name.size(), ":", lora_adapter_name);
+  return key;
+}
+
+std::shared_ptr<const Responses> ResponseCache::Lookup(
+    absl::string_view decoding_key, absl::Span<const int> token_ids) {
+  const std::shared_ptr<const Responses>* responses = cache_.Lookup(
+      Key(decoding_key, std::vector<int>(token_ids.begin(), token_ids.end())));
+  return responses == nullptr ? nullptr : *responses;
+}
+
+void ResponseCache::Insert(absl::string_view decoding_key,
+                           absl::Span<const int> token_ids,
+                           Responses responses) {
+  const size_t size_in_bytes = decoding_key.size() +
+                               token_ids.size() * sizeof(int) +
+                               GetSizeInBytes(responses);
+  cache_.Insert(
+      Key(decoding_key, std::vector<int>(token_ids.begin(), token_ids.end())),
+      std::make_shared<const Responses>(std::move(responses)), size_in_bytes);
+}
+
+void ResponseCache::Clear() { cache_.Clear(); }
+
+}  // namespace litert::lm
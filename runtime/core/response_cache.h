@@ -0,0 +1,95 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_RESPONSE_CACHE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_RESPONSE_CACHE_H_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/engine/engine_settings.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/util/lru_cache.h"
+
+namespace litert::lm {
+
+// An LRU cache of the responses of the deterministic decodes, e.g. of the
+// repeated greedy prompts of canned suggestions or classifications. The
+// responses are keyed by the token ids of the prompt and by the decoding key
+// of the session config, such that a session sending a prompt already
+// answered with the same decoding gets the same responses without running the
+// executor. The cache is owned by the executor, which only runs one model, so
+// the model is implied by the cache.
+//
+// The cache is bounded by the total size of the stored responses. The least
+// recently used entries are evicted first when a new entry does not fit.
+//
+// The class is not thread-safe. The engine only accesses it from the worker
+// thread of its executor.
+class ResponseCache {
+ public:
+  // Creates a ResponseCache that holds at most `max_size_in_bytes` of
+  // responses.
+  static absl::StatusOr<std::unique_ptr<ResponseCache>> Create(
+      size_t max_size_in_bytes);
+
+  // Returns the key of the decoding of `session_config`, or an empty string if
+  // the decoding is not deterministic, and so its responses are not cached.
+  // Only the greedy decoding of a single output candidate, i.e. with k = 1 or
+  // GREEDY on the CPU sampler, not bounded by time and not shifting its
+  // context, is deterministic.
+  static std::string GetDecodingKey(const SessionConfig& session_config);
+
+  // Returns the responses of the prompt of `token_ids` decoded with
+  // `decoding_key`, or nullptr if there are none. The matched entry becomes
+  // the most recently used one. Every call is counted as either a hit or a
+  // miss.
+  std::shared_ptr<const Responses> Lookup(absl::string_view decoding_key,
+                                          absl::Span<const int> token_ids);
+
+  // Stores the responses of the prompt of `token_ids` decoded with
+  // `decoding_key`, replacing any existing entry for the same key. Entries
+  // larger than the whole budget are dropped.
+  void Insert(absl::string_view decoding_key, absl::Span<const int> token_ids,
+              Responses responses);
+
+  // Removes all the entries. The hit and miss counters are kept.
+  void Clear();
+
+  int NumEntries() const { return cache_.NumEntries(); }
+  size_t SizeInBytes() const { return cache_.SizeInBytes(); }
+  size_t MaxSizeInBytes() const { return cache_.MaxSizeInBytes(); }
+  int NumHits() const { return cache_.NumHits(); }
+  int NumMisses() const { return cache_.NumMisses(); }
+
+ private:
+  // The decoding key and the token ids of a prompt.
+  using Key = std::pair<std::string, std::vector<int>>;
+
+  explicit ResponseCache(size_t max_size_in_bytes)
+      : cache_(max_size_in_bytes) {}
+
+  LruCache<Key, std::shared_ptr<const Responses>> cache_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_RESPONSE_CACHE_H_
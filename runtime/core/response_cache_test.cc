@@ -0,0 +1,162 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/core/response_cache.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/engine_settings.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/proto/sampler_params.pb.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::IsEmpty;
+using ::testing::Not;
+using ::testing::status::IsOkAndHolds;
+using ::testing::status::StatusIs;
+
+// Creates the responses of a single candidate of `text`.
+Responses CreateResponses(const std::string& text) {
+  Responses responses(/*num_output_candidates=*/1);
+  responses.GetMutableResponseTexts()[0] = text;
+  return responses;
+}
+
+// Returns the config of a greedy decoding on the CPU sampler.
+SessionConfig CreateGreedySessionConfig() {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.SetSamplerBackend(Backend::CPU);
+  session_config.GetMutableSamplerParams().set_type(
+      proto::SamplerParameters::GREEDY);
+  return session_config;
+}
+
+TEST(ResponseCacheTest, CreateRejectsZeroBudget) {
+  EXPECT_THAT(ResponseCache::Create(/*max_size_in_bytes=*/0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ResponseCacheTest, LookupMatchesDecodingKeyAndTokenIds) {
+  ASSERT_OK_AND_ASSIGN(auto cache, ResponseCache::Create(1024));
+  cache->Insert("greedy", {1, 2}, CreateResponses("yes"));
+  cache->Insert("greedy", {1, 3}, CreateResponses("no"));
+  EXPECT_EQ(cache->NumEntries(), 2);
+
+  auto responses = cache->Lookup("greedy", {1, 2});
+  ASSERT_NE(responses, nullptr);
+  EXPECT_THAT(responses->GetResponseTextAt(0), IsOkAndHolds("yes"));
+  EXPECT_NE(cache->Lookup("greedy", {1, 3}), nullptr);
+
+  // The same prompt decoded otherwise is another entry.
+  EXPECT_EQ(cache->Lookup("max_tokens", {1, 2}), nullptr);
+  EXPECT_EQ(cache->Lookup("greedy", {1}), nullptr);
+  EXPECT_EQ(cache->NumHits(), 2);
+  EXPECT_EQ(cache->NumMisses(), 2);
+}
+
+TEST(ResponseCacheTest, InsertEvictsLeastRecentlyUsed) {
+  // Each entry takes 100 bytes of text, plus the key, the token id and the
+  // score.
+  const size_t entry_size = 100 + 1 + sizeof(int) + sizeof(float);
+  ASSERT_OK_AND_ASSIGN(auto cache, ResponseCache::Create(2 * entry_size + 50));
+  cache->Insert("k", {1}, CreateResponses(std::string(100, 'a')));
+  cache->Insert("k", {2}, CreateResponses(std::string(100, 'b')));
+  EXPECT_EQ(cache->SizeInBytes(), 2 * entry_size);
+
+  // Touch {1} so that {2} becomes the least recently used entry.
+  EXPECT_NE(cache->Lookup("k", {1}), nullptr);
+  cache->Insert("k", {3}, CreateResponses(std::string(100, 'c')));
+  EXPECT_EQ(cache->NumEntries(), 2);
+  EXPECT_NE(cache->Lookup("k", {1}), nullptr);
+  EXPECT_EQ(cache->Lookup("k", {2}), nullptr);
+  EXPECT_NE(cache->Lookup("k", {3}), nullptr);
+  EXPECT_LE(cache->SizeInBytes(), cache->MaxSizeInBytes());
+}
+
+TEST(ResponseCacheTest, InsertDropsEntryLargerThanBudget) {
+  ASSERT_OK_AND_ASSIGN(auto cache, ResponseCache::Create(64));
+  cache->Insert("k", {1}, CreateResponses(std::string(128, 'a')));
+  EXPECT_EQ(cache->NumEntries(), 0);
+  EXPECT_EQ(cache->SizeInBytes(), 0);
+}
+
+TEST(ResponseCacheTest, InsertReplacesSameKey) {
+  ASSERT_OK_AND_ASSIGN(auto cache, ResponseCache::Create(1024));
+  cache->Insert("k", {1}, CreateResponses("first"));
+  cache->Insert("k", {1}, CreateResponses("second"));
+  EXPECT_EQ(cache->NumEntries(), 1);
+  auto responses = cache->Lookup("k", {1});
+  ASSERT_NE(responses, nullptr);
+  EXPECT_THAT(responses->GetResponseTextAt(0), IsOkAndHolds("second"));
+
+  cache->Clear();
+  EXPECT_EQ(cache->NumEntries(), 0);
+  EXPECT_EQ(cache->SizeInBytes(), 0);
+  EXPECT_EQ(cache->Lookup("k", {1}), nullptr);
+}
+
+TEST(ResponseCacheTest, GetDecodingKeyOfDeterministicDecodings) {
+  SessionConfig greedy = CreateGreedySessionConfig();
+  const std::string greedy_key = ResponseCache::GetDecodingKey(greedy);
+  EXPECT_THAT(greedy_key, Not(IsEmpty()));
+
+  SessionConfig top_1 = CreateGreedySessionConfig();
+  top_1.GetMutableSamplerParams().set_type(proto::SamplerParameters::TOP_P);
+  top_1.GetMutableSamplerParams().set_k(1);
+  EXPECT_THAT(ResponseCache::GetDecodingKey(top_1), Not(IsEmpty()));
+
+  // The decoding parameters are part of the key.
+  SessionConfig max_tokens = CreateGreedySessionConfig();
+  max_tokens.SetMaxOutputTokens(8);
+  EXPECT_NE(ResponseCache::GetDecodingKey(max_tokens), greedy_key);
+  SessionConfig lora = CreateGreedySessionConfig();
+  lora.SetLoraAdapterName("adapter");
+  EXPECT_NE(ResponseCache::GetDecodingKey(lora), greedy_key);
+}
+
+TEST(ResponseCacheTest, GetDecodingKeyOfNonDeterministicDecodings) {
+  SessionConfig top_k = CreateGreedySessionConfig();
+  top_k.GetMutableSamplerParams().set_type(proto::SamplerParameters::TOP_K);
+  top_k.GetMutableSamplerParams().set_k(40);
+  EXPECT_THAT(ResponseCache::GetDecodingKey(top_k), IsEmpty());
+
+  SessionConfig candidates = CreateGreedySessionConfig();
+  candidates.SetNumOutputCandidates(2);
+  EXPECT_THAT(ResponseCache::GetDecodingKey(candidates), IsEmpty());
+
+  // The GPU sampler samples the top-k tokens whatever the type.
+  SessionConfig gpu = CreateGreedySessionConfig();
+  gpu.SetSamplerBackend(Backend::GPU);
+  EXPECT_THAT(ResponseCache::GetDecodingKey(gpu), IsEmpty());
+  gpu.GetMutableSamplerParams().set_k(1);
+  EXPECT_THAT(ResponseCache::GetDecodingKey(gpu), Not(IsEmpty()));
+
+  SessionConfig timed = CreateGreedySessionConfig();
+  timed.SetDecodeTimeBudget(absl::Seconds(1));
+  EXPECT_THAT(ResponseCache::GetDecodingKey(timed), IsEmpty());
+}
+
+}  // namespace
+}  // namespace litert::lm
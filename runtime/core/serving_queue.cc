@@ -0,0 +1,219 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/serving_queue.h"
+
+#include <algorithm>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "runtime/core/decode_scheduler.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<ServingQueue>> ServingQueue::Create(
+    std::unique_ptr<DecodeScheduler> scheduler,
+    const ServingQueueOptions& options) {
+  if (scheduler == nullptr) {
+    return absl::InvalidArgumentError("Scheduler must be provided.");
+  }
+  if (options.max_queue_depth < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Max queue depth must be non-negative, got ",
+                     options.max_queue_depth));
+  }
+  if (options.max_num_tokens_per_slot <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Max number of tokens per slot must be positive, got ",
+                     options.max_num_tokens_per_slot));
+  }
+  if (options.kv_capacity_tokens < 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("KV capacity must be non-negative, got ",
+                     options.kv_capacity_tokens));
+  }
+  return absl::WrapUnique(new ServingQueue(std::move(scheduler), options));
+}
+
+absl::StatusOr<ServingQueue::RequestId> ServingQueue::Submit(
+    Request request) {
+  if (request.prompt_ids.empty()) {
+    return absl::InvalidArgumentError("Prompt ids must be non-empty.");
+  }
+  if (request.max_num_tokens <= 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Max number of tokens must be positive, got ", request.max_num_tokens));
+  }
+  const int num_kv_tokens = NumKvTokens(request);
+  if (num_kv_tokens > options_.max_num_tokens_per_slot ||
+      (options_.kv_capacity_tokens > 0 &&
+       num_kv_tokens > options_.kv_capacity_tokens)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The request needs ", num_kv_tokens,
+        " kv-cache tokens, more than a slot holds: ",
+        options_.kv_capacity_tokens > 0
+            ? std::min(options_.max_num_tokens_per_slot,
+                       options_.kv_capacity_tokens)
+            : options_.max_num_tokens_per_slot));
+  }
+  absl::MutexLock lock(&mutex_);
+  if (queued_requests_.size() >= options_.max_queue_depth) {
+    return absl::ResourceExhaustedError(absl::StrCat(
+        "All ", options_.max_queue_depth, " queue entries are taken."));
+  }
+  const RequestId request_id = next_request_id_++;
+  queued_requests_.push_back({request_id, std::move(request)});
+  return request_id;
+}
+
+absl::Status ServingQueue::Cancel(RequestId request_id) {
+  absl::MutexLock lock(&mutex_);
+  auto queued = std::find_if(queued_requests_.begin(), queued_requests_.end(),
+                             [request_id](const QueuedRequest& queued) {
+                               return queued.id == request_id;
+                             });
+  if (queued != queued_requests_.end()) {
+    cancelled_queued_requests_.push_back(std::move(queued->request));
+    queued_requests_.erase(queued);
+    return absl::OkStatus();
+  }
+  if (active_requests_.contains(request_id)) {
+    cancelled_active_requests_.push_back(request_id);
+    return absl::OkStatus();
+  }
+  return absl::NotFoundError(
+      absl::StrCat("Request ", request_id, " is not queued or active."));
+}
+
+absl::Status ServingQueue::Step() {
+  std::vector<Request> cancelled_queued_requests;
+  std::vector<RequestId> cancelled_active_requests;
+  {
+    absl::MutexLock lock(&mutex_);
+    cancelled_queued_requests.swap(cancelled_queued_requests_);
+    cancelled_active_requests.swap(cancelled_active_requests_);
+  }
+  // The callbacks are called without the lock, such that they may submit new
+  // requests.
+  for (Request& request : cancelled_queued_requests) {
+    if (request.on_done != nullptr) {
+      request.on_done(absl::CancelledError("The request is cancelled."));
+    }
+  }
+  for (RequestId request_id : cancelled_active_requests) {
+    int slot;
+    {
+      absl::MutexLock lock(&mutex_);
+      auto it = active_requests_.find(request_id);
+      if (it == active_requests_.end()) {
+        // Finished, or cancelled twice, since.
+        continue;
+      }
+      slot = it->second.slot;
+    }
+    RETURN_IF_ERROR(scheduler_->Leave(slot));
+    FinishRequest(request_id,
+                  absl::CancelledError("The request is cancelled."));
+  }
+  AdmitRequests();
+  return scheduler_->Step();
+}
+
+absl::Status ServingQueue::RunUntilIdle() {
+  while (true) {
+    {
+      absl::MutexLock lock(&mutex_);
+      if (queued_requests_.empty() && active_requests_.empty() &&
+          cancelled_queued_requests_.empty()) {
+        return absl::OkStatus();
+      }
+    }
+    RETURN_IF_ERROR(Step());
+  }
+}
+
+ServingQueue::Stats ServingQueue::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return Stats{
+      .num_queued_requests = static_cast<int>(queued_requests_.size()),
+      .num_active_requests = static_cast<int>(active_requests_.size()),
+      .num_reserved_kv_tokens = num_reserved_kv_tokens_,
+  };
+}
+
+void ServingQueue::AdmitRequests() {
+  while (scheduler_->NumActiveSlots() < scheduler_->NumSlots()) {
+    QueuedRequest admitted;
+    {
+      absl::MutexLock lock(&mutex_);
+      if (queued_requests_.empty()) {
+        return;
+      }
+      // The head of the queue is admitted first, so that a long request is
+      // not starved by the shorter ones behind it.
+      const int num_kv_tokens = NumKvTokens(queued_requests_.front().request);
+      if (options_.kv_capacity_tokens > 0 &&
+          num_reserved_kv_tokens_ + num_kv_tokens >
+              options_.kv_capacity_tokens) {
+        return;
+      }
+      admitted = std::move(queued_requests_.front());
+      queued_requests_.pop_front();
+      num_reserved_kv_tokens_ += num_kv_tokens;
+      active_requests_[admitted.id] = ActiveRequest{
+          .num_reserved_kv_tokens = num_kv_tokens,
+          .on_done = std::move(admitted.request.on_done)};
+    }
+    const RequestId request_id = admitted.id;
+    absl::StatusOr<int> slot = scheduler_->JoinWithPrefill(
+        std::move(admitted.request.prompt_ids),
+        admitted.request.max_num_tokens, std::move(admitted.request.on_token),
+        [this, request_id](absl::Status status) {
+          FinishRequest(request_id, std::move(status));
+        });
+    if (!slot.ok()) {
+      FinishRequest(request_id, slot.status());
+      continue;
+    }
+    absl::MutexLock lock(&mutex_);
+    active_requests_[request_id].slot = *slot;
+  }
+}
+
+void ServingQueue::FinishRequest(RequestId request_id, absl::Status status) {
+  DecodeScheduler::DoneCallback on_done;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = active_requests_.find(request_id);
+    if (it == active_requests_.end()) {
+      return;
+    }
+    num_reserved_kv_tokens_ -= it->second.num_reserved_kv_tokens;
+    on_done = std::move(it->second.on_done);
+    active_requests_.erase(it);
+  }
+  if (on_done != nullptr) {
+    on_done(std::move(status));
+  }
+}
+
+}  // namespace litert::lm
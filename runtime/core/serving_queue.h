@@ -0,0 +1,167 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SERVING_QUEUE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SERVING_QUEUE_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "runtime/core/decode_scheduler.h"
+
+namespace litert::lm {
+
+struct ServingQueueOptions {
+  // The maximum number of requests waiting for a slot. Further requests are
+  // rejected until the queue drains.
+  int max_queue_depth = 64;
+
+  // The kv-cache capacity of one slot, in tokens, i.e. the max number of
+  // tokens of the executor. A request whose prompt and output budget do not
+  // fit into one slot is rejected.
+  int max_num_tokens_per_slot = 0;
+
+  // The kv-cache tokens shared by all the slots. Each admitted request
+  // reserves its prompt and output budget until it finishes, and the queued
+  // requests wait for a slot until their reservation fits as well. 0 means
+  // that every slot owns `max_num_tokens_per_slot` tokens of its own.
+  int kv_capacity_tokens = 0;
+};
+
+// ServingQueue puts a request queue with admission control in front of a
+// DecodeScheduler, such that the requests of many clients are served by one
+// continuously batched executor instead of by independent sessions.
+//
+// Requests are submitted from any thread. They are rejected right away if the
+// queue is full or if they can never fit into the kv-cache, and otherwise wait
+// in FIFO order until a slot is free and their kv-cache reservation fits.
+// Step(), called in a loop by the one serving thread, admits the waiting
+// requests into the scheduler with their prompts, and runs one step of it. The
+// tokens of a request are streamed through its callbacks from the serving
+// thread, so a transport, e.g. an HTTP or gRPC server, only has to forward
+// them.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto queue,
+//                    ServingQueue::Create(std::move(scheduler), options));
+//   // On the client threads:
+//   ASSIGN_OR_RETURN(auto request_id, queue->Submit(std::move(request)));
+//   // On the serving thread:
+//   while (serving) {
+//     RETURN_IF_ERROR(queue->Step());
+//   }
+class ServingQueue {
+ public:
+  using RequestId = int64_t;
+
+  struct Request {
+    // The prompt to prefill, followed by up to `max_num_tokens` decoded
+    // tokens.
+    std::vector<int> prompt_ids;
+    int max_num_tokens = 0;
+    // Called from the serving thread with each decoded token.
+    DecodeScheduler::TokenCallback on_token;
+    // Called once from the serving thread when the request finishes, with
+    // CancelledError if it is cancelled.
+    DecodeScheduler::DoneCallback on_done;
+  };
+
+  struct Stats {
+    int num_queued_requests = 0;
+    int num_active_requests = 0;
+    int num_reserved_kv_tokens = 0;
+  };
+
+  // Creates a ServingQueue over `scheduler`, which must be created with a
+  // prefill function.
+  static absl::StatusOr<std::unique_ptr<ServingQueue>> Create(
+      std::unique_ptr<DecodeScheduler> scheduler,
+      const ServingQueueOptions& options);
+
+  // Queues `request` and returns its id. Thread-safe.
+  // Returns ResourceExhaustedError if the queue is full, and
+  // InvalidArgumentError if the request does not fit into the kv-cache.
+  absl::StatusOr<RequestId> Submit(Request request);
+
+  // Cancels a queued or active request. Its on_done callback is called with
+  // CancelledError by the next Step(). Thread-safe.
+  // Returns NotFoundError if the request is unknown or already finished.
+  absl::Status Cancel(RequestId request_id);
+
+  // Finishes the cancelled requests, admits the waiting requests that fit,
+  // then runs one step of the scheduler. Only called from the serving thread.
+  absl::Status Step();
+
+  // Runs Step() until no request is queued or active.
+  absl::Status RunUntilIdle();
+
+  // Returns the queued and active work. Thread-safe.
+  Stats GetStats() const;
+
+ private:
+  struct QueuedRequest {
+    RequestId id = 0;
+    Request request;
+  };
+
+  struct ActiveRequest {
+    // The slot of the scheduler, -1 until the request joins it.
+    int slot = -1;
+    int num_reserved_kv_tokens = 0;
+    DecodeScheduler::DoneCallback on_done;
+  };
+
+  ServingQueue(std::unique_ptr<DecodeScheduler> scheduler,
+               const ServingQueueOptions& options)
+      : scheduler_(std::move(scheduler)), options_(options) {}
+
+  // Returns the kv-cache tokens `request` reserves while it is active.
+  static int NumKvTokens(const Request& request) {
+    return request.prompt_ids.size() + request.max_num_tokens;
+  }
+
+  // Joins the queued requests into the free slots of the scheduler, in FIFO
+  // order while their reservations fit.
+  void AdmitRequests();
+
+  // Releases the reservation of the active request `request_id` and calls its
+  // on_done callback.
+  void FinishRequest(RequestId request_id, absl::Status status);
+
+  const std::unique_ptr<DecodeScheduler> scheduler_;
+  const ServingQueueOptions options_;
+
+  mutable absl::Mutex mutex_;
+  RequestId next_request_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  std::deque<QueuedRequest> queued_requests_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<RequestId, ActiveRequest> active_requests_
+      ABSL_GUARDED_BY(mutex_);
+  int num_reserved_kv_tokens_ ABSL_GUARDED_BY(mutex_) = 0;
+  // The cancellations, carried out by the next Step().
+  std::vector<Request> cancelled_queued_requests_ ABSL_GUARDED_BY(mutex_);
+  std::vector<RequestId> cancelled_active_requests_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SERVING_QUEUE_H_
@@ -0,0 +1,168 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/serving_queue.h"
+
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/core/decode_scheduler.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::Optional;
+using ::testing::status::StatusIs;
+
+// Creates a scheduler that decodes `input + 1` for every slot and prefills
+// nothing.
+std::unique_ptr<DecodeScheduler> CreateScheduler(int num_slots) {
+  auto scheduler = DecodeScheduler::Create(
+      num_slots, /*stop_token_ids=*/{},
+      [](absl::Span<const int> input_ids, absl::Span<int> output_ids) {
+        for (int i = 0; i < input_ids.size(); ++i) {
+          output_ids[i] = input_ids[i] + 1;
+        }
+        return absl::OkStatus();
+      },
+      [](int slot, absl::Span<const int> input_ids) {
+        return absl::OkStatus();
+      },
+      /*max_prefill_tokens_per_step=*/16);
+  return std::move(*scheduler);
+}
+
+// Collects the tokens and the final status of one request.
+struct Client {
+  std::vector<int> tokens;
+  std::optional<absl::Status> status;
+
+  ServingQueue::Request NewRequest(std::vector<int> prompt_ids,
+                                   int max_num_tokens) {
+    return ServingQueue::Request{
+        .prompt_ids = std::move(prompt_ids),
+        .max_num_tokens = max_num_tokens,
+        .on_token = [this](int token_id) { tokens.push_back(token_id); },
+        .on_done = [this](absl::Status done_status) { status = done_status; },
+    };
+  }
+};
+
+TEST(ServingQueueTest, CreateRejectsInvalidOptions) {
+  EXPECT_THAT(ServingQueue::Create(nullptr, {.max_num_tokens_per_slot = 16}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ServingQueue::Create(CreateScheduler(1), {}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ServingQueue::Create(CreateScheduler(1),
+                                   {.max_queue_depth = -1,
+                                    .max_num_tokens_per_slot = 16}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(ServingQueueTest, SubmitRejectsTheRequestsThatDoNotFit) {
+  ASSERT_OK_AND_ASSIGN(
+      auto queue,
+      ServingQueue::Create(CreateScheduler(1), {.max_queue_depth = 1,
+                                                .max_num_tokens_per_slot = 4}));
+  Client client;
+  EXPECT_THAT(queue->Submit(client.NewRequest({1, 2}, /*max_num_tokens=*/3)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(queue->Submit(client.NewRequest({}, /*max_num_tokens=*/1)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_OK(queue->Submit(client.NewRequest({1}, /*max_num_tokens=*/3)));
+  EXPECT_THAT(queue->Submit(client.NewRequest({1}, /*max_num_tokens=*/3)),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+}
+
+TEST(ServingQueueTest, ServesTheQueuedRequestsAsSlotsFree) {
+  ASSERT_OK_AND_ASSIGN(
+      auto queue, ServingQueue::Create(CreateScheduler(1),
+                                       {.max_num_tokens_per_slot = 16}));
+  Client first, second;
+  ASSERT_OK(queue->Submit(first.NewRequest({3, 10}, /*max_num_tokens=*/2)));
+  ASSERT_OK(queue->Submit(second.NewRequest({20}, /*max_num_tokens=*/1)));
+  EXPECT_EQ(queue->GetStats().num_queued_requests, 2);
+
+  ASSERT_OK(queue->Step());
+  EXPECT_EQ(queue->GetStats().num_queued_requests, 1);
+  EXPECT_EQ(queue->GetStats().num_active_requests, 1);
+
+  ASSERT_OK(queue->RunUntilIdle());
+  EXPECT_THAT(first.tokens, ElementsAre(11, 12));
+  EXPECT_THAT(first.status, Optional(absl::OkStatus()));
+  EXPECT_THAT(second.tokens, ElementsAre(21));
+  EXPECT_THAT(second.status, Optional(absl::OkStatus()));
+  EXPECT_EQ(queue->GetStats().num_active_requests, 0);
+}
+
+TEST(ServingQueueTest, AdmitsTheRequestsWithinTheKvCapacity) {
+  ASSERT_OK_AND_ASSIGN(
+      auto queue,
+      ServingQueue::Create(CreateScheduler(2), {.max_num_tokens_per_slot = 4,
+                                                .kv_capacity_tokens = 5}));
+  Client first, second;
+  ASSERT_OK(queue->Submit(first.NewRequest({10}, /*max_num_tokens=*/2)));
+  ASSERT_OK(queue->Submit(second.NewRequest({20}, /*max_num_tokens=*/2)));
+
+  // A slot is free, but the second reservation does not fit yet.
+  ASSERT_OK(queue->Step());
+  EXPECT_EQ(queue->GetStats().num_active_requests, 1);
+  EXPECT_EQ(queue->GetStats().num_queued_requests, 1);
+  EXPECT_EQ(queue->GetStats().num_reserved_kv_tokens, 3);
+
+  ASSERT_OK(queue->RunUntilIdle());
+  EXPECT_THAT(first.tokens, ElementsAre(11, 12));
+  EXPECT_THAT(second.tokens, ElementsAre(21, 22));
+  EXPECT_EQ(queue->GetStats().num_reserved_kv_tokens, 0);
+}
+
+TEST(ServingQueueTest, CancelsQueuedAndActiveRequests) {
+  ASSERT_OK_AND_ASSIGN(
+      auto queue, ServingQueue::Create(CreateScheduler(1),
+                                       {.max_num_tokens_per_slot = 16}));
+  Client first, second;
+  ASSERT_OK_AND_ASSIGN(
+      auto first_id,
+      queue->Submit(first.NewRequest({10}, /*max_num_tokens=*/8)));
+  ASSERT_OK_AND_ASSIGN(
+      auto second_id,
+      queue->Submit(second.NewRequest({20}, /*max_num_tokens=*/8)));
+  ASSERT_OK(queue->Step());
+  ASSERT_OK(queue->Step());
+  EXPECT_THAT(first.tokens, ElementsAre(11));
+
+  ASSERT_OK(queue->Cancel(first_id));
+  ASSERT_OK(queue->Cancel(second_id));
+  EXPECT_THAT(queue->Cancel(/*request_id=*/7),
+              StatusIs(absl::StatusCode::kNotFound));
+  ASSERT_OK(queue->RunUntilIdle());
+  EXPECT_THAT(first.tokens, ElementsAre(11));
+  EXPECT_THAT(first.status,
+              Optional(StatusIs(absl::StatusCode::kCancelled)));
+  EXPECT_THAT(second.tokens, IsEmpty());
+  EXPECT_THAT(second.status,
+              Optional(StatusIs(absl::StatusCode::kCancelled)));
+}
+
+}  // namespace
+}  // namespace litert::lm
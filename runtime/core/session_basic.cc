@@ -1,68 +1,312 @@
 #include "runtime/core/session_basic.h"
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/memory/memory.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/constrained_sampler.h"
+#include "runtime/components/decode_recording.h"
+#include "runtime/components/recording_sampler.h"
 #include "runtime/components/sampler.h"
 #include "runtime/components/sampler_factory.h"
+#include "runtime/components/stop_string_detector.h"
 #include "runtime/components/stop_token_detector.h"
+#include "runtime/components/token_constraint.h"
 #include "runtime/components/tokenizer.h"
 #include "runtime/core/pipeline.h"
+#include "runtime/core/prefix_cache.h"
+#include "runtime/core/response_cache.h"
+#include "runtime/core/session_resource_pool.h"
 #include "runtime/engine/engine.h"
+#include "runtime/engine/engine_metrics.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
 #include "runtime/executor/executor_settings_base.h"
 #include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/framework/threadpool.h"
+#include "runtime/proto/llm_metadata.pb.h"
 #include "runtime/proto/sampler_params.pb.h"
 #include "runtime/util/convert_tensor_buffer.h"
 #include "runtime/util/status_macros.h"  // IWYU pragma: keep
 
 namespace litert::lm {
+namespace {
+
+// Joins the texts of the inputs of a prefill call, such that they are
+// tokenized and prefilled as one token stream, between one pair of prompt
+// template affixes.
+absl::StatusOr<std::string> JoinTextInputs(
+    const std::vector<InputData>& contents) {
+  if (contents.empty()) {
+    return absl::InvalidArgumentError("Input is empty.");
+  }
+  std::string text;
+  for (const auto& input : contents) {
+    std::optional<absl::string_view> input_text = ToStringView(input);
+    RET_CHECK(input_text.has_value())
+            .SetCode(absl::StatusCode::kUnimplemented)
+        << "Only the text inputs are supported.";
+    absl::StrAppend(&text, *input_text);
+  }
+  return text;
+}
+
+// Forwards the streamed responses of a decode to an observer, and collects
+// them into the responses of the whole decode, with the score of the last
+// one, such that they are stored into the response cache once it is done.
+class ResponseCollector : public InferenceObservable {
+ public:
+  explicit ResponseCollector(InferenceObservable* observer)
+      : observer_(observer), responses_(/*num_output_candidates=*/1) {}
+
+  void OnNext(const Responses& responses) override {
+    for (int i = 0; i < responses.GetNumOutputCandidates() &&
+                    i < responses_.GetNumOutputCandidates();
+         ++i) {
+      if (auto text = responses.GetResponseTextAt(i); text.ok()) {
+        responses_.GetMutableResponseTexts()[i].append(text->data(),
+                                                       text->size());
+      }
+      if (auto score = responses.GetScoreAt(i); score.ok()) {
+        responses_.GetMutableScores()[i] = *score;
+      }
+      if (auto top_log_probs = responses.GetTopLogProbsAt(i);
+          top_log_probs.ok()) {
+        auto& steps = responses_.GetMutableTopLogProbs()[i];
+        steps.insert(steps.end(), top_log_probs->begin(),
+                     top_log_probs->end());
+      }
+    }
+    if (observer_ != nullptr) {
+      observer_->OnNext(responses);
+    }
+  }
+
+  void OnNextText(int candidate_index, absl::string_view text) override {
+    if (candidate_index >= 0 &&
+        candidate_index < responses_.GetNumOutputCandidates()) {
+      responses_.GetMutableResponseTexts()[candidate_index].append(
+          text.data(), text.size());
+    }
+    if (observer_ != nullptr) {
+      observer_->OnNextText(candidate_index, text);
+    }
+  }
+
+  void OnCandidateDone(int candidate_index) override {
+    if (observer_ != nullptr) {
+      observer_->OnCandidateDone(candidate_index);
+    }
+  }
+
+  void OnDone() override {
+    done_ = !failed_;
+    if (observer_ != nullptr) {
+      observer_->OnDone();
+    }
+  }
+
+  void OnError(const absl::Status& status) override {
+    failed_ = true;
+    done_ = false;
+    if (observer_ != nullptr) {
+      observer_->OnError(status);
+    }
+  }
+
+  // Returns true if the decode is done without an error.
+  bool IsDone() const { return done_; }
+
+  Responses TakeResponses() { return std::move(responses_); }
+
+ private:
+  InferenceObservable* observer_;
+  Responses responses_;
+  bool done_ = false;
+  bool failed_ = false;
+};
+
+}  // namespace
 
 // static
 absl::StatusOr<std::unique_ptr<SessionBasic>> SessionBasic::Create(
     LlmExecutor* executor, Tokenizer* tokenizer,
     const SessionConfig& session_config,
     std::optional<BenchmarkInfo> benchmark_info,
-    ThreadPool* worker_thread_pool) {
+    ThreadPool* worker_thread_pool, PrefixCache* prefix_cache,
+    ThreadPool* sampler_thread_pool, TokenConstraintCache* constraint_cache,
+    EngineMetricsRecorder* metrics_recorder,
+    SessionResourcePool* resource_pool, FairTaskScheduler* task_scheduler,
+    ResponseCache* response_cache) {
+  // The resources of a destroyed session of the same config are recycled.
+  std::string resource_key;
+  std::optional<SessionResources> resources;
+  if (resource_pool != nullptr) {
+    resource_key = SessionResourcePool::GetKey(session_config);
+    if (!resource_key.empty()) {
+      resources = resource_pool->Acquire(resource_key);
+    }
+  }
   auto sampler_backend = session_config.GetSamplerBackend();
   std::unique_ptr<Sampler> sampler;
   // If use CPU sampling, we create it here; For GPU sampling, we let executor
-  // create it internally.
-  if (sampler_backend == Backend::CPU) {
+  // create it internally. Beam search needs no sampler.
+  if (resources.has_value()) {
+    sampler = std::move(resources->sampler);
+  } else if (session_config.GetSamplerParams().type() ==
+             proto::SamplerParameters::BEAM_SEARCH) {
+    ABSL_LOG(INFO) << "Decoding with beam search.";
+  } else if (sampler_backend == Backend::CPU) {
     ASSIGN_OR_RETURN(
         sampler,
         CreateSampler(sampler_backend, session_config.GetNumOutputCandidates(),
-                      session_config.GetSamplerParams()));
+                      session_config.GetSamplerParams(), /*env=*/nullptr,
+                      /*vocab_size=*/std::nullopt,
+                      /*activation_data_type=*/std::nullopt,
+                      sampler_thread_pool));
   } else if (sampler_backend != Backend::GPU &&
              sampler_backend != Backend::NPU) {
     return absl::InvalidArgumentError(
         absl::StrCat("Unsupported sampler backend: ", sampler_backend));
   }
 
+  if (session_config.GetMaxOutputTokens().has_value()) {
+    RET_CHECK_GT(*session_config.GetMaxOutputTokens(), 0)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The maximum number of output tokens must be positive.";
+  }
+
+  if (const auto& options = session_config.GetConstrainedDecodingOptions();
+      options.has_value()) {
+    RET_CHECK(sampler != nullptr).SetCode(absl::StatusCode::kInvalidArgument)
+        << "Constrained decoding needs the CPU sampler without beam search.";
+    RET_CHECK(constraint_cache != nullptr)
+            .SetCode(absl::StatusCode::kFailedPrecondition)
+        << "Constrained decoding needs a constraint cache.";
+    std::shared_ptr<TokenConstraint> constraint;
+    if (options->has_json_schema()) {
+      ASSIGN_OR_RETURN(constraint, constraint_cache->GetOrCompileJsonSchema(
+                                       options->json_schema()));
+    } else {
+      ASSIGN_OR_RETURN(constraint,
+                       constraint_cache->GetOrCompileRegex(options->regex()));
+    }
+    // The texts are ended by the stop tokens of a single token id.
+    std::vector<int> end_token_ids;
+    for (const auto& stop_token_sequence : session_config.GetStopTokenIds()) {
+      if (stop_token_sequence.size() == 1) {
+        end_token_ids.push_back(stop_token_sequence[0]);
+      }
+    }
+    ASSIGN_OR_RETURN(
+        sampler,
+        ConstrainedSampler::Create(std::move(sampler), std::move(constraint),
+                                   std::move(end_token_ids),
+                                   session_config.GetNumOutputCandidates()));
+  }
+
+  if (const int num_top_log_probs = session_config.GetNumTopLogProbs();
+      num_top_log_probs > 0) {
+    // The log-probabilities are collected by the sampler while it draws the
+    // tokens, so the executors sampling internally cannot report them.
+    RET_CHECK(sampler != nullptr).SetCode(absl::StatusCode::kUnimplemented)
+        << "Top log-probabilities need the CPU sampler without beam search.";
+    RET_CHECK(!session_config.GetPromptLookupConfig().has_value())
+            .SetCode(absl::StatusCode::kUnimplemented)
+        << "Top log-probabilities are not reported by prompt lookup decoding.";
+    RETURN_IF_ERROR(sampler->SetNumTopLogProbs(num_top_log_probs));
+  }
+
+  if (const std::shared_ptr<DecodeRecorder>& recorder =
+          session_config.GetDecodeRecorder();
+      recorder != nullptr) {
+    // The recorded ids are those of the CPU sampler, which skips no step.
+    RET_CHECK(sampler != nullptr).SetCode(absl::StatusCode::kUnimplemented)
+        << "Decode recording needs the CPU sampler without beam search.";
+    RET_CHECK(!session_config.GetPromptLookupConfig().has_value())
+            .SetCode(absl::StatusCode::kUnimplemented)
+        << "Decode recording does not record prompt lookup decoding.";
+    ASSIGN_OR_RETURN(sampler,
+                     RecordingSampler::Create(std::move(sampler), recorder));
+  }
+
   if (benchmark_info.has_value()) {
     ABSL_LOG(INFO) << "Benchmark is enabled.";
   }
-  StopTokenDetector stop_token_detector(
-      session_config.GetNumOutputCandidates());
-  for (const auto& stop_token_sequence : session_config.GetStopTokenIds()) {
-    RETURN_IF_ERROR(
-        stop_token_detector.AddStopTokenSequence(stop_token_sequence));
+  if (!resources.has_value()) {
+    StopTokenDetector stop_token_detector(
+        session_config.GetNumOutputCandidates());
+    for (const auto& stop_token_sequence : session_config.GetStopTokenIds()) {
+      RETURN_IF_ERROR(
+          stop_token_detector.AddStopTokenSequence(stop_token_sequence));
+    }
+    StopStringDetector stop_string_detector;
+    for (const auto& stop_string : session_config.GetStopStrings()) {
+      RETURN_IF_ERROR(stop_string_detector.AddStopString(stop_string));
+    }
+    // The prompt template affixes are the same for all the turns, so they are
+    // encoded once.
+    const proto::PromptTemplates& prompt_templates =
+        session_config.GetPromptTemplates();
+    PromptAffixTokenIds affix_token_ids;
+    if (!prompt_templates.user().prefix().empty()) {
+      ASSIGN_OR_RETURN(
+          affix_token_ids.prefix,
+          tokenizer->TextToTokenIds(prompt_templates.user().prefix()));
+    }
+    const std::string suffix = absl::StrCat(prompt_templates.user().suffix(),
+                                            prompt_templates.model().prefix());
+    if (!suffix.empty()) {
+      ASSIGN_OR_RETURN(affix_token_ids.suffix,
+                       tokenizer->TextToTokenIds(suffix));
+    }
+    resources.emplace(SessionResources{
+        .stop_token_detector = std::move(stop_token_detector),
+        .stop_string_detector = std::move(stop_string_detector),
+        .affix_token_ids = std::move(affix_token_ids)});
+  }
+  FairTaskScheduler::FlowId scheduling_flow = 0;
+  if (task_scheduler != nullptr) {
+    ASSIGN_OR_RETURN(scheduling_flow,
+                     task_scheduler->AddFlow(
+                         session_config.GetSchedulingTenant(),
+                         session_config.GetSchedulingWeight()));
   }
-  return absl::WrapUnique(new SessionBasic(
+  // The responses of the sessions decoding otherwise are not cached.
+  std::string decoding_key;
+  if (response_cache != nullptr) {
+    decoding_key = ResponseCache::GetDecodingKey(session_config);
+    if (decoding_key.empty()) {
+      response_cache = nullptr;
+    }
+  }
+  auto session = absl::WrapUnique(new SessionBasic(
       executor, tokenizer, std::move(sampler), session_config, benchmark_info,
-      worker_thread_pool, stop_token_detector));
+      worker_thread_pool, resources->stop_token_detector,
+      resources->stop_string_detector, prefix_cache, sampler_thread_pool,
+      std::move(resources->affix_token_ids), metrics_recorder, resource_pool,
+      std::move(resource_key), task_scheduler, scheduling_flow, response_cache,
+      std::move(decoding_key)));
+  if (metrics_recorder != nullptr) {
+    metrics_recorder->RecordSessionCreated();
+  }
+  return session;
 }
 
 SessionBasic::~SessionBasic() {
@@ -70,69 +314,466 @@ SessionBasic::~SessionBasic() {
   if (!status.ok()) {
     ABSL_LOG(ERROR) << "Failed to reset executor: " << status;
   }
+  if (resource_pool_ != nullptr && !resource_key_.empty()) {
+    resource_pool_->Release(
+        resource_key_,
+        SessionResources{.sampler = std::move(sampler_),
+                         .stop_token_detector = stop_token_detector_,
+                         .stop_string_detector = stop_string_detector_,
+                         .affix_token_ids = std::move(affix_token_ids_)});
+  }
+  if (metrics_recorder_ != nullptr) {
+    metrics_recorder_->RecordSessionDestroyed();
+  }
+  if (task_scheduler_ != nullptr) {
+    task_scheduler_->RemoveFlow(scheduling_flow_);
+  }
+}
+
+std::optional<int> SessionBasic::GetStepForMetrics() const {
+  if (metrics_recorder_ == nullptr) {
+    return std::nullopt;
+  }
+  absl::StatusOr<int> step = executor_.GetCurrentStep();
+  if (!step.ok()) {
+    return std::nullopt;
+  }
+  return *step;
+}
+
+void SessionBasic::RecordPrefillMetrics(std::optional<int> start_step) {
+  std::optional<int> end_step = GetStepForMetrics();
+  if (!start_step.has_value() || !end_step.has_value()) {
+    return;
+  }
+  // A prefix restored from the cache counts as prefilled, and a context shift
+  // as nothing prefilled.
+  metrics_recorder_->RecordPrefill(*end_step - *start_step);
+  metrics_recorder_->RecordKvCacheNumTokens(*end_step);
+  if (prefix_cache_ != nullptr) {
+    metrics_recorder_->RecordPrefixCacheLookups(prefix_cache_->NumHits(),
+                                                prefix_cache_->NumMisses());
+  }
+  absl::StatusOr<EmbeddingCacheStats> embedding_cache_stats =
+      executor_.GetEmbeddingCacheStats();
+  if (embedding_cache_stats.ok()) {
+    metrics_recorder_->RecordEmbeddingCacheLookups(
+        embedding_cache_stats->hits, embedding_cache_stats->misses);
+  }
+}
+
+void SessionBasic::RecordDecodeMetrics(std::optional<int> start_step,
+                                       absl::Time start_time) {
+  const std::optional<absl::Time> turn_start_time = turn_start_time_;
+  turn_start_time_ = std::nullopt;
+  std::optional<int> end_step = GetStepForMetrics();
+  if (!start_step.has_value() || !end_step.has_value()) {
+    return;
+  }
+  metrics_recorder_->RecordKvCacheNumTokens(*end_step);
+  const int num_tokens = *end_step - *start_step;
+  if (num_tokens <= 0) {
+    return;
+  }
+  // The tokens are not timed one by one, so the first one is taken to come
+  // after the mean inter-token latency of the decode.
+  const absl::Duration decode_time = absl::Now() - start_time;
+  const absl::Duration time_to_first_token =
+      start_time - turn_start_time.value_or(start_time) +
+      decode_time / num_tokens;
+  metrics_recorder_->RecordDecode(num_tokens, time_to_first_token,
+                                  decode_time);
 }
 
 absl::Status SessionBasic::PrefillInternal(absl::string_view input,
-                                           bool wait_for_completion) {
+                                           bool wait_for_completion,
+                                           const CancelParams& cancel_params) {
   // TODO(b/397975034): Consider to utilize a prompt formatting logic in a
   // separate library/class.
-  // Update the input with prompt formatting.
-  std::string formatted_input =
-      absl::StrCat(session_config_.GetPromptTemplates().user().prefix(), input,
-                   session_config_.GetPromptTemplates().user().suffix(),
-                   session_config_.GetPromptTemplates().model().prefix());
-  ABSL_LOG(INFO) << "PrefillInternal: " << formatted_input;
-  ASSIGN_OR_RETURN(last_prefill_token_id_,
-                   Prefill(executor_, tokenizer_, formatted_input,
-                           session_config_.GetStartTokenId(),
-                           wait_for_completion, benchmark_info_));
+  // The input is prefilled between the token ids of the prompt template
+  // affixes.
+  ABSL_LOG(INFO) << "PrefillInternal: " << input;
+  RETURN_IF_ERROR(CheckNoDraft());
+  RETURN_IF_ERROR(ReplayCachedTurn(cancel_params));
+  const std::optional<int> start_step = GetStepForMetrics();
+  if (start_step.has_value() && !turn_start_time_.has_value()) {
+    turn_start_time_ = absl::Now();
+  }
+  RecordRewindPoint();
+  RETURN_IF_ERROR(SelectLoraAdapter());
+  if (const std::shared_ptr<DecodeRecorder>& recorder =
+          session_config_.GetDecodeRecorder();
+      recorder != nullptr) {
+    // A replayed prompt must be encoded as recorded for the same decode.
+    ASSIGN_OR_RETURN(std::vector<int> token_ids,
+                     tokenizer_.TextToTokenIds(input));
+    RETURN_IF_ERROR(recorder->StartTurn(input, token_ids));
+  }
+  // The cached kv-cache states are computed with the base model.
+  const bool use_prefix_cache = prefix_cache_ != nullptr &&
+                                context_token_ids_.has_value() &&
+                                session_config_.GetLoraAdapterName().empty();
+  ASSIGN_OR_RETURN(
+      last_prefill_token_id_,
+      Prefill(executor_, tokenizer_, input,
+              session_config_.GetStartTokenId(), wait_for_completion,
+              benchmark_info_, use_prefix_cache ? prefix_cache_ : nullptr,
+              use_prefix_cache ? &context_token_ids_.value() : nullptr,
+              session_config_.GetContextShiftConfig(),
+              UsePromptLookup() ? &prompt_token_ids_ : nullptr,
+              sampler_thread_pool_, &affix_token_ids_, &cancel_params));
+  RecordPrefillMetrics(start_step);
   return absl::OkStatus();
 }
 
 absl::Status SessionBasic::RunPrefill(const std::vector<InputData>& contents) {
-  if (contents.empty()) {
-    return absl::InvalidArgumentError("Input is empty.");
+  ASSIGN_OR_RETURN(std::string input, JoinTextInputs(contents));
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return RunTask([this, input = std::move(input), cancellation]() {
+    return this->PrefillInternal(input, /*wait_for_completion=*/true,
+                                 cancellation.params);
+  });
+}
+
+absl::Status SessionBasic::RunPrefillAsync(
+    const std::vector<InputData>& contents, InferenceObservable* observer) {
+  ASSIGN_OR_RETURN(std::string input, JoinTextInputs(contents));
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return ScheduleTask(
+      [this, input = std::move(input), cancellation, observer]() {
+        std::unique_ptr<InferenceObservable> queued_observer;
+        InferenceObservable* delivery_observer =
+            GetDeliveryObserver(observer, queued_observer);
+        absl::Status status = this->PrefillInternal(
+            input, /*wait_for_completion=*/false, cancellation.params);
+        ABSL_LOG(INFO) << "RunPrefillAsync status: " << status;
+        if (status.ok()) {
+          delivery_observer->OnDone();
+        } else {
+          delivery_observer->OnError(status);
+        }
+      });
+}
+
+InferenceObservable* SessionBasic::GetDeliveryObserver(
+    InferenceObservable* observer,
+    std::unique_ptr<InferenceObservable>& queued_observer) {
+  if (!delivery_thread_.has_value()) {
+    return observer;
   }
-  absl::Status status;
-  for (const auto& input : contents) {
-    RETURN_IF_ERROR(worker_thread_pool_.Schedule(
-        [this, input_copy = ToString(input).value(), &status]() {
-          status =
-              this->PrefillInternal(input_copy, /*wait_for_completion=*/true);
-        }));
+  queued_observer = delivery_thread_->Wrap(observer);
+  return queued_observer.get();
+}
+
+SessionBasic::RequestCancellation SessionBasic::NewRequestCancellation() {
+  RequestCancellation cancellation;
+  {
+    absl::MutexLock lock(&cancel_mutex_);
+    cancellation.cancel_flag = cancel_flag_;
+  }
+  cancellation.params.cancel = cancellation.cancel_flag.get();
+  const absl::Duration request_timeout = session_config_.GetRequestTimeout();
+  if (request_timeout != absl::InfiniteDuration()) {
+    cancellation.params.deadline = absl::Now() + request_timeout;
+  }
+  return cancellation;
+}
+
+absl::Status SessionBasic::ScheduleTask(absl::AnyInvocable<void() &&> task) {
+  auto recorded_task = WithSchedulingStats(std::move(task));
+  if (task_scheduler_ != nullptr) {
+    return task_scheduler_->Schedule(scheduling_flow_,
+                                     session_config_.GetPriority(),
+                                     std::move(recorded_task));
+  }
+  return worker_thread_pool_.Schedule(std::move(recorded_task),
+                                      session_config_.GetPriority());
+}
+
+void SessionBasic::RecordScheduledTask(absl::Duration wait_time,
+                                       const absl::StatusOr<int>& start_step) {
+  // The tokens are the steps the kv-cache advanced by, not counting the
+  // rollbacks, nor the executors which do not report their step.
+  int num_tokens = 0;
+  if (absl::StatusOr<int> end_step = executor_.GetCurrentStep();
+      start_step.ok() && end_step.ok()) {
+    num_tokens = std::max(*end_step - *start_step, 0);
+  }
+  if (task_scheduler_ != nullptr) {
+    task_scheduler_->Charge(scheduling_flow_, num_tokens);
+  }
+  absl::MutexLock lock(&scheduling_stats_mutex_);
+  ++scheduling_stats_.num_tasks;
+  scheduling_stats_.num_tokens += num_tokens;
+  scheduling_stats_.total_wait_time += wait_time;
+  scheduling_stats_.max_wait_time =
+      std::max(scheduling_stats_.max_wait_time, wait_time);
+}
+
+absl::StatusOr<SessionSchedulingStats> SessionBasic::GetSchedulingStats()
+    const {
+  absl::MutexLock lock(&scheduling_stats_mutex_);
+  return scheduling_stats_;
+}
+
+DecodeBudget SessionBasic::NewDecodeBudget() {
+  DecodeBudget decode_budget;
+  decode_budget.max_output_tokens = session_config_.GetMaxOutputTokens();
+  const absl::Duration decode_time_budget =
+      session_config_.GetDecodeTimeBudget();
+  if (decode_time_budget != absl::InfiniteDuration()) {
+    decode_budget.end_time = absl::Now() + decode_time_budget;
+  }
+  if (decode_pacer_.has_value()) {
+    decode_pacer_->Restart();
+    decode_budget.pacer = &*decode_pacer_;
+  }
+  return decode_budget;
+}
+
+absl::Status SessionBasic::Cancel() {
+  absl::MutexLock lock(&cancel_mutex_);
+  cancel_flag_->store(true, std::memory_order_relaxed);
+  cancel_flag_ = std::make_shared<std::atomic_bool>(false);
+  return absl::OkStatus();
+}
+
+absl::Status SessionBasic::SelectLoraAdapter() {
+  const std::string& lora_adapter_name = session_config_.GetLoraAdapterName();
+  absl::Status status = executor_.SelectLoraAdapter(lora_adapter_name);
+  // Executors without LoRA support always run the base model.
+  if (absl::IsUnimplemented(status) && lora_adapter_name.empty()) {
+    return absl::OkStatus();
   }
-  RETURN_IF_ERROR(worker_thread_pool_.WaitUntilDone(Engine::kDefaultTimeout));
   return status;
 }
 
-absl::Status SessionBasic::RunPrefillAsync(
-    const std::vector<InputData>& contents, InferenceObservable* observer) {
-  if (contents.empty()) {
-    return absl::InvalidArgumentError("Input is empty.");
+void SessionBasic::RecordRewindPoint() {
+  absl::StatusOr<int> step = executor_.GetCurrentStep();
+  absl::StatusOr<int> next_input_token_id = executor_.GetNextInputTokenId();
+  if (!step.ok() || !next_input_token_id.ok()) {
+    return;
   }
-  for (const auto& input : contents) {
-    RETURN_IF_ERROR(worker_thread_pool_.Schedule(
-        [this, input_copy = ToString(input).value(), observer]() {
-          absl::Status status =
-              this->PrefillInternal(input_copy, /*wait_for_completion=*/false);
-          ABSL_LOG(INFO) << "RunPrefillAsync status: " << status;
-          if (status.ok()) {
-            observer->OnDone();
-          } else {
-            observer->OnError(status);
-          }
-        }));
+  if (!rewind_points_.empty() && rewind_points_.back().step > *step) {
+    // The executor went back without a rewind, e.g. it was reset, so the
+    // earlier points no longer hold.
+    rewind_points_.clear();
+  } else if (!rewind_points_.empty() && rewind_points_.back().step == *step) {
+    // E.g. the decode right after a rewind to its start.
+    rewind_points_.pop_back();
+  }
+  rewind_points_.push_back(RewindPoint{*step, *next_input_token_id});
+}
+
+absl::Status SessionBasic::RewindInternal(int step) {
+  RETURN_IF_ERROR(CheckNoDraft());
+  RETURN_IF_ERROR(ReplayCachedTurn(CancelParams()));
+  // The context shifting moves the tokens of the kv-cache to other steps.
+  RET_CHECK(!session_config_.GetContextShiftConfig().has_value())
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "Cannot rewind a session that shifts its context.";
+  auto it = std::find_if(
+      rewind_points_.begin(), rewind_points_.end(),
+      [step](const RewindPoint& point) { return point.step == step; });
+  RET_CHECK(it != rewind_points_.end())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Step " << step
+      << " is not the start of a prefill or decode of the session.";
+  if (it->next_input_token_id == -1) {
+    // Nothing was prefilled yet.
+    RETURN_IF_ERROR(executor_.Reset());
+    context_token_ids_ = std::vector<int>();
+  } else {
+    // The pending input token is counted by the step, but is not in the
+    // kv-cache yet.
+    RETURN_IF_ERROR(executor_.Rollback(step - 1, it->next_input_token_id));
+    last_prefill_token_id_ = it->next_input_token_id;
+    // The token ids before `step` are not tracked, so the prefix cache is no
+    // longer used.
+    context_token_ids_ = std::nullopt;
+  }
+  rewind_points_.erase(it + 1, rewind_points_.end());
+  prompt_token_ids_.clear();
+  return absl::OkStatus();
+}
+
+absl::Status SessionBasic::CheckNoDraft() const {
+  RET_CHECK(!draft_.has_value()).SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The draft of the session must be committed or discarded first.";
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::vector<int>> SessionBasic::UpdateDraftInternal(
+    absl::string_view text, const CancelParams& cancel_params) {
+  // The context shifting moves the tokens of the kv-cache to other steps.
+  RET_CHECK(!session_config_.GetContextShiftConfig().has_value())
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "Cannot draft the input of a session that shifts its context.";
+  if (!draft_.has_value()) {
+    RETURN_IF_ERROR(ReplayCachedTurn(cancel_params));
+  }
+  RETURN_IF_ERROR(SelectLoraAdapter());
+  if (!draft_.has_value()) {
+    ASSIGN_OR_RETURN(int step, executor_.GetCurrentStep());
+    ASSIGN_OR_RETURN(int next_input_token_id, executor_.GetNextInputTokenId());
+    RecordRewindPoint();
+    Draft draft{.start = RewindPoint{step, next_input_token_id}};
+    // The turn is laid out as by Prefill().
+    draft.head_token_ids.push_back(session_config_.GetStartTokenId());
+    draft.head_token_ids.insert(draft.head_token_ids.end(),
+                                affix_token_ids_.prefix.begin(),
+                                affix_token_ids_.prefix.end());
+    draft_ = std::move(draft);
+  }
+  ASSIGN_OR_RETURN(std::vector<int> text_token_ids,
+                   tokenizer_.TextToTokenIds(text));
+  std::vector<int> turn_token_ids = draft_->head_token_ids;
+  turn_token_ids.insert(turn_token_ids.end(), text_token_ids.begin(),
+                        text_token_ids.end());
+  const absl::Span<const int> stable_token_ids =
+      absl::MakeConstSpan(turn_token_ids)
+          .first(turn_token_ids.size() - (text_token_ids.empty() ? 0 : 1));
+
+  // The head is always kept, so at least one token is.
+  std::vector<int>& prefilled_token_ids = draft_->prefilled_token_ids;
+  const int num_kept_tokens =
+      std::mismatch(prefilled_token_ids.begin(), prefilled_token_ids.end(),
+                    stable_token_ids.begin(), stable_token_ids.end())
+          .first -
+      prefilled_token_ids.begin();
+  if (num_kept_tokens < prefilled_token_ids.size()) {
+    RETURN_IF_ERROR(
+        executor_.Rollback(draft_->start.step + num_kept_tokens - 1,
+                           prefilled_token_ids[num_kept_tokens - 1]));
+    prefilled_token_ids.resize(num_kept_tokens);
   }
+  if (num_kept_tokens < stable_token_ids.size()) {
+    // The draft is not a turn of the benchmark.
+    std::optional<BenchmarkInfo> no_benchmark_info;
+    absl::Status status = PrefillTokenIds(
+        executor_, tokenizer_, stable_token_ids.subspan(num_kept_tokens),
+        /*wait_for_completion=*/true, no_benchmark_info, &cancel_params);
+    // A cancelled prefill keeps the tokens prefilled before it stopped.
+    ASSIGN_OR_RETURN(int step, executor_.GetCurrentStep());
+    const int num_prefilled_tokens = step - draft_->start.step;
+    RET_CHECK(num_prefilled_tokens >= num_kept_tokens &&
+              num_prefilled_tokens <= stable_token_ids.size())
+        << "The executor is at step " << step << " after prefilling the draft.";
+    prefilled_token_ids.assign(stable_token_ids.begin(),
+                               stable_token_ids.begin() + num_prefilled_tokens);
+    RETURN_IF_ERROR(status);
+  }
+  return turn_token_ids;
+}
+
+absl::Status SessionBasic::CommitDraftInternal(
+    absl::string_view text, const CancelParams& cancel_params) {
+  ASSIGN_OR_RETURN(std::vector<int> turn_token_ids,
+                   UpdateDraftInternal(text, cancel_params));
+  const int num_head_tokens = draft_->head_token_ids.size();
+  if (const std::shared_ptr<DecodeRecorder>& recorder =
+          session_config_.GetDecodeRecorder();
+      recorder != nullptr) {
+    RETURN_IF_ERROR(recorder->StartTurn(
+        text, absl::MakeConstSpan(turn_token_ids).subspan(num_head_tokens)));
+  }
+  turn_token_ids.insert(turn_token_ids.end(), affix_token_ids_.suffix.begin(),
+                        affix_token_ids_.suffix.end());
+
+  // Only the tail of the turn is left, which the time to first token of the
+  // next decode is measured from.
+  const std::optional<int> start_step = GetStepForMetrics();
+  if (start_step.has_value() && !turn_start_time_.has_value()) {
+    turn_start_time_ = absl::Now();
+  }
+  const int num_prefilled_tokens = draft_->prefilled_token_ids.size();
+  if (num_prefilled_tokens < turn_token_ids.size()) {
+    RETURN_IF_ERROR(PrefillTokenIds(
+        executor_, tokenizer_,
+        absl::MakeConstSpan(turn_token_ids).subspan(num_prefilled_tokens),
+        /*wait_for_completion=*/true, benchmark_info_, &cancel_params));
+  }
+  RecordPrefillMetrics(start_step);
+  last_prefill_token_id_ = turn_token_ids.back();
+  if (context_token_ids_.has_value()) {
+    context_token_ids_->insert(context_token_ids_->end(),
+                               turn_token_ids.begin(), turn_token_ids.end());
+  }
+  if (UsePromptLookup()) {
+    prompt_token_ids_.insert(prompt_token_ids_.end(), turn_token_ids.begin(),
+                             turn_token_ids.end());
+  }
+  draft_.reset();
   return absl::OkStatus();
 }
 
-absl::StatusOr<Responses> SessionBasic::DecodeInternal() {
+absl::Status SessionBasic::CompactContextInternal(
+    absl::Span<const std::pair<int, int>> discarded_ranges) {
+  RETURN_IF_ERROR(CheckNoDraft());
+  RETURN_IF_ERROR(ReplayCachedTurn(CancelParams()));
+  RETURN_IF_ERROR(executor_.CompactContext(discarded_ranges));
+  if (!discarded_ranges.empty()) {
+    // The later steps now hold other tokens.
+    const int first_discarded_step = discarded_ranges.front().first;
+    rewind_points_.erase(
+        std::remove_if(rewind_points_.begin(), rewind_points_.end(),
+                       [first_discarded_step](const RewindPoint& point) {
+                         return point.step > first_discarded_step;
+                       }),
+        rewind_points_.end());
+  }
+  // The token ids of the context are no longer the prefilled ones.
+  context_token_ids_ = std::nullopt;
+  return absl::OkStatus();
+}
+
+absl::Status SessionBasic::RestoreCheckpointInternal(absl::string_view path) {
+  RETURN_IF_ERROR(CheckNoDraft());
+  ASSIGN_OR_RETURN(std::unique_ptr<ExecutorCheckpoint> checkpoint,
+                   ExecutorCheckpoint::LoadFromFile(path));
+  // The kv-cache was computed with the adapter of the session config.
+  RETURN_IF_ERROR(SelectLoraAdapter());
+  RETURN_IF_ERROR(executor_.RestoreState(*checkpoint));
+  cached_turn_.reset();
+  if (checkpoint->GetNextInputTokenId() != -1) {
+    last_prefill_token_id_ = checkpoint->GetNextInputTokenId();
+  }
+  // The history of the restored tokens is not in the checkpoint, so neither
+  // the prefix cache nor the earlier turns can be used.
+  context_token_ids_ = std::nullopt;
+  prompt_token_ids_.clear();
+  rewind_points_.clear();
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Responses> SessionBasic::DecodeInternal(
+    const CancelParams& cancel_params) {
+  // Beam search and the lookup decodings only stop here, before they start.
+  RETURN_IF_ERROR(CheckCancelled(&cancel_params));
+  RETURN_IF_ERROR(CheckNoDraft());
+  RETURN_IF_ERROR(ReplayCachedTurn(cancel_params));
+  RecordRewindPoint();
+  context_token_ids_ = std::nullopt;
+  RETURN_IF_ERROR(SelectLoraAdapter());
+  if (UseBeamSearch()) {
+    return DecodeBeamSearch(executor_, tokenizer_, stop_token_detector_,
+                            session_config_.GetNumOutputCandidates(),
+                            last_prefill_token_id_, benchmark_info_);
+  }
+  if (UsePromptLookup()) {
+    return DecodePromptLookupInternal();
+  }
+  const DecodeBudget decode_budget = NewDecodeBudget();
   if (sampler_ == nullptr) {
     ASSIGN_OR_RETURN(
         auto responses,
-        Decode(executor_, tokenizer_, stop_token_detector_, benchmark_info_));
+        Decode(executor_, tokenizer_, stop_token_detector_, benchmark_info_,
+               session_config_.GetContextShiftConfig(), &cancel_params,
+               &decode_budget));
     return responses;
   } else {
+    // The sampler state, e.g. of the penalties, is per response.
+    sampler_->Reset();
     std::vector<int> decoded_ids(session_config_.GetNumOutputCandidates(),
                                  last_prefill_token_id_);
     auto decoded_ids_buffer = CopyToTensorBuffer<int>(
@@ -140,60 +781,548 @@ absl::StatusOr<Responses> SessionBasic::DecodeInternal() {
     ASSIGN_OR_RETURN(
         auto responses,
         DecodeCustomSampling(executor_, tokenizer_, stop_token_detector_,
-                             /*num_output_candidates=*/1, *sampler_,
-                             *decoded_ids_buffer, benchmark_info_));
+                             session_config_.GetNumOutputCandidates(),
+                             *sampler_, *decoded_ids_buffer, benchmark_info_,
+                             session_config_.GetContextShiftConfig(),
+                             &cancel_params, &decode_budget));
     return responses;
   }
 }
 
 absl::Status SessionBasic::DecodeInternalStreaming(
-    InferenceObservable* observer) {
+    InferenceObservable* observer, const CancelParams& cancel_params) {
+  if (absl::Status status = CheckCancelled(&cancel_params); !status.ok()) {
+    if (observer != nullptr) {
+      observer->OnError(status);
+    }
+    return status;
+  }
+  if (absl::Status status = CheckNoDraft(); !status.ok()) {
+    if (observer != nullptr) {
+      observer->OnError(status);
+    }
+    return status;
+  }
+  if (absl::Status status = ReplayCachedTurn(cancel_params); !status.ok()) {
+    if (observer != nullptr) {
+      observer->OnError(status);
+    }
+    return status;
+  }
+  RecordRewindPoint();
+  context_token_ids_ = std::nullopt;
+  if (absl::Status status = SelectLoraAdapter(); !status.ok()) {
+    if (observer != nullptr) {
+      observer->OnError(status);
+    }
+    return status;
+  }
+  if (UseBeamSearch()) {
+    // The beams are only final once the search is done, so they are not
+    // streamed.
+    absl::StatusOr<Responses> responses = DecodeBeamSearch(
+        executor_, tokenizer_, stop_token_detector_,
+        session_config_.GetNumOutputCandidates(), last_prefill_token_id_,
+        benchmark_info_);
+    if (observer != nullptr) {
+      if (responses.ok()) {
+        observer->OnNext(*responses);
+        observer->OnDone();
+      } else {
+        observer->OnError(responses.status());
+      }
+    }
+    return responses.status();
+  }
+  if (UsePromptLookup()) {
+    // The stop sequences may span the tokens of several verifications, so
+    // the response is sent once the decoding is done.
+    absl::StatusOr<Responses> responses = DecodePromptLookupInternal();
+    if (observer != nullptr) {
+      if (responses.ok()) {
+        observer->OnNext(*responses);
+        observer->OnDone();
+      } else {
+        observer->OnError(responses.status());
+      }
+    }
+    return responses.status();
+  }
+  const DecodeBudget decode_budget = NewDecodeBudget();
   if (sampler_ == nullptr) {
-    RETURN_IF_ERROR(DecodeStreaming(executor_, tokenizer_, stop_token_detector_,
-                                    benchmark_info_, observer));
+    RETURN_IF_ERROR(DecodeStreaming(
+        executor_, tokenizer_, stop_token_detector_, benchmark_info_, observer,
+        session_config_.GetContextShiftConfig(), &stop_string_detector_,
+        &cancel_params, &decode_budget));
   } else {
+    // The sampler state, e.g. of the penalties, is per response.
+    sampler_->Reset();
     std::vector<int> decoded_ids(session_config_.GetNumOutputCandidates(),
                                  last_prefill_token_id_);
     auto decoded_ids_buffer = CopyToTensorBuffer<int>(
         decoded_ids, {session_config_.GetNumOutputCandidates(), 1});
     RETURN_IF_ERROR(DecodeCustomSamplingStreaming(
         executor_, tokenizer_, stop_token_detector_,
-        /*num_output_candidates=*/1, *sampler_, *decoded_ids_buffer,
-        benchmark_info_, observer));
+        session_config_.GetNumOutputCandidates(), *sampler_,
+        *decoded_ids_buffer, benchmark_info_, observer,
+        session_config_.GetContextShiftConfig(),
+        session_config_.GetOverlapDecodeOutput(), &stop_string_detector_,
+        &cancel_params, &decode_budget));
   }
   return absl::OkStatus();
 }
 
+absl::StatusOr<Responses> SessionBasic::DecodePromptLookupInternal() {
+  // The decoded tokens are looked up in the next turn as part of its prompt
+  // only if they are prefilled again, as in a chat history.
+  std::vector<int> prompt_token_ids = std::move(prompt_token_ids_);
+  prompt_token_ids_.clear();
+  return DecodePromptLookup(executor_, tokenizer_, stop_token_detector_,
+                            prompt_token_ids,
+                            *session_config_.GetPromptLookupConfig(),
+                            benchmark_info_);
+}
+
 absl::StatusOr<Responses> SessionBasic::RunDecode() {
   ABSL_LOG(INFO) << "RunDecodeSync";
-  absl::StatusOr<Responses> responses;
-  RETURN_IF_ERROR(worker_thread_pool_.Schedule(
-      [this, &responses]() { responses = this->DecodeInternal(); }));
-  RETURN_IF_ERROR(worker_thread_pool_.WaitUntilDone(Engine::kDefaultTimeout));
-  return responses;
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return RunTask([this, cancellation]() {
+    const std::optional<int> start_step = GetStepForMetrics();
+    const absl::Time start_time = absl::Now();
+    absl::StatusOr<Responses> responses =
+        this->DecodeInternal(cancellation.params);
+    RecordDecodeMetrics(start_step, start_time);
+    return responses;
+  });
 }
 
 absl::Status SessionBasic::RunDecodeAsync(InferenceObservable* observer) {
   ABSL_LOG(INFO) << "RunDecodeAsync";
-  return worker_thread_pool_.Schedule([this, observer]() {
-    this->DecodeInternalStreaming(observer).IgnoreError();
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return ScheduleTask([this, observer, cancellation]() {
+    std::unique_ptr<InferenceObservable> queued_observer;
+    DecodeStreamingTask(GetDeliveryObserver(observer, queued_observer),
+                        cancellation.params);
+  });
+}
+
+void SessionBasic::DecodeStreamingTask(InferenceObservable* observer,
+                                       const CancelParams& cancel_params) {
+  // The responses are coalesced when the session asks for it. OnDone() and
+  // OnError() flush the rest.
+  std::optional<CoalescingObservable> coalescing_observer;
+  if (const auto& options = session_config_.GetStreamingFlushOptions();
+      options.has_value()) {
+    coalescing_observer.emplace(observer, *options);
+  }
+  // The errors are sent to the observer.
+  const std::optional<int> start_step = GetStepForMetrics();
+  const absl::Time start_time = absl::Now();
+  absl::Status status = this->DecodeInternalStreaming(
+      coalescing_observer.has_value() ? &*coalescing_observer : observer,
+      cancel_params);
+  RecordDecodeMetrics(start_step, start_time);
+  ABSL_LOG(INFO) << "RunDecodeAsync status: " << status;
+}
+
+absl::StatusOr<const PromptAffixTokenIds*> SessionBasic::GetAffixTokenIds(
+    PromptRole role) {
+  switch (role) {
+    case PromptRole::kRaw:
+      return nullptr;
+    case PromptRole::kUser:
+      return &affix_token_ids_;
+    case PromptRole::kSystem:
+      break;
+  }
+  if (!system_affix_token_ids_.has_value()) {
+    const proto::PromptTemplates& prompt_templates =
+        session_config_.GetPromptTemplates();
+    PromptAffixTokenIds affix_token_ids;
+    if (!prompt_templates.system().prefix().empty()) {
+      ASSIGN_OR_RETURN(
+          affix_token_ids.prefix,
+          tokenizer_.TextToTokenIds(prompt_templates.system().prefix()));
+    }
+    const std::string suffix = absl::StrCat(prompt_templates.system().suffix(),
+                                            prompt_templates.model().prefix());
+    if (!suffix.empty()) {
+      ASSIGN_OR_RETURN(affix_token_ids.suffix,
+                       tokenizer_.TextToTokenIds(suffix));
+    }
+    system_affix_token_ids_ = std::move(affix_token_ids);
+  }
+  return &*system_affix_token_ids_;
+}
+
+absl::Status SessionBasic::AppendInternal(absl::string_view text,
+                                          PromptRole role,
+                                          const CancelParams& cancel_params) {
+  RETURN_IF_ERROR(CheckNoDraft());
+  RETURN_IF_ERROR(ReplayCachedTurn(cancel_params));
+  const std::optional<int> start_step = GetStepForMetrics();
+  if (start_step.has_value() && !turn_start_time_.has_value()) {
+    turn_start_time_ = absl::Now();
+  }
+  RecordRewindPoint();
+  RETURN_IF_ERROR(SelectLoraAdapter());
+  ASSIGN_OR_RETURN(const PromptAffixTokenIds* affix_token_ids,
+                   GetAffixTokenIds(role));
+  ASSIGN_OR_RETURN(std::vector<int> text_token_ids,
+                   tokenizer_.TextToTokenIds(text));
+  if (const std::shared_ptr<DecodeRecorder>& recorder =
+          session_config_.GetDecodeRecorder();
+      recorder != nullptr) {
+    RETURN_IF_ERROR(recorder->StartTurn(text, text_token_ids));
+  }
+  std::vector<int> ids;
+  if (affix_token_ids != nullptr) {
+    ids = affix_token_ids->prefix;
+  }
+  ids.insert(ids.end(), text_token_ids.begin(), text_token_ids.end());
+  if (affix_token_ids != nullptr) {
+    ids.insert(ids.end(), affix_token_ids->suffix.begin(),
+               affix_token_ids->suffix.end());
+  }
+  RET_CHECK(!ids.empty()).SetCode(absl::StatusCode::kInvalidArgument)
+      << "There are no tokens to append.";
+
+  if (benchmark_info_.has_value()) {
+    RETURN_IF_ERROR(benchmark_info_->TimePrefillTurnStart());
+  }
+  // The decode that follows waits for the prefill.
+  RETURN_IF_ERROR(PrefillTokenIds(executor_, tokenizer_, ids,
+                                  /*wait_for_completion=*/false,
+                                  benchmark_info_, &cancel_params));
+  if (benchmark_info_.has_value()) {
+    RETURN_IF_ERROR(benchmark_info_->TimePrefillTurnEnd(ids.size()));
+  }
+  last_prefill_token_id_ = ids.back();
+  if (context_token_ids_.has_value()) {
+    context_token_ids_->insert(context_token_ids_->end(), ids.begin(),
+                               ids.end());
+  }
+  if (UsePromptLookup()) {
+    prompt_token_ids_.insert(prompt_token_ids_.end(), ids.begin(), ids.end());
+  }
+  RecordPrefillMetrics(start_step);
+  return absl::OkStatus();
+}
+
+absl::StatusOr<Responses> SessionBasic::AppendAndDecode(absl::string_view text,
+                                                        PromptRole role) {
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return RunTask([this, text = std::string(text), role,
+                  cancellation]() -> absl::StatusOr<Responses> {
+    RETURN_IF_ERROR(AppendInternal(text, role, cancellation.params));
+    const std::optional<int> start_step = GetStepForMetrics();
+    const absl::Time start_time = absl::Now();
+    absl::StatusOr<Responses> responses =
+        this->DecodeInternal(cancellation.params);
+    RecordDecodeMetrics(start_step, start_time);
+    return responses;
   });
 }
 
+absl::Status SessionBasic::AppendAndDecodeAsync(
+    absl::string_view text, PromptRole role, InferenceObservable* observer) {
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return ScheduleTask(
+      [this, text = std::string(text), role, observer, cancellation]() {
+        std::unique_ptr<InferenceObservable> queued_observer;
+        InferenceObservable* delivery_observer =
+            GetDeliveryObserver(observer, queued_observer);
+        if (absl::Status status =
+                AppendInternal(text, role, cancellation.params);
+            !status.ok()) {
+          delivery_observer->OnError(status);
+          return;
+        }
+        DecodeStreamingTask(delivery_observer, cancellation.params);
+      });
+}
+
 absl::StatusOr<Responses> SessionBasic::GenerateContent(
     const std::vector<InputData>& contents) {
-  RETURN_IF_ERROR(RunPrefill(contents));
-  return RunDecode();
+  if (response_cache_ == nullptr) {
+    RETURN_IF_ERROR(RunPrefill(contents));
+    return RunDecode();
+  }
+  ASSIGN_OR_RETURN(std::string input, JoinTextInputs(contents));
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return RunTask([this, input = std::move(input), cancellation]() {
+    return GenerateCachedInternal(input, cancellation.params);
+  });
 }
 
 absl::Status SessionBasic::GenerateContentStream(
     const std::vector<InputData>& contents, InferenceObservable* observer) {
-  RETURN_IF_ERROR(RunPrefillAsync(contents, observer));
-  return RunDecodeAsync(observer);
+  if (response_cache_ == nullptr) {
+    RETURN_IF_ERROR(RunPrefillAsync(contents, observer));
+    return RunDecodeAsync(observer);
+  }
+  ASSIGN_OR_RETURN(std::string input, JoinTextInputs(contents));
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return ScheduleTask(
+      [this, input = std::move(input), observer, cancellation]() {
+        GenerateCachedStreamingTask(input, observer, cancellation.params);
+      });
+}
+
+bool SessionBasic::CanUseResponseCache() const {
+  return response_cache_ != nullptr && !cached_turn_.has_value() &&
+         !draft_.has_value() && rewind_points_.empty() &&
+         context_token_ids_.has_value() && context_token_ids_->empty();
+}
+
+absl::StatusOr<Responses> SessionBasic::GenerateCachedInternal(
+    absl::string_view input, const CancelParams& cancel_params) {
+  // Checked before the prefill changes it.
+  const bool use_response_cache = CanUseResponseCache();
+  std::vector<int> token_ids;
+  if (use_response_cache) {
+    ASSIGN_OR_RETURN(token_ids, tokenizer_.TextToTokenIds(input));
+    if (std::shared_ptr<const Responses> responses =
+            response_cache_->Lookup(decoding_key_, token_ids);
+        responses != nullptr) {
+      ASSIGN_OR_RETURN(absl::string_view response_text,
+                       responses->GetResponseTextAt(0));
+      cached_turn_ = CachedTurn{.input = std::string(input),
+                                .response_text = std::string(response_text)};
+      return *responses;
+    }
+  }
+  RETURN_IF_ERROR(
+      PrefillInternal(input, /*wait_for_completion=*/true, cancel_params));
+  const std::optional<int> start_step = GetStepForMetrics();
+  const absl::Time start_time = absl::Now();
+  absl::StatusOr<Responses> responses = DecodeInternal(cancel_params);
+  RecordDecodeMetrics(start_step, start_time);
+  if (use_response_cache && responses.ok()) {
+    response_cache_->Insert(decoding_key_, token_ids, *responses);
+  }
+  return responses;
+}
+
+void SessionBasic::GenerateCachedStreamingTask(
+    absl::string_view input, InferenceObservable* observer,
+    const CancelParams& cancel_params) {
+  std::unique_ptr<InferenceObservable> queued_observer;
+  InferenceObservable* delivery_observer =
+      GetDeliveryObserver(observer, queued_observer);
+  const bool use_response_cache = CanUseResponseCache();
+  std::vector<int> token_ids;
+  if (use_response_cache) {
+    absl::StatusOr<std::vector<int>> input_token_ids =
+        tokenizer_.TextToTokenIds(input);
+    if (!input_token_ids.ok()) {
+      delivery_observer->OnError(input_token_ids.status());
+      return;
+    }
+    token_ids = *std::move(input_token_ids);
+    if (std::shared_ptr<const Responses> responses =
+            response_cache_->Lookup(decoding_key_, token_ids);
+        responses != nullptr) {
+      absl::StatusOr<absl::string_view> response_text =
+          responses->GetResponseTextAt(0);
+      if (!response_text.ok()) {
+        delivery_observer->OnError(response_text.status());
+        return;
+      }
+      cached_turn_ = CachedTurn{.input = std::string(input),
+                                .response_text = std::string(*response_text)};
+      // The prefill is done as with RunPrefillAsync(), then the whole
+      // response is sent at once, coalesced as a decode would be.
+      delivery_observer->OnDone();
+      std::optional<CoalescingObservable> coalescing_observer;
+      if (const auto& options = session_config_.GetStreamingFlushOptions();
+          options.has_value()) {
+        coalescing_observer.emplace(delivery_observer, *options);
+      }
+      InferenceObservable* response_observer =
+          coalescing_observer.has_value() ? &*coalescing_observer
+                                          : delivery_observer;
+      response_observer->OnNext(*responses);
+      response_observer->OnDone();
+      return;
+    }
+  }
+  if (absl::Status status = PrefillInternal(
+          input, /*wait_for_completion=*/false, cancel_params);
+      !status.ok()) {
+    delivery_observer->OnError(status);
+    return;
+  }
+  delivery_observer->OnDone();
+  if (!use_response_cache) {
+    DecodeStreamingTask(delivery_observer, cancel_params);
+    return;
+  }
+  ResponseCollector collector(delivery_observer);
+  DecodeStreamingTask(&collector, cancel_params);
+  if (collector.IsDone()) {
+    response_cache_->Insert(decoding_key_, token_ids,
+                            collector.TakeResponses());
+  }
+}
+
+absl::Status SessionBasic::ReplayCachedTurn(
+    const CancelParams& cancel_params) {
+  if (!cached_turn_.has_value()) {
+    return absl::OkStatus();
+  }
+  const CachedTurn cached_turn = *std::move(cached_turn_);
+  cached_turn_.reset();
+  RETURN_IF_ERROR(PrefillInternal(cached_turn.input,
+                                  /*wait_for_completion=*/false,
+                                  cancel_params));
+  if (cached_turn.response_text.empty()) {
+    return absl::OkStatus();
+  }
+  // The response is prefilled at the step its decode would have started at,
+  // without the stop token the decode ended with.
+  RecordRewindPoint();
+  ASSIGN_OR_RETURN(std::vector<int> response_token_ids,
+                   tokenizer_.TextToTokenIds(cached_turn.response_text));
+  if (response_token_ids.empty()) {
+    return absl::OkStatus();
+  }
+  RETURN_IF_ERROR(PrefillTokenIds(executor_, tokenizer_, response_token_ids,
+                                  /*wait_for_completion=*/false,
+                                  benchmark_info_, &cancel_params));
+  last_prefill_token_id_ = response_token_ids.back();
+  // As after a decode, the context is no longer tracked.
+  context_token_ids_ = std::nullopt;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<int> SessionBasic::GetCurrentStep() {
+  return RunTask([this]() -> absl::StatusOr<int> {
+    RETURN_IF_ERROR(ReplayCachedTurn(CancelParams()));
+    return executor_.GetCurrentStep();
+  });
+}
+
+absl::Status SessionBasic::RewindToStep(int step) {
+  return RunTask([this, step]() { return RewindInternal(step); });
+}
+
+absl::Status SessionBasic::UpdateDraft(absl::string_view text) {
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return RunTask([this, text = std::string(text), cancellation]() {
+    return UpdateDraftInternal(text, cancellation.params).status();
+  });
+}
+
+absl::Status SessionBasic::CommitDraft(absl::string_view text) {
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return RunTask([this, text = std::string(text), cancellation]() {
+    return CommitDraftInternal(text, cancellation.params);
+  });
+}
+
+absl::Status SessionBasic::DiscardDraft() {
+  return RunTask([this]() {
+    if (!draft_.has_value()) {
+      return absl::OkStatus();
+    }
+    const int start_step = draft_->start.step;
+    draft_.reset();
+    return RewindInternal(start_step);
+  });
+}
+
+absl::Status SessionBasic::CompactContext(
+    absl::Span<const std::pair<int, int>> discarded_ranges) {
+  // The ranges are copied, since the task may outlive the call on a timeout.
+  std::vector<std::pair<int, int>> ranges(discarded_ranges.begin(),
+                                          discarded_ranges.end());
+  return RunTask([this, ranges = std::move(ranges)]() {
+    return CompactContextInternal(ranges);
+  });
+}
+
+absl::StatusOr<std::vector<float>> SessionBasic::Score(
+    const std::vector<InputData>& contents,
+    absl::Span<const std::string> continuations) {
+  ASSIGN_OR_RETURN(std::string input, JoinTextInputs(contents));
+  // The continuations are copied, since the task may outlive the call on a
+  // timeout.
+  std::vector<std::string> texts(continuations.begin(), continuations.end());
+  const RequestCancellation cancellation = NewRequestCancellation();
+  return RunTask([this, input = std::move(input), texts = std::move(texts),
+                  cancellation]() -> absl::StatusOr<std::vector<float>> {
+    RETURN_IF_ERROR(this->PrefillInternal(input, /*wait_for_completion=*/true,
+                                          cancellation.params));
+    return this->ScoreInternal(texts);
+  });
+}
+
+absl::StatusOr<std::vector<float>> SessionBasic::ScoreInternal(
+    absl::Span<const std::string> continuations) {
+  RET_CHECK_EQ(session_config_.GetNumOutputCandidates(), 1)
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "Score is only supported for a single output candidate.";
+  std::vector<float> scores;
+  scores.reserve(continuations.size());
+  for (const std::string& continuation : continuations) {
+    ASSIGN_OR_RETURN(std::vector<int> token_ids,
+                     tokenizer_.TextToTokenIds(continuation));
+    RET_CHECK(!token_ids.empty()).SetCode(absl::StatusCode::kInvalidArgument)
+        << "The continuation has no tokens: " << continuation;
+    ASSIGN_OR_RETURN(std::vector<float> log_probabilities,
+                     executor_.ScoreTokens(token_ids));
+    float score = 0.0f;
+    for (float log_probability : log_probabilities) {
+      score += log_probability;
+    }
+    scores.push_back(score);
+  }
+  return scores;
+}
+
+absl::Status SessionBasic::SaveCheckpoint(absl::string_view path) {
+  return RunTask([this, path]() {
+    RETURN_IF_ERROR(ReplayCachedTurn(CancelParams()));
+    absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> checkpoint =
+        executor_.SaveState();
+    return checkpoint.ok() ? (*checkpoint)->SaveToFile(path)
+                           : checkpoint.status();
+  });
+}
+
+absl::Status SessionBasic::RestoreCheckpoint(absl::string_view path) {
+  return RunTask(
+      [this, path]() { return RestoreCheckpointInternal(path); });
 }
 
 absl::StatusOr<BenchmarkInfo> SessionBasic::GetBenchmarkInfo() {
   if (benchmark_info_.has_value()) {
+    // The stage breakdown of the executor is reported along with the session
+    // benchmark, for the backends that support it.
+    absl::StatusOr<ExecutorStageLatencies> stage_latencies =
+        executor_.GetStageLatencies();
+    if (stage_latencies.ok()) {
+      benchmark_info_->SetExecutorStageLatencies(*std::move(stage_latencies));
+    } else if (!absl::IsUnimplemented(stage_latencies.status())) {
+      return stage_latencies.status();
+    }
+    absl::StatusOr<EmbeddingCacheStats> embedding_cache_stats =
+        executor_.GetEmbeddingCacheStats();
+    if (embedding_cache_stats.ok()) {
+      benchmark_info_->SetEmbeddingCacheStats(
+          embedding_cache_stats->hits, embedding_cache_stats->misses,
+          embedding_cache_stats->size_in_bytes);
+    } else if (!absl::IsUnimplemented(embedding_cache_stats.status())) {
+      return embedding_cache_stats.status();
+    }
+    absl::StatusOr<int> prefill_chunk_size = executor_.GetPrefillChunkSize();
+    if (prefill_chunk_size.ok()) {
+      benchmark_info_->SetPrefillChunkSize(*prefill_chunk_size);
+    } else if (!absl::IsUnimplemented(prefill_chunk_size.status()) &&
+               !absl::IsFailedPrecondition(prefill_chunk_size.status())) {
+      return prefill_chunk_size.status();
+    }
     return benchmark_info_.value();
   }
   return absl::InternalError(
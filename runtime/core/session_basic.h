@@ -15,22 +15,41 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SESSION_BASIC_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SESSION_BASIC_H_
 
+#include <atomic>
 #include <memory>
 #include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/cleanup/cleanup.h"  // from @com_google_absl
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "runtime/components/sampler.h"
+#include "runtime/components/stop_string_detector.h"
 #include "runtime/components/stop_token_detector.h"
+#include "runtime/components/token_constraint.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/core/decode_pacer.h"
+#include "runtime/core/pipeline.h"
+#include "runtime/core/prefix_cache.h"
+#include "runtime/core/response_cache.h"
+#include "runtime/core/session_resource_pool.h"
+#include "runtime/engine/delivery_thread.h"
 #include "runtime/engine/engine.h"
+#include "runtime/engine/engine_metrics.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
 #include "runtime/executor/llm_executor.h"
+#include "runtime/framework/fair_task_scheduler.h"
 #include "runtime/framework/threadpool.h"
 #include "runtime/proto/sampler_params.pb.h"
 
@@ -48,11 +67,34 @@ class SessionBasic : public Engine::Session {
   // - sampler_params: The sampler parameters used for decoding. Note that if
   //   the sampler_params.type is TYPE_UNSPECIFIED, the sampling logic will be
   //   handled by the LLM Executor.
+  // - prefix_cache: The optional engine-level prefix cache shared by all the
+  //   sessions of the engine.
+  // - sampler_thread_pool: The optional pool the CPU sampler samples the
+  //   output candidates on in parallel, and the long prompts are encoded on in
+  //   chunks. It must differ from worker_thread_pool, which the sampler and the
+  //   tokenizer are called from.
+  // - constraint_cache: The engine-level cache of the compiled constraints,
+  //   required when the session config sets constrained decoding options.
+  // - metrics_recorder: The optional recorder of the engine metrics, which
+  //   must outlive the session.
+  // - task_scheduler: The optional scheduler sharing worker_thread_pool among
+  //   the sessions by their scheduling weights. Without it, the tasks of the
+  //   sessions run in the order they are scheduled.
+  // - response_cache: The optional cache of the responses of the deterministic
+  //   decodes, shared by the sessions of the executor. Only GenerateContent()
+  //   and GenerateContentStream() called before anything is prefilled use it.
   static absl::StatusOr<std::unique_ptr<SessionBasic>> Create(
       LlmExecutor* absl_nonnull executor, Tokenizer* absl_nonnull tokenizer,
       const SessionConfig& session_config,
       std::optional<BenchmarkInfo> benchmark_info,
-      ThreadPool* absl_nonnull worker_thread_pool);
+      ThreadPool* absl_nonnull worker_thread_pool,
+      PrefixCache* absl_nullable prefix_cache = nullptr,
+      ThreadPool* absl_nullable sampler_thread_pool = nullptr,
+      TokenConstraintCache* absl_nullable constraint_cache = nullptr,
+      EngineMetricsRecorder* absl_nullable metrics_recorder = nullptr,
+      SessionResourcePool* absl_nullable resource_pool = nullptr,
+      FairTaskScheduler* absl_nullable task_scheduler = nullptr,
+      ResponseCache* absl_nullable response_cache = nullptr);
 
   virtual ~SessionBasic();
 
@@ -71,34 +113,295 @@ class SessionBasic : public Engine::Session {
   absl::Status RunDecodeAsync(
       InferenceObservable* observer) override;
 
+  absl::StatusOr<Responses> AppendAndDecode(absl::string_view text,
+                                            PromptRole role) override;
+  absl::Status AppendAndDecodeAsync(absl::string_view text, PromptRole role,
+                                    InferenceObservable* observer) override;
+
+  absl::Status Cancel() override;
+
   absl::StatusOr<BenchmarkInfo> GetBenchmarkInfo() override;
 
+  absl::StatusOr<SessionSchedulingStats> GetSchedulingStats() const override;
+
+  absl::StatusOr<int> GetCurrentStep() override;
+
+  // Requires the executor to support Rollback() and GetNextInputTokenId(),
+  // and a single output candidate unless `step` is 0.
+  absl::Status RewindToStep(int step) override;
+
+  // Require the executor to support Rollback() and GetNextInputTokenId(),
+  // and a session that does not shift its context. The draft is prefilled
+  // without the prefix cache.
+  absl::Status UpdateDraft(absl::string_view text) override;
+  absl::Status CommitDraft(absl::string_view text) override;
+  absl::Status DiscardDraft() override;
+
+  // Requires the executor to support CompactContext(). The rewind points after
+  // the first dropped step are dropped too, and the prefix cache is no longer
+  // used.
+  absl::Status CompactContext(
+      absl::Span<const std::pair<int, int>> discarded_ranges) override;
+
+  // Requires the executor to support ScoreTokens(), and a single output
+  // candidate.
+  absl::StatusOr<std::vector<float>> Score(
+      const std::vector<InputData>& contents,
+      absl::Span<const std::string> continuations) override;
+
+  // Requires the executor to support SaveState() and RestoreState().
+  absl::Status SaveCheckpoint(absl::string_view path) override;
+  absl::Status RestoreCheckpoint(absl::string_view path) override;
+
  private:
+  // The state of the executor at the start of a prefill or decode, which the
+  // session can be rewound to.
+  struct RewindPoint {
+    int step;
+    // The pending input token at `step`, or -1 if there is none.
+    int next_input_token_id;
+  };
+
+  // The input of the next turn prefilled while it is typed, see
+  // UpdateDraft().
+  struct Draft {
+    // The state of the executor when the draft started.
+    RewindPoint start;
+    // The token ids before the text, i.e. the start token and the prompt
+    // template prefix.
+    std::vector<int> head_token_ids;
+    // The token ids prefilled from `start`, starting with the head ones.
+    std::vector<int> prefilled_token_ids;
+  };
+
+  // The first turn of the session served from the response cache, which the
+  // executor has not run yet, see ReplayCachedTurn().
+  struct CachedTurn {
+    std::string input;
+    std::string response_text;
+  };
+
+  // The cancellation of a prefill or decode call, taken when the call is made
+  // and kept by its task.
+  struct RequestCancellation {
+    // The flag set by the next Cancel().
+    std::shared_ptr<const std::atomic_bool> cancel_flag;
+    // Refers to `cancel_flag`, with the deadline of the request timeout.
+    CancelParams params;
+  };
+
   explicit SessionBasic(LlmExecutor* absl_nonnull executor,
                         Tokenizer* absl_nonnull tokenizer,
                         std::unique_ptr<Sampler> sampler,
                         const SessionConfig& session_config,
                         std::optional<BenchmarkInfo> benchmark_info,
                         ThreadPool* absl_nonnull worker_thread_pool,
-                        const StopTokenDetector& stop_token_detector)
+                        const StopTokenDetector& stop_token_detector,
+                        const StopStringDetector& stop_string_detector,
+                        PrefixCache* absl_nullable prefix_cache,
+                        ThreadPool* absl_nullable sampler_thread_pool,
+                        PromptAffixTokenIds affix_token_ids,
+                        EngineMetricsRecorder* absl_nullable metrics_recorder,
+                        SessionResourcePool* absl_nullable resource_pool,
+                        std::string resource_key,
+                        FairTaskScheduler* absl_nullable task_scheduler,
+                        FairTaskScheduler::FlowId scheduling_flow,
+                        ResponseCache* absl_nullable response_cache,
+                        std::string decoding_key)
       : executor_(*executor),
         tokenizer_(*tokenizer),
         sampler_(std::move(sampler)),
         session_config_(session_config),
         benchmark_info_(benchmark_info),
         worker_thread_pool_(*worker_thread_pool),
-        stop_token_detector_(stop_token_detector) {}
+        stop_token_detector_(stop_token_detector),
+        stop_string_detector_(stop_string_detector),
+        prefix_cache_(prefix_cache),
+        sampler_thread_pool_(sampler_thread_pool),
+        affix_token_ids_(std::move(affix_token_ids)),
+        metrics_recorder_(metrics_recorder),
+        resource_pool_(resource_pool),
+        resource_key_(std::move(resource_key)),
+        task_scheduler_(task_scheduler),
+        scheduling_flow_(scheduling_flow),
+        response_cache_(response_cache),
+        decoding_key_(std::move(decoding_key)) {
+    if (session_config_.GetDecodePacingConfig().has_value()) {
+      decode_pacer_.emplace(*session_config_.GetDecodePacingConfig());
+    }
+    if (session_config_.GetDeliveryOptions().has_value()) {
+      delivery_thread_.emplace(*session_config_.GetDeliveryOptions());
+    }
+  }
 
   // The internal function to prefill the input prompt. It is for convenience to
   // wrap it with lambda function for scheduling.
   absl::Status PrefillInternal(absl::string_view input,
-                               bool wait_for_completion);
+                               bool wait_for_completion,
+                               const CancelParams& cancel_params);
+
+  // Returns the summed log-probabilities of the tokens of each continuation
+  // following the prefilled tokens.
+  absl::StatusOr<std::vector<float>> ScoreInternal(
+      absl::Span<const std::string> continuations);
 
   // The internal functions to decode the input prompt. It is for convenience to
   // wrap it with lambda function for scheduling.
-  absl::StatusOr<Responses> DecodeInternal();
-  absl::Status DecodeInternalStreaming(
-      InferenceObservable* observer = nullptr);
+  absl::StatusOr<Responses> DecodeInternal(const CancelParams& cancel_params);
+  absl::Status DecodeInternalStreaming(InferenceObservable* observer,
+                                       const CancelParams& cancel_params);
+
+  // Returns true if the responses of the next call may be served from, and
+  // stored into, the response cache: the session decodes deterministically,
+  // and has prefilled nothing yet.
+  bool CanUseResponseCache() const;
+
+  // The internal functions of GenerateContent() and GenerateContentStream()
+  // with the response cache, run on the worker thread. A hit is returned, or
+  // streamed as one response, without running the executor, and a miss is
+  // prefilled and decoded as usual, then stored.
+  absl::StatusOr<Responses> GenerateCachedInternal(
+      absl::string_view input, const CancelParams& cancel_params);
+  void GenerateCachedStreamingTask(absl::string_view input,
+                                   InferenceObservable* observer,
+                                   const CancelParams& cancel_params);
+
+  // Prefills the turn served from the response cache, if any, before anything
+  // else runs the executor: the input as prefilled by the turn, then the
+  // response as if it was decoded.
+  absl::Status ReplayCachedTurn(const CancelParams& cancel_params);
+
+  // Returns the observer the worker thread calls for `observer`: `observer`
+  // itself, or an observer queuing the calls on the delivery thread, owned by
+  // `queued_observer`.
+  InferenceObservable* GetDeliveryObserver(
+      InferenceObservable* observer,
+      std::unique_ptr<InferenceObservable>& queued_observer);
+
+  // Runs the streaming decode of RunDecodeAsync() on the worker thread,
+  // sending the responses and the errors to `observer`.
+  void DecodeStreamingTask(InferenceObservable* observer,
+                           const CancelParams& cancel_params);
+
+  // Returns the token ids of the prompt template affixes of `role`, encoded on
+  // first use, or nullptr for PromptRole::kRaw.
+  absl::StatusOr<const PromptAffixTokenIds*> GetAffixTokenIds(PromptRole role);
+
+  // The internal function of AppendAndDecode() prefilling `text` between the
+  // affixes of `role` from the current step, without a start token.
+  absl::Status AppendInternal(absl::string_view text, PromptRole role,
+                              const CancelParams& cancel_params);
+
+  // Returns the cancellation of a prefill or decode call made now.
+  RequestCancellation NewRequestCancellation();
+
+  // Schedules a task on the worker thread, with the priority of the session.
+  // The tasks of the session run in the order they are scheduled.
+  absl::Status ScheduleTask(absl::AnyInvocable<void() &&> task);
+
+  // Like ScheduleTask(), but waits up to Engine::kDefaultTimeout for the
+  // result of the task, such that a call waits for its own task, and not for
+  // the tasks of the other sessions sharing the worker thread. The task runs
+  // on the calling thread when the worker thread is idle and runs the tasks
+  // inline, see EngineSettings::SetWorkerSpinDuration().
+  template <typename Task>
+  auto RunTask(Task task) {
+    auto recorded_task = WithSchedulingStats(std::move(task));
+    if (task_scheduler_ != nullptr) {
+      return task_scheduler_->SubmitAndWait(
+          scheduling_flow_, session_config_.GetPriority(),
+          std::move(recorded_task), Engine::kDefaultTimeout);
+    }
+    return worker_thread_pool_.SubmitAndWait(std::move(recorded_task),
+                                             session_config_.GetPriority(),
+                                             Engine::kDefaultTimeout);
+  }
+
+  // Wraps `task` scheduled now, such that its wait for the worker thread and
+  // the tokens it prefills and decodes are recorded into the scheduling
+  // stats, and charged to the flow of the session.
+  template <typename Task>
+  auto WithSchedulingStats(Task task) {
+    return [this, task = std::move(task),
+            schedule_time = absl::Now()]() mutable {
+      const absl::Time start_time = absl::Now();
+      const absl::StatusOr<int> start_step = executor_.GetCurrentStep();
+      absl::Cleanup record_task = [&]() {
+        RecordScheduledTask(start_time - schedule_time, start_step);
+      };
+      return std::move(task)();
+    };
+  }
+
+  // Records a task which waited `wait_time` for the worker thread, and
+  // started at `start_step`, into the scheduling stats.
+  void RecordScheduledTask(absl::Duration wait_time,
+                           const absl::StatusOr<int>& start_step);
+
+  // Returns the budget of a decode starting now, from the session config,
+  // paced by the pacer of the session if any.
+  DecodeBudget NewDecodeBudget();
+
+  // Returns true if the session decodes with beam search, with one beam per
+  // output candidate.
+  bool UseBeamSearch() const {
+    return session_config_.GetSamplerParams().type() ==
+           proto::SamplerParameters::BEAM_SEARCH;
+  }
+
+  // Returns true if the session decodes with prompt lookup decoding.
+  bool UsePromptLookup() const {
+    return session_config_.GetPromptLookupConfig().has_value();
+  }
+
+  // Decodes with prompt lookup decoding from the tokens prefilled since the
+  // last decode.
+  absl::StatusOr<Responses> DecodePromptLookupInternal();
+
+  // Records the state of the executor as a rewind point, at the start of a
+  // prefill or decode. Nothing is recorded if the executor cannot report it.
+  void RecordRewindPoint();
+
+  // Returns the step of the executor when a prefill or decode starts, or
+  // std::nullopt if the metrics are not recorded or the executor cannot report
+  // it.
+  std::optional<int> GetStepForMetrics() const;
+
+  // Records the engine metrics of a prefill or decode started at `start_step`,
+  // and at `start_time` for the decode. Nothing is recorded without a start
+  // step.
+  void RecordPrefillMetrics(std::optional<int> start_step);
+  void RecordDecodeMetrics(std::optional<int> start_step,
+                           absl::Time start_time);
+
+  // Returns a FailedPrecondition error if a draft is open, which the other
+  // prefills, decodes and rewinds cannot run along with.
+  absl::Status CheckNoDraft() const;
+
+  // The internal function of UpdateDraft(), run on the worker thread. Opens
+  // the draft if needed, and returns the token ids of the whole turn without
+  // the template suffix, of which all but the last are prefilled.
+  absl::StatusOr<std::vector<int>> UpdateDraftInternal(
+      absl::string_view text, const CancelParams& cancel_params);
+
+  // The internal function of CommitDraft(), run on the worker thread.
+  absl::Status CommitDraftInternal(absl::string_view text,
+                                   const CancelParams& cancel_params);
+
+  // The internal function of RewindToStep(), run on the worker thread.
+  absl::Status RewindInternal(int step);
+
+  // The internal function of CompactContext(), run on the worker thread.
+  absl::Status CompactContextInternal(
+      absl::Span<const std::pair<int, int>> discarded_ranges);
+
+  // The internal function of RestoreCheckpoint(), run on the worker thread.
+  absl::Status RestoreCheckpointInternal(absl::string_view path);
+
+  // Selects the LoRA adapter of the session on the shared executor. Called on
+  // the worker thread before each prefill and decode, since another session
+  // may have selected its own adapter in between.
+  absl::Status SelectLoraAdapter();
 
   // The executor used for run the LLM for prefill/decode.
   LlmExecutor& executor_;
@@ -124,6 +427,86 @@ class SessionBasic : public Engine::Session {
 
   // The stop token detector used for the session.
   StopTokenDetector stop_token_detector_;
+
+  // The stop strings of the session, matched on the streamed text.
+  StopStringDetector stop_string_detector_;
+
+  // The prefix cache shared by the sessions of the engine, or nullptr if the
+  // prefix cache is disabled.
+  PrefixCache* absl_nullable prefix_cache_;
+
+  // The pool the CPU sampler samples the output candidates on, also used to
+  // encode the long prompts in parallel, or nullptr.
+  ThreadPool* absl_nullable sampler_thread_pool_;
+
+  // The token ids of the prompt template affixes around each input. Not const,
+  // so that they are moved back into the resource pool.
+  PromptAffixTokenIds affix_token_ids_;
+  // The token ids of the system prompt template affixes, encoded by the first
+  // append of a system text.
+  std::optional<PromptAffixTokenIds> system_affix_token_ids_;
+
+  // The token ids prefilled into the executor so far. The decoded tokens are
+  // not tracked, so it is reset to std::nullopt and the prefix cache is no
+  // longer used once the session starts decoding.
+  std::optional<std::vector<int>> context_token_ids_ = std::vector<int>();
+
+  // The token ids prefilled since the last decode, where the prompt lookup
+  // decoding looks up its proposals. Only tracked with prompt lookup decoding.
+  std::vector<int> prompt_token_ids_;
+
+  // The recorder of the engine metrics, or nullptr.
+  EngineMetricsRecorder* absl_nullable metrics_recorder_;
+
+  // The pool the sampler, the stop detectors and the affixes are given back
+  // to when the session is destroyed, under `resource_key_`, or nullptr. The
+  // key is empty if they are not recycled.
+  SessionResourcePool* absl_nullable resource_pool_;
+  const std::string resource_key_;
+
+  // The pacer of the decode steps, which keeps the step latencies it measured
+  // across the decode calls, or std::nullopt if the decode is not paced.
+  std::optional<DecodePacer> decode_pacer_;
+
+  // The scheduler of the worker thread and the flow of the session in it, or
+  // nullptr if the tasks are scheduled on the worker thread directly.
+  FairTaskScheduler* absl_nullable task_scheduler_;
+  const FairTaskScheduler::FlowId scheduling_flow_;
+
+  // The response cache of the executor and the key of the decoding of the
+  // session in it, or nullptr and an empty key if the responses of the
+  // session are not cached.
+  ResponseCache* absl_nullable response_cache_;
+  const std::string decoding_key_;
+  // The turn served from the response cache but not run by the executor yet.
+  std::optional<CachedTurn> cached_turn_;
+
+  // The waits of the tasks of the session for the worker thread.
+  mutable absl::Mutex scheduling_stats_mutex_;
+  SessionSchedulingStats scheduling_stats_
+      ABSL_GUARDED_BY(scheduling_stats_mutex_);
+
+  // The thread the observers are called on, or std::nullopt if they are
+  // called on the worker thread. It delivers the calls still queued when the
+  // session is destroyed.
+  std::optional<DeliveryThread> delivery_thread_;
+
+  // The start of the first prefill since the last decode, from which the time
+  // to first token of the next decode is measured. Only tracked along with the
+  // metrics.
+  std::optional<absl::Time> turn_start_time_;
+
+  // The rewind points of the turns so far, in increasing order of steps.
+  std::vector<RewindPoint> rewind_points_;
+
+  // The draft of the next turn, or std::nullopt if none is open.
+  std::optional<Draft> draft_;
+
+  // The flag the calls made since the last Cancel() are cancelled by. Cancel()
+  // sets it and replaces it with a new one for the later calls.
+  absl::Mutex cancel_mutex_;
+  std::shared_ptr<std::atomic_bool> cancel_flag_ ABSL_GUARDED_BY(
+      cancel_mutex_) = std::make_shared<std::atomic_bool>(false);
 };
 
 }  // namespace litert::lm
@@ -3,19 +3,26 @@
 #include <filesystem>  // NOLINT: Required for path manipulation.
 #include <memory>
 #include <optional>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
 #include "runtime/components/sentencepiece_tokenizer.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/core/response_cache.h"
+#include "runtime/engine/engine_metrics.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
 #include "runtime/executor/executor_settings_base.h"
 #include "runtime/executor/fake_llm_executor.h"
 #include "runtime/executor/llm_executor.h"
+#include "runtime/framework/fair_task_scheduler.h"
 #include "runtime/framework/thread_options.h"
 #include "runtime/framework/threadpool.h"
 #include "runtime/util/test_utils.h"  // NOLINT
@@ -23,6 +30,8 @@
 namespace litert::lm {
 namespace {
 
+using ::testing::status::IsOkAndHolds;
+
 constexpr char kTestdataDir[] =
     "litert_lm/runtime/components/testdata/";
 
@@ -91,14 +100,388 @@ TEST_F(SessionBasicTest, RunDecode) {
   EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
 }
 
+TEST_F(SessionBasicTest, RecordsTheEngineMetrics) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  EngineMetricsRecorder metrics_recorder;
+  {
+    auto session = SessionBasic::Create(
+        executor_.get(), tokenizer_.get(), session_config, std::nullopt,
+        worker_thread_pool_.get(), /*prefix_cache=*/nullptr,
+        /*sampler_thread_pool=*/nullptr, /*constraint_cache=*/nullptr,
+        &metrics_recorder);
+    ASSERT_OK(session);
+    EXPECT_EQ(metrics_recorder.GetSnapshot().num_active_sessions, 1);
+    EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+    EXPECT_OK((*session)->RunDecode());
+
+    const EngineMetrics metrics = metrics_recorder.GetSnapshot();
+    EXPECT_EQ(metrics.num_prefill_tokens, 8);
+    EXPECT_GT(metrics.num_decode_tokens, 0);
+    EXPECT_EQ(metrics.num_decodes, 1);
+    EXPECT_GT(metrics.total_time_to_first_token, absl::ZeroDuration());
+    EXPECT_EQ(metrics.kv_cache_num_tokens, 8 + metrics.num_decode_tokens);
+  }
+  EXPECT_EQ(metrics_recorder.GetSnapshot().num_active_sessions, 0);
+}
+
+TEST_F(SessionBasicTest, RecordsTheSchedulingStats) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  FairTaskScheduler task_scheduler(worker_thread_pool_.get());
+  auto session = SessionBasic::Create(
+      executor_.get(), tokenizer_.get(), session_config, std::nullopt,
+      worker_thread_pool_.get(), /*prefix_cache=*/nullptr,
+      /*sampler_thread_pool=*/nullptr, /*constraint_cache=*/nullptr,
+      /*metrics_recorder=*/nullptr, /*resource_pool=*/nullptr,
+      &task_scheduler);
+  ASSERT_OK(session);
+  EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+  EXPECT_OK((*session)->RunDecode());
+
+  ASSERT_OK_AND_ASSIGN(SessionSchedulingStats stats,
+                       (*session)->GetSchedulingStats());
+  EXPECT_EQ(stats.num_tasks, 2);
+  // The 8 prompt tokens, then the decoded ones.
+  EXPECT_GT(stats.num_tokens, 8);
+  EXPECT_GE(stats.max_wait_time, absl::ZeroDuration());
+  EXPECT_LE(stats.max_wait_time, stats.total_wait_time);
+}
+
+TEST_F(SessionBasicTest, RejectsNonPositiveSchedulingWeights) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.SetSamplerBackend(Backend::CPU);
+  session_config.SetSchedulingWeight(0.0);
+  FairTaskScheduler task_scheduler(worker_thread_pool_.get());
+  EXPECT_THAT(
+      SessionBasic::Create(
+          executor_.get(), tokenizer_.get(), session_config, std::nullopt,
+          worker_thread_pool_.get(), /*prefix_cache=*/nullptr,
+          /*sampler_thread_pool=*/nullptr, /*constraint_cache=*/nullptr,
+          /*metrics_recorder=*/nullptr, /*resource_pool=*/nullptr,
+          &task_scheduler),
+      testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(SessionBasicTest, RunPrefillJoinsTheInputsOfACall) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  // The fake executor expects a single prefill of "Hello World!".
+  EXPECT_OK((*session)->RunPrefill({InputText("Hello "), InputText("World!")}));
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, RunDecodeWithMultipleOutputCandidates) {
+  // The prompt is prefilled once for both candidates, and the second one
+  // stops one token earlier.
+  std::vector<std::vector<int>> prefill_tokens = {
+      {2, 90, 547, 58, 735, 210, 466, 2294}};
+  std::vector<std::vector<int>> decode_tokens = {
+      {224, 224}, {24, 24},     {8, 8},       {66, 66},
+      {246, 246}, {18, 18},     {2295, 2294}, {2294, 2294}};
+  executor_ = std::make_unique<FakeLlmExecutor>(2560, prefill_tokens,
+                                                decode_tokens,
+                                                /*batch_size=*/2);
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  proto::SamplerParameters greedy_params;
+  greedy_params.set_type(proto::SamplerParameters::TOP_P);
+  greedy_params.set_k(1);
+  greedy_params.set_p(1.0f);
+  greedy_params.set_temperature(1.0f);
+  session_config.GetMutableSamplerParams() = greedy_params;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  session_config.SetNumOutputCandidates(2);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(responses->GetNumOutputCandidates(), 2);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+  EXPECT_EQ(*(responses->GetResponseTextAt(1)), " How's it going?");
+}
+
+TEST_F(SessionBasicTest, RunDecodeWithMaxOutputTokens) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  session_config.SetMaxOutputTokens(3);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's");
+}
+
+TEST_F(SessionBasicTest, RewindToStepRegeneratesTheResponse) {
+  std::vector<std::vector<int>> prefill_tokens = {
+      {2, 90, 547, 58, 735, 210, 466, 2294}};
+  // The response "How's it going?!" is decoded twice.
+  std::vector<std::vector<int>> decode_tokens = {
+      {224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294},
+      {224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294}};
+  executor_ =
+      std::make_unique<FakeLlmExecutor>(2560, prefill_tokens, decode_tokens);
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+  auto step = (*session)->GetCurrentStep();
+  ASSERT_OK(step);
+  EXPECT_EQ(*step, 8);
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+
+  // Only the steps starting a turn can be rewound to.
+  EXPECT_EQ((*session)->RewindToStep(5).code(),
+            absl::StatusCode::kInvalidArgument);
+  // The prompt is not prefilled again.
+  EXPECT_OK((*session)->RewindToStep(*step));
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(8));
+  responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, CommitDraftOnlyPrefillsTheTail) {
+  // "How's it going?" is typed first, all but its last token prefilled, then
+  // edited into "Hello World!", which only keeps the start token.
+  std::vector<std::vector<int>> prefill_tokens = {
+      {2, 224, 24, 8, 66, 246, 18}, {90, 547, 58, 735, 210, 466}, {2294}};
+  std::vector<std::vector<int>> decode_tokens = {
+      {224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294}};
+  executor_ =
+      std::make_unique<FakeLlmExecutor>(2560, prefill_tokens, decode_tokens);
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  EXPECT_OK((*session)->UpdateDraft("How's it going?"));
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(7));
+  // The draft must be committed first.
+  EXPECT_EQ((*session)->RunPrefill({InputText("Hello World!")}).code(),
+            absl::StatusCode::kFailedPrecondition);
+
+  EXPECT_OK((*session)->CommitDraft("Hello World!"));
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(8));
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, DiscardDraftRewindsToItsStart) {
+  std::vector<std::vector<int>> prefill_tokens = {
+      {2, 224, 24, 8, 66, 246, 18}, {2, 90, 547, 58, 735, 210, 466, 2294}};
+  std::vector<std::vector<int>> decode_tokens = {{224}};
+  executor_ =
+      std::make_unique<FakeLlmExecutor>(2560, prefill_tokens, decode_tokens);
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  EXPECT_OK((*session)->UpdateDraft("How's it going?"));
+  EXPECT_OK((*session)->DiscardDraft());
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(0));
+  EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(8));
+}
+
+TEST_F(SessionBasicTest, AppendAndDecodeContinuesFromTheDecodedTokens) {
+  // The appended text gets no start token.
+  std::vector<std::vector<int>> prefill_tokens = {
+      {2, 90, 547, 58, 735, 210, 466, 2294}, {90, 547, 58, 735, 210, 466, 2294}};
+  std::vector<std::vector<int>> decode_tokens = {
+      {224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294},
+      {224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294}};
+  executor_ =
+      std::make_unique<FakeLlmExecutor>(2560, prefill_tokens, decode_tokens);
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  auto responses = (*session)->GenerateContent({InputText("Hello World!")});
+  ASSERT_OK(responses);
+  EXPECT_EQ((*session)->AppendAndDecode("", PromptRole::kRaw).status().code(),
+            absl::StatusCode::kInvalidArgument);
+
+  responses = (*session)->AppendAndDecode("Hello World!", PromptRole::kUser);
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, ScoreRanksTheContinuations) {
+  std::vector<std::vector<int>> prefill_tokens = {
+      {2, 90, 547, 58, 735, 210, 466, 2294}};
+  std::vector<std::vector<int>> decode_tokens = {
+      {224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294}};
+  executor_ =
+      std::make_unique<FakeLlmExecutor>(2560, prefill_tokens, decode_tokens);
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  const std::vector<std::string> continuations = {"How's it going?!",
+                                                  "Goodbye"};
+  auto scores = (*session)->Score({InputText("Hello World!")}, continuations);
+  ASSERT_OK(scores);
+  ASSERT_EQ(scores->size(), 2);
+  // The fake executor scores the tokens of its decode tokens 0.
+  EXPECT_FLOAT_EQ((*scores)[0], 0.0f);
+  EXPECT_LT((*scores)[1], 0.0f);
+
+  // The session is left as after the prefill.
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(8));
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, CompactContextDropsTheTokens) {
+  std::vector<std::vector<int>> prefill_tokens = {
+      {2, 90, 547, 58, 735, 210, 466, 2294}};
+  std::vector<std::vector<int>> decode_tokens = {
+      {224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294}};
+  executor_ =
+      std::make_unique<FakeLlmExecutor>(2560, prefill_tokens, decode_tokens);
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(8));
+
+  EXPECT_EQ((*session)->CompactContext({{3, 1}}).code(),
+            absl::StatusCode::kInvalidArgument);
+  EXPECT_OK((*session)->CompactContext({{1, 3}, {4, 5}}));
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(5));
+  // The kept tokens are not prefilled again.
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, SaveAndRestoreCheckpoint) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  const std::string path = (std::filesystem::path(::testing::TempDir()) /
+                            "session_checkpoint.bin")
+                               .string();
+  {
+    auto session =
+        SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                             std::nullopt, worker_thread_pool_.get());
+    ASSERT_OK(session);
+    EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+    EXPECT_OK((*session)->SaveCheckpoint(path));
+  }
+
+  // The restored session decodes without the prompt being prefilled again.
+  FakeLlmExecutor executor(
+      2560, /*prefill_tokens_set=*/{},
+      {{224}, {24}, {8}, {66}, {246}, {18}, {2295}, {2294}});
+  auto session =
+      SessionBasic::Create(&executor, tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  EXPECT_OK((*session)->RestoreCheckpoint(path));
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(8));
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+}
+
 class TestObserver : public InferenceObservable {
  public:
+  void OnNext(const Responses& responses) override {
+    if (auto text = responses.GetResponseTextAt(0); text.ok()) {
+      texts_.emplace_back(*text);
+    }
+  }
+
   void OnDone() override { done_ = true; }
 
+  void OnError(const absl::Status& status) override { status_ = status; }
+
   bool IsDone() { return done_; }
 
+  const absl::Status& GetStatus() { return status_; }
+
+  const std::vector<std::string>& GetTexts() { return texts_; }
+
  private:
+  std::vector<std::string> texts_;
   bool done_ = false;
+  absl::Status status_;
 };
 
 TEST_F(SessionBasicTest, RunPrefillAsync) {
@@ -136,5 +519,158 @@ TEST_F(SessionBasicTest, RunDecodeAsync) {
   EXPECT_TRUE(observer.IsDone());
 }
 
+TEST_F(SessionBasicTest, RunDecodeAsyncCoalescesTheResponses) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  StreamingFlushOptions options;
+  options.max_num_responses = 4;
+  options.max_delay = absl::InfiniteDuration();
+  session_config.SetStreamingFlushOptions(options);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  TestObserver observer;
+  EXPECT_OK(
+      (*session)->RunPrefillAsync({InputText("Hello World!")}, &observer));
+  EXPECT_OK((*session)->RunDecodeAsync(&observer));
+  EXPECT_OK(worker_thread_pool_->WaitUntilDone(absl::Seconds(100)));
+  EXPECT_TRUE(observer.IsDone());
+  // The 7 steps of the response are sent in a group of 4, and the rest on
+  // OnDone().
+  ASSERT_EQ(observer.GetTexts().size(), 2);
+  EXPECT_EQ(observer.GetTexts()[0] + observer.GetTexts()[1],
+            " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, RunDecodeAsyncDeliversOnTheDeliveryThread) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  session_config.SetDeliveryOptions(DeliveryOptions{
+      .max_queued_calls = 2,
+      .overflow_policy = DeliveryOverflowPolicy::kCoalesce});
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  TestObserver observer;
+  EXPECT_OK(
+      (*session)->RunPrefillAsync({InputText("Hello World!")}, &observer));
+  EXPECT_OK((*session)->RunDecodeAsync(&observer));
+  EXPECT_OK(worker_thread_pool_->WaitUntilDone(absl::Seconds(100)));
+  // The session delivers the calls still queued when it is destroyed.
+  session->reset();
+  EXPECT_TRUE(observer.IsDone());
+  // Whether coalesced or not, no text is lost.
+  EXPECT_EQ(absl::StrJoin(observer.GetTexts(), ""), " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, GenerateContentServesTheCachedResponses) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  proto::SamplerParameters greedy_params;
+  greedy_params.set_type(proto::SamplerParameters::TOP_P);
+  greedy_params.set_k(1);
+  greedy_params.set_p(1.0f);
+  greedy_params.set_temperature(1.0f);
+  session_config.GetMutableSamplerParams() = greedy_params;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  ASSERT_OK_AND_ASSIGN(auto response_cache, ResponseCache::Create(1024));
+  auto create_session = [&]() {
+    return SessionBasic::Create(
+        executor_.get(), tokenizer_.get(), session_config, std::nullopt,
+        worker_thread_pool_.get(), /*prefix_cache=*/nullptr,
+        /*sampler_thread_pool=*/nullptr, /*constraint_cache=*/nullptr,
+        /*metrics_recorder=*/nullptr, /*resource_pool=*/nullptr,
+        /*task_scheduler=*/nullptr, response_cache.get());
+  };
+  {
+    ASSERT_OK_AND_ASSIGN(auto session, create_session());
+    auto responses = session->GenerateContent({InputText("Hello World!")});
+    ASSERT_OK(responses);
+    EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+  }
+  EXPECT_EQ(response_cache->NumEntries(), 1);
+  EXPECT_EQ(response_cache->NumMisses(), 1);
+
+  // The fake executor only has the tokens of one decode, which the sessions
+  // below do not run.
+  ASSERT_OK_AND_ASSIGN(auto session, create_session());
+  auto responses = session->GenerateContent({InputText("Hello World!")});
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+
+  ASSERT_OK_AND_ASSIGN(auto streaming_session, create_session());
+  TestObserver observer;
+  EXPECT_OK(streaming_session->GenerateContentStream(
+      {InputText("Hello World!")}, &observer));
+  EXPECT_OK(worker_thread_pool_->WaitUntilDone(absl::Seconds(100)));
+  EXPECT_TRUE(observer.IsDone());
+  EXPECT_EQ(absl::StrJoin(observer.GetTexts(), ""), " How's it going?!");
+  EXPECT_EQ(response_cache->NumHits(), 2);
+}
+
+TEST_F(SessionBasicTest, CancelStopsTheCallsMadeBefore) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  // The worker is kept busy until the calls are made and cancelled.
+  absl::Notification cancelled;
+  ASSERT_OK(worker_thread_pool_->Schedule(
+      [&cancelled]() { cancelled.WaitForNotification(); }));
+  TestObserver observer;
+  EXPECT_OK(
+      (*session)->RunPrefillAsync({InputText("Hello World!")}, &observer));
+  EXPECT_OK((*session)->RunDecodeAsync(&observer));
+  EXPECT_OK((*session)->Cancel());
+  cancelled.Notify();
+  EXPECT_OK(worker_thread_pool_->WaitUntilDone(absl::Seconds(100)));
+  EXPECT_FALSE(observer.IsDone());
+  EXPECT_EQ(observer.GetStatus().code(), absl::StatusCode::kCancelled);
+
+  // Nothing was prefilled, and the calls made after Cancel() run.
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(0));
+  EXPECT_OK((*session)->RunPrefill({InputText("Hello World!")}));
+  auto responses = (*session)->RunDecode();
+  ASSERT_OK(responses);
+  EXPECT_EQ(*(responses->GetResponseTextAt(0)), " How's it going?!");
+}
+
+TEST_F(SessionBasicTest, RequestTimeoutStopsTheCalls) {
+  const std::vector<std::vector<int>> stop_token_ids = {{2294}};
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams() = sampler_params_;
+  session_config.GetMutableStopTokenIds() = stop_token_ids;
+  session_config.SetStartTokenId(2);
+  session_config.SetSamplerBackend(Backend::CPU);
+  session_config.SetRequestTimeout(absl::ZeroDuration());
+  auto session =
+      SessionBasic::Create(executor_.get(), tokenizer_.get(), session_config,
+                           std::nullopt, worker_thread_pool_.get());
+  ASSERT_OK(session);
+  EXPECT_EQ((*session)->RunPrefill({InputText("Hello World!")}).code(),
+            absl::StatusCode::kDeadlineExceeded);
+  EXPECT_EQ((*session)->RunDecode().status().code(),
+            absl::StatusCode::kDeadlineExceeded);
+  EXPECT_THAT((*session)->GetCurrentStep(), IsOkAndHolds(0));
+}
+
 }  // namespace
 }  // namespace litert::lm
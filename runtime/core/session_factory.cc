@@ -5,9 +5,14 @@
 
 #include "absl/base/nullability.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "runtime/components/token_constraint.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/core/prefix_cache.h"
+#include "runtime/core/response_cache.h"
 #include "runtime/core/session_basic.h"
+#include "runtime/core/session_resource_pool.h"
 #include "runtime/engine/engine.h"
+#include "runtime/engine/engine_metrics.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
 #include "runtime/executor/llm_executor.h"
@@ -21,9 +26,18 @@ absl::StatusOr<std::unique_ptr<Engine::Session>> InitializeSession(
     LlmExecutor* executor, Tokenizer* tokenizer,
     const SessionConfig& session_config,
     std::optional<BenchmarkInfo> benchmark_info,
-    ThreadPool* absl_nonnull worker_thread_pool) {
-  auto session = SessionBasic::Create(executor, tokenizer, session_config,
-                                      benchmark_info, worker_thread_pool);
+    ThreadPool* absl_nonnull worker_thread_pool,
+    PrefixCache* absl_nullable prefix_cache,
+    ThreadPool* absl_nullable sampler_thread_pool,
+    TokenConstraintCache* absl_nullable constraint_cache,
+    EngineMetricsRecorder* absl_nullable metrics_recorder,
+    SessionResourcePool* absl_nullable resource_pool,
+    FairTaskScheduler* absl_nullable task_scheduler,
+    ResponseCache* absl_nullable response_cache) {
+  auto session = SessionBasic::Create(
+      executor, tokenizer, session_config, benchmark_info, worker_thread_pool,
+      prefix_cache, sampler_thread_pool, constraint_cache, metrics_recorder,
+      resource_pool, task_scheduler, response_cache);
   return session;
 }
 
@@ -20,11 +20,17 @@
 
 #include "absl/base/nullability.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "runtime/components/token_constraint.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/core/prefix_cache.h"
+#include "runtime/core/response_cache.h"
+#include "runtime/core/session_resource_pool.h"
 #include "runtime/engine/engine.h"
+#include "runtime/engine/engine_metrics.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
 #include "runtime/executor/llm_executor.h"
+#include "runtime/framework/fair_task_scheduler.h"
 #include "runtime/framework/threadpool.h"
 
 namespace litert::lm {
@@ -36,7 +42,14 @@ absl::StatusOr<std::unique_ptr<Engine::Session>> InitializeSession(
     LlmExecutor* absl_nonnull executor, Tokenizer* absl_nonnull tokenizer,
     const SessionConfig& session_config,
     std::optional<BenchmarkInfo> benchmark_info,
-    ThreadPool* absl_nonnull worker_thread_pool);
+    ThreadPool* absl_nonnull worker_thread_pool,
+    PrefixCache* absl_nullable prefix_cache = nullptr,
+    ThreadPool* absl_nullable sampler_thread_pool = nullptr,
+    TokenConstraintCache* absl_nullable constraint_cache = nullptr,
+    EngineMetricsRecorder* absl_nullable metrics_recorder = nullptr,
+    SessionResourcePool* absl_nullable resource_pool = nullptr,
+    FairTaskScheduler* absl_nullable task_scheduler = nullptr,
+    ResponseCache* absl_nullable response_cache = nullptr);
 
 }  // namespace litert::lm
 
@@ -0,0 +1,58 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/session_placement.h"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include "absl/hash/hash.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+
+namespace litert::lm {
+
+size_t PlaceSession(absl::Span<const ExecutorPlacementInfo> executors,
+                    std::optional<Backend> preferred_backend,
+                    absl::string_view affinity_key) {
+  std::vector<size_t> candidates;
+  if (preferred_backend.has_value()) {
+    for (size_t i = 0; i < executors.size(); ++i) {
+      if (executors[i].backend == *preferred_backend) {
+        candidates.push_back(i);
+      }
+    }
+  }
+  if (candidates.empty()) {
+    for (size_t i = 0; i < executors.size(); ++i) {
+      candidates.push_back(i);
+    }
+  }
+  if (!affinity_key.empty()) {
+    return candidates[absl::Hash<absl::string_view>()(affinity_key) %
+                      candidates.size()];
+  }
+  size_t least_loaded = candidates[0];
+  for (size_t candidate : candidates) {
+    if (executors[candidate].num_sessions <
+        executors[least_loaded].num_sessions) {
+      least_loaded = candidate;
+    }
+  }
+  return least_loaded;
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,48 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SESSION_PLACEMENT_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SESSION_PLACEMENT_H_
+
+#include <cstddef>
+#include <optional>
+
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+
+namespace litert::lm {
+
+// An executor of the pool of an engine, as seen by the session placement.
+struct ExecutorPlacementInfo {
+  Backend backend = Backend::UNSPECIFIED;
+  // The sessions of the engine alive on the executor.
+  int num_sessions = 0;
+};
+
+// Returns the index in `executors`, which must not be empty, of the executor a
+// new session runs on:
+// - The candidates are the executors of `preferred_backend` if set and there
+//   is any, or all the executors otherwise.
+// - The sessions of the same non-empty `affinity_key` are placed on the same
+//   candidate, whatever the load of the executors.
+// - Otherwise the session is placed on the candidate with the fewest sessions,
+//   the first one on ties.
+size_t PlaceSession(absl::Span<const ExecutorPlacementInfo> executors,
+                    std::optional<Backend> preferred_backend,
+                    absl::string_view affinity_key);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SESSION_PLACEMENT_H_
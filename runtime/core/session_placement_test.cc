@@ -0,0 +1,59 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/session_placement.h"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "runtime/executor/executor_settings_base.h"
+
+namespace litert::lm {
+namespace {
+
+TEST(SessionPlacementTest, PlacesOnTheLeastLoadedExecutor) {
+  const std::vector<ExecutorPlacementInfo> executors = {
+      {Backend::GPU, 2}, {Backend::GPU, 1}, {Backend::NPU, 1}};
+  EXPECT_EQ(PlaceSession(executors, std::nullopt, ""), 1);
+}
+
+TEST(SessionPlacementTest, PlacesOnThePreferredBackend) {
+  const std::vector<ExecutorPlacementInfo> executors = {
+      {Backend::GPU, 0}, {Backend::NPU, 3}, {Backend::NPU, 2}};
+  EXPECT_EQ(PlaceSession(executors, Backend::NPU, ""), 2);
+  // Without an executor of the preferred backend, any executor is used.
+  EXPECT_EQ(PlaceSession(executors, Backend::CPU, ""), 0);
+}
+
+TEST(SessionPlacementTest, PlacesTheSameAffinityKeyTogether) {
+  std::vector<ExecutorPlacementInfo> executors = {
+      {Backend::GPU, 0}, {Backend::GPU, 0}, {Backend::GPU, 0}};
+  const size_t placed = PlaceSession(executors, std::nullopt, "user");
+  // The load does not move the sessions of the key.
+  executors[placed].num_sessions = 10;
+  EXPECT_EQ(PlaceSession(executors, std::nullopt, "user"), placed);
+}
+
+TEST(SessionPlacementTest, PlacesTheAffinityKeyOnThePreferredBackend) {
+  const std::vector<ExecutorPlacementInfo> executors = {
+      {Backend::GPU, 0}, {Backend::NPU, 0}, {Backend::GPU, 0}};
+  for (const char* key : {"a", "b", "c", "d"}) {
+    EXPECT_EQ(PlaceSession(executors, Backend::NPU, key), 1);
+  }
+}
+
+}  // namespace
+}  // namespace litert::lm
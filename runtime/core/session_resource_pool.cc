@@ -0,0 +1,91 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/session_resource_pool.h"
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/str_append.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "runtime/engine/engine_settings.h"
+
+namespace litert::lm {
+
+// static
+std::string SessionResourcePool::GetKey(const SessionConfig& session_config) {
+  if (session_config.GetConstrainedDecodingOptions().has_value() ||
+      session_config.GetDecodeRecorder() != nullptr) {
+    return "";
+  }
+  // The strings are prefixed by their size, so that the key is unambiguous.
+  std::string key = absl::StrCat(
+      static_cast<int>(session_config.GetSamplerBackend()), ";",
+      session_config.GetNumOutputCandidates(), ";",
+      session_config.GetNumTopLogProbs(), ";");
+  const std::string sampler_params =
+      session_config.GetSamplerParams().SerializeAsString();
+  absl::StrAppend(&key, sampler_params.size(), ":", sampler_params);
+  for (const std::vector<int>& stop_token_ids :
+       session_config.GetStopTokenIds()) {
+    absl::StrAppend(&key, "[", absl::StrJoin(stop_token_ids, ","), "]");
+  }
+  absl::StrAppend(&key, ";");
+  for (const std::string& stop_string : session_config.GetStopStrings()) {
+    absl::StrAppend(&key, stop_string.size(), ":", stop_string);
+  }
+  const std::string prompt_templates =
+      session_config.GetPromptTemplates().SerializeAsString();
+  absl::StrAppend(&key, ";", prompt_templates.size(), ":", prompt_templates);
+  return key;
+}
+
+std::optional<SessionResources> SessionResourcePool::Acquire(
+    const std::string& key) {
+  absl::MutexLock lock(&mutex_);
+  auto it = idle_.find(key);
+  if (it == idle_.end()) {
+    return std::nullopt;
+  }
+  SessionResources resources = std::move(it->second.back());
+  it->second.pop_back();
+  if (it->second.empty()) {
+    idle_.erase(it);
+  }
+  return resources;
+}
+
+void SessionResourcePool::Release(const std::string& key,
+                                  SessionResources resources) {
+  absl::MutexLock lock(&mutex_);
+  std::vector<SessionResources>& idle = idle_[key];
+  if (idle.size() < max_num_idle_per_key_) {
+    idle.push_back(std::move(resources));
+  }
+}
+
+int SessionResourcePool::GetNumIdle() const {
+  absl::MutexLock lock(&mutex_);
+  int num_idle = 0;
+  for (const auto& [key, idle] : idle_) {
+    num_idle += idle.size();
+  }
+  return num_idle;
+}
+
+}  // namespace litert::lm
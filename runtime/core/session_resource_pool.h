@@ -0,0 +1,81 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SESSION_RESOURCE_POOL_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SESSION_RESOURCE_POOL_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "runtime/components/sampler.h"
+#include "runtime/components/stop_string_detector.h"
+#include "runtime/components/stop_token_detector.h"
+#include "runtime/core/pipeline.h"
+#include "runtime/engine/engine_settings.h"
+
+namespace litert::lm {
+
+// The parts of a session built from its config, which do not depend on its
+// conversation: the sampler, the stop detectors and the encoded prompt
+// template affixes.
+struct SessionResources {
+  // nullptr if the executor samples or the session decodes with beam search.
+  std::unique_ptr<Sampler> sampler;
+  StopTokenDetector stop_token_detector;
+  StopStringDetector stop_string_detector;
+  PromptAffixTokenIds affix_token_ids;
+};
+
+// Keeps the resources of the destroyed sessions for the next sessions of the
+// same config, such that a session created at a high request rate does not
+// allocate its sampler, or encode its prompt templates, again. The resources
+// are keyed by the fields of the validated config they are built from. The
+// sampler is reset by the session before each decode, as it is already. The
+// class is thread-safe.
+class SessionResourcePool {
+ public:
+  // - max_num_idle_per_key: The number of resources kept per key at most.
+  explicit SessionResourcePool(int max_num_idle_per_key = 4)
+      : max_num_idle_per_key_(max_num_idle_per_key) {}
+
+  // Returns the key of the resources built from `session_config`, or an empty
+  // string if they are not recycled, e.g. with a constrained sampler tied to
+  // the state of its constraint.
+  static std::string GetKey(const SessionConfig& session_config);
+
+  // Takes idle resources of `key`, or returns std::nullopt if there is none.
+  std::optional<SessionResources> Acquire(const std::string& key);
+
+  // Keeps `resources` for the next Acquire() of `key`, unless the key holds
+  // max_num_idle_per_key resources already.
+  void Release(const std::string& key, SessionResources resources);
+
+  // Returns the number of idle resources of all the keys.
+  int GetNumIdle() const;
+
+ private:
+  const int max_num_idle_per_key_;
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::vector<SessionResources>> idle_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_CORE_SESSION_RESOURCE_POOL_H_
@@ -0,0 +1,92 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/core/session_resource_pool.h"
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "runtime/components/decode_recording.h"
+#include "runtime/components/stop_string_detector.h"
+#include "runtime/components/stop_token_detector.h"
+#include "runtime/engine/engine_settings.h"
+
+namespace litert::lm {
+namespace {
+
+SessionResources CreateResources() {
+  return SessionResources{
+      .stop_token_detector = StopTokenDetector(/*batch_size=*/1),
+      .stop_string_detector = StopStringDetector()};
+}
+
+TEST(SessionResourcePoolTest, GetKeyDependsOnTheConfig) {
+  SessionConfig config = SessionConfig::CreateDefault();
+  SessionConfig same_config = SessionConfig::CreateDefault();
+  EXPECT_EQ(SessionResourcePool::GetKey(config),
+            SessionResourcePool::GetKey(same_config));
+
+  SessionConfig other_config = SessionConfig::CreateDefault();
+  other_config.GetMutableStopStrings().push_back("</s>");
+  EXPECT_NE(SessionResourcePool::GetKey(config),
+            SessionResourcePool::GetKey(other_config));
+
+  other_config = SessionConfig::CreateDefault();
+  other_config.GetMutableSamplerParams().set_k(3);
+  EXPECT_NE(SessionResourcePool::GetKey(config),
+            SessionResourcePool::GetKey(other_config));
+}
+
+TEST(SessionResourcePoolTest, GetKeyIsEmptyForConstrainedDecoding) {
+  SessionConfig config = SessionConfig::CreateDefault();
+  config.GetMutableConstrainedDecodingOptions();
+  EXPECT_EQ(SessionResourcePool::GetKey(config), "");
+}
+
+TEST(SessionResourcePoolTest, GetKeyIsEmptyForDecodeRecording) {
+  SessionConfig config = SessionConfig::CreateDefault();
+  config.SetDecodeRecorder(std::make_shared<DecodeRecorder>("params"));
+  EXPECT_EQ(SessionResourcePool::GetKey(config), "");
+}
+
+TEST(SessionResourcePoolTest, AcquiresTheReleasedResources) {
+  SessionResourcePool pool;
+  EXPECT_FALSE(pool.Acquire("key").has_value());
+  SessionResources resources = CreateResources();
+  resources.affix_token_ids.prefix = {1, 2};
+  pool.Release("key", std::move(resources));
+  EXPECT_EQ(pool.GetNumIdle(), 1);
+
+  EXPECT_FALSE(pool.Acquire("other_key").has_value());
+  std::optional<SessionResources> acquired = pool.Acquire("key");
+  ASSERT_TRUE(acquired.has_value());
+  EXPECT_EQ(acquired->affix_token_ids.prefix, std::vector<int>({1, 2}));
+  EXPECT_EQ(pool.GetNumIdle(), 0);
+}
+
+TEST(SessionResourcePoolTest, KeepsAtMostMaxNumIdlePerKey) {
+  SessionResourcePool pool(/*max_num_idle_per_key=*/2);
+  for (int i = 0; i < 3; ++i) {
+    pool.Release("key", CreateResources());
+  }
+  pool.Release("other_key", CreateResources());
+  EXPECT_EQ(pool.GetNumIdle(), 3);
+}
+
+}  // namespace
+}  // namespace litert::lm
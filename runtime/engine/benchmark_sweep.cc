@@ -0,0 +1,461 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/engine/benchmark_sweep.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_format.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/strings/str_replace.h"  // from @com_google_absl
+#include "absl/strings/str_split.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/json_value.h"
+#include "runtime/engine/engine.h"
+#include "runtime/engine/engine_settings.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// The tokens per second over all the turns of a kind.
+template <typename GetTurn>
+double GetTokensPerSec(uint64_t num_turns, GetTurn get_turn) {
+  uint64_t num_tokens = 0;
+  absl::Duration duration;
+  for (uint64_t i = 0; i < num_turns; ++i) {
+    num_tokens += get_turn(i).num_tokens;
+    duration += get_turn(i).duration;
+  }
+  const double seconds = absl::ToDoubleSeconds(duration);
+  return seconds > 0.0 ? num_tokens / seconds : 0.0;
+}
+
+std::string FormatMilliseconds(absl::Duration duration) {
+  return absl::StrFormat("%.3f", absl::ToDoubleMilliseconds(duration));
+}
+
+// A column of a result, named as in the CSV header and the JSON objects, and
+// formatted as a JSON number unless `is_string`.
+struct Column {
+  std::string name;
+  std::string value;
+  bool is_string = false;
+};
+
+std::vector<Column> GetColumns(const BenchmarkSweepResult& result) {
+  return {
+      {"num_prefill_tokens", absl::StrCat(result.num_prefill_tokens)},
+      {"num_decode_tokens", absl::StrCat(result.num_decode_tokens)},
+      {"num_iterations", absl::StrCat(result.num_iterations)},
+      {"prefill_tokens_per_sec",
+       absl::StrFormat("%.2f", result.prefill_tokens_per_sec)},
+      {"decode_tokens_per_sec",
+       absl::StrFormat("%.2f", result.decode_tokens_per_sec)},
+      {"time_to_first_token_ms",
+       FormatMilliseconds(result.time_to_first_token)},
+      {"decode_step_p50_ms", FormatMilliseconds(result.decode_step_p50)},
+      {"decode_step_p99_ms", FormatMilliseconds(result.decode_step_p99)},
+  };
+}
+
+std::vector<Column> GetColumns(const ContextScalingResult& result) {
+  return {
+      {"context_depth", absl::StrCat(result.context_depth)},
+      {"num_prefill_tokens", absl::StrCat(result.num_prefill_tokens)},
+      {"num_decode_tokens", absl::StrCat(result.num_decode_tokens)},
+      {"prefill_latency_ms", FormatMilliseconds(result.prefill_latency)},
+      {"prefill_tokens_per_sec",
+       absl::StrFormat("%.2f", result.prefill_tokens_per_sec)},
+      {"decode_tokens_per_sec",
+       absl::StrFormat("%.2f", result.decode_tokens_per_sec)},
+      {"decode_step_ms", FormatMilliseconds(result.decode_step_latency)},
+  };
+}
+
+absl::string_view GetCacheStateName(StartupCacheState cache_state) {
+  switch (cache_state) {
+    case StartupCacheState::kCold:
+      return "cold";
+    case StartupCacheState::kWarmFile:
+      return "warm_file";
+    case StartupCacheState::kWarmCache:
+      return "warm_cache";
+  }
+  return "unknown";
+}
+
+std::vector<Column> GetColumns(const StartupBenchmarkResult& result) {
+  return {
+      {"cache_state", std::string(GetCacheStateName(result.cache_state)),
+       /*is_string=*/true},
+      {"num_iterations", absl::StrCat(result.num_iterations)},
+      {"create_engine_p50_ms", FormatMilliseconds(result.create_engine_p50)},
+      {"create_engine_p90_ms", FormatMilliseconds(result.create_engine_p90)},
+      {"create_session_p50_ms", FormatMilliseconds(result.create_session_p50)},
+      {"create_session_p90_ms", FormatMilliseconds(result.create_session_p90)},
+      {"time_to_first_token_p50_ms",
+       FormatMilliseconds(result.time_to_first_token_p50)},
+      {"time_to_first_token_p90_ms",
+       FormatMilliseconds(result.time_to_first_token_p90)},
+      {"total_p50_ms", FormatMilliseconds(result.total_p50)},
+      {"total_p90_ms", FormatMilliseconds(result.total_p90)},
+  };
+}
+
+// Returns the nearest-rank `percentile` of `durations`.
+absl::Duration GetPercentile(std::vector<absl::Duration> durations,
+                             int percentile) {
+  if (durations.empty()) {
+    return absl::ZeroDuration();
+  }
+  std::sort(durations.begin(), durations.end());
+  const size_t rank = (durations.size() * percentile + 99) / 100;
+  return durations[std::max<size_t>(rank, 1) - 1];
+}
+
+// Quotes a CSV field if needed.
+std::string CsvField(absl::string_view field) {
+  if (field.find_first_of(",\"\n") == absl::string_view::npos) {
+    return std::string(field);
+  }
+  return absl::StrCat("\"", absl::StrReplaceAll(field, {{"\"", "\"\""}}),
+                      "\"");
+}
+
+JsonValue JsonString(absl::string_view text) {
+  JsonValue value;
+  value.type = JsonValue::Type::kString;
+  value.text = std::string(text);
+  return value;
+}
+
+JsonValue JsonNumber(std::string text) {
+  JsonValue value;
+  value.type = JsonValue::Type::kNumber;
+  value.text = std::move(text);
+  return value;
+}
+
+// Formats the results of either benchmark, see GetColumns().
+template <typename Result>
+std::string FormatCsv(const BenchmarkSweepSettings& settings,
+                      absl::Span<const Result> results) {
+  std::vector<std::string> header;
+  for (const auto& [name, value] : settings) {
+    header.push_back(CsvField(name));
+  }
+  for (const Column& column : GetColumns(Result())) {
+    header.push_back(column.name);
+  }
+  std::string csv = absl::StrCat(absl::StrJoin(header, ","), "\n");
+  for (const Result& result : results) {
+    std::vector<std::string> fields;
+    for (const auto& [name, value] : settings) {
+      fields.push_back(CsvField(value));
+    }
+    for (Column& column : GetColumns(result)) {
+      fields.push_back(std::move(column.value));
+    }
+    absl::StrAppend(&csv, absl::StrJoin(fields, ","), "\n");
+  }
+  return csv;
+}
+
+template <typename Result>
+std::string FormatJson(const BenchmarkSweepSettings& settings,
+                       absl::Span<const Result> results) {
+  JsonValue json;
+  json.type = JsonValue::Type::kObject;
+  JsonValue settings_json;
+  settings_json.type = JsonValue::Type::kObject;
+  for (const auto& [name, value] : settings) {
+    settings_json.members.emplace_back(name, JsonString(value));
+  }
+  JsonValue results_json;
+  results_json.type = JsonValue::Type::kArray;
+  for (const Result& result : results) {
+    JsonValue result_json;
+    result_json.type = JsonValue::Type::kObject;
+    for (Column& column : GetColumns(result)) {
+      result_json.members.emplace_back(
+          column.name, column.is_string ? JsonString(column.value)
+                                        : JsonNumber(std::move(column.value)));
+    }
+    results_json.items.push_back(std::move(result_json));
+  }
+  json.members.emplace_back("settings", std::move(settings_json));
+  json.members.emplace_back("results", std::move(results_json));
+  return SerializeJson(json);
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<int>> ParseTokenCounts(absl::string_view counts) {
+  std::vector<int> token_counts;
+  for (absl::string_view count : absl::StrSplit(counts, ',')) {
+    count = absl::StripAsciiWhitespace(count);
+    int multiplier = 1;
+    if (absl::ConsumeSuffix(&count, "k") || absl::ConsumeSuffix(&count, "K")) {
+      multiplier = 1024;
+    }
+    int value;
+    if (!absl::SimpleAtoi(count, &value) || value <= 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid token counts: ", counts));
+    }
+    token_counts.push_back(value * multiplier);
+  }
+  return token_counts;
+}
+
+absl::StatusOr<std::vector<BenchmarkSweepResult>> RunBenchmarkSweep(
+    Engine& engine, const SessionConfig& session_config,
+    absl::string_view prompt, const BenchmarkSweepOptions& options) {
+  if (options.num_prefill_tokens.empty() ||
+      options.num_decode_tokens.empty() || options.num_iterations <= 0 ||
+      options.num_warmup_iterations < 0) {
+    return absl::InvalidArgumentError(
+        "The sweep needs prefill and decode token counts, and a positive "
+        "number of iterations.");
+  }
+  const int num_runs = options.num_warmup_iterations + options.num_iterations;
+  std::vector<BenchmarkSweepResult> results;
+  for (int num_prefill_tokens : options.num_prefill_tokens) {
+    for (int num_decode_tokens : options.num_decode_tokens) {
+      SessionConfig config = session_config;
+      config.GetMutableBenchmarkParams().set_num_prefill_tokens(
+          num_prefill_tokens);
+      config.GetMutableBenchmarkParams().set_num_decode_tokens(
+          num_decode_tokens);
+      BenchmarkSweepResult result;
+      result.num_prefill_tokens = num_prefill_tokens;
+      result.num_decode_tokens = num_decode_tokens;
+      result.num_iterations = options.num_iterations;
+      for (int i = 0; i < num_runs; ++i) {
+        ASSIGN_OR_RETURN(std::unique_ptr<Engine::Session> session,
+                         engine.CreateSession(config));
+        RETURN_IF_ERROR(
+            session->GenerateContent({InputText(prompt)}).status());
+        if (i < options.num_warmup_iterations) {
+          continue;
+        }
+        ASSIGN_OR_RETURN(BenchmarkInfo info, session->GetBenchmarkInfo());
+        result.prefill_tokens_per_sec +=
+            GetTokensPerSec(info.GetTotalPrefillTurns(), [&](uint64_t turn) {
+              return info.GetPrefillTurn(turn);
+            });
+        result.decode_tokens_per_sec +=
+            GetTokensPerSec(info.GetTotalDecodeTurns(), [&](uint64_t turn) {
+              return info.GetDecodeTurn(turn);
+            });
+        result.time_to_first_token += info.GetTimeToFirstTokens().GetMax();
+        result.decode_step_p50 +=
+            info.GetDecodeStepLatencies().GetPercentile(50);
+        result.decode_step_p99 +=
+            info.GetDecodeStepLatencies().GetPercentile(99);
+      }
+      result.prefill_tokens_per_sec /= options.num_iterations;
+      result.decode_tokens_per_sec /= options.num_iterations;
+      result.time_to_first_token /= options.num_iterations;
+      result.decode_step_p50 /= options.num_iterations;
+      result.decode_step_p99 /= options.num_iterations;
+      results.push_back(result);
+    }
+  }
+  return results;
+}
+
+absl::StatusOr<std::vector<ContextScalingResult>> RunContextScalingBenchmark(
+    Engine& engine, const SessionConfig& session_config,
+    absl::string_view prompt, const ContextScalingOptions& options) {
+  if (options.num_step_tokens <= 0 || options.num_decode_tokens <= 0 ||
+      options.max_num_tokens <
+          options.num_step_tokens + options.num_decode_tokens) {
+    return absl::InvalidArgumentError(
+        "The context scaling benchmark needs positive step and decode token "
+        "counts, and a context of at least one step.");
+  }
+  SessionConfig config = session_config;
+  config.GetMutableBenchmarkParams().set_num_prefill_tokens(
+      options.num_step_tokens);
+  config.GetMutableBenchmarkParams().set_num_decode_tokens(
+      options.num_decode_tokens);
+  ASSIGN_OR_RETURN(std::unique_ptr<Engine::Session> session,
+                   engine.CreateSession(config));
+  std::vector<ContextScalingResult> results;
+  int context_depth = 0;
+  while (true) {
+    // The session knows the depth exactly, e.g. with the last decoded token
+    // yet to be prefilled, if it supports it.
+    if (absl::StatusOr<int> current_step = session->GetCurrentStep();
+        current_step.ok()) {
+      context_depth = *current_step;
+    }
+    if (context_depth + options.num_step_tokens + options.num_decode_tokens >
+        options.max_num_tokens) {
+      break;
+    }
+    // Each step extends the kv-cache of the previous ones.
+    RETURN_IF_ERROR(session->RunPrefill({InputText(prompt)}));
+    RETURN_IF_ERROR(session->RunDecode().status());
+    ASSIGN_OR_RETURN(BenchmarkInfo info, session->GetBenchmarkInfo());
+    if (info.GetTotalPrefillTurns() == 0 || info.GetTotalDecodeTurns() == 0) {
+      return absl::InternalError("The step recorded no benchmark turn.");
+    }
+    const BenchmarkTurnData& prefill =
+        info.GetPrefillTurn(info.GetTotalPrefillTurns() - 1);
+    const BenchmarkTurnData& decode =
+        info.GetDecodeTurn(info.GetTotalDecodeTurns() - 1);
+    if (prefill.num_tokens == 0) {
+      return absl::InternalError("The step prefilled no token.");
+    }
+    ContextScalingResult result;
+    result.context_depth = context_depth;
+    result.num_prefill_tokens = prefill.num_tokens;
+    result.num_decode_tokens = decode.num_tokens;
+    result.prefill_latency = prefill.duration;
+    result.prefill_tokens_per_sec =
+        GetTokensPerSec(1, [&](uint64_t) { return prefill; });
+    result.decode_tokens_per_sec =
+        GetTokensPerSec(1, [&](uint64_t) { return decode; });
+    if (decode.num_tokens > 0) {
+      result.decode_step_latency =
+          decode.duration / static_cast<int64_t>(decode.num_tokens);
+    }
+    results.push_back(result);
+    context_depth += prefill.num_tokens + decode.num_tokens;
+  }
+  return results;
+}
+
+absl::StatusOr<std::vector<StartupBenchmarkResult>> RunStartupBenchmark(
+    const SessionConfig& session_config, absl::string_view prompt,
+    StartupBenchmarkOptions options) {
+  if (options.num_iterations <= 0 || !options.prepare_caches ||
+      !options.create_engine) {
+    return absl::InvalidArgumentError(
+        "The startup benchmark needs a positive number of iterations, and the "
+        "callbacks preparing the caches and creating the engine.");
+  }
+  constexpr StartupCacheState kCacheStates[] = {StartupCacheState::kCold,
+                                                StartupCacheState::kWarmFile,
+                                                StartupCacheState::kWarmCache};
+  struct Startups {
+    std::vector<absl::Duration> create_engine;
+    std::vector<absl::Duration> create_session;
+    std::vector<absl::Duration> time_to_first_token;
+    std::vector<absl::Duration> total;
+  };
+  Startups startups[std::size(kCacheStates)];
+  for (int i = 0; i < options.num_iterations; ++i) {
+    for (size_t state = 0; state < std::size(kCacheStates); ++state) {
+      RETURN_IF_ERROR(options.prepare_caches(kCacheStates[state]));
+      const absl::Time start = absl::Now();
+      ASSIGN_OR_RETURN(std::unique_ptr<Engine> engine,
+                       options.create_engine());
+      const absl::Time engine_created = absl::Now();
+      ASSIGN_OR_RETURN(std::unique_ptr<Engine::Session> session,
+                       engine->CreateSession(session_config));
+      const absl::Time session_created = absl::Now();
+      RETURN_IF_ERROR(session->GenerateContent({InputText(prompt)}).status());
+      ASSIGN_OR_RETURN(BenchmarkInfo info, session->GetBenchmarkInfo());
+      const absl::Duration time_to_first_token =
+          info.GetTimeToFirstTokens().GetMax();
+      startups[state].create_engine.push_back(engine_created - start);
+      startups[state].create_session.push_back(session_created -
+                                               engine_created);
+      startups[state].time_to_first_token.push_back(time_to_first_token);
+      startups[state].total.push_back(session_created - start +
+                                      time_to_first_token);
+    }
+  }
+  std::vector<StartupBenchmarkResult> results;
+  for (size_t state = 0; state < std::size(kCacheStates); ++state) {
+    const Startups& state_startups = startups[state];
+    StartupBenchmarkResult result;
+    result.cache_state = kCacheStates[state];
+    result.num_iterations = options.num_iterations;
+    result.create_engine_p50 = GetPercentile(state_startups.create_engine, 50);
+    result.create_engine_p90 = GetPercentile(state_startups.create_engine, 90);
+    result.create_session_p50 =
+        GetPercentile(state_startups.create_session, 50);
+    result.create_session_p90 =
+        GetPercentile(state_startups.create_session, 90);
+    result.time_to_first_token_p50 =
+        GetPercentile(state_startups.time_to_first_token, 50);
+    result.time_to_first_token_p90 =
+        GetPercentile(state_startups.time_to_first_token, 90);
+    result.total_p50 = GetPercentile(state_startups.total, 50);
+    result.total_p90 = GetPercentile(state_startups.total, 90);
+    results.push_back(result);
+  }
+  return results;
+}
+
+std::string FormatBenchmarkSweepCsv(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const BenchmarkSweepResult> results) {
+  return FormatCsv(settings, results);
+}
+
+std::string FormatBenchmarkSweepJson(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const BenchmarkSweepResult> results) {
+  return FormatJson(settings, results);
+}
+
+std::string FormatContextScalingCsv(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const ContextScalingResult> results) {
+  return FormatCsv(settings, results);
+}
+
+std::string FormatContextScalingJson(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const ContextScalingResult> results) {
+  return FormatJson(settings, results);
+}
+
+std::string FormatStartupBenchmarkCsv(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const StartupBenchmarkResult> results) {
+  return FormatCsv(settings, results);
+}
+
+std::string FormatStartupBenchmarkJson(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const StartupBenchmarkResult> results) {
+  return FormatJson(settings, results);
+}
+
+}  // namespace litert::lm
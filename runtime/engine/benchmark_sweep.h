@@ -0,0 +1,183 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_BENCHMARK_SWEEP_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_BENCHMARK_SWEEP_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/engine/engine.h"
+#include "runtime/engine/engine_settings.h"
+
+namespace litert::lm {
+
+// Parses a comma separated list of token counts, with an optional "k" suffix
+// for the multiples of 1024, e.g. "128,512,1k,4k".
+absl::StatusOr<std::vector<int>> ParseTokenCounts(absl::string_view counts);
+
+struct BenchmarkSweepOptions {
+  // The numbers of prefill and decode tokens of the points of the sweep, all
+  // their combinations being benchmarked.
+  std::vector<int> num_prefill_tokens;
+  std::vector<int> num_decode_tokens;
+  // The runs of each point before the timed ones, e.g. to warm up the caches
+  // and the clocks.
+  int num_warmup_iterations = 1;
+  // The timed runs of each point, whose results are averaged.
+  int num_iterations = 3;
+};
+
+// The results of a point of the sweep, averaged over its timed runs.
+struct BenchmarkSweepResult {
+  int num_prefill_tokens = 0;
+  int num_decode_tokens = 0;
+  int num_iterations = 0;
+  double prefill_tokens_per_sec = 0.0;
+  double decode_tokens_per_sec = 0.0;
+  absl::Duration time_to_first_token;
+  absl::Duration decode_step_p50;
+  absl::Duration decode_step_p99;
+};
+
+// Benchmarks each point of the sweep on `engine`, whose benchmark must be
+// enabled. Each run prefills `prompt`, resized to the prefill tokens of the
+// point, and decodes on a new session, whose destruction resets the executor
+// for the next run.
+absl::StatusOr<std::vector<BenchmarkSweepResult>> RunBenchmarkSweep(
+    Engine& engine, const SessionConfig& session_config,
+    absl::string_view prompt, const BenchmarkSweepOptions& options);
+
+// The settings the sweep ran with, e.g. {"backend", "cpu"}, written along the
+// results.
+using BenchmarkSweepSettings = std::vector<std::pair<std::string, std::string>>;
+
+struct ContextScalingOptions {
+  // The prefill tokens of each step, after which the decode is timed.
+  int num_step_tokens = 512;
+  // The decode tokens of each step.
+  int num_decode_tokens = 32;
+  // The context the steps fill, e.g. the max_num_tokens of the executor.
+  int max_num_tokens = 0;
+};
+
+// The results of a step of the context scaling benchmark.
+struct ContextScalingResult {
+  // The tokens in the kv-cache before the prefill of the step.
+  int context_depth = 0;
+  int num_prefill_tokens = 0;
+  int num_decode_tokens = 0;
+  absl::Duration prefill_latency;
+  double prefill_tokens_per_sec = 0.0;
+  double decode_tokens_per_sec = 0.0;
+  // The mean latency of the decode steps.
+  absl::Duration decode_step_latency;
+};
+
+// Benchmarks the prefill and the decode at successive context depths on one
+// session of `engine`, whose benchmark must be enabled. Each step prefills
+// `prompt`, resized to the step tokens, after the kv-cache of the previous
+// steps, and decodes, until the next step would not fit in the context.
+absl::StatusOr<std::vector<ContextScalingResult>> RunContextScalingBenchmark(
+    Engine& engine, const SessionConfig& session_config,
+    absl::string_view prompt, const ContextScalingOptions& options);
+
+// The state of the caches a startup of the startup benchmark runs from.
+enum class StartupCacheState {
+  // Neither the model file is in the page cache nor the weight cache exists.
+  kCold,
+  // The model file is in the page cache, but the weight cache does not exist.
+  kWarmFile,
+  // Both the model file is in the page cache and the weight cache exists.
+  kWarmCache,
+};
+
+struct StartupBenchmarkOptions {
+  // The timed startups from each cache state.
+  int num_iterations = 3;
+  // Brings the caches to the state before a startup, untimed, e.g. evicts the
+  // model file from the page cache and points the weight cache to an empty
+  // directory for kCold. The startups of an iteration run from kCold, then
+  // kWarmFile and kWarmCache, such that kWarmCache gets the files and the
+  // weight cache of the two first.
+  absl::AnyInvocable<absl::Status(StartupCacheState)> prepare_caches;
+  // Creates the engine of a startup, timed, with its benchmark enabled.
+  absl::AnyInvocable<absl::StatusOr<std::unique_ptr<Engine>>()> create_engine;
+};
+
+// The percentiles of the startups from a cache state.
+struct StartupBenchmarkResult {
+  StartupCacheState cache_state = StartupCacheState::kCold;
+  int num_iterations = 0;
+  absl::Duration create_engine_p50;
+  absl::Duration create_engine_p90;
+  absl::Duration create_session_p50;
+  absl::Duration create_session_p90;
+  absl::Duration time_to_first_token_p50;
+  absl::Duration time_to_first_token_p90;
+  // The time from the creation of the engine to the first token.
+  absl::Duration total_p50;
+  absl::Duration total_p90;
+};
+
+// Benchmarks the startup of an engine from each cache state, timing its
+// creation, the creation of its first session, and the first token of
+// `prompt` on it. Each startup destroys its engine before the next one.
+// Returns the results of kCold, kWarmFile and kWarmCache, in that order.
+absl::StatusOr<std::vector<StartupBenchmarkResult>> RunStartupBenchmark(
+    const SessionConfig& session_config, absl::string_view prompt,
+    StartupBenchmarkOptions options);
+
+// Formats the results as CSV, with a header line, one column per setting and
+// one line per point.
+std::string FormatBenchmarkSweepCsv(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const BenchmarkSweepResult> results);
+
+// Formats the results as a JSON object, with the "settings" object and the
+// "results" array of one object per point.
+std::string FormatBenchmarkSweepJson(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const BenchmarkSweepResult> results);
+
+// Formats the results of the context scaling benchmark as the ones of the
+// sweep, with one line or object per step.
+std::string FormatContextScalingCsv(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const ContextScalingResult> results);
+std::string FormatContextScalingJson(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const ContextScalingResult> results);
+
+// Formats the results of the startup benchmark as the ones of the sweep, with
+// one line or object per cache state.
+std::string FormatStartupBenchmarkCsv(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const StartupBenchmarkResult> results);
+std::string FormatStartupBenchmarkJson(
+    const BenchmarkSweepSettings& settings,
+    absl::Span<const StartupBenchmarkResult> results);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_BENCHMARK_SWEEP_H_
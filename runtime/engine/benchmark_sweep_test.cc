@@ -0,0 +1,259 @@
+#include "runtime/engine/benchmark_sweep.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/engine.h"
+#include "runtime/engine/engine_settings.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/proto/engine.pb.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::HasSubstr;
+using ::testing::status::IsOkAndHolds;
+using ::testing::status::StatusIs;
+
+// Records one prefill and one decode turn of the benchmark parameters of its
+// config.
+class FakeSession : public Engine::Session {
+ public:
+  explicit FakeSession(const proto::BenchmarkParams& benchmark_params)
+      : benchmark_info_(benchmark_params) {}
+
+  absl::StatusOr<Responses> GenerateContent(
+      const std::vector<InputData>& contents) override {
+    RETURN_IF_ERROR(RunPrefill(contents));
+    return RunDecode();
+  }
+
+  absl::Status GenerateContentStream(const std::vector<InputData>& contents,
+                                     InferenceObservable* observer) override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  absl::Status RunPrefill(const std::vector<InputData>& contents) override {
+    const auto& params = benchmark_info_.GetBenchmarkParams();
+    RETURN_IF_ERROR(benchmark_info_.TimePrefillTurnStart());
+    return benchmark_info_.TimePrefillTurnEnd(params.num_prefill_tokens());
+  }
+
+  absl::StatusOr<Responses> RunDecode() override {
+    const auto& params = benchmark_info_.GetBenchmarkParams();
+    RETURN_IF_ERROR(benchmark_info_.TimeDecodeTurnStart());
+    for (int i = 0; i < params.num_decode_tokens(); ++i) {
+      RETURN_IF_ERROR(benchmark_info_.TimeDecodeStep());
+    }
+    RETURN_IF_ERROR(
+        benchmark_info_.TimeDecodeTurnEnd(params.num_decode_tokens()));
+    return Responses(/*num_output_candidates=*/1);
+  }
+
+  absl::StatusOr<BenchmarkInfo> GetBenchmarkInfo() override {
+    return benchmark_info_;
+  }
+
+ private:
+  BenchmarkInfo benchmark_info_;
+};
+
+class FakeEngine : public Engine {
+ public:
+  absl::StatusOr<std::unique_ptr<Session>> CreateSession(
+      const SessionConfig& session_config) const override {
+    ++num_sessions_;
+    return std::make_unique<FakeSession>(
+        session_config.GetBenchmarkParams().value_or(proto::BenchmarkParams()));
+  }
+
+  int num_sessions() const { return num_sessions_; }
+
+ private:
+  mutable int num_sessions_ = 0;
+};
+
+TEST(BenchmarkSweepTest, ParsesTokenCounts) {
+  EXPECT_THAT(ParseTokenCounts("128, 512,1k,4K"),
+              IsOkAndHolds(std::vector<int>({128, 512, 1024, 4096})));
+  EXPECT_THAT(ParseTokenCounts("128,,4k"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseTokenCounts("-1"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(BenchmarkSweepTest, RunsEachPoint) {
+  FakeEngine engine;
+  BenchmarkSweepOptions options;
+  options.num_prefill_tokens = {128, 512};
+  options.num_decode_tokens = {32, 256};
+  options.num_warmup_iterations = 1;
+  options.num_iterations = 2;
+  auto results = RunBenchmarkSweep(engine, SessionConfig::CreateDefault(),
+                                   "Hello", options);
+  ASSERT_OK(results);
+  ASSERT_EQ(results->size(), 4);
+  EXPECT_EQ(engine.num_sessions(), 4 * 3);
+  std::vector<std::pair<int, int>> points;
+  for (const BenchmarkSweepResult& result : *results) {
+    points.emplace_back(result.num_prefill_tokens, result.num_decode_tokens);
+    EXPECT_EQ(result.num_iterations, 2);
+  }
+  EXPECT_THAT(points, ElementsAre(std::pair(128, 32), std::pair(128, 256),
+                                  std::pair(512, 32), std::pair(512, 256)));
+}
+
+TEST(BenchmarkSweepTest, RejectsAnEmptySweep) {
+  FakeEngine engine;
+  BenchmarkSweepOptions options;
+  options.num_prefill_tokens = {128};
+  EXPECT_THAT(RunBenchmarkSweep(engine, SessionConfig::CreateDefault(),
+                                "Hello", options),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(BenchmarkSweepTest, RunsTheContextScalingOnOneSession) {
+  FakeEngine engine;
+  ContextScalingOptions options;
+  options.num_step_tokens = 512;
+  options.num_decode_tokens = 32;
+  options.max_num_tokens = 2048;
+  auto results = RunContextScalingBenchmark(
+      engine, SessionConfig::CreateDefault(), "Hello", options);
+  ASSERT_OK(results);
+  EXPECT_EQ(engine.num_sessions(), 1);
+  std::vector<int> context_depths;
+  for (const ContextScalingResult& result : *results) {
+    context_depths.push_back(result.context_depth);
+    EXPECT_EQ(result.num_prefill_tokens, 512);
+    EXPECT_EQ(result.num_decode_tokens, 32);
+  }
+  // The fourth step would end past the context.
+  EXPECT_THAT(context_depths, ElementsAre(0, 544, 1088));
+
+  options.max_num_tokens = 512;
+  EXPECT_THAT(RunContextScalingBenchmark(
+                  engine, SessionConfig::CreateDefault(), "Hello", options),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(BenchmarkSweepTest, RunsTheStartupsFromEachCacheState) {
+  std::vector<StartupCacheState> prepared_states;
+  int num_engines = 0;
+  StartupBenchmarkOptions options;
+  options.num_iterations = 2;
+  options.prepare_caches = [&](StartupCacheState cache_state) {
+    prepared_states.push_back(cache_state);
+    return absl::OkStatus();
+  };
+  options.create_engine = [&]() -> absl::StatusOr<std::unique_ptr<Engine>> {
+    ++num_engines;
+    return std::make_unique<FakeEngine>();
+  };
+  auto results = RunStartupBenchmark(SessionConfig::CreateDefault(), "Hello",
+                                     std::move(options));
+  ASSERT_OK(results);
+  EXPECT_EQ(num_engines, 6);
+  EXPECT_THAT(prepared_states,
+              ElementsAre(StartupCacheState::kCold,
+                          StartupCacheState::kWarmFile,
+                          StartupCacheState::kWarmCache,
+                          StartupCacheState::kCold,
+                          StartupCacheState::kWarmFile,
+                          StartupCacheState::kWarmCache));
+  std::vector<StartupCacheState> result_states;
+  for (const StartupBenchmarkResult& result : *results) {
+    result_states.push_back(result.cache_state);
+    EXPECT_EQ(result.num_iterations, 2);
+    EXPECT_GE(result.total_p90, result.total_p50);
+  }
+  EXPECT_THAT(result_states, ElementsAre(StartupCacheState::kCold,
+                                         StartupCacheState::kWarmFile,
+                                         StartupCacheState::kWarmCache));
+
+  EXPECT_THAT(RunStartupBenchmark(SessionConfig::CreateDefault(), "Hello",
+                                  StartupBenchmarkOptions()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(BenchmarkSweepTest, FormatsTheResults) {
+  BenchmarkSweepResult result;
+  result.num_prefill_tokens = 128;
+  result.num_decode_tokens = 32;
+  result.num_iterations = 3;
+  result.prefill_tokens_per_sec = 1000.0;
+  result.decode_tokens_per_sec = 50.0;
+  result.time_to_first_token = absl::Milliseconds(150);
+  result.decode_step_p50 = absl::Milliseconds(20);
+  result.decode_step_p99 = absl::Milliseconds(25);
+  const BenchmarkSweepSettings settings = {{"backend", "cpu"},
+                                           {"model", "a,b"}};
+
+  EXPECT_EQ(FormatBenchmarkSweepCsv(settings, {result}),
+            "backend,model,num_prefill_tokens,num_decode_tokens,"
+            "num_iterations,prefill_tokens_per_sec,decode_tokens_per_sec,"
+            "time_to_first_token_ms,decode_step_p50_ms,decode_step_p99_ms\n"
+            "cpu,\"a,b\",128,32,3,1000.00,50.00,150.000,20.000,25.000\n");
+  EXPECT_THAT(
+      FormatBenchmarkSweepJson(settings, {result}),
+      HasSubstr(R"({"settings":{"backend":"cpu","model":"a,b"},"results":[)"
+                R"({"num_prefill_tokens":128,"num_decode_tokens":32,)"));
+}
+
+TEST(BenchmarkSweepTest, FormatsTheContextScalingResults) {
+  ContextScalingResult result;
+  result.context_depth = 544;
+  result.num_prefill_tokens = 512;
+  result.num_decode_tokens = 32;
+  result.prefill_latency = absl::Milliseconds(500);
+  result.prefill_tokens_per_sec = 1024.0;
+  result.decode_tokens_per_sec = 40.0;
+  result.decode_step_latency = absl::Milliseconds(25);
+  const BenchmarkSweepSettings settings = {{"backend", "cpu"}};
+
+  EXPECT_EQ(FormatContextScalingCsv(settings, {result}),
+            "backend,context_depth,num_prefill_tokens,num_decode_tokens,"
+            "prefill_latency_ms,prefill_tokens_per_sec,decode_tokens_per_sec,"
+            "decode_step_ms\n"
+            "cpu,544,512,32,500.000,1024.00,40.00,25.000\n");
+  EXPECT_THAT(FormatContextScalingJson(settings, {result}),
+              HasSubstr(R"("results":[{"context_depth":544,)"));
+}
+
+TEST(BenchmarkSweepTest, FormatsTheStartupResults) {
+  StartupBenchmarkResult result;
+  result.cache_state = StartupCacheState::kWarmFile;
+  result.num_iterations = 5;
+  result.create_engine_p50 = absl::Milliseconds(800);
+  result.create_engine_p90 = absl::Milliseconds(900);
+  result.create_session_p50 = absl::Milliseconds(20);
+  result.create_session_p90 = absl::Milliseconds(30);
+  result.time_to_first_token_p50 = absl::Milliseconds(100);
+  result.time_to_first_token_p90 = absl::Milliseconds(120);
+  result.total_p50 = absl::Milliseconds(920);
+  result.total_p90 = absl::Milliseconds(1050);
+  const BenchmarkSweepSettings settings = {{"backend", "gpu"}};
+
+  EXPECT_EQ(FormatStartupBenchmarkCsv(settings, {result}),
+            "backend,cache_state,num_iterations,create_engine_p50_ms,"
+            "create_engine_p90_ms,create_session_p50_ms,"
+            "create_session_p90_ms,time_to_first_token_p50_ms,"
+            "time_to_first_token_p90_ms,total_p50_ms,total_p90_ms\n"
+            "gpu,warm_file,5,800.000,900.000,20.000,30.000,100.000,120.000,"
+            "920.000,1050.000\n");
+  EXPECT_THAT(FormatStartupBenchmarkJson(settings, {result}),
+              HasSubstr(R"("results":[{"cache_state":"warm_file",)"
+                        R"("num_iterations":5,)"));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,209 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/engine/delivery_thread.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/io_types.h"
+#include "runtime/framework/threadpool.h"
+
+namespace litert::lm {
+
+// Queues the calls made to it for the observer it wraps.
+class DeliveryThread::QueuedObservable : public InferenceObservable {
+ public:
+  QueuedObservable(DeliveryThread& delivery_thread,
+                   InferenceObservable& observer)
+      : delivery_thread_(delivery_thread), observer_(observer) {}
+
+  void OnNext(const Responses& responses) override {
+    delivery_thread_.Push(Call{.type = Call::Type::kNext,
+                               .observer = &observer_,
+                               .responses = responses});
+  }
+
+  void OnNextText(int candidate_index, absl::string_view text) override {
+    delivery_thread_.Push(Call{.type = Call::Type::kNextText,
+                               .observer = &observer_,
+                               .candidate_index = candidate_index,
+                               .text = std::string(text)});
+  }
+
+  void OnCandidateDone(int candidate_index) override {
+    delivery_thread_.Push(Call{.type = Call::Type::kCandidateDone,
+                               .observer = &observer_,
+                               .candidate_index = candidate_index});
+  }
+
+  void OnDone() override {
+    delivery_thread_.Push(
+        Call{.type = Call::Type::kDone, .observer = &observer_});
+  }
+
+  void OnError(const absl::Status& status) override {
+    delivery_thread_.Push(Call{
+        .type = Call::Type::kError, .observer = &observer_, .status = status});
+  }
+
+ private:
+  DeliveryThread& delivery_thread_;
+  InferenceObservable& observer_;
+};
+
+DeliveryThread::DeliveryThread(const DeliveryOptions& options)
+    : options_(options), thread_("delivery", /*max_num_threads=*/1) {}
+
+DeliveryThread::~DeliveryThread() {
+  absl::Status status = WaitUntilDelivered(absl::InfiniteDuration());
+  if (!status.ok()) {
+    ABSL_LOG(ERROR) << "Failed to deliver the queued calls: " << status;
+  }
+}
+
+std::unique_ptr<InferenceObservable> DeliveryThread::Wrap(
+    InferenceObservable* observer) {
+  return std::make_unique<QueuedObservable>(*this, *observer);
+}
+
+absl::Status DeliveryThread::WaitUntilDelivered(absl::Duration timeout) {
+  absl::MutexLock lock(&mutex_);
+  auto is_delivered = [this]() {
+    mutex_.AssertHeld();
+    return !draining_;
+  };
+  if (!mutex_.AwaitWithTimeout(absl::Condition(&is_delivered), timeout)) {
+    return absl::DeadlineExceededError(
+        "Timeout waiting for the queued calls to be delivered.");
+  }
+  return absl::OkStatus();
+}
+
+DeliveryThread::Stats DeliveryThread::GetStats() const {
+  absl::MutexLock lock(&mutex_);
+  return stats_;
+}
+
+void DeliveryThread::Push(Call call) {
+  absl::MutexLock lock(&mutex_);
+  const bool is_text = call.type == Call::Type::kNext ||
+                       call.type == Call::Type::kNextText;
+  if (calls_.size() >= static_cast<size_t>(options_.max_queued_calls)) {
+    if (options_.overflow_policy == DeliveryOverflowPolicy::kBlock) {
+      auto has_room = [this]() {
+        mutex_.AssertHeld();
+        return calls_.size() < static_cast<size_t>(options_.max_queued_calls);
+      };
+      mutex_.Await(absl::Condition(&has_room));
+    } else if (is_text && options_.overflow_policy ==
+                              DeliveryOverflowPolicy::kDropIntermediate) {
+      ++stats_.num_dropped_calls;
+      return;
+    } else if (is_text && CoalesceWithLast(call)) {
+      ++stats_.num_coalesced_calls;
+      return;
+    }
+  }
+  calls_.push_back(std::move(call));
+  if (!draining_) {
+    draining_ = true;
+    absl::Status status = thread_.Schedule([this]() { Drain(); });
+    if (!status.ok()) {
+      ABSL_LOG(ERROR) << "Failed to schedule the delivery: " << status;
+      draining_ = false;
+    }
+  }
+}
+
+bool DeliveryThread::CoalesceWithLast(Call& call) {
+  if (calls_.empty()) {
+    return false;
+  }
+  Call& last = calls_.back();
+  if (last.type != call.type || last.observer != call.observer) {
+    return false;
+  }
+  if (call.type == Call::Type::kNextText) {
+    if (last.candidate_index != call.candidate_index) {
+      return false;
+    }
+    last.text.append(call.text);
+    return true;
+  }
+  // As in CoalescingObservable, the texts and the top log-probabilities are
+  // appended, and the scores are the ones of the last responses.
+  Responses& responses = *last.responses;
+  const Responses& next_responses = *call.responses;
+  const int num_candidates = responses.GetNumOutputCandidates();
+  if (next_responses.GetNumOutputCandidates() != num_candidates) {
+    return false;
+  }
+  for (int i = 0; i < num_candidates; ++i) {
+    const absl::string_view text = *next_responses.GetResponseTextAt(i);
+    responses.GetMutableResponseTexts()[i].append(text.data(), text.size());
+    if (auto top_log_probs = next_responses.GetTopLogProbsAt(i);
+        top_log_probs.ok()) {
+      responses.GetMutableTopLogProbs().resize(num_candidates);
+      std::vector<std::vector<TokenLogProb>>& steps =
+          responses.GetMutableTopLogProbs()[i];
+      steps.insert(steps.end(), top_log_probs->begin(), top_log_probs->end());
+    }
+    if (auto score = next_responses.GetScoreAt(i);
+        score.ok() && i < responses.GetMutableScores().size()) {
+      responses.GetMutableScores()[i] = *score;
+    }
+  }
+  return true;
+}
+
+void DeliveryThread::Drain() {
+  absl::MutexLock lock(&mutex_);
+  while (!calls_.empty()) {
+    Call call = std::move(calls_.front());
+    calls_.pop_front();
+    // The observer is called without the lock, so that the decode keeps
+    // queuing meanwhile.
+    mutex_.Unlock();
+    switch (call.type) {
+      case Call::Type::kNext:
+        call.observer->OnNext(*call.responses);
+        break;
+      case Call::Type::kNextText:
+        call.observer->OnNextText(call.candidate_index, call.text);
+        break;
+      case Call::Type::kCandidateDone:
+        call.observer->OnCandidateDone(call.candidate_index);
+        break;
+      case Call::Type::kDone:
+        call.observer->OnDone();
+        break;
+      case Call::Type::kError:
+        call.observer->OnError(call.status);
+        break;
+    }
+    mutex_.Lock();
+  }
+  draining_ = false;
+}
+
+}  // namespace litert::lm
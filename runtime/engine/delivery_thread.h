@@ -0,0 +1,112 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_DELIVERY_THREAD_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_DELIVERY_THREAD_H_
+
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/io_types.h"
+#include "runtime/framework/threadpool.h"
+
+namespace litert::lm {
+
+// Calls the observers on a thread of its own, such that a slow consumer, e.g.
+// behind JNI or a network connection, does not stall the engine worker thread
+// decoding for all the sessions. The calls made to the observers returned by
+// Wrap() are queued, and made to the wrapped observers in the same order. The
+// queue is bounded, see DeliveryOptions for what happens when it is full.
+//
+// Example usage:
+//
+//   DeliveryThread delivery_thread(DeliveryOptions());
+//   std::unique_ptr<InferenceObservable> queued_observer =
+//       delivery_thread.Wrap(&observer);
+//   RETURN_IF_ERROR(session->RunDecodeAsync(queued_observer.get()));
+class DeliveryThread {
+ public:
+  // The number of streamed responses the overflow policy did not queue on
+  // their own.
+  struct Stats {
+    int num_coalesced_calls = 0;
+    int num_dropped_calls = 0;
+  };
+
+  explicit DeliveryThread(const DeliveryOptions& options);
+
+  // Makes the calls still queued, then joins the thread.
+  ~DeliveryThread();
+
+  // Returns an observer queuing its calls for `observer`. The returned
+  // observer can be destroyed right after its last call, but `observer` must
+  // outlive the delivery of the calls, e.g. until its OnDone() or OnError().
+  std::unique_ptr<InferenceObservable> Wrap(
+      InferenceObservable* absl_nonnull observer);
+
+  // Waits until all the queued calls are made. Returns DeadlineExceededError
+  // if they are not made within `timeout`.
+  absl::Status WaitUntilDelivered(absl::Duration timeout);
+
+  Stats GetStats() const;
+
+ private:
+  class QueuedObservable;
+
+  // A call to an observer.
+  struct Call {
+    enum class Type { kNext, kNextText, kCandidateDone, kDone, kError };
+    Type type;
+    InferenceObservable* absl_nonnull observer;
+    // The responses of kNext.
+    std::optional<Responses> responses;
+    // The candidate of kNextText and kCandidateDone.
+    int candidate_index = 0;
+    // The text of kNextText.
+    std::string text;
+    // The status of kError.
+    absl::Status status;
+  };
+
+  // Queues `call`, applying the overflow policy if the queue is full.
+  void Push(Call call);
+
+  // Appends the text of `call`, a kNext or kNextText call, to the last queued
+  // call if it is of the same kind. Returns false if it is not.
+  bool CoalesceWithLast(Call& call) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Makes the queued calls until the queue is empty. Runs on the thread.
+  void Drain();
+
+  const DeliveryOptions options_;
+  mutable absl::Mutex mutex_;
+  std::deque<Call> calls_ ABSL_GUARDED_BY(mutex_);
+  // Whether Drain() is scheduled or running.
+  bool draining_ ABSL_GUARDED_BY(mutex_) = false;
+  Stats stats_ ABSL_GUARDED_BY(mutex_);
+  // Declared last, so that it joins before the queue is destroyed.
+  ThreadPool thread_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_DELIVERY_THREAD_H_
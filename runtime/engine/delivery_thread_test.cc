@@ -0,0 +1,197 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/engine/delivery_thread.h"
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/io_types.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+
+// Logs the calls made to it. The first OnNext() waits for Release(), such
+// that the calls made meanwhile fill the queue.
+class SlowObservable : public InferenceObservable {
+ public:
+  void OnNext(const Responses& responses) override {
+    if (!started_.HasBeenNotified()) {
+      started_.Notify();
+      released_.WaitForNotification();
+    }
+    Log(std::string(*responses.GetResponseTextAt(0)));
+  }
+
+  void OnNextText(int candidate_index, absl::string_view text) override {
+    Log(absl::StrCat(candidate_index, ":", text));
+  }
+
+  void OnCandidateDone(int candidate_index) override {
+    Log(absl::StrCat("candidate done ", candidate_index));
+  }
+
+  void OnDone() override { Log("done"); }
+
+  void OnError(const absl::Status& status) override {
+    Log(std::string(status.message()));
+  }
+
+  // Waits until the first OnNext() is being delivered.
+  void WaitUntilStarted() { started_.WaitForNotification(); }
+
+  void Release() { released_.Notify(); }
+
+  std::vector<std::string> GetLog() {
+    absl::MutexLock lock(&mutex_);
+    return log_;
+  }
+
+ private:
+  void Log(std::string call) {
+    absl::MutexLock lock(&mutex_);
+    log_.push_back(std::move(call));
+  }
+
+  absl::Notification started_;
+  absl::Notification released_;
+  absl::Mutex mutex_;
+  std::vector<std::string> log_;
+};
+
+Responses MakeResponses(absl::string_view text) {
+  Responses responses(/*num_output_candidates=*/1);
+  responses.GetMutableResponseTexts()[0] = std::string(text);
+  return responses;
+}
+
+TEST(DeliveryThreadTest, DeliversTheCallsInOrder) {
+  SlowObservable observer;
+  observer.Release();
+  DeliveryThread delivery_thread((DeliveryOptions()));
+  std::unique_ptr<InferenceObservable> queued_observer =
+      delivery_thread.Wrap(&observer);
+  queued_observer->OnNext(MakeResponses("Hello"));
+  queued_observer->OnNextText(0, " World");
+  queued_observer->OnCandidateDone(0);
+  queued_observer->OnError(absl::CancelledError("cancelled"));
+  EXPECT_OK(delivery_thread.WaitUntilDelivered(absl::Seconds(10)));
+  EXPECT_THAT(observer.GetLog(), ElementsAre("Hello", "0: World",
+                                             "candidate done 0", "cancelled"));
+}
+
+TEST(DeliveryThreadTest, CoalescesTheResponsesPastTheBound) {
+  SlowObservable observer;
+  DeliveryThread delivery_thread(DeliveryOptions{
+      .max_queued_calls = 1,
+      .overflow_policy = DeliveryOverflowPolicy::kCoalesce});
+  std::unique_ptr<InferenceObservable> queued_observer =
+      delivery_thread.Wrap(&observer);
+  queued_observer->OnNext(MakeResponses("a"));
+  observer.WaitUntilStarted();
+  queued_observer->OnNext(MakeResponses("b"));
+  queued_observer->OnNext(MakeResponses("c"));
+  queued_observer->OnNext(MakeResponses("d"));
+  // Never coalesced, though the queue is full.
+  queued_observer->OnDone();
+  observer.Release();
+  EXPECT_OK(delivery_thread.WaitUntilDelivered(absl::Seconds(10)));
+  EXPECT_THAT(observer.GetLog(), ElementsAre("a", "bcd", "done"));
+  EXPECT_EQ(delivery_thread.GetStats().num_coalesced_calls, 2);
+  EXPECT_EQ(delivery_thread.GetStats().num_dropped_calls, 0);
+}
+
+TEST(DeliveryThreadTest, DropsTheIntermediateResponsesPastTheBound) {
+  SlowObservable observer;
+  DeliveryThread delivery_thread(DeliveryOptions{
+      .max_queued_calls = 1,
+      .overflow_policy = DeliveryOverflowPolicy::kDropIntermediate});
+  std::unique_ptr<InferenceObservable> queued_observer =
+      delivery_thread.Wrap(&observer);
+  queued_observer->OnNext(MakeResponses("a"));
+  observer.WaitUntilStarted();
+  queued_observer->OnNext(MakeResponses("b"));
+  queued_observer->OnNextText(0, "c");
+  queued_observer->OnNext(MakeResponses("d"));
+  queued_observer->OnCandidateDone(0);
+  observer.Release();
+  EXPECT_OK(delivery_thread.WaitUntilDelivered(absl::Seconds(10)));
+  EXPECT_THAT(observer.GetLog(), ElementsAre("a", "b", "candidate done 0"));
+  EXPECT_EQ(delivery_thread.GetStats().num_dropped_calls, 2);
+}
+
+TEST(DeliveryThreadTest, BlocksUntilTheQueueHasRoom) {
+  SlowObservable observer;
+  DeliveryThread delivery_thread(DeliveryOptions{
+      .max_queued_calls = 1,
+      .overflow_policy = DeliveryOverflowPolicy::kBlock});
+  std::unique_ptr<InferenceObservable> queued_observer =
+      delivery_thread.Wrap(&observer);
+  queued_observer->OnNext(MakeResponses("a"));
+  observer.WaitUntilStarted();
+  queued_observer->OnNext(MakeResponses("b"));
+  absl::Notification pushed;
+  std::thread producer_thread([&]() {
+    queued_observer->OnNext(MakeResponses("c"));
+    pushed.Notify();
+  });
+  EXPECT_FALSE(pushed.WaitForNotificationWithTimeout(absl::Milliseconds(50)));
+  observer.Release();
+  producer_thread.join();
+  EXPECT_OK(delivery_thread.WaitUntilDelivered(absl::Seconds(10)));
+  EXPECT_THAT(observer.GetLog(), ElementsAre("a", "b", "c"));
+  EXPECT_EQ(delivery_thread.GetStats().num_coalesced_calls, 0);
+}
+
+TEST(DeliveryThreadTest, DeliversTheQueuedCallsOnDestruction) {
+  SlowObservable observer;
+  {
+    DeliveryThread delivery_thread((DeliveryOptions()));
+    std::unique_ptr<InferenceObservable> queued_observer =
+        delivery_thread.Wrap(&observer);
+    queued_observer->OnNext(MakeResponses("a"));
+    observer.WaitUntilStarted();
+    queued_observer->OnDone();
+    observer.Release();
+  }
+  EXPECT_THAT(observer.GetLog(), ElementsAre("a", "done"));
+}
+
+TEST(DeliveryThreadTest, WaitUntilDeliveredTimesOut) {
+  SlowObservable observer;
+  DeliveryThread delivery_thread((DeliveryOptions()));
+  std::unique_ptr<InferenceObservable> queued_observer =
+      delivery_thread.Wrap(&observer);
+  queued_observer->OnNext(MakeResponses("a"));
+  observer.WaitUntilStarted();
+  EXPECT_THAT(delivery_thread.WaitUntilDelivered(absl::Milliseconds(10)),
+              testing::status::StatusIs(absl::StatusCode::kDeadlineExceeded));
+  observer.Release();
+}
+
+}  // namespace
+}  // namespace litert::lm
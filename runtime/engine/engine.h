@@ -16,17 +16,40 @@
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_ENGINE_H_
 
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/engine/engine_metrics.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/util/memory_usage.h"
 
 namespace litert::lm {
 
+// How much memory Engine::OnMemoryPressure() gives back, in increasing order,
+// e.g. mapped from the levels of onTrimMemory() on Android. Each level also
+// releases the memory of the levels below it.
+enum class MemoryPressureLevel {
+  // Frees the prefix caches.
+  kModerate = 0,
+  // Frees the decode embedding caches and the scratch buffers of the
+  // executors.
+  kHigh = 1,
+  // Drops the pages of the model sections read from the mapped model file
+  // which are not read any more or read in place, e.g. the weights uploaded
+  // to the GPU and the embedding tables. They are read from the file again
+  // when accessed.
+  kCritical = 2,
+};
+
 // Engine is the interface for the LLM runtime. It is responsible for
 // - Initializing the LLM model and related resources, e.g. tokenizer,
 //   embedder, etc.
@@ -81,7 +104,8 @@ class Engine {
 
     // Adds the input prompt/query to the model for starting the prefilling
     // process. Note that the user can break down their prompt/query into
-    // multiple chunks and call this function multiple times.
+    // multiple chunks and call this function multiple times. The contents of
+    // one call are joined, and prefilled at once as a single token stream.
     //
     // This is a blocking call and the function will return when the prefill
     // process is done.
@@ -94,6 +118,42 @@ class Engine {
       return absl::UnimplementedError("Not implemented.");
     }
 
+    // Prefills `text`, the input of the next turn while the user is still
+    // typing it, such that only its tail is left to prefill once it is sent.
+    // Each call passes the whole input so far, whose token ids are compared
+    // to the ones prefilled by the previous calls: the tokens from the first
+    // one that differs are rolled back, e.g. when the user edits the input,
+    // and only the new ones are prefilled. The last token is held back, since
+    // the next characters may change it, and so is the prompt template suffix.
+    // A cancelled call keeps the tokens prefilled so far, which the next call
+    // carries on from.
+    //
+    // This is a blocking call, meant to be made when the typing pauses. No
+    // other prefill, decode or rewind can run until the draft is committed or
+    // discarded:
+    //
+    //   RETURN_IF_ERROR(session->UpdateDraft("What is the tall"));
+    //   RETURN_IF_ERROR(session->UpdateDraft("What is the highest"));
+    //   // The user presses send.
+    //   RETURN_IF_ERROR(session->CommitDraft("What is the highest mountain?"));
+    //   ASSIGN_OR_RETURN(auto responses, session->RunDecode());
+    virtual absl::Status UpdateDraft(absl::string_view text) {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Updates the draft to `text` like UpdateDraft(), then prefills its
+    // remaining tokens and the prompt template suffix, such that the session
+    // is as after RunPrefill({InputText(text)}), and the draft is closed.
+    virtual absl::Status CommitDraft(absl::string_view text) {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Drops the draft, if any, rewinding the session to the step it started
+    // at.
+    virtual absl::Status DiscardDraft() {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
     // Starts the decoding process for the model to predict the response based
     // on the input prompt/query added after using RunPrefill* functions.
     // This is a blocking call and the function will return when the decoding
@@ -108,25 +168,234 @@ class Engine {
       return absl::UnimplementedError("Not implemented.");
     }
 
+    // Appends `text` to the context right after the tokens decoded so far,
+    // e.g. the result of the tool call the last decode stopped at, between the
+    // affixes of `role`, then decodes the next response, in a single task of
+    // the worker thread. Unlike RunPrefill() then RunDecode(), no start token
+    // is added, and the affixes are encoded once per session.
+    //
+    //   ASSIGN_OR_RETURN(auto responses, session->GenerateContent(
+    //       {InputText(user_turn)}));
+    //   while (IsToolCall(responses)) {
+    //     ASSIGN_OR_RETURN(responses, session->AppendAndDecode(
+    //         RunTool(responses), PromptRole::kUser));
+    //   }
+    virtual absl::StatusOr<Responses> AppendAndDecode(absl::string_view text,
+                                                      PromptRole role) {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Same as AppendAndDecode(), but the responses are streamed through the
+    // observer, which also gets the errors of the append. Returns right away.
+    virtual absl::Status AppendAndDecodeAsync(absl::string_view text,
+                                              PromptRole role,
+                                              InferenceObservable* observer) {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Cancels the prefills and decodes of the session that are running or
+    // scheduled, which fail with CancelledError, or send it to their observer.
+    // They stop between the decode steps or prefill work groups, leaving the
+    // tokens processed so far in the session, so a rewind is needed to drop
+    // them. The calls made after Cancel() are not affected. Can be called from
+    // any thread.
+    virtual absl::Status Cancel() {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
     // Returns the benchmark info for the session. Returns error if the
     // benchmark is not enabled.
     virtual absl::StatusOr<BenchmarkInfo> GetBenchmarkInfo() = 0;
+
+    // Returns how long the calls of the session waited for the worker thread
+    // it shares with the other sessions of its executor, e.g. to check that a
+    // foreground session is not delayed by a background one. See
+    // SessionConfig::SetSchedulingWeight().
+    virtual absl::StatusOr<SessionSchedulingStats> GetSchedulingStats() const {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Returns the current step of the session, i.e. the number of tokens it
+    // has prefilled and decoded so far.
+    virtual absl::StatusOr<int> GetCurrentStep() {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Rewinds the session to `step`, which must be the current step at the
+    // start of one of its prefills or decodes, dropping all the later turns.
+    // The tokens before `step` stay in the kv-cache, so regenerating the last
+    // response, or editing the last input, only costs the changed suffix:
+    //
+    //   ASSIGN_OR_RETURN(int step, session->GetCurrentStep());
+    //   RETURN_IF_ERROR(session->RunPrefill({InputText(user_turn)}));
+    //   ASSIGN_OR_RETURN(auto responses, session->RunDecode());
+    //   // Edits the user turn.
+    //   RETURN_IF_ERROR(session->RewindToStep(step));
+    //   RETURN_IF_ERROR(session->RunPrefill({InputText(edited_user_turn)}));
+    virtual absl::Status RewindToStep(int step) {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Drops the tokens at the steps of `discarded_ranges`, [first, second)
+    // pairs in increasing order that do not overlap, from the session, e.g.
+    // the old tool outputs of a long conversation. The later tokens are moved
+    // down in the kv-cache, such that the current step goes back by the
+    // number of dropped tokens and the kept history is not prefilled again.
+    // The session can no longer be rewound past the first dropped step.
+    //
+    //   ASSIGN_OR_RETURN(int begin, session->GetCurrentStep());
+    //   RETURN_IF_ERROR(session->RunPrefill({InputText(tool_output)}));
+    //   ASSIGN_OR_RETURN(int end, session->GetCurrentStep());
+    //   ...
+    //   RETURN_IF_ERROR(session->CompactContext({{begin, end}}));
+    virtual absl::Status CompactContext(
+        absl::Span<const std::pair<int, int>> discarded_ranges) {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Prefills `contents` like RunPrefill(), then returns the log-probability
+    // of each of `continuations` following them, e.g. to rank the answers of
+    // a multiple-choice question without decoding. The continuations are
+    // scored from the kv-cache of the prompt, which is prefilled once, and the
+    // session is left as after the prefill.
+    virtual absl::StatusOr<std::vector<float>> Score(
+        const std::vector<InputData>& contents,
+        absl::Span<const std::string> continuations) {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Writes the state of the session, i.e. its kv-cache and step counters, to
+    // a file at `path`, such that the session can be resumed without
+    // prefilling its history again, e.g. after the app is killed. The
+    // kv-cache is stored in int8 if the executor settings say so.
+    virtual absl::Status SaveCheckpoint(absl::string_view path) {
+      return absl::UnimplementedError("Not implemented.");
+    }
+
+    // Resumes the session from a file written by SaveCheckpoint() of a
+    // session with the same config, on the same model and device. The
+    // kv-cache contents are mapped from the file and copied into the kv-cache
+    // once.
+    virtual absl::Status RestoreCheckpoint(absl::string_view path) {
+      return absl::UnimplementedError("Not implemented.");
+    }
   };
 
-  // Method to create Engine.
+  // Observes the loading of an engine created by CreateEngineAsync(). The
+  // methods are called from the loading thread.
+  class LoadingObserver {
+   public:
+    virtual ~LoadingObserver() = default;
+
+    // Called when a loading phase starts, e.g. "Tokenizer initialization".
+    virtual void OnProgress(absl::string_view phase) {}
+
+    // Called once the engine is loaded, with OkStatus if it is ready to run
+    // sessions, or with the error the loading failed with.
+    virtual void OnReady(absl::Status status) {}
+  };
+
+  // Method to create Engine. Returns once the engine is loaded.
   static absl::StatusOr<std::unique_ptr<Engine>> CreateEngine(
       EngineSettings settings);
 
+  // Creates the engine without blocking: the engine is returned right away,
+  // and loaded on a thread of its own, whose progress and result are sent to
+  // `observer`, if not null. The observer must outlive the loading. Sessions
+  // can be created while the engine is loading:
+  // - CreateSession() waits until the engine is loaded.
+  // - CreateSessionAsync() queues the creation until then.
+  // Both fail with the loading error if the engine fails to load. Destroying
+  // the engine waits for the loading to finish.
+  //
+  //   ASSIGN_OR_RETURN(auto engine,
+  //                    Engine::CreateEngineAsync(settings, &observer));
+  //   engine->CreateSessionAsync(
+  //       SessionConfig::CreateDefault(),
+  //       [](absl::StatusOr<std::unique_ptr<Engine::Session>> session) {
+  //         // Runs once the engine is loaded.
+  //       });
+  static absl::StatusOr<std::unique_ptr<Engine>> CreateEngineAsync(
+      EngineSettings settings, LoadingObserver* observer);
+
   // Method to create the Session.
   virtual absl::StatusOr<std::unique_ptr<Session>> CreateSession(
       const SessionConfig& session_config) const = 0;
 
+  // Creates a session without blocking, and sends it to `callback`, from
+  // another thread if the engine is still loading.
+  virtual void CreateSessionAsync(
+      const SessionConfig& session_config,
+      absl::AnyInvocable<void(absl::StatusOr<std::unique_ptr<Session>>) &&>
+          callback) const {
+    std::move(callback)(CreateSession(session_config));
+  }
+
+  // Creates a session resumed from the checkpoint file at `path`, written by
+  // Session::SaveCheckpoint().
+  virtual absl::StatusOr<std::unique_ptr<Session>> RestoreSession(
+      const SessionConfig& session_config, absl::string_view path) const {
+    absl::StatusOr<std::unique_ptr<Session>> session =
+        CreateSession(session_config);
+    if (!session.ok()) {
+      return session.status();
+    }
+    absl::Status status = (*session)->RestoreCheckpoint(path);
+    if (!status.ok()) {
+      return status;
+    }
+    return session;
+  }
+
   // Waits until the engine is done with all the tasks. The function will
   // return error if the timeout is reached.
   virtual absl::Status WaitUntilDone(absl::Duration timeout) {
     return absl::UnimplementedError("Not implemented.");
   }
 
+  // Returns the metrics of the engine, accumulated over all its sessions.
+  // They are always recorded, at the cost of a few atomic operations per
+  // prefill and decode, so they can be polled in production, e.g. to export
+  // them periodically to a monitoring system.
+  virtual absl::StatusOr<EngineMetrics> GetMetrics() const {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  // Returns the memory held by the engine, by component, e.g. the weights,
+  // the kv-cache, the model buffers, the embedders and the tokenizer, and by
+  // host or device location. Waits for the engine to be loaded.
+  virtual absl::StatusOr<MemoryUsage> GetMemoryUsage() const {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  // Warms the executors of the engine up, on their worker threads, and leaves
+  // them as new. Waits for the engine to be loaded, and for the warmup unless
+  // `options.run_in_background`, in which case its failures are only logged.
+  // The executors busy with a session are not warmed up. Also run once the
+  // engine is loaded if EngineSettings::SetWarmupOptions() is called.
+  virtual absl::Status Warmup(const WarmupOptions& options) {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  // Gives memory back at `level`, e.g. when the app is asked to trim its
+  // memory, without destroying the engine, which stays usable at the cost of
+  // refilling its caches. The memory is released on the worker threads ahead
+  // of the tasks queued, but after the running ones, so the call does not
+  // wait for it. No-op while the engine is loading.
+  virtual absl::Status OnMemoryPressure(MemoryPressureLevel level) {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  // Returns one embedding per text, pooled by `pooling` from the final hidden
+  // states of the model, e.g. to index documents for retrieval without a
+  // second embedding model. The texts are run in batches through the "embed"
+  // signature of the model, which keeps no kv-cache, so the sessions are not
+  // affected.
+  virtual absl::StatusOr<std::vector<std::vector<float>>> Embed(
+      absl::Span<const std::string> texts, EmbeddingPooling pooling) {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
   // Default timeout duration for the engine/session processes.
   static constexpr absl::Duration kDefaultTimeout = absl::Minutes(10);
 };
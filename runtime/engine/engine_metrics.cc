@@ -0,0 +1,208 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/engine/engine_metrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include "absl/time/time.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+// Returns `numerator / denominator`, or 0 if `denominator` is 0.
+double Ratio(double numerator, double denominator) {
+  return denominator > 0 ? numerator / denominator : 0.0;
+}
+
+void UpdateMax(std::atomic<int64_t>& max, int64_t value) {
+  int64_t current = max.load(std::memory_order_relaxed);
+  while (current < value &&
+         !max.compare_exchange_weak(current, value,
+                                    std::memory_order_relaxed)) {
+  }
+}
+
+}  // namespace
+
+absl::Duration EngineMetrics::GetMeanTimeToFirstToken() const {
+  if (num_decodes == 0) {
+    return absl::ZeroDuration();
+  }
+  return total_time_to_first_token / static_cast<int64_t>(num_decodes);
+}
+
+absl::Duration EngineMetrics::GetMeanInterTokenLatency() const {
+  if (num_decode_tokens == 0) {
+    return absl::ZeroDuration();
+  }
+  return total_decode_time / static_cast<int64_t>(num_decode_tokens);
+}
+
+double EngineMetrics::GetPrefixCacheHitRate() const {
+  return Ratio(prefix_cache_hits, prefix_cache_hits + prefix_cache_misses);
+}
+
+double EngineMetrics::GetEmbeddingCacheHitRate() const {
+  return Ratio(embedding_cache_hits,
+               embedding_cache_hits + embedding_cache_misses);
+}
+
+double EngineMetrics::GetKvCacheOccupancy() const {
+  return Ratio(kv_cache_num_tokens, kv_cache_max_num_tokens);
+}
+
+std::ostream& operator<<(std::ostream& os, const EngineMetrics& metrics) {
+  os << "EngineMetrics:" << std::endl;
+  os << "  Prefill tokens: " << metrics.num_prefill_tokens << std::endl;
+  os << "  Decode tokens: " << metrics.num_decode_tokens << std::endl;
+  os << "  Time to first token (" << metrics.num_decodes << "): mean "
+     << absl::ToDoubleMilliseconds(metrics.GetMeanTimeToFirstToken())
+     << " ms, max "
+     << absl::ToDoubleMilliseconds(metrics.max_time_to_first_token) << " ms"
+     << std::endl;
+  os << "  Inter-token latency: mean "
+     << absl::ToDoubleMilliseconds(metrics.GetMeanInterTokenLatency())
+     << " ms" << std::endl;
+  os << "  KV cache: " << metrics.kv_cache_num_tokens << " / "
+     << metrics.kv_cache_max_num_tokens << " tokens" << std::endl;
+  os << "  Active sessions: " << metrics.num_active_sessions << std::endl;
+  os << "  Queued tasks: " << metrics.num_queued_tasks << std::endl;
+  os << "  Prefix cache: " << metrics.prefix_cache_hits << " hits, "
+     << metrics.prefix_cache_misses << " misses" << std::endl;
+  os << "  Embedding cache: " << metrics.embedding_cache_hits << " hits, "
+     << metrics.embedding_cache_misses << " misses" << std::endl;
+  return os;
+}
+
+absl::Duration SessionSchedulingStats::GetMeanWaitTime() const {
+  if (num_tasks == 0) {
+    return absl::ZeroDuration();
+  }
+  return total_wait_time / static_cast<int64_t>(num_tasks);
+}
+
+std::ostream& operator<<(std::ostream& os,
+                         const SessionSchedulingStats& stats) {
+  os << "SessionSchedulingStats:" << std::endl;
+  os << "  Tasks: " << stats.num_tasks << std::endl;
+  os << "  Tokens: " << stats.num_tokens << std::endl;
+  os << "  Wait time: mean "
+     << absl::ToDoubleMilliseconds(stats.GetMeanWaitTime()) << " ms, max "
+     << absl::ToDoubleMilliseconds(stats.max_wait_time) << " ms" << std::endl;
+  return os;
+}
+
+void EngineMetricsRecorder::RecordPrefill(int num_tokens) {
+  num_prefill_tokens_.fetch_add(std::max(num_tokens, 0),
+                                std::memory_order_relaxed);
+  if (parent_ != nullptr) {
+    parent_->RecordPrefill(num_tokens);
+  }
+}
+
+void EngineMetricsRecorder::RecordDecode(int num_tokens,
+                                         absl::Duration time_to_first_token,
+                                         absl::Duration decode_time) {
+  const int64_t time_to_first_token_ns =
+      absl::ToInt64Nanoseconds(time_to_first_token);
+  num_decode_tokens_.fetch_add(std::max(num_tokens, 0),
+                               std::memory_order_relaxed);
+  num_decodes_.fetch_add(1, std::memory_order_relaxed);
+  total_time_to_first_token_ns_.fetch_add(time_to_first_token_ns,
+                                          std::memory_order_relaxed);
+  UpdateMax(max_time_to_first_token_ns_, time_to_first_token_ns);
+  total_decode_time_ns_.fetch_add(absl::ToInt64Nanoseconds(decode_time),
+                                  std::memory_order_relaxed);
+  if (parent_ != nullptr) {
+    parent_->RecordDecode(num_tokens, time_to_first_token, decode_time);
+  }
+}
+
+void EngineMetricsRecorder::RecordKvCacheNumTokens(int num_tokens) {
+  kv_cache_num_tokens_.store(num_tokens, std::memory_order_relaxed);
+  if (parent_ != nullptr) {
+    parent_->RecordKvCacheNumTokens(num_tokens);
+  }
+}
+
+void EngineMetricsRecorder::RecordPrefixCacheLookups(uint64_t hits,
+                                                     uint64_t misses) {
+  prefix_cache_hits_.store(hits, std::memory_order_relaxed);
+  prefix_cache_misses_.store(misses, std::memory_order_relaxed);
+  if (parent_ != nullptr) {
+    parent_->RecordPrefixCacheLookups(hits, misses);
+  }
+}
+
+void EngineMetricsRecorder::RecordEmbeddingCacheLookups(uint64_t hits,
+                                                        uint64_t misses) {
+  embedding_cache_hits_.store(hits, std::memory_order_relaxed);
+  embedding_cache_misses_.store(misses, std::memory_order_relaxed);
+  if (parent_ != nullptr) {
+    parent_->RecordEmbeddingCacheLookups(hits, misses);
+  }
+}
+
+void EngineMetricsRecorder::RecordSessionCreated() {
+  num_active_sessions_.fetch_add(1, std::memory_order_relaxed);
+  if (parent_ != nullptr) {
+    parent_->RecordSessionCreated();
+  }
+}
+
+void EngineMetricsRecorder::RecordSessionDestroyed() {
+  num_active_sessions_.fetch_sub(1, std::memory_order_relaxed);
+  if (parent_ != nullptr) {
+    parent_->RecordSessionDestroyed();
+  }
+}
+
+int EngineMetricsRecorder::GetNumActiveSessions() const {
+  return num_active_sessions_.load(std::memory_order_relaxed);
+}
+
+EngineMetrics EngineMetricsRecorder::GetSnapshot() const {
+  EngineMetrics metrics;
+  metrics.num_prefill_tokens =
+      num_prefill_tokens_.load(std::memory_order_relaxed);
+  metrics.num_decode_tokens =
+      num_decode_tokens_.load(std::memory_order_relaxed);
+  metrics.num_decodes = num_decodes_.load(std::memory_order_relaxed);
+  metrics.total_time_to_first_token = absl::Nanoseconds(
+      total_time_to_first_token_ns_.load(std::memory_order_relaxed));
+  metrics.max_time_to_first_token = absl::Nanoseconds(
+      max_time_to_first_token_ns_.load(std::memory_order_relaxed));
+  metrics.total_decode_time =
+      absl::Nanoseconds(total_decode_time_ns_.load(std::memory_order_relaxed));
+  metrics.kv_cache_num_tokens =
+      kv_cache_num_tokens_.load(std::memory_order_relaxed);
+  metrics.num_active_sessions =
+      num_active_sessions_.load(std::memory_order_relaxed);
+  metrics.prefix_cache_hits =
+      prefix_cache_hits_.load(std::memory_order_relaxed);
+  metrics.prefix_cache_misses =
+      prefix_cache_misses_.load(std::memory_order_relaxed);
+  metrics.embedding_cache_hits =
+      embedding_cache_hits_.load(std::memory_order_relaxed);
+  metrics.embedding_cache_misses =
+      embedding_cache_misses_.load(std::memory_order_relaxed);
+  return metrics;
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,159 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_ENGINE_METRICS_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_ENGINE_METRICS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+#include "absl/time/time.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// A snapshot of the metrics of an engine, accumulated over all its sessions
+// since the engine was created. Unlike BenchmarkInfo, the metrics are always
+// recorded and do not change how the sessions run, so they can be exported
+// from production, see Engine::GetMetrics().
+struct EngineMetrics {
+  // The tokens prefilled and decoded, i.e. the steps the kv-cache advanced
+  // by. The decoded tokens are counted once per step, whatever the number of
+  // output candidates.
+  uint64_t num_prefill_tokens = 0;
+  uint64_t num_decode_tokens = 0;
+
+  // The number of decodes, and the sum and maximum of their time to first
+  // token, from the start of the first prefill of the turn, or of the decode
+  // if there is none, to the first decoded token.
+  uint64_t num_decodes = 0;
+  absl::Duration total_time_to_first_token = absl::ZeroDuration();
+  absl::Duration max_time_to_first_token = absl::ZeroDuration();
+
+  // The total time spent decoding, over `num_decode_tokens` tokens.
+  absl::Duration total_decode_time = absl::ZeroDuration();
+
+  // The tokens in the kv-cache after the last prefill or decode of any
+  // session, and its capacity, 0 if unknown.
+  int kv_cache_num_tokens = 0;
+  int kv_cache_max_num_tokens = 0;
+
+  // The sessions alive, and the tasks of the sessions waiting for the worker
+  // thread.
+  int num_active_sessions = 0;
+  int num_queued_tasks = 0;
+
+  // The lookups of the prefix cache and of the embedding cache of the
+  // executor, as of the last prefill.
+  uint64_t prefix_cache_hits = 0;
+  uint64_t prefix_cache_misses = 0;
+  uint64_t embedding_cache_hits = 0;
+  uint64_t embedding_cache_misses = 0;
+
+  // The mean time to first token and inter-token latency, or zero if nothing
+  // was decoded.
+  absl::Duration GetMeanTimeToFirstToken() const;
+  absl::Duration GetMeanInterTokenLatency() const;
+
+  // The hit rates of the caches in [0, 1], or 0 if they were never looked up.
+  double GetPrefixCacheHitRate() const;
+  double GetEmbeddingCacheHitRate() const;
+
+  // The fraction of the kv-cache in use in [0, 1], or 0 if unknown.
+  double GetKvCacheOccupancy() const;
+};
+std::ostream& operator<<(std::ostream& os, const EngineMetrics& metrics);
+
+// The waits of the calls of a session for the worker thread of its executor,
+// shared with the other sessions of the executor, since the session was
+// created. See Engine::Session::GetSchedulingStats().
+struct SessionSchedulingStats {
+  // The tasks run on the worker thread for the calls of the session, and the
+  // tokens they prefilled and decoded.
+  uint64_t num_tasks = 0;
+  uint64_t num_tokens = 0;
+
+  // The sum and maximum of the times the tasks waited for the worker thread,
+  // from the call to the start of the task.
+  absl::Duration total_wait_time = absl::ZeroDuration();
+  absl::Duration max_wait_time = absl::ZeroDuration();
+
+  // The mean wait time, or zero if no task ran.
+  absl::Duration GetMeanWaitTime() const;
+};
+std::ostream& operator<<(std::ostream& os,
+                         const SessionSchedulingStats& stats);
+
+// Records the metrics of an engine from its sessions. Each call costs a few
+// relaxed atomic operations, and the calls are made once per prefill or
+// decode rather than once per token, so the recorder is always on. Thread
+// safe, and lock free.
+class EngineMetricsRecorder {
+ public:
+  EngineMetricsRecorder() = default;
+  // Creates a recorder which also records all the calls into `parent`, e.g.
+  // the recorder of the sessions of one executor of an engine, whose parent
+  // records all the sessions of the engine.
+  explicit EngineMetricsRecorder(EngineMetricsRecorder* parent)
+      : parent_(parent) {}
+  EngineMetricsRecorder(const EngineMetricsRecorder&) = delete;
+  EngineMetricsRecorder& operator=(const EngineMetricsRecorder&) = delete;
+
+  // Records a prefill of `num_tokens` tokens.
+  void RecordPrefill(int num_tokens);
+
+  // Records a decode of `num_tokens` tokens which took `decode_time`, and
+  // whose first token came `time_to_first_token` after the start of the turn.
+  void RecordDecode(int num_tokens, absl::Duration time_to_first_token,
+                    absl::Duration decode_time);
+
+  // Records the tokens in the kv-cache after a prefill or decode.
+  void RecordKvCacheNumTokens(int num_tokens);
+
+  // Records the lifetime counters of the caches.
+  void RecordPrefixCacheLookups(uint64_t hits, uint64_t misses);
+  void RecordEmbeddingCacheLookups(uint64_t hits, uint64_t misses);
+
+  // Records the creation and the destruction of a session.
+  void RecordSessionCreated();
+  void RecordSessionDestroyed();
+
+  // Returns the metrics recorded so far. The fields recorded concurrently may
+  // be off by the calls in flight. The fields the recorder does not know of,
+  // i.e. the kv-cache capacity and the queued tasks, are left to the engine.
+  EngineMetrics GetSnapshot() const;
+
+  // Returns the sessions alive, as in the snapshot.
+  int GetNumActiveSessions() const;
+
+ private:
+  EngineMetricsRecorder* const parent_ = nullptr;
+  std::atomic<uint64_t> num_prefill_tokens_ = 0;
+  std::atomic<uint64_t> num_decode_tokens_ = 0;
+  std::atomic<uint64_t> num_decodes_ = 0;
+  std::atomic<int64_t> total_time_to_first_token_ns_ = 0;
+  std::atomic<int64_t> max_time_to_first_token_ns_ = 0;
+  std::atomic<int64_t> total_decode_time_ns_ = 0;
+  std::atomic<int> kv_cache_num_tokens_ = 0;
+  std::atomic<int> num_active_sessions_ = 0;
+  std::atomic<uint64_t> prefix_cache_hits_ = 0;
+  std::atomic<uint64_t> prefix_cache_misses_ = 0;
+  std::atomic<uint64_t> embedding_cache_hits_ = 0;
+  std::atomic<uint64_t> embedding_cache_misses_ = 0;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_ENGINE_METRICS_H_
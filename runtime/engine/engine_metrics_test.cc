@@ -0,0 +1,131 @@
+#include "runtime/engine/engine_metrics.h"
+
+#include <sstream>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/time/time.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+using ::testing::HasSubstr;
+
+TEST(EngineMetricsTest, EmptyMetricsHaveZeroRates) {
+  EngineMetrics metrics;
+  EXPECT_EQ(metrics.GetMeanTimeToFirstToken(), absl::ZeroDuration());
+  EXPECT_EQ(metrics.GetMeanInterTokenLatency(), absl::ZeroDuration());
+  EXPECT_EQ(metrics.GetPrefixCacheHitRate(), 0.0);
+  EXPECT_EQ(metrics.GetEmbeddingCacheHitRate(), 0.0);
+  EXPECT_EQ(metrics.GetKvCacheOccupancy(), 0.0);
+}
+
+TEST(EngineMetricsRecorderTest, RecordsTheTokensAndLatencies) {
+  EngineMetricsRecorder recorder;
+  recorder.RecordPrefill(10);
+  recorder.RecordPrefill(6);
+  recorder.RecordDecode(/*num_tokens=*/4,
+                        /*time_to_first_token=*/absl::Milliseconds(30),
+                        /*decode_time=*/absl::Milliseconds(40));
+  recorder.RecordDecode(/*num_tokens=*/6,
+                        /*time_to_first_token=*/absl::Milliseconds(50),
+                        /*decode_time=*/absl::Milliseconds(60));
+
+  const EngineMetrics metrics = recorder.GetSnapshot();
+  EXPECT_EQ(metrics.num_prefill_tokens, 16);
+  EXPECT_EQ(metrics.num_decode_tokens, 10);
+  EXPECT_EQ(metrics.num_decodes, 2);
+  EXPECT_EQ(metrics.GetMeanTimeToFirstToken(), absl::Milliseconds(40));
+  EXPECT_EQ(metrics.max_time_to_first_token, absl::Milliseconds(50));
+  EXPECT_EQ(metrics.GetMeanInterTokenLatency(), absl::Milliseconds(10));
+}
+
+TEST(EngineMetricsRecorderTest, RecordsTheGauges) {
+  EngineMetricsRecorder recorder;
+  recorder.RecordSessionCreated();
+  recorder.RecordSessionCreated();
+  recorder.RecordSessionDestroyed();
+  recorder.RecordKvCacheNumTokens(100);
+  recorder.RecordKvCacheNumTokens(25);
+  recorder.RecordPrefixCacheLookups(/*hits=*/3, /*misses=*/1);
+  recorder.RecordEmbeddingCacheLookups(/*hits=*/1, /*misses=*/4);
+
+  EngineMetrics metrics = recorder.GetSnapshot();
+  metrics.kv_cache_max_num_tokens = 100;
+  EXPECT_EQ(metrics.num_active_sessions, 1);
+  EXPECT_EQ(metrics.kv_cache_num_tokens, 25);
+  EXPECT_DOUBLE_EQ(metrics.GetKvCacheOccupancy(), 0.25);
+  EXPECT_DOUBLE_EQ(metrics.GetPrefixCacheHitRate(), 0.75);
+  EXPECT_DOUBLE_EQ(metrics.GetEmbeddingCacheHitRate(), 0.2);
+}
+
+TEST(EngineMetricsRecorderTest, RecordsIntoTheParent) {
+  EngineMetricsRecorder parent;
+  EngineMetricsRecorder first(&parent);
+  EngineMetricsRecorder second(&parent);
+  first.RecordSessionCreated();
+  second.RecordSessionCreated();
+  second.RecordSessionCreated();
+  first.RecordPrefill(10);
+  second.RecordDecode(5, absl::Milliseconds(20), absl::Milliseconds(50));
+
+  EXPECT_EQ(first.GetNumActiveSessions(), 1);
+  EXPECT_EQ(second.GetNumActiveSessions(), 2);
+  EXPECT_EQ(parent.GetNumActiveSessions(), 3);
+  const EngineMetrics metrics = parent.GetSnapshot();
+  EXPECT_EQ(metrics.num_prefill_tokens, 10);
+  EXPECT_EQ(metrics.num_decode_tokens, 5);
+  EXPECT_EQ(first.GetSnapshot().num_decode_tokens, 0);
+}
+
+TEST(EngineMetricsRecorderTest, RecordsFromManyThreads) {
+  EngineMetricsRecorder recorder;
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&recorder, i]() {
+      for (int j = 0; j < 1000; ++j) {
+        recorder.RecordPrefill(1);
+        recorder.RecordDecode(1, absl::Microseconds(i * 1000 + j),
+                              absl::Microseconds(1));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const EngineMetrics metrics = recorder.GetSnapshot();
+  EXPECT_EQ(metrics.num_prefill_tokens, 4000);
+  EXPECT_EQ(metrics.num_decode_tokens, 4000);
+  EXPECT_EQ(metrics.max_time_to_first_token, absl::Microseconds(3999));
+}
+
+TEST(EngineMetricsTest, PrintsTheMetrics) {
+  EngineMetricsRecorder recorder;
+  recorder.RecordPrefill(8);
+  recorder.RecordDecode(2, absl::Milliseconds(5), absl::Milliseconds(4));
+  EngineMetrics metrics = recorder.GetSnapshot();
+  metrics.kv_cache_max_num_tokens = 1024;
+  std::stringstream ss;
+  ss << metrics;
+  EXPECT_THAT(ss.str(), HasSubstr("Prefill tokens: 8"));
+  EXPECT_THAT(ss.str(), HasSubstr("Time to first token (1): mean 5 ms"));
+  EXPECT_THAT(ss.str(), HasSubstr("Inter-token latency: mean 2 ms"));
+  EXPECT_THAT(ss.str(), HasSubstr("KV cache: 0 / 1024 tokens"));
+}
+
+TEST(SessionSchedulingStatsTest, PrintsTheMeanWaitTime) {
+  SessionSchedulingStats stats;
+  EXPECT_EQ(stats.GetMeanWaitTime(), absl::ZeroDuration());
+  stats.num_tasks = 4;
+  stats.total_wait_time = absl::Milliseconds(8);
+  stats.max_wait_time = absl::Milliseconds(5);
+  EXPECT_EQ(stats.GetMeanWaitTime(), absl::Milliseconds(2));
+  std::stringstream ss;
+  ss << stats;
+  EXPECT_THAT(ss.str(), HasSubstr("Wait time: mean 2 ms, max 5 ms"));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -1,18 +1,27 @@
 #include "runtime/engine/engine_settings.h"
 
+#include <cstddef>
+#include <memory>
 #include <optional>
 #include <ostream>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/escaping.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/components/decode_recording.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/engine/io_types.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/proto/constrained_decoding_options.pb.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/framework/thread_options.h"
 #include "runtime/proto/engine.pb.h"
 #include "runtime/proto/llm_metadata.pb.h"
 #include "runtime/proto/sampler_params.pb.h"
@@ -86,6 +95,19 @@ absl::Status EngineSettings::MaybeUpdateAndValidate(
     }
     main_executor_settings_.SetMaxNumTokens(max_num_tokens);
   }
+  // The executors of the pool hold as many tokens as the main one, unless
+  // set otherwise.
+  for (auto& executor_settings : pool_executor_settings_) {
+    if (executor_settings.GetMaxNumTokens() == 0) {
+      executor_settings.SetMaxNumTokens(
+          main_executor_settings_.GetMaxNumTokens());
+    }
+  }
+  if (split_prefill_executor_settings_.has_value() &&
+      split_prefill_executor_settings_->GetMaxNumTokens() == 0) {
+    split_prefill_executor_settings_->SetMaxNumTokens(
+        main_executor_settings_.GetMaxNumTokens());
+  }
 
   // Set the default values for the sampler params.
   if (!metadata.has_sampler_params()) {
@@ -147,6 +169,79 @@ const std::optional<proto::LlmMetadata>& EngineSettings::GetLlmMetadata()
   return metadata_;
 }
 
+const std::optional<size_t>& EngineSettings::GetPrefixCacheBudgetBytes()
+    const {
+  return prefix_cache_budget_bytes_;
+}
+
+void EngineSettings::SetPrefixCacheBudgetBytes(
+    size_t prefix_cache_budget_bytes) {
+  prefix_cache_budget_bytes_ = prefix_cache_budget_bytes;
+}
+
+const std::optional<std::string>& EngineSettings::GetPrefixCacheDirectory()
+    const {
+  return prefix_cache_directory_;
+}
+
+void EngineSettings::SetPrefixCacheDirectory(
+    std::string prefix_cache_directory) {
+  prefix_cache_directory_ = std::move(prefix_cache_directory);
+}
+
+const std::optional<size_t>& EngineSettings::GetResponseCacheBudgetBytes()
+    const {
+  return response_cache_budget_bytes_;
+}
+
+void EngineSettings::SetResponseCacheBudgetBytes(
+    size_t response_cache_budget_bytes) {
+  response_cache_budget_bytes_ = response_cache_budget_bytes;
+}
+
+const std::vector<LlmExecutorSettings>&
+EngineSettings::GetPoolExecutorSettings() const {
+  return pool_executor_settings_;
+}
+
+void EngineSettings::AddPoolExecutorSettings(
+    LlmExecutorSettings executor_settings) {
+  pool_executor_settings_.push_back(std::move(executor_settings));
+}
+
+const std::optional<LlmExecutorSettings>&
+EngineSettings::GetSplitPrefillExecutorSettings() const {
+  return split_prefill_executor_settings_;
+}
+
+int EngineSettings::GetSplitPrefillMinTokens() const {
+  return split_prefill_min_tokens_;
+}
+
+void EngineSettings::SetSplitPrefillExecutorSettings(
+    LlmExecutorSettings executor_settings, int min_prefill_tokens) {
+  split_prefill_executor_settings_ = std::move(executor_settings);
+  split_prefill_min_tokens_ = min_prefill_tokens;
+}
+
+const std::optional<WarmupOptions>& EngineSettings::GetWarmupOptions() const {
+  return warmup_options_;
+}
+
+void EngineSettings::SetWarmupOptions(WarmupOptions warmup_options) {
+  warmup_options_ = warmup_options;
+}
+
+const std::optional<absl::Duration>& EngineSettings::GetWorkerSpinDuration()
+    const {
+  return worker_spin_duration_;
+}
+
+void EngineSettings::SetWorkerSpinDuration(
+    absl::Duration worker_spin_duration) {
+  worker_spin_duration_ = worker_spin_duration;
+}
+
 std::ostream& operator<<(std::ostream& os, const EngineSettings& settings) {
   os << "EngineSettings: " << std::endl;
   os << "  MainExecutorSettings: " << settings.GetMainExecutorSettings();
@@ -161,6 +256,39 @@ std::ostream& operator<<(std::ostream& os, const EngineSettings& settings) {
   } else {
     os << "  BenchmarkParams: Not set" << std::endl;
   }
+  if (settings.GetPrefixCacheBudgetBytes().has_value()) {
+    os << "  PrefixCacheBudgetBytes: "
+       << settings.GetPrefixCacheBudgetBytes().value() << std::endl;
+  } else {
+    os << "  PrefixCacheBudgetBytes: Not set" << std::endl;
+  }
+  if (settings.GetPrefixCacheDirectory().has_value()) {
+    os << "  PrefixCacheDirectory: "
+       << settings.GetPrefixCacheDirectory().value() << std::endl;
+  }
+  if (settings.GetResponseCacheBudgetBytes().has_value()) {
+    os << "  ResponseCacheBudgetBytes: "
+       << settings.GetResponseCacheBudgetBytes().value() << std::endl;
+  }
+  for (const auto& executor_settings : settings.GetPoolExecutorSettings()) {
+    os << "  PoolExecutorSettings: " << executor_settings;
+  }
+  if (settings.GetSplitPrefillExecutorSettings().has_value()) {
+    os << "  SplitPrefillMinTokens: " << settings.GetSplitPrefillMinTokens()
+       << std::endl;
+    os << "  SplitPrefillExecutorSettings: "
+       << settings.GetSplitPrefillExecutorSettings().value();
+  }
+  if (settings.GetWarmupOptions().has_value()) {
+    os << "  WarmupNumDecodeSteps: "
+       << settings.GetWarmupOptions()->num_decode_steps << std::endl;
+    os << "  WarmupRunInBackground: "
+       << settings.GetWarmupOptions()->run_in_background << std::endl;
+  }
+  if (settings.GetWorkerSpinDuration().has_value()) {
+    os << "  WorkerSpinDuration: " << settings.GetWorkerSpinDuration().value()
+       << std::endl;
+  }
   return os;
 }
 
@@ -255,6 +383,64 @@ absl::Status SessionConfig::MaybeUpdateAndValidate(
         "Number of output candidates need to be at least 1, but got: ",
         num_output_candidates_));
   }
+  if (num_top_log_probs_ < 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Number of top log-probabilities must be non-negative, but got: ",
+        num_top_log_probs_));
+  }
+
+  if (context_shift_config_.has_value()) {
+    if (context_shift_config_->num_sink_tokens < 0) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Number of sink tokens must not be negative, but got: ",
+          context_shift_config_->num_sink_tokens));
+    }
+    if (context_shift_config_->num_recent_tokens < 1) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Number of recent tokens need to be at least 1, but got: ",
+          context_shift_config_->num_recent_tokens));
+    }
+  }
+
+  if (decode_pacing_config_.has_value()) {
+    if (decode_pacing_config_->target_steps_per_second < 0) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Target decode steps per second must not be negative, but got: ",
+          decode_pacing_config_->target_steps_per_second));
+    }
+    if (decode_pacing_config_->throttle_latency_ratio <= 1) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Throttle latency ratio must be greater than 1, but got: ",
+          decode_pacing_config_->throttle_latency_ratio));
+    }
+  }
+
+  if (prompt_lookup_config_.has_value()) {
+    if (prompt_lookup_config_->min_ngram_size < 1 ||
+        prompt_lookup_config_->max_ngram_size <
+            prompt_lookup_config_->min_ngram_size) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Invalid prompt lookup n-gram sizes: [",
+          prompt_lookup_config_->min_ngram_size, ", ",
+          prompt_lookup_config_->max_ngram_size, "]"));
+    }
+    if (prompt_lookup_config_->max_num_draft_tokens < 1) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Number of prompt lookup draft tokens need to be at least 1, but "
+          "got: ",
+          prompt_lookup_config_->max_num_draft_tokens));
+    }
+    if (num_output_candidates_ != 1) {
+      return absl::InvalidArgumentError(
+          "Prompt lookup decoding needs a single output candidate.");
+    }
+    if (sampler_params_.type() == proto::SamplerParameters::BEAM_SEARCH ||
+        constrained_decoding_options_.has_value()) {
+      return absl::InvalidArgumentError(
+          "Prompt lookup decoding is greedy, and cannot be combined with beam "
+          "search or constrained decoding.");
+    }
+  }
 
   if (sampler_backend_ == Backend::UNSPECIFIED) {
     if (engine_settings.GetMainExecutorSettings().GetBackend() ==
@@ -264,6 +450,53 @@ absl::Status SessionConfig::MaybeUpdateAndValidate(
       sampler_backend_ = Backend::CPU;
     }
   }
+  // The GPU sampler only applies the top-k, top-p and temperature, so the
+  // penalties and the logit biases are sampled with on the CPU.
+  if (sampler_backend_ == Backend::GPU &&
+      (sampler_params_.has_repetition_penalty() ||
+       sampler_params_.frequency_penalty() != 0.0f ||
+       sampler_params_.presence_penalty() != 0.0f ||
+       sampler_params_.min_p() != 0.0f ||
+       !sampler_params_.logit_biases().empty() ||
+       !sampler_params_.banned_token_ids().empty() ||
+       sampler_params_.restrict_to_logit_biases())) {
+    ABSL_LOG(INFO) << "Sampling with penalties or logit biases on CPU.";
+    sampler_backend_ = Backend::CPU;
+  }
+
+  if (constrained_decoding_options_.has_value()) {
+    if (constrained_decoding_options_->constraint_case() ==
+        proto::ConstrainedDecodingOptions::CONSTRAINT_NOT_SET) {
+      return absl::InvalidArgumentError(
+          "Constrained decoding needs a regex or a JSON schema.");
+    }
+    if (sampler_backend_ != Backend::CPU) {
+      return absl::InvalidArgumentError(
+          "Constrained decoding is only supported by the CPU sampler.");
+    }
+  }
+
+  if (decode_recorder_ != nullptr) {
+    if (sampler_backend_ != Backend::CPU || num_output_candidates_ != 1) {
+      return absl::InvalidArgumentError(
+          "Decode recording needs the CPU sampler and a single output "
+          "candidate.");
+    }
+    if (sampler_params_.type() == proto::SamplerParameters::BEAM_SEARCH ||
+        constrained_decoding_options_.has_value() ||
+        prompt_lookup_config_.has_value()) {
+      return absl::InvalidArgumentError(
+          "Decode recording records the sampled tokens, and cannot be "
+          "combined with beam search, constrained or prompt lookup "
+          "decoding.");
+    }
+  }
+
+  if (benchmark_params_.has_value() && !engine_settings.IsBenchmarkEnabled()) {
+    return absl::InvalidArgumentError(
+        "The benchmark parameters of the session need the benchmark to be "
+        "enabled on the engine.");
+  }
 
   ABSL_LOG(INFO) << "The validated session config: " << *this;
   return absl::OkStatus();
@@ -288,6 +521,14 @@ std::vector<std::vector<int>>& SessionConfig::GetMutableStopTokenIds() {
   return stop_token_ids_;
 }
 
+const std::vector<std::string>& SessionConfig::GetStopStrings() const {
+  return stop_strings_;
+}
+
+std::vector<std::string>& SessionConfig::GetMutableStopStrings() {
+  return stop_strings_;
+}
+
 int SessionConfig::GetStartTokenId() const { return start_token_id_; }
 
 void SessionConfig::SetStartTokenId(int start_token_id) {
@@ -302,6 +543,12 @@ void SessionConfig::SetNumOutputCandidates(int num_output_candidates) {
   num_output_candidates_ = num_output_candidates;
 }
 
+int SessionConfig::GetNumTopLogProbs() const { return num_top_log_probs_; }
+
+void SessionConfig::SetNumTopLogProbs(int num_top_log_probs) {
+  num_top_log_probs_ = num_top_log_probs;
+}
+
 const proto::PromptTemplates& SessionConfig::GetPromptTemplates() const {
   return prompt_templates_;
 }
@@ -320,10 +567,95 @@ std::ostream& operator<<(std::ostream& os, const SessionConfig& config) {
   for (const auto& stop_token_ids : config.GetStopTokenIds()) {
     os << "    " << stop_token_ids << std::endl;
   }
+  os << "  StopStrings: " << std::endl;
+  for (const auto& stop_string : config.GetStopStrings()) {
+    os << "    \"" << absl::CEscape(stop_string) << "\"" << std::endl;
+  }
   os << "  NumOutputCandidates: " << config.GetNumOutputCandidates()
      << std::endl;
+  os << "  NumTopLogProbs: " << config.GetNumTopLogProbs() << std::endl;
   os << "  PromptTemplates: " << config.GetPromptTemplates().DebugString()
      << std::endl;
+  if (config.GetContextShiftConfig().has_value()) {
+    os << "  ContextShiftConfig: num_sink_tokens="
+       << config.GetContextShiftConfig()->num_sink_tokens
+       << ", num_recent_tokens="
+       << config.GetContextShiftConfig()->num_recent_tokens << std::endl;
+  } else {
+    os << "  ContextShiftConfig: Not set" << std::endl;
+  }
+  if (config.GetPromptLookupConfig().has_value()) {
+    os << "  PromptLookupConfig: min_ngram_size="
+       << config.GetPromptLookupConfig()->min_ngram_size
+       << ", max_ngram_size=" << config.GetPromptLookupConfig()->max_ngram_size
+       << ", max_num_draft_tokens="
+       << config.GetPromptLookupConfig()->max_num_draft_tokens << std::endl;
+  } else {
+    os << "  PromptLookupConfig: Not set" << std::endl;
+  }
+  os << "  OverlapDecodeOutput: " << config.GetOverlapDecodeOutput()
+     << std::endl;
+  os << "  RequestTimeout: " << config.GetRequestTimeout() << std::endl;
+  if (config.GetMaxOutputTokens().has_value()) {
+    os << "  MaxOutputTokens: " << *config.GetMaxOutputTokens() << std::endl;
+  } else {
+    os << "  MaxOutputTokens: Not set" << std::endl;
+  }
+  os << "  DecodeTimeBudget: " << config.GetDecodeTimeBudget() << std::endl;
+  if (config.GetDecodePacingConfig().has_value()) {
+    os << "  DecodePacingConfig: target_steps_per_second="
+       << config.GetDecodePacingConfig()->target_steps_per_second
+       << ", throttle_latency_ratio="
+       << config.GetDecodePacingConfig()->throttle_latency_ratio << std::endl;
+  } else {
+    os << "  DecodePacingConfig: Not set" << std::endl;
+  }
+  if (const auto& options = config.GetStreamingFlushOptions();
+      options.has_value()) {
+    os << "  StreamingFlushOptions: max_num_responses="
+       << options->max_num_responses << ", max_delay=" << options->max_delay
+       << ", flush_on_newline=" << options->flush_on_newline
+       << ", text_only=" << options->text_only << std::endl;
+  } else {
+    os << "  StreamingFlushOptions: Not set" << std::endl;
+  }
+  if (const auto& options = config.GetDeliveryOptions(); options.has_value()) {
+    os << "  DeliveryOptions: max_queued_calls=" << options->max_queued_calls
+       << ", overflow_policy=" << options->overflow_policy << std::endl;
+  } else {
+    os << "  DeliveryOptions: Not set" << std::endl;
+  }
+  os << "  Priority: " << config.GetPriority() << std::endl;
+  os << "  SchedulingWeight: " << config.GetSchedulingWeight() << std::endl;
+  os << "  SchedulingTenant: " << config.GetSchedulingTenant() << std::endl;
+  os << "  LoraAdapterName: " << config.GetLoraAdapterName() << std::endl;
+  if (config.GetConstrainedDecodingOptions().has_value()) {
+    os << "  ConstrainedDecodingOptions: "
+       << config.GetConstrainedDecodingOptions()->DebugString() << std::endl;
+  } else {
+    os << "  ConstrainedDecodingOptions: Not set" << std::endl;
+  }
+  if (config.GetBenchmarkParams().has_value()) {
+    os << "  BenchmarkParams: " << config.GetBenchmarkParams()->DebugString()
+       << std::endl;
+  } else {
+    os << "  BenchmarkParams: Not set" << std::endl;
+  }
+  if (config.GetPreferredBackend().has_value()) {
+    os << "  PreferredBackend: " << *config.GetPreferredBackend() << std::endl;
+  } else {
+    os << "  PreferredBackend: Not set" << std::endl;
+  }
+  os << "  ExecutorAffinityKey: " << config.GetExecutorAffinityKey()
+     << std::endl;
+  if (config.GetDecodeRecorder() != nullptr) {
+    os << "  DecodeRecorder: "
+       << (config.GetDecodeRecorder()->IsReplaying() ? "Replaying"
+                                                     : "Recording")
+       << std::endl;
+  } else {
+    os << "  DecodeRecorder: Not set" << std::endl;
+  }
   return os;
 }
 
@@ -332,4 +664,168 @@ void SessionConfig::SetSamplerBackend(Backend sampler_backend) {
   sampler_backend_ = sampler_backend;
 }
 
+const std::optional<ContextShiftConfig>& SessionConfig::GetContextShiftConfig()
+    const {
+  return context_shift_config_;
+}
+
+void SessionConfig::SetContextShiftConfig(
+    const ContextShiftConfig& context_shift_config) {
+  context_shift_config_ = context_shift_config;
+}
+
+const std::optional<PromptLookupConfig>& SessionConfig::GetPromptLookupConfig()
+    const {
+  return prompt_lookup_config_;
+}
+
+void SessionConfig::SetPromptLookupConfig(
+    const PromptLookupConfig& prompt_lookup_config) {
+  prompt_lookup_config_ = prompt_lookup_config;
+}
+
+bool SessionConfig::GetOverlapDecodeOutput() const {
+  return overlap_decode_output_;
+}
+
+void SessionConfig::SetOverlapDecodeOutput(bool overlap_decode_output) {
+  overlap_decode_output_ = overlap_decode_output;
+}
+
+absl::Duration SessionConfig::GetRequestTimeout() const {
+  return request_timeout_;
+}
+
+void SessionConfig::SetRequestTimeout(absl::Duration request_timeout) {
+  request_timeout_ = request_timeout;
+}
+
+const std::optional<int>& SessionConfig::GetMaxOutputTokens() const {
+  return max_output_tokens_;
+}
+
+void SessionConfig::SetMaxOutputTokens(int max_output_tokens) {
+  max_output_tokens_ = max_output_tokens;
+}
+
+absl::Duration SessionConfig::GetDecodeTimeBudget() const {
+  return decode_time_budget_;
+}
+
+void SessionConfig::SetDecodeTimeBudget(absl::Duration decode_time_budget) {
+  decode_time_budget_ = decode_time_budget;
+}
+
+const std::optional<DecodePacingConfig>& SessionConfig::GetDecodePacingConfig()
+    const {
+  return decode_pacing_config_;
+}
+
+void SessionConfig::SetDecodePacingConfig(
+    const DecodePacingConfig& decode_pacing_config) {
+  decode_pacing_config_ = decode_pacing_config;
+}
+
+const std::optional<StreamingFlushOptions>&
+SessionConfig::GetStreamingFlushOptions() const {
+  return streaming_flush_options_;
+}
+
+void SessionConfig::SetStreamingFlushOptions(
+    const StreamingFlushOptions& streaming_flush_options) {
+  streaming_flush_options_ = streaming_flush_options;
+}
+
+const std::optional<DeliveryOptions>& SessionConfig::GetDeliveryOptions()
+    const {
+  return delivery_options_;
+}
+
+void SessionConfig::SetDeliveryOptions(
+    const DeliveryOptions& delivery_options) {
+  delivery_options_ = delivery_options;
+}
+
+TaskPriority SessionConfig::GetPriority() const { return priority_; }
+
+void SessionConfig::SetPriority(TaskPriority priority) {
+  priority_ = priority;
+}
+
+double SessionConfig::GetSchedulingWeight() const {
+  return scheduling_weight_;
+}
+
+void SessionConfig::SetSchedulingWeight(double scheduling_weight) {
+  scheduling_weight_ = scheduling_weight;
+}
+
+const std::string& SessionConfig::GetSchedulingTenant() const {
+  return scheduling_tenant_;
+}
+
+void SessionConfig::SetSchedulingTenant(absl::string_view scheduling_tenant) {
+  scheduling_tenant_ = std::string(scheduling_tenant);
+}
+
+const std::string& SessionConfig::GetLoraAdapterName() const {
+  return lora_adapter_name_;
+}
+
+void SessionConfig::SetLoraAdapterName(absl::string_view lora_adapter_name) {
+  lora_adapter_name_ = std::string(lora_adapter_name);
+}
+
+const std::optional<proto::ConstrainedDecodingOptions>&
+SessionConfig::GetConstrainedDecodingOptions() const {
+  return constrained_decoding_options_;
+}
+
+proto::ConstrainedDecodingOptions&
+SessionConfig::GetMutableConstrainedDecodingOptions() {
+  if (!constrained_decoding_options_.has_value()) {
+    constrained_decoding_options_ = proto::ConstrainedDecodingOptions();
+  }
+  return *constrained_decoding_options_;
+}
+
+const std::optional<proto::BenchmarkParams>& SessionConfig::GetBenchmarkParams()
+    const {
+  return benchmark_params_;
+}
+
+proto::BenchmarkParams& SessionConfig::GetMutableBenchmarkParams() {
+  if (!benchmark_params_.has_value()) {
+    benchmark_params_ = proto::BenchmarkParams();
+  }
+  return *benchmark_params_;
+}
+
+const std::optional<Backend>& SessionConfig::GetPreferredBackend() const {
+  return preferred_backend_;
+}
+
+void SessionConfig::SetPreferredBackend(Backend preferred_backend) {
+  preferred_backend_ = preferred_backend;
+}
+
+const std::string& SessionConfig::GetExecutorAffinityKey() const {
+  return executor_affinity_key_;
+}
+
+void SessionConfig::SetExecutorAffinityKey(
+    absl::string_view executor_affinity_key) {
+  executor_affinity_key_ = std::string(executor_affinity_key);
+}
+
+const std::shared_ptr<DecodeRecorder>& SessionConfig::GetDecodeRecorder()
+    const {
+  return decode_recorder_;
+}
+
+void SessionConfig::SetDecodeRecorder(
+    std::shared_ptr<DecodeRecorder> decode_recorder) {
+  decode_recorder_ = std::move(decode_recorder);
+}
+
 }  // namespace litert::lm
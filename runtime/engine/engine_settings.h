@@ -1,16 +1,25 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_ENGINE_SETTINGS_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_ENGINE_SETTINGS_H_
 
+#include <cstddef>
+#include <memory>
 #include <optional>
 #include <ostream>
+#include <string>
 #include <vector>
 
 #include "absl/base/nullability.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/components/decode_recording.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/engine/io_types.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/proto/constrained_decoding_options.pb.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/framework/thread_options.h"
 #include "runtime/proto/engine.pb.h"
 #include "runtime/proto/llm_metadata.pb.h"
 #include "runtime/proto/sampler_params.pb.h"
@@ -30,6 +39,19 @@ namespace litert::lm {
 // const reference to the std::optional<T> field.
 
 // Settings used for initializing LiteRT LM Engine.
+// The warmup of the executors of an engine, which runs every prefill signature
+// and a few decode steps on the buffers as they are, such that the first
+// request does not pay for the kernel compilation, the buffer allocations and
+// the weight upload. See Engine::Warmup().
+struct WarmupOptions {
+  // The number of decode steps run by each executor.
+  int num_decode_steps = 4;
+  // Whether Engine::Warmup() returns right away, while the warmup runs on the
+  // worker threads of the executors. The sessions created in the meantime are
+  // queued behind it.
+  bool run_in_background = false;
+};
+
 // This class encapsulates the model-specific settings that are used for
 // initializing the LiteRT LM. These settings are typically fixed for a given
 // model and are not expected to change during the inference process.
@@ -83,6 +105,77 @@ class EngineSettings {
   // created and returned.
   proto::LlmMetadata& GetMutableLlmMetadata();
 
+  // Prefix cache:
+  // Returns the memory budget in bytes of the engine-level prefix cache. The
+  // prefix cache is disabled when not set.
+  const std::optional<size_t>& GetPrefixCacheBudgetBytes() const;
+  // Sets the memory budget in bytes of the engine-level prefix cache, which
+  // keeps the executor state at the end of each prefill chunk such that later
+  // prefills sharing the same token id prefix only need to prefill the suffix.
+  void SetPrefixCacheBudgetBytes(size_t prefix_cache_budget_bytes);
+  // Returns the directory the frequently used prefixes of the prefix cache are
+  // persisted to, or std::nullopt if they are only kept in memory.
+  const std::optional<std::string>& GetPrefixCacheDirectory() const;
+  // Sets the directory the prefixes hit at least twice are written to, keyed
+  // by the model file, the executor settings and their token ids, such that
+  // the engines created later with the same model and settings, e.g. after
+  // the app restarts, load them back instead of prefilling them. Only used
+  // along with the prefix cache budget.
+  void SetPrefixCacheDirectory(std::string prefix_cache_directory);
+
+  // Response cache:
+  // Returns the memory budget in bytes of the engine-level response cache. The
+  // response cache is disabled when not set.
+  const std::optional<size_t>& GetResponseCacheBudgetBytes() const;
+  // Sets the memory budget in bytes of the engine-level response cache, which
+  // keeps the responses of the deterministic decodes, i.e. greedy with a
+  // single output candidate, keyed by their prompt token ids and decoding
+  // parameters, such that a session sending the same first prompt again gets
+  // them without running the executor. See ResponseCache.
+  void SetResponseCacheBudgetBytes(size_t response_cache_budget_bytes);
+
+  // Executor pool:
+  // The settings of the executors run next to the main one, e.g. on another
+  // GPU or backend. Each executor has its own kv-cache, prefix cache and
+  // worker thread, so the sessions placed on different executors run in
+  // parallel, and all of them share the model resources loaded for the main
+  // executor, whose model assets they are built from. Empty by default, i.e.
+  // all the sessions run on the main executor. See SessionConfig for the
+  // placement of the sessions.
+  const std::vector<LlmExecutorSettings>& GetPoolExecutorSettings() const;
+  void AddPoolExecutorSettings(LlmExecutorSettings executor_settings);
+
+  // Split execution:
+  // The settings of an executor prefilling the long prompts of the main
+  // executor, e.g. on the NPU next to a GPU main executor, such that the main
+  // executor only prefills the prompts shorter than `min_prefill_tokens` and
+  // decodes. The kv-cache of a prompt prefilled on the prefill executor is
+  // handed over to the main executor when the decode starts, and converted if
+  // their layouts differ. The prefill executor is built from the model assets
+  // of the main one. Not set by default, i.e. the main executor prefills all
+  // the prompts. See SplitLlmExecutor.
+  const std::optional<LlmExecutorSettings>& GetSplitPrefillExecutorSettings()
+      const;
+  int GetSplitPrefillMinTokens() const;
+  void SetSplitPrefillExecutorSettings(LlmExecutorSettings executor_settings,
+                                       int min_prefill_tokens);
+
+  // Warmup:
+  // The warmup run once the engine is loaded, see Engine::Warmup(). Not set
+  // by default, i.e. the first request warms the executors up.
+  const std::optional<WarmupOptions>& GetWarmupOptions() const;
+  void SetWarmupOptions(WarmupOptions warmup_options);
+
+  // Low-latency worker:
+  // When set, the worker threads of the executors spin for up to the given
+  // duration for the next call before they block, and so do the sessions
+  // waiting for the result of a call, sparing the thread wake-ups of the
+  // handoff at the cost of the CPU time spun. The blocking calls of a session
+  // also run on its calling thread while the worker thread is idle. Not set by
+  // default, i.e. the threads block right away. See ThreadPool::SubmitAndWait.
+  const std::optional<absl::Duration>& GetWorkerSpinDuration() const;
+  void SetWorkerSpinDuration(absl::Duration worker_spin_duration);
+
  private:
   explicit EngineSettings(
       LlmExecutorSettings executor_settings,
@@ -97,9 +190,75 @@ class EngineSettings {
   // Default metadata for the model. This is loaded from the model assets (if
   // present).
   std::optional<proto::LlmMetadata> metadata_;
+
+  // Memory budget in bytes of the prefix cache. Not set means disabled.
+  std::optional<size_t> prefix_cache_budget_bytes_;
+  // Directory the prefix cache is persisted to. Not set means in memory only.
+  std::optional<std::string> prefix_cache_directory_;
+
+  // Memory budget in bytes of the response cache. Not set means disabled.
+  std::optional<size_t> response_cache_budget_bytes_;
+
+  // Settings for the executors of the pool, apart from the main one.
+  std::vector<LlmExecutorSettings> pool_executor_settings_;
+
+  // Settings for the executor prefilling the long prompts of the main one,
+  // and the min number of tokens of the prompts it prefills.
+  std::optional<LlmExecutorSettings> split_prefill_executor_settings_;
+  int split_prefill_min_tokens_ = 0;
+
+  // The warmup run once the engine is loaded. Not set means no warmup.
+  std::optional<WarmupOptions> warmup_options_;
+
+  // How long the worker threads spin before blocking. Not set means no
+  // low-latency worker.
+  std::optional<absl::Duration> worker_spin_duration_;
 };
 std::ostream& operator<<(std::ostream& os, const EngineSettings& settings);
 
+// The context shifting policy of a session. When the kv-cache is full, the
+// first `num_sink_tokens` tokens of the context are kept together with the
+// latest `num_recent_tokens` tokens, and the tokens in between are dropped
+// from the kv-cache, such that decoding goes on without prefilling a truncated
+// history again. The kept tokens keep their original positions.
+struct ContextShiftConfig {
+  // The number of tokens at the start of the context that are never dropped,
+  // e.g. the start token and the system prompt.
+  int num_sink_tokens = 4;
+  // The number of the latest tokens that are kept, including the pending input
+  // token of the next decode step. Must be positive.
+  int num_recent_tokens = 512;
+};
+
+// The prompt lookup decoding of a session. In each step, the latest tokens of
+// the context are looked up in the prompt and the text decoded so far, and
+// the tokens that followed their latest earlier occurrence are verified by
+// the model in a single call. It needs no draft model, and speeds up the
+// outputs that copy from the input, e.g. summaries and code edits. The
+// decoding is greedy.
+struct PromptLookupConfig {
+  // The sizes of the n-grams looked up, the longest matching one first.
+  int min_ngram_size = 2;
+  int max_ngram_size = 4;
+  // The maximum number of tokens proposed in each step.
+  int max_num_draft_tokens = 8;
+};
+
+// The decode pacing of a session, which spaces its decode steps out instead of
+// running them back to back, such that a sustained decode heats the device up
+// slower, and the stream keeps a steady rate instead of stalling once the
+// device throttles. The throttling is detected from the decode step latency,
+// which grows as the clocks are lowered.
+struct DecodePacingConfig {
+  // The rate the steps are held at, in steps per second. 0 means the steps are
+  // only paced while the device is throttled.
+  double target_steps_per_second = 0;
+  // The ratio of the recent step latency over the lowest one seen beyond which
+  // the device is taken as throttled, and the steps are held at the recent
+  // latency. Must be greater than 1.
+  double throttle_latency_ratio = 1.5;
+};
+
 // Configurations used for the session.
 // This class encapsulates the session-specific configurations that are used for
 // creating a LiteRT LM session.
@@ -123,15 +282,32 @@ class SessionConfig {
   const std::vector<std::vector<int>>& GetStopTokenIds() const;
   std::vector<std::vector<int>>& GetMutableStopTokenIds();
 
+  // Stop strings:
+  // The texts to stop the decoding process at, matched on the decoded text
+  // however they are tokenized. Neither the stop string nor the text after it
+  // is returned. Only applies to the streaming decode.
+  const std::vector<std::string>& GetStopStrings() const;
+  std::vector<std::string>& GetMutableStopStrings();
+
   // Set the start token ids.
   int GetStartTokenId() const;
   void SetStartTokenId(int start_token_id);
 
   // Number of output candidates:
-  // Getters for the number of output candidates.
+  // Getters for the number of output candidates. The prompt is prefilled once
+  // for all the candidates, which are then decoded in the batch rows of the
+  // executor, so the number must match the batch size of the model.
   int GetNumOutputCandidates() const;
   void SetNumOutputCandidates(int num_output_candidates);
 
+  // Number of top log-probabilities:
+  // Getters for the number of most likely tokens whose log-probabilities are
+  // reported alongside each sampled token (see Responses::GetTopLogProbsAt).
+  // They are collected by the sampler in the same pass that draws the token,
+  // so only samplers run by the session support it. 0 disables the report.
+  int GetNumTopLogProbs() const;
+  void SetNumTopLogProbs(int num_top_log_probs);
+
   // Sampler backend:
   // Getters for the backend of the sampler.
   Backend GetSamplerBackend() const;
@@ -142,6 +318,130 @@ class SessionConfig {
   const proto::PromptTemplates& GetPromptTemplates() const;
   proto::PromptTemplates& GetMutablePromptTemplates();
 
+  // Context shifting:
+  // Returns the context shifting policy. When not set, decoding stops with an
+  // error once the kv-cache is full.
+  const std::optional<ContextShiftConfig>& GetContextShiftConfig() const;
+  void SetContextShiftConfig(const ContextShiftConfig& context_shift_config);
+
+  // Prompt lookup decoding:
+  // Returns the prompt lookup decoding policy. When not set, each step
+  // decodes a single token. Needs a single output candidate.
+  const std::optional<PromptLookupConfig>& GetPromptLookupConfig() const;
+  void SetPromptLookupConfig(const PromptLookupConfig& prompt_lookup_config);
+
+  // Output overlapping:
+  // Whether the detokenization and the observer callbacks of a streaming
+  // decode run on a separate thread while the executor computes the next
+  // step. Only applies to the sampling done outside of the executor.
+  bool GetOverlapDecodeOutput() const;
+  void SetOverlapDecodeOutput(bool overlap_decode_output);
+
+  // Request timeout:
+  // The time each prefill or decode call may take from the moment it is made,
+  // including the time it waits for the earlier calls. The calls still
+  // running by then fail with DeadlineExceededError. Infinite by default.
+  absl::Duration GetRequestTimeout() const;
+  void SetRequestTimeout(absl::Duration request_timeout);
+
+  // Decode budget:
+  // The maximum number of tokens each decode call outputs per candidate, and
+  // the time it may decode for, from its first step. A decode spending either
+  // ends as if it hit a stop token, e.g. with OnDone() when streaming. Not set
+  // and infinite by default, i.e. up to the kv-cache size.
+  const std::optional<int>& GetMaxOutputTokens() const;
+  void SetMaxOutputTokens(int max_output_tokens);
+  absl::Duration GetDecodeTimeBudget() const;
+  void SetDecodeTimeBudget(absl::Duration decode_time_budget);
+
+  // Decode pacing:
+  // Returns the pacing of the decode steps. When not set, they run back to
+  // back. Its measured step latencies are kept for the lifetime of the
+  // session.
+  const std::optional<DecodePacingConfig>& GetDecodePacingConfig() const;
+  void SetDecodePacingConfig(const DecodePacingConfig& decode_pacing_config);
+
+  // Streaming flushes:
+  // When set, the responses streamed by RunDecodeAsync() and
+  // GenerateContentStream() are collected and sent to the observer in fewer,
+  // longer responses, as by a CoalescingObservable. Not set by default, i.e.
+  // one response per decode step.
+  const std::optional<StreamingFlushOptions>& GetStreamingFlushOptions() const;
+  void SetStreamingFlushOptions(
+      const StreamingFlushOptions& streaming_flush_options);
+
+  // Delivery thread:
+  // When set, the calls of the observers of RunPrefillAsync(),
+  // RunDecodeAsync() and GenerateContentStream() are made on a thread of the
+  // session, as by a DeliveryThread, such that a slow observer does not stall
+  // the engine worker thread. Not set by default, i.e. the observers are
+  // called on the worker thread.
+  const std::optional<DeliveryOptions>& GetDeliveryOptions() const;
+  void SetDeliveryOptions(const DeliveryOptions& delivery_options);
+
+  // Priority:
+  // The priority of the calls of the session on the engine worker thread.
+  // The calls of a session run in the order they are made, e.g. a prefill
+  // before the decode after it, as long as its priority is not changed in
+  // between. kNormal by default.
+  TaskPriority GetPriority() const;
+  void SetPriority(TaskPriority priority);
+
+  // Fair scheduling:
+  // The sessions sharing an executor take turns on its worker thread by
+  // weighted fair queuing over the tokens they prefill and decode, see
+  // FairTaskScheduler. A session of twice the weight of another gets twice
+  // the tokens while both have calls waiting. The sessions of the same
+  // non-empty tenant share one weight, the one of its first session, e.g.
+  // for all the sessions of a background feature. 1.0 and no tenant by
+  // default.
+  double GetSchedulingWeight() const;
+  void SetSchedulingWeight(double scheduling_weight);
+  const std::string& GetSchedulingTenant() const;
+  void SetSchedulingTenant(absl::string_view scheduling_tenant);
+
+  // LoRA adapter:
+  // The name of the LoRA adapter applied to the session, among the adapters
+  // loaded into the executor. Empty for the base model, the default.
+  const std::string& GetLoraAdapterName() const;
+  void SetLoraAdapterName(absl::string_view lora_adapter_name);
+
+  // Constrained decoding:
+  // The constraint of the decoded texts, e.g. a JSON schema. Not set means
+  // unconstrained decoding, the default. Only supported by the CPU sampler.
+  const std::optional<proto::ConstrainedDecodingOptions>&
+  GetConstrainedDecodingOptions() const;
+  proto::ConstrainedDecodingOptions& GetMutableConstrainedDecodingOptions();
+
+  // Benchmark parameters:
+  // The numbers of prefill and decode tokens of the benchmarked turns of the
+  // session, overriding the BenchmarkParams of the engine, e.g. to sweep them
+  // on one engine. Needs the benchmark to be enabled on the engine. Not set by
+  // default, i.e. the parameters of the engine.
+  const std::optional<proto::BenchmarkParams>& GetBenchmarkParams() const;
+  proto::BenchmarkParams& GetMutableBenchmarkParams();
+
+  // Executor placement:
+  // The executor the session runs on, when the engine has a pool of
+  // executors. The session is placed on an executor of the preferred backend
+  // if there is any, or of any backend otherwise. The sessions of the same
+  // non-empty affinity key are placed on the same executor, e.g. to share its
+  // prefix cache, and the other sessions on the executor running the fewest
+  // sessions of the engine. Not set and empty by default.
+  const std::optional<Backend>& GetPreferredBackend() const;
+  void SetPreferredBackend(Backend preferred_backend);
+  const std::string& GetExecutorAffinityKey() const;
+  void SetExecutorAffinityKey(absl::string_view executor_affinity_key);
+
+  // Decode recording:
+  // When set, the prompts of the session, its sampled tokens and the latency
+  // of each decode step are recorded into the recorder, or, if it replays a
+  // recording, the sampled tokens are replaced by the recorded ones, e.g. to
+  // reproduce the timings of a generation on another build. Needs the CPU
+  // sampler and a single output candidate. Not set by default.
+  const std::shared_ptr<DecodeRecorder>& GetDecodeRecorder() const;
+  void SetDecodeRecorder(std::shared_ptr<DecodeRecorder> decode_recorder);
+
  private:
   // Private constructor for the SessionConfig. The user should use the
   // CreateDefault() method to create a SessionConfig.
@@ -156,6 +456,9 @@ class SessionConfig {
   // dimension is the sequence of token ids that constitutes the stop token.
   std::vector<std::vector<int>> stop_token_ids_;
 
+  // Stop strings for the session, matched on the decoded text.
+  std::vector<std::string> stop_strings_;
+
   // Start token id for the session.
   int start_token_id_ = -1;
 
@@ -167,8 +470,65 @@ class SessionConfig {
   // it to a value greater than 1 will require the model to support batching.
   int num_output_candidates_ = 1;
 
+  // The number of top log-probabilities to report per decoded token.
+  int num_top_log_probs_ = 0;
+
   // Backend to use for sampling.
   Backend sampler_backend_ = Backend::UNSPECIFIED;
+
+  // The context shifting policy. Not set means disabled.
+  std::optional<ContextShiftConfig> context_shift_config_;
+
+  // The prompt lookup decoding policy. Not set means disabled.
+  std::optional<PromptLookupConfig> prompt_lookup_config_;
+
+  // Whether to overlap the output processing with the next decode step.
+  bool overlap_decode_output_ = false;
+
+  // The time each prefill or decode call may take.
+  absl::Duration request_timeout_ = absl::InfiniteDuration();
+
+  // The maximum number of tokens per decode call. Not set means no limit.
+  std::optional<int> max_output_tokens_;
+
+  // The time each decode call may decode for.
+  absl::Duration decode_time_budget_ = absl::InfiniteDuration();
+
+  // The pacing of the decode steps. Not set means disabled.
+  std::optional<DecodePacingConfig> decode_pacing_config_;
+
+  // When the streamed responses are sent. Not set means once per step.
+  std::optional<StreamingFlushOptions> streaming_flush_options_;
+
+  // How the observers are called from a thread of the session. Not set means
+  // from the worker thread.
+  std::optional<DeliveryOptions> delivery_options_;
+
+  // The priority of the calls of the session.
+  TaskPriority priority_ = TaskPriority::kNormal;
+
+  // The share of the worker thread of the session, and the tenant sharing it
+  // with the other sessions of the tenant, empty for none.
+  double scheduling_weight_ = 1.0;
+  std::string scheduling_tenant_;
+
+  // The LoRA adapter of the session, empty for the base model.
+  std::string lora_adapter_name_;
+
+  // The constraint of the decoded texts. Not set means unconstrained.
+  std::optional<proto::ConstrainedDecodingOptions>
+      constrained_decoding_options_;
+
+  // The benchmark parameters of the session. Not set means the ones of the
+  // engine.
+  std::optional<proto::BenchmarkParams> benchmark_params_;
+
+  // The placement of the session on the executors of the pool.
+  std::optional<Backend> preferred_backend_;
+  std::string executor_affinity_key_;
+
+  // The recorder of the decoded tokens. Not set means no recording.
+  std::shared_ptr<DecodeRecorder> decode_recorder_;
 };
 std::ostream& operator<<(std::ostream& os, const SessionConfig& config);
 
@@ -1,5 +1,6 @@
 #include "runtime/engine/engine_settings.h"
 
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -9,8 +10,14 @@
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/components/decode_recording.h"
 #include "runtime/components/tokenizer.h"
+#include "runtime/engine/io_types.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/executor/proto/constrained_decoding_options.pb.h"
+#include "runtime/framework/thread_options.h"
 #include "runtime/proto/engine.pb.h"
 #include "runtime/proto/llm_metadata.pb.h"
 #include "runtime/util/test_utils.h"  // IWYU pragma: keep
@@ -106,6 +113,113 @@ TEST(EngineSettingsTest, BenchmarkParams) {
   EXPECT_EQ(settings->GetBenchmarkParams()->num_prefill_tokens(), 100);
 }
 
+TEST(EngineSettingsTest, PrefixCacheBudgetBytes) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  EXPECT_OK(settings);
+  EXPECT_FALSE(settings->GetPrefixCacheBudgetBytes().has_value());
+
+  settings->SetPrefixCacheBudgetBytes(64 * 1024 * 1024);
+  EXPECT_EQ(settings->GetPrefixCacheBudgetBytes().value(), 64 * 1024 * 1024);
+}
+
+TEST(EngineSettingsTest, PrefixCacheDirectory) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  EXPECT_OK(settings);
+  EXPECT_FALSE(settings->GetPrefixCacheDirectory().has_value());
+
+  settings->SetPrefixCacheDirectory("/tmp/prefix_cache");
+  EXPECT_EQ(settings->GetPrefixCacheDirectory().value(), "/tmp/prefix_cache");
+}
+
+TEST(EngineSettingsTest, ResponseCacheBudgetBytes) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  EXPECT_OK(settings);
+  EXPECT_FALSE(settings->GetResponseCacheBudgetBytes().has_value());
+
+  settings->SetResponseCacheBudgetBytes(1024 * 1024);
+  EXPECT_EQ(settings->GetResponseCacheBudgetBytes().value(), 1024 * 1024);
+}
+
+TEST(EngineSettingsTest, WorkerSpinDuration) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  EXPECT_OK(settings);
+  EXPECT_FALSE(settings->GetWorkerSpinDuration().has_value());
+
+  settings->SetWorkerSpinDuration(absl::Microseconds(50));
+  EXPECT_EQ(settings->GetWorkerSpinDuration().value(),
+            absl::Microseconds(50));
+}
+
+TEST(EngineSettingsTest, PoolExecutorSettings) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets, Backend::GPU);
+  EXPECT_OK(settings);
+  EXPECT_TRUE(settings->GetPoolExecutorSettings().empty());
+
+  auto npu_settings =
+      LlmExecutorSettings::CreateDefault(*model_assets, Backend::NPU);
+  ASSERT_OK(npu_settings);
+  settings->AddPoolExecutorSettings(*npu_settings);
+  ASSERT_EQ(settings->GetPoolExecutorSettings().size(), 1);
+  EXPECT_EQ(settings->GetPoolExecutorSettings()[0].GetBackend(), Backend::NPU);
+
+  // The executors of the pool hold as many tokens as the main one.
+  settings->GetMutableMainExecutorSettings().SetMaxNumTokens(2048);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+  EXPECT_EQ(settings->GetPoolExecutorSettings()[0].GetMaxNumTokens(), 2048);
+}
+
+TEST(EngineSettingsTest, SplitPrefillExecutorSettings) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets, Backend::GPU);
+  EXPECT_OK(settings);
+  EXPECT_FALSE(settings->GetSplitPrefillExecutorSettings().has_value());
+
+  auto npu_settings =
+      LlmExecutorSettings::CreateDefault(*model_assets, Backend::NPU);
+  ASSERT_OK(npu_settings);
+  settings->SetSplitPrefillExecutorSettings(*npu_settings,
+                                            /*min_prefill_tokens=*/256);
+  ASSERT_TRUE(settings->GetSplitPrefillExecutorSettings().has_value());
+  EXPECT_EQ(settings->GetSplitPrefillExecutorSettings()->GetBackend(),
+            Backend::NPU);
+  EXPECT_EQ(settings->GetSplitPrefillMinTokens(), 256);
+
+  // The prefill executor holds as many tokens as the main one.
+  settings->GetMutableMainExecutorSettings().SetMaxNumTokens(2048);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+  EXPECT_EQ(settings->GetSplitPrefillExecutorSettings()->GetMaxNumTokens(),
+            2048);
+}
+
+TEST(EngineSettingsTest, WarmupOptions) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets, Backend::GPU);
+  EXPECT_OK(settings);
+  EXPECT_FALSE(settings->GetWarmupOptions().has_value());
+
+  settings->SetWarmupOptions(
+      {.num_decode_steps = 2, .run_in_background = true});
+  ASSERT_TRUE(settings->GetWarmupOptions().has_value());
+  EXPECT_EQ(settings->GetWarmupOptions()->num_decode_steps, 2);
+  EXPECT_TRUE(settings->GetWarmupOptions()->run_in_background);
+}
+
 TEST(EngineSettingsTest, LlmMetadata) {
   auto model_assets = ModelAssets::Create("test_model_path_1");
   ASSERT_OK(model_assets);
@@ -252,6 +366,13 @@ TEST(SessionConfigTest, SetAndGetNumOutputCandidates) {
   EXPECT_EQ(session_config.GetNumOutputCandidates(), 2);
 }
 
+TEST(SessionConfigTest, SetAndGetNumTopLogProbs) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_EQ(session_config.GetNumTopLogProbs(), 0);
+  session_config.SetNumTopLogProbs(5);
+  EXPECT_EQ(session_config.GetNumTopLogProbs(), 5);
+}
+
 TEST(SessionConfigTest, SetAndGetStartTokenId) {
   SessionConfig session_config = SessionConfig::CreateDefault();
   EXPECT_EQ(session_config.GetStartTokenId(), -1);
@@ -300,6 +421,22 @@ TEST(SessionConfigTest, MaybeUpdateAndValidatePickGpuAsSamplerBackend) {
   EXPECT_EQ(session_config.GetSamplerBackend(), Backend::GPU);
 }
 
+TEST(SessionConfigTest, MaybeUpdateAndValidateSamplesLogitBiasesOnCpu) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  ASSERT_OK(settings);
+  settings->GetMutableMainExecutorSettings().SetBackend(Backend::GPU);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+
+  auto session_config = SessionConfig::CreateDefault();
+  session_config.GetMutableSamplerParams().add_banned_token_ids(3);
+  EXPECT_OK(session_config.MaybeUpdateAndValidate(*settings));
+  EXPECT_EQ(session_config.GetSamplerBackend(), Backend::CPU);
+}
+
 TEST(SessionConfigTest, MaybeUpdateAndValidateMaxNumTokens) {
   auto model_assets = ModelAssets::Create("test_model_path_1");
   ASSERT_OK(model_assets);
@@ -341,5 +478,254 @@ TEST(SessionConfigTest, SetAndGetSamplerBackend) {
   EXPECT_EQ(session_config.GetSamplerBackend(), Backend::GPU);
 }
 
+TEST(SessionConfigTest, SetAndGetContextShiftConfig) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetContextShiftConfig().has_value());
+  ContextShiftConfig context_shift_config;
+  context_shift_config.num_sink_tokens = 2;
+  context_shift_config.num_recent_tokens = 100;
+  session_config.SetContextShiftConfig(context_shift_config);
+  ASSERT_TRUE(session_config.GetContextShiftConfig().has_value());
+  EXPECT_EQ(session_config.GetContextShiftConfig()->num_sink_tokens, 2);
+  EXPECT_EQ(session_config.GetContextShiftConfig()->num_recent_tokens, 100);
+}
+
+TEST(SessionConfigTest, SetAndGetLoraAdapterName) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_TRUE(session_config.GetLoraAdapterName().empty());
+  session_config.SetLoraAdapterName("chat");
+  EXPECT_EQ(session_config.GetLoraAdapterName(), "chat");
+}
+
+TEST(SessionConfigTest, SetAndGetExecutorPlacement) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetPreferredBackend().has_value());
+  EXPECT_TRUE(session_config.GetExecutorAffinityKey().empty());
+  session_config.SetPreferredBackend(Backend::NPU);
+  session_config.SetExecutorAffinityKey("user_1");
+  EXPECT_EQ(session_config.GetPreferredBackend(), Backend::NPU);
+  EXPECT_EQ(session_config.GetExecutorAffinityKey(), "user_1");
+}
+
+TEST(SessionConfigTest, SetAndGetRequestTimeout) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_EQ(session_config.GetRequestTimeout(), absl::InfiniteDuration());
+  session_config.SetRequestTimeout(absl::Seconds(30));
+  EXPECT_EQ(session_config.GetRequestTimeout(), absl::Seconds(30));
+}
+
+TEST(SessionConfigTest, SetAndGetDecodeBudget) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetMaxOutputTokens().has_value());
+  EXPECT_EQ(session_config.GetDecodeTimeBudget(), absl::InfiniteDuration());
+  session_config.SetMaxOutputTokens(256);
+  session_config.SetDecodeTimeBudget(absl::Seconds(5));
+  EXPECT_EQ(session_config.GetMaxOutputTokens(), 256);
+  EXPECT_EQ(session_config.GetDecodeTimeBudget(), absl::Seconds(5));
+}
+
+TEST(SessionConfigTest, SetAndGetDecodePacingConfig) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetDecodePacingConfig().has_value());
+  DecodePacingConfig decode_pacing_config;
+  decode_pacing_config.target_steps_per_second = 20;
+  session_config.SetDecodePacingConfig(decode_pacing_config);
+  ASSERT_TRUE(session_config.GetDecodePacingConfig().has_value());
+  EXPECT_EQ(session_config.GetDecodePacingConfig()->target_steps_per_second,
+            20);
+  EXPECT_EQ(session_config.GetDecodePacingConfig()->throttle_latency_ratio,
+            1.5);
+}
+
+TEST(SessionConfigTest, SetAndGetStreamingFlushOptions) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetStreamingFlushOptions().has_value());
+  StreamingFlushOptions options;
+  options.max_num_responses = 4;
+  options.text_only = true;
+  session_config.SetStreamingFlushOptions(options);
+  ASSERT_TRUE(session_config.GetStreamingFlushOptions().has_value());
+  EXPECT_EQ(session_config.GetStreamingFlushOptions()->max_num_responses, 4);
+  EXPECT_TRUE(session_config.GetStreamingFlushOptions()->text_only);
+}
+
+TEST(SessionConfigTest, SetAndGetDeliveryOptions) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetDeliveryOptions().has_value());
+  session_config.SetDeliveryOptions(DeliveryOptions{
+      .max_queued_calls = 8,
+      .overflow_policy = DeliveryOverflowPolicy::kDropIntermediate});
+  ASSERT_TRUE(session_config.GetDeliveryOptions().has_value());
+  EXPECT_EQ(session_config.GetDeliveryOptions()->max_queued_calls, 8);
+  EXPECT_EQ(session_config.GetDeliveryOptions()->overflow_policy,
+            DeliveryOverflowPolicy::kDropIntermediate);
+}
+
+TEST(SessionConfigTest, SetAndGetPriority) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_EQ(session_config.GetPriority(), TaskPriority::kNormal);
+  session_config.SetPriority(TaskPriority::kHigh);
+  EXPECT_EQ(session_config.GetPriority(), TaskPriority::kHigh);
+}
+
+TEST(SessionConfigTest, SetAndGetSchedulingWeightAndTenant) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_EQ(session_config.GetSchedulingWeight(), 1.0);
+  EXPECT_TRUE(session_config.GetSchedulingTenant().empty());
+  session_config.SetSchedulingWeight(0.25);
+  session_config.SetSchedulingTenant("background");
+  EXPECT_EQ(session_config.GetSchedulingWeight(), 0.25);
+  EXPECT_EQ(session_config.GetSchedulingTenant(), "background");
+}
+
+TEST(SessionConfigTest, SetAndGetStopStrings) {
+  SessionConfig session_config = SessionConfig::CreateDefault();
+  EXPECT_TRUE(session_config.GetStopStrings().empty());
+  session_config.GetMutableStopStrings().push_back("\nUser:");
+  EXPECT_THAT(session_config.GetStopStrings(), ElementsAre("\nUser:"));
+}
+
+TEST(SessionConfigTest, MaybeUpdateAndValidateContextShiftConfig) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  ASSERT_OK(settings);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+
+  auto session_config = SessionConfig::CreateDefault();
+  ContextShiftConfig context_shift_config;
+  context_shift_config.num_recent_tokens = 0;
+  session_config.SetContextShiftConfig(context_shift_config);
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+  context_shift_config.num_recent_tokens = 16;
+  session_config.SetContextShiftConfig(context_shift_config);
+  EXPECT_OK(session_config.MaybeUpdateAndValidate(*settings));
+}
+
+TEST(SessionConfigTest, MaybeUpdateAndValidateDecodePacingConfig) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  ASSERT_OK(settings);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+
+  auto session_config = SessionConfig::CreateDefault();
+  DecodePacingConfig decode_pacing_config;
+  decode_pacing_config.throttle_latency_ratio = 1;
+  session_config.SetDecodePacingConfig(decode_pacing_config);
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+  decode_pacing_config.throttle_latency_ratio = 2;
+  session_config.SetDecodePacingConfig(decode_pacing_config);
+  EXPECT_OK(session_config.MaybeUpdateAndValidate(*settings));
+}
+
+TEST(SessionConfigTest, MaybeUpdateAndValidatePromptLookupConfig) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  ASSERT_OK(settings);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+
+  auto session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetPromptLookupConfig().has_value());
+  PromptLookupConfig prompt_lookup_config;
+  prompt_lookup_config.min_ngram_size = 3;
+  prompt_lookup_config.max_ngram_size = 2;
+  session_config.SetPromptLookupConfig(prompt_lookup_config);
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+  prompt_lookup_config.max_ngram_size = 3;
+  session_config.SetPromptLookupConfig(prompt_lookup_config);
+  EXPECT_OK(session_config.MaybeUpdateAndValidate(*settings));
+  // The proposals are verified for a single output candidate.
+  session_config.SetNumOutputCandidates(2);
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(SessionConfigTest, MaybeUpdateAndValidateConstrainedDecodingOptions) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  ASSERT_OK(settings);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+
+  auto session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetConstrainedDecodingOptions().has_value());
+  // The options need a constraint.
+  session_config.GetMutableConstrainedDecodingOptions().set_constraint_library(
+      proto::ConstrainedDecodingOptions::TOKEN_AUTOMATON);
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+  session_config.GetMutableConstrainedDecodingOptions().set_json_schema(
+      R"({"type": "boolean"})");
+  EXPECT_OK(session_config.MaybeUpdateAndValidate(*settings));
+  EXPECT_EQ(session_config.GetConstrainedDecodingOptions()->json_schema(),
+            R"({"type": "boolean"})");
+
+  // Only the CPU sampler masks the logits.
+  session_config.SetSamplerBackend(Backend::GPU);
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(SessionConfigTest, MaybeUpdateAndValidateDecodeRecorder) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  ASSERT_OK(settings);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+
+  auto session_config = SessionConfig::CreateDefault();
+  EXPECT_EQ(session_config.GetDecodeRecorder(), nullptr);
+  auto recorder = std::make_shared<DecodeRecorder>(
+      session_config.GetSamplerParams().SerializeAsString());
+  session_config.SetDecodeRecorder(recorder);
+  session_config.SetSamplerBackend(Backend::CPU);
+  EXPECT_OK(session_config.MaybeUpdateAndValidate(*settings));
+  EXPECT_EQ(session_config.GetDecodeRecorder(), recorder);
+
+  // The tokens are recorded by the CPU sampler, one candidate at a time.
+  session_config.SetNumOutputCandidates(2);
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+  session_config.SetNumOutputCandidates(1);
+  session_config.SetSamplerBackend(Backend::GPU);
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(SessionConfigTest, MaybeUpdateAndValidateBenchmarkParams) {
+  auto model_assets = ModelAssets::Create("test_model_path_1");
+  ASSERT_OK(model_assets);
+  auto settings = EngineSettings::CreateDefault(*model_assets);
+  ASSERT_OK(settings);
+  FakeTokenizer tokenizer;
+  proto::LlmMetadata llm_metadata = CreateLlmMetadata();
+  EXPECT_OK(settings->MaybeUpdateAndValidate(tokenizer, &llm_metadata));
+
+  auto session_config = SessionConfig::CreateDefault();
+  EXPECT_FALSE(session_config.GetBenchmarkParams().has_value());
+  session_config.GetMutableBenchmarkParams().set_num_prefill_tokens(512);
+  // The engine does not benchmark.
+  EXPECT_THAT(session_config.MaybeUpdateAndValidate(*settings),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+  settings->GetMutableBenchmarkParams();
+  EXPECT_OK(session_config.MaybeUpdateAndValidate(*settings));
+  EXPECT_EQ(session_config.GetBenchmarkParams()->num_prefill_tokens(), 512);
+}
+
 }  // namespace
 }  // namespace litert::lm
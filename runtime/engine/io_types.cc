@@ -1,5 +1,8 @@
 #include "runtime/engine/io_types.h"
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <iomanip>
@@ -10,12 +13,14 @@
 #include <optional>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
 #include "absl/log/log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "absl/time/clock.h"  // from @com_google_absl
@@ -30,6 +35,13 @@ std::optional<std::string> ToString(const InputData& input_data) {
   return std::nullopt;
 }
 
+std::optional<absl::string_view> ToStringView(const InputData& input_data) {
+  if (const auto* input_text = std::get_if<InputText>(&input_data)) {
+    return input_text->GetData();
+  }
+  return std::nullopt;
+}
+
 // A container to host the model responses.
 Responses::Responses(int num_output_candidates)
     : num_output_candidates_(num_output_candidates) {
@@ -69,6 +81,26 @@ std::vector<float>& Responses::GetMutableScores() {
   return scores_;
 }
 
+absl::StatusOr<absl::Span<const std::vector<TokenLogProb>>>
+Responses::GetTopLogProbsAt(int index) const {
+  if (top_log_probs_.empty()) {
+    return absl::InvalidArgumentError("Top log-probabilities are not set.");
+  }
+  if (index < 0 || index >= top_log_probs_.size()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Index ", index, " is out of range [0, ", top_log_probs_.size(), ")."));
+  }
+  return absl::MakeConstSpan(top_log_probs_[index]);
+}
+
+std::vector<std::vector<std::vector<TokenLogProb>>>&
+Responses::GetMutableTopLogProbs() {
+  if (top_log_probs_.empty()) {
+    top_log_probs_.resize(num_output_candidates_);
+  }
+  return top_log_probs_;
+}
+
 std::ostream& operator<<(std::ostream& os, const Responses& responses) {
   if (responses.GetNumOutputCandidates() == 0) {
     os << " No reponses." << std::endl;
@@ -97,6 +129,52 @@ std::ostream& operator<<(std::ostream& os, const Responses& responses) {
   return os;  // Return the ostream to allow chaining
 }
 
+// --- LatencyHistogram Method Definitions ---
+void LatencyHistogram::Record(absl::Duration latency) {
+  counts_[GetBucketIndex(absl::ToInt64Microseconds(latency))]++;
+  count_++;
+  max_ = std::max(max_, latency);
+}
+
+absl::Duration LatencyHistogram::GetPercentile(double percentile) const {
+  if (count_ == 0) {
+    return absl::ZeroDuration();
+  }
+  // The rank of the latency in the sorted latencies, from 1.
+  const uint64_t rank = std::clamp<uint64_t>(
+      static_cast<uint64_t>(std::ceil(percentile / 100.0 * count_)), 1,
+      count_);
+  uint64_t num_latencies = 0;
+  for (int i = 0; i < kNumBuckets; ++i) {
+    num_latencies += counts_[i];
+    if (num_latencies >= rank) {
+      return std::min(absl::Microseconds(GetBucketUpperBound(i)), max_);
+    }
+  }
+  return max_;
+}
+
+int LatencyHistogram::GetBucketIndex(int64_t micros) {
+  const uint64_t value = std::clamp<int64_t>(
+      micros, 0, (int64_t{1} << kMaxMagnitude) - 1);
+  if (value < kNumSubBuckets) {
+    return value;
+  }
+  const int magnitude = std::bit_width(value) - 1;
+  const int shift = magnitude - kSubBucketBits;
+  return kNumSubBuckets + shift * kNumSubBuckets +
+         static_cast<int>((value >> shift) - kNumSubBuckets);
+}
+
+int64_t LatencyHistogram::GetBucketUpperBound(int index) {
+  if (index < kNumSubBuckets) {
+    return index;
+  }
+  const int shift = (index - kNumSubBuckets) / kNumSubBuckets;
+  const int64_t sub_bucket = kNumSubBuckets + index % kNumSubBuckets;
+  return ((sub_bucket + 1) << shift) - 1;
+}
+
 // --- BenchmarkTurnData Method Definitions ---
 BenchmarkTurnData::BenchmarkTurnData(uint64_t tokens, absl::Duration dur)
     : duration(dur), num_tokens(tokens) {}
@@ -108,6 +186,11 @@ const proto::BenchmarkParams& BenchmarkInfo::GetBenchmarkParams() const {
   return benchmark_params_;
 }
 
+void BenchmarkInfo::SetBenchmarkParams(
+    const proto::BenchmarkParams& benchmark_params) {
+  benchmark_params_ = benchmark_params;
+}
+
 absl::Status BenchmarkInfo::TimeInitPhaseStart(const std::string& phase_name) {
   if (start_time_map_.contains(phase_name)) {
     return absl::InternalError(
@@ -126,6 +209,15 @@ absl::Status BenchmarkInfo::TimeInitPhaseEnd(const std::string& phase_name) {
   return absl::OkStatus();
 }
 
+void BenchmarkInfo::AddInitPhase(const std::string& phase_name,
+                                 absl::Duration duration) {
+  init_phases_[phase_name] += duration;
+}
+
+void BenchmarkInfo::SetModelPageCacheResidency(double resident_fraction) {
+  model_page_cache_residency_ = resident_fraction;
+}
+
 absl::Status BenchmarkInfo::TimeMarkDelta(const std::string& mark_name) {
   if (mark_time_map_.contains(mark_name)) {
     mark_durations_[mark_name] = absl::Now() - mark_time_map_[mark_name];
@@ -146,6 +238,22 @@ absl::Status BenchmarkInfo::TimePrefillTurnStart() {
         absl::StrCat("Prefill turn ", phase_name, " already started."));
   }
   start_time_map_[phase_name] = absl::Now();
+  last_prefill_step_time_ = start_time_map_[phase_name];
+  if (!first_token_start_time_.has_value()) {
+    first_token_start_time_ = start_time_map_[phase_name];
+  }
+  return absl::OkStatus();
+}
+
+absl::Status BenchmarkInfo::TimePrefillStep() {
+  const std::string phase_name = absl::StrCat("prefill:", prefill_turn_index_);
+  if (!start_time_map_.contains(phase_name)) {
+    return absl::InternalError(
+        absl::StrCat("Prefill turn ", phase_name, " not started."));
+  }
+  const absl::Time now = absl::Now();
+  prefill_step_latencies_.Record(now - last_prefill_step_time_);
+  last_prefill_step_time_ = now;
   return absl::OkStatus();
 }
 
@@ -172,6 +280,23 @@ absl::Status BenchmarkInfo::TimeDecodeTurnStart() {
         absl::StrCat("Decode turn ", phase_name, " already started."));
   }
   start_time_map_[phase_name] = absl::Now();
+  last_decode_step_time_ = start_time_map_[phase_name];
+  return absl::OkStatus();
+}
+
+absl::Status BenchmarkInfo::TimeDecodeStep() {
+  const std::string phase_name = absl::StrCat("decode:", decode_turn_index_);
+  if (!start_time_map_.contains(phase_name)) {
+    return absl::InternalError(
+        absl::StrCat("Decode turn ", phase_name, " not started."));
+  }
+  const absl::Time now = absl::Now();
+  decode_step_latencies_.Record(now - last_decode_step_time_);
+  last_decode_step_time_ = now;
+  if (first_token_start_time_.has_value()) {
+    time_to_first_tokens_.Record(now - *first_token_start_time_);
+    first_token_start_time_ = std::nullopt;
+  }
   return absl::OkStatus();
 }
 
@@ -196,6 +321,15 @@ const std::map<std::string, absl::Duration>& BenchmarkInfo::GetInitPhases()
   return init_phases_;
 }
 
+std::optional<double> BenchmarkInfo::GetModelPageCacheResidency() const {
+  return model_page_cache_residency_;
+}
+
+bool BenchmarkInfo::IsColdStart() const {
+  return model_page_cache_residency_.has_value() &&
+         *model_page_cache_residency_ < 0.5;
+}
+
 uint64_t BenchmarkInfo::GetTotalPrefillTurns() const {
   return prefill_turns_.size();
 }
@@ -244,6 +378,135 @@ double BenchmarkInfo::GetDecodeTokensPerSec(int turn_index) const {
   return static_cast<double>(turn.num_tokens) / turn_seconds;
 }
 
+void BenchmarkInfo::RecordPrefixCacheLookup(bool hit,
+                                            uint64_t num_reused_tokens,
+                                            uint64_t size_in_bytes) {
+  if (hit) {
+    prefix_cache_hits_++;
+    prefix_cache_reused_tokens_ += num_reused_tokens;
+  } else {
+    prefix_cache_misses_++;
+  }
+  prefix_cache_size_in_bytes_ = size_in_bytes;
+}
+
+uint64_t BenchmarkInfo::GetPrefixCacheHits() const {
+  return prefix_cache_hits_;
+}
+
+uint64_t BenchmarkInfo::GetPrefixCacheMisses() const {
+  return prefix_cache_misses_;
+}
+
+double BenchmarkInfo::GetPrefixCacheHitRate() const {
+  const uint64_t lookups = prefix_cache_hits_ + prefix_cache_misses_;
+  if (lookups == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(prefix_cache_hits_) / lookups;
+}
+
+uint64_t BenchmarkInfo::GetPrefixCacheReusedTokens() const {
+  return prefix_cache_reused_tokens_;
+}
+
+uint64_t BenchmarkInfo::GetPrefixCacheSizeInBytes() const {
+  return prefix_cache_size_in_bytes_;
+}
+
+void BenchmarkInfo::SetEmbeddingCacheStats(uint64_t hits, uint64_t misses,
+                                           uint64_t size_in_bytes) {
+  embedding_cache_hits_ = hits;
+  embedding_cache_misses_ = misses;
+  embedding_cache_size_in_bytes_ = size_in_bytes;
+}
+
+void BenchmarkInfo::SetPrefillChunkSize(int prefill_chunk_size) {
+  prefill_chunk_size_ = prefill_chunk_size;
+}
+
+std::optional<int> BenchmarkInfo::GetPrefillChunkSize() const {
+  return prefill_chunk_size_;
+}
+
+uint64_t BenchmarkInfo::GetEmbeddingCacheHits() const {
+  return embedding_cache_hits_;
+}
+
+uint64_t BenchmarkInfo::GetEmbeddingCacheMisses() const {
+  return embedding_cache_misses_;
+}
+
+double BenchmarkInfo::GetEmbeddingCacheHitRate() const {
+  const uint64_t lookups = embedding_cache_hits_ + embedding_cache_misses_;
+  if (lookups == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(embedding_cache_hits_) / lookups;
+}
+
+uint64_t BenchmarkInfo::GetEmbeddingCacheSizeInBytes() const {
+  return embedding_cache_size_in_bytes_;
+}
+
+void BenchmarkInfo::RecordSpeculativeDecodingStep(
+    uint64_t num_draft_tokens, uint64_t num_accepted_tokens) {
+  speculative_decoding_steps_++;
+  speculative_draft_tokens_ += num_draft_tokens;
+  speculative_accepted_tokens_ += num_accepted_tokens;
+}
+
+uint64_t BenchmarkInfo::GetSpeculativeDecodingSteps() const {
+  return speculative_decoding_steps_;
+}
+
+uint64_t BenchmarkInfo::GetSpeculativeDraftTokens() const {
+  return speculative_draft_tokens_;
+}
+
+uint64_t BenchmarkInfo::GetSpeculativeAcceptedTokens() const {
+  return speculative_accepted_tokens_;
+}
+
+double BenchmarkInfo::GetSpeculativeAcceptanceRate() const {
+  if (speculative_draft_tokens_ == 0) {
+    return 0.0;
+  }
+  return static_cast<double>(speculative_accepted_tokens_) /
+         speculative_draft_tokens_;
+}
+
+void BenchmarkInfo::SetExecutorStageLatencies(
+    std::map<std::string, absl::Duration> stage_latencies) {
+  executor_stage_latencies_ = std::move(stage_latencies);
+}
+
+const std::map<std::string, absl::Duration>&
+BenchmarkInfo::GetExecutorStageLatencies() const {
+  return executor_stage_latencies_;
+}
+
+const LatencyHistogram& BenchmarkInfo::GetPrefillStepLatencies() const {
+  return prefill_step_latencies_;
+}
+
+const LatencyHistogram& BenchmarkInfo::GetDecodeStepLatencies() const {
+  return decode_step_latencies_;
+}
+
+const LatencyHistogram& BenchmarkInfo::GetTimeToFirstTokens() const {
+  return time_to_first_tokens_;
+}
+
+std::ostream& operator<<(std::ostream& os, const LatencyHistogram& histogram) {
+  os << "p50: " << absl::ToDoubleMilliseconds(histogram.GetPercentile(50))
+     << " ms, p90: " << absl::ToDoubleMilliseconds(histogram.GetPercentile(90))
+     << " ms, p99: " << absl::ToDoubleMilliseconds(histogram.GetPercentile(99))
+     << " ms, max: " << absl::ToDoubleMilliseconds(histogram.GetMax())
+     << " ms";
+  return os;
+}
+
 std::ostream& operator<<(std::ostream& os, const BenchmarkTurnData& data) {
   os << "Processed " << data.num_tokens << " tokens in " << data.duration
      << " duration." << std::endl;
@@ -260,12 +523,23 @@ std::ostream& operator<<(std::ostream& os, const BenchmarkInfo& info) {
   } else {
     double total_time = 0.0;
     for (const auto& phase : info.GetInitPhases()) {
-      total_time += absl::ToDoubleMilliseconds(phase.second);
-      os << "    - " << phase.first << ": "
-         << absl::ToDoubleMilliseconds(phase.second) << " ms" << std::endl;
+      // The steps of a phase are indented under it, and not counted twice.
+      const int depth =
+          std::count(phase.first.begin(), phase.first.end(), '/');
+      if (depth == 0) {
+        total_time += absl::ToDoubleMilliseconds(phase.second);
+      }
+      os << "    " << std::string(2 * depth, ' ') << "- " << phase.first
+         << ": " << absl::ToDoubleMilliseconds(phase.second) << " ms"
+         << std::endl;
     }
     os << "    Total init time: " << total_time << " ms" << std::endl;
   }
+  if (info.GetModelPageCacheResidency().has_value()) {
+    os << "    Model page cache: " << (info.IsColdStart() ? "cold" : "warm")
+       << " (" << *info.GetModelPageCacheResidency() * 100
+       << "% of the model file was cached)" << std::endl;
+  }
 
   os << "--------------------------------------------------" << std::endl;
   os << "  Prefill Turns (Total: " << info.GetTotalPrefillTurns()
@@ -280,6 +554,10 @@ std::ostream& operator<<(std::ostream& os, const BenchmarkInfo& info) {
          << std::endl;
     }
   }
+  if (info.GetPrefillChunkSize().has_value()) {
+    os << "    Prefill Chunk Size: " << *info.GetPrefillChunkSize()
+       << " tokens (autotuned)" << std::endl;
+  }
 
   os << "--------------------------------------------------" << std::endl;
   os << "  Decode Turns (Total: " << info.GetTotalDecodeTurns()
@@ -296,6 +574,18 @@ std::ostream& operator<<(std::ostream& os, const BenchmarkInfo& info) {
   }
   os << "--------------------------------------------------" << std::endl;
 
+  if (info.GetTimeToFirstTokens().GetCount() > 0) {
+    os << "  Time To First Token (" << info.GetTimeToFirstTokens().GetCount()
+       << "): " << info.GetTimeToFirstTokens() << std::endl;
+  }
+  if (info.GetPrefillStepLatencies().GetCount() > 0) {
+    os << "  Prefill Step Latency ("
+       << info.GetPrefillStepLatencies().GetCount() << "): " << info.GetPrefillStepLatencies() << std::endl;
+  }
+  if (info.GetDecodeStepLatencies().GetCount() > 0) {
+    os << "  Inter-Token Latency (" << info.GetDecodeStepLatencies().GetCount()
+       << "): " << info.GetDecodeStepLatencies() << std::endl;
+  }
   if (!info.GetMarkDurations().empty()) {
     os << "  Mark Durations (" << info.GetMarkDurations().size() << "):"
        << std::endl;
@@ -303,6 +593,44 @@ std::ostream& operator<<(std::ostream& os, const BenchmarkInfo& info) {
       os << "    - " << mark_name << ": " << duration << std::endl;
     }
   }
+  if (!info.GetExecutorStageLatencies().empty()) {
+    os << "  Executor Stages (" << info.GetExecutorStageLatencies().size()
+       << "):" << std::endl;
+    for (const auto& [stage_name, latency] :
+         info.GetExecutorStageLatencies()) {
+      os << "    - " << stage_name << ": "
+         << absl::ToDoubleMilliseconds(latency) << " ms" << std::endl;
+    }
+  }
+  if (info.GetPrefixCacheHits() + info.GetPrefixCacheMisses() > 0) {
+    os << "  Prefix Cache:" << std::endl;
+    os << "    Hits: " << info.GetPrefixCacheHits()
+       << ", Misses: " << info.GetPrefixCacheMisses()
+       << ", Hit Rate: " << info.GetPrefixCacheHitRate() * 100 << "%"
+       << std::endl;
+    os << "    Reused Tokens: " << info.GetPrefixCacheReusedTokens()
+       << std::endl;
+    os << "    Size: " << info.GetPrefixCacheSizeInBytes() << " bytes"
+       << std::endl;
+  }
+  if (info.GetEmbeddingCacheHits() + info.GetEmbeddingCacheMisses() > 0) {
+    os << "  Embedding Cache:" << std::endl;
+    os << "    Hits: " << info.GetEmbeddingCacheHits()
+       << ", Misses: " << info.GetEmbeddingCacheMisses()
+       << ", Hit Rate: " << info.GetEmbeddingCacheHitRate() * 100 << "%"
+       << std::endl;
+    os << "    Size: " << info.GetEmbeddingCacheSizeInBytes() << " bytes"
+       << std::endl;
+  }
+  if (info.GetSpeculativeDecodingSteps() > 0) {
+    os << "  Speculative Decoding:" << std::endl;
+    os << "    Steps: " << info.GetSpeculativeDecodingSteps()
+       << ", Draft Tokens: " << info.GetSpeculativeDraftTokens()
+       << ", Accepted Tokens: " << info.GetSpeculativeAcceptedTokens()
+       << std::endl;
+    os << "    Acceptance Rate: " << info.GetSpeculativeAcceptanceRate() * 100
+       << "%" << std::endl;
+  }
   os << "--------------------------------------------------" << std::endl;
   return os;
 }
@@ -312,6 +640,13 @@ void InferenceObservable::OnNext(const Responses& responses) {
   std::cout << *responses.GetResponseTextAt(0) << std::flush;
 }
 
+void InferenceObservable::OnNextText(int candidate_index,
+                                     absl::string_view text) {
+  if (candidate_index == 0) {
+    std::cout << text << std::flush;
+  }
+}
+
 // Called when the inference is done and finished successfully.
 void InferenceObservable::OnDone() {
   LOG(INFO) << "Inference Done." << std::endl;
@@ -322,4 +657,84 @@ void InferenceObservable::OnError(const absl::Status& status) {
   LOG(ERROR) << "Inference Error: " << status.message() << std::endl;
 }
 
+void CoalescingObservable::OnNext(const Responses& responses) {
+  const int num_candidates = responses.GetNumOutputCandidates();
+  if (texts_.size() != num_candidates) {
+    Flush();
+    texts_.resize(num_candidates);
+  }
+  bool has_newline = false;
+  scores_.clear();
+  for (int i = 0; i < num_candidates; ++i) {
+    const absl::string_view text = *responses.GetResponseTextAt(i);
+    has_newline |= absl::StrContains(text, '\n');
+    texts_[i].append(text.data(), text.size());
+    if (absl::StatusOr<float> score = responses.GetScoreAt(i); score.ok()) {
+      scores_.push_back(*score);
+    }
+    if (auto top_log_probs = responses.GetTopLogProbsAt(i);
+        top_log_probs.ok()) {
+      top_log_probs_.resize(num_candidates);
+      top_log_probs_[i].insert(top_log_probs_[i].end(), top_log_probs->begin(),
+                               top_log_probs->end());
+    }
+  }
+  const bool delayed = options_.max_delay != absl::InfiniteDuration();
+  const absl::Time now = delayed ? absl::Now() : absl::InfinitePast();
+  if (num_responses_ == 0) {
+    first_response_time_ = now;
+  }
+  ++num_responses_;
+  if (num_responses_ >= options_.max_num_responses ||
+      (delayed && now - first_response_time_ >= options_.max_delay) ||
+      (options_.flush_on_newline && has_newline)) {
+    Flush();
+  }
+}
+
+void CoalescingObservable::OnCandidateDone(int candidate_index) {
+  Flush();
+  observer_.OnCandidateDone(candidate_index);
+}
+
+void CoalescingObservable::OnDone() {
+  Flush();
+  observer_.OnDone();
+}
+
+void CoalescingObservable::OnError(const absl::Status& status) {
+  Flush();
+  observer_.OnError(status);
+}
+
+void CoalescingObservable::Flush() {
+  if (num_responses_ == 0) {
+    return;
+  }
+  num_responses_ = 0;
+  if (options_.text_only) {
+    for (int i = 0; i < texts_.size(); ++i) {
+      if (!texts_[i].empty()) {
+        observer_.OnNextText(i, texts_[i]);
+      }
+    }
+  } else {
+    // The texts are moved in and out of the responses to keep their buffers.
+    Responses responses(texts_.size());
+    responses.GetMutableResponseTexts().swap(texts_);
+    if (scores_.size() == responses.GetNumOutputCandidates()) {
+      responses.GetMutableScores() = scores_;
+    }
+    if (!top_log_probs_.empty()) {
+      responses.GetMutableTopLogProbs().swap(top_log_probs_);
+    }
+    observer_.OnNext(responses);
+    texts_.swap(responses.GetMutableResponseTexts());
+  }
+  top_log_probs_.clear();
+  for (std::string& text : texts_) {
+    text.clear();
+  }
+}
+
 }  // namespace litert::lm
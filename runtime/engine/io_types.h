@@ -15,32 +15,46 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_IO_TYPES_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_IO_TYPES_H_
 
+#include <array>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <optional>
 #include <ostream>
 #include <string>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#include "absl/base/nullability.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "runtime/proto/engine.pb.h"
 
 namespace litert::lm {
 
-// A container to host the input text.
+// A container to host the input text. The text is shared by the copies of
+// the container, such that passing a large document around, e.g. to the
+// thread prefilling it, does not copy it.
 class InputText {
  public:
-  explicit InputText(absl::string_view text) : text_(text) {}
+  // Copies `text`.
+  explicit InputText(absl::string_view text)
+      : text_(std::make_shared<const std::string>(text)) {}
+
+  // Shares `text`, e.g. moved in with
+  // InputText(std::make_shared<const std::string>(std::move(text))).
+  explicit InputText(std::shared_ptr<const std::string> text)
+      : text_(std::move(text)) {}
 
   // Returns the input text.
-  absl::string_view GetData() const { return text_; }
+  absl::string_view GetData() const { return *text_; }
 
  private:
-  std::string text_;
+  std::shared_ptr<const std::string> text_;
 };
 
 // A container to host the input data. Will be extended to support more input
@@ -49,6 +63,29 @@ using InputData = std::variant<InputText>;
 // Converts the input data to a string. It returns nullopt if the input data
 // is not an InputText.
 std::optional<std::string> ToString(const InputData& input_data);
+// Same as ToString(), but refers to the text of the input data instead of
+// copying it.
+std::optional<absl::string_view> ToStringView(const InputData& input_data);
+
+// The role of a text appended to the context of a session, whose prompt
+// template affixes are put around it.
+enum class PromptRole {
+  // The text is appended as is, e.g. already formatted by the caller, or
+  // continuing the turn of the model.
+  kRaw,
+  // Between the user prefix, and the user suffix followed by the model
+  // prefix, e.g. for a tool result.
+  kUser,
+  // Between the system prefix, and the system suffix followed by the model
+  // prefix.
+  kSystem,
+};
+
+// One of the most likely tokens at a decoded step, with its log-probability.
+struct TokenLogProb {
+  int token_id = -1;
+  float log_prob = 0.0f;
+};
 
 // A container to host the model responses.
 class Responses {
@@ -77,6 +114,18 @@ class Responses {
   // (= log(0.0f)).
   std::vector<float>& GetMutableScores();
 
+  // Returns the most likely tokens of each step decoded into the response at
+  // the given index, from the most likely, if the session config asks for
+  // them. Returns error if the index is out of range or if they are not
+  // included.
+  absl::StatusOr<absl::Span<const std::vector<TokenLogProb>>> GetTopLogProbsAt(
+      int index) const;
+
+  // Returns the mutable top log-probabilities, the steps of each candidate. If
+  // it is the first time calling this function, the vector will be allocated
+  // to the size of num_output_candidates_ with no steps.
+  std::vector<std::vector<std::vector<TokenLogProb>>>& GetMutableTopLogProbs();
+
  private:
   // The number of output candidates.
   int num_output_candidates_;
@@ -87,6 +136,9 @@ class Responses {
   // The output vector of scores for each response text. The "score" is pulled
   // from the probability of the last token in the response text.
   std::vector<float> scores_;
+
+  // The most likely tokens of each decoded step of each response text.
+  std::vector<std::vector<std::vector<TokenLogProb>>> top_log_probs_;
 };
 std::ostream& operator<<(std::ostream& os, const Responses& responses);
 
@@ -99,12 +151,49 @@ struct BenchmarkTurnData {
 };
 std::ostream& operator<<(std::ostream& os, const BenchmarkTurnData& data);
 
+// A histogram of latencies in fixed memory, in the style of HdrHistogram: each
+// power of two of microseconds is split in kNumSubBuckets linear buckets, so
+// the percentiles are reported within 1/kNumSubBuckets of the recorded
+// latencies, from a microsecond up to 2^kMaxMagnitude microseconds (19 hours),
+// above which the latencies are clamped.
+class LatencyHistogram {
+ public:
+  void Record(absl::Duration latency);
+
+  uint64_t GetCount() const { return count_; }
+  absl::Duration GetMax() const { return max_; }
+  // Returns the latency that "percentile" percent of the recorded latencies
+  // do not exceed, e.g. GetPercentile(99) for the p99, or zero if none was
+  // recorded.
+  absl::Duration GetPercentile(double percentile) const;
+
+ private:
+  static constexpr int kSubBucketBits = 5;
+  static constexpr int kNumSubBuckets = 1 << kSubBucketBits;
+  static constexpr int kMaxMagnitude = 36;
+  // The latencies below kNumSubBuckets microseconds are counted exactly, then
+  // each magnitude has kNumSubBuckets buckets.
+  static constexpr int kNumBuckets =
+      kNumSubBuckets + (kMaxMagnitude - kSubBucketBits) * kNumSubBuckets;
+
+  static int GetBucketIndex(int64_t micros);
+  // Returns the highest latency counted by the bucket, in microseconds.
+  static int64_t GetBucketUpperBound(int index);
+
+  std::array<uint64_t, kNumBuckets> counts_ = {};
+  uint64_t count_ = 0;
+  absl::Duration max_ = absl::ZeroDuration();
+};
+std::ostream& operator<<(std::ostream& os, const LatencyHistogram& histogram);
+
 // Class to store and manage comprehensive performance benchmark information for
 // LLMs.
 class BenchmarkInfo {
  public:
   explicit BenchmarkInfo(const proto::BenchmarkParams& benchmark_params);
   const proto::BenchmarkParams& GetBenchmarkParams() const;
+  // Replaces the parameters, e.g. with the ones of a session.
+  void SetBenchmarkParams(const proto::BenchmarkParams& benchmark_params);
 
   // --- Methods to record data ---
   // Time the start and end of a phase in the initialization. The phase name
@@ -112,6 +201,12 @@ class BenchmarkInfo {
   // methods will return an error.
   absl::Status TimeInitPhaseStart(const std::string& phase_name);
   absl::Status TimeInitPhaseEnd(const std::string& phase_name);
+  // Adds a phase of the initialization timed elsewhere, e.g. a step of a phase
+  // named "<phase>/<step>". The durations of a repeated phase add up.
+  void AddInitPhase(const std::string& phase_name, absl::Duration duration);
+  // Records the fraction of the model file which was in the page cache before
+  // it was loaded, i.e. whether the initialization was a cold start.
+  void SetModelPageCacheResidency(double resident_fraction);
   // Time the start and end of a prefill/decode turn. The num_prefill_tokens
   // should be the number of tokens processed in this turn. The method will
   // return an error if the methods are called out of order (i.e. one end after
@@ -120,6 +215,14 @@ class BenchmarkInfo {
   absl::Status TimePrefillTurnEnd(uint64_t num_prefill_tokens);
   absl::Status TimeDecodeTurnStart();
   absl::Status TimeDecodeTurnEnd(uint64_t num_decode_tokens);
+  // Time the end of a step of the current prefill / decode turn, i.e. of an
+  // executor call prefilling a run of the prompt or of a decoded token. The
+  // step latency is measured since the previous step of the turn, or its
+  // start. The first decode step after a prefill also records the time to
+  // first token, since the start of the first prefill turn before it. The
+  // methods will return an error if no turn is started.
+  absl::Status TimePrefillStep();
+  absl::Status TimeDecodeStep();
   // Time the duration between two consecutive marks. Useful for profiling the
   // pipeline at a specific point. For example:
   //   RETURN_IF_ERROR(benchmark_info.TimeMarkDelta("sampling"));
@@ -130,21 +233,84 @@ class BenchmarkInfo {
   // TimeMarkDelta("sampling") calls. The duration will be stored / recorded for
   // each unique mark name.
   absl::Status TimeMarkDelta(const std::string& mark_name);
+  // Records the outcome of a prefix cache lookup. On a hit, num_reused_tokens
+  // is the number of prefill tokens restored from the cache instead of being
+  // prefilled. size_in_bytes is the memory held by the prefix cache after the
+  // lookup.
+  void RecordPrefixCacheLookup(bool hit, uint64_t num_reused_tokens,
+                               uint64_t size_in_bytes);
+  // Records one speculative decoding step, in which num_draft_tokens tokens
+  // were proposed by the draft model and num_accepted_tokens of them were
+  // accepted by the main model.
+  void RecordSpeculativeDecodingStep(uint64_t num_draft_tokens,
+                                     uint64_t num_accepted_tokens);
+  // Sets the latencies accumulated by each stage of the executor, e.g.
+  // "decode_inference", replacing the previously set ones. The stage names are
+  // shared by the backends, such that their breakdowns print side by side.
+  void SetExecutorStageLatencies(
+      std::map<std::string, absl::Duration> stage_latencies);
+  // Sets the statistics of the decode embedding cache of the executor, which
+  // are accumulated over the lifetime of the executor. size_in_bytes is the
+  // memory held by the cache.
+  void SetEmbeddingCacheStats(uint64_t hits, uint64_t misses,
+                              uint64_t size_in_bytes);
+  // Sets the prefill chunk size of the highest throughput measured on the
+  // device by the executor, when it autotunes its prefill work groups.
+  void SetPrefillChunkSize(int prefill_chunk_size);
 
   // --- Getters for raw data ---
   const std::map<std::string, absl::Duration>& GetInitPhases() const;
+  // The fraction of the model file in the page cache before it was loaded, if
+  // known.
+  std::optional<double> GetModelPageCacheResidency() const;
+  // Whether most of the model file had to be read from the disk.
+  bool IsColdStart() const;
   const std::map<std::string, absl::Duration>& GetMarkDurations() const;
+  const std::map<std::string, absl::Duration>& GetExecutorStageLatencies()
+      const;
+
+  // --- Latency distributions over all the turns ---
+  const LatencyHistogram& GetPrefillStepLatencies() const;
+  // The inter-token latencies, whose maximum is the longest stall of the
+  // decoding.
+  const LatencyHistogram& GetDecodeStepLatencies() const;
+  const LatencyHistogram& GetTimeToFirstTokens() const;
 
   // --- Calculated metrics and getters for Prefill ---
   uint64_t GetTotalPrefillTurns() const;
   const BenchmarkTurnData& GetPrefillTurn(int turn_index) const;
   double GetPrefillTokensPerSec(int turn_index) const;
+  // The prefill chunk size autotuned by the executor, if any.
+  std::optional<int> GetPrefillChunkSize() const;
 
   // --- Calculated metrics and getters for Decode ---
   uint64_t GetTotalDecodeTurns() const;
   const BenchmarkTurnData& GetDecodeTurn(int turn_index) const;
   double GetDecodeTokensPerSec(int turn_index) const;
 
+  // --- Calculated metrics and getters for the prefix cache ---
+  uint64_t GetPrefixCacheHits() const;
+  uint64_t GetPrefixCacheMisses() const;
+  // Returns the ratio of hits over all lookups, or 0 if there was no lookup.
+  double GetPrefixCacheHitRate() const;
+  uint64_t GetPrefixCacheReusedTokens() const;
+  uint64_t GetPrefixCacheSizeInBytes() const;
+
+  // --- Calculated metrics and getters for the decode embedding cache ---
+  uint64_t GetEmbeddingCacheHits() const;
+  uint64_t GetEmbeddingCacheMisses() const;
+  // Returns the ratio of hits over all lookups, or 0 if there was no lookup.
+  double GetEmbeddingCacheHitRate() const;
+  uint64_t GetEmbeddingCacheSizeInBytes() const;
+
+  // --- Calculated metrics and getters for speculative decoding ---
+  uint64_t GetSpeculativeDecodingSteps() const;
+  uint64_t GetSpeculativeDraftTokens() const;
+  uint64_t GetSpeculativeAcceptedTokens() const;
+  // Returns the ratio of accepted over proposed draft tokens, or 0 if no draft
+  // token was proposed.
+  double GetSpeculativeAcceptanceRate() const;
+
  private:
   proto::BenchmarkParams benchmark_params_;
 
@@ -156,9 +322,35 @@ class BenchmarkInfo {
   int decode_turn_index_ = 0;
 
   std::map<std::string, absl::Duration> init_phases_;
+  std::optional<double> model_page_cache_residency_;
+  std::optional<int> prefill_chunk_size_;
   std::map<std::string, absl::Duration> mark_durations_;
+  std::map<std::string, absl::Duration> executor_stage_latencies_;
   std::vector<BenchmarkTurnData> prefill_turns_;
   std::vector<BenchmarkTurnData> decode_turns_;
+
+  // The end of the last step of the current prefill / decode turn, or its
+  // start.
+  absl::Time last_prefill_step_time_;
+  absl::Time last_decode_step_time_;
+  // The start of the first prefill turn since the last decode step, if any.
+  std::optional<absl::Time> first_token_start_time_;
+  LatencyHistogram prefill_step_latencies_;
+  LatencyHistogram decode_step_latencies_;
+  LatencyHistogram time_to_first_tokens_;
+
+  uint64_t prefix_cache_hits_ = 0;
+  uint64_t prefix_cache_misses_ = 0;
+  uint64_t prefix_cache_reused_tokens_ = 0;
+  uint64_t prefix_cache_size_in_bytes_ = 0;
+
+  uint64_t embedding_cache_hits_ = 0;
+  uint64_t embedding_cache_misses_ = 0;
+  uint64_t embedding_cache_size_in_bytes_ = 0;
+
+  uint64_t speculative_decoding_steps_ = 0;
+  uint64_t speculative_draft_tokens_ = 0;
+  uint64_t speculative_accepted_tokens_ = 0;
 };
 std::ostream& operator<<(std::ostream& os, const BenchmarkInfo& info);
 
@@ -172,6 +364,16 @@ class InferenceObservable {
   // Called when a new response is generated.
   virtual void OnNext(const Responses& responses);
 
+  // Called with the new text of an output candidate instead of OnNext(), by
+  // the CoalescingObservable with StreamingFlushOptions::text_only set.
+  virtual void OnNextText(int candidate_index, absl::string_view text);
+
+  // Called when an output candidate of a decoding with several of them stops
+  // on a stop token or a stop string, after the last of its text, while the
+  // others may still be decoded. The candidates decoded to the end of the
+  // inference, e.g. to the max number of tokens, are only ended by OnDone().
+  virtual void OnCandidateDone(int candidate_index) {}
+
   // Called when the inference is done and finished successfully.
   virtual void OnDone();
 
@@ -179,6 +381,93 @@ class InferenceObservable {
   virtual void OnError(const absl::Status& status);
 };
 
+// When a CoalescingObservable sends the text it has collected. The text is
+// sent once any of the conditions is met, and at the end of the inference.
+struct StreamingFlushOptions {
+  // The number of responses, i.e. of decode steps, collected at most.
+  int max_num_responses = 16;
+  // The time after the first collected response at which the next one sends
+  // the text. It is checked as the responses come, so it needs no timer.
+  absl::Duration max_delay = absl::Milliseconds(50);
+  // Whether a response with a newline sends the text.
+  bool flush_on_newline = true;
+  // Whether the text is sent to OnNextText(), per candidate, rather than to
+  // OnNext() in a Responses.
+  bool text_only = false;
+};
+
+// What a DeliveryThread does with a streamed response when the queue of its
+// consumer is full.
+enum class DeliveryOverflowPolicy {
+  // The response is appended to the last queued one of the same observer, if
+  // any, such that no text is lost and the decode does not wait.
+  kCoalesce,
+  // The decode waits for the consumer to free a place in the queue.
+  kBlock,
+  // The response is dropped, e.g. for a consumer only showing the progress.
+  kDropIntermediate,
+};
+
+inline std::ostream& operator<<(std::ostream& os,
+                                DeliveryOverflowPolicy policy) {
+  switch (policy) {
+    case DeliveryOverflowPolicy::kCoalesce:
+      return os << "COALESCE";
+    case DeliveryOverflowPolicy::kBlock:
+      return os << "BLOCK";
+    case DeliveryOverflowPolicy::kDropIntermediate:
+      return os << "DROP_INTERMEDIATE";
+  }
+  return os << "UNKNOWN";
+}
+
+// How a DeliveryThread queues the calls of the observers for their consumer.
+// OnCandidateDone(), OnDone() and OnError() are never coalesced nor dropped:
+// past the bound, they wait with kBlock, and are queued anyway otherwise.
+struct DeliveryOptions {
+  // The number of calls queued at most before the overflow policy applies.
+  int max_queued_calls = 64;
+  DeliveryOverflowPolicy overflow_policy = DeliveryOverflowPolicy::kCoalesce;
+};
+
+// An observer collecting the responses streamed to it, and sending them to
+// another observer in fewer, longer responses, e.g. when each call crosses
+// into another language. The scores sent are the ones of the last response.
+// The observer must outlive it. Example usage:
+//
+//   CoalescingObservable coalescing_observer(&observer,
+//                                            StreamingFlushOptions());
+//   RETURN_IF_ERROR(session->RunDecodeAsync(&coalescing_observer));
+class CoalescingObservable : public InferenceObservable {
+ public:
+  CoalescingObservable(InferenceObservable* absl_nonnull observer,
+                       const StreamingFlushOptions& options)
+      : observer_(*observer), options_(options) {}
+
+  void OnNext(const Responses& responses) override;
+
+  // Sends the collected text before forwarding the call.
+  void OnCandidateDone(int candidate_index) override;
+  void OnDone() override;
+  void OnError(const absl::Status& status) override;
+
+  // Sends the collected text, if any.
+  void Flush();
+
+ private:
+  InferenceObservable& observer_;
+  const StreamingFlushOptions options_;
+  // The collected text of each candidate.
+  std::vector<std::string> texts_;
+  // The scores of the last response, empty if it had none.
+  std::vector<float> scores_;
+  // The collected top log-probabilities of each candidate, empty if the
+  // responses had none.
+  std::vector<std::vector<std::vector<TokenLogProb>>> top_log_probs_;
+  int num_responses_ = 0;
+  absl::Time first_response_time_;
+};
+
 }  // namespace litert::lm
 
 #endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_IO_TYPES_H_
@@ -1,11 +1,17 @@
 #include "runtime/engine/io_types.h"
 
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 #include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
 #include "absl/time/clock.h"  // from @com_google_absl
 #include "runtime/util/test_utils.h"  // NOLINT
@@ -16,6 +22,8 @@ namespace {
 using ::testing::status::IsOkAndHolds;
 using ::testing::status::StatusIs;
 using ::testing::ContainsRegex;
+using ::testing::ElementsAre;
+using ::testing::Pair;
 
 std::string FloatToString(float val) {
   std::ostringstream oss;
@@ -33,6 +41,16 @@ TEST(InputTextTest, ToString) {
   EXPECT_EQ(ToString(input_data), "Hello World!");
 }
 
+TEST(InputTextTest, CopiesShareTheText) {
+  auto text = std::make_shared<const std::string>("Hello World!");
+  InputData input_data = InputText(text);
+  InputData input_data_copy = input_data;
+  std::optional<absl::string_view> view = ToStringView(input_data_copy);
+  ASSERT_TRUE(view.has_value());
+  EXPECT_EQ(*view, "Hello World!");
+  EXPECT_EQ(view->data(), text->data());
+}
+
 TEST(ResponsesTest, GetResponseTextAt) {
   Responses responses(/*num_output_candidates=*/2);
   responses.GetMutableResponseTexts()[0] = "Hello World!";
@@ -69,6 +87,21 @@ TEST(ResponsesTest, HasScores) {
   responses.GetMutableScores()[1] = 0.2;
 }
 
+TEST(ResponsesTest, GetTopLogProbsAt) {
+  Responses responses(/*num_output_candidates=*/2);
+  EXPECT_THAT(responses.GetTopLogProbsAt(0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  responses.GetMutableTopLogProbs()[1].push_back(
+      {{.token_id = 5, .log_prob = -0.1f}, {.token_id = 3, .log_prob = -2.5f}});
+  auto top_log_probs = responses.GetTopLogProbsAt(1);
+  ASSERT_OK(top_log_probs);
+  ASSERT_EQ(top_log_probs->size(), 1);
+  EXPECT_EQ((*top_log_probs)[0][1].token_id, 3);
+  EXPECT_THAT(responses.GetTopLogProbsAt(0), IsOkAndHolds(testing::IsEmpty()));
+  EXPECT_THAT(responses.GetTopLogProbsAt(2),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 TEST(ResponsesTest, GetMutableResponseTexts) {
   Responses responses(/*num_output_candidates=*/2);
   responses.GetMutableResponseTexts()[0] = "Hello World!";
@@ -125,6 +158,99 @@ proto::BenchmarkParams GetBenchmarkParams() {
 }
 
 // --- Test Init Phases ---
+// Records the calls of a CoalescingObservable.
+class RecordingObserver : public InferenceObservable {
+ public:
+  void OnNext(const Responses& responses) override {
+    texts_.push_back(std::string(*responses.GetResponseTextAt(0)));
+  }
+  void OnNextText(int candidate_index, absl::string_view text) override {
+    candidate_texts_.emplace_back(candidate_index, std::string(text));
+  }
+  // Records the candidate with the number of texts sent before it stopped.
+  void OnCandidateDone(int candidate_index) override {
+    done_candidates_.emplace_back(candidate_index, candidate_texts_.size());
+  }
+  void OnDone() override { done_ = true; }
+  void OnError(const absl::Status& status) override { status_ = status; }
+
+  std::vector<std::string> texts_;
+  std::vector<std::pair<int, std::string>> candidate_texts_;
+  std::vector<std::pair<int, int>> done_candidates_;
+  bool done_ = false;
+  absl::Status status_;
+};
+
+Responses MakeResponses(std::vector<std::string> texts) {
+  Responses responses(texts.size());
+  responses.GetMutableResponseTexts() = std::move(texts);
+  return responses;
+}
+
+TEST(CoalescingObservableTest, FlushesEveryMaxNumResponses) {
+  RecordingObserver observer;
+  StreamingFlushOptions options;
+  options.max_num_responses = 3;
+  options.max_delay = absl::InfiniteDuration();
+  CoalescingObservable coalescing_observer(&observer, options);
+  for (const char* text : {"a", "b", "c", "d"}) {
+    coalescing_observer.OnNext(MakeResponses({text}));
+  }
+  EXPECT_THAT(observer.texts_, ElementsAre("abc"));
+  coalescing_observer.OnDone();
+  EXPECT_THAT(observer.texts_, ElementsAre("abc", "d"));
+  EXPECT_TRUE(observer.done_);
+}
+
+TEST(CoalescingObservableTest, FlushesOnNewlineAndDelay) {
+  RecordingObserver observer;
+  StreamingFlushOptions options;
+  options.max_delay = absl::InfiniteDuration();
+  CoalescingObservable coalescing_observer(&observer, options);
+  for (const char* text : {"a", "b\n", "c"}) {
+    coalescing_observer.OnNext(MakeResponses({text}));
+  }
+  EXPECT_THAT(observer.texts_, ElementsAre("ab\n"));
+
+  // Without a delay, each response is sent right away.
+  RecordingObserver delay_observer;
+  options.max_delay = absl::ZeroDuration();
+  CoalescingObservable delay_coalescing_observer(&delay_observer, options);
+  for (const char* text : {"a", "b"}) {
+    delay_coalescing_observer.OnNext(MakeResponses({text}));
+  }
+  EXPECT_THAT(delay_observer.texts_, ElementsAre("a", "b"));
+}
+
+TEST(CoalescingObservableTest, SendsTextOnly) {
+  RecordingObserver observer;
+  StreamingFlushOptions options;
+  options.text_only = true;
+  CoalescingObservable coalescing_observer(&observer, options);
+  coalescing_observer.OnNext(MakeResponses({"x", ""}));
+  coalescing_observer.OnNext(MakeResponses({"y", "z"}));
+  coalescing_observer.OnError(absl::CancelledError("Cancelled."));
+  EXPECT_TRUE(observer.texts_.empty());
+  EXPECT_THAT(observer.candidate_texts_,
+              ElementsAre(Pair(0, "xy"), Pair(1, "z")));
+  EXPECT_EQ(observer.status_.code(), absl::StatusCode::kCancelled);
+}
+
+TEST(CoalescingObservableTest, SendsTheTextBeforeACandidateIsDone) {
+  RecordingObserver observer;
+  StreamingFlushOptions options;
+  options.text_only = true;
+  CoalescingObservable coalescing_observer(&observer, options);
+  coalescing_observer.OnNext(MakeResponses({"x", "y"}));
+  coalescing_observer.OnCandidateDone(1);
+  coalescing_observer.OnNext(MakeResponses({"z", ""}));
+  coalescing_observer.OnDone();
+  EXPECT_THAT(observer.candidate_texts_,
+              ElementsAre(Pair(0, "x"), Pair(1, "y"), Pair(0, "z")));
+  EXPECT_THAT(observer.done_candidates_, ElementsAre(Pair(1, 2)));
+  EXPECT_TRUE(observer.done_);
+}
+
 TEST(BenchmarkInfoTests, AddAndGetInitPhases) {
   BenchmarkInfo benchmark_info(GetBenchmarkParams());
   EXPECT_OK(benchmark_info.TimeInitPhaseStart("Model Load"));
@@ -154,6 +280,34 @@ TEST(BenchmarkInfoTests, AddInitPhaseTwice) {
               StatusIs(absl::StatusCode::kInternal));
 }
 
+TEST(BenchmarkInfoTests, AddNestedInitPhases) {
+  BenchmarkInfo benchmark_info(GetBenchmarkParams());
+  benchmark_info.AddInitPhase("Executor initialization",
+                              absl::Milliseconds(30));
+  benchmark_info.AddInitPhase("Executor initialization/Model compilation",
+                              absl::Milliseconds(10));
+  benchmark_info.AddInitPhase("Executor initialization/Model compilation",
+                              absl::Milliseconds(10));
+  benchmark_info.AddInitPhase("Tokenizer initialization",
+                              absl::Milliseconds(5));
+  benchmark_info.SetModelPageCacheResidency(0.25);
+  EXPECT_EQ(benchmark_info.GetInitPhases().at(
+                "Executor initialization/Model compilation"),
+            absl::Milliseconds(20));
+  EXPECT_TRUE(benchmark_info.IsColdStart());
+
+  std::stringstream ss;
+  ss << benchmark_info;
+  // The steps are indented under their phase, and only counted once.
+  EXPECT_THAT(ss.str(), ContainsRegex(R"(  Init Phases \(3\):
+    - Executor initialization: 30.00 ms
+      - Executor initialization/Model compilation: 20.00 ms
+    - Tokenizer initialization: 5.00 ms
+    Total init time: 35.00 ms
+    Model page cache: cold \(25.00% of the model file was cached\)
+)"));
+}
+
 TEST(BenchmarkInfoTests, AddPrefillTurn) {
   BenchmarkInfo benchmark_info(GetBenchmarkParams());
   EXPECT_OK(benchmark_info.TimePrefillTurnStart());
@@ -235,6 +389,170 @@ TEST(BenchmarkInfoTests, AddTwoMarks) {
             absl::Milliseconds(100));
 }
 
+TEST(BenchmarkInfoTests, RecordPrefixCacheLookups) {
+  BenchmarkInfo benchmark_info(GetBenchmarkParams());
+  EXPECT_EQ(benchmark_info.GetPrefixCacheHitRate(), 0.0);
+
+  benchmark_info.RecordPrefixCacheLookup(/*hit=*/false, 0, 1024);
+  benchmark_info.RecordPrefixCacheLookup(/*hit=*/true, 30, 2048);
+  benchmark_info.RecordPrefixCacheLookup(/*hit=*/true, 20, 2048);
+  benchmark_info.RecordPrefixCacheLookup(/*hit=*/false, 0, 4096);
+  EXPECT_EQ(benchmark_info.GetPrefixCacheHits(), 2);
+  EXPECT_EQ(benchmark_info.GetPrefixCacheMisses(), 2);
+  EXPECT_EQ(benchmark_info.GetPrefixCacheHitRate(), 0.5);
+  EXPECT_EQ(benchmark_info.GetPrefixCacheReusedTokens(), 50);
+  EXPECT_EQ(benchmark_info.GetPrefixCacheSizeInBytes(), 4096);
+
+  std::stringstream ss;
+  ss << benchmark_info;
+  EXPECT_THAT(ss.str(), ContainsRegex(R"(  Prefix Cache:
+    Hits: 2, Misses: 2, Hit Rate: 50.00%
+    Reused Tokens: 50
+    Size: 4096 bytes
+)"));
+}
+
+TEST(BenchmarkInfoTests, SetEmbeddingCacheStats) {
+  BenchmarkInfo benchmark_info(GetBenchmarkParams());
+  EXPECT_EQ(benchmark_info.GetEmbeddingCacheHitRate(), 0.0);
+
+  benchmark_info.SetEmbeddingCacheStats(/*hits=*/3, /*misses=*/1,
+                                        /*size_in_bytes=*/512);
+  EXPECT_EQ(benchmark_info.GetEmbeddingCacheHits(), 3);
+  EXPECT_EQ(benchmark_info.GetEmbeddingCacheMisses(), 1);
+  EXPECT_EQ(benchmark_info.GetEmbeddingCacheHitRate(), 0.75);
+  EXPECT_EQ(benchmark_info.GetEmbeddingCacheSizeInBytes(), 512);
+
+  std::stringstream ss;
+  ss << benchmark_info;
+  EXPECT_THAT(ss.str(), ContainsRegex(R"(  Embedding Cache:
+    Hits: 3, Misses: 1, Hit Rate: 75.00%
+    Size: 512 bytes
+)"));
+}
+
+TEST(BenchmarkInfoTests, SetPrefillChunkSize) {
+  BenchmarkInfo benchmark_info(GetBenchmarkParams());
+  EXPECT_EQ(benchmark_info.GetPrefillChunkSize(), std::nullopt);
+  std::stringstream ss;
+  ss << benchmark_info;
+  EXPECT_THAT(ss.str(), ::testing::Not(ContainsRegex("Prefill Chunk Size")));
+
+  benchmark_info.SetPrefillChunkSize(512);
+  EXPECT_EQ(benchmark_info.GetPrefillChunkSize(), 512);
+  ss.str("");
+  ss << benchmark_info;
+  EXPECT_THAT(ss.str(),
+              ContainsRegex("Prefill Chunk Size: 512 tokens \\(autotuned\\)"));
+}
+
+TEST(BenchmarkInfoTests, RecordSpeculativeDecodingSteps) {
+  BenchmarkInfo benchmark_info(GetBenchmarkParams());
+  EXPECT_EQ(benchmark_info.GetSpeculativeAcceptanceRate(), 0.0);
+
+  benchmark_info.RecordSpeculativeDecodingStep(/*num_draft_tokens=*/4,
+                                               /*num_accepted_tokens=*/4);
+  benchmark_info.RecordSpeculativeDecodingStep(/*num_draft_tokens=*/4,
+                                               /*num_accepted_tokens=*/1);
+  EXPECT_EQ(benchmark_info.GetSpeculativeDecodingSteps(), 2);
+  EXPECT_EQ(benchmark_info.GetSpeculativeDraftTokens(), 8);
+  EXPECT_EQ(benchmark_info.GetSpeculativeAcceptedTokens(), 5);
+  EXPECT_EQ(benchmark_info.GetSpeculativeAcceptanceRate(), 0.625);
+
+  std::stringstream ss;
+  ss << benchmark_info;
+  EXPECT_THAT(ss.str(), ContainsRegex(R"(  Speculative Decoding:
+    Steps: 2, Draft Tokens: 8, Accepted Tokens: 5
+    Acceptance Rate: 62.50%
+)"));
+}
+
+TEST(BenchmarkInfoTests, SetExecutorStageLatencies) {
+  BenchmarkInfo benchmark_info(GetBenchmarkParams());
+  benchmark_info.SetExecutorStageLatencies(
+      {{"decode_inference", absl::Milliseconds(20)},
+       {"decode_prepare_inputs", absl::Microseconds(1500)}});
+  EXPECT_EQ(benchmark_info.GetExecutorStageLatencies().size(), 2);
+
+  std::stringstream ss;
+  ss << benchmark_info;
+  EXPECT_THAT(ss.str(), ContainsRegex(R"(  Executor Stages \(2\):
+    - decode_inference: 20.00 ms
+    - decode_prepare_inputs: 1.50 ms
+)"));
+
+  // The latencies are replaced, not accumulated.
+  benchmark_info.SetExecutorStageLatencies(
+      {{"decode_inference", absl::Milliseconds(30)}});
+  EXPECT_EQ(benchmark_info.GetExecutorStageLatencies().at("decode_inference"),
+            absl::Milliseconds(30));
+  EXPECT_EQ(benchmark_info.GetExecutorStageLatencies().size(), 1);
+}
+
+TEST(LatencyHistogramTest, ReportsThePercentiles) {
+  LatencyHistogram histogram;
+  EXPECT_EQ(histogram.GetPercentile(50), absl::ZeroDuration());
+
+  for (int i = 1000; i >= 1; --i) {
+    histogram.Record(absl::Milliseconds(i));
+  }
+  EXPECT_EQ(histogram.GetCount(), 1000);
+  EXPECT_EQ(histogram.GetMax(), absl::Milliseconds(1000));
+  // The percentiles are within 1/32 of the recorded latencies.
+  EXPECT_GE(histogram.GetPercentile(50), absl::Milliseconds(500));
+  EXPECT_LE(histogram.GetPercentile(50), absl::Milliseconds(500) * 33 / 32);
+  EXPECT_GE(histogram.GetPercentile(99), absl::Milliseconds(990));
+  EXPECT_LE(histogram.GetPercentile(99), absl::Milliseconds(1000));
+  EXPECT_EQ(histogram.GetPercentile(100), absl::Milliseconds(1000));
+}
+
+TEST(LatencyHistogramTest, CountsTheShortLatenciesExactly) {
+  LatencyHistogram histogram;
+  histogram.Record(absl::Microseconds(3));
+  histogram.Record(absl::Microseconds(7));
+  histogram.Record(absl::Microseconds(7));
+  histogram.Record(absl::Microseconds(20));
+  EXPECT_EQ(histogram.GetPercentile(25), absl::Microseconds(3));
+  EXPECT_EQ(histogram.GetPercentile(50), absl::Microseconds(7));
+  EXPECT_EQ(histogram.GetPercentile(75), absl::Microseconds(7));
+  EXPECT_EQ(histogram.GetPercentile(99), absl::Microseconds(20));
+}
+
+TEST(BenchmarkInfoTests, TimeSteps) {
+  BenchmarkInfo benchmark_info(GetBenchmarkParams());
+  // No turn is started.
+  EXPECT_THAT(benchmark_info.TimePrefillStep(),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_THAT(benchmark_info.TimeDecodeStep(),
+              StatusIs(absl::StatusCode::kInternal));
+
+  EXPECT_OK(benchmark_info.TimePrefillTurnStart());
+  EXPECT_OK(benchmark_info.TimePrefillStep());
+  EXPECT_OK(benchmark_info.TimePrefillStep());
+  EXPECT_OK(benchmark_info.TimePrefillTurnEnd(100));
+  EXPECT_OK(benchmark_info.TimeDecodeTurnStart());
+  for (int i = 0; i < 5; ++i) {
+    EXPECT_OK(benchmark_info.TimeDecodeStep());
+  }
+  EXPECT_OK(benchmark_info.TimeDecodeTurnEnd(5));
+  EXPECT_EQ(benchmark_info.GetPrefillStepLatencies().GetCount(), 2);
+  EXPECT_EQ(benchmark_info.GetDecodeStepLatencies().GetCount(), 5);
+  // Only the first decode step after the prefill is timed to first token.
+  EXPECT_EQ(benchmark_info.GetTimeToFirstTokens().GetCount(), 1);
+  EXPECT_GE(benchmark_info.GetTimeToFirstTokens().GetMax(),
+            benchmark_info.GetDecodeStepLatencies().GetPercentile(0));
+
+  std::stringstream ss;
+  ss << benchmark_info;
+  const std::string percentiles =
+      "p50: .* ms, p90: .* ms, p99: .* ms, max: .* ms";
+  EXPECT_THAT(ss.str(),
+              ContainsRegex(absl::StrCat(
+                  "  Time To First Token \\(1\\): ", percentiles,
+                  "\n  Prefill Step Latency \\(2\\): ", percentiles,
+                  "\n  Inter-Token Latency \\(5\\): ", percentiles, "\n")));
+}
+
 TEST(BenchmarkInfoTests, OperatorOutputWithData) {
   BenchmarkInfo benchmark_info(GetBenchmarkParams());
   EXPECT_OK(benchmark_info.TimeInitPhaseStart("Load Model"));
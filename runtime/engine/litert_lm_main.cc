@@ -21,9 +21,15 @@
 //
 // Consider run_llm_inference_engine.sh as an example to run on android device.
 
+#include <algorithm>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <system_error>  // NOLINT
 #include <utility>
+#include <vector>
 #include <iostream>
 
 #include "absl/base/log_severity.h"  // from @com_google_absl
@@ -35,24 +41,38 @@
 #include "absl/log/globals.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
 #include "litert/c/litert_logging.h"  // from @litert
+#include "runtime/components/decode_recording.h"
+#include "runtime/core/capacity_planner.h"
+#include "runtime/engine/benchmark_sweep.h"
 #include "runtime/engine/engine.h"
 #include "runtime/engine/engine_settings.h"
 #include "runtime/engine/io_types.h"
+#include "runtime/engine/load_generator.h"
 #include "runtime/executor/executor_settings_base.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/scoped_file.h"
 #include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "runtime/util/trace.h"
 #include "tflite/profiling/memory_usage_monitor.h"  // from @litert
 
 ABSL_FLAG(std::string, backend, "gpu",
-          "Executor backend to use for LLM execution (cpu, gpu, etc.)");
+          "Executor backend to use for LLM execution (cpu, gpu, etc.), or "
+          "auto for the fastest one on the device, measured on the first run "
+          "and recorded next to the weight cache.");
 ABSL_FLAG(std::string, sampler_backend, "",
           "Sampler backend to use for LLM execution (cpu, gpu, etc.). If "
           "empty, the sampler backend will be chosen for the best according to "
           "the main executor, for example, gpu for gpu main executor.");
 ABSL_FLAG(std::string, model_path, "", "Model path to use for LLM execution.");
+ABSL_FLAG(std::string, fake_weights_mode, "none",
+          "The fake weights replacing the weights of the model, e.g. to "
+          "benchmark its architecture and a quantization scheme without its "
+          "real weights: none, 8bits_all_layers or attn_8_ffn_4_emb_4.");
 ABSL_FLAG(std::string, input_prompt,
           "What is the tallest building in the world?",
           "Input prompt to use for testing LLM execution.");
@@ -66,21 +86,88 @@ ABSL_FLAG(int, benchmark_decode_tokens, 0,
           "If benchmark is true and the value is larger than 0, the benchmark "
           "will use this number to set the number of decode steps (regardless "
           "of the input prompt).");
+ABSL_FLAG(std::string, benchmark_sweep_prefill_tokens, "",
+          "If set with --benchmark_sweep_decode_tokens, runs a benchmark sweep "
+          "of all the combinations of these comma separated numbers of "
+          "prefill tokens, e.g. \"128,512,1k,4k\", and of the decode ones, "
+          "on one engine.");
+ABSL_FLAG(std::string, benchmark_sweep_decode_tokens, "",
+          "The comma separated numbers of decode tokens of the benchmark "
+          "sweep, e.g. \"32,256\".");
+ABSL_FLAG(int, benchmark_warmup_iterations, 1,
+          "The untimed runs of each point of the benchmark sweep.");
+ABSL_FLAG(int, benchmark_iterations, 3,
+          "The timed runs of each point of the benchmark sweep, averaged.");
+ABSL_FLAG(int, benchmark_context_step_tokens, 0,
+          "If larger than 0, runs a context scaling benchmark instead, which "
+          "prefills this number of tokens and decodes "
+          "--benchmark_decode_tokens at successive context depths of one "
+          "session, e.g. 512.");
+ABSL_FLAG(int, benchmark_context_max_tokens, 0,
+          "The context the context scaling benchmark fills, or the max number "
+          "of tokens of the executor if 0.");
+ABSL_FLAG(int, benchmark_startup_iterations, 0,
+          "If larger than 0, runs a startup benchmark instead, which creates "
+          "the engine, its first session and the first token of the prompt "
+          "this number of times from each of the cold, warm file and warm "
+          "weight cache states, and reports their percentiles.");
+ABSL_FLAG(std::string, benchmark_startup_cache_dir, "",
+          "The directory under which the startup benchmark keeps the weight "
+          "cache of its startups, in a directory it clears, or the temporary "
+          "directory if empty.");
+ABSL_FLAG(std::string, benchmark_sweep_output, "",
+          "The path to write the results of the benchmark sweep, of the "
+          "context scaling benchmark or of the startup benchmark to, as JSON "
+          "if it ends with .json, or CSV otherwise. The CSV is logged if "
+          "empty.");
 ABSL_FLAG(bool, async, true, "Run the LLM execution asynchronously.");
 ABSL_FLAG(bool, report_peak_memory_footprint, false,
           "Report peak memory footprint.");
 ABSL_FLAG(bool, force_f32, false,
           "Force float 32 precision for the activation data type.");
+ABSL_FLAG(std::string, activation_data_type, "",
+          "The activation data type of the main executor, i.e. float32, "
+          "float16, int16 or int8, e.g. int8 to run a model with quantized "
+          "activations on the int8 kernels of the CPU. The default of the "
+          "backend if empty. Overridden by --force_f32.");
 ABSL_FLAG(bool, multi_turns, false,
           "If true, the command line will ask for multi-turns input.");
+ABSL_FLAG(std::string, trace_output, "",
+          "If set, the path to write a trace of the run to, in the Chrome JSON "
+          "trace format, which chrome://tracing and ui.perfetto.dev open.");
+ABSL_FLAG(std::string, load_workload, "",
+          "If set, runs a load test replaying the JSON Lines workload at this "
+          "path, one {\"prompt\": ..., \"max_output_tokens\": ...} request "
+          "per line, each on its own session, instead of the input prompt.");
+ABSL_FLAG(int, load_concurrency, 1,
+          "The number of requests of the load test in flight at most.");
+ABSL_FLAG(double, load_arrival_rate, 0.0,
+          "The mean number of requests of the load test arriving per second, "
+          "as a Poisson process, or 0 for a closed loop.");
+ABSL_FLAG(int, load_num_requests, 0,
+          "The number of requests of the load test, cycling through the "
+          "workload, or 0 to send each request of the workload once.");
+ABSL_FLAG(std::string, record_decode, "",
+          "If set, the path to write a recording of the decoded tokens to, "
+          "with the latency of each decode step, on the CPU sampler.");
+ABSL_FLAG(std::string, replay_decode, "",
+          "If set, the path of a recording of --record_decode to replay: its "
+          "prompts are run with its sampler parameters, and the recorded "
+          "tokens are decoded whatever is sampled, such that the step "
+          "latencies of two builds can be compared on the same decode.");
 
 namespace {
 
 using ::litert::lm::Backend;
+using ::litert::lm::DecodeRecorder;
+using ::litert::lm::DecodeRecording;
+using ::litert::lm::DecodeRecordingTurn;
 using ::litert::lm::EngineSettings;
 using ::litert::lm::InferenceObservable;
 using ::litert::lm::InputText;
 using ::litert::lm::LlmExecutorSettings;
+using ::litert::lm::LoadGeneratorOptions;
+using ::litert::lm::LoadRequest;
 using ::litert::lm::ModelAssets;
 
 // Memory check interval in milliseconds.
@@ -110,6 +197,286 @@ LiteRtLogSeverity AbslMinLogLevelToLiteRtLogSeverity(
   }
 }
 
+// Replays the workload of --load_workload on sessions of `engine`, and logs
+// the report.
+absl::Status RunLoadTest(litert::lm::Engine& engine,
+                         const litert::lm::SessionConfig& session_config) {
+  const std::string workload_path = absl::GetFlag(FLAGS_load_workload);
+  std::ifstream file(workload_path);
+  if (!file.is_open()) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open the workload: ", workload_path));
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  ASSIGN_OR_RETURN(std::vector<LoadRequest> workload,  // NOLINT
+                   litert::lm::ParseLoadWorkload(contents.str()));
+  LoadGeneratorOptions options;
+  options.concurrency = absl::GetFlag(FLAGS_load_concurrency);
+  options.arrival_rate = absl::GetFlag(FLAGS_load_arrival_rate);
+  options.num_requests = absl::GetFlag(FLAGS_load_num_requests);
+  ABSL_LOG(INFO) << "Running a load test of " << workload.size()
+                 << " requests from " << workload_path;
+  ASSIGN_OR_RETURN(
+      litert::lm::LoadReport report,
+      litert::lm::RunLoad(engine, session_config, workload, options));
+  ABSL_LOG(INFO) << report;
+  return absl::OkStatus();
+}
+
+bool IsBenchmarkSweep() {
+  return !absl::GetFlag(FLAGS_benchmark_sweep_prefill_tokens).empty() &&
+         !absl::GetFlag(FLAGS_benchmark_sweep_decode_tokens).empty();
+}
+
+template <typename T>
+std::string StreamToString(const T& value) {
+  std::ostringstream os;
+  os << value;
+  return os.str();
+}
+
+// Returns the settings written along the results of the benchmark sweep.
+litert::lm::BenchmarkSweepSettings GetBenchmarkSweepSettings(
+    absl::string_view model_path, const LlmExecutorSettings& settings,
+    const litert::lm::SessionConfig& session_config) {
+  litert::lm::BenchmarkSweepSettings sweep_settings = {
+      {"model", std::string(model_path)},
+      {"backend", StreamToString(settings.GetBackend())},
+      {"sampler_backend", StreamToString(session_config.GetSamplerBackend())},
+      {"max_num_tokens", absl::StrCat(settings.GetMaxNumTokens())},
+  };
+  sweep_settings.emplace_back(
+      "activation_data_type",
+      settings.GetActivationDataType().has_value()
+          ? StreamToString(*settings.GetActivationDataType())
+          : "default");
+  if (auto cpu_config = settings.GetBackendConfig<litert::lm::CpuConfig>();
+      cpu_config.ok()) {
+    sweep_settings.emplace_back("num_threads",
+                                absl::StrCat(cpu_config->number_of_threads));
+  }
+  if (settings.GetModelAssets().fake_weights_mode() !=
+      litert::lm::FakeWeightsMode::FAKE_WEIGHTS_NONE) {
+    sweep_settings.emplace_back(
+        "fake_weights_mode",
+        StreamToString(settings.GetModelAssets().fake_weights_mode()));
+  }
+  return sweep_settings;
+}
+
+// Writes the results of a benchmark to --benchmark_sweep_output, or logs the
+// CSV.
+absl::Status WriteBenchmarkResults(absl::string_view csv,
+                                   absl::string_view json) {
+  const std::string output_path = absl::GetFlag(FLAGS_benchmark_sweep_output);
+  if (output_path.empty()) {
+    ABSL_LOG(INFO) << "Benchmark results:\n" << csv;
+    return absl::OkStatus();
+  }
+  std::ofstream file(output_path);
+  if (!file.is_open()) {
+    return absl::InternalError(
+        absl::StrCat("Failed to open the sweep output: ", output_path));
+  }
+  file << (absl::EndsWith(output_path, ".json") ? json : csv);
+  ABSL_LOG(INFO) << "Benchmark results written to " << output_path;
+  return absl::OkStatus();
+}
+
+// Runs the benchmark sweep of the flags on `engine`, and writes the results.
+absl::Status RunBenchmarkSweep(
+    litert::lm::Engine& engine,
+    const litert::lm::SessionConfig& session_config,
+    const litert::lm::BenchmarkSweepSettings& sweep_settings) {
+  litert::lm::BenchmarkSweepOptions options;
+  ASSIGN_OR_RETURN(options.num_prefill_tokens,
+                   litert::lm::ParseTokenCounts(
+                       absl::GetFlag(FLAGS_benchmark_sweep_prefill_tokens)));
+  ASSIGN_OR_RETURN(options.num_decode_tokens,
+                   litert::lm::ParseTokenCounts(
+                       absl::GetFlag(FLAGS_benchmark_sweep_decode_tokens)));
+  options.num_warmup_iterations =
+      absl::GetFlag(FLAGS_benchmark_warmup_iterations);
+  options.num_iterations = absl::GetFlag(FLAGS_benchmark_iterations);
+  ASSIGN_OR_RETURN(
+      std::vector<litert::lm::BenchmarkSweepResult> results,
+      litert::lm::RunBenchmarkSweep(engine, session_config,
+                                    absl::GetFlag(FLAGS_input_prompt),
+                                    options));
+  return WriteBenchmarkResults(
+      litert::lm::FormatBenchmarkSweepCsv(sweep_settings, results),
+      litert::lm::FormatBenchmarkSweepJson(sweep_settings, results));
+}
+
+// Runs the context scaling benchmark of the flags on `engine`, and writes the
+// results.
+absl::Status RunContextScalingBenchmark(
+    litert::lm::Engine& engine,
+    const litert::lm::SessionConfig& session_config,
+    absl::string_view model_path, int max_num_tokens,
+    const litert::lm::BenchmarkSweepSettings& sweep_settings) {
+  litert::lm::ContextScalingOptions options;
+  options.num_step_tokens = absl::GetFlag(FLAGS_benchmark_context_step_tokens);
+  if (absl::GetFlag(FLAGS_benchmark_decode_tokens) > 0) {
+    options.num_decode_tokens = absl::GetFlag(FLAGS_benchmark_decode_tokens);
+  }
+  options.max_num_tokens = absl::GetFlag(FLAGS_benchmark_context_max_tokens);
+  if (options.max_num_tokens <= 0) {
+    options.max_num_tokens = max_num_tokens;
+  }
+  if (options.max_num_tokens <= 0) {
+    // The executor takes the max number of tokens of the model metadata when
+    // it is not set.
+    if (auto info = litert::lm::ReadModelCapacityInfo(std::string(model_path));
+        info.ok()) {
+      options.max_num_tokens = info->max_num_tokens;
+    }
+  }
+  ASSIGN_OR_RETURN(
+      std::vector<litert::lm::ContextScalingResult> results,
+      litert::lm::RunContextScalingBenchmark(
+          engine, session_config, absl::GetFlag(FLAGS_input_prompt), options));
+  return WriteBenchmarkResults(
+      litert::lm::FormatContextScalingCsv(sweep_settings, results),
+      litert::lm::FormatContextScalingJson(sweep_settings, results));
+}
+
+// Runs the startup benchmark of the flags on engines created from
+// `engine_settings`, and writes the results. The startups from the cold state
+// evict the model file from the page cache, and those from the cold and warm
+// file states start from an empty weight cache.
+absl::Status RunStartupBenchmark(
+    const EngineSettings& engine_settings,
+    const litert::lm::SessionConfig& session_config,
+    absl::string_view model_path,
+    const litert::lm::BenchmarkSweepSettings& sweep_settings) {
+  std::filesystem::path cache_root(
+      absl::GetFlag(FLAGS_benchmark_startup_cache_dir));
+  if (cache_root.empty()) {
+    cache_root = std::filesystem::temp_directory_path();
+  }
+  // A directory of its own, since it is cleared before the startups.
+  const std::string cache_dir =
+      (cache_root / "litert_lm_startup_weight_cache").string();
+  litert::lm::StartupBenchmarkOptions options;
+  options.num_iterations = absl::GetFlag(FLAGS_benchmark_startup_iterations);
+  options.prepare_caches =
+      [&](litert::lm::StartupCacheState cache_state) -> absl::Status {
+    if (cache_state != litert::lm::StartupCacheState::kWarmCache) {
+      std::error_code error;
+      std::filesystem::remove_all(cache_dir, error);
+      if (!error) {
+        std::filesystem::create_directories(cache_dir, error);
+      }
+      if (error) {
+        return absl::InternalError(absl::StrCat(
+            "Failed to clear the weight cache ", cache_dir, ": ",
+            error.message()));
+      }
+    }
+    if (cache_state == litert::lm::StartupCacheState::kCold) {
+      ASSIGN_OR_RETURN(litert::lm::ScopedFile model_file,  // NOLINT
+                       litert::lm::ScopedFile::Open(model_path));
+      RETURN_IF_ERROR(model_file.EvictFromPageCache());
+    }
+    return absl::OkStatus();
+  };
+  options.create_engine = [&]() {
+    EngineSettings settings = engine_settings;
+    settings.GetMutableMainExecutorSettings().SetCacheDir(cache_dir);
+    return litert::lm::Engine::CreateEngine(std::move(settings));
+  };
+  ASSIGN_OR_RETURN(
+      std::vector<litert::lm::StartupBenchmarkResult> results,
+      litert::lm::RunStartupBenchmark(session_config,
+                                      absl::GetFlag(FLAGS_input_prompt),
+                                      std::move(options)));
+  return WriteBenchmarkResults(
+      litert::lm::FormatStartupBenchmarkCsv(sweep_settings, results),
+      litert::lm::FormatStartupBenchmarkJson(sweep_settings, results));
+}
+
+// Returns the recorder of --record_decode or --replay_decode, if any, and
+// sets the sampler parameters of `session_config` to the recorded ones.
+absl::StatusOr<std::shared_ptr<DecodeRecorder>> CreateDecodeRecorder(
+    litert::lm::SessionConfig& session_config) {
+  const std::string replay_path = absl::GetFlag(FLAGS_replay_decode);
+  if (!absl::GetFlag(FLAGS_record_decode).empty()) {
+    if (!replay_path.empty()) {
+      return absl::InvalidArgumentError(
+          "--record_decode and --replay_decode are exclusive.");
+    }
+    return std::make_shared<DecodeRecorder>(
+        session_config.GetSamplerParams().SerializeAsString());
+  }
+  if (replay_path.empty()) {
+    return nullptr;
+  }
+  std::ifstream file(replay_path, std::ios::binary);
+  if (!file.is_open()) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open the decode recording: ", replay_path));
+  }
+  std::stringstream contents;
+  contents << file.rdbuf();
+  ASSIGN_OR_RETURN(DecodeRecording recording,  // NOLINT
+                   litert::lm::ParseDecodeRecording(contents.str()));
+  if (!session_config.GetMutableSamplerParams().ParseFromString(
+          recording.sampler_params)) {
+    return absl::InvalidArgumentError(
+        "Invalid sampler parameters in the decode recording.");
+  }
+  ABSL_LOG(INFO) << "Replaying " << recording.turns.size()
+                 << " turns from " << replay_path;
+  return std::make_shared<DecodeRecorder>(std::move(recording));
+}
+
+// Runs the recorded prompts of `recorder` on `session`, and logs the step
+// latencies of each turn against the recorded ones.
+absl::Status ReplayDecodeRecording(litert::lm::Engine::Session& session,
+                                   const DecodeRecorder& recorder) {
+  const DecodeRecording& recording = *recorder.GetReplayedRecording();
+  for (const DecodeRecordingTurn& turn : recording.turns) {
+    // The turn runs synchronously, to time the decode steps alone.
+    ASSIGN_OR_RETURN(auto responses,  // NOLINT
+                     session.GenerateContent({InputText(turn.prompt)}));
+    ABSL_LOG(INFO) << "Responses: " << responses;
+  }
+  const DecodeRecording replayed = recorder.GetRecording();
+  for (int i = 0; i < replayed.turns.size(); ++i) {
+    const DecodeRecordingTurn& recorded_turn = recording.turns[i];
+    const DecodeRecordingTurn& replayed_turn = replayed.turns[i];
+    absl::Duration recorded_total;
+    absl::Duration replayed_total;
+    for (absl::Duration latency : recorded_turn.step_latencies) {
+      recorded_total += latency;
+    }
+    for (absl::Duration latency : replayed_turn.step_latencies) {
+      replayed_total += latency;
+    }
+    const int num_steps = std::max<int>(replayed_turn.step_latencies.size(), 1);
+    ABSL_LOG(INFO) << "Turn " << i << ": " << num_steps
+                   << " decode steps, recorded " << recorded_total << " ("
+                   << recorded_total / num_steps << " per step), replayed "
+                   << replayed_total << " (" << replayed_total / num_steps
+                   << " per step)";
+  }
+  return absl::OkStatus();
+}
+
+absl::Status WriteDecodeRecording(const DecodeRecorder& recorder) {
+  const std::string output_path = absl::GetFlag(FLAGS_record_decode);
+  std::ofstream file(output_path, std::ios::binary);
+  if (!file.is_open()) {
+    return absl::InternalError(
+        absl::StrCat("Failed to open the decode recording: ", output_path));
+  }
+  file << litert::lm::SerializeDecodeRecording(recorder.GetRecording());
+  ABSL_LOG(INFO) << "Decode recording written to " << output_path;
+  return absl::OkStatus();
+}
+
 absl::Status MainHelper(int argc, char** argv) {
   absl::ParseCommandLine(argc, argv);
   LiteRtSetMinLoggerSeverity(
@@ -120,12 +487,29 @@ absl::Status MainHelper(int argc, char** argv) {
     ABSL_LOG(INFO)
         << "Example usage: ./litert_lm_main --model_path=<model_path> "
            "[--input_prompt=<input_prompt>] [--backend=<cpu|gpu|npu>] "
+           "[--fake_weights_mode=<none|8bits_all_layers|attn_8_ffn_4_emb_4>] "
            "[--sampler_backend=<cpu|gpu>] [--benchmark] "
            "[--benchmark_prefill_tokens=<num_prefill_tokens>] "
            "[--benchmark_decode_tokens=<num_decode_tokens>] "
+           "[--benchmark_sweep_prefill_tokens=<128,512,1k,4k>] "
+           "[--benchmark_sweep_decode_tokens=<32,256>] "
+           "[--benchmark_warmup_iterations=<num_iterations>] "
+           "[--benchmark_iterations=<num_iterations>] "
+           "[--benchmark_context_step_tokens=<num_step_tokens>] "
+           "[--benchmark_context_max_tokens=<max_num_tokens>] "
+           "[--benchmark_startup_iterations=<num_iterations>] "
+           "[--benchmark_startup_cache_dir=<cache_dir>] "
+           "[--benchmark_sweep_output=<csv_or_json_path>] "
            "[--async=<true|false>] "
            "[--report_peak_memory_footprint]"
-           "[--multi_turns=<true|false>]";
+           "[--multi_turns=<true|false>] "
+           "[--trace_output=<trace_path>] "
+           "[--load_workload=<workload_path>] "
+           "[--load_concurrency=<num_sessions>] "
+           "[--load_arrival_rate=<requests_per_second>] "
+           "[--load_num_requests=<num_requests>] "
+           "[--record_decode=<recording_path>] "
+           "[--replay_decode=<recording_path>]";
     return absl::InvalidArgumentError("No arguments provided.");
   }
 
@@ -140,9 +524,17 @@ absl::Status MainHelper(int argc, char** argv) {
             kMemoryCheckIntervalMs);
     mem_monitor->Start();
   }
+  if (!absl::GetFlag(FLAGS_trace_output).empty()) {
+    // The loading is traced as well.
+    litert::lm::TraceRecorder::Get().Start();
+  }
   ABSL_LOG(INFO) << "Model path: " << model_path;
   ASSIGN_OR_RETURN(ModelAssets model_assets,  // NOLINT
                    ModelAssets::Create(model_path));
+  ASSIGN_OR_RETURN(litert::lm::FakeWeightsMode fake_weights_mode,
+                   litert::lm::GetFakeWeightsModeFromString(
+                       absl::GetFlag(FLAGS_fake_weights_mode)));
+  model_assets.SetFakeWeightsMode(fake_weights_mode);
   auto backend_str = absl::GetFlag(FLAGS_backend);
   ABSL_LOG(INFO) << "Choose backend: " << backend_str;
   ASSIGN_OR_RETURN(Backend backend,
@@ -150,6 +542,13 @@ absl::Status MainHelper(int argc, char** argv) {
   ASSIGN_OR_RETURN(
       EngineSettings engine_settings,
       EngineSettings::CreateDefault(std::move(model_assets), backend));
+  if (!absl::GetFlag(FLAGS_activation_data_type).empty()) {
+    ASSIGN_OR_RETURN(litert::lm::ActivationDataType activation_data_type,
+                     litert::lm::GetActivationDataTypeFromString(
+                         absl::GetFlag(FLAGS_activation_data_type)));
+    engine_settings.GetMutableMainExecutorSettings().SetActivationDataType(
+        activation_data_type);
+  }
   if (absl::GetFlag(FLAGS_force_f32)) {
     engine_settings.GetMutableMainExecutorSettings().SetActivationDataType(
         litert::lm::ActivationDataType::FLOAT32);
@@ -166,10 +565,29 @@ absl::Status MainHelper(int argc, char** argv) {
       session_config.SetSamplerBackend(*sampler_backend);
     }
   }
+  ASSIGN_OR_RETURN(std::shared_ptr<DecodeRecorder> decode_recorder,
+                   CreateDecodeRecorder(session_config));
+  if (decode_recorder != nullptr) {
+    // The tokens are recorded by the CPU sampler.
+    session_config.SetSamplerBackend(Backend::CPU);
+    session_config.SetDecodeRecorder(decode_recorder);
+  }
   ABSL_LOG(INFO) << "executor_settings: "
                  << engine_settings.GetMainExecutorSettings();
 
-  if (absl::GetFlag(FLAGS_benchmark)) {
+  const bool is_benchmark_sweep = IsBenchmarkSweep();
+  const bool is_context_scaling_benchmark =
+      absl::GetFlag(FLAGS_benchmark_context_step_tokens) > 0;
+  const bool is_startup_benchmark =
+      absl::GetFlag(FLAGS_benchmark_startup_iterations) > 0;
+  const int max_num_tokens =
+      engine_settings.GetMainExecutorSettings().GetMaxNumTokens();
+  const litert::lm::BenchmarkSweepSettings sweep_settings =
+      GetBenchmarkSweepSettings(model_path,
+                                engine_settings.GetMainExecutorSettings(),
+                                session_config);
+  if (absl::GetFlag(FLAGS_benchmark) || is_benchmark_sweep ||
+      is_context_scaling_benchmark || is_startup_benchmark) {
     litert::lm::proto::BenchmarkParams benchmark_params;
     benchmark_params.set_num_prefill_tokens(
         absl::GetFlag(FLAGS_benchmark_prefill_tokens));
@@ -177,16 +595,41 @@ absl::Status MainHelper(int argc, char** argv) {
         absl::GetFlag(FLAGS_benchmark_decode_tokens));
     engine_settings.GetMutableBenchmarkParams() = benchmark_params;
   }
+  if (is_startup_benchmark) {
+    // The benchmark creates the engines of its startups.
+    return RunStartupBenchmark(engine_settings, session_config, model_path,
+                               sweep_settings);
+  }
   ABSL_LOG(INFO) << "Creating engine";
   absl::StatusOr<std::unique_ptr<litert::lm::Engine>> llm =
       litert::lm::Engine::CreateEngine(std::move(engine_settings));
   ABSL_CHECK_OK(llm) << "Failed to create engine";
 
+  if (is_context_scaling_benchmark) {
+    return RunContextScalingBenchmark(**llm, session_config, model_path,
+                                      max_num_tokens, sweep_settings);
+  }
+  if (is_benchmark_sweep) {
+    return RunBenchmarkSweep(**llm, session_config, sweep_settings);
+  }
+
+  if (!absl::GetFlag(FLAGS_load_workload).empty()) {
+    RETURN_IF_ERROR(RunLoadTest(**llm, session_config));
+    if (auto metrics = (*llm)->GetMetrics(); metrics.ok()) {
+      ABSL_LOG(INFO) << *metrics;
+    }
+    return absl::OkStatus();
+  }
+
   ABSL_LOG(INFO) << "Creating session";
   absl::StatusOr<std::unique_ptr<litert::lm::Engine::Session>> session =
       (*llm)->CreateSession(session_config);
   ABSL_CHECK_OK(session) << "Failed to create session";
 
+  if (decode_recorder != nullptr && decode_recorder->IsReplaying()) {
+    return ReplayDecodeRecording(**session, *decode_recorder);
+  }
+
   // When either prefill or decode tokens is set, the input prompt will be
   // forced to be the specified value and generate a dummy input.
   const bool is_dummy_input =
@@ -229,11 +672,27 @@ absl::Status MainHelper(int argc, char** argv) {
     }
   } while (is_multi_turns);
 
+  if (decode_recorder != nullptr) {
+    RETURN_IF_ERROR(WriteDecodeRecording(*decode_recorder));
+  }
+
+  const std::string trace_output = absl::GetFlag(FLAGS_trace_output);
+  if (!trace_output.empty()) {
+    litert::lm::TraceRecorder::Get().Stop();
+    RETURN_IF_ERROR(
+        litert::lm::TraceRecorder::Get().WriteChromeTrace(trace_output));
+    ABSL_LOG(INFO) << "Trace written to " << trace_output;
+  }
+
   if (absl::GetFlag(FLAGS_benchmark)) {
     auto benchmark_info = (*session)->GetBenchmarkInfo();
     ABSL_LOG(INFO) << *benchmark_info;
   }
 
+  if (auto metrics = (*llm)->GetMetrics(); metrics.ok()) {
+    ABSL_LOG(INFO) << *metrics;
+  }
+
   if (absl::GetFlag(FLAGS_report_peak_memory_footprint)) {
     float peak_mem_mb = 0.0f;
     if (mem_monitor != nullptr) {
@@ -241,6 +700,9 @@ absl::Status MainHelper(int argc, char** argv) {
       peak_mem_mb = mem_monitor->GetPeakMemUsageInMB();
     }
     ABSL_LOG(INFO) << "Peak system ram usage: " << peak_mem_mb << "MB.";
+    if (auto memory_usage = (*llm)->GetMemoryUsage(); memory_usage.ok()) {
+      ABSL_LOG(INFO) << *memory_usage;
+    }
   }
   return absl::OkStatus();
 }
@@ -0,0 +1,286 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/engine/load_generator.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_split.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/components/json_value.h"
+#include "runtime/engine/engine.h"
+#include "runtime/engine/engine_settings.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/framework/threadpool.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "tflite/profiling/memory_info.h"  // from @litert
+
+namespace litert::lm {
+namespace {
+
+// Streams the responses of a request, and records the time of each of them.
+class RequestObserver : public InferenceObservable {
+ public:
+  void OnNext(const Responses& responses) override {
+    const absl::Time now = absl::Now();
+    absl::MutexLock lock(&mutex_);
+    response_times_.push_back(now);
+  }
+
+  void OnDone() override { done_.Notify(); }
+
+  void OnError(const absl::Status& status) override {
+    {
+      absl::MutexLock lock(&mutex_);
+      status_ = status;
+    }
+    done_.Notify();
+  }
+
+  bool WaitUntilDone(absl::Duration timeout) {
+    return done_.WaitForNotificationWithTimeout(timeout);
+  }
+
+  // Only valid once done.
+  absl::Status status() const {
+    absl::MutexLock lock(&mutex_);
+    return status_;
+  }
+  std::vector<absl::Time> response_times() const {
+    absl::MutexLock lock(&mutex_);
+    return response_times_;
+  }
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::Status status_ ABSL_GUARDED_BY(mutex_);
+  std::vector<absl::Time> response_times_ ABSL_GUARDED_BY(mutex_);
+  absl::Notification done_;
+};
+
+// Returns the offsets from the start of the load test at which the requests
+// arrive, all at once for a closed loop.
+std::vector<absl::Duration> GetArrivalOffsets(
+    int num_requests, const LoadGeneratorOptions& options) {
+  std::vector<absl::Duration> offsets(num_requests, absl::ZeroDuration());
+  if (options.arrival_rate <= 0.0) {
+    return offsets;
+  }
+  std::mt19937 gen(options.seed);
+  std::exponential_distribution<double> inter_arrival_seconds(
+      options.arrival_rate);
+  double offset_seconds = 0.0;
+  for (absl::Duration& offset : offsets) {
+    offset = absl::Seconds(offset_seconds);
+    offset_seconds += inter_arrival_seconds(gen);
+  }
+  return offsets;
+}
+
+uint64_t GetHeapInUseBytes() {
+  if (!tflite::profiling::memory::MemoryUsage::IsSupported()) {
+    return 0;
+  }
+  return tflite::profiling::memory::GetMemoryUsage().in_use_allocated_bytes;
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<LoadRequest>> ParseLoadWorkload(
+    absl::string_view jsonl) {
+  std::vector<LoadRequest> workload;
+  int line_number = 0;
+  for (absl::string_view line : absl::StrSplit(jsonl, '\n')) {
+    ++line_number;
+    if (absl::StripAsciiWhitespace(line).empty()) {
+      continue;
+    }
+    auto value = ParseJson(line);
+    if (!value.ok()) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Line ", line_number,
+                       " of the workload: ", value.status().message()));
+    }
+    const JsonValue* prompt = value->Find("prompt");
+    if (value->type != JsonValue::Type::kObject || prompt == nullptr ||
+        prompt->type != JsonValue::Type::kString) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Line ", line_number, " of the workload has no string prompt."));
+    }
+    LoadRequest request;
+    request.prompt = prompt->text;
+    if (const JsonValue* max_output_tokens = value->Find("max_output_tokens")) {
+      if (max_output_tokens->type != JsonValue::Type::kNumber ||
+          !absl::SimpleAtoi(max_output_tokens->text,
+                            &request.max_output_tokens) ||
+          request.max_output_tokens < 0) {
+        return absl::InvalidArgumentError(
+            absl::StrCat("Line ", line_number,
+                         " of the workload has an invalid max_output_tokens."));
+      }
+    }
+    workload.push_back(std::move(request));
+  }
+  return workload;
+}
+
+double LoadReport::GetRequestsPerSecond() const {
+  const double seconds = absl::ToDoubleSeconds(duration);
+  return seconds > 0.0 ? (num_requests - num_failed_requests) / seconds : 0.0;
+}
+
+double LoadReport::GetOutputTokensPerSecond() const {
+  const double seconds = absl::ToDoubleSeconds(duration);
+  return seconds > 0.0 ? num_output_tokens / seconds : 0.0;
+}
+
+std::ostream& operator<<(std::ostream& os, const LoadReport& report) {
+  os << "LoadReport:" << std::endl;
+  os << "  Requests: " << report.num_requests << " ("
+     << report.num_failed_requests << " failed) in " << report.duration
+     << std::endl;
+  os << "  Throughput: " << report.GetRequestsPerSecond() << " requests/s, "
+     << report.GetOutputTokensPerSecond() << " tokens/s" << std::endl;
+  os << "  Time to first token: " << report.time_to_first_token << std::endl;
+  os << "  Inter-token latency: " << report.inter_token_latency << std::endl;
+  os << "  Request latency: " << report.request_latency << std::endl;
+  os << "  Memory samples (" << report.memory_samples.size()
+     << "):" << std::endl;
+  for (const LoadMemorySample& sample : report.memory_samples) {
+    os << "    " << sample.time << ": heap in use "
+       << sample.heap_in_use_bytes / (1024.0 * 1024.0) << " MB, "
+       << sample.kv_cache_num_tokens << " kv-cache tokens" << std::endl;
+  }
+  return os;
+}
+
+absl::StatusOr<LoadReport> RunLoad(Engine& engine,
+                                   const SessionConfig& session_config,
+                                   absl::Span<const LoadRequest> workload,
+                                   const LoadGeneratorOptions& options) {
+  if (workload.empty()) {
+    return absl::InvalidArgumentError("The workload is empty.");
+  }
+  if (options.concurrency <= 0 || options.num_requests < 0 ||
+      options.arrival_rate < 0.0 ||
+      options.memory_sample_interval <= absl::ZeroDuration()) {
+    return absl::InvalidArgumentError(
+        "The concurrency and the memory sample interval must be positive, and "
+        "the number of requests and the arrival rate not negative.");
+  }
+  const int num_requests =
+      options.num_requests > 0 ? options.num_requests : workload.size();
+  const std::vector<absl::Duration> arrival_offsets =
+      GetArrivalOffsets(num_requests, options);
+
+  absl::Mutex mutex;
+  LoadReport report;
+  report.num_requests = num_requests;
+  std::atomic<int> next_request = 0;
+  const absl::Time start_time = absl::Now();
+
+  // Each client sends the next request that has arrived, if any is left.
+  auto run_client = [&]() {
+    for (int index = next_request++; index < num_requests;
+         index = next_request++) {
+      const absl::Time arrival_time = start_time + arrival_offsets[index];
+      absl::SleepFor(arrival_time - absl::Now());
+      const LoadRequest& request = workload[index % workload.size()];
+      SessionConfig config = session_config;
+      if (request.max_output_tokens > 0) {
+        config.SetMaxOutputTokens(request.max_output_tokens);
+      }
+
+      absl::Status status;
+      RequestObserver observer;
+      auto session = engine.CreateSession(config);
+      if (!session.ok()) {
+        status = session.status();
+      } else {
+        status = (*session)->GenerateContentStream(
+            {InputText(request.prompt)}, &observer);
+        if (status.ok()) {
+          if (!observer.WaitUntilDone(options.request_timeout)) {
+            (*session)->Cancel().IgnoreError();
+            observer.WaitUntilDone(absl::InfiniteDuration());
+          }
+          status = observer.status();
+        }
+      }
+
+      const std::vector<absl::Time> response_times = observer.response_times();
+      absl::MutexLock lock(&mutex);
+      if (!status.ok() || response_times.empty()) {
+        ABSL_LOG(WARNING) << "Request " << index << " failed: " << status;
+        ++report.num_failed_requests;
+        continue;
+      }
+      report.num_output_tokens += response_times.size();
+      report.time_to_first_token.Record(response_times.front() -
+                                        arrival_time);
+      for (size_t i = 1; i < response_times.size(); ++i) {
+        report.inter_token_latency.Record(response_times[i] -
+                                          response_times[i - 1]);
+      }
+      report.request_latency.Record(response_times.back() - arrival_time);
+    }
+  };
+
+  auto sample_memory = [&]() {
+    LoadMemorySample sample;
+    sample.time = absl::Now() - start_time;
+    sample.heap_in_use_bytes = GetHeapInUseBytes();
+    if (auto metrics = engine.GetMetrics(); metrics.ok()) {
+      sample.kv_cache_num_tokens = metrics->kv_cache_num_tokens;
+    }
+    absl::MutexLock lock(&mutex);
+    report.memory_samples.push_back(sample);
+  };
+
+  {
+    ThreadPool pool("load_generator", options.concurrency);
+    for (int i = 0; i < options.concurrency; ++i) {
+      RETURN_IF_ERROR(pool.Schedule(run_client));
+    }
+    // Samples the memory until the clients are done, then once more.
+    while (!pool.WaitUntilDone(options.memory_sample_interval).ok()) {
+      sample_memory();
+    }
+    sample_memory();
+  }
+  report.duration = absl::Now() - start_time;
+  return report;
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,113 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_LOAD_GENERATOR_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_LOAD_GENERATOR_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/engine/engine.h"
+#include "runtime/engine/engine_settings.h"
+#include "runtime/engine/io_types.h"
+
+namespace litert::lm {
+
+// A request of a load test.
+struct LoadRequest {
+  std::string prompt;
+  // The number of tokens decoded at most for the request, or 0 to decode up
+  // to the max output tokens of the session config.
+  int max_output_tokens = 0;
+};
+
+// Parses a workload in the JSON Lines format, one request per line, e.g.
+//   {"prompt": "What is the tallest building?", "max_output_tokens": 128}
+// The empty lines are skipped.
+absl::StatusOr<std::vector<LoadRequest>> ParseLoadWorkload(
+    absl::string_view jsonl);
+
+struct LoadGeneratorOptions {
+  // The number of requests in flight at most, each on its own session.
+  int concurrency = 1;
+  // The mean number of requests arriving per second, as a Poisson process.
+  // 0 for a closed loop, where each of the `concurrency` clients sends its
+  // next request as soon as its previous one is done.
+  double arrival_rate = 0.0;
+  // The number of requests sent, cycling through the workload, or 0 to send
+  // each request of the workload once.
+  int num_requests = 0;
+  // The seed of the arrival times.
+  uint32_t seed = 0;
+  // The time each request may take before it is cancelled, and counted as
+  // failed.
+  absl::Duration request_timeout = absl::Minutes(10);
+  // The period at which the memory is sampled.
+  absl::Duration memory_sample_interval = absl::Seconds(1);
+};
+
+// The memory at some point of a load test.
+struct LoadMemorySample {
+  // The time since the start of the load test.
+  absl::Duration time;
+  // The heap memory in use by the process, or 0 if it is not reported on
+  // the platform.
+  uint64_t heap_in_use_bytes = 0;
+  // The number of tokens held in the kv-caches of the engine.
+  int64_t kv_cache_num_tokens = 0;
+};
+
+// The results of a load test.
+struct LoadReport {
+  int num_requests = 0;
+  int num_failed_requests = 0;
+  // The number of responses streamed, i.e. of decode steps.
+  uint64_t num_output_tokens = 0;
+  absl::Duration duration;
+  // From the arrival of each request to its first response, including the
+  // time it waits for a free client.
+  LatencyHistogram time_to_first_token;
+  // Between the consecutive responses of each request.
+  LatencyHistogram inter_token_latency;
+  // From the arrival of each request to its last response.
+  LatencyHistogram request_latency;
+  std::vector<LoadMemorySample> memory_samples;
+
+  double GetRequestsPerSecond() const;
+  double GetOutputTokensPerSecond() const;
+};
+std::ostream& operator<<(std::ostream& os, const LoadReport& report);
+
+// Replays `workload` on sessions of `engine` created from `session_config`,
+// at the concurrency and the arrival rate of `options`, and reports the
+// throughput and the latencies. Each request is streamed on a new session,
+// so the responses are timed as they come; StreamingFlushOptions in
+// `session_config` would coalesce them. Blocks until all the requests are
+// done. Only returns an error for invalid arguments: the failed requests
+// are counted in the report.
+absl::StatusOr<LoadReport> RunLoad(Engine& engine,
+                                   const SessionConfig& session_config,
+                                   absl::Span<const LoadRequest> workload,
+                                   const LoadGeneratorOptions& options);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_LOAD_GENERATOR_H_
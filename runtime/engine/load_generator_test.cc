@@ -0,0 +1,175 @@
+#include "runtime/engine/load_generator.h"
+
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/engine/engine.h"
+#include "runtime/engine/engine_settings.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::status::StatusIs;
+
+// Streams one response per millisecond, up to the max output tokens of its
+// config, or 4 by default.
+class FakeSession : public Engine::Session {
+ public:
+  FakeSession(int num_responses, std::atomic<int>& num_active_sessions,
+              std::atomic<int>& max_num_active_sessions)
+      : num_responses_(num_responses),
+        num_active_sessions_(num_active_sessions) {
+    const int num_active = ++num_active_sessions_;
+    int max_num_active = max_num_active_sessions.load();
+    while (num_active > max_num_active &&
+           !max_num_active_sessions.compare_exchange_weak(max_num_active,
+                                                          num_active)) {
+    }
+  }
+
+  ~FakeSession() override {
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+    --num_active_sessions_;
+  }
+
+  absl::StatusOr<Responses> GenerateContent(
+      const std::vector<InputData>& contents) override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  absl::Status GenerateContentStream(const std::vector<InputData>& contents,
+                                     InferenceObservable* observer) override {
+    thread_ = std::thread([this, observer]() {
+      for (int i = 0; i < num_responses_; ++i) {
+        absl::SleepFor(absl::Milliseconds(1));
+        observer->OnNext(Responses(/*num_output_candidates=*/1));
+      }
+      observer->OnDone();
+    });
+    return absl::OkStatus();
+  }
+
+  absl::Status RunPrefill(const std::vector<InputData>& contents) override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  absl::StatusOr<Responses> RunDecode() override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  absl::StatusOr<BenchmarkInfo> GetBenchmarkInfo() override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+ private:
+  const int num_responses_;
+  std::atomic<int>& num_active_sessions_;
+  std::thread thread_;
+};
+
+class FakeEngine : public Engine {
+ public:
+  absl::StatusOr<std::unique_ptr<Session>> CreateSession(
+      const SessionConfig& session_config) const override {
+    return std::make_unique<FakeSession>(
+        session_config.GetMaxOutputTokens().value_or(4), num_active_sessions_,
+        max_num_active_sessions_);
+  }
+
+  int max_num_active_sessions() const { return max_num_active_sessions_; }
+
+ private:
+  mutable std::atomic<int> num_active_sessions_ = 0;
+  mutable std::atomic<int> max_num_active_sessions_ = 0;
+};
+
+TEST(LoadGeneratorTest, ParsesTheWorkload) {
+  auto workload = ParseLoadWorkload(
+      "{\"prompt\": \"Hello\", \"max_output_tokens\": 8}\n"
+      "\n"
+      "{\"prompt\": \"World\\n\"}\n");
+  ASSERT_OK(workload);
+  ASSERT_EQ(workload->size(), 2);
+  EXPECT_EQ((*workload)[0].prompt, "Hello");
+  EXPECT_EQ((*workload)[0].max_output_tokens, 8);
+  EXPECT_EQ((*workload)[1].prompt, "World\n");
+  EXPECT_EQ((*workload)[1].max_output_tokens, 0);
+}
+
+TEST(LoadGeneratorTest, RejectsAnInvalidWorkload) {
+  EXPECT_THAT(ParseLoadWorkload("{\"prompt\": \"Hello\"}\n{\"prompt\": 1}"),
+              StatusIs(absl::StatusCode::kInvalidArgument,
+                       "Line 2 of the workload has no string prompt."));
+  EXPECT_THAT(
+      ParseLoadWorkload("{\"prompt\": \"a\", \"max_output_tokens\": -1}"),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseLoadWorkload("{\"prompt\": "),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LoadGeneratorTest, RunsAClosedLoop) {
+  FakeEngine engine;
+  const std::vector<LoadRequest> workload = {{"a", 3}, {"b", 5}};
+  LoadGeneratorOptions options;
+  options.concurrency = 2;
+  options.num_requests = 6;
+  auto report = RunLoad(engine, SessionConfig::CreateDefault(), workload,
+                        options);
+  ASSERT_OK(report);
+  EXPECT_EQ(report->num_requests, 6);
+  EXPECT_EQ(report->num_failed_requests, 0);
+  EXPECT_EQ(report->num_output_tokens, 3 * (3 + 5));
+  EXPECT_EQ(report->time_to_first_token.GetCount(), 6);
+  EXPECT_EQ(report->inter_token_latency.GetCount(), 3 * (2 + 4));
+  EXPECT_EQ(report->request_latency.GetCount(), 6);
+  EXPECT_GT(report->GetOutputTokensPerSecond(), 0.0);
+  EXPECT_FALSE(report->memory_samples.empty());
+  EXPECT_LE(engine.max_num_active_sessions(), 2);
+
+  std::stringstream ss;
+  ss << *report;
+  EXPECT_THAT(ss.str(), HasSubstr("Time to first token: p50: "));
+}
+
+TEST(LoadGeneratorTest, SpreadsTheArrivals) {
+  FakeEngine engine;
+  const std::vector<LoadRequest> workload = {{"a", 1}};
+  LoadGeneratorOptions options;
+  options.concurrency = 4;
+  options.num_requests = 5;
+  // 4 inter-arrivals of 10ms on average.
+  options.arrival_rate = 100.0;
+  auto report = RunLoad(engine, SessionConfig::CreateDefault(), workload,
+                        options);
+  ASSERT_OK(report);
+  EXPECT_EQ(report->num_output_tokens, 5);
+  EXPECT_GT(report->duration, absl::Milliseconds(1));
+}
+
+TEST(LoadGeneratorTest, RejectsInvalidOptions) {
+  FakeEngine engine;
+  LoadGeneratorOptions options;
+  EXPECT_THAT(RunLoad(engine, SessionConfig::CreateDefault(), {}, options),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  options.concurrency = 0;
+  EXPECT_THAT(RunLoad(engine, SessionConfig::CreateDefault(), {{"a", 1}},
+                      options),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,350 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/engine/ring_buffer_observable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <utility>
+
+#include "absl/log/log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/engine/io_types.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <climits>
+#endif  // defined(__linux__)
+
+namespace litert::lm {
+namespace {
+
+constexpr uint32_t kMagic = 0x4C4D5242;  // "LMRB"
+constexpr uint32_t kMinCapacity = 64;
+constexpr uint32_t kMaxCapacity = 1u << 30;
+// The records are aligned to their header, such that a header never wraps
+// around the end of the buffer.
+constexpr uint32_t kRecordAlignment = 8;
+// Fills the end of the buffer when the next record does not fit before it.
+constexpr uint32_t kPaddingRecordType = 0xFFFFFFFF;
+// The polling interval of a waiting side where futexes are not available.
+constexpr absl::Duration kPollInterval = absl::Microseconds(100);
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free,
+              "The positions are shared by processes, so they must be "
+              "lock-free.");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+
+struct RecordHeader {
+  uint32_t type;
+  uint32_t candidate_index;
+  // The size of the record, including the header and the alignment.
+  uint32_t size;
+  uint32_t data_size;
+};
+static_assert(sizeof(RecordHeader) % kRecordAlignment == 0);
+
+uint32_t GetRecordSize(size_t data_size) {
+  const size_t size = sizeof(RecordHeader) + data_size;
+  return (size + kRecordAlignment - 1) / kRecordAlignment * kRecordAlignment;
+}
+
+// Sleeps until `word` is woken while it differs from `expected`, or `timeout`
+// passes. May return spuriously.
+void WaitOnWord(std::atomic<uint32_t>& word, uint32_t expected,
+                absl::Duration timeout) {
+#if defined(__linux__)
+  // Not FUTEX_PRIVATE_FLAG: the word is in memory shared by processes.
+  timespec relative_timeout = absl::ToTimespec(timeout);
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, expected,
+          timeout == absl::InfiniteDuration() ? nullptr : &relative_timeout,
+          nullptr, 0);
+#else
+  absl::SleepFor(std::min(timeout, kPollInterval));
+#endif  // defined(__linux__)
+}
+
+void WakeWord(std::atomic<uint32_t>& word) {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+#endif  // defined(__linux__)
+}
+
+}  // namespace
+
+// The shared state at the start of the memory. The positions count the bytes
+// written and read so far, wrapping around 2^32, and each sits on its own
+// cache line, such that the two sides do not write the same line.
+struct TokenRingBuffer::Header {
+  // Set last by Initialize(), once the rest is.
+  std::atomic<uint32_t> magic;
+  uint32_t capacity;
+  alignas(64) std::atomic<uint32_t> write_position;
+  // Whether the consumer sleeps on write_position.
+  std::atomic<uint32_t> consumer_waiting;
+  alignas(64) std::atomic<uint32_t> read_position;
+  // Whether the producer sleeps on read_position.
+  std::atomic<uint32_t> producer_waiting;
+};
+
+// static
+size_t TokenRingBuffer::GetRequiredSize(uint32_t capacity) {
+  return sizeof(Header) + capacity;
+}
+
+// static
+absl::StatusOr<TokenRingBuffer> TokenRingBuffer::Initialize(
+    absl::Span<uint8_t> memory, uint32_t capacity) {
+  if (capacity < kMinCapacity || capacity > kMaxCapacity ||
+      (capacity & (capacity - 1)) != 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Capacity must be a power of two in [", kMinCapacity, ", ",
+        kMaxCapacity, "], got ", capacity));
+  }
+  if (memory.size() < GetRequiredSize(capacity)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("The ring buffer needs ", GetRequiredSize(capacity),
+                     " bytes, got ", memory.size()));
+  }
+  if (reinterpret_cast<uintptr_t>(memory.data()) % alignof(Header) != 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The ring buffer memory must be ", alignof(Header), "-byte aligned."));
+  }
+  auto* header = new (memory.data()) Header();
+  header->capacity = capacity;
+  header->write_position.store(0, std::memory_order_relaxed);
+  header->read_position.store(0, std::memory_order_relaxed);
+  header->magic.store(kMagic, std::memory_order_release);
+  return TokenRingBuffer(header);
+}
+
+// static
+absl::StatusOr<TokenRingBuffer> TokenRingBuffer::Attach(
+    absl::Span<uint8_t> memory) {
+  if (memory.size() < sizeof(Header) ||
+      reinterpret_cast<uintptr_t>(memory.data()) % alignof(Header) != 0) {
+    return absl::InvalidArgumentError(
+        "The memory does not hold an aligned ring buffer header.");
+  }
+  auto* header = reinterpret_cast<Header*>(memory.data());
+  if (header->magic.load(std::memory_order_acquire) != kMagic) {
+    return absl::FailedPreconditionError(
+        "The ring buffer is not initialized.");
+  }
+  if (memory.size() < GetRequiredSize(header->capacity)) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "The ring buffer needs ", GetRequiredSize(header->capacity),
+        " bytes, got ", memory.size()));
+  }
+  return TokenRingBuffer(header);
+}
+
+TokenRingBuffer::TokenRingBuffer(Header* header)
+    : header_(header), capacity_(header->capacity) {}
+
+uint8_t* TokenRingBuffer::DataAt(uint32_t position) const {
+  return reinterpret_cast<uint8_t*>(header_ + 1) +
+         (position & (capacity_ - 1));
+}
+
+absl::Status TokenRingBuffer::Write(RecordType type, int candidate_index,
+                                    absl::string_view data,
+                                    absl::Duration timeout) {
+  const absl::Time deadline = absl::Now() + timeout;
+  const size_t max_data_size = capacity_ / 2 - sizeof(RecordHeader);
+  if (type != RecordType::kText) {
+    return WriteRecord(static_cast<uint32_t>(type), candidate_index,
+                       data.substr(0, max_data_size), deadline);
+  }
+  do {
+    const absl::string_view chunk = data.substr(0, max_data_size);
+    if (absl::Status status = WriteRecord(static_cast<uint32_t>(type),
+                                          candidate_index, chunk, deadline);
+        !status.ok()) {
+      return status;
+    }
+    data.remove_prefix(chunk.size());
+  } while (!data.empty());
+  return absl::OkStatus();
+}
+
+absl::Status TokenRingBuffer::WriteRecord(uint32_t type,
+                                          uint32_t candidate_index,
+                                          absl::string_view data,
+                                          absl::Time deadline) {
+  uint32_t write_position =
+      header_->write_position.load(std::memory_order_relaxed);
+  const uint32_t record_size = GetRecordSize(data.size());
+  const uint32_t size_before_end =
+      capacity_ - (write_position & (capacity_ - 1));
+  // A record that does not fit before the end starts over at the beginning,
+  // after a padding record.
+  const uint32_t needed_size =
+      record_size > size_before_end ? size_before_end + record_size
+                                    : record_size;
+  while (true) {
+    const uint32_t read_position =
+        header_->read_position.load(std::memory_order_acquire);
+    if (capacity_ - (write_position - read_position) >= needed_size) {
+      break;
+    }
+    const absl::Duration timeout = deadline - absl::Now();
+    if (timeout <= absl::ZeroDuration()) {
+      return absl::DeadlineExceededError(
+          "The consumer did not free the ring buffer space in time.");
+    }
+    // The flag is set before the position is checked again, and the consumer
+    // sets the position before it checks the flag, so a wake is not missed.
+    header_->producer_waiting.store(1, std::memory_order_seq_cst);
+    if (header_->read_position.load(std::memory_order_seq_cst) ==
+        read_position) {
+      WaitOnWord(header_->read_position, read_position, timeout);
+    }
+    header_->producer_waiting.store(0, std::memory_order_relaxed);
+  }
+  if (record_size > size_before_end) {
+    const RecordHeader padding = {.type = kPaddingRecordType,
+                                  .size = size_before_end};
+    std::memcpy(DataAt(write_position), &padding, sizeof(padding));
+    write_position += size_before_end;
+  }
+  const RecordHeader record = {.type = type,
+                               .candidate_index = candidate_index,
+                               .size = record_size,
+                               .data_size = static_cast<uint32_t>(data.size())};
+  uint8_t* destination = DataAt(write_position);
+  std::memcpy(destination, &record, sizeof(record));
+  std::memcpy(destination + sizeof(record), data.data(), data.size());
+  write_position += record_size;
+  header_->write_position.store(write_position, std::memory_order_seq_cst);
+  if (header_->consumer_waiting.load(std::memory_order_seq_cst) != 0) {
+    WakeWord(header_->write_position);
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<TokenRingBuffer::Record> TokenRingBuffer::Read(
+    absl::Duration timeout) {
+  const absl::Time deadline = absl::Now() + timeout;
+  uint32_t read_position =
+      header_->read_position.load(std::memory_order_relaxed);
+  while (true) {
+    const uint32_t write_position =
+        header_->write_position.load(std::memory_order_acquire);
+    if (write_position != read_position) {
+      RecordHeader record_header;
+      std::memcpy(&record_header, DataAt(read_position),
+                  sizeof(record_header));
+      if (record_header.type == kPaddingRecordType) {
+        read_position += record_header.size;
+        continue;
+      }
+      Record record{
+          .type = static_cast<RecordType>(record_header.type),
+          .candidate_index = static_cast<int>(record_header.candidate_index),
+          .data = std::string(reinterpret_cast<const char*>(
+                                  DataAt(read_position) + sizeof(RecordHeader)),
+                              record_header.data_size)};
+      read_position += record_header.size;
+      header_->read_position.store(read_position, std::memory_order_seq_cst);
+      if (header_->producer_waiting.load(std::memory_order_seq_cst) != 0) {
+        WakeWord(header_->read_position);
+      }
+      return record;
+    }
+    // The padding records skipped are freed for the producer.
+    header_->read_position.store(read_position, std::memory_order_release);
+    const absl::Duration remaining = deadline - absl::Now();
+    if (remaining <= absl::ZeroDuration()) {
+      return absl::DeadlineExceededError("No record was written in time.");
+    }
+    header_->consumer_waiting.store(1, std::memory_order_seq_cst);
+    if (header_->write_position.load(std::memory_order_seq_cst) ==
+        write_position) {
+      WaitOnWord(header_->write_position, write_position, remaining);
+    }
+    header_->consumer_waiting.store(0, std::memory_order_relaxed);
+  }
+}
+
+void RingBufferObservable::OnNext(const Responses& responses) {
+  if (!write_status_.ok()) {
+    return;
+  }
+  for (int i = 0; i < responses.GetNumOutputCandidates(); ++i) {
+    absl::StatusOr<absl::string_view> text = responses.GetResponseTextAt(i);
+    if (text.ok() && !text->empty()) {
+      Write(TokenRingBuffer::RecordType::kText, i, *text);
+    }
+  }
+}
+
+void RingBufferObservable::OnNextText(int candidate_index,
+                                      absl::string_view text) {
+  if (!write_status_.ok()) {
+    return;
+  }
+  Write(TokenRingBuffer::RecordType::kText, candidate_index, text);
+}
+
+void RingBufferObservable::OnCandidateDone(int candidate_index) {
+  if (!write_status_.ok()) {
+    return;
+  }
+  Write(TokenRingBuffer::RecordType::kCandidateDone, candidate_index, "");
+}
+
+void RingBufferObservable::OnDone() {
+  if (!write_status_.ok()) {
+    // The consumer misses some of the text, so it must not take the output
+    // as complete.
+    Write(TokenRingBuffer::RecordType::kError,
+          static_cast<int>(write_status_.code()), write_status_.message());
+    return;
+  }
+  Write(TokenRingBuffer::RecordType::kDone, /*candidate_index=*/0, "");
+}
+
+void RingBufferObservable::OnError(const absl::Status& status) {
+  Write(TokenRingBuffer::RecordType::kError, static_cast<int>(status.code()),
+        status.message());
+}
+
+void RingBufferObservable::Write(TokenRingBuffer::RecordType type,
+                                 int candidate_index, absl::string_view data) {
+  absl::Status status =
+      ring_buffer_.Write(type, candidate_index, data, write_timeout_);
+  if (!status.ok() && write_status_.ok()) {
+    ABSL_LOG(WARNING) << "Dropping the streamed text: " << status;
+    write_status_ = std::move(status);
+  }
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,147 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_RING_BUFFER_OBSERVABLE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_RING_BUFFER_OBSERVABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/engine/io_types.h"
+
+namespace litert::lm {
+
+// A single-producer/single-consumer ring buffer of streamed text records,
+// laid out in memory shared by two processes, e.g. a mapping of the same
+// memfd or shm_open file. Neither side takes a lock: each only advances its
+// own position. A side only makes a syscall, a futex wake, when the other one
+// sleeps on an empty or full buffer, so streaming at steady state costs none
+// per token. On other platforms than Linux, a waiting side polls instead.
+//
+// Example usage:
+//
+//   // In the inference process, on memory mapped from a shared file:
+//   ASSIGN_OR_RETURN(auto ring_buffer, TokenRingBuffer::Initialize(
+//                                          memory, /*capacity=*/1 << 16));
+//   RingBufferObservable observer(&ring_buffer);
+//   RETURN_IF_ERROR(session->RunDecodeAsync(&observer));
+//
+//   // In the UI process, on the same file mapped again:
+//   ASSIGN_OR_RETURN(auto ring_buffer, TokenRingBuffer::Attach(memory));
+//   ASSIGN_OR_RETURN(auto record, ring_buffer.Read(absl::Seconds(1)));
+class TokenRingBuffer {
+ public:
+  enum class RecordType : uint32_t {
+    // New text of the output candidate `candidate_index`.
+    kText = 0,
+    // The inference finished successfully.
+    kDone = 1,
+    // The inference failed. `candidate_index` holds the status code and
+    // `data` the message.
+    kError = 2,
+    // The output candidate `candidate_index` stopped, while the others may
+    // still be decoded.
+    kCandidateDone = 3,
+  };
+
+  struct Record {
+    RecordType type = RecordType::kText;
+    int candidate_index = 0;
+    std::string data;
+  };
+
+  // Returns the memory size a ring buffer of `capacity` bytes of records
+  // takes.
+  static size_t GetRequiredSize(uint32_t capacity);
+
+  // Initializes an empty ring buffer in `memory`, by the producer before the
+  // consumer attaches. `capacity` must be a power of two of at least 64 bytes
+  // and `memory` must be 64-byte aligned and hold GetRequiredSize(capacity).
+  static absl::StatusOr<TokenRingBuffer> Initialize(absl::Span<uint8_t> memory,
+                                                    uint32_t capacity);
+
+  // Attaches to the ring buffer initialized in `memory`.
+  static absl::StatusOr<TokenRingBuffer> Attach(absl::Span<uint8_t> memory);
+
+  // Appends a record, waiting up to `timeout` for the consumer to free the
+  // space. Texts longer than half the capacity are split into several
+  // records, error messages are truncated. Only called by the producer.
+  // Returns DeadlineExceededError if the consumer does not free the space in
+  // time.
+  absl::Status Write(RecordType type, int candidate_index,
+                     absl::string_view data,
+                     absl::Duration timeout = absl::InfiniteDuration());
+
+  // Takes the next record, waiting up to `timeout` for the producer to write
+  // it. Only called by the consumer.
+  // Returns DeadlineExceededError if no record is written in time.
+  absl::StatusOr<Record> Read(
+      absl::Duration timeout = absl::InfiniteDuration());
+
+ private:
+  struct Header;
+
+  explicit TokenRingBuffer(Header* header);
+
+  // Returns the record bytes starting at `position`, modulo the capacity.
+  uint8_t* DataAt(uint32_t position) const;
+
+  // Writes one record of at most half the capacity.
+  absl::Status WriteRecord(uint32_t type, uint32_t candidate_index,
+                           absl::string_view data, absl::Time deadline);
+
+  Header* header_;
+  uint32_t capacity_;
+};
+
+// An observer writing the streamed text into a TokenRingBuffer, for a client
+// in another process. Each OnNext() writes the new text of every candidate as
+// one record per candidate, without copying the Responses. The ring buffer
+// must outlive the observer. If the consumer stops reading for longer than
+// `write_timeout`, the text is dropped, and the error is reported to the
+// consumer at the end of the inference when there is space again.
+class RingBufferObservable : public InferenceObservable {
+ public:
+  explicit RingBufferObservable(
+      TokenRingBuffer* ring_buffer,
+      absl::Duration write_timeout = absl::Seconds(10))
+      : ring_buffer_(*ring_buffer), write_timeout_(write_timeout) {}
+
+  void OnNext(const Responses& responses) override;
+  void OnNextText(int candidate_index, absl::string_view text) override;
+  void OnCandidateDone(int candidate_index) override;
+  void OnDone() override;
+  void OnError(const absl::Status& status) override;
+
+  // Returns the first error writing into the ring buffer.
+  const absl::Status& GetWriteStatus() const { return write_status_; }
+
+ private:
+  void Write(TokenRingBuffer::RecordType type, int candidate_index,
+             absl::string_view data);
+
+  TokenRingBuffer& ring_buffer_;
+  const absl::Duration write_timeout_;
+  absl::Status write_status_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_RING_BUFFER_OBSERVABLE_H_
@@ -0,0 +1,136 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/engine/ring_buffer_observable.h"
+
+#include <cstdint>
+#include <string>
+#include <thread>  // NOLINT
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/engine/io_types.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+using RecordType = TokenRingBuffer::RecordType;
+
+constexpr uint32_t kCapacity = 128;
+
+// Stands for the memory shared by the two processes.
+struct alignas(64) SharedMemory {
+  uint8_t bytes[1024] = {};
+
+  absl::Span<uint8_t> span() { return absl::MakeSpan(bytes); }
+};
+
+TEST(TokenRingBufferTest, InitializeRejectsInvalidArguments) {
+  SharedMemory memory;
+  EXPECT_THAT(TokenRingBuffer::Initialize(memory.span(), /*capacity=*/100),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TokenRingBuffer::Initialize(memory.span(), /*capacity=*/4096),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(TokenRingBuffer::Attach(memory.span()),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(TokenRingBufferTest, ReadsTheRecordsInOrder) {
+  SharedMemory memory;
+  ASSERT_OK_AND_ASSIGN(auto producer,
+                       TokenRingBuffer::Initialize(memory.span(), kCapacity));
+  ASSERT_OK_AND_ASSIGN(auto consumer, TokenRingBuffer::Attach(memory.span()));
+  EXPECT_THAT(consumer.Read(absl::Milliseconds(1)),
+              StatusIs(absl::StatusCode::kDeadlineExceeded));
+
+  ASSERT_OK(producer.Write(RecordType::kText, /*candidate_index=*/1, "Hello"));
+  ASSERT_OK(producer.Write(RecordType::kDone, /*candidate_index=*/0, ""));
+  ASSERT_OK_AND_ASSIGN(auto text, consumer.Read());
+  EXPECT_EQ(text.type, RecordType::kText);
+  EXPECT_EQ(text.candidate_index, 1);
+  EXPECT_EQ(text.data, "Hello");
+  ASSERT_OK_AND_ASSIGN(auto done, consumer.Read());
+  EXPECT_EQ(done.type, RecordType::kDone);
+}
+
+TEST(TokenRingBufferTest, WriteTimesOutWhenFull) {
+  SharedMemory memory;
+  ASSERT_OK_AND_ASSIGN(auto producer,
+                       TokenRingBuffer::Initialize(memory.span(), kCapacity));
+  const std::string text(40, 'a');
+  ASSERT_OK(producer.Write(RecordType::kText, 0, text));
+  ASSERT_OK(producer.Write(RecordType::kText, 0, text));
+  EXPECT_THAT(producer.Write(RecordType::kText, 0, text, absl::Milliseconds(1)),
+              StatusIs(absl::StatusCode::kDeadlineExceeded));
+}
+
+TEST(TokenRingBufferTest, StreamsAcrossThreadsThroughTheWrapAround) {
+  SharedMemory memory;
+  ASSERT_OK_AND_ASSIGN(auto producer,
+                       TokenRingBuffer::Initialize(memory.span(), kCapacity));
+  ASSERT_OK_AND_ASSIGN(auto consumer, TokenRingBuffer::Attach(memory.span()));
+  constexpr int kNumRecords = 1000;
+  std::thread producer_thread([&producer]() {
+    for (int i = 0; i < kNumRecords; ++i) {
+      ASSERT_OK(producer.Write(RecordType::kText, 0, absl::StrCat("t", i)));
+    }
+    // Longer than half the capacity, so split into several records.
+    ASSERT_OK(producer.Write(RecordType::kText, 0, std::string(100, 'b')));
+  });
+  for (int i = 0; i < kNumRecords; ++i) {
+    ASSERT_OK_AND_ASSIGN(auto record, consumer.Read(absl::Seconds(10)));
+    ASSERT_EQ(record.data, absl::StrCat("t", i));
+  }
+  std::string long_text;
+  while (long_text.size() < 100) {
+    ASSERT_OK_AND_ASSIGN(auto record, consumer.Read(absl::Seconds(10)));
+    long_text += record.data;
+  }
+  producer_thread.join();
+  EXPECT_EQ(long_text, std::string(100, 'b'));
+}
+
+TEST(RingBufferObservableTest, WritesTheTextOfEveryCandidate) {
+  SharedMemory memory;
+  ASSERT_OK_AND_ASSIGN(auto producer,
+                       TokenRingBuffer::Initialize(memory.span(), kCapacity));
+  ASSERT_OK_AND_ASSIGN(auto consumer, TokenRingBuffer::Attach(memory.span()));
+  RingBufferObservable observer(&producer);
+  Responses responses(/*num_output_candidates=*/2);
+  responses.GetMutableResponseTexts()[1] = " World";
+  observer.OnNext(responses);
+  observer.OnCandidateDone(1);
+  observer.OnError(absl::CancelledError("cancelled"));
+
+  ASSERT_OK_AND_ASSIGN(auto text, consumer.Read());
+  EXPECT_EQ(text.candidate_index, 1);
+  EXPECT_EQ(text.data, " World");
+  ASSERT_OK_AND_ASSIGN(auto candidate_done, consumer.Read());
+  EXPECT_EQ(candidate_done.type, RecordType::kCandidateDone);
+  EXPECT_EQ(candidate_done.candidate_index, 1);
+  ASSERT_OK_AND_ASSIGN(auto error, consumer.Read());
+  EXPECT_EQ(error.type, RecordType::kError);
+  EXPECT_EQ(error.candidate_index,
+            static_cast<int>(absl::StatusCode::kCancelled));
+  EXPECT_EQ(error.data, "cancelled");
+  EXPECT_OK(observer.GetWriteStatus());
+}
+
+}  // namespace
+}  // namespace litert::lm
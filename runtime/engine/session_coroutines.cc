@@ -0,0 +1,123 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/engine/session_coroutines.h"
+
+#include <coroutine>  // NOLINT
+#include <optional>
+#include <utility>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "runtime/engine/engine.h"
+#include "runtime/engine/io_types.h"
+
+namespace litert::lm {
+
+bool PrefillAwaitable::await_suspend(std::coroutine_handle<> awaiting) {
+  awaiting_ = awaiting;
+  // The prefill may finish, and resume the coroutine, before the call
+  // returns, so nothing of the awaitable is touched after it.
+  absl::Status status = session_.RunPrefillAsync(contents_, this);
+  if (!status.ok()) {
+    // The prefill is not scheduled, so the coroutine goes on right away.
+    status_ = std::move(status);
+    return false;
+  }
+  return true;
+}
+
+void PrefillAwaitable::OnDone() {
+  status_ = absl::OkStatus();
+  awaiting_.resume();
+}
+
+void PrefillAwaitable::OnError(const absl::Status& status) {
+  status_ = status;
+  awaiting_.resume();
+}
+
+DecodeStream::DecodeStream(Engine::Session& session) {
+  if (absl::Status status = session.RunDecodeAsync(this); !status.ok()) {
+    Finish(std::move(status));
+  }
+}
+
+DecodeStream::~DecodeStream() { done_.WaitForNotification(); }
+
+bool DecodeStream::NextAwaitable::await_ready() const {
+  absl::MutexLock lock(&stream_.mutex_);
+  return !stream_.responses_.empty() || stream_.final_status_.has_value();
+}
+
+bool DecodeStream::NextAwaitable::await_suspend(
+    std::coroutine_handle<> awaiting) {
+  absl::MutexLock lock(&stream_.mutex_);
+  // A response may have come since await_ready().
+  if (!stream_.responses_.empty() || stream_.final_status_.has_value()) {
+    return false;
+  }
+  stream_.awaiting_ = awaiting;
+  return true;
+}
+
+absl::StatusOr<std::optional<Responses>>
+DecodeStream::NextAwaitable::await_resume() {
+  absl::MutexLock lock(&stream_.mutex_);
+  if (!stream_.responses_.empty()) {
+    Responses responses = std::move(stream_.responses_.front());
+    stream_.responses_.pop_front();
+    return std::optional<Responses>(std::move(responses));
+  }
+  if (!stream_.final_status_->ok()) {
+    return *stream_.final_status_;
+  }
+  return std::nullopt;
+}
+
+void DecodeStream::OnNext(const Responses& responses) {
+  std::coroutine_handle<> awaiting;
+  {
+    absl::MutexLock lock(&mutex_);
+    responses_.push_back(responses);
+    awaiting = std::exchange(awaiting_, nullptr);
+  }
+  // Resumed inline on the decoding thread, which goes on with the next step
+  // once the coroutine suspends again.
+  if (awaiting) {
+    awaiting.resume();
+  }
+}
+
+void DecodeStream::OnDone() { Finish(absl::OkStatus()); }
+
+void DecodeStream::OnError(const absl::Status& status) { Finish(status); }
+
+void DecodeStream::Finish(absl::Status status) {
+  std::coroutine_handle<> awaiting;
+  {
+    absl::MutexLock lock(&mutex_);
+    final_status_ = std::move(status);
+    awaiting = std::exchange(awaiting_, nullptr);
+  }
+  // The coroutine may destroy the stream once it is resumed, so the stream is
+  // not touched afterwards.
+  done_.Notify();
+  if (awaiting) {
+    awaiting.resume();
+  }
+}
+
+}  // namespace litert::lm
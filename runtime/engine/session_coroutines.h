@@ -0,0 +1,225 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_SESSION_COROUTINES_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_SESSION_COROUTINES_H_
+
+#include <atomic>
+#include <coroutine>  // NOLINT
+#include <deque>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
+#include "runtime/engine/engine.h"
+#include "runtime/engine/io_types.h"
+
+// C++20 coroutine adapters of the asynchronous Session API, for composing the
+// turns of a conversation, e.g. prefill -> decode -> tool call -> prefill, as
+// straight-line code instead of chained observers:
+//
+//   Task<absl::Status> Chat(Engine::Session& session) {
+//     absl::Status status =
+//         co_await AsyncPrefill(session, {InputText("What's the weather?")});
+//     if (!status.ok()) co_return status;
+//     DecodeStream stream(session);
+//     while (true) {
+//       absl::StatusOr<std::optional<Responses>> responses =
+//           co_await stream.Next();
+//       if (!responses.ok()) co_return responses.status();
+//       if (!responses->has_value()) break;
+//       Print(**responses);
+//     }
+//     co_return absl::OkStatus();
+//   }
+//
+//   absl::Status status = Chat(*session).Wait();
+//
+// A suspended coroutine is resumed inline on the engine thread completing the
+// awaited call, without another thread handoff. Until it suspends again, it
+// runs on that thread, so it must not make the blocking Session calls, e.g.
+// RunPrefill() or RunDecode(), which would wait for the very same thread.
+
+namespace litert::lm {
+
+// A coroutine returning a T, e.g. an absl::Status, started eagerly when it is
+// called. It is awaited with co_await from another coroutine, or waited for
+// with Wait() from a thread outside the engine. Destroying an unfinished Task
+// waits for it.
+template <typename T>
+class Task {
+ public:
+  struct promise_type {
+    Task get_return_object() {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    std::suspend_never initial_suspend() noexcept { return {}; }
+    auto final_suspend() noexcept { return FinalAwaiter(); }
+    void return_value(T result) { value.emplace(std::move(result)); }
+    void unhandled_exception() { std::terminate(); }
+
+    std::optional<T> value;
+    // The coroutine awaiting this one, resumed when this one finishes.
+    std::coroutine_handle<> continuation;
+    // Set by the second of the awaiter registering `continuation` and the
+    // coroutine finishing, which is then responsible for resuming it.
+    std::atomic<bool> continuation_ready = false;
+    absl::Notification done;
+  };
+
+  Task(Task&& other) noexcept
+      : handle_(std::exchange(other.handle_, nullptr)) {}
+  Task& operator=(Task&& other) noexcept {
+    if (this != &other) {
+      Destroy();
+      handle_ = std::exchange(other.handle_, nullptr);
+    }
+    return *this;
+  }
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+  ~Task() { Destroy(); }
+
+  // Blocks until the coroutine finishes and returns its result.
+  T Wait() && {
+    handle_.promise().done.WaitForNotification();
+    return std::move(*handle_.promise().value);
+  }
+
+  bool await_ready() const noexcept {
+    return handle_.promise().done.HasBeenNotified();
+  }
+  bool await_suspend(std::coroutine_handle<> awaiting) noexcept {
+    handle_.promise().continuation = awaiting;
+    // Not suspended if the coroutine finished in the meantime.
+    return !handle_.promise().continuation_ready.exchange(
+        true, std::memory_order_acq_rel);
+  }
+  T await_resume() { return std::move(*handle_.promise().value); }
+
+ private:
+  struct FinalAwaiter {
+    bool await_ready() noexcept { return false; }
+    std::coroutine_handle<> await_suspend(
+        std::coroutine_handle<promise_type> handle) noexcept {
+      promise_type& promise = handle.promise();
+      std::coroutine_handle<> next = std::noop_coroutine();
+      if (promise.continuation_ready.exchange(true,
+                                              std::memory_order_acq_rel)) {
+        next = promise.continuation;
+      }
+      // The frame may be destroyed by a waiting thread right after this.
+      promise.done.Notify();
+      return next;
+    }
+    void await_resume() noexcept {}
+  };
+
+  explicit Task(std::coroutine_handle<promise_type> handle)
+      : handle_(handle) {}
+
+  void Destroy() {
+    if (handle_) {
+      handle_.promise().done.WaitForNotification();
+      handle_.destroy();
+      handle_ = nullptr;
+    }
+  }
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+// Awaits RunPrefillAsync() of `contents`, which must outlive the co_await
+// expression, and returns its status.
+class PrefillAwaitable : private InferenceObservable {
+ public:
+  PrefillAwaitable(Engine::Session& session,
+                   const std::vector<InputData>& contents)
+      : session_(session), contents_(contents) {}
+
+  bool await_ready() const noexcept { return false; }
+  bool await_suspend(std::coroutine_handle<> awaiting);
+  absl::Status await_resume() { return std::move(status_); }
+
+ private:
+  void OnDone() override;
+  void OnError(const absl::Status& status) override;
+
+  Engine::Session& session_;
+  const std::vector<InputData>& contents_;
+  std::coroutine_handle<> awaiting_;
+  absl::Status status_;
+};
+
+inline PrefillAwaitable AsyncPrefill(Engine::Session& session,
+                                     const std::vector<InputData>& contents) {
+  return PrefillAwaitable(session, contents);
+}
+
+// An asynchronous generator of the responses streamed by RunDecodeAsync(),
+// which it starts when it is created. Each `co_await Next()` returns the next
+// response, std::nullopt after the last one, or the error of the decoding.
+// The responses are kept until they are awaited, so the decoding is not held
+// back by a consumer that is not suspended in Next(). The stream must be read
+// to its end, or the session cancelled, before it is destroyed, which waits
+// for the decoding to finish.
+class DecodeStream : private InferenceObservable {
+ public:
+  explicit DecodeStream(Engine::Session& session);
+  ~DecodeStream() override;
+
+  DecodeStream(const DecodeStream&) = delete;
+  DecodeStream& operator=(const DecodeStream&) = delete;
+
+  class NextAwaitable {
+   public:
+    bool await_ready() const;
+    bool await_suspend(std::coroutine_handle<> awaiting);
+    absl::StatusOr<std::optional<Responses>> await_resume();
+
+   private:
+    friend class DecodeStream;
+    explicit NextAwaitable(DecodeStream& stream) : stream_(stream) {}
+
+    DecodeStream& stream_;
+  };
+
+  // Only one Next() is awaited at a time.
+  NextAwaitable Next() { return NextAwaitable(*this); }
+
+ private:
+  void OnNext(const Responses& responses) override;
+  void OnDone() override;
+  void OnError(const absl::Status& status) override;
+
+  // Records the final status and resumes the awaiting coroutine, if any.
+  void Finish(absl::Status status);
+
+  absl::Mutex mutex_;
+  std::deque<Responses> responses_ ABSL_GUARDED_BY(mutex_);
+  std::optional<absl::Status> final_status_ ABSL_GUARDED_BY(mutex_);
+  std::coroutine_handle<> awaiting_ ABSL_GUARDED_BY(mutex_);
+  absl::Notification done_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_ENGINE_SESSION_COROUTINES_H_
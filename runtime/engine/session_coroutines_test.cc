@@ -0,0 +1,186 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/engine/session_coroutines.h"
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "runtime/engine/engine.h"
+#include "runtime/engine/io_types.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::status::StatusIs;
+
+// Runs each asynchronous call on a thread of its own, standing for the engine
+// worker thread. The prefill of "fail" fails, and each decode streams the
+// prompts prefilled since the previous one, one response per prompt.
+class FakeSession : public Engine::Session {
+ public:
+  ~FakeSession() override {
+    // The threads are started by one another, so they are joined in order.
+    for (int i = 0;; ++i) {
+      std::thread thread;
+      {
+        absl::MutexLock lock(&mutex_);
+        if (i == threads_.size()) {
+          break;
+        }
+        thread = std::move(threads_[i]);
+      }
+      thread.join();
+    }
+  }
+
+  absl::StatusOr<Responses> GenerateContent(
+      const std::vector<InputData>& contents) override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  absl::Status GenerateContentStream(const std::vector<InputData>& contents,
+                                     InferenceObservable* observer) override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  absl::Status RunPrefill(const std::vector<InputData>& contents) override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  absl::Status RunPrefillAsync(const std::vector<InputData>& contents,
+                               InferenceObservable* observer) override {
+    const std::string prompt(*ToStringView(contents[0]));
+    Start([this, prompt, observer]() {
+      if (prompt == "fail") {
+        observer->OnError(absl::InternalError("Prefill failed."));
+        return;
+      }
+      prompts_.push_back(prompt);
+      observer->OnDone();
+    });
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<Responses> RunDecode() override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+  absl::Status RunDecodeAsync(InferenceObservable* observer) override {
+    Start([this, observer]() {
+      std::vector<std::string> prompts = std::move(prompts_);
+      prompts_.clear();
+      for (const std::string& prompt : prompts) {
+        Responses responses(/*num_output_candidates=*/1);
+        responses.GetMutableResponseTexts()[0] = prompt;
+        observer->OnNext(responses);
+      }
+      observer->OnDone();
+    });
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<BenchmarkInfo> GetBenchmarkInfo() override {
+    return absl::UnimplementedError("Not implemented.");
+  }
+
+ private:
+  void Start(std::function<void()> task) {
+    absl::MutexLock lock(&mutex_);
+    threads_.emplace_back(std::move(task));
+  }
+
+  absl::Mutex mutex_;
+  std::vector<std::thread> threads_;
+  // Only used by one call at a time.
+  std::vector<std::string> prompts_;
+};
+
+// Decodes and returns the texts of the stream.
+Task<absl::StatusOr<std::vector<std::string>>> DecodeTexts(
+    Engine::Session& session) {
+  std::vector<std::string> texts;
+  DecodeStream stream(session);
+  while (true) {
+    absl::StatusOr<std::optional<Responses>> responses =
+        co_await stream.Next();
+    if (!responses.ok()) {
+      co_return responses.status();
+    }
+    if (!responses->has_value()) {
+      break;
+    }
+    texts.emplace_back(*(*responses)->GetResponseTextAt(0));
+  }
+  co_return texts;
+}
+
+// Prefills `prompts` one by one, with a decode after each one.
+Task<absl::StatusOr<std::vector<std::string>>> Chat(
+    Engine::Session& session, std::vector<std::string> prompts) {
+  std::vector<std::string> texts;
+  for (const std::string& prompt : prompts) {
+    absl::Status status = co_await AsyncPrefill(session, {InputText(prompt)});
+    if (!status.ok()) {
+      co_return status;
+    }
+    absl::StatusOr<std::vector<std::string>> turn_texts =
+        co_await DecodeTexts(session);
+    if (!turn_texts.ok()) {
+      co_return turn_texts.status();
+    }
+    texts.insert(texts.end(), turn_texts->begin(), turn_texts->end());
+  }
+  co_return texts;
+}
+
+TEST(SessionCoroutinesTest, ComposesPrefillsAndDecodes) {
+  FakeSession session;
+  absl::StatusOr<std::vector<std::string>> texts =
+      Chat(session, {"Hello", "How are you?"}).Wait();
+  ASSERT_OK(texts);
+  EXPECT_THAT(*texts, ElementsAre("Hello", "How are you?"));
+}
+
+TEST(SessionCoroutinesTest, ReturnsThePrefillError) {
+  FakeSession session;
+  EXPECT_THAT(Chat(session, {"Hello", "fail"}).Wait(),
+              StatusIs(absl::StatusCode::kInternal));
+}
+
+TEST(SessionCoroutinesTest, ReturnsTheErrorOfAnUnsupportedSession) {
+  class SyncOnlySession : public FakeSession {
+   public:
+    absl::Status RunDecodeAsync(InferenceObservable* observer) override {
+      return absl::UnimplementedError("Not implemented.");
+    }
+  };
+  SyncOnlySession session;
+  EXPECT_THAT(DecodeTexts(session).Wait(),
+              StatusIs(absl::StatusCode::kUnimplemented));
+}
+
+}  // namespace
+}  // namespace litert::lm
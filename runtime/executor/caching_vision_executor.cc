@@ -0,0 +1,199 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/caching_vision_executor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/hash/hash.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/vision_executor.h"
+#include "runtime/util/litert_status_util.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// Hashes the contents and the dimensions of `image`.
+absl::StatusOr<uint64_t> HashImage(const ::litert::TensorBuffer& image) {
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto buffer, image.Duplicate());
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, buffer.TensorType());
+  const auto layout = tensor_type.Layout();
+  const auto dimensions = layout.Dimensions();
+  std::vector<int> dims(dimensions.begin(), dimensions.end());
+  LITERT_ASSIGN_OR_RETURN_ABSL(size_t size, buffer.PackedSize());
+  LITERT_ASSIGN_OR_RETURN_ABSL(
+      auto lock_and_addr,
+      ::litert::TensorBufferScopedLock::Create(
+          buffer, ::litert::TensorBuffer::LockMode::kRead));
+  const absl::string_view contents(
+      static_cast<const char*>(lock_and_addr.second), size);
+  return absl::HashOf(dims, contents);
+}
+
+// Returns the duplicate of `buffer`, sharing its memory, and adds its size to
+// `size_in_bytes`.
+absl::StatusOr<std::optional<::litert::TensorBuffer>> DuplicateBuffer(
+    const absl::StatusOr<const ::litert::TensorBuffer*>& buffer,
+    size_t& size_in_bytes) {
+  if (!buffer.ok()) {
+    // The embeddings are not set.
+    return std::nullopt;
+  }
+  LITERT_ASSIGN_OR_RETURN_ABSL(size_t buffer_size, (*buffer)->PackedSize());
+  size_in_bytes += buffer_size;
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto duplicate, (*buffer)->Duplicate());
+  return duplicate;
+}
+
+// Returns the duplicate of `vision_data`, sharing its buffers, and its size.
+absl::StatusOr<std::pair<ExecutorVisionData, size_t>> DuplicateVisionData(
+    const ExecutorVisionData& vision_data) {
+  size_t size_in_bytes = 0;
+  ASSIGN_OR_RETURN(auto embeddings,
+                   DuplicateBuffer(vision_data.GetEmbeddingsPtr(),
+                                   size_in_bytes));
+  ASSIGN_OR_RETURN(auto per_layer_embeddings,
+                   DuplicateBuffer(vision_data.GetPerLayerEmbeddingsPtr(),
+                                   size_in_bytes));
+  return std::make_pair(ExecutorVisionData(std::move(embeddings),
+                                           std::move(per_layer_embeddings)),
+                        size_in_bytes);
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<CachingVisionExecutor>>
+CachingVisionExecutor::Create(std::unique_ptr<VisionExecutor> vision_executor,
+                              size_t max_size_in_bytes) {
+  if (vision_executor == nullptr) {
+    return absl::InvalidArgumentError("The vision executor must not be null.");
+  }
+  if (max_size_in_bytes == 0) {
+    return absl::InvalidArgumentError(
+        "The vision embedding cache budget must be positive.");
+  }
+  return absl::WrapUnique(
+      new CachingVisionExecutor(std::move(vision_executor), max_size_in_bytes));
+}
+
+absl::StatusOr<ExecutorVisionData> CachingVisionExecutor::Encode(
+    const ::litert::TensorBuffer& input_image_tensor) {
+  ASSIGN_OR_RETURN(uint64_t hash, HashImage(input_image_tensor));
+  ASSIGN_OR_RETURN(std::optional<ExecutorVisionData> cached, Lookup(hash));
+  if (cached.has_value()) {
+    return *std::move(cached);
+  }
+  // The lock is not held while encoding. The same image encoded twice
+  // concurrently is encoded twice, and cached once.
+  ASSIGN_OR_RETURN(ExecutorVisionData vision_data,
+                   vision_executor_->Encode(input_image_tensor));
+  RETURN_IF_ERROR(Store(hash, vision_data));
+  return vision_data;
+}
+
+absl::StatusOr<std::vector<ExecutorVisionData>>
+CachingVisionExecutor::EncodeBatch(
+    absl::Span<const ::litert::TensorBuffer> input_image_tensors) {
+  std::vector<ExecutorVisionData> vision_data(input_image_tensors.size());
+  // The hashes and the duplicates of the images not cached, in order.
+  std::vector<size_t> missed_indices;
+  std::vector<uint64_t> missed_hashes;
+  std::vector<::litert::TensorBuffer> missed_images;
+  for (size_t i = 0; i < input_image_tensors.size(); ++i) {
+    ASSIGN_OR_RETURN(uint64_t hash, HashImage(input_image_tensors[i]));
+    ASSIGN_OR_RETURN(std::optional<ExecutorVisionData> cached, Lookup(hash));
+    if (cached.has_value()) {
+      vision_data[i] = *std::move(cached);
+      continue;
+    }
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto image,
+                                 input_image_tensors[i].Duplicate());
+    missed_indices.push_back(i);
+    missed_hashes.push_back(hash);
+    missed_images.push_back(std::move(image));
+  }
+  if (missed_images.empty()) {
+    return vision_data;
+  }
+  ASSIGN_OR_RETURN(std::vector<ExecutorVisionData> encoded,
+                   vision_executor_->EncodeBatch(missed_images));
+  RET_CHECK_EQ(encoded.size(), missed_images.size())
+      << "The vision executor returned the vision data of "
+      << encoded.size() << " images for " << missed_images.size() << ".";
+  for (size_t i = 0; i < encoded.size(); ++i) {
+    RETURN_IF_ERROR(Store(missed_hashes[i], encoded[i]));
+    vision_data[missed_indices[i]] = std::move(encoded[i]);
+  }
+  return vision_data;
+}
+
+absl::StatusOr<std::optional<ExecutorVisionData>>
+CachingVisionExecutor::Lookup(uint64_t hash) {
+  absl::MutexLock lock(&mutex_);
+  const ExecutorVisionData* vision_data = cache_.Lookup(hash);
+  if (vision_data == nullptr) {
+    return std::nullopt;
+  }
+  ASSIGN_OR_RETURN(auto duplicate, DuplicateVisionData(*vision_data));
+  return std::move(duplicate.first);
+}
+
+absl::Status CachingVisionExecutor::Store(
+    uint64_t hash, const ExecutorVisionData& vision_data) {
+  ASSIGN_OR_RETURN(auto duplicate, DuplicateVisionData(vision_data));
+  absl::MutexLock lock(&mutex_);
+  cache_.Insert(hash, std::move(duplicate.first), duplicate.second);
+  return absl::OkStatus();
+}
+
+void CachingVisionExecutor::Clear() {
+  absl::MutexLock lock(&mutex_);
+  cache_.Clear();
+}
+
+int CachingVisionExecutor::NumEntries() const {
+  absl::MutexLock lock(&mutex_);
+  return cache_.NumEntries();
+}
+
+size_t CachingVisionExecutor::SizeInBytes() const {
+  absl::MutexLock lock(&mutex_);
+  return cache_.SizeInBytes();
+}
+
+int CachingVisionExecutor::NumHits() const {
+  absl::MutexLock lock(&mutex_);
+  return cache_.NumHits();
+}
+
+int CachingVisionExecutor::NumMisses() const {
+  absl::MutexLock lock(&mutex_);
+  return cache_.NumMisses();
+}
+
+}  // namespace litert::lm
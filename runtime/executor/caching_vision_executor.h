@@ -0,0 +1,103 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_CACHING_VISION_EXECUTOR_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_CACHING_VISION_EXECUTOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/vision_executor.h"
+#include "runtime/util/lru_cache.h"
+
+namespace litert::lm {
+
+// A vision executor keeping the embeddings of the latest images it encoded,
+// keyed by the hash of their contents and dimensions, such that an image sent
+// again, e.g. on every turn of a multi-turn chat, skips the vision encoder.
+//
+// The cache is bounded by the total size of the stored embeddings. The least
+// recently used entries are evicted first when a new entry does not fit.
+//
+// The returned embeddings of a cached image share their buffers with the
+// cache, so they must not be written to. The cache is thread-safe, while the
+// wrapped executor is only called from one thread at a time.
+class CachingVisionExecutor : public VisionExecutor {
+ public:
+  // Creates a CachingVisionExecutor over `vision_executor`, which holds at
+  // most `max_size_in_bytes` of embeddings.
+  static absl::StatusOr<std::unique_ptr<CachingVisionExecutor>> Create(
+      std::unique_ptr<VisionExecutor> vision_executor,
+      size_t max_size_in_bytes);
+
+  // Returns the cached embeddings of `input_image_tensor` if any, or encodes
+  // it with the wrapped executor and caches the result.
+  absl::StatusOr<ExecutorVisionData> Encode(
+      const ::litert::TensorBuffer& input_image_tensor) override;
+
+  // Returns the cached embeddings of each image, and encodes the images not
+  // cached in one batch with the wrapped executor.
+  absl::StatusOr<std::vector<ExecutorVisionData>> EncodeBatch(
+      absl::Span<const ::litert::TensorBuffer> input_image_tensors) override;
+
+  absl::StatusOr<std::vector<int>> GetExpectedInputDimension()
+      const override {
+    return vision_executor_->GetExpectedInputDimension();
+  }
+
+  // Removes all the entries. The hit and miss counters are kept.
+  void Clear();
+
+  int NumEntries() const;
+  size_t SizeInBytes() const;
+  int NumHits() const;
+  int NumMisses() const;
+
+ private:
+  CachingVisionExecutor(std::unique_ptr<VisionExecutor> vision_executor,
+                        size_t max_size_in_bytes)
+      : vision_executor_(std::move(vision_executor)),
+        cache_(max_size_in_bytes) {}
+
+  // Returns the cached embeddings of the image of `hash`, or std::nullopt,
+  // and counts the hit or miss.
+  absl::StatusOr<std::optional<ExecutorVisionData>> Lookup(uint64_t hash)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  // Caches a duplicate of `vision_data`, the embeddings of the image of
+  // `hash`. Embeddings larger than the whole budget are dropped.
+  absl::Status Store(uint64_t hash, const ExecutorVisionData& vision_data)
+      ABSL_LOCKS_EXCLUDED(mutex_);
+
+  const std::unique_ptr<VisionExecutor> vision_executor_;
+
+  mutable absl::Mutex mutex_;
+  // The embeddings keyed by the hash of their image.
+  LruCache<uint64_t, ExecutorVisionData> cache_ ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_CACHING_VISION_EXECUTOR_H_
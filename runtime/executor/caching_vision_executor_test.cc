@@ -0,0 +1,199 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/caching_vision_executor.h"
+
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "litert/test/matchers.h"  // from @litert
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/vision_executor.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::IsOkAndHolds;
+using ::testing::status::StatusIs;
+
+// Encodes an image of 2 values into 2 embeddings, each the sum of the image
+// values plus 1 for every image encoded so far, such that the encodings of the
+// same image differ.
+class CountingVisionExecutor : public VisionExecutor {
+ public:
+  explicit CountingVisionExecutor(int* num_encodes)
+      : num_encodes_(num_encodes) {}
+
+  absl::StatusOr<ExecutorVisionData> Encode(
+      const ::litert::TensorBuffer& input_image_tensor) override {
+    auto image = ReferTensorBufferAsSpan<float>(input_image_tensor);
+    if (!image) {
+      return absl::InternalError(image.Error().Message());
+    }
+    ++*num_encodes_;
+    const float value = (*image)[0] + (*image)[1] + *num_encodes_;
+    std::vector<float> embeddings = {value, value};
+    auto embeddings_buffer =
+        CopyToTensorBuffer<float>(absl::MakeSpan(embeddings), {2, 1});
+    if (!embeddings_buffer) {
+      return absl::InternalError(embeddings_buffer.Error().Message());
+    }
+    return ExecutorVisionData(std::move(*embeddings_buffer), std::nullopt);
+  }
+
+  absl::StatusOr<std::vector<int>> GetExpectedInputDimension()
+      const override {
+    return std::vector<int>{1, 1, 2, 1};
+  }
+
+ private:
+  int* num_encodes_;
+};
+
+// Records the number of images of each batch.
+class BatchCountingVisionExecutor : public CountingVisionExecutor {
+ public:
+  BatchCountingVisionExecutor(int* num_encodes,
+                              std::vector<int>* batch_sizes)
+      : CountingVisionExecutor(num_encodes), batch_sizes_(batch_sizes) {}
+
+  absl::StatusOr<std::vector<ExecutorVisionData>> EncodeBatch(
+      absl::Span<const ::litert::TensorBuffer> input_image_tensors) override {
+    batch_sizes_->push_back(input_image_tensors.size());
+    return CountingVisionExecutor::EncodeBatch(input_image_tensors);
+  }
+
+ private:
+  std::vector<int>* batch_sizes_;
+};
+
+::litert::TensorBuffer MakeImage(float first, float second) {
+  std::vector<float> image = {first, second};
+  return *CopyToTensorBuffer<float>(absl::MakeSpan(image), {1, 1, 2, 1});
+}
+
+float GetFirstEmbedding(const ExecutorVisionData& vision_data) {
+  auto embeddings = ReferTensorBufferAsSpan<float>(
+      **vision_data.GetEmbeddingsPtr());
+  return (*embeddings)[0];
+}
+
+TEST(CachingVisionExecutorTest, CreateRejectsInvalidArguments) {
+  int num_encodes = 0;
+  EXPECT_THAT(CachingVisionExecutor::Create(nullptr, 1024),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(CachingVisionExecutor::Create(
+                  std::make_unique<CountingVisionExecutor>(&num_encodes), 0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(CachingVisionExecutorTest, SkipsTheEncoderForTheSameImage) {
+  int num_encodes = 0;
+  ASSERT_OK_AND_ASSIGN(
+      auto executor,
+      CachingVisionExecutor::Create(
+          std::make_unique<CountingVisionExecutor>(&num_encodes), 1024));
+  EXPECT_THAT(executor->GetExpectedInputDimension(),
+              IsOkAndHolds(std::vector<int>{1, 1, 2, 1}));
+
+  ASSERT_OK_AND_ASSIGN(auto first, executor->Encode(MakeImage(1, 2)));
+  EXPECT_EQ(GetFirstEmbedding(first), 4);
+  // The same contents in another buffer.
+  ASSERT_OK_AND_ASSIGN(auto second, executor->Encode(MakeImage(1, 2)));
+  EXPECT_EQ(GetFirstEmbedding(second), 4);
+  EXPECT_EQ(num_encodes, 1);
+  // Another image with the same sum.
+  ASSERT_OK_AND_ASSIGN(auto third, executor->Encode(MakeImage(2, 1)));
+  EXPECT_EQ(GetFirstEmbedding(third), 5);
+  EXPECT_EQ(num_encodes, 2);
+
+  EXPECT_EQ(executor->NumHits(), 1);
+  EXPECT_EQ(executor->NumMisses(), 2);
+  EXPECT_EQ(executor->NumEntries(), 2);
+  EXPECT_EQ(executor->SizeInBytes(), 2 * 2 * sizeof(float));
+
+  executor->Clear();
+  EXPECT_EQ(executor->NumEntries(), 0);
+  EXPECT_EQ(executor->SizeInBytes(), 0);
+  ASSERT_OK_AND_ASSIGN(auto fourth, executor->Encode(MakeImage(1, 2)));
+  EXPECT_EQ(GetFirstEmbedding(fourth), 6);
+  EXPECT_EQ(num_encodes, 3);
+}
+
+TEST(CachingVisionExecutorTest, EvictsTheLeastRecentlyUsedImage) {
+  int num_encodes = 0;
+  // Room for the embeddings of 2 images.
+  ASSERT_OK_AND_ASSIGN(
+      auto executor,
+      CachingVisionExecutor::Create(
+          std::make_unique<CountingVisionExecutor>(&num_encodes),
+          2 * 2 * sizeof(float)));
+
+  EXPECT_OK(executor->Encode(MakeImage(1, 0)));
+  EXPECT_OK(executor->Encode(MakeImage(2, 0)));
+  // The first image becomes the most recently used.
+  EXPECT_OK(executor->Encode(MakeImage(1, 0)));
+  EXPECT_OK(executor->Encode(MakeImage(3, 0)));
+  EXPECT_EQ(num_encodes, 3);
+  EXPECT_EQ(executor->NumEntries(), 2);
+
+  EXPECT_OK(executor->Encode(MakeImage(1, 0)));
+  EXPECT_EQ(num_encodes, 3);
+  EXPECT_OK(executor->Encode(MakeImage(2, 0)));
+  EXPECT_EQ(num_encodes, 4);
+}
+
+TEST(CachingVisionExecutorTest, EncodesTheMissedImagesInOneBatch) {
+  int num_encodes = 0;
+  std::vector<int> batch_sizes;
+  ASSERT_OK_AND_ASSIGN(
+      auto executor,
+      CachingVisionExecutor::Create(
+          std::make_unique<BatchCountingVisionExecutor>(&num_encodes,
+                                                        &batch_sizes),
+          1024));
+
+  ASSERT_OK_AND_ASSIGN(auto cached, executor->Encode(MakeImage(1, 2)));
+  EXPECT_EQ(GetFirstEmbedding(cached), 4);
+  std::vector<::litert::TensorBuffer> images;
+  images.push_back(MakeImage(3, 0));
+  images.push_back(MakeImage(1, 2));
+  images.push_back(MakeImage(5, 0));
+  ASSERT_OK_AND_ASSIGN(auto vision_data, executor->EncodeBatch(images));
+  ASSERT_EQ(vision_data.size(), 3);
+  EXPECT_EQ(GetFirstEmbedding(vision_data[0]), 5);
+  EXPECT_EQ(GetFirstEmbedding(vision_data[1]), 4);
+  EXPECT_EQ(GetFirstEmbedding(vision_data[2]), 8);
+  EXPECT_EQ(batch_sizes, std::vector<int>{2});
+  EXPECT_EQ(executor->NumHits(), 1);
+  EXPECT_EQ(executor->NumMisses(), 3);
+
+  // All the images are cached now.
+  ASSERT_OK_AND_ASSIGN(vision_data, executor->EncodeBatch(images));
+  EXPECT_EQ(GetFirstEmbedding(vision_data[2]), 8);
+  EXPECT_EQ(batch_sizes, std::vector<int>{2});
+  EXPECT_EQ(num_encodes, 3);
+}
+
+}  // namespace
+}  // namespace litert::lm
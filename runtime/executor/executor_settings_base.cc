@@ -14,6 +14,7 @@
 
 #include "runtime/executor/executor_settings_base.h"
 
+#include <cstring>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -45,6 +46,8 @@ std::ostream& operator<<(std::ostream& os, const Backend& backend) {
       return os << "GOOGLE_TENSOR_ARTISAN";
     case Backend::NPU:
       return os << "NPU";
+    case Backend::AUTO:
+      return os << "AUTO";
     default:
       return os << "UNSPECIFIED";
   }
@@ -64,6 +67,8 @@ absl::StatusOr<Backend> GetBackendFromString(absl::string_view backend_str) {
     backend = Backend::CPU_ARTISAN;
   } else if (absl::EqualsIgnoreCase(backend_str, "google_tensor_artisan")) {
     backend = Backend::GOOGLE_TENSOR_ARTISAN;
+  } else if (absl::EqualsIgnoreCase(backend_str, "auto")) {
+    backend = Backend::AUTO;
   } else {
     return absl::InvalidArgumentError(
         absl::StrCat("Unsupported backend: ", backend_str));
@@ -87,6 +92,21 @@ std::ostream& operator<<(std::ostream& os,
   }
 }
 
+absl::StatusOr<ActivationDataType> GetActivationDataTypeFromString(
+    absl::string_view activation_data_type_str) {
+  if (absl::EqualsIgnoreCase(activation_data_type_str, "float32")) {
+    return ActivationDataType::FLOAT32;
+  } else if (absl::EqualsIgnoreCase(activation_data_type_str, "float16")) {
+    return ActivationDataType::FLOAT16;
+  } else if (absl::EqualsIgnoreCase(activation_data_type_str, "int16")) {
+    return ActivationDataType::INT16;
+  } else if (absl::EqualsIgnoreCase(activation_data_type_str, "int8")) {
+    return ActivationDataType::INT8;
+  }
+  return absl::InvalidArgumentError(absl::StrCat(
+      "Unsupported activation data type: ", activation_data_type_str));
+}
+
 std::ostream& operator<<(std::ostream& os,
                          const FakeWeightsMode& fake_weights_mode) {
   switch (fake_weights_mode) {
@@ -101,6 +121,35 @@ std::ostream& operator<<(std::ostream& os,
   }
 }
 
+absl::StatusOr<FakeWeightsMode> GetFakeWeightsModeFromString(
+    absl::string_view fake_weights_mode_str) {
+  absl::string_view mode_str = fake_weights_mode_str;
+  if (absl::StartsWithIgnoreCase(mode_str, "fake_weights_")) {
+    mode_str.remove_prefix(std::strlen("fake_weights_"));
+  }
+  if (absl::EqualsIgnoreCase(mode_str, "none")) {
+    return FakeWeightsMode::FAKE_WEIGHTS_NONE;
+  } else if (absl::EqualsIgnoreCase(mode_str, "8bits_all_layers")) {
+    return FakeWeightsMode::FAKE_WEIGHTS_8BITS_ALL_LAYERS;
+  } else if (absl::EqualsIgnoreCase(mode_str, "attn_8_ffn_4_emb_4")) {
+    return FakeWeightsMode::FAKE_WEIGHTS_ATTN_8_FFN_4_EMB_4;
+  }
+  return absl::InvalidArgumentError(absl::StrCat(
+      "Unsupported fake weights mode: ", fake_weights_mode_str));
+}
+
+std::ostream& operator<<(std::ostream& os,
+                         const WeightMemoryOptions& weight_memory_options) {
+  os << "use_huge_pages: " << weight_memory_options.use_huge_pages
+     << ", lock_in_memory: " << weight_memory_options.lock_in_memory
+     << ", use_direct_io: " << weight_memory_options.use_direct_io
+     << ", shared_memory_dir: ";
+  if (weight_memory_options.shared_memory_dir.empty()) {
+    return os << "Not set.";
+  }
+  return os << weight_memory_options.shared_memory_dir;
+}
+
 std::ostream& operator<<(std::ostream& os, const FileFormat& file_format) {
   switch (file_format) {
     case FileFormat::TFLITE:
@@ -174,6 +223,10 @@ std::ostream& operator<<(std::ostream& os, const ModelAssets& model_assets) {
     os << "model_path: " << model_assets.GetPath().value() << "\n";
   }
   os << "fake_weights_mode: " << model_assets.fake_weights_mode() << "\n";
+  if (model_assets.section_arrival_timeout() > absl::ZeroDuration()) {
+    os << "section_arrival_timeout: "
+       << absl::FormatDuration(model_assets.section_arrival_timeout()) << "\n";
+  }
   return os;
 }
 
@@ -24,6 +24,7 @@
 
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
 #include "runtime/util/scoped_file.h"
 
 namespace litert::lm {
@@ -49,6 +50,11 @@ enum class Backend {
 
   // NPU backend.
   NPU,
+
+  // The fastest of the NPU, GPU and CPU backends available on the device,
+  // measured on the first run of the model and recorded next to its weight
+  // cache. Resolved by the engine before the main executor is built.
+  AUTO,
 };
 std::ostream& operator<<(std::ostream& os, const Backend& backend);
 // Returns the backend from the string.
@@ -69,6 +75,9 @@ enum class ActivationDataType {
 };
 std::ostream& operator<<(std::ostream& os,
                          const ActivationDataType& activation);
+// Returns the activation data type from the string, e.g. "float32" or "int8".
+absl::StatusOr<ActivationDataType> GetActivationDataTypeFromString(
+    absl::string_view activation_data_type_str);
 
 // Fake weights mode.
 enum class FakeWeightsMode {
@@ -84,6 +93,11 @@ enum class FakeWeightsMode {
 };
 std::ostream& operator<<(std::ostream& os,
                          const FakeWeightsMode& fake_weights_mode);
+// Returns the fake weights mode from the string, e.g. "none",
+// "8bits_all_layers" or "attn_8_ffn_4_emb_4", with or without the
+// "fake_weights_" prefix.
+absl::StatusOr<FakeWeightsMode> GetFakeWeightsModeFromString(
+    absl::string_view fake_weights_mode_str);
 
 enum class FileFormat {
   // .tflite file format.
@@ -97,6 +111,31 @@ enum class FileFormat {
 };
 std::ostream& operator<<(std::ostream& os, const FileFormat& file_format);
 
+// How the weights of the models mapped from the model file are held in
+// memory. Only applies to the .litertlm files.
+struct WeightMemoryOptions {
+  // Backs the mapped models with transparent huge pages, if the OS supports
+  // them for the file, to cut the TLB misses of the CPU inference on large
+  // models.
+  bool use_huge_pages = false;
+  // Locks the mapped models in memory, such that they are read in once and
+  // never paged out. Fails over to the pageable mappings, with a warning,
+  // beyond the memory lock limit of the process.
+  bool lock_in_memory = false;
+  // Reads the uncompressed models into memory with many direct reads in
+  // flight through io_uring on Linux, at the bandwidth of the drive, instead
+  // of paging them in from the mappings. Falls back to the mappings, with a
+  // warning, where io_uring or direct I/O is not available.
+  bool use_direct_io = false;
+  // If not empty, the directory in which the sections decompressed at load
+  // time are written once, to files named after their contents, and mapped
+  // read-only. The processes loading the same model then share one copy of
+  // them through the page cache, instead of each holding its own.
+  std::string shared_memory_dir;
+};
+std::ostream& operator<<(std::ostream& os,
+                         const WeightMemoryOptions& weight_memory_options);
+
 // Class to host the model assets, including base models and lora models.
 class ModelAssets {
  public:
@@ -129,6 +168,17 @@ class ModelAssets {
     fake_weights_mode_ = fake_weights_mode;
   }
 
+  // How long the loader waits for each section of a .litertlm model file that
+  // is still arriving, e.g. downloaded on first use, to land in it. The file
+  // must grow in order. Zero, the default, for a complete file.
+  absl::Duration section_arrival_timeout() const {
+    return section_arrival_timeout_;
+  }
+
+  void SetSectionArrivalTimeout(absl::Duration section_arrival_timeout) {
+    section_arrival_timeout_ = section_arrival_timeout;
+  }
+
  private:
   explicit ModelAssets(std::shared_ptr<ScopedFile> model_file);
   explicit ModelAssets(absl::string_view model_path);
@@ -139,6 +189,7 @@ class ModelAssets {
       path_or_scoped_file_;
 
   FakeWeightsMode fake_weights_mode_ = FakeWeightsMode::FAKE_WEIGHTS_NONE;
+  absl::Duration section_arrival_timeout_ = absl::ZeroDuration();
 };
 std::ostream& operator<<(std::ostream& os, const ModelAssets& model_assets);
 
@@ -161,6 +212,15 @@ class ExecutorSettingsBase {
     activation_data_type_ = activation_data_type;
   }
 
+  // Weight memory options APIs.
+  const WeightMemoryOptions& GetWeightMemoryOptions() const {
+    return weight_memory_options_;
+  }
+  void SetWeightMemoryOptions(
+      const WeightMemoryOptions& weight_memory_options) {
+    weight_memory_options_ = weight_memory_options;
+  }
+
   // Should be used by consumers who want to write to a single weight cache
   // file. Returns, in order of preference:
   //   1. an open file descriptor to the weight cache file,
@@ -210,6 +270,10 @@ class ExecutorSettingsBase {
   // this field will override the default activation data type, for example,
   // OpenCL backend only support fp32 on Linux.
   std::optional<ActivationDataType> activation_data_type_;
+
+  // How the mapped weights are held in memory. By default, they are pageable
+  // mappings of regular pages.
+  WeightMemoryOptions weight_memory_options_;
 };
 
 }  // namespace litert::lm
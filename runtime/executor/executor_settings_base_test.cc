@@ -19,11 +19,15 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
 #include "runtime/util/test_utils.h"  // NOLINT
 
 namespace litert::lm {
 namespace {
 
+using ::testing::status::IsOkAndHolds;
+using ::testing::status::StatusIs;
+
 TEST(LlmExecutorConfigTest, Backend) {
   Backend backend;
   std::stringstream oss;
@@ -55,6 +59,10 @@ TEST(LlmExecutorConfigTest, Backend) {
   oss.str("");
   oss << backend;
   EXPECT_EQ(oss.str(), "NPU");
+  backend = Backend::AUTO;
+  oss.str("");
+  oss << backend;
+  EXPECT_EQ(oss.str(), "AUTO");
 }
 
 TEST(LlmExecutorConfigTest, StringToBackend) {
@@ -70,6 +78,8 @@ TEST(LlmExecutorConfigTest, StringToBackend) {
   EXPECT_EQ(*backend, Backend::GOOGLE_TENSOR_ARTISAN);
   backend = GetBackendFromString("npu");
   EXPECT_EQ(*backend, Backend::NPU);
+  backend = GetBackendFromString("auto");
+  EXPECT_EQ(*backend, Backend::AUTO);
 }
 
 TEST(LlmExecutorConfigTest, ActivatonDataType) {
@@ -103,6 +113,30 @@ TEST(LlmExecutorConfigTest, FakeWeightsMode) {
   EXPECT_EQ(oss.str(), "FAKE_WEIGHTS_ATTN_8_FFN_4_EMB_4");
 }
 
+TEST(LlmExecutorConfigTest, StringToActivationDataType) {
+  EXPECT_THAT(GetActivationDataTypeFromString("float32"),
+              IsOkAndHolds(ActivationDataType::FLOAT32));
+  EXPECT_THAT(GetActivationDataTypeFromString("FLOAT16"),
+              IsOkAndHolds(ActivationDataType::FLOAT16));
+  EXPECT_THAT(GetActivationDataTypeFromString("int16"),
+              IsOkAndHolds(ActivationDataType::INT16));
+  EXPECT_THAT(GetActivationDataTypeFromString("Int8"),
+              IsOkAndHolds(ActivationDataType::INT8));
+  EXPECT_THAT(GetActivationDataTypeFromString("int4"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmExecutorConfigTest, StringToFakeWeightsMode) {
+  EXPECT_THAT(GetFakeWeightsModeFromString("none"),
+              IsOkAndHolds(FakeWeightsMode::FAKE_WEIGHTS_NONE));
+  EXPECT_THAT(GetFakeWeightsModeFromString("8bits_all_layers"),
+              IsOkAndHolds(FakeWeightsMode::FAKE_WEIGHTS_8BITS_ALL_LAYERS));
+  EXPECT_THAT(GetFakeWeightsModeFromString("FAKE_WEIGHTS_ATTN_8_FFN_4_EMB_4"),
+              IsOkAndHolds(FakeWeightsMode::FAKE_WEIGHTS_ATTN_8_FFN_4_EMB_4));
+  EXPECT_THAT(GetFakeWeightsModeFromString("4bits"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 TEST(LlmExecutorConfigTest, FileFormat) {
   std::stringstream oss;
 
@@ -119,6 +153,25 @@ TEST(LlmExecutorConfigTest, FileFormat) {
   EXPECT_EQ(oss.str(), "LITERT_LM");
 }
 
+TEST(LlmExecutorConfigTest, WeightMemoryOptions) {
+  std::stringstream oss;
+  WeightMemoryOptions weight_memory_options;
+  oss << weight_memory_options;
+  EXPECT_EQ(oss.str(),
+            "use_huge_pages: 0, lock_in_memory: 0, use_direct_io: 0, "
+            "shared_memory_dir: Not set.");
+
+  weight_memory_options.use_huge_pages = true;
+  weight_memory_options.lock_in_memory = true;
+  weight_memory_options.use_direct_io = true;
+  weight_memory_options.shared_memory_dir = "/dev/shm/models";
+  oss.str("");
+  oss << weight_memory_options;
+  EXPECT_EQ(oss.str(),
+            "use_huge_pages: 1, lock_in_memory: 1, use_direct_io: 1, "
+            "shared_memory_dir: /dev/shm/models");
+}
+
 TEST(LlmExecutorConfigTest, ModelAssets) {
   auto model_assets = ModelAssets::Create("/path/to/model1");
   ASSERT_OK(model_assets);
@@ -1,6 +1,7 @@
 #include "runtime/executor/fake_llm_executor.h"
 
 #include <limits>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -16,6 +17,7 @@
 #include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/executor/llm_executor_settings.h"
 #include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/litert_status_util.h"
 #include "runtime/util/status_macros.h"
 
 namespace litert::lm {
@@ -89,6 +91,9 @@ absl::Status FakeLlmExecutor::Prefill(const ExecutorInputs& inputs) {
       absl::MakeSpan(prefill_tokens_set_[prefill_times_]), *input_span));
   prefill_times_++;
   current_step_ += input_span->size();
+  if (!input_span->empty()) {
+    next_input_token_id_ = input_span->back();
+  }
   return absl::OkStatus();
 }
 
@@ -104,18 +109,27 @@ absl::Status FakeLlmExecutor::Prefill(
 }
 
 absl::Status FakeLlmExecutor::Decode(::litert::TensorBuffer& output_tokens) {
-  if (decode_times_ >= decode_tokens_set_.size()) {
-    return absl::InvalidArgumentError(absl::StrCat(
-        "Decode function has been called more times than the number of "
-        "expected decode tokens.",
-        decode_times_));
-  }
+  // Output tokens of shape [batch_size, num_steps] take num_steps decode calls
+  // of `decode_tokens_set`.
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, output_tokens.TensorType());
+  const auto& dims = tensor_type.Layout().Dimensions();
+  const int num_steps = dims.size() > 1 ? dims[1] : 1;
   auto tokens_span = ReferTensorBufferAsSpan<int>(output_tokens);
-  for (int i = 0; i < decode_tokens_set_[decode_times_].size(); ++i) {
-    (*tokens_span)[i] = decode_tokens_set_[decode_times_][i];
+  for (int step = 0; step < num_steps; ++step) {
+    if (decode_times_ >= decode_tokens_set_.size()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Decode function has been called more times than the number of "
+          "expected decode tokens.",
+          decode_times_));
+    }
+    for (int i = 0; i < decode_tokens_set_[decode_times_].size(); ++i) {
+      (*tokens_span)[i * num_steps + step] =
+          decode_tokens_set_[decode_times_][i];
+    }
+    next_input_token_id_ = decode_tokens_set_[decode_times_][0];
+    decode_times_++;
+    current_step_++;
   }
-  decode_times_++;
-  current_step_++;
   return absl::OkStatus();
 }
 
@@ -136,6 +150,7 @@ absl::Status FakeLlmExecutor::Decode(const ExecutorInputs& inputs,
   }
   DecodeIdsToLogits(decode_tokens_set_[decode_times_], vocab_size_,
                     output_logits);
+  next_input_token_id_ = decode_tokens_set_[decode_times_][0];
   decode_times_++;
   current_step_++;
   return absl::OkStatus();
@@ -161,9 +176,181 @@ absl::StatusOr<::litert::TensorBuffer> FakeLlmExecutor::DecodeLogits(
       CreateTensorBuffer<float>({batch_size_, 1, vocab_size_}));
   DecodeIdsToLogits(decode_tokens_set_[decode_times_], vocab_size_,
                     output_logits);
+  next_input_token_id_ = decode_tokens_set_[decode_times_][0];
   decode_times_++;
   current_step_++;
   return std::move(output_logits);
 }
 
+absl::Status FakeLlmExecutor::DecodeTopKLogits(
+    const ExecutorInputs& inputs, ::litert::TensorBuffer& output_topk_logits,
+    ::litert::TensorBuffer& output_topk_ids) {
+  if (decode_times_ >= decode_tokens_set_.size()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Decode function has been called more times than the number of "
+        "expected decode tokens.",
+        decode_times_));
+  }
+  if (decode_times_ > 0) {
+    // Check that the input tokens match the decode tokens from the last call.
+    auto input_span =
+        ReferTensorBufferAsSpan<int>(*(*inputs.GetTextTokenIdsPtr()));
+    RETURN_IF_ERROR(CheckEquivalent(
+        absl::MakeSpan(decode_tokens_set_[decode_times_ - 1]), *input_span));
+  }
+  // The decode token is the top logit, and the others are the next ids.
+  const std::vector<int>& ids = decode_tokens_set_[decode_times_];
+  auto topk_logits_span = ReferTensorBufferAsSpan<float>(output_topk_logits);
+  auto topk_ids_span = ReferTensorBufferAsSpan<int>(output_topk_ids);
+  const int k = topk_ids_span->size() / ids.size();
+  for (int i = 0; i < ids.size(); ++i) {
+    for (int j = 0; j < k; ++j) {
+      (*topk_ids_span)[i * k + j] = (ids[i] + j) % vocab_size_;
+      (*topk_logits_span)[i * k + j] =
+          j == 0 ? std::numeric_limits<float>::max()
+                 : std::numeric_limits<float>::lowest();
+    }
+  }
+  next_input_token_id_ = decode_tokens_set_[decode_times_][0];
+  decode_times_++;
+  current_step_++;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>>
+FakeLlmExecutor::SaveState() {
+  // The current step of the fake executor counts the pending input token,
+  // which the checkpoint holds apart.
+  return std::make_unique<ExecutorCheckpoint>(
+      next_input_token_id_ == -1 ? current_step_ : current_step_ - 1,
+      next_input_token_id_, ExecutorCheckpoint::KvCacheData());
+}
+
+absl::Status FakeLlmExecutor::RestoreState(
+    const ExecutorCheckpoint& checkpoint) {
+  if (checkpoint.GetNumTokens() > executor_settings_.GetMaxNumTokens()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Checkpoint holds ", checkpoint.GetNumTokens(),
+        " tokens, more than the max number of tokens ",
+        executor_settings_.GetMaxNumTokens()));
+  }
+  current_step_ = checkpoint.GetNumTokens();
+  next_input_token_id_ = checkpoint.GetNextInputTokenId();
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::vector<int>> FakeLlmExecutor::VerifyDraftTokens(
+    absl::Span<const int> draft_token_ids) {
+  std::vector<int> accepted_token_ids;
+  for (int i = 0; i <= draft_token_ids.size(); ++i) {
+    if (decode_times_ >= decode_tokens_set_.size()) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "VerifyDraftTokens needs more decode tokens than expected.",
+          decode_times_));
+    }
+    const int token_id = decode_tokens_set_[decode_times_][0];
+    decode_times_++;
+    accepted_token_ids.push_back(token_id);
+    if (i == draft_token_ids.size() || token_id != draft_token_ids[i]) {
+      break;
+    }
+  }
+  current_step_ += accepted_token_ids.size();
+  next_input_token_id_ = accepted_token_ids.back();
+  return accepted_token_ids;
+}
+
+absl::StatusOr<std::vector<float>> FakeLlmExecutor::ScoreTokens(
+    absl::Span<const int> token_ids) {
+  if (next_input_token_id_ < 0) {
+    return absl::FailedPreconditionError(
+        "No pending input token to score the tokens from.");
+  }
+  std::vector<float> log_probabilities;
+  log_probabilities.reserve(token_ids.size());
+  for (int i = 0; i < token_ids.size(); ++i) {
+    const bool matches = decode_times_ + i < decode_tokens_set_.size() &&
+                         decode_tokens_set_[decode_times_ + i][0] ==
+                             token_ids[i];
+    log_probabilities.push_back(matches ? 0.0f : -1.0f);
+  }
+  return log_probabilities;
+}
+
+absl::Status FakeLlmExecutor::Rollback(int num_processed_tokens,
+                                       int next_input_token_id) {
+  // The current step of the fake executor counts the pending input token.
+  if (num_processed_tokens < 0 || num_processed_tokens >= current_step_) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Cannot roll back to ", num_processed_tokens,
+                     " tokens from step ", current_step_));
+  }
+  current_step_ = num_processed_tokens + 1;
+  next_input_token_id_ = next_input_token_id;
+  return absl::OkStatus();
+}
+
+absl::Status FakeLlmExecutor::ShiftContext(int num_sink_tokens,
+                                           int num_discarded_tokens) {
+  // The current step of the fake executor counts the pending input token,
+  // which is never discarded.
+  if (num_sink_tokens < 0 || num_discarded_tokens < 0 ||
+      num_sink_tokens + num_discarded_tokens >= current_step_) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Cannot discard ", num_discarded_tokens, " tokens after ",
+        num_sink_tokens, " sink tokens from step ", current_step_));
+  }
+  current_step_ -= num_discarded_tokens;
+  return absl::OkStatus();
+}
+
+absl::Status FakeLlmExecutor::CompactContext(
+    absl::Span<const std::pair<int, int>> discarded_ranges) {
+  // As in ShiftContext(), the pending input token is never discarded.
+  int num_discarded_tokens = 0;
+  int previous_end = 0;
+  for (const auto& [begin, end] : discarded_ranges) {
+    if (begin < previous_end || begin > end || end >= current_step_) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Cannot discard the steps [", begin, ", ", end,
+                       ") from step ", current_step_));
+    }
+    num_discarded_tokens += end - begin;
+    previous_end = end;
+  }
+  current_step_ -= num_discarded_tokens;
+  return absl::OkStatus();
+}
+
+absl::Status FakeLlmExecutor::ReorderBatchRows(
+    absl::Span<const int> source_rows) {
+  if (source_rows.size() != batch_size_) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Expected ", batch_size_, " source rows, but got ",
+                     source_rows.size()));
+  }
+  for (int source_row : source_rows) {
+    if (source_row < 0 || source_row >= batch_size_) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Source row ", source_row, " is out of range."));
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status FakeLlmExecutor::Warmup(int num_decode_steps) {
+  if (current_step_ != 0 || next_input_token_id_ != -1) {
+    return absl::FailedPreconditionError(
+        "Warmup must be called before the first prefill or after Reset().");
+  }
+  num_warmup_decode_steps_ += num_decode_steps;
+  return absl::OkStatus();
+}
+
+absl::Status FakeLlmExecutor::Reset() {
+  current_step_ = 0;
+  next_input_token_id_ = -1;
+  return absl::OkStatus();
+}
+
 }  // namespace litert::lm
@@ -15,11 +15,14 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_MOCK_LLM_EXECUTOR_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_MOCK_LLM_EXECUTOR_H_
 
+#include <memory>
+#include <utility>
 #include <vector>
 
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/executor/llm_executor.h"
 #include "runtime/executor/llm_executor_settings.h"
@@ -56,6 +59,10 @@ class FakeLlmExecutor : public LlmExecutor {
   absl::StatusOr<::litert::TensorBuffer> DecodeLogits(
       const ExecutorInputs& inputs) override;
 
+  absl::Status DecodeTopKLogits(
+      const ExecutorInputs& inputs, ::litert::TensorBuffer& output_topk_logits,
+      ::litert::TensorBuffer& output_topk_ids) override;
+
   absl::string_view ExecutorBackendName() const override {
     return "FakeLlmExecutorBackend";
   };
@@ -72,6 +79,42 @@ class FakeLlmExecutor : public LlmExecutor {
     return current_step_;
   }
 
+  // The fake executor has no kv-cache, so the checkpoint only holds the
+  // current step.
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() override;
+  absl::Status RestoreState(const ExecutorCheckpoint& checkpoint) override;
+
+  // Verifies the draft tokens against the next decode tokens, one decode call
+  // of `decode_tokens_set` per returned token.
+  absl::StatusOr<std::vector<int>> VerifyDraftTokens(
+      absl::Span<const int> draft_token_ids) override;
+  // Scores each token 0 if it matches the next decode tokens, and -1
+  // otherwise, without consuming them.
+  absl::StatusOr<std::vector<float>> ScoreTokens(
+      absl::Span<const int> token_ids) override;
+  absl::Status Rollback(int num_processed_tokens,
+                        int next_input_token_id) override;
+  // The pending input token is the last prefilled or decoded token of the
+  // first batch row.
+  absl::StatusOr<int> GetNextInputTokenId() const override {
+    return next_input_token_id_;
+  }
+  absl::Status ShiftContext(int num_sink_tokens,
+                            int num_discarded_tokens) override;
+  absl::Status CompactContext(
+      absl::Span<const std::pair<int, int>> discarded_ranges) override;
+  // The fake executor has no kv-cache, so only the source rows are checked.
+  absl::Status ReorderBatchRows(absl::Span<const int> source_rows) override;
+  // Records the decode steps of the warmup, which does not consume the
+  // expected prefill and decode calls.
+  absl::Status Warmup(int num_decode_steps) override;
+  // The decode steps of all the warmups so far.
+  int GetNumWarmupDecodeSteps() const { return num_warmup_decode_steps_; }
+
+  // Clears the current step and the pending input token. The expected
+  // prefill and decode calls carry on.
+  absl::Status Reset() override;
+
  private:
   int vocab_size_;
   std::vector<std::vector<int>> prefill_tokens_set_;
@@ -88,6 +131,12 @@ class FakeLlmExecutor : public LlmExecutor {
 
   // The current step of the executor.
   int current_step_;
+
+  // The pending input token, or -1 before the first Prefill.
+  int next_input_token_id_ = -1;
+
+  // The decode steps of all the warmups so far.
+  int num_warmup_decode_steps_ = 0;
 };
 
 }  // namespace litert::lm
@@ -67,6 +67,7 @@ TEST(FakeLlmExecutorTest, Prefill) {
   (*ids_span)[2] = 3;
   EXPECT_OK(fake_llm_executor.Prefill(inputs));
   EXPECT_EQ(fake_llm_executor.GetCurrentStep().value(), 3);
+  EXPECT_EQ(fake_llm_executor.GetNextInputTokenId().value(), 3);
 }
 
 TEST(FakeLlmExecutorTest, DecodeToIds) {
@@ -89,6 +90,7 @@ TEST(FakeLlmExecutorTest, DecodeToIds) {
   EXPECT_EQ(fake_llm_executor.GetCurrentStep().value(), 2);
   output_tokens_span = ReferTensorBufferAsSpan<int>(output_tokens);
   EXPECT_EQ((*output_tokens_span)[0], 0);
+  EXPECT_EQ(fake_llm_executor.GetNextInputTokenId().value(), 0);
 
   // Call Decode for the 3nd time. Should fail.
   EXPECT_THAT(fake_llm_executor.Decode(output_tokens),
@@ -177,5 +179,40 @@ TEST(FakeLlmExecutorTest, DecodeLogits) {
               StatusIs(absl::StatusCode::kInvalidArgument));
 }
 
+TEST(FakeLlmExecutorTest, SaveAndRestoreState) {
+  const std::vector<std::vector<int>> prefill_tokens_set = {{1, 2, 3}};
+  const std::vector<std::vector<int>> decode_tokens_set = {{3, 2}, {0, 0}};
+  FakeLlmExecutor fake_llm_executor(3, prefill_tokens_set, decode_tokens_set);
+
+  ExecutorInputs inputs;
+  const std::vector<int> input_tokens = {1, 2, 3};
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto input_tokens_buffer,
+      CopyToTensorBuffer<int>(absl::MakeSpan(input_tokens), {1, 3}));
+  inputs.SetTextData(ExecutorTextData(std::move(input_tokens_buffer)));
+  EXPECT_OK(fake_llm_executor.Prefill(inputs));
+  EXPECT_EQ(fake_llm_executor.GetCurrentStep().value(), 3);
+
+  ASSERT_OK_AND_ASSIGN(auto checkpoint, fake_llm_executor.SaveState());
+  EXPECT_EQ(checkpoint->GetNumTokens(), 3);
+
+  LITERT_ASSERT_OK_AND_ASSIGN(auto output_tokens,
+                              CreateTensorBuffer<int>({2, 1}));
+  EXPECT_OK(fake_llm_executor.Decode(output_tokens));
+  EXPECT_EQ(fake_llm_executor.GetCurrentStep().value(), 4);
+
+  EXPECT_OK(fake_llm_executor.RestoreState(*checkpoint));
+  EXPECT_EQ(fake_llm_executor.GetCurrentStep().value(), 3);
+}
+
+TEST(FakeLlmExecutorTest, RestoreStateExceedsMaxNumTokens) {
+  FakeLlmExecutor fake_llm_executor(3, {}, {});
+  fake_llm_executor.GetMutableExecutorSettings().value()->SetMaxNumTokens(2);
+  ExecutorCheckpoint checkpoint(/*current_step=*/3, /*next_input_token_id=*/-1,
+                                ExecutorCheckpoint::KvCacheData());
+  EXPECT_THAT(fake_llm_executor.RestoreState(checkpoint),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 }  // namespace
 }  // namespace litert::lm
@@ -0,0 +1,349 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/growable_llm_executor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/algorithm/container.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/kv_cache_layout.h"
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/executor/lora_adapter.h"
+#include "runtime/util/litert_status_util.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// Returns `checkpoint` converted to the kv-cache capacity of `layouts`, or
+// nullptr if it was saved at that capacity. The other dimensions of the
+// kv-cache tensors must be those of `layouts`.
+absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> ConvertCheckpoint(
+    const ExecutorCheckpoint& checkpoint, const KvCacheLayouts& layouts) {
+  // The layout of each tensor of the checkpoint, which only differs from the
+  // target one by its number of token positions.
+  KvCacheLayouts source_layouts;
+  bool same_capacity = true;
+  for (const auto& [name, target_layout] : layouts) {
+    ASSIGN_OR_RETURN(auto source, checkpoint.GetKvCacheTensor(name));
+    const size_t bytes_per_token =
+        target_layout.SizeInBytes() / target_layout.NumTokens();
+    RET_CHECK(bytes_per_token > 0 && source.size() % bytes_per_token == 0)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The kv-cache tensor " << name << " of " << source.size()
+        << " bytes does not match the layout of the executor.";
+    KvCacheTensorLayout source_layout = target_layout;
+    source_layout.dims[source_layout.seq_dim] =
+        static_cast<int>(source.size() / bytes_per_token);
+    same_capacity &= source_layout == target_layout;
+    source_layouts[name] = std::move(source_layout);
+  }
+  if (same_capacity) {
+    return nullptr;
+  }
+  if (!checkpoint.GetKvCacheScales().empty()) {
+    return absl::UnimplementedError(
+        "Cannot convert a checkpoint with a quantized kv-cache.");
+  }
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  for (const auto& [name, target_layout] : layouts) {
+    ASSIGN_OR_RETURN(auto source, checkpoint.GetKvCacheTensor(name));
+    std::vector<uint8_t>& target = kv_cache[name];
+    target.resize(target_layout.SizeInBytes());
+    RETURN_IF_ERROR(ConvertKvCacheTensor(
+        source, source_layouts.at(name), target_layout,
+        checkpoint.GetCurrentStep(), absl::MakeSpan(target)));
+  }
+  return std::make_unique<ExecutorCheckpoint>(checkpoint.GetCurrentStep(),
+                                              checkpoint.GetNextInputTokenId(),
+                                              std::move(kv_cache));
+}
+
+// Restores `checkpoint` on `executor`, converted to its kv-cache capacity if
+// needed. The executors not reporting their layouts restore it as it is.
+absl::Status RestoreConvertedState(LlmExecutor& executor,
+                                   const ExecutorCheckpoint& checkpoint) {
+  auto layouts = executor.GetKvCacheLayouts();
+  if (!layouts.ok()) {
+    return executor.RestoreState(checkpoint);
+  }
+  ASSIGN_OR_RETURN(auto converted, ConvertCheckpoint(checkpoint, *layouts));
+  return executor.RestoreState(converted != nullptr ? *converted : checkpoint);
+}
+
+// Returns the number of tokens of the prompt of `inputs`.
+absl::StatusOr<int> GetNumPromptTokens(const ExecutorInputs& inputs) {
+  ASSIGN_OR_RETURN(const auto* token_ids, inputs.GetTextTokenIdsPtr());
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, token_ids->TensorType());
+  RET_CHECK_EQ(tensor_type.Layout().Dimensions().size(), 2)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Prefill token ids must be of shape [batch, sequence_length].";
+  return tensor_type.Layout().Dimensions()[1];
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<GrowableLlmExecutor>>
+GrowableLlmExecutor::Create(std::vector<int> capacities,
+                            ExecutorFactory executor_factory) {
+  RET_CHECK(!capacities.empty() && capacities.front() > 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "At least one positive kv-cache capacity is required.";
+  for (int i = 1; i < capacities.size(); ++i) {
+    RET_CHECK_GT(capacities[i], capacities[i - 1])
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The kv-cache capacities must be in increasing order.";
+  }
+  RET_CHECK(executor_factory != nullptr)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The executor factory is required.";
+  ASSIGN_OR_RETURN(std::unique_ptr<LlmExecutor> executor,
+                   executor_factory(capacities.front()));
+  RET_CHECK(executor != nullptr) << "The executor factory returned null.";
+  return absl::WrapUnique(new GrowableLlmExecutor(
+      std::move(capacities), std::move(executor_factory),
+      std::move(executor)));
+}
+
+GrowableLlmExecutor::GrowableLlmExecutor(std::vector<int> capacities,
+                                         ExecutorFactory executor_factory,
+                                         std::unique_ptr<LlmExecutor> executor)
+    : capacities_(std::move(capacities)),
+      executor_factory_(std::move(executor_factory)),
+      executor_(std::move(executor)) {}
+
+absl::StatusOr<std::unique_ptr<LlmExecutor>>
+GrowableLlmExecutor::CreateExecutor(int capacity_index) {
+  ASSIGN_OR_RETURN(std::unique_ptr<LlmExecutor> executor,
+                   executor_factory_(capacities_[capacity_index]));
+  RET_CHECK(executor != nullptr) << "The executor factory returned null.";
+  for (const auto& [name, serialized_adapter] : lora_adapters_) {
+    RETURN_IF_ERROR(executor->LoadLoraAdapter(serialized_adapter));
+  }
+  if (!lora_row_names_.empty()) {
+    RETURN_IF_ERROR(executor->SelectLoraAdapters(lora_row_names_));
+  } else if (!lora_name_.empty()) {
+    RETURN_IF_ERROR(executor->SelectLoraAdapter(lora_name_));
+  }
+  return executor;
+}
+
+void GrowableLlmExecutor::ReplaceExecutor(
+    int capacity_index, std::unique_ptr<LlmExecutor> executor) {
+  auto latencies = executor_->GetStageLatencies();
+  if (latencies.ok()) {
+    for (const auto& [stage, latency] : *latencies) {
+      replaced_stage_latencies_[stage] += latency;
+    }
+  }
+  executor_ = std::move(executor);
+  capacity_index_ = capacity_index;
+}
+
+absl::Status GrowableLlmExecutor::Reserve(int num_new_tokens) {
+  ASSIGN_OR_RETURN(const int current_step, executor_->GetCurrentStep());
+  const int num_tokens = current_step + num_new_tokens;
+  int capacity_index = capacity_index_;
+  while (capacities_[capacity_index] < num_tokens &&
+         capacity_index + 1 < capacities_.size()) {
+    ++capacity_index;
+  }
+  if (capacity_index == capacity_index_) {
+    return absl::OkStatus();
+  }
+  RET_CHECK(!has_vision_embeddings_)
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The prompt of " << num_new_tokens << " tokens with vision "
+      << "embeddings does not fit in the kv-cache of " << GetCapacity()
+      << " tokens.";
+  ASSIGN_OR_RETURN(auto checkpoint, executor_->SaveState());
+  ASSIGN_OR_RETURN(auto executor, CreateExecutor(capacity_index));
+  RETURN_IF_ERROR(RestoreConvertedState(*executor, *checkpoint));
+  ReplaceExecutor(capacity_index, std::move(executor));
+  ++num_growths_;
+  return absl::OkStatus();
+}
+
+absl::Status GrowableLlmExecutor::Prefill(const ExecutorInputs& inputs) {
+  ASSIGN_OR_RETURN(const int num_tokens, GetNumPromptTokens(inputs));
+  RETURN_IF_ERROR(Reserve(num_tokens));
+  has_vision_embeddings_ = false;
+  return executor_->Prefill(inputs);
+}
+
+absl::Status GrowableLlmExecutor::Prefill(
+    const ExecutorInputs& inputs, const ExecutorPrefillParams& prefill_params) {
+  ASSIGN_OR_RETURN(const int num_tokens, GetNumPromptTokens(inputs));
+  RETURN_IF_ERROR(Reserve(num_tokens));
+  has_vision_embeddings_ = false;
+  return executor_->Prefill(inputs, prefill_params);
+}
+
+absl::Status GrowableLlmExecutor::Decode(
+    ::litert::TensorBuffer& output_tokens) {
+  RETURN_IF_ERROR(Reserve(/*num_new_tokens=*/1));
+  return executor_->Decode(output_tokens);
+}
+
+absl::Status GrowableLlmExecutor::Decode(
+    const ExecutorInputs& inputs, ::litert::TensorBuffer& output_logits) {
+  RETURN_IF_ERROR(Reserve(/*num_new_tokens=*/1));
+  return executor_->Decode(inputs, output_logits);
+}
+
+absl::StatusOr<::litert::TensorBuffer> GrowableLlmExecutor::DecodeLogits(
+    const ExecutorInputs& inputs) {
+  RETURN_IF_ERROR(Reserve(/*num_new_tokens=*/1));
+  return executor_->DecodeLogits(inputs);
+}
+
+absl::Status GrowableLlmExecutor::DecodeTopKLogits(
+    const ExecutorInputs& inputs, ::litert::TensorBuffer& output_topk_logits,
+    ::litert::TensorBuffer& output_topk_ids) {
+  RETURN_IF_ERROR(Reserve(/*num_new_tokens=*/1));
+  return executor_->DecodeTopKLogits(inputs, output_topk_logits,
+                                     output_topk_ids);
+}
+
+absl::StatusOr<std::vector<int>> GrowableLlmExecutor::VerifyDraftTokens(
+    absl::Span<const int> draft_token_ids) {
+  // The pending input token is fed into the model with the draft tokens.
+  RETURN_IF_ERROR(Reserve(draft_token_ids.size() + 1));
+  return executor_->VerifyDraftTokens(draft_token_ids);
+}
+
+absl::StatusOr<std::vector<float>> GrowableLlmExecutor::ScoreTokens(
+    absl::Span<const int> token_ids) {
+  // The tokens are fed into the model before the kv-cache is rolled back.
+  RETURN_IF_ERROR(Reserve(token_ids.size() + 1));
+  return executor_->ScoreTokens(token_ids);
+}
+
+absl::StatusOr<LlmExecutorSettings> GrowableLlmExecutor::GetExecutorSettings()
+    const {
+  ASSIGN_OR_RETURN(LlmExecutorSettings settings,
+                   executor_->GetExecutorSettings());
+  settings.SetMaxNumTokens(capacities_.back());
+  return settings;
+}
+
+absl::Status GrowableLlmExecutor::FillVisionEmbeddings(
+    const ExecutorVisionData& vision_input, int image_index) {
+  RETURN_IF_ERROR(executor_->FillVisionEmbeddings(vision_input, image_index));
+  has_vision_embeddings_ = true;
+  return absl::OkStatus();
+}
+
+absl::Status GrowableLlmExecutor::FillVisionEmbeddingsBatch(
+    absl::Span<const ExecutorVisionData> vision_inputs,
+    int first_image_index) {
+  RETURN_IF_ERROR(
+      executor_->FillVisionEmbeddingsBatch(vision_inputs, first_image_index));
+  has_vision_embeddings_ = true;
+  return absl::OkStatus();
+}
+
+absl::Status GrowableLlmExecutor::RestoreState(
+    const ExecutorCheckpoint& checkpoint) {
+  has_vision_embeddings_ = false;
+  // The context never moves to a smaller capacity, which would create an
+  // executor for each restored prefix.
+  int capacity_index = capacity_index_;
+  while (capacities_[capacity_index] < checkpoint.GetNumTokens() &&
+         capacity_index + 1 < capacities_.size()) {
+    ++capacity_index;
+  }
+  if (capacity_index == capacity_index_) {
+    return RestoreConvertedState(*executor_, checkpoint);
+  }
+  ASSIGN_OR_RETURN(auto executor, CreateExecutor(capacity_index));
+  RETURN_IF_ERROR(RestoreConvertedState(*executor, checkpoint));
+  ReplaceExecutor(capacity_index, std::move(executor));
+  ++num_growths_;
+  return absl::OkStatus();
+}
+
+absl::Status GrowableLlmExecutor::LoadLoraAdapter(
+    absl::string_view serialized_adapter) {
+  ASSIGN_OR_RETURN(LoraAdapter adapter, ParseLoraAdapter(serialized_adapter));
+  RETURN_IF_ERROR(executor_->LoadLoraAdapter(serialized_adapter));
+  lora_adapters_.emplace_back(std::move(adapter.name),
+                              std::string(serialized_adapter));
+  return absl::OkStatus();
+}
+
+absl::Status GrowableLlmExecutor::UnloadLoraAdapter(absl::string_view name) {
+  RETURN_IF_ERROR(executor_->UnloadLoraAdapter(name));
+  std::erase_if(lora_adapters_,
+                [name](const auto& adapter) { return adapter.first == name; });
+  // The executors select the base model when the adapter was selected.
+  if (name == lora_name_ || absl::c_linear_search(lora_row_names_, name)) {
+    lora_name_.clear();
+    lora_row_names_.clear();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status GrowableLlmExecutor::SelectLoraAdapter(absl::string_view name) {
+  RETURN_IF_ERROR(executor_->SelectLoraAdapter(name));
+  lora_name_ = std::string(name);
+  lora_row_names_.clear();
+  return absl::OkStatus();
+}
+
+absl::Status GrowableLlmExecutor::SelectLoraAdapters(
+    absl::Span<const std::string> names) {
+  RETURN_IF_ERROR(executor_->SelectLoraAdapters(names));
+  lora_name_.clear();
+  lora_row_names_.assign(names.begin(), names.end());
+  return absl::OkStatus();
+}
+
+absl::StatusOr<ExecutorStageLatencies> GrowableLlmExecutor::GetStageLatencies()
+    const {
+  ASSIGN_OR_RETURN(ExecutorStageLatencies latencies,
+                   executor_->GetStageLatencies());
+  for (const auto& [stage, latency] : replaced_stage_latencies_) {
+    latencies[stage] += latency;
+  }
+  return latencies;
+}
+
+absl::Status GrowableLlmExecutor::Reset() {
+  if (capacity_index_ == 0) {
+    RETURN_IF_ERROR(executor_->Reset());
+  } else {
+    ASSIGN_OR_RETURN(auto executor, CreateExecutor(/*capacity_index=*/0));
+    ReplaceExecutor(/*capacity_index=*/0, std::move(executor));
+  }
+  has_vision_embeddings_ = false;
+  replaced_stage_latencies_.clear();
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
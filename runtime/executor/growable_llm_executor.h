@@ -0,0 +1,211 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_GROWABLE_LLM_EXECUTOR_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_GROWABLE_LLM_EXECUTOR_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/kv_cache_layout.h"
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/memory_usage.h"
+
+namespace litert::lm {
+
+// Runs a context on executors of growing kv-cache capacities, e.g. the model
+// compiled for 1k, 2k, 4k and 8k tokens, such that the short contexts only
+// hold a small kv-cache. The context starts on the executor of the smallest
+// capacity, and moves to the executor of the next capacity that fits before
+// the call that would overflow the kv-cache, e.g. a long Prefill(). The
+// kv-cache is moved with SaveState() and RestoreState(), and converted on the
+// way to the layouts reported by GetKvCacheLayouts(). The executor of the
+// previous capacity is destroyed once the context is moved, and Reset() goes
+// back to the smallest capacity.
+class GrowableLlmExecutor : public LlmExecutor {
+ public:
+  // Creates the executor of the model of a kv-cache of `max_num_tokens`
+  // tokens.
+  using ExecutorFactory =
+      absl::AnyInvocable<absl::StatusOr<std::unique_ptr<LlmExecutor>>(
+          int max_num_tokens)>;
+
+  // `capacities` are the kv-cache capacities in tokens `executor_factory` can
+  // create executors of, in increasing order. The executor of the smallest
+  // one is created right away.
+  static absl::StatusOr<std::unique_ptr<GrowableLlmExecutor>> Create(
+      std::vector<int> capacities, ExecutorFactory executor_factory);
+
+  absl::Status Prefill(const ExecutorInputs& inputs) override;
+  absl::Status Prefill(const ExecutorInputs& inputs,
+                       const ExecutorPrefillParams& prefill_params) override;
+
+  absl::Status Decode(::litert::TensorBuffer& output_tokens) override;
+  absl::Status Decode(const ExecutorInputs& inputs,
+                      ::litert::TensorBuffer& output_logits) override;
+  absl::StatusOr<::litert::TensorBuffer> DecodeLogits(
+      const ExecutorInputs& inputs) override;
+  absl::Status DecodeTopKLogits(
+      const ExecutorInputs& inputs, ::litert::TensorBuffer& output_topk_logits,
+      ::litert::TensorBuffer& output_topk_ids) override;
+
+  absl::string_view ExecutorBackendName() const override {
+    return "Growable kv-cache";
+  }
+
+  absl::StatusOr<int> GetVocabSize() override {
+    return executor_->GetVocabSize();
+  }
+  absl::StatusOr<int> GetCurrentStep() const override {
+    return executor_->GetCurrentStep();
+  }
+  absl::StatusOr<int> GetMaxPrefillLength() const override {
+    return executor_->GetMaxPrefillLength();
+  }
+  // The settings of the executor of the largest capacity, which bounds the
+  // context.
+  absl::StatusOr<LlmExecutorSettings> GetExecutorSettings() const override;
+
+  // The vision embeddings are filled on the current executor, so the prompt
+  // using them fails with FailedPreconditionError if it does not fit in its
+  // capacity.
+  absl::Status FillVisionEmbeddings(const ExecutorVisionData& vision_input,
+                                    int image_index) override;
+  absl::Status FillVisionEmbeddingsBatch(
+      absl::Span<const ExecutorVisionData> vision_inputs,
+      int first_image_index) override;
+
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() override {
+    return executor_->SaveState();
+  }
+  // Grows to the capacity holding the checkpoint, and converts it if it was
+  // saved at another capacity.
+  absl::Status RestoreState(const ExecutorCheckpoint& checkpoint) override;
+  absl::StatusOr<KvCacheLayouts> GetKvCacheLayouts() const override {
+    return executor_->GetKvCacheLayouts();
+  }
+
+  absl::StatusOr<std::vector<int>> VerifyDraftTokens(
+      absl::Span<const int> draft_token_ids) override;
+  absl::StatusOr<std::vector<float>> ScoreTokens(
+      absl::Span<const int> token_ids) override;
+  absl::StatusOr<std::vector<std::vector<float>>> EmbedTokens(
+      absl::Span<const std::vector<int>> token_ids,
+      EmbeddingPooling pooling) override {
+    return executor_->EmbedTokens(token_ids, pooling);
+  }
+  absl::Status Rollback(int num_processed_tokens,
+                        int next_input_token_id) override {
+    return executor_->Rollback(num_processed_tokens, next_input_token_id);
+  }
+  absl::StatusOr<int> GetNextInputTokenId() const override {
+    return executor_->GetNextInputTokenId();
+  }
+  absl::Status ReorderBatchRows(absl::Span<const int> source_rows) override {
+    return executor_->ReorderBatchRows(source_rows);
+  }
+  absl::Status ShiftContext(int num_sink_tokens,
+                            int num_discarded_tokens) override {
+    return executor_->ShiftContext(num_sink_tokens, num_discarded_tokens);
+  }
+  absl::Status CompactContext(
+      absl::Span<const std::pair<int, int>> discarded_ranges) override {
+    return executor_->CompactContext(discarded_ranges);
+  }
+
+  // The adapters are kept, to be loaded again on the executors created later.
+  absl::Status LoadLoraAdapter(absl::string_view serialized_adapter) override;
+  absl::Status UnloadLoraAdapter(absl::string_view name) override;
+  absl::Status SelectLoraAdapter(absl::string_view name) override;
+  absl::Status SelectLoraAdapters(
+      absl::Span<const std::string> names) override;
+
+  // The latencies of all the executors the contexts ran on.
+  absl::StatusOr<ExecutorStageLatencies> GetStageLatencies() const override;
+  absl::StatusOr<EmbeddingCacheStats> GetEmbeddingCacheStats() const override {
+    return executor_->GetEmbeddingCacheStats();
+  }
+  absl::StatusOr<int> GetPrefillChunkSize() const override {
+    return executor_->GetPrefillChunkSize();
+  }
+  absl::Status ReleaseCaches() override { return executor_->ReleaseCaches(); }
+  absl::StatusOr<MemoryUsage> GetMemoryUsage() const override {
+    return executor_->GetMemoryUsage();
+  }
+
+  absl::Status Warmup(int num_decode_steps) override {
+    return executor_->Warmup(num_decode_steps);
+  }
+
+  // Resets the executor, and goes back to the smallest capacity.
+  absl::Status Reset() override;
+
+  // Returns the kv-cache capacity of the current executor, in tokens.
+  int GetCapacity() const { return capacities_[capacity_index_]; }
+  // Returns the number of times the context moved to a larger capacity since
+  // the executor was created.
+  int GetNumGrowths() const { return num_growths_; }
+
+ private:
+  GrowableLlmExecutor(std::vector<int> capacities,
+                      ExecutorFactory executor_factory,
+                      std::unique_ptr<LlmExecutor> executor);
+
+  // Moves the context to the executor of the smallest capacity holding
+  // `num_new_tokens` more tokens, if the current one does not, or to the
+  // largest capacity if none does, which then reports the overflow.
+  absl::Status Reserve(int num_new_tokens);
+
+  // Creates the executor of `capacities_[capacity_index]`, with the LoRA
+  // adapters loaded and selected.
+  absl::StatusOr<std::unique_ptr<LlmExecutor>> CreateExecutor(
+      int capacity_index);
+
+  // Replaces the current executor by `executor` of
+  // `capacities_[capacity_index]`, keeping the latencies of the current one.
+  void ReplaceExecutor(int capacity_index,
+                       std::unique_ptr<LlmExecutor> executor);
+
+  const std::vector<int> capacities_;
+  ExecutorFactory executor_factory_;
+  std::unique_ptr<LlmExecutor> executor_;
+  int capacity_index_ = 0;
+
+  // The serialized LoRA adapters keyed by name, in the order they were
+  // loaded, and the selected one, or empty for the base model.
+  std::vector<std::pair<std::string, std::string>> lora_adapters_;
+  std::string lora_name_;
+  // The adapters selected per row, empty unless SelectLoraAdapters() was
+  // called last.
+  std::vector<std::string> lora_row_names_;
+  // Whether vision embeddings are filled for the next prompt.
+  bool has_vision_embeddings_ = false;
+  // The latencies of the executors that were replaced.
+  ExecutorStageLatencies replaced_stage_latencies_;
+  int num_growths_ = 0;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_GROWABLE_LLM_EXECUTOR_H_
@@ -0,0 +1,225 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/growable_llm_executor.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/test/matchers.h"  // from @litert
+#include "runtime/executor/fake_llm_executor.h"
+#include "runtime/executor/kv_cache_layout.h"
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::status::StatusIs;
+
+constexpr char kKvCacheName[] = "kv_cache_k_0";
+constexpr int kVocabSize = 16;
+constexpr int kNumHeads = 2;
+
+// A fake executor with a kv-cache of one [1, capacity, heads, 1] tensor,
+// which is saved and restored with the step counters.
+class FakeKvCacheExecutor : public FakeLlmExecutor {
+ public:
+  FakeKvCacheExecutor(int capacity,
+                      const std::vector<std::vector<int>>& prefill_tokens_set,
+                      const std::vector<std::vector<int>>& decode_tokens_set)
+      : FakeLlmExecutor(kVocabSize, prefill_tokens_set, decode_tokens_set),
+        layout_({{1, capacity, kNumHeads, 1}, 1, 1}),
+        kv_cache_(layout_.SizeInBytes(), 0) {
+    (*GetMutableExecutorSettings())->SetMaxNumTokens(capacity);
+  }
+
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() override {
+    auto checkpoint = FakeLlmExecutor::SaveState();
+    if (!checkpoint.ok()) {
+      return checkpoint.status();
+    }
+    ExecutorCheckpoint::KvCacheData kv_cache;
+    kv_cache[kKvCacheName] = kv_cache_;
+    return std::make_unique<ExecutorCheckpoint>(
+        (*checkpoint)->GetCurrentStep(), (*checkpoint)->GetNextInputTokenId(),
+        std::move(kv_cache));
+  }
+
+  absl::Status RestoreState(const ExecutorCheckpoint& checkpoint) override {
+    auto contents = checkpoint.GetKvCacheTensor(kKvCacheName);
+    if (!contents.ok()) {
+      return contents.status();
+    }
+    if (contents->size() != kv_cache_.size()) {
+      return absl::InvalidArgumentError("Wrong kv-cache size.");
+    }
+    kv_cache_.assign(contents->begin(), contents->end());
+    return FakeLlmExecutor::RestoreState(checkpoint);
+  }
+
+  absl::StatusOr<KvCacheLayouts> GetKvCacheLayouts() const override {
+    return KvCacheLayouts{{kKvCacheName, layout_}};
+  }
+
+  std::vector<uint8_t>& kv_cache() { return kv_cache_; }
+
+ private:
+  KvCacheTensorLayout layout_;
+  std::vector<uint8_t> kv_cache_;
+};
+
+// Creates the fake executors, scripted by their capacity, and remembers the
+// last one created.
+class FakeExecutorFactory {
+ public:
+  explicit FakeExecutorFactory(
+      absl::flat_hash_map<int, std::vector<std::vector<int>>>
+          prefill_tokens_sets,
+      absl::flat_hash_map<int, std::vector<std::vector<int>>>
+          decode_tokens_sets)
+      : prefill_tokens_sets_(std::move(prefill_tokens_sets)),
+        decode_tokens_sets_(std::move(decode_tokens_sets)) {}
+
+  GrowableLlmExecutor::ExecutorFactory AsFactory() {
+    return [this](int max_num_tokens)
+               -> absl::StatusOr<std::unique_ptr<LlmExecutor>> {
+      auto executor = std::make_unique<FakeKvCacheExecutor>(
+          max_num_tokens, prefill_tokens_sets_[max_num_tokens],
+          decode_tokens_sets_[max_num_tokens]);
+      last_executor_ = executor.get();
+      ++num_created_;
+      return executor;
+    };
+  }
+
+  FakeKvCacheExecutor* last_executor() const { return last_executor_; }
+  int num_created() const { return num_created_; }
+
+ private:
+  absl::flat_hash_map<int, std::vector<std::vector<int>>> prefill_tokens_sets_;
+  absl::flat_hash_map<int, std::vector<std::vector<int>>> decode_tokens_sets_;
+  FakeKvCacheExecutor* last_executor_ = nullptr;
+  int num_created_ = 0;
+};
+
+ExecutorInputs MakeInputs(std::vector<int> token_ids) {
+  auto token_ids_buffer = CopyToTensorBuffer<int>(
+      absl::MakeSpan(token_ids), {1, static_cast<int>(token_ids.size())});
+  ExecutorInputs inputs;
+  inputs.SetTextData(ExecutorTextData(std::move(*token_ids_buffer)));
+  return inputs;
+}
+
+TEST(GrowableLlmExecutorTest, CreateRejectsInvalidArguments) {
+  FakeExecutorFactory factory({}, {});
+  EXPECT_THAT(GrowableLlmExecutor::Create({}, factory.AsFactory()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(GrowableLlmExecutor::Create({8, 4}, factory.AsFactory()),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(GrowableLlmExecutor::Create({4}, nullptr),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_EQ(factory.num_created(), 0);
+}
+
+TEST(GrowableLlmExecutorTest, GrowsTheKvCacheBeforeItOverflows) {
+  FakeExecutorFactory factory(
+      /*prefill_tokens_sets=*/{{4, {{1, 2, 3}}}, {8, {{7, 8, 9, 10}}}},
+      /*decode_tokens_sets=*/{{4, {{5}}}, {8, {{11}}}});
+  ASSERT_OK_AND_ASSIGN(
+      auto executor,
+      GrowableLlmExecutor::Create({4, 8, 16}, factory.AsFactory()));
+  EXPECT_EQ(executor->GetCapacity(), 4);
+  // The context is bounded by the largest capacity.
+  ASSERT_OK_AND_ASSIGN(auto settings, executor->GetExecutorSettings());
+  EXPECT_EQ(settings.GetMaxNumTokens(), 16);
+
+  EXPECT_OK(executor->Prefill(MakeInputs({1, 2, 3})));
+  // The kv-cache written by the prefill, 10 * token + head.
+  FakeKvCacheExecutor* small_executor = factory.last_executor();
+  for (int token = 0; token < 2; ++token) {
+    for (int head = 0; head < kNumHeads; ++head) {
+      small_executor->kv_cache()[token * kNumHeads + head] = 10 * token + head;
+    }
+  }
+  LITERT_ASSERT_OK_AND_ASSIGN(auto output_tokens,
+                              CreateTensorBuffer<int>({1, 1}));
+  EXPECT_OK(executor->Decode(output_tokens));
+  EXPECT_EQ(executor->GetCapacity(), 4);
+  EXPECT_EQ(executor->GetNumGrowths(), 0);
+
+  // The next prompt does not fit in 4 tokens, so the context moves to the
+  // executor of 8 tokens first, with its kv-cache.
+  EXPECT_OK(executor->Prefill(MakeInputs({7, 8, 9, 10})));
+  EXPECT_EQ(executor->GetCapacity(), 8);
+  EXPECT_EQ(executor->GetNumGrowths(), 1);
+  EXPECT_EQ(*executor->GetCurrentStep(), 8);
+  EXPECT_THAT(factory.last_executor()->kv_cache(),
+              ElementsAreArray({0, 1, 10, 11, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                                0, 0}));
+  EXPECT_OK(executor->Decode(output_tokens));
+  auto output_tokens_span = ReferTensorBufferAsSpan<int>(output_tokens);
+  EXPECT_EQ((*output_tokens_span)[0], 11);
+
+  // Reset goes back to the smallest capacity.
+  EXPECT_OK(executor->Reset());
+  EXPECT_EQ(executor->GetCapacity(), 4);
+  EXPECT_EQ(*executor->GetCurrentStep(), 0);
+  EXPECT_EQ(factory.num_created(), 3);
+}
+
+TEST(GrowableLlmExecutorTest, RestoresCheckpointsOfOtherCapacities) {
+  FakeExecutorFactory factory({}, {});
+  ASSERT_OK_AND_ASSIGN(
+      auto executor,
+      GrowableLlmExecutor::Create({4, 8, 16}, factory.AsFactory()));
+
+  // A checkpoint of 2 tokens saved at 8 tokens is restored at 4 tokens.
+  ExecutorCheckpoint::KvCacheData small_kv_cache;
+  small_kv_cache[kKvCacheName] = {0, 1, 10, 11, 0, 0, 0, 0,
+                                  0, 0, 0,  0,  0, 0, 0, 0};
+  ExecutorCheckpoint small_checkpoint(/*current_step=*/2,
+                                      /*next_input_token_id=*/-1,
+                                      std::move(small_kv_cache));
+  EXPECT_OK(executor->RestoreState(small_checkpoint));
+  EXPECT_EQ(executor->GetCapacity(), 4);
+  EXPECT_THAT(factory.last_executor()->kv_cache(),
+              ElementsAreArray({0, 1, 10, 11, 0, 0, 0, 0}));
+
+  // A checkpoint of 6 tokens moves the context to 8 tokens.
+  ExecutorCheckpoint::KvCacheData large_kv_cache;
+  large_kv_cache[kKvCacheName] = std::vector<uint8_t>(16, 1);
+  ExecutorCheckpoint large_checkpoint(/*current_step=*/5,
+                                      /*next_input_token_id=*/3,
+                                      std::move(large_kv_cache));
+  EXPECT_OK(executor->RestoreState(large_checkpoint));
+  EXPECT_EQ(executor->GetCapacity(), 8);
+  EXPECT_EQ(executor->GetNumGrowths(), 1);
+  EXPECT_EQ(*executor->GetCurrentStep(), 6);
+  EXPECT_EQ(*executor->GetNextInputTokenId(), 3);
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,130 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/kv_cache_block_allocator.h"
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<KvCacheBlockAllocator>>
+KvCacheBlockAllocator::Create(int num_blocks, int block_size) {
+  if (num_blocks <= 0) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Number of kv-cache blocks must be positive, got ",
+                     num_blocks, "."));
+  }
+  if (block_size <= 0) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Kv-cache block size must be positive, got ", block_size, "."));
+  }
+  return absl::WrapUnique(new KvCacheBlockAllocator(num_blocks, block_size));
+}
+
+KvCacheBlockAllocator::KvCacheBlockAllocator(int num_blocks, int block_size)
+    : block_size_(block_size), allocated_(num_blocks, false) {
+  free_blocks_.reserve(num_blocks);
+  // Push in reverse order so that block 0 is handed out first.
+  for (int i = num_blocks - 1; i >= 0; --i) {
+    free_blocks_.push_back(i);
+  }
+}
+
+absl::StatusOr<int> KvCacheBlockAllocator::AllocateBlock() {
+  if (free_blocks_.empty()) {
+    return absl::ResourceExhaustedError(absl::StrCat(
+        "All ", NumBlocks(), " kv-cache blocks are in use."));
+  }
+  int block_index = free_blocks_.back();
+  free_blocks_.pop_back();
+  allocated_[block_index] = true;
+  return block_index;
+}
+
+absl::Status KvCacheBlockAllocator::FreeBlock(int block_index) {
+  if (block_index < 0 || block_index >= NumBlocks()) {
+    return absl::InvalidArgumentError(absl::StrCat(
+        "Kv-cache block index ", block_index, " is out of range [0, ",
+        NumBlocks(), ")."));
+  }
+  if (!allocated_[block_index]) {
+    return absl::FailedPreconditionError(
+        absl::StrCat("Kv-cache block ", block_index, " is not allocated."));
+  }
+  allocated_[block_index] = false;
+  free_blocks_.push_back(block_index);
+  return absl::OkStatus();
+}
+
+KvCacheBlockTable::~KvCacheBlockTable() {
+  if (auto status = Release(); !status.ok()) {
+    ABSL_LOG(ERROR) << "Failed to release kv-cache blocks: " << status;
+  }
+}
+
+KvCacheBlockTable::KvCacheBlockTable(KvCacheBlockTable&& other)
+    : allocator_(other.allocator_), blocks_(std::move(other.blocks_)) {
+  other.blocks_.clear();
+}
+
+KvCacheBlockTable& KvCacheBlockTable::operator=(KvCacheBlockTable&& other) {
+  if (this != &other) {
+    Release().IgnoreError();
+    allocator_ = other.allocator_;
+    blocks_ = std::move(other.blocks_);
+    other.blocks_.clear();
+  }
+  return *this;
+}
+
+absl::Status KvCacheBlockTable::EnsureCapacity(int num_tokens) {
+  RET_CHECK(allocator_ != nullptr).SetCode(absl::StatusCode::kFailedPrecondition)
+      << "Kv-cache block table has no allocator.";
+  const int num_blocks_needed = allocator_->NumBlocksForTokens(num_tokens);
+  const int num_blocks_before = blocks_.size();
+  while (blocks_.size() < num_blocks_needed) {
+    auto block_index = allocator_->AllocateBlock();
+    if (!block_index.ok()) {
+      // Roll back so that a failed call does not hold on to partial capacity.
+      RETURN_IF_ERROR(Truncate(num_blocks_before * allocator_->BlockSize()));
+      return block_index.status();
+    }
+    blocks_.push_back(*block_index);
+  }
+  return absl::OkStatus();
+}
+
+absl::Status KvCacheBlockTable::Truncate(int num_tokens) {
+  if (allocator_ == nullptr) {
+    return absl::OkStatus();
+  }
+  const int num_blocks_to_keep = allocator_->NumBlocksForTokens(num_tokens);
+  while (blocks_.size() > num_blocks_to_keep) {
+    RETURN_IF_ERROR(allocator_->FreeBlock(blocks_.back()));
+    blocks_.pop_back();
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,119 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_KV_CACHE_BLOCK_ALLOCATOR_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_KV_CACHE_BLOCK_ALLOCATOR_H_
+
+#include <memory>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// A pool of fixed-size kv-cache blocks shared by all the contexts of an
+// executor. Each block holds `block_size` token positions. Blocks are
+// identified by their index in the pool and are handed out in LIFO order so
+// that recently released (and likely still resident) blocks are reused first.
+//
+// The allocator is not thread-safe. The executor is expected to serialize
+// calls, the same way it serializes calls to the compiled model.
+class KvCacheBlockAllocator {
+ public:
+  // Creates an allocator with `num_blocks` blocks of `block_size` tokens each.
+  // Both values must be positive.
+  static absl::StatusOr<std::unique_ptr<KvCacheBlockAllocator>> Create(
+      int num_blocks, int block_size);
+
+  // Returns the index of a free block, or ResourceExhaustedError if the pool
+  // is empty.
+  absl::StatusOr<int> AllocateBlock();
+
+  // Returns the block back to the pool. It is an error to free a block that is
+  // out of range or is not currently allocated.
+  absl::Status FreeBlock(int block_index);
+
+  // Returns the number of token positions held by a single block.
+  int BlockSize() const { return block_size_; }
+
+  // Returns the total number of blocks in the pool.
+  int NumBlocks() const { return static_cast<int>(allocated_.size()); }
+
+  // Returns the number of blocks that are not allocated.
+  int NumFreeBlocks() const { return static_cast<int>(free_blocks_.size()); }
+
+  // Returns the number of blocks needed to hold `num_tokens` positions.
+  int NumBlocksForTokens(int num_tokens) const {
+    return (num_tokens + block_size_ - 1) / block_size_;
+  }
+
+ private:
+  KvCacheBlockAllocator(int num_blocks, int block_size);
+
+  int block_size_;
+  // Stack of free block indices.
+  std::vector<int> free_blocks_;
+  // allocated_[i] is true if block i is currently handed out.
+  std::vector<bool> allocated_;
+};
+
+// The per-context view of the paged kv-cache: maps logical block `i` (token
+// positions [i * block_size, (i + 1) * block_size)) to a physical block of the
+// shared allocator. Blocks are only taken from the pool when the context grows
+// into them, so short contexts do not reserve the worst case.
+class KvCacheBlockTable {
+ public:
+  // The allocator must outlive the block table.
+  explicit KvCacheBlockTable(KvCacheBlockAllocator* allocator)
+      : allocator_(allocator) {}
+  ~KvCacheBlockTable();
+
+  KvCacheBlockTable(const KvCacheBlockTable&) = delete;
+  KvCacheBlockTable& operator=(const KvCacheBlockTable&) = delete;
+  KvCacheBlockTable(KvCacheBlockTable&& other);
+  KvCacheBlockTable& operator=(KvCacheBlockTable&& other);
+
+  // Makes sure the table maps enough blocks to hold `num_tokens` positions,
+  // allocating new blocks from the pool if needed. On failure no block is
+  // leaked and the table keeps its previous size.
+  absl::Status EnsureCapacity(int num_tokens);
+
+  // Drops the blocks beyond the ones needed to hold `num_tokens` positions and
+  // returns them to the pool.
+  absl::Status Truncate(int num_tokens);
+
+  // Returns all the blocks to the pool.
+  absl::Status Release() { return Truncate(0); }
+
+  // Returns the physical block indices, in logical order.
+  absl::Span<const int> Blocks() const { return blocks_; }
+
+  // Returns the number of token positions that can be held without allocating
+  // new blocks.
+  int Capacity() const {
+    return allocator_ == nullptr
+               ? 0
+               : static_cast<int>(blocks_.size()) * allocator_->BlockSize();
+  }
+
+ private:
+  KvCacheBlockAllocator* allocator_;
+  std::vector<int> blocks_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_KV_CACHE_BLOCK_ALLOCATOR_H_
@@ -0,0 +1,123 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/kv_cache_block_allocator.h"
+
+#include <utility>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::status::StatusIs;
+
+TEST(KvCacheBlockAllocatorTest, CreateRejectsInvalidArguments) {
+  EXPECT_THAT(KvCacheBlockAllocator::Create(/*num_blocks=*/0,
+                                            /*block_size=*/16),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(KvCacheBlockAllocator::Create(/*num_blocks=*/4,
+                                            /*block_size=*/0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(KvCacheBlockAllocatorTest, AllocateAndFree) {
+  ASSERT_OK_AND_ASSIGN(auto allocator, KvCacheBlockAllocator::Create(
+                                           /*num_blocks=*/2,
+                                           /*block_size=*/16));
+  EXPECT_EQ(allocator->NumFreeBlocks(), 2);
+  ASSERT_OK_AND_ASSIGN(int block_0, allocator->AllocateBlock());
+  ASSERT_OK_AND_ASSIGN(int block_1, allocator->AllocateBlock());
+  EXPECT_EQ(block_0, 0);
+  EXPECT_EQ(block_1, 1);
+  EXPECT_EQ(allocator->NumFreeBlocks(), 0);
+  EXPECT_THAT(allocator->AllocateBlock(),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+
+  EXPECT_OK(allocator->FreeBlock(block_0));
+  EXPECT_THAT(allocator->FreeBlock(block_0),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(allocator->FreeBlock(5),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_EQ(allocator->NumFreeBlocks(), 1);
+}
+
+TEST(KvCacheBlockTableTest, GrowsOnDemand) {
+  ASSERT_OK_AND_ASSIGN(auto allocator, KvCacheBlockAllocator::Create(
+                                           /*num_blocks=*/4,
+                                           /*block_size=*/16));
+  KvCacheBlockTable table(allocator.get());
+  EXPECT_EQ(table.Capacity(), 0);
+
+  EXPECT_OK(table.EnsureCapacity(1));
+  EXPECT_EQ(table.Capacity(), 16);
+  EXPECT_OK(table.EnsureCapacity(16));
+  EXPECT_EQ(table.Capacity(), 16);
+  EXPECT_OK(table.EnsureCapacity(17));
+  EXPECT_EQ(table.Capacity(), 32);
+  EXPECT_THAT(table.Blocks(), ElementsAre(0, 1));
+  EXPECT_EQ(allocator->NumFreeBlocks(), 2);
+}
+
+TEST(KvCacheBlockTableTest, FailedGrowthRollsBack) {
+  ASSERT_OK_AND_ASSIGN(auto allocator, KvCacheBlockAllocator::Create(
+                                           /*num_blocks=*/3,
+                                           /*block_size=*/8));
+  KvCacheBlockTable table_1(allocator.get());
+  KvCacheBlockTable table_2(allocator.get());
+  EXPECT_OK(table_1.EnsureCapacity(8));
+
+  EXPECT_THAT(table_2.EnsureCapacity(24),
+              StatusIs(absl::StatusCode::kResourceExhausted));
+  EXPECT_EQ(table_2.Capacity(), 0);
+  EXPECT_EQ(allocator->NumFreeBlocks(), 2);
+}
+
+TEST(KvCacheBlockTableTest, TruncateAndRelease) {
+  ASSERT_OK_AND_ASSIGN(auto allocator, KvCacheBlockAllocator::Create(
+                                           /*num_blocks=*/4,
+                                           /*block_size=*/4));
+  KvCacheBlockTable table(allocator.get());
+  EXPECT_OK(table.EnsureCapacity(16));
+  EXPECT_EQ(allocator->NumFreeBlocks(), 0);
+
+  EXPECT_OK(table.Truncate(5));
+  EXPECT_EQ(table.Capacity(), 8);
+  EXPECT_EQ(allocator->NumFreeBlocks(), 2);
+
+  EXPECT_OK(table.Release());
+  EXPECT_EQ(table.Capacity(), 0);
+  EXPECT_EQ(allocator->NumFreeBlocks(), 4);
+}
+
+TEST(KvCacheBlockTableTest, DestructorReturnsBlocks) {
+  ASSERT_OK_AND_ASSIGN(auto allocator, KvCacheBlockAllocator::Create(
+                                           /*num_blocks=*/2,
+                                           /*block_size=*/4));
+  {
+    KvCacheBlockTable table(allocator.get());
+    EXPECT_OK(table.EnsureCapacity(8));
+    KvCacheBlockTable moved = std::move(table);
+    EXPECT_EQ(moved.Capacity(), 8);
+    EXPECT_EQ(allocator->NumFreeBlocks(), 0);
+  }
+  EXPECT_EQ(allocator->NumFreeBlocks(), 2);
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,187 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/kv_cache_layout.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+bool IsValidLayout(const KvCacheTensorLayout& layout) {
+  return layout.seq_dim >= 0 && layout.seq_dim < layout.dims.size() &&
+         layout.element_size > 0 &&
+         std::all_of(layout.dims.begin(), layout.dims.end(),
+                     [](int dim) { return dim > 0; });
+}
+
+// Returns the strides in bytes of the dimensions of `layout`.
+std::vector<size_t> GetStrides(const KvCacheTensorLayout& layout) {
+  std::vector<size_t> strides(layout.dims.size());
+  size_t stride = layout.element_size;
+  for (int i = layout.dims.size() - 1; i >= 0; --i) {
+    strides[i] = stride;
+    stride *= layout.dims[i];
+  }
+  return strides;
+}
+
+// Returns the elements of `values` but the one of the sequence dimension.
+template <typename T>
+std::vector<T> WithoutSeqDim(const std::vector<T>& values,
+                             const KvCacheTensorLayout& layout) {
+  std::vector<T> result = values;
+  result.erase(result.begin() + layout.seq_dim);
+  return result;
+}
+
+}  // namespace
+
+size_t KvCacheTensorLayout::SizeInBytes() const {
+  size_t size = element_size;
+  for (int dim : dims) {
+    size *= dim;
+  }
+  return size;
+}
+
+absl::StatusOr<KvCacheTensorLayout> GetKvCacheTensorLayout(
+    absl::Span<const int> dims, int kv_cache_length, size_t size_in_bytes) {
+  KvCacheTensorLayout layout;
+  layout.dims.assign(dims.begin(), dims.end());
+  for (int i = 1; i < dims.size(); ++i) {
+    if (dims[i] == kv_cache_length) {
+      RET_CHECK_EQ(layout.seq_dim, -1)
+              .SetCode(absl::StatusCode::kInvalidArgument)
+          << "Ambiguous sequence dimension of the kv-cache.";
+      layout.seq_dim = i;
+    }
+  }
+  RET_CHECK_NE(layout.seq_dim, -1).SetCode(absl::StatusCode::kInvalidArgument)
+      << "No kv-cache dimension of size " << kv_cache_length;
+  size_t num_elements = 1;
+  for (int dim : dims) {
+    num_elements *= dim;
+  }
+  RET_CHECK(num_elements > 0 && size_in_bytes % num_elements == 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Kv-cache tensor of " << size_in_bytes << " bytes does not hold "
+      << num_elements << " elements.";
+  layout.element_size = size_in_bytes / num_elements;
+  return layout;
+}
+
+absl::Status ConvertKvCacheTensor(absl::Span<const uint8_t> source,
+                                  const KvCacheTensorLayout& source_layout,
+                                  const KvCacheTensorLayout& target_layout,
+                                  int num_tokens, absl::Span<uint8_t> target) {
+  return CopyKvCacheTokens(source, source_layout, /*source_begin=*/0,
+                           target_layout, /*target_begin=*/0, num_tokens,
+                           target);
+}
+
+absl::Status CopyKvCacheTokens(absl::Span<const uint8_t> source,
+                               const KvCacheTensorLayout& source_layout,
+                               int source_begin,
+                               const KvCacheTensorLayout& target_layout,
+                               int target_begin, int num_tokens,
+                               absl::Span<uint8_t> target) {
+  RET_CHECK(IsValidLayout(source_layout) && IsValidLayout(target_layout))
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Invalid kv-cache layout.";
+  if (source_layout.element_size != target_layout.element_size) {
+    return absl::UnimplementedError(absl::StrCat(
+        "Cannot convert kv-cache elements of ", source_layout.element_size,
+        " bytes to ", target_layout.element_size, " bytes."));
+  }
+  // The dimensions other than the sequence one, e.g. [batch, heads, head_dim].
+  const std::vector<int> other_dims =
+      WithoutSeqDim(source_layout.dims, source_layout);
+  RET_CHECK(other_dims == WithoutSeqDim(target_layout.dims, target_layout))
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The kv-cache layouts differ by more than the sequence dimension.";
+  RET_CHECK(num_tokens >= 0 && source_begin >= 0 && target_begin >= 0 &&
+            source_begin + num_tokens <= source_layout.NumTokens() &&
+            target_begin + num_tokens <= target_layout.NumTokens())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Cannot copy " << num_tokens << " tokens from position "
+      << source_begin << " of a kv-cache of " << source_layout.NumTokens()
+      << " tokens to position " << target_begin << " of one of "
+      << target_layout.NumTokens() << " tokens.";
+  RET_CHECK_EQ(source.size(), source_layout.SizeInBytes())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Source kv-cache tensor size mismatch.";
+  RET_CHECK_EQ(target.size(), target_layout.SizeInBytes())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Target kv-cache tensor size mismatch.";
+
+  const std::vector<size_t> source_strides = GetStrides(source_layout);
+  const std::vector<size_t> target_strides = GetStrides(target_layout);
+  const size_t source_seq_stride = source_strides[source_layout.seq_dim];
+  const size_t target_seq_stride = target_strides[target_layout.seq_dim];
+  const std::vector<size_t> source_other_strides =
+      WithoutSeqDim(source_strides, source_layout);
+  const std::vector<size_t> target_other_strides =
+      WithoutSeqDim(target_strides, target_layout);
+
+  // The dimensions after the sequence one in both layouts are the innermost
+  // ones of both, and are copied as one block per token position.
+  const int num_other_dims = other_dims.size();
+  const int num_inner_dims = std::min(
+      source_layout.dims.size() - 1 - source_layout.seq_dim,
+      target_layout.dims.size() - 1 - target_layout.seq_dim);
+  const int num_outer_dims = num_other_dims - num_inner_dims;
+  size_t block_size = source_layout.element_size;
+  for (int i = num_outer_dims; i < num_other_dims; ++i) {
+    block_size *= other_dims[i];
+  }
+  size_t num_blocks = 1;
+  for (int i = 0; i < num_outer_dims; ++i) {
+    num_blocks *= other_dims[i];
+  }
+
+  std::vector<int> index(num_outer_dims, 0);
+  for (size_t block = 0; block < num_blocks; ++block) {
+    size_t source_offset = source_begin * source_seq_stride;
+    size_t target_offset = target_begin * target_seq_stride;
+    for (int i = 0; i < num_outer_dims; ++i) {
+      source_offset += index[i] * source_other_strides[i];
+      target_offset += index[i] * target_other_strides[i];
+    }
+    for (int token = 0; token < num_tokens; ++token) {
+      std::memcpy(target.data() + target_offset + token * target_seq_stride,
+                  source.data() + source_offset + token * source_seq_stride,
+                  block_size);
+    }
+    for (int i = num_outer_dims - 1; i >= 0; --i) {
+      if (++index[i] < other_dims[i]) {
+        break;
+      }
+      index[i] = 0;
+    }
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,85 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_KV_CACHE_LAYOUT_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_KV_CACHE_LAYOUT_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// The memory layout of a kv-cache tensor, e.g. [batch, seq, heads, head_dim]
+// on the GPU or [batch, heads, seq, head_dim] on the NPU, with the key tensor
+// sometimes transposed to [batch, heads, head_dim, seq].
+struct KvCacheTensorLayout {
+  // The dimensions of the tensor, outermost first.
+  std::vector<int> dims;
+  // The index of the sequence dimension in `dims`, whose size is the number of
+  // token positions held by the tensor.
+  int seq_dim = -1;
+  // The size of one element in bytes.
+  size_t element_size = 0;
+
+  bool operator==(const KvCacheTensorLayout& other) const = default;
+
+  // Returns the number of token positions held by the tensor.
+  int NumTokens() const { return dims[seq_dim]; }
+  // Returns the size of the tensor in bytes.
+  size_t SizeInBytes() const;
+};
+
+// The layouts of the kv-cache tensors of an executor, keyed by the tensor name
+// as in the checkpoints of LlmExecutorBase::SaveState().
+using KvCacheLayouts = absl::flat_hash_map<std::string, KvCacheTensorLayout>;
+
+// Returns the layout of a kv-cache tensor of `dims` and `size_in_bytes`
+// holding `kv_cache_length` token positions. The sequence dimension is the
+// only one of size `kv_cache_length` after the batch dimension, as assumed by
+// ShiftKvCache().
+absl::StatusOr<KvCacheTensorLayout> GetKvCacheTensorLayout(
+    absl::Span<const int> dims, int kv_cache_length, size_t size_in_bytes);
+
+// Copies the first `num_tokens` token positions of the kv-cache tensor
+// `source` to `target`, which may hold a different number of positions and
+// have its sequence dimension elsewhere. The other dimensions must be the same
+// and in the same order in both layouts, and so must the element size, i.e.
+// the values are moved but never converted. The positions of `target` after
+// `num_tokens` are left as they are.
+absl::Status ConvertKvCacheTensor(absl::Span<const uint8_t> source,
+                                  const KvCacheTensorLayout& source_layout,
+                                  const KvCacheTensorLayout& target_layout,
+                                  int num_tokens, absl::Span<uint8_t> target);
+
+// Same as ConvertKvCacheTensor(), but copies the `num_tokens` token positions
+// of `source` from `source_begin` on to the positions of `target` from
+// `target_begin` on, e.g. to gather the kv-cache segments of several prompts
+// into one kv-cache.
+absl::Status CopyKvCacheTokens(absl::Span<const uint8_t> source,
+                               const KvCacheTensorLayout& source_layout,
+                               int source_begin,
+                               const KvCacheTensorLayout& target_layout,
+                               int target_begin, int num_tokens,
+                               absl::Span<uint8_t> target);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_KV_CACHE_LAYOUT_H_
@@ -0,0 +1,171 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/kv_cache_layout.h"
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+constexpr int kNumHeads = 2;
+constexpr int kHeadDim = 3;
+
+// The layouts of a kv-cache of `num_tokens` positions with int16 elements.
+KvCacheTensorLayout SeqHeadsLayout(int num_tokens) {
+  return {{1, num_tokens, kNumHeads, kHeadDim}, 1, sizeof(int16_t)};
+}
+KvCacheTensorLayout HeadsSeqLayout(int num_tokens) {
+  return {{1, kNumHeads, num_tokens, kHeadDim}, 2, sizeof(int16_t)};
+}
+KvCacheTensorLayout TransposedLayout(int num_tokens) {
+  return {{1, kNumHeads, kHeadDim, num_tokens}, 3, sizeof(int16_t)};
+}
+
+int16_t Value(int token, int head, int dim) {
+  return token * 100 + head * 10 + dim;
+}
+
+// Returns the byte offset of the element (token, head, dim) in `layout`.
+size_t Offset(const KvCacheTensorLayout& layout, int token, int head,
+              int dim) {
+  std::vector<int> index;
+  for (int i = 1, other = 0; i < layout.dims.size(); ++i) {
+    index.push_back(i == layout.seq_dim ? token : (other++ == 0 ? head : dim));
+  }
+  size_t offset = 0;
+  for (int i = 1; i < layout.dims.size(); ++i) {
+    offset = offset * layout.dims[i] + index[i - 1];
+  }
+  return offset * layout.element_size;
+}
+
+// Returns a tensor of `layout` whose first `num_tokens` positions are filled.
+std::vector<uint8_t> MakeTensor(const KvCacheTensorLayout& layout,
+                                int num_tokens) {
+  std::vector<uint8_t> tensor(layout.SizeInBytes(), 0);
+  for (int token = 0; token < num_tokens; ++token) {
+    for (int head = 0; head < kNumHeads; ++head) {
+      for (int dim = 0; dim < kHeadDim; ++dim) {
+        const int16_t value = Value(token, head, dim);
+        std::memcpy(tensor.data() + Offset(layout, token, head, dim), &value,
+                    sizeof(value));
+      }
+    }
+  }
+  return tensor;
+}
+
+TEST(KvCacheLayoutTest, GetKvCacheTensorLayout) {
+  ASSERT_OK_AND_ASSIGN(auto layout, GetKvCacheTensorLayout(
+                                        {1, 2, 16, 3}, /*kv_cache_length=*/16,
+                                        /*size_in_bytes=*/2 * 16 * 3 * 4));
+  EXPECT_EQ(layout.seq_dim, 2);
+  EXPECT_EQ(layout.element_size, 4);
+  EXPECT_EQ(layout.NumTokens(), 16);
+
+  EXPECT_THAT(GetKvCacheTensorLayout({1, 16, 16, 3}, 16, 16 * 16 * 3 * 4),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(GetKvCacheTensorLayout({1, 2, 16, 3}, 8, 2 * 16 * 3 * 4),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(GetKvCacheTensorLayout({1, 2, 16, 3}, 16, 2 * 16 * 3 * 4 + 1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(KvCacheLayoutTest, ConvertsBetweenLayouts) {
+  const std::vector<KvCacheTensorLayout> layouts = {
+      SeqHeadsLayout(8), HeadsSeqLayout(8), TransposedLayout(8),
+      SeqHeadsLayout(5), HeadsSeqLayout(12), TransposedLayout(6)};
+  constexpr int kNumTokens = 5;
+  for (const auto& source_layout : layouts) {
+    const std::vector<uint8_t> source = MakeTensor(source_layout, kNumTokens);
+    for (const auto& target_layout : layouts) {
+      std::vector<uint8_t> target(target_layout.SizeInBytes(), 0);
+      ASSERT_OK(ConvertKvCacheTensor(source, source_layout, target_layout,
+                                     kNumTokens, absl::MakeSpan(target)));
+      EXPECT_EQ(target, MakeTensor(target_layout, kNumTokens));
+    }
+  }
+}
+
+TEST(KvCacheLayoutTest, CopiesTokenRanges) {
+  const KvCacheTensorLayout source_layout = HeadsSeqLayout(8);
+  const KvCacheTensorLayout target_layout = SeqHeadsLayout(6);
+  const std::vector<uint8_t> source = MakeTensor(source_layout, 5);
+  std::vector<uint8_t> target(target_layout.SizeInBytes(), 0);
+  // Tokens 2 to 4 of the source go to positions 1 to 3 of the target.
+  ASSERT_OK(CopyKvCacheTokens(source, source_layout, /*source_begin=*/2,
+                              target_layout, /*target_begin=*/1,
+                              /*num_tokens=*/3, absl::MakeSpan(target)));
+  for (int token = 0; token < target_layout.NumTokens(); ++token) {
+    for (int head = 0; head < kNumHeads; ++head) {
+      for (int dim = 0; dim < kHeadDim; ++dim) {
+        int16_t value;
+        std::memcpy(&value,
+                    target.data() + Offset(target_layout, token, head, dim),
+                    sizeof(value));
+        const bool copied = token >= 1 && token < 4;
+        EXPECT_EQ(value, copied ? Value(token + 1, head, dim) : 0);
+      }
+    }
+  }
+
+  // Past the end of the target.
+  EXPECT_THAT(CopyKvCacheTokens(source, source_layout, 2, target_layout, 4, 3,
+                                absl::MakeSpan(target)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(KvCacheLayoutTest, ConvertRejectsMismatchedLayouts) {
+  const std::vector<uint8_t> source = MakeTensor(SeqHeadsLayout(8), 4);
+  std::vector<uint8_t> target(SeqHeadsLayout(4).SizeInBytes());
+
+  // Too many tokens for the target.
+  EXPECT_THAT(ConvertKvCacheTensor(source, SeqHeadsLayout(8),
+                                   SeqHeadsLayout(4), 5,
+                                   absl::MakeSpan(target)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // Wrong target size.
+  EXPECT_THAT(ConvertKvCacheTensor(source, SeqHeadsLayout(8),
+                                   SeqHeadsLayout(6), 4,
+                                   absl::MakeSpan(target)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // Different number of heads.
+  KvCacheTensorLayout more_heads = SeqHeadsLayout(4);
+  more_heads.dims[2] = kNumHeads + 1;
+  std::vector<uint8_t> more_heads_target(more_heads.SizeInBytes());
+  EXPECT_THAT(ConvertKvCacheTensor(source, SeqHeadsLayout(8), more_heads, 4,
+                                   absl::MakeSpan(more_heads_target)),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // Different element types.
+  KvCacheTensorLayout float_layout = SeqHeadsLayout(4);
+  float_layout.element_size = sizeof(float);
+  std::vector<uint8_t> float_target(float_layout.SizeInBytes());
+  EXPECT_THAT(ConvertKvCacheTensor(source, SeqHeadsLayout(8), float_layout, 4,
+                                   absl::MakeSpan(float_target)),
+              StatusIs(absl::StatusCode::kUnimplemented));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -15,11 +15,13 @@
 #include "runtime/executor/litert_compiled_model_executor_utils.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
 #include <cstring>
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -28,17 +30,28 @@
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/strings/str_split.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_buffer_ref.h"  // from @litert
+#include "litert/cc/litert_element_type.h"  // from @litert
 #include "litert/cc/litert_expected.h"  // from @litert
 #include "litert/cc/litert_model.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/components/model_resources.h"
 #include "runtime/components/model_resources_litert_lm.h"
 #include "runtime/components/model_resources_task.h"
+#include "runtime/components/sampling_cpu_util.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/util/convert_tensor_buffer.h"
 #include "runtime/util/file_format_util.h"
+#include "runtime/util/init_phase.h"
 #include "runtime/util/litert_lm_loader.h"
+#include "runtime/util/litert_status_util.h"
 #include "runtime/util/model_asset_bundle_resources.h"
 #include "runtime/util/scoped_file.h"
 #include "runtime/util/status_macros.h"  //NOLINT
@@ -90,6 +103,10 @@ constexpr AttentionMaskDataType kPyTorchCpuOnly_InputAttnMaskDataType =
 // Output: [batch_size, max_seq_len, vocab_size]
 constexpr char kPyTorchCpuOnly_OutputLogits[] = "logits";
 
+// Starts the line of a prefill cost file recording the device the costs were
+// measured on.
+constexpr absl::string_view kDeviceLinePrefix = "device ";
+
 // Gemma 3n with external embeddings model signature.
 // Input: [max_seq_len]
 constexpr char kExternalEmbeddingsModel_InputPositions[] = "input_pos";
@@ -117,6 +134,13 @@ constexpr AttentionMaskDataType kGemini_InputAttnMaskDataType =
 // Output: [batch_size, max_seq_len, vocab_size]
 constexpr char kGemini_OutputLogits[] = "logits";
 
+// Model signatures deriving the positions and the attention mask on device.
+// The tokens are named as by the PyTorch or the JAX conversion.
+// Input: [2] or [batch_size, 2], {start_step, num_steps} per row.
+constexpr char kStepParams_InputStepParams[] = "step_params";
+// Output: [batch_size, max_seq_len, vocab_size]
+constexpr char kStepParams_OutputLogits[] = "logits";
+
 bool Contains(const std::vector<absl::string_view>& input_names,
               const char* name) {
   return std::find(input_names.begin(), input_names.end(), name) !=
@@ -169,6 +193,14 @@ bool IsExternalEmbeddingModel(
          Contains(output_names, kExternalEmbeddingsModel_OutputLogits);
 }
 
+bool IsStepParamsModel(const std::vector<absl::string_view>& input_names,
+                       const std::vector<absl::string_view>& output_names) {
+  return Contains(input_names, kStepParams_InputStepParams) &&
+         (Contains(input_names, kPyTorch_InputTokens) ||
+          Contains(input_names, kGemma2JAX_InputTokens)) &&
+         Contains(output_names, kStepParams_OutputLogits);
+}
+
 absl::StatusOr<std::unique_ptr<ModelResources>>
 BuildModelResourcesFromTaskFormat(std::shared_ptr<ScopedFile> model_file) {
   ASSIGN_OR_RETURN(auto resources,  // NOLINT
@@ -190,13 +222,17 @@ BuildModelResourcesFromTaskFormat(std::shared_ptr<ScopedFile> model_file) {
 }
 
 absl::StatusOr<std::unique_ptr<ModelResources>>
-BuildModelResourcesFromLitertLmFormat(ScopedFile model_file) {
-  auto loader = std::make_unique<LitertLmLoader>(std::move(model_file));
+BuildModelResourcesFromLitertLmFormat(
+    ScopedFile model_file, const WeightMemoryOptions& weight_memory_options,
+    absl::Duration section_arrival_timeout,
+    FakeWeightsMode fake_weights_mode) {
+  auto loader = std::make_unique<LitertLmLoader>(
+      std::move(model_file), weight_memory_options, section_arrival_timeout);
 
   ABSL_LOG(INFO) << "Read litert model from section.";
 
   // Save the loader for future use and keep the model alive.
-  return ModelResourcesLitertLm::Create(std::move(loader));
+  return ModelResourcesLitertLm::Create(std::move(loader), fake_weights_mode);
 }
 
 }  // namespace
@@ -204,6 +240,18 @@ BuildModelResourcesFromLitertLmFormat(ScopedFile model_file) {
 absl::StatusOr<ModelSignatures> GetModelSignaturesFromInputOutputNames(
     const std::vector<absl::string_view>& input_names,
     const std::vector<absl::string_view>& output_names) {
+  // Checked first, as the step parameters take precedence over any positions
+  // input the model may have.
+  if (IsStepParamsModel(input_names, output_names)) {
+    return ModelSignatures{
+        .input_tokens = Contains(input_names, kPyTorch_InputTokens)
+                            ? kPyTorch_InputTokens
+                            : kGemma2JAX_InputTokens,
+        .input_step_params = kStepParams_InputStepParams,
+        .output_logits = kStepParams_OutputLogits,
+    };
+  }
+
   if (IsGemma2JAX(input_names, output_names)) {
     return ModelSignatures{
         .input_tokens = kGemma2JAX_InputTokens,
@@ -261,7 +309,7 @@ absl::StatusOr<ModelSignatures> GetModelSignaturesFromInputOutputNames(
 
 absl::StatusOr<SortedPrefillSignatureMap> GetPrefillRunnerSetFromModel(
     const ::litert::Model& model, const std::string& signature_name_base,
-    const std::string& input_positions_name) {
+    const std::string& input_length_name) {
   SortedPrefillSignatureMap prefill_runner_set;
   auto signatures = model.GetSignatures();
   for (auto& signature : *signatures) {
@@ -271,11 +319,11 @@ absl::StatusOr<SortedPrefillSignatureMap> GetPrefillRunnerSetFromModel(
       if (!subgraph) {
         return absl::InternalError(subgraph.Error().Message());
       }
-      auto input_positions_tensor = subgraph->Input(input_positions_name);
-      if (!input_positions_tensor) {
-        return absl::InternalError(input_positions_tensor.Error().Message());
+      auto input_length_tensor = subgraph->Input(input_length_name);
+      if (!input_length_tensor) {
+        return absl::InternalError(input_length_tensor.Error().Message());
       }
-      auto ranked_tensor_type = input_positions_tensor->RankedTensorType();
+      auto ranked_tensor_type = input_length_tensor->RankedTensorType();
       if (!ranked_tensor_type) {
         return absl::InternalError(ranked_tensor_type.Error().Message());
       }
@@ -297,6 +345,89 @@ absl::StatusOr<SortedPrefillSignatureMap> GetPrefillRunnerSetFromModel(
   return prefill_runner_set;
 }
 
+absl::StatusOr<SortedDecodeSignatureMap> GetKvBucketedDecodeSignaturesFromModel(
+    const ::litert::Model& model, const std::string& signature_name_base,
+    const std::string& full_signature_name,
+    const std::string& kv_cache_input_name) {
+  // Returns the dimensions of the kv-cache input of `signature_key`.
+  auto get_kv_cache_dims = [&](absl::string_view signature_key)
+      -> absl::StatusOr<std::vector<int32_t>> {
+    auto subgraph = model.Subgraph(signature_key);
+    if (!subgraph) {
+      return absl::InternalError(subgraph.Error().Message());
+    }
+    auto kv_cache_tensor = subgraph->Input(kv_cache_input_name);
+    if (!kv_cache_tensor) {
+      return absl::InternalError(kv_cache_tensor.Error().Message());
+    }
+    auto ranked_tensor_type = kv_cache_tensor->RankedTensorType();
+    if (!ranked_tensor_type) {
+      return absl::InternalError(ranked_tensor_type.Error().Message());
+    }
+    const auto dims = ranked_tensor_type->Layout().Dimensions();
+    return std::vector<int32_t>(dims.begin(), dims.end());
+  };
+  SortedDecodeSignatureMap decode_signature_map;
+  auto signatures = model.GetSignatures();
+  std::optional<std::vector<int32_t>> full_dims;
+  for (auto& signature : *signatures) {
+    const absl::string_view signature_key = signature.Key();
+    if (signature_key == full_signature_name ||
+        !absl::StartsWith(signature_key, signature_name_base)) {
+      continue;
+    }
+    if (!full_dims.has_value()) {
+      ASSIGN_OR_RETURN(full_dims, get_kv_cache_dims(full_signature_name));
+    }
+    ASSIGN_OR_RETURN(std::vector<int32_t> dims,
+                     get_kv_cache_dims(signature_key));
+    absl::StatusOr<int> kv_length = GetPrefixKvCacheLength(*full_dims, dims);
+    if (!kv_length.ok()) {
+      return absl::FailedPreconditionError(
+          absl::StrCat("Decode signature ", signature_key,
+                       " cannot share the kv-cache of ", full_signature_name,
+                       ": ", kv_length.status().message()));
+    }
+    decode_signature_map[*kv_length] = std::string(signature_key);
+  }
+  return decode_signature_map;
+}
+
+absl::StatusOr<int> GetPrefixKvCacheLength(absl::Span<const int32_t> full_dims,
+                                           absl::Span<const int32_t> dims) {
+  if (dims.size() != full_dims.size()) {
+    return absl::FailedPreconditionError(
+        "The kv-cache tensors are of different ranks.");
+  }
+  for (int i = 0; i < dims.size(); ++i) {
+    if (dims[i] == full_dims[i]) {
+      if (full_dims[i] != 1) {
+        break;
+      }
+      continue;
+    }
+    // The dimensions after the kv-cache one must all match, such that the
+    // shorter kv-cache is a prefix of the longer one in memory.
+    if (dims[i] > full_dims[i] ||
+        !std::equal(dims.begin() + i + 1, dims.end(),
+                    full_dims.begin() + i + 1)) {
+      break;
+    }
+    return dims[i];
+  }
+  return absl::FailedPreconditionError(absl::StrCat(
+      "The kv-cache of dimensions [", absl::StrJoin(dims, ", "),
+      "] is not a shorter prefix of the one of dimensions [",
+      absl::StrJoin(full_dims, ", "), "]."));
+}
+
+absl::string_view GetDecodeSignatureForStep(
+    const SortedDecodeSignatureMap& decode_signature_map, int step) {
+  auto it = decode_signature_map.upper_bound(step);
+  return it == decode_signature_map.end() ? absl::string_view()
+                                          : absl::string_view(it->second);
+}
+
 absl::StatusOr<std::vector<std::pair<std::string, int>>>
 GetOptimizedPrefillWorkGroups(
     const SortedPrefillSignatureMap& prefill_runner_set, int input_length) {
@@ -329,6 +460,146 @@ GetOptimizedPrefillWorkGroups(
   return work_groups;
 }
 
+absl::StatusOr<std::vector<std::pair<std::string, int>>>
+GetOptimizedPrefillWorkGroups(
+    const SortedPrefillSignatureMap& prefill_runner_set, int input_length,
+    const PrefillSignatureCosts& costs) {
+  for (const auto& [seq_len, signature] : prefill_runner_set) {
+    if (!costs.contains(seq_len)) {
+      return GetOptimizedPrefillWorkGroups(prefill_runner_set, input_length);
+    }
+  }
+  // min_costs[n] is the minimum latency to prefill n tokens, and
+  // best_seq_lens[n] the signature of the first work group achieving it. A
+  // signature longer than the remaining tokens is padded, so only the last
+  // work group can be partial.
+  std::vector<double> min_costs(input_length + 1,
+                                std::numeric_limits<double>::infinity());
+  std::vector<int> best_seq_lens(input_length + 1, 0);
+  min_costs[0] = 0;
+  for (int n = 1; n <= input_length; ++n) {
+    for (const auto& [seq_len, signature] : prefill_runner_set) {
+      const double cost =
+          costs.at(seq_len) + min_costs[std::max(n - seq_len, 0)];
+      if (cost < min_costs[n]) {
+        min_costs[n] = cost;
+        best_seq_lens[n] = seq_len;
+      }
+    }
+  }
+  std::vector<std::pair<std::string, int>> work_groups;
+  for (int n = input_length; n > 0;) {
+    const int seq_len = best_seq_lens[n];
+    const int prefill_length = std::min(seq_len, n);
+    work_groups.push_back(
+        std::make_pair(prefill_runner_set.at(seq_len), prefill_length));
+    n -= prefill_length;
+  }
+  return work_groups;
+}
+
+absl::StatusOr<int> GetHighestThroughputPrefillLength(
+    const PrefillSignatureCosts& costs) {
+  RET_CHECK(!costs.empty()).SetCode(absl::StatusCode::kInvalidArgument)
+      << "There is no prefill signature cost.";
+  int best_seq_len = 0;
+  double best_latency_per_token = 0;
+  // From the longest, such that a shorter signature must be strictly faster
+  // per token to be picked.
+  for (auto it = costs.rbegin(); it != costs.rend(); ++it) {
+    const double latency_per_token = it->second / it->first;
+    if (best_seq_len == 0 || latency_per_token < best_latency_per_token) {
+      best_seq_len = it->first;
+      best_latency_per_token = latency_per_token;
+    }
+  }
+  return best_seq_len;
+}
+
+std::string SerializePrefillSignatureCosts(
+    const PrefillSignatureCosts& costs, absl::string_view device_fingerprint) {
+  std::string serialized_costs;
+  if (!device_fingerprint.empty()) {
+    absl::StrAppend(&serialized_costs, kDeviceLinePrefix, device_fingerprint,
+                    "\n");
+  }
+  for (const auto& [seq_len, latency_us] : costs) {
+    absl::StrAppend(&serialized_costs, seq_len, " ", latency_us, "\n");
+  }
+  return serialized_costs;
+}
+
+absl::StatusOr<PrefillSignatureCosts> ParsePrefillSignatureCosts(
+    absl::string_view serialized_costs, absl::string_view device_fingerprint) {
+  PrefillSignatureCosts costs;
+  bool measured_on_device = device_fingerprint.empty();
+  for (absl::string_view line :
+       absl::StrSplit(serialized_costs, '\n', absl::SkipWhitespace())) {
+    if (absl::ConsumePrefix(&line, kDeviceLinePrefix)) {
+      measured_on_device |= line == device_fingerprint;
+      continue;
+    }
+    std::vector<absl::string_view> fields =
+        absl::StrSplit(line, ' ', absl::SkipEmpty());
+    int seq_len = 0;
+    double latency_us = 0;
+    if (fields.size() != 2 || !absl::SimpleAtoi(fields[0], &seq_len) ||
+        !absl::SimpleAtod(fields[1], &latency_us) || seq_len <= 0 ||
+        latency_us < 0) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("Invalid prefill signature cost: ", line));
+    }
+    costs[seq_len] = latency_us;
+  }
+  if (!measured_on_device) {
+    return absl::FailedPreconditionError(
+        "The prefill signature costs were measured on another device.");
+  }
+  return costs;
+}
+
+namespace {
+
+// The float value of the masked out entries of an attention mask.
+// Default value reference:
+// third_party/odml/infra/genai/inference/ml_drift/llm/tasks/apply_attention_mask_test_util.cc
+float MaskedFloatValue(bool is_f16) {
+  return is_f16 ? -45824 : -0.7f * std::numeric_limits<float>::max();
+}
+
+// The values of the visible and masked out entries of an attention mask of
+// elements of type T.
+template <typename T>
+struct AttentionMaskValues {
+  T visible;
+  T masked;
+};
+
+// Calls `fill` with the mask at `mask` cast to its element type, and the
+// values of its entries, such that the loops over the rows are compiled once
+// per element type with no branch on the type or the precision inside. The
+// rows are contiguous, so std::fill() of each range compiles to wide stores,
+// or to memset() for the boolean masks.
+template <typename Fill>
+absl::Status DispatchAttentionMask(void* mask,
+                                   AttentionMaskDataType mask_data_type,
+                                   bool is_f16, Fill&& fill) {
+  switch (mask_data_type) {
+    case AttentionMaskDataType::BOOLEAN:
+      fill(static_cast<bool*>(mask),
+           AttentionMaskValues<bool>{/*visible=*/true, /*masked=*/false});
+      return absl::OkStatus();
+    case AttentionMaskDataType::FLOAT:
+      fill(static_cast<float*>(mask),
+           AttentionMaskValues<float>{/*visible=*/0.0f,
+                                      /*masked=*/MaskedFloatValue(is_f16)});
+      return absl::OkStatus();
+  }
+  return absl::InvalidArgumentError("Unsupported attention mask data type.");
+}
+
+}  // namespace
+
 absl::Status InitializeAttentionMask(litert::TensorBuffer& mask,
                                      AttentionMaskDataType mask_data_type,
                                      bool is_f16) {
@@ -338,24 +609,14 @@ absl::Status InitializeAttentionMask(litert::TensorBuffer& mask,
       mask, litert::TensorBuffer::LockMode::kWrite);
   RET_CHECK(mask_lock_and_addr) << "Failed to lock attention mask buffer.";
 
-  switch (mask_data_type) {
-    case AttentionMaskDataType::BOOLEAN: {
-      // Boolean mask: Default value = false.
-      memset(mask_lock_and_addr->second, 0, *mask_size);
-    } break;
-    case AttentionMaskDataType::FLOAT: {
-      // Float mask: Default value is based on precision.
-      // Default value reference:
-      // third_party/odml/infra/genai/inference/ml_drift/llm/tasks/apply_attention_mask_test_util.cc
-      float* mask_ptr = static_cast<float*>(mask_lock_and_addr->second);
-      std::fill(mask_ptr, mask_ptr + *mask_size / sizeof(float),
-                is_f16 ? -45824 : -0.7f * std::numeric_limits<float>::max());
-    } break;
-    default:
-      return absl::InvalidArgumentError(
-          "Unsupported attention mask data type.");
-  }
-  return absl::OkStatus();
+  // Every entry is masked out: false for a boolean mask, or a value based on
+  // the precision for a float mask.
+  return DispatchAttentionMask(
+      mask_lock_and_addr->second, mask_data_type, is_f16,
+      [&](auto* mask_ptr, auto values) {
+        std::fill(mask_ptr, mask_ptr + *mask_size / sizeof(*mask_ptr),
+                  values.masked);
+      });
 }
 
 absl::Status FillAttentionMask(litert::TensorBuffer& mask, int start_timestep,
@@ -366,53 +627,436 @@ absl::Status FillAttentionMask(litert::TensorBuffer& mask, int start_timestep,
   RET_CHECK_EQ(mask_tensor_type->Layout().Rank(), 4)
           .SetCode(absl::StatusCode::kInvalidArgument)
       << "Attention mask must be 4D.";
-  int channel_size = mask_tensor_type->Layout().Dimensions()[3];
+  const int batch_size = mask_tensor_type->Layout().Dimensions()[0];
+  const int seq_size = mask_tensor_type->Layout().Dimensions()[1];
+  const int channel_size = mask_tensor_type->Layout().Dimensions()[3];
+  RET_CHECK_LE(steps, seq_size).SetCode(absl::StatusCode::kInvalidArgument)
+      << "Attention mask holds " << seq_size << " steps, but " << steps
+      << " steps are to be filled.";
+  auto mask_lock_and_addr = litert::TensorBufferScopedLock::Create(
+      mask, litert::TensorBuffer::LockMode::kWrite);
+  RET_CHECK(mask_lock_and_addr) << "Failed to lock attention mask buffer.";
+
+  // All the batch rows are at the same timesteps, so they get the same mask.
+  // The visible values only depend on the data type: true or 0.0f.
+  return DispatchAttentionMask(
+      mask_lock_and_addr->second, mask_data_type, /*is_f16=*/false,
+      [&](auto* mask_ptr, auto values) {
+        for (int b = 0; b < batch_size; ++b) {
+          for (int i = 0; i < steps; ++i) {
+            // For current step = n, we fill (n+1) positions for the mask
+            // sequence.
+            auto* row = mask_ptr + (b * seq_size + i) * channel_size;
+            std::fill(row, row + start_timestep + i + 1, values.visible);
+          }
+        }
+      });
+}
+
+absl::Status FillStepParams(litert::TensorBuffer& step_params,
+                            int start_timestep, int steps) {
+  auto step_params_size = step_params.PackedSize();
+  RET_CHECK(step_params_size) << "Failed to get step parameters size.";
+  const size_t num_values = *step_params_size / sizeof(int32_t);
+  RET_CHECK(num_values > 0 && num_values % 2 == 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Step parameters must hold {start step, steps} pairs, but hold "
+      << num_values << " values.";
+  auto step_params_lock_and_addr = litert::TensorBufferScopedLock::Create(
+      step_params, litert::TensorBuffer::LockMode::kWrite);
+  RET_CHECK(step_params_lock_and_addr)
+      << "Failed to lock step parameters buffer.";
+  auto* step_params_ptr =
+      static_cast<int32_t*>(step_params_lock_and_addr->second);
+  // All the batch rows are at the same timesteps.
+  for (size_t i = 0; i < num_values; i += 2) {
+    step_params_ptr[i] = start_timestep;
+    step_params_ptr[i + 1] = steps;
+  }
+  return absl::OkStatus();
+}
+
+absl::Status UpdateAttentionMask(litert::TensorBuffer& mask,
+                                 int previous_start_timestep,
+                                 int previous_steps, int start_timestep,
+                                 int steps,
+                                 AttentionMaskDataType mask_data_type,
+                                 bool is_f16) {
+  if (mask_data_type != AttentionMaskDataType::BOOLEAN &&
+      mask_data_type != AttentionMaskDataType::FLOAT) {
+    return absl::InvalidArgumentError("Unsupported attention mask data type.");
+  }
+  auto mask_tensor_type = mask.TensorType();
+  RET_CHECK(mask_tensor_type) << "Failed to get attention mask tensor type.";
+  RET_CHECK_EQ(mask_tensor_type->Layout().Rank(), 4)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Attention mask must be 4D.";
+  const int batch_size = mask_tensor_type->Layout().Dimensions()[0];
+  const int seq_size = mask_tensor_type->Layout().Dimensions()[1];
+  const int channel_size = mask_tensor_type->Layout().Dimensions()[3];
+  RET_CHECK_LE(steps, seq_size).SetCode(absl::StatusCode::kInvalidArgument)
+      << "Attention mask holds " << seq_size << " steps, but " << steps
+      << " steps are to be filled.";
+  RET_CHECK_LE(previous_steps, seq_size)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Attention mask holds " << seq_size << " steps, but " << previous_steps
+      << " steps were filled.";
   auto mask_lock_and_addr = litert::TensorBufferScopedLock::Create(
       mask, litert::TensorBuffer::LockMode::kWrite);
   RET_CHECK(mask_lock_and_addr) << "Failed to lock attention mask buffer.";
 
-  for (int i = 0; i < steps; ++i) {
-    int current_step = start_timestep + i;
-    int offset = i * channel_size;
-    // For current step = n, we fill (n+1) positions for the mask sequence.
-    switch (mask_data_type) {
-      case AttentionMaskDataType::BOOLEAN: {
-        // Boolean mask: Fill value = true.
-        bool* mask_bool_ptr = static_cast<bool*>(mask_lock_and_addr->second);
-        std::fill(mask_bool_ptr + offset,
-                  mask_bool_ptr + offset + current_step + 1, true);
-      } break;
-      case AttentionMaskDataType::FLOAT: {
-        // Float mask: Fill value = 0.0f.
-        float* mask_float_ptr = static_cast<float*>(mask_lock_and_addr->second);
-        std::fill(mask_float_ptr + offset,
-                  mask_float_ptr + offset + current_step + 1, 0.0f);
-      } break;
-      default:
-        return absl::InvalidArgumentError(
-            "Unsupported attention mask data type.");
+  // Row i of a mask filled for steps from timestep n has the first (n+i+1)
+  // entries visible, and the rows after the filled steps fully masked out.
+  const auto visible_end = [channel_size](int start, int num_steps, int row) {
+    return row < num_steps ? std::min(start + row + 1, channel_size) : 0;
+  };
+  const int num_rows = std::max(previous_steps, steps);
+  return DispatchAttentionMask(
+      mask_lock_and_addr->second, mask_data_type, is_f16,
+      [&](auto* mask_ptr, auto values) {
+        for (int b = 0; b < batch_size; ++b) {
+          for (int i = 0; i < num_rows; ++i) {
+            auto* row = mask_ptr + (b * seq_size + i) * channel_size;
+            const int previous_end =
+                visible_end(previous_start_timestep, previous_steps, i);
+            const int end = visible_end(start_timestep, steps, i);
+            if (end > previous_end) {
+              std::fill(row + previous_end, row + end, values.visible);
+            } else if (end < previous_end) {
+              std::fill(row + end, row + previous_end, values.masked);
+            }
+          }
+        }
+      });
+}
+
+absl::Status ShiftKvCache(litert::TensorBuffer& kv_cache, int kv_cache_length,
+                          int num_sink_tokens, int num_discarded_tokens,
+                          int num_tokens) {
+  RET_CHECK(num_sink_tokens >= 0 && num_discarded_tokens >= 0 &&
+            num_sink_tokens + num_discarded_tokens <= num_tokens &&
+            num_tokens <= kv_cache_length)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Cannot discard " << num_discarded_tokens << " tokens after "
+      << num_sink_tokens << " sink tokens from " << num_tokens << " tokens.";
+  const std::pair<int, int> discarded_range = {
+      num_sink_tokens, num_sink_tokens + num_discarded_tokens};
+  return CompactKvCache(kv_cache, kv_cache_length, {discarded_range},
+                        num_tokens);
+}
+
+absl::Status CompactKvCache(
+    litert::TensorBuffer& kv_cache, int kv_cache_length,
+    absl::Span<const std::pair<int, int>> discarded_ranges, int num_tokens) {
+  RET_CHECK(num_tokens >= 0 && num_tokens <= kv_cache_length)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Cannot hold " << num_tokens << " tokens in a kv-cache of length "
+      << kv_cache_length;
+  int num_discarded_tokens = 0;
+  int previous_end = 0;
+  for (const auto& [begin, end] : discarded_ranges) {
+    RET_CHECK(begin >= previous_end && begin <= end && end <= num_tokens)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Cannot discard the tokens [" << begin << ", " << end << ") of "
+        << num_tokens << " tokens after the ones before " << previous_end;
+    num_discarded_tokens += end - begin;
+    previous_end = end;
+  }
+  auto tensor_type = kv_cache.TensorType();
+  RET_CHECK(tensor_type) << "Failed to get kv-cache tensor type.";
+  const auto& dims = tensor_type->Layout().Dimensions();
+  int seq_dim = -1;
+  for (int i = 1; i < dims.size(); ++i) {
+    if (dims[i] == kv_cache_length) {
+      RET_CHECK_EQ(seq_dim, -1).SetCode(absl::StatusCode::kInvalidArgument)
+          << "Ambiguous sequence dimension of the kv-cache.";
+      seq_dim = i;
+    }
+  }
+  RET_CHECK_NE(seq_dim, -1).SetCode(absl::StatusCode::kInvalidArgument)
+      << "No kv-cache dimension of size " << kv_cache_length;
+  if (num_discarded_tokens == 0) {
+    return absl::OkStatus();
+  }
+
+  // The kv-cache is viewed as [outer, kv_cache_length, inner] rows of bytes.
+  size_t num_elements = 1;
+  size_t outer_size = 1;
+  for (int i = 0; i < dims.size(); ++i) {
+    num_elements *= dims[i];
+    if (i < seq_dim) {
+      outer_size *= dims[i];
+    }
+  }
+  auto buffer_size = kv_cache.PackedSize();
+  RET_CHECK(buffer_size) << "Failed to get kv-cache buffer size.";
+  const size_t element_bytes = *buffer_size / num_elements;
+  const size_t position_bytes =
+      element_bytes * (num_elements / outer_size / kv_cache_length);
+  const size_t outer_bytes = position_bytes * kv_cache_length;
+  auto lock_and_addr = litert::TensorBufferScopedLock::Create(
+      kv_cache, litert::TensorBuffer::LockMode::kWrite);
+  RET_CHECK(lock_and_addr) << "Failed to lock kv-cache buffer.";
+  auto* data = static_cast<uint8_t*>(lock_and_addr->second);
+  for (size_t o = 0; o < outer_size; ++o) {
+    uint8_t* row = data + o * outer_bytes;
+    // The kept tokens after each range are moved right after the tokens kept
+    // so far.
+    int num_kept_tokens = discarded_ranges.front().first;
+    for (int i = 0; i < discarded_ranges.size(); ++i) {
+      const int kept_begin = discarded_ranges[i].second;
+      const int kept_end = i + 1 < discarded_ranges.size()
+                               ? discarded_ranges[i + 1].first
+                               : num_tokens;
+      if (kept_end > kept_begin && kept_begin != num_kept_tokens) {
+        memmove(row + num_kept_tokens * position_bytes,
+                row + kept_begin * position_bytes,
+                (kept_end - kept_begin) * position_bytes);
+      }
+      num_kept_tokens += kept_end - kept_begin;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status ReorderKvCacheBatch(litert::TensorBuffer& kv_cache,
+                                 absl::Span<const int> source_rows,
+                                 std::vector<uint8_t>& scratch) {
+  auto tensor_type = kv_cache.TensorType();
+  RET_CHECK(tensor_type) << "Failed to get kv-cache tensor type.";
+  const auto& dims = tensor_type->Layout().Dimensions();
+  RET_CHECK(!dims.empty() && dims[0] == source_rows.size())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Expected " << (dims.empty() ? 0 : dims[0])
+      << " source rows, but got " << source_rows.size();
+  const int batch_size = source_rows.size();
+  bool is_identity = true;
+  for (int b = 0; b < batch_size; ++b) {
+    RET_CHECK(source_rows[b] >= 0 && source_rows[b] < batch_size)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Source row " << source_rows[b] << " is out of range.";
+    is_identity &= source_rows[b] == b;
+  }
+  if (is_identity) {
+    return absl::OkStatus();
+  }
+  auto buffer_size = kv_cache.PackedSize();
+  RET_CHECK(buffer_size) << "Failed to get kv-cache buffer size.";
+  const size_t row_bytes = *buffer_size / batch_size;
+  auto lock_and_addr = litert::TensorBufferScopedLock::Create(
+      kv_cache, litert::TensorBuffer::LockMode::kWrite);
+  RET_CHECK(lock_and_addr) << "Failed to lock kv-cache buffer.";
+  auto* data = static_cast<uint8_t*>(lock_and_addr->second);
+  // The rows are written in order, so a source row is saved only if a later
+  // row reads it once it is overwritten. The slot in `scratch` of each saved
+  // row, or -1 for the rows read in place.
+  std::vector<int> scratch_slots(batch_size, -1);
+  int num_saved_rows = 0;
+  for (int b = 0; b < batch_size; ++b) {
+    const int source = source_rows[b];
+    if (source < b && source_rows[source] != source &&
+        scratch_slots[source] < 0) {
+      scratch_slots[source] = num_saved_rows++;
+    }
+  }
+  scratch.resize(num_saved_rows * row_bytes);
+  for (int row = 0; row < batch_size; ++row) {
+    if (scratch_slots[row] >= 0) {
+      memcpy(scratch.data() + scratch_slots[row] * row_bytes,
+             data + row * row_bytes, row_bytes);
+    }
+  }
+  for (int b = 0; b < batch_size; ++b) {
+    const int source = source_rows[b];
+    if (source != b) {
+      const uint8_t* source_data =
+          scratch_slots[source] >= 0
+              ? scratch.data() + scratch_slots[source] * row_bytes
+              : data + source * row_bytes;
+      memcpy(data + b * row_bytes, source_data, row_bytes);
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status QuantizeKvCacheToInt8(litert::TensorBuffer& kv_cache,
+                                   std::vector<uint8_t>& values,
+                                   std::vector<float>& scales) {
+  auto tensor_type = kv_cache.TensorType();
+  RET_CHECK(tensor_type) << "Failed to get kv-cache tensor type.";
+  RET_CHECK(tensor_type->ElementType() == litert::ElementType::Float32)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Only float32 kv-cache tensors can be quantized.";
+  const auto& dims = tensor_type->Layout().Dimensions();
+  RET_CHECK(!dims.empty() && dims.back() > 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Kv-cache tensor has no innermost dimension.";
+  size_t num_elements = 1;
+  for (int dim : dims) {
+    num_elements *= dim;
+  }
+  const size_t row_size = dims.back();
+  const size_t num_rows = num_elements / row_size;
+  auto lock_and_addr = litert::TensorBufferScopedLock::Create(
+      kv_cache, litert::TensorBuffer::LockMode::kRead);
+  RET_CHECK(lock_and_addr) << "Failed to lock kv-cache buffer.";
+  const auto* data = static_cast<const float*>(lock_and_addr->second);
+  values.resize(num_elements);
+  scales.resize(num_rows);
+  for (size_t r = 0; r < num_rows; ++r) {
+    const float* row = data + r * row_size;
+    float max_abs = 0.0f;
+    for (size_t i = 0; i < row_size; ++i) {
+      max_abs = std::max(max_abs, std::abs(row[i]));
+    }
+    // An all-zero row keeps a zero scale and dequantizes back to zeros.
+    const float scale = max_abs / 127.0f;
+    const float inverse_scale = scale > 0.0f ? 1.0f / scale : 0.0f;
+    scales[r] = scale;
+    for (size_t i = 0; i < row_size; ++i) {
+      const float quantized =
+          std::clamp(std::round(row[i] * inverse_scale), -127.0f, 127.0f);
+      values[r * row_size + i] =
+          static_cast<uint8_t>(static_cast<int8_t>(quantized));
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status DequantizeKvCacheFromInt8(absl::Span<const uint8_t> values,
+                                       absl::Span<const float> scales,
+                                       litert::TensorBuffer& kv_cache) {
+  auto tensor_type = kv_cache.TensorType();
+  RET_CHECK(tensor_type) << "Failed to get kv-cache tensor type.";
+  RET_CHECK(tensor_type->ElementType() == litert::ElementType::Float32)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Only float32 kv-cache tensors can be dequantized.";
+  const auto& dims = tensor_type->Layout().Dimensions();
+  RET_CHECK(!dims.empty() && dims.back() > 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Kv-cache tensor has no innermost dimension.";
+  size_t num_elements = 1;
+  for (int dim : dims) {
+    num_elements *= dim;
+  }
+  const size_t row_size = dims.back();
+  RET_CHECK(values.size() == num_elements &&
+            scales.size() == num_elements / row_size)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Quantized kv-cache of " << values.size() << " values and "
+      << scales.size() << " scales does not match the kv-cache tensor.";
+  auto lock_and_addr = litert::TensorBufferScopedLock::Create(
+      kv_cache, litert::TensorBuffer::LockMode::kWrite);
+  RET_CHECK(lock_and_addr) << "Failed to lock kv-cache buffer.";
+  auto* data = static_cast<float*>(lock_and_addr->second);
+  for (size_t i = 0; i < num_elements; ++i) {
+    data[i] = static_cast<int8_t>(values[i]) * scales[i / row_size];
+  }
+  return absl::OkStatus();
+}
+
+absl::Status DequantizeLogitsTensor(const litert::TensorBuffer& logits,
+                                    float scale, int32_t zero_point,
+                                    litert::TensorBuffer& output) {
+  auto tensor_type = logits.TensorType();
+  RET_CHECK(tensor_type) << "Failed to get logits tensor type.";
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto output_span,
+                               ReferTensorBufferAsSpan<float>(output));
+  if (tensor_type->ElementType() == litert::ElementType::Int8) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto logits_span,
+                                 ReferTensorBufferAsSpan<int8_t>(logits));
+    RET_CHECK_EQ(logits_span.size(), output_span.size())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The dequantized logits do not match the logits.";
+    DequantizeLogits(logits_span, scale, zero_point, output_span);
+  } else if (tensor_type->ElementType() == litert::ElementType::Int16) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto logits_span,
+                                 ReferTensorBufferAsSpan<int16_t>(logits));
+    RET_CHECK_EQ(logits_span.size(), output_span.size())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The dequantized logits do not match the logits.";
+    DequantizeLogits(logits_span, scale, zero_point, output_span);
+  } else {
+    return absl::InvalidArgumentError(
+        "Only int8 and int16 logits can be dequantized.");
+  }
+  return absl::OkStatus();
+}
+
+absl::Status GatherTopKLogits(litert::TensorBuffer& logits, int batch_size,
+                              int k, litert::TensorBuffer& output_topk_logits,
+                              litert::TensorBuffer& output_topk_ids) {
+  auto tensor_type = logits.TensorType();
+  RET_CHECK(tensor_type) << "Failed to get logits tensor type.";
+  RET_CHECK(tensor_type->ElementType() == litert::ElementType::Float32)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Only float32 logits are supported for top-k.";
+  auto buffer_size = logits.PackedSize();
+  RET_CHECK(buffer_size) << "Failed to get logits buffer size.";
+  const size_t num_logits = *buffer_size / sizeof(float);
+  RET_CHECK(batch_size > 0 && num_logits % batch_size == 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << num_logits << " logits are not " << batch_size << " rows.";
+  const int vocab_size = num_logits / batch_size;
+  RET_CHECK(k > 0 && k <= vocab_size)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Top-k must be in [1, " << vocab_size << "], got " << k;
+  auto lock_and_addr = litert::TensorBufferScopedLock::Create(
+      logits, litert::TensorBuffer::LockMode::kRead);
+  RET_CHECK(lock_and_addr) << "Failed to lock logits buffer.";
+  absl::Span<const float> logits_span(
+      static_cast<const float*>(lock_and_addr->second), num_logits);
+  ASSIGN_OR_RETURN(std::vector<int> topk_indices,
+                   TopKIndicies(logits_span, k, batch_size));
+  LITERT_ASSIGN_OR_RETURN_ABSL(
+      auto topk_logits_span,
+      ReferTensorBufferAsSpan<float>(output_topk_logits));
+  LITERT_ASSIGN_OR_RETURN_ABSL(
+      auto topk_ids_span, ReferTensorBufferAsSpan<int32_t>(output_topk_ids));
+  RET_CHECK(topk_logits_span.size() == topk_indices.size() &&
+            topk_ids_span.size() == topk_indices.size())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Top-k outputs must be (batch, k).";
+  for (int b = 0; b < batch_size; ++b) {
+    for (int i = b * k; i < (b + 1) * k; ++i) {
+      topk_ids_span[i] = topk_indices[i];
+      topk_logits_span[i] = logits_span[b * vocab_size + topk_indices[i]];
     }
   }
   return absl::OkStatus();
 }
 
 absl::StatusOr<std::unique_ptr<ModelResources>>
-BuildLiteRtCompiledModelResources(const ModelAssets& model_assets) {
+BuildLiteRtCompiledModelResources(
+    const ModelAssets& model_assets,
+    const WeightMemoryOptions& weight_memory_options) {
   ASSIGN_OR_RETURN(  // NOLINT
       auto format,
       GetFileFormat(model_assets.GetPath().value_or(""),
                     model_assets.GetScopedFile().value_or(nullptr)));
 
-  ASSIGN_OR_RETURN(auto scoped_file,  // NOLINT
-                   model_assets.GetOrCreateScopedFile());
+  std::shared_ptr<ScopedFile> scoped_file;
+  {
+    InitPhaseScope phase("File open");
+    ASSIGN_OR_RETURN(scoped_file,  // NOLINT
+                     model_assets.GetOrCreateScopedFile());
+  }
 
   switch (format) {
     case FileFormat::TFLITE:
       return absl::InvalidArgumentError("Unsupported file format.");
     case FileFormat::TASK:
+      if (model_assets.fake_weights_mode() !=
+          FakeWeightsMode::FAKE_WEIGHTS_NONE) {
+        return absl::UnimplementedError(
+            "Fake weights are only supported for .litertlm models.");
+      }
       return BuildModelResourcesFromTaskFormat(std::move(scoped_file));
     case FileFormat::LITERT_LM:
-      return BuildModelResourcesFromLitertLmFormat(std::move(*scoped_file));
+      return BuildModelResourcesFromLitertLmFormat(
+          std::move(*scoped_file), weight_memory_options,
+          model_assets.section_arrival_timeout(),
+          model_assets.fake_weights_mode());
   }
 }
 
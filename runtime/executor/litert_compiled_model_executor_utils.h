@@ -15,6 +15,7 @@
 #ifndef THIRD_PARTY_ODML_INFRA_GENAI_INFERENCE_EXECUTOR_LITERT_COMPILED_MODEL_EXECUTOR_UTILS_H_
 #define THIRD_PARTY_ODML_INFRA_GENAI_INFERENCE_EXECUTOR_LITERT_COMPILED_MODEL_EXECUTOR_UTILS_H_
 
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -26,6 +27,7 @@
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_model.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/components/model_resources.h"
@@ -37,6 +39,10 @@ namespace litert::lm {
 using SortedPrefillSignatureMap =
     absl::btree_map<int, std::string, std::greater<int>>;
 
+// Decode signatures attending over a prefix of the kv-cache, keyed by the
+// kv-cache length, in ascending order.
+using SortedDecodeSignatureMap = absl::btree_map<int, std::string>;
+
 // The data type of the attention mask.
 // BOOLEAN: The attention mask is a boolean tensor.
 // FLOAT: The attention mask is a float tensor.
@@ -49,7 +55,8 @@ enum class AttentionMaskDataType { BOOLEAN, FLOAT };
 struct ModelSignatures {
   // Input token signature name. For both prefill and decode.
   std::string input_tokens;
-  // Input position signature name. For both prefill and decode.
+  // Input position signature name. For both prefill and decode. Empty if the
+  // model derives the positions from input_step_params.
   std::string input_positions;
   // Input attention mask signature name. For both prefill and decode.
   // Not all models require this input.
@@ -64,6 +71,11 @@ struct ModelSignatures {
   // When this is provided, the per layer embedding model will be used to look
   // up the per layer embeddings.
   std::optional<std::string> input_per_layer_embeddings;
+  // Input step parameters signature name. For both prefill and decode. When
+  // this is provided, the model derives the positions and the attention mask
+  // on device from the start step and the number of steps of each run, see
+  // FillStepParams(), and has neither a positions nor a mask input.
+  std::optional<std::string> input_step_params;
   // Output logits signature name. Necessary for decode.
   std::string output_logits;
 };
@@ -81,11 +93,37 @@ absl::StatusOr<ModelSignatures> GetModelSignaturesFromInputOutputNames(
 // The signature runners are sorted by the input tokens dimension.
 // signature_name_base is the prefix of the prefill signature names, e.g.
 // "prefill".
-// input_tokens_name is the name of the input tokens signature, e.g. "token_ids"
-// for Gemma2 JAX and "tokens" for Gemma2 PyTorch.
+// input_length_name is the name of an input whose sequence dimension is the
+// prefill length, e.g. the positions, or the tokens for a model taking step
+// parameters.
 absl::StatusOr<SortedPrefillSignatureMap> GetPrefillRunnerSetFromModel(
     const ::litert::Model& model, const std::string& signature_name_base,
-    const std::string& input_positions_name);
+    const std::string& input_length_name);
+
+// Gets the decode signatures attending over a prefix of the kv-cache of the
+// `full_signature_name` one, i.e. the signatures named `signature_name_base`
+// followed by anything, e.g. "decode_kv512", keyed by their kv-cache length.
+// kv_cache_input_name is the name of a kv-cache input of all the signatures.
+// Returns a FailedPrecondition error if the kv-cache of such a signature is
+// not a prefix of the full one, see GetPrefixKvCacheLength().
+absl::StatusOr<SortedDecodeSignatureMap> GetKvBucketedDecodeSignaturesFromModel(
+    const ::litert::Model& model, const std::string& signature_name_base,
+    const std::string& full_signature_name,
+    const std::string& kv_cache_input_name);
+
+// Returns the kv-cache length of a kv-cache tensor of dimensions `dims`, if it
+// is a prefix of the memory of one of dimensions `full_dims`, such that both
+// can be bound to the same buffer: the dimensions must only differ in a
+// shorter kv-cache dimension, after dimensions of size 1 only. Returns a
+// FailedPrecondition error otherwise.
+absl::StatusOr<int> GetPrefixKvCacheLength(absl::Span<const int32_t> full_dims,
+                                           absl::Span<const int32_t> dims);
+
+// Returns the signature of `decode_signature_map` of the shortest kv-cache
+// covering the decode at `step`, i.e. longer than `step`, or an empty string
+// if none does and the full decode signature must be run.
+absl::string_view GetDecodeSignatureForStep(
+    const SortedDecodeSignatureMap& decode_signature_map, int step);
 
 // Get a list of prefill work groups, each of which contains the signature
 // runner and prefill length for a single prefill call.
@@ -97,8 +135,41 @@ absl::StatusOr<std::vector<std::pair<std::string, int>>>
 GetOptimizedPrefillWorkGroups(
     const SortedPrefillSignatureMap& prefill_runner_set, int input_length);
 
+// The measured latency in microseconds of one run of each prefill signature,
+// keyed by the sequence length of the signature.
+using PrefillSignatureCosts = absl::btree_map<int, double>;
+
+// Same as above, but picks the work groups with the minimum total latency
+// according to `costs`, which may pad a larger signature where that is cheaper
+// than splitting the input. Falls back to the length based strategy if a
+// signature has no cost.
+absl::StatusOr<std::vector<std::pair<std::string, int>>>
+GetOptimizedPrefillWorkGroups(
+    const SortedPrefillSignatureMap& prefill_runner_set, int input_length,
+    const PrefillSignatureCosts& costs);
+
+// Returns the sequence length of the signature of the lowest latency per
+// token in `costs`, i.e. the prefill chunk size of the highest throughput, the
+// longest one on ties. Returns an InvalidArgument error if `costs` is empty.
+absl::StatusOr<int> GetHighestThroughputPrefillLength(
+    const PrefillSignatureCosts& costs);
+
+// Serializes the prefill signature costs into lines of
+// "<sequence length> <latency in microseconds>", after a line of
+// "device <device fingerprint>" if `device_fingerprint` is not empty.
+std::string SerializePrefillSignatureCosts(
+    const PrefillSignatureCosts& costs,
+    absl::string_view device_fingerprint = "");
+
+// Parses the prefill signature costs serialized by
+// SerializePrefillSignatureCosts(). If `device_fingerprint` is not empty,
+// returns a FailedPrecondition error unless they were measured on that device.
+absl::StatusOr<PrefillSignatureCosts> ParsePrefillSignatureCosts(
+    absl::string_view serialized_costs,
+    absl::string_view device_fingerprint = "");
+
 // Initializes the attention mask tensor for prefill/decode.
-// The mask is a 4D tensor with shape [batch=1, seq_len, 1, max_kv_len].
+// The mask is a 4D tensor with shape [batch, seq_len, 1, max_kv_len].
 // The default value for mask is different for different mask data types, and
 // different calculation precisions.
 absl::Status InitializeAttentionMask(::litert::TensorBuffer& mask,
@@ -106,7 +177,8 @@ absl::Status InitializeAttentionMask(::litert::TensorBuffer& mask,
                                      bool is_f16);
 
 // Fill attention mask for a given range of timesteps.
-// The mask is a 4D tensor with shape [batch=1, seq_len, 1, max_kv_len].
+// The mask is a 4D tensor with shape [batch, seq_len, 1, max_kv_len]. Every
+// batch row is filled with the same range.
 // mask - The attention mask tensor to be filled.
 // start_timestep - The starting timestep to be filled at seq = 1.
 // steps - The number of steps to fill (the number of sequences to be filled).
@@ -114,10 +186,90 @@ absl::Status InitializeAttentionMask(::litert::TensorBuffer& mask,
 absl::Status FillAttentionMask(::litert::TensorBuffer& mask, int start_timestep,
                                int steps, AttentionMaskDataType mask_data_type);
 
+// Fills the step parameters tensor of a model deriving the positions and the
+// attention mask on device. The tensor is int32 of shape [2] or
+// [batch_size, 2], and every row is set to {start_timestep, steps}, such that
+// a run uploads two values per row instead of the positions and the mask.
+absl::Status FillStepParams(::litert::TensorBuffer& step_params,
+                            int start_timestep, int steps);
+
+// Updates an attention mask last filled for `previous_steps` steps from
+// `previous_start_timestep` to the mask of `steps` steps from `start_timestep`,
+// as if it was initialized by InitializeAttentionMask() and filled by
+// FillAttentionMask() again. Only the entries that differ between the two
+// masks are written, i.e. the columns of the new steps in each row. A mask
+// fresh from InitializeAttentionMask() has `previous_steps` = 0.
+// The mask buffer must keep its contents between the calls.
+absl::Status UpdateAttentionMask(::litert::TensorBuffer& mask,
+                                 int previous_start_timestep,
+                                 int previous_steps, int start_timestep,
+                                 int steps,
+                                 AttentionMaskDataType mask_data_type,
+                                 bool is_f16);
+
+// Drops the entries at positions [num_sink_tokens, num_sink_tokens +
+// num_discarded_tokens) of a kv-cache tensor holding `num_tokens` positions,
+// and moves the entries after them down to the freed positions. The sequence
+// dimension is the only dimension of size `kv_cache_length` after the batch
+// dimension; it is an error if there is none or more than one.
+absl::Status ShiftKvCache(::litert::TensorBuffer& kv_cache, int kv_cache_length,
+                          int num_sink_tokens, int num_discarded_tokens,
+                          int num_tokens);
+
+// Drops the entries at the positions of `discarded_ranges`, [first, second)
+// pairs in increasing order that do not overlap, of a kv-cache tensor holding
+// `num_tokens` positions, and moves the entries kept after them down to the
+// freed positions in a single pass. The sequence dimension is found as in
+// ShiftKvCache().
+absl::Status CompactKvCache(
+    ::litert::TensorBuffer& kv_cache, int kv_cache_length,
+    absl::Span<const std::pair<int, int>> discarded_ranges, int num_tokens);
+
+// Reorders the batch rows of a kv-cache tensor, such that row `b` holds the
+// previous contents of row `source_rows[b]`. A row may be the source of several
+// rows. The batch dimension is the first one, and its size must match the size
+// of `source_rows`. Only the source rows read once overwritten are saved, into
+// `scratch`, which the caller keeps across the calls such that they do not
+// allocate.
+absl::Status ReorderKvCacheBatch(::litert::TensorBuffer& kv_cache,
+                                 absl::Span<const int> source_rows,
+                                 std::vector<uint8_t>& scratch);
+
+// Quantizes a float32 kv-cache tensor to int8 with one symmetric scale per row
+// of the innermost dimension. `values` receives one int8 value per element and
+// `scales` one scale per row.
+absl::Status QuantizeKvCacheToInt8(::litert::TensorBuffer& kv_cache,
+                                   std::vector<uint8_t>& values,
+                                   std::vector<float>& scales);
+
+// Writes a kv-cache tensor quantized by QuantizeKvCacheToInt8() back into the
+// float32 `kv_cache` tensor.
+absl::Status DequantizeKvCacheFromInt8(absl::Span<const uint8_t> values,
+                                       absl::Span<const float> scales,
+                                       ::litert::TensorBuffer& kv_cache);
+
+// Dequantizes the int8 or int16 `logits` of the per-tensor `scale` and
+// `zero_point` into the float32 `output` tensor of as many elements.
+absl::Status DequantizeLogitsTensor(const ::litert::TensorBuffer& logits,
+                                    float scale, int32_t zero_point,
+                                    ::litert::TensorBuffer& output);
+
+// Writes the `k` largest float32 `logits` of each of the `batch_size` rows of
+// the logits tensor, e.g. of shape (batch, 1, vocab), into
+// `output_topk_logits`, and their ids into `output_topk_ids`, both of shape
+// (batch, k). The quantized logits are to be dequantized first, e.g. by
+// DequantizeLogitsTensor().
+absl::Status GatherTopKLogits(::litert::TensorBuffer& logits, int batch_size,
+                              int k, ::litert::TensorBuffer& output_topk_logits,
+                              ::litert::TensorBuffer& output_topk_ids);
+
 // Builds the model resources from the model_path for compiled model only.
-// Supports .task and .litertlm formats.
+// Supports .task and .litertlm formats. The models of a .litertlm file are
+// held in memory as `weight_memory_options` say.
 absl::StatusOr<std::unique_ptr<ModelResources>>
-BuildLiteRtCompiledModelResources(const ModelAssets& model_assets);
+BuildLiteRtCompiledModelResources(
+    const ModelAssets& model_assets,
+    const WeightMemoryOptions& weight_memory_options = WeightMemoryOptions());
 
 }  // namespace litert::lm
 
@@ -14,14 +14,21 @@
 
 #include "runtime/executor/litert_compiled_model_executor_utils.h"
 
+#include <cstdint>
 #include <filesystem>  // NOLINT: Required for path manipulation.
 #include <memory>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/test/matchers.h"  // from @litert
 #include "runtime/components/model_resources.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/convert_tensor_buffer.h"
 #include "runtime/util/scoped_file.h"
 #include "runtime/util/test_utils.h"  // NOLINT
 
@@ -29,6 +36,12 @@ namespace litert::lm {
 namespace {
 
 using ::testing::_;  // NOLINT: Required by ASSERT_OK_AND_ASSIGN().
+using ::testing::ElementsAre;
+using ::testing::ElementsAreArray;
+using ::testing::FloatNear;
+using ::testing::status::IsOkAndHolds;
+using ::testing::UnorderedElementsAre;
+using ::testing::status::StatusIs;
 
 TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
      BuildModelResourcesTaskBundleFromPath) {
@@ -62,5 +75,471 @@ TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
   ASSERT_OK(model_resources->GetTFLiteModel(ModelType::kTfLitePrefillDecode));
 }
 
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, FillAttentionMaskAllBatchRows) {
+  // [batch=2, seq_len=2, 1, max_kv_len=3]
+  LITERT_ASSERT_OK_AND_ASSIGN(auto mask,
+                              CreateTensorBuffer<float>({2, 2, 1, 3}));
+  ASSERT_OK(InitializeAttentionMask(mask, AttentionMaskDataType::FLOAT,
+                                    /*is_f16=*/true));
+  ASSERT_OK(FillAttentionMask(mask, /*start_timestep=*/0, /*steps=*/2,
+                              AttentionMaskDataType::FLOAT));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto mask_span,
+                              ReferTensorBufferAsSpan<float>(mask));
+  constexpr float kMasked = -45824;
+  EXPECT_THAT(mask_span,
+              ElementsAre(0, kMasked, kMasked, 0, 0, kMasked,  // batch 0
+                          0, kMasked, kMasked, 0, 0, kMasked));  // batch 1
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, FillAttentionMaskTooManySteps) {
+  LITERT_ASSERT_OK_AND_ASSIGN(auto mask,
+                              CreateTensorBuffer<float>({1, 2, 1, 3}));
+  EXPECT_THAT(FillAttentionMask(mask, /*start_timestep=*/0, /*steps=*/3,
+                                AttentionMaskDataType::FLOAT),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     UpdateAttentionMaskMatchesFreshFill) {
+  // [batch=1, seq_len=3, 1, max_kv_len=6]
+  LITERT_ASSERT_OK_AND_ASSIGN(auto mask,
+                              CreateTensorBuffer<float>({1, 3, 1, 6}));
+  ASSERT_OK(InitializeAttentionMask(mask, AttentionMaskDataType::FLOAT,
+                                    /*is_f16=*/true));
+  ASSERT_OK(UpdateAttentionMask(mask, /*previous_start_timestep=*/0,
+                                /*previous_steps=*/0, /*start_timestep=*/0,
+                                /*steps=*/3, AttentionMaskDataType::FLOAT,
+                                /*is_f16=*/true));
+  // A shorter follow-up chunk masks out the rows after its steps again.
+  ASSERT_OK(UpdateAttentionMask(mask, /*previous_start_timestep=*/0,
+                                /*previous_steps=*/3, /*start_timestep=*/3,
+                                /*steps=*/2, AttentionMaskDataType::FLOAT,
+                                /*is_f16=*/true));
+
+  LITERT_ASSERT_OK_AND_ASSIGN(auto expected_mask,
+                              CreateTensorBuffer<float>({1, 3, 1, 6}));
+  ASSERT_OK(InitializeAttentionMask(expected_mask, AttentionMaskDataType::FLOAT,
+                                    /*is_f16=*/true));
+  ASSERT_OK(FillAttentionMask(expected_mask, /*start_timestep=*/3,
+                              /*steps=*/2, AttentionMaskDataType::FLOAT));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto mask_span,
+                              ReferTensorBufferAsSpan<float>(mask));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto expected_mask_span,
+                              ReferTensorBufferAsSpan<float>(expected_mask));
+  EXPECT_THAT(mask_span, ElementsAreArray(expected_mask_span));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, UpdateAttentionMaskBoolean) {
+  // [batch=1, seq_len=1, 1, max_kv_len=4], with one byte per boolean.
+  LITERT_ASSERT_OK_AND_ASSIGN(auto mask,
+                              CreateTensorBuffer<int8_t>({1, 1, 1, 4}));
+  ASSERT_OK(InitializeAttentionMask(mask, AttentionMaskDataType::BOOLEAN,
+                                    /*is_f16=*/false));
+  ASSERT_OK(UpdateAttentionMask(mask, /*previous_start_timestep=*/0,
+                                /*previous_steps=*/0, /*start_timestep=*/1,
+                                /*steps=*/1, AttentionMaskDataType::BOOLEAN,
+                                /*is_f16=*/false));
+  ASSERT_OK(UpdateAttentionMask(mask, /*previous_start_timestep=*/1,
+                                /*previous_steps=*/1, /*start_timestep=*/2,
+                                /*steps=*/1, AttentionMaskDataType::BOOLEAN,
+                                /*is_f16=*/false));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto mask_span,
+                              ReferTensorBufferAsSpan<int8_t>(mask));
+  EXPECT_THAT(mask_span, ElementsAre(1, 1, 1, 0));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, ShiftKvCache) {
+  // [batch=1, kv_cache_length=5, heads=2, dim=1]
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto kv_cache,
+      CopyToTensorBuffer<float>({0, 1, 10, 11, 20, 21, 30, 31, 40, 41},
+                                {1, 5, 2, 1}));
+  ASSERT_OK(ShiftKvCache(kv_cache, /*kv_cache_length=*/5,
+                         /*num_sink_tokens=*/1, /*num_discarded_tokens=*/2,
+                         /*num_tokens=*/4));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto kv_cache_span,
+                              ReferTensorBufferAsSpan<float>(kv_cache));
+  // Position 3 moves to position 1; the positions after it are stale.
+  EXPECT_THAT(kv_cache_span, ElementsAre(0, 1, 30, 31, 20, 21, 30, 31, 40, 41));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     ShiftKvCacheTransposedSequenceDimension) {
+  // [batch=1, heads=2, kv_cache_length=3]
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto kv_cache,
+      CopyToTensorBuffer<float>({0, 1, 2, 10, 11, 12}, {1, 2, 3}));
+  ASSERT_OK(ShiftKvCache(kv_cache, /*kv_cache_length=*/3,
+                         /*num_sink_tokens=*/0, /*num_discarded_tokens=*/1,
+                         /*num_tokens=*/3));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto kv_cache_span,
+                              ReferTensorBufferAsSpan<float>(kv_cache));
+  EXPECT_THAT(kv_cache_span, ElementsAre(1, 2, 2, 11, 12, 12));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, ShiftKvCacheInvalidArguments) {
+  LITERT_ASSERT_OK_AND_ASSIGN(auto kv_cache,
+                              CreateTensorBuffer<float>({1, 4, 4}));
+  // Both the sequence and the head dimension match the kv-cache length.
+  EXPECT_THAT(ShiftKvCache(kv_cache, /*kv_cache_length=*/4,
+                           /*num_sink_tokens=*/0, /*num_discarded_tokens=*/1,
+                           /*num_tokens=*/2),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ShiftKvCache(kv_cache, /*kv_cache_length=*/4,
+                           /*num_sink_tokens=*/2, /*num_discarded_tokens=*/2,
+                           /*num_tokens=*/3),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, CompactKvCache) {
+  // [batch=1, heads=2, kv_cache_length=6]
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto kv_cache,
+      CopyToTensorBuffer<float>({0, 1, 2, 3, 4, 5, 10, 11, 12, 13, 14, 15},
+                                {1, 2, 6}));
+  // Of the 5 tokens, 1 and 3 are dropped, and an empty range is ignored.
+  const std::vector<std::pair<int, int>> discarded_ranges = {
+      {1, 2}, {3, 3}, {3, 4}};
+  ASSERT_OK(CompactKvCache(kv_cache, /*kv_cache_length=*/6, discarded_ranges,
+                           /*num_tokens=*/5));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto kv_cache_span,
+                              ReferTensorBufferAsSpan<float>(kv_cache));
+  EXPECT_THAT(kv_cache_span,
+              ElementsAre(0, 2, 4, 3, 4, 5, 10, 12, 14, 13, 14, 15));
+
+  // Overlapping, unordered and out of range ranges.
+  EXPECT_THAT(CompactKvCache(kv_cache, /*kv_cache_length=*/6,
+                             {{0, 2}, {1, 3}}, /*num_tokens=*/5),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(CompactKvCache(kv_cache, /*kv_cache_length=*/6,
+                             {{2, 3}, {0, 1}}, /*num_tokens=*/5),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(CompactKvCache(kv_cache, /*kv_cache_length=*/6, {{4, 6}},
+                             /*num_tokens=*/5),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, ReorderKvCacheBatch) {
+  // [batch=3, kv_cache_length=2, dim=1]
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto kv_cache,
+      CopyToTensorBuffer<float>({0, 1, 10, 11, 20, 21}, {3, 2, 1}));
+  const int source_rows[] = {2, 0, 0};
+  std::vector<uint8_t> scratch;
+  ASSERT_OK(ReorderKvCacheBatch(kv_cache, source_rows, scratch));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto kv_cache_span,
+                              ReferTensorBufferAsSpan<float>(kv_cache));
+  EXPECT_THAT(kv_cache_span, ElementsAre(20, 21, 0, 1, 0, 1));
+  // Only row 0 is read after it is overwritten.
+  EXPECT_EQ(scratch.size(), 2 * sizeof(float));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, ReorderKvCacheBatchSwapsRows) {
+  // [batch=3, kv_cache_length=2, dim=1]
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto kv_cache,
+      CopyToTensorBuffer<float>({0, 1, 10, 11, 20, 21}, {3, 2, 1}));
+  const int source_rows[] = {1, 0, 2};
+  std::vector<uint8_t> scratch;
+  ASSERT_OK(ReorderKvCacheBatch(kv_cache, source_rows, scratch));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto kv_cache_span,
+                              ReferTensorBufferAsSpan<float>(kv_cache));
+  EXPECT_THAT(kv_cache_span, ElementsAre(10, 11, 0, 1, 20, 21));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     ReorderKvCacheBatchInvalidArguments) {
+  LITERT_ASSERT_OK_AND_ASSIGN(auto kv_cache,
+                              CreateTensorBuffer<float>({2, 4, 4}));
+  std::vector<uint8_t> scratch;
+  const int too_few_rows[] = {0};
+  EXPECT_THAT(ReorderKvCacheBatch(kv_cache, too_few_rows, scratch),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  const int out_of_range_rows[] = {0, 2};
+  EXPECT_THAT(ReorderKvCacheBatch(kv_cache, out_of_range_rows, scratch),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, QuantizeKvCacheToInt8RoundTrip) {
+  // [batch=1, kv_cache_length=2, dim=4], one scale per position.
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto kv_cache,
+      CopyToTensorBuffer<float>({1.27, -0.5, 0, 0.635, 0, 0, 0, 0}, {1, 2, 4}));
+  std::vector<uint8_t> values;
+  std::vector<float> scales;
+  ASSERT_OK(QuantizeKvCacheToInt8(kv_cache, values, scales));
+  EXPECT_EQ(values.size(), 8);
+  ASSERT_EQ(scales.size(), 2);
+  EXPECT_FLOAT_EQ(scales[0], 0.01f);
+  EXPECT_FLOAT_EQ(scales[1], 0.0f);
+  EXPECT_EQ(static_cast<int8_t>(values[0]), 127);
+  EXPECT_EQ(static_cast<int8_t>(values[1]), -50);
+
+  LITERT_ASSERT_OK_AND_ASSIGN(auto restored,
+                              CreateTensorBuffer<float>({1, 2, 4}));
+  ASSERT_OK(DequantizeKvCacheFromInt8(values, scales, restored));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto restored_span,
+                              ReferTensorBufferAsSpan<float>(restored));
+  EXPECT_THAT(restored_span,
+              ElementsAre(FloatNear(1.27, 0.005), FloatNear(-0.5, 0.005), 0,
+                          FloatNear(0.635, 0.005), 0, 0, 0, 0));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     QuantizeKvCacheToInt8InvalidArguments) {
+  LITERT_ASSERT_OK_AND_ASSIGN(auto int_kv_cache,
+                              CreateTensorBuffer<int8_t>({1, 2, 4}));
+  std::vector<uint8_t> values;
+  std::vector<float> scales;
+  EXPECT_THAT(QuantizeKvCacheToInt8(int_kv_cache, values, scales),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  LITERT_ASSERT_OK_AND_ASSIGN(auto kv_cache,
+                              CreateTensorBuffer<float>({1, 2, 4}));
+  values.assign(8, 0);
+  scales.assign(1, 1.0f);
+  EXPECT_THAT(DequantizeKvCacheFromInt8(values, scales, kv_cache),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, GatherTopKLogits) {
+  // [batch=2, 1, vocab=4]
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto logits,
+      CopyToTensorBuffer<float>({0.1, 0.9, 0.3, 0.7, 4, 1, 3, 2}, {2, 1, 4}));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_logits,
+                              CreateTensorBuffer<float>({2, 2}));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_ids,
+                              CreateTensorBuffer<int32_t>({2, 2}));
+  ASSERT_OK(GatherTopKLogits(logits, /*batch_size=*/2, /*k=*/2, topk_logits,
+                             topk_ids));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_ids_span,
+                              ReferTensorBufferAsSpan<int32_t>(topk_ids));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_logits_span,
+                              ReferTensorBufferAsSpan<float>(topk_logits));
+  // In no particular order within a row.
+  EXPECT_THAT(topk_ids_span.subspan(0, 2), UnorderedElementsAre(1, 3));
+  EXPECT_THAT(topk_ids_span.subspan(2, 2), UnorderedElementsAre(0, 2));
+  const float expected_logits[] = {0.1, 0.9, 0.3, 0.7, 4, 1, 3, 2};
+  for (int i = 0; i < 4; ++i) {
+    EXPECT_FLOAT_EQ(topk_logits_span[i],
+                    expected_logits[(i / 2) * 4 + topk_ids_span[i]]);
+  }
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     GatherTopKLogitsOfQuantizedLogits) {
+  // [batch=1, 1, vocab=4], of scale 0.5 and zero point 2.
+  LITERT_ASSERT_OK_AND_ASSIGN(
+      auto int8_logits, CopyToTensorBuffer<int8_t>({-6, 10, 4, 12}, {1, 1, 4}));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto logits,
+                              CreateTensorBuffer<float>({1, 1, 4}));
+  ASSERT_OK(DequantizeLogitsTensor(int8_logits, /*scale=*/0.5f,
+                                   /*zero_point=*/2, logits));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto logits_span,
+                              ReferTensorBufferAsSpan<float>(logits));
+  EXPECT_THAT(logits_span, ElementsAre(-4, 4, 1, 5));
+
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_logits,
+                              CreateTensorBuffer<float>({1, 2}));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_ids,
+                              CreateTensorBuffer<int32_t>({1, 2}));
+  ASSERT_OK(GatherTopKLogits(logits, /*batch_size=*/1, /*k=*/2, topk_logits,
+                             topk_ids));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_ids_span,
+                              ReferTensorBufferAsSpan<int32_t>(topk_ids));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_logits_span,
+                              ReferTensorBufferAsSpan<float>(topk_logits));
+  EXPECT_THAT(topk_ids_span, UnorderedElementsAre(1, 3));
+  EXPECT_THAT(topk_logits_span, UnorderedElementsAre(4, 5));
+
+  // Float logits are not dequantized.
+  EXPECT_THAT(DequantizeLogitsTensor(logits, 0.5f, 2, logits),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     GatherTopKLogitsInvalidArguments) {
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_logits,
+                              CreateTensorBuffer<float>({1, 2}));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto topk_ids,
+                              CreateTensorBuffer<int32_t>({1, 2}));
+  // The quantized logits are to be dequantized first.
+  LITERT_ASSERT_OK_AND_ASSIGN(auto int8_logits,
+                              CreateTensorBuffer<int8_t>({1, 1, 4}));
+  EXPECT_THAT(GatherTopKLogits(int8_logits, /*batch_size=*/1, /*k=*/2,
+                               topk_logits, topk_ids),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+
+  LITERT_ASSERT_OK_AND_ASSIGN(auto logits,
+                              CreateTensorBuffer<float>({1, 1, 4}));
+  EXPECT_THAT(GatherTopKLogits(logits, /*batch_size=*/1, /*k=*/5, topk_logits,
+                               topk_ids),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(GatherTopKLogits(logits, /*batch_size=*/3, /*k=*/1, topk_logits,
+                               topk_ids),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  // The outputs are not (batch, k).
+  EXPECT_THAT(GatherTopKLogits(logits, /*batch_size=*/1, /*k=*/1, topk_logits,
+                               topk_ids),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     GetOptimizedPrefillWorkGroupsWithCosts) {
+  SortedPrefillSignatureMap prefill_runner_set;
+  prefill_runner_set[128] = "prefill_128";
+  prefill_runner_set[512] = "prefill_512";
+
+  // Without costs, the input is split greedily.
+  ASSERT_OK_AND_ASSIGN(auto work_groups,
+                       GetOptimizedPrefillWorkGroups(prefill_runner_set, 300));
+  EXPECT_THAT(work_groups, ElementsAre(std::make_pair("prefill_128", 128),
+                                       std::make_pair("prefill_128", 128),
+                                       std::make_pair("prefill_128", 44)));
+
+  // Padding the larger signature is cheaper than three runs of the smaller
+  // one.
+  PrefillSignatureCosts costs = {{128, 10.0}, {512, 20.0}};
+  ASSERT_OK_AND_ASSIGN(
+      work_groups, GetOptimizedPrefillWorkGroups(prefill_runner_set, 300, costs));
+  EXPECT_THAT(work_groups, ElementsAre(std::make_pair("prefill_512", 300)));
+
+  // Splitting is cheaper if the larger signature is slow.
+  costs = {{128, 10.0}, {512, 35.0}};
+  ASSERT_OK_AND_ASSIGN(
+      work_groups, GetOptimizedPrefillWorkGroups(prefill_runner_set, 600, costs));
+  EXPECT_THAT(work_groups, ElementsAre(std::make_pair("prefill_512", 512),
+                                       std::make_pair("prefill_128", 88)));
+
+  // Falls back to the greedy split if a signature has no cost.
+  costs = {{512, 20.0}};
+  ASSERT_OK_AND_ASSIGN(
+      work_groups, GetOptimizedPrefillWorkGroups(prefill_runner_set, 300, costs));
+  EXPECT_EQ(work_groups.size(), 3);
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, GetPrefixKvCacheLength) {
+  EXPECT_THAT(GetPrefixKvCacheLength({1, 4096, 8, 64}, {1, 512, 8, 64}),
+              IsOkAndHolds(512));
+  EXPECT_THAT(GetPrefixKvCacheLength({4096, 8, 64}, {1024, 8, 64}),
+              IsOkAndHolds(1024));
+  // The kv-cache dimension after another one is not a prefix in memory.
+  EXPECT_THAT(GetPrefixKvCacheLength({1, 8, 4096, 64}, {1, 8, 512, 64}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(GetPrefixKvCacheLength({1, 512, 8, 64}, {1, 512, 4, 64}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(GetPrefixKvCacheLength({1, 512, 8, 64}, {1, 1024, 8, 64}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(GetPrefixKvCacheLength({1, 512, 8, 64}, {1, 512, 8, 64}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(GetPrefixKvCacheLength({1, 512, 8, 64}, {1, 512, 8}),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, GetDecodeSignatureForStep) {
+  SortedDecodeSignatureMap decode_signature_map;
+  EXPECT_EQ(GetDecodeSignatureForStep(decode_signature_map, 0), "");
+  decode_signature_map[512] = "decode_kv512";
+  decode_signature_map[1024] = "decode_kv1024";
+  EXPECT_EQ(GetDecodeSignatureForStep(decode_signature_map, 0),
+            "decode_kv512");
+  EXPECT_EQ(GetDecodeSignatureForStep(decode_signature_map, 511),
+            "decode_kv512");
+  // The step at 512 writes the kv-cache entry past the first signature.
+  EXPECT_EQ(GetDecodeSignatureForStep(decode_signature_map, 512),
+            "decode_kv1024");
+  EXPECT_EQ(GetDecodeSignatureForStep(decode_signature_map, 1024), "");
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, PrefillSignatureCostsRoundTrip) {
+  PrefillSignatureCosts costs = {{128, 1500.5}, {1024, 9000.0}};
+  ASSERT_OK_AND_ASSIGN(
+      auto parsed_costs,
+      ParsePrefillSignatureCosts(SerializePrefillSignatureCosts(costs)));
+  EXPECT_EQ(parsed_costs, costs);
+
+  EXPECT_THAT(ParsePrefillSignatureCosts("128\n"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParsePrefillSignatureCosts("abc 1.0\n"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     PrefillSignatureCostsAreKeyedByDevice) {
+  PrefillSignatureCosts costs = {{128, 1500.5}, {1024, 9000.0}};
+  const std::string serialized_costs =
+      SerializePrefillSignatureCosts(costs, "phone|cores=8");
+  ASSERT_OK_AND_ASSIGN(
+      auto parsed_costs,
+      ParsePrefillSignatureCosts(serialized_costs, "phone|cores=8"));
+  EXPECT_EQ(parsed_costs, costs);
+  // Any device is accepted if none is given.
+  ASSERT_OK_AND_ASSIGN(parsed_costs,
+                       ParsePrefillSignatureCosts(serialized_costs));
+  EXPECT_EQ(parsed_costs, costs);
+  EXPECT_THAT(ParsePrefillSignatureCosts(serialized_costs, "laptop|cores=4"),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  EXPECT_THAT(ParsePrefillSignatureCosts(SerializePrefillSignatureCosts(costs),
+                                         "phone|cores=8"),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     GetModelSignaturesWithStepParams) {
+  ASSERT_OK_AND_ASSIGN(
+      ModelSignatures signatures,
+      GetModelSignaturesFromInputOutputNames(
+          {"tokens", "step_params", "kv_cache_k_0", "kv_cache_v_0"},
+          {"logits", "kv_cache_k_0", "kv_cache_v_0"}));
+  EXPECT_EQ(signatures.input_tokens, "tokens");
+  EXPECT_EQ(signatures.input_step_params, "step_params");
+  EXPECT_TRUE(signatures.input_positions.empty());
+  EXPECT_FALSE(signatures.input_attn_mask.has_value());
+  EXPECT_EQ(signatures.output_logits, "logits");
+
+  // The other models have no step parameters.
+  ASSERT_OK_AND_ASSIGN(signatures, GetModelSignaturesFromInputOutputNames(
+                                       {"tokens", "input_pos", "mask"},
+                                       {"logits"}));
+  EXPECT_EQ(signatures.input_positions, "input_pos");
+  EXPECT_FALSE(signatures.input_step_params.has_value());
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest, FillStepParams) {
+  // [batch=2, 2]
+  LITERT_ASSERT_OK_AND_ASSIGN(auto step_params,
+                              CreateTensorBuffer<int32_t>({2, 2}));
+  ASSERT_OK(FillStepParams(step_params, /*start_timestep=*/5, /*steps=*/3));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto step_params_span,
+                              ReferTensorBufferAsSpan<int32_t>(step_params));
+  EXPECT_THAT(step_params_span, ElementsAre(5, 3, 5, 3));
+
+  LITERT_ASSERT_OK_AND_ASSIGN(auto odd_step_params,
+                              CreateTensorBuffer<int32_t>({3}));
+  EXPECT_THAT(FillStepParams(odd_step_params, /*start_timestep=*/0,
+                             /*steps=*/1),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LlmLiteRTCompiledModelExecutorUtilsTest,
+     GetHighestThroughputPrefillLength) {
+  // 128 tokens take 0.1 us each, 512 tokens 0.05 us each.
+  ASSERT_OK_AND_ASSIGN(
+      int chunk_size,
+      GetHighestThroughputPrefillLength({{128, 12.8}, {512, 25.6}}));
+  EXPECT_EQ(chunk_size, 512);
+  // A large signature slower per token, e.g. spilling out of the caches.
+  ASSERT_OK_AND_ASSIGN(
+      chunk_size, GetHighestThroughputPrefillLength({{128, 12.8}, {512, 64.0}}));
+  EXPECT_EQ(chunk_size, 128);
+  // The longest on ties.
+  ASSERT_OK_AND_ASSIGN(
+      chunk_size, GetHighestThroughputPrefillLength({{128, 12.8}, {256, 25.6}}));
+  EXPECT_EQ(chunk_size, 256);
+  EXPECT_THAT(GetHighestThroughputPrefillLength({}),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 }  // namespace
 }  // namespace litert::lm
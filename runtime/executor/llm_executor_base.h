@@ -15,13 +15,22 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_LLM_EXECUTOR_BASE_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_LLM_EXECUTOR_BASE_H_
 
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/kv_cache_layout.h"
 #include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/memory_usage.h"
 
 namespace litert::lm {
 
@@ -76,6 +85,19 @@ class LlmExecutorBase {
                      ExecutorBackendName()));
   };
 
+  // Same as DecodeLogits(), but only outputs the k largest logits of each
+  // batch and their token ids, in any order, which is all a top-k sampler
+  // needs. Both outputs have the shape `[batch, k]` on the host memory, float32
+  // for `output_topk_logits` and int32 for `output_topk_ids`, where k is taken
+  // from the shape.
+  virtual absl::Status DecodeTopKLogits(
+      const ExecutorInputs& inputs, ::litert::TensorBuffer& output_topk_logits,
+      ::litert::TensorBuffer& output_topk_ids) {
+    return absl::UnimplementedError(absl::StrCat(
+        "Decode for top-k logits output not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
   virtual absl::string_view ExecutorBackendName() const = 0;
 
   // Get vocabulary size used to build tensor buffers for decode functions.
@@ -90,6 +112,14 @@ class LlmExecutorBase {
         "GetCurrentStep not implemented for backend: ", ExecutorBackendName()));
   };
 
+  // Gets the number of tokens of the longest prefill signature, i.e. the
+  // largest number of tokens prefilled with one run of the model.
+  virtual absl::StatusOr<int> GetMaxPrefillLength() const {
+    return absl::UnimplementedError(
+        absl::StrCat("GetMaxPrefillLength not implemented for backend: ",
+                     ExecutorBackendName()));
+  };
+
   // Gets the current step of the executor.
   virtual absl::StatusOr<LlmExecutorSettings> GetExecutorSettings() const {
     return absl::UnimplementedError(
@@ -112,6 +142,308 @@ class LlmExecutorBase {
                      ExecutorBackendName()));
   };
 
+  // Fills the embeddings of consecutive images, e.g. the vision data returned
+  // by VisionExecutor::EncodeBatch(), `vision_inputs[i]` being the image at
+  // `first_image_index + i`. The default fills the images one at a time.
+  virtual absl::Status FillVisionEmbeddingsBatch(
+      absl::Span<const ExecutorVisionData> vision_inputs,
+      int first_image_index) {
+    for (int i = 0; i < vision_inputs.size(); ++i) {
+      absl::Status status =
+          FillVisionEmbeddings(vision_inputs[i], first_image_index + i);
+      if (!status.ok()) {
+        return status;
+      }
+    }
+    return absl::OkStatus();
+  };
+
+  // ------------State APIs------------:
+  // Takes a snapshot of the internal states (e.g. KVCache and the current
+  // step), so that the same prefix can be restored later with RestoreState()
+  // without being prefilled again.
+  virtual absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() {
+    return absl::UnimplementedError(absl::StrCat(
+        "SaveState not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // Restores the internal states from a checkpoint previously returned by
+  // SaveState() of an executor running the same model. The checkpoint is not
+  // consumed and can be restored multiple times.
+  virtual absl::Status RestoreState(const ExecutorCheckpoint& checkpoint) {
+    return absl::UnimplementedError(absl::StrCat(
+        "RestoreState not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // Returns the layout of each kv-cache tensor of the checkpoints returned by
+  // SaveState(), such that the checkpoint of an executor running the same
+  // model on another backend can be converted to this one with
+  // ConvertKvCacheTensor().
+  virtual absl::StatusOr<KvCacheLayouts> GetKvCacheLayouts() const {
+    return absl::UnimplementedError(
+        absl::StrCat("GetKvCacheLayouts not implemented for backend: ",
+                     ExecutorBackendName()));
+  };
+
+  // Parks the internal states of an idle session, so that the executor can
+  // serve other sessions while this one is resumed later with RestoreState().
+  // The states are saved with SaveState() and, if `offload_path` is not empty,
+  // the kv-cache contents are offloaded from host memory to a memory mapped
+  // file at that path, which is paged back in on RestoreState().
+  virtual absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> ParkState(
+      absl::string_view offload_path) {
+    auto checkpoint = SaveState();
+    if (!checkpoint.ok() || offload_path.empty()) {
+      return checkpoint;
+    }
+    absl::Status status = (*checkpoint)->OffloadToFile(offload_path);
+    if (!status.ok()) {
+      return status;
+    }
+    return checkpoint;
+  };
+
+  // ------------Context APIs------------:
+  // Creates an empty kv-cache context resident on the device next to the
+  // active one, and returns its id. The sessions sharing the executor then
+  // alternate with SwitchContext(), whose kv-caches stay in place instead of
+  // being saved and prefilled again. The active context is the one with id 0
+  // until switched.
+  virtual absl::StatusOr<int> CreateContext() {
+    return absl::UnimplementedError(absl::StrCat(
+        "CreateContext not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // Makes the context `context_id` the one the next calls prefill and decode,
+  // keeping the kv-cache and the step of the active one as they are.
+  virtual absl::Status SwitchContext(int context_id) {
+    return absl::UnimplementedError(absl::StrCat(
+        "SwitchContext not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // Deletes the context `context_id`, which must not be the active one, and
+  // frees its kv-cache.
+  virtual absl::Status DeleteContext(int context_id) {
+    return absl::UnimplementedError(absl::StrCat(
+        "DeleteContext not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // ------------Speculative decoding APIs------------:
+  // Verifies the tokens proposed by a draft model in a single invocation of the
+  // model. The pending input token followed by `draft_token_ids` are fed into
+  // the model, and the draft tokens are accepted as long as they match the
+  // greedy output of the model. Returns the accepted draft tokens followed by
+  // one token decoded by the model after them. Only the accepted tokens
+  // remain in the kv-cache, and the last returned token becomes the pending
+  // input token.
+  virtual absl::StatusOr<std::vector<int>> VerifyDraftTokens(
+      absl::Span<const int> draft_token_ids) {
+    return absl::UnimplementedError(
+        absl::StrCat("VerifyDraftTokens not implemented for backend: ",
+                     ExecutorBackendName()));
+  };
+
+  // Rolls the executor back to the state where `num_processed_tokens` tokens
+  // are in the kv-cache and `next_input_token_id` is the pending input token
+  // of the next Prefill or Decode call. The kv-cache entries after
+  // `num_processed_tokens` are dropped. `num_processed_tokens` must not exceed
+  // the number of tokens currently in the kv-cache.
+  virtual absl::Status Rollback(int num_processed_tokens,
+                                int next_input_token_id) {
+    return absl::UnimplementedError(absl::StrCat(
+        "Rollback not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // Gets the pending input token of the next Prefill or Decode call, or -1 if
+  // there is none, e.g. before the first Prefill. Together with
+  // GetCurrentStep(), it is the state a later Rollback() returns to, with
+  // GetCurrentStep() - 1 tokens in the kv-cache.
+  virtual absl::StatusOr<int> GetNextInputTokenId() const {
+    return absl::UnimplementedError(
+        absl::StrCat("GetNextInputTokenId not implemented for backend: ",
+                     ExecutorBackendName()));
+  };
+
+  // ------------Pipeline APIs------------:
+  // Runs the positions from the current step through the layers of one stage
+  // of a model split by layers, see PipelineLlmExecutor, and appends them to
+  // the kv-cache of the stage. Unlike Prefill(), no position is held back as
+  // the pending input token. The first stage takes the `token_ids` and returns
+  // the activations of the positions, of shape `[1, num_positions,
+  // hidden_size]` of float32_t, in a buffer the next stage may read in place.
+  // The next stage takes them as `input_activations`, the ids only giving the
+  // number of positions, and returns the logits of the last position, of shape
+  // `[1, 1, vocab_size]` of float32_t on the host memory.
+  virtual absl::StatusOr<::litert::TensorBuffer> RunPipelineStage(
+      absl::Span<const int> token_ids,
+      const ::litert::TensorBuffer* input_activations) {
+    return absl::UnimplementedError(
+        absl::StrCat("RunPipelineStage not implemented for backend: ",
+                     ExecutorBackendName()));
+  };
+
+  // ------------Scoring APIs------------:
+  // Returns the log-probability of each of `token_ids` given the context, the
+  // pending input token and the tokens before it. The executor is left as
+  // before the call, so several continuations of the same context can each be
+  // scored from its kv-cache.
+  virtual absl::StatusOr<std::vector<float>> ScoreTokens(
+      absl::Span<const int> token_ids) {
+    return absl::UnimplementedError(absl::StrCat(
+        "ScoreTokens not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // ------------Embedding APIs------------:
+  // Returns one embedding per row of `token_ids`, pooled by `pooling` from the
+  // final hidden states of its tokens. The rows are independent of each other
+  // and of the context, which is left as before the call.
+  virtual absl::StatusOr<std::vector<std::vector<float>>> EmbedTokens(
+      absl::Span<const std::vector<int>> token_ids, EmbeddingPooling pooling) {
+    return absl::UnimplementedError(absl::StrCat(
+        "EmbedTokens not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // ------------Beam search APIs------------:
+  // Reorders the batch rows of the internal states, such that row `b`
+  // continues from the kv-cache and the pending input token previously held
+  // by row `source_rows[b]`. A row may be the source of several rows, e.g.
+  // when a beam is extended by more than one token. The size of `source_rows`
+  // must match the batch size.
+  virtual absl::Status ReorderBatchRows(absl::Span<const int> source_rows) {
+    return absl::UnimplementedError(
+        absl::StrCat("ReorderBatchRows not implemented for backend: ",
+                     ExecutorBackendName()));
+  };
+
+  // ------------Context shifting APIs------------:
+  // Drops the `num_discarded_tokens` tokens that follow the first
+  // `num_sink_tokens` tokens from the kv-cache, and moves the later tokens
+  // down to the freed positions, such that the current step goes back by
+  // `num_discarded_tokens`. The moved tokens keep the positional encoding of
+  // their original positions. The pending input token, if any, is kept.
+  virtual absl::Status ShiftContext(int num_sink_tokens,
+                                    int num_discarded_tokens) {
+    return absl::UnimplementedError(absl::StrCat(
+        "ShiftContext not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // Drops the tokens at the steps of `discarded_ranges`, [first, second) pairs
+  // in increasing order that do not overlap, from the kv-cache, and moves the
+  // later tokens down to the freed positions, such that the current step goes
+  // back by the number of dropped tokens, e.g. to drop old tool outputs from
+  // a long session without prefilling the rest again. As with ShiftContext(),
+  // the moved tokens keep the positional encoding of their original positions
+  // and the pending input token, if any, is kept.
+  virtual absl::Status CompactContext(
+      absl::Span<const std::pair<int, int>> discarded_ranges) {
+    return absl::UnimplementedError(absl::StrCat(
+        "CompactContext not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // ------------LoRA APIs------------:
+  // Loads a LoRA adapter, a serialized schema::LoraAdapter, whose tensors are
+  // bound to the LoRA inputs of the model when the adapter is selected. The
+  // adapter is registered under its name, which must not be loaded yet.
+  virtual absl::Status LoadLoraAdapter(absl::string_view serialized_adapter) {
+    return absl::UnimplementedError(absl::StrCat(
+        "LoadLoraAdapter not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // Unloads the LoRA adapter of `name`. If it is selected, the base model is
+  // selected instead.
+  virtual absl::Status UnloadLoraAdapter(absl::string_view name) {
+    return absl::UnimplementedError(absl::StrCat(
+        "UnloadLoraAdapter not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // Selects the LoRA adapter of `name` for the following Prefill and Decode
+  // calls, or the base model if `name` is empty. Sessions sharing the executor
+  // select their adapter before each call, which only rebinds input buffers.
+  virtual absl::Status SelectLoraAdapter(absl::string_view name) {
+    return absl::UnimplementedError(absl::StrCat(
+        "SelectLoraAdapter not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // Selects one LoRA adapter per batch row, `names[b]` for row b or the base
+  // model if empty, such that the sequences of several adapters share a
+  // batched Decode, e.g. the slots of a DecodeScheduler. The rows all
+  // selecting the same adapter are the same as SelectLoraAdapter().
+  virtual absl::Status SelectLoraAdapters(
+      absl::Span<const std::string> names) {
+    if (!names.empty() &&
+        std::all_of(names.begin(), names.end(),
+                    [&names](const std::string& name) {
+                      return name == names.front();
+                    })) {
+      return SelectLoraAdapter(names.front());
+    }
+    return absl::UnimplementedError(absl::StrCat(
+        "SelectLoraAdapters not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // ------------Profiling APIs------------:
+  // Returns the latencies accumulated by each stage of the Prefill and Decode
+  // calls since the last Reset(). The stages shared by all the backends are
+  // named by the k*Stage constants of llm_executor_io_types.h.
+  virtual absl::StatusOr<ExecutorStageLatencies> GetStageLatencies() const {
+    return absl::UnimplementedError(absl::StrCat(
+        "GetStageLatencies not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // Returns the statistics of the decode embedding cache, which is kept for
+  // the lifetime of the executor and therefore shared by its sessions.
+  virtual absl::StatusOr<EmbeddingCacheStats> GetEmbeddingCacheStats() const {
+    return absl::UnimplementedError(absl::StrCat(
+        "GetEmbeddingCacheStats not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // Returns the number of tokens of the prefill chunk of the highest
+  // throughput, i.e. the prefill signature of the lowest latency per token, as
+  // measured on the device when the prefill work groups are autotuned, see
+  // LlmExecutorSettings::SetAutotunePrefillWorkGroups(). Returns a
+  // FailedPrecondition error if they are not.
+  virtual absl::StatusOr<int> GetPrefillChunkSize() const {
+    return absl::UnimplementedError(absl::StrCat(
+        "GetPrefillChunkSize not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // Drops the caches kept across the sessions of the executor, e.g. the
+  // decode embedding cache, and frees its scratch buffers, such that the
+  // memory is given back under memory pressure. The executor stays usable,
+  // with its states kept, and fills the caches again on demand.
+  virtual absl::Status ReleaseCaches() {
+    return absl::UnimplementedError(absl::StrCat(
+        "ReleaseCaches not implemented for backend: ", ExecutorBackendName()));
+  };
+
+  // Returns the memory held by the executor, e.g. its kv-cache and its model
+  // input and output buffers, by component and location.
+  virtual absl::StatusOr<MemoryUsage> GetMemoryUsage() const {
+    return absl::UnimplementedError(absl::StrCat(
+        "GetMemoryUsage not implemented for backend: ",
+        ExecutorBackendName()));
+  };
+
+  // ------------Warmup APIs------------:
+  // Runs every prefill signature once, and the decode signature
+  // `num_decode_steps` times, on whatever their input buffers hold, such that
+  // the first request does not pay for the kernel compilation, the buffer
+  // allocations and the weight upload. Must be called before the first
+  // Prefill() or right after Reset(), and leaves the executor as after
+  // Reset(), with a garbage kv-cache the next prefill overwrites.
+  virtual absl::Status Warmup(int num_decode_steps) {
+    return absl::UnimplementedError(absl::StrCat(
+        "Warmup not implemented for backend: ", ExecutorBackendName()));
+  };
+
   // Resets all of the internal states (e.g. KVCache). Loaded and used LoRA
   // models are not affected (remain loaded and in use).
   virtual absl::Status Reset() {
@@ -14,23 +14,54 @@
 
 #include "runtime/executor/llm_executor_io_types.h"
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <ios>
+#include <memory>
 #include <optional>
 #include <ostream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/strings/strip.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/util/binary_serialization.h"
 #include "runtime/util/logging_tensor_buffer.h"
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/status_macros.h"  // NOLINT
 
 namespace litert::lm {
 
 constexpr char kFieldIndent[] = "  ";
 
+namespace {
+
+// The magic number and the version of the files written by
+// ExecutorCheckpoint::SaveToFile().
+constexpr absl::string_view kCheckpointFileMagic = "LMCK";
+constexpr uint32_t kCheckpointFileVersion = 1;
+// The alignment of the kv-cache contents in the checkpoint files.
+constexpr size_t kCheckpointFileAlignment = 64;
+
+size_t AlignCheckpointOffset(size_t offset) {
+  return (offset + kCheckpointFileAlignment - 1) / kCheckpointFileAlignment *
+         kCheckpointFileAlignment;
+}
+
+}  // namespace
+
 ExecutorTextData::ExecutorTextData(::litert::TensorBuffer&& token_ids)
     : token_ids_(std::move(token_ids)) {}
 
@@ -504,6 +535,12 @@ void ExecutorPrefillParams::SetCancelFlag(const std::atomic_bool* cancel) {
   cancel_ = cancel;
 }
 
+absl::Time ExecutorPrefillParams::GetDeadline() const { return deadline_; }
+
+void ExecutorPrefillParams::SetDeadline(absl::Time deadline) {
+  deadline_ = deadline;
+}
+
 std::ostream& operator<<(std::ostream& os,
                          const ExecutorPrefillParams& params) {
   os << "ExecutorPrefillParams: {\n"
@@ -519,6 +556,271 @@ std::ostream& operator<<(std::ostream& os,
     os << "nullptr";
   }
   os << "\n"
+     << kFieldIndent << "Deadline: " << params.GetDeadline() << "\n"
+     << "}";
+  return os;
+}
+
+// --- ExecutorCheckpoint Implementation ---
+ExecutorCheckpoint::ExecutorCheckpoint(int current_step,
+                                       int next_input_token_id,
+                                       KvCacheData&& kv_cache)
+    : current_step_(current_step),
+      next_input_token_id_(next_input_token_id),
+      kv_cache_(std::move(kv_cache)) {}
+
+ExecutorCheckpoint::ExecutorCheckpoint(int current_step,
+                                       int next_input_token_id,
+                                       KvCacheData&& kv_cache,
+                                       KvCacheScales&& kv_cache_scales)
+    : current_step_(current_step),
+      next_input_token_id_(next_input_token_id),
+      kv_cache_(std::move(kv_cache)),
+      kv_cache_scales_(std::move(kv_cache_scales)) {}
+
+int ExecutorCheckpoint::GetCurrentStep() const { return current_step_; }
+
+int ExecutorCheckpoint::GetNextInputTokenId() const {
+  return next_input_token_id_;
+}
+
+int ExecutorCheckpoint::GetNumTokens() const {
+  return current_step_ + (next_input_token_id_ == -1 ? 0 : 1);
+}
+
+const ExecutorCheckpoint::KvCacheData& ExecutorCheckpoint::GetKvCache() const {
+  return kv_cache_;
+}
+
+ExecutorCheckpoint::KvCacheData& ExecutorCheckpoint::GetMutableKvCache() {
+  return kv_cache_;
+}
+
+const ExecutorCheckpoint::KvCacheScales& ExecutorCheckpoint::GetKvCacheScales()
+    const {
+  return kv_cache_scales_;
+}
+
+int ExecutorCheckpoint::GetNumKvCacheTensors() const {
+  return IsOffloaded() ? offloaded_tensors_.size() : kv_cache_.size();
+}
+
+absl::StatusOr<absl::Span<const uint8_t>> ExecutorCheckpoint::GetKvCacheTensor(
+    absl::string_view name) const {
+  if (IsOffloaded()) {
+    auto it = offloaded_tensors_.find(name);
+    if (it == offloaded_tensors_.end()) {
+      return absl::NotFoundError(
+          absl::StrCat("Kv-cache tensor ", name, " not found in checkpoint."));
+    }
+    const auto* data = static_cast<const uint8_t*>(offloaded_file_->data());
+    return absl::MakeConstSpan(data + it->second.first, it->second.second);
+  }
+  auto it = kv_cache_.find(name);
+  if (it == kv_cache_.end()) {
+    return absl::NotFoundError(
+        absl::StrCat("Kv-cache tensor ", name, " not found in checkpoint."));
+  }
+  return absl::MakeConstSpan(it->second);
+}
+
+absl::Status ExecutorCheckpoint::OffloadToFile(absl::string_view path) {
+  if (IsOffloaded()) {
+    return absl::FailedPreconditionError("Checkpoint is already offloaded.");
+  }
+  if (kv_cache_.empty()) {
+    // Nothing to offload, and an empty file cannot be mapped.
+    return absl::OkStatus();
+  }
+  absl::flat_hash_map<std::string, std::pair<size_t, size_t>> offloaded_tensors;
+  {
+    std::ofstream file(std::string(path), std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return absl::InternalError(
+          absl::StrCat("Failed to open ", path, " for writing."));
+    }
+    size_t offset = 0;
+    for (const auto& [name, data] : kv_cache_) {
+      file.write(reinterpret_cast<const char*>(data.data()), data.size());
+      offloaded_tensors[name] = {offset, data.size()};
+      offset += data.size();
+    }
+    file.close();
+    if (!file) {
+      return absl::InternalError(absl::StrCat("Failed to write ", path, "."));
+    }
+  }
+  ASSIGN_OR_RETURN(std::unique_ptr<MemoryMappedFile> mapped_file,
+                   MemoryMappedFile::Create(path));
+  offloaded_file_ = std::move(mapped_file);
+  offloaded_tensors_ = std::move(offloaded_tensors);
+  kv_cache_.clear();
+  return absl::OkStatus();
+}
+
+absl::Status ExecutorCheckpoint::SaveToFile(absl::string_view path) const {
+  // The file starts with an index of the tensors, followed by their contents
+  // at aligned offsets. The tensors are sorted such that the same checkpoint
+  // always gives the same file.
+  std::vector<std::string> names;
+  names.reserve(GetNumKvCacheTensors());
+  if (IsOffloaded()) {
+    for (const auto& [name, tensor] : offloaded_tensors_) {
+      names.push_back(name);
+    }
+  } else {
+    for (const auto& [name, data] : kv_cache_) {
+      names.push_back(name);
+    }
+  }
+  std::sort(names.begin(), names.end());
+  std::vector<absl::Span<const uint8_t>> contents;
+  contents.reserve(names.size());
+  size_t index_size = kCheckpointFileMagic.size() + 4 * sizeof(uint32_t);
+  for (const std::string& name : names) {
+    ASSIGN_OR_RETURN(absl::Span<const uint8_t> tensor_contents,
+                     GetKvCacheTensor(name));
+    contents.push_back(tensor_contents);
+    auto scales_it = kv_cache_scales_.find(name);
+    const size_t num_scales =
+        scales_it == kv_cache_scales_.end() ? 0 : scales_it->second.size();
+    index_size += 2 * sizeof(uint32_t) + name.size() +
+                  num_scales * sizeof(float) + 2 * sizeof(uint64_t);
+  }
+
+  std::string index;
+  index.reserve(index_size);
+  index.append(kCheckpointFileMagic.data(), kCheckpointFileMagic.size());
+  AppendValue<uint32_t>(kCheckpointFileVersion, index);
+  AppendValue<int32_t>(current_step_, index);
+  AppendValue<int32_t>(next_input_token_id_, index);
+  AppendValue<uint32_t>(names.size(), index);
+  size_t offset = AlignCheckpointOffset(index_size);
+  std::vector<size_t> offsets(names.size());
+  for (int i = 0; i < names.size(); ++i) {
+    AppendValue<uint32_t>(names[i].size(), index);
+    index.append(names[i]);
+    auto scales_it = kv_cache_scales_.find(names[i]);
+    if (scales_it == kv_cache_scales_.end()) {
+      AppendValue<uint32_t>(0, index);
+    } else {
+      AppendValue<uint32_t>(scales_it->second.size(), index);
+      index.append(reinterpret_cast<const char*>(scales_it->second.data()),
+                   scales_it->second.size() * sizeof(float));
+    }
+    offsets[i] = offset;
+    AppendValue<uint64_t>(offset, index);
+    AppendValue<uint64_t>(contents[i].size(), index);
+    offset = AlignCheckpointOffset(offset + contents[i].size());
+  }
+
+  std::ofstream file(std::string(path), std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return absl::InternalError(
+        absl::StrCat("Failed to open ", path, " for writing."));
+  }
+  file.write(index.data(), index.size());
+  const std::string padding(kCheckpointFileAlignment, '\0');
+  size_t written = index.size();
+  for (int i = 0; i < names.size(); ++i) {
+    file.write(padding.data(), offsets[i] - written);
+    file.write(reinterpret_cast<const char*>(contents[i].data()),
+               contents[i].size());
+    written = offsets[i] + contents[i].size();
+  }
+  file.close();
+  if (!file) {
+    return absl::InternalError(absl::StrCat("Failed to write ", path, "."));
+  }
+  return absl::OkStatus();
+}
+
+// static
+absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>>
+ExecutorCheckpoint::LoadFromFile(absl::string_view path) {
+  ASSIGN_OR_RETURN(std::unique_ptr<MemoryMappedFile> mapped_file,
+                   MemoryMappedFile::Create(path));
+  const absl::string_view file_contents(
+      static_cast<const char*>(mapped_file->data()), mapped_file->length());
+  const absl::Status truncated_error = absl::DataLossError(
+      absl::StrCat("Checkpoint file ", path, " is truncated."));
+  absl::string_view in = file_contents;
+  if (!absl::ConsumePrefix(&in, kCheckpointFileMagic)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat(path, " is not a checkpoint file."));
+  }
+  uint32_t version = 0;
+  int32_t current_step = 0;
+  int32_t next_input_token_id = -1;
+  uint32_t num_tensors = 0;
+  if (!ConsumeValue(in, version) || !ConsumeValue(in, current_step) ||
+      !ConsumeValue(in, next_input_token_id) ||
+      !ConsumeValue(in, num_tensors)) {
+    return truncated_error;
+  }
+  if (version != kCheckpointFileVersion) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Unsupported checkpoint file version ", version, "."));
+  }
+  KvCacheScales kv_cache_scales;
+  absl::flat_hash_map<std::string, std::pair<size_t, size_t>> tensors;
+  for (int i = 0; i < num_tensors; ++i) {
+    uint32_t name_size = 0;
+    if (!ConsumeValue(in, name_size) || in.size() < name_size) {
+      return truncated_error;
+    }
+    std::string name(in.substr(0, name_size));
+    in.remove_prefix(name_size);
+    uint32_t num_scales = 0;
+    if (!ConsumeValue(in, num_scales) ||
+        in.size() / sizeof(float) < num_scales) {
+      return truncated_error;
+    }
+    if (num_scales > 0) {
+      std::vector<float>& scales = kv_cache_scales[name];
+      scales.resize(num_scales);
+      memcpy(scales.data(), in.data(), num_scales * sizeof(float));
+      in.remove_prefix(num_scales * sizeof(float));
+    }
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    if (!ConsumeValue(in, offset) || !ConsumeValue(in, size)) {
+      return truncated_error;
+    }
+    if (offset > file_contents.size() ||
+        size > file_contents.size() - offset) {
+      return truncated_error;
+    }
+    tensors[std::move(name)] = {offset, size};
+  }
+  auto checkpoint = std::make_unique<ExecutorCheckpoint>(
+      current_step, next_input_token_id, KvCacheData(),
+      std::move(kv_cache_scales));
+  checkpoint->offloaded_file_ = std::move(mapped_file);
+  checkpoint->offloaded_tensors_ = std::move(tensors);
+  return checkpoint;
+}
+
+size_t ExecutorCheckpoint::GetSizeInBytes() const {
+  size_t size = 0;
+  for (const auto& [name, data] : kv_cache_) {
+    size += data.size();
+  }
+  for (const auto& [name, scales] : kv_cache_scales_) {
+    size += scales.size() * sizeof(float);
+  }
+  return size;
+}
+
+std::ostream& operator<<(std::ostream& os,
+                         const ExecutorCheckpoint& checkpoint) {
+  os << "ExecutorCheckpoint: {\n"
+     << kFieldIndent << "CurrentStep: " << checkpoint.GetCurrentStep() << "\n"
+     << kFieldIndent
+     << "NextInputTokenId: " << checkpoint.GetNextInputTokenId() << "\n"
+     << kFieldIndent << "KvCacheTensors: " << checkpoint.GetNumKvCacheTensors()
+     << "\n"
+     << kFieldIndent << "SizeInBytes: " << checkpoint.GetSizeInBytes() << "\n"
      << "}";
   return os;
 }
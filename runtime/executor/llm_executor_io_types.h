@@ -16,11 +16,24 @@
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_LLM_EXECUTOR_IO_TYPES_H_
 
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
 #include <optional>
 #include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
 
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/util/memory_mapped_file.h"
 
 namespace litert::lm {
 
@@ -231,6 +244,7 @@ class ExecutorPrefillParams {
   // - current_step: -1
   // - wait_for_completion: false
   // - cancel: nullptr
+  // - deadline: absl::InfiniteFuture()
   ExecutorPrefillParams() = default;
 
   // Parameterized constructor for all values
@@ -246,6 +260,9 @@ class ExecutorPrefillParams {
   const std::atomic_bool* GetCancelFlag() const;
   void SetCancelFlag(const std::atomic_bool* cancel);
 
+  absl::Time GetDeadline() const;
+  void SetDeadline(absl::Time deadline);
+
  private:
   // The current step to prefill.
   int current_step_ = -1;
@@ -258,9 +275,143 @@ class ExecutorPrefillParams {
   // to true, the Executor is responsible to cancel the Prefill process as soon
   // as possible.
   const std::atomic_bool* cancel_ = nullptr;
+
+  // The time after which the Executor stops the Prefill process as soon as
+  // possible, as if it was cancelled.
+  absl::Time deadline_ = absl::InfiniteFuture();
 };
 std::ostream& operator<<(std::ostream& os, const ExecutorPrefillParams& params);
 
+// Class to host a snapshot of the executor state, i.e. the kv-cache contents
+// and the step counters, taken by LlmExecutorBase::SaveState() and applied
+// back with LlmExecutorBase::RestoreState(). The kv-cache is copied to host
+// memory so that the checkpoint stays valid after the executor continues to
+// run, and so that it can outlive the buffers it was taken from. The kv-cache
+// contents of an idle checkpoint can be offloaded further to a memory mapped
+// file with OffloadToFile(), in which case they are paged back in on access.
+class ExecutorCheckpoint {
+ public:
+  // The kv-cache contents keyed by the kv-cache tensor name.
+  using KvCacheData = absl::flat_hash_map<std::string, std::vector<uint8_t>>;
+  // The quantization scales of the kv-cache tensors stored in int8, keyed by
+  // the kv-cache tensor name. Tensors without scales are stored in the data
+  // type of the model.
+  using KvCacheScales = absl::flat_hash_map<std::string, std::vector<float>>;
+
+  ExecutorCheckpoint() = default;
+
+  // current_step: The internal step of the executor, i.e. the number of tokens
+  //   already written into the kv-cache.
+  // next_input_token_id: The pending token that has not been fed into the
+  //   model yet, or -1 if there is none.
+  // kv_cache: The kv-cache contents.
+  ExecutorCheckpoint(int current_step, int next_input_token_id,
+                     KvCacheData&& kv_cache);
+  // kv_cache_scales: The scales of the kv-cache tensors stored in int8.
+  ExecutorCheckpoint(int current_step, int next_input_token_id,
+                     KvCacheData&& kv_cache, KvCacheScales&& kv_cache_scales);
+
+  int GetCurrentStep() const;
+  int GetNextInputTokenId() const;
+
+  // Returns the number of tokens covered by the checkpoint, i.e. the value of
+  // LlmExecutorBase::GetCurrentStep() at the time the checkpoint was taken.
+  int GetNumTokens() const;
+
+  // The kv-cache contents held in host memory, which are empty once the
+  // checkpoint is offloaded. Prefer GetKvCacheTensor() to read the contents.
+  const KvCacheData& GetKvCache() const;
+  KvCacheData& GetMutableKvCache();
+  const KvCacheScales& GetKvCacheScales() const;
+
+  // Returns the number of kv-cache tensors, whether offloaded or not.
+  int GetNumKvCacheTensors() const;
+
+  // Returns the contents of the kv-cache tensor `name`, from host memory or
+  // from the memory mapped file if the checkpoint is offloaded. The span is
+  // valid as long as the checkpoint is not modified.
+  absl::StatusOr<absl::Span<const uint8_t>> GetKvCacheTensor(
+      absl::string_view name) const;
+
+  // Moves the kv-cache contents from host memory to the file at `path`, which
+  // is created or overwritten, and maps the file back read-only. The file is
+  // owned by the caller and must outlive the checkpoint. Does nothing if the
+  // checkpoint holds no kv-cache contents.
+  absl::Status OffloadToFile(absl::string_view path);
+  bool IsOffloaded() const { return offloaded_file_ != nullptr; }
+
+  // Writes the checkpoint, i.e. the step counters, the kv-cache contents and
+  // their scales, to a self-contained file at `path`, which is created or
+  // overwritten. The file is in the byte order of the device, and is meant to
+  // be read back on it by LoadFromFile(), e.g. after the app restarts.
+  absl::Status SaveToFile(absl::string_view path) const;
+
+  // Loads a checkpoint written by SaveToFile(). The file is mapped read-only
+  // and the checkpoint is returned offloaded to it, so the kv-cache contents
+  // are only paged in when restored. The file must outlive the checkpoint.
+  static absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> LoadFromFile(
+      absl::string_view path);
+
+  // Returns the host memory held by the kv-cache contents and their scales,
+  // not counting the offloaded contents.
+  size_t GetSizeInBytes() const;
+
+ private:
+  int current_step_ = 0;
+  int next_input_token_id_ = -1;
+  KvCacheData kv_cache_;
+  KvCacheScales kv_cache_scales_;
+
+  // The file holding the kv-cache contents once offloaded, with the offset and
+  // the size of each kv-cache tensor in the file.
+  std::shared_ptr<MemoryMappedFile> offloaded_file_;
+  absl::flat_hash_map<std::string, std::pair<size_t, size_t>>
+      offloaded_tensors_;
+};
+std::ostream& operator<<(std::ostream& os,
+                         const ExecutorCheckpoint& checkpoint);
+
+// The accumulated latencies of the stages of an executor, keyed by the stage
+// name, as reported by LlmExecutorBase::GetStageLatencies().
+using ExecutorStageLatencies = std::map<std::string, absl::Duration>;
+
+// The names of the stages shared by all the backends, such that their costs
+// can be compared side by side. A backend may report finer stages on top of
+// these, e.g. the "decode_rope" model of the NPU executor.
+//
+// Filling the model inputs, e.g. the token ids, positions and masks.
+inline constexpr absl::string_view kPrefillPrepareInputsStage =
+    "prefill_prepare_inputs";
+inline constexpr absl::string_view kDecodePrepareInputsStage =
+    "decode_prepare_inputs";
+// Running the model(s).
+inline constexpr absl::string_view kPrefillInferenceStage = "prefill_inference";
+inline constexpr absl::string_view kDecodeInferenceStage = "decode_inference";
+// Sampling the next tokens from the logits, within the executor.
+inline constexpr absl::string_view kDecodeSamplingStage = "decode_sampling";
+// The part of the inference the host waits for the device once the runs are
+// enqueued, if measured, e.g. with GpuConfig::measure_device_time.
+inline constexpr absl::string_view kPrefillDeviceStage = "prefill_device";
+inline constexpr absl::string_view kDecodeDeviceStage = "decode_device";
+
+// The statistics of the cache of the embeddings of the decoded tokens, as
+// reported by LlmExecutorBase::GetEmbeddingCacheStats(). The lookups of the
+// embedder and the per-layer embedder are counted separately.
+struct EmbeddingCacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t size_in_bytes = 0;
+};
+
+// How the final hidden states of the tokens of one input are pooled into its
+// embedding by LlmExecutorBase::EmbedTokens().
+enum class EmbeddingPooling {
+  // The mean of the hidden states of all the tokens.
+  kMean = 0,
+  // The hidden state of the last token.
+  kLastToken = 1,
+};
+
 }  // namespace litert::lm
 
 #endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_LLM_EXECUTOR_IO_TYPES_H_
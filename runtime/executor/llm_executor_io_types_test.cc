@@ -16,12 +16,18 @@
 
 #include <atomic>
 #include <cstdint>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <ios>
 #include <optional>
 #include <sstream>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
 #include "litert/c/litert_tensor_buffer.h"  // from @litert
 #include "litert/cc/litert_element_type.h"  // from @litert
@@ -139,6 +145,7 @@ TEST(LlmExecutorIoTypesTest, ExecutorPrefillParamsPrint) {
             "  CurrentStep: 10\n"
             "  WaitForCompletion: true\n"
             "  CancelFlag: true (atomic)\n"
+            "  Deadline: infinite-future\n"
             "}");
 
   // Test with a null cancel flag.
@@ -150,6 +157,7 @@ TEST(LlmExecutorIoTypesTest, ExecutorPrefillParamsPrint) {
             "  CurrentStep: 10\n"
             "  WaitForCompletion: true\n"
             "  CancelFlag: nullptr\n"
+            "  Deadline: infinite-future\n"
             "}");
 }
 
@@ -738,6 +746,137 @@ TEST(LlmExecutorIoTypesTest, ExecutorPrefillParamsGetSet) {
   // Test SetCancelFlag
   params.SetCancelFlag(&new_cancel);
   EXPECT_EQ(params.GetCancelFlag(), &new_cancel);
+
+  // Test GetDeadline and SetDeadline
+  EXPECT_EQ(params.GetDeadline(), absl::InfiniteFuture());
+  const absl::Time deadline = absl::FromUnixSeconds(100);
+  params.SetDeadline(deadline);
+  EXPECT_EQ(params.GetDeadline(), deadline);
+}
+
+TEST(LlmExecutorIoTypesTest, ExecutorCheckpointGetSet) {
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  kv_cache["kv_cache_k_0"] = std::vector<uint8_t>(16, 1);
+  kv_cache["kv_cache_v_0"] = std::vector<uint8_t>(16, 2);
+  ExecutorCheckpoint checkpoint(/*current_step=*/10,
+                                /*next_input_token_id=*/3,
+                                std::move(kv_cache));
+
+  EXPECT_EQ(checkpoint.GetCurrentStep(), 10);
+  EXPECT_EQ(checkpoint.GetNextInputTokenId(), 3);
+  EXPECT_EQ(checkpoint.GetNumTokens(), 11);
+  EXPECT_EQ(checkpoint.GetKvCache().size(), 2);
+  EXPECT_EQ(checkpoint.GetSizeInBytes(), 32);
+
+  checkpoint.GetMutableKvCache().erase("kv_cache_v_0");
+  EXPECT_EQ(checkpoint.GetSizeInBytes(), 16);
+
+  std::stringstream oss;
+  oss << checkpoint;
+  EXPECT_EQ(oss.str(),
+            "ExecutorCheckpoint: {\n"
+            "  CurrentStep: 10\n"
+            "  NextInputTokenId: 3\n"
+            "  KvCacheTensors: 1\n"
+            "  SizeInBytes: 16\n"
+            "}");
+}
+
+TEST(LlmExecutorIoTypesTest, ExecutorCheckpointWithKvCacheScales) {
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  kv_cache["kv_cache_k_0"] = std::vector<uint8_t>(16, 1);
+  ExecutorCheckpoint::KvCacheScales kv_cache_scales;
+  kv_cache_scales["kv_cache_k_0"] = std::vector<float>(2, 0.5f);
+  ExecutorCheckpoint checkpoint(/*current_step=*/2,
+                                /*next_input_token_id=*/-1,
+                                std::move(kv_cache),
+                                std::move(kv_cache_scales));
+  EXPECT_EQ(checkpoint.GetKvCacheScales().at("kv_cache_k_0").size(), 2);
+  EXPECT_EQ(checkpoint.GetSizeInBytes(), 16 + 2 * sizeof(float));
+}
+
+TEST(LlmExecutorIoTypesTest, ExecutorCheckpointOffloadToFile) {
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  kv_cache["kv_cache_k_0"] = std::vector<uint8_t>(16, 1);
+  kv_cache["kv_cache_v_0"] = std::vector<uint8_t>(8, 2);
+  ExecutorCheckpoint checkpoint(/*current_step=*/10,
+                                /*next_input_token_id=*/3,
+                                std::move(kv_cache));
+  const std::string path = std::filesystem::path(::testing::TempDir()) /
+                           "executor_checkpoint_offload.bin";
+  ASSERT_TRUE(checkpoint.OffloadToFile(path).ok());
+  EXPECT_TRUE(checkpoint.IsOffloaded());
+  EXPECT_TRUE(checkpoint.GetKvCache().empty());
+  EXPECT_EQ(checkpoint.GetNumKvCacheTensors(), 2);
+  EXPECT_EQ(checkpoint.GetSizeInBytes(), 0);
+
+  auto k_cache = checkpoint.GetKvCacheTensor("kv_cache_k_0");
+  ASSERT_TRUE(k_cache.ok());
+  EXPECT_EQ(std::vector<uint8_t>(k_cache->begin(), k_cache->end()),
+            std::vector<uint8_t>(16, 1));
+  auto v_cache = checkpoint.GetKvCacheTensor("kv_cache_v_0");
+  ASSERT_TRUE(v_cache.ok());
+  EXPECT_EQ(std::vector<uint8_t>(v_cache->begin(), v_cache->end()),
+            std::vector<uint8_t>(8, 2));
+  EXPECT_EQ(checkpoint.GetKvCacheTensor("kv_cache_k_1").status().code(),
+            absl::StatusCode::kNotFound);
+  EXPECT_EQ(checkpoint.OffloadToFile(path).code(),
+            absl::StatusCode::kFailedPrecondition);
+}
+
+TEST(LlmExecutorIoTypesTest, ExecutorCheckpointWithoutPendingToken) {
+  ExecutorCheckpoint checkpoint(/*current_step=*/4,
+                                /*next_input_token_id=*/-1,
+                                ExecutorCheckpoint::KvCacheData());
+  EXPECT_EQ(checkpoint.GetNumTokens(), 4);
+  EXPECT_EQ(checkpoint.GetSizeInBytes(), 0);
+}
+
+TEST(LlmExecutorIoTypesTest, ExecutorCheckpointSaveAndLoadFile) {
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  kv_cache["kv_cache_k_0"] = std::vector<uint8_t>(16, 1);
+  kv_cache["kv_cache_v_0"] = std::vector<uint8_t>(100, 2);
+  ExecutorCheckpoint::KvCacheScales kv_cache_scales;
+  kv_cache_scales["kv_cache_v_0"] = {0.5f, 0.25f};
+  ExecutorCheckpoint checkpoint(/*current_step=*/10,
+                                /*next_input_token_id=*/3,
+                                std::move(kv_cache),
+                                std::move(kv_cache_scales));
+  const std::string path = std::filesystem::path(::testing::TempDir()) /
+                           "executor_checkpoint_save.bin";
+  ASSERT_TRUE(checkpoint.SaveToFile(path).ok());
+
+  auto loaded = ExecutorCheckpoint::LoadFromFile(path);
+  ASSERT_TRUE(loaded.ok());
+  EXPECT_EQ((*loaded)->GetCurrentStep(), 10);
+  EXPECT_EQ((*loaded)->GetNextInputTokenId(), 3);
+  // The contents stay in the mapped file until they are restored.
+  EXPECT_TRUE((*loaded)->IsOffloaded());
+  EXPECT_EQ((*loaded)->GetNumKvCacheTensors(), 2);
+  auto v_cache = (*loaded)->GetKvCacheTensor("kv_cache_v_0");
+  ASSERT_TRUE(v_cache.ok());
+  EXPECT_EQ(std::vector<uint8_t>(v_cache->begin(), v_cache->end()),
+            std::vector<uint8_t>(100, 2));
+  EXPECT_EQ((*loaded)->GetKvCacheScales().at("kv_cache_v_0"),
+            std::vector<float>({0.5f, 0.25f}));
+  EXPECT_FALSE((*loaded)->GetKvCacheScales().contains("kv_cache_k_0"));
+}
+
+TEST(LlmExecutorIoTypesTest, ExecutorCheckpointLoadInvalidFile) {
+  const std::string path = std::filesystem::path(::testing::TempDir()) /
+                           "executor_checkpoint_invalid.bin";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "LMCK";
+  }
+  EXPECT_EQ(ExecutorCheckpoint::LoadFromFile(path).status().code(),
+            absl::StatusCode::kDataLoss);
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "not a checkpoint";
+  }
+  EXPECT_EQ(ExecutorCheckpoint::LoadFromFile(path).status().code(),
+            absl::StatusCode::kInvalidArgument);
 }
 
 }  // namespace
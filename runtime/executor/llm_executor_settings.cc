@@ -29,6 +29,17 @@
 
 namespace litert::lm {
 
+std::ostream& operator<<(std::ostream& os, const KvCacheDataType& data_type) {
+  switch (data_type) {
+    case KvCacheDataType::NATIVE:
+      return os << "NATIVE";
+    case KvCacheDataType::INT8:
+      return os << "INT8";
+    default:
+      return os << "UNKNOWN";
+  }
+}
+
 std::ostream& operator<<(std::ostream& os, const GpuArtisanConfig& config) {
   os << "num_output_candidates: " << config.num_output_candidates << "\n";
   os << "wait_for_weight_uploads: " << config.wait_for_weight_uploads << "\n";
@@ -43,11 +54,29 @@ std::ostream& operator<<(std::ostream& os, const GpuArtisanConfig& config) {
 
 std::ostream& operator<<(std::ostream& os, const GpuConfig& config) {
   os << "max_top_k: " << config.max_top_k << "\n";
+  os << "num_decode_steps_per_sync: " << config.num_decode_steps_per_sync
+     << "\n";
+  os << "in_place_kv_cache_update: " << config.in_place_kv_cache_update
+     << "\n";
+  os << "async_prefill: " << config.async_prefill << "\n";
+  os << "wait_for_weight_uploads: " << config.wait_for_weight_uploads
+     << "\n";
+  os << "measure_device_time: " << config.measure_device_time << "\n";
+  os << "import_host_weights: " << config.import_host_weights << "\n";
+  os << "replay_command_buffers: " << config.replay_command_buffers << "\n";
   return os;
 }
 
 std::ostream& operator<<(std::ostream& os, const CpuConfig& config) {
   os << "number_of_threads: " << config.number_of_threads << "\n";
+  os << "prefer_performance_cores: " << config.prefer_performance_cores
+     << "\n";
+  os << "dynamic_range_quantization: " << config.dynamic_range_quantization
+     << "\n";
+  os << "use_weight_cache: " << config.use_weight_cache << "\n";
+  os << "model_resident_budget_bytes: " << config.model_resident_budget_bytes
+     << "\n";
+  os << "numa_node: " << config.numa_node << "\n";
   return os;
 }
 
@@ -61,6 +90,30 @@ std::ostream& operator<<(std::ostream& os, const LlmExecutorSettings& config) {
   os << "max_tokens: " << config.GetMaxNumTokens() << "\n";
   os << "activation_data_type: " << config.GetActivationDataType() << "\n";
   os << "max_num_images: " << config.GetMaxNumImages() << "\n";
+  if (config.GetKvCacheBlockSize().has_value()) {
+    os << "kv_cache_block_size: " << config.GetKvCacheBlockSize().value()
+       << "\n";
+  } else {
+    os << "kv_cache_block_size: Not set.\n";
+  }
+  os << "kv_cache_data_type: " << config.GetKvCacheDataType() << "\n";
+  os << "autotune_prefill_work_groups: "
+     << config.GetAutotunePrefillWorkGroups() << "\n";
+  os << "lazy_prefill_signatures: " << config.GetLazyPrefillSignatures()
+     << "\n";
+  os << "release_prefill_buffers: " << config.GetReleasePrefillBuffers()
+     << "\n";
+  os << "pipeline_decode_inputs: " << config.GetPipelineDecodeInputs()
+     << "\n";
+  os << "warmup_on_compilation_cache_hit: "
+     << config.GetWarmupOnCompilationCacheHit() << "\n";
+  os << "precompute_decode_rope: " << config.GetPrecomputeDecodeRope()
+     << "\n";
+  os << "embedding_cache_budget_bytes: "
+     << config.GetEmbeddingCacheBudgetBytes() << "\n";
+  os << "per_layer_embedding_mapped_budget_bytes: "
+     << config.GetPerLayerEmbeddingMappedBudgetBytes() << "\n";
+  os << "weight_memory_options: " << config.GetWeightMemoryOptions() << "\n";
   os << "cache_dir: " << config.GetCacheDir() << "\n";
   if (config.GetScopedCacheFile()) {
     os << "cache_file: " << config.GetScopedCacheFile()->file() << "\n";
@@ -71,27 +124,39 @@ std::ostream& operator<<(std::ostream& os, const LlmExecutorSettings& config) {
   return os;
 }
 
-// static
-absl::StatusOr<LlmExecutorSettings> LlmExecutorSettings::CreateDefault(
-    ModelAssets model_assets, Backend backend) {
-  LlmExecutorSettings settings(std::move(model_assets));
+absl::Status LlmExecutorSettings::ResolveBackend(Backend backend) {
   if (backend == Backend::CPU) {
-    CpuConfig config;
-    config.number_of_threads = 4;
-    settings.SetBackendConfig(config);
+    if (!std::holds_alternative<CpuConfig>(backend_config_)) {
+      CpuConfig config;
+      config.number_of_threads = 4;
+      SetBackendConfig(config);
+    }
   } else if (backend == Backend::GPU) {
-    GpuConfig config;
-    // Default max top k to 1 for GPU.
-    config.max_top_k = 1;
-    settings.SetBackendConfig(config);
-  } else if (backend == Backend::NPU) {
+    if (!std::holds_alternative<GpuConfig>(backend_config_)) {
+      GpuConfig config;
+      // Default max top k to 1 for GPU.
+      config.max_top_k = 1;
+      SetBackendConfig(config);
+    }
+  } else if (backend == Backend::NPU || backend == Backend::AUTO) {
+    // The NPU has no config, and the one of AUTO is set once resolved.
   } else if (backend == Backend::GPU_ARTISAN) {
-    settings.SetBackendConfig(GpuArtisanConfig());
+    if (!std::holds_alternative<GpuArtisanConfig>(backend_config_)) {
+      SetBackendConfig(GpuArtisanConfig());
+    }
   } else {
     return absl::InvalidArgumentError(
         absl::StrCat("Unsupported backend: ", backend));
   }
-  settings.SetBackend(backend);
+  SetBackend(backend);
+  return absl::OkStatus();
+}
+
+// static
+absl::StatusOr<LlmExecutorSettings> LlmExecutorSettings::CreateDefault(
+    ModelAssets model_assets, Backend backend) {
+  LlmExecutorSettings settings(std::move(model_assets));
+  RETURN_IF_ERROR(settings.ResolveBackend(backend));
   // Explicitly set the field value to avoid undefined behavior. Setting to 0
   // means that the maximum number of tokens is not set can could be inferred
   // from the model assets (but note that for the model or backend which does
@@ -31,6 +31,20 @@
 
 namespace litert::lm {
 
+// The data type the kv-cache is stored in by the executor outside of the
+// model, e.g. in the checkpoints taken by SaveState() and kept by the prefix
+// cache. The kv-cache tensors of the model keep the data type the model was
+// converted with.
+enum class KvCacheDataType {
+  // Store the kv-cache in the data type of the model.
+  NATIVE,
+
+  // Store float32 kv-cache tensors in int8, with one float32 scale per row of
+  // the innermost dimension, i.e. per head and position.
+  INT8,
+};
+std::ostream& operator<<(std::ostream& os, const KvCacheDataType& data_type);
+
 struct GpuArtisanConfig {
   // Number of output candidates.
   uint32_t num_output_candidates = 1;
@@ -75,12 +89,94 @@ struct GpuConfig {
   // means only greedy decoding is supported for any sessions created with
   // this engine.
   uint32_t max_top_k = 1;
+
+  // Number of decode steps per sync. The sampled token of each step is fed to
+  // the next step on the device, and the host reads back the tokens of all the
+  // steps at once.
+  uint32_t num_decode_steps_per_sync = 1;
+
+  // Whether the kv-cache outputs of the model alias its kv-cache inputs, as
+  // on CPU, instead of being a second copy of the kv-cache swapped with the
+  // inputs after every run. Halves the kv-cache memory, but is only valid for
+  // the models exported with in-place, i.e. scatter, kv-cache updates, which
+  // only write the entries of the new steps.
+  bool in_place_kv_cache_update = false;
+
+  // Whether the prefills that do not wait for completion are enqueued on the
+  // GPU work group after work group, without the host waiting for any of
+  // them. The host then only waits for the outputs it reads, e.g. the logits
+  // of the next decode. The prefill inputs are double-buffered, such that the
+  // host prepares the next work group while the GPU runs the current one.
+  bool async_prefill = false;
+
+  // Whether the engine waits for the weights of the model to be uploaded to
+  // the GPU before it is ready. The weights are uploaded by the first run of
+  // the model, which the engine starts on the worker thread of the executor
+  // once it is loaded. If false, the engine is ready meanwhile, and the
+  // sessions created then are queued behind the upload.
+  bool wait_for_weight_uploads = false;
+
+  // Whether each run of a signature is enqueued, and the time the host then
+  // waits for the events of its outputs is reported as the device stage of
+  // the run, next to the host stages, see GetStageLatencies(). The inference
+  // stage minus the device stage is the host orchestration. Adds a sync per
+  // run, i.e. only meant for profiling.
+  bool measure_device_time = false;
+
+  // Whether the GPU reads the weights of a page-aligned model in place from
+  // the mapped model file, on the GPUs sharing the memory of the host, rather
+  // than copying them into textures at load. Cuts the load time and its peak
+  // memory, but keeps the model mapped for as long as the executor. Ignored
+  // for the models which are not page-aligned, e.g. those written without the
+  // aligned section layout or decompressed at load.
+  bool import_host_weights = false;
+
+  // Whether the GPU delegate records the command buffer of a run once and
+  // replays it on the next runs of the same signature with the same buffers,
+  // instead of dispatching its kernels again. Each decode step runs the
+  // signature of its kv-cache parity with the buffers bound for it, so the
+  // steady-state decode only replays one of two recorded command buffers,
+  // with only the contents of the token and position inputs changed. Cuts the
+  // host dispatch time of each step, which bounds the decode speed of the
+  // small models on the fast GPUs.
+  bool replay_command_buffers = false;
 };
 std::ostream& operator<<(std::ostream& os, const GpuConfig& config);
 
 struct CpuConfig {
   // Number of threads. The default value is 4.
   uint32_t number_of_threads = 4;
+  // Whether to keep the inference on the performance cores of a heterogeneous
+  // CPU, e.g. the big cores of a big.LITTLE SoC: the number of threads is
+  // capped to the number of performance cores, and the engine worker thread
+  // is pinned to them. The default value is false.
+  bool prefer_performance_cores = false;
+  // Whether the layers of int8 weights and float activations quantize their
+  // activations to int8 on the fly, and run the signed 8-bit kernels of
+  // XNNPACK, instead of dequantizing their weights. Faster prefill and decode,
+  // at a small accuracy cost. The default value is false.
+  bool dynamic_range_quantization = false;
+  // Whether the weights packed by XNNPACK are kept in the weight cache, next
+  // to the model or in the cache dir, or in the scoped cache file, so they
+  // are not packed again on the next start. The default value is true.
+  bool use_weight_cache = true;
+  // The memory budget of the pages of the model read in place from the mapped
+  // model file. Once more of it is resident after a model run, its pages are
+  // dropped and read from the file again by the next runs, such that a model
+  // larger than the RAM headroom still runs, only slower. Applies to the
+  // weights the CPU delegate reads in place, e.g. the ones it does not
+  // repack. The default value of 0 keeps the pages read so far.
+  uint64_t model_resident_budget_bytes = 0;
+  // The NUMA node of a multi-socket server to run on. The executor is built
+  // on a thread bound to the node, such that its kv-cache, its packed weights
+  // and the threads of its delegate are on the node, and its engine worker
+  // thread is bound to it. An executor of the executor pool per node, see
+  // EngineSettings::AddPoolExecutorSettings(), then has the memory bandwidth
+  // of each node. Takes precedence over prefer_performance_cores. The weights
+  // read in place from the mapped model file are shared by the executors, and
+  // are on the node of the executor faulting them in first. The default value
+  // of -1 binds to no node.
+  int numa_node = -1;
 };
 std::ostream& operator<<(std::ostream& os, const CpuConfig& config);
 
@@ -102,6 +198,26 @@ class LlmExecutorSettings : public ExecutorSettingsBase {
   // Getter APIs.
   uint32_t GetMaxNumTokens() const { return max_num_tokens_; }
   uint32_t GetMaxNumImages() const { return max_num_images_; }
+  const std::optional<uint32_t>& GetKvCacheBlockSize() const {
+    return kv_cache_block_size_;
+  }
+  KvCacheDataType GetKvCacheDataType() const { return kv_cache_data_type_; }
+  bool GetAutotunePrefillWorkGroups() const {
+    return autotune_prefill_work_groups_;
+  }
+  bool GetLazyPrefillSignatures() const { return lazy_prefill_signatures_; }
+  bool GetReleasePrefillBuffers() const { return release_prefill_buffers_; }
+  bool GetPipelineDecodeInputs() const { return pipeline_decode_inputs_; }
+  bool GetWarmupOnCompilationCacheHit() const {
+    return warmup_on_compilation_cache_hit_;
+  }
+  bool GetPrecomputeDecodeRope() const { return precompute_decode_rope_; }
+  uint64_t GetEmbeddingCacheBudgetBytes() const {
+    return embedding_cache_budget_bytes_;
+  }
+  uint64_t GetPerLayerEmbeddingMappedBudgetBytes() const {
+    return per_layer_embedding_mapped_budget_bytes_;
+  }
 
   template <typename T>
   absl::StatusOr<const T> GetBackendConfig() const {
@@ -127,12 +243,49 @@ class LlmExecutorSettings : public ExecutorSettingsBase {
   void SetMaxNumImages(uint32_t max_num_images) {
     max_num_images_ = max_num_images;
   }
+  void SetKvCacheBlockSize(uint32_t kv_cache_block_size) {
+    kv_cache_block_size_ = kv_cache_block_size;
+  }
+  void SetKvCacheDataType(KvCacheDataType kv_cache_data_type) {
+    kv_cache_data_type_ = kv_cache_data_type;
+  }
+  void SetAutotunePrefillWorkGroups(bool autotune_prefill_work_groups) {
+    autotune_prefill_work_groups_ = autotune_prefill_work_groups;
+  }
+  void SetLazyPrefillSignatures(bool lazy_prefill_signatures) {
+    lazy_prefill_signatures_ = lazy_prefill_signatures;
+  }
+  void SetReleasePrefillBuffers(bool release_prefill_buffers) {
+    release_prefill_buffers_ = release_prefill_buffers;
+  }
+  void SetPipelineDecodeInputs(bool pipeline_decode_inputs) {
+    pipeline_decode_inputs_ = pipeline_decode_inputs;
+  }
+  void SetWarmupOnCompilationCacheHit(bool warmup_on_compilation_cache_hit) {
+    warmup_on_compilation_cache_hit_ = warmup_on_compilation_cache_hit;
+  }
+  void SetPrecomputeDecodeRope(bool precompute_decode_rope) {
+    precompute_decode_rope_ = precompute_decode_rope;
+  }
+  void SetEmbeddingCacheBudgetBytes(uint64_t embedding_cache_budget_bytes) {
+    embedding_cache_budget_bytes_ = embedding_cache_budget_bytes;
+  }
+  void SetPerLayerEmbeddingMappedBudgetBytes(
+      uint64_t per_layer_embedding_mapped_budget_bytes) {
+    per_layer_embedding_mapped_budget_bytes_ =
+        per_layer_embedding_mapped_budget_bytes;
+  }
 
   void SetBackendConfig(const std::variant<GpuArtisanConfig, GpuConfig,
                                            CpuConfig>& backend_config) {
     backend_config_ = backend_config;
   }
 
+  // Sets `backend`, with its default config unless the settings hold a config
+  // of that backend already, e.g. the one of the backend selected for
+  // Backend::AUTO, which keeps a CpuConfig set beforehand.
+  absl::Status ResolveBackend(Backend backend);
+
  private:
   explicit LlmExecutorSettings(ModelAssets model_assets)
       : ExecutorSettingsBase(std::move(model_assets)) {}
@@ -144,6 +297,62 @@ class LlmExecutorSettings : public ExecutorSettingsBase {
   // Maximum number of images the model can handle.
   uint32_t max_num_images_;
 
+  // Number of tokens per kv-cache block when the paged kv-cache is enabled.
+  // When not set, the kv-cache is reserved for `max_num_tokens_` up front.
+  std::optional<uint32_t> kv_cache_block_size_;
+
+  // The data type of the kv-cache stored outside of the model.
+  KvCacheDataType kv_cache_data_type_ = KvCacheDataType::NATIVE;
+
+  // Whether to measure the latency of each prefill signature at load time and
+  // split the prefill inputs into the work groups of minimum total latency.
+  // The measurements are cached next to the weight cache.
+  bool autotune_prefill_work_groups_ = false;
+
+  // Whether to bind the buffers of a prefill signature on its first use
+  // instead of at load time. Only the smallest prefill signature is bound at
+  // load time, which shortens the startup of models with many signatures.
+  // Ignored when autotune_prefill_work_groups_ is set.
+  bool lazy_prefill_signatures_ = false;
+
+  // Whether to release the buffers of the prefill signatures, e.g. their
+  // attention masks of [1, seq, 1, max_kv_len] and their per-layer embedding
+  // inputs, once the decode starts, keeping only the ones of the smallest
+  // prefill signature. They are bound again by the next prefill using them,
+  // which lowers the memory of the decode at the cost of the allocations.
+  bool release_prefill_buffers_ = false;
+
+  // Whether executors made of several sub-models (i.e. the NPU executor)
+  // run the work of the decode steps that does not depend on the sampled
+  // token, i.e. the cache update of the current step and the inputs of the
+  // next one that only depend on its position, on a worker thread while the
+  // host samples and processes the current step.
+  bool pipeline_decode_inputs_ = false;
+
+  // Whether executors with an on-disk compilation cache (i.e. the NPU
+  // executor) still run a warmup inference when they start from a valid
+  // cache. The warmup is always run when the cache is built.
+  bool warmup_on_compilation_cache_hit_ = false;
+
+  // Whether executors with a separate RoPE model (i.e. the NPU executor) run
+  // it for every position up to max_num_tokens_ at load time, and copy the
+  // precomputed rows into its outputs instead of running it on each decode
+  // step.
+  bool precompute_decode_rope_ = false;
+
+  // The memory budget of the cache of the embeddings of the decoded tokens,
+  // for the models with separate embedders. The embedding and per-layer
+  // embedding rows of a cached token are copied instead of running the
+  // embedders. 0 disables the cache.
+  uint64_t embedding_cache_budget_bytes_ = 0;
+
+  // The memory budget of the pages of the per-layer embedding table read in
+  // place from the mapped model file. Once the rows read exceed it, the pages
+  // of the table are dropped, such that only the rows of the recent tokens
+  // stay resident, besides the ones held by the embedding cache. 0 keeps the
+  // pages read so far.
+  uint64_t per_layer_embedding_mapped_budget_bytes_ = 0;
+
   // Backend specific config.
   std::variant<GpuArtisanConfig, GpuConfig, CpuConfig> backend_config_;
 
@@ -95,6 +95,16 @@ TEST(LlmExecutorConfigTest, ActivatonDataType) {
   EXPECT_EQ(oss.str(), "FLOAT16");
 }
 
+TEST(LlmExecutorConfigTest, KvCacheDataType) {
+  std::stringstream oss;
+  oss << KvCacheDataType::NATIVE;
+  EXPECT_EQ(oss.str(), "NATIVE");
+
+  oss.str("");
+  oss << KvCacheDataType::INT8;
+  EXPECT_EQ(oss.str(), "INT8");
+}
+
 TEST(LlmExecutorConfigTest, FakeWeightsMode) {
   FakeWeightsMode fake_weights_mode;
   std::stringstream oss;
@@ -167,6 +177,49 @@ enable_decode_logits: 1
   EXPECT_EQ(oss.str(), expected_output);
 }
 
+TEST(LlmExecutorConfigTest, GpuConfig) {
+  GpuConfig config;
+  config.max_top_k = 40;
+  config.num_decode_steps_per_sync = 4;
+  config.in_place_kv_cache_update = true;
+  config.async_prefill = true;
+  config.wait_for_weight_uploads = true;
+  config.measure_device_time = true;
+  config.import_host_weights = true;
+  config.replay_command_buffers = true;
+  std::stringstream oss;
+  oss << config;
+  const std::string expected_output = R"(max_top_k: 40
+num_decode_steps_per_sync: 4
+in_place_kv_cache_update: 1
+async_prefill: 1
+wait_for_weight_uploads: 1
+measure_device_time: 1
+import_host_weights: 1
+replay_command_buffers: 1
+)";
+  EXPECT_EQ(oss.str(), expected_output);
+}
+
+TEST(LlmExecutorConfigTest, CpuConfig) {
+  CpuConfig config;
+  config.number_of_threads = 2;
+  config.dynamic_range_quantization = true;
+  config.use_weight_cache = false;
+  config.model_resident_budget_bytes = 1024;
+  config.numa_node = 1;
+  std::stringstream oss;
+  oss << config;
+  const std::string expected_output = R"(number_of_threads: 2
+prefer_performance_cores: 0
+dynamic_range_quantization: 1
+use_weight_cache: 0
+model_resident_budget_bytes: 1024
+numa_node: 1
+)";
+  EXPECT_EQ(oss.str(), expected_output);
+}
+
 TEST(LlmExecutorConfigTest, LlmExecutorSettings) {
   auto model_assets = ModelAssets::Create("/path/to/model1");
   ASSERT_OK(model_assets);
@@ -192,6 +245,17 @@ enable_decode_logits: 1
 max_tokens: 1024
 activation_data_type: FLOAT16
 max_num_images: 1
+kv_cache_block_size: Not set.
+kv_cache_data_type: NATIVE
+autotune_prefill_work_groups: 0
+lazy_prefill_signatures: 0
+release_prefill_buffers: 0
+pipeline_decode_inputs: 0
+warmup_on_compilation_cache_hit: 0
+precompute_decode_rope: 0
+embedding_cache_budget_bytes: 0
+per_layer_embedding_mapped_budget_bytes: 0
+weight_memory_options: use_huge_pages: 0, lock_in_memory: 0, use_direct_io: 0, shared_memory_dir: Not set.
 cache_dir: /path/to/cache
 cache_file: Not set.
 model_assets: model_path: /path/to/model1
@@ -201,6 +265,29 @@ fake_weights_mode: FAKE_WEIGHTS_NONE
   EXPECT_EQ(oss.str(), expected_output);
 }
 
+TEST(LlmExecutorConfigTest, ResolvesTheAutoBackend) {
+  auto model_assets = ModelAssets::Create("/path/to/model1");
+  ASSERT_OK(model_assets);
+  ASSERT_OK_AND_ASSIGN(auto settings,
+                       LlmExecutorSettings::CreateDefault(
+                           *std::move(model_assets), Backend::AUTO));
+  EXPECT_EQ(settings.GetBackend(), Backend::AUTO);
+
+  ASSERT_OK(settings.ResolveBackend(Backend::GPU));
+  EXPECT_EQ(settings.GetBackend(), Backend::GPU);
+  ASSERT_OK_AND_ASSIGN(auto gpu_config,
+                       settings.GetBackendConfig<GpuConfig>());
+  EXPECT_EQ(gpu_config.max_top_k, 1);
+
+  // The config set beforehand is kept.
+  CpuConfig cpu_config;
+  cpu_config.number_of_threads = 2;
+  settings.SetBackendConfig(cpu_config);
+  ASSERT_OK(settings.ResolveBackend(Backend::CPU));
+  ASSERT_OK_AND_ASSIGN(cpu_config, settings.GetBackendConfig<CpuConfig>());
+  EXPECT_EQ(cpu_config.number_of_threads, 2);
+}
+
 TEST(GetWeightCacheFileTest, CacheDirAndModelPath) {
   auto model_assets = ModelAssets::Create("/path/to/model1.tflite");
   ASSERT_OK(model_assets);
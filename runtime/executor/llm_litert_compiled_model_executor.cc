@@ -14,14 +14,27 @@
 
 #include "runtime/executor/llm_litert_compiled_model_executor.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <fstream>
+#include <functional>
 #include <memory>
+#include <optional>
+#include <set>
+#include <sstream>
 #include <string>
 #include <utility>
+#include <variant>
 #include <vector>
 
+#include "absl/algorithm/container.h"  // from @com_google_absl
 #include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/container/flat_hash_set.h"  // from @com_google_absl
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/memory/memory.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
@@ -29,11 +42,15 @@
 #include "absl/strings/match.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
 #include "litert/c/litert_common.h"  // from @litert
 #include "litert/c/litert_environment_options.h"  // from @litert
 #include "litert/cc/litert_compiled_model.h"  // from @litert
+#include "litert/cc/litert_element_type.h"  // from @litert
 #include "litert/cc/litert_environment.h"  // from @litert
+#include "litert/cc/litert_event.h"  // from @litert
 #include "litert/cc/litert_expected.h"  // from @litert
 #include "litert/cc/litert_model.h"  // from @litert
 #include "litert/cc/litert_options.h"  // from @litert
@@ -44,14 +61,26 @@
 #include "runtime/components/embedding_lookup_text.h"
 #include "runtime/components/model_resources.h"
 #include "runtime/components/sampler_factory.h"
+#include "runtime/components/sampling_cpu_util.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/kv_cache_block_allocator.h"
+#include "runtime/executor/kv_cache_layout.h"
 #include "runtime/executor/litert_compiled_model_executor_utils.h"
 #include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/executor/lora_adapter.h"
+#include "runtime/executor/weight_cache.h"
+#include "runtime/framework/cpu_topology.h"
+#include "runtime/framework/threadpool.h"
 #include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/device_fingerprint.h"
 #include "runtime/util/file_util.h"
+#include "runtime/util/init_phase.h"
 #include "runtime/util/litert_status_util.h"
+#include "runtime/util/memory_usage.h"
 #include "runtime/util/status_macros.h"  // IWYU pragma: keep
+#include "runtime/util/trace.h"
+#include "tflite/delegates/xnnpack/xnnpack_delegate.h"  // from @litert
 
 namespace litert::lm {
 namespace {
@@ -65,6 +94,15 @@ using ::litert::TensorBuffer;
 // interpreter.
 constexpr char kPrefillSignatureRunner[] = "prefill";
 constexpr char kDecodeSignatureRunner[] = "decode";
+// The prefix of the decode signatures attending over a prefix of the
+// kv-cache, e.g. "decode_kv512".
+constexpr char kKvBucketedDecodeSignatureRunner[] = "decode_kv";
+// The signature computing the final hidden states of the tokens, without the
+// kv-cache.
+constexpr char kEmbedSignatureRunner[] = "embed";
+constexpr char kEmbedOutputHiddenStates[] = "hidden_states";
+// The timeout of the per layer embedding lookup run on the worker thread.
+constexpr absl::Duration kEmbeddingLookupTimeout = absl::Seconds(10);
 
 absl::Status GetCacheRootNames(std::vector<absl::string_view> input_names,
                                std::string& k_root_name,
@@ -83,7 +121,93 @@ absl::Status GetCacheRootNames(std::vector<absl::string_view> input_names,
   return absl::FailedPreconditionError("No KV cache inputs found.");
 }
 
-bool IsCalculationPrecisionF16() { return true; }
+// Returns the per-tensor quantization of the `logits_name` output of the
+// decode signature, with int8 or int16 logits.
+absl::StatusOr<std::pair<float, int32_t>> GetLogitsQuantization(
+    const ::litert::Model& model, absl::string_view logits_name) {
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto decode_signature,
+                               model.FindSignature(kDecodeSignatureRunner));
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto logits,
+                               decode_signature.OutputTensor(logits_name));
+  RET_CHECK(logits.HasQuantization() &&
+            logits.QTypeId() == kLiteRtQuantizationPerTensor)
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "The quantized logits must be quantized per tensor.";
+  const auto quantization = logits.PerTensorQuantization();
+  return std::make_pair(quantization.scale,
+                        static_cast<int32_t>(quantization.zero_point));
+}
+
+// The parameters of the sampler the executor samples the logits with when no
+// sampler is given to it, i.e. greedily.
+proto::SamplerParameters GetInternalSamplerParams() {
+  proto::SamplerParameters sampler_params;
+  sampler_params.set_type(proto::SamplerParameters::TOP_P);
+  sampler_params.set_k(1);
+  sampler_params.set_p(0.0f);
+  sampler_params.set_temperature(1.0f);
+  sampler_params.set_seed(0);
+  return sampler_params;
+}
+
+// Accounts the memory of tensor buffers to the components, counting each
+// underlying buffer once whatever the number of its duplicates. The host
+// memory buffers are counted on the host, and the others, e.g. the OpenCL or
+// OpenGL buffers, on the device.
+class TensorBufferMemoryCounter {
+ public:
+  explicit TensorBufferMemoryCounter(MemoryUsage& memory_usage)
+      : memory_usage_(memory_usage) {}
+
+  void Add(absl::string_view component, const TensorBuffer& buffer) {
+    if (!counted_buffers_.insert(buffer.Get()).second) {
+      return;
+    }
+    auto size = buffer.Size();
+    if (!size) {
+      return;
+    }
+    auto buffer_type = buffer.BufferType();
+    const MemoryLocation location =
+        buffer_type && *buffer_type == kLiteRtTensorBufferTypeHostMemory
+            ? MemoryLocation::kHost
+            : MemoryLocation::kDevice;
+    memory_usage_.Add(component, location, *size);
+  }
+
+  template <typename Key>
+  void Add(absl::string_view component,
+           const absl::flat_hash_map<Key, TensorBuffer>& buffers) {
+    for (const auto& [name, buffer] : buffers) {
+      Add(component, buffer);
+    }
+  }
+
+  void Add(absl::string_view component,
+           const std::vector<TensorBuffer>& buffers) {
+    for (const TensorBuffer& buffer : buffers) {
+      Add(component, buffer);
+    }
+  }
+
+ private:
+  MemoryUsage& memory_usage_;
+  absl::flat_hash_set<LiteRtTensorBuffer> counted_buffers_;
+};
+
+// Returns a map holding duplicates of `buffers`.
+absl::StatusOr<absl::flat_hash_map<absl::string_view, TensorBuffer>>
+DuplicateBufferMap(
+    const absl::flat_hash_map<absl::string_view, TensorBuffer>& buffers) {
+  absl::flat_hash_map<absl::string_view, TensorBuffer> duplicated_buffers;
+  duplicated_buffers.reserve(buffers.size());
+  for (const auto& [name, buffer] : buffers) {
+    auto duplicated_buffer = buffer.Duplicate();
+    RET_CHECK(duplicated_buffer) << "Failed to duplicate buffer " << name;
+    duplicated_buffers[name] = std::move(*duplicated_buffer);
+  }
+  return duplicated_buffers;
+}
 
 }  // namespace
 
@@ -91,130 +215,183 @@ absl::Status LlmLiteRtCompiledModelExecutor::Prefill(
     const ExecutorInputs& inputs, const ExecutorPrefillParams& params) {
   LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type,
                                (*inputs.GetTextTokenIdsPtr())->TensorType());
-  // Only accept batch size 1 for now.
-  RET_CHECK_EQ(tensor_type.Layout().Dimensions()[0], 1);
-  RET_CHECK_GT(tensor_type.Layout().Dimensions()[1], 0)
-      << "Prefill token ids must be non-empty.";
+  const int input_batch_size = tensor_type.Layout().Dimensions()[0];
+  const int seq_len = tensor_type.Layout().Dimensions()[1];
+  // Each batch row is prefilled into its own kv-cache slot, so the batch size
+  // must match the one the model is built for. A single row is the shared
+  // prompt of all the output candidates, and is prefilled into every slot in
+  // the same invocations instead of once per candidate.
+  RET_CHECK(input_batch_size == output_batch_size_ || input_batch_size == 1)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Prefill batch size does not match the batch size of the model.";
+  RET_CHECK_GT(seq_len, 0) << "Prefill token ids must be non-empty.";
   LITERT_ASSIGN_OR_RETURN_ABSL(auto ids, ReferTensorBufferAsSpan<int32_t>(
                                              *(*inputs.GetTextTokenIdsPtr())));
+  const int batch_size = output_batch_size_;
+  if (input_batch_size != batch_size) {
+    prefill_broadcast_ids_.clear();
+    for (int b = 0; b < batch_size; ++b) {
+      prefill_broadcast_ids_.insert(prefill_broadcast_ids_.end(), ids.begin(),
+                                    ids.end());
+    }
+    ids = absl::MakeSpan(prefill_broadcast_ids_);
+  }
 
-  ASSIGN_OR_RETURN(auto work_groups, GetOptimizedPrefillWorkGroups(
-                                         prefill_signature_map_, ids.size()));
+  ASSIGN_OR_RETURN(
+      auto work_groups,
+      prefill_signature_costs_.has_value()
+          ? GetOptimizedPrefillWorkGroups(prefill_signature_map_, seq_len,
+                                          *prefill_signature_costs_)
+          : GetOptimizedPrefillWorkGroups(prefill_signature_map_, seq_len));
+  if (signatures_.input_tokens.empty()) {
+    // If input_tokens is empty, we must have input_embeddings.
+    if (!signatures_.input_embeddings.has_value()) {
+      return absl::FailedPreconditionError(
+          "Input tokens or embeddings must be provided.");
+    }
+    if (embedding_lookup_ == nullptr) {
+      return absl::FailedPreconditionError(
+          "Input embeddings required by signature but embedding lookup "
+          "model is not initialized.");
+    }
+    if (signatures_.input_per_layer_embeddings.has_value() &&
+        per_layer_embedding_lookup_ == nullptr) {
+      return absl::FailedPreconditionError(
+          "Input per layer embeddings required by signature but embedding "
+          "lookup model is not initialized.");
+    }
+  }
+  prefill_external_embeddings_ = {};
+  num_prefilled_external_embeddings_ = 0;
+  if (auto external_embeddings = inputs.GetVisionEmbeddingsPtr();
+      external_embeddings.ok()) {
+    RET_CHECK(signatures_.input_tokens.empty())
+            .SetCode(absl::StatusCode::kUnimplemented)
+        << "External embeddings require a model taking input embeddings.";
+    RET_CHECK_EQ(batch_size, 1).SetCode(absl::StatusCode::kUnimplemented)
+        << "Batched prefill is not supported with external embeddings.";
+    RET_CHECK_NE(ids.back(), ExecutorVisionData::kSpecialToken)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The last id to prefill must not be an embedding placeholder.";
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        prefill_external_embeddings_,
+        ReferTensorBufferAsSpan<float>(**external_embeddings));
+    const size_t num_placeholders =
+        std::count(ids.begin(), ids.end(), ExecutorVisionData::kSpecialToken);
+    RET_CHECK_EQ(prefill_external_embeddings_.size(),
+                 num_placeholders * embedding_lookup_->GetFloatsPerToken())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Expected one external embedding per placeholder id.";
+  }
+  const std::atomic_bool* cancel = params.GetCancelFlag();
+  int offset = 0;
   for (const auto& [prefill_signature, prefill_length] : work_groups) {
-    // Create input_token, positions and attn_mask buffers after determining
-    // the prefill length.
-    if (!signatures_.input_tokens.empty()) {
-      auto tokens_buffer = compiled_model_.CreateInputBuffer(
-          prefill_signature, signatures_.input_tokens);
-      prefill_input_buffers_[signatures_.input_tokens] =
-          std::move(*tokens_buffer);
+    // Each work group is prefilled whole, so a stopped prefill leaves the
+    // executor right after the last one done.
+    if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+      return absl::CancelledError("The prefill is cancelled.");
+    }
+    if (absl::Now() >= params.GetDeadline()) {
+      return absl::DeadlineExceededError("The prefill deadline is exceeded.");
+    }
+    if (batch_size == 1) {
+      RETURN_IF_ERROR(PrefillInternal(
+          prefill_signature, ids.subspan(offset, prefill_length),
+          /*batch_size=*/1, params.GetWaitForCompletion()));
     } else {
-      // If input_tokens is empty, we must have input_embeddings.
-      if (!signatures_.input_embeddings.has_value()) {
-        return absl::FailedPreconditionError(
-            "Input tokens or embeddings must be provided.");
-      }
-      if (embedding_lookup_ == nullptr) {
-        return absl::FailedPreconditionError(
-            "Input embeddings required by signature but embedding lookup "
-            "model is not initialized.");
-      }
-      auto embeddings_buffer = compiled_model_.CreateInputBuffer(
-          prefill_signature, signatures_.input_embeddings.value());
-      prefill_input_buffers_[signatures_.input_embeddings.value()] =
-          std::move(*embeddings_buffer);
-
-      // We may have per layer embedding as well.
-      if (signatures_.input_per_layer_embeddings.has_value()) {
-        if (embedding_lookup_ == nullptr) {
-          return absl::FailedPreconditionError(
-              "Input per layer embeddings required by signature but embedding "
-              "lookup model is not initialized.");
-        }
-        auto per_layer_embeddings_buffer = compiled_model_.CreateInputBuffer(
-            prefill_signature, signatures_.input_per_layer_embeddings.value());
-        prefill_input_buffers_[signatures_.input_per_layer_embeddings.value()] =
-            std::move(*per_layer_embeddings_buffer);
+      // Gather the columns of this work group from every batch row.
+      prefill_batch_ids_.clear();
+      for (int b = 0; b < batch_size; ++b) {
+        auto row = ids.subspan(b * seq_len + offset, prefill_length);
+        prefill_batch_ids_.insert(prefill_batch_ids_.end(), row.begin(),
+                                  row.end());
       }
+      RETURN_IF_ERROR(PrefillInternal(prefill_signature, prefill_batch_ids_,
+                                      batch_size,
+                                      params.GetWaitForCompletion()));
     }
-    auto positions_buffer = compiled_model_.CreateInputBuffer(
-        prefill_signature, signatures_.input_positions);
-    prefill_input_buffers_[signatures_.input_positions] =
-        std::move(*positions_buffer);
-
-    if (signatures_.input_attn_mask.has_value()) {
-      auto attn_mask_buffer = compiled_model_.CreateInputBuffer(
-          prefill_signature, signatures_.input_attn_mask.value());
-      prefill_input_buffers_[signatures_.input_attn_mask.value()] =
-          std::move(*attn_mask_buffer);
-    }
-    RETURN_IF_ERROR(PrefillInternal(prefill_signature,
-                                    ids.subspan(/*pos=*/0, prefill_length)));
-    ids = ids.subspan(/*pos=*/prefill_length);
+    offset += prefill_length;
   }
-  RET_CHECK_EQ(ids.size(), 0).SetCode(absl::StatusCode::kInternal)
+  RET_CHECK_EQ(offset, seq_len).SetCode(absl::StatusCode::kInternal)
       << "Work groups not covering the entire prefill input.";
+  if (weight_cache_ != nullptr) {
+    // The delegate has written the cache by the first successful run. A
+    // no-op if the cache was already valid or is built by another process.
+    absl::Status status = weight_cache_->Commit();
+    if (!status.ok()) {
+      ABSL_LOG(WARNING) << "Failed to commit the weight cache: " << status;
+    }
+    weight_cache_.reset();
+  }
   return absl::OkStatus();
 }
 
 absl::Status LlmLiteRtCompiledModelExecutor::PrefillInternal(
-    absl::string_view prefill_signature, Span<const int> ids) {
+    absl::string_view prefill_signature, Span<const int> ids, int batch_size,
+    bool wait_for_completion) {
+  LITERT_LM_TRACE_SCOPE("prefill_work_group");
+  const absl::Time prepare_start = absl::Now();
+  const int num_ids = ids.size() / batch_size;
+  const bool has_pending_ids = !next_input_token_ids_.empty();
+  // We will not fill the last token of each row into the interpreter now. It
+  // will be stored in next_input_token_ids_ and used in the next prefill or
+  // decode.
+  // TODO(b/425396146): Add the unit tests for checking the prefill length.
+  const int num_ids_to_fill = num_ids > 1 ? num_ids - 1 : num_ids;
+  // The pending next_input_token_ids_ are consumed in front of the ids.
+  const int steps = num_ids_to_fill + (has_pending_ids ? 1 : 0);
+  RETURN_IF_ERROR(ReserveKvCacheBlocks(current_step_ + steps));
+
+  ASSIGN_OR_RETURN(auto* signature_run_buffers,
+                   GetPrefillRunBuffers(prefill_signature));
+  RunBuffers& run_buffers = (*signature_run_buffers)[KvCacheParity()];
+  // The inputs of each parity are only refilled once the device is done with
+  // the run enqueued two work groups ago, which last read them.
+  const int input_parity = async_prefill_ ? KvCacheParity() : 0;
+  if (async_prefill_) {
+    RETURN_IF_ERROR(WaitForRunOutputs(run_buffers));
+  }
   {
     // Fill the input buffers with scoped locks.
-    auto& prefill_input_pos =
-        prefill_input_buffers_[signatures_.input_positions];
-    LITERT_ASSIGN_OR_RETURN_ABSL(auto prefill_input_pos_size,
-                                 prefill_input_pos.PackedSize());
-    LITERT_ASSIGN_OR_RETURN_ABSL(
-        auto prefill_input_pos_lock_and_addr,
-        ::litert::TensorBufferScopedLock::Create(
-            prefill_input_pos, TensorBuffer::LockMode::kWrite));
-    auto* prefill_input_pos_ptr =
-        static_cast<int32_t*>(prefill_input_pos_lock_and_addr.second);
     bool has_input_attn_mask = signatures_.input_attn_mask.has_value();
+    const int start_step = current_step_;
 
-    memset(prefill_input_pos_ptr, 0, prefill_input_pos_size);
-    if (has_input_attn_mask) {
-      RET_CHECK(signatures_.input_attn_mask_data_type.has_value())
-          << "Attention mask data type is not provided.";
-      RETURN_IF_ERROR(InitializeAttentionMask(
-          prefill_input_buffers_[signatures_.input_attn_mask.value()],
-          signatures_.input_attn_mask_data_type.value(),
-          IsCalculationPrecisionF16()));
-    }
-    // We will not fill the last token of the current input into the
-    // interpreter now. It will be stored in next_input_token_id_ and used in
-    // the next prefill or decode.
-    int start_step = current_step_;
-    std::vector<int> tokens_to_lookup;
-    // TODO(b/425396146): Add the unit tests for checking the prefill length.
-    int input_idx = 0;
-    int prefill_length = ids.size();
-    if (prefill_length > 1) {
-      // If the prefill length is larger than 1, we will not use the last token
-      // of the current input. Last token will be used as input in the next
-      // prefill.
-      prefill_length = ids.size() - 1;
-    }
-    for (int i = 0; i < prefill_length; input_idx++, current_step_++) {
-      if (next_input_token_id_ != -1) {
-        // Use next_input_token_id_ if it is valid.
-        // Currently we use -1 to indicate that next_input_token_id_ is
-        // invalid.
-        tokens_to_lookup.push_back(next_input_token_id_);
-        // next_input_token_id_ should only be used once at the beginning of
-        // the loop.
-        next_input_token_id_ = -1;
-      } else {
-        tokens_to_lookup.push_back(ids[input_idx]);
-        // Only increase i if we used the token inside ids.
-        i++;
-      }
-      prefill_input_pos_ptr[input_idx] = current_step_;
+    // All the rows are at the same timesteps. The positions input either has
+    // one row per batch row or a single row shared by all of them. A model
+    // taking step parameters has no positions input, and derives them on
+    // device from the start step and the number of steps instead.
+    int32_t* prefill_input_pos_ptr = nullptr;
+    size_t prefill_input_pos_size = 0;
+    int num_pos_rows = 0;
+    int pos_row_size = 0;
+    std::optional<std::pair<::litert::TensorBufferScopedLock, void*>>
+        prefill_input_pos_lock_and_addr;
+    if (run_buffers.input_step_params >= 0) {
+      RETURN_IF_ERROR(FillStepParams(
+          run_buffers.inputs[run_buffers.input_step_params], start_step,
+          steps));
+    } else {
+      auto& prefill_input_pos =
+          run_buffers.inputs[run_buffers.input_positions];
+      LITERT_ASSIGN_OR_RETURN_ABSL(prefill_input_pos_size,
+                                   prefill_input_pos.PackedSize());
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto lock_and_addr,
+          ::litert::TensorBufferScopedLock::Create(
+              prefill_input_pos, TensorBuffer::LockMode::kWrite));
+      prefill_input_pos_lock_and_addr.emplace(std::move(lock_and_addr));
+      prefill_input_pos_ptr =
+          static_cast<int32_t*>(prefill_input_pos_lock_and_addr->second);
+      LITERT_ASSIGN_OR_RETURN_ABSL(auto prefill_input_pos_type,
+                                   prefill_input_pos.TensorType());
+      const auto& pos_dims = prefill_input_pos_type.Layout().Dimensions();
+      num_pos_rows =
+          pos_dims.size() > 1 && pos_dims[0] == batch_size ? batch_size : 1;
+      pos_row_size = prefill_input_pos_size / sizeof(int32_t) / num_pos_rows;
     }
+    current_step_ += steps;
     if (!signatures_.input_tokens.empty()) {
-      auto& prefill_input_buffer =
-          prefill_input_buffers_[signatures_.input_tokens];
+      auto& prefill_input_buffer = run_buffers.inputs[run_buffers.input_tokens];
       LITERT_ASSIGN_OR_RETURN_ABSL(auto prefill_input_size,
                                    prefill_input_buffer.PackedSize());
       LITERT_ASSIGN_OR_RETURN_ABSL(
@@ -223,90 +400,179 @@ absl::Status LlmLiteRtCompiledModelExecutor::PrefillInternal(
               prefill_input_buffer, TensorBuffer::LockMode::kWrite));
       int32_t* prefill_input_ptr =
           static_cast<int32_t*>(prefill_input_lock_and_addr.second);
-      memset(prefill_input_ptr, 0, prefill_input_size);
-      memcpy(prefill_input_ptr, tokens_to_lookup.data(),
-             tokens_to_lookup.size() * sizeof(int32_t));
+      const int row_size = prefill_input_size / sizeof(int32_t) / batch_size;
+      // The ids and positions are written straight from `ids` in one pass,
+      // with the pending id in front of each row, and only the padding after
+      // the steps is cleared.
+      for (int b = 0; b < batch_size; ++b) {
+        int32_t* input_row = prefill_input_ptr + b * row_size;
+        int32_t* pos_row = b < num_pos_rows
+                               ? prefill_input_pos_ptr + b * pos_row_size
+                               : nullptr;
+        if (has_pending_ids) {
+          input_row[0] = next_input_token_ids_[b];
+        }
+        const int* row = ids.data() + b * num_ids;
+        std::copy(row, row + num_ids_to_fill,
+                  input_row + (has_pending_ids ? 1 : 0));
+        std::fill(input_row + steps, input_row + row_size, 0);
+        if (pos_row != nullptr) {
+          for (int i = 0; i < steps; ++i) {
+            pos_row[i] = start_step + i;
+          }
+          std::fill(pos_row + steps, pos_row + pos_row_size, 0);
+        }
+      }
     } else {
+      if (prefill_input_pos_ptr != nullptr) {
+        memset(prefill_input_pos_ptr, 0, prefill_input_pos_size);
+      }
+      for (int r = 0; r < num_pos_rows; ++r) {
+        for (int i = 0; i < steps; ++i) {
+          prefill_input_pos_ptr[r * pos_row_size + i] = start_step + i;
+        }
+      }
+      // The tokens to look up, laid out as [batch_size, steps].
+      std::vector<int>& tokens_to_lookup = prefill_tokens_to_lookup_;
+      tokens_to_lookup.clear();
+      for (int b = 0; b < batch_size; ++b) {
+        if (has_pending_ids) {
+          tokens_to_lookup.push_back(next_input_token_ids_[b]);
+        }
+        auto row = ids.subspan(b * num_ids, num_ids_to_fill);
+        tokens_to_lookup.insert(tokens_to_lookup.end(), row.begin(),
+                                row.end());
+      }
       // If input_tokens is empty, we must have input_embeddings. There is no
       // need to create input_embeddings_ptr because TensorBuffer locking and
       // filling is handled by the embedding lookup.
+      RET_CHECK_EQ(batch_size, 1).SetCode(absl::StatusCode::kUnimplemented)
+          << "Batched prefill is not supported with input embeddings.";
       TensorBuffer* prefill_input_embeddings_buffer =
-          &(prefill_input_buffers_[signatures_.input_embeddings.value()]);
-      RETURN_IF_ERROR(embedding_lookup_->LookupPrefill(
-          tokens_to_lookup, prefill_input_embeddings_buffer, 0));
-
+          &(run_buffers.inputs[run_buffers.input_embeddings]);
+      LITERT_LM_TRACE_SCOPE("embedding_lookup");
+      // The placeholders are prefilled in order, including a pending one
+      // left by the previous work group.
+      const size_t num_placeholders =
+          prefill_external_embeddings_.empty()
+              ? 0
+              : std::count(tokens_to_lookup.begin(), tokens_to_lookup.end(),
+                           ExecutorVisionData::kSpecialToken);
+      const size_t floats_per_token = embedding_lookup_->GetFloatsPerToken();
+      auto lookup = [&]() {
+        return embedding_lookup_->LookupPrefillWithPlaceholders(
+            tokens_to_lookup, ExecutorVisionData::kSpecialToken,
+            prefill_external_embeddings_.subspan(
+                num_prefilled_external_embeddings_ * floats_per_token,
+                num_placeholders * floats_per_token),
+            prefill_input_embeddings_buffer, 0);
+      };
       // We may have per layer embedding as well.
+      std::function<absl::Status()> per_layer_lookup;
       if (signatures_.input_per_layer_embeddings.has_value()) {
         TensorBuffer* prefill_input_per_layer_embeddings_buffer =
-            &(prefill_input_buffers_[signatures_.input_per_layer_embeddings
-                                         .value()]);
-        RETURN_IF_ERROR(per_layer_embedding_lookup_->LookupPrefill(
-            tokens_to_lookup, prefill_input_per_layer_embeddings_buffer, 0));
+            &(run_buffers.inputs[run_buffers.input_per_layer_embeddings]);
+        per_layer_lookup = [&, prefill_input_per_layer_embeddings_buffer]() {
+          return per_layer_embedding_lookup_->LookupPrefill(
+              tokens_to_lookup, prefill_input_per_layer_embeddings_buffer, 0);
+        };
       }
+      RETURN_IF_ERROR(RunEmbeddingLookups(lookup, per_layer_lookup));
+      num_prefilled_external_embeddings_ += num_placeholders;
     }
     if (has_input_attn_mask) {
-      RETURN_IF_ERROR(FillAttentionMask(
-          prefill_input_buffers_[signatures_.input_attn_mask.value()],
-          start_step,
-          /*steps=*/current_step_ - start_step,
-          signatures_.input_attn_mask_data_type.value()));
-    }
-  }
-  next_input_token_id_ = ids[ids.size() - 1];
-
-  absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>
-      prefill_input_buffers;
-  for (const auto& [input_name, input_buffer] : prefill_input_buffers_) {
-    auto duplicated_input_buffer = input_buffer.Duplicate();
-    RET_CHECK(duplicated_input_buffer) << "Failed to duplicate input buffer.";
-    prefill_input_buffers[input_name] = std::move(*duplicated_input_buffer);
-  }
-  for (const auto& [input_name, input_buffer] : *input_kv_cache_buffers_) {
-    auto duplicated_input_buffer = input_buffer.Duplicate();
-    RET_CHECK(duplicated_input_buffer) << "Failed to duplicate input buffer.";
-    prefill_input_buffers[input_name] = std::move(*duplicated_input_buffer);
-  }
-  absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>
-      prefill_output_buffers;
-  for (const auto& [output_name, output_buffer] : prefill_output_buffers_) {
-    auto duplicated_output_buffer = output_buffer.Duplicate();
-    RET_CHECK(duplicated_output_buffer) << "Failed to duplicate output buffer.";
-    prefill_output_buffers[output_name] = std::move(*duplicated_output_buffer);
-  }
-  for (const auto& [output_name, output_buffer] : *output_kv_cache_buffers_) {
-    auto duplicated_output_buffer = output_buffer.Duplicate();
-    RET_CHECK(duplicated_output_buffer) << "Failed to duplicate output buffer.";
-    prefill_output_buffers[output_name] = std::move(*duplicated_output_buffer);
-  }
-
-  auto res = compiled_model_.Run(prefill_signature, prefill_input_buffers,
-                                 prefill_output_buffers);
-  RET_CHECK(res) << "Failed to run compiled model." << res.Error().Message();
+      RETURN_IF_ERROR(UpdateAttentionMaskForSteps(
+          run_buffers.inputs[run_buffers.input_attn_mask],
+          prefill_attention_masks_[prefill_signature][input_parity],
+          start_step, steps));
+    }
+  }
+  next_input_token_ids_.resize(batch_size);
+  for (int b = 0; b < batch_size; ++b) {
+    next_input_token_ids_[b] = ids[(b + 1) * num_ids - 1];
+  }
+  RecordStageLatency(kPrefillPrepareInputsStage, prepare_start);
+
+  LITERT_LM_TRACE_SCOPE("compiled_model_run");
+  const absl::Time inference_start = absl::Now();
+  if (async_prefill_ && !wait_for_completion) {
+    // The run is only enqueued, so the inference stage times the enqueueing.
+    // The outputs get the events the reads of the host wait for, and the next
+    // runs are ordered after this one by the queue of the delegate.
+    bool async = false;
+    auto res = compiled_model_.RunAsync(run_buffers.signature_index,
+                                        run_buffers.inputs, run_buffers.outputs,
+                                        async);
+    RET_CHECK(res) << "Failed to run compiled model asynchronously."
+                   << res.Error().Message();
+  } else {
+    RETURN_IF_ERROR(RunSignature(run_buffers, kPrefillDeviceStage));
+  }
   std::swap(input_kv_cache_buffers_, output_kv_cache_buffers_);
+  RecordStageLatency(kPrefillInferenceStage, inference_start);
+  TrimModelMemory();
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::UpdateAttentionMaskForSteps(
+    ::litert::TensorBuffer& mask, AttentionMaskState& state, int start_step,
+    int steps) {
+  RET_CHECK(signatures_.input_attn_mask_data_type.has_value())
+      << "Attention mask data type is not provided.";
+  const AttentionMaskDataType mask_data_type =
+      signatures_.input_attn_mask_data_type.value();
+  if (!state.initialized) {
+    RETURN_IF_ERROR(InitializeAttentionMask(mask, mask_data_type,
+                                            mask_precision_f16_));
+    state.initialized = true;
+    state.start_step = 0;
+    state.steps = 0;
+  }
+  RETURN_IF_ERROR(UpdateAttentionMask(mask, state.start_step, state.steps,
+                                      start_step, steps, mask_data_type,
+                                      mask_precision_f16_));
+  state.start_step = start_step;
+  state.steps = steps;
   return absl::OkStatus();
 }
 
 absl::Status LlmLiteRtCompiledModelExecutor::Decode(
     ::litert::TensorBuffer& output_tokens) {
-  ASSIGN_OR_RETURN(decoded_logits_, DecodeLogits(ExecutorInputs()));
-  LITERT_ASSIGN_OR_RETURN_ABSL(auto size, decoded_logits_.PackedSize());
-  if (decoded_logits_vector_.empty()) {
-    decoded_logits_vector_ = std::vector<float>(size / sizeof(float));
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto output_tokens_type,
+                               output_tokens.TensorType());
+  const auto& output_tokens_dims = output_tokens_type.Layout().Dimensions();
+  const int num_steps =
+      output_tokens_dims.size() > 1 ? output_tokens_dims[1] : 1;
+  if (num_steps > 1) {
+    RET_CHECK(!signatures_.input_tokens.empty())
+            .SetCode(absl::StatusCode::kUnimplemented)
+        << "Multi-step decode is not supported with input embeddings.";
+    return DecodeSteps(num_steps, output_tokens);
   }
-  RETURN_IF_ERROR(SampleLogits(decoded_logits_, output_tokens));
 
-  // Read the first output token for the next input token id.
+  // The logits are sampled where the model wrote them, so that with the GPU
+  // sampler only the sampled ids are read back to host memory.
+  ASSIGN_OR_RETURN(TensorBuffer * logits, DecodeInternal(ExecutorInputs()));
+  const absl::Time sampling_start = absl::Now();
+  RETURN_IF_ERROR(SampleLogits(*logits, output_tokens));
+  RecordStageLatency(kDecodeSamplingStage, sampling_start);
+
+  // Read the output tokens of every batch row for the next input token ids.
   bool reset_output_token = false;
   {
     LITERT_ASSIGN_OR_RETURN_ABSL(
         auto lock_and_addr, ::litert::TensorBufferScopedLock::Create(
                                 output_tokens, TensorBuffer::LockMode::kRead));
     auto output_tokens_ptr = static_cast<int32_t*>(lock_and_addr.second);
-    reset_output_token = output_tokens_ptr[0] < 0;
-    next_input_token_id_ = reset_output_token ? 0 : output_tokens_ptr[0];
+    next_input_token_ids_.resize(output_batch_size_);
+    for (int b = 0; b < output_batch_size_; ++b) {
+      reset_output_token |= output_tokens_ptr[b] < 0;
+      next_input_token_ids_[b] =
+          output_tokens_ptr[b] < 0 ? 0 : output_tokens_ptr[b];
+    }
   }
 
-  // If the first output token is invalid, reset it to 0 to avoid crash.
+  // If an output token is invalid, reset it to 0 to avoid crash.
   if (reset_output_token) {
     LITERT_ASSIGN_OR_RETURN_ABSL(
         auto lock_and_addr, ::litert::TensorBufferScopedLock::Create(
@@ -314,249 +580,321 @@ absl::Status LlmLiteRtCompiledModelExecutor::Decode(
     ABSL_LOG(WARNING) << "Invalid decode and sample result. The sampled token "
                          "is casted to 0 to avoid crash.";
     auto output_tokens_ptr = static_cast<int32_t*>(lock_and_addr.second);
-    output_tokens_ptr[0] = 0;
+    for (int b = 0; b < output_batch_size_; ++b) {
+      output_tokens_ptr[b] = next_input_token_ids_[b];
+    }
   }
   return absl::OkStatus();
 }
 
-absl::Status LlmLiteRtCompiledModelExecutor::Decode(
-    const ExecutorInputs& inputs, ::litert::TensorBuffer& output_logits) {
-  int id = next_input_token_id_;
+absl::Status LlmLiteRtCompiledModelExecutor::DecodeSteps(
+    int num_steps, ::litert::TensorBuffer& output_tokens) {
+  // The sampled ids of every step stay in buffers of the model input type, so
+  // that a step is fed the ids sampled by the previous one without a round
+  // trip through the host. The buffers are kept for the later calls.
+  while (decode_step_token_ids_.size() < num_steps) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto step_token_ids,
+        compiled_model_.CreateInputBuffer(kDecodeSignatureRunner,
+                                          signatures_.input_tokens));
+    decode_step_token_ids_.push_back(std::move(step_token_ids));
+  }
+  RETURN_IF_ERROR(ReserveKvCacheBlocks(current_step_ + num_steps));
 
-  if (inputs.GetTextDataPtr().ok()) {
-    auto input_tensor_size = (*inputs.GetTextTokenIdsPtr())->PackedSize();
-    if (input_tensor_size && *input_tensor_size != 0) {
-      // Input token ids provided, so use it regardless of whether next input
-      // token id is set. Only accept batch size 1 and a single token for now.
-      RET_CHECK_EQ(*input_tensor_size, 1 * sizeof(int32_t));
+  for (int step = 0; step < num_steps; ++step) {
+    LITERT_LM_TRACE_SCOPE("decode_step");
+    const absl::Time prepare_start = absl::Now();
+    RunBuffers& run_buffers = GetDecodeRunBuffers();
+    ::litert::TensorBuffer bound_token_ids;
+    if (step == 0) {
+      // The first step is fed the pending input tokens from the host.
+      RETURN_IF_ERROR(FillDecodeInputs(ExecutorInputs()));
+    } else {
+      RETURN_IF_ERROR(FillDecodePositions());
       LITERT_ASSIGN_OR_RETURN_ABSL(
-          auto ids,
-          ReferTensorBufferAsSpan<int32_t>(*(*inputs.GetTextTokenIdsPtr())));
-      id = ids[0];
+          bound_token_ids, decode_step_token_ids_[step - 1].Duplicate());
+      std::swap(run_buffers.inputs[run_buffers.input_tokens], bound_token_ids);
     }
+    RecordStageLatency(kDecodePrepareInputsStage, prepare_start);
+    const absl::Time inference_start = absl::Now();
+    absl::Status status = RunSignature(run_buffers, kDecodeDeviceStage);
+    if (step > 0) {
+      std::swap(run_buffers.inputs[run_buffers.input_tokens], bound_token_ids);
+    }
+    RETURN_IF_ERROR(status);
+    std::swap(input_kv_cache_buffers_, output_kv_cache_buffers_);
+    ++current_step_;
+    RecordStageLatency(kDecodeInferenceStage, inference_start);
+    TrimModelMemory();
+    if (step == 0) {
+      MaybeReleasePrefillRunBuffers();
+    }
+    const absl::Time sampling_start = absl::Now();
+    RETURN_IF_ERROR(SampleLogits(run_buffers.outputs[run_buffers.output_logits],
+                                 decode_step_token_ids_[step]));
+    RecordStageLatency(kDecodeSamplingStage, sampling_start);
   }
-  if (id == -1) {
-    return absl::InvalidArgumentError("No id available to be decoded.");
-  }
-
-  // Invalidate the previous next_input_token_id_, regardless of whether it is
-  // used.
-  next_input_token_id_ = -1;
-
-  {
-    // Fill the input buffers with scoped locks.
-    if (!signatures_.input_tokens.empty()) {
-      auto& decode_input_buffer =
-          decode_input_buffers_[signatures_.input_tokens];
-      auto decode_input_lock_and_addr =
-          ::litert::TensorBufferScopedLock::Create(
-              decode_input_buffer, TensorBuffer::LockMode::kWrite);
-      RET_CHECK(decode_input_lock_and_addr)
-          << "Failed to lock decode input buffer.";
-      int32_t* decode_input_ptr =
-          static_cast<int32_t*>(decode_input_lock_and_addr->second);
-      decode_input_ptr[0] = id;
-    } else {
-      if (!signatures_.input_embeddings.has_value()) {
-        return absl::InvalidArgumentError(
-            "Input tokens or embeddings must be provided.");
-      }
-      auto& decode_input_embeddings_buffer =
-          decode_input_buffers_[signatures_.input_embeddings.value()];
-      RETURN_IF_ERROR(
-          embedding_lookup_->LookupDecode(id, &decode_input_embeddings_buffer));
 
-      if (signatures_.input_per_layer_embeddings.has_value()) {
-        auto& decode_input_per_layer_embeddings_buffer =
-            decode_input_buffers_[signatures_.input_per_layer_embeddings
-                                      .value()];
-        RETURN_IF_ERROR(per_layer_embedding_lookup_->LookupDecode(
-            id, &decode_input_per_layer_embeddings_buffer));
-      }
-    }
-    auto& decode_input_pos_buffer =
-        decode_input_buffers_[signatures_.input_positions];
-    auto decode_input_pos_lock_and_addr =
+  // Synchronize with the host once, when reading back the ids of all the
+  // steps.
+  LITERT_ASSIGN_OR_RETURN_ABSL(
+      auto output_lock_and_addr,
+      ::litert::TensorBufferScopedLock::Create(output_tokens,
+                                               TensorBuffer::LockMode::kWrite));
+  auto* output_tokens_ptr = static_cast<int32_t*>(output_lock_and_addr.second);
+  bool reset_output_token = false;
+  next_input_token_ids_.resize(output_batch_size_);
+  for (int step = 0; step < num_steps; ++step) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto step_lock_and_addr,
         ::litert::TensorBufferScopedLock::Create(
-            decode_input_pos_buffer, TensorBuffer::LockMode::kWrite);
-    RET_CHECK(decode_input_pos_lock_and_addr)
-        << "Failed to lock decode input position buffer.";
-    auto* decode_input_pos_ptr =
-        static_cast<int32_t*>(decode_input_pos_lock_and_addr->second);
-    bool has_input_attn_mask = signatures_.input_attn_mask.has_value();
-    if (has_input_attn_mask) {
-      RET_CHECK(signatures_.input_attn_mask_data_type.has_value())
-          << "Attention mask data type is not provided.";
-      RETURN_IF_ERROR(InitializeAttentionMask(
-          decode_input_buffers_[signatures_.input_attn_mask.value()],
-          signatures_.input_attn_mask_data_type.value(),
-          IsCalculationPrecisionF16()));
-      RETURN_IF_ERROR(FillAttentionMask(
-          decode_input_buffers_[signatures_.input_attn_mask.value()],
-          current_step_, /*steps=*/1,
-          signatures_.input_attn_mask_data_type.value()));
-    }
-    decode_input_pos_ptr[0] = current_step_;
-  }
-
-  absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>
-      decode_input_buffers;
-  for (const auto& [input_name, input_buffer] : decode_input_buffers_) {
-    auto duplicated_input_buffer = input_buffer.Duplicate();
-    RET_CHECK(duplicated_input_buffer) << "Failed to duplicate input buffer.";
-    decode_input_buffers[input_name] = std::move(*duplicated_input_buffer);
-  }
-  for (const auto& [input_name, input_buffer] : *input_kv_cache_buffers_) {
-    auto duplicated_input_buffer = input_buffer.Duplicate();
-    RET_CHECK(duplicated_input_buffer) << "Failed to duplicate input buffer.";
-    decode_input_buffers[input_name] = std::move(*duplicated_input_buffer);
-  }
-  absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>
-      decode_output_buffers;
-  for (const auto& [output_name, output_buffer] : decode_output_buffers_) {
-    auto duplicated_output_buffer = output_name == signatures_.output_logits
-                                        ? output_logits.Duplicate()
-                                        : output_buffer.Duplicate();
-    RET_CHECK(duplicated_output_buffer) << "Failed to duplicate output buffer.";
-    decode_output_buffers[output_name] = std::move(*duplicated_output_buffer);
-  }
-  for (const auto& [output_name, output_buffer] : *output_kv_cache_buffers_) {
-    auto duplicated_output_buffer = output_buffer.Duplicate();
-    RET_CHECK(duplicated_output_buffer) << "Failed to duplicate output buffer.";
-    decode_output_buffers[output_name] = std::move(*duplicated_output_buffer);
-  }
-
-  auto res = compiled_model_.Run(kDecodeSignatureRunner, decode_input_buffers,
-                                 decode_output_buffers);
-  RET_CHECK(res) << "Failed to run compiled model: " << res.Error().Message();
-  std::swap(input_kv_cache_buffers_, output_kv_cache_buffers_);
-
-  ++current_step_;
+            decode_step_token_ids_[step], TensorBuffer::LockMode::kRead));
+    auto* step_token_ids_ptr =
+        static_cast<const int32_t*>(step_lock_and_addr.second);
+    for (int b = 0; b < output_batch_size_; ++b) {
+      // If an output token is invalid, reset it to 0 to avoid crash.
+      reset_output_token |= step_token_ids_ptr[b] < 0;
+      const int token_id =
+          step_token_ids_ptr[b] < 0 ? 0 : step_token_ids_ptr[b];
+      output_tokens_ptr[b * num_steps + step] = token_id;
+      next_input_token_ids_[b] = token_id;
+    }
+  }
+  if (reset_output_token) {
+    ABSL_LOG(WARNING) << "Invalid decode and sample result. The sampled token "
+                         "is casted to 0 to avoid crash.";
+  }
   return absl::OkStatus();
 }
 
-absl::StatusOr<::litert::TensorBuffer>
-LlmLiteRtCompiledModelExecutor::DecodeLogits(const ExecutorInputs& inputs) {
-  int id = next_input_token_id_;
+absl::Status LlmLiteRtCompiledModelExecutor::FillDecodeInputs(
+    const ExecutorInputs& inputs) {
+  std::vector<int> ids = next_input_token_ids_;
 
   if (inputs.GetTextDataPtr().ok()) {
     auto input_tensor_size = (*inputs.GetTextTokenIdsPtr())->PackedSize();
     if (input_tensor_size && *input_tensor_size != 0) {
-      // Input token ids provided, so use it regardless of whether next input
-      // token id is set. Only accept batch size 1 and a single token for now.
-      RET_CHECK_EQ(*input_tensor_size, 1 * sizeof(int32_t));
+      // Input token ids provided, so use them regardless of whether next input
+      // token ids are set. Only accept a single token per batch row for now.
+      RET_CHECK_EQ(*input_tensor_size, output_batch_size_ * sizeof(int32_t));
       LITERT_ASSIGN_OR_RETURN_ABSL(
-          auto ids,
+          auto input_ids,
           ReferTensorBufferAsSpan<int32_t>(*(*inputs.GetTextTokenIdsPtr())));
-      id = ids[0];
+      ids.assign(input_ids.begin(), input_ids.end());
     }
   }
-  if (id == -1) {
+  if (ids.empty()) {
     return absl::InvalidArgumentError("No id available to be decoded.");
   }
 
-  // Invalidate the previous next_input_token_id_, regardless of whether it is
-  // used.
-  next_input_token_id_ = -1;
+  RETURN_IF_ERROR(ReserveKvCacheBlocks(current_step_ + 1));
 
-  {
-    // Fill the input buffers with scoped locks.
-    if (!signatures_.input_tokens.empty()) {
-      auto& decode_input_buffer =
-          decode_input_buffers_[signatures_.input_tokens];
-      auto decode_input_lock_and_addr =
-          ::litert::TensorBufferScopedLock::Create(
-              decode_input_buffer, TensorBuffer::LockMode::kWrite);
-      RET_CHECK(decode_input_lock_and_addr)
-          << "Failed to lock decode input buffer.";
-      int32_t* decode_input_ptr =
-          static_cast<int32_t*>(decode_input_lock_and_addr->second);
-      decode_input_ptr[0] = id;
-    } else {
-      if (!signatures_.input_embeddings.has_value()) {
-        return absl::InvalidArgumentError(
-            "Input tokens or embeddings must be provided.");
-      }
-      auto& decode_embeddings_buffer =
-          decode_input_buffers_[signatures_.input_embeddings.value()];
-      RETURN_IF_ERROR(
-          embedding_lookup_->LookupDecode(id, &decode_embeddings_buffer));
+  // Invalidate the previous next_input_token_ids_, regardless of whether they
+  // are used.
+  next_input_token_ids_.clear();
 
-      if (signatures_.input_per_layer_embeddings.has_value()) {
-        auto& decode_input_per_layer_embeddings_buffer =
-            decode_input_buffers_[signatures_.input_per_layer_embeddings
-                                      .value()];
-        RETURN_IF_ERROR(per_layer_embedding_lookup_->LookupDecode(
-            id, &decode_input_per_layer_embeddings_buffer));
-      }
+  // Fill the input buffers with scoped locks. The run buffers of both
+  // parities share the memory of the decode inputs.
+  RunBuffers& run_buffers = GetDecodeRunBuffers();
+  if (!signatures_.input_tokens.empty()) {
+    auto& decode_input_buffer = run_buffers.inputs[run_buffers.input_tokens];
+    auto decode_input_lock_and_addr = ::litert::TensorBufferScopedLock::Create(
+        decode_input_buffer, TensorBuffer::LockMode::kWrite);
+    RET_CHECK(decode_input_lock_and_addr)
+        << "Failed to lock decode input buffer.";
+    int32_t* decode_input_ptr =
+        static_cast<int32_t*>(decode_input_lock_and_addr->second);
+    memcpy(decode_input_ptr, ids.data(), ids.size() * sizeof(int32_t));
+  } else {
+    if (!signatures_.input_embeddings.has_value()) {
+      return absl::InvalidArgumentError(
+          "Input tokens or embeddings must be provided.");
+    }
+    RET_CHECK_EQ(ids.size(), 1).SetCode(absl::StatusCode::kUnimplemented)
+        << "Batched decode is not supported with input embeddings.";
+    auto& decode_input_embeddings_buffer =
+        run_buffers.inputs[run_buffers.input_embeddings];
+    LITERT_LM_TRACE_SCOPE("embedding_lookup");
+    auto lookup = [&]() {
+      return embedding_lookup_->LookupDecode(ids[0],
+                                             &decode_input_embeddings_buffer);
+    };
+    std::function<absl::Status()> per_layer_lookup;
+    if (signatures_.input_per_layer_embeddings.has_value()) {
+      auto& decode_input_per_layer_embeddings_buffer =
+          run_buffers.inputs[run_buffers.input_per_layer_embeddings];
+      per_layer_lookup = [&]() {
+        return per_layer_embedding_lookup_->LookupDecode(
+            ids[0], &decode_input_per_layer_embeddings_buffer);
+      };
     }
+    RETURN_IF_ERROR(RunEmbeddingLookups(lookup, per_layer_lookup));
+  }
+  return FillDecodePositions();
+}
 
-    auto& decode_input_pos_buffer =
-        decode_input_buffers_[signatures_.input_positions];
-    auto decode_input_pos_lock_and_addr =
-        ::litert::TensorBufferScopedLock::Create(
-            decode_input_pos_buffer, TensorBuffer::LockMode::kWrite);
-    RET_CHECK(decode_input_pos_lock_and_addr)
-        << "Failed to lock decode input position buffer.";
-    auto* decode_input_pos_ptr =
-        static_cast<int32_t*>(decode_input_pos_lock_and_addr->second);
-    bool has_input_attn_mask = signatures_.input_attn_mask.has_value();
-    if (has_input_attn_mask) {
-      RET_CHECK(signatures_.input_attn_mask_data_type.has_value())
-          << "Attention mask data type is not provided.";
-      RETURN_IF_ERROR(InitializeAttentionMask(
-          decode_input_buffers_[signatures_.input_attn_mask.value()],
-          signatures_.input_attn_mask_data_type.value(),
-          IsCalculationPrecisionF16()));
-      RETURN_IF_ERROR(FillAttentionMask(
-          decode_input_buffers_[signatures_.input_attn_mask.value()],
-          current_step_, /*steps=*/1,
-          signatures_.input_attn_mask_data_type.value()));
-    }
-    decode_input_pos_ptr[0] = current_step_;
-  }
-
-  absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>
-      decode_input_buffers;
-  for (const auto& [input_name, input_buffer] : decode_input_buffers_) {
-    auto duplicated_input_buffer = input_buffer.Duplicate();
-    RET_CHECK(duplicated_input_buffer) << "Failed to duplicate input buffer.";
-    decode_input_buffers[input_name] = std::move(*duplicated_input_buffer);
-  }
-  for (const auto& [input_name, input_buffer] : *input_kv_cache_buffers_) {
-    auto duplicated_input_buffer = input_buffer.Duplicate();
-    RET_CHECK(duplicated_input_buffer) << "Failed to duplicate input buffer.";
-    decode_input_buffers[input_name] = std::move(*duplicated_input_buffer);
-  }
-  absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>
-      decode_output_buffers;
-  for (const auto& [output_name, output_buffer] : decode_output_buffers_) {
-    auto duplicated_output_buffer = output_buffer.Duplicate();
-    RET_CHECK(duplicated_output_buffer) << "Failed to duplicate output buffer.";
-    decode_output_buffers[output_name] = std::move(*duplicated_output_buffer);
-  }
-  for (const auto& [output_name, output_buffer] : *output_kv_cache_buffers_) {
-    auto duplicated_output_buffer = output_buffer.Duplicate();
-    RET_CHECK(duplicated_output_buffer) << "Failed to duplicate output buffer.";
-    decode_output_buffers[output_name] = std::move(*duplicated_output_buffer);
-  }
-
-  auto res = compiled_model_.Run(kDecodeSignatureRunner, decode_input_buffers,
-                                 decode_output_buffers);
-  RET_CHECK(res) << "Failed to run compiled model: " << res.Error().Message();
+absl::Status LlmLiteRtCompiledModelExecutor::RunEmbeddingLookups(
+    const std::function<absl::Status()>& lookup,
+    const std::function<absl::Status()>& per_layer_lookup) {
+  if (!per_layer_lookup) {
+    return lookup();
+  }
+  if (embedding_lookup_pool_ == nullptr) {
+    RETURN_IF_ERROR(lookup());
+    return per_layer_lookup();
+  }
+  // The lookups run different models into different buffers, and the worker
+  // is waited for before returning, even on an error of this thread.
+  absl::Status per_layer_status;
+  RETURN_IF_ERROR(embedding_lookup_pool_->Schedule(
+      [&]() { per_layer_status = per_layer_lookup(); }));
+  absl::Status status = lookup();
+  RETURN_IF_ERROR(
+      embedding_lookup_pool_->WaitUntilDone(kEmbeddingLookupTimeout));
+  RETURN_IF_ERROR(status);
+  return per_layer_status;
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::FillDecodePositions() {
+  RunBuffers& run_buffers = GetDecodeRunBuffers();
+  if (run_buffers.input_step_params >= 0) {
+    return FillStepParams(run_buffers.inputs[run_buffers.input_step_params],
+                          current_step_, /*steps=*/1);
+  }
+  auto& decode_input_pos_buffer =
+      run_buffers.inputs[run_buffers.input_positions];
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto decode_input_pos_size,
+                               decode_input_pos_buffer.PackedSize());
+  auto decode_input_pos_lock_and_addr =
+      ::litert::TensorBufferScopedLock::Create(decode_input_pos_buffer,
+                                               TensorBuffer::LockMode::kWrite);
+  RET_CHECK(decode_input_pos_lock_and_addr)
+      << "Failed to lock decode input position buffer.";
+  auto* decode_input_pos_ptr =
+      static_cast<int32_t*>(decode_input_pos_lock_and_addr->second);
+  bool has_input_attn_mask = signatures_.input_attn_mask.has_value();
+  if (has_input_attn_mask) {
+    RETURN_IF_ERROR(UpdateAttentionMaskForSteps(
+        run_buffers.inputs[run_buffers.input_attn_mask],
+        GetDecodeAttentionMaskState(), current_step_, /*steps=*/1));
+  }
+  // All the batch rows are at the same step.
+  std::fill(decode_input_pos_ptr,
+            decode_input_pos_ptr + decode_input_pos_size / sizeof(int32_t),
+            current_step_);
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::Decode(
+    const ExecutorInputs& inputs, ::litert::TensorBuffer& output_logits) {
+  const absl::Time prepare_start = absl::Now();
+  RETURN_IF_ERROR(FillDecodeInputs(inputs));
+  RecordStageLatency(kDecodePrepareInputsStage, prepare_start);
+
+  LITERT_LM_TRACE_SCOPE("compiled_model_run");
+  const absl::Time inference_start = absl::Now();
+  RunBuffers& run_buffers = GetDecodeRunBuffers();
+  // Bind the caller's logits buffer for this run only.
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto bound_logits, output_logits.Duplicate());
+  std::swap(run_buffers.outputs[run_buffers.output_logits], bound_logits);
+  absl::Status status = RunSignature(run_buffers, kDecodeDeviceStage);
+  std::swap(run_buffers.outputs[run_buffers.output_logits], bound_logits);
+  RETURN_IF_ERROR(status);
+  std::swap(input_kv_cache_buffers_, output_kv_cache_buffers_);
+  RecordStageLatency(kDecodeInferenceStage, inference_start);
+  TrimModelMemory();
+  MaybeReleasePrefillRunBuffers();
+
+  ++current_step_;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<::litert::TensorBuffer*>
+LlmLiteRtCompiledModelExecutor::DecodeInternal(const ExecutorInputs& inputs) {
+  const absl::Time prepare_start = absl::Now();
+  RETURN_IF_ERROR(FillDecodeInputs(inputs));
+  RecordStageLatency(kDecodePrepareInputsStage, prepare_start);
+
+  LITERT_LM_TRACE_SCOPE("compiled_model_run");
+  const absl::Time inference_start = absl::Now();
+  RunBuffers& run_buffers = GetDecodeRunBuffers();
+  RETURN_IF_ERROR(RunSignature(run_buffers, kDecodeDeviceStage));
   std::swap(input_kv_cache_buffers_, output_kv_cache_buffers_);
+  RecordStageLatency(kDecodeInferenceStage, inference_start);
+  TrimModelMemory();
+  MaybeReleasePrefillRunBuffers();
 
   ++current_step_;
-  auto output_logits =
-      decode_output_buffers[signatures_.output_logits].Duplicate();
+  return &run_buffers.outputs[run_buffers.output_logits];
+}
+
+absl::StatusOr<::litert::TensorBuffer>
+LlmLiteRtCompiledModelExecutor::DecodeLogits(const ExecutorInputs& inputs) {
+  ASSIGN_OR_RETURN(TensorBuffer * logits, DecodeInternal(inputs));
+  if (logits_quantization_.has_value()) {
+    ASSIGN_OR_RETURN(logits, GetDequantizedLogits(*logits));
+  }
+  auto output_logits = logits->Duplicate();
   if (!output_logits.HasValue()) {
     return absl::InternalError(output_logits.Error().Message());
   }
   return std::move(*output_logits);
 }
 
+absl::StatusOr<::litert::TensorBuffer*>
+LlmLiteRtCompiledModelExecutor::GetDequantizedLogits(
+    const ::litert::TensorBuffer& logits) {
+  RET_CHECK(logits_quantization_.has_value());
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto logits_type, logits.TensorType());
+  const auto& logits_dims = logits_type.Layout().Dimensions();
+  if (!dequantized_logits_.has_value()) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto dequantized_logits,
+        CreateTensorBuffer<float>(
+            ::litert::Dimensions(logits_dims.begin(), logits_dims.end())));
+    dequantized_logits_ = std::move(dequantized_logits);
+  }
+  const auto [scale, zero_point] = *logits_quantization_;
+  RETURN_IF_ERROR(DequantizeLogitsTensor(logits, scale, zero_point,
+                                         *dequantized_logits_));
+  return &*dequantized_logits_;
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::DecodeTopKLogits(
+    const ExecutorInputs& inputs, TensorBuffer& output_topk_logits,
+    TensorBuffer& output_topk_ids) {
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto topk_ids_type,
+                               output_topk_ids.TensorType());
+  const auto& topk_dims = topk_ids_type.Layout().Dimensions();
+  RET_CHECK_EQ(topk_dims.size(), 2)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Top-k outputs must be (batch, k).";
+  RET_CHECK_EQ(topk_dims[0], output_batch_size_)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Top-k outputs do not match the batch size of the model.";
+  const int k = topk_dims[1];
+  ASSIGN_OR_RETURN(auto vocab_size, GetVocabSize());
+  RET_CHECK(k > 0 && k <= vocab_size)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Top-k must be in [1, " << vocab_size << "], got " << k;
+  auto gpu_config = executor_settings_.GetBackendConfig<GpuConfig>();
+  if (gpu_config.ok()) {
+    RET_CHECK_LE(k, gpu_config->max_top_k)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Top-k exceeds the max top-k of the executor.";
+  }
+
+  ASSIGN_OR_RETURN(TensorBuffer * logits, DecodeInternal(inputs));
+  if (logits_quantization_.has_value()) {
+    ASSIGN_OR_RETURN(logits, GetDequantizedLogits(*logits));
+  }
+  return GatherTopKLogits(*logits, output_batch_size_, k, output_topk_logits,
+                          output_topk_ids);
+}
+
 absl::Status LlmLiteRtCompiledModelExecutor::SampleLogits(
     const TensorBuffer& logits, TensorBuffer& ids_tensor) {
+  LITERT_LM_TRACE_SCOPE("sampling");
   ASSIGN_OR_RETURN(auto vocab_size, GetVocabSize());
 
   if (sampler_ == nullptr) {
@@ -567,19 +905,19 @@ absl::Status LlmLiteRtCompiledModelExecutor::SampleLogits(
     }
     LITERT_ASSIGN_OR_RETURN_ABSL(const auto decoded_logits_tensor_type,
                                  logits.TensorType());
-    proto::SamplerParameters sampler_params;
-    sampler_params.set_type(proto::SamplerParameters::TOP_P);
-    sampler_params.set_k(1);
-    sampler_params.set_p(0.0f);
-    sampler_params.set_temperature(1.0f);
-    sampler_params.set_seed(0);
+    LITERT_ASSIGN_OR_RETURN_ABSL(const auto logits_buffer_type,
+                                 logits.BufferType());
     ASSIGN_OR_RETURN(
         sampler_,
         CreateSampler(
             sampler_backend,
             /*batch_size=*/decoded_logits_tensor_type.Layout().Dimensions()[0],
-            std::move(sampler_params), env_.Get(), vocab_size,
-            logits_data_type_));
+            GetInternalSamplerParams(), env_.Get(), vocab_size,
+            logits_data_type_, /*thread_pool=*/nullptr, logits_buffer_type));
+    if (logits_quantization_.has_value()) {
+      RETURN_IF_ERROR(sampler_->SetLogitsQuantization(
+          logits_quantization_->first, logits_quantization_->second));
+    }
   }
 
   RETURN_IF_ERROR(sampler_->SampleToIdAndScoreBuffer(
@@ -587,11 +925,1310 @@ absl::Status LlmLiteRtCompiledModelExecutor::SampleLogits(
   return absl::OkStatus();
 }
 
+absl::StatusOr<std::vector<TensorBuffer>>
+LlmLiteRtCompiledModelExecutor::DuplicateBuffers(
+    absl::Span<const absl::string_view> names,
+    const absl::flat_hash_map<absl::string_view, TensorBuffer>& buffers,
+    const absl::flat_hash_map<absl::string_view, TensorBuffer>&
+        kv_cache_buffers) {
+  std::vector<TensorBuffer> duplicated_buffers;
+  duplicated_buffers.reserve(names.size());
+  for (absl::string_view name : names) {
+    auto it = buffers.find(name);
+    if (it == buffers.end()) {
+      it = kv_cache_buffers.find(name);
+      RET_CHECK(it != kv_cache_buffers.end()) << "No buffer for " << name;
+    }
+    auto duplicated_buffer = it->second.Duplicate();
+    RET_CHECK(duplicated_buffer) << "Failed to duplicate buffer " << name;
+    duplicated_buffers.push_back(std::move(*duplicated_buffer));
+  }
+  return duplicated_buffers;
+}
+
+absl::StatusOr<LlmLiteRtCompiledModelExecutor::RunBuffers>
+LlmLiteRtCompiledModelExecutor::CreateRunBuffers(
+    absl::string_view signature_key,
+    const absl::flat_hash_map<absl::string_view, TensorBuffer>& input_buffers,
+    const absl::flat_hash_map<absl::string_view, TensorBuffer>& output_buffers,
+    const absl::flat_hash_map<absl::string_view, TensorBuffer>&
+        input_kv_cache_buffers,
+    const absl::flat_hash_map<absl::string_view, TensorBuffer>&
+        output_kv_cache_buffers) const {
+  RunBuffers run_buffers;
+  bool found = false;
+  for (size_t i = 0; i < model_.GetNumSignatures(); ++i) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto signature, model_.GetSignature(i));
+    if (signature.Key() == signature_key) {
+      run_buffers.signature_index = i;
+      run_buffers.input_names = signature.InputNames();
+      run_buffers.output_names = signature.OutputNames();
+      found = true;
+      break;
+    }
+  }
+  RET_CHECK(found) << "Signature not found: " << signature_key;
+  ASSIGN_OR_RETURN(run_buffers.inputs,
+                   DuplicateBuffers(run_buffers.input_names, input_buffers,
+                                    input_kv_cache_buffers));
+  ASSIGN_OR_RETURN(run_buffers.outputs,
+                   DuplicateBuffers(run_buffers.output_names, output_buffers,
+                                    output_kv_cache_buffers));
+
+  auto find_slot = [](absl::Span<const absl::string_view> names,
+                      std::optional<absl::string_view> name) {
+    if (!name.has_value() || name->empty()) {
+      return -1;
+    }
+    auto it = absl::c_find(names, *name);
+    return it == names.end() ? -1 : static_cast<int>(it - names.begin());
+  };
+  run_buffers.input_tokens =
+      find_slot(run_buffers.input_names, signatures_.input_tokens);
+  run_buffers.input_positions =
+      find_slot(run_buffers.input_names, signatures_.input_positions);
+  run_buffers.input_attn_mask =
+      find_slot(run_buffers.input_names, signatures_.input_attn_mask);
+  run_buffers.input_step_params =
+      find_slot(run_buffers.input_names, signatures_.input_step_params);
+  run_buffers.input_embeddings =
+      find_slot(run_buffers.input_names, signatures_.input_embeddings);
+  run_buffers.input_per_layer_embeddings = find_slot(
+      run_buffers.input_names, signatures_.input_per_layer_embeddings);
+  run_buffers.output_logits =
+      find_slot(run_buffers.output_names, signatures_.output_logits);
+
+  // The per step inputs the model signatures name must all be bound, the
+  // logits output being optional for prefill.
+  RET_CHECK(run_buffers.input_positions >= 0 ||
+            run_buffers.input_step_params >= 0)
+      << "No positions nor step parameters input in " << signature_key;
+  RET_CHECK(signatures_.input_tokens.empty() || run_buffers.input_tokens >= 0)
+      << "No tokens input in " << signature_key;
+  RET_CHECK(!signatures_.input_attn_mask.has_value() ||
+            run_buffers.input_attn_mask >= 0)
+      << "No attention mask input in " << signature_key;
+  if (signatures_.input_tokens.empty()) {
+    RET_CHECK(!signatures_.input_embeddings.has_value() ||
+              run_buffers.input_embeddings >= 0)
+        << "No embeddings input in " << signature_key;
+    RET_CHECK(!signatures_.input_per_layer_embeddings.has_value() ||
+              run_buffers.input_per_layer_embeddings >= 0)
+        << "No per layer embeddings input in " << signature_key;
+  }
+  return run_buffers;
+}
+
+absl::Status
+LlmLiteRtCompiledModelExecutor::LoadOrMeasurePrefillSignatureCosts() {
+  // The costs are not cached if there is no weight cache path, e.g. the cache
+  // is disabled or given as a file descriptor. They are measured again on
+  // another device, e.g. for a model directory copied over.
+  const std::string device_fingerprint = GetDeviceFingerprint();
+  std::string cost_file_path;
+  auto cost_file = executor_settings_.GetWeightCacheFile(".prefill_costs");
+  if (cost_file.ok() && std::holds_alternative<std::string>(*cost_file)) {
+    cost_file_path = std::get<std::string>(*cost_file);
+  }
+  if (!cost_file_path.empty()) {
+    std::ifstream file(cost_file_path);
+    if (file.is_open()) {
+      std::stringstream contents;
+      contents << file.rdbuf();
+      auto costs =
+          ParsePrefillSignatureCosts(contents.str(), device_fingerprint);
+      if (costs.ok() && costs->size() == prefill_signature_map_.size()) {
+        prefill_signature_costs_ = *std::move(costs);
+        return absl::OkStatus();
+      }
+      ABSL_LOG(WARNING) << "Ignoring invalid prefill cost file "
+                        << cost_file_path;
+    }
+  }
+
+  // One warm-up run, then the average over a few timed runs.
+  constexpr int kNumTimedRuns = 3;
+  PrefillSignatureCosts costs;
+  for (const auto& [prefill_length, prefill_signature] :
+       prefill_signature_map_) {
+    ASSIGN_OR_RETURN(auto* signature_run_buffers,
+                     GetPrefillRunBuffers(prefill_signature));
+    RunBuffers& run_buffers = (*signature_run_buffers)[KvCacheParity()];
+    absl::Duration elapsed;
+    for (int i = 0; i <= kNumTimedRuns; ++i) {
+      const absl::Time start = absl::Now();
+      auto res = compiled_model_.Run(run_buffers.signature_index,
+                                     run_buffers.inputs, run_buffers.outputs);
+      RET_CHECK(res) << "Failed to run compiled model."
+                     << res.Error().Message();
+      if (i > 0) {
+        elapsed += absl::Now() - start;
+      }
+    }
+    costs[prefill_length] =
+        absl::ToDoubleMicroseconds(elapsed) / kNumTimedRuns;
+    ABSL_LOG(INFO) << "Prefill signature " << prefill_signature << " takes "
+                   << costs[prefill_length] << " us.";
+  }
+
+  if (!cost_file_path.empty()) {
+    std::ofstream file(cost_file_path, std::ios::trunc);
+    file << SerializePrefillSignatureCosts(costs, device_fingerprint);
+    if (!file.good()) {
+      ABSL_LOG(WARNING) << "Failed to write prefill cost file "
+                        << cost_file_path;
+    }
+  }
+  prefill_signature_costs_ = std::move(costs);
+  return absl::OkStatus();
+}
+
+absl::StatusOr<int> LlmLiteRtCompiledModelExecutor::GetPrefillChunkSize()
+    const {
+  RET_CHECK(prefill_signature_costs_.has_value())
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The prefill work groups are not autotuned.";
+  return GetHighestThroughputPrefillLength(*prefill_signature_costs_);
+}
+
+absl::StatusOr<std::array<LlmLiteRtCompiledModelExecutor::RunBuffers, 2>*>
+LlmLiteRtCompiledModelExecutor::GetPrefillRunBuffers(
+    absl::string_view prefill_signature) {
+  auto run_buffers_it = prefill_run_buffers_.find(prefill_signature);
+  if (run_buffers_it != prefill_run_buffers_.end()) {
+    return &run_buffers_it->second;
+  }
+
+  // Parity 0 reads the kv-cache from kv_cache_buffers_1_ and writes it to
+  // kv_cache_buffers_2_, parity 1 the other way around.
+  const absl::flat_hash_map<absl::string_view, TensorBuffer>*
+      input_kv_cache_buffers[2] = {&kv_cache_buffers_1_, &kv_cache_buffers_2_};
+  const absl::flat_hash_map<absl::string_view, TensorBuffer>*
+      output_kv_cache_buffers[2] = {&kv_cache_buffers_2_, &kv_cache_buffers_1_};
+
+  // The token, position and attention mask inputs depend on the prefill
+  // length, so each prefill signature gets its own, as do the step parameters
+  // of its runs. With the asynchronous prefill, each parity gets its own too,
+  // so that the host fills the inputs of the next work group while the
+  // device still reads those of the current one.
+  std::vector<absl::string_view> per_signature_input_names;
+  if (signatures_.input_step_params.has_value()) {
+    per_signature_input_names.push_back(signatures_.input_step_params.value());
+  } else {
+    per_signature_input_names.push_back(signatures_.input_positions);
+  }
+  if (!signatures_.input_tokens.empty()) {
+    per_signature_input_names.push_back(signatures_.input_tokens);
+  } else {
+    if (signatures_.input_embeddings.has_value()) {
+      per_signature_input_names.push_back(signatures_.input_embeddings.value());
+    }
+    if (signatures_.input_per_layer_embeddings.has_value()) {
+      per_signature_input_names.push_back(
+          signatures_.input_per_layer_embeddings.value());
+    }
+  }
+  if (signatures_.input_attn_mask.has_value()) {
+    per_signature_input_names.push_back(signatures_.input_attn_mask.value());
+  }
+
+  ASSIGN_OR_RETURN(auto signature_input_buffers,
+                   DuplicateBufferMap(prefill_input_buffers_));
+  ASSIGN_OR_RETURN(auto signature_output_buffers,
+                   DuplicateBufferMap(prefill_output_buffers_));
+  std::array<RunBuffers, 2> run_buffers;
+  for (int parity = 0; parity < 2; ++parity) {
+    if (parity == 0 || async_prefill_) {
+      for (absl::string_view input_name : per_signature_input_names) {
+        auto input_buffer =
+            compiled_model_.CreateInputBuffer(prefill_signature, input_name);
+        if (!input_buffer) {
+          return absl::InternalError(absl::StrCat(
+              "Failed to create prefill input buffer for '", input_name,
+              "' of ", prefill_signature, ": ",
+              input_buffer.Error().Message()));
+        }
+        signature_input_buffers[input_name] = std::move(*input_buffer);
+      }
+      // The logits output, if any, also depends on the prefill length.
+      if (signature_output_buffers.contains(signatures_.output_logits)) {
+        auto output_buffer = compiled_model_.CreateOutputBuffer(
+            prefill_signature, signatures_.output_logits);
+        if (!output_buffer) {
+          return absl::InternalError(absl::StrCat(
+              "Failed to create prefill output buffer for '",
+              signatures_.output_logits, "' of ", prefill_signature, ": ",
+              output_buffer.Error().Message()));
+        }
+        signature_output_buffers[signatures_.output_logits] =
+            std::move(*output_buffer);
+      }
+    }
+    ASSIGN_OR_RETURN(
+        run_buffers[parity],
+        CreateRunBuffers(prefill_signature, signature_input_buffers,
+                         signature_output_buffers,
+                         *input_kv_cache_buffers[parity],
+                         *output_kv_cache_buffers[parity]));
+  }
+  return &(prefill_run_buffers_[prefill_signature] = std::move(run_buffers));
+}
+
+void LlmLiteRtCompiledModelExecutor::MaybeReleasePrefillRunBuffers() {
+  if (!executor_settings_.GetReleasePrefillBuffers() ||
+      prefill_run_buffers_.size() <= 1) {
+    return;
+  }
+  // The smallest prefill signature is kept bound, as with lazy prefill
+  // signatures, for the short prefills of the next turns.
+  const std::string& kept_signature = prefill_signature_map_.rbegin()->second;
+  absl::erase_if(prefill_run_buffers_, [&](const auto& entry) {
+    return entry.first != kept_signature;
+  });
+  // The masks of the released signatures are initialized again when bound.
+  absl::erase_if(prefill_attention_masks_, [&](const auto& entry) {
+    return entry.first != kept_signature;
+  });
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::BindRunBuffers() {
+  // The map is sorted by descending prefill length.
+  if (!prefill_signature_map_.empty()) {
+    const int max_prefill_ids =
+        (prefill_signature_map_.begin()->first + 1) * output_batch_size_;
+    prefill_tokens_to_lookup_.reserve(max_prefill_ids);
+    prefill_batch_ids_.reserve(max_prefill_ids);
+  }
+  // With lazy prefill signatures, only the smallest prefill signature is
+  // bound up front and the others on first use. Measuring the prefill costs
+  // runs every signature anyway.
+  const bool bind_all_prefill_signatures =
+      !executor_settings_.GetLazyPrefillSignatures() ||
+      executor_settings_.GetAutotunePrefillWorkGroups();
+  for (const auto& [prefill_length, prefill_signature] :
+       prefill_signature_map_) {
+    if (bind_all_prefill_signatures ||
+        prefill_length == prefill_signature_map_.rbegin()->first) {
+      RETURN_IF_ERROR(GetPrefillRunBuffers(prefill_signature).status());
+    }
+  }
+
+  // Parity 0 reads the kv-cache from kv_cache_buffers_1_ and writes it to
+  // kv_cache_buffers_2_, parity 1 the other way around.
+  const absl::flat_hash_map<absl::string_view, TensorBuffer>*
+      input_kv_cache_buffers[2] = {&kv_cache_buffers_1_, &kv_cache_buffers_2_};
+  const absl::flat_hash_map<absl::string_view, TensorBuffer>*
+      output_kv_cache_buffers[2] = {&kv_cache_buffers_2_, &kv_cache_buffers_1_};
+  for (int parity = 0; parity < 2; ++parity) {
+    ASSIGN_OR_RETURN(
+        decode_run_buffers_[parity],
+        CreateRunBuffers(kDecodeSignatureRunner, decode_input_buffers_,
+                         decode_output_buffers_,
+                         *input_kv_cache_buffers[parity],
+                         *output_kv_cache_buffers[parity]));
+    RET_CHECK_GE(decode_run_buffers_[parity].output_logits, 0)
+        << "No logits output in " << kDecodeSignatureRunner;
+  }
+  return BindKvBucketedDecodeRunBuffers();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::BindKvBucketedDecodeRunBuffers() {
+  // The buffers are all bound up front, such that the run buffers returned by
+  // GetDecodeRunBuffers() stay valid through a decode step.
+  const absl::flat_hash_map<absl::string_view, TensorBuffer>*
+      input_kv_cache_buffers[2] = {&kv_cache_buffers_1_, &kv_cache_buffers_2_};
+  const absl::flat_hash_map<absl::string_view, TensorBuffer>*
+      output_kv_cache_buffers[2] = {&kv_cache_buffers_2_, &kv_cache_buffers_1_};
+  for (const auto& [kv_cache_length, decode_signature] :
+       decode_signature_map_) {
+    ASSIGN_OR_RETURN(auto signature_input_buffers,
+                     DuplicateBufferMap(decode_input_buffers_));
+    if (signatures_.input_attn_mask.has_value()) {
+      auto input_buffer = compiled_model_.CreateInputBuffer(
+          decode_signature, signatures_.input_attn_mask.value());
+      if (!input_buffer) {
+        return absl::InternalError(absl::StrCat(
+            "Failed to create decode attention mask buffer of ",
+            decode_signature, ": ", input_buffer.Error().Message()));
+      }
+      signature_input_buffers[signatures_.input_attn_mask.value()] =
+          std::move(*input_buffer);
+    }
+    std::array<RunBuffers, 2> run_buffers;
+    for (int parity = 0; parity < 2; ++parity) {
+      ASSIGN_OR_RETURN(
+          run_buffers[parity],
+          CreateRunBuffers(decode_signature, signature_input_buffers,
+                           decode_output_buffers_,
+                           *input_kv_cache_buffers[parity],
+                           *output_kv_cache_buffers[parity]));
+      RET_CHECK_GE(run_buffers[parity].output_logits, 0)
+          << "No logits output in " << decode_signature;
+    }
+    kv_bucketed_decode_run_buffers_[decode_signature] = std::move(run_buffers);
+  }
+  return absl::OkStatus();
+}
+
+LlmLiteRtCompiledModelExecutor::RunBuffers&
+LlmLiteRtCompiledModelExecutor::GetDecodeRunBuffers() {
+  const absl::string_view decode_signature =
+      GetDecodeSignatureForStep(decode_signature_map_, current_step_);
+  if (decode_signature.empty()) {
+    return decode_run_buffers_[KvCacheParity()];
+  }
+  return kv_bucketed_decode_run_buffers_.at(decode_signature)[KvCacheParity()];
+}
+
+LlmLiteRtCompiledModelExecutor::AttentionMaskState&
+LlmLiteRtCompiledModelExecutor::GetDecodeAttentionMaskState() {
+  const absl::string_view decode_signature =
+      GetDecodeSignatureForStep(decode_signature_map_, current_step_);
+  if (decode_signature.empty()) {
+    return decode_attention_mask_;
+  }
+  return kv_bucketed_decode_attention_masks_[decode_signature];
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::ReserveKvCacheBlocks(
+    int num_tokens) {
+  if (!kv_cache_block_table_.has_value()) {
+    return absl::OkStatus();
+  }
+  return kv_cache_block_table_->EnsureCapacity(num_tokens);
+}
+
+absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>>
+LlmLiteRtCompiledModelExecutor::SaveState() {
+  RET_CHECK_EQ(output_batch_size_, 1).SetCode(absl::StatusCode::kUnimplemented)
+      << "SaveState is only supported for batch size 1.";
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  ExecutorCheckpoint::KvCacheScales kv_cache_scales;
+  const bool quantize_kv_cache =
+      executor_settings_.GetKvCacheDataType() == KvCacheDataType::INT8;
+  // The latest kv-cache is always in the input buffers, since the buffers are
+  // swapped after each run.
+  for (auto& [name, buffer] : *input_kv_cache_buffers_) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, buffer.TensorType());
+    if (quantize_kv_cache &&
+        tensor_type.ElementType() == ::litert::ElementType::Float32) {
+      RETURN_IF_ERROR(QuantizeKvCacheToInt8(buffer, kv_cache[name],
+                                            kv_cache_scales[name]));
+      continue;
+    }
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto buffer_size, buffer.PackedSize());
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto lock_and_addr, ::litert::TensorBufferScopedLock::Create(
+                                buffer, TensorBuffer::LockMode::kRead));
+    const auto* data = static_cast<const uint8_t*>(lock_and_addr.second);
+    kv_cache[name] = std::vector<uint8_t>(data, data + buffer_size);
+  }
+  return std::make_unique<ExecutorCheckpoint>(
+      current_step_,
+      next_input_token_ids_.empty() ? -1 : next_input_token_ids_[0],
+      std::move(kv_cache), std::move(kv_cache_scales));
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::RestoreState(
+    const ExecutorCheckpoint& checkpoint) {
+  RET_CHECK_EQ(output_batch_size_, 1).SetCode(absl::StatusCode::kUnimplemented)
+      << "RestoreState is only supported for batch size 1.";
+  RET_CHECK_EQ(checkpoint.GetNumKvCacheTensors(),
+               input_kv_cache_buffers_->size())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Checkpoint does not match the kv-cache of the model.";
+  RETURN_IF_ERROR(ReserveKvCacheBlocks(checkpoint.GetCurrentStep()));
+  for (auto& [name, buffer] : *input_kv_cache_buffers_) {
+    // The contents of an offloaded checkpoint are paged in from its file here.
+    auto contents = checkpoint.GetKvCacheTensor(name);
+    RET_CHECK(contents.ok()).SetCode(absl::StatusCode::kInvalidArgument)
+        << contents.status().message();
+    auto scales_it = checkpoint.GetKvCacheScales().find(name);
+    if (scales_it != checkpoint.GetKvCacheScales().end()) {
+      RETURN_IF_ERROR(
+          DequantizeKvCacheFromInt8(*contents, scales_it->second, buffer));
+      continue;
+    }
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto buffer_size, buffer.PackedSize());
+    RET_CHECK_EQ(contents->size(), buffer_size)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Kv-cache tensor " << name << " size mismatch.";
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto lock_and_addr, ::litert::TensorBufferScopedLock::Create(
+                                buffer, TensorBuffer::LockMode::kWrite));
+    memcpy(lock_and_addr.second, contents->data(), buffer_size);
+  }
+  current_step_ = checkpoint.GetCurrentStep();
+  next_input_token_ids_.clear();
+  if (checkpoint.GetNextInputTokenId() != -1) {
+    next_input_token_ids_.push_back(checkpoint.GetNextInputTokenId());
+  }
+  if (kv_cache_block_table_.has_value()) {
+    RETURN_IF_ERROR(kv_cache_block_table_->Truncate(current_step_));
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<KvCacheLayouts>
+LlmLiteRtCompiledModelExecutor::GetKvCacheLayouts() const {
+  RET_CHECK(!kv_cache_block_table_.has_value())
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "The blocks of the paged kv-cache are not in token order.";
+  RET_CHECK(executor_settings_.GetKvCacheDataType() != KvCacheDataType::INT8)
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "The kv-cache of the checkpoints is quantized to int8.";
+  ASSIGN_OR_RETURN(const int kv_cache_length, GetKvCacheLength());
+  KvCacheLayouts layouts;
+  for (const auto& [name, buffer] : *input_kv_cache_buffers_) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, buffer.TensorType());
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto buffer_size, buffer.PackedSize());
+    const auto& dims = tensor_type.Layout().Dimensions();
+    ASSIGN_OR_RETURN(
+        layouts[name],
+        GetKvCacheTensorLayout(std::vector<int>(dims.begin(), dims.end()),
+                               kv_cache_length, buffer_size));
+  }
+  return layouts;
+}
+
+absl::StatusOr<std::vector<int>>
+LlmLiteRtCompiledModelExecutor::VerifyDraftTokens(
+    absl::Span<const int> draft_token_ids) {
+  RET_CHECK_EQ(output_batch_size_, 1).SetCode(absl::StatusCode::kUnimplemented)
+      << "VerifyDraftTokens is only supported for batch size 1.";
+  RET_CHECK(!draft_token_ids.empty())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "No draft tokens to verify.";
+  if (next_input_token_ids_.empty()) {
+    return absl::FailedPreconditionError(
+        "No pending input token to verify the draft tokens from.");
+  }
+  // The pending token and the draft tokens are fed in one run.
+  const int num_verify_tokens = draft_token_ids.size() + 1;
+  const std::string* verify_signature = nullptr;
+  // The map is sorted by descending prefill length.
+  for (const auto& [prefill_length, prefill_signature] :
+       prefill_signature_map_) {
+    if (prefill_length >= num_verify_tokens) {
+      verify_signature = &prefill_signature;
+    }
+  }
+  RET_CHECK(verify_signature != nullptr)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Too many draft tokens to verify: " << draft_token_ids.size();
+  ASSIGN_OR_RETURN(auto* signature_run_buffers,
+                   GetPrefillRunBuffers(*verify_signature));
+  RunBuffers& run_buffers = (*signature_run_buffers)[KvCacheParity()];
+  if (run_buffers.output_logits < 0) {
+    return absl::UnimplementedError(
+        "The prefill signatures of the model do not output logits.");
+  }
+
+  const int start_step = current_step_;
+  // PrefillInternal holds back the last id as the pending token, so the last
+  // draft token is repeated to have all of them fed.
+  std::vector<int> verify_ids(draft_token_ids.begin(), draft_token_ids.end());
+  verify_ids.push_back(draft_token_ids.back());
+  RETURN_IF_ERROR(
+      PrefillInternal(*verify_signature, verify_ids, /*batch_size=*/1));
+
+  TensorBuffer& logits_buffer = run_buffers.outputs[run_buffers.output_logits];
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto logits_type, logits_buffer.TensorType());
+  RET_CHECK(logits_type.ElementType() == ::litert::ElementType::Float32)
+      << "Only float32 logits are supported for verification.";
+  const auto& logits_dims = logits_type.Layout().Dimensions();
+  RET_CHECK_EQ(logits_dims.size(), 3) << "Logits must be (batch, seq, vocab)";
+  RET_CHECK_GE(logits_dims[1], num_verify_tokens);
+  const int vocab_size = logits_dims[2];
+  LITERT_ASSIGN_OR_RETURN_ABSL(
+      auto logits_lock_and_addr,
+      ::litert::TensorBufferScopedLock::Create(logits_buffer,
+                                               TensorBuffer::LockMode::kRead));
+  const float* logits = static_cast<const float*>(logits_lock_and_addr.second);
+
+  // Accept the draft tokens as long as they match the greedy output of the
+  // model, then take the model's own token at the first mismatch.
+  std::vector<int> accepted_token_ids;
+  accepted_token_ids.reserve(num_verify_tokens);
+  for (int i = 0; i < num_verify_tokens; ++i) {
+    const float* position_logits = logits + i * vocab_size;
+    const int token_id =
+        std::max_element(position_logits, position_logits + vocab_size) -
+        position_logits;
+    accepted_token_ids.push_back(token_id);
+    if (i == draft_token_ids.size() || token_id != draft_token_ids[i]) {
+      break;
+    }
+  }
+  // The kv-cache keeps the pending token and the accepted draft tokens.
+  RETURN_IF_ERROR(Rollback(start_step + accepted_token_ids.size(),
+                           accepted_token_ids.back()));
+  return accepted_token_ids;
+}
+
+absl::StatusOr<std::vector<float>> LlmLiteRtCompiledModelExecutor::ScoreTokens(
+    absl::Span<const int> token_ids) {
+  RET_CHECK_EQ(output_batch_size_, 1).SetCode(absl::StatusCode::kUnimplemented)
+      << "ScoreTokens is only supported for batch size 1.";
+  RET_CHECK(!token_ids.empty()).SetCode(absl::StatusCode::kInvalidArgument)
+      << "No tokens to score.";
+  if (next_input_token_ids_.empty()) {
+    return absl::FailedPreconditionError(
+        "No pending input token to score the tokens from.");
+  }
+  RET_CHECK(!prefill_signature_map_.empty());
+  // The pending token is fed in front of each chunk of the tokens. The map is
+  // sorted by descending prefill length.
+  const int max_chunk_size = prefill_signature_map_.begin()->first - 1;
+  RET_CHECK_GT(max_chunk_size, 0).SetCode(absl::StatusCode::kUnimplemented)
+      << "The prefill signatures are too short to score tokens.";
+
+  const int start_step = current_step_;
+  const int start_token_id = next_input_token_ids_[0];
+  std::vector<float> log_probabilities;
+  log_probabilities.reserve(token_ids.size());
+  auto score_chunks = [&]() -> absl::Status {
+    for (int offset = 0; offset < token_ids.size(); offset += max_chunk_size) {
+      absl::Span<const int> chunk = token_ids.subspan(offset, max_chunk_size);
+      const int num_score_tokens = chunk.size() + 1;
+      const std::string* score_signature = nullptr;
+      for (const auto& [prefill_length, prefill_signature] :
+           prefill_signature_map_) {
+        if (prefill_length >= num_score_tokens) {
+          score_signature = &prefill_signature;
+        }
+      }
+      RET_CHECK(score_signature != nullptr);
+      ASSIGN_OR_RETURN(auto* signature_run_buffers,
+                       GetPrefillRunBuffers(*score_signature));
+      RunBuffers& run_buffers = (*signature_run_buffers)[KvCacheParity()];
+      if (run_buffers.output_logits < 0) {
+        return absl::UnimplementedError(
+            "The prefill signatures of the model do not output logits.");
+      }
+
+      // PrefillInternal holds back the last id as the pending token, so the
+      // last token of the chunk is repeated to have all of them fed.
+      std::vector<int> score_ids(chunk.begin(), chunk.end());
+      score_ids.push_back(chunk.back());
+      RETURN_IF_ERROR(
+          PrefillInternal(*score_signature, score_ids, /*batch_size=*/1));
+
+      TensorBuffer& logits_buffer =
+          run_buffers.outputs[run_buffers.output_logits];
+      LITERT_ASSIGN_OR_RETURN_ABSL(auto logits_type,
+                                   logits_buffer.TensorType());
+      RET_CHECK(logits_type.ElementType() == ::litert::ElementType::Float32)
+          << "Only float32 logits are supported for scoring.";
+      const auto& logits_dims = logits_type.Layout().Dimensions();
+      RET_CHECK_EQ(logits_dims.size(), 3)
+          << "Logits must be (batch, seq, vocab)";
+      RET_CHECK_GE(logits_dims[1], num_score_tokens);
+      const int vocab_size = logits_dims[2];
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto logits_lock_and_addr,
+          ::litert::TensorBufferScopedLock::Create(
+              logits_buffer, TensorBuffer::LockMode::kRead));
+      const float* logits =
+          static_cast<const float*>(logits_lock_and_addr.second);
+
+      // The logits at each position predict the token that follows it, and
+      // are normalized with log-softmax.
+      for (int i = 0; i < chunk.size(); ++i) {
+        RET_CHECK(chunk[i] >= 0 && chunk[i] < vocab_size)
+                .SetCode(absl::StatusCode::kInvalidArgument)
+            << "Token id out of the vocabulary: " << chunk[i];
+        const float* position_logits = logits + i * vocab_size;
+        const float max_logit =
+            *std::max_element(position_logits, position_logits + vocab_size);
+        double sum_exp = 0.0;
+        for (int v = 0; v < vocab_size; ++v) {
+          sum_exp += std::exp(position_logits[v] - max_logit);
+        }
+        log_probabilities.push_back(position_logits[chunk[i]] - max_logit -
+                                    std::log(sum_exp));
+      }
+      // The last token of the chunk is the pending token of the next chunk.
+      RETURN_IF_ERROR(Rollback(current_step_ - 1, chunk.back()));
+    }
+    return absl::OkStatus();
+  };
+  absl::Status status = score_chunks();
+  // The kv-cache is rolled back to the context, whether the scoring succeeded
+  // or not.
+  RETURN_IF_ERROR(Rollback(start_step, start_token_id));
+  RETURN_IF_ERROR(status);
+  return log_probabilities;
+}
+
+absl::StatusOr<LlmLiteRtCompiledModelExecutor::RunBuffers*>
+LlmLiteRtCompiledModelExecutor::GetEmbedRunBuffers() {
+  if (embed_run_buffers_.has_value()) {
+    return &*embed_run_buffers_;
+  }
+  RunBuffers run_buffers;
+  bool found = false;
+  for (size_t i = 0; i < model_.GetNumSignatures(); ++i) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto signature, model_.GetSignature(i));
+    if (signature.Key() == kEmbedSignatureRunner) {
+      run_buffers.signature_index = i;
+      run_buffers.input_names = signature.InputNames();
+      run_buffers.output_names = signature.OutputNames();
+      found = true;
+      break;
+    }
+  }
+  if (!found) {
+    return absl::UnimplementedError(
+        "The model has no embed signature to compute the embeddings.");
+  }
+  for (int i = 0; i < run_buffers.input_names.size(); ++i) {
+    const absl::string_view input_name = run_buffers.input_names[i];
+    if (input_name == signatures_.input_tokens) {
+      run_buffers.input_tokens = i;
+    } else if (input_name == signatures_.input_positions) {
+      run_buffers.input_positions = i;
+    } else if (input_name == signatures_.input_step_params) {
+      run_buffers.input_step_params = i;
+    } else {
+      return absl::UnimplementedError(
+          absl::StrCat("Unsupported input of the embed signature: ",
+                       input_name));
+    }
+    auto input_buffer =
+        compiled_model_.CreateInputBuffer(kEmbedSignatureRunner, input_name);
+    if (!input_buffer) {
+      return absl::InternalError(absl::StrCat(
+          "Failed to create embed input buffer for '", input_name,
+          "': ", input_buffer.Error().Message()));
+    }
+    run_buffers.inputs.push_back(std::move(*input_buffer));
+  }
+  for (int i = 0; i < run_buffers.output_names.size(); ++i) {
+    const absl::string_view output_name = run_buffers.output_names[i];
+    if (output_name == kEmbedOutputHiddenStates) {
+      run_buffers.output_hidden_states = i;
+    }
+    auto output_buffer =
+        compiled_model_.CreateOutputBuffer(kEmbedSignatureRunner, output_name);
+    if (!output_buffer) {
+      return absl::InternalError(absl::StrCat(
+          "Failed to create embed output buffer for '", output_name,
+          "': ", output_buffer.Error().Message()));
+    }
+    run_buffers.outputs.push_back(std::move(*output_buffer));
+  }
+  RET_CHECK_GE(run_buffers.input_tokens, 0)
+      << "No tokens input in " << kEmbedSignatureRunner;
+  RET_CHECK_GE(run_buffers.output_hidden_states, 0)
+      << "No hidden states output in " << kEmbedSignatureRunner;
+  embed_run_buffers_ = std::move(run_buffers);
+  return &*embed_run_buffers_;
+}
+
+absl::StatusOr<std::vector<std::vector<float>>>
+LlmLiteRtCompiledModelExecutor::EmbedTokens(
+    absl::Span<const std::vector<int>> token_ids, EmbeddingPooling pooling) {
+  ASSIGN_OR_RETURN(auto* run_buffers, GetEmbedRunBuffers());
+  TensorBuffer& tokens_buffer = run_buffers->inputs[run_buffers->input_tokens];
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto tokens_type, tokens_buffer.TensorType());
+  const auto& tokens_dims = tokens_type.Layout().Dimensions();
+  RET_CHECK_EQ(tokens_dims.size(), 2) << "Tokens must be (batch, seq)";
+  const int batch_size = tokens_dims[0];
+  const int seq_len = tokens_dims[1];
+  TensorBuffer& hidden_states_buffer =
+      run_buffers->outputs[run_buffers->output_hidden_states];
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto hidden_states_type,
+                               hidden_states_buffer.TensorType());
+  RET_CHECK(hidden_states_type.ElementType() == ::litert::ElementType::Float32)
+      << "Only float32 hidden states are supported.";
+  const auto& hidden_states_dims = hidden_states_type.Layout().Dimensions();
+  RET_CHECK(hidden_states_dims.size() == 3 &&
+            hidden_states_dims[0] == batch_size &&
+            hidden_states_dims[1] == seq_len)
+      << "Hidden states must be (batch, seq, dim)";
+  const int dim = hidden_states_dims[2];
+  for (const std::vector<int>& row : token_ids) {
+    RET_CHECK(!row.empty() && row.size() <= seq_len)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Each input must have between 1 and " << seq_len
+        << " tokens, but got " << row.size();
+  }
+
+  if (run_buffers->input_step_params >= 0) {
+    RETURN_IF_ERROR(
+        FillStepParams(run_buffers->inputs[run_buffers->input_step_params],
+                       /*start_timestep=*/0, /*steps=*/seq_len));
+  } else if (run_buffers->input_positions >= 0) {
+    // The rows all start at position 0, so the positions are written once.
+    TensorBuffer& positions_buffer =
+        run_buffers->inputs[run_buffers->input_positions];
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto positions_size,
+                                 positions_buffer.PackedSize());
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto positions_lock_and_addr,
+        ::litert::TensorBufferScopedLock::Create(
+            positions_buffer, TensorBuffer::LockMode::kWrite));
+    auto* positions_ptr = static_cast<int32_t*>(positions_lock_and_addr.second);
+    for (int i = 0; i < positions_size / sizeof(int32_t); ++i) {
+      positions_ptr[i] = i % seq_len;
+    }
+  }
+
+  std::vector<std::vector<float>> embeddings;
+  embeddings.reserve(token_ids.size());
+  for (int offset = 0; offset < token_ids.size(); offset += batch_size) {
+    const int num_rows = std::min<int>(batch_size, token_ids.size() - offset);
+    {
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto tokens_lock_and_addr,
+          ::litert::TensorBufferScopedLock::Create(
+              tokens_buffer, TensorBuffer::LockMode::kWrite));
+      auto* tokens_ptr = static_cast<int32_t*>(tokens_lock_and_addr.second);
+      // The padding tokens are not pooled.
+      std::fill(tokens_ptr, tokens_ptr + batch_size * seq_len, 0);
+      for (int b = 0; b < num_rows; ++b) {
+        const std::vector<int>& row = token_ids[offset + b];
+        std::copy(row.begin(), row.end(), tokens_ptr + b * seq_len);
+      }
+    }
+    auto res = compiled_model_.Run(run_buffers->signature_index,
+                                   run_buffers->inputs, run_buffers->outputs);
+    RET_CHECK(res) << "Failed to run compiled model." << res.Error().Message();
+
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto hidden_states_lock_and_addr,
+        ::litert::TensorBufferScopedLock::Create(
+            hidden_states_buffer, TensorBuffer::LockMode::kRead));
+    const float* hidden_states =
+        static_cast<const float*>(hidden_states_lock_and_addr.second);
+    for (int b = 0; b < num_rows; ++b) {
+      const int num_tokens = token_ids[offset + b].size();
+      const float* row_states = hidden_states + b * seq_len * dim;
+      std::vector<float>& embedding = embeddings.emplace_back(dim, 0.0f);
+      if (pooling == EmbeddingPooling::kLastToken) {
+        const float* last_state = row_states + (num_tokens - 1) * dim;
+        std::copy(last_state, last_state + dim, embedding.begin());
+        continue;
+      }
+      for (int t = 0; t < num_tokens; ++t) {
+        for (int d = 0; d < dim; ++d) {
+          embedding[d] += row_states[t * dim + d];
+        }
+      }
+      for (float& value : embedding) {
+        value /= num_tokens;
+      }
+    }
+  }
+  return embeddings;
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::Rollback(int num_processed_tokens,
+                                                      int next_input_token_id) {
+  RET_CHECK_EQ(output_batch_size_, 1).SetCode(absl::StatusCode::kUnimplemented)
+      << "Rollback is only supported for batch size 1.";
+  RET_CHECK(num_processed_tokens >= 0 && num_processed_tokens <= current_step_)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Cannot roll back to " << num_processed_tokens
+      << " tokens from step " << current_step_;
+  current_step_ = num_processed_tokens;
+  next_input_token_ids_.assign(1, next_input_token_id);
+  if (kv_cache_block_table_.has_value()) {
+    RETURN_IF_ERROR(kv_cache_block_table_->Truncate(current_step_));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::ReorderBatchRows(
+    absl::Span<const int> source_rows) {
+  RET_CHECK_EQ(source_rows.size(), output_batch_size_)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The number of source rows does not match the batch size.";
+  // The latest kv-cache is always in the input buffers, since the buffers are
+  // swapped after each run.
+  for (auto& [name, buffer] : *input_kv_cache_buffers_) {
+    RETURN_IF_ERROR(
+        ReorderKvCacheBatch(buffer, source_rows, reorder_kv_cache_scratch_));
+  }
+  if (!next_input_token_ids_.empty()) {
+    std::vector<int> next_input_token_ids(source_rows.size());
+    for (int b = 0; b < source_rows.size(); ++b) {
+      next_input_token_ids[b] = next_input_token_ids_[source_rows[b]];
+    }
+    next_input_token_ids_ = std::move(next_input_token_ids);
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<int> LlmLiteRtCompiledModelExecutor::GetKvCacheLength() const {
+  if (!signatures_.input_attn_mask.has_value()) {
+    return executor_settings_.GetMaxNumTokens();
+  }
+  auto mask_it = decode_input_buffers_.find(*signatures_.input_attn_mask);
+  RET_CHECK(mask_it != decode_input_buffers_.end())
+      << "No decode attention mask buffer.";
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto mask_type, mask_it->second.TensorType());
+  return mask_type.Layout().Dimensions()[3];
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::ShiftContext(
+    int num_sink_tokens, int num_discarded_tokens) {
+  RET_CHECK(num_sink_tokens >= 0 && num_discarded_tokens >= 0 &&
+            num_sink_tokens + num_discarded_tokens <= current_step_)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Cannot discard " << num_discarded_tokens << " tokens after "
+      << num_sink_tokens << " sink tokens from step " << current_step_;
+  const std::pair<int, int> discarded_range = {
+      num_sink_tokens, num_sink_tokens + num_discarded_tokens};
+  return CompactContext({discarded_range});
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::CompactContext(
+    absl::Span<const std::pair<int, int>> discarded_ranges) {
+  int num_discarded_tokens = 0;
+  int previous_end = 0;
+  for (const auto& [begin, end] : discarded_ranges) {
+    RET_CHECK(begin >= previous_end && begin <= end && end <= current_step_)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "Cannot discard the steps [" << begin << ", " << end
+        << ") from step " << current_step_;
+    num_discarded_tokens += end - begin;
+    previous_end = end;
+  }
+  if (num_discarded_tokens == 0) {
+    return absl::OkStatus();
+  }
+  ASSIGN_OR_RETURN(const int kv_cache_length, GetKvCacheLength());
+  // The latest kv-cache is always in the input buffers, since the buffers are
+  // swapped after each run.
+  for (auto& [name, buffer] : *input_kv_cache_buffers_) {
+    RETURN_IF_ERROR(CompactKvCache(buffer, kv_cache_length, discarded_ranges,
+                                   current_step_));
+  }
+  current_step_ -= num_discarded_tokens;
+  if (kv_cache_block_table_.has_value()) {
+    RETURN_IF_ERROR(kv_cache_block_table_->Truncate(current_step_));
+  }
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::InitLoraInputs() {
+  absl::flat_hash_map<std::string, TensorBuffer> base_weights;
+  for (auto* buffers : {&decode_input_buffers_, &prefill_input_buffers_}) {
+    for (auto& [input_name, buffer] : *buffers) {
+      if (!absl::StartsWith(input_name, kLoraInputPrefix) ||
+          base_weights.contains(input_name)) {
+        continue;
+      }
+      LITERT_ASSIGN_OR_RETURN_ABSL(size_t packed_size, buffer.PackedSize());
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto lock_and_addr, ::litert::TensorBufferScopedLock::Create(
+                                  buffer, TensorBuffer::LockMode::kWrite));
+      std::memset(lock_and_addr.second, 0, packed_size);
+      LITERT_ASSIGN_OR_RETURN_ABSL(base_weights[std::string(input_name)],
+                                   buffer.Duplicate());
+      LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, buffer.TensorType());
+      const auto dimensions = tensor_type.Layout().Dimensions();
+      if (output_batch_size_ > 1 && dimensions.size() > 1 &&
+          dimensions[0] == output_batch_size_) {
+        lora_row_sizes_[std::string(input_name)] =
+            packed_size / output_batch_size_;
+      }
+    }
+  }
+  if (base_weights.empty()) {
+    return absl::OkStatus();
+  }
+  // The prefill and decode signatures share one buffer per LoRA input.
+  RETURN_IF_ERROR(BindLoraWeights(base_weights));
+  lora_weights_[""] = std::move(base_weights);
+  return absl::OkStatus();
+}
+
+absl::StatusOr<TensorBuffer>
+LlmLiteRtCompiledModelExecutor::CreateLoraInputBuffer(
+    absl::string_view input_name) {
+  const absl::string_view signature =
+      decode_input_buffers_.contains(input_name)
+          ? absl::string_view(kDecodeSignatureRunner)
+          : absl::string_view(prefill_signature_map_.begin()->second);
+  auto buffer = compiled_model_.CreateInputBuffer(signature, input_name);
+  if (!buffer) {
+    return absl::InternalError(
+        absl::StrCat("Failed to create LoRA input buffer for '", input_name,
+                     "': ", buffer.Error().Message()));
+  }
+  return std::move(*buffer);
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::BindLoraWeights(
+    const absl::flat_hash_map<std::string, TensorBuffer>& weights) {
+  auto bind = [&weights](
+                  absl::flat_hash_map<absl::string_view, TensorBuffer>& buffers)
+      -> absl::Status {
+    for (auto& [input_name, buffer] : buffers) {
+      auto it = weights.find(input_name);
+      if (it != weights.end()) {
+        LITERT_ASSIGN_OR_RETURN_ABSL(buffer, it->second.Duplicate());
+      }
+    }
+    return absl::OkStatus();
+  };
+  auto bind_run_buffers = [&weights](RunBuffers& run_buffers) -> absl::Status {
+    for (size_t i = 0; i < run_buffers.inputs.size(); ++i) {
+      auto it = weights.find(run_buffers.input_names[i]);
+      if (it != weights.end()) {
+        LITERT_ASSIGN_OR_RETURN_ABSL(run_buffers.inputs[i],
+                                     it->second.Duplicate());
+      }
+    }
+    return absl::OkStatus();
+  };
+  RETURN_IF_ERROR(bind(prefill_input_buffers_));
+  RETURN_IF_ERROR(bind(decode_input_buffers_));
+  for (auto& [prefill_signature, run_buffers] : prefill_run_buffers_) {
+    for (RunBuffers& parity_run_buffers : run_buffers) {
+      RETURN_IF_ERROR(bind_run_buffers(parity_run_buffers));
+    }
+  }
+  for (RunBuffers& parity_run_buffers : decode_run_buffers_) {
+    RETURN_IF_ERROR(bind_run_buffers(parity_run_buffers));
+  }
+  for (auto& [decode_signature, run_buffers] :
+       kv_bucketed_decode_run_buffers_) {
+    for (RunBuffers& parity_run_buffers : run_buffers) {
+      RETURN_IF_ERROR(bind_run_buffers(parity_run_buffers));
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::LoadLoraAdapter(
+    absl::string_view serialized_adapter) {
+  RET_CHECK(!lora_weights_.empty())
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The model has no LoRA inputs.";
+  ASSIGN_OR_RETURN(LoraAdapter adapter, ParseLoraAdapter(serialized_adapter));
+  if (lora_weights_.contains(adapter.name)) {
+    return absl::AlreadyExistsError(
+        absl::StrCat("LoRA adapter ", adapter.name, " is already loaded."));
+  }
+  const auto& base_weights = lora_weights_.at("");
+  RET_CHECK_EQ(adapter.tensors.size(), base_weights.size())
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "LoRA adapter " << adapter.name << " does not match the LoRA inputs "
+      << "of the model.";
+  absl::flat_hash_map<std::string, TensorBuffer> weights;
+  for (const auto& [input_name, base_buffer] : base_weights) {
+    auto tensor_it = adapter.tensors.find(input_name);
+    RET_CHECK(tensor_it != adapter.tensors.end())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "LoRA adapter " << adapter.name << " has no tensor for "
+        << input_name;
+    ASSIGN_OR_RETURN(TensorBuffer buffer, CreateLoraInputBuffer(input_name));
+    LITERT_ASSIGN_OR_RETURN_ABSL(size_t packed_size, buffer.PackedSize());
+    const absl::Span<const uint8_t> tensor = tensor_it->second;
+    // The tensor of a single row is broadcast to all the rows of a batched
+    // input.
+    auto row_size_it = lora_row_sizes_.find(input_name);
+    const bool broadcast = row_size_it != lora_row_sizes_.end() &&
+                           tensor.size() == row_size_it->second;
+    RET_CHECK(tensor.size() == packed_size || broadcast)
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "LoRA adapter " << adapter.name << " has a tensor of the wrong "
+        << "size for " << input_name;
+    {
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto lock_and_addr, ::litert::TensorBufferScopedLock::Create(
+                                  buffer, TensorBuffer::LockMode::kWrite));
+      auto* data = static_cast<uint8_t*>(lock_and_addr.second);
+      for (size_t offset = 0; offset < packed_size; offset += tensor.size()) {
+        std::memcpy(data + offset, tensor.data(), tensor.size());
+      }
+    }
+    weights[input_name] = std::move(buffer);
+  }
+  lora_weights_[adapter.name] = std::move(weights);
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::UnloadLoraAdapter(
+    absl::string_view name) {
+  if (name.empty() || !lora_weights_.contains(name)) {
+    return absl::NotFoundError(
+        absl::StrCat("LoRA adapter ", name, " is not loaded."));
+  }
+  if (selected_lora_adapter_ == name ||
+      absl::c_linear_search(selected_lora_adapters_, name)) {
+    RETURN_IF_ERROR(SelectLoraAdapter(""));
+  }
+  lora_weights_.erase(name);
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::SelectLoraAdapter(
+    absl::string_view name) {
+  if (name == selected_lora_adapter_ && selected_lora_adapters_.empty()) {
+    return absl::OkStatus();
+  }
+  auto it = lora_weights_.find(name);
+  if (it == lora_weights_.end()) {
+    return absl::NotFoundError(
+        absl::StrCat("LoRA adapter ", name, " is not loaded."));
+  }
+  RETURN_IF_ERROR(BindLoraWeights(it->second));
+  selected_lora_adapter_ = std::string(name);
+  selected_lora_adapters_.clear();
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::SelectLoraAdapters(
+    absl::Span<const std::string> names) {
+  RET_CHECK_EQ(names.size(), output_batch_size_)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Expected one LoRA adapter name per batch row.";
+  if (std::all_of(names.begin(), names.end(),
+                  [&names](const std::string& name) {
+                    return name == names.front();
+                  })) {
+    return SelectLoraAdapter(names.front());
+  }
+  if (absl::c_equal(names, selected_lora_adapters_)) {
+    return absl::OkStatus();
+  }
+  RET_CHECK(!lora_weights_.empty())
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The model has no LoRA inputs.";
+  RET_CHECK_EQ(lora_row_sizes_.size(), lora_weights_.at("").size())
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The LoRA inputs of the model are not batched, so all the rows must "
+         "select the same adapter.";
+  std::vector<absl::flat_hash_map<std::string, TensorBuffer>*> row_weights;
+  row_weights.reserve(names.size());
+  for (const std::string& name : names) {
+    auto it = lora_weights_.find(name);
+    if (it == lora_weights_.end()) {
+      return absl::NotFoundError(
+          absl::StrCat("LoRA adapter ", name, " is not loaded."));
+    }
+    row_weights.push_back(&it->second);
+  }
+  for (const auto& [input_name, row_size] : lora_row_sizes_) {
+    auto mixed_it = mixed_lora_weights_.find(input_name);
+    if (mixed_it == mixed_lora_weights_.end()) {
+      ASSIGN_OR_RETURN(TensorBuffer buffer, CreateLoraInputBuffer(input_name));
+      mixed_it =
+          mixed_lora_weights_.emplace(input_name, std::move(buffer)).first;
+    }
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto mixed_lock_and_addr,
+        ::litert::TensorBufferScopedLock::Create(
+            mixed_it->second, TensorBuffer::LockMode::kWrite));
+    auto* mixed_data = static_cast<uint8_t*>(mixed_lock_and_addr.second);
+    for (int b = 0; b < row_weights.size(); ++b) {
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto lock_and_addr,
+          ::litert::TensorBufferScopedLock::Create(
+              row_weights[b]->at(input_name), TensorBuffer::LockMode::kRead));
+      std::memcpy(mixed_data + b * row_size,
+                  static_cast<const uint8_t*>(lock_and_addr.second) +
+                      b * row_size,
+                  row_size);
+    }
+  }
+  RETURN_IF_ERROR(BindLoraWeights(mixed_lora_weights_));
+  selected_lora_adapter_.clear();
+  selected_lora_adapters_.assign(names.begin(), names.end());
+  return absl::OkStatus();
+}
+
+void LlmLiteRtCompiledModelExecutor::RecordStageLatency(
+    absl::string_view stage, absl::Time start) {
+  const absl::Duration latency = absl::Now() - start;
+  if (auto it = stage_latencies_.find(stage); it != stage_latencies_.end()) {
+    it->second += latency;
+  } else {
+    stage_latencies_.emplace(stage, latency);
+  }
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::RunSignature(
+    RunBuffers& run_buffers, absl::string_view device_stage) {
+  if (!measure_device_time_) {
+    auto res = compiled_model_.Run(run_buffers.signature_index,
+                                   run_buffers.inputs, run_buffers.outputs);
+    RET_CHECK(res) << "Failed to run compiled model: " << res.Error().Message();
+    return absl::OkStatus();
+  }
+  bool async = false;
+  auto res = compiled_model_.RunAsync(run_buffers.signature_index,
+                                      run_buffers.inputs, run_buffers.outputs,
+                                      async);
+  RET_CHECK(res) << "Failed to run compiled model: " << res.Error().Message();
+  // The outputs of a run the delegate did not enqueue are ready already, and
+  // the whole run is host time.
+  const absl::Time enqueued = absl::Now();
+  RETURN_IF_ERROR(WaitForRunOutputs(run_buffers));
+  RecordStageLatency(device_stage, enqueued);
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::WaitForRunOutputs(
+    RunBuffers& run_buffers) {
+  for (::litert::TensorBuffer& output : run_buffers.outputs) {
+    if (!output.HasEvent()) {
+      continue;
+    }
+    LITERT_ASSIGN_OR_RETURN_ABSL(::litert::Event event, output.GetEvent());
+    auto waited = event.Wait(/*timeout_in_ms=*/-1);
+    RET_CHECK(waited) << "Failed to wait for the compiled model: "
+                      << waited.Error().Message();
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<EmbeddingCacheStats>
+LlmLiteRtCompiledModelExecutor::GetEmbeddingCacheStats() const {
+  EmbeddingCacheStats stats;
+  for (const auto* lookup :
+       {embedding_lookup_.get(), per_layer_embedding_lookup_.get()}) {
+    if (lookup != nullptr) {
+      stats.hits += lookup->GetDecodeCacheHits();
+      stats.misses += lookup->GetDecodeCacheMisses();
+      stats.size_in_bytes += lookup->GetDecodeCacheSizeInBytes();
+    }
+  }
+  return stats;
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::ReleaseCaches() {
+  for (auto* lookup :
+       {embedding_lookup_.get(), per_layer_embedding_lookup_.get()}) {
+    if (lookup != nullptr) {
+      lookup->ClearDecodeCache();
+    }
+  }
+  prefill_broadcast_ids_ = {};
+  prefill_batch_ids_ = {};
+  // The embed buffers are bound again by the next EmbedTokens().
+  embed_run_buffers_.reset();
+  return absl::OkStatus();
+}
+
+absl::StatusOr<MemoryUsage> LlmLiteRtCompiledModelExecutor::GetMemoryUsage()
+    const {
+  MemoryUsage memory_usage;
+  TensorBufferMemoryCounter counter(memory_usage);
+  // The kv-cache is counted first, as the run buffers hold duplicates of it.
+  counter.Add(kKvCacheMemory, kv_cache_buffers_1_);
+  counter.Add(kKvCacheMemory, kv_cache_buffers_2_);
+  counter.Add(kPrefillBuffersMemory, prefill_input_buffers_);
+  counter.Add(kPrefillBuffersMemory, prefill_output_buffers_);
+  // The inputs of each bound prefill signature are allocated for its length.
+  for (const auto& [signature, run_buffers] : prefill_run_buffers_) {
+    for (const RunBuffers& parity_run_buffers : run_buffers) {
+      counter.Add(kPrefillBuffersMemory, parity_run_buffers.inputs);
+      counter.Add(kPrefillBuffersMemory, parity_run_buffers.outputs);
+    }
+  }
+  counter.Add(kDecodeBuffersMemory, decode_input_buffers_);
+  counter.Add(kDecodeBuffersMemory, decode_output_buffers_);
+  for (const RunBuffers& parity_run_buffers : decode_run_buffers_) {
+    counter.Add(kDecodeBuffersMemory, parity_run_buffers.inputs);
+    counter.Add(kDecodeBuffersMemory, parity_run_buffers.outputs);
+  }
+  for (const auto& [decode_signature, run_buffers] :
+       kv_bucketed_decode_run_buffers_) {
+    for (const RunBuffers& parity_run_buffers : run_buffers) {
+      counter.Add(kDecodeBuffersMemory, parity_run_buffers.inputs);
+      counter.Add(kDecodeBuffersMemory, parity_run_buffers.outputs);
+    }
+  }
+  for (const TensorBuffer& buffer : decode_step_token_ids_) {
+    counter.Add(kDecodeBuffersMemory, buffer);
+  }
+  for (const auto& [adapter_name, weights] : lora_weights_) {
+    counter.Add(kLoraWeightsMemory, weights);
+  }
+  ASSIGN_OR_RETURN(EmbeddingCacheStats embedding_cache_stats,
+                   GetEmbeddingCacheStats());
+  if (embedding_cache_stats.size_in_bytes > 0) {
+    memory_usage.Add(kEmbedderMemory, MemoryLocation::kHost,
+                     embedding_cache_stats.size_in_bytes);
+  }
+  return memory_usage;
+}
+
+absl::Status LlmLiteRtCompiledModelExecutor::Warmup(int num_decode_steps) {
+  RET_CHECK(current_step_ == 0 && next_input_token_ids_.empty())
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "Warmup must be called before the first prefill or after Reset().";
+  RET_CHECK_GE(num_decode_steps, 0);
+  LITERT_LM_TRACE_SCOPE("warmup");
+  // The signatures are sorted from the longest.
+  int num_tokens = num_decode_steps;
+  if (!prefill_signature_map_.empty()) {
+    num_tokens = std::max(num_tokens, prefill_signature_map_.begin()->first);
+  }
+  RETURN_IF_ERROR(ReserveKvCacheBlocks(num_tokens));
+  // Each parity binds its own buffers, so both are run.
+  for (const auto& [prefill_length, prefill_signature] :
+       prefill_signature_map_) {
+    ASSIGN_OR_RETURN(auto* signature_run_buffers,
+                     GetPrefillRunBuffers(prefill_signature));
+    for (RunBuffers& run_buffers : *signature_run_buffers) {
+      auto res = compiled_model_.Run(run_buffers.signature_index,
+                                     run_buffers.inputs, run_buffers.outputs);
+      RET_CHECK(res) << "Failed to run compiled model: "
+                     << res.Error().Message();
+    }
+  }
+  for (int step = 0; step < num_decode_steps; ++step) {
+    RunBuffers& run_buffers = decode_run_buffers_[step % 2];
+    auto res = compiled_model_.Run(run_buffers.signature_index,
+                                   run_buffers.inputs, run_buffers.outputs);
+    RET_CHECK(res) << "Failed to run compiled model: " << res.Error().Message();
+    if (step == 0) {
+      if (decode_step_token_ids_.empty()) {
+        LITERT_ASSIGN_OR_RETURN_ABSL(
+            auto step_token_ids,
+            compiled_model_.CreateInputBuffer(kDecodeSignatureRunner,
+                                              signatures_.input_tokens));
+        decode_step_token_ids_.push_back(std::move(step_token_ids));
+      }
+      RETURN_IF_ERROR(
+          SampleLogits(run_buffers.outputs[run_buffers.output_logits],
+                       decode_step_token_ids_[0]));
+    }
+  }
+  // The sampler is kept, as it is created the same way for every session.
+  current_step_ = 0;
+  stage_latencies_.clear();
+  if (kv_cache_block_table_.has_value()) {
+    RETURN_IF_ERROR(kv_cache_block_table_->Release());
+  }
+  return absl::OkStatus();
+}
+
 absl::Status LlmLiteRtCompiledModelExecutor::Reset() {
   current_step_ = 0;
-  next_input_token_id_ = -1;
+  next_input_token_ids_.clear();
   processed_tokens_.clear();
-  sampler_.reset();
+  stage_latencies_.clear();
+  if (sampler_ != nullptr) {
+    // The sampler is reconfigured in place rather than created again, which
+    // spares setting up the GPU sampler for every session.
+    const proto::SamplerParameters params = GetInternalSamplerParams();
+    absl::Status status = sampler_->Reconfigure(
+        params.k(), params.p(), params.temperature(), params.seed());
+    if (!status.ok()) {
+      sampler_.reset();
+    }
+  }
+  if (kv_cache_block_table_.has_value()) {
+    RETURN_IF_ERROR(kv_cache_block_table_->Release());
+  }
   return absl::OkStatus();
 }
 
@@ -611,9 +2248,9 @@ absl::StatusOr<int> LlmLiteRtCompiledModelExecutor::GetVocabSize() {
 // Creates a LlmLiteRtCompiledModelExecutor from a LiteRt model.
 absl::StatusOr<std::unique_ptr<LlmLiteRtCompiledModelExecutor>>
 LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
-                                       ModelResources& resources) {
-  ASSIGN_OR_RETURN(auto litert_model,
-                   resources.GetTFLiteModel(ModelType::kTfLitePrefillDecode));
+                                       ModelResources& resources,
+                                       ModelType model_type) {
+  ASSIGN_OR_RETURN(auto litert_model, resources.GetTFLiteModel(model_type));
   // For the LlmLiteRtCompiledModelExecutor, ML_DRIFT backend is used by
   // default.
   // TODO(b/405424188): - Add support for NPU backends.
@@ -624,6 +2261,48 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
     activation_data_type = executor_settings.GetActivationDataType().value();
   }
   const Backend backend = executor_settings.GetBackend();
+  std::optional<CpuConfig> cpu_config;
+  if (backend == Backend::CPU) {
+    ASSIGN_OR_RETURN(cpu_config,
+                     executor_settings.GetBackendConfig<CpuConfig>());
+    if (!cpu_config->use_weight_cache) {
+      weight_cache_path = ":nocache";
+    }
+  }
+  if (executor_settings.GetModelAssets().fake_weights_mode() !=
+      FakeWeightsMode::FAKE_WEIGHTS_NONE) {
+    // The cache must not mix the weights packed from the fake and the real
+    // ones of the model.
+    weight_cache_path = ":nocache";
+  }
+  // The versioned weight cache, keyed by the model and the options the cached
+  // weights depend on. Falls back to the unversioned path if the cache cannot
+  // be keyed, e.g. when the cache file is passed as a file descriptor.
+  std::unique_ptr<WeightCache> weight_cache;
+  if (weight_cache_path != ":nocache") {
+    InitPhaseScope phase("Weight cache lookup");
+    std::stringstream cache_options;
+    cache_options << backend << "|" << activation_data_type;
+    if (cpu_config.has_value() && cpu_config->dynamic_range_quantization) {
+      // The weights are packed for the int8 kernels.
+      cache_options << "|dynamic_range_quantization";
+    }
+    auto created_weight_cache = WeightCache::Create(
+        executor_settings, cache_options.str(),
+        backend == Backend::CPU ? ".xnnpack_cache" : ".gpu_cache");
+    if (created_weight_cache.ok()) {
+      weight_cache = *std::move(created_weight_cache);
+    } else {
+      ABSL_LOG(INFO) << "Using the unversioned weight cache: "
+                     << created_weight_cache.status();
+    }
+  }
+  // Whether the GPU reads the weights from the pages of the model file, which
+  // must then stay mapped.
+  bool import_host_weights = false;
+  // The number of command buffers the GPU delegate records and replays with
+  // GpuConfig::replay_command_buffers, one per kv-cache parity of the decode.
+  constexpr int kNumReplayedCommandBuffers = 2;
   switch (backend) {
     case Backend::GPU: {
       // TODO: b/403132820 - Add accelerator compilation options for ML_DRIFT.
@@ -639,18 +2318,43 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
         gpu_compilation_options.SetDelegatePrecision(
             LiteRtDelegatePrecision::kLiteRtDelegatePrecisionFp16);
       }
-      gpu_compilation_options.SetPreferTextureWeights(true);
+      auto gpu_config = executor_settings.GetBackendConfig<GpuConfig>();
+      if (gpu_config.ok() && gpu_config->import_host_weights) {
+        import_host_weights = resources.IsTFLiteModelPageAligned(model_type);
+        if (!import_host_weights) {
+          ABSL_LOG(INFO) << "The model is not page-aligned in the model file, "
+                            "so its weights are copied to the GPU.";
+        }
+      }
+      if (gpu_config.ok() && gpu_config->replay_command_buffers) {
+        gpu_compilation_options.SetNumStepsOfCommandBufferPreparations(
+            kNumReplayedCommandBuffers);
+      }
+      // The textures are a copy of the weights in another layout, while the
+      // buffer weights are read from the pages of the model.
+      gpu_compilation_options.SetPreferTextureWeights(!import_host_weights);
+      if (weight_cache != nullptr && !weight_cache->GetPath().has_value()) {
+        // Another process is building the cache.
+        weight_cache_path = ":nocache";
+      }
       if (weight_cache_path != ":nocache") {
         ASSIGN_OR_RETURN(auto model_path,
                          executor_settings.GetModelAssets().GetPath());
-        if (weight_cache_path.empty()) {
+        std::string model_cache_key(Basename(model_path));
+        if (weight_cache != nullptr) {
+          // The delegate names its cache files after the key, next to the
+          // header of the weight cache.
+          weight_cache_path = std::string(Dirname(*weight_cache->GetPath()));
+          absl::StrAppend(&model_cache_key, ".", weight_cache->GetKey());
+        } else if (weight_cache_path.empty()) {
           weight_cache_path = Dirname(model_path);
         }
         gpu_compilation_options.SetSerializationDir(weight_cache_path.c_str());
-        absl::string_view model_name = Basename(model_path);
-        gpu_compilation_options.SetModelCacheKey(model_name.data());
+        gpu_compilation_options.SetModelCacheKey(model_cache_key.c_str());
         gpu_compilation_options.SetSerializeProgramCache(true);
-        gpu_compilation_options.SetSerializeExternalTensors(true);
+        // The weights read in place are not converted, so not cached either.
+        gpu_compilation_options.SetSerializeExternalTensors(
+            !import_host_weights);
       }
       gpu_compilation_options.EnableNoImmutableExternalTensorsMode(true);
       // This option prevents KVCache handling from being affected by
@@ -664,10 +2368,57 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
     case Backend::CPU: {
       // TODO: b/403132820 - Add accelerator compilation options for XNNPACK.
       Expected<CpuOptions> cpu_compilation_options = CpuOptions::Create();
-      const uint32_t num_threads =
-          executor_settings.GetBackendConfig<CpuConfig>()->number_of_threads;
+      uint32_t num_threads = cpu_config->number_of_threads;
+      if (cpu_config->prefer_performance_cores) {
+        // XNNPACK does not pin its threads, so they are kept off the slower
+        // cores by being no more than the performance cores.
+        const std::set<int> performance_cores = GetPerformanceCores();
+        if (!performance_cores.empty() &&
+            performance_cores.size() < num_threads) {
+          ABSL_LOG(INFO) << "Capping the " << num_threads
+                         << " CPU threads to the "
+                         << performance_cores.size() << " performance cores.";
+          num_threads = performance_cores.size();
+        }
+      }
       cpu_compilation_options->SetNumThreads(num_threads);
-      if (weight_cache_path != ":nocache") {
+      if (activation_data_type == ActivationDataType::INT16) {
+        return absl::UnimplementedError(
+            "XNNPACK has no int16 activation kernels; use int8 or float "
+            "activations on CPU.");
+      }
+      uint32_t quantization_flags = 0;
+      if (cpu_config->dynamic_range_quantization) {
+        quantization_flags |= TFLITE_XNNPACK_DELEGATE_FLAG_QS8;
+      }
+      if (activation_data_type == ActivationDataType::INT8) {
+        // The quantized ops of a model with int8 activations run on the int8
+        // kernels, and the float matmuls of int8 weights quantize their
+        // inputs on the fly.
+        quantization_flags |=
+            TFLITE_XNNPACK_DELEGATE_FLAG_QS8 |
+            TFLITE_XNNPACK_DELEGATE_FLAG_QU8 |
+            TFLITE_XNNPACK_DELEGATE_FLAG_DYNAMIC_FULLY_CONNECTED;
+      }
+      if (quantization_flags != 0) {
+        LITERT_ASSIGN_OR_RETURN_ABSL(
+            uint32_t xnnpack_flags, cpu_compilation_options->GetXNNPackFlags());
+        cpu_compilation_options->SetXNNPackFlags(xnnpack_flags |
+                                                 quantization_flags);
+      }
+      if (weight_cache != nullptr) {
+        // Another process may be building the cache.
+        weight_cache_path = weight_cache->GetPath().value_or(":nocache");
+#if !defined(_WIN32)
+      } else if (weight_cache_path != ":nocache" &&
+                 executor_settings.GetScopedCacheFile() != nullptr) {
+        // The packed weights go to the cache file given by the caller, e.g.
+        // an app that cannot write next to the model.
+        cpu_compilation_options->SetXNNPackWeightCacheFileDescriptor(
+            executor_settings.GetScopedCacheFile()->file());
+        weight_cache_path = ":nocache";
+#endif  // !defined(_WIN32)
+      } else if (weight_cache_path != ":nocache") {
         ASSIGN_OR_RETURN(auto model_path,
                          executor_settings.GetModelAssets().GetPath());
         if (weight_cache_path.empty()) {
@@ -676,6 +2427,8 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
           ASSIGN_OR_RETURN(weight_cache_path,
                            JoinPath(weight_cache_path, Basename(model_path)));
         }
+      }
+      if (weight_cache_path != ":nocache") {
         cpu_compilation_options->SetXNNPackWeightCachePath(
             weight_cache_path.c_str());
       }
@@ -702,12 +2455,23 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
   if (!litert_model || !*litert_model) {
     return absl::InternalError("Failed to build LiteRt model");
   }
+  // The delegate loads the weights from a valid weight cache, or packs them
+  // and saves them to the cache, while it compiles the model.
+  absl::string_view compilation_phase = "Model compilation";
+  if (weight_cache != nullptr && weight_cache->IsValid()) {
+    compilation_phase = "Model compilation with weight cache load";
+  } else if (weight_cache != nullptr && weight_cache->GetPath().has_value()) {
+    compilation_phase = "Model compilation with weight cache save";
+  }
+  std::optional<InitPhaseScope> init_phase;
+  init_phase.emplace(compilation_phase);
   auto compiled_model = ::litert::CompiledModel::Create(
       *lrt_env, *litert_model, std::move(*compilation_options));
   if (!compiled_model) {
     return absl::InternalError(absl::StrCat("Failed to create compiled model: ",
                                             compiled_model.Error().Message()));
   }
+  init_phase.emplace("Buffer allocation");
 
   absl::flat_hash_map<absl::string_view, TensorBuffer> prefill_input_buffers;
   absl::flat_hash_map<absl::string_view, TensorBuffer> prefill_output_buffers;
@@ -738,12 +2502,25 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
       GetModelSignaturesFromInputOutputNames(decode_signature->InputNames(),
                                              decode_signature->OutputNames()));
 
+  // The kv-cache is updated in place on CPU, and on GPU if the model supports
+  // it, so its inputs and outputs share the same buffers. Otherwise each run
+  // reads one copy of the kv-cache and writes the other.
+  bool in_place_kv_cache_update = backend == Backend::CPU;
+  bool async_prefill = false;
+  bool measure_device_time = false;
+  if (auto gpu_config = executor_settings.GetBackendConfig<GpuConfig>();
+      backend == Backend::GPU && gpu_config.ok()) {
+    in_place_kv_cache_update = gpu_config->in_place_kv_cache_update;
+    async_prefill = gpu_config->async_prefill;
+    measure_device_time = gpu_config->measure_device_time;
+  }
   for (auto input_name : prefill_signature->InputNames()) {
     // Skip creating buffers for the input tokens, positions and attn mask. Move
     // into prefill function to create them based on the ids size.
     if (input_name == signatures.input_tokens ||
         input_name == signatures.input_positions ||
-        input_name == signatures.input_attn_mask) {
+        input_name == signatures.input_attn_mask ||
+        input_name == signatures.input_step_params) {
       continue;
     }
     auto input_buffer =
@@ -755,7 +2532,7 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
     }
     if (absl::StartsWith(input_name, kv_cache_k_root_name) ||
         absl::StartsWith(input_name, kv_cache_v_root_name)) {
-      if (backend == Backend::CPU) {
+      if (in_place_kv_cache_update) {
         auto output_buffer = input_buffer->Duplicate();
         RET_CHECK(output_buffer) << "Failed to duplicate input buffer.";
         output_kv_cache_buffers[input_name] = std::move(*output_buffer);
@@ -775,11 +2552,11 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
     }
     if (absl::StartsWith(output_name, kv_cache_k_root_name) ||
         absl::StartsWith(output_name, kv_cache_v_root_name)) {
-      if (backend == Backend::GPU) {
+      if (!in_place_kv_cache_update) {
         output_kv_cache_buffers[output_name] = std::move(*output_buffer);
       }
-      // For CPU, we will use single buffer for kv cache input and output to
-      // improve performance and memory usage.
+      // Otherwise the output aliases the kv-cache input, which halves the
+      // kv-cache memory.
     } else {
       prefill_output_buffers[output_name] = std::move(*output_buffer);
     }
@@ -820,16 +2597,44 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
                                output_logits_buffer->TensorType());
   RET_CHECK(output_logits_buffer_tensor_type.Layout().Dimensions().size() == 3)
       << "Output logits must be (batch, seq, vocab)";
-  RET_CHECK(output_logits_buffer_tensor_type.Layout().Dimensions()[0] == 1)
-      << "Only support batch size 1 for now.";
   int batch_size = output_logits_buffer_tensor_type.Layout().Dimensions()[0];
+  init_phase.reset();
 
+  // The step parameters have no sequence dimension, so the prefill length of
+  // a model taking them is that of its tokens.
   ASSIGN_OR_RETURN(auto prefill_runner_set,
                    GetPrefillRunnerSetFromModel(
                        *litert_model, kPrefillSignatureRunner,
-                       /*input_positions_name=*/signatures.input_positions));
+                       /*input_length_name=*/signatures.input_positions.empty()
+                           ? signatures.input_tokens
+                           : signatures.input_positions));
   RET_CHECK(!prefill_runner_set.empty()) << "No prefill runner available.";
 
+  // The decode signatures attending over a prefix of the kv-cache, if any, are
+  // run while the context fits in it. The paged kv-cache maps the positions to
+  // blocks of the whole kv-cache, so it only runs the full decode signature.
+  SortedDecodeSignatureMap decode_signature_map;
+  if (!executor_settings.GetKvCacheBlockSize().has_value()) {
+    std::string kv_cache_input_name;
+    for (auto input_name : decode_signature->InputNames()) {
+      if (absl::StartsWith(input_name, kv_cache_k_root_name)) {
+        kv_cache_input_name = std::string(input_name);
+        break;
+      }
+    }
+    RET_CHECK(!kv_cache_input_name.empty())
+        << "No kv-cache input in " << kDecodeSignatureRunner;
+    ASSIGN_OR_RETURN(decode_signature_map,
+                     GetKvBucketedDecodeSignaturesFromModel(
+                         *litert_model, kKvBucketedDecodeSignatureRunner,
+                         kDecodeSignatureRunner, kv_cache_input_name));
+    for (const auto& [kv_cache_length, signature] : decode_signature_map) {
+      ABSL_LOG(INFO) << "Decode signature " << signature
+                     << " attends over " << kv_cache_length
+                     << " kv-cache positions.";
+    }
+  }
+
   // Create embedding lookups from the resources.
   std::unique_ptr<EmbeddingLookupText> embedding_lookup;
   auto embedder_model = resources.GetTFLiteModel(ModelType::kTfLiteEmbedder);
@@ -847,7 +2652,86 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
                      EmbeddingLookupText::Create(*per_layer_embedder_model));
   }
 
-  return absl::WrapUnique(new LlmLiteRtCompiledModelExecutor(
+  // The decode embedding cache budget is split such that each cached token
+  // holds both its embedding and its per-layer embedding rows.
+  if (executor_settings.GetEmbeddingCacheBudgetBytes() > 0) {
+    size_t bytes_per_token = 0;
+    for (const auto* lookup :
+         {embedding_lookup.get(), per_layer_embedding_lookup.get()}) {
+      if (lookup != nullptr) {
+        bytes_per_token += lookup->GetFloatsPerToken() * sizeof(float);
+      }
+    }
+    if (bytes_per_token > 0) {
+      const size_t max_num_tokens =
+          executor_settings.GetEmbeddingCacheBudgetBytes() / bytes_per_token;
+      for (auto* lookup :
+           {embedding_lookup.get(), per_layer_embedding_lookup.get()}) {
+        if (lookup != nullptr) {
+          lookup->SetDecodeCacheCapacity(max_num_tokens);
+        }
+      }
+    }
+  }
+
+  // The per-layer embedding table can be larger than the transformer
+  // weights, so its pages are dropped once the rows read exceed the budget.
+  if (per_layer_embedding_lookup != nullptr &&
+      executor_settings.GetPerLayerEmbeddingMappedBudgetBytes() > 0) {
+    per_layer_embedding_lookup->SetMappedRowBudget(
+        executor_settings.GetPerLayerEmbeddingMappedBudgetBytes(),
+        [&resources]() {
+          resources.ReleaseTFLiteModelMemory(
+              ModelType::kTfLitePerLayerEmbedder);
+        });
+  }
+
+  // The model larger than the RAM headroom is paged from the mapped file: the
+  // pages read by a run are dropped once beyond the budget, so the next runs
+  // read them from the file again.
+  std::function<void()> trim_model_memory;
+  if (cpu_config.has_value() && cpu_config->model_resident_budget_bytes > 0) {
+    trim_model_memory = [&resources, model_type,
+                         budget = cpu_config->model_resident_budget_bytes]() {
+      auto resident_bytes = resources.GetTFLiteModelResidentBytes(model_type);
+      if (resident_bytes.ok() && *resident_bytes > budget) {
+        resources.ReleaseTFLiteModelMemory(model_type);
+      }
+    };
+  }
+
+  // Build the block pool for the paged kv-cache. The pool covers the whole
+  // kv-cache; contexts only take the blocks they grow into.
+  std::unique_ptr<KvCacheBlockAllocator> kv_cache_block_allocator;
+  if (executor_settings.GetKvCacheBlockSize().has_value()) {
+    const int block_size = executor_settings.GetKvCacheBlockSize().value();
+    const int max_num_tokens = executor_settings.GetMaxNumTokens();
+    RET_CHECK_GT(max_num_tokens, 0).SetCode(absl::StatusCode::kInvalidArgument)
+        << "max_num_tokens must be set to enable the paged kv-cache.";
+    RET_CHECK_GT(block_size, 0).SetCode(absl::StatusCode::kInvalidArgument)
+        << "kv_cache_block_size must be positive.";
+    ASSIGN_OR_RETURN(kv_cache_block_allocator,
+                     KvCacheBlockAllocator::Create(
+                         /*num_blocks=*/(max_num_tokens + block_size - 1) /
+                             block_size,
+                         block_size));
+  }
+
+  // The int8 or int16 logits of a model with quantized activations are
+  // dequantized for the samplers.
+  std::optional<std::pair<float, int32_t>> logits_quantization;
+  if (auto it = decode_output_buffers.find(signatures.output_logits);
+      it != decode_output_buffers.end()) {
+    LITERT_ASSIGN_OR_RETURN_ABSL(auto logits_type, it->second.TensorType());
+    if (logits_type.ElementType() == ::litert::ElementType::Int8 ||
+        logits_type.ElementType() == ::litert::ElementType::Int16) {
+      ASSIGN_OR_RETURN(logits_quantization,
+                       GetLogitsQuantization(*litert_model,
+                                             signatures.output_logits));
+    }
+  }
+
+  auto executor = absl::WrapUnique(new LlmLiteRtCompiledModelExecutor(
       std::move(executor_settings), std::move(*lrt_env), litert_model,
       std::move(*compiled_model), std::move(prefill_input_buffers),
       std::move(prefill_output_buffers), std::move(decode_input_buffers),
@@ -855,6 +2739,41 @@ LlmLiteRtCompiledModelExecutor::Create(LlmExecutorSettings executor_settings,
       std::move(output_kv_cache_buffers), std::move(prefill_runner_set),
       signatures, batch_size, weight_cache_path, std::move(embedding_lookup),
       std::move(per_layer_embedding_lookup), activation_data_type));
+  executor->weight_cache_ = std::move(weight_cache);
+  executor->async_prefill_ = async_prefill;
+  executor->measure_device_time_ = measure_device_time;
+  // The float masks of the models computing in reduced precision, or with
+  // quantized activations, keep their masked value within the float16 range.
+  executor->mask_precision_f16_ =
+      activation_data_type != ActivationDataType::FLOAT32;
+  executor->logits_quantization_ = logits_quantization;
+  executor->trim_model_memory_ = std::move(trim_model_memory);
+  executor->decode_signature_map_ = std::move(decode_signature_map);
+  // The per layer embeddings are looked up on their own thread, as their
+  // lookup takes about as long as the one of the embeddings.
+  if (executor->embedding_lookup_ != nullptr &&
+      executor->per_layer_embedding_lookup_ != nullptr) {
+    executor->embedding_lookup_pool_ = std::make_unique<ThreadPool>(
+        /*name_prefix=*/"embedding_lookup", /*max_num_threads=*/1);
+  }
+  if (kv_cache_block_allocator != nullptr) {
+    executor->kv_cache_block_allocator_ = std::move(kv_cache_block_allocator);
+    executor->kv_cache_block_table_.emplace(
+        executor->kv_cache_block_allocator_.get());
+  }
+  RETURN_IF_ERROR(executor->InitLoraInputs());
+  RETURN_IF_ERROR(executor->BindRunBuffers());
+  if (executor->executor_settings_.GetAutotunePrefillWorkGroups()) {
+    // The signatures are run to be measured, which also warms them up.
+    InitPhaseScope phase("Prefill signature cost measurement");
+    RETURN_IF_ERROR(executor->LoadOrMeasurePrefillSignatureCosts());
+  }
+  // On GPU, the weights are uploaded by now, so the pages of the model read
+  // so far are released. They are read from the file again if needed.
+  if (backend == Backend::GPU && !import_host_weights) {
+    resources.ReleaseTFLiteModelMemory(model_type);
+  }
+  return executor;
 }
 
 }  // namespace litert::lm
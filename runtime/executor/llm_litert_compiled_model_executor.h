@@ -15,7 +15,12 @@
 #ifndef THIRD_PARTY_ODML_INFRA_GENAI_INFERENCE_EXECUTOR_LLM_TFLITE_GPU_EXECUTOR_H_
 #define THIRD_PARTY_ODML_INFRA_GENAI_INFERENCE_EXECUTOR_LLM_TFLITE_GPU_EXECUTOR_H_
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <memory>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
@@ -26,6 +31,7 @@
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
 #include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_compiled_model.h"  // from @litert
 #include "litert/cc/litert_environment.h"  // from @litert
@@ -35,10 +41,15 @@
 #include "runtime/components/model_resources.h"
 #include "runtime/components/sampler.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/kv_cache_block_allocator.h"
+#include "runtime/executor/kv_cache_layout.h"
 #include "runtime/executor/litert_compiled_model_executor_utils.h"
 #include "runtime/executor/llm_executor.h"
 #include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/executor/weight_cache.h"
+#include "runtime/framework/threadpool.h"
+#include "runtime/util/memory_usage.h"
 
 namespace litert::lm {
 
@@ -48,9 +59,13 @@ namespace litert::lm {
 // TODO: b/361667248 - Add test for LlmTfLiteGpuExecutor.
 class LlmLiteRtCompiledModelExecutor : public LlmExecutor {
  public:
-  // Creates a LlmLiteRtCompiledModelExecutor from a LiteRt model.
+  // Creates a LlmLiteRtCompiledModelExecutor from a LiteRt model. The
+  // model_type selects the model section of the resources to run, e.g.
+  // kTfLiteDraft for the draft model of speculative decoding. A draft model
+  // must take token ids as input.
   static absl::StatusOr<std::unique_ptr<LlmLiteRtCompiledModelExecutor>> Create(
-      LlmExecutorSettings executor_settings, ModelResources& resources);
+      LlmExecutorSettings executor_settings, ModelResources& resources,
+      ModelType model_type = ModelType::kTfLitePrefillDecode);
 
   // Input APIs:
   // Basic API to trigger the "prefill" or "prefix" process.
@@ -61,12 +76,25 @@ class LlmLiteRtCompiledModelExecutor : public LlmExecutor {
   };
 
   // Advanced API to allow customized query parameters.
-  // Input is token ids with shape `[batch, sequence_length]`
+  // Input is token ids with shape `[batch, sequence_length]`, where batch is
+  // either the batch size of the model or 1. A single row is prefilled into
+  // every batch row, so that the output candidates decoded next all continue
+  // from the same prompt.
+  //
+  // On a model taking input embeddings, the ids equal to
+  // ExecutorVisionData::kSpecialToken are placeholders for the rows of the
+  // vision embeddings of `inputs`, if any, e.g. soft prompts or document
+  // encodings computed outside of the model. The rows are copied straight from
+  // the host buffer of `inputs` into the embeddings input of the model, and the
+  // last id must not be a placeholder.
   absl::Status Prefill(const ExecutorInputs& inputs,
                        const ExecutorPrefillParams& params) override;
 
   // Output APIs:
-  // Basic API to trigger the "decode" process.
+  // Basic API to trigger the "decode" process. When `output_tokens` has the
+  // shape `[batch, num_steps]` with num_steps > 1, runs num_steps decode steps
+  // that each sample the input of the next step on the device, and
+  // synchronizes with the host only once to read back all the sampled ids.
   absl::Status Decode(::litert::TensorBuffer& output_tokens) override;
 
   // Basic API to trigger the "decode" process but without sampling.
@@ -80,6 +108,10 @@ class LlmLiteRtCompiledModelExecutor : public LlmExecutor {
   absl::StatusOr<::litert::TensorBuffer> DecodeLogits(
       const ExecutorInputs& inputs) override;
 
+  absl::Status DecodeTopKLogits(
+      const ExecutorInputs& inputs, ::litert::TensorBuffer& output_topk_logits,
+      ::litert::TensorBuffer& output_topk_ids) override;
+
   absl::string_view ExecutorBackendName() const override {
     return "LiteRT Compiled Model";
   }
@@ -94,9 +126,113 @@ class LlmLiteRtCompiledModelExecutor : public LlmExecutor {
   // users prefill 100 tokens, then they expect the current step to be 100). It
   // is different from the internal current step.
   absl::StatusOr<int> GetCurrentStep() const override {
-    return current_step_ + (next_input_token_id_ == -1 ? 0 : 1);
+    return current_step_ + (next_input_token_ids_.empty() ? 0 : 1);
+  }
+
+  absl::StatusOr<int> GetMaxPrefillLength() const override {
+    if (prefill_signature_map_.empty()) {
+      return absl::FailedPreconditionError("The model has no prefill.");
+    }
+    // The signatures are sorted by decreasing length.
+    return prefill_signature_map_.begin()->first;
+  }
+
+  // Copies the current kv-cache to host memory together with the step
+  // counters.
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() override;
+
+  // Writes the kv-cache contents of the checkpoint back into the kv-cache
+  // buffers and restores the step counters.
+  absl::Status RestoreState(const ExecutorCheckpoint& checkpoint) override;
+
+  // Returns the layouts of the kv-cache buffers. Not implemented for the paged
+  // kv-cache, whose blocks are not in token order, nor for the int8
+  // checkpoints.
+  absl::StatusOr<KvCacheLayouts> GetKvCacheLayouts() const override;
+
+  // Verifies the draft tokens with one run of the shortest prefill signature
+  // that fits them. Requires the prefill signatures to output logits, and
+  // returns UnimplementedError otherwise.
+  absl::StatusOr<std::vector<int>> VerifyDraftTokens(
+      absl::Span<const int> draft_token_ids) override;
+
+  // Scores the tokens in runs of the longest prefill signature, and rolls the
+  // kv-cache back after each of them. Requires the prefill signatures to output
+  // logits, and returns UnimplementedError otherwise.
+  absl::StatusOr<std::vector<float>> ScoreTokens(
+      absl::Span<const int> token_ids) override;
+
+  // Runs the rows in batches through the "embed" signature of the model, which
+  // must only take the tokens and positions, and output the "hidden_states" of
+  // [batch, seq, dim]. Rows longer than the signature are rejected.
+  absl::StatusOr<std::vector<std::vector<float>>> EmbedTokens(
+      absl::Span<const std::vector<int>> token_ids,
+      EmbeddingPooling pooling) override;
+
+  // Rolls back the step counters. The kv-cache entries after
+  // `num_processed_tokens` are masked out and overwritten by later runs.
+  absl::Status Rollback(int num_processed_tokens,
+                        int next_input_token_id) override;
+
+  // Gets the pending input token of the first batch row.
+  absl::StatusOr<int> GetNextInputTokenId() const override {
+    return next_input_token_ids_.empty() ? -1 : next_input_token_ids_[0];
   }
 
+  // Reorders the batch rows of the kv-cache of every layer on host memory.
+  absl::Status ReorderBatchRows(absl::Span<const int> source_rows) override;
+
+  // Shifts the kv-cache of every layer. The length of the kv-cache is taken
+  // from the attention mask, or from the max number of tokens if the model
+  // has no attention mask input.
+  absl::Status ShiftContext(int num_sink_tokens,
+                            int num_discarded_tokens) override;
+
+  // Compacts the kv-cache of every layer in place, in one pass per buffer.
+  absl::Status CompactContext(
+      absl::Span<const std::pair<int, int>> discarded_ranges) override;
+
+  // Copies the adapter weights into buffers of the LoRA inputs of the model.
+  absl::Status LoadLoraAdapter(absl::string_view serialized_adapter) override;
+
+  absl::Status UnloadLoraAdapter(absl::string_view name) override;
+
+  // Rebinds the LoRA inputs of every signature to the weights of the adapter.
+  // No weights are copied.
+  absl::Status SelectLoraAdapter(absl::string_view name) override;
+
+  // Copies the weights of the adapter of each row into the rows of buffers of
+  // the LoRA inputs, and binds them. The model applies the deltas per row, so
+  // its LoRA inputs must be batched, i.e. of [batch, ...], unless all the rows
+  // select the same adapter.
+  absl::Status SelectLoraAdapters(
+      absl::Span<const std::string> names) override;
+
+  // Reports the latencies of filling the inputs, running the model and, for
+  // Decode with sampling, sampling the logits.
+  absl::StatusOr<ExecutorStageLatencies> GetStageLatencies() const override {
+    return ExecutorStageLatencies(stage_latencies_.begin(),
+                                  stage_latencies_.end());
+  }
+
+  absl::StatusOr<EmbeddingCacheStats> GetEmbeddingCacheStats() const override;
+
+  absl::StatusOr<int> GetPrefillChunkSize() const override;
+
+  // Clears the decode embedding caches, and frees the ids the prefill
+  // gathers per work group and the buffers of the embed signature.
+  absl::Status ReleaseCaches() override;
+
+  // Reports the kv-cache, the prefill and decode buffers, the LoRA weights
+  // and the decode embedding cache. The buffers duplicated from one another
+  // share their memory, so they are counted once.
+  absl::StatusOr<MemoryUsage> GetMemoryUsage() const override;
+
+  // Runs every prefill signature and the decode signature on both kv-cache
+  // parities, and creates the decode sampler, on the bound buffers as they
+  // are.
+  absl::Status Warmup(int num_decode_steps) override;
+
   // Resets all of the internal states.
   absl::Status Reset() override;
 
@@ -147,18 +283,207 @@ class LlmLiteRtCompiledModelExecutor : public LlmExecutor {
         logits_data_type_(logits_data_type) {}
 
  private:
+  // The buffers passed to one CompiledModel::Run() call, in the order of the
+  // inputs and outputs of its signature, such that the run binds them by
+  // position instead of looking every name up. They are duplicated once from
+  // the executor buffers and reused on every step, since the duplicates share
+  // the underlying memory.
+  struct RunBuffers {
+    size_t signature_index = 0;
+    std::vector<absl::string_view> input_names;
+    std::vector<::litert::TensorBuffer> inputs;
+    std::vector<absl::string_view> output_names;
+    std::vector<::litert::TensorBuffer> outputs;
+    // The positions in `inputs` and `outputs` of the buffers filled or read on
+    // every step, resolved from signatures_ once when binding, or -1 if the
+    // signature has none.
+    int input_tokens = -1;
+    int input_positions = -1;
+    int input_attn_mask = -1;
+    int input_step_params = -1;
+    int input_embeddings = -1;
+    int input_per_layer_embeddings = -1;
+    int output_logits = -1;
+    int output_hidden_states = -1;
+  };
+
+  // Returns duplicates of the buffers of `names`, in that order, each taken
+  // from `buffers` or else from `kv_cache_buffers`.
+  static absl::StatusOr<std::vector<::litert::TensorBuffer>> DuplicateBuffers(
+      absl::Span<const absl::string_view> names,
+      const absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>&
+          buffers,
+      const absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>&
+          kv_cache_buffers);
+
+  // Returns the run buffers of `signature_key`, duplicated from `*_buffers`,
+  // with the positions of the per step buffers resolved.
+  absl::StatusOr<RunBuffers> CreateRunBuffers(
+      absl::string_view signature_key,
+      const absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>&
+          input_buffers,
+      const absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>&
+          output_buffers,
+      const absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>&
+          input_kv_cache_buffers,
+      const absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>&
+          output_kv_cache_buffers) const;
+
+  // Returns the run buffers of the embed signature, binding them on first use.
+  // They are created for the signature alone, since it has no kv-cache.
+  absl::StatusOr<RunBuffers*> GetEmbedRunBuffers();
+
+  // Builds the run buffers of the prefill signatures and of the decode
+  // signature, for both kv-cache parities. With lazy prefill signatures, only
+  // the smallest prefill signature is bound here. Called once from Create().
+  absl::Status BindRunBuffers();
+
+  // Returns the number of token positions of the kv-cache, taken from the
+  // attention mask, or the max number of tokens if the model has no attention
+  // mask input.
+  absl::StatusOr<int> GetKvCacheLength() const;
+
+  // Returns the run buffers of `prefill_signature` for both kv-cache parities,
+  // binding them on first use. The token, position, embedding and attention
+  // mask inputs of each prefill signature are allocated once and reused by
+  // every prefill, once per parity with the asynchronous prefill. Binding
+  // another signature invalidates the returned pointer.
+  absl::StatusOr<std::array<RunBuffers, 2>*> GetPrefillRunBuffers(
+      absl::string_view prefill_signature);
+
+  // Releases the run buffers of the prefill signatures but the smallest one,
+  // if LlmExecutorSettings::GetReleasePrefillBuffers(). Called after the
+  // decode runs, which wait for the prefills enqueued before them, such that
+  // the buffers are no longer used by the delegate.
+  void MaybeReleasePrefillRunBuffers();
+
+  // Returns the run buffers of the next decode step for the current kv-cache
+  // parity, i.e. those of the decode signature of the shortest kv-cache
+  // covering the current step.
+  RunBuffers& GetDecodeRunBuffers();
+
+  // Binds the run buffers of every kv-bucketed decode signature for both
+  // kv-cache parities. They share the decode inputs and outputs, and the
+  // kv-cache buffers, except for the attention mask which depends on the
+  // kv-cache length. Called once from BindRunBuffers().
+  absl::Status BindKvBucketedDecodeRunBuffers();
+
+  // Sets prefill_signature_costs_ from the cost file next to the weight cache,
+  // or measures the latency of each prefill signature and writes the file.
+  // Must be called before the first prefill, since the measuring runs do not
+  // keep the kv-cache. Called once from Create() if enabled in the settings.
+  absl::Status LoadOrMeasurePrefillSignatureCosts();
+
+  // Returns which of the two kv-cache buffer sets is currently the input,
+  // i.e. the index into the run buffers to use for the next run.
+  int KvCacheParity() const {
+    return input_kv_cache_buffers_ == &kv_cache_buffers_1_ ? 0 : 1;
+  }
+
   // Samples output logits and write to ids_tensor.
   absl::Status SampleLogits(const TensorBuffer& logits,
                             TensorBuffer& ids_tensor);
 
   // Prefill internal implementation, for one prefill call to the Interpreter
-  // with a certain length.
+  // with a certain length. `ids` holds `batch_size` rows of the same length,
+  // laid out row by row. The run is only enqueued if `wait_for_completion` is
+  // false and the asynchronous prefill is enabled.
   absl::Status PrefillInternal(absl::string_view prefill_signature,
-                               absl::Span<const int> ids);
+                               absl::Span<const int> ids, int batch_size,
+                               bool wait_for_completion = true);
+
+  // Fills the decode input buffers with one token per batch row, taken from
+  // `inputs` if provided or from the pending next input token ids otherwise,
+  // together with the positions and the attention mask of the current step.
+  absl::Status FillDecodeInputs(const ExecutorInputs& inputs);
+
+  // Fills the decode positions and the attention mask of the current step, or
+  // the step parameters they are derived from on device.
+  absl::Status FillDecodePositions();
+
+  // Runs `lookup` of the embeddings on this thread and `per_layer_lookup` of
+  // the per layer embeddings on `embedding_lookup_pool_` at the same time, or
+  // one after the other without the pool, and returns the first error.
+  absl::Status RunEmbeddingLookups(
+      const std::function<absl::Status()>& lookup,
+      const std::function<absl::Status()>& per_layer_lookup);
+
+  // Adds the time elapsed since `start` to the latency of `stage`.
+  void RecordStageLatency(absl::string_view stage, absl::Time start);
+
+  // Runs the signature of `run_buffers`. If the device time is measured, the
+  // run is enqueued, and the wait for the events of its outputs is added to
+  // `device_stage`.
+  absl::Status RunSignature(RunBuffers& run_buffers,
+                            absl::string_view device_stage);
+
+  // Waits for the events of the outputs of `run_buffers`, i.e. for the last
+  // enqueued run of them to complete.
+  absl::Status WaitForRunOutputs(RunBuffers& run_buffers);
+
+  // Drops the pages of the mapped model once more of it than the budget of
+  // CpuConfig::model_resident_budget_bytes is resident. Called after each
+  // model run, and a no-op if no budget is set.
+  void TrimModelMemory() {
+    if (trim_model_memory_) {
+      trim_model_memory_();
+    }
+  }
+
+  // Runs `num_steps` decode steps, sampling the input of each step from the
+  // output of the previous one, and writes the sampled ids into
+  // `output_tokens` of shape `[batch, num_steps]`.
+  absl::Status DecodeSteps(int num_steps,
+                           ::litert::TensorBuffer& output_tokens);
+
+  // Decode internal implementation, without result downloading. Returns the
+  // logits output buffer of the run, which stays valid until the next decode
+  // with the same kv-cache parity. On GPU it is a device buffer, which the
+  // caller hands on without locking it.
+  absl::StatusOr<::litert::TensorBuffer*> DecodeInternal(
+      const ExecutorInputs& inputs);
+
+  // Dequantizes the quantized `logits` of a decode into dequantized_logits_,
+  // which stays valid until the next call.
+  absl::StatusOr<::litert::TensorBuffer*> GetDequantizedLogits(
+      const ::litert::TensorBuffer& logits);
+
+  // What an attention mask buffer was last filled with, such that the next
+  // fill only rewrites the entries that change.
+  struct AttentionMaskState {
+    bool initialized = false;
+    int start_step = 0;
+    int steps = 0;
+  };
+
+  // Fills `mask` for `steps` steps from `start_step`, initializing it on first
+  // use and rewriting only the entries that differ from the fill recorded in
+  // `state`, which is updated to the new fill.
+  absl::Status UpdateAttentionMaskForSteps(::litert::TensorBuffer& mask,
+                                           AttentionMaskState& state,
+                                           int start_step, int steps);
+
+  // Returns the attention mask state of the run buffers of
+  // GetDecodeRunBuffers().
+  AttentionMaskState& GetDecodeAttentionMaskState();
+
+  // Makes sure the paged kv-cache holds enough blocks for `num_tokens`
+  // positions. No-op when the paged kv-cache is disabled.
+  absl::Status ReserveKvCacheBlocks(int num_tokens);
 
-  // Decode internal implementation, without result downloading.
-  // Caller of this function is responsible for capturing the output.
-  absl::Status DecodeInternal(ExecutorInputs inputs);
+  // Zeroes the LoRA inputs of the model, if any, and records them as the
+  // weights of the base model. Called once from Create(), before the run
+  // buffers are bound.
+  absl::Status InitLoraInputs();
+
+  // Creates a buffer of the LoRA input `input_name`.
+  absl::StatusOr<::litert::TensorBuffer> CreateLoraInputBuffer(
+      absl::string_view input_name);
+
+  // Binds `weights`, keyed by the LoRA input name, to the LoRA inputs of the
+  // executor buffers and of every run buffers.
+  absl::Status BindLoraWeights(
+      const absl::flat_hash_map<std::string, ::litert::TensorBuffer>& weights);
 
   LlmExecutorSettings executor_settings_;
   ::litert::Environment env_;
@@ -182,10 +507,50 @@ class LlmLiteRtCompiledModelExecutor : public LlmExecutor {
       output_kv_cache_buffers_;
 
   SortedPrefillSignatureMap prefill_signature_map_;
+  // The measured latency of each prefill signature, used to pick the prefill
+  // work groups when set.
+  std::optional<PrefillSignatureCosts> prefill_signature_costs_;
+
+  // The bound run buffers, keyed by the prefill signature name for prefill,
+  // and indexed by KvCacheParity().
+  absl::flat_hash_map<std::string, std::array<RunBuffers, 2>>
+      prefill_run_buffers_;
+  std::array<RunBuffers, 2> decode_run_buffers_;
+  // The decode signatures attending over a prefix of the kv-cache, and their
+  // bound run buffers keyed by the signature name, indexed by KvCacheParity().
+  // Empty if the model has none, or with the paged kv-cache.
+  SortedDecodeSignatureMap decode_signature_map_;
+  absl::flat_hash_map<std::string, std::array<RunBuffers, 2>>
+      kv_bucketed_decode_run_buffers_;
+  // The run buffers of the embed signature, bound by the first EmbedTokens().
+  std::optional<RunBuffers> embed_run_buffers_;
+
+  // Scratch space for the token ids fed into one prefill run. Reserved for the
+  // longest prefill signature so that prefill does not allocate.
+  std::vector<int> prefill_tokens_to_lookup_;
+  // Scratch space for the ids of one work group gathered from every batch row.
+  std::vector<int> prefill_batch_ids_;
+  // Scratch space for a single-row prompt repeated for every batch row.
+  std::vector<int> prefill_broadcast_ids_;
+  // The external embeddings of the placeholder ids of the running Prefill(),
+  // and the number of them already prefilled.
+  absl::Span<const float> prefill_external_embeddings_;
+  size_t num_prefilled_external_embeddings_ = 0;
 
   // The signatures of the model.
   ModelSignatures signatures_;
 
+  // The contents of the persistent attention mask buffers, keyed by the
+  // prefill signature name for prefill, and indexed by KvCacheParity() with
+  // the asynchronous prefill, whose parities have their own inputs, or 0.
+  absl::flat_hash_map<std::string, std::array<AttentionMaskState, 2>>
+      prefill_attention_masks_;
+  AttentionMaskState decode_attention_mask_;
+  // The contents of the attention masks of the kv-bucketed decode signatures,
+  // keyed by the signature name.
+  absl::flat_hash_map<std::string, AttentionMaskState>
+      kv_bucketed_decode_attention_masks_;
+
   // The sampled ids to use for external sampling.
   // The layout is batch-major.
   // e.g. for output_batch_size=2, the layout is:
@@ -201,25 +566,54 @@ class LlmLiteRtCompiledModelExecutor : public LlmExecutor {
   // Internal timestep.
   int current_step_ = 0;
 
+  // Whether the prefills not waiting for completion are run asynchronously,
+  // set from GpuConfig::async_prefill.
+  bool async_prefill_ = false;
+
+  // Whether the runs report their device time, set from
+  // GpuConfig::measure_device_time.
+  bool measure_device_time_ = false;
+
+  // Whether the masked value of the float attention masks is kept within the
+  // float16 range, i.e. unless the model computes in float32.
+  bool mask_precision_f16_ = true;
+
+  // The scale and zero point of the int8 or int16 logits of a model with
+  // quantized activations, which are dequantized into dequantized_logits_
+  // for the callers of DecodeLogits(). Unset for float logits.
+  std::optional<std::pair<float, int32_t>> logits_quantization_;
+  std::optional<::litert::TensorBuffer> dequantized_logits_;
+
+  // Drops the pages of the mapped model beyond its resident budget. Empty
+  // unless CpuConfig::model_resident_budget_bytes is set.
+  std::function<void()> trim_model_memory_;
+
+  // The latencies accumulated by each stage since the last Reset(), looked up
+  // by the stage name without building a string at every step.
+  absl::flat_hash_map<std::string, absl::Duration> stage_latencies_;
+
   // TODO: b/404625243 - To be implemented.
   // The processed tokens.
   std::vector<int> processed_tokens_;
 
-  // The token served as the first input token to the model for next Prefill or
-  // Decode.
-  int next_input_token_id_ = -1;
+  // The tokens served as the first input token of each batch row to the model
+  // for next Prefill or Decode. Empty when there is no pending token.
+  std::vector<int> next_input_token_ids_;
 
-  // A tensor buffer to store the logits decoded before sampling the final
-  // tokens. It's to avoid creating a new tensor buffer for each Decode() call.
-  ::litert::TensorBuffer decoded_logits_;
+  // The kv-cache rows saved by ReorderBatchRows() before they are overwritten,
+  // kept such that the reorders of the beam search steps do not allocate.
+  std::vector<uint8_t> reorder_kv_cache_scratch_;
 
-  // A vector to store the logits decoded before sampling the final tokens.
-  // It's to avoid creating a new vector for each Decode() call.
-  std::vector<float> decoded_logits_vector_;
+  // The ids sampled by each step of a multi-step decode, in buffers of the
+  // decode input tokens type.
+  std::vector<::litert::TensorBuffer> decode_step_token_ids_;
 
   // The path to the weight cache directory. Executor will take the ownership of
   // this path to maintain the path lifecycle.
   std::string weight_cache_path_;
+  // The versioned weight cache until it is committed after the first
+  // successful prefill.
+  std::unique_ptr<WeightCache> weight_cache_;
 
   // The embedding lookup for the optional embedder model.
   std::unique_ptr<EmbeddingLookupText> embedding_lookup_;
@@ -228,6 +622,33 @@ class LlmLiteRtCompiledModelExecutor : public LlmExecutor {
   // The logits data type of the model, used to determine the data type of the
   // logits tensor for gpu sampling.
   LogitsDataType logits_data_type_;
+
+  // The pool of kv-cache blocks and the block table of the current context.
+  // Only set when the paged kv-cache is enabled through
+  // LlmExecutorSettings::SetKvCacheBlockSize().
+  std::unique_ptr<KvCacheBlockAllocator> kv_cache_block_allocator_;
+  std::optional<KvCacheBlockTable> kv_cache_block_table_;
+
+  // The weights of the LoRA inputs of the model, keyed by the adapter name and
+  // then by the input name. The empty name holds the zero weights of the base
+  // model. Empty if the model has no LoRA inputs.
+  absl::flat_hash_map<
+      std::string, absl::flat_hash_map<std::string, ::litert::TensorBuffer>>
+      lora_weights_;
+  // The name of the selected adapter, empty for the base model.
+  std::string selected_lora_adapter_;
+  // The size in bytes of a batch row of the LoRA inputs of [batch, ...], keyed
+  // by the input name. Empty if the batch has a single row.
+  absl::flat_hash_map<std::string, size_t> lora_row_sizes_;
+  // The weights of the adapters selected per row, and their names, which are
+  // empty unless SelectLoraAdapters() selected several adapters.
+  absl::flat_hash_map<std::string, ::litert::TensorBuffer> mixed_lora_weights_;
+  std::vector<std::string> selected_lora_adapters_;
+
+  // The worker thread looking up the per layer embeddings while the embeddings
+  // are looked up, if the model has both. Declared last, so that a pending
+  // lookup finishes before the buffers it fills are destroyed.
+  std::unique_ptr<ThreadPool> embedding_lookup_pool_;
 };
 
 }  // namespace litert::lm
@@ -30,6 +30,7 @@
 #include "runtime/components/model_resources_task.h"
 #include "runtime/executor/executor_settings_base.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/memory_usage.h"
 #include "runtime/util/model_asset_bundle_resources.h"
 #include "runtime/util/scoped_file.h"
 #include "runtime/util/test_utils.h"  // IWYU pragma: keep
@@ -104,5 +105,34 @@ TEST(LlmLiteRTCompiledModelExecutorTest, CreateExecutorTest_WithCache) {
   ASSERT_NE(*executor, nullptr);
 }
 
+TEST(LlmLiteRTCompiledModelExecutorTest, GetMemoryUsage) {
+  auto model_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm.task";
+  ASSERT_OK_AND_ASSIGN(auto model_resources,
+                       CreateExecutorModelResources(model_path.string()));
+  auto model_assets = ModelAssets::Create(model_path.string());
+  ASSERT_OK(model_assets);
+  auto executor_settings =
+      LlmExecutorSettings::CreateDefault(*model_assets, Backend::CPU);
+  executor_settings->SetCacheDir(":nocache");
+  executor_settings->SetMaxNumTokens(kMaxNumTokens);
+  ::litert::lm::CpuConfig config;
+  config.number_of_threads = kNumThreads;
+  executor_settings->SetBackendConfig(config);
+  ASSERT_OK_AND_ASSIGN(auto executor,
+                       LlmLiteRtCompiledModelExecutor::Create(
+                           *executor_settings, *model_resources));
+
+  ASSERT_OK_AND_ASSIGN(MemoryUsage memory_usage, executor->GetMemoryUsage());
+  // The CPU buffers are all on the host.
+  EXPECT_GT(memory_usage.GetSizeInBytes(kKvCacheMemory, MemoryLocation::kHost),
+            0);
+  EXPECT_GT(memory_usage.GetSizeInBytes(kDecodeBuffersMemory,
+                                        MemoryLocation::kHost),
+            0);
+  EXPECT_EQ(memory_usage.GetTotalSizeInBytes(MemoryLocation::kDevice), 0);
+}
+
 }  // namespace
 }  // namespace litert::lm
@@ -1,12 +1,15 @@
 #include "runtime/executor/llm_litert_npu_compiled_model_executor.h"
 
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
-#include <limits>
+#include <filesystem>  // NOLINT: Required for path manipulation.
 #include <memory>
 #include <optional>
 #include <set>
 #include <string>
+#include <system_error>
 #include <utility>
 #include <vector>
 
@@ -16,6 +19,8 @@
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "absl/time/clock.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
@@ -29,10 +34,14 @@
 #include "litert/cc/litert_model.h"  // from @litert
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/components/model_resources.h"
+#include "runtime/executor/kv_cache_layout.h"
 #include "runtime/executor/litert_compiled_model_executor_utils.h"
 #include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/executor/weight_cache.h"
+#include "runtime/framework/threadpool.h"
 #include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/init_phase.h"
 #include "runtime/util/litert_status_util.h"
 #include "runtime/util/status_macros.h"  // NOLINT
 
@@ -48,6 +57,13 @@ constexpr int kPrefillSize = 128;
 constexpr char kDecodeSignature[] = "decode";
 constexpr char cache_k25[] = "kv_cache_k_25";
 constexpr char cache_v25[] = "kv_cache_v_25";
+// The prefixes of the names of the kv-cache inputs of the LLM model.
+constexpr absl::string_view kKvCacheKRootName = "kv_cache_k_";
+constexpr absl::string_view kKvCacheVRootName = "kv_cache_v_";
+// The time to wait for the pipelined decode inputs of a step.
+constexpr absl::Duration kDecodeInputsTimeout = absl::Seconds(10);
+// The suffix of the NPU compilation cache directory, after the cache key.
+constexpr absl::string_view kCompilationCacheSuffix = ".npu_cache";
 
 // Signature names for the embedder.
 struct EmbedderSignatures {
@@ -115,33 +131,83 @@ struct CacheUpdateSignatures {
 // Applies greedy sampling to the decoded logits. TODO(b/416702864) this logic
 // should be replaced by the LiteRT-LM sampler once it supports greedy sampling
 // for quantized tensors.
-absl::StatusOr<int> ApplyGreedySampling(const TensorBuffer& decoded_logits) {
-  int max_index = 0;
+// Returns the index of the first largest of the logits, read in place rather
+// than copied out of the buffer, as the vocabulary makes for a large copy on
+// every decode step.
+template <typename T>
+absl::StatusOr<int> ArgMaxInPlace(TensorBuffer& decoded_logits) {
+  LITERT_ASSIGN_OR_RETURN(size_t logits_size, decoded_logits.PackedSize());
+  LITERT_ASSIGN_OR_RETURN(
+      auto lock_and_addr,
+      ::litert::TensorBufferScopedLock::Create(
+          decoded_logits, ::litert::TensorBuffer::LockMode::kRead));
+  const auto* logits = static_cast<const T*>(lock_and_addr.second);
+  const size_t num_logits = logits_size / sizeof(T);
+  RET_CHECK_GT(num_logits, 0) << "The logits are empty.";
+  return std::max_element(logits, logits + num_logits) - logits;
+}
+
+absl::StatusOr<int> ApplyGreedySampling(TensorBuffer& decoded_logits) {
   LITERT_ASSIGN_OR_RETURN(RankedTensorType logits_tensor_type,
                           decoded_logits.TensorType());
   if (logits_tensor_type.ElementType() == ::litert::ElementType::Float32) {
-    LITERT_ASSIGN_OR_RETURN(auto logits_buffer_float,
-                            CopyFromTensorBuffer<float>(decoded_logits));
-
-    float max_value = std::numeric_limits<float>::min();
-    for (int i = 0; i < logits_buffer_float.size(); ++i) {
-      if (logits_buffer_float[i] > max_value) {
-        max_value = logits_buffer_float[i];
-        max_index = i;
-      }
-    }
-  } else {
-    LITERT_ASSIGN_OR_RETURN(auto logits_buffer_int16,
-                            CopyFromTensorBuffer<int16_t>(decoded_logits));
-    int16_t max_value = std::numeric_limits<int16_t>::min();
-    for (int i = 0; i < logits_buffer_int16.size(); ++i) {
-      if (logits_buffer_int16[i] > max_value) {
-        max_value = logits_buffer_int16[i];
-        max_index = i;
-      }
+    return ArgMaxInPlace<float>(decoded_logits);
+  }
+  return ArgMaxInPlace<int16_t>(decoded_logits);
+}
+
+// Returns the identity of the NPU driver, i.e. the names, sizes and
+// modification times of the dispatch libraries, such that the compilation
+// cache is rebuilt when the driver is updated.
+std::string GetDispatchLibraryVersion(
+    const std::optional<std::string>& dispatch_library_path) {
+  if (!dispatch_library_path.has_value()) {
+    return "default";
+  }
+  std::vector<std::string> libraries;
+  std::error_code error;
+  for (const auto& entry : std::filesystem::directory_iterator(
+           *dispatch_library_path, error)) {
+    const std::string name = entry.path().filename().string();
+    if (!entry.is_regular_file(error) ||
+        !absl::StrContains(name, "Dispatch")) {
+      continue;
     }
+    libraries.push_back(absl::StrCat(
+        name, ":", entry.file_size(error), ":",
+        entry.last_write_time(error).time_since_epoch().count()));
+  }
+  // The directory order is unspecified.
+  std::sort(libraries.begin(), libraries.end());
+  return absl::StrJoin(libraries, ",");
+}
+
+// Opens the cache of the artifacts compiled by the NPU driver, a directory next
+// to the weight cache keyed by the model and the driver. If this process builds
+// the cache, the directory is emptied first.
+absl::StatusOr<std::unique_ptr<WeightCache>> OpenCompilationCache(
+    const LlmExecutorSettings& executor_settings,
+    const std::optional<std::string>& dispatch_library_path) {
+  const std::string cache_options =
+      absl::StrCat("npu|", GetDispatchLibraryVersion(dispatch_library_path));
+  ASSIGN_OR_RETURN(auto compilation_cache,
+                   WeightCache::Create(executor_settings, cache_options,
+                                       kCompilationCacheSuffix));
+  if (compilation_cache->GetPath().has_value() &&
+      !compilation_cache->IsValid()) {
+    const std::string& path = *compilation_cache->GetPath();
+    std::error_code error;
+    std::filesystem::remove_all(path, error);
+    RET_CHECK(std::filesystem::create_directories(path, error))
+        << "Failed to create the NPU compilation cache " << path << ": "
+        << error.message();
   }
-  return max_index;
+  return compilation_cache;
+}
+
+bool IsKvCacheBufferName(absl::string_view name) {
+  return absl::StartsWith(name, kKvCacheKRootName) ||
+         absl::StartsWith(name, kKvCacheVRootName);
 }
 
 }  // namespace
@@ -569,6 +635,9 @@ absl::Status LlmLiteRtNpuCompiledModelExecutor::Prefill(
 absl::Status LlmLiteRtNpuCompiledModelExecutor::Prefill(
     const ExecutorInputs& inputs, const ExecutorPrefillParams& params) {
   auto start = absl::Now();
+  // The auxiliary model must be idle, and the precomputed decode inputs are
+  // stale once the prefill moves the current step.
+  RETURN_IF_ERROR(WaitForPipelinedDecodeInputs());
   LITERT_ASSIGN_OR_RETURN(auto tensor_type,
                           (*inputs.GetTextTokenIdsPtr())->TensorType());
   // Only accept batch size 1 for now.
@@ -814,16 +883,6 @@ absl::Status LlmLiteRtNpuCompiledModelExecutor::Decode(
         static_cast<int32_t*>(decode_input_lock_and_addr.second);
     decode_input_ptr[0] = id;
 
-    // Decode input position
-    LITERT_ASSIGN_OR_RETURN(
-        auto decode_input_pos_lock_and_addr,
-        ::litert::TensorBufferScopedLock::Create(
-            rope_context_.decode_input_buffers[RopeSignatures::kInputPos],
-            ::litert::TensorBuffer::LockMode::kWrite));
-    auto* decode_input_pos_ptr =
-        static_cast<int32_t*>(decode_input_pos_lock_and_addr.second);
-    decode_input_pos_ptr[0] = current_step_;
-
     // Timestep input.
     LITERT_ASSIGN_OR_RETURN(
         auto decode_timestep_lock_and_addr,
@@ -866,16 +925,13 @@ absl::Status LlmLiteRtNpuCompiledModelExecutor::Decode(
     }
   }
 
-  // Invoke RoPE signature.
-  {
-    auto start = absl::Now();
-    auto res = npu_auxiliary_context_.npu_auxiliary_compiled_model.Run(
-        RopeSignatures::kDecodeRope, rope_context_.decode_input_buffers,
-        rope_context_.decode_output_buffers);
-    RET_CHECK(res) << "Failed to run RoPE model." << res.Error().Message();
-    auto end = absl::Now();
-    latency_stats_.decode_rope_inference_latency_us +=
-        absl::ToInt64Microseconds(end - start);
+  // Invoke RoPE signature, unless it already ran for this step while the
+  // host was processing the previous one. The embedder above does not use the
+  // auxiliary model, so it overlaps with the pipelined cache update and RoPE.
+  if (decode_inputs_pending_) {
+    RETURN_IF_ERROR(WaitForPipelinedDecodeInputs());
+  } else {
+    RETURN_IF_ERROR(RunDecodeRope(current_step_));
   }
 
   // Invoke mask signature.
@@ -902,23 +958,110 @@ absl::Status LlmLiteRtNpuCompiledModelExecutor::Decode(
     RET_CHECK(res) << "Failed to run LLM model." << res.Error().Message();
   }
 
-  // Cache update.
+  ++current_step_;
+  if (decode_input_pool_ != nullptr) {
+    // Neither the cache update of this step nor the RoPE of the next one
+    // depend on the sampled token, so they run on the NPU while the caller
+    // samples and processes the logits of this step. They run in order, as
+    // the input position of the cache update is then overwritten by the RoPE.
+    decode_inputs_pending_ = true;
+    RETURN_IF_ERROR(
+        decode_input_pool_->Schedule([this, step = current_step_]() {
+          decode_inputs_status_ = RunDecodeCacheUpdate();
+          if (decode_inputs_status_.ok()) {
+            decode_inputs_status_ = RunDecodeRope(step);
+          }
+        }));
+    return absl::OkStatus();
+  }
+  return RunDecodeCacheUpdate();
+}
+
+absl::Status LlmLiteRtNpuCompiledModelExecutor::RunDecodeCacheUpdate() {
+  auto start = absl::Now();
+  auto res = npu_auxiliary_context_.npu_auxiliary_compiled_model.Run(
+      CacheUpdateSignatures::kDecodeCacheUpdate,
+      cache_update_inference_context_.decode_input_buffers,
+      cache_update_inference_context_.decode_output_buffers);
+  RET_CHECK(res) << "Failed to run cache update model."
+                 << res.Error().Message();
+  auto end = absl::Now();
+  latency_stats_.decode_cache_update_inference_latency_us +=
+      absl::ToInt64Microseconds(end - start);
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtNpuCompiledModelExecutor::RunDecodeRope(int step) {
+  auto start = absl::Now();
   {
-    auto start = absl::Now();
+    LITERT_ASSIGN_OR_RETURN(
+        auto decode_input_pos_lock_and_addr,
+        ::litert::TensorBufferScopedLock::Create(
+            rope_context_.decode_input_buffers[RopeSignatures::kInputPos],
+            ::litert::TensorBuffer::LockMode::kWrite));
+    auto* decode_input_pos_ptr =
+        static_cast<int32_t*>(decode_input_pos_lock_and_addr.second);
+    decode_input_pos_ptr[0] = step;
+  }
+  if (step < decode_rope_table_steps_) {
+    // The input position is still written, since the cache update reads it.
+    for (auto& [name, buffer] : rope_context_.decode_output_buffers) {
+      const std::vector<uint8_t>& table = decode_rope_table_[name];
+      const size_t row_size = table.size() / decode_rope_table_steps_;
+      LITERT_ASSIGN_OR_RETURN(
+          auto lock_and_addr,
+          ::litert::TensorBufferScopedLock::Create(
+              buffer, ::litert::TensorBuffer::LockMode::kWrite));
+      memcpy(lock_and_addr.second, table.data() + step * row_size, row_size);
+    }
+  } else {
     auto res = npu_auxiliary_context_.npu_auxiliary_compiled_model.Run(
-        CacheUpdateSignatures::kDecodeCacheUpdate,
-        cache_update_inference_context_.decode_input_buffers,
-        cache_update_inference_context_.decode_output_buffers);
-    RET_CHECK(res) << "Failed to run cache update model."
-                   << res.Error().Message();
-    auto end = absl::Now();
-    latency_stats_.decode_cache_update_inference_latency_us +=
-        absl::ToInt64Microseconds(end - start);
+        RopeSignatures::kDecodeRope, rope_context_.decode_input_buffers,
+        rope_context_.decode_output_buffers);
+    RET_CHECK(res) << "Failed to run RoPE model." << res.Error().Message();
   }
-  ++current_step_;
+  auto end = absl::Now();
+  latency_stats_.decode_rope_inference_latency_us +=
+      absl::ToInt64Microseconds(end - start);
   return absl::OkStatus();
 }
 
+absl::Status LlmLiteRtNpuCompiledModelExecutor::PrecomputeDecodeRope(
+    int num_steps) {
+  absl::flat_hash_map<absl::string_view, std::vector<uint8_t>> table;
+  for (int step = 0; step < num_steps; ++step) {
+    RETURN_IF_ERROR(RunDecodeRope(step));
+    for (auto& [name, buffer] : rope_context_.decode_output_buffers) {
+      LITERT_ASSIGN_OR_RETURN(size_t row_size, buffer.PackedSize());
+      LITERT_ASSIGN_OR_RETURN(
+          auto lock_and_addr,
+          ::litert::TensorBufferScopedLock::Create(
+              buffer, ::litert::TensorBuffer::LockMode::kRead));
+      const auto* row = static_cast<const uint8_t*>(lock_and_addr.second);
+      std::vector<uint8_t>& rows = table[name];
+      if (step == 0) {
+        rows.reserve(row_size * num_steps);
+      }
+      rows.insert(rows.end(), row, row + row_size);
+    }
+  }
+  decode_rope_table_ = std::move(table);
+  decode_rope_table_steps_ = num_steps;
+  // The precomputation is part of the load, not of the decode steps.
+  latency_stats_ = {};
+  return absl::OkStatus();
+}
+
+absl::Status
+LlmLiteRtNpuCompiledModelExecutor::WaitForPipelinedDecodeInputs() {
+  if (!decode_inputs_pending_) {
+    return absl::OkStatus();
+  }
+  RETURN_IF_ERROR(decode_input_pool_->WaitUntilDone(kDecodeInputsTimeout));
+  decode_inputs_pending_ = false;
+  return decode_inputs_status_;
+}
+
 absl::StatusOr<int> LlmLiteRtNpuCompiledModelExecutor::GetVocabSize() {
   LITERT_ASSIGN_OR_RETURN(
       auto logits_tensor_type,
@@ -933,7 +1076,65 @@ LlmLiteRtNpuCompiledModelExecutor::GetLatencyStats() const {
   return latency_stats_;
 }
 
+absl::StatusOr<ExecutorStageLatencies>
+LlmLiteRtNpuCompiledModelExecutor::GetStageLatencies() const {
+  const LatencyStats& stats = latency_stats_;
+  ExecutorStageLatencies latencies = {
+      {"prefill_embedder",
+       absl::Microseconds(stats.prefill_embedder_inference_latency_us)},
+      {"prefill_mask",
+       absl::Microseconds(stats.prefill_mask_inference_latency_us)},
+      {"prefill_rope",
+       absl::Microseconds(stats.prefill_rope_inference_latency_us)},
+      {"prefill_llm",
+       absl::Microseconds(stats.prefill_llm_inference_latency_us)},
+      {"prefill_cache_update",
+       absl::Microseconds(stats.prefill_cache_update_inference_latency_us)},
+      {"decode_embedder",
+       absl::Microseconds(stats.decode_embedder_inference_latency_us)},
+      {"decode_mask",
+       absl::Microseconds(stats.decode_mask_inference_latency_us)},
+      {"decode_rope",
+       absl::Microseconds(stats.decode_rope_inference_latency_us)},
+      {"decode_llm",
+       absl::Microseconds(stats.decode_llm_inference_latency_us)},
+      {"decode_cache_update",
+       absl::Microseconds(stats.decode_cache_update_inference_latency_us)},
+  };
+  latencies[std::string(kPrefillPrepareInputsStage)] =
+      absl::Microseconds(stats.prefill_prepare_input_latency_us);
+  latencies[std::string(kPrefillInferenceStage)] =
+      latencies["prefill_embedder"] + latencies["prefill_mask"] +
+      latencies["prefill_rope"] + latencies["prefill_llm"] +
+      latencies["prefill_cache_update"];
+  latencies[std::string(kDecodePrepareInputsStage)] =
+      absl::Microseconds(stats.decode_prepare_input_latency_us);
+  latencies[std::string(kDecodeInferenceStage)] =
+      latencies["decode_embedder"] + latencies["decode_mask"] +
+      latencies["decode_rope"] + latencies["decode_llm"] +
+      latencies["decode_cache_update"];
+  latencies[std::string(kDecodeSamplingStage)] =
+      absl::Microseconds(stats.decode_sampling_latency_us);
+  return latencies;
+}
+
+absl::Status LlmLiteRtNpuCompiledModelExecutor::Warmup(
+    int num_decode_steps) {
+  RET_CHECK(current_step_ == 0 && next_input_token_id_ == -1)
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "Warmup must be called before the first prefill or after Reset().";
+  RETURN_IF_ERROR(WaitForPipelinedDecodeInputs());
+  RETURN_IF_ERROR(WarmupInference(
+      llm_compiled_model_, llm_inference_context_,
+      npu_auxiliary_context_.npu_auxiliary_compiled_model, rope_context_,
+      mask_context_, cache_update_inference_context_));
+  return Reset();
+}
+
 absl::Status LlmLiteRtNpuCompiledModelExecutor::Reset() {
+  // The pending cache update and RoPE are done with, and their result dropped
+  // along with the other states.
+  WaitForPipelinedDecodeInputs().IgnoreError();
   current_step_ = 0;
   next_input_token_id_ = -1;
   sampled_ids_.clear();
@@ -941,6 +1142,135 @@ absl::Status LlmLiteRtNpuCompiledModelExecutor::Reset() {
   return absl::OkStatus();
 }
 
+absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>>
+LlmLiteRtNpuCompiledModelExecutor::SaveState() {
+  // The pending cache update of the last decode step writes the kv-cache.
+  RETURN_IF_ERROR(WaitForPipelinedDecodeInputs());
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  // The prefill inputs hold all the kv-cache buffers, while the decode inputs
+  // hold placeholders for some of them, see Create().
+  for (auto& [name, buffer] : llm_inference_context_.prefill_input_buffers) {
+    if (!IsKvCacheBufferName(name)) {
+      continue;
+    }
+    LITERT_ASSIGN_OR_RETURN(auto buffer_size, buffer.PackedSize());
+    LITERT_ASSIGN_OR_RETURN(
+        auto lock_and_addr,
+        ::litert::TensorBufferScopedLock::Create(
+            buffer, ::litert::TensorBuffer::LockMode::kRead));
+    const auto* data = static_cast<const uint8_t*>(lock_and_addr.second);
+    kv_cache[name] = std::vector<uint8_t>(data, data + buffer_size);
+  }
+  return std::make_unique<ExecutorCheckpoint>(
+      current_step_, next_input_token_id_, std::move(kv_cache));
+}
+
+absl::StatusOr<KvCacheLayouts>
+LlmLiteRtNpuCompiledModelExecutor::GetKvCacheLayouts() const {
+  auto mask_it = mask_context_.decode_output_buffers.find(
+      MaskSignatures::kMaskOutputGlobalMask);
+  RET_CHECK(mask_it != mask_context_.decode_output_buffers.end())
+      << "No decode global mask buffer.";
+  LITERT_ASSIGN_OR_RETURN(auto mask_type, mask_it->second.TensorType());
+  const int kv_cache_length = mask_type.Layout().Dimensions().back();
+  KvCacheLayouts layouts;
+  for (const auto& [name, buffer] :
+       llm_inference_context_.prefill_input_buffers) {
+    if (!IsKvCacheBufferName(name)) {
+      continue;
+    }
+    LITERT_ASSIGN_OR_RETURN(auto tensor_type, buffer.TensorType());
+    LITERT_ASSIGN_OR_RETURN(auto buffer_size, buffer.PackedSize());
+    const auto& dims = tensor_type.Layout().Dimensions();
+    ASSIGN_OR_RETURN(
+        layouts[name],
+        GetKvCacheTensorLayout(std::vector<int>(dims.begin(), dims.end()),
+                               kv_cache_length, buffer_size));
+  }
+  return layouts;
+}
+
+absl::StatusOr<int> LlmLiteRtNpuCompiledModelExecutor::CreateContext() {
+  ParkedContext context;
+  for (const auto& [name, buffer] :
+       llm_inference_context_.prefill_input_buffers) {
+    if (!IsKvCacheBufferName(name)) {
+      continue;
+    }
+    LITERT_ASSIGN_OR_RETURN(
+        context.kv_cache_buffers[name],
+        llm_compiled_model_.CreateInputBuffer(kPrefillSignature, name));
+  }
+  const int context_id = next_context_id_++;
+  parked_contexts_.emplace(context_id, std::move(context));
+  return context_id;
+}
+
+absl::Status LlmLiteRtNpuCompiledModelExecutor::SwitchContext(int context_id) {
+  if (context_id == active_context_id_) {
+    return absl::OkStatus();
+  }
+  auto it = parked_contexts_.find(context_id);
+  RET_CHECK(it != parked_contexts_.end()).SetCode(absl::StatusCode::kNotFound)
+      << "No context " << context_id << ".";
+  // The pending cache update writes the kv-cache of the active context. Its
+  // pending RoPE is of the next step, which runs again once resumed.
+  RETURN_IF_ERROR(WaitForPipelinedDecodeInputs());
+  ParkedContext active;
+  for (const auto& [name, buffer] :
+       llm_inference_context_.prefill_input_buffers) {
+    if (IsKvCacheBufferName(name)) {
+      LITERT_ASSIGN_OR_RETURN(active.kv_cache_buffers[name],
+                              buffer.Duplicate());
+    }
+  }
+  active.current_step = current_step_;
+  active.next_input_token_id = next_input_token_id_;
+  RETURN_IF_ERROR(BindKvCacheBuffers(it->second.kv_cache_buffers));
+  current_step_ = it->second.current_step;
+  next_input_token_id_ = it->second.next_input_token_id;
+  sampled_ids_.clear();
+  parked_contexts_.erase(it);
+  parked_contexts_.emplace(active_context_id_, std::move(active));
+  active_context_id_ = context_id;
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtNpuCompiledModelExecutor::DeleteContext(int context_id) {
+  RET_CHECK_NE(context_id, active_context_id_)
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The active context cannot be deleted.";
+  RET_CHECK(parked_contexts_.erase(context_id) > 0)
+          .SetCode(absl::StatusCode::kNotFound)
+      << "No context " << context_id << ".";
+  return absl::OkStatus();
+}
+
+absl::Status LlmLiteRtNpuCompiledModelExecutor::BindKvCacheBuffers(
+    const absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>&
+        kv_cache_buffers) {
+  for (const auto& [name, buffer] : kv_cache_buffers) {
+    LITERT_ASSIGN_OR_RETURN(llm_inference_context_.prefill_input_buffers[name],
+                            buffer.Duplicate());
+    // The decode inputs of kv_cache_{k,v}_25 of Gemma3 are placeholders of
+    // another type rather than the kv-cache, see Create().
+    if (embedder_per_layer_context_.has_value() ||
+        (name != cache_k25 && name != cache_v25)) {
+      LITERT_ASSIGN_OR_RETURN(
+          llm_inference_context_.decode_input_buffers[name],
+          buffer.Duplicate());
+    }
+    InferenceContext& cache_update = cache_update_inference_context_;
+    for (auto* buffers : {&cache_update.prefill_input_buffers,
+                          &cache_update.prefill_output_buffers,
+                          &cache_update.decode_input_buffers,
+                          &cache_update.decode_output_buffers}) {
+      LITERT_ASSIGN_OR_RETURN((*buffers)[name], buffer.Duplicate());
+    }
+  }
+  return absl::OkStatus();
+}
+
 // static
 absl::StatusOr<std::unique_ptr<LlmLiteRtNpuCompiledModelExecutor>>
 LlmLiteRtNpuCompiledModelExecutor::Create(
@@ -957,6 +1287,24 @@ LlmLiteRtNpuCompiledModelExecutor::Create(
   } else {
     ABSL_LOG(INFO) << "No dispatch library path provided.";
   }
+  // The driver persists the artifacts it compiles from the model into the
+  // compilation cache, so that a warm start skips the compilation and, unless
+  // requested, the warmup inference.
+  std::unique_ptr<WeightCache> compilation_cache;
+  auto opened_compilation_cache =
+      OpenCompilationCache(executor_settings, dispatch_library_path);
+  if (opened_compilation_cache.ok()) {
+    compilation_cache = *std::move(opened_compilation_cache);
+  } else {
+    ABSL_LOG(INFO) << "Running without the NPU compilation cache: "
+                   << opened_compilation_cache.status();
+  }
+  if (compilation_cache != nullptr &&
+      compilation_cache->GetPath().has_value()) {
+    environment_options.push_back(::litert::Environment::Option{
+        ::litert::Environment::OptionTag::CompilerCacheDir,
+        absl::string_view(*compilation_cache->GetPath())});
+  }
   LITERT_ASSIGN_OR_RETURN(
       Environment env,
       ::litert::Environment::Create(absl::MakeConstSpan(environment_options)));
@@ -965,9 +1313,12 @@ LlmLiteRtNpuCompiledModelExecutor::Create(
       resources.GetTFLiteModel(litert::lm::ModelType::kTfLitePrefillDecode));
   // If the model is fully AOT compiled for NPU, NPU accelerator is used
   // automatically.
+  std::optional<InitPhaseScope> init_phase;
+  init_phase.emplace("Model compilation");
   LITERT_ASSIGN_OR_RETURN(
       CompiledModel llm_compiled_model,
       CompiledModel::Create(env, *llm_model, kLiteRtHwAcceleratorCpu));
+  init_phase.reset();
 
   // Allocate all input and output buffers of the LLM model that are meant to be
   // used by the NPU chip first, so that we can later duplicate the buffers into
@@ -984,16 +1335,13 @@ LlmLiteRtNpuCompiledModelExecutor::Create(
       decode_output_kv_cache_slice_buffers;
 
   auto prefill_signature = llm_model->FindSignature(kPrefillSignature);
-  constexpr absl::string_view kv_cache_k_root_name = "kv_cache_k_";
-  constexpr absl::string_view kv_cache_v_root_name = "kv_cache_v_";
   constexpr absl::string_view kv_cache_slice_k_root_name = "kv_slice_k_";
   constexpr absl::string_view kv_cache_slice_v_root_name = "kv_slice_v_";
 
   bool has_per_layer_embeddings = false;
 
   for (auto input_name : prefill_signature->InputNames()) {
-    if (absl::StartsWith(input_name, kv_cache_k_root_name) ||
-        absl::StartsWith(input_name, kv_cache_v_root_name)) {
+    if (IsKvCacheBufferName(input_name)) {
       LITERT_ASSIGN_OR_RETURN(
           input_kv_cache_buffers[input_name],
           llm_compiled_model.CreateInputBuffer(kPrefillSignature, input_name));
@@ -1009,8 +1357,7 @@ LlmLiteRtNpuCompiledModelExecutor::Create(
   }
   auto decode_signature = llm_model->FindSignature(kDecodeSignature);
   for (auto input_name : decode_signature->InputNames()) {
-    if (absl::StartsWith(input_name, kv_cache_k_root_name) ||
-        absl::StartsWith(input_name, kv_cache_v_root_name)) {
+    if (IsKvCacheBufferName(input_name)) {
       continue;
     }
     LITERT_ASSIGN_OR_RETURN(
@@ -1108,10 +1455,21 @@ LlmLiteRtNpuCompiledModelExecutor::Create(
           decode_output_kv_cache_slice_buffers, std::move(prefill_input_pos),
           std::move(decode_input_pos)));
 
-  RETURN_IF_ERROR(WarmupInference(
-      llm_compiled_model, llm_inference_context,
-      npu_auxiliary_context.npu_auxiliary_compiled_model, rope_context,
-      mask_context, cache_update_inference_context));
+  const bool compilation_cache_hit =
+      compilation_cache != nullptr && compilation_cache->IsValid();
+  if (!compilation_cache_hit ||
+      executor_settings.GetWarmupOnCompilationCacheHit()) {
+    InitPhaseScope phase("Warmup");
+    RETURN_IF_ERROR(WarmupInference(
+        llm_compiled_model, llm_inference_context,
+        npu_auxiliary_context.npu_auxiliary_compiled_model, rope_context,
+        mask_context, cache_update_inference_context));
+  }
+  if (compilation_cache != nullptr) {
+    // The warmup ran every signature, so all the artifacts have been compiled.
+    InitPhaseScope phase("Compilation cache save");
+    RETURN_IF_ERROR(compilation_cache->Commit());
+  }
 
   // For now we only support one prefill length in the model.
   SortedPrefillSignatureMap prefill_runner_set;
@@ -1140,6 +1498,14 @@ LlmLiteRtNpuCompiledModelExecutor::Create(
       std::move(llm_inference_context),
       std::move(cache_update_inference_context), std::move(prefill_runner_set),
       std::move(embedder_per_layer_context)));
+  if (executor_settings.GetPrecomputeDecodeRope()) {
+    RETURN_IF_ERROR(
+        executor->PrecomputeDecodeRope(executor_settings.GetMaxNumTokens()));
+  }
+  if (executor_settings.GetPipelineDecodeInputs()) {
+    executor->decode_input_pool_ = std::make_unique<ThreadPool>(
+        /*name_prefix=*/"npu_decode_inputs", /*max_num_threads=*/1);
+  }
   return executor;
 };
 
@@ -33,18 +33,20 @@
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/components/model_resources.h"
 #include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/kv_cache_layout.h"
 #include "runtime/executor/litert_compiled_model_executor_utils.h"
 #include "runtime/executor/llm_executor.h"
 #include "runtime/executor/llm_executor_io_types.h"
 #include "runtime/executor/llm_executor_settings.h"
+#include "runtime/framework/threadpool.h"
 
 namespace litert::lm {
 
 // Component intended to be used with an NPU variant of Gemma3.
 class LlmLiteRtNpuCompiledModelExecutor : public ::litert::lm::LlmExecutor {
  public:
-  // Holds the latency breakdown stats for the executor.
-  // TODO(b/405424188): Use 'litert::lm::BenchmarkInfo' instead.
+  // Holds the latency breakdown stats for the executor. They are also reported
+  // through GetStageLatencies().
   struct LatencyStats {
     uint64_t prefill_e2e_latency_us = 0;
     int prefill_num_tokens = 0;
@@ -108,6 +110,14 @@ class LlmLiteRtNpuCompiledModelExecutor : public ::litert::lm::LlmExecutor {
     return current_step_ + (next_input_token_id_ == -1 ? 0 : 1);
   }
 
+  absl::StatusOr<int> GetMaxPrefillLength() const override {
+    if (prefill_signature_map_.empty()) {
+      return absl::FailedPreconditionError("The model has no prefill.");
+    }
+    // The signatures are sorted by decreasing length.
+    return prefill_signature_map_.begin()->first;
+  }
+
   absl::StatusOr<int> GetVocabSize() override;
 
   absl::StatusOr<litert::lm::LlmExecutorSettings> GetExecutorSettings()
@@ -118,7 +128,31 @@ class LlmLiteRtNpuCompiledModelExecutor : public ::litert::lm::LlmExecutor {
   // profiling.
   LatencyStats GetLatencyStats() const;
 
-  // Resets all of the internal states.
+  // Reports the latency stats, where the inference of each stage is the sum of
+  // its embedder, mask, rope, llm and cache update models. The models are also
+  // reported on their own, e.g. as "decode_rope".
+  absl::StatusOr<ExecutorStageLatencies> GetStageLatencies() const override;
+
+  // Copies the kv-cache to host memory together with the step counters, e.g.
+  // to hand a prefill over to an executor decoding on another backend. The
+  // checkpoint cannot be restored on this executor.
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() override;
+
+  // Returns the layouts of the kv-cache buffers, whose length is taken from
+  // the global attention mask.
+  absl::StatusOr<KvCacheLayouts> GetKvCacheLayouts() const override;
+
+  // Allocates another set of kv-cache buffers, which SwitchContext() binds to
+  // the signatures in place of the active ones, without copying either.
+  absl::StatusOr<int> CreateContext() override;
+  absl::Status SwitchContext(int context_id) override;
+  absl::Status DeleteContext(int context_id) override;
+
+  // Runs the prefill and decode signatures of every model once, as at
+  // creation, whatever `num_decode_steps`.
+  absl::Status Warmup(int num_decode_steps) override;
+
+  // Resets all of the internal states of the active context.
   absl::Status Reset() override;
 
  private:
@@ -226,6 +260,29 @@ class LlmLiteRtNpuCompiledModelExecutor : public ::litert::lm::LlmExecutor {
   // Caller of this function is responsible for capturing the output.
   absl::Status DecodeInternal(::litert::lm::ExecutorInputs inputs);
 
+  // Runs the decode cache update signature, writing the kv-cache slices of
+  // the last decode step into the kv-cache.
+  absl::Status RunDecodeCacheUpdate();
+
+  // Runs the decode RoPE signature for the input position `step`, or copies
+  // its precomputed outputs if `step` is covered by `decode_rope_table_`.
+  absl::Status RunDecodeRope(int step);
+
+  // Runs the decode RoPE signature for the positions [0, num_steps) and keeps
+  // the outputs in `decode_rope_table_`.
+  absl::Status PrecomputeDecodeRope(int num_steps);
+
+  // Waits for the cache update of the last decode step and the RoPE of the
+  // next one scheduled on `decode_input_pool_`, if any, and returns their
+  // status.
+  absl::Status WaitForPipelinedDecodeInputs();
+
+  // Binds the kv-cache buffers `kv_cache_buffers`, keyed by the kv-cache
+  // input names, to the LLM and cache update signatures.
+  absl::Status BindKvCacheBuffers(
+      const absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>&
+          kv_cache_buffers);
+
   // Creates the context for the embedder model.  Instead of creating new
   // output buffers for the embedder, the context will use the input buffers
   // of the provided 'gemma_prefill_input_buffers' and
@@ -345,6 +402,37 @@ class LlmLiteRtNpuCompiledModelExecutor : public ::litert::lm::LlmExecutor {
   // The token served as the first input token to the model for next Prefill or
   // Decode.
   int next_input_token_id_ = -1;
+
+  // The kv-cache and the steps of a context other than the active one, see
+  // CreateContext().
+  struct ParkedContext {
+    absl::flat_hash_map<absl::string_view, ::litert::TensorBuffer>
+        kv_cache_buffers;
+    int current_step = 0;
+    int next_input_token_id = -1;
+  };
+  absl::flat_hash_map<int, ParkedContext> parked_contexts_;
+  int active_context_id_ = 0;
+  int next_context_id_ = 1;
+
+  // The outputs of the decode RoPE signature for the positions
+  // [0, decode_rope_table_steps_), with the rows of all the positions laid out
+  // back to back per output buffer name.
+  absl::flat_hash_map<absl::string_view, std::vector<uint8_t>>
+      decode_rope_table_;
+  int decode_rope_table_steps_ = 0;
+
+  // Whether the cache update of the last step and the RoPE of the current one
+  // are scheduled on `decode_input_pool_`, and their status once done.
+  bool decode_inputs_pending_ = false;
+  absl::Status decode_inputs_status_;
+
+  // The worker thread running the cache update of the last decode step and
+  // the RoPE of the next one while the host samples and processes the logits
+  // of the last one, if pipelining of the decode inputs is enabled. Declared
+  // last, so that a pending task finishes before the buffers it uses are
+  // destroyed.
+  std::unique_ptr<ThreadPool> decode_input_pool_;
 };
 
 }  // namespace litert::lm
@@ -0,0 +1,58 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/lora_adapter.h"
+
+#include <cstdint>
+#include <string>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "flatbuffers/flatbuffers.h"  // from @flatbuffers
+#include "schema/core/litertlm_header_schema_generated.h"
+
+namespace litert::lm {
+
+absl::StatusOr<LoraAdapter> ParseLoraAdapter(
+    absl::string_view serialized_adapter) {
+  const auto* data =
+      reinterpret_cast<const uint8_t*>(serialized_adapter.data());
+  flatbuffers::Verifier verifier(data, serialized_adapter.size());
+  if (!verifier.VerifyBuffer<schema::LoraAdapter>(nullptr)) {
+    return absl::InvalidArgumentError("Invalid LoRA adapter buffer.");
+  }
+  const auto* adapter = flatbuffers::GetRoot<schema::LoraAdapter>(data);
+  LoraAdapter parsed;
+  parsed.name = adapter->name()->str();
+  if (parsed.name.empty()) {
+    return absl::InvalidArgumentError("LoRA adapter has no name.");
+  }
+  parsed.rank = adapter->rank();
+  for (const auto* tensor : *adapter->tensors()) {
+    const auto [it, inserted] = parsed.tensors.try_emplace(
+        tensor->name()->str(),
+        absl::MakeConstSpan(tensor->data()->data(), tensor->data()->size()));
+    if (!inserted) {
+      return absl::InvalidArgumentError(
+          absl::StrCat("LoRA adapter ", parsed.name, " has two tensors named ",
+                       it->first));
+    }
+  }
+  return parsed;
+}
+
+}  // namespace litert::lm
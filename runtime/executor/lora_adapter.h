@@ -0,0 +1,49 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_LORA_ADAPTER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_LORA_ADAPTER_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// The model inputs that take the LoRA weights start with this prefix.
+inline constexpr absl::string_view kLoraInputPrefix = "lora_";
+
+// A LoRA adapter parsed from a serialized schema::LoraAdapter. The tensor data
+// refers to the serialized adapter, which must outlive it.
+struct LoraAdapter {
+  std::string name;
+  uint32_t rank = 0;
+  // The raw data of each tensor, keyed by the name of the model input it is
+  // bound to.
+  absl::flat_hash_map<std::string, absl::Span<const uint8_t>> tensors;
+};
+
+// Parses and verifies a serialized schema::LoraAdapter. Returns an error if the
+// buffer is not a valid adapter, the adapter has no name or two tensors share
+// a name.
+absl::StatusOr<LoraAdapter> ParseLoraAdapter(
+    absl::string_view serialized_adapter);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_LORA_ADAPTER_H_
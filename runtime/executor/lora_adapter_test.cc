@@ -0,0 +1,73 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/lora_adapter.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "flatbuffers/flatbuffer_builder.h"  // from @flatbuffers
+#include "schema/core/litertlm_header_schema_generated.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::status::StatusIs;
+
+// Serializes an adapter of the given name and tensors.
+std::string SerializeAdapter(
+    const std::string& name,
+    const std::vector<std::pair<std::string, std::vector<uint8_t>>>& tensors) {
+  flatbuffers::FlatBufferBuilder builder;
+  std::vector<flatbuffers::Offset<schema::LoraTensor>> tensor_offsets;
+  for (const auto& [tensor_name, data] : tensors) {
+    tensor_offsets.push_back(
+        schema::CreateLoraTensorDirect(builder, tensor_name.c_str(), &data));
+  }
+  builder.Finish(schema::CreateLoraAdapterDirect(builder, name.c_str(),
+                                                 /*rank=*/4, &tensor_offsets));
+  return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()),
+                     builder.GetSize());
+}
+
+TEST(LoraAdapterTest, ParseLoraAdapter) {
+  const std::string serialized = SerializeAdapter(
+      "chat", {{"lora_q_a", {1, 2, 3}}, {"lora_q_b", {4, 5}}});
+  ASSERT_OK_AND_ASSIGN(LoraAdapter adapter, ParseLoraAdapter(serialized));
+  EXPECT_EQ(adapter.name, "chat");
+  EXPECT_EQ(adapter.rank, 4);
+  ASSERT_EQ(adapter.tensors.size(), 2);
+  EXPECT_THAT(adapter.tensors.at("lora_q_a"), ElementsAre(1, 2, 3));
+  EXPECT_THAT(adapter.tensors.at("lora_q_b"), ElementsAre(4, 5));
+}
+
+TEST(LoraAdapterTest, ParseLoraAdapterRejectsInvalidAdapters) {
+  EXPECT_THAT(ParseLoraAdapter("not an adapter"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseLoraAdapter(SerializeAdapter("", {{"lora_q_a", {1}}})),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(ParseLoraAdapter(SerializeAdapter(
+                  "chat", {{"lora_q_a", {1}}, {"lora_q_a", {2}}})),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
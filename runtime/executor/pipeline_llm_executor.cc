@@ -0,0 +1,282 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/pipeline_llm_executor.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/framework/threadpool.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/litert_status_util.h"
+#include "runtime/util/memory_usage.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// Returns an error if the prefill of `prefill_params` is to be stopped before
+// the next micro-batch.
+absl::Status CheckPrefillStop(const ExecutorPrefillParams& prefill_params) {
+  const std::atomic_bool* cancel = prefill_params.GetCancelFlag();
+  if (cancel != nullptr && cancel->load(std::memory_order_relaxed)) {
+    return absl::CancelledError("The prefill is cancelled.");
+  }
+  if (absl::Now() >= prefill_params.GetDeadline()) {
+    return absl::DeadlineExceededError("The prefill deadline is exceeded.");
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<PipelineLlmExecutor>>
+PipelineLlmExecutor::Create(std::unique_ptr<LlmExecutor> first_stage,
+                            std::unique_ptr<LlmExecutor> second_stage,
+                            int micro_batch_size) {
+  RET_CHECK(first_stage != nullptr && second_stage != nullptr)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Both the first and the second stage executors are required.";
+  RET_CHECK_GT(micro_batch_size, 0).SetCode(absl::StatusCode::kInvalidArgument)
+      << "The micro-batch size must be positive.";
+  return absl::WrapUnique(new PipelineLlmExecutor(
+      std::move(first_stage), std::move(second_stage), micro_batch_size));
+}
+
+PipelineLlmExecutor::PipelineLlmExecutor(
+    std::unique_ptr<LlmExecutor> first_stage,
+    std::unique_ptr<LlmExecutor> second_stage, int micro_batch_size)
+    : first_stage_(std::move(first_stage)),
+      second_stage_(std::move(second_stage)),
+      micro_batch_size_(micro_batch_size),
+      first_stage_thread_("pipeline_first_stage", /*max_num_threads=*/1) {}
+
+absl::Status PipelineLlmExecutor::Prefill(const ExecutorInputs& inputs) {
+  ExecutorPrefillParams prefill_params;
+  return Prefill(inputs, prefill_params);
+}
+
+absl::Status PipelineLlmExecutor::Prefill(
+    const ExecutorInputs& inputs, const ExecutorPrefillParams& prefill_params) {
+  RET_CHECK(!inputs.GetVisionEmbeddingsPtr().ok() &&
+            !inputs.GetAudioEmbeddingsPtr().ok())
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "The pipeline executor only prefills text.";
+  ASSIGN_OR_RETURN(const auto* token_ids, inputs.GetTextTokenIdsPtr());
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, token_ids->TensorType());
+  const auto& dims = tensor_type.Layout().Dimensions();
+  RET_CHECK(dims.size() == 2 && dims[0] == 1)
+          .SetCode(absl::StatusCode::kUnimplemented)
+      << "The pipeline executor only prefills a single row.";
+  RET_CHECK_GT(dims[1], 0).SetCode(absl::StatusCode::kInvalidArgument)
+      << "Prefill token ids must be non-empty.";
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto ids,
+                               ReferTensorBufferAsSpan<int32_t>(*token_ids));
+
+  // As with the other executors, the last id is held back as the pending
+  // input token of the next call, and the pending one is run in front.
+  std::vector<int> ids_to_run;
+  ids_to_run.reserve(ids.size());
+  if (next_input_token_id_ != -1) {
+    ids_to_run.push_back(next_input_token_id_);
+  }
+  ids_to_run.insert(ids_to_run.end(), ids.begin(), ids.end() - 1);
+  const int start_step = current_step_;
+  absl::Status status = PrefillMicroBatches(ids_to_run, prefill_params);
+  const int num_run = current_step_ - start_step;
+  next_input_token_id_ = num_run < static_cast<int>(ids_to_run.size())
+                             ? ids_to_run[num_run]
+                             : ids.back();
+  return status;
+}
+
+absl::Status PipelineLlmExecutor::PrefillMicroBatches(
+    absl::Span<const int> token_ids,
+    const ExecutorPrefillParams& prefill_params) {
+  if (token_ids.empty()) {
+    return absl::OkStatus();
+  }
+  auto micro_batch = [&](int index) {
+    return token_ids.subspan(index * micro_batch_size_, micro_batch_size_);
+  };
+  auto run_first_stage = [this](absl::Span<const int> micro_batch_ids) {
+    return first_stage_thread_.Submit([this, micro_batch_ids]() {
+      return first_stage_->RunPipelineStage(micro_batch_ids,
+                                            /*input_activations=*/nullptr);
+    });
+  };
+  const int num_micro_batches =
+      (token_ids.size() + micro_batch_size_ - 1) / micro_batch_size_;
+
+  RETURN_IF_ERROR(CheckPrefillStop(prefill_params));
+  std::optional<TaskFuture<absl::StatusOr<::litert::TensorBuffer>>>
+      first_stage_run;
+  ASSIGN_OR_RETURN(first_stage_run, run_first_stage(micro_batch(0)));
+  absl::Status status;
+  for (int i = 0; i < num_micro_batches; ++i) {
+    absl::StatusOr<::litert::TensorBuffer> activations =
+        first_stage_run->Get(absl::InfiniteDuration());
+    first_stage_run.reset();
+    if (!activations.ok()) {
+      status = activations.status();
+      break;
+    }
+    // The first stage runs the next micro-batch meanwhile.
+    if (i + 1 < num_micro_batches) {
+      status = CheckPrefillStop(prefill_params);
+      if (!status.ok()) {
+        break;
+      }
+      auto next_run = run_first_stage(micro_batch(i + 1));
+      if (!next_run.ok()) {
+        status = next_run.status();
+        break;
+      }
+      first_stage_run = *std::move(next_run);
+    }
+    status = second_stage_->RunPipelineStage(micro_batch(i), &*activations)
+                 .status();
+    if (!status.ok()) {
+      break;
+    }
+    current_step_ += micro_batch(i).size();
+  }
+  if (first_stage_run.has_value()) {
+    // The activations of the next micro-batch are dropped with the error.
+    first_stage_run->Get(absl::InfiniteDuration()).status().IgnoreError();
+  }
+  if (!status.ok()) {
+    RollbackStages();
+  }
+  return status;
+}
+
+absl::StatusOr<::litert::TensorBuffer> PipelineLlmExecutor::DecodeLogits(
+    const ExecutorInputs& inputs) {
+  int id = next_input_token_id_;
+  if (inputs.GetTextDataPtr().ok()) {
+    ASSIGN_OR_RETURN(const auto* token_ids, inputs.GetTextTokenIdsPtr());
+    auto input_tensor_size = token_ids->PackedSize();
+    if (input_tensor_size && *input_tensor_size != 0) {
+      // Input token ids provided, so use them regardless of whether the next
+      // input token id is set.
+      RET_CHECK_EQ(*input_tensor_size, sizeof(int32_t))
+              .SetCode(absl::StatusCode::kUnimplemented)
+          << "The pipeline executor only decodes a single row.";
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto input_ids, ReferTensorBufferAsSpan<int32_t>(*token_ids));
+      id = input_ids[0];
+    }
+  }
+  if (id == -1) {
+    return absl::InvalidArgumentError("No id available to be decoded.");
+  }
+  const int ids[] = {id};
+  absl::StatusOr<::litert::TensorBuffer> logits =
+      first_stage_->RunPipelineStage(ids, /*input_activations=*/nullptr);
+  if (logits.ok()) {
+    // The activations are read by the second stage in place.
+    ::litert::TensorBuffer activations = *std::move(logits);
+    logits = second_stage_->RunPipelineStage(ids, &activations);
+  }
+  if (!logits.ok()) {
+    RollbackStages();
+    return logits.status();
+  }
+  next_input_token_id_ = -1;
+  ++current_step_;
+  return logits;
+}
+
+absl::Status PipelineLlmExecutor::Rollback(int num_processed_tokens,
+                                           int next_input_token_id) {
+  RET_CHECK(num_processed_tokens >= 0 && num_processed_tokens <= current_step_)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Cannot roll back to " << num_processed_tokens << " tokens with "
+      << current_step_ << " tokens in the kv-cache.";
+  RETURN_IF_ERROR(first_stage_->Rollback(num_processed_tokens,
+                                         /*next_input_token_id=*/-1));
+  RETURN_IF_ERROR(second_stage_->Rollback(num_processed_tokens,
+                                          /*next_input_token_id=*/-1));
+  current_step_ = num_processed_tokens;
+  next_input_token_id_ = next_input_token_id;
+  return absl::OkStatus();
+}
+
+void PipelineLlmExecutor::RollbackStages() {
+  for (LlmExecutor* stage : {first_stage_.get(), second_stage_.get()}) {
+    absl::Status status =
+        stage->Rollback(current_step_, /*next_input_token_id=*/-1);
+    if (!status.ok()) {
+      ABSL_LOG(WARNING) << "Failed to roll the " << stage->ExecutorBackendName()
+                        << " stage back to step " << current_step_ << ": "
+                        << status;
+    }
+  }
+}
+
+absl::StatusOr<ExecutorStageLatencies> PipelineLlmExecutor::GetStageLatencies()
+    const {
+  ASSIGN_OR_RETURN(ExecutorStageLatencies latencies,
+                   second_stage_->GetStageLatencies());
+  auto first_stage_latencies = first_stage_->GetStageLatencies();
+  if (first_stage_latencies.ok()) {
+    for (const auto& [stage, latency] : *first_stage_latencies) {
+      latencies[stage] += latency;
+    }
+  }
+  return latencies;
+}
+
+absl::Status PipelineLlmExecutor::ReleaseCaches() {
+  absl::Status first_stage_status = first_stage_->ReleaseCaches();
+  if (!first_stage_status.ok() && !absl::IsUnimplemented(first_stage_status)) {
+    return first_stage_status;
+  }
+  return second_stage_->ReleaseCaches();
+}
+
+absl::StatusOr<MemoryUsage> PipelineLlmExecutor::GetMemoryUsage() const {
+  ASSIGN_OR_RETURN(MemoryUsage memory_usage, second_stage_->GetMemoryUsage());
+  auto first_stage_memory_usage = first_stage_->GetMemoryUsage();
+  if (first_stage_memory_usage.ok()) {
+    memory_usage.Merge(*first_stage_memory_usage);
+  }
+  return memory_usage;
+}
+
+absl::Status PipelineLlmExecutor::Reset() {
+  RETURN_IF_ERROR(first_stage_->Reset());
+  RETURN_IF_ERROR(second_stage_->Reset());
+  current_step_ = 0;
+  next_input_token_id_ = -1;
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
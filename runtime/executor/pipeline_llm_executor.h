@@ -0,0 +1,121 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_PIPELINE_LLM_EXECUTOR_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_PIPELINE_LLM_EXECUTOR_H_
+
+#include <memory>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/framework/threadpool.h"
+#include "runtime/util/memory_usage.h"
+
+namespace litert::lm {
+
+// Runs a model split by layers into two stages, the kTfLitePipelineFirstStage
+// and kTfLitePipelineSecondStage sections, on two executors, e.g. on the NPU
+// and on the GPU, for a model that doesn't fit or is too slow on any one of
+// them. The executors run their stage with RunPipelineStage(), and the
+// activations of the first stage are passed to the second one in the buffer
+// the first stage outputs them to.
+//
+// The prompts are prefilled by micro-batches of `micro_batch_size` tokens,
+// the first stage running the next micro-batch while the second stage runs
+// the current one, such that both executors are busy. The decode steps run
+// the stages one after the other. The logits are sampled outside of the
+// executor, i.e. with the CPU sampler.
+class PipelineLlmExecutor : public LlmExecutor {
+ public:
+  static absl::StatusOr<std::unique_ptr<PipelineLlmExecutor>> Create(
+      std::unique_ptr<LlmExecutor> first_stage,
+      std::unique_ptr<LlmExecutor> second_stage, int micro_batch_size);
+
+  // Only a single row of text is prefilled. A failed or cancelled prefill
+  // leaves the executor right after the last micro-batch run by both stages.
+  absl::Status Prefill(const ExecutorInputs& inputs) override;
+  absl::Status Prefill(const ExecutorInputs& inputs,
+                       const ExecutorPrefillParams& prefill_params) override;
+
+  absl::Status Decode(::litert::TensorBuffer& output_tokens) override {
+    return absl::UnimplementedError(
+        "The pipeline executor does not sample, use the CPU sampler.");
+  }
+  absl::StatusOr<::litert::TensorBuffer> DecodeLogits(
+      const ExecutorInputs& inputs) override;
+
+  absl::string_view ExecutorBackendName() const override {
+    return "Pipeline";
+  }
+
+  absl::StatusOr<int> GetVocabSize() override {
+    return second_stage_->GetVocabSize();
+  }
+  absl::StatusOr<int> GetCurrentStep() const override {
+    return current_step_ + (next_input_token_id_ == -1 ? 0 : 1);
+  }
+  absl::StatusOr<LlmExecutorSettings> GetExecutorSettings() const override {
+    return second_stage_->GetExecutorSettings();
+  }
+
+  absl::Status Rollback(int num_processed_tokens,
+                        int next_input_token_id) override;
+  absl::StatusOr<int> GetNextInputTokenId() const override {
+    return next_input_token_id_;
+  }
+
+  // The latencies of both stages, summed by stage.
+  absl::StatusOr<ExecutorStageLatencies> GetStageLatencies() const override;
+  // Releases the caches of both stages.
+  absl::Status ReleaseCaches() override;
+  // The memory of both stages.
+  absl::StatusOr<MemoryUsage> GetMemoryUsage() const override;
+
+  absl::Status Reset() override;
+
+ private:
+  PipelineLlmExecutor(std::unique_ptr<LlmExecutor> first_stage,
+                      std::unique_ptr<LlmExecutor> second_stage,
+                      int micro_batch_size);
+
+  // Runs `token_ids` through both stages by micro-batches, and advances the
+  // current step by the micro-batches run by both.
+  absl::Status PrefillMicroBatches(absl::Span<const int> token_ids,
+                                   const ExecutorPrefillParams& prefill_params);
+
+  // Rolls both stages back to the current step, e.g. after the first stage ran
+  // positions the second one did not.
+  void RollbackStages();
+
+  std::unique_ptr<LlmExecutor> first_stage_;
+  std::unique_ptr<LlmExecutor> second_stage_;
+  const int micro_batch_size_;
+  // Runs the first stage of the next micro-batch of a prefill.
+  ThreadPool first_stage_thread_;
+
+  // The number of positions in the kv-cache of both stages.
+  int current_step_ = 0;
+  // The pending input token of the next call, or -1 if there is none.
+  int next_input_token_id_ = -1;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_PIPELINE_LLM_EXECUTOR_H_
@@ -0,0 +1,270 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/pipeline_llm_executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "litert/test/matchers.h"  // from @litert
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/litert_status_util.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::status::StatusIs;
+
+constexpr int kVocabSize = 16;
+constexpr int kMicroBatchSize = 4;
+
+// A fake stage of a model predicting the id following each token. The first
+// stage outputs the activation id + 0.5 per position, and the second stage
+// the logits of the id following the one of its last activation.
+class FakeStageExecutor : public LlmExecutor {
+ public:
+  explicit FakeStageExecutor(bool is_first_stage)
+      : is_first_stage_(is_first_stage) {}
+
+  absl::Status Prefill(const ExecutorInputs& inputs) override {
+    return absl::UnimplementedError("The stages are run by the pipeline.");
+  }
+  absl::Status Decode(::litert::TensorBuffer& output_tokens) override {
+    return absl::UnimplementedError("The stages are run by the pipeline.");
+  }
+  absl::string_view ExecutorBackendName() const override {
+    return "FakeStage";
+  }
+  absl::StatusOr<int> GetVocabSize() override { return kVocabSize; }
+  absl::StatusOr<int> GetCurrentStep() const override { return current_step_; }
+
+  absl::StatusOr<::litert::TensorBuffer> RunPipelineStage(
+      absl::Span<const int> token_ids,
+      const ::litert::TensorBuffer* input_activations) override {
+    const int num_positions = token_ids.size();
+    if (on_run_) {
+      on_run_(run_sizes_.size());
+    }
+    if (failing_step_ >= current_step_ &&
+        failing_step_ < current_step_ + num_positions) {
+      return absl::InternalError("The stage failed.");
+    }
+    run_sizes_.push_back(num_positions);
+    current_step_ += num_positions;
+    if (is_first_stage_) {
+      EXPECT_EQ(input_activations, nullptr);
+      std::vector<float> activations;
+      for (int id : token_ids) {
+        activations.push_back(id + 0.5f);
+      }
+      LITERT_ASSIGN_OR_RETURN_ABSL(
+          auto buffer,
+          CopyToTensorBuffer<float>(absl::MakeConstSpan(activations),
+                                    {1, num_positions, 1}));
+      return buffer;
+    }
+    EXPECT_NE(input_activations, nullptr);
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto activations, CopyFromTensorBuffer<float>(*input_activations));
+    EXPECT_EQ(activations.size(), token_ids.size());
+    std::vector<float> logits(kVocabSize, 0.0f);
+    logits[(static_cast<int>(activations.back()) + 1) % kVocabSize] = 1.0f;
+    LITERT_ASSIGN_OR_RETURN_ABSL(
+        auto buffer, CopyToTensorBuffer<float>(absl::MakeConstSpan(logits),
+                                               {1, 1, kVocabSize}));
+    return buffer;
+  }
+
+  absl::Status Rollback(int num_processed_tokens,
+                        int next_input_token_id) override {
+    EXPECT_EQ(next_input_token_id, -1);
+    current_step_ = num_processed_tokens;
+    return absl::OkStatus();
+  }
+
+  absl::Status Reset() override {
+    current_step_ = 0;
+    return absl::OkStatus();
+  }
+
+  // The number of positions of each run.
+  const std::vector<int>& run_sizes() const { return run_sizes_; }
+  // Makes the runs covering `step` fail.
+  void set_failing_step(int step) { failing_step_ = step; }
+  // Called with the index of each run before it starts.
+  void set_on_run(std::function<void(int)> on_run) {
+    on_run_ = std::move(on_run);
+  }
+
+ private:
+  const bool is_first_stage_;
+  int current_step_ = 0;
+  int failing_step_ = -1;
+  std::vector<int> run_sizes_;
+  std::function<void(int)> on_run_;
+};
+
+ExecutorInputs MakeInputs(std::vector<int> token_ids) {
+  auto token_ids_buffer = CopyToTensorBuffer<int>(
+      absl::MakeSpan(token_ids), {1, static_cast<int>(token_ids.size())});
+  ExecutorInputs inputs;
+  inputs.SetTextData(ExecutorTextData(std::move(*token_ids_buffer)));
+  return inputs;
+}
+
+class PipelineLlmExecutorTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    auto first_stage = std::make_unique<FakeStageExecutor>(true);
+    auto second_stage = std::make_unique<FakeStageExecutor>(false);
+    first_stage_ = first_stage.get();
+    second_stage_ = second_stage.get();
+    ASSERT_OK_AND_ASSIGN(executor_, PipelineLlmExecutor::Create(
+                                        std::move(first_stage),
+                                        std::move(second_stage),
+                                        kMicroBatchSize));
+  }
+
+  FakeStageExecutor* first_stage_;
+  FakeStageExecutor* second_stage_;
+  std::unique_ptr<PipelineLlmExecutor> executor_;
+};
+
+TEST(PipelineLlmExecutorCreateTest, RejectsInvalidArguments) {
+  EXPECT_THAT(
+      PipelineLlmExecutor::Create(
+          nullptr, std::make_unique<FakeStageExecutor>(false), kMicroBatchSize),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(PipelineLlmExecutor::Create(
+                  std::make_unique<FakeStageExecutor>(true),
+                  std::make_unique<FakeStageExecutor>(false),
+                  /*micro_batch_size=*/0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(PipelineLlmExecutorTest, PrefillsByMicroBatches) {
+  EXPECT_OK(
+      executor_->Prefill(MakeInputs({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11})));
+  // The last id is pending, the other ones are run by micro-batches.
+  EXPECT_THAT(first_stage_->run_sizes(), ElementsAre(4, 4, 2));
+  EXPECT_THAT(second_stage_->run_sizes(), ElementsAre(4, 4, 2));
+  EXPECT_EQ(*executor_->GetCurrentStep(), 11);
+  EXPECT_EQ(*executor_->GetNextInputTokenId(), 11);
+
+  // The pending id is run in front of the next prompt.
+  EXPECT_OK(executor_->Prefill(MakeInputs({12, 13})));
+  EXPECT_THAT(second_stage_->run_sizes(), ElementsAre(4, 4, 2, 2));
+  EXPECT_EQ(*executor_->GetCurrentStep(), 13);
+  EXPECT_EQ(*first_stage_->GetCurrentStep(), 12);
+  EXPECT_EQ(*second_stage_->GetCurrentStep(), 12);
+}
+
+TEST_F(PipelineLlmExecutorTest, DecodesThroughBothStages) {
+  EXPECT_OK(executor_->Prefill(MakeInputs({1, 2, 3})));
+  ExecutorInputs no_inputs;
+  ASSERT_OK_AND_ASSIGN(auto logits, executor_->DecodeLogits(no_inputs));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto logits_values,
+                              CopyFromTensorBuffer<float>(logits));
+  ASSERT_EQ(logits_values.size(), kVocabSize);
+  EXPECT_EQ(std::max_element(logits_values.begin(), logits_values.end()) -
+                logits_values.begin(),
+            4);
+  EXPECT_EQ(*executor_->GetCurrentStep(), 3);
+  EXPECT_EQ(*executor_->GetNextInputTokenId(), -1);
+
+  // The sampled id is passed back as the input of the next step.
+  ASSERT_OK_AND_ASSIGN(logits, executor_->DecodeLogits(MakeInputs({4})));
+  LITERT_ASSERT_OK_AND_ASSIGN(logits_values,
+                              CopyFromTensorBuffer<float>(logits));
+  EXPECT_EQ(logits_values[5], 1.0f);
+  EXPECT_EQ(*executor_->GetCurrentStep(), 4);
+
+  LITERT_ASSERT_OK_AND_ASSIGN(auto output_tokens,
+                              CreateTensorBuffer<int>({1, 1}));
+  EXPECT_THAT(executor_->Decode(output_tokens),
+              StatusIs(absl::StatusCode::kUnimplemented));
+}
+
+TEST_F(PipelineLlmExecutorTest, OverlapsTheStages) {
+  // The second stage runs the first micro-batch while the first stage runs the
+  // second one, which would time out if the stages took turns.
+  absl::Notification second_micro_batch_started;
+  bool overlapped = false;
+  first_stage_->set_on_run([&](int run_index) {
+    if (run_index == 1) {
+      second_micro_batch_started.Notify();
+    }
+  });
+  second_stage_->set_on_run([&](int run_index) {
+    if (run_index == 0) {
+      overlapped = second_micro_batch_started.WaitForNotificationWithTimeout(
+          absl::Seconds(10));
+    }
+  });
+  EXPECT_OK(executor_->Prefill(MakeInputs({1, 2, 3, 4, 5, 6, 7, 8, 9})));
+  EXPECT_TRUE(overlapped);
+}
+
+TEST_F(PipelineLlmExecutorTest, RollsTheStagesBackOnError) {
+  second_stage_->set_failing_step(5);
+  EXPECT_THAT(
+      executor_->Prefill(MakeInputs({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11})),
+      StatusIs(absl::StatusCode::kInternal));
+  // The executor is left after the first micro-batch, which both stages ran.
+  EXPECT_EQ(*first_stage_->GetCurrentStep(), 4);
+  EXPECT_EQ(*second_stage_->GetCurrentStep(), 4);
+  EXPECT_EQ(*executor_->GetCurrentStep(), 5);
+  EXPECT_EQ(*executor_->GetNextInputTokenId(), 5);
+
+  second_stage_->set_failing_step(-1);
+  EXPECT_OK(executor_->Rollback(2, 3));
+  EXPECT_EQ(*first_stage_->GetCurrentStep(), 2);
+  EXPECT_EQ(*executor_->GetCurrentStep(), 3);
+  EXPECT_OK(executor_->Reset());
+  EXPECT_EQ(*executor_->GetCurrentStep(), 0);
+  EXPECT_EQ(*second_stage_->GetCurrentStep(), 0);
+}
+
+TEST_F(PipelineLlmExecutorTest, StopsACancelledPrefill) {
+  std::atomic_bool cancel = false;
+  ExecutorPrefillParams prefill_params;
+  prefill_params.SetCancelFlag(&cancel);
+  first_stage_->set_on_run([&](int run_index) { cancel = true; });
+  EXPECT_THAT(executor_->Prefill(MakeInputs({1, 2, 3, 4, 5, 6, 7, 8, 9, 10}),
+                                 prefill_params),
+              StatusIs(absl::StatusCode::kCancelled));
+  EXPECT_EQ(*first_stage_->GetCurrentStep(), 0);
+  EXPECT_EQ(*second_stage_->GetCurrentStep(), 0);
+  EXPECT_EQ(*executor_->GetCurrentStep(), 1);
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,354 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/split_llm_executor.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/kv_cache_layout.h"
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/util/litert_status_util.h"
+#include "runtime/util/memory_usage.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+
+// static
+absl::StatusOr<std::unique_ptr<SplitLlmExecutor>> SplitLlmExecutor::Create(
+    std::unique_ptr<LlmExecutor> prefill_executor,
+    std::unique_ptr<LlmExecutor> decode_executor, int min_prefill_tokens) {
+  RET_CHECK(prefill_executor != nullptr && decode_executor != nullptr)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Both the prefill and the decode executors are required.";
+  RET_CHECK_GT(min_prefill_tokens, 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The min number of prefill tokens must be positive.";
+  std::optional<KvCacheLayouts> prefill_layouts;
+  std::optional<KvCacheLayouts> decode_layouts;
+  auto source_layouts = prefill_executor->GetKvCacheLayouts();
+  auto target_layouts = decode_executor->GetKvCacheLayouts();
+  if (source_layouts.ok() && target_layouts.ok()) {
+    if (*source_layouts != *target_layouts) {
+      prefill_layouts = *std::move(source_layouts);
+      decode_layouts = *std::move(target_layouts);
+    }
+  } else {
+    ABSL_LOG(WARNING) << "The kv-cache layouts of the "
+                      << prefill_executor->ExecutorBackendName() << " and "
+                      << decode_executor->ExecutorBackendName()
+                      << " executors are unknown, the kv-cache is handed "
+                         "over unconverted.";
+  }
+  return absl::WrapUnique(new SplitLlmExecutor(
+      std::move(prefill_executor), std::move(decode_executor),
+      min_prefill_tokens, std::move(prefill_layouts),
+      std::move(decode_layouts)));
+}
+
+SplitLlmExecutor::SplitLlmExecutor(
+    std::unique_ptr<LlmExecutor> prefill_executor,
+    std::unique_ptr<LlmExecutor> decode_executor, int min_prefill_tokens,
+    std::optional<KvCacheLayouts> prefill_layouts,
+    std::optional<KvCacheLayouts> decode_layouts)
+    : prefill_executor_(std::move(prefill_executor)),
+      decode_executor_(std::move(decode_executor)),
+      min_prefill_tokens_(min_prefill_tokens),
+      prefill_layouts_(std::move(prefill_layouts)),
+      decode_layouts_(std::move(decode_layouts)) {}
+
+absl::StatusOr<LlmExecutor*> SplitLlmExecutor::SelectPrefillExecutor(
+    const ExecutorInputs& inputs) {
+  // The rest of a prompt goes where its beginning went.
+  if (context_on_prefill_executor_) {
+    return prefill_executor_.get();
+  }
+  ASSIGN_OR_RETURN(const int current_step, decode_executor_->GetCurrentStep());
+  if (current_step > 0 || has_vision_embeddings_ || !lora_name_.empty()) {
+    return decode_executor_.get();
+  }
+  ASSIGN_OR_RETURN(const auto* token_ids, inputs.GetTextTokenIdsPtr());
+  LITERT_ASSIGN_OR_RETURN_ABSL(auto tensor_type, token_ids->TensorType());
+  RET_CHECK_EQ(tensor_type.Layout().Dimensions().size(), 2)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Prefill token ids must be of shape [batch, sequence_length].";
+  if (tensor_type.Layout().Dimensions()[1] < min_prefill_tokens_) {
+    return decode_executor_.get();
+  }
+  return prefill_executor_.get();
+}
+
+absl::Status SplitLlmExecutor::Prefill(const ExecutorInputs& inputs) {
+  ASSIGN_OR_RETURN(LlmExecutor * executor, SelectPrefillExecutor(inputs));
+  has_vision_embeddings_ = false;
+  RETURN_IF_ERROR(executor->Prefill(inputs));
+  context_on_prefill_executor_ = executor == prefill_executor_.get();
+  return absl::OkStatus();
+}
+
+absl::Status SplitLlmExecutor::Prefill(
+    const ExecutorInputs& inputs, const ExecutorPrefillParams& prefill_params) {
+  ASSIGN_OR_RETURN(LlmExecutor * executor, SelectPrefillExecutor(inputs));
+  has_vision_embeddings_ = false;
+  RETURN_IF_ERROR(executor->Prefill(inputs, prefill_params));
+  context_on_prefill_executor_ = executor == prefill_executor_.get();
+  return absl::OkStatus();
+}
+
+absl::Status SplitLlmExecutor::HandOverPrefill() {
+  if (!context_on_prefill_executor_) {
+    return absl::OkStatus();
+  }
+  ASSIGN_OR_RETURN(auto checkpoint, prefill_executor_->SaveState());
+  if (decode_layouts_.has_value()) {
+    ASSIGN_OR_RETURN(checkpoint, ConvertCheckpoint(*checkpoint));
+  }
+  RETURN_IF_ERROR(decode_executor_->RestoreState(*checkpoint));
+  context_on_prefill_executor_ = false;
+  ++num_handovers_;
+  // The latencies of the prefill executor are cleared by its Reset().
+  auto latencies = prefill_executor_->GetStageLatencies();
+  if (latencies.ok()) {
+    for (const auto& [stage, latency] : *latencies) {
+      prefill_stage_latencies_[stage] += latency;
+    }
+  }
+  return prefill_executor_->Reset();
+}
+
+absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>>
+SplitLlmExecutor::ConvertCheckpoint(
+    const ExecutorCheckpoint& checkpoint) const {
+  if (!checkpoint.GetKvCacheScales().empty()) {
+    return absl::UnimplementedError(
+        "Cannot convert a checkpoint with a quantized kv-cache.");
+  }
+  ExecutorCheckpoint::KvCacheData kv_cache;
+  for (const auto& [name, target_layout] : *decode_layouts_) {
+    auto source_layout = prefill_layouts_->find(name);
+    RET_CHECK(source_layout != prefill_layouts_->end())
+            .SetCode(absl::StatusCode::kInvalidArgument)
+        << "The prefill executor has no kv-cache tensor " << name;
+    ASSIGN_OR_RETURN(auto source, checkpoint.GetKvCacheTensor(name));
+    std::vector<uint8_t>& target = kv_cache[name];
+    target.resize(target_layout.SizeInBytes());
+    RETURN_IF_ERROR(ConvertKvCacheTensor(
+        source, source_layout->second, target_layout,
+        checkpoint.GetCurrentStep(), absl::MakeSpan(target)));
+  }
+  return std::make_unique<ExecutorCheckpoint>(checkpoint.GetCurrentStep(),
+                                              checkpoint.GetNextInputTokenId(),
+                                              std::move(kv_cache));
+}
+
+absl::Status SplitLlmExecutor::Decode(::litert::TensorBuffer& output_tokens) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->Decode(output_tokens);
+}
+
+absl::Status SplitLlmExecutor::Decode(const ExecutorInputs& inputs,
+                                      ::litert::TensorBuffer& output_logits) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->Decode(inputs, output_logits);
+}
+
+absl::StatusOr<::litert::TensorBuffer> SplitLlmExecutor::DecodeLogits(
+    const ExecutorInputs& inputs) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->DecodeLogits(inputs);
+}
+
+absl::Status SplitLlmExecutor::DecodeTopKLogits(
+    const ExecutorInputs& inputs, ::litert::TensorBuffer& output_topk_logits,
+    ::litert::TensorBuffer& output_topk_ids) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->DecodeTopKLogits(inputs, output_topk_logits,
+                                            output_topk_ids);
+}
+
+absl::StatusOr<int> SplitLlmExecutor::GetCurrentStep() const {
+  return context_on_prefill_executor_ ? prefill_executor_->GetCurrentStep()
+                                      : decode_executor_->GetCurrentStep();
+}
+
+absl::StatusOr<int> SplitLlmExecutor::GetNextInputTokenId() const {
+  return context_on_prefill_executor_
+             ? prefill_executor_->GetNextInputTokenId()
+             : decode_executor_->GetNextInputTokenId();
+}
+
+absl::Status SplitLlmExecutor::FillVisionEmbeddings(
+    const ExecutorVisionData& vision_input, int image_index) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  RETURN_IF_ERROR(
+      decode_executor_->FillVisionEmbeddings(vision_input, image_index));
+  has_vision_embeddings_ = true;
+  return absl::OkStatus();
+}
+
+absl::Status SplitLlmExecutor::FillVisionEmbeddingsBatch(
+    absl::Span<const ExecutorVisionData> vision_inputs,
+    int first_image_index) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  RETURN_IF_ERROR(decode_executor_->FillVisionEmbeddingsBatch(
+      vision_inputs, first_image_index));
+  has_vision_embeddings_ = true;
+  return absl::OkStatus();
+}
+
+absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>>
+SplitLlmExecutor::SaveState() {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->SaveState();
+}
+
+absl::Status SplitLlmExecutor::RestoreState(
+    const ExecutorCheckpoint& checkpoint) {
+  if (context_on_prefill_executor_) {
+    RETURN_IF_ERROR(prefill_executor_->Reset());
+    context_on_prefill_executor_ = false;
+  }
+  return decode_executor_->RestoreState(checkpoint);
+}
+
+absl::StatusOr<std::vector<int>> SplitLlmExecutor::VerifyDraftTokens(
+    absl::Span<const int> draft_token_ids) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->VerifyDraftTokens(draft_token_ids);
+}
+
+absl::StatusOr<std::vector<float>> SplitLlmExecutor::ScoreTokens(
+    absl::Span<const int> token_ids) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->ScoreTokens(token_ids);
+}
+
+absl::Status SplitLlmExecutor::Rollback(int num_processed_tokens,
+                                        int next_input_token_id) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->Rollback(num_processed_tokens, next_input_token_id);
+}
+
+absl::Status SplitLlmExecutor::ReorderBatchRows(
+    absl::Span<const int> source_rows) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->ReorderBatchRows(source_rows);
+}
+
+absl::Status SplitLlmExecutor::ShiftContext(int num_sink_tokens,
+                                            int num_discarded_tokens) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->ShiftContext(num_sink_tokens,
+                                        num_discarded_tokens);
+}
+
+absl::Status SplitLlmExecutor::CompactContext(
+    absl::Span<const std::pair<int, int>> discarded_ranges) {
+  RETURN_IF_ERROR(HandOverPrefill());
+  return decode_executor_->CompactContext(discarded_ranges);
+}
+
+absl::Status SplitLlmExecutor::UnloadLoraAdapter(absl::string_view name) {
+  RETURN_IF_ERROR(decode_executor_->UnloadLoraAdapter(name));
+  if (name == lora_name_) {
+    lora_name_.clear();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status SplitLlmExecutor::SelectLoraAdapter(absl::string_view name) {
+  RETURN_IF_ERROR(decode_executor_->SelectLoraAdapter(name));
+  lora_name_ = std::string(name);
+  return absl::OkStatus();
+}
+
+absl::Status SplitLlmExecutor::SelectLoraAdapters(
+    absl::Span<const std::string> names) {
+  RETURN_IF_ERROR(decode_executor_->SelectLoraAdapters(names));
+  // The prompts are prefilled on the decode executor if any row has an
+  // adapter.
+  lora_name_.clear();
+  for (const std::string& name : names) {
+    if (!name.empty()) {
+      lora_name_ = name;
+      break;
+    }
+  }
+  return absl::OkStatus();
+}
+
+absl::StatusOr<ExecutorStageLatencies> SplitLlmExecutor::GetStageLatencies()
+    const {
+  ASSIGN_OR_RETURN(ExecutorStageLatencies latencies,
+                   decode_executor_->GetStageLatencies());
+  for (const auto& [stage, latency] : prefill_stage_latencies_) {
+    latencies[stage] += latency;
+  }
+  auto prefill_latencies = prefill_executor_->GetStageLatencies();
+  if (prefill_latencies.ok()) {
+    for (const auto& [stage, latency] : *prefill_latencies) {
+      latencies[stage] += latency;
+    }
+  }
+  return latencies;
+}
+
+absl::StatusOr<MemoryUsage> SplitLlmExecutor::GetMemoryUsage() const {
+  ASSIGN_OR_RETURN(MemoryUsage memory_usage,
+                   decode_executor_->GetMemoryUsage());
+  auto prefill_memory_usage = prefill_executor_->GetMemoryUsage();
+  if (prefill_memory_usage.ok()) {
+    memory_usage.Merge(*prefill_memory_usage);
+  }
+  return memory_usage;
+}
+
+absl::Status SplitLlmExecutor::ReleaseCaches() {
+  absl::Status prefill_status = prefill_executor_->ReleaseCaches();
+  if (!prefill_status.ok() && !absl::IsUnimplemented(prefill_status)) {
+    return prefill_status;
+  }
+  return decode_executor_->ReleaseCaches();
+}
+
+absl::Status SplitLlmExecutor::Warmup(int num_decode_steps) {
+  RET_CHECK(!context_on_prefill_executor_)
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "Warmup must be called before the first prefill or after Reset().";
+  RETURN_IF_ERROR(prefill_executor_->Warmup(/*num_decode_steps=*/0));
+  return decode_executor_->Warmup(num_decode_steps);
+}
+
+absl::Status SplitLlmExecutor::Reset() {
+  RETURN_IF_ERROR(prefill_executor_->Reset());
+  RETURN_IF_ERROR(decode_executor_->Reset());
+  context_on_prefill_executor_ = false;
+  has_vision_embeddings_ = false;
+  prefill_stage_latencies_.clear();
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
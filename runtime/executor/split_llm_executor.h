@@ -0,0 +1,191 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_SPLIT_LLM_EXECUTOR_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_SPLIT_LLM_EXECUTOR_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/cc/litert_tensor_buffer.h"  // from @litert
+#include "runtime/executor/kv_cache_layout.h"
+#include "runtime/executor/llm_executor.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/memory_usage.h"
+
+namespace litert::lm {
+
+// Runs the prefill of the long prompts on one executor, e.g. on the NPU, and
+// everything else on another one, e.g. on the GPU, both running the same
+// model. The prompt of a fresh context is prefilled on the prefill executor
+// if it has at least `min_prefill_tokens` tokens. Its kv-cache is then handed
+// over to the decode executor with SaveState() and RestoreState() before the
+// first call that needs it, e.g. Decode(), and converted on the way if the
+// executors report different kv-cache layouts from GetKvCacheLayouts(). The
+// executors not reporting their layouts must share the same one.
+//
+// The shorter prompts, the prompts continuing a context, and the prompts
+// with vision embeddings or a LoRA adapter are prefilled on the decode
+// executor, which serves all the other calls.
+class SplitLlmExecutor : public LlmExecutor {
+ public:
+  static absl::StatusOr<std::unique_ptr<SplitLlmExecutor>> Create(
+      std::unique_ptr<LlmExecutor> prefill_executor,
+      std::unique_ptr<LlmExecutor> decode_executor, int min_prefill_tokens);
+
+  absl::Status Prefill(const ExecutorInputs& inputs) override;
+  absl::Status Prefill(const ExecutorInputs& inputs,
+                       const ExecutorPrefillParams& prefill_params) override;
+
+  absl::Status Decode(::litert::TensorBuffer& output_tokens) override;
+  absl::Status Decode(const ExecutorInputs& inputs,
+                      ::litert::TensorBuffer& output_logits) override;
+  absl::StatusOr<::litert::TensorBuffer> DecodeLogits(
+      const ExecutorInputs& inputs) override;
+  absl::Status DecodeTopKLogits(
+      const ExecutorInputs& inputs, ::litert::TensorBuffer& output_topk_logits,
+      ::litert::TensorBuffer& output_topk_ids) override;
+
+  absl::string_view ExecutorBackendName() const override {
+    return "Split Prefill and Decode";
+  }
+
+  absl::StatusOr<int> GetVocabSize() override {
+    return decode_executor_->GetVocabSize();
+  }
+  // The current step of the executor holding the context.
+  absl::StatusOr<int> GetCurrentStep() const override;
+  absl::StatusOr<int> GetMaxPrefillLength() const override {
+    return decode_executor_->GetMaxPrefillLength();
+  }
+  absl::StatusOr<LlmExecutorSettings> GetExecutorSettings() const override {
+    return decode_executor_->GetExecutorSettings();
+  }
+
+  // The vision embeddings are filled on the decode executor, which prefills
+  // the next prompt.
+  absl::Status FillVisionEmbeddings(const ExecutorVisionData& vision_input,
+                                    int image_index) override;
+  absl::Status FillVisionEmbeddingsBatch(
+      absl::Span<const ExecutorVisionData> vision_inputs,
+      int first_image_index) override;
+
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() override;
+  absl::Status RestoreState(const ExecutorCheckpoint& checkpoint) override;
+  absl::StatusOr<KvCacheLayouts> GetKvCacheLayouts() const override {
+    return decode_executor_->GetKvCacheLayouts();
+  }
+
+  absl::StatusOr<std::vector<int>> VerifyDraftTokens(
+      absl::Span<const int> draft_token_ids) override;
+  absl::StatusOr<std::vector<float>> ScoreTokens(
+      absl::Span<const int> token_ids) override;
+  // The inputs are embedded by the prefill executor, whose context does not
+  // change.
+  absl::StatusOr<std::vector<std::vector<float>>> EmbedTokens(
+      absl::Span<const std::vector<int>> token_ids,
+      EmbeddingPooling pooling) override {
+    return prefill_executor_->EmbedTokens(token_ids, pooling);
+  }
+  absl::Status Rollback(int num_processed_tokens,
+                        int next_input_token_id) override;
+  absl::StatusOr<int> GetNextInputTokenId() const override;
+  absl::Status ReorderBatchRows(absl::Span<const int> source_rows) override;
+  absl::Status ShiftContext(int num_sink_tokens,
+                            int num_discarded_tokens) override;
+  absl::Status CompactContext(
+      absl::Span<const std::pair<int, int>> discarded_ranges) override;
+
+  absl::Status LoadLoraAdapter(absl::string_view serialized_adapter) override {
+    return decode_executor_->LoadLoraAdapter(serialized_adapter);
+  }
+  absl::Status UnloadLoraAdapter(absl::string_view name) override;
+  absl::Status SelectLoraAdapter(absl::string_view name) override;
+  absl::Status SelectLoraAdapters(
+      absl::Span<const std::string> names) override;
+
+  // The latencies of both executors, summed by stage.
+  absl::StatusOr<ExecutorStageLatencies> GetStageLatencies() const override;
+  absl::StatusOr<EmbeddingCacheStats> GetEmbeddingCacheStats() const override {
+    return decode_executor_->GetEmbeddingCacheStats();
+  }
+  // The chunk size of the executor prefilling the long prompts.
+  absl::StatusOr<int> GetPrefillChunkSize() const override {
+    return prefill_executor_->GetPrefillChunkSize();
+  }
+  // Releases the caches of both executors.
+  absl::Status ReleaseCaches() override;
+  // The memory of both executors.
+  absl::StatusOr<MemoryUsage> GetMemoryUsage() const override;
+
+  // Warms the prefill executor up without decode steps, and the decode
+  // executor with them.
+  absl::Status Warmup(int num_decode_steps) override;
+
+  absl::Status Reset() override;
+
+  // Returns the number of prompts prefilled on the prefill executor and
+  // handed over to the decode executor since the executor was created.
+  int GetNumHandovers() const { return num_handovers_; }
+
+ private:
+  SplitLlmExecutor(std::unique_ptr<LlmExecutor> prefill_executor,
+                   std::unique_ptr<LlmExecutor> decode_executor,
+                   int min_prefill_tokens,
+                   std::optional<KvCacheLayouts> prefill_layouts,
+                   std::optional<KvCacheLayouts> decode_layouts);
+
+  // Returns the executor prefilling `inputs`.
+  absl::StatusOr<LlmExecutor*> SelectPrefillExecutor(
+      const ExecutorInputs& inputs);
+
+  // Hands the context prefilled on the prefill executor, if any, over to the
+  // decode executor, and resets the prefill executor.
+  absl::Status HandOverPrefill();
+
+  // Converts the checkpoint of the prefill executor to the kv-cache layouts of
+  // the decode executor.
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> ConvertCheckpoint(
+      const ExecutorCheckpoint& checkpoint) const;
+
+  std::unique_ptr<LlmExecutor> prefill_executor_;
+  std::unique_ptr<LlmExecutor> decode_executor_;
+  const int min_prefill_tokens_;
+  // The kv-cache layouts of both executors, only set if they differ.
+  std::optional<KvCacheLayouts> prefill_layouts_;
+  std::optional<KvCacheLayouts> decode_layouts_;
+
+  // Whether the context is held by the prefill executor.
+  bool context_on_prefill_executor_ = false;
+  // Whether vision embeddings are filled for the next prompt.
+  bool has_vision_embeddings_ = false;
+  // The selected LoRA adapter, or one of the adapters selected per row, or
+  // empty for the base model.
+  std::string lora_name_;
+  // The latencies of the prefill executor before its last Reset().
+  ExecutorStageLatencies prefill_stage_latencies_;
+  int num_handovers_ = 0;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_SPLIT_LLM_EXECUTOR_H_
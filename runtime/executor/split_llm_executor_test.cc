@@ -0,0 +1,244 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/split_llm_executor.h"
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "litert/test/matchers.h"  // from @litert
+#include "runtime/executor/fake_llm_executor.h"
+#include "runtime/executor/kv_cache_layout.h"
+#include "runtime/executor/llm_executor_io_types.h"
+#include "runtime/util/convert_tensor_buffer.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAreArray;
+using ::testing::status::StatusIs;
+
+constexpr char kKvCacheName[] = "kv_cache_k_0";
+constexpr int kVocabSize = 16;
+constexpr int kMinPrefillTokens = 4;
+
+// A fake executor with a kv-cache of one tensor of `layout`, which is saved
+// and restored with the step counters.
+class FakeKvCacheExecutor : public FakeLlmExecutor {
+ public:
+  FakeKvCacheExecutor(KvCacheTensorLayout layout,
+                      const std::vector<std::vector<int>>& prefill_tokens_set,
+                      const std::vector<std::vector<int>>& decode_tokens_set)
+      : FakeLlmExecutor(kVocabSize, prefill_tokens_set, decode_tokens_set),
+        layout_(std::move(layout)),
+        kv_cache_(layout_.SizeInBytes(), 0) {}
+
+  absl::StatusOr<std::unique_ptr<ExecutorCheckpoint>> SaveState() override {
+    auto checkpoint = FakeLlmExecutor::SaveState();
+    if (!checkpoint.ok()) {
+      return checkpoint.status();
+    }
+    ExecutorCheckpoint::KvCacheData kv_cache;
+    kv_cache[kKvCacheName] = kv_cache_;
+    return std::make_unique<ExecutorCheckpoint>(
+        (*checkpoint)->GetCurrentStep(), (*checkpoint)->GetNextInputTokenId(),
+        std::move(kv_cache));
+  }
+
+  absl::Status RestoreState(const ExecutorCheckpoint& checkpoint) override {
+    auto contents = checkpoint.GetKvCacheTensor(kKvCacheName);
+    if (!contents.ok()) {
+      return contents.status();
+    }
+    kv_cache_.assign(contents->begin(), contents->end());
+    return FakeLlmExecutor::RestoreState(checkpoint);
+  }
+
+  absl::StatusOr<KvCacheLayouts> GetKvCacheLayouts() const override {
+    return KvCacheLayouts{{kKvCacheName, layout_}};
+  }
+
+  std::vector<uint8_t>& kv_cache() { return kv_cache_; }
+
+ private:
+  KvCacheTensorLayout layout_;
+  std::vector<uint8_t> kv_cache_;
+};
+
+ExecutorInputs MakeInputs(std::vector<int> token_ids) {
+  auto token_ids_buffer = CopyToTensorBuffer<int>(
+      absl::MakeSpan(token_ids), {1, static_cast<int>(token_ids.size())});
+  ExecutorInputs inputs;
+  inputs.SetTextData(ExecutorTextData(std::move(*token_ids_buffer)));
+  return inputs;
+}
+
+TEST(SplitLlmExecutorTest, CreateRejectsInvalidArguments) {
+  EXPECT_THAT(SplitLlmExecutor::Create(
+                  nullptr,
+                  std::make_unique<FakeLlmExecutor>(
+                      kVocabSize, std::vector<std::vector<int>>{},
+                      std::vector<std::vector<int>>{}),
+                  kMinPrefillTokens),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(SplitLlmExecutor::Create(
+                  std::make_unique<FakeLlmExecutor>(
+                      kVocabSize, std::vector<std::vector<int>>{},
+                      std::vector<std::vector<int>>{}),
+                  std::make_unique<FakeLlmExecutor>(
+                      kVocabSize, std::vector<std::vector<int>>{},
+                      std::vector<std::vector<int>>{}),
+                  /*min_prefill_tokens=*/0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(SplitLlmExecutorTest, PrefillsLongPromptsOnThePrefillExecutor) {
+  auto prefill_executor = std::make_unique<FakeLlmExecutor>(
+      kVocabSize, std::vector<std::vector<int>>{{1, 2, 3, 4}},
+      std::vector<std::vector<int>>{});
+  auto decode_executor = std::make_unique<FakeLlmExecutor>(
+      kVocabSize, std::vector<std::vector<int>>{{7, 8}},
+      std::vector<std::vector<int>>{{5}, {6}});
+  FakeLlmExecutor* prefill_executor_ptr = prefill_executor.get();
+  FakeLlmExecutor* decode_executor_ptr = decode_executor.get();
+  ASSERT_OK_AND_ASSIGN(auto executor, SplitLlmExecutor::Create(
+                                          std::move(prefill_executor),
+                                          std::move(decode_executor),
+                                          kMinPrefillTokens));
+
+  EXPECT_OK(executor->Prefill(MakeInputs({1, 2, 3, 4})));
+  EXPECT_EQ(*prefill_executor_ptr->GetCurrentStep(), 4);
+  EXPECT_EQ(*decode_executor_ptr->GetCurrentStep(), 0);
+  EXPECT_EQ(*executor->GetCurrentStep(), 4);
+  EXPECT_EQ(executor->GetNumHandovers(), 0);
+
+  // The first decode hands the context over to the decode executor.
+  LITERT_ASSERT_OK_AND_ASSIGN(auto output_tokens,
+                              CreateTensorBuffer<int>({1, 1}));
+  EXPECT_OK(executor->Decode(output_tokens));
+  EXPECT_EQ(executor->GetNumHandovers(), 1);
+  EXPECT_EQ(*prefill_executor_ptr->GetCurrentStep(), 0);
+  EXPECT_EQ(*decode_executor_ptr->GetCurrentStep(), 5);
+  EXPECT_EQ(*executor->GetCurrentStep(), 5);
+  auto output_tokens_span = ReferTensorBufferAsSpan<int>(output_tokens);
+  EXPECT_EQ((*output_tokens_span)[0], 5);
+
+  // The next turn continues the context on the decode executor, however long
+  // it is.
+  EXPECT_OK(executor->Prefill(MakeInputs({7, 8})));
+  EXPECT_EQ(*decode_executor_ptr->GetCurrentStep(), 7);
+  EXPECT_OK(executor->Decode(output_tokens));
+  EXPECT_EQ(executor->GetNumHandovers(), 1);
+}
+
+TEST(SplitLlmExecutorTest, PrefillsShortPromptsOnTheDecodeExecutor) {
+  auto prefill_executor = std::make_unique<FakeLlmExecutor>(
+      kVocabSize, std::vector<std::vector<int>>{},
+      std::vector<std::vector<int>>{});
+  auto decode_executor = std::make_unique<FakeLlmExecutor>(
+      kVocabSize, std::vector<std::vector<int>>{{1, 2, 3}},
+      std::vector<std::vector<int>>{{5}});
+  FakeLlmExecutor* decode_executor_ptr = decode_executor.get();
+  ASSERT_OK_AND_ASSIGN(auto executor, SplitLlmExecutor::Create(
+                                          std::move(prefill_executor),
+                                          std::move(decode_executor),
+                                          kMinPrefillTokens));
+
+  EXPECT_OK(executor->Prefill(MakeInputs({1, 2, 3})));
+  EXPECT_EQ(*decode_executor_ptr->GetCurrentStep(), 3);
+  LITERT_ASSERT_OK_AND_ASSIGN(auto output_tokens,
+                              CreateTensorBuffer<int>({1, 1}));
+  EXPECT_OK(executor->Decode(output_tokens));
+  EXPECT_EQ(executor->GetNumHandovers(), 0);
+  EXPECT_EQ(*executor->GetCurrentStep(), 4);
+}
+
+TEST(SplitLlmExecutorTest, WarmsUpBothExecutors) {
+  auto prefill_executor = std::make_unique<FakeLlmExecutor>(
+      kVocabSize, std::vector<std::vector<int>>{{1, 2, 3, 4}},
+      std::vector<std::vector<int>>{});
+  auto decode_executor = std::make_unique<FakeLlmExecutor>(
+      kVocabSize, std::vector<std::vector<int>>{},
+      std::vector<std::vector<int>>{{5}});
+  FakeLlmExecutor* prefill_executor_ptr = prefill_executor.get();
+  FakeLlmExecutor* decode_executor_ptr = decode_executor.get();
+  ASSERT_OK_AND_ASSIGN(auto executor, SplitLlmExecutor::Create(
+                                          std::move(prefill_executor),
+                                          std::move(decode_executor),
+                                          kMinPrefillTokens));
+
+  EXPECT_OK(executor->Warmup(/*num_decode_steps=*/3));
+  EXPECT_EQ(prefill_executor_ptr->GetNumWarmupDecodeSteps(), 0);
+  EXPECT_EQ(decode_executor_ptr->GetNumWarmupDecodeSteps(), 3);
+
+  // The warmup does not touch the context, but is refused once there is one.
+  EXPECT_OK(executor->Prefill(MakeInputs({1, 2, 3, 4})));
+  EXPECT_THAT(executor->Warmup(/*num_decode_steps=*/3),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+  LITERT_ASSERT_OK_AND_ASSIGN(auto output_tokens,
+                              CreateTensorBuffer<int>({1, 1}));
+  EXPECT_OK(executor->Decode(output_tokens));
+  EXPECT_EQ(*executor->GetCurrentStep(), 5);
+}
+
+TEST(SplitLlmExecutorTest, ConvertsTheKvCacheLayout) {
+  constexpr int kNumTokens = 8;
+  constexpr int kNumHeads = 2;
+  // [batch, heads, seq, head_dim] on the prefill executor and
+  // [batch, seq, heads, head_dim] on the decode executor.
+  const KvCacheTensorLayout prefill_layout = {{1, kNumHeads, kNumTokens, 1},
+                                              2, 1};
+  const KvCacheTensorLayout decode_layout = {{1, kNumTokens, kNumHeads, 1},
+                                             1, 1};
+  auto prefill_executor = std::make_unique<FakeKvCacheExecutor>(
+      prefill_layout, std::vector<std::vector<int>>{{1, 2, 3, 4}},
+      std::vector<std::vector<int>>{});
+  auto decode_executor = std::make_unique<FakeKvCacheExecutor>(
+      decode_layout, std::vector<std::vector<int>>{},
+      std::vector<std::vector<int>>{{5}});
+  FakeKvCacheExecutor* prefill_executor_ptr = prefill_executor.get();
+  FakeKvCacheExecutor* decode_executor_ptr = decode_executor.get();
+  ASSERT_OK_AND_ASSIGN(auto executor, SplitLlmExecutor::Create(
+                                          std::move(prefill_executor),
+                                          std::move(decode_executor),
+                                          kMinPrefillTokens));
+
+  EXPECT_OK(executor->Prefill(MakeInputs({1, 2, 3, 4})));
+  // The kv-cache written by the prefill, 10 * token + head.
+  for (int head = 0; head < kNumHeads; ++head) {
+    for (int token = 0; token < 4; ++token) {
+      prefill_executor_ptr->kv_cache()[head * kNumTokens + token] =
+          10 * token + head;
+    }
+  }
+  LITERT_ASSERT_OK_AND_ASSIGN(auto output_tokens,
+                              CreateTensorBuffer<int>({1, 1}));
+  EXPECT_OK(executor->Decode(output_tokens));
+  // The last prompt token is pending, so only the first 3 tokens are in the
+  // kv-cache.
+  EXPECT_THAT(decode_executor_ptr->kv_cache(),
+              ElementsAreArray({0, 1, 10, 11, 20, 21, 0, 0, 0, 0, 0, 0, 0,
+                                0, 0, 0}));
+}
+
+}  // namespace
+}  // namespace litert::lm
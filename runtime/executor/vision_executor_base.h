@@ -15,9 +15,11 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_VISION_EXECUTOR_BASE_H_
 #define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_VISION_EXECUTOR_BASE_H_
 
+#include <utility>
 #include <vector>
 
 #include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
 #include "litert/cc/litert_tensor_buffer.h"  // from @litert
 #include "runtime/executor/llm_executor_io_types.h"
 
@@ -37,6 +39,26 @@ class VisionExecutorBase {
   virtual absl::StatusOr<::litert::lm::ExecutorVisionData> Encode(
       const litert::TensorBuffer& input_image_tensor) = 0;
 
+  // Encodes the images of a request, each an image tensor as for Encode(),
+  // and returns the vision data of each image in order. The default encodes
+  // the images one at a time. The encoders with a batch dimension, see
+  // GetExpectedInputDimension(), override it to encode up to that many images
+  // in one invocation.
+  virtual absl::StatusOr<std::vector<::litert::lm::ExecutorVisionData>>
+  EncodeBatch(absl::Span<const litert::TensorBuffer> input_image_tensors) {
+    std::vector<::litert::lm::ExecutorVisionData> vision_data;
+    vision_data.reserve(input_image_tensors.size());
+    for (const litert::TensorBuffer& input_image_tensor :
+         input_image_tensors) {
+      auto image_vision_data = Encode(input_image_tensor);
+      if (!image_vision_data.ok()) {
+        return image_vision_data.status();
+      }
+      vision_data.push_back(*std::move(image_vision_data));
+    }
+    return vision_data;
+  }
+
   // Get the expected input dimension of the vision executor.
   // [batch, height, width, channels]
   virtual absl::StatusOr<std::vector<int>> GetExpectedInputDimension()
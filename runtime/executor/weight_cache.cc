@@ -0,0 +1,179 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/weight_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/memory/memory.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_format.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/util/scoped_file.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// The number of bytes hashed from each end of the model file. Hashing the
+// whole model would cost as much as the cold start the cache saves.
+constexpr int64_t kNumHashedModelBytes = 1 << 20;
+
+// FNV-1a, which unlike absl::Hash is stable across processes.
+class Fnv1aHasher {
+ public:
+  void Update(absl::string_view data) {
+    for (unsigned char c : data) {
+      hash_ = (hash_ ^ c) * 0x100000001b3ULL;
+    }
+  }
+  uint64_t hash() const { return hash_; }
+
+ private:
+  uint64_t hash_ = 0xcbf29ce484222325ULL;
+};
+
+// Returns the key of the cache for the model at `model_path`, from the
+// format version, the options, the model size and both ends of the model.
+absl::StatusOr<std::string> ComputeKey(absl::string_view model_path,
+                                       absl::string_view cache_options) {
+  std::ifstream model(std::string(model_path), std::ios::binary);
+  if (!model.is_open()) {
+    return absl::NotFoundError(
+        absl::StrCat("Failed to open the model file: ", model_path));
+  }
+  model.seekg(0, std::ios::end);
+  const int64_t model_size = model.tellg();
+  Fnv1aHasher hasher;
+  hasher.Update(absl::StrCat(WeightCache::kFormatVersion, "|", cache_options,
+                             "|", model_size, "|"));
+  std::vector<char> buffer(std::min(model_size, kNumHashedModelBytes));
+  for (int64_t offset : {int64_t{0}, model_size - kNumHashedModelBytes}) {
+    model.seekg(std::max<int64_t>(offset, 0));
+    model.read(buffer.data(), buffer.size());
+    if (!model) {
+      return absl::DataLossError(
+          absl::StrCat("Failed to read the model file: ", model_path));
+    }
+    hasher.Update(absl::string_view(buffer.data(), buffer.size()));
+  }
+  return absl::StrFormat("%016x", hasher.hash());
+}
+
+std::string HeaderContents(absl::string_view key) {
+  return absl::StrCat("litert_lm_weight_cache\nversion ",
+                      WeightCache::kFormatVersion, "\nkey ", key, "\n");
+}
+
+bool IsHeaderValid(absl::string_view header_path, absl::string_view key) {
+  std::ifstream header{std::string(header_path)};
+  if (!header.is_open()) {
+    return false;
+  }
+  std::stringstream contents;
+  contents << header.rdbuf();
+  return contents.str() == HeaderContents(key);
+}
+
+}  // namespace
+
+// static
+absl::StatusOr<std::unique_ptr<WeightCache>> WeightCache::Create(
+    const ExecutorSettingsBase& settings, absl::string_view cache_options,
+    absl::string_view suffix) {
+  ASSIGN_OR_RETURN(auto model_path, settings.GetModelAssets().GetPath());
+  ASSIGN_OR_RETURN(std::string key, ComputeKey(model_path, cache_options));
+  ASSIGN_OR_RETURN(auto cache_file,
+                   settings.GetWeightCacheFile(absl::StrCat(".", key, suffix)));
+  if (!std::holds_alternative<std::string>(cache_file)) {
+    return absl::InvalidArgumentError(
+        "The weight cache is given as a file, not a path.");
+  }
+  std::string path = std::get<std::string>(std::move(cache_file));
+  std::string header_path = absl::StrCat(path, ".header");
+  if (IsHeaderValid(header_path, key)) {
+    return absl::WrapUnique(new WeightCache(std::move(path), std::move(key),
+                                            std::move(header_path),
+                                            /*is_valid=*/true, std::nullopt));
+  }
+
+  // The cache is missing or incomplete. Only the process holding the lock
+  // builds it; the lock is released if that process dies.
+  ASSIGN_OR_RETURN(
+      auto lock_file,
+      ScopedFile::OpenOrCreateWritable(absl::StrCat(path, ".lock")));
+  ASSIGN_OR_RETURN(bool locked, lock_file.TryLockExclusive());
+  if (!locked) {
+    ABSL_LOG(INFO) << "The weight cache " << path
+                   << " is being built by another process, running without it.";
+    return absl::WrapUnique(new WeightCache(std::nullopt, std::move(key),
+                                            std::move(header_path),
+                                            /*is_valid=*/false, std::nullopt));
+  }
+  // The header may have been committed between the check and the lock.
+  if (IsHeaderValid(header_path, key)) {
+    return absl::WrapUnique(new WeightCache(std::move(path), std::move(key),
+                                            std::move(header_path),
+                                            /*is_valid=*/true, std::nullopt));
+  }
+  // Whatever is left at the path was written by a process that did not
+  // finish, so the cache is rebuilt from scratch.
+  std::remove(path.c_str());
+  return absl::WrapUnique(new WeightCache(std::move(path), std::move(key),
+                                          std::move(header_path),
+                                          /*is_valid=*/false,
+                                          std::move(lock_file)));
+}
+
+absl::Status WeightCache::Commit() {
+  if (is_valid_ || !lock_file_.has_value()) {
+    return absl::OkStatus();
+  }
+  // Write to a temporary file and rename it, so that no process ever reads a
+  // partial header.
+  const std::string temp_path = absl::StrCat(header_path_, ".tmp");
+  {
+    std::ofstream header(temp_path, std::ios::trunc);
+    header << HeaderContents(key_);
+    if (!header.good()) {
+      return absl::InternalError(
+          absl::StrCat("Failed to write the weight cache header: ", temp_path));
+    }
+  }
+  std::remove(header_path_.c_str());
+  if (std::rename(temp_path.c_str(), header_path_.c_str()) != 0) {
+    return absl::InternalError(absl::StrCat(
+        "Failed to commit the weight cache header: ", header_path_));
+  }
+  is_valid_ = true;
+  lock_file_ = std::nullopt;
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
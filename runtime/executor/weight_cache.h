@@ -0,0 +1,102 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_WEIGHT_CACHE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_WEIGHT_CACHE_H_
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/util/scoped_file.h"
+
+namespace litert::lm {
+
+// WeightCache resolves the weight cache file of an executor and guards it
+// against several processes building it at once.
+//
+// The cache file name carries a key computed from the cache format version,
+// the model file and the backend options, so a cache built for another model
+// or other options is never loaded. A cache file is only trusted once a header
+// file next to it records the same version and key, which Commit() writes
+// atomically after the first successful run. Until then, the first process to
+// lock the cache owns it and builds it from scratch, while the other processes
+// run without a cache instead of reading or writing a partial file.
+//
+// Example usage:
+//
+//   ASSIGN_OR_RETURN(auto weight_cache,
+//                    WeightCache::Create(settings, cache_options,
+//                                        ".xnnpack_cache"));
+//   if (weight_cache->GetPath().has_value()) {
+//     // Hand the path to the delegate.
+//   }
+//   // Compile and run the model.
+//   RETURN_IF_ERROR(weight_cache->Commit());
+class WeightCache {
+ public:
+  // Bump when the layout of the cache files changes.
+  static constexpr int kFormatVersion = 1;
+
+  // Creates a WeightCache for the model of `settings`.
+  // - cache_options: The backend and the options the cache contents depend
+  //   on, e.g. the activation data type.
+  // - suffix: The suffix of the cache file, after the key.
+  // Returns an error if the cache is disabled or the settings do not give a
+  // cache path, e.g. when the cache file is passed as a file descriptor.
+  static absl::StatusOr<std::unique_ptr<WeightCache>> Create(
+      const ExecutorSettingsBase& settings, absl::string_view cache_options,
+      absl::string_view suffix);
+
+  // Returns the path of the cache file, or std::nullopt if this process must
+  // run without the cache because another process is building it.
+  const std::optional<std::string>& GetPath() const { return path_; }
+
+  // Returns the key of the cache as a hex string.
+  const std::string& GetKey() const { return key_; }
+
+  // Returns true if the cache file is complete and can be loaded.
+  bool IsValid() const { return is_valid_; }
+
+  // Records the cache file as complete if this process built it, and releases
+  // the lock on it. A no-op if the cache was already valid or is not owned by
+  // this process.
+  absl::Status Commit();
+
+ private:
+  WeightCache(std::optional<std::string> path, std::string key,
+              std::string header_path, bool is_valid,
+              std::optional<ScopedFile> lock_file)
+      : path_(std::move(path)),
+        key_(std::move(key)),
+        header_path_(std::move(header_path)),
+        is_valid_(is_valid),
+        lock_file_(std::move(lock_file)) {}
+
+  std::optional<std::string> path_;
+  const std::string key_;
+  const std::string header_path_;
+  bool is_valid_;
+  // The locked lock file while this process builds the cache.
+  std::optional<ScopedFile> lock_file_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_EXECUTOR_WEIGHT_CACHE_H_
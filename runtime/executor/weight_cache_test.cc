@@ -0,0 +1,129 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/executor/weight_cache.h"
+
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <optional>
+#include <string>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/executor/llm_executor_settings.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Optional;
+using ::testing::status::StatusIs;
+
+class WeightCacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    cache_dir_ =
+        std::filesystem::path(::testing::TempDir()) /
+        ::testing::UnitTest::GetInstance()->current_test_info()->name();
+    std::filesystem::remove_all(cache_dir_);
+    std::filesystem::create_directories(cache_dir_);
+    model_path_ = (cache_dir_ / "model.tflite").string();
+    WriteModel("model contents");
+  }
+
+  void WriteModel(absl::string_view contents) {
+    std::ofstream model(model_path_, std::ios::binary | std::ios::trunc);
+    model << contents;
+  }
+
+  LlmExecutorSettings CreateSettings() {
+    auto settings = LlmExecutorSettings::CreateDefault(
+        ModelAssets::Create(model_path_).value());
+    settings->SetCacheDir(cache_dir_.string());
+    return *std::move(settings);
+  }
+
+  std::filesystem::path cache_dir_;
+  std::string model_path_;
+};
+
+TEST_F(WeightCacheTest, FirstProcessBuildsAndCommitsCache) {
+  auto settings = CreateSettings();
+  ASSERT_OK_AND_ASSIGN(auto weight_cache,
+                       WeightCache::Create(settings, "cpu", ".xnnpack_cache"));
+  EXPECT_FALSE(weight_cache->IsValid());
+  EXPECT_THAT(weight_cache->GetPath(),
+              Optional(HasSubstr(weight_cache->GetKey())));
+
+  // Another process finds the cache locked and runs without it.
+  ASSERT_OK_AND_ASSIGN(auto other_cache,
+                       WeightCache::Create(settings, "cpu", ".xnnpack_cache"));
+  EXPECT_FALSE(other_cache->IsValid());
+  EXPECT_EQ(other_cache->GetPath(), std::nullopt);
+  EXPECT_OK(other_cache->Commit());
+
+  EXPECT_OK(weight_cache->Commit());
+  EXPECT_TRUE(weight_cache->IsValid());
+  ASSERT_OK_AND_ASSIGN(auto committed_cache,
+                       WeightCache::Create(settings, "cpu", ".xnnpack_cache"));
+  EXPECT_TRUE(committed_cache->IsValid());
+  EXPECT_EQ(committed_cache->GetPath(), weight_cache->GetPath());
+}
+
+TEST_F(WeightCacheTest, KeyDependsOnOptionsAndModel) {
+  auto settings = CreateSettings();
+  ASSERT_OK_AND_ASSIGN(auto cpu_cache,
+                       WeightCache::Create(settings, "cpu", ".xnnpack_cache"));
+  ASSERT_OK_AND_ASSIGN(auto gpu_cache,
+                       WeightCache::Create(settings, "gpu", ".xnnpack_cache"));
+  EXPECT_NE(cpu_cache->GetKey(), gpu_cache->GetKey());
+
+  const std::string key = cpu_cache->GetKey();
+  cpu_cache.reset();
+  WriteModel("other model contents");
+  ASSERT_OK_AND_ASSIGN(cpu_cache,
+                       WeightCache::Create(settings, "cpu", ".xnnpack_cache"));
+  EXPECT_NE(cpu_cache->GetKey(), key);
+}
+
+TEST_F(WeightCacheTest, UncommittedCacheIsRebuilt) {
+  auto settings = CreateSettings();
+  std::string path;
+  {
+    ASSERT_OK_AND_ASSIGN(auto weight_cache, WeightCache::Create(
+                                                settings, "cpu", ".cache"));
+    path = *weight_cache->GetPath();
+    // The process writes a partial cache and dies before committing it.
+    std::ofstream(path) << "partial";
+  }
+  ASSERT_OK_AND_ASSIGN(auto weight_cache,
+                       WeightCache::Create(settings, "cpu", ".cache"));
+  EXPECT_FALSE(weight_cache->IsValid());
+  EXPECT_EQ(weight_cache->GetPath(), path);
+  EXPECT_FALSE(std::filesystem::exists(path));
+}
+
+TEST_F(WeightCacheTest, DisabledCache) {
+  auto settings = CreateSettings();
+  settings.SetCacheDir(":nocache");
+  EXPECT_THAT(WeightCache::Create(settings, "cpu", ".cache"),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
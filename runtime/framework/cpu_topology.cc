@@ -0,0 +1,296 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/framework/cpu_topology.h"
+
+#if defined(__linux__)
+#include <errno.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif  // __linux__
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>  // NOLINT: Required for listing the cores.
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <system_error>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/numbers.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_split.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+// Reads the first line of a sysfs file, or returns false if it cannot be read.
+bool ReadLine(const std::filesystem::path& path, std::string& line) {
+  std::ifstream file(path);
+  if (!file) {
+    return false;
+  }
+  // The file of an empty list is a single newline, or nothing.
+  line.clear();
+  std::getline(file, line);
+  return true;
+}
+
+// Reads a number from a sysfs file, or returns false if it cannot be read.
+bool ReadNumber(const std::filesystem::path& path, int64_t& number) {
+  std::string content;
+  return ReadLine(path, content) && absl::SimpleAtoi(content, &number);
+}
+
+// Parses a list of CPU cores as sysfs writes them, e.g. "0-3,8,10-11", or
+// returns false if it is malformed.
+bool ParseCpuList(absl::string_view cpu_list, std::set<int>& cpus) {
+  for (absl::string_view range :
+       absl::StrSplit(absl::StripAsciiWhitespace(cpu_list), ',',
+                      absl::SkipEmpty())) {
+    std::pair<absl::string_view, absl::string_view> bounds =
+        absl::StrSplit(range, absl::MaxSplits('-', 1));
+    int first;
+    int last;
+    if (!absl::SimpleAtoi(bounds.first, &first) ||
+        !absl::SimpleAtoi(bounds.second.empty() ? bounds.first : bounds.second,
+                          &last) ||
+        first < 0 || last < first) {
+      return false;
+    }
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.insert(cpu);
+    }
+  }
+  return true;
+}
+
+#if defined(__linux__)
+// The memory policy of set_mempolicy(2) preferring a node, from
+// <linux/mempolicy.h>, which the libc headers do not all ship.
+constexpr int kMpolPreferred = 1;
+
+// The number of nodes of the node masks of the memory policies, the
+// MAX_NUMNODES of the largest kernel configurations.
+constexpr int kMaxNumaNodes = 1024;
+constexpr int kBitsPerMaskWord = sizeof(unsigned long) * 8;  // NOLINT
+using NodeMask = std::array<unsigned long,  // NOLINT
+                            kMaxNumaNodes / kBitsPerMaskWord>;
+// The kernel reads one node less than it is told to.
+constexpr unsigned long kMaxNode = kMaxNumaNodes + 1;  // NOLINT
+#endif  // __linux__
+
+}  // namespace
+
+absl::StatusOr<std::vector<CpuCluster>> GetCpuClusters(
+    absl::string_view sysfs_cpu_dir) {
+  std::error_code error;
+  std::filesystem::directory_iterator it(std::string(sysfs_cpu_dir), error);
+  if (error) {
+    return absl::NotFoundError(absl::StrCat("Cannot list the CPU cores in ",
+                                            sysfs_cpu_dir, ": ",
+                                            error.message()));
+  }
+  // The cores by capacity. The cores whose capacity cannot be read, e.g. the
+  // offline ones, are left out.
+  std::map<int64_t, std::set<int>> cpus_by_capacity;
+  for (const auto& entry : it) {
+    const std::string name = entry.path().filename().string();
+    int cpu;
+    if (!absl::StartsWith(name, "cpu") ||
+        !absl::SimpleAtoi(absl::string_view(name).substr(3), &cpu)) {
+      continue;
+    }
+    int64_t capacity;
+    if (ReadNumber(entry.path() / "cpu_capacity", capacity) ||
+        ReadNumber(entry.path() / "cpufreq" / "cpuinfo_max_freq", capacity)) {
+      cpus_by_capacity[capacity].insert(cpu);
+    }
+  }
+  if (cpus_by_capacity.empty()) {
+    return absl::NotFoundError(
+        absl::StrCat("No CPU core is described in ", sysfs_cpu_dir));
+  }
+  std::vector<CpuCluster> clusters;
+  for (auto it = cpus_by_capacity.rbegin(); it != cpus_by_capacity.rend();
+       ++it) {
+    CpuCluster cluster;
+    cluster.capacity = it->first;
+    cluster.cpus = it->second;
+    clusters.push_back(std::move(cluster));
+  }
+  return clusters;
+}
+
+std::set<int> GetPerformanceCores(absl::string_view sysfs_cpu_dir) {
+  absl::StatusOr<std::vector<CpuCluster>> clusters =
+      GetCpuClusters(sysfs_cpu_dir);
+  if (!clusters.ok() || clusters->size() < 2) {
+    return {};
+  }
+  const int64_t max_capacity = clusters->front().capacity;
+  std::set<int> cpus;
+  for (const CpuCluster& cluster : *clusters) {
+    if (cluster.capacity * 2 > max_capacity) {
+      cpus.insert(cluster.cpus.begin(), cluster.cpus.end());
+    }
+  }
+  return cpus;
+}
+
+absl::StatusOr<std::vector<NumaNode>> GetNumaNodes(
+    absl::string_view sysfs_node_dir) {
+  std::error_code error;
+  std::filesystem::directory_iterator it(std::string(sysfs_node_dir), error);
+  if (error) {
+    return absl::NotFoundError(absl::StrCat("Cannot list the NUMA nodes in ",
+                                            sysfs_node_dir, ": ",
+                                            error.message()));
+  }
+  std::map<int, std::set<int>> cpus_by_node;
+  for (const auto& entry : it) {
+    const std::string name = entry.path().filename().string();
+    int node;
+    if (!absl::StartsWith(name, "node") ||
+        !absl::SimpleAtoi(absl::string_view(name).substr(4), &node)) {
+      continue;
+    }
+    std::string cpu_list;
+    std::set<int> cpus;
+    if (ReadLine(entry.path() / "cpulist", cpu_list) &&
+        ParseCpuList(cpu_list, cpus)) {
+      cpus_by_node[node] = std::move(cpus);
+    }
+  }
+  if (cpus_by_node.empty()) {
+    return absl::NotFoundError(
+        absl::StrCat("No NUMA node is described in ", sysfs_node_dir));
+  }
+  std::vector<NumaNode> nodes;
+  for (auto& [id, cpus] : cpus_by_node) {
+    NumaNode node;
+    node.id = id;
+    node.cpus = std::move(cpus);
+    nodes.push_back(std::move(node));
+  }
+  return nodes;
+}
+
+absl::Status BindCurrentThreadToNumaNode(int node,
+                                         absl::string_view sysfs_node_dir) {
+#if defined(__linux__)
+  absl::StatusOr<std::vector<NumaNode>> nodes = GetNumaNodes(sysfs_node_dir);
+  if (!nodes.ok()) {
+    return nodes.status();
+  }
+  auto it = std::find_if(nodes->begin(), nodes->end(),
+                         [node](const NumaNode& n) { return n.id == node; });
+  if (it == nodes->end() || node >= kMaxNumaNodes) {
+    return absl::NotFoundError(
+        absl::StrCat("No NUMA node ", node, " in ", sysfs_node_dir));
+  }
+  if (!it->cpus.empty()) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const int cpu : it->cpus) {
+      if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &cpu_set);
+      }
+    }
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &cpu_set) != 0) {
+      return absl::ErrnoToStatus(
+          errno, absl::StrCat("Cannot pin the thread to NUMA node ", node));
+    }
+  }
+  // Preferred rather than bound, such that an allocation past the memory of
+  // the node falls back to the other nodes instead of failing.
+  NodeMask nodes_mask = {};
+  nodes_mask[node / kBitsPerMaskWord] |= 1ul << (node % kBitsPerMaskWord);
+  if (syscall(SYS_set_mempolicy, kMpolPreferred, nodes_mask.data(),
+              kMaxNode) != 0) {
+    return absl::ErrnoToStatus(
+        errno, absl::StrCat("Cannot set the memory policy of NUMA node ",
+                            node));
+  }
+  return absl::OkStatus();
+#else
+  return absl::UnimplementedError(
+      "NUMA binding is only supported on Linux.");
+#endif  // __linux__
+}
+
+#if defined(__linux__)
+struct ScopedNumaNodeBinding::SavedState {
+  cpu_set_t affinity;
+  int mode = 0;
+  NodeMask nodes_mask = {};
+};
+#else
+struct ScopedNumaNodeBinding::SavedState {};
+#endif  // __linux__
+
+absl::StatusOr<std::unique_ptr<ScopedNumaNodeBinding>>
+ScopedNumaNodeBinding::Create(int node, absl::string_view sysfs_node_dir) {
+#if defined(__linux__)
+  auto saved_state = std::make_unique<SavedState>();
+  if (sched_getaffinity(0, sizeof(cpu_set_t), &saved_state->affinity) != 0 ||
+      syscall(SYS_get_mempolicy, &saved_state->mode,
+              saved_state->nodes_mask.data(), kMaxNode, nullptr, 0) != 0) {
+    return absl::ErrnoToStatus(
+        errno, "Cannot read the affinity and the memory policy of the thread");
+  }
+  // Restores the saved state if the binding fails halfway.
+  std::unique_ptr<ScopedNumaNodeBinding> binding(
+      new ScopedNumaNodeBinding(std::move(saved_state)));
+  absl::Status status = BindCurrentThreadToNumaNode(node, sysfs_node_dir);
+  if (!status.ok()) {
+    return status;
+  }
+  return binding;
+#else
+  return absl::UnimplementedError(
+      "NUMA binding is only supported on Linux.");
+#endif  // __linux__
+}
+
+ScopedNumaNodeBinding::ScopedNumaNodeBinding(
+    std::unique_ptr<SavedState> saved_state)
+    : saved_state_(std::move(saved_state)) {}
+
+ScopedNumaNodeBinding::~ScopedNumaNodeBinding() {
+#if defined(__linux__)
+  if (sched_setaffinity(0, sizeof(cpu_set_t), &saved_state_->affinity) != 0 ||
+      syscall(SYS_set_mempolicy, saved_state_->mode,
+              saved_state_->nodes_mask.data(), kMaxNode) != 0) {
+    ABSL_LOG(WARNING) << "Cannot restore the affinity and the memory policy "
+                         "of the thread: "
+                      << strerror(errno);
+  }
+#endif  // __linux__
+}
+
+}  // namespace litert::lm
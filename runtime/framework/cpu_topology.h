@@ -0,0 +1,109 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_LITERT_LM_RUNTIME_FRAMEWORK_CPU_TOPOLOGY_H_
+#define THIRD_PARTY_LITERT_LM_RUNTIME_FRAMEWORK_CPU_TOPOLOGY_H_
+
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// The directory where Linux describes the CPU cores.
+inline constexpr absl::string_view kSysfsCpuDir = "/sys/devices/system/cpu";
+
+// The CPU cores of the same capacity, e.g. the big or the little cores of a
+// big.LITTLE SoC.
+struct CpuCluster {
+  // The relative capacity of the cores, or their max frequency in kHz when
+  // the kernel does not report the capacity.
+  int64_t capacity = 0;
+  std::set<int> cpus;
+};
+
+// Reads the clusters of the CPU cores from sysfs, i.e. from the
+// cpu<N>/cpu_capacity files, or from cpu<N>/cpufreq/cpuinfo_max_freq for the
+// kernels without them. The clusters are sorted by decreasing capacity.
+// Returns NotFoundError if the cores are not described, e.g. on the platforms
+// other than Linux.
+absl::StatusOr<std::vector<CpuCluster>> GetCpuClusters(
+    absl::string_view sysfs_cpu_dir = kSysfsCpuDir);
+
+// Returns the cores of the fastest cluster of a heterogeneous CPU, e.g. the
+// big and prime cores of a big.LITTLE SoC, which are those of more than half
+// the capacity of the fastest core. Returns an empty set if the cores cannot
+// be told apart, i.e. if they are all alike or not described.
+std::set<int> GetPerformanceCores(
+    absl::string_view sysfs_cpu_dir = kSysfsCpuDir);
+
+// The directory where Linux describes the NUMA nodes.
+inline constexpr absl::string_view kSysfsNodeDir = "/sys/devices/system/node";
+
+// A NUMA node, e.g. a socket of a multi-socket server, with its memory and
+// the CPU cores closest to it.
+struct NumaNode {
+  int id = 0;
+  // Empty for the nodes of memory only, e.g. the CXL memory expanders.
+  std::set<int> cpus;
+};
+
+// Reads the NUMA nodes from sysfs, i.e. from the node<N>/cpulist files, e.g.
+// "0-15,32-47". The nodes are sorted by id. Returns NotFoundError if the
+// nodes are not described, e.g. on the kernels without NUMA support or on the
+// platforms other than Linux.
+absl::StatusOr<std::vector<NumaNode>> GetNumaNodes(
+    absl::string_view sysfs_node_dir = kSysfsNodeDir);
+
+// Pins the calling thread to the cores of NUMA node `node`, and makes the
+// memory it first touches from now on, e.g. the buffers it allocates and the
+// pages of the mapped files it faults in, be allocated on the node, or on the
+// others once the node is full. The threads it creates later inherit both.
+// Returns NotFoundError if there is no such node, and UnimplementedError on
+// the platforms other than Linux.
+absl::Status BindCurrentThreadToNumaNode(
+    int node, absl::string_view sysfs_node_dir = kSysfsNodeDir);
+
+// Binds the calling thread to a NUMA node as BindCurrentThreadToNumaNode()
+// does for the lifetime of the object, e.g. while an executor is built, such
+// that its buffers and the threads of its delegates are on the node. The
+// affinity and the memory policy of the thread are restored once destroyed,
+// on the same thread.
+class ScopedNumaNodeBinding {
+ public:
+  static absl::StatusOr<std::unique_ptr<ScopedNumaNodeBinding>> Create(
+      int node, absl::string_view sysfs_node_dir = kSysfsNodeDir);
+
+  ~ScopedNumaNodeBinding();
+
+  ScopedNumaNodeBinding(const ScopedNumaNodeBinding&) = delete;
+  ScopedNumaNodeBinding& operator=(const ScopedNumaNodeBinding&) = delete;
+
+ private:
+  // The saved CPU affinity and memory policy, as the platform defines them.
+  struct SavedState;
+
+  explicit ScopedNumaNodeBinding(std::unique_ptr<SavedState> saved_state);
+
+  std::unique_ptr<SavedState> saved_state_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_LITERT_LM_RUNTIME_FRAMEWORK_CPU_TOPOLOGY_H_
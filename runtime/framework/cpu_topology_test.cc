@@ -0,0 +1,185 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/framework/cpu_topology.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif  // __linux__
+
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT: Required for binding a thread of its own.
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+
+// Writes a fake sysfs file under a fresh directory of the test.
+class CpuTopologyTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    sysfs_cpu_dir_ = std::filesystem::path(::testing::TempDir()) /
+                     ::testing::UnitTest::GetInstance()
+                         ->current_test_info()
+                         ->name();
+    std::filesystem::remove_all(sysfs_cpu_dir_);
+    std::filesystem::create_directories(sysfs_cpu_dir_);
+  }
+
+  void WriteFile(const std::string& relative_path,
+                 const std::string& content) {
+    const std::filesystem::path path = sysfs_cpu_dir_ / relative_path;
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path) << content;
+  }
+
+  std::string sysfs_cpu_dir() const { return sysfs_cpu_dir_.string(); }
+
+ private:
+  std::filesystem::path sysfs_cpu_dir_;
+};
+
+TEST_F(CpuTopologyTest, ReadsTheClustersByCapacity) {
+  WriteFile("cpu0/cpu_capacity", "325\n");
+  WriteFile("cpu1/cpu_capacity", "325\n");
+  WriteFile("cpu2/cpu_capacity", "871\n");
+  WriteFile("cpu3/cpu_capacity", "1024\n");
+  // Not a core.
+  WriteFile("cpufreq/policy0/scaling_max_freq", "1800000\n");
+
+  auto clusters = GetCpuClusters(sysfs_cpu_dir());
+  ASSERT_TRUE(clusters.ok());
+  ASSERT_EQ(clusters->size(), 3);
+  EXPECT_EQ((*clusters)[0].capacity, 1024);
+  EXPECT_THAT((*clusters)[0].cpus, ElementsAre(3));
+  EXPECT_EQ((*clusters)[1].capacity, 871);
+  EXPECT_THAT((*clusters)[1].cpus, ElementsAre(2));
+  EXPECT_EQ((*clusters)[2].capacity, 325);
+  EXPECT_THAT((*clusters)[2].cpus, ElementsAre(0, 1));
+  // The prime and big cores.
+  EXPECT_THAT(GetPerformanceCores(sysfs_cpu_dir()), ElementsAre(2, 3));
+}
+
+TEST_F(CpuTopologyTest, FallsBackToTheMaxFrequency) {
+  WriteFile("cpu0/cpufreq/cpuinfo_max_freq", "1200000\n");
+  WriteFile("cpu1/cpufreq/cpuinfo_max_freq", "2800000\n");
+  // An offline core.
+  WriteFile("cpu2/online", "0\n");
+  EXPECT_THAT(GetPerformanceCores(sysfs_cpu_dir()), ElementsAre(1));
+}
+
+TEST_F(CpuTopologyTest, NoPerformanceCoresWhenTheCoresAreAlike) {
+  WriteFile("cpu0/cpu_capacity", "1024\n");
+  WriteFile("cpu1/cpu_capacity", "1024\n");
+  EXPECT_THAT(GetPerformanceCores(sysfs_cpu_dir()), IsEmpty());
+}
+
+TEST_F(CpuTopologyTest, NotFoundWithoutTheCores) {
+  EXPECT_EQ(GetCpuClusters(sysfs_cpu_dir()).status().code(),
+            absl::StatusCode::kNotFound);
+  EXPECT_EQ(GetCpuClusters(sysfs_cpu_dir() + "/missing").status().code(),
+            absl::StatusCode::kNotFound);
+  EXPECT_THAT(GetPerformanceCores(sysfs_cpu_dir()), IsEmpty());
+}
+
+TEST_F(CpuTopologyTest, ReadsTheNumaNodes) {
+  WriteFile("node1/cpulist", "8-11,24-27\n");
+  WriteFile("node0/cpulist", "0-3,16-19\n");
+  // A node of memory only.
+  WriteFile("node2/cpulist", "\n");
+  // Not a node.
+  WriteFile("possible", "0-2\n");
+  WriteFile("node3/meminfo", "Node 3 MemTotal: 0 kB\n");
+
+  auto nodes = GetNumaNodes(sysfs_cpu_dir());
+  ASSERT_TRUE(nodes.ok());
+  ASSERT_EQ(nodes->size(), 3);
+  EXPECT_EQ((*nodes)[0].id, 0);
+  EXPECT_THAT((*nodes)[0].cpus, ElementsAre(0, 1, 2, 3, 16, 17, 18, 19));
+  EXPECT_EQ((*nodes)[1].id, 1);
+  EXPECT_THAT((*nodes)[1].cpus, ElementsAre(8, 9, 10, 11, 24, 25, 26, 27));
+  EXPECT_EQ((*nodes)[2].id, 2);
+  EXPECT_THAT((*nodes)[2].cpus, IsEmpty());
+}
+
+TEST_F(CpuTopologyTest, SkipsTheMalformedNumaNodes) {
+  WriteFile("node0/cpulist", "0,2\n");
+  WriteFile("node1/cpulist", "5-3\n");
+  WriteFile("node2/cpulist", "a-b\n");
+
+  auto nodes = GetNumaNodes(sysfs_cpu_dir());
+  ASSERT_TRUE(nodes.ok());
+  ASSERT_EQ(nodes->size(), 1);
+  EXPECT_THAT((*nodes)[0].cpus, ElementsAre(0, 2));
+}
+
+TEST_F(CpuTopologyTest, NotFoundWithoutTheNumaNodes) {
+  EXPECT_EQ(GetNumaNodes(sysfs_cpu_dir()).status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+#if defined(__linux__)
+TEST_F(CpuTopologyTest, NotFoundWithoutTheNumaNodeToBindTo) {
+  WriteFile("node0/cpulist", "0\n");
+  EXPECT_EQ(BindCurrentThreadToNumaNode(1, sysfs_cpu_dir()).code(),
+            absl::StatusCode::kNotFound);
+  EXPECT_EQ(ScopedNumaNodeBinding::Create(1, sysfs_cpu_dir()).status().code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST(ScopedNumaNodeBindingTest, BindsTheThreadToTheNodeUntilDestroyed) {
+  auto nodes = GetNumaNodes();
+  if (!nodes.ok() || nodes->front().cpus.empty()) {
+    GTEST_SKIP() << "No NUMA node of CPU cores here.";
+  }
+  // On a thread of its own, not to leave the test runner bound if it fails.
+  std::thread([&]() {
+    cpu_set_t affinity;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set_t), &affinity), 0);
+    {
+      absl::StatusOr<std::unique_ptr<ScopedNumaNodeBinding>> binding =
+          ScopedNumaNodeBinding::Create(nodes->front().id);
+      if (absl::IsPermissionDenied(binding.status())) {
+        // E.g. in a sandbox blocking set_mempolicy.
+        return;
+      }
+      ASSERT_TRUE(binding.ok()) << binding.status();
+      cpu_set_t bound_affinity;
+      ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set_t), &bound_affinity), 0);
+      for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        EXPECT_EQ(CPU_ISSET(cpu, &bound_affinity) != 0,
+                  nodes->front().cpus.contains(cpu) &&
+                      CPU_ISSET(cpu, &affinity) != 0)
+            << cpu;
+      }
+    }
+    cpu_set_t restored_affinity;
+    ASSERT_EQ(sched_getaffinity(0, sizeof(cpu_set_t), &restored_affinity), 0);
+    EXPECT_TRUE(CPU_EQUAL(&restored_affinity, &affinity));
+  }).join();
+}
+#endif  // __linux__
+
+}  // namespace
+}  // namespace litert::lm
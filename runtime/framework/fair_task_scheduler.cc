@@ -0,0 +1,202 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/framework/fair_task_scheduler.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <utility>
+
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "runtime/framework/thread_options.h"
+
+namespace litert::lm {
+
+absl::StatusOr<FairTaskScheduler::FlowId> FairTaskScheduler::AddFlow(
+    absl::string_view tenant, double weight) {
+  if (!(weight > 0.0)) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("The weight must be positive, got ", weight, "."));
+  }
+  absl::MutexLock lock(&mutex_);
+  if (!tenant.empty()) {
+    if (auto it = tenant_flows_.find(tenant); it != tenant_flows_.end()) {
+      ++flows_[it->second].num_users;
+      return it->second;
+    }
+  }
+  const FlowId flow_id = next_flow_id_++;
+  Flow& flow = flows_[flow_id];
+  flow.tenant = std::string(tenant);
+  flow.weight = weight;
+  flow.virtual_time = virtual_time_;
+  if (!tenant.empty()) {
+    tenant_flows_[tenant] = flow_id;
+  }
+  return flow_id;
+}
+
+void FairTaskScheduler::RemoveFlow(FlowId flow) {
+  absl::MutexLock lock(&mutex_);
+  auto it = flows_.find(flow);
+  if (it == flows_.end()) {
+    return;
+  }
+  --it->second.num_users;
+  MaybeRemoveFlow(flow);
+}
+
+absl::Status FairTaskScheduler::Schedule(FlowId flow, TaskPriority priority,
+                                         absl::AnyInvocable<void() &&> task) {
+  int64_t sequence_number = 0;
+  {
+    absl::MutexLock lock(&mutex_);
+    auto it = flows_.find(flow);
+    if (it == flows_.end()) {
+      return absl::NotFoundError(absl::StrCat("Unknown flow ", flow, "."));
+    }
+    sequence_number = next_sequence_number_++;
+    if (it->second.tasks.empty()) {
+      // The flow does not save up the virtual time it was idle for.
+      it->second.virtual_time =
+          std::max(it->second.virtual_time, virtual_time_);
+    }
+    it->second.tasks.push_back(QueuedTask{
+        .task = std::move(task),
+        .priority = priority,
+        .sequence_number = sequence_number,
+    });
+  }
+  absl::Status status = thread_pool_.Schedule(
+      [this, priority]() { RunNext(priority); }, priority);
+  if (!status.ok()) {
+    // The task is dropped rather than run by the next task of another flow.
+    absl::MutexLock lock(&mutex_);
+    if (auto it = flows_.find(flow); it != flows_.end()) {
+      std::deque<QueuedTask>& tasks = it->second.tasks;
+      tasks.erase(std::remove_if(tasks.begin(), tasks.end(),
+                                 [sequence_number](const QueuedTask& queued) {
+                                   return queued.sequence_number ==
+                                          sequence_number;
+                                 }),
+                  tasks.end());
+      MaybeRemoveFlow(flow);
+    }
+  }
+  return status;
+}
+
+void FairTaskScheduler::Charge(FlowId flow, double cost) {
+  absl::MutexLock lock(&mutex_);
+  if (auto it = flows_.find(flow); it != flows_.end() && cost > 0.0) {
+    it->second.virtual_time += cost / it->second.weight;
+  }
+}
+
+absl::StatusOr<double> FairTaskScheduler::GetVirtualTime(FlowId flow) const {
+  absl::MutexLock lock(&mutex_);
+  auto it = flows_.find(flow);
+  if (it == flows_.end()) {
+    return absl::NotFoundError(absl::StrCat("Unknown flow ", flow, "."));
+  }
+  return it->second.virtual_time;
+}
+
+bool FairTaskScheduler::TryStartInlineTask(FlowId flow) {
+  absl::MutexLock lock(&mutex_);
+  auto it = flows_.find(flow);
+  if (it == flows_.end()) {
+    return false;
+  }
+  for (const auto& [flow_id, queued_flow] : flows_) {
+    if (!queued_flow.tasks.empty()) {
+      return false;
+    }
+  }
+  if (!thread_pool_.TryStartInlineTask()) {
+    return false;
+  }
+  // The flow catches up as if its task was scheduled and picked.
+  it->second.virtual_time = std::max(it->second.virtual_time, virtual_time_);
+  virtual_time_ = it->second.virtual_time;
+  return true;
+}
+
+void FairTaskScheduler::RunNext(TaskPriority priority) {
+  absl::AnyInvocable<void() &&> task;
+  FlowId next_flow = 0;
+  {
+    absl::MutexLock lock(&mutex_);
+    // The flows with a task of `priority` go first, then by virtual time, then
+    // by the order their first tasks were scheduled in.
+    const Flow* picked = nullptr;
+    bool picked_has_priority = false;
+    for (const auto& [flow_id, flow] : flows_) {
+      if (flow.tasks.empty()) {
+        continue;
+      }
+      const bool has_priority =
+          std::any_of(flow.tasks.begin(), flow.tasks.end(),
+                      [priority](const QueuedTask& queued_task) {
+                        return queued_task.priority == priority;
+                      });
+      if (picked != nullptr) {
+        if (picked_has_priority != has_priority) {
+          if (picked_has_priority) {
+            continue;
+          }
+        } else if (flow.virtual_time > picked->virtual_time ||
+                   (flow.virtual_time == picked->virtual_time &&
+                    flow.tasks.front().sequence_number >
+                        picked->tasks.front().sequence_number)) {
+          continue;
+        }
+      }
+      picked = &flow;
+      picked_has_priority = has_priority;
+      next_flow = flow_id;
+    }
+    if (picked == nullptr) {
+      return;
+    }
+    Flow& flow = flows_[next_flow];
+    task = std::move(flow.tasks.front().task);
+    flow.tasks.pop_front();
+    virtual_time_ = flow.virtual_time;
+  }
+  std::move(task)();
+  absl::MutexLock lock(&mutex_);
+  MaybeRemoveFlow(next_flow);
+}
+
+void FairTaskScheduler::MaybeRemoveFlow(FlowId flow) {
+  auto it = flows_.find(flow);
+  if (it == flows_.end() || it->second.num_users > 0 ||
+      !it->second.tasks.empty()) {
+    return;
+  }
+  if (!it->second.tenant.empty()) {
+    tenant_flows_.erase(it->second.tenant);
+  }
+  flows_.erase(it);
+}
+
+}  // namespace litert::lm
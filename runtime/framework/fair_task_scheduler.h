@@ -0,0 +1,182 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_FRAMEWORK_FAIR_TASK_SCHEDULER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_FRAMEWORK_FAIR_TASK_SCHEDULER_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "absl/base/nullability.h"  // from @com_google_absl
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/framework/thread_options.h"
+#include "runtime/framework/threadpool.h"
+
+namespace litert::lm {
+
+// Shares the single thread of a ThreadPool among flows of tasks, e.g. the
+// sessions of an executor, by weighted fair queuing over the cost of their
+// tasks, e.g. the tokens they prefill and decode. Without it, a flow
+// scheduling many long tasks delays the tasks of all the others by as much.
+//
+// The scheduling is start-time fair queuing:
+// - Each flow has a virtual time, advanced by the cost of its tasks divided
+//   by its weight, see Charge().
+// - The next task run is the first one of the flow with the least virtual
+//   time. A flow of twice the weight of another runs twice the cost in the
+//   same time while both have tasks queued.
+// - A flow with no task queued does not save up virtual time: it catches up
+//   with the flow last run once it queues a task again.
+//
+// The tasks of a flow run in the order they are scheduled. Among the flows,
+// the tasks of a higher priority class still run first, as on the ThreadPool.
+// The tasks being picked as they start rather than as they are scheduled, a
+// long task is not preempted, but the next tasks of its flow wait for those
+// of the others.
+//
+// Example usage:
+//
+//   FairTaskScheduler scheduler(&worker_thread_pool);
+//   ASSIGN_OR_RETURN(FlowId flow, scheduler.AddFlow(/*tenant=*/"", 2.0));
+//   RETURN_IF_ERROR(scheduler.Schedule(flow, TaskPriority::kNormal, [&]() {
+//     scheduler.Charge(flow, Prefill(tokens));
+//   }));
+//
+// Thread-safe.
+class FairTaskScheduler {
+ public:
+  using FlowId = int64_t;
+
+  // Schedules the tasks on `thread_pool`, which must have a single thread and
+  // outlive the scheduler.
+  explicit FairTaskScheduler(ThreadPool* absl_nonnull thread_pool)
+      : thread_pool_(*thread_pool) {}
+
+  // Adds a flow of `weight` and returns its id. All the callers of the same
+  // non-empty `tenant` share one flow, whose weight is the one of the first
+  // caller.
+  // Returns InvalidArgumentError if `weight` is not positive.
+  absl::StatusOr<FlowId> AddFlow(absl::string_view tenant, double weight);
+
+  // Releases a flow returned by AddFlow(). The flow is removed once all its
+  // callers released it, after its last queued task.
+  void RemoveFlow(FlowId flow);
+
+  // Queues `task` in `flow`, and schedules its run with `priority` on the
+  // thread pool.
+  absl::Status Schedule(FlowId flow, TaskPriority priority,
+                        absl::AnyInvocable<void() &&> task);
+
+  // Like Schedule(), but returns the future of the result of the task, as
+  // ThreadPool::Submit() does.
+  template <typename Task, typename T = std::invoke_result_t<Task&&>>
+  absl::StatusOr<TaskFuture<T>> Submit(FlowId flow, TaskPriority priority,
+                                       Task task) {
+    auto state = std::make_shared<typename TaskFuture<T>::State>();
+    state->spin_duration = thread_pool_.spin_duration();
+    absl::Status status = Schedule(
+        flow, priority, [task = std::move(task), state]() mutable {
+          state->SetResult(std::move(task)());
+        });
+    if (!status.ok()) {
+      return status;
+    }
+    return TaskFuture<T>(std::move(state));
+  }
+
+  // Like Submit() followed by TaskFuture::Get(`timeout`), but runs `task` on
+  // the calling thread if the thread pool runs the tasks inline and neither
+  // it nor the scheduler has a task queued or running, see
+  // ThreadPool::SubmitAndWait().
+  template <typename Task, typename T = std::invoke_result_t<Task&&>>
+  T SubmitAndWait(FlowId flow, TaskPriority priority, Task task,
+                  absl::Duration timeout) {
+    if (TryStartInlineTask(flow)) {
+      T result = std::move(task)();
+      thread_pool_.FinishInlineTask();
+      return result;
+    }
+    auto future = Submit(flow, priority, std::move(task));
+    if (!future.ok()) {
+      return future.status();
+    }
+    return future->Get(timeout);
+  }
+
+  // Advances the virtual time of `flow` by `cost`, e.g. the tokens processed
+  // by its running task, divided by its weight. Called by the task itself,
+  // before it returns, such that the next task is picked with its cost.
+  void Charge(FlowId flow, double cost);
+
+  // Returns the virtual time of `flow`, or NotFoundError if it is unknown.
+  absl::StatusOr<double> GetVirtualTime(FlowId flow) const;
+
+ private:
+  struct QueuedTask {
+    absl::AnyInvocable<void() &&> task;
+    TaskPriority priority;
+    // The order the task was scheduled in, breaking the ties between the
+    // flows of the same virtual time.
+    int64_t sequence_number;
+  };
+
+  struct Flow {
+    std::string tenant;
+    double weight = 1.0;
+    double virtual_time = 0.0;
+    // The callers of AddFlow() which did not release it yet.
+    int num_users = 1;
+    std::deque<QueuedTask> tasks;
+  };
+
+  // Starts running a task of `flow` on the calling thread, as RunNext()
+  // would, if the thread pool allows it and no task is queued, and returns
+  // whether it did.
+  bool TryStartInlineTask(FlowId flow);
+
+  // Runs the first task of the flow of the least virtual time among those
+  // with a queued task of `priority`, or among all of them if none has. Runs
+  // once per scheduled task on the thread pool.
+  void RunNext(TaskPriority priority);
+
+  // Removes `flow` if it is released and has no queued task.
+  void MaybeRemoveFlow(FlowId flow) ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  ThreadPool& thread_pool_;
+
+  mutable absl::Mutex mutex_;
+  FlowId next_flow_id_ ABSL_GUARDED_BY(mutex_) = 0;
+  int64_t next_sequence_number_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::flat_hash_map<FlowId, Flow> flows_ ABSL_GUARDED_BY(mutex_);
+  absl::flat_hash_map<std::string, FlowId> tenant_flows_
+      ABSL_GUARDED_BY(mutex_);
+  // The virtual time of the flow last run, which the flows queuing a task
+  // again catch up with.
+  double virtual_time_ ABSL_GUARDED_BY(mutex_) = 0.0;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_FRAMEWORK_FAIR_TASK_SCHEDULER_H_
@@ -0,0 +1,201 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/framework/fair_task_scheduler.h"
+
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/framework/thread_options.h"
+#include "runtime/framework/threadpool.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::status::IsOkAndHolds;
+using ::testing::status::StatusIs;
+using FlowId = FairTaskScheduler::FlowId;
+
+class FairTaskSchedulerTest : public testing::Test {
+ protected:
+  // Keeps the thread busy until Release(), such that the tasks scheduled
+  // meanwhile are all queued when the first one is picked.
+  void Block() {
+    ASSERT_OK(thread_pool_.Schedule(
+        [this]() { released_.WaitForNotification(); }));
+  }
+
+  void Release() { released_.Notify(); }
+
+  // Schedules a task of `flow` logging `name` and costing `cost`.
+  void Schedule(FlowId flow, const std::string& name, double cost = 1.0,
+                TaskPriority priority = TaskPriority::kNormal) {
+    ASSERT_OK(scheduler_.Schedule(flow, priority, [this, flow, name, cost]() {
+      log_.push_back(name);
+      scheduler_.Charge(flow, cost);
+    }));
+  }
+
+  std::string RunAndGetLog() {
+    Release();
+    EXPECT_OK(thread_pool_.WaitUntilDone(absl::Seconds(10)));
+    return absl::StrJoin(log_, "");
+  }
+
+  ThreadPool thread_pool_{"fair", /*max_num_threads=*/1};
+  FairTaskScheduler scheduler_{&thread_pool_};
+  absl::Notification released_;
+  std::vector<std::string> log_;
+};
+
+TEST_F(FairTaskSchedulerTest, AddFlowRejectsNonPositiveWeights) {
+  EXPECT_THAT(scheduler_.AddFlow("", 0.0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  EXPECT_THAT(scheduler_.AddFlow("", -1.0),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST_F(FairTaskSchedulerTest, RunsTheTasksOfAFlowInOrder) {
+  ASSERT_OK_AND_ASSIGN(FlowId flow, scheduler_.AddFlow("", 1.0));
+  Block();
+  for (const char* name : {"a", "b", "c", "d"}) {
+    Schedule(flow, name, /*cost=*/0.0);
+  }
+  EXPECT_EQ(RunAndGetLog(), "abcd");
+}
+
+TEST_F(FairTaskSchedulerTest, SharesTheCostByWeight) {
+  ASSERT_OK_AND_ASSIGN(FlowId light_flow, scheduler_.AddFlow("", 1.0));
+  ASSERT_OK_AND_ASSIGN(FlowId heavy_flow, scheduler_.AddFlow("", 2.0));
+  Block();
+  for (int i = 0; i < 6; ++i) {
+    Schedule(light_flow, "l");
+  }
+  for (int i = 0; i < 6; ++i) {
+    Schedule(heavy_flow, "h");
+  }
+  // The heavy flow runs two tasks for each task of the light one, until it
+  // has none left.
+  EXPECT_EQ(RunAndGetLog(), "lhhlhhlhhlll");
+}
+
+TEST_F(FairTaskSchedulerTest, IdleFlowsDoNotSaveUpVirtualTime) {
+  ASSERT_OK_AND_ASSIGN(FlowId busy_flow, scheduler_.AddFlow("", 1.0));
+  ASSERT_OK_AND_ASSIGN(FlowId idle_flow, scheduler_.AddFlow("", 1.0));
+  Block();
+  for (int i = 0; i < 10; ++i) {
+    Schedule(busy_flow, "b");
+  }
+  EXPECT_EQ(RunAndGetLog(), "bbbbbbbbbb");
+  EXPECT_THAT(scheduler_.GetVirtualTime(busy_flow), IsOkAndHolds(10.0));
+
+  // The idle flow catches up with the start of the last task of the busy
+  // flow, instead of running 10 tasks in a row.
+  log_.clear();
+  absl::Notification released;
+  ASSERT_OK(thread_pool_.Schedule([&]() { released.WaitForNotification(); }));
+  Schedule(busy_flow, "b");
+  Schedule(busy_flow, "b");
+  Schedule(idle_flow, "i");
+  Schedule(idle_flow, "i");
+  released.Notify();
+  EXPECT_OK(thread_pool_.WaitUntilDone(absl::Seconds(10)));
+  EXPECT_EQ(absl::StrJoin(log_, ""), "ibib");
+}
+
+TEST_F(FairTaskSchedulerTest, RunsTheHigherPriorityTasksFirst) {
+  ASSERT_OK_AND_ASSIGN(FlowId normal_flow, scheduler_.AddFlow("", 1.0));
+  ASSERT_OK_AND_ASSIGN(FlowId high_flow, scheduler_.AddFlow("", 1.0));
+  Block();
+  Schedule(normal_flow, "n", /*cost=*/1.0, TaskPriority::kNormal);
+  // Costs more, but still runs first.
+  Schedule(high_flow, "h", /*cost=*/10.0, TaskPriority::kHigh);
+  Schedule(high_flow, "h", /*cost=*/10.0, TaskPriority::kHigh);
+  EXPECT_EQ(RunAndGetLog(), "hhn");
+}
+
+TEST_F(FairTaskSchedulerTest, TheSessionsOfATenantShareAFlow) {
+  ASSERT_OK_AND_ASSIGN(FlowId first_flow, scheduler_.AddFlow("tenant", 1.0));
+  ASSERT_OK_AND_ASSIGN(FlowId second_flow, scheduler_.AddFlow("tenant", 4.0));
+  ASSERT_OK_AND_ASSIGN(FlowId other_flow, scheduler_.AddFlow("other", 1.0));
+  EXPECT_EQ(first_flow, second_flow);
+  EXPECT_NE(first_flow, other_flow);
+  Block();
+  Schedule(first_flow, "t", /*cost=*/2.0);
+  Schedule(second_flow, "t", /*cost=*/2.0);
+  Schedule(other_flow, "o", /*cost=*/1.0);
+  Schedule(other_flow, "o", /*cost=*/1.0);
+  // The tenant keeps the weight of its first session.
+  EXPECT_EQ(RunAndGetLog(), "toot");
+
+  scheduler_.RemoveFlow(first_flow);
+  EXPECT_THAT(scheduler_.GetVirtualTime(second_flow), IsOkAndHolds(4.0));
+  scheduler_.RemoveFlow(second_flow);
+  EXPECT_THAT(scheduler_.GetVirtualTime(second_flow),
+              StatusIs(absl::StatusCode::kNotFound));
+  EXPECT_THAT(scheduler_.Schedule(second_flow, TaskPriority::kNormal, []() {}),
+              StatusIs(absl::StatusCode::kNotFound));
+}
+
+TEST_F(FairTaskSchedulerTest, SubmitReturnsTheResultOfTheTask) {
+  ASSERT_OK_AND_ASSIGN(FlowId flow, scheduler_.AddFlow("", 1.0));
+  ASSERT_OK_AND_ASSIGN(auto future,
+                       scheduler_.Submit(flow, TaskPriority::kNormal, []() {
+                         return absl::StatusOr<int>(42);
+                       }));
+  EXPECT_THAT(future.Get(absl::Seconds(10)), IsOkAndHolds(42));
+}
+
+TEST_F(FairTaskSchedulerTest, SubmitAndWaitRunsInlineWhenIdle) {
+  thread_pool_.SetRunTasksInline(true);
+  ASSERT_OK_AND_ASSIGN(FlowId flow, scheduler_.AddFlow("", 1.0));
+  const std::thread::id caller = std::this_thread::get_id();
+  EXPECT_THAT(scheduler_.SubmitAndWait(
+                  flow, TaskPriority::kNormal,
+                  [&]() -> absl::StatusOr<bool> {
+                    scheduler_.Charge(flow, 3.0);
+                    return std::this_thread::get_id() == caller;
+                  },
+                  absl::Seconds(10)),
+              IsOkAndHolds(true));
+  EXPECT_THAT(scheduler_.GetVirtualTime(flow), IsOkAndHolds(3.0));
+
+  // Behind a running task, it runs on the thread pool instead.
+  Block();
+  std::thread releaser([this]() {
+    absl::SleepFor(absl::Milliseconds(10));
+    Release();
+  });
+  EXPECT_THAT(scheduler_.SubmitAndWait(
+                  flow, TaskPriority::kNormal,
+                  [&]() -> absl::StatusOr<bool> {
+                    return std::this_thread::get_id() == caller;
+                  },
+                  absl::Seconds(10)),
+              IsOkAndHolds(false));
+  releaser.join();
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -17,16 +17,46 @@
 
 #include <stddef.h>
 
+#include <ostream>
 #include <set>
 #include <string>
 
 namespace litert::lm {
 
+// The priority class of a task scheduled on a ThreadPool. The tasks of a
+// higher class run first, and those of the same class in the order they are
+// scheduled.
+enum class TaskPriority {
+  // E.g. the requests of a user waiting for the response.
+  kHigh = 0,
+  kNormal = 1,
+  // E.g. the batch or background work.
+  kLow = 2,
+};
+
+inline constexpr int kNumTaskPriorities = 3;
+
+inline std::ostream& operator<<(std::ostream& os, TaskPriority priority) {
+  switch (priority) {
+    case TaskPriority::kHigh:
+      return os << "HIGH";
+    case TaskPriority::kNormal:
+      return os << "NORMAL";
+    case TaskPriority::kLow:
+      return os << "LOW";
+  }
+  return os << "UNKNOWN";
+}
+
 // Options to configure a thread.  Default values are listed in
 // the field descriptions.
 class ThreadOptions {
  public:
-  ThreadOptions() : stack_size_(0), nice_priority_level_(0) {}
+  ThreadOptions()
+      : stack_size_(0),
+        nice_priority_level_(0),
+        prefer_performance_cores_(false),
+        numa_node_(-1) {}
 
   // Set the thread stack size (in bytes).  Passing stack_size==0 resets
   // the stack size to the default value for the system. The system default
@@ -46,6 +76,23 @@ class ThreadOptions {
     return *this;
   }
 
+  // Pins the threads to the performance cores of a heterogeneous CPU, e.g. the
+  // big cores of a big.LITTLE SoC, when no cpu_set is set. Ignored if the
+  // cores are alike or cannot be told apart.
+  ThreadOptions& set_prefer_performance_cores(bool prefer_performance_cores) {
+    prefer_performance_cores_ = prefer_performance_cores;
+    return *this;
+  }
+
+  // Binds the threads to NUMA node `numa_node` of a multi-socket server: they
+  // are pinned to its cores when no cpu_set is set, and the memory they first
+  // touch is allocated on it. Takes precedence over
+  // prefer_performance_cores. A negative node, the default, binds none.
+  ThreadOptions& set_numa_node(int numa_node) {
+    numa_node_ = numa_node;
+    return *this;
+  }
+
   ThreadOptions& set_name_prefix(const std::string& name_prefix) {
     name_prefix_ = name_prefix;
     return *this;
@@ -57,12 +104,18 @@ class ThreadOptions {
 
   const std::set<int>& cpu_set() const { return cpu_set_; }
 
+  bool prefer_performance_cores() const { return prefer_performance_cores_; }
+
+  int numa_node() const { return numa_node_; }
+
   std::string name_prefix() const { return name_prefix_; }
 
  private:
   size_t stack_size_;        // Size of thread stack
   int nice_priority_level_;  // Nice priority level of the workers
   std::set<int> cpu_set_;    // CPU set for affinity setting
+  bool prefer_performance_cores_;  // Whether to pin to the performance cores
+  int numa_node_;            // NUMA node to bind to, or -1
   std::string name_prefix_;  // Name of the thread
 };
 
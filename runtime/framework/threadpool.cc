@@ -15,8 +15,11 @@
 #include "runtime/framework/threadpool.h"
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <atomic>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -65,7 +68,8 @@ ThreadPool::~ThreadPool() {
   ABSL_LOG(INFO) << "ThreadPool '" << name_prefix_ << "': Shutdown complete. ";
 }
 
-absl::Status ThreadPool::Schedule(absl::AnyInvocable<void() &&> callback) {
+absl::Status ThreadPool::Schedule(absl::AnyInvocable<void() &&> callback,
+                                  TaskPriority priority) {
   absl::MutexLock lock(&mutex_);
   if (stopped_) {
     ABSL_LOG(WARNING) << "ThreadPool '" << name_prefix_
@@ -78,7 +82,7 @@ absl::Status ThreadPool::Schedule(absl::AnyInvocable<void() &&> callback) {
   // thread to run the task.
   size_t num_threads = threads_.size();
   if (num_threads < max_num_threads_) {
-    size_t num_tasks = num_active_tasks_ + tasks_.size();
+    size_t num_tasks = num_active_tasks_ + NumPendingTasks();
     if (num_threads <= num_tasks) {
       auto thread = WorkerThread::Create(this, name_prefix_);
       if (thread.ok()) {
@@ -105,24 +109,81 @@ absl::Status ThreadPool::Schedule(absl::AnyInvocable<void() &&> callback) {
     }
   }
 
-  tasks_.push_back(std::move(callback));
+  tasks_[static_cast<int>(priority)].push_back(
+      {std::move(callback), absl::Now(), next_sequence_number_++});
+  num_scheduled_tasks_.fetch_add(1, std::memory_order_release);
   return absl::OkStatus();
 }
 
+bool ThreadPool::TryStartInlineTask() {
+  absl::MutexLock lock(&mutex_);
+  if (!run_tasks_inline_ || stopped_ || max_num_threads_ != 1 ||
+      num_active_tasks_ > 0 || NumPendingTasks() > 0) {
+    return false;
+  }
+  ++num_active_tasks_;
+  ++num_inline_tasks_;
+  return true;
+}
+
+void ThreadPool::FinishInlineTask() {
+  absl::MutexLock lock(&mutex_);
+  --num_inline_tasks_;
+  --num_active_tasks_;
+}
+
+size_t ThreadPool::NumPendingTasks() const {
+  size_t num_tasks = 0;
+  for (const auto& tasks : tasks_) {
+    num_tasks += tasks.size();
+  }
+  return num_tasks;
+}
+
+ThreadPool::Task ThreadPool::PopNextTask() {
+  const absl::Time now = absl::Now();
+  // The front of each class is its earliest task, hence the one aged the
+  // most.
+  int best_priority = -1;
+  int64_t best_rank = 0;
+  for (int priority = 0; priority < kNumTaskPriorities; ++priority) {
+    if (tasks_[priority].empty()) {
+      continue;
+    }
+    const Task& task = tasks_[priority].front();
+    int64_t rank = priority;
+    if (task_aging_period_ != absl::InfiniteDuration()) {
+      rank -= (now - task.schedule_time) / task_aging_period_;
+    }
+    if (best_priority < 0 || rank < best_rank ||
+        (rank == best_rank &&
+         task.sequence_number <
+             tasks_[best_priority].front().sequence_number)) {
+      best_priority = priority;
+      best_rank = rank;
+    }
+  }
+  ABSL_CHECK_GE(best_priority, 0);
+  Task task = std::move(tasks_[best_priority].front());
+  tasks_[best_priority].pop_front();
+  return task;
+}
+
 absl::Status ThreadPool::WaitUntilIdle(absl::Duration timeout) {
   absl::MutexLock lock(&mutex_);
   absl::Time deadline = absl::Now() + timeout;
   // Wait until tasks_ is empty OR the deadline is reached.
   auto is_tasks_empty = [this]() {
     mutex_.AssertHeld();
-    return tasks_.empty();
+    return NumPendingTasks() == 0;
   };
   if (mutex_.AwaitWithDeadline(absl::Condition(&is_tasks_empty), deadline)) {
     return absl::OkStatus();
   }
   return absl::DeadlineExceededError(
       absl::StrCat("Timeout waiting for task queue to become idle in pool '",
-                   name_prefix_, "'. Tasks still in queue: ", tasks_.size()));
+                   name_prefix_,
+                   "'. Tasks still in queue: ", NumPendingTasks()));
 }
 
 absl::Status ThreadPool::WaitUntilDone(absl::Duration timeout) {
@@ -131,36 +192,51 @@ absl::Status ThreadPool::WaitUntilDone(absl::Duration timeout) {
   // Wait until tasks_ is empty OR the deadline is reached.
   auto is_done = [this]() {
     mutex_.AssertHeld();
-    return tasks_.empty() && num_active_tasks_ == 0;
+    return NumPendingTasks() == 0 && num_active_tasks_ == 0;
   };
   if (mutex_.AwaitWithDeadline(absl::Condition(&is_done), deadline)) {
     return absl::OkStatus();
   }
   return absl::DeadlineExceededError(
       absl::StrCat("Timeout waiting for all tasks to be done in pool '",
-                   name_prefix_, "'. Tasks still in queue: ", tasks_.size(),
+                   name_prefix_, "'. Tasks still in queue: ", NumPendingTasks(),
                    ", Active tasks: ", num_active_tasks_));
 }
 
 void ThreadPool::RunWorker() {
   absl::MutexLock lock(&mutex_);
   while (true) {
-    // Wait until a task is available OR the pool is stopped.
+    if (NumPendingTasks() == 0 && !stopped_ &&
+        spin_duration_ > absl::ZeroDuration()) {
+      // Spins with the mutex released, such that a task scheduled meanwhile
+      // is picked up without waking up a blocked thread.
+      const int64_t num_scheduled_tasks =
+          num_scheduled_tasks_.load(std::memory_order_relaxed);
+      const absl::Time spin_deadline = absl::Now() + spin_duration_;
+      mutex_.Unlock();
+      while (num_scheduled_tasks_.load(std::memory_order_acquire) ==
+                 num_scheduled_tasks &&
+             absl::Now() < spin_deadline) {
+        std::this_thread::yield();
+      }
+      mutex_.Lock();
+    }
+    // Wait until a task is available OR the pool is stopped, and no task runs
+    // inline.
     auto is_task_available_or_stopped = [this]() {
       mutex_.AssertHeld();
-      return !tasks_.empty() || stopped_;
+      return (NumPendingTasks() > 0 || stopped_) && num_inline_tasks_ == 0;
     };
     mutex_.Await(absl::Condition(&is_task_available_or_stopped));
 
-    if (tasks_.empty()) {
+    if (NumPendingTasks() == 0) {
       ABSL_CHECK(stopped_);
       ABSL_LOG(INFO) << "ThreadPool '" << name_prefix_
                      << "': Worker thread stopped.";
       return;
     }
 
-    auto task_to_run = std::move(tasks_.front());
-    tasks_.pop_front();
+    auto task_to_run = PopNextTask().callback;
     ++num_active_tasks_;
 
     // Execute the task with mutex released.
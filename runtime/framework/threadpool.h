@@ -15,16 +15,26 @@
 #ifndef THIRD_PARTY_LITERT_LM_RUNTIME_FRAMEWORK_THREADPOOL_H_
 #define THIRD_PARTY_LITERT_LM_RUNTIME_FRAMEWORK_THREADPOOL_H_
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
 #include <deque>
 #include <memory>
+#include <optional>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "absl/base/thread_annotations.h"  // from @com_google_absl
 #include "absl/functional/any_invocable.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
 #include "runtime/framework/thread_options.h"
 
@@ -33,10 +43,86 @@ namespace litert::lm {
 // Forward declaration of WorkerThread to avoid circular dependency.
 class WorkerThread;
 
+// The result of a task submitted to a ThreadPool, which the caller waits for
+// instead of the whole pool. T is absl::Status or an absl::StatusOr, such that
+// the timeout of the wait is reported like the errors of the task.
+//
+// Sample usage:
+//
+//   ASSIGN_OR_RETURN(TaskFuture<absl::Status> future,
+//                    pool.Submit([]() { return DoWork(); }));
+//   RETURN_IF_ERROR(future.Get(absl::Seconds(10)));
+template <typename T>
+class TaskFuture {
+ public:
+  // Waits until the task is done, and returns its result. Returns
+  // DeadlineExceededError if the timeout is reached first. The result is
+  // moved out, so it is only returned once.
+  T Get(absl::Duration timeout) {
+    if (state_->spin_duration > absl::ZeroDuration()) {
+      // Spins before blocking, such that a result set meanwhile is taken
+      // without the wake-up of a blocked thread.
+      const absl::Time spin_deadline =
+          absl::Now() + std::min(state_->spin_duration, timeout);
+      while (!state_->done.load(std::memory_order_acquire) &&
+             absl::Now() < spin_deadline) {
+        std::this_thread::yield();
+      }
+    }
+    absl::MutexLock lock(&state_->mutex);
+    auto is_done = [this]() {
+      state_->mutex.AssertHeld();
+      return state_->result.has_value();
+    };
+    if (!state_->mutex.AwaitWithTimeout(absl::Condition(&is_done), timeout)) {
+      return absl::DeadlineExceededError("Timeout waiting for the task.");
+    }
+    return *std::move(state_->result);
+  }
+
+  // Whether the task is done.
+  bool IsDone() const {
+    absl::MutexLock lock(&state_->mutex);
+    return state_->result.has_value();
+  }
+
+ private:
+  friend class FairTaskScheduler;
+  friend class ThreadPool;
+
+  // The state shared with the task.
+  struct State {
+    absl::Mutex mutex;
+    std::optional<T> result ABSL_GUARDED_BY(mutex);
+    // Set once `result` is, for Get() to spin on.
+    std::atomic<bool> done = false;
+    // How long Get() spins for the result before blocking, see
+    // ThreadPool::SetSpinDuration().
+    absl::Duration spin_duration;
+
+    void SetResult(T new_result) {
+      absl::MutexLock lock(&mutex);
+      result = std::move(new_result);
+      done.store(true, std::memory_order_release);
+    }
+  };
+
+  explicit TaskFuture(std::shared_ptr<State> state)
+      : state_(std::move(state)) {}
+
+  std::shared_ptr<State> state_;
+};
+
 // A thread pool consists of a set of threads that sit around waiting
 // for callbacks to appear on a queue.  When that happens, one of the
 // threads pulls a callback off the queue and runs it.
 //
+// The tasks are run by priority class, see TaskPriority. A task waiting in
+// the queue is promoted by one class every task aging period, such that the
+// low priority tasks are not starved. The tasks of the same class run in the
+// order they are scheduled, so the tasks a caller schedules with the same
+// priority on a pool of a single thread run one after the other in order.
+//
 // The thread pool is shut down when the pool is destroyed.
 //
 // Sample usage:
@@ -61,11 +147,87 @@ class ThreadPool {
   // having called StartWorkers().
   ~ThreadPool();
 
+  // The default period after which a pending task is promoted by one
+  // priority class.
+  static constexpr absl::Duration kDefaultTaskAgingPeriod =
+      absl::Milliseconds(500);
+
   // Adds specified callback to queue of pending callbacks.  Eventually a
   // thread will pull this callback off the queue and execute it. Note that
   // this does not guarantee that the callback is executed in the order it was
-  // scheduled.
-  absl::Status Schedule(absl::AnyInvocable<void() &&> callback);
+  // scheduled, unless the pool has a single thread and the callbacks have the
+  // same priority.
+  absl::Status Schedule(absl::AnyInvocable<void() &&> callback,
+                        TaskPriority priority = TaskPriority::kNormal);
+
+  // Schedules a task like Schedule(), and returns the future of its result,
+  // such that the caller waits for this task only, not for the tasks of the
+  // other callers as with WaitUntilDone(). The task returns absl::Status or
+  // an absl::StatusOr.
+  template <typename Task, typename T = std::invoke_result_t<Task&&>>
+  absl::StatusOr<TaskFuture<T>> Submit(
+      Task task, TaskPriority priority = TaskPriority::kNormal) {
+    auto state = std::make_shared<typename TaskFuture<T>::State>();
+    state->spin_duration = spin_duration();
+    absl::Status status = Schedule(
+        [task = std::move(task), state]() mutable {
+          state->SetResult(std::move(task)());
+        },
+        priority);
+    if (!status.ok()) {
+      return status;
+    }
+    return TaskFuture<T>(std::move(state));
+  }
+
+  // Runs `task` and returns its result, for the callers which would block on
+  // its future right away. If the pool runs the tasks inline, see
+  // SetRunTasksInline(), and has no task queued or running, `task` runs on
+  // the calling thread, sparing the two thread wake-ups of the handoff.
+  // Otherwise it is submitted, and waited for up to `timeout`.
+  template <typename Task, typename T = std::invoke_result_t<Task&&>>
+  T SubmitAndWait(Task task, TaskPriority priority, absl::Duration timeout) {
+    if (TryStartInlineTask()) {
+      T result = std::move(task)();
+      FinishInlineTask();
+      return result;
+    }
+    auto future = Submit(std::move(task), priority);
+    if (!future.ok()) {
+      return future.status();
+    }
+    return future->Get(timeout);
+  }
+
+  // Sets how long the idle worker threads spin for a new task, and the
+  // callers of TaskFuture::Get() for the result of their task, before they
+  // block. Spinning spares the futex wake-ups of a short handoff at the cost of
+  // the CPU time spun. ZeroDuration(), the default, blocks right away.
+  void SetSpinDuration(absl::Duration spin_duration) {
+    absl::MutexLock lock(&mutex_);
+    spin_duration_ = spin_duration;
+  }
+  absl::Duration spin_duration() const {
+    absl::MutexLock lock(&mutex_);
+    return spin_duration_;
+  }
+
+  // Sets whether SubmitAndWait() runs the task on the calling thread when the
+  // pool is idle. Only applies to the pools of a single thread, where the
+  // tasks scheduled while a task runs inline wait for it, such that the tasks
+  // still run one at a time. The inline tasks do not get the thread options
+  // of the pool, e.g. its CPU affinity.
+  void SetRunTasksInline(bool run_tasks_inline) {
+    absl::MutexLock lock(&mutex_);
+    run_tasks_inline_ = run_tasks_inline;
+  }
+
+  // Sets the period after which a pending task is promoted by one priority
+  // class. InfiniteDuration() disables the aging.
+  void SetTaskAgingPeriod(absl::Duration task_aging_period) {
+    absl::MutexLock lock(&mutex_);
+    task_aging_period_ = task_aging_period;
+  }
 
   // Waits until the task queue is empty. The function will return an error if
   // the timeout is reached before the task queue is empty.
@@ -89,10 +251,17 @@ class ThreadPool {
     return threads_.size();
   }
 
+  // Number of tasks waiting in the queue, not counting the running ones.
+  size_t num_pending_tasks() const {
+    absl::MutexLock lock(&mutex_);
+    return NumPendingTasks();
+  }
+
   // Standard thread options.  Use this accessor to get them.
   const ThreadOptions& thread_options() const { return thread_options_; }
 
  private:
+  friend class FairTaskScheduler;
   friend class WorkerThread;
 
   const std::string name_prefix_;
@@ -101,18 +270,52 @@ class ThreadPool {
   // Thread options.
   const ThreadOptions thread_options_;
 
+  // A callback waiting in the queue.
+  struct Task {
+    absl::AnyInvocable<void() &&> callback;
+    absl::Time schedule_time;
+    // The order in which the tasks are scheduled, across the classes.
+    int64_t sequence_number;
+  };
+
   // The main function of the worker thread.
   void RunWorker();
 
+  // Starts running a task on the calling thread, if the pool runs the tasks
+  // inline and is idle, and returns whether it did. Then FinishInlineTask()
+  // must be called once the task is done.
+  bool TryStartInlineTask();
+  void FinishInlineTask();
+
+  // The number of tasks waiting in the queue.
+  size_t NumPendingTasks() const ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Removes and returns the next task to run, i.e. the one of the highest
+  // class after aging, the earliest scheduled among them. The queue must not
+  // be empty.
+  Task PopNextTask() ABSL_EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   mutable absl::Mutex mutex_;
   std::vector<std::unique_ptr<WorkerThread>> threads_ ABSL_GUARDED_BY(mutex_);
   // Whether the pool is stopped.
   bool stopped_ ABSL_GUARDED_BY(mutex_) = false;
-  // The tasks are stored in a queue using the Schedule() method and will be
-  // executed by the threads.
-  std::deque<absl::AnyInvocable<void() &&>> tasks_ ABSL_GUARDED_BY(mutex_);
+  // The tasks are stored in a queue per priority class using the Schedule()
+  // method and will be executed by the threads.
+  std::array<std::deque<Task>, kNumTaskPriorities> tasks_
+      ABSL_GUARDED_BY(mutex_);
+  int64_t next_sequence_number_ ABSL_GUARDED_BY(mutex_) = 0;
+  absl::Duration task_aging_period_ ABSL_GUARDED_BY(mutex_) =
+      kDefaultTaskAgingPeriod;
   // Count the number of active tasks that are being executed by the threads.
   int num_active_tasks_ ABSL_GUARDED_BY(mutex_) = 0;
+  // The tasks among num_active_tasks_ running on the calling thread of
+  // SubmitAndWait(), which the worker threads wait for.
+  int num_inline_tasks_ ABSL_GUARDED_BY(mutex_) = 0;
+  bool run_tasks_inline_ ABSL_GUARDED_BY(mutex_) = false;
+  absl::Duration spin_duration_ ABSL_GUARDED_BY(mutex_);
+  // The number of tasks scheduled so far, read by the spinning worker threads
+  // without locking the mutex.
+  std::atomic<int64_t> num_scheduled_tasks_ = 0;
 };
 
 }  // namespace litert::lm
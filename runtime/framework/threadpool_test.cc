@@ -15,20 +15,29 @@
 #include "runtime/framework/threadpool.h"
 
 #include <atomic>
+#include <cstdint>
 #include <set>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
 #include "absl/time/clock.h"  // from @com_google_absl
 #include "absl/time/time.h"  // from @com_google_absl
 #include "runtime/framework/thread_options.h"
+#include "runtime/framework/work_stealing_threadpool.h"
 #include "runtime/util/test_utils.h"  // NOLINT
 
 namespace litert::lm {
 namespace {
 
+using ::testing::status::IsOkAndHolds;
+
 TEST(ThreadPoolTest, DestroyWithoutStart) {
   ThreadPool thread_pool("testpool", 10);
   EXPECT_EQ(thread_pool.max_num_threads(), 10);
@@ -164,5 +173,215 @@ TEST(ThreadPoolTest, WaitUntilDone) {
   EXPECT_THAT(v, testing::ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9));
 }
 
+TEST(ThreadPoolTest, RunsTheTasksByPriority) {
+  ThreadPool thread_pool("testpool", 1);
+  thread_pool.SetTaskAgingPeriod(absl::InfiniteDuration());
+  // The worker is kept busy until all the tasks are scheduled.
+  absl::Notification scheduled;
+  EXPECT_OK(thread_pool.Schedule([&scheduled]() {
+    scheduled.WaitForNotification();
+  }));
+
+  absl::Mutex mu;
+  std::vector<int> v;
+  auto push_back = [&v, &mu](int i) {
+    return [&v, &mu, i]() {
+      absl::MutexLock l(&mu);
+      v.push_back(i);
+    };
+  };
+  EXPECT_OK(thread_pool.Schedule(push_back(0), TaskPriority::kLow));
+  EXPECT_OK(thread_pool.Schedule(push_back(1), TaskPriority::kNormal));
+  EXPECT_OK(thread_pool.Schedule(push_back(2), TaskPriority::kHigh));
+  EXPECT_OK(thread_pool.Schedule(push_back(3), TaskPriority::kLow));
+  EXPECT_OK(thread_pool.Schedule(push_back(4), TaskPriority::kHigh));
+  scheduled.Notify();
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+  EXPECT_THAT(v, testing::ElementsAre(2, 4, 1, 0, 3));
+}
+
+TEST(ThreadPoolTest, AgingPromotesTheWaitingTasks) {
+  ThreadPool thread_pool("testpool", 1);
+  thread_pool.SetTaskAgingPeriod(absl::Milliseconds(10));
+  absl::Notification scheduled;
+  EXPECT_OK(thread_pool.Schedule([&scheduled]() {
+    scheduled.WaitForNotification();
+  }));
+
+  absl::Mutex mu;
+  std::vector<int> v;
+  auto push_back = [&v, &mu](int i) {
+    return [&v, &mu, i]() {
+      absl::MutexLock l(&mu);
+      v.push_back(i);
+    };
+  };
+  EXPECT_OK(thread_pool.Schedule(push_back(0), TaskPriority::kLow));
+  // The low priority task has waited long enough to run before the high
+  // priority one.
+  absl::SleepFor(absl::Milliseconds(100));
+  EXPECT_OK(thread_pool.Schedule(push_back(1), TaskPriority::kHigh));
+  scheduled.Notify();
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+  EXPECT_THAT(v, testing::ElementsAre(0, 1));
+}
+
+TEST(ThreadPoolTest, CountsThePendingTasks) {
+  ThreadPool thread_pool("testpool", 1);
+  EXPECT_EQ(thread_pool.num_pending_tasks(), 0);
+  absl::Notification started;
+  absl::Notification unblock;
+  EXPECT_OK(thread_pool.Schedule([&started, &unblock]() {
+    started.Notify();
+    unblock.WaitForNotification();
+  }));
+  started.WaitForNotification();
+  // The running task is not pending.
+  EXPECT_EQ(thread_pool.num_pending_tasks(), 0);
+  EXPECT_OK(thread_pool.Schedule([]() {}, TaskPriority::kLow));
+  EXPECT_OK(thread_pool.Schedule([]() {}, TaskPriority::kHigh));
+  EXPECT_EQ(thread_pool.num_pending_tasks(), 2);
+  unblock.Notify();
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+  EXPECT_EQ(thread_pool.num_pending_tasks(), 0);
+}
+
+TEST(ThreadPoolTest, SubmitWaitsForTheTaskOnly) {
+  ThreadPool thread_pool("testpool", 2);
+  absl::Notification unblock;
+  EXPECT_OK(thread_pool.Schedule([&unblock]() {
+    unblock.WaitForNotification();
+  }));
+
+  auto future = thread_pool.Submit([]() -> absl::StatusOr<int> { return 42; });
+  ASSERT_OK(future);
+  // The task is waited for while the other one is still running.
+  EXPECT_THAT(future->Get(absl::Seconds(50)), IsOkAndHolds(42));
+  EXPECT_TRUE(future->IsDone());
+  EXPECT_EQ(thread_pool.WaitUntilDone(absl::Milliseconds(10)).code(),
+            absl::StatusCode::kDeadlineExceeded);
+  unblock.Notify();
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+}
+
+TEST(ThreadPoolTest, SubmitReportsTheTimeoutAsTheResult) {
+  ThreadPool thread_pool("testpool", 1);
+  absl::Notification unblock;
+  auto future = thread_pool.Submit([&unblock]() {
+    unblock.WaitForNotification();
+    return absl::InternalError("Failed.");
+  });
+  ASSERT_OK(future);
+  EXPECT_FALSE(future->IsDone());
+  EXPECT_EQ(future->Get(absl::Milliseconds(10)).code(),
+            absl::StatusCode::kDeadlineExceeded);
+  unblock.Notify();
+  EXPECT_EQ(future->Get(absl::Seconds(50)).code(),
+            absl::StatusCode::kInternal);
+}
+
+TEST(ThreadPoolTest, SpinningPoolRunsTheTasks) {
+  ThreadPool thread_pool("testpool", 1);
+  thread_pool.SetSpinDuration(absl::Milliseconds(1));
+  for (int i = 0; i < 100; ++i) {
+    auto future =
+        thread_pool.Submit([i]() -> absl::StatusOr<int> { return i; });
+    ASSERT_OK(future);
+    EXPECT_THAT(future->Get(absl::Seconds(50)), IsOkAndHolds(i));
+  }
+  // The worker spins for a while, then blocks.
+  absl::SleepFor(absl::Milliseconds(10));
+  auto future = thread_pool.Submit([]() -> absl::StatusOr<int> { return 1; });
+  ASSERT_OK(future);
+  EXPECT_THAT(future->Get(absl::Seconds(50)), IsOkAndHolds(1));
+}
+
+TEST(ThreadPoolTest, SubmitAndWaitRunsInlineWhenIdle) {
+  ThreadPool thread_pool("testpool", 1);
+  const std::thread::id caller_id = std::this_thread::get_id();
+  auto run_on_caller = [&caller_id]() -> absl::StatusOr<bool> {
+    return std::this_thread::get_id() == caller_id;
+  };
+  // Not inline unless asked to.
+  EXPECT_THAT(thread_pool.SubmitAndWait(run_on_caller, TaskPriority::kNormal,
+                                        absl::Seconds(50)),
+              IsOkAndHolds(false));
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+
+  thread_pool.SetRunTasksInline(true);
+  EXPECT_THAT(thread_pool.SubmitAndWait(run_on_caller, TaskPriority::kNormal,
+                                        absl::Seconds(50)),
+              IsOkAndHolds(true));
+
+  // Not inline behind a running task.
+  absl::Notification unblock;
+  EXPECT_OK(thread_pool.Schedule(
+      [&unblock]() { unblock.WaitForNotification(); }));
+  absl::Notification submitted;
+  std::thread caller([&]() {
+    submitted.Notify();
+    EXPECT_THAT(thread_pool.SubmitAndWait(run_on_caller, TaskPriority::kNormal,
+                                          absl::Seconds(50)),
+                IsOkAndHolds(false));
+  });
+  submitted.WaitForNotification();
+  unblock.Notify();
+  caller.join();
+}
+
+TEST(ThreadPoolTest, TasksScheduledDuringAnInlineTaskWaitForIt) {
+  ThreadPool thread_pool("testpool", 1);
+  thread_pool.SetRunTasksInline(true);
+  std::vector<int> order;
+  absl::Mutex order_mutex;
+  auto record = [&](int i) {
+    absl::MutexLock lock(&order_mutex);
+    order.push_back(i);
+  };
+  EXPECT_OK(thread_pool.SubmitAndWait(
+      [&]() -> absl::Status {
+        EXPECT_OK(thread_pool.Schedule([&]() { record(2); }));
+        absl::SleepFor(absl::Milliseconds(20));
+        record(1);
+        return absl::OkStatus();
+      },
+      TaskPriority::kNormal, absl::Seconds(50)));
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+  EXPECT_THAT(order, testing::ElementsAre(1, 2));
+}
+
+// Schedules many short tasks on a pool, and returns the number of tasks run
+// per second.
+template <typename Pool>
+double MeasureThroughput(Pool& pool, int num_tasks) {
+  std::atomic<int64_t> sum = 0;
+  const absl::Time start = absl::Now();
+  for (int i = 0; i < num_tasks; ++i) {
+    EXPECT_OK(pool.Schedule([&sum, i]() {
+      int64_t value = i;
+      for (int j = 0; j < 100; ++j) {
+        value = value * 31 + j;
+      }
+      sum += value & 1;
+    }));
+  }
+  EXPECT_OK(pool.WaitUntilDone(absl::Seconds(100)));
+  return num_tasks / absl::ToDoubleSeconds(absl::Now() - start);
+}
+
+// Compares the throughput of ThreadPool and WorkStealingThreadPool. It only
+// logs the numbers, since they depend on the machine.
+TEST(ThreadPoolTest, ThroughputAgainstWorkStealingThreadPool) {
+  constexpr int kNumThreads = 4;
+  constexpr int kNumTasks = 100000;
+  ThreadPool thread_pool("testpool", kNumThreads);
+  WorkStealingThreadPool work_stealing_thread_pool("testpool", kNumThreads);
+  ABSL_LOG(INFO) << "ThreadPool: "
+                 << MeasureThroughput(thread_pool, kNumTasks) << " tasks/s";
+  ABSL_LOG(INFO) << "WorkStealingThreadPool: "
+                 << MeasureThroughput(work_stealing_thread_pool, kNumTasks)
+                 << " tasks/s";
+}
+
 }  // namespace
 }  // namespace litert::lm
@@ -0,0 +1,176 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/framework/work_stealing_threadpool.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <utility>
+
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/log/absl_check.h"  // from @com_google_absl
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+// The pool and the index of the worker running on the current thread, if any,
+// such that the callbacks it schedules go to its own queue.
+thread_local const WorkStealingThreadPool* current_pool = nullptr;
+thread_local int current_worker_index = -1;
+
+}  // namespace
+
+WorkStealingThreadPool::WorkStealingThreadPool(const std::string& name_prefix,
+                                               size_t num_threads)
+    : name_prefix_(name_prefix) {
+  if (num_threads == 0) {
+    num_threads = 1;
+  }
+  ABSL_LOG(INFO) << "WorkStealingThreadPool '" << name_prefix_
+                 << "': Running " << num_threads << " threads.";
+  queues_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    queues_.push_back(std::make_unique<WorkerQueue>());
+  }
+  threads_.reserve(num_threads);
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads_.emplace_back([this, i]() { RunWorker(i); });
+  }
+}
+
+WorkStealingThreadPool::~WorkStealingThreadPool() {
+  ABSL_LOG(INFO) << "WorkStealingThreadPool '" << name_prefix_
+                 << "': Shutting down...";
+  {
+    absl::MutexLock lock(&mutex_);
+    stopped_ = true;
+    callback_queued_.SignalAll();
+  }
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  ABSL_CHECK_EQ(num_unfinished_callbacks_, 0);
+  ABSL_LOG(INFO) << "WorkStealingThreadPool '" << name_prefix_
+                 << "': Shutdown complete.";
+}
+
+absl::Status WorkStealingThreadPool::Schedule(
+    absl::AnyInvocable<void() &&> callback) {
+  if (stopped_) {
+    ABSL_LOG(WARNING) << "WorkStealingThreadPool '" << name_prefix_
+                      << "': Schedule called on a stopped pool.";
+    return absl::FailedPreconditionError(absl::StrCat(
+        "WorkStealingThreadPool '", name_prefix_, "' is stopped."));
+  }
+  const int queue_index =
+      current_pool == this
+          ? current_worker_index
+          : next_queue_index_.fetch_add(1, std::memory_order_relaxed) %
+                queues_.size();
+  // The counts are raised first, such that they never go below the number of
+  // callbacks in the queues.
+  ++num_unfinished_callbacks_;
+  ++num_queued_callbacks_;
+  {
+    WorkerQueue& queue = *queues_[queue_index];
+    absl::MutexLock lock(&queue.mutex);
+    queue.callbacks.push_back(std::move(callback));
+  }
+  // An idle worker either sees the queued callback before it waits, or one
+  // of them is woken here.
+  if (num_idle_workers_ > 0) {
+    absl::MutexLock lock(&mutex_);
+    callback_queued_.Signal();
+  }
+  return absl::OkStatus();
+}
+
+absl::Status WorkStealingThreadPool::WaitUntilDone(absl::Duration timeout) {
+  absl::MutexLock lock(&mutex_);
+  const absl::Time deadline = absl::Now() + timeout;
+  auto is_done = [this]() { return num_unfinished_callbacks_ == 0; };
+  if (mutex_.AwaitWithDeadline(absl::Condition(&is_done), deadline)) {
+    return absl::OkStatus();
+  }
+  return absl::DeadlineExceededError(absl::StrCat(
+      "Timeout waiting for all tasks to be done in pool '", name_prefix_,
+      "'. Tasks not finished: ", num_unfinished_callbacks_.load()));
+}
+
+void WorkStealingThreadPool::RunWorker(int worker_index) {
+  current_pool = this;
+  current_worker_index = worker_index;
+  while (true) {
+    absl::AnyInvocable<void() &&> callback;
+    if (TakeCallback(worker_index, callback)) {
+      --num_queued_callbacks_;
+      std::move(callback)();
+      if (--num_unfinished_callbacks_ == 0) {
+        WakeDoneWaiters();
+      }
+      continue;
+    }
+
+    absl::MutexLock lock(&mutex_);
+    ++num_idle_workers_;
+    while (num_queued_callbacks_ == 0 && !stopped_) {
+      callback_queued_.Wait(&mutex_);
+    }
+    --num_idle_workers_;
+    if (num_queued_callbacks_ == 0) {
+      ABSL_CHECK(stopped_);
+      ABSL_LOG(INFO) << "WorkStealingThreadPool '" << name_prefix_
+                     << "': Worker thread stopped.";
+      return;
+    }
+  }
+}
+
+bool WorkStealingThreadPool::TakeCallback(
+    int worker_index, absl::AnyInvocable<void() &&>& callback) {
+  {
+    WorkerQueue& queue = *queues_[worker_index];
+    absl::MutexLock lock(&queue.mutex);
+    if (!queue.callbacks.empty()) {
+      callback = std::move(queue.callbacks.back());
+      queue.callbacks.pop_back();
+      return true;
+    }
+  }
+  for (size_t i = 1; i < queues_.size(); ++i) {
+    WorkerQueue& queue = *queues_[(worker_index + i) % queues_.size()];
+    absl::MutexLock lock(&queue.mutex);
+    if (!queue.callbacks.empty()) {
+      callback = std::move(queue.callbacks.front());
+      queue.callbacks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingThreadPool::WakeDoneWaiters() {
+  // Releasing the mutex makes the waiters re-evaluate their conditions.
+  absl::MutexLock lock(&mutex_);
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,124 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_LITERT_LM_RUNTIME_FRAMEWORK_WORK_STEALING_THREADPOOL_H_
+#define THIRD_PARTY_LITERT_LM_RUNTIME_FRAMEWORK_WORK_STEALING_THREADPOOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// A thread pool for many short CPU-bound callbacks, e.g. the tokenization,
+// sampling or embedding gathers split across the cores. Unlike ThreadPool,
+// whose threads share one queue behind one mutex, each worker has its own
+// queue:
+// - The callbacks scheduled from outside the pool are spread across the
+//   queues of the workers in turn.
+// - The callbacks scheduled from a worker go to its own queue, and it runs
+//   the last one first while it is warm in the cache.
+// - A worker whose queue is empty steals the oldest callback of another one.
+// The shared mutex is only taken when a worker runs out of work or the last
+// callback finishes, so the workers rarely contend on it.
+//
+// There is no priority nor ordering between the callbacks. The threads are
+// all started when the pool is created, and the pool runs the pending
+// callbacks before it is destroyed.
+//
+// Sample usage:
+//
+// {
+//   WorkStealingThreadPool pool("sampler", num_threads);
+//   for (int i = 0; i < N; ++i) {
+//     pool.Schedule([i]() { DoWork(i); });
+//   }
+//   RETURN_IF_ERROR(pool.WaitUntilDone(absl::Seconds(10)));
+// }
+//
+class WorkStealingThreadPool {
+ public:
+  // Creates a pool of "num_threads" threads, at least one. "name_prefix"
+  // names the pool in the logs.
+  WorkStealingThreadPool(const std::string& name_prefix, size_t num_threads);
+
+  // Runs the pending callbacks, and joins the threads.
+  ~WorkStealingThreadPool();
+
+  // Adds specified callback to the queues of pending callbacks. Eventually a
+  // thread will run it. The callbacks are not run in the order they are
+  // scheduled.
+  absl::Status Schedule(absl::AnyInvocable<void() &&> callback);
+
+  // Waits until all the scheduled callbacks are executed and finished. The
+  // function will return an error if the timeout is reached before all the
+  // callbacks are finished.
+  absl::Status WaitUntilDone(absl::Duration timeout);
+
+  // Number of threads in the pool.
+  size_t num_threads() const { return threads_.size(); }
+
+ private:
+  // The callbacks of a worker. The owner pushes and pops at the back, and the
+  // other workers steal from the front.
+  struct WorkerQueue {
+    absl::Mutex mutex;
+    std::deque<absl::AnyInvocable<void() &&>> callbacks ABSL_GUARDED_BY(mutex);
+  };
+
+  // The main function of the worker thread of index "worker_index".
+  void RunWorker(int worker_index);
+
+  // Takes a callback from the own queue of the worker, or steals one from the
+  // others. Returns false if all the queues were empty.
+  bool TakeCallback(int worker_index, absl::AnyInvocable<void() &&>& callback);
+
+  // Wakes the threads waiting in WaitUntilDone(), which re-evaluate their
+  // condition when mutex_ is released.
+  void WakeDoneWaiters();
+
+  const std::string name_prefix_;
+
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> threads_;
+
+  // The queue the next callback scheduled from outside the pool goes to.
+  std::atomic<uint32_t> next_queue_index_ = 0;
+  // The callbacks in the queues, and those scheduled and not finished yet.
+  std::atomic<int64_t> num_queued_callbacks_ = 0;
+  std::atomic<int64_t> num_unfinished_callbacks_ = 0;
+  // The workers waiting for callbacks, and whether the pool is stopped.
+  std::atomic<int> num_idle_workers_ = 0;
+  std::atomic<bool> stopped_ = false;
+
+  // Only taken to wait for callbacks, or for all the callbacks to finish.
+  absl::Mutex mutex_;
+  // Signaled for an idle worker when a callback is queued.
+  absl::CondVar callback_queued_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_LITERT_LM_RUNTIME_FRAMEWORK_WORK_STEALING_THREADPOOL_H_
@@ -0,0 +1,88 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/framework/work_stealing_threadpool.h"
+
+#include <atomic>
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/synchronization/notification.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+TEST(WorkStealingThreadPoolTest, AtLeastOneThread) {
+  WorkStealingThreadPool thread_pool("testpool", 0);
+  EXPECT_EQ(thread_pool.num_threads(), 1);
+}
+
+TEST(WorkStealingThreadPoolTest, RunsThePendingTasksWhenDestroyed) {
+  std::atomic<int> n = 1000;
+  {
+    WorkStealingThreadPool thread_pool("testpool", 4);
+    EXPECT_EQ(thread_pool.num_threads(), 4);
+    for (int i = 0; i < 1000; ++i) {
+      EXPECT_OK(thread_pool.Schedule([&n]() { --n; }));
+    }
+  }
+  EXPECT_EQ(n, 0);
+}
+
+TEST(WorkStealingThreadPoolTest, WaitUntilDoneRunsTheNestedTasks) {
+  WorkStealingThreadPool thread_pool("testpool", 4);
+  std::atomic<int> n = 0;
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_OK(thread_pool.Schedule([&thread_pool, &n]() {
+      // The tasks scheduled by a worker go to its own queue, from which the
+      // other workers steal.
+      for (int j = 0; j < 100; ++j) {
+        EXPECT_OK(thread_pool.Schedule([&n]() { ++n; }));
+      }
+    }));
+  }
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+  EXPECT_EQ(n, 1000);
+}
+
+TEST(WorkStealingThreadPoolTest, IdleWorkersStealTheTasksOfABusyOne) {
+  WorkStealingThreadPool thread_pool("testpool", 2);
+  absl::Notification stolen;
+  // The tasks are spread across the 2 queues in turn. The first one blocks
+  // its worker until the second one, queued behind it, is run by the other
+  // worker.
+  EXPECT_OK(thread_pool.Schedule([&stolen]() {
+    EXPECT_TRUE(stolen.WaitForNotificationWithTimeout(absl::Seconds(50)));
+  }));
+  EXPECT_OK(thread_pool.Schedule([]() {}));
+  EXPECT_OK(thread_pool.Schedule([&stolen]() { stolen.Notify(); }));
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+  EXPECT_TRUE(stolen.HasBeenNotified());
+}
+
+TEST(WorkStealingThreadPoolTest, WaitUntilDoneTimesOut) {
+  WorkStealingThreadPool thread_pool("testpool", 1);
+  absl::Notification done;
+  EXPECT_OK(thread_pool.Schedule([&done]() { done.WaitForNotification(); }));
+  EXPECT_EQ(thread_pool.WaitUntilDone(absl::Milliseconds(10)).code(),
+            absl::StatusCode::kDeadlineExceeded);
+  done.Notify();
+  EXPECT_OK(thread_pool.WaitUntilDone(absl::Seconds(50)));
+}
+
+}  // namespace
+}  // namespace litert::lm
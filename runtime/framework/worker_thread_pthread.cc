@@ -31,6 +31,7 @@
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/str_join.h"  // from @com_google_absl
+#include "runtime/framework/cpu_topology.h"
 #include "runtime/framework/thread_options.h"
 #include "runtime/framework/threadpool.h"
 #include "runtime/framework/worker_thread.h"
@@ -99,8 +100,25 @@ void* WorkerThreadPthread::ThreadBody(void* arg) {
   auto thread = reinterpret_cast<WorkerThreadPthread*>(arg);
   int nice_priority_level =
       thread->pool_.thread_options().nice_priority_level();
-  const std::set<int> selected_cpus = thread->pool_.thread_options().cpu_set();
+  std::set<int> selected_cpus = thread->pool_.thread_options().cpu_set();
+  const int numa_node = thread->pool_.thread_options().numa_node();
 #if defined(__linux__)
+  if (numa_node >= 0) {
+    // Pins the thread to the cores of the node, which the cpu_set below
+    // overrides if set.
+    absl::Status status = BindCurrentThreadToNumaNode(numa_node);
+    if (status.ok()) {
+      ABSL_LOG(INFO) << "Bound the thread pool executor to NUMA node "
+                     << numa_node << ".";
+    } else {
+      ABSL_LOG(ERROR) << "Error : " << status << std::endl
+                      << "Failed to bind to NUMA node " << numa_node
+                      << ". Ignore NUMA node setting for now.";
+    }
+  } else if (selected_cpus.empty() &&
+             thread->pool_.thread_options().prefer_performance_cores()) {
+    selected_cpus = GetPerformanceCores();
+  }
   const std::string name =
       CreateThreadName(thread->name_prefix_, syscall(SYS_gettid));
   if (nice_priority_level != 0) {
@@ -137,7 +155,7 @@ void* WorkerThreadPthread::ThreadBody(void* arg) {
   }
 #else
   const std::string name = CreateThreadName(thread->name_prefix_, 0);
-  if (nice_priority_level != 0 || !selected_cpus.empty()) {
+  if (nice_priority_level != 0 || !selected_cpus.empty() || numa_node >= 0) {
     ABSL_LOG(ERROR) << "Thread priority and processor affinity feature aren't "
                        "supported on the current platform.";
   }
@@ -0,0 +1,51 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_BINARY_SERIALIZATION_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_BINARY_SERIALIZATION_H_
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// Helpers of the binary files the runtime writes and reads back on the same
+// device, e.g. the checkpoints, the recordings and the indexes, whose values
+// are stored in the native byte order.
+
+// Appends the bytes of `value` to `out`.
+template <typename T>
+void AppendValue(const T& value, std::string& out) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+// Reads a value from the front of `in`. Returns false if `in` is too short.
+template <typename T>
+bool ConsumeValue(absl::string_view& in, T& value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  if (in.size() < sizeof(T)) {
+    return false;
+  }
+  memcpy(&value, in.data(), sizeof(T));
+  in.remove_prefix(sizeof(T));
+  return true;
+}
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_BINARY_SERIALIZATION_H_
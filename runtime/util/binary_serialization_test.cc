@@ -0,0 +1,57 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/binary_serialization.h"
+
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+TEST(BinarySerializationTest, ConsumesTheAppendedValues) {
+  std::string out;
+  AppendValue<uint32_t>(0x12345678, out);
+  AppendValue<float>(1.5f, out);
+  AppendValue<int8_t>(-3, out);
+  EXPECT_EQ(out.size(), sizeof(uint32_t) + sizeof(float) + sizeof(int8_t));
+
+  absl::string_view in = out;
+  uint32_t u32 = 0;
+  float f = 0;
+  int8_t i8 = 0;
+  ASSERT_TRUE(ConsumeValue(in, u32));
+  ASSERT_TRUE(ConsumeValue(in, f));
+  ASSERT_TRUE(ConsumeValue(in, i8));
+  EXPECT_EQ(u32, 0x12345678);
+  EXPECT_EQ(f, 1.5f);
+  EXPECT_EQ(i8, -3);
+  EXPECT_TRUE(in.empty());
+}
+
+TEST(BinarySerializationTest, KeepsTheInputWhenTooShort) {
+  std::string out;
+  AppendValue<uint16_t>(7, out);
+  absl::string_view in = out;
+  uint32_t value = 42;
+  EXPECT_FALSE(ConsumeValue(in, value));
+  EXPECT_EQ(value, 42);
+  EXPECT_EQ(in.size(), sizeof(uint16_t));
+}
+
+}  // namespace
+}  // namespace litert::lm
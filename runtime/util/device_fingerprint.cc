@@ -0,0 +1,81 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/device_fingerprint.h"
+
+#include <fstream>
+#include <optional>
+#include <string>
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
+
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_join.h"  // from @com_google_absl
+#include "absl/strings/str_replace.h"  // from @com_google_absl
+#include "absl/strings/str_split.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+#if defined(__linux__)
+#include <sys/utsname.h>
+#endif  // defined(__linux__)
+
+namespace litert::lm {
+namespace {
+
+#if defined(__linux__)
+// Returns the value of the first line of /proc/cpuinfo starting with `key`,
+// e.g. "Hardware" on Android or "model name" on x86, or std::nullopt.
+std::optional<std::string> ReadCpuInfo(absl::string_view key) {
+  std::ifstream cpuinfo("/proc/cpuinfo");
+  std::string line;
+  while (std::getline(cpuinfo, line)) {
+    if (!absl::StartsWith(line, key)) {
+      continue;
+    }
+    std::pair<absl::string_view, absl::string_view> field =
+        absl::StrSplit(line, absl::MaxSplits(':', 1));
+    return std::string(absl::StripAsciiWhitespace(field.second));
+  }
+  return std::nullopt;
+}
+#endif  // defined(__linux__)
+
+}  // namespace
+
+std::string GetDeviceFingerprint() {
+  std::vector<std::string> parts;
+#if defined(__linux__)
+  if (struct utsname name; uname(&name) == 0) {
+    parts.push_back(name.sysname);
+    parts.push_back(name.machine);
+    // The drivers of the accelerators come with the system, which the kernel
+    // release changes along with.
+    parts.push_back(name.release);
+  }
+  if (auto hardware = ReadCpuInfo("Hardware"); hardware.has_value()) {
+    parts.push_back(*std::move(hardware));
+  } else if (auto model_name = ReadCpuInfo("model name");
+             model_name.has_value()) {
+    parts.push_back(*std::move(model_name));
+  }
+#endif  // defined(__linux__)
+  parts.push_back(absl::StrCat("cores=", std::thread::hardware_concurrency()));
+  return absl::StrReplaceAll(absl::StrJoin(parts, "|"),
+                             {{"\t", " "}, {"\n", " "}, {"\r", " "}});
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,31 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_DEVICE_FINGERPRINT_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_DEVICE_FINGERPRINT_H_
+
+#include <string>
+
+namespace litert::lm {
+
+// Returns the fingerprint of the device the process runs on, e.g. its CPU
+// model, its number of cores and its kernel release, which the measurements
+// cached on the disk, e.g. the selected backend or the prefill costs, are only
+// valid for. It holds no tab nor line break, so it fits on a field of a line.
+// Best effort, as some platforms tell less.
+std::string GetDeviceFingerprint();
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_DEVICE_FINGERPRINT_H_
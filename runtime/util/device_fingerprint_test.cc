@@ -0,0 +1,33 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/device_fingerprint.h"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+namespace litert::lm {
+namespace {
+
+TEST(DeviceFingerprintTest, FingerprintsTheDevice) {
+  const std::string fingerprint = GetDeviceFingerprint();
+  EXPECT_FALSE(fingerprint.empty());
+  EXPECT_EQ(fingerprint.find('\n'), std::string::npos);
+  EXPECT_EQ(fingerprint.find('\t'), std::string::npos);
+  EXPECT_EQ(GetDeviceFingerprint(), fingerprint);
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,191 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/fake_weights.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/container/flat_hash_set.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "flatbuffers/flatbuffers.h"  // from @flatbuffers
+#include "runtime/executor/executor_settings_base.h"
+#include "tflite/schema/schema_generated.h"  // from @litert
+
+namespace litert::lm {
+namespace {
+
+enum class WeightRole { kAttention, kFeedForward, kEmbedding };
+
+// Classifies a weight by its name, e.g.
+// "transformer/layer_0/attn.q_proj.w" or "embedder/input_embedding".
+WeightRole GetWeightRole(absl::string_view name) {
+  const std::string lower_name = absl::AsciiStrToLower(name);
+  if (absl::StrContains(lower_name, "embed")) {
+    return WeightRole::kEmbedding;
+  }
+  for (absl::string_view attention_name :
+       {"attn", "attention", "q_proj", "k_proj", "v_proj", "o_proj", "query",
+        "key", "value"}) {
+    if (absl::StrContains(lower_name, attention_name)) {
+      return WeightRole::kAttention;
+    }
+  }
+  return WeightRole::kFeedForward;
+}
+
+tflite::TensorType GetFakeWeightType(FakeWeightsMode mode, WeightRole role) {
+  if (mode == FakeWeightsMode::FAKE_WEIGHTS_ATTN_8_FFN_4_EMB_4 &&
+      role != WeightRole::kAttention) {
+    return tflite::TensorType_INT4;
+  }
+  return tflite::TensorType_INT8;
+}
+
+tflite::BuiltinOperator GetBuiltinCode(const tflite::OperatorCodeT& code) {
+  // The codes past 127 are only in builtin_code, and the older models only
+  // have deprecated_builtin_code.
+  return static_cast<tflite::BuiltinOperator>(
+      std::max(static_cast<int32_t>(code.builtin_code),
+               static_cast<int32_t>(code.deprecated_builtin_code)));
+}
+
+// Returns the input of `op` that is its weight, if any, e.g. the filter of a
+// FULLY_CONNECTED, or -1.
+int GetWeightInput(tflite::BuiltinOperator op) {
+  switch (op) {
+    case tflite::BuiltinOperator_FULLY_CONNECTED:
+    case tflite::BuiltinOperator_BATCH_MATMUL:
+    case tflite::BuiltinOperator_CONV_2D:
+    case tflite::BuiltinOperator_DEPTHWISE_CONV_2D:
+    case tflite::BuiltinOperator_EMBEDDING_LOOKUP:
+      return 1;
+    case tflite::BuiltinOperator_GATHER:
+      return 0;
+    default:
+      return -1;
+  }
+}
+
+// Returns the indices of the weight tensors of `subgraph`.
+absl::flat_hash_set<int32_t> GetWeightTensors(
+    const tflite::ModelT& model, const tflite::SubGraphT& subgraph) {
+  absl::flat_hash_set<int32_t> weights;
+  for (const auto& op : subgraph.operators) {
+    const int input = GetWeightInput(
+        GetBuiltinCode(*model.operator_codes[op->opcode_index]));
+    if (input >= 0 && input < op->inputs.size() && op->inputs[input] >= 0) {
+      weights.insert(op->inputs[input]);
+    }
+  }
+  // The weights stored in another type and dequantized when the model runs.
+  for (const auto& op : subgraph.operators) {
+    if (GetBuiltinCode(*model.operator_codes[op->opcode_index]) ==
+            tflite::BuiltinOperator_DEQUANTIZE &&
+        !op->inputs.empty() && !op->outputs.empty() &&
+        weights.contains(op->outputs[0])) {
+      weights.insert(op->inputs[0]);
+    }
+  }
+  return weights;
+}
+
+// Fills `data` with the bytes of a xorshift generator, such that the weights
+// are neither zeros nor any pattern a kernel could take a shortcut on.
+void FillPseudoRandom(uint64_t seed, std::vector<uint8_t>& data) {
+  uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+  for (uint8_t& byte : data) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    byte = static_cast<uint8_t>(state >> 32);
+  }
+}
+
+}  // namespace
+
+absl::StatusOr<std::vector<uint8_t>> CreateModelWithFakeWeights(
+    absl::Span<const uint8_t> model_buffer, FakeWeightsMode mode) {
+  if (mode == FakeWeightsMode::FAKE_WEIGHTS_NONE) {
+    return absl::InvalidArgumentError("No fake weights mode is set.");
+  }
+  flatbuffers::Verifier verifier(model_buffer.data(), model_buffer.size());
+  if (!tflite::VerifyModelBuffer(verifier)) {
+    return absl::InvalidArgumentError("The TFLite model is invalid.");
+  }
+  std::unique_ptr<tflite::ModelT> model =
+      tflite::UnPackModel(model_buffer.data());
+  for (const auto& buffer : model->buffers) {
+    if (buffer->offset > 1) {
+      return absl::UnimplementedError(
+          "The fake weights of the models keeping their buffers past the "
+          "flatbuffer are not supported.");
+    }
+  }
+
+  // The buffers may be shared by the tensors, and are replaced once.
+  absl::flat_hash_map<uint32_t, tflite::TensorType> fake_buffer_types;
+  for (const auto& subgraph : model->subgraphs) {
+    for (int32_t index : GetWeightTensors(*model, *subgraph)) {
+      if (index >= subgraph->tensors.size()) {
+        continue;
+      }
+      tflite::TensorT& tensor = *subgraph->tensors[index];
+      if (tensor.buffer == 0 || tensor.buffer >= model->buffers.size() ||
+          model->buffers[tensor.buffer]->data.empty() ||
+          tensor.shape.size() < 2) {
+        continue;
+      }
+      uint64_t num_elements = 1;
+      for (int32_t dim : tensor.shape) {
+        num_elements *= std::max(dim, 1);
+      }
+      auto [it, inserted] = fake_buffer_types.try_emplace(
+          tensor.buffer, GetFakeWeightType(mode, GetWeightRole(tensor.name)));
+      const tflite::TensorType type = it->second;
+      if (inserted) {
+        std::vector<uint8_t>& data = model->buffers[tensor.buffer]->data;
+        data.resize(type == tflite::TensorType_INT4 ? (num_elements + 1) / 2
+                                                     : num_elements);
+        FillPseudoRandom(tensor.buffer, data);
+      }
+      tensor.type = type;
+      // Symmetric, per channel of the first dimension, scaled to about 1.
+      auto quantization = std::make_unique<tflite::QuantizationParametersT>();
+      const int num_channels = std::max(tensor.shape[0], 1);
+      const float scale =
+          type == tflite::TensorType_INT4 ? 1.0f / 7 : 1.0f / 127;
+      quantization->scale.assign(num_channels, scale);
+      quantization->zero_point.assign(num_channels, 0);
+      quantization->quantized_dimension = 0;
+      tensor.quantization = std::move(quantization);
+    }
+  }
+
+  flatbuffers::FlatBufferBuilder builder;
+  tflite::FinishModelBuffer(builder, tflite::Model::Pack(builder, model.get()));
+  return std::vector<uint8_t>(builder.GetBufferPointer(),
+                              builder.GetBufferPointer() + builder.GetSize());
+}
+
+}  // namespace litert::lm
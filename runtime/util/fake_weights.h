@@ -0,0 +1,44 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_FAKE_WEIGHTS_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_FAKE_WEIGHTS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/types/span.h"  // from @com_google_absl
+#include "runtime/executor/executor_settings_base.h"
+
+namespace litert::lm {
+
+// Returns a copy of the TFLite model `model_buffer` whose weights are replaced
+// with pseudo-random ones, quantized as of `mode`, e.g. to benchmark the
+// architecture of a model and a quantization scheme without its real weights.
+// The weights are the constant inputs of the matrix multiplications, e.g. of
+// FULLY_CONNECTED and BATCH_MATMUL, and of the embedding lookups, and the
+// inputs of the DEQUANTIZE ops feeding them. They are quantized per channel
+// of their first dimension, the embeddings being the tensors named as such
+// and the attention weights the ones named after the attention or its
+// projections. The other tensors are kept as they are.
+//
+// The models of 2GB or more, which keep their buffers past the flatbuffer,
+// are not supported.
+absl::StatusOr<std::vector<uint8_t>> CreateModelWithFakeWeights(
+    absl::Span<const uint8_t> model_buffer, FakeWeightsMode mode);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_FAKE_WEIGHTS_H_
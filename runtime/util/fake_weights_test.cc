@@ -0,0 +1,180 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/fake_weights.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "flatbuffers/flatbuffers.h"  // from @flatbuffers
+#include "runtime/executor/executor_settings_base.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+#include "tflite/schema/schema_generated.h"  // from @litert
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+// The tensors of the model of CreateModel().
+enum Tensor {
+  kInput,
+  kIds,
+  kEmbedding,
+  kEmbedded,
+  kQueryWeights,
+  kQuery,
+  kFfnWeights,
+  kFfnBias,
+  kOutput,
+};
+
+// Returns a model embedding its ids, and applying an attention and a
+// feedforward projection to its input, each with float weights of [8, 4].
+std::vector<uint8_t> CreateModel() {
+  tflite::ModelT model;
+  model.version = 3;
+  for (tflite::BuiltinOperator op :
+       {tflite::BuiltinOperator_EMBEDDING_LOOKUP,
+        tflite::BuiltinOperator_FULLY_CONNECTED}) {
+    auto code = std::make_unique<tflite::OperatorCodeT>();
+    code->builtin_code = op;
+    code->deprecated_builtin_code = static_cast<int8_t>(op);
+    model.operator_codes.push_back(std::move(code));
+  }
+  // The first buffer is the empty one of the non-constant tensors.
+  model.buffers.push_back(std::make_unique<tflite::BufferT>());
+  auto subgraph = std::make_unique<tflite::SubGraphT>();
+  auto add_tensor = [&](const std::string& name, std::vector<int32_t> shape,
+                        tflite::TensorType type, bool is_constant) {
+    auto tensor = std::make_unique<tflite::TensorT>();
+    tensor->name = name;
+    tensor->type = type;
+    if (is_constant) {
+      int num_elements = 1;
+      for (int32_t dim : shape) {
+        num_elements *= dim;
+      }
+      auto buffer = std::make_unique<tflite::BufferT>();
+      buffer->data.assign(num_elements * sizeof(float), 0);
+      tensor->buffer = model.buffers.size();
+      model.buffers.push_back(std::move(buffer));
+    }
+    tensor->shape = std::move(shape);
+    subgraph->tensors.push_back(std::move(tensor));
+  };
+  add_tensor("input", {1, 4}, tflite::TensorType_FLOAT32, false);
+  add_tensor("ids", {1}, tflite::TensorType_INT32, false);
+  add_tensor("embedder/input_embedding", {16, 4}, tflite::TensorType_FLOAT32,
+             true);
+  add_tensor("embedded", {1, 4}, tflite::TensorType_FLOAT32, false);
+  add_tensor("layer_0/attn.q_proj.w", {8, 4}, tflite::TensorType_FLOAT32,
+             true);
+  add_tensor("query", {1, 8}, tflite::TensorType_FLOAT32, false);
+  add_tensor("layer_0/ffn.w1", {8, 4}, tflite::TensorType_FLOAT32, true);
+  add_tensor("layer_0/ffn.b1", {8}, tflite::TensorType_FLOAT32, true);
+  add_tensor("output", {1, 8}, tflite::TensorType_FLOAT32, false);
+  auto add_op = [&](int opcode_index, std::vector<int32_t> inputs,
+                    int32_t output) {
+    auto op = std::make_unique<tflite::OperatorT>();
+    op->opcode_index = opcode_index;
+    op->inputs = std::move(inputs);
+    op->outputs = {output};
+    subgraph->operators.push_back(std::move(op));
+  };
+  add_op(0, {kIds, kEmbedding}, kEmbedded);
+  add_op(1, {kInput, kQueryWeights, -1}, kQuery);
+  add_op(1, {kInput, kFfnWeights, kFfnBias}, kOutput);
+  subgraph->inputs = {kInput, kIds};
+  subgraph->outputs = {kEmbedded, kQuery, kOutput};
+  model.subgraphs.push_back(std::move(subgraph));
+
+  flatbuffers::FlatBufferBuilder builder;
+  tflite::FinishModelBuffer(builder, tflite::Model::Pack(builder, &model));
+  return std::vector<uint8_t>(builder.GetBufferPointer(),
+                              builder.GetBufferPointer() + builder.GetSize());
+}
+
+const tflite::Tensor& GetTensor(const tflite::Model& model, Tensor tensor) {
+  return *model.subgraphs()->Get(0)->tensors()->Get(tensor);
+}
+
+size_t GetBufferSize(const tflite::Model& model, Tensor tensor) {
+  const auto* data =
+      model.buffers()->Get(GetTensor(model, tensor).buffer())->data();
+  return data == nullptr ? 0 : data->size();
+}
+
+TEST(FakeWeightsTest, QuantizesAllTheWeightsTo8Bits) {
+  const std::vector<uint8_t> model_buffer = CreateModel();
+  ASSERT_OK_AND_ASSIGN(
+      std::vector<uint8_t> fake_model_buffer,
+      CreateModelWithFakeWeights(
+          model_buffer, FakeWeightsMode::FAKE_WEIGHTS_8BITS_ALL_LAYERS));
+  flatbuffers::Verifier verifier(fake_model_buffer.data(),
+                                 fake_model_buffer.size());
+  ASSERT_TRUE(tflite::VerifyModelBuffer(verifier));
+  const tflite::Model& model = *tflite::GetModel(fake_model_buffer.data());
+
+  for (Tensor tensor : {kEmbedding, kQueryWeights, kFfnWeights}) {
+    EXPECT_EQ(GetTensor(model, tensor).type(), tflite::TensorType_INT8);
+    const tflite::QuantizationParameters* quantization =
+        GetTensor(model, tensor).quantization();
+    ASSERT_NE(quantization, nullptr);
+    EXPECT_EQ(quantization->scale()->size(),
+              GetTensor(model, tensor).shape()->Get(0));
+    EXPECT_EQ(quantization->quantized_dimension(), 0);
+  }
+  EXPECT_EQ(GetBufferSize(model, kEmbedding), 16 * 4);
+  EXPECT_EQ(GetBufferSize(model, kQueryWeights), 8 * 4);
+  // The bias and the activations are kept.
+  EXPECT_EQ(GetTensor(model, kFfnBias).type(), tflite::TensorType_FLOAT32);
+  EXPECT_EQ(GetBufferSize(model, kFfnBias), 8 * sizeof(float));
+  EXPECT_EQ(GetTensor(model, kInput).type(), tflite::TensorType_FLOAT32);
+}
+
+TEST(FakeWeightsTest, QuantizesTheAttentionTo8BitsAndTheRestTo4Bits) {
+  ASSERT_OK_AND_ASSIGN(
+      std::vector<uint8_t> fake_model_buffer,
+      CreateModelWithFakeWeights(
+          CreateModel(), FakeWeightsMode::FAKE_WEIGHTS_ATTN_8_FFN_4_EMB_4));
+  const tflite::Model& model = *tflite::GetModel(fake_model_buffer.data());
+
+  EXPECT_EQ(GetTensor(model, kQueryWeights).type(), tflite::TensorType_INT8);
+  EXPECT_EQ(GetBufferSize(model, kQueryWeights), 8 * 4);
+  EXPECT_EQ(GetTensor(model, kFfnWeights).type(), tflite::TensorType_INT4);
+  EXPECT_EQ(GetBufferSize(model, kFfnWeights), 8 * 4 / 2);
+  EXPECT_EQ(GetTensor(model, kEmbedding).type(), tflite::TensorType_INT4);
+  EXPECT_EQ(GetBufferSize(model, kEmbedding), 16 * 4 / 2);
+}
+
+TEST(FakeWeightsTest, RejectsNoModeAndInvalidModels) {
+  EXPECT_THAT(CreateModelWithFakeWeights(CreateModel(),
+                                         FakeWeightsMode::FAKE_WEIGHTS_NONE),
+              StatusIs(absl::StatusCode::kInvalidArgument));
+  const std::vector<uint8_t> invalid_model(64, 0xff);
+  EXPECT_THAT(
+      CreateModelWithFakeWeights(
+          invalid_model, FakeWeightsMode::FAKE_WEIGHTS_8BITS_ALL_LAYERS),
+      StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,66 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/init_phase.h"
+
+#include <string>
+
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+// The sink of the calling thread, and the full name of its innermost phase,
+// if any.
+thread_local InitPhaseSink* current_sink = nullptr;
+thread_local const std::string* current_parent = nullptr;
+
+}  // namespace
+
+ScopedInitPhaseSink::ScopedInitPhaseSink(InitPhaseSink* sink)
+    : previous_sink_(current_sink), previous_parent_(current_parent) {
+  current_sink = sink;
+  current_parent = nullptr;
+}
+
+ScopedInitPhaseSink::~ScopedInitPhaseSink() {
+  current_sink = previous_sink_;
+  current_parent = previous_parent_;
+}
+
+InitPhaseScope::InitPhaseScope(absl::string_view name) : sink_(current_sink) {
+  if (sink_ == nullptr) {
+    return;
+  }
+  name_ = current_parent == nullptr ? std::string(name)
+                                    : absl::StrCat(*current_parent, "/", name);
+  parent_ = current_parent;
+  current_parent = &name_;
+  start_time_ = absl::Now();
+}
+
+InitPhaseScope::~InitPhaseScope() {
+  if (sink_ == nullptr) {
+    return;
+  }
+  current_parent = parent_;
+  sink_->OnInitPhase(name_, absl::Now() - start_time_);
+}
+
+bool InitPhaseScope::IsEnabled() { return current_sink != nullptr; }
+
+}  // namespace litert::lm
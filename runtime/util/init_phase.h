@@ -0,0 +1,87 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_INIT_PHASE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_INIT_PHASE_H_
+
+#include <string>
+
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// Receives the init phases timed on the threads it is installed on, e.g. to
+// record the steps of the loading of an engine into its benchmark info.
+class InitPhaseSink {
+ public:
+  virtual ~InitPhaseSink() = default;
+
+  // Called when the phase "name" ends, from the thread it ran on.
+  virtual void OnInitPhase(absl::string_view name,
+                           absl::Duration duration) = 0;
+};
+
+// Installs "sink" on the calling thread for its lifetime, such that the
+// InitPhaseScopes of the thread report to it. The previous sink of the thread
+// is restored when it is destroyed. "sink" may be null, to time nothing.
+class ScopedInitPhaseSink {
+ public:
+  explicit ScopedInitPhaseSink(InitPhaseSink* sink);
+  ~ScopedInitPhaseSink();
+
+  ScopedInitPhaseSink(const ScopedInitPhaseSink&) = delete;
+  ScopedInitPhaseSink& operator=(const ScopedInitPhaseSink&) = delete;
+
+ private:
+  InitPhaseSink* const previous_sink_;
+  const std::string* const previous_parent_;
+};
+
+// Times its lifetime as the init phase "name", reported to the sink of the
+// calling thread if any, and costs a thread local lookup otherwise. The
+// phases nested in another one are named after it, e.g. "Executor
+// initialization/Model compilation", so the steps of each phase list under
+// it once sorted.
+//
+// Sample usage:
+//
+//   absl::Status MapSections() {
+//     InitPhaseScope phase("Header parsing");
+//     ...
+//   }
+//
+class InitPhaseScope {
+ public:
+  explicit InitPhaseScope(absl::string_view name);
+  ~InitPhaseScope();
+
+  InitPhaseScope(const InitPhaseScope&) = delete;
+  InitPhaseScope& operator=(const InitPhaseScope&) = delete;
+
+  // Whether the phases of the calling thread are reported to a sink, e.g. to
+  // skip building the name of a phase otherwise.
+  static bool IsEnabled();
+
+ private:
+  InitPhaseSink* const sink_;
+  // The full name of the phase, and the one of the phase it is nested in.
+  std::string name_;
+  const std::string* parent_ = nullptr;
+  absl::Time start_time_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_INIT_PHASE_H_
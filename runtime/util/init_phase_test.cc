@@ -0,0 +1,83 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/init_phase.h"
+
+#include <map>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+using ::testing::ElementsAre;
+using ::testing::IsEmpty;
+using ::testing::Key;
+
+class RecordingSink : public InitPhaseSink {
+ public:
+  void OnInitPhase(absl::string_view name, absl::Duration duration) override {
+    phases_[std::string(name)] += duration;
+  }
+
+  const std::map<std::string, absl::Duration>& phases() const {
+    return phases_;
+  }
+
+ private:
+  std::map<std::string, absl::Duration> phases_;
+};
+
+TEST(InitPhaseTest, NamesTheNestedPhasesAfterTheirParent) {
+  RecordingSink sink;
+  {
+    ScopedInitPhaseSink scoped_sink(&sink);
+    EXPECT_TRUE(InitPhaseScope::IsEnabled());
+    InitPhaseScope phase("Loading");
+    {
+      InitPhaseScope nested_phase("Mapping");
+      InitPhaseScope innermost_phase("Header");
+    }
+    InitPhaseScope other_phase("Parsing");
+  }
+  EXPECT_FALSE(InitPhaseScope::IsEnabled());
+  EXPECT_THAT(sink.phases(),
+              ElementsAre(Key("Loading"), Key("Loading/Mapping"),
+                          Key("Loading/Mapping/Header"),
+                          Key("Loading/Parsing")));
+  EXPECT_GE(sink.phases().at("Loading"),
+            sink.phases().at("Loading/Mapping"));
+}
+
+TEST(InitPhaseTest, OnlyReportsThePhasesOfTheThreadsOfTheSink) {
+  RecordingSink sink;
+  ScopedInitPhaseSink scoped_sink(&sink);
+  InitPhaseScope phase("Loading");
+  std::thread thread([]() { InitPhaseScope other_phase("Other thread"); });
+  thread.join();
+  {
+    // The phases run with no sink are not timed, nor nested under "Loading".
+    ScopedInitPhaseSink no_sink(nullptr);
+    InitPhaseScope untimed_phase("Untimed");
+  }
+  EXPECT_THAT(sink.phases(), IsEmpty());
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,389 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/io_uring_file_reader.h"
+
+#include <cstdint>
+#include <memory>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/scoped_file.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define LITERT_LM_HAS_IO_URING 1
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/cleanup/cleanup.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "runtime/util/status_macros.h"
+#endif  // defined(__linux__) && __has_include(<linux/io_uring.h>)
+
+namespace litert::lm {
+
+#if defined(LITERT_LM_HAS_IO_URING)
+namespace {
+
+// The submission and completion rings of an io_uring instance, mapped from
+// the kernel as io_uring_setup(2) describes, without liburing.
+class IoUring {
+ public:
+  static absl::StatusOr<std::unique_ptr<IoUring>> Create(unsigned entries) {
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    const int ring_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_fd < 0) {
+      return absl::UnavailableError(
+          absl::StrCat("io_uring is not available: ", strerror(errno)));
+    }
+    auto ring = std::unique_ptr<IoUring>(new IoUring(ring_fd));
+    RETURN_IF_ERROR(ring->MapRings(params));
+    return ring;
+  }
+
+  ~IoUring() {
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != MAP_FAILED) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    close(ring_fd_);
+  }
+
+  IoUring(const IoUring&) = delete;
+  IoUring& operator=(const IoUring&) = delete;
+
+  // Queues a read of `size` bytes at `offset` of `fd` into `buffer`, whose
+  // completion returns `user_data`. Returns false if the submission ring is
+  // full.
+  bool QueueRead(int fd, void* buffer, uint32_t size, uint64_t offset,
+                 uint64_t user_data) {
+    const unsigned tail = *sq_tail_;
+    if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+      return false;
+    }
+    const unsigned index = tail & sq_mask_;
+    io_uring_sqe& sqe = sqes_[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(buffer);
+    sqe.len = size;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    sq_array_[index] = index;
+    // The kernel sees the entry once the tail is published.
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++num_queued_;
+    return true;
+  }
+
+  // Submits the queued reads, and waits for at least `min_complete` of the
+  // reads in flight to complete.
+  absl::Status SubmitAndWait(unsigned min_complete) {
+    while (true) {
+      const int num_submitted =
+          syscall(__NR_io_uring_enter, ring_fd_, num_queued_, min_complete,
+                  IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (num_submitted >= 0) {
+        num_queued_ -= num_submitted;
+        return absl::OkStatus();
+      }
+      if (errno != EINTR) {
+        return absl::InternalError(
+            absl::StrCat("io_uring_enter failed: ", strerror(errno)));
+      }
+    }
+  }
+
+  // Calls `on_completion(user_data, result)` for each completed read, where
+  // `result` is the number of bytes read or a negated errno.
+  template <typename OnCompletion>
+  void ReapCompletions(OnCompletion on_completion) {
+    unsigned head = *cq_head_;
+    const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+      const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+      on_completion(cqe.user_data, cqe.res);
+    }
+    // The kernel reuses the entries once the head is published.
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  }
+
+ private:
+  explicit IoUring(int ring_fd) : ring_fd_(ring_fd) {}
+
+  absl::Status MapRings(const io_uring_params& params) {
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    RET_CHECK(sq_ring_ != MAP_FAILED)
+        << "Failed to map the io_uring submission ring: " << strerror(errno);
+    cq_ring_ = single_mmap ? sq_ring_
+                           : mmap(nullptr, cq_ring_size_,
+                                  PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, ring_fd_,
+                                  IORING_OFF_CQ_RING);
+    RET_CHECK(cq_ring_ != MAP_FAILED)
+        << "Failed to map the io_uring completion ring: " << strerror(errno);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    RET_CHECK(sqes != MAP_FAILED)
+        << "Failed to map the io_uring submission entries: "
+        << strerror(errno);
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    auto* sq_ring = static_cast<uint8_t*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+    auto* cq_ring = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+    return absl::OkStatus();
+  }
+
+  const int ring_fd_;
+  void* sq_ring_ = MAP_FAILED;
+  size_t sq_ring_size_ = 0;
+  void* cq_ring_ = MAP_FAILED;
+  size_t cq_ring_size_ = 0;
+  io_uring_sqe* sqes_ = static_cast<io_uring_sqe*>(MAP_FAILED);
+  size_t sqes_size_ = 0;
+  unsigned* sq_head_ = nullptr;
+  unsigned* sq_tail_ = nullptr;
+  unsigned* sq_array_ = nullptr;
+  unsigned sq_mask_ = 0;
+  unsigned sq_entries_ = 0;
+  unsigned* cq_head_ = nullptr;
+  unsigned* cq_tail_ = nullptr;
+  unsigned cq_mask_ = 0;
+  io_uring_cqe* cqes_ = nullptr;
+  // The reads queued and not submitted yet.
+  unsigned num_queued_ = 0;
+};
+
+// The bytes of a region of a file read into anonymous memory, which is
+// replaced by a private mapping of the file once released.
+class IoUringReadFile : public MemoryMappedFile {
+ public:
+  IoUringReadFile(int fd, uint64_t offset, uint64_t length, void* data,
+                  size_t mapped_length)
+      : fd_(fd),
+        offset_(offset),
+        length_(length),
+        data_(data),
+        mapped_length_(mapped_length) {}
+  ~IoUringReadFile() override { munmap(data_, mapped_length_); }
+
+  uint64_t length() override { return length_; }
+
+  void* data() override { return data_; }
+
+  absl::Status Advise(Advice advice) override {
+    switch (advice) {
+      case Advice::kDontNeed: {
+        // The same bytes are mapped from the file in place, such that the
+        // anonymous pages are freed and the data pointer stays valid.
+        void* mapped = mmap(data_, mapped_length_, PROT_READ,
+                            MAP_PRIVATE | MAP_FIXED, fd_, offset_);
+        RET_CHECK(mapped != MAP_FAILED)
+            << "Failed to map the file over the read section: "
+            << strerror(errno);
+        return absl::OkStatus();
+      }
+      case Advice::kHugePage:
+#ifdef MADV_HUGEPAGE
+        RET_CHECK_EQ(madvise(data_, mapped_length_, MADV_HUGEPAGE), 0)
+            << "madvise failed, error: " << strerror(errno);
+#endif  // MADV_HUGEPAGE
+        return absl::OkStatus();
+      default:
+        // The bytes are already in memory.
+        return absl::OkStatus();
+    }
+  }
+
+  absl::Status Lock() override {
+    RET_CHECK_EQ(mlock(data_, length_), 0)
+            .SetCode(absl::StatusCode::kResourceExhausted)
+        << "mlock failed, error: " << strerror(errno);
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<double> GetResidentFraction() override {
+    const size_t page_size = getpagesize();
+    const size_t num_pages = (length_ + page_size - 1) / page_size;
+    std::vector<unsigned char> residency(num_pages);
+    RET_CHECK_EQ(mincore(data_, length_, residency.data()), 0)
+        << "mincore failed, error: " << strerror(errno);
+    size_t num_resident_pages = 0;
+    for (const auto page : residency) {
+      num_resident_pages += page & 1;
+    }
+    return static_cast<double>(num_resident_pages) / num_pages;
+  }
+
+ private:
+  const int fd_;
+  const uint64_t offset_;
+  const uint64_t length_;
+  void* const data_;
+  const size_t mapped_length_;
+};
+
+}  // namespace
+
+absl::StatusOr<std::unique_ptr<MemoryMappedFile>> ReadFileWithIoUring(
+    ScopedFile::PlatformFile file, uint64_t offset, uint64_t length,
+    const IoUringReadOptions& options) {
+  const size_t page_size = getpagesize();
+  RET_CHECK(length > 0 && offset % page_size == 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "Cannot read " << length << " bytes at offset " << offset
+      << ", which must be a multiple of " << page_size;
+  RET_CHECK(options.chunk_size > 0 && options.chunk_size % page_size == 0 &&
+            options.queue_depth > 0)
+          .SetCode(absl::StatusCode::kInvalidArgument)
+      << "The chunk size must be a multiple of " << page_size
+      << " and the queue depth positive.";
+
+  // The direct reads bypass the page cache, so the file is opened again with
+  // O_DIRECT rather than changing the flags of the caller's descriptor.
+  const int direct_fd = open(absl::StrCat("/proc/self/fd/", file).c_str(),
+                             O_RDONLY | O_DIRECT | O_CLOEXEC);
+  if (direct_fd < 0) {
+    return absl::UnavailableError(absl::StrCat(
+        "Failed to open the file for direct reads: ", strerror(errno)));
+  }
+  absl::Cleanup close_direct_fd = [direct_fd] { close(direct_fd); };
+
+  // The direct reads are of whole pages into page-aligned memory.
+  const size_t mapped_length = (length + page_size - 1) / page_size * page_size;
+  void* data = mmap(nullptr, mapped_length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  RET_CHECK(data != MAP_FAILED).SetCode(absl::StatusCode::kResourceExhausted)
+      << "Failed to allocate " << mapped_length
+      << " bytes: " << strerror(errno);
+  auto read_file = std::make_unique<IoUringReadFile>(file, offset, length,
+                                                     data, mapped_length);
+  ASSIGN_OR_RETURN(auto ring, IoUring::Create(options.queue_depth));
+
+  auto* bytes = static_cast<uint8_t*>(data);
+  uint64_t next_read = 0;
+  int num_in_flight = 0;
+  absl::Status read_status;
+  // The chunks cut short, e.g. by a signal, are finished with buffered reads,
+  // since their remainder needs not be aligned.
+  std::vector<std::pair<uint64_t, uint64_t>> short_reads;
+  while (next_read < mapped_length || num_in_flight > 0) {
+    while (next_read < mapped_length && num_in_flight < options.queue_depth) {
+      const uint32_t size = std::min<uint64_t>(options.chunk_size,
+                                               mapped_length - next_read);
+      if (!ring->QueueRead(direct_fd, bytes + next_read, size,
+                           offset + next_read, /*user_data=*/next_read)) {
+        break;
+      }
+      next_read += size;
+      ++num_in_flight;
+    }
+    RETURN_IF_ERROR(ring->SubmitAndWait(/*min_complete=*/1));
+    ring->ReapCompletions([&](uint64_t start, int result) {
+      --num_in_flight;
+      const uint64_t size =
+          std::min<uint64_t>(options.chunk_size, mapped_length - start);
+      if (result < 0) {
+        if (read_status.ok()) {
+          // EINVAL is what the kernels without IORING_OP_READ, and the file
+          // systems without direct I/O, fail the reads with.
+          read_status =
+              result == -EINVAL
+                  ? absl::UnavailableError(
+                        "The file cannot be read with direct I/O.")
+                  : absl::InternalError(absl::StrCat(
+                        "Failed to read the file: ", strerror(-result)));
+        }
+      } else if (static_cast<uint64_t>(result) < size &&
+                 start + result < length) {
+        short_reads.push_back({start + result, size - result});
+      }
+    });
+    if (!read_status.ok()) {
+      // The reads in flight write into the memory, so they are waited for.
+      while (num_in_flight > 0) {
+        RETURN_IF_ERROR(ring->SubmitAndWait(/*min_complete=*/1));
+        ring->ReapCompletions([&](uint64_t, int) { --num_in_flight; });
+      }
+      return read_status;
+    }
+  }
+  for (auto [start, size] : short_reads) {
+    size = std::min<uint64_t>(size, length - start);
+    while (size > 0) {
+      const ssize_t result = pread(file, bytes + start, size, offset + start);
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+      RET_CHECK_GT(result, 0)
+          << "Failed to read the file: "
+          << (result < 0 ? strerror(errno) : "unexpected end of file");
+      start += result;
+      size -= result;
+    }
+  }
+  // Read-only, as the mappings of the file are.
+  RET_CHECK_EQ(mprotect(data, mapped_length, PROT_READ), 0)
+      << "mprotect failed, error: " << strerror(errno);
+  return read_file;
+}
+
+#else  // !defined(LITERT_LM_HAS_IO_URING)
+
+absl::StatusOr<std::unique_ptr<MemoryMappedFile>> ReadFileWithIoUring(
+    ScopedFile::PlatformFile file, uint64_t offset, uint64_t length,
+    const IoUringReadOptions& options) {
+  return absl::UnavailableError("io_uring is only available on Linux.");
+}
+
+#endif  // defined(LITERT_LM_HAS_IO_URING)
+
+}  // namespace litert::lm
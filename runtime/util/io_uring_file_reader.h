@@ -0,0 +1,56 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_IO_URING_FILE_READER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_IO_URING_FILE_READER_H_
+
+#include <cstdint>
+#include <memory>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/scoped_file.h"
+
+namespace litert::lm {
+
+// The options of ReadFileWithIoUring().
+struct IoUringReadOptions {
+  // The size of each read, a multiple of the page size.
+  uint32_t chunk_size = 1 << 20;
+  // The number of reads in flight, such that an NVMe drive is kept busy.
+  int queue_depth = 32;
+};
+
+// Reads the `length` bytes at `offset` of `file` into anonymous memory, with
+// many O_DIRECT reads in flight through io_uring. A large cold section is then
+// read at the bandwidth of the device, instead of at the pace of the page
+// faults of a mapping, which serialize the reads of the GPU upload or of the
+// XNNPACK packing. `offset` must be a multiple of
+// MemoryMappedFile::GetOffsetAlignment().
+//
+// The returned MemoryMappedFile holds the bytes read, read-only. Lock() pins
+// them in RAM. Advise(kDontNeed) maps the file over them, such that their
+// memory is released and read back from the file if accessed again. `file`
+// must outlive it.
+//
+// Returns UnavailableError if the reads cannot be done so, e.g. on other
+// platforms than Linux, in a sandbox blocking io_uring, or on a file system
+// without direct I/O, in which case the file is to be mapped instead.
+absl::StatusOr<std::unique_ptr<MemoryMappedFile>> ReadFileWithIoUring(
+    ScopedFile::PlatformFile file, uint64_t offset, uint64_t length,
+    const IoUringReadOptions& options = IoUringReadOptions());
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_IO_URING_FILE_READER_H_
@@ -0,0 +1,110 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/io_uring_file_reader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/scoped_file.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+// Returns the contents of a file of `size` bytes, none of its pages alike.
+std::string CreateContents(size_t size) {
+  std::string contents(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    contents[i] = static_cast<char>((i * 7 + i / 4096) & 0xff);
+  }
+  return contents;
+}
+
+std::string WriteFile(absl::string_view name, absl::string_view contents) {
+  auto path = std::filesystem::path(::testing::TempDir()) / std::string(name);
+  std::ofstream ofstr(path, std::ios::out | std::ios::binary);
+  ofstr << contents;
+  return path.string();
+}
+
+// Reads `length` bytes at `offset` of `handle`, or skips the test if io_uring
+// or direct I/O is not available here.
+#define READ_OR_SKIP(lhs, handle, offset, length, options)                  \
+  absl::StatusOr<std::unique_ptr<MemoryMappedFile>> lhs##_or =              \
+      ReadFileWithIoUring((handle).file(), offset, length, options);        \
+  if (absl::IsUnavailable(lhs##_or.status())) {                             \
+    GTEST_SKIP() << lhs##_or.status();                                      \
+  }                                                                         \
+  ASSERT_OK(lhs##_or);                                                      \
+  std::unique_ptr<MemoryMappedFile> lhs = *std::move(lhs##_or)
+
+TEST(IoUringFileReaderTest, ReadsTheSection) {
+  const size_t alignment = MemoryMappedFile::GetOffsetAlignment();
+  const std::string contents = CreateContents(8 * alignment + 123);
+  ASSERT_OK_AND_ASSIGN(auto handle,
+                       ScopedFile::Open(WriteFile("section.bin", contents)));
+
+  // Small chunks and a short queue, for the reads to be queued over and over.
+  IoUringReadOptions options;
+  options.chunk_size = alignment;
+  options.queue_depth = 2;
+  READ_OR_SKIP(file, handle, alignment, contents.size() - alignment, options);
+
+  ASSERT_EQ(file->length(), contents.size() - alignment);
+  EXPECT_EQ(absl::string_view(static_cast<const char*>(file->data()),
+                              file->length()),
+            absl::string_view(contents).substr(alignment));
+}
+
+TEST(IoUringFileReaderTest, KeepsTheBytesOnceReleased) {
+  const size_t alignment = MemoryMappedFile::GetOffsetAlignment();
+  const std::string contents = CreateContents(3 * alignment);
+  ASSERT_OK_AND_ASSIGN(auto handle,
+                       ScopedFile::Open(WriteFile("released.bin", contents)));
+  READ_OR_SKIP(file, handle, 0, contents.size(), IoUringReadOptions());
+
+  EXPECT_OK(file->Advise(MemoryMappedFile::Advice::kDontNeed));
+  EXPECT_EQ(absl::string_view(static_cast<const char*>(file->data()),
+                              file->length()),
+            contents);
+}
+
+TEST(IoUringFileReaderTest, RejectsUnalignedOffsets) {
+  const std::string contents = CreateContents(4096);
+  ASSERT_OK_AND_ASSIGN(auto handle,
+                       ScopedFile::Open(WriteFile("unaligned.bin", contents)));
+  auto file = ReadFileWithIoUring(handle.file(), 1, 100);
+  if (absl::IsUnavailable(file.status())) {
+    GTEST_SKIP() << file.status();
+  }
+  EXPECT_THAT(file, StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+}  // namespace
+}  // namespace litert::lm
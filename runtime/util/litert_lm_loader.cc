@@ -22,6 +22,7 @@
 #include <optional>
 #include <sstream>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -29,40 +30,101 @@
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
-#include "absl/strings/ascii.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
 #include "litert/cc/litert_buffer_ref.h"  // from @litert
 #include "runtime/components/model_resources.h"
+#include "runtime/framework/work_stealing_threadpool.h"
+#include "runtime/util/init_phase.h"
+#include "runtime/util/io_uring_file_reader.h"
 #include "runtime/util/memory_mapped_file.h"
 #include "runtime/util/scoped_file.h"
+#include "runtime/util/shared_memory_file.h"
 #include "runtime/util/status_macros.h"  // NOLINT
+#include "schema/core/litertlm_compression.h"
+#include "schema/core/litertlm_header.h"
 #include "schema/core/litertlm_header_schema_generated.h"
 #include "schema/core/litertlm_read.h"
+#include "schema/core/litertlm_utils.h"
 
 namespace litert::lm {
 
 namespace {
-// Utility function to Creates a memory-mapped file from a ScopedFile.
-absl::StatusOr<std::unique_ptr<MemoryMappedFile>> CreateMemoryMapFromScopedFile(
-    litert::lm::ScopedFile& scoped_file) {
+
+constexpr uint64_t kLitertLmHeaderMaxSize = 16 * 1024;
+
+// How often the size of a model file still arriving is checked.
+constexpr absl::Duration kArrivalPollInterval = absl::Milliseconds(10);
+
+// The bytes of each end of a compressed section fingerprinted with its index.
+constexpr uint64_t kSectionFingerprintEndSize = 64 * 1024;
+
+// Returns a fingerprint of the chunk compressed section of "size" bytes at
+// "data", cheap enough for multi GB sections: its chunk index, which holds the
+// size of every compressed chunk, and the data at both of its ends.
+std::string SectionFingerprint(const uint8_t* data, uint64_t size,
+                               const schema::ChunkIndex& index) {
+  const char* chars = reinterpret_cast<const char*>(data);
+  const uint64_t index_size = index.chunk_begin_offsets.empty()
+                                  ? 0
+                                  : index.chunk_begin_offsets.front();
+  const uint64_t begin_size =
+      std::min(size, std::max(index_size, kSectionFingerprintEndSize));
+  const uint64_t end_size = std::min(size, kSectionFingerprintEndSize);
+  std::string fingerprint = absl::StrCat(size, ":");
+  fingerprint.append(chars, begin_size);
+  fingerprint.append(chars + size - end_size, end_size);
+  return fingerprint;
+}
+
+// Utility function to Creates a memory-mapped file of the header from a
+// ScopedFile.
+absl::StatusOr<std::unique_ptr<MemoryMappedFile>>
+CreateHeaderMemoryMapFromScopedFile(litert::lm::ScopedFile& scoped_file) {
   if (!scoped_file.IsValid()) {
     return absl::InvalidArgumentError("Invalid ScopedFile provided.");
   }
   litert::lm::ScopedFile::PlatformFile platform_file = scoped_file.file();
+  ASSIGN_OR_RETURN(size_t file_size, scoped_file.GetSize());
   // For a read-only memory-mapped file:
-  return litert::lm::MemoryMappedFile::Create(platform_file, 0, 0, "whole");
+  return litert::lm::MemoryMappedFile::Create(
+      platform_file, 0, std::min<uint64_t>(kLitertLmHeaderMaxSize, file_size));
 }
 
-constexpr uint64_t kLitertLmHeaderMaxSize = 16 * 1024;
+// Returns how a section is read once mapped:
+// - The embedders are looked up a few rows per token.
+// - The other models and the LoRA adapters are read through, once to be
+//   compiled, packed or uploaded.
+// - The small sections, e.g. the tokenizers and the metadata, are read whole
+//   right away.
+MemoryMappedFile::Advice GetSectionAdvice(
+    schema::AnySectionDataType data_type, std::optional<ModelType> model_type) {
+  if (data_type == schema::AnySectionDataType_TFLiteModel) {
+    if (model_type == ModelType::kTfLiteEmbedder ||
+        model_type == ModelType::kTfLitePerLayerEmbedder) {
+      return MemoryMappedFile::Advice::kRandom;
+    }
+    return MemoryMappedFile::Advice::kSequential;
+  }
+  if (data_type == schema::AnySectionDataType_LoRA_Adapter) {
+    return MemoryMappedFile::Advice::kSequential;
+  }
+  return MemoryMappedFile::Advice::kWillNeed;
+}
 
 }  // namespace
 
 absl::Status LitertLmLoader::MapSections() {
   schema::LitertlmHeader header;
   // Read the header information.
-  absl::Status status = ReadHeaderFromLiteRTLM(
-      memory_mapped_file_->data(),
-      std::min(kLitertLmHeaderMaxSize, memory_mapped_file_->length()), &header);
+  absl::Status status;
+  {
+    InitPhaseScope phase("Header parsing");
+    status = ReadHeaderFromLiteRTLM(header_mapped_file_->data(),
+                                    header_mapped_file_->length(), &header);
+  }
   ABSL_LOG(INFO) << "status: " << status;
   ABSL_LOG(INFO) << "major_version: " << header.major_version;
   ABSL_LOG(INFO) << "minor_version: " << header.minor_version;
@@ -72,47 +134,70 @@ absl::Status LitertLmLoader::MapSections() {
     return status;
   }
 
-  // Loop through the sections and map them to the section buffers.
-  auto sections = header.metadata->section_metadata()->objects();
-  for (size_t i = 0; i < sections->size(); ++i) {
-    const schema::SectionObject* section = sections->Get(i);
-    auto items = section->items();
-    BufferKey buffer_key(section->data_type());
+  // The items of the sections are read once into the index, and the sections
+  // are then looked up by their keys.
+  for (const schema::SectionIndexEntry& entry :
+       schema::BuildSectionIndex(*header.metadata)) {
+    const int i = entry.section_index;
+    BufferKey buffer_key(entry.data_type);
     // Extract the specific model type from the section items KeyValuePairs.
-    if (section->data_type() ==
-        schema::AnySectionDataType_TFLiteModel) {
-      bool found_model_type = false;
-      std::string model_type;
-      for (size_t j = 0; j < items->size(); ++j) {
-        auto item = items->Get(j);
-        if (item->key() &&
-            absl::AsciiStrToLower(item->key()->str()) == "model_type" &&
-            item->value()) {
-          found_model_type = true;
-          model_type = *(item->value_as_StringValue()->value());
-          break;
-        }
-      }
-      if (found_model_type) {
-        ABSL_LOG(INFO) << "model_type: " << model_type;
-        buffer_key = BufferKey(section->data_type(),
-                               StringToModelType(model_type).value());
+    if (entry.data_type == schema::AnySectionDataType_TFLiteModel) {
+      if (!entry.model_type.empty()) {
+        ABSL_LOG(INFO) << "model_type: " << entry.model_type;
+        buffer_key = BufferKey(entry.data_type,
+                               StringToModelType(entry.model_type).value());
       } else {
         ABSL_LOG(WARNING) << "model_type not found, use kTfLitePrefillDecode";
         // For backward compatibility, we will use the default model type if
         // model_type is not found.
         buffer_key =
-            BufferKey(section->data_type(), ModelType::kTfLitePrefillDecode);
+            BufferKey(entry.data_type, ModelType::kTfLitePrefillDecode);
       }
     }
-    section_buffers_[buffer_key] =
-        BufferRef<uint8_t>(static_cast<uint8_t*>(memory_mapped_file_->data()),
-                           section->end_offset(), section->begin_offset());
+    // A file written with an aligned layout records the alignment of its
+    // sections, which lets them be mapped in place.
+    if (entry.alignment != 0) {
+      RET_CHECK_EQ(entry.begin_offset % entry.alignment, 0)
+              .SetCode(absl::StatusCode::kDataLoss)
+          << "Section " << i << " at offset " << entry.begin_offset
+          << " is not aligned to its recorded alignment " << entry.alignment;
+    }
+    if (!entry.compression.empty()) {
+      RET_CHECK_EQ(entry.compression, schema::kChunkedZlibCompression)
+              .SetCode(absl::StatusCode::kUnimplemented)
+          << "Section " << i << " has an unsupported compression.";
+    }
+    if (entry.begin_offset % MemoryMappedFile::GetOffsetAlignment() != 0) {
+      ABSL_LOG(INFO) << "Section " << i << " is not aligned to the mapping "
+                     << "granularity, so it is mapped with the page before.";
+    }
+    Section section_to_map;
+    section_to_map.name = EnumNameAnySectionDataType(entry.data_type);
+    if (buffer_key.model_type.has_value()) {
+      absl::StrAppend(&section_to_map.name, ":",
+                      ModelTypeToString(*buffer_key.model_type));
+    }
+    section_to_map.begin_offset = entry.begin_offset;
+    section_to_map.end_offset = entry.end_offset;
+    section_to_map.advice =
+        GetSectionAdvice(entry.data_type, buffer_key.model_type);
+    section_to_map.is_model =
+        entry.data_type == schema::AnySectionDataType_TFLiteModel;
+    section_to_map.is_compressed = !entry.compression.empty();
+    if (section_to_map.is_compressed) {
+      // The compressed chunks are read once, in order.
+      section_to_map.advice = MemoryMappedFile::Advice::kSequential;
+    }
+    if (entry.data_type == schema::AnySectionDataType_LoRA_Adapter) {
+      lora_adapter_sections_.push_back(std::move(section_to_map));
+    } else {
+      sections_[buffer_key] = std::move(section_to_map);
+    }
     ABSL_LOG(INFO) << "section_index: " << i;
     ABSL_LOG(INFO) << "section_data_type: "
-                   << EnumNameAnySectionDataType(section->data_type());
-    ABSL_LOG(INFO) << "section_begin_offset: " << section->begin_offset();
-    ABSL_LOG(INFO) << "section_end_offset: " << section->end_offset();
+                   << EnumNameAnySectionDataType(entry.data_type);
+    ABSL_LOG(INFO) << "section_begin_offset: " << entry.begin_offset;
+    ABSL_LOG(INFO) << "section_end_offset: " << entry.end_offset;
   }
   return absl::OkStatus();
 }
@@ -120,13 +205,23 @@ absl::Status LitertLmLoader::MapSections() {
 absl::Status LitertLmLoader::Initialize() {
   ABSL_LOG(INFO) << "LitertLmLoader::Initialize";
 
-  absl::StatusOr<std::unique_ptr<MemoryMappedFile>> mmap_status =
-      CreateMemoryMapFromScopedFile(model_file_);
+  if (section_arrival_timeout_ > absl::ZeroDuration()) {
+    // The sections start past the header block, so it has arrived once the
+    // file is larger than it.
+    InitPhaseScope phase("Header arrival");
+    ABSL_CHECK_OK(WaitForArrival(kLitertLmHeaderMaxSize));
+  }
+
+  absl::StatusOr<std::unique_ptr<MemoryMappedFile>> mmap_status;
+  {
+    InitPhaseScope phase("Header mapping");
+    mmap_status = CreateHeaderMemoryMapFromScopedFile(model_file_);
+  }
 
   if (mmap_status.ok()) {
-    memory_mapped_file_ = std::move(mmap_status).value();
+    header_mapped_file_ = std::move(mmap_status).value();
     ABSL_LOG(INFO) << "mmap_status is ok";
-    ABSL_LOG(INFO) << "length: " << memory_mapped_file_->length();
+    ABSL_LOG(INFO) << "header length: " << header_mapped_file_->length();
   } else {
     ABSL_LOG(ERROR) << "Failed to create memory-mapped file: "
                     << mmap_status.status();
@@ -137,26 +232,277 @@ absl::Status LitertLmLoader::Initialize() {
   return absl::OkStatus();
 }
 
-std::optional<litert::OwningBufferRef<uint8_t>>
+std::optional<litert::BufferRef<uint8_t>>
 LitertLmLoader::GetHuggingFaceTokenizer() {
-  auto section_key = BufferKey(schema::AnySectionDataType_HF_Tokenizer_Zlib);
-  if (!section_buffers_.contains(section_key)) {
-    return std::nullopt;
+  auto json_section_key =
+      BufferKey(schema::AnySectionDataType_HF_Tokenizer_Json);
+  if (sections_.contains(json_section_key)) {
+    return GetSectionBuffer(sections_.at(json_section_key));
+  }
+  if (!hf_tokenizer_json_.has_value()) {
+    auto section_key = BufferKey(schema::AnySectionDataType_HF_Tokenizer_Zlib);
+    if (!sections_.contains(section_key)) {
+      return std::nullopt;
+    }
+    const BufferRef<uint8_t> section =
+        GetSectionBuffer(sections_.at(section_key));
+
+    std::vector<uint8_t> hf_tokenizer_data;
+    auto status = schema::DecompressData(section.Data(), section.Size(),
+                                         &hf_tokenizer_data);
+    if (!status.ok()) {
+      ABSL_LOG(ERROR) << "Failed to decompress HuggingFace tokenizer data: "
+                      << status;
+      return std::nullopt;
+    }
+    hf_tokenizer_json_ = std::move(hf_tokenizer_data);
   }
-  const auto& section = section_buffers_[section_key];
+  return BufferRef<uint8_t>(hf_tokenizer_json_->data(),
+                            hf_tokenizer_json_->size());
+}
 
-  std::vector<uint8_t> hf_tokenizer_data;
-  auto status = schema::DecompressData(section.Data(), section.Size(),
-                                       &hf_tokenizer_data);
+void LitertLmLoader::ReleaseTFLiteModel(ModelType model_type) {
+  auto section_key =
+      BufferKey(schema::AnySectionDataType_TFLiteModel, model_type);
+  if (!sections_.contains(section_key)) {
+    return;
+  }
+  Section& section = sections_.at(section_key);
+  if (section.mapping == nullptr) {
+    return;
+  }
+  // The released pages must not be read in again.
+  if (prefetcher_ != nullptr) {
+    prefetcher_->Cancel();
+  }
+  auto status = section.mapping->Advise(MemoryMappedFile::Advice::kDontNeed);
   if (!status.ok()) {
-    ABSL_LOG(ERROR) << "Failed to decompress HuggingFace tokenizer data: "
-                    << status;
-    return std::nullopt;
+    ABSL_LOG(WARNING) << "Failed to release the TFLite model "
+                      << ModelTypeToString(model_type) << ": " << status;
+  }
+}
+
+absl::StatusOr<uint64_t> LitertLmLoader::GetTFLiteModelResidentBytes(
+    ModelType model_type) {
+  auto section_key =
+      BufferKey(schema::AnySectionDataType_TFLiteModel, model_type);
+  RET_CHECK(sections_.contains(section_key))
+          .SetCode(absl::StatusCode::kNotFound)
+      << "No TFLite model " << ModelTypeToString(model_type);
+  Section& section = sections_.at(section_key);
+  RET_CHECK(section.mapping != nullptr && !section.is_compressed)
+          .SetCode(absl::StatusCode::kFailedPrecondition)
+      << "The TFLite model " << ModelTypeToString(model_type)
+      << " is not read from its mapping.";
+  ASSIGN_OR_RETURN(double resident_fraction,
+                   section.mapping->GetResidentFraction());
+  return static_cast<uint64_t>(resident_fraction * section.mapping->length());
+}
+
+bool LitertLmLoader::IsTFLiteModelPageAligned(ModelType model_type) const {
+  auto it = sections_.find(
+      BufferKey(schema::AnySectionDataType_TFLiteModel, model_type));
+  if (it == sections_.end()) {
+    return false;
+  }
+  const Section& section = it->second;
+  return !section.is_compressed &&
+         section.begin_offset % MemoryMappedFile::GetOffsetAlignment() == 0;
+}
+
+void LitertLmLoader::PrefetchTFLiteModel(ModelType model_type) {
+  auto section_key =
+      BufferKey(schema::AnySectionDataType_TFLiteModel, model_type);
+  if (!sections_.contains(section_key)) {
+    return;
+  }
+  Section& section = sections_.at(section_key);
+  if (section.is_compressed) {
+    return;
+  }
+  if (section.mapping == nullptr && section.is_model &&
+      weight_memory_options_.use_direct_io) {
+    // The section is read in whole when first accessed, which paging it in
+    // ahead would only compete with.
+    return;
+  }
+  if (section.mapping == nullptr && !HasArrived(section.end_offset)) {
+    ABSL_LOG(INFO) << "The TFLite model " << ModelTypeToString(model_type)
+                   << " has not arrived yet, so it is not prefetched.";
+    return;
+  }
+  const BufferRef<uint8_t> buffer = GetSectionBuffer(section);
+  if (buffer.Size() == 0) {
+    return;
+  }
+  if (prefetcher_ == nullptr) {
+    prefetcher_ = std::make_unique<MemoryPrefetcher>();
+  }
+  ABSL_LOG(INFO) << "Prefetching the TFLite model "
+                 << ModelTypeToString(model_type) << " of " << buffer.Size()
+                 << " bytes.";
+  prefetcher_->Prefetch(*section.mapping, buffer.Data(), buffer.Size());
+}
+
+const std::vector<litert::BufferRef<uint8_t>>&
+LitertLmLoader::GetLoraAdapters() {
+  if (!lora_adapters_.has_value()) {
+    lora_adapters_.emplace();
+    lora_adapters_->reserve(lora_adapter_sections_.size());
+    for (Section& section : lora_adapter_sections_) {
+      lora_adapters_->push_back(GetSectionBuffer(section));
+    }
+  }
+  return *lora_adapters_;
+}
+
+bool LitertLmLoader::HasArrived(uint64_t size) const {
+  absl::StatusOr<size_t> file_size = model_file_.GetSize();
+  return file_size.ok() && *file_size >= size;
+}
+
+absl::Status LitertLmLoader::WaitForArrival(uint64_t size) const {
+  const absl::Time deadline = absl::Now() + section_arrival_timeout_;
+  while (true) {
+    ASSIGN_OR_RETURN(size_t file_size, model_file_.GetSize());
+    if (file_size >= size) {
+      return absl::OkStatus();
+    }
+    if (absl::Now() >= deadline) {
+      return absl::DeadlineExceededError(absl::StrCat(
+          "The model file holds ", file_size, " bytes, but ", size,
+          " bytes are needed, and they did not arrive within ",
+          absl::FormatDuration(section_arrival_timeout_), "."));
+    }
+    absl::SleepFor(kArrivalPollInterval);
+  }
+}
+
+BufferRef<uint8_t> LitertLmLoader::GetSectionBuffer(Section& section) {
+  if (section.mapping != nullptr) {
+    return section.buffer;
+  }
+  absl::Status arrival_status;
+  {
+    InitPhaseScope phase(absl::StrCat("Section arrival: ", section.name));
+    arrival_status = WaitForArrival(section.end_offset);
+  }
+  if (!arrival_status.ok()) {
+    ABSL_LOG(ERROR) << "The section [" << section.begin_offset << ", "
+                    << section.end_offset << ") is not in the file: "
+                    << arrival_status;
+    return BufferRef<uint8_t>();
+  }
+  // The mappings must start on a page, so the page holding the beginning of
+  // the section is mapped as well.
+  const uint64_t alignment = MemoryMappedFile::GetOffsetAlignment();
+  const uint64_t map_offset =
+      section.begin_offset - section.begin_offset % alignment;
+  absl::StatusOr<std::unique_ptr<MemoryMappedFile>> mapping;
+  if (section.is_model && !section.is_compressed &&
+      weight_memory_options_.use_direct_io) {
+    InitPhaseScope phase(absl::StrCat("Section read: ", section.name));
+    mapping = ReadFileWithIoUring(model_file_.file(), map_offset,
+                                  section.end_offset - map_offset);
+    if (!mapping.ok()) {
+      ABSL_LOG(WARNING) << "Failed to read the section with direct I/O, "
+                           "mapping it instead: "
+                        << mapping.status();
+    }
   }
+  if (!mapping.ok()) {
+    InitPhaseScope phase(absl::StrCat("Section mapping: ", section.name));
+    mapping = MemoryMappedFile::Create(model_file_.file(), map_offset,
+                                       section.end_offset - map_offset, "",
+                                       section.advice);
+  }
+  if (!mapping.ok()) {
+    ABSL_LOG(ERROR) << "Failed to map the section ["
+                    << section.begin_offset << ", " << section.end_offset
+                    << "): " << mapping.status();
+    return BufferRef<uint8_t>();
+  }
+  uint8_t* section_data = static_cast<uint8_t*>((*mapping)->data()) +
+                          (section.begin_offset - map_offset);
+  const uint64_t section_size = section.end_offset - section.begin_offset;
+  if (section.is_compressed) {
+    absl::Status status;
+    {
+      InitPhaseScope phase(
+          absl::StrCat("Section decompression: ", section.name));
+      status = DecompressSection(section_data, section_size, section);
+    }
+    if (!status.ok()) {
+      ABSL_LOG(ERROR) << "Failed to decompress the section ["
+                      << section.begin_offset << ", " << section.end_offset
+                      << "): " << status;
+      return BufferRef<uint8_t>();
+    }
+    // The compressed pages are not read again.
+    status = (*mapping)->Advise(MemoryMappedFile::Advice::kDontNeed);
+    if (!status.ok()) {
+      ABSL_LOG(WARNING) << "Failed to release the compressed section: "
+                        << status;
+    }
+    section.mapping = std::move(mapping).value();
+    return section.buffer;
+  }
+  // The weight memory options are best effort, the section is usable as
+  // mapped either way.
+  if (section.is_model && weight_memory_options_.use_huge_pages) {
+    auto status = (*mapping)->Advise(MemoryMappedFile::Advice::kHugePage);
+    if (!status.ok()) {
+      ABSL_LOG(WARNING) << "Failed to back the section with huge pages: "
+                        << status;
+    }
+  }
+  if (section.is_model && weight_memory_options_.lock_in_memory) {
+    auto status = (*mapping)->Lock();
+    if (!status.ok()) {
+      ABSL_LOG(WARNING) << "Failed to lock the section in memory: " << status;
+    }
+  }
+  section.mapping = std::move(mapping).value();
+  section.buffer = BufferRef<uint8_t>(section_data, section_size);
+  return section.buffer;
+}
 
-  return OwningBufferRef<uint8_t>{
-      static_cast<const uint8_t*>(hf_tokenizer_data.data()),
-      hf_tokenizer_data.size()};
+absl::Status LitertLmLoader::DecompressSection(const uint8_t* data,
+                                               uint64_t size,
+                                               Section& section) {
+  ASSIGN_OR_RETURN(const schema::ChunkIndex index,
+                   schema::ReadChunkIndex(data, size));
+  // The chunks are decompressed straight into the section buffer, one per
+  // core at a time.
+  auto decompress = [data, size](uint8_t* output,
+                                 uint64_t output_size) -> absl::Status {
+    WorkStealingThreadPool pool("section_decompression",
+                                std::thread::hardware_concurrency());
+    return schema::DecompressChunked(data, size, output, output_size, &pool);
+  };
+  if (!weight_memory_options_.shared_memory_dir.empty()) {
+    // The processes loading the same section share one decompressed copy.
+    auto shared_mapping = MapOrCreateSharedMemoryFile(
+        weight_memory_options_.shared_memory_dir,
+        ComputeSharedMemoryKey(SectionFingerprint(data, size, index)),
+        index.uncompressed_size, decompress);
+    if (shared_mapping.ok()) {
+      section.shared_mapping = std::move(shared_mapping).value();
+      section.buffer = BufferRef<uint8_t>(
+          static_cast<uint8_t*>(section.shared_mapping->data()),
+          section.shared_mapping->length());
+      return absl::OkStatus();
+    }
+    ABSL_LOG(WARNING) << "Failed to share the decompressed section, keeping "
+                         "it in the process memory: "
+                      << shared_mapping.status();
+  }
+  section.decompressed.resize(index.uncompressed_size);
+  RETURN_IF_ERROR(
+      decompress(section.decompressed.data(), section.decompressed.size()));
+  section.buffer = BufferRef<uint8_t>(section.decompressed.data(),
+                                      section.decompressed.size());
+  return absl::OkStatus();
 }
 
 }  // namespace litert::lm
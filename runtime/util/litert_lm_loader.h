@@ -21,15 +21,21 @@
 #include <functional>
 #include <memory>
 #include <optional>
+#include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/log/absl_check.h"  // from @com_google_absl
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
 #include "litert/cc/litert_buffer_ref.h"  // from @litert
 #include "runtime/components/model_resources.h"
+#include "runtime/executor/executor_settings_base.h"
 #include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/memory_prefetcher.h"
 #include "runtime/util/scoped_file.h"
 #include "schema/core/litertlm_header_schema_generated.h"
 
@@ -77,13 +83,31 @@ struct BufferKeyHash {
 };
 
 // A class to load the Litert LM model from the .litertlm file. The loader will
-// read the model header from and map the sections to the section buffers.
+// read the model header from the file, and map each section on its first
+// access only, such that the sections a backend never reads, e.g. a model for
+// another backend, are never mapped nor paged in.
+//
+// The model file may still be arriving, e.g. downloaded on first use, as long
+// as it grows in order. With a positive `section_arrival_timeout`, the loader
+// waits for the header to land before reading it, and for each section to land
+// before mapping it, such that the model is served once the sections it needs
+// first are in, e.g. the tokenizer and the main model, before the optional
+// ones, e.g. a draft model or the LoRA adapters. See the
+// order_for_progressive_loading option of the writer.
 class LitertLmLoader {
  public:
   // Creates a LitertLmLoader from the model file. The loader will read the
-  // model header from and map the sections to the section buffers.
-  explicit LitertLmLoader(ScopedFile model_file)
-      : model_file_(std::move(model_file)) {
+  // model header from and record the sections of the file. The TFLite models
+  // are held in memory as `weight_memory_options` say once mapped. Each
+  // section missing from the file is waited for up to
+  // `section_arrival_timeout`.
+  explicit LitertLmLoader(
+      ScopedFile model_file,
+      WeightMemoryOptions weight_memory_options = WeightMemoryOptions(),
+      absl::Duration section_arrival_timeout = absl::ZeroDuration())
+      : model_file_(std::move(model_file)),
+        weight_memory_options_(weight_memory_options),
+        section_arrival_timeout_(section_arrival_timeout) {
     ABSL_CHECK_OK(Initialize());
   }
 
@@ -91,43 +115,127 @@ class LitertLmLoader {
   // If not found, returns std::nullopt.
   std::optional<litert::BufferRef<uint8_t>> GetSentencePieceTokenizer() {
     auto section_key = BufferKey(schema::AnySectionDataType_SP_Tokenizer);
-    if (!section_buffers_.contains(section_key)) {
+    if (!sections_.contains(section_key)) {
       return std::nullopt;
     }
-    return section_buffers_[section_key];
+    return GetSectionBuffer(sections_.at(section_key));
   }
 
-  // Returns the tokenizer section buffer for the HuggingFace tokenizer.
-  // If not found, returns std::nullopt.
-  std::optional<litert::OwningBufferRef<uint8_t>> GetHuggingFaceTokenizer();
+  // Returns the JSON config of the HuggingFace tokenizer. An uncompressed
+  // section is returned as mapped, while a compressed one is inflated on the
+  // first call and kept by the loader. If not found, returns std::nullopt.
+  std::optional<litert::BufferRef<uint8_t>> GetHuggingFaceTokenizer();
 
-  // Returns the TFLite model section buffer.
+  // Returns the TFLite model section buffer. The embedders are mapped for
+  // random reads, and the other models for sequential ones. Returns an empty
+  // buffer if the model is not in the file.
   litert::BufferRef<uint8_t> GetTFLiteModel(ModelType model_type) {
-    return section_buffers_[BufferKey(
-        schema::AnySectionDataType_TFLiteModel, model_type)];
+    auto section_key =
+        BufferKey(schema::AnySectionDataType_TFLiteModel, model_type);
+    if (!sections_.contains(section_key)) {
+      return BufferRef<uint8_t>();
+    }
+    return GetSectionBuffer(sections_.at(section_key));
   };
 
+  // Advises the OS that the TFLite model section is not read any more, e.g.
+  // once its weights are uploaded to the GPU, such that its pages are dropped.
+  // They are read from the file again if the model is accessed later.
+  void ReleaseTFLiteModel(ModelType model_type);
+
+  // Returns the number of bytes of the mapped TFLite model section which are
+  // in RAM. Fails if the section is not read from its mapping, e.g. when it is
+  // compressed, or the platform cannot tell.
+  absl::StatusOr<uint64_t> GetTFLiteModelResidentBytes(ModelType model_type);
+
+  // Returns whether the TFLite model section starts on a page of the file and
+  // is used as stored, i.e. uncompressed, such that its buffer is page-aligned
+  // in its mapping. Returns false if the model is not in the file.
+  bool IsTFLiteModelPageAligned(ModelType model_type) const;
+
+  // Maps the TFLite model section and reads it in on a background thread, such
+  // that its disk reads overlap with the rest of the loading. The compressed
+  // sections are decompressed on their first access instead, and the sections
+  // which have not arrived yet are not waited for.
+  void PrefetchTFLiteModel(ModelType model_type);
+
+  // Returns the LoRA adapter section buffers, each holding a serialized
+  // schema::LoraAdapter, in file order.
+  const std::vector<litert::BufferRef<uint8_t>>& GetLoraAdapters();
+
   // Returns the tokenizer section buffer.
   litert::BufferRef<uint8_t> GetLlmMetadata() {
-    return section_buffers_[BufferKey(
-        schema::AnySectionDataType_LlmMetadataProto)];
+    auto section_key = BufferKey(schema::AnySectionDataType_LlmMetadataProto);
+    if (!sections_.contains(section_key)) {
+      return BufferRef<uint8_t>();
+    }
+    return GetSectionBuffer(sections_.at(section_key));
   }
 
  private:
+  // A section of the file, mapped on its first access.
+  struct Section {
+    // The data type of the section, and its model type if any, to name its
+    // init phases.
+    std::string name;
+    uint64_t begin_offset = 0;
+    uint64_t end_offset = 0;
+    // How the section is read once mapped.
+    MemoryMappedFile::Advice advice = MemoryMappedFile::Advice::kNormal;
+    // Whether the section holds a TFLite model, to which the weight memory
+    // options apply.
+    bool is_model = false;
+    // The mapping from the page holding begin_offset to end_offset, and the
+    // buffer of the section in it, once mapped.
+    std::unique_ptr<MemoryMappedFile> mapping;
+    BufferRef<uint8_t> buffer;
+    // Whether the section is chunk compressed, in which case the buffer is
+    // the section decompressed into `decompressed` instead of the mapping, or
+    // into `shared_mapping` if the weight memory options set a shared memory
+    // directory.
+    bool is_compressed = false;
+    std::vector<uint8_t> decompressed;
+    std::unique_ptr<MemoryMappedFile> shared_mapping;
+  };
+
   // Initializes the LitertLmLoader. Includes reading the model header and
-  // mapping the sections to the section buffers.
+  // recording the sections.
   absl::Status Initialize();
-  // Maps the sections to the section buffers.
+  // Records the sections listed in the header.
   absl::Status MapSections();
+  // Returns the buffer of the section, mapping it first if needed, once it has
+  // arrived. Returns an empty buffer if the section can't be mapped.
+  BufferRef<uint8_t> GetSectionBuffer(Section& section);
+  // Returns whether the first `size` bytes of the model file have arrived.
+  bool HasArrived(uint64_t size) const;
+  // Waits up to section_arrival_timeout_ for the first `size` bytes of the
+  // model file to arrive, as mapping past its end would fault.
+  absl::Status WaitForArrival(uint64_t size) const;
+  // Decompresses the chunk compressed section of "size" bytes at "data" into
+  // its buffer, on a thread pool. The decompressed section is shared with the
+  // other processes through a file of the shared memory directory, if set.
+  absl::Status DecompressSection(const uint8_t* data, uint64_t size,
+                                 Section& section);
+
   // The model file to be loaded.
   ScopedFile model_file_;
-  // The model_file_ mapped to a MemoryMappedFile.
-  ::std::unique_ptr<MemoryMappedFile> memory_mapped_file_;
+  const WeightMemoryOptions weight_memory_options_;
+  const absl::Duration section_arrival_timeout_;
+  // The header of model_file_ mapped to a MemoryMappedFile.
+  ::std::unique_ptr<MemoryMappedFile> header_mapped_file_;
 
   // TODO (b/413793273): Add the extra names to the key to differentiate
   // between the TFLite models.
-  ::std::unordered_map<BufferKey, BufferRef<uint8_t>, BufferKeyHash>
-      section_buffers_;
+  ::std::unordered_map<BufferKey, Section, BufferKeyHash> sections_;
+  // A file may hold several LoRA adapters, so they are not in sections_.
+  std::vector<Section> lora_adapter_sections_;
+  // The buffers of lora_adapter_sections_, once mapped.
+  std::optional<std::vector<BufferRef<uint8_t>>> lora_adapters_;
+  // The inflated HF_Tokenizer_Zlib section, once read.
+  std::optional<std::vector<uint8_t>> hf_tokenizer_json_;
+  // Reads the prefetched sections in, once one is. Declared last, such that
+  // it is stopped before the sections are unmapped.
+  std::unique_ptr<MemoryPrefetcher> prefetcher_;
 };
 
 }  // namespace litert::lm
@@ -14,10 +14,19 @@
 
 #include "runtime/util/litert_lm_loader.h"
 
+#include <cstddef>
 #include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <ios>
+#include <iterator>
+#include <string>
+#include <thread>  // NOLINT
 #include <utility>
 
 #include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
 #include "runtime/components/model_resources.h"
 #include "runtime/util/scoped_file.h"
 
@@ -45,9 +54,159 @@ TEST(LitertLmLoaderTest, InitializeWithHuggingFaceFile) {
   auto model_file = ScopedFile::Open(model_path.string());
   ASSERT_TRUE(model_file.ok());
   LitertLmLoader loader(std::move(model_file.value()));
-  ASSERT_GT(loader.GetHuggingFaceTokenizer()->Size(), 0);
+  auto hf_tokenizer = loader.GetHuggingFaceTokenizer();
+  ASSERT_TRUE(hf_tokenizer);
+  ASSERT_GT(hf_tokenizer->Size(), 0);
+  // The compressed tokenizer is inflated once.
+  EXPECT_EQ(loader.GetHuggingFaceTokenizer()->Data(), hf_tokenizer->Data());
   ASSERT_FALSE(loader.GetSentencePieceTokenizer());
 }
 
+TEST(LitertLmLoaderTest, MapsTheSectionsOnFirstAccess) {
+  const auto model_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm.litertlm";
+  auto model_file = ScopedFile::Open(model_path.string());
+  ASSERT_TRUE(model_file.ok());
+  LitertLmLoader loader(std::move(model_file.value()));
+  auto model = loader.GetTFLiteModel(ModelType::kTfLitePrefillDecode);
+  ASSERT_GT(model.Size(), 0);
+  // The section is mapped once.
+  EXPECT_EQ(
+      loader.GetTFLiteModel(ModelType::kTfLitePrefillDecode).Data(),
+      model.Data());
+  const std::string contents(model.StrView());
+  // The released pages are read from the file again.
+  loader.ReleaseTFLiteModel(ModelType::kTfLitePrefillDecode);
+  EXPECT_EQ(model.StrView(), contents);
+  // The models not in the file are not mapped.
+  EXPECT_EQ(loader.GetTFLiteModel(ModelType::kTfLiteDraft).Size(), 0);
+}
+
+TEST(LitertLmLoaderTest, PrefetchesTheTFLiteModel) {
+  const auto model_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm.litertlm";
+  auto model_file = ScopedFile::Open(model_path.string());
+  ASSERT_TRUE(model_file.ok());
+  LitertLmLoader loader(std::move(model_file.value()));
+  loader.PrefetchTFLiteModel(ModelType::kTfLitePrefillDecode);
+  // The prefetched section is the one returned, read concurrently.
+  auto model = loader.GetTFLiteModel(ModelType::kTfLitePrefillDecode);
+  ASSERT_GT(model.Size(), 0);
+  EXPECT_EQ(std::string(model.StrView()).size(), model.Size());
+  // The models not in the file are not prefetched.
+  loader.PrefetchTFLiteModel(ModelType::kTfLiteDraft);
+}
+
+TEST(LitertLmLoaderTest, CountsTheResidentBytesOfTheTFLiteModel) {
+  const auto model_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm.litertlm";
+  auto model_file = ScopedFile::Open(model_path.string());
+  ASSERT_TRUE(model_file.ok());
+  LitertLmLoader loader(std::move(model_file.value()));
+  auto model = loader.GetTFLiteModel(ModelType::kTfLitePrefillDecode);
+  ASSERT_GT(model.Size(), 0);
+  EXPECT_EQ(std::string(model.StrView()).size(), model.Size());
+  // The section read is resident, up to the pages it shares with the others.
+  auto resident_bytes =
+      loader.GetTFLiteModelResidentBytes(ModelType::kTfLitePrefillDecode);
+  ASSERT_TRUE(resident_bytes.ok());
+  EXPECT_GT(*resident_bytes, 0);
+  // The models not in the file have no resident bytes.
+  EXPECT_EQ(loader.GetTFLiteModelResidentBytes(ModelType::kTfLiteDraft)
+                .status()
+                .code(),
+            absl::StatusCode::kNotFound);
+}
+
+TEST(LitertLmLoaderTest, TellsWhetherTheTFLiteModelIsPageAligned) {
+  const auto model_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm.litertlm";
+  auto model_file = ScopedFile::Open(model_path.string());
+  ASSERT_TRUE(model_file.ok());
+  LitertLmLoader loader(std::move(model_file.value()));
+  // The sections are written on 16KB blocks.
+  EXPECT_TRUE(loader.IsTFLiteModelPageAligned(ModelType::kTfLitePrefillDecode));
+  EXPECT_FALSE(loader.IsTFLiteModelPageAligned(ModelType::kTfLiteDraft));
+}
+
+// The header block of the file, ahead of the sections.
+constexpr size_t kHeaderBlockSize = 16 * 1024;
+
+// Returns the contents of the test model file.
+std::string ReadTestModel() {
+  const auto model_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm.litertlm";
+  std::ifstream file(model_path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file), {});
+}
+
+TEST(LitertLmLoaderTest, WaitsForTheSectionsToArrive) {
+  const std::string contents = ReadTestModel();
+  ASSERT_GT(contents.size(), kHeaderBlockSize);
+  const auto path =
+      std::filesystem::path(::testing::TempDir()) / "arriving.litertlm";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write(contents.data(), kHeaderBlockSize);
+  }
+  // Stands for the download of the rest of the file.
+  std::thread download([&]() {
+    absl::SleepFor(absl::Milliseconds(100));
+    std::ofstream file(path, std::ios::binary | std::ios::app);
+    file.write(contents.data() + kHeaderBlockSize,
+               contents.size() - kHeaderBlockSize);
+  });
+  auto model_file = ScopedFile::Open(path.string());
+  ASSERT_TRUE(model_file.ok());
+  LitertLmLoader loader(std::move(model_file.value()), WeightMemoryOptions(),
+                        /*section_arrival_timeout=*/absl::Seconds(30));
+  auto model = loader.GetTFLiteModel(ModelType::kTfLitePrefillDecode);
+  download.join();
+  ASSERT_GT(model.Size(), 0);
+  EXPECT_NE(contents.find(model.StrView()), std::string::npos);
+}
+
+TEST(LitertLmLoaderTest, ReadsTheModelsWithDirectIo) {
+  const std::string contents = ReadTestModel();
+  const auto model_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm.litertlm";
+  auto model_file = ScopedFile::Open(model_path.string());
+  ASSERT_TRUE(model_file.ok());
+  WeightMemoryOptions weight_memory_options;
+  weight_memory_options.use_direct_io = true;
+  LitertLmLoader loader(std::move(model_file.value()), weight_memory_options);
+  // The section is read, or mapped where direct I/O is not available, the
+  // same bytes either way.
+  loader.PrefetchTFLiteModel(ModelType::kTfLitePrefillDecode);
+  auto model = loader.GetTFLiteModel(ModelType::kTfLitePrefillDecode);
+  ASSERT_GT(model.Size(), 0);
+  EXPECT_NE(contents.find(model.StrView()), std::string::npos);
+  const std::string model_contents(model.StrView());
+  loader.ReleaseTFLiteModel(ModelType::kTfLitePrefillDecode);
+  EXPECT_EQ(model.StrView(), model_contents);
+}
+
+TEST(LitertLmLoaderTest, ReturnsAnEmptyBufferForAMissingSection) {
+  const std::string contents = ReadTestModel();
+  ASSERT_GT(contents.size(), kHeaderBlockSize);
+  const auto path =
+      std::filesystem::path(::testing::TempDir()) / "truncated.litertlm";
+  {
+    std::ofstream file(path, std::ios::binary);
+    file.write(contents.data(), kHeaderBlockSize);
+  }
+  auto model_file = ScopedFile::Open(path.string());
+  ASSERT_TRUE(model_file.ok());
+  LitertLmLoader loader(std::move(model_file.value()), WeightMemoryOptions(),
+                        /*section_arrival_timeout=*/absl::Milliseconds(10));
+  EXPECT_EQ(loader.GetTFLiteModel(ModelType::kTfLitePrefillDecode).Size(), 0);
+}
+
 }  // namespace
 }  // namespace litert::lm
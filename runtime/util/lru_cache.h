@@ -0,0 +1,130 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_LRU_CACHE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_LRU_CACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <utility>
+
+#include "absl/container/node_hash_map.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// An LRU cache of `Value`s keyed by `Key`, which must be hashable with
+// absl::Hash, bounded by the total size of the stored values. The size of
+// each value is given by the caller when inserting it. The least recently
+// used entries are evicted first when a new entry does not fit.
+//
+// The returned pointers to the values are stable until their entry is erased
+// or evicted.
+//
+// The class is not thread-safe.
+template <typename Key, typename Value>
+class LruCache {
+ public:
+  explicit LruCache(size_t max_size_in_bytes)
+      : max_size_in_bytes_(max_size_in_bytes) {}
+
+  LruCache(const LruCache&) = delete;
+  LruCache& operator=(const LruCache&) = delete;
+
+  // Returns the value of `key`, or nullptr if there is none. The matched entry
+  // becomes the most recently used one. Every call is counted as either a hit
+  // or a miss.
+  Value* Lookup(const Key& key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      ++num_misses_;
+      return nullptr;
+    }
+    ++num_hits_;
+    order_.splice(order_.begin(), order_, it->second.position);
+    return &it->second.value;
+  }
+
+  // Stores `value`, of `size_in_bytes`, for `key`, replacing any existing
+  // entry for the same key. Returns the stored value, or nullptr if it is
+  // larger than the whole budget and so dropped.
+  Value* Insert(Key key, Value value, size_t size_in_bytes) {
+    Erase(key);
+    if (size_in_bytes > max_size_in_bytes_) {
+      return nullptr;
+    }
+    while (size_in_bytes_ + size_in_bytes > max_size_in_bytes_) {
+      EraseEntry(entries_.find(*order_.back()));
+    }
+    auto [it, inserted] = entries_.try_emplace(
+        std::move(key), Entry{.value = std::move(value),
+                              .size_in_bytes = size_in_bytes});
+    order_.push_front(&it->first);
+    it->second.position = order_.begin();
+    size_in_bytes_ += size_in_bytes;
+    return &it->second.value;
+  }
+
+  // Removes the entry of `key`, if any. Returns whether there was one.
+  bool Erase(const Key& key) {
+    auto it = entries_.find(key);
+    if (it == entries_.end()) {
+      return false;
+    }
+    EraseEntry(it);
+    return true;
+  }
+
+  // Removes all the entries. The hit and miss counters are kept.
+  void Clear() {
+    order_.clear();
+    entries_.clear();
+    size_in_bytes_ = 0;
+  }
+
+  int NumEntries() const { return entries_.size(); }
+  size_t SizeInBytes() const { return size_in_bytes_; }
+  size_t MaxSizeInBytes() const { return max_size_in_bytes_; }
+  int NumHits() const { return num_hits_; }
+  int NumMisses() const { return num_misses_; }
+
+ private:
+  struct Entry {
+    Value value;
+    size_t size_in_bytes;
+    // The position of the entry in `order_`.
+    typename std::list<const Key*>::iterator position;
+  };
+  using EntryMap = absl::node_hash_map<Key, Entry>;
+
+  void EraseEntry(typename EntryMap::iterator it) {
+    size_in_bytes_ -= it->second.size_in_bytes;
+    order_.erase(it->second.position);
+    entries_.erase(it);
+  }
+
+  const size_t max_size_in_bytes_;
+  size_t size_in_bytes_ = 0;
+  int num_hits_ = 0;
+  int num_misses_ = 0;
+
+  // The entries, whose nodes are stable, so that `order_` can point to their
+  // keys.
+  EntryMap entries_;
+  // The keys of the entries ordered from the most to the least recently used.
+  std::list<const Key*> order_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_LRU_CACHE_H_
@@ -0,0 +1,93 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/lru_cache.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace litert::lm {
+namespace {
+
+using ::testing::IsNull;
+using ::testing::NotNull;
+using ::testing::Pointee;
+
+TEST(LruCacheTest, LookupCountsHitsAndMisses) {
+  LruCache<std::vector<int>, std::string> cache(/*max_size_in_bytes=*/100);
+  EXPECT_THAT(cache.Insert({1, 2}, "a", 10), Pointee(std::string("a")));
+
+  EXPECT_THAT(cache.Lookup({1, 2}), Pointee(std::string("a")));
+  EXPECT_THAT(cache.Lookup({1}), IsNull());
+  EXPECT_EQ(cache.NumHits(), 1);
+  EXPECT_EQ(cache.NumMisses(), 1);
+  EXPECT_EQ(cache.NumEntries(), 1);
+  EXPECT_EQ(cache.SizeInBytes(), 10);
+}
+
+TEST(LruCacheTest, InsertEvictsLeastRecentlyUsed) {
+  LruCache<int, std::string> cache(/*max_size_in_bytes=*/20);
+  cache.Insert(1, "a", 10);
+  cache.Insert(2, "b", 10);
+  // Makes 1 the most recently used entry, so 2 is evicted.
+  ASSERT_THAT(cache.Lookup(1), NotNull());
+  cache.Insert(3, "c", 10);
+
+  EXPECT_THAT(cache.Lookup(1), NotNull());
+  EXPECT_THAT(cache.Lookup(2), IsNull());
+  EXPECT_THAT(cache.Lookup(3), NotNull());
+  EXPECT_EQ(cache.NumEntries(), 2);
+  EXPECT_EQ(cache.SizeInBytes(), 20);
+}
+
+TEST(LruCacheTest, InsertDropsEntryLargerThanBudget) {
+  LruCache<int, std::string> cache(/*max_size_in_bytes=*/20);
+  cache.Insert(1, "a", 10);
+  EXPECT_THAT(cache.Insert(2, "b", 21), IsNull());
+  EXPECT_THAT(cache.Lookup(1), NotNull());
+  EXPECT_EQ(cache.NumEntries(), 1);
+}
+
+TEST(LruCacheTest, InsertReplacesSameKey) {
+  LruCache<int, std::string> cache(/*max_size_in_bytes=*/20);
+  cache.Insert(1, "a", 10);
+  cache.Insert(1, "b", 15);
+  EXPECT_THAT(cache.Lookup(1), Pointee(std::string("b")));
+  EXPECT_EQ(cache.NumEntries(), 1);
+  EXPECT_EQ(cache.SizeInBytes(), 15);
+}
+
+TEST(LruCacheTest, EraseAndClearKeepTheCounters) {
+  LruCache<int, std::string> cache(/*max_size_in_bytes=*/20);
+  cache.Insert(1, "a", 10);
+  cache.Insert(2, "b", 10);
+  EXPECT_TRUE(cache.Erase(1));
+  EXPECT_FALSE(cache.Erase(1));
+  EXPECT_EQ(cache.SizeInBytes(), 10);
+  ASSERT_THAT(cache.Lookup(2), NotNull());
+
+  cache.Clear();
+  EXPECT_EQ(cache.NumEntries(), 0);
+  EXPECT_EQ(cache.SizeInBytes(), 0);
+  EXPECT_EQ(cache.NumHits(), 1);
+  // The budget is available again.
+  EXPECT_THAT(cache.Insert(3, "c", 20), NotNull());
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -19,6 +19,7 @@
 #include <cstdint>
 #include <memory>
 
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "runtime/util/scoped_file.h"
@@ -37,6 +38,24 @@ class MemoryMappedFile {
   MemoryMappedFile(const MemoryMappedFile&) = delete;
   MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
 
+  // How the mapped memory is going to be accessed, as a hint to the OS.
+  enum class Advice {
+    // No particular pattern.
+    kNormal,
+    // Read in order, e.g. the weights read once to be uploaded or packed.
+    kSequential,
+    // Read in no order, e.g. the rows of an embedding table.
+    kRandom,
+    // Read soon, so the OS starts reading it in.
+    kWillNeed,
+    // Not read any more. The pages read so far are dropped, and read from the
+    // file again if accessed.
+    kDontNeed,
+    // Backed by transparent huge pages where possible, to cut the TLB misses
+    // of large mappings read over and over.
+    kHugePage,
+  };
+
   // Gets the required alignment for a file offset passed to Create().
   static size_t GetOffsetAlignment();
 
@@ -45,10 +64,11 @@ class MemoryMappedFile {
       absl::string_view path);
   // Creates a MemoryMappedFile object from the platform file handle. This does
   // not take ownership of the passed handle. The `key` passed here is an
-  // optimization when mapping the same file with different offsets.
+  // optimization when mapping the same file with different offsets. The
+  // `advice` is given for the mapped memory upfront.
   static absl::StatusOr<std::unique_ptr<MemoryMappedFile>> Create(
       ScopedFile::PlatformFile file, uint64_t offset = 0u, uint64_t length = 0u,
-      absl::string_view key = "");
+      absl::string_view key = "", Advice advice = Advice::kWillNeed);
 
   // Creates a mutable MemoryMappedFile object, any modification through data()
   // pointer will be carried over to the underlying path.
@@ -69,6 +89,24 @@ class MemoryMappedFile {
   // Returns a pointer to the file data.
   virtual void* data() = 0;
 
+  // Advises the OS of how the mapped memory is going to be accessed. The
+  // advices the platform does not support are ignored.
+  virtual absl::Status Advise(Advice advice) { return absl::OkStatus(); }
+
+  // Locks the mapped memory in RAM, reading it in first, such that it is
+  // never paged out until the mapping is destroyed. Fails if the process is
+  // not allowed to lock that much memory. No-op if the platform does not
+  // support it.
+  virtual absl::Status Lock() { return absl::OkStatus(); }
+
+  // Returns the fraction of the mapped memory which is in RAM, e.g. whether
+  // the file is still in the page cache before it is read. Fails if the
+  // platform cannot tell.
+  virtual absl::StatusOr<double> GetResidentFraction() {
+    return absl::UnimplementedError(
+        "The resident memory is not known on this platform.");
+  }
+
  protected:
   // Protected default constructor to prevent direct instantiation
   MemoryMappedFile() = default;
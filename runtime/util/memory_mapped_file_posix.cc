@@ -21,6 +21,7 @@
 #include <cstdio>
 #include <cstring>
 #include <memory>
+#include <vector>
 
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
@@ -32,6 +33,29 @@
 namespace litert::lm {
 namespace {
 
+int ToMadvise(MemoryMappedFile::Advice advice) {
+  switch (advice) {
+    case MemoryMappedFile::Advice::kNormal:
+      return MADV_NORMAL;
+    case MemoryMappedFile::Advice::kSequential:
+      return MADV_SEQUENTIAL;
+    case MemoryMappedFile::Advice::kRandom:
+      return MADV_RANDOM;
+    case MemoryMappedFile::Advice::kWillNeed:
+      return MADV_WILLNEED;
+    case MemoryMappedFile::Advice::kDontNeed:
+      return MADV_DONTNEED;
+    case MemoryMappedFile::Advice::kHugePage:
+#ifdef MADV_HUGEPAGE
+      return MADV_HUGEPAGE;
+#else
+      // Not supported by the platform, so nothing particular is advised.
+      return MADV_NORMAL;
+#endif  // MADV_HUGEPAGE
+  }
+  return MADV_NORMAL;
+}
+
 class MemoryMappedFilePosix : public MemoryMappedFile {
  public:
   MemoryMappedFilePosix(uint64_t length, void* data)
@@ -79,6 +103,40 @@ class MemoryMappedFilePosix : public MemoryMappedFile {
 
   void* data() override { return data_; }
 
+  absl::Status Advise(Advice advice) override {
+    RET_CHECK_EQ(madvise(data_, length_, ToMadvise(advice)), 0)
+        << "madvise failed, error: " << strerror(errno);
+    return absl::OkStatus();
+  }
+
+  absl::Status Lock() override {
+    RET_CHECK_EQ(mlock(data_, length_), 0)
+            .SetCode(absl::StatusCode::kResourceExhausted)
+        << "mlock failed, error: " << strerror(errno);
+    // The pages are unlocked when unmapped.
+    return absl::OkStatus();
+  }
+
+  absl::StatusOr<double> GetResidentFraction() override {
+    if (length_ == 0) {
+      return 1.0;
+    }
+    const size_t page_size = getpagesize();
+    const size_t num_pages = (length_ + page_size - 1) / page_size;
+#ifdef __APPLE__
+    std::vector<char> residency(num_pages);
+#else
+    std::vector<unsigned char> residency(num_pages);
+#endif  // __APPLE__
+    RET_CHECK_EQ(mincore(data_, length_, residency.data()), 0)
+        << "mincore failed, error: " << strerror(errno);
+    size_t num_resident_pages = 0;
+    for (const auto page : residency) {
+      num_resident_pages += page & 1;
+    }
+    return static_cast<double>(num_resident_pages) / num_pages;
+  }
+
  private:
   uint64_t length_;
   void* data_;
@@ -98,7 +156,8 @@ absl::StatusOr<std::unique_ptr<MemoryMappedFile>> MemoryMappedFile::Create(
 
 // static
 absl::StatusOr<std::unique_ptr<MemoryMappedFile>> MemoryMappedFile::Create(
-    int file, uint64_t offset, uint64_t length, absl::string_view key) {
+    int file, uint64_t offset, uint64_t length, absl::string_view key,
+    Advice advice) {
   RET_CHECK_EQ(offset % GetOffsetAlignment(), 0)
       << "Offset must be a multiple of page size : " << offset << ", "
       << GetOffsetAlignment();
@@ -121,9 +180,9 @@ absl::StatusOr<std::unique_ptr<MemoryMappedFile>> MemoryMappedFile::Create(
 #endif
   RET_CHECK_NE(data, MAP_FAILED) << "Failed to map, error: " << strerror(errno);
   RET_CHECK_NE(data, nullptr) << "Failed to map.";
-  RET_CHECK_EQ(madvise(data, length, MADV_WILLNEED), 0) << "madvise failed.";
-
-  return std::make_unique<MemoryMappedFilePosix>(length, data);
+  auto mapped_file = std::make_unique<MemoryMappedFilePosix>(length, data);
+  RETURN_IF_ERROR(mapped_file->Advise(advice));
+  return mapped_file;
 }
 
 absl::StatusOr<std::unique_ptr<MemoryMappedFile>>
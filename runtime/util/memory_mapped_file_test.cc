@@ -25,6 +25,7 @@
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "runtime/util/scoped_file.h"
@@ -33,6 +34,8 @@
 namespace litert::lm {
 namespace {
 
+using ::testing::status::IsOkAndHolds;
+
 void WriteFile(absl::string_view path, absl::string_view contents) {
   std::ofstream ofstr(std::string(path), std::ios::out);
   ofstr << contents;
@@ -152,6 +155,53 @@ TEST(MemoryMappedFile, SucceedsMappingLengthAndOffset) {
   }
 }
 
+TEST(MemoryMappedFile, KeepsContentsAcrossAdvices) {
+  auto path = std::filesystem::path(::testing::TempDir()) / "file.txt";
+  WriteFile(path.string(), "foo bar");
+
+  auto scoped_file = *ScopedFile::Open(path.string());
+  auto file = MemoryMappedFile::Create(scoped_file.file(), 0, 0, "",
+                                       MemoryMappedFile::Advice::kRandom);
+  ASSERT_OK(file);
+  CheckContents(**file, "foo bar");
+  EXPECT_OK((*file)->Advise(MemoryMappedFile::Advice::kSequential));
+  CheckContents(**file, "foo bar");
+  // The dropped pages are read from the file again.
+  EXPECT_OK((*file)->Advise(MemoryMappedFile::Advice::kDontNeed));
+  CheckContents(**file, "foo bar");
+}
+
+TEST(MemoryMappedFile, KeepsContentsInHugePagesAndLocked) {
+  auto path = std::filesystem::path(::testing::TempDir()) / "file.txt";
+  WriteFile(path.string(), "foo bar");
+
+  auto scoped_file = *ScopedFile::Open(path.string());
+  auto file = MemoryMappedFile::Create(scoped_file.file(), 0, 0, "",
+                                       MemoryMappedFile::Advice::kHugePage);
+  ASSERT_OK(file);
+  CheckContents(**file, "foo bar");
+  // A single page is within the default memory lock limit.
+  EXPECT_OK((*file)->Lock());
+  CheckContents(**file, "foo bar");
+}
+
+TEST(MemoryMappedFile, ReportsTheResidentFraction) {
+  auto path = std::filesystem::path(::testing::TempDir()) / "file.txt";
+  WriteFile(path.string(), "foo bar");
+
+  auto file = MemoryMappedFile::Create(path.string());
+  ASSERT_OK(file);
+  CheckContents(**file, "foo bar");
+  absl::StatusOr<double> resident_fraction = (*file)->GetResidentFraction();
+#ifdef _WIN32
+  EXPECT_EQ(resident_fraction.status().code(),
+            absl::StatusCode::kUnimplemented);
+#else
+  // The page just read is in RAM.
+  EXPECT_THAT(resident_fraction, IsOkAndHolds(1.0));
+#endif  // _WIN32
+}
+
 TEST(MemoryMappedFile, FailsMappingNonExistentFile) {
   auto path = std::filesystem::path(::testing::TempDir()) / "bad.txt";
   ASSERT_FALSE(MemoryMappedFile::Create(path.string()).ok());
@@ -146,7 +146,8 @@ absl::StatusOr<std::unique_ptr<MemoryMappedFile>> MemoryMappedFile::Create(
 
 // static
 absl::StatusOr<std::unique_ptr<MemoryMappedFile>> MemoryMappedFile::Create(
-    HANDLE file, uint64_t offset, uint64_t length, absl::string_view key) {
+    HANDLE file, uint64_t offset, uint64_t length, absl::string_view key,
+    Advice advice) {
   return CreateImpl(file, offset, length, key.empty() ? nullptr : key.data(),
                     /*writable=*/false);
 }
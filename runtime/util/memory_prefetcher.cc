@@ -0,0 +1,77 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/util/memory_prefetcher.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/framework/thread_options.h"
+#include "runtime/framework/threadpool.h"
+#include "runtime/util/memory_mapped_file.h"
+
+namespace litert::lm {
+namespace {
+
+// The stride of the touched bytes, at most the size of a page.
+constexpr size_t kTouchStride = 4096;
+// The bytes touched between two checks of the cancellation.
+constexpr size_t kTouchBlockSize = 4 * 1024 * 1024;
+
+}  // namespace
+
+MemoryPrefetcher::MemoryPrefetcher()
+    : pool_("prefetcher", /*max_num_threads=*/1) {}
+
+MemoryPrefetcher::~MemoryPrefetcher() { cancelled_ = true; }
+
+void MemoryPrefetcher::Prefetch(MemoryMappedFile& mapping, const void* data,
+                                size_t size) {
+  // The advice starts the reads in the OS, while the pages are touched.
+  auto status = mapping.Advise(MemoryMappedFile::Advice::kWillNeed);
+  if (!status.ok()) {
+    ABSL_LOG(WARNING) << "Failed to advise the prefetched memory: " << status;
+  }
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  status = pool_.Schedule([this, bytes, size]() { TouchPages(bytes, size); },
+                          TaskPriority::kLow);
+  if (!status.ok()) {
+    ABSL_LOG(WARNING) << "Failed to schedule the prefetch: " << status;
+  }
+}
+
+absl::Status MemoryPrefetcher::WaitUntilDone(absl::Duration timeout) {
+  return pool_.WaitUntilDone(timeout);
+}
+
+void MemoryPrefetcher::TouchPages(const uint8_t* data, size_t size) {
+  for (size_t block = 0; block < size && !cancelled_;
+       block += kTouchBlockSize) {
+    const size_t block_end = std::min(size, block + kTouchBlockSize);
+    // The reads are volatile, so they are not optimized out.
+    uint8_t sum = 0;
+    for (size_t i = block; i < block_end; i += kTouchStride) {
+      sum += static_cast<const volatile uint8_t*>(data)[i];
+    }
+    static_cast<void>(sum);
+    num_prefetched_bytes_ += block_end - block;
+  }
+}
+
+}  // namespace litert::lm
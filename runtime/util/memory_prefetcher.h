@@ -0,0 +1,78 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_MEMORY_PREFETCHER_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_MEMORY_PREFETCHER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/framework/threadpool.h"
+#include "runtime/util/memory_mapped_file.h"
+
+namespace litert::lm {
+
+// Reads mapped memory in ahead of its first use, on a background thread, such
+// that the disk reads overlap with the rest of the loading, e.g. the weights
+// of a model read while the tokenizer is created. The OS is first advised to
+// read the memory in, and the thread then touches each of its pages in order,
+// which also covers the platforms ignoring the advice.
+//
+// The prefetches are cancelled when the prefetcher is destroyed, which must
+// happen before the mappings they read are.
+//
+// Example usage:
+//
+//   MemoryPrefetcher prefetcher;
+//   prefetcher.Prefetch(*mapping, section_data, section_size);
+//   ... // Other loading work.
+class MemoryPrefetcher {
+ public:
+  MemoryPrefetcher();
+
+  // Cancels the pending prefetches, and waits for the running one to stop.
+  ~MemoryPrefetcher();
+
+  // Reads the "size" bytes at "data", in "mapping", in the background. The
+  // bytes are only read, so they may be used concurrently.
+  void Prefetch(MemoryMappedFile& mapping, const void* data, size_t size);
+
+  // Stops the running and pending prefetches, e.g. once the memory is
+  // released. The later ones are not run either.
+  void Cancel() { cancelled_ = true; }
+
+  // Waits until the scheduled prefetches are done.
+  absl::Status WaitUntilDone(absl::Duration timeout);
+
+  // The number of bytes prefetched so far.
+  uint64_t num_prefetched_bytes() const { return num_prefetched_bytes_; }
+
+ private:
+  // Touches the pages of [data, data + size) until cancelled.
+  void TouchPages(const uint8_t* data, size_t size);
+
+  std::atomic<bool> cancelled_ = false;
+  std::atomic<uint64_t> num_prefetched_bytes_ = 0;
+  // Declared last, such that it is stopped before the members its tasks use
+  // are destroyed.
+  ThreadPool pool_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_MEMORY_PREFETCHER_H_
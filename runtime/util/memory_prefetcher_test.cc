@@ -0,0 +1,71 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/util/memory_prefetcher.h"
+
+#include <cstddef>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <ios>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/time/time.h"  // from @com_google_absl
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+void WriteFile(absl::string_view path, absl::string_view contents) {
+  std::ofstream ofstr(std::string(path), std::ios::out | std::ios::binary);
+  ofstr << contents;
+}
+
+TEST(MemoryPrefetcherTest, PrefetchesTheWholeRegion) {
+  auto path = std::filesystem::path(::testing::TempDir()) / "prefetched.bin";
+  const std::string contents(10 * 1024 * 1024 + 123, 'p');
+  WriteFile(path.string(), contents);
+  auto file = MemoryMappedFile::Create(path.string());
+  ASSERT_OK(file);
+
+  MemoryPrefetcher prefetcher;
+  prefetcher.Prefetch(**file, (*file)->data(), (*file)->length());
+  EXPECT_OK(prefetcher.WaitUntilDone(absl::Seconds(50)));
+  EXPECT_EQ(prefetcher.num_prefetched_bytes(), contents.size());
+  // The memory is unchanged.
+  EXPECT_EQ(absl::string_view(static_cast<const char*>((*file)->data()),
+                              (*file)->length()),
+            contents);
+}
+
+TEST(MemoryPrefetcherTest, CancelsThePrefetchesWhenDestroyed) {
+  auto path = std::filesystem::path(::testing::TempDir()) / "cancelled.bin";
+  WriteFile(path.string(), std::string(1024 * 1024, 'c'));
+  auto file = MemoryMappedFile::Create(path.string());
+  ASSERT_OK(file);
+  {
+    MemoryPrefetcher prefetcher;
+    for (int i = 0; i < 10; ++i) {
+      prefetcher.Prefetch(**file, (*file)->data(), (*file)->length());
+    }
+  }
+  // The mapping outlives the prefetcher, and is still readable.
+  EXPECT_EQ(static_cast<const char*>((*file)->data())[0], 'c');
+}
+
+}  // namespace
+}  // namespace litert::lm
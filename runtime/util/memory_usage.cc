@@ -0,0 +1,83 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/util/memory_usage.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+std::ostream& operator<<(std::ostream& os, MemoryLocation location) {
+  switch (location) {
+    case MemoryLocation::kHost:
+      return os << "host";
+    case MemoryLocation::kDevice:
+      return os << "device";
+  }
+  return os << "unknown";
+}
+
+void MemoryUsage::Add(absl::string_view component, MemoryLocation location,
+                      uint64_t size_in_bytes) {
+  sizes_[{std::string(component), location}] += size_in_bytes;
+}
+
+void MemoryUsage::Merge(const MemoryUsage& other) {
+  for (const auto& [key, size_in_bytes] : other.sizes_) {
+    sizes_[key] += size_in_bytes;
+  }
+}
+
+uint64_t MemoryUsage::GetSizeInBytes(absl::string_view component,
+                                     MemoryLocation location) const {
+  auto it = sizes_.find({std::string(component), location});
+  return it == sizes_.end() ? 0 : it->second;
+}
+
+uint64_t MemoryUsage::GetTotalSizeInBytes(MemoryLocation location) const {
+  uint64_t total_size_in_bytes = 0;
+  for (const auto& [key, size_in_bytes] : sizes_) {
+    if (key.second == location) {
+      total_size_in_bytes += size_in_bytes;
+    }
+  }
+  return total_size_in_bytes;
+}
+
+std::ostream& operator<<(std::ostream& os, const MemoryUsage& memory_usage) {
+  constexpr double kBytesPerMegabyte = 1024.0 * 1024.0;
+  os << "MemoryUsage:" << std::endl;
+  if (memory_usage.sizes().empty()) {
+    os << "  No memory recorded." << std::endl;
+    return os;
+  }
+  for (const auto& [key, size_in_bytes] : memory_usage.sizes()) {
+    os << "  " << key.first << " (" << key.second
+       << "): " << size_in_bytes / kBytesPerMegabyte << " MB" << std::endl;
+  }
+  for (MemoryLocation location :
+       {MemoryLocation::kHost, MemoryLocation::kDevice}) {
+    os << "  Total " << location << ": "
+       << memory_usage.GetTotalSizeInBytes(location) / kBytesPerMegabyte
+       << " MB" << std::endl;
+  }
+  return os;
+}
+
+}  // namespace litert::lm
@@ -0,0 +1,93 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_MEMORY_USAGE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_MEMORY_USAGE_H_
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+
+#include "absl/strings/string_view.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// Where the memory of a component is allocated.
+enum class MemoryLocation {
+  // The CPU memory, including the memory mapped files.
+  kHost,
+  // The memory of an accelerator, e.g. GPU buffers and textures.
+  kDevice,
+};
+std::ostream& operator<<(std::ostream& os, MemoryLocation location);
+
+// The names of the components the memory is accounted to, shared by all the
+// executors and resources such that the breakdowns compare across backends.
+//
+// The weights of the main model, and of the draft model if any, as mapped
+// from the model file or held on the device.
+inline constexpr absl::string_view kWeightsMemory = "weights";
+// The weights and the cached embeddings of the embedder models.
+inline constexpr absl::string_view kEmbedderMemory = "embedder";
+// The tokenizer model.
+inline constexpr absl::string_view kTokenizerMemory = "tokenizer";
+// The kv-cache buffers.
+inline constexpr absl::string_view kKvCacheMemory = "kv_cache";
+// The input and output buffers of the prefill and decode signatures, besides
+// the kv-cache, e.g. the logits.
+inline constexpr absl::string_view kPrefillBuffersMemory = "prefill_buffers";
+inline constexpr absl::string_view kDecodeBuffersMemory = "decode_buffers";
+// The weights of the loaded LoRA adapters.
+inline constexpr absl::string_view kLoraWeightsMemory = "lora_weights";
+// The executor checkpoints held by the prefix cache.
+inline constexpr absl::string_view kPrefixCacheMemory = "prefix_cache";
+// The responses held by the response cache.
+inline constexpr absl::string_view kResponseCacheMemory = "response_cache";
+
+// A breakdown of the memory held by an engine, by component and location, in
+// bytes. The memory mapped files are counted at their mapped size, whether
+// their pages are resident or not.
+class MemoryUsage {
+ public:
+  // Adds `size_in_bytes` to the memory of `component` at `location`.
+  void Add(absl::string_view component, MemoryLocation location,
+           uint64_t size_in_bytes);
+
+  // Adds all the memory of `other`.
+  void Merge(const MemoryUsage& other);
+
+  // Returns the memory of `component` at `location`, 0 if none.
+  uint64_t GetSizeInBytes(absl::string_view component,
+                          MemoryLocation location) const;
+
+  // Returns the memory of all the components at `location`.
+  uint64_t GetTotalSizeInBytes(MemoryLocation location) const;
+
+  // The memory keyed by component and location, sorted by component.
+  const std::map<std::pair<std::string, MemoryLocation>, uint64_t>& sizes()
+      const {
+    return sizes_;
+  }
+
+ private:
+  std::map<std::pair<std::string, MemoryLocation>, uint64_t> sizes_;
+};
+std::ostream& operator<<(std::ostream& os, const MemoryUsage& memory_usage);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_MEMORY_USAGE_H_
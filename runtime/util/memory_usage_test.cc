@@ -0,0 +1,65 @@
+#include "runtime/util/memory_usage.h"
+
+#include <sstream>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+namespace litert::lm {
+namespace {
+
+using ::testing::HasSubstr;
+
+TEST(MemoryUsageTest, AccumulatesByComponentAndLocation) {
+  MemoryUsage memory_usage;
+  memory_usage.Add(kKvCacheMemory, MemoryLocation::kDevice, 100);
+  memory_usage.Add(kKvCacheMemory, MemoryLocation::kDevice, 50);
+  memory_usage.Add(kKvCacheMemory, MemoryLocation::kHost, 10);
+  memory_usage.Add(kWeightsMemory, MemoryLocation::kHost, 1000);
+
+  EXPECT_EQ(memory_usage.GetSizeInBytes(kKvCacheMemory,
+                                        MemoryLocation::kDevice),
+            150);
+  EXPECT_EQ(memory_usage.GetSizeInBytes(kKvCacheMemory, MemoryLocation::kHost),
+            10);
+  EXPECT_EQ(memory_usage.GetSizeInBytes(kTokenizerMemory,
+                                        MemoryLocation::kHost),
+            0);
+  EXPECT_EQ(memory_usage.GetTotalSizeInBytes(MemoryLocation::kHost), 1010);
+  EXPECT_EQ(memory_usage.GetTotalSizeInBytes(MemoryLocation::kDevice), 150);
+}
+
+TEST(MemoryUsageTest, MergesTheOtherUsage) {
+  MemoryUsage memory_usage;
+  memory_usage.Add(kWeightsMemory, MemoryLocation::kHost, 1000);
+  MemoryUsage other;
+  other.Add(kWeightsMemory, MemoryLocation::kHost, 24);
+  other.Add(kPrefixCacheMemory, MemoryLocation::kHost, 8);
+  memory_usage.Merge(other);
+
+  EXPECT_EQ(memory_usage.GetSizeInBytes(kWeightsMemory, MemoryLocation::kHost),
+            1024);
+  EXPECT_EQ(memory_usage.GetSizeInBytes(kPrefixCacheMemory,
+                                        MemoryLocation::kHost),
+            8);
+  EXPECT_EQ(memory_usage.sizes().size(), 2);
+}
+
+TEST(MemoryUsageTest, PrintsTheBreakdown) {
+  MemoryUsage memory_usage;
+  std::stringstream empty;
+  empty << memory_usage;
+  EXPECT_THAT(empty.str(), HasSubstr("No memory recorded."));
+
+  memory_usage.Add(kKvCacheMemory, MemoryLocation::kDevice, 2 * 1024 * 1024);
+  memory_usage.Add(kWeightsMemory, MemoryLocation::kHost, 1024 * 1024);
+  std::stringstream ss;
+  ss << memory_usage;
+  EXPECT_THAT(ss.str(), HasSubstr("kv_cache (device): 2 MB"));
+  EXPECT_THAT(ss.str(), HasSubstr("weights (host): 1 MB"));
+  EXPECT_THAT(ss.str(), HasSubstr("Total host: 1 MB"));
+  EXPECT_THAT(ss.str(), HasSubstr("Total device: 2 MB"));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -37,4 +37,18 @@ absl::StatusOr<size_t> ScopedFile::GetSize(PlatformFile file) {
   return GetSizeImpl(file);
 }
 
+absl::StatusOr<bool> ScopedFile::TryLockExclusive() const {
+  if (!IsFileValid(file_)) {
+    return absl::FailedPreconditionError("Scoped file is not valid");
+  }
+  return TryLockExclusiveImpl(file_);
+}
+
+absl::Status ScopedFile::EvictFromPageCache() const {
+  if (!IsFileValid(file_)) {
+    return absl::FailedPreconditionError("Scoped file is not valid");
+  }
+  return EvictFromPageCacheImpl(file_);
+}
+
 }  // namespace litert::lm
@@ -21,6 +21,7 @@
 
 #include <cstddef>
 
+#include "absl/status/status.h"  // from @com_google_absl
 #include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 
@@ -39,6 +40,9 @@ class ScopedFile {
 
   static absl::StatusOr<ScopedFile> Open(absl::string_view path);
   static absl::StatusOr<ScopedFile> OpenWritable(absl::string_view path);
+  // Same as OpenWritable(), but creates the file if it does not exist.
+  static absl::StatusOr<ScopedFile> OpenOrCreateWritable(
+      absl::string_view path);
 
   ScopedFile() : file_(kInvalidPlatformFile) {}
   explicit ScopedFile(PlatformFile file) : file_(file) {}
@@ -67,6 +71,18 @@ class ScopedFile {
   static absl::StatusOr<size_t> GetSize(PlatformFile file);
   absl::StatusOr<size_t> GetSize() const { return GetSize(file_); }
 
+  // Tries to take an exclusive advisory lock on the file without blocking.
+  // Returns false if another open file holds the lock, which may be in this
+  // or another process. The lock is released when the file is closed,
+  // including when the process exits.
+  absl::StatusOr<bool> TryLockExclusive() const;
+
+  // Drops the cached pages of the file from the page cache, such that the
+  // next reads of it are read from the storage, e.g. to time a cold start.
+  // Only the pages neither dirty nor mapped by any process are dropped.
+  // Returns UnimplementedError on the platforms without such an advice.
+  absl::Status EvictFromPageCache() const;
+
 #if defined(_WIN32)
   // Releases ownership of the operating system file HANDLE and returns the
   // corresponding C file descriptor.
@@ -99,6 +115,8 @@ class ScopedFile {
   // `PlatformFile` is valid. This must be ensured by the caller.
   static void CloseFile(PlatformFile file);
   static absl::StatusOr<size_t> GetSizeImpl(PlatformFile file);
+  static absl::StatusOr<bool> TryLockExclusiveImpl(PlatformFile file);
+  static absl::Status EvictFromPageCacheImpl(PlatformFile file);
 
   PlatformFile file_;
 };
@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <fcntl.h>
+#include <sys/file.h>
 #include <sys/stat.h>
 
 #include <cerrno>
@@ -40,6 +41,14 @@ absl::StatusOr<ScopedFile> ScopedFile::OpenWritable(absl::string_view path) {
   return ScopedFile(fd);
 }
 
+// static
+absl::StatusOr<ScopedFile> ScopedFile::OpenOrCreateWritable(
+    absl::string_view path) {
+  int fd = open(path.data(), O_RDWR | O_CREAT, 0644);
+  RET_CHECK_GE(fd, 0) << "open() failed: " << path;
+  return ScopedFile(fd);
+}
+
 // static
 void ScopedFile::CloseFile(int file) { close(file); }
 
@@ -53,4 +62,31 @@ absl::StatusOr<size_t> ScopedFile::GetSizeImpl(int file) {
   return info.st_size;
 }
 
+// static
+absl::StatusOr<bool> ScopedFile::TryLockExclusiveImpl(int file) {
+  if (flock(file, LOCK_EX | LOCK_NB) == 0) {
+    return true;
+  }
+  if (errno == EWOULDBLOCK) {
+    return false;
+  }
+  return absl::ErrnoToStatus(errno, "Failed to lock file");
+}
+
+// static
+absl::Status ScopedFile::EvictFromPageCacheImpl(int file) {
+#if defined(__APPLE__)
+  return absl::UnimplementedError(
+      "Evicting a file from the page cache is not supported on Apple "
+      "platforms.");
+#else
+  // The advice returns the error number instead of setting errno.
+  const int error = posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+  if (error != 0) {
+    return absl::ErrnoToStatus(error, "Failed to evict file");
+  }
+  return absl::OkStatus();
+#endif
+}
+
 }  // namespace litert::lm
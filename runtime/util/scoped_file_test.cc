@@ -78,6 +78,51 @@ TEST(ScopedFile, GetSizeOfWritableFile) {
   EXPECT_THAT(ScopedFile::GetSize(file->file()), IsOkAndHolds(7));
 }
 
+TEST(ScopedFile, OpenOrCreateWritableCreatesFile) {
+  auto path = std::filesystem::path(::testing::TempDir()) / "created.txt";
+  std::filesystem::remove(path);
+
+  auto file = ScopedFile::OpenOrCreateWritable(path.string());
+  ASSERT_OK(file);
+  EXPECT_TRUE(std::filesystem::exists(path));
+  EXPECT_THAT(file->GetSize(), IsOkAndHolds(0));
+}
+
+TEST(ScopedFile, TryLockExclusive) {
+  auto path = std::filesystem::path(::testing::TempDir()) / "file.lock";
+  auto file = ScopedFile::OpenOrCreateWritable(path.string());
+  ASSERT_OK(file);
+  EXPECT_THAT(file->TryLockExclusive(), IsOkAndHolds(true));
+
+  // The lock is held by the first open file until it is closed.
+  {
+    auto other_file = ScopedFile::OpenOrCreateWritable(path.string());
+    ASSERT_OK(other_file);
+    EXPECT_THAT(other_file->TryLockExclusive(), IsOkAndHolds(false));
+  }
+  *file = ScopedFile();
+  auto other_file = ScopedFile::OpenOrCreateWritable(path.string());
+  ASSERT_OK(other_file);
+  EXPECT_THAT(other_file->TryLockExclusive(), IsOkAndHolds(true));
+
+  EXPECT_THAT(ScopedFile().TryLockExclusive(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
+TEST(ScopedFile, EvictFromPageCache) {
+  auto path = std::filesystem::path(::testing::TempDir()) / "evicted.txt";
+  WriteFile(path.string(), "foo bar");
+  auto file = ScopedFile::Open(path.string());
+  ASSERT_OK(file);
+  absl::Status status = file->EvictFromPageCache();
+  if (absl::IsUnimplemented(status)) {
+    GTEST_SKIP() << status;
+  }
+  EXPECT_OK(status);
+  EXPECT_THAT(ScopedFile().EvictFromPageCache(),
+              StatusIs(absl::StatusCode::kFailedPrecondition));
+}
+
 TEST(ScopedFile, MoveInvalidatesFile) {
   auto path = std::filesystem::path(::testing::TempDir()) / "file.txt";
   WriteFile(path.string(), "foo bar");
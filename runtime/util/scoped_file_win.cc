@@ -36,8 +36,9 @@ std::wstring Utf8ToWideChar(absl::string_view utf8str) {
   return ws_translated_str;
 }
 
-absl::StatusOr<ScopedFile> OpenImpl(absl::string_view path,
-                                    DWORD file_attribute_flag) {
+absl::StatusOr<ScopedFile> OpenImpl(
+    absl::string_view path, DWORD file_attribute_flag,
+    DWORD creation_disposition = OPEN_EXISTING) {
   std::wstring ws_path = Utf8ToWideChar(path);
 
   DWORD share_mode = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
@@ -46,7 +47,8 @@ absl::StatusOr<ScopedFile> OpenImpl(absl::string_view path,
     access |= GENERIC_WRITE;
   }
   HANDLE hfile = ::CreateFileW(ws_path.c_str(), access, share_mode, nullptr,
-                               OPEN_EXISTING, file_attribute_flag, nullptr);
+                               creation_disposition, file_attribute_flag,
+                               nullptr);
   RET_CHECK_NE(hfile, INVALID_HANDLE_VALUE) << "Failed to open: " << path;
   return ScopedFile(hfile);
 }
@@ -64,6 +66,12 @@ absl::StatusOr<ScopedFile> ScopedFile::OpenWritable(absl::string_view path) {
   return OpenImpl(path, FILE_ATTRIBUTE_NORMAL);
 }
 
+// static
+absl::StatusOr<ScopedFile> ScopedFile::OpenOrCreateWritable(
+    absl::string_view path) {
+  return OpenImpl(path, FILE_ATTRIBUTE_NORMAL, OPEN_ALWAYS);
+}
+
 // static
 void ScopedFile::CloseFile(HANDLE file) { ::CloseHandle(file); }
 
@@ -76,6 +84,26 @@ absl::StatusOr<size_t> ScopedFile::GetSizeImpl(HANDLE file) {
   return static_cast<size_t>(size.QuadPart);
 }
 
+// static
+absl::StatusOr<bool> ScopedFile::TryLockExclusiveImpl(HANDLE file) {
+  OVERLAPPED overlapped = {};
+  if (::LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY,
+                   /*dwReserved=*/0, /*nNumberOfBytesToLockLow=*/MAXDWORD,
+                   /*nNumberOfBytesToLockHigh=*/MAXDWORD, &overlapped)) {
+    return true;
+  }
+  if (GetLastError() == ERROR_LOCK_VIOLATION) {
+    return false;
+  }
+  return absl::UnknownError("Failed to lock file");
+}
+
+// static
+absl::Status ScopedFile::EvictFromPageCacheImpl(HANDLE file) {
+  return absl::UnimplementedError(
+      "Evicting a file from the page cache is not supported on Windows.");
+}
+
 namespace {
 
 // Returns a string holding the error message corresponding to the code returned
@@ -0,0 +1,103 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/util/shared_memory_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/log/absl_log.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_format.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/util/file_util.h"
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/scoped_file.h"
+#include "runtime/util/status_macros.h"  // IWYU pragma: keep
+
+namespace litert::lm {
+namespace {
+
+// Maps the file at "path" if it holds "size" bytes.
+absl::StatusOr<std::unique_ptr<MemoryMappedFile>> MapIfComplete(
+    const std::string& path, uint64_t size) {
+  ASSIGN_OR_RETURN(auto file, ScopedFile::Open(path));
+  ASSIGN_OR_RETURN(size_t file_size, file.GetSize());
+  if (file_size != size) {
+    return absl::DataLossError(absl::StrCat("The shared memory file ", path,
+                                            " has ", file_size,
+                                            " bytes instead of ", size));
+  }
+  // The mapping stays valid once the file is closed.
+  return MemoryMappedFile::Create(file.file());
+}
+
+}  // namespace
+
+std::string ComputeSharedMemoryKey(absl::string_view fingerprint) {
+  // FNV-1a, which unlike absl::Hash is stable across processes.
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : fingerprint) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return absl::StrFormat("%016x", hash);
+}
+
+absl::StatusOr<std::unique_ptr<MemoryMappedFile>> MapOrCreateSharedMemoryFile(
+    absl::string_view dir, absl::string_view key, uint64_t size,
+    absl::AnyInvocable<absl::Status(uint8_t* data, uint64_t size) &&> fill) {
+  ASSIGN_OR_RETURN(std::string path,
+                   JoinPath(dir, absl::StrCat(key, ".shared")));
+  auto mapping = MapIfComplete(path, size);
+  if (mapping.ok()) {
+    return mapping;
+  }
+  ABSL_LOG(INFO) << "Creating the shared memory file " << path << ": "
+                 << mapping.status();
+
+  std::vector<uint8_t> contents(size);
+  RETURN_IF_ERROR(std::move(fill)(contents.data(), contents.size()));
+  // Each creator writes its own temporary file.
+  const std::string temp_path =
+      absl::StrCat(path, ".tmp", absl::Hex(std::random_device()()));
+  {
+    std::ofstream temp_file(temp_path, std::ios::binary | std::ios::trunc);
+    temp_file.write(reinterpret_cast<const char*>(contents.data()),
+                    contents.size());
+    if (!temp_file.good()) {
+      std::remove(temp_path.c_str());
+      return absl::InternalError(absl::StrCat(
+          "Failed to write the shared memory file: ", temp_path));
+    }
+  }
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    // E.g. on Windows, where a file mapped by another process is not
+    // replaced.
+    std::remove(temp_path.c_str());
+  }
+  return MapIfComplete(path, size);
+}
+
+}  // namespace litert::lm
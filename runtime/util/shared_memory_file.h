@@ -0,0 +1,47 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_SHARED_MEMORY_FILE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_SHARED_MEMORY_FILE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/util/memory_mapped_file.h"
+
+namespace litert::lm {
+
+// Returns a key addressing the contents fingerprinted by "fingerprint", stable
+// across processes, to name a shared memory file.
+std::string ComputeSharedMemoryKey(absl::string_view fingerprint);
+
+// Maps the file "key" of "dir" read-only, such that all the processes mapping
+// it share its physical memory through the page cache. The file is created
+// first if missing: "fill" writes its "size" bytes, and the file is renamed
+// into place once complete, so no process maps a partial file. Concurrent
+// creators each write their own file, and the last one renamed is kept,
+// as the contents of a key are the same.
+absl::StatusOr<std::unique_ptr<MemoryMappedFile>> MapOrCreateSharedMemoryFile(
+    absl::string_view dir, absl::string_view key, uint64_t size,
+    absl::AnyInvocable<absl::Status(uint8_t* data, uint64_t size) &&> fill);
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_SHARED_MEMORY_FILE_H_
@@ -0,0 +1,86 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/util/shared_memory_file.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+std::string AsString(MemoryMappedFile& mapping) {
+  return std::string(static_cast<const char*>(mapping.data()),
+                     mapping.length());
+}
+
+TEST(SharedMemoryFileTest, CreatesTheFileOnce) {
+  const std::string dir = ::testing::TempDir();
+  const std::string key = ComputeSharedMemoryKey("creates_the_file_once");
+  std::filesystem::remove(std::filesystem::path(dir) / (key + ".shared"));
+  int num_fills = 0;
+  auto fill = [&num_fills](uint8_t* data, uint64_t size) {
+    ++num_fills;
+    std::memset(data, 's', size);
+    return absl::OkStatus();
+  };
+
+  auto first = MapOrCreateSharedMemoryFile(dir, key, 100, fill);
+  ASSERT_TRUE(first.ok()) << first.status();
+  EXPECT_EQ(AsString(**first), std::string(100, 's'));
+  auto second = MapOrCreateSharedMemoryFile(dir, key, 100, fill);
+  ASSERT_TRUE(second.ok()) << second.status();
+  EXPECT_EQ(AsString(**second), std::string(100, 's'));
+  EXPECT_EQ(num_fills, 1);
+}
+
+TEST(SharedMemoryFileTest, ReplacesAnIncompleteFile) {
+  const std::string dir = ::testing::TempDir();
+  const std::string key = ComputeSharedMemoryKey("replaces_an_incomplete");
+  auto fill = [](char c) {
+    return [c](uint8_t* data, uint64_t size) {
+      std::memset(data, c, size);
+      return absl::OkStatus();
+    };
+  };
+  ASSERT_TRUE(MapOrCreateSharedMemoryFile(dir, key, 10, fill('a')).ok());
+
+  auto mapping = MapOrCreateSharedMemoryFile(dir, key, 20, fill('b'));
+  ASSERT_TRUE(mapping.ok()) << mapping.status();
+  EXPECT_EQ(AsString(**mapping), std::string(20, 'b'));
+}
+
+TEST(SharedMemoryFileTest, ReturnsTheFillError) {
+  auto mapping = MapOrCreateSharedMemoryFile(
+      ::testing::TempDir(), ComputeSharedMemoryKey("returns_the_fill_error"),
+      10, [](uint8_t*, uint64_t) { return absl::DataLossError("corrupt"); });
+  EXPECT_EQ(mapping.status().code(), absl::StatusCode::kDataLoss);
+}
+
+TEST(SharedMemoryFileTest, KeysAreStable) {
+  EXPECT_EQ(ComputeSharedMemoryKey("abc"), ComputeSharedMemoryKey("abc"));
+  EXPECT_NE(ComputeSharedMemoryKey("abc"), ComputeSharedMemoryKey("abd"));
+  EXPECT_EQ(ComputeSharedMemoryKey("").size(), 16);
+}
+
+}  // namespace
+}  // namespace litert::lm
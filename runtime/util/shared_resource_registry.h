@@ -0,0 +1,91 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_SHARED_RESOURCE_REGISTRY_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_SHARED_RESOURCE_REGISTRY_H_
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/functional/any_invocable.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+
+namespace litert::lm {
+
+// A registry of refcounted resources keyed by string. GetOrCreate() returns
+// the live resource of a key if any, and creates it otherwise. The registry
+// only holds weak references, so a resource is destroyed as soon as its last
+// user releases it, and the next GetOrCreate() of its key creates it again.
+//
+// Example usage:
+//
+//   static auto* registry = new SharedResourceRegistry<ModelResources>();
+//   ASSIGN_OR_RETURN(std::shared_ptr<ModelResources> resources,
+//                    registry->GetOrCreate(model_key, [&]() {
+//                      return BuildModelResources(model_path);
+//                    }));
+//
+// The class is thread-safe. The factory runs under the registry lock, so
+// concurrent callers of the same key create the resource only once.
+template <typename T>
+class SharedResourceRegistry {
+ public:
+  using Factory = absl::AnyInvocable<absl::StatusOr<std::unique_ptr<T>>()>;
+
+  // Returns the resource of `key`, creating it with `factory` if there is no
+  // live one. Errors of the factory are returned as is and nothing is
+  // registered.
+  absl::StatusOr<std::shared_ptr<T>> GetOrCreate(absl::string_view key,
+                                                 Factory factory) {
+    absl::MutexLock lock(&mutex_);
+    auto it = resources_.find(key);
+    if (it != resources_.end()) {
+      if (std::shared_ptr<T> resource = it->second.lock()) {
+        return resource;
+      }
+    }
+    absl::StatusOr<std::unique_ptr<T>> created = factory();
+    if (!created.ok()) {
+      return created.status();
+    }
+    std::shared_ptr<T> resource(std::move(*created));
+    resources_[std::string(key)] = resource;
+    return resource;
+  }
+
+  // Returns the number of keys whose resource is still alive.
+  int NumLiveResources() const {
+    absl::MutexLock lock(&mutex_);
+    int num_live_resources = 0;
+    for (const auto& [key, resource] : resources_) {
+      if (!resource.expired()) {
+        ++num_live_resources;
+      }
+    }
+    return num_live_resources;
+  }
+
+ private:
+  mutable absl::Mutex mutex_;
+  absl::flat_hash_map<std::string, std::weak_ptr<T>> resources_
+      ABSL_GUARDED_BY(mutex_);
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_SHARED_RESOURCE_REGISTRY_H_
@@ -0,0 +1,84 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "runtime/util/shared_resource_registry.h"
+
+#include <memory>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::status::StatusIs;
+
+// Returns a factory that creates `value` and counts its calls.
+SharedResourceRegistry<int>::Factory CountingFactory(int value,
+                                                     int* num_calls) {
+  return [value, num_calls]() -> absl::StatusOr<std::unique_ptr<int>> {
+    ++*num_calls;
+    return std::make_unique<int>(value);
+  };
+}
+
+TEST(SharedResourceRegistryTest, SharesResourceOfSameKey) {
+  SharedResourceRegistry<int> registry;
+  int num_calls = 0;
+  ASSERT_OK_AND_ASSIGN(
+      auto first, registry.GetOrCreate("a", CountingFactory(1, &num_calls)));
+  ASSERT_OK_AND_ASSIGN(
+      auto second, registry.GetOrCreate("a", CountingFactory(2, &num_calls)));
+  ASSERT_OK_AND_ASSIGN(
+      auto other, registry.GetOrCreate("b", CountingFactory(3, &num_calls)));
+  EXPECT_EQ(first.get(), second.get());
+  EXPECT_EQ(*second, 1);
+  EXPECT_EQ(*other, 3);
+  EXPECT_EQ(num_calls, 2);
+  EXPECT_EQ(registry.NumLiveResources(), 2);
+}
+
+TEST(SharedResourceRegistryTest, RecreatesReleasedResource) {
+  SharedResourceRegistry<int> registry;
+  int num_calls = 0;
+  ASSERT_OK_AND_ASSIGN(
+      auto first, registry.GetOrCreate("a", CountingFactory(1, &num_calls)));
+  first.reset();
+  EXPECT_EQ(registry.NumLiveResources(), 0);
+  ASSERT_OK_AND_ASSIGN(
+      auto second, registry.GetOrCreate("a", CountingFactory(2, &num_calls)));
+  EXPECT_EQ(*second, 2);
+  EXPECT_EQ(num_calls, 2);
+}
+
+TEST(SharedResourceRegistryTest, FactoryErrorIsNotRegistered) {
+  SharedResourceRegistry<int> registry;
+  EXPECT_THAT(registry.GetOrCreate(
+                  "a",
+                  []() -> absl::StatusOr<std::unique_ptr<int>> {
+                    return absl::InternalError("Failed to create.");
+                  }),
+              StatusIs(absl::StatusCode::kInternal));
+  EXPECT_EQ(registry.NumLiveResources(), 0);
+  int num_calls = 0;
+  ASSERT_OK_AND_ASSIGN(
+      auto resource, registry.GetOrCreate("a", CountingFactory(1, &num_calls)));
+  EXPECT_EQ(*resource, 1);
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,144 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/util/trace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <ios>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_format.h"  // from @com_google_absl
+#include "absl/strings/str_replace.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+
+namespace litert::lm {
+namespace {
+
+// Returns the nanoseconds since the epoch as the microseconds of a trace.
+std::string ToTraceMicros(int64_t ns) {
+  return absl::StrFormat("%.3f", ns / 1000.0);
+}
+
+}  // namespace
+
+TraceRecorder& TraceRecorder::Get() {
+  static auto* recorder = new TraceRecorder();
+  return *recorder;
+}
+
+void TraceRecorder::Start() {
+  recording_.fetch_add(1, std::memory_order_relaxed);
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+void TraceRecorder::Stop() {
+  enabled_.store(false, std::memory_order_relaxed);
+}
+
+void TraceRecorder::Record(const char* name, int64_t begin_ns,
+                           int64_t end_ns) {
+  ThreadBuffer& buffer = GetThreadBuffer();
+  const uint64_t recording = recording_.load(std::memory_order_relaxed);
+  uint64_t num_events = buffer.num_events.load(std::memory_order_relaxed);
+  if (buffer.recording.load(std::memory_order_relaxed) != recording) {
+    buffer.recording.store(recording, std::memory_order_relaxed);
+    num_events = 0;
+  }
+  TraceEvent& event = buffer.events[num_events % kMaxEventsPerThread];
+  event.name = name;
+  event.thread_id = buffer.thread_id;
+  event.begin_ns = begin_ns;
+  event.end_ns = end_ns;
+  buffer.num_events.store(num_events + 1, std::memory_order_release);
+}
+
+TraceRecorder::ThreadBuffer& TraceRecorder::GetThreadBuffer() {
+  // The recorder is a singleton, so the buffer of the thread is too.
+  thread_local ThreadBuffer* current_buffer = nullptr;
+  if (current_buffer == nullptr) {
+    auto buffer = std::make_unique<ThreadBuffer>();
+    buffer->events = std::make_unique<TraceEvent[]>(kMaxEventsPerThread);
+    buffer->recording = recording_.load(std::memory_order_relaxed);
+    absl::MutexLock lock(&mutex_);
+    buffer->thread_id = buffers_.size();
+    current_buffer = buffer.get();
+    buffers_.push_back(std::move(buffer));
+  }
+  return *current_buffer;
+}
+
+std::vector<TraceEvent> TraceRecorder::GetEvents() const {
+  const uint64_t recording = recording_.load(std::memory_order_relaxed);
+  std::vector<TraceEvent> events;
+  absl::MutexLock lock(&mutex_);
+  for (const auto& buffer : buffers_) {
+    const uint64_t num_events =
+        buffer->num_events.load(std::memory_order_acquire);
+    if (buffer->recording.load(std::memory_order_relaxed) != recording) {
+      continue;
+    }
+    const uint64_t first_event =
+        num_events > kMaxEventsPerThread ? num_events - kMaxEventsPerThread
+                                         : 0;
+    for (uint64_t i = first_event; i < num_events; ++i) {
+      events.push_back(buffer->events[i % kMaxEventsPerThread]);
+    }
+  }
+  return events;
+}
+
+absl::Status TraceRecorder::WriteChromeTrace(absl::string_view path) const {
+  const std::vector<TraceEvent> events = GetEvents();
+  std::ofstream file{std::string(path), std::ios::trunc};
+  if (!file.is_open()) {
+    return absl::InternalError(
+        absl::StrCat("Failed to open the trace file: ", path));
+  }
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  int max_thread_id = -1;
+  for (size_t i = 0; i < events.size(); ++i) {
+    const TraceEvent& event = events[i];
+    file << (i == 0 ? "" : ",") << "\n{\"name\":\""
+         << absl::StrReplaceAll(event.name, {{"\\", "\\\\"}, {"\"", "\\\""}})
+         << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << event.thread_id
+         << ",\"ts\":" << ToTraceMicros(event.begin_ns)
+         << ",\"dur\":" << ToTraceMicros(event.end_ns - event.begin_ns) << "}";
+    max_thread_id = std::max(max_thread_id, event.thread_id);
+  }
+  // Names the threads in the order they first recorded a span.
+  for (int thread_id = 0; thread_id <= max_thread_id; ++thread_id) {
+    file << (events.empty() ? "" : ",")
+         << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+         << thread_id << ",\"args\":{\"name\":\"thread " << thread_id
+         << "\"}}";
+  }
+  file << "\n]}\n";
+  file.close();
+  if (!file.good()) {
+    return absl::InternalError(
+        absl::StrCat("Failed to write the trace file: ", path));
+  }
+  return absl::OkStatus();
+}
+
+}  // namespace litert::lm
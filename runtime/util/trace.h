@@ -0,0 +1,148 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_TRACE_H_
+#define THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_TRACE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "absl/base/thread_annotations.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/mutex.h"  // from @com_google_absl
+#include "absl/time/clock.h"  // from @com_google_absl
+
+// Traces the rest of the enclosing scope as a span named "name", which must be
+// a string literal. The spans are only recorded while the TraceRecorder is
+// started, and cost a relaxed atomic load otherwise. Building with
+// --define=litert_lm_disable_tracing=true removes them altogether.
+//
+// Sample usage:
+//
+//   absl::Status Prefill(...) {
+//     LITERT_LM_TRACE_SCOPE("prefill");
+//     ...
+//   }
+//
+#ifdef LITERT_LM_DISABLE_TRACING
+#define LITERT_LM_TRACE_SCOPE(name)
+#else
+#define LITERT_LM_TRACE_SCOPE(name)                  \
+  ::litert::lm::TraceScope LITERT_LM_TRACE_CONCAT(   \
+      litert_lm_trace_scope_, __LINE__)(name)
+#endif
+
+#define LITERT_LM_TRACE_CONCAT(a, b) LITERT_LM_TRACE_CONCAT_IMPL(a, b)
+#define LITERT_LM_TRACE_CONCAT_IMPL(a, b) a##b
+
+namespace litert::lm {
+
+// A span of a trace: "name" ran on thread "thread_id" from "begin_ns" to
+// "end_ns", in nanoseconds since the epoch.
+struct TraceEvent {
+  const char* name = nullptr;
+  int thread_id = 0;
+  int64_t begin_ns = 0;
+  int64_t end_ns = 0;
+};
+
+// Records the spans of all the threads of the process. Each thread records its
+// spans into its own ring buffer, without any lock nor shared cache line, and
+// keeps the last kMaxEventsPerThread of them. The buffers are only read once
+// the recording is stopped, to write the trace.
+//
+// The class is thread-safe.
+class TraceRecorder {
+ public:
+  static constexpr size_t kMaxEventsPerThread = 1 << 16;
+
+  // Returns the recorder of the process.
+  static TraceRecorder& Get();
+
+  // Starts recording the spans, dropping those of the previous recording.
+  void Start();
+  // Stops recording the spans. The spans still open on other threads may be
+  // recorded until they close.
+  void Stop();
+  bool IsEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+  // Records a span of the calling thread. "name" must outlive the recorder,
+  // e.g. be a string literal.
+  void Record(const char* name, int64_t begin_ns, int64_t end_ns);
+
+  // Returns the spans of the recording, by thread and in the order they
+  // closed.
+  std::vector<TraceEvent> GetEvents() const;
+
+  // Writes the spans of the recording to "path" in the Chrome JSON trace
+  // format, which chrome://tracing and https://ui.perfetto.dev open.
+  absl::Status WriteChromeTrace(absl::string_view path) const;
+
+ private:
+  // The ring buffer of the spans of a thread, only written by that thread.
+  struct ThreadBuffer {
+    int thread_id = 0;
+    // The recording the events belong to.
+    std::atomic<uint64_t> recording = 0;
+    std::unique_ptr<TraceEvent[]> events;
+    // The number of events recorded, published after each event is written.
+    std::atomic<uint64_t> num_events = 0;
+  };
+
+  TraceRecorder() = default;
+
+  // Returns the buffer of the calling thread, creating it first if needed.
+  ThreadBuffer& GetThreadBuffer();
+
+  std::atomic<bool> enabled_ = false;
+  // Incremented by each Start(), such that each thread drops the events of
+  // the previous recording from its buffer on its next span.
+  std::atomic<uint64_t> recording_ = 0;
+
+  mutable absl::Mutex mutex_;
+  // The buffers outlive their threads, such that the spans of the threads
+  // which exited are still written.
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers_ ABSL_GUARDED_BY(mutex_);
+};
+
+// Records the span of its lifetime, if the TraceRecorder is started when it
+// is created. Use LITERT_LM_TRACE_SCOPE rather than this class directly.
+class TraceScope {
+ public:
+  explicit TraceScope(const char* name)
+      : name_(TraceRecorder::Get().IsEnabled() ? name : nullptr),
+        begin_ns_(name_ != nullptr ? absl::GetCurrentTimeNanos() : 0) {}
+  ~TraceScope() {
+    if (name_ != nullptr) {
+      TraceRecorder::Get().Record(name_, begin_ns_,
+                                  absl::GetCurrentTimeNanos());
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+ private:
+  const char* const name_;
+  const int64_t begin_ns_;
+};
+
+}  // namespace litert::lm
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_RUNTIME_UTIL_TRACE_H_
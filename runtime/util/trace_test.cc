@@ -0,0 +1,104 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/util/trace.h"
+
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+#include "runtime/util/test_utils.h"  // NOLINT
+
+namespace litert::lm {
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::IsEmpty;
+using ::testing::SizeIs;
+
+void TraceSpans(int num_spans) {
+  for (int i = 0; i < num_spans; ++i) {
+    LITERT_LM_TRACE_SCOPE("span");
+  }
+}
+
+TEST(TraceRecorderTest, RecordsTheSpansOfEachThread) {
+  TraceRecorder& recorder = TraceRecorder::Get();
+  recorder.Start();
+  {
+    LITERT_LM_TRACE_SCOPE("outer");
+    TraceSpans(3);
+  }
+  std::thread thread([]() { TraceSpans(2); });
+  thread.join();
+  recorder.Stop();
+  TraceSpans(5);
+
+  const std::vector<TraceEvent> events = recorder.GetEvents();
+  ASSERT_THAT(events, SizeIs(6));
+  int num_outer_events = 0;
+  for (const TraceEvent& event : events) {
+    EXPECT_LE(event.begin_ns, event.end_ns);
+    if (std::string(event.name) == "outer") {
+      ++num_outer_events;
+    }
+  }
+  EXPECT_EQ(num_outer_events, 1);
+  // The spans of the other thread are recorded in its own buffer.
+  EXPECT_NE(events.front().thread_id, events.back().thread_id);
+}
+
+TEST(TraceRecorderTest, DropsThePreviousRecording) {
+  TraceRecorder& recorder = TraceRecorder::Get();
+  recorder.Start();
+  TraceSpans(3);
+  recorder.Stop();
+  recorder.Start();
+  recorder.Stop();
+  EXPECT_THAT(recorder.GetEvents(), IsEmpty());
+}
+
+TEST(TraceRecorderTest, KeepsTheLastEventsOfAThread) {
+  TraceRecorder& recorder = TraceRecorder::Get();
+  recorder.Start();
+  TraceSpans(TraceRecorder::kMaxEventsPerThread + 10);
+  recorder.Stop();
+  EXPECT_THAT(recorder.GetEvents(), SizeIs(TraceRecorder::kMaxEventsPerThread));
+}
+
+TEST(TraceRecorderTest, WritesChromeTrace) {
+  TraceRecorder& recorder = TraceRecorder::Get();
+  recorder.Start();
+  TraceSpans(2);
+  recorder.Stop();
+  const auto path =
+      std::filesystem::path(::testing::TempDir()) / "trace.json";
+  ASSERT_TRUE(recorder.WriteChromeTrace(path.string()).ok());
+
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  EXPECT_THAT(contents.str(), HasSubstr("\"traceEvents\":["));
+  EXPECT_THAT(contents.str(), HasSubstr("{\"name\":\"span\",\"ph\":\"X\""));
+  EXPECT_THAT(contents.str(), HasSubstr("\"name\":\"thread_name\""));
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -18,6 +18,7 @@ limitations under the License.
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <initializer_list>
 #include <string>
 #include <utility>
 
@@ -105,9 +106,173 @@ absl::StatusOr<ZipFileInfo> GetCurrentZipFileInfo(const unzFile& zf) {
   return result;
 }
 
-}  // namespace
+// The zip records read to locate the stored entries, see
+// https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT.
+constexpr uint32_t kLocalFileHeaderSignature = 0x04034b50;
+constexpr uint32_t kCentralDirectoryHeaderSignature = 0x02014b50;
+constexpr uint32_t kEndOfCentralDirectorySignature = 0x06054b50;
+constexpr uint32_t kZip64EndOfCentralDirectorySignature = 0x06064b50;
+constexpr uint32_t kZip64EndOfCentralDirectoryLocatorSignature = 0x07064b50;
+constexpr uint16_t kZip64ExtraFieldId = 0x0001;
+constexpr size_t kLocalFileHeaderSize = 30;
+constexpr size_t kCentralDirectoryHeaderSize = 46;
+constexpr size_t kEndOfCentralDirectorySize = 22;
+constexpr size_t kZip64EndOfCentralDirectorySize = 56;
+constexpr size_t kZip64EndOfCentralDirectoryLocatorSize = 20;
+constexpr size_t kMaxCommentSize = 0xFFFF;
+constexpr uint16_t kStoredMethod = 0;
+constexpr uint32_t kZip64Marker = 0xFFFFFFFF;
 
-absl::Status ExtractFilesfromZipFile(
+// Reads the little endian integer of type T at "data".
+template <typename T>
+T ReadLittleEndian(const char* data) {
+  T value = 0;
+  for (size_t i = 0; i < sizeof(T); ++i) {
+    value |= static_cast<T>(static_cast<uint8_t>(data[i])) << (8 * i);
+  }
+  return value;
+}
+
+// Reads the 64 bits values of the fields of "values" set to kZip64Marker from
+// the ZIP64 extra field of a central directory header, in order.
+absl::Status ReadZip64ExtraField(const char* extra, size_t extra_size,
+                                 std::initializer_list<uint64_t*> values) {
+  size_t offset = 0;
+  while (extra_size - offset >= 4) {
+    const uint16_t id = ReadLittleEndian<uint16_t>(extra + offset);
+    const uint16_t size = ReadLittleEndian<uint16_t>(extra + offset + 2);
+    offset += 4;
+    RET_CHECK_LE(size, extra_size - offset)
+            .SetCode(absl::StatusCode::kDataLoss)
+        << "The extra field is out of the header.";
+    if (id == kZip64ExtraFieldId) {
+      size_t field_offset = 0;
+      for (uint64_t* value : values) {
+        if (*value != kZip64Marker) {
+          continue;
+        }
+        RET_CHECK_LE(field_offset + sizeof(uint64_t), size)
+                .SetCode(absl::StatusCode::kDataLoss)
+            << "The ZIP64 extra field is truncated.";
+        *value = ReadLittleEndian<uint64_t>(extra + offset + field_offset);
+        field_offset += sizeof(uint64_t);
+      }
+      return absl::OkStatus();
+    }
+    offset += size;
+  }
+  return absl::DataLossError("The ZIP64 extra field is missing.");
+}
+
+// Finds the stored entries from the central directory at the end of the
+// archive, and resolves their local headers to the offsets of their contents,
+// all in place. Only the headers of the archive are read.
+absl::Status ExtractStoredFilesFromCentralDirectory(
+    const char* data, size_t size,
+    absl::flat_hash_map<std::string, absl::string_view>* files) {
+  RET_CHECK_GE(size, kEndOfCentralDirectorySize)
+          .SetCode(absl::StatusCode::kDataLoss)
+      << "The archive is too short.";
+  // The end of central directory record is followed by a comment of up to
+  // 64KB.
+  const size_t min_offset =
+      size - kEndOfCentralDirectorySize > kMaxCommentSize
+          ? size - kEndOfCentralDirectorySize - kMaxCommentSize
+          : 0;
+  size_t end_offset = size - kEndOfCentralDirectorySize;
+  while (ReadLittleEndian<uint32_t>(data + end_offset) !=
+         kEndOfCentralDirectorySignature) {
+    RET_CHECK_GT(end_offset, min_offset).SetCode(absl::StatusCode::kDataLoss)
+        << "Unable to find the end of central directory.";
+    --end_offset;
+  }
+  uint64_t num_entries = ReadLittleEndian<uint16_t>(data + end_offset + 10);
+  uint64_t directory_size = ReadLittleEndian<uint32_t>(data + end_offset + 12);
+  uint64_t directory_offset =
+      ReadLittleEndian<uint32_t>(data + end_offset + 16);
+  if (num_entries == 0xFFFF || directory_size == kZip64Marker ||
+      directory_offset == kZip64Marker) {
+    // A ZIP64 archive, whose locator precedes the end of central directory.
+    RET_CHECK(end_offset >= kZip64EndOfCentralDirectoryLocatorSize &&
+              ReadLittleEndian<uint32_t>(
+                  data + end_offset - kZip64EndOfCentralDirectoryLocatorSize) ==
+                  kZip64EndOfCentralDirectoryLocatorSignature)
+            .SetCode(absl::StatusCode::kDataLoss)
+        << "Unable to find the ZIP64 end of central directory locator.";
+    const uint64_t zip64_end_offset = ReadLittleEndian<uint64_t>(
+        data + end_offset - kZip64EndOfCentralDirectoryLocatorSize + 8);
+    RET_CHECK(zip64_end_offset <= size - kZip64EndOfCentralDirectorySize &&
+              ReadLittleEndian<uint32_t>(data + zip64_end_offset) ==
+                  kZip64EndOfCentralDirectorySignature)
+            .SetCode(absl::StatusCode::kDataLoss)
+        << "Unable to find the ZIP64 end of central directory.";
+    num_entries = ReadLittleEndian<uint64_t>(data + zip64_end_offset + 32);
+    directory_size = ReadLittleEndian<uint64_t>(data + zip64_end_offset + 40);
+    directory_offset =
+        ReadLittleEndian<uint64_t>(data + zip64_end_offset + 48);
+  }
+  RET_CHECK(directory_offset <= size &&
+            directory_size <= size - directory_offset)
+          .SetCode(absl::StatusCode::kDataLoss)
+      << "The central directory is out of the archive.";
+
+  size_t header_offset = directory_offset;
+  const size_t directory_end = directory_offset + directory_size;
+  for (uint64_t i = 0; i < num_entries; ++i) {
+    const char* header = data + header_offset;
+    RET_CHECK(directory_end - header_offset >= kCentralDirectoryHeaderSize &&
+              ReadLittleEndian<uint32_t>(header) ==
+                  kCentralDirectoryHeaderSignature)
+            .SetCode(absl::StatusCode::kDataLoss)
+        << "Invalid central directory header of entry " << i;
+    const uint16_t method = ReadLittleEndian<uint16_t>(header + 10);
+    uint64_t compressed_size = ReadLittleEndian<uint32_t>(header + 20);
+    uint64_t uncompressed_size = ReadLittleEndian<uint32_t>(header + 24);
+    const uint16_t name_size = ReadLittleEndian<uint16_t>(header + 28);
+    const uint16_t extra_size = ReadLittleEndian<uint16_t>(header + 30);
+    const uint16_t comment_size = ReadLittleEndian<uint16_t>(header + 32);
+    uint64_t local_header_offset = ReadLittleEndian<uint32_t>(header + 42);
+    const size_t header_size =
+        kCentralDirectoryHeaderSize + name_size + extra_size + comment_size;
+    RET_CHECK_LE(header_size, directory_end - header_offset)
+            .SetCode(absl::StatusCode::kDataLoss)
+        << "The central directory header of entry " << i << " is truncated.";
+    std::string name(header + kCentralDirectoryHeaderSize, name_size);
+    if (uncompressed_size == kZip64Marker || compressed_size == kZip64Marker ||
+        local_header_offset == kZip64Marker) {
+      RETURN_IF_ERROR(ReadZip64ExtraField(
+          header + kCentralDirectoryHeaderSize + name_size, extra_size,
+          {&uncompressed_size, &compressed_size, &local_header_offset}));
+    }
+    if (method != kStoredMethod) {
+      return absl::UnknownError("Expected uncompressed zip archive.");
+    }
+
+    RET_CHECK(local_header_offset <= size - kLocalFileHeaderSize &&
+              ReadLittleEndian<uint32_t>(data + local_header_offset) ==
+                  kLocalFileHeaderSignature)
+            .SetCode(absl::StatusCode::kDataLoss)
+        << "Invalid local header of " << name;
+    // The local header has its own name and extra field, which may differ
+    // from those of the central directory.
+    const uint64_t content_offset =
+        local_header_offset + kLocalFileHeaderSize +
+        ReadLittleEndian<uint16_t>(data + local_header_offset + 26) +
+        ReadLittleEndian<uint16_t>(data + local_header_offset + 28);
+    RET_CHECK(content_offset <= size &&
+              uncompressed_size <= size - content_offset)
+            .SetCode(absl::StatusCode::kDataLoss)
+        << "The contents of " << name << " are out of the archive.";
+    (*files)[std::move(name)] =
+        absl::string_view(data + content_offset, uncompressed_size);
+    header_offset += header_size;
+  }
+  return absl::OkStatus();
+}
+
+// Extracts the files through minizip, which reads the local header of each
+// entry.
+absl::Status ExtractFilesWithMinizip(
     const char* buffer_data, const size_t buffer_size,
     absl::flat_hash_map<std::string, absl::string_view>* files) {
   // Create in-memory read-only zip file.
@@ -152,6 +317,27 @@ absl::Status ExtractFilesfromZipFile(
   return absl::OkStatus();
 }
 
+}  // namespace
+
+absl::Status ExtractFilesfromZipFile(
+    const char* buffer_data, const size_t buffer_size,
+    absl::flat_hash_map<std::string, absl::string_view>* files) {
+  absl::flat_hash_map<std::string, absl::string_view> stored_files;
+  auto status = ExtractStoredFilesFromCentralDirectory(buffer_data, buffer_size,
+                                                       &stored_files);
+  if (status.ok()) {
+    for (auto& [name, contents] : stored_files) {
+      (*files)[name] = contents;
+    }
+    return absl::OkStatus();
+  }
+  // The archives the central directory can't be read from, e.g. with a
+  // compressed entry, get the errors of minizip.
+  ABSL_LOG(INFO) << "Failed to read the central directory, falling back to "
+                 << "minizip: " << status;
+  return ExtractFilesWithMinizip(buffer_data, buffer_size, files);
+}
+
 void SetExternalFile(const absl::string_view file_content,
                      proto::ExternalFile* model_file, bool is_copy) {
   if (is_copy) {
@@ -29,6 +29,9 @@ namespace litert::lm {
 // Outputs: A map with the filename as key and a pointer to the file contents
 // as value. The file contents returned by this function are only guaranteed to
 // stay valid while buffer_data is alive.
+// The entries must be stored uncompressed. They are located from the central
+// directory of the archive, such that only its headers are read and the
+// contents are used in place.
 absl::Status ExtractFilesfromZipFile(
     const char* buffer_data, const size_t buffer_size,
     absl::flat_hash_map<std::string, absl::string_view>* files);
@@ -0,0 +1,143 @@
+// Copyright 2025 The ODML Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "runtime/util/zip_utils.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/container/flat_hash_map.h"  // from @com_google_absl
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/util/memory_mapped_file.h"
+#include "runtime/util/scoped_file.h"
+
+namespace litert::lm {
+namespace {
+
+void AppendLittleEndian(uint64_t value, size_t size, std::string& output) {
+  for (size_t i = 0; i < size; ++i) {
+    output.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+// Returns a zip archive of the stored "entries", with "extra" in their local
+// headers and "comment" at the end of the archive.
+std::string MakeStoredZip(
+    const std::vector<std::pair<std::string, std::string>>& entries,
+    const std::string& extra, const std::string& comment) {
+  std::string archive;
+  std::vector<size_t> local_header_offsets;
+  for (const auto& [name, contents] : entries) {
+    local_header_offsets.push_back(archive.size());
+    AppendLittleEndian(0x04034b50, 4, archive);
+    AppendLittleEndian(10, 2, archive);  // Version needed.
+    AppendLittleEndian(0, 2, archive);  // Flags.
+    AppendLittleEndian(0, 2, archive);  // Stored.
+    AppendLittleEndian(0, 4, archive);  // Time and date.
+    AppendLittleEndian(0, 4, archive);  // CRC-32, not checked.
+    AppendLittleEndian(contents.size(), 4, archive);
+    AppendLittleEndian(contents.size(), 4, archive);
+    AppendLittleEndian(name.size(), 2, archive);
+    AppendLittleEndian(extra.size(), 2, archive);
+    archive.append(name);
+    archive.append(extra);
+    archive.append(contents);
+  }
+  const size_t directory_offset = archive.size();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    const auto& [name, contents] = entries[i];
+    AppendLittleEndian(0x02014b50, 4, archive);
+    AppendLittleEndian(10, 2, archive);  // Version made by.
+    AppendLittleEndian(10, 2, archive);  // Version needed.
+    AppendLittleEndian(0, 2, archive);  // Flags.
+    AppendLittleEndian(0, 2, archive);  // Stored.
+    AppendLittleEndian(0, 4, archive);  // Time and date.
+    AppendLittleEndian(0, 4, archive);  // CRC-32, not checked.
+    AppendLittleEndian(contents.size(), 4, archive);
+    AppendLittleEndian(contents.size(), 4, archive);
+    AppendLittleEndian(name.size(), 2, archive);
+    AppendLittleEndian(0, 2, archive);  // Extra field.
+    AppendLittleEndian(0, 2, archive);  // Comment.
+    AppendLittleEndian(0, 2, archive);  // Disk number.
+    AppendLittleEndian(0, 2, archive);  // Internal attributes.
+    AppendLittleEndian(0, 4, archive);  // External attributes.
+    AppendLittleEndian(local_header_offsets[i], 4, archive);
+    archive.append(name);
+  }
+  const size_t directory_size = archive.size() - directory_offset;
+  AppendLittleEndian(0x06054b50, 4, archive);
+  AppendLittleEndian(0, 4, archive);  // Disk numbers.
+  AppendLittleEndian(entries.size(), 2, archive);
+  AppendLittleEndian(entries.size(), 2, archive);
+  AppendLittleEndian(directory_size, 4, archive);
+  AppendLittleEndian(directory_offset, 4, archive);
+  AppendLittleEndian(comment.size(), 2, archive);
+  archive.append(comment);
+  return archive;
+}
+
+TEST(ZipUtilsTest, ExtractsTheStoredEntriesInPlace) {
+  const std::string archive =
+      MakeStoredZip({{"TF_LITE_PREFILL_DECODE", "model contents"},
+                     {"TOKENIZER_MODEL", "tokenizer contents"},
+                     {"EMPTY", ""}},
+                    /*extra=*/"\x01\x02\x03\x04", /*comment=*/"a comment");
+  absl::flat_hash_map<std::string, absl::string_view> files;
+  ASSERT_TRUE(
+      ExtractFilesfromZipFile(archive.data(), archive.size(), &files).ok());
+  ASSERT_EQ(files.size(), 3);
+  EXPECT_EQ(files["TF_LITE_PREFILL_DECODE"], "model contents");
+  EXPECT_EQ(files["TOKENIZER_MODEL"], "tokenizer contents");
+  EXPECT_EQ(files["EMPTY"], "");
+  // The contents are not copied.
+  EXPECT_GE(files["TOKENIZER_MODEL"].data(), archive.data());
+  EXPECT_LT(files["TOKENIZER_MODEL"].data(), archive.data() + archive.size());
+}
+
+TEST(ZipUtilsTest, ExtractsTheEntriesOfATaskFile) {
+  const auto model_path =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/runtime/testdata/test_lm.task";
+  auto model_file = ScopedFile::Open(model_path.string());
+  ASSERT_TRUE(model_file.ok());
+  auto mapped_file = MemoryMappedFile::Create(model_file->file());
+  ASSERT_TRUE(mapped_file.ok());
+  absl::flat_hash_map<std::string, absl::string_view> files;
+  ASSERT_TRUE(ExtractFilesfromZipFile(
+                  static_cast<const char*>((*mapped_file)->data()),
+                  (*mapped_file)->length(), &files)
+                  .ok());
+  ASSERT_TRUE(files.contains("TF_LITE_PREFILL_DECODE"));
+  ASSERT_TRUE(files.contains("TOKENIZER_MODEL"));
+  ASSERT_TRUE(files.contains("METADATA"));
+  // The model is a TFLite flatbuffer.
+  EXPECT_EQ(files["TF_LITE_PREFILL_DECODE"].substr(4, 4), "TFL3");
+}
+
+TEST(ZipUtilsTest, FailsOnATruncatedArchive) {
+  const std::string archive =
+      MakeStoredZip({{"TOKENIZER_MODEL", "tokenizer contents"}}, "", "");
+  absl::flat_hash_map<std::string, absl::string_view> files;
+  EXPECT_FALSE(ExtractFilesfromZipFile(archive.data(), 10, &files).ok());
+}
+
+}  // namespace
+}  // namespace litert::lm
@@ -0,0 +1,253 @@
+#include "schema/core/litertlm_compression.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/blocking_counter.h"  // from @com_google_absl
+#include "runtime/framework/work_stealing_threadpool.h"
+#include "runtime/util/status_macros.h"  // NOLINT
+#include "zlib.h"  // from @zlib
+
+namespace litert {
+namespace lm {
+namespace schema {
+namespace {
+
+// The fixed fields of the chunk index: the magic, the uncompressed size, the
+// chunk size and the number of chunks.
+constexpr size_t kNumIndexFields = 4;
+
+// Runs "fn(i)" for each i in [0, n), on "pool" if not null, and returns the
+// first error.
+template <typename Fn>
+absl::Status ParallelFor(size_t n, WorkStealingThreadPool* pool, Fn fn) {
+  std::vector<absl::Status> statuses(n);
+  if (pool == nullptr || n <= 1) {
+    for (size_t i = 0; i < n; ++i) {
+      statuses[i] = fn(i);
+    }
+  } else {
+    absl::BlockingCounter done(static_cast<int>(n));
+    for (size_t i = 0; i < n; ++i) {
+      auto status = pool->Schedule([&fn, &statuses, &done, i]() {
+        statuses[i] = fn(i);
+        done.DecrementCount();
+      });
+      if (!status.ok()) {
+        statuses[i] = fn(i);
+        done.DecrementCount();
+      }
+    }
+    done.Wait();
+  }
+  for (auto& status : statuses) {
+    RETURN_IF_ERROR(status);  // NOLINT
+  }
+  return absl::OkStatus();
+}
+
+uint64_t ReadUint64(const uint8_t* data, size_t index) {
+  uint64_t value;
+  std::memcpy(&value, data + index * sizeof(uint64_t), sizeof(uint64_t));
+  return value;
+}
+
+void AppendUint64(uint64_t value, std::string& output) {
+  output.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Compresses the chunk "i" into "output".
+absl::Status CompressChunk(absl::string_view chunk, size_t i,
+                           std::string& output) {
+  uLongf compressed_size = compressBound(chunk.size());
+  output.resize(compressed_size);
+  const int result = compress2(reinterpret_cast<Bytef*>(output.data()),
+                               &compressed_size,
+                               reinterpret_cast<const Bytef*>(chunk.data()),
+                               chunk.size(), Z_DEFAULT_COMPRESSION);
+  if (result != Z_OK) {
+    return absl::InternalError(absl::StrCat(
+        "Compression of chunk ", i, " failed with error code: ", result));
+  }
+  output.resize(compressed_size);
+  return absl::OkStatus();
+}
+
+}  // namespace
+
+absl::StatusOr<std::string> CompressChunked(absl::string_view data,
+                                            uint64_t chunk_size,
+                                            WorkStealingThreadPool* pool) {
+  if (chunk_size == 0) {
+    return absl::InvalidArgumentError("The chunk size must be positive.");
+  }
+  const uint64_t num_chunks = (data.size() + chunk_size - 1) / chunk_size;
+  std::vector<std::string> chunks(num_chunks);
+  RETURN_IF_ERROR(ParallelFor(  // NOLINT
+      num_chunks, pool, [&](size_t i) -> absl::Status {
+        return CompressChunk(data.substr(i * chunk_size, chunk_size), i,
+                             chunks[i]);
+      }));
+
+  std::string output;
+  size_t total_size = (kNumIndexFields + num_chunks) * sizeof(uint64_t);
+  for (const auto& chunk : chunks) {
+    total_size += chunk.size();
+  }
+  output.reserve(total_size);
+  AppendUint64(kChunkedSectionMagic, output);
+  AppendUint64(data.size(), output);
+  AppendUint64(chunk_size, output);
+  AppendUint64(num_chunks, output);
+  uint64_t chunk_end_offset = 0;
+  for (const auto& chunk : chunks) {
+    chunk_end_offset += chunk.size();
+    AppendUint64(chunk_end_offset, output);
+  }
+  for (const auto& chunk : chunks) {
+    output.append(chunk);
+  }
+  return output;
+}
+
+absl::StatusOr<uint64_t> CompressChunkedToStream(
+    std::istream& input, uint64_t size, uint64_t chunk_size,
+    std::ostream& output, WorkStealingThreadPool* pool) {
+  if (chunk_size == 0) {
+    return absl::InvalidArgumentError("The chunk size must be positive.");
+  }
+  const uint64_t num_chunks = (size + chunk_size - 1) / chunk_size;
+  const std::streampos index_pos = output.tellp();
+  if (index_pos == std::streampos(-1)) {
+    return absl::InvalidArgumentError("The output stream must be seekable.");
+  }
+  // The index, of which the chunk end offsets are filled at the end.
+  std::string index;
+  AppendUint64(kChunkedSectionMagic, index);
+  AppendUint64(size, index);
+  AppendUint64(chunk_size, index);
+  AppendUint64(num_chunks, index);
+  index.resize((kNumIndexFields + num_chunks) * sizeof(uint64_t));
+  output.write(index.data(), index.size());
+
+  // One batch of chunks is compressed at a time, one chunk per thread.
+  const size_t batch_size = pool == nullptr ? 1 : pool->num_threads();
+  std::vector<std::string> uncompressed_chunks(batch_size);
+  std::vector<std::string> compressed_chunks(batch_size);
+  std::vector<uint64_t> chunk_end_offsets;
+  chunk_end_offsets.reserve(num_chunks);
+  uint64_t chunk_end_offset = 0;
+  for (uint64_t first = 0; first < num_chunks; first += batch_size) {
+    const size_t num_batch_chunks =
+        std::min<uint64_t>(batch_size, num_chunks - first);
+    for (size_t j = 0; j < num_batch_chunks; ++j) {
+      uncompressed_chunks[j].resize(
+          std::min(chunk_size, size - (first + j) * chunk_size));
+      if (!input.read(uncompressed_chunks[j].data(),
+                      uncompressed_chunks[j].size())) {
+        return absl::DataLossError(absl::StrCat(
+            "The input ended before its ", size, " bytes were read."));
+      }
+    }
+    RETURN_IF_ERROR(ParallelFor(  // NOLINT
+        num_batch_chunks, pool, [&](size_t j) -> absl::Status {
+          return CompressChunk(uncompressed_chunks[j], first + j,
+                               compressed_chunks[j]);
+        }));
+    for (size_t j = 0; j < num_batch_chunks; ++j) {
+      output.write(compressed_chunks[j].data(), compressed_chunks[j].size());
+      chunk_end_offset += compressed_chunks[j].size();
+      chunk_end_offsets.push_back(chunk_end_offset);
+    }
+  }
+  const std::streampos end_pos = output.tellp();
+  output.seekp(index_pos + static_cast<std::streamoff>(kNumIndexFields *
+                                                       sizeof(uint64_t)));
+  output.write(reinterpret_cast<const char*>(chunk_end_offsets.data()),
+               chunk_end_offsets.size() * sizeof(uint64_t));
+  output.seekp(end_pos);
+  if (!output.good()) {
+    return absl::InternalError("Failed to write the compressed section.");
+  }
+  return static_cast<uint64_t>(index.size()) + chunk_end_offset;
+}
+
+absl::StatusOr<ChunkIndex> ReadChunkIndex(const uint8_t* data, size_t size) {
+  if (size < kNumIndexFields * sizeof(uint64_t) ||
+      ReadUint64(data, 0) != kChunkedSectionMagic) {
+    return absl::DataLossError("The section is not chunk compressed.");
+  }
+  ChunkIndex index;
+  index.uncompressed_size = ReadUint64(data, 1);
+  index.chunk_size = ReadUint64(data, 2);
+  const uint64_t num_chunks = ReadUint64(data, 3);
+  if (index.chunk_size == 0 ||
+      num_chunks != (index.uncompressed_size + index.chunk_size - 1) /
+                        index.chunk_size) {
+    return absl::DataLossError(absl::StrCat(
+        "Invalid chunk index: ", num_chunks, " chunks of ", index.chunk_size,
+        " bytes for ", index.uncompressed_size, " bytes."));
+  }
+  if (num_chunks > size / sizeof(uint64_t) - kNumIndexFields) {
+    return absl::DataLossError("The chunk index is truncated.");
+  }
+  const uint64_t chunks_offset =
+      (kNumIndexFields + num_chunks) * sizeof(uint64_t);
+  index.chunk_begin_offsets.reserve(num_chunks);
+  index.chunk_end_offsets.reserve(num_chunks);
+  uint64_t chunk_begin_offset = chunks_offset;
+  for (uint64_t i = 0; i < num_chunks; ++i) {
+    const uint64_t chunk_end_offset =
+        chunks_offset + ReadUint64(data, kNumIndexFields + i);
+    if (chunk_end_offset < chunk_begin_offset || chunk_end_offset > size) {
+      return absl::DataLossError(
+          absl::StrCat("Chunk ", i, " is out of the section."));
+    }
+    index.chunk_begin_offsets.push_back(chunk_begin_offset);
+    index.chunk_end_offsets.push_back(chunk_end_offset);
+    chunk_begin_offset = chunk_end_offset;
+  }
+  return index;
+}
+
+absl::Status DecompressChunked(const uint8_t* data, size_t size,
+                               uint8_t* output, size_t output_size,
+                               WorkStealingThreadPool* pool) {
+  ASSIGN_OR_RETURN(ChunkIndex index, ReadChunkIndex(data, size));  // NOLINT
+  if (output_size != index.uncompressed_size) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Expected an output of ", index.uncompressed_size,
+                     " bytes, but got ", output_size, " bytes."));
+  }
+  return ParallelFor(
+      index.chunk_end_offsets.size(), pool, [&](size_t i) -> absl::Status {
+        const uint64_t output_offset = i * index.chunk_size;
+        const uint64_t expected_size =
+            std::min(index.chunk_size, output_size - output_offset);
+        uLongf uncompressed_size = expected_size;
+        const int result = uncompress(
+            output + output_offset, &uncompressed_size,
+            data + index.chunk_begin_offsets[i],
+            index.chunk_end_offsets[i] - index.chunk_begin_offsets[i]);
+        if (result != Z_OK || uncompressed_size != expected_size) {
+          return absl::DataLossError(absl::StrCat(
+              "Failed to decompress chunk ", i, ", error code: ", result));
+        }
+        return absl::OkStatus();
+      });
+}
+
+}  // end namespace schema
+}  // end namespace lm
+}  // end namespace litert
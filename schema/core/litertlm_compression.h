@@ -0,0 +1,76 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_COMPRESSION_H_
+#define THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_COMPRESSION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/framework/work_stealing_threadpool.h"
+
+namespace litert {
+namespace lm {
+namespace schema {
+
+// The chunked compression of a section, recorded as the kSectionCompressionKey
+// item of the section. The data is split in chunks of the same uncompressed
+// size, the last one possibly shorter, and each chunk is zlib compressed on
+// its own, such that the chunks are compressed and decompressed in parallel.
+//
+// Layout of the section (little endian):
+//   uint64 kChunkedSectionMagic
+//   uint64 uncompressed_size
+//   uint64 chunk_size: The uncompressed size of the chunks.
+//   uint64 num_chunks
+//   uint64 chunk_end_offsets[num_chunks]: The end of each compressed chunk,
+//     relative to the first one.
+//   The compressed chunks.
+constexpr char kChunkedZlibCompression[] = "zlib_chunked";
+constexpr uint64_t kChunkedSectionMagic = 0x4b4e48434d4c544cULL;  // LTLMCHNK
+constexpr uint64_t kDefaultCompressionChunkSize = 1024 * 1024;
+
+// The chunk index at the start of a chunked section.
+struct ChunkIndex {
+  uint64_t uncompressed_size = 0;
+  uint64_t chunk_size = 0;
+  // The [begin, end) offsets of each compressed chunk in the section.
+  std::vector<uint64_t> chunk_begin_offsets;
+  std::vector<uint64_t> chunk_end_offsets;
+};
+
+// Compresses "data" in chunks of "chunk_size" bytes. The chunks are
+// compressed on "pool" if not null, or on the calling thread.
+absl::StatusOr<std::string> CompressChunked(
+    absl::string_view data, uint64_t chunk_size = kDefaultCompressionChunkSize,
+    WorkStealingThreadPool* pool = nullptr);
+
+// Compresses the "size" bytes read from "input" like CompressChunked(), but
+// straight into "output", such that the data is never held in memory as a
+// whole: one chunk per thread of "pool", or a single one if "pool" is null, is
+// held at a time. "output" must be seekable, as the chunk index is written
+// ahead of the chunks, and filled once they are compressed. Returns the number
+// of bytes written.
+absl::StatusOr<uint64_t> CompressChunkedToStream(
+    std::istream& input, uint64_t size, uint64_t chunk_size,
+    std::ostream& output, WorkStealingThreadPool* pool = nullptr);
+
+// Reads and validates the chunk index of a chunked section.
+absl::StatusOr<ChunkIndex> ReadChunkIndex(const uint8_t* data, size_t size);
+
+// Decompresses the chunked section "data" straight into "output", which must
+// hold exactly the uncompressed size of the section. The chunks are
+// decompressed on "pool" if not null, or on the calling thread.
+absl::Status DecompressChunked(const uint8_t* data, size_t size,
+                               uint8_t* output, size_t output_size,
+                               WorkStealingThreadPool* pool = nullptr);
+
+}  // end namespace schema
+}  // end namespace lm
+}  // end namespace litert
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_COMPRESSION_H_
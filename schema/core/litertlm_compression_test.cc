@@ -0,0 +1,106 @@
+#include "schema/core/litertlm_compression.h"
+
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/framework/work_stealing_threadpool.h"
+
+namespace litert::lm::schema {
+namespace {
+
+std::string MakeData(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>((i * 7) % 13 + (i / 1000) % 5);
+  }
+  return data;
+}
+
+const uint8_t* AsBytes(const std::string& data) {
+  return reinterpret_cast<const uint8_t*>(data.data());
+}
+
+TEST(LiteRTLMCompressionTest, RoundTripsOnThePool) {
+  WorkStealingThreadPool pool("compression", 4);
+  const std::string data = MakeData(100000);
+  auto compressed = CompressChunked(data, 4096, &pool);
+  ASSERT_TRUE(compressed.ok());
+  EXPECT_LT(compressed->size(), data.size());
+
+  auto index = ReadChunkIndex(AsBytes(*compressed), compressed->size());
+  ASSERT_TRUE(index.ok());
+  EXPECT_EQ(index->uncompressed_size, data.size());
+  EXPECT_EQ(index->chunk_size, 4096);
+  EXPECT_EQ(index->chunk_end_offsets.size(), 25);
+
+  std::vector<uint8_t> output(data.size());
+  EXPECT_TRUE(DecompressChunked(AsBytes(*compressed), compressed->size(),
+                                output.data(), output.size(), &pool)
+                  .ok());
+  EXPECT_EQ(std::string(output.begin(), output.end()), data);
+}
+
+TEST(LiteRTLMCompressionTest, RoundTripsOnTheCallingThread) {
+  const std::string data = MakeData(10000);
+  auto compressed = CompressChunked(data, 3000);
+  ASSERT_TRUE(compressed.ok());
+
+  std::vector<uint8_t> output(data.size());
+  EXPECT_TRUE(DecompressChunked(AsBytes(*compressed), compressed->size(),
+                                output.data(), output.size())
+                  .ok());
+  EXPECT_EQ(std::string(output.begin(), output.end()), data);
+}
+
+TEST(LiteRTLMCompressionTest, CompressesFromStreamToStream) {
+  WorkStealingThreadPool pool("compression", 3);
+  const std::string data = MakeData(100000);
+  auto compressed = CompressChunked(data, 4096);
+  ASSERT_TRUE(compressed.ok());
+
+  std::istringstream input(data);
+  std::stringstream output;
+  // The section does not start at the beginning of the output.
+  output << "header";
+  auto size = CompressChunkedToStream(input, data.size(), 4096, output, &pool);
+  ASSERT_TRUE(size.ok());
+  EXPECT_EQ(*size, compressed->size());
+  EXPECT_EQ(output.str(), "header" + *compressed);
+
+  // The input is shorter than claimed.
+  std::istringstream short_input(data.substr(0, 5000));
+  std::stringstream short_output;
+  EXPECT_EQ(CompressChunkedToStream(short_input, data.size(), 4096,
+                                    short_output, &pool)
+                .status()
+                .code(),
+            absl::StatusCode::kDataLoss);
+}
+
+TEST(LiteRTLMCompressionTest, RejectsCorruptData) {
+  const std::string data = MakeData(10000);
+  auto compressed = CompressChunked(data, 3000);
+  ASSERT_TRUE(compressed.ok());
+  std::vector<uint8_t> output(data.size());
+
+  // The output must hold exactly the uncompressed data.
+  EXPECT_EQ(DecompressChunked(AsBytes(*compressed), compressed->size(),
+                              output.data(), output.size() - 1)
+                .code(),
+            absl::StatusCode::kInvalidArgument);
+  // The last chunk is cut.
+  EXPECT_EQ(DecompressChunked(AsBytes(*compressed), compressed->size() - 10,
+                              output.data(), output.size())
+                .code(),
+            absl::StatusCode::kDataLoss);
+  // Not a chunked section.
+  EXPECT_EQ(ReadChunkIndex(AsBytes(data), data.size()).status().code(),
+            absl::StatusCode::kDataLoss);
+}
+
+}  // namespace
+}  // namespace litert::lm::schema
@@ -1,33 +1,47 @@
 #include "schema/core/litertlm_export.h"
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
 #include <fstream>
 #include <iosfwd>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
 #include "absl/strings/str_format.h"  // from @com_google_absl
 #include "flatbuffers/buffer.h"  // from @flatbuffers
 #include "flatbuffers/flatbuffer_builder.h"  // from @flatbuffers
+#include "runtime/framework/work_stealing_threadpool.h"
+#include "schema/core/litertlm_hash.h"
 #include "schema/core/litertlm_header.h"
 #include "schema/core/litertlm_header_schema_generated.h"
 #include "schema/core/litertlm_section.h"
 #include "schema/core/litertlm_utils.h"
 #include "runtime/util/status_macros.h" //NOLINT
 
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif  // defined(__linux__)
+
 namespace litert {
 namespace lm {
 namespace schema {
 
 constexpr int kHeaderBeginByteOffset = 32;
 constexpr int kHeaderEndLocationByteOffset = 24;
-constexpr int kBlockSize = 16 * 1024;
+constexpr int kBlockSize = kSectionBlockSize;
 
 absl::Status WriteHeader(
     flatbuffers::FlatBufferBuilder& builder, std::ostream& output_stream,
@@ -91,13 +105,87 @@ absl::Status PadUntilNextPageBlock(std::ostream& output_file,
   return absl::OkStatus();
 }
 
+namespace {
+
+#if defined(__linux__)
+// Closes the file descriptor when it goes out of scope.
+class ScopedFd {
+ public:
+  explicit ScopedFd(int fd) : fd_(fd) {}
+  ~ScopedFd() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+  int get() const { return fd_; }
+
+ private:
+  int fd_;
+};
+
+// Appends the file at "path" to "output_file", opened at "out_path", file to
+// file in the kernel with copy_file_range(2). Returns false, having written
+// nothing, if the file systems do not support it.
+absl::StatusOr<bool> CopyFileRange(const std::string& path,
+                                   const std::string& out_path,
+                                   std::ofstream& output_file) {
+  ScopedFd in_fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  ScopedFd out_fd(open(out_path.c_str(), O_WRONLY | O_CLOEXEC));
+  struct stat in_stat;
+  if (in_fd.get() < 0 || out_fd.get() < 0 ||
+      fstat(in_fd.get(), &in_stat) != 0) {
+    return false;
+  }
+  // The buffered bytes must land before the copied ones.
+  output_file.flush();
+  loff_t in_offset = 0;
+  loff_t out_offset = output_file.tellp();
+  while (in_offset < in_stat.st_size) {
+    const ssize_t copied =
+        copy_file_range(in_fd.get(), &in_offset, out_fd.get(), &out_offset,
+                        in_stat.st_size - in_offset, /*flags=*/0);
+    if (copied < 0 && in_offset == 0 &&
+        (errno == EXDEV || errno == ENOSYS || errno == EINVAL ||
+         errno == EOPNOTSUPP)) {
+      return false;
+    }
+    if (copied <= 0) {
+      return absl::InternalError(absl::StrFormat(
+          "Failed to copy %s to the output file, errno: %d", path, errno));
+    }
+  }
+  output_file.seekp(out_offset);
+  return true;
+}
+#endif  // defined(__linux__)
+
+// Writes the prepared "section" at the end of "output_file". The sections
+// backed by a file as is are copied file to file where possible, and the
+// others are streamed, such that no section is held in memory as a whole.
+absl::Status WriteSection(SectionStreamBase& section,
+                          const std::string& out_path,
+                          std::ofstream& output_file) {
+#if defined(__linux__)
+  if (std::optional<std::string> path = section.BackingFilePath()) {
+    ASSIGN_OR_RETURN(bool copied, CopyFileRange(*path, out_path, output_file));
+    if (copied) {
+      return absl::OkStatus();
+    }
+  }
+#endif  // defined(__linux__)
+  return section.WriteTo(output_file);
+}
+
+}  // namespace
+
 absl::Status MakeLiteRTLMFromSections(
     flatbuffers::FlatBufferBuilder& builder,
     const std::vector<std::unique_ptr<SectionStreamBase>>& sections,
     const std::vector<AnySectionDataType>& section_types,
     const std::vector<KVPair>& system_metadata_map,
     const std::vector<std::vector<KVPair>>& section_items_maps,
-    const std::string& out_path) {
+    const std::string& out_path, uint64_t section_alignment,
+    bool record_content_hashes) {
   // ** Validation **
   if (sections.empty()) {
     ABSL_LOG(ERROR) << "Input sections list is empty.";
@@ -112,6 +200,15 @@ absl::Status MakeLiteRTLMFromSections(
                         "sections, section_types, and section_items_maps must "
                         "have the same size.");
   }
+  if (section_alignment % kBlockSize != 0) {
+    ABSL_LOG(ERROR) << "section_alignment must be a multiple of 16KB.";
+    return absl::Status(
+        absl::StatusCode::kInvalidArgument,
+        absl::StrFormat("section_alignment must be a multiple of %d, got %d.",
+                        kBlockSize, section_alignment));
+  }
+  const uint64_t block_size =
+      section_alignment == 0 ? kBlockSize : section_alignment;
 
   // ** Open an std::ostream for binary file writing **
   std::ofstream output_file(out_path, std::ios::binary);
@@ -134,39 +231,66 @@ absl::Status MakeLiteRTLMFromSections(
   // ** 1. Write zero pad until offset kBlockSize. **
   RETURN_IF_ERROR(PadUntilNextPageBlock(output_file, kBlockSize));
 
-  // ** 2. Write the sections. **
+  // ** 2. Write the sections, each at the next block. **
+  RETURN_IF_ERROR(PadUntilNextPageBlock(output_file, block_size));
   std::vector<std::pair<uint64_t, uint64_t>> section_offsets;
   for (size_t i = 0; i < sections.size(); ++i) {
     RETURN_IF_ERROR(sections[i]->Prepare());
     std::streampos start_byte_offset = output_file.tellp();  // capture start
-    std::istream& strm = sections[i]->GetStream();
-    output_file << strm.rdbuf();
+    RETURN_IF_ERROR(WriteSection(*sections[i], out_path, output_file));
     std::streampos end_byte_offset = output_file.tellp();  // capture end
     section_offsets.push_back(
         std::make_pair(static_cast<uint64_t>(start_byte_offset),
                        static_cast<uint64_t>(end_byte_offset)));
     RETURN_IF_ERROR(sections[i]->Finalize());
-    RETURN_IF_ERROR(PadUntilNextPageBlock(output_file, kBlockSize));
+    RETURN_IF_ERROR(PadUntilNextPageBlock(output_file, block_size));
+  }
+
+  // ** 3. Hash the sections as written, if asked. **
+  std::vector<std::string> content_hashes;
+  if (record_content_hashes) {
+    output_file.flush();
+    WorkStealingThreadPool pool(
+        "section_hashing",
+        std::max<size_t>(1, std::thread::hardware_concurrency()));
+    for (const auto& [begin_offset, end_offset] : section_offsets) {
+      ASSIGN_OR_RETURN(uint64_t hash,
+                       ContentHashOfFileRange(out_path, begin_offset,
+                                              end_offset, &pool));
+      content_hashes.push_back(FormatContentHash(hash));
+    }
   }
 
-  // ** 3. Write the header. **
+  // ** 4. Write the header. **
   output_file.seekp(kHeaderBeginByteOffset, std::ios::beg);
 
+  // The alignment is recorded for the readers to verify.
+  std::vector<std::vector<KVPair>> section_items = section_items_maps;
+  if (section_alignment != 0) {
+    for (auto& items : section_items) {
+      items.push_back(CreateKeyValuePair(
+          builder, std::string(kSectionAlignmentKey), section_alignment));
+    }
+  }
+  for (size_t i = 0; i < content_hashes.size(); ++i) {
+    section_items[i].push_back(
+        CreateKeyValuePair(builder, std::string(kSectionContentHashKey),
+                           content_hashes[i]));
+  }
   RETURN_IF_ERROR(WriteHeader(builder, output_file, system_metadata_map,
-                              section_items_maps, section_offsets,
-                              section_types));
+                              section_items, section_offsets, section_types));
   std::streampos header_end_pos = output_file.tellp();
   uint64_t header_end_offset = static_cast<uint64_t>(header_end_pos);
   ABSL_DLOG(INFO) << "Header End Offset is " << header_end_offset;
 
-  // ** 4. Check if header exceeds 16k boundary**
+  // ** 5. Check if header exceeds 16k boundary**
   if (header_end_offset > kBlockSize) {
     // TODO(413978412): support headers > 16KB in this header writer.
     ABSL_LOG(ERROR) << "Header size exceeds 16KB limit.";
     return absl::Status(absl::StatusCode::kInternal,
                         "Header size exceeds 16KB limit.");
   }
-  // ** 5. Finally, write the header end offset. **
+  // ** 6. Finally, write the header end offset. **
   output_file.seekp(kHeaderEndLocationByteOffset, std::ios::beg);
   output_file.write(reinterpret_cast<const char*>(&header_end_offset),
                     sizeof(uint64_t));
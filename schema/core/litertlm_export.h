@@ -1,6 +1,7 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_EXPORT_H_
 #define THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_EXPORT_H_
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <map>
@@ -32,6 +33,14 @@ using KVPairs = std::vector<KVPair>;
 //   system_metadata_map: a vector of system metadata key value pair.
 //   section_items_maps: a vector of key-value pairs for section metadata.
 //   out_path: output path of the LiteRT-LM file.
+//   section_alignment: if not 0, the alignment of the sections in the file,
+//     recorded in the kSectionAlignmentKey item of each section, e.g. the
+//     memory mapping granularity of the target OS, such that each section is
+//     mapped in place. Must be a multiple of kSectionBlockSize. If 0, the
+//     sections are padded to kSectionBlockSize, and no alignment is recorded.
+//   record_content_hashes: whether the content hash of each section, as
+//     written, is recorded in its kSectionContentHashKey item. The sections
+//     are read back from the output file in chunks hashed in parallel.
 //
 // Returns:
 //   absl::Status.
@@ -41,7 +50,8 @@ absl::Status MakeLiteRTLMFromSections(
     const std::vector<AnySectionDataType>& section_types,
     const std::vector<KVPair>& system_metadata_map,
     const std::vector<std::vector<KVPair>>& section_items_maps,
-    const std::string& out_path);
+    const std::string& out_path, uint64_t section_alignment = 0,
+    bool record_content_hashes = false);
 
 }  // end namespace schema
 }  // end namespace lm
@@ -0,0 +1,193 @@
+#include "schema/core/litertlm_hash.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "absl/status/status.h"  // from @com_google_absl
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/str_format.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "absl/synchronization/blocking_counter.h"  // from @com_google_absl
+#include "runtime/framework/work_stealing_threadpool.h"
+#include "runtime/util/status_macros.h"  // NOLINT
+
+namespace litert {
+namespace lm {
+namespace schema {
+namespace {
+
+constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+uint64_t RotateLeft(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t Read64(const char* data) {
+  uint64_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+uint32_t Read32(const char* data) {
+  uint32_t value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+uint64_t Round(uint64_t acc, uint64_t input) {
+  acc += input * kPrime2;
+  return RotateLeft(acc, 31) * kPrime1;
+}
+
+uint64_t MergeRound(uint64_t acc, uint64_t value) {
+  acc ^= Round(0, value);
+  return acc * kPrime1 + kPrime4;
+}
+
+// Runs "fn(i)" for each chunk i in [0, num_chunks), on "pool" if not null,
+// and returns the first error.
+template <typename Fn>
+absl::Status ForEachChunk(uint64_t num_chunks, WorkStealingThreadPool* pool,
+                          Fn fn) {
+  std::vector<absl::Status> statuses(num_chunks);
+  if (pool == nullptr || num_chunks <= 1) {
+    for (uint64_t i = 0; i < num_chunks; ++i) {
+      statuses[i] = fn(i);
+    }
+  } else {
+    absl::BlockingCounter done(static_cast<int>(num_chunks));
+    for (uint64_t i = 0; i < num_chunks; ++i) {
+      auto status = pool->Schedule([&fn, &statuses, &done, i]() {
+        statuses[i] = fn(i);
+        done.DecrementCount();
+      });
+      if (!status.ok()) {
+        statuses[i] = fn(i);
+        done.DecrementCount();
+      }
+    }
+    done.Wait();
+  }
+  for (auto& status : statuses) {
+    RETURN_IF_ERROR(status);  // NOLINT
+  }
+  return absl::OkStatus();
+}
+
+// Combines the hashes of the chunks of a section of "size" bytes.
+uint64_t CombineChunkHashes(uint64_t size,
+                            const std::vector<uint64_t>& chunk_hashes) {
+  std::string combined(reinterpret_cast<const char*>(&size), sizeof(size));
+  combined.append(reinterpret_cast<const char*>(chunk_hashes.data()),
+                  chunk_hashes.size() * sizeof(uint64_t));
+  return Xxh64(combined);
+}
+
+}  // namespace
+
+uint64_t Xxh64(absl::string_view data, uint64_t seed) {
+  const char* p = data.data();
+  const char* const end = p + data.size();
+  uint64_t hash;
+  if (data.size() >= 32) {
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+    for (; p + 32 <= end; p += 32) {
+      v1 = Round(v1, Read64(p));
+      v2 = Round(v2, Read64(p + 8));
+      v3 = Round(v3, Read64(p + 16));
+      v4 = Round(v4, Read64(p + 24));
+    }
+    hash = RotateLeft(v1, 1) + RotateLeft(v2, 7) + RotateLeft(v3, 12) +
+           RotateLeft(v4, 18);
+    hash = MergeRound(hash, v1);
+    hash = MergeRound(hash, v2);
+    hash = MergeRound(hash, v3);
+    hash = MergeRound(hash, v4);
+  } else {
+    hash = seed + kPrime5;
+  }
+  hash += data.size();
+  for (; p + 8 <= end; p += 8) {
+    hash ^= Round(0, Read64(p));
+    hash = RotateLeft(hash, 27) * kPrime1 + kPrime4;
+  }
+  if (p + 4 <= end) {
+    hash ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+    hash = RotateLeft(hash, 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; ++p) {
+    hash ^= static_cast<uint8_t>(*p) * kPrime5;
+    hash = RotateLeft(hash, 11) * kPrime1;
+  }
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+uint64_t ContentHash(absl::string_view data, WorkStealingThreadPool* pool) {
+  const uint64_t num_chunks =
+      (data.size() + kContentHashChunkSize - 1) / kContentHashChunkSize;
+  std::vector<uint64_t> chunk_hashes(num_chunks);
+  ForEachChunk(num_chunks, pool, [&](uint64_t i) {
+    chunk_hashes[i] =
+        Xxh64(data.substr(i * kContentHashChunkSize, kContentHashChunkSize));
+    return absl::OkStatus();
+  }).IgnoreError();
+  return CombineChunkHashes(data.size(), chunk_hashes);
+}
+
+absl::StatusOr<uint64_t> ContentHashOfFileRange(const std::string& path,
+                                                uint64_t begin, uint64_t end,
+                                                WorkStealingThreadPool* pool) {
+  if (end < begin) {
+    return absl::InvalidArgumentError(
+        absl::StrCat("Invalid range [", begin, ", ", end, ") of ", path));
+  }
+  const uint64_t size = end - begin;
+  const uint64_t num_chunks =
+      (size + kContentHashChunkSize - 1) / kContentHashChunkSize;
+  std::vector<uint64_t> chunk_hashes(num_chunks);
+  RETURN_IF_ERROR(ForEachChunk(  // NOLINT
+      num_chunks, pool, [&](uint64_t i) -> absl::Status {
+        // Each chunk is read through a stream of its own, as they are read
+        // concurrently.
+        std::ifstream file(path, std::ios::binary);
+        std::string chunk(
+            std::min(kContentHashChunkSize, size - i * kContentHashChunkSize),
+            '\0');
+        file.seekg(begin + i * kContentHashChunkSize);
+        if (!file.read(chunk.data(), chunk.size())) {
+          return absl::DataLossError(
+              absl::StrCat("Failed to read chunk ", i, " of [", begin, ", ",
+                           end, ") of ", path));
+        }
+        chunk_hashes[i] = Xxh64(chunk);
+        return absl::OkStatus();
+      }));
+  return CombineChunkHashes(size, chunk_hashes);
+}
+
+std::string FormatContentHash(uint64_t hash) {
+  return absl::StrFormat("%016x", hash);
+}
+
+}  // end namespace schema
+}  // end namespace lm
+}  // end namespace litert
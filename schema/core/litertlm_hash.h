@@ -0,0 +1,50 @@
+#ifndef THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_HASH_H_
+#define THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_HASH_H_
+
+#include <cstdint>
+#include <string>
+
+#include "absl/status/statusor.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "runtime/framework/work_stealing_threadpool.h"
+
+namespace litert {
+namespace lm {
+namespace schema {
+
+// The content hash of a section, recorded as the kSectionContentHashKey item
+// of the section. It identifies the bytes of the section as stored in the file,
+// such that the caches built from a model are keyed without reading its
+// weights, and the sections that changed between two files are found from
+// their headers.
+//
+// The stored bytes are split in chunks of kContentHashChunkSize bytes, the
+// last one possibly shorter, each hashed on its own with XXH64, such that the
+// chunks are hashed in parallel. The content hash is the XXH64 of the size of
+// the section followed by the hashes of its chunks, as little endian uint64s.
+// It is recorded as 16 lowercase hex digits.
+constexpr uint64_t kContentHashChunkSize = 4 * 1024 * 1024;
+
+// Returns the XXH64 hash of "data".
+uint64_t Xxh64(absl::string_view data, uint64_t seed = 0);
+
+// Returns the content hash of "data". The chunks are hashed on "pool" if not
+// null, or on the calling thread.
+uint64_t ContentHash(absl::string_view data,
+                     WorkStealingThreadPool* pool = nullptr);
+
+// Returns the content hash of the [begin, end) bytes of the file at "path",
+// read one chunk at a time per thread of "pool", or on the calling thread if
+// "pool" is null.
+absl::StatusOr<uint64_t> ContentHashOfFileRange(
+    const std::string& path, uint64_t begin, uint64_t end,
+    WorkStealingThreadPool* pool = nullptr);
+
+// Formats "hash" as recorded in the kSectionContentHashKey item.
+std::string FormatContentHash(uint64_t hash);
+
+}  // end namespace schema
+}  // end namespace lm
+}  // end namespace litert
+
+#endif  // THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_HASH_H_
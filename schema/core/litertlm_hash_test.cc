@@ -0,0 +1,66 @@
+#include "schema/core/litertlm_hash.h"
+
+#include <cstddef>
+#include <filesystem>  // NOLINT: Required for path manipulation.
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+#include "absl/status/status.h"  // from @com_google_absl
+#include "runtime/framework/work_stealing_threadpool.h"
+
+namespace litert::lm::schema {
+namespace {
+
+std::string MakeData(size_t size) {
+  std::string data(size, '\0');
+  for (size_t i = 0; i < size; ++i) {
+    data[i] = static_cast<char>((i * 7) % 251 + (i / 1000) % 5);
+  }
+  return data;
+}
+
+TEST(LiteRTLMHashTest, Xxh64MatchesTheReference) {
+  EXPECT_EQ(Xxh64(""), 0xEF46DB3751D8E999ULL);
+  EXPECT_EQ(Xxh64("abc"), 0x44BC2CF5AD770999ULL);
+  EXPECT_EQ(Xxh64("Nobody inspects the spammish repetition"),
+            0xFBCEA83C8A378BF1ULL);
+}
+
+TEST(LiteRTLMHashTest, ContentHashDoesNotDependOnThePool) {
+  WorkStealingThreadPool pool("hash", 4);
+  const std::string data = MakeData(3 * kContentHashChunkSize + 1000);
+  const uint64_t hash = ContentHash(data);
+  EXPECT_EQ(ContentHash(data, &pool), hash);
+  EXPECT_EQ(FormatContentHash(hash).size(), 16);
+
+  // Any byte changes the hash, as does the size.
+  std::string changed = data;
+  changed[2 * kContentHashChunkSize + 5] ^= 1;
+  EXPECT_NE(ContentHash(changed, &pool), hash);
+  EXPECT_NE(ContentHash(data.substr(0, data.size() - 1), &pool), hash);
+}
+
+TEST(LiteRTLMHashTest, ContentHashOfFileRangeMatchesTheBytes) {
+  WorkStealingThreadPool pool("hash", 3);
+  const std::string data = MakeData(2 * kContentHashChunkSize + 123);
+  const std::string path =
+      (std::filesystem::path(::testing::TempDir()) / "hashed.bin").string();
+  {
+    std::ofstream file(path, std::ios::binary);
+    file << "prefix" << data << "suffix";
+  }
+  auto hash = ContentHashOfFileRange(path, 6, 6 + data.size(), &pool);
+  ASSERT_TRUE(hash.ok());
+  EXPECT_EQ(*hash, ContentHash(data));
+
+  EXPECT_EQ(ContentHashOfFileRange(path, 6, 100 + data.size(), &pool)
+                .status()
+                .code(),
+            absl::StatusCode::kDataLoss);
+  EXPECT_EQ(ContentHashOfFileRange(path, 6, 5).status().code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
+}  // namespace
+}  // namespace litert::lm::schema
@@ -20,9 +20,24 @@ namespace schema {
 //                compatible manner.
 // PATCH version: increments on backward compatible bug fixes.
 constexpr uint32_t LITERTLM_MAJOR_VERSION = 1;
-constexpr uint32_t LITERTLM_MINOR_VERSION = 2;
+constexpr uint32_t LITERTLM_MINOR_VERSION = 4;
 constexpr uint32_t LITERTLM_PATCH_VERSION = 0;
 
+// The block size the header and the sections are padded to by default.
+constexpr uint64_t kSectionBlockSize = 16 * 1024;
+
+// The key of the section item recording the alignment of the section in a
+// file written with an aligned layout, as a uint64.
+constexpr char kSectionAlignmentKey[] = "section_alignment";
+
+// The key of the section item recording the compression of the section, as a
+// string, e.g. "zlib_chunked". The section is stored as is without it.
+constexpr char kSectionCompressionKey[] = "compression";
+
+// The key of the section item recording the content hash of the stored bytes
+// of the section, as a string. See litertlm_hash.h for the hash.
+constexpr char kSectionContentHashKey[] = "content_hash";
+
 // Alias for a fully constructed KeyValuePair for LiteRTLM metadata.
 // Users of the CreateKeyValuePair function (see below) will get
 // back one of these during the creation of their metadata
@@ -3,6 +3,7 @@
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
@@ -89,9 +90,38 @@ void PrintKeyValuePair(const KeyValuePair* kvp, std::ostream& output_stream,
   }
 }
 
+// Prints one line per section of the index, from the header only.
+void PrintSectionIndex(const LiteRTLMMetaData& metadata,
+                       std::ostream& output_stream) {
+  const std::vector<SectionIndexEntry> index = BuildSectionIndex(metadata);
+  PrintBoxedTitle(output_stream,
+                  "Section Index (" + std::to_string(index.size()) + ")");
+  for (const SectionIndexEntry& entry : index) {
+    output_stream << std::string(INDENT_SPACES, ' ') << entry.section_index
+                  << ": " << AnySectionDataTypeToString(entry.data_type);
+    if (!entry.model_type.empty()) {
+      output_stream << " (" << entry.model_type << ")";
+    }
+    output_stream << ", offset " << entry.begin_offset << ", size "
+                  << entry.end_offset - entry.begin_offset;
+    if (entry.alignment != 0) {
+      output_stream << ", alignment " << entry.alignment;
+    }
+    if (!entry.compression.empty()) {
+      output_stream << ", " << entry.compression;
+    }
+    if (!entry.content_hash.empty()) {
+      output_stream << ", hash " << entry.content_hash;
+    }
+    output_stream << "\n";
+  }
+  output_stream << "\n";
+}
+
 // Main function to process and print the LiteRT-LM file information
 absl::Status ProcessLiteRTLMFile(const std::string& litertlm_file,
-                                 std::ostream& output_stream) {
+                                 std::ostream& output_stream,
+                                 bool index_only) {
   LitertlmHeader header;
   absl::Status status = ReadHeaderFromLiteRTLM(litertlm_file, &header);
 
@@ -132,6 +162,11 @@ absl::Status ProcessLiteRTLMFile(const std::string& litertlm_file,
   }
   output_stream << "\n";  // Add a newline after system metadata block
 
+  PrintSectionIndex(*header.metadata, output_stream);
+  if (index_only) {
+    return absl::OkStatus();
+  }
+
   // Print section information with boxing
   auto section_metadata_obj = header.metadata->section_metadata();
   auto section_objects = section_metadata_obj->objects();
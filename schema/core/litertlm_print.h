@@ -16,8 +16,12 @@ namespace lm {
 namespace schema {
 
 // Send info about the LiteRT-LM file to the output stream.
+// Prints the header of the LiteRT-LM file, its section index, and each of its
+// sections. If "index_only", only the header is read and the sections are not
+// printed.
 absl::Status ProcessLiteRTLMFile(const std::string& litertlm_file,
-                                 std::ostream& output_stream);
+                                 std::ostream& output_stream,
+                                 bool index_only = false);
 
 }  // end namespace schema
 }  // end namespace lm
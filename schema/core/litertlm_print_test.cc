@@ -31,6 +31,22 @@ TEST(LiteRTLMPrintTest, ProcessLiteRTLMFileTest) {
             std::string::npos);
 }
 
+TEST(LiteRTLMPrintTest, ProcessLiteRTLMFileIndexOnlyTest) {
+  const auto input_filename =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/schema/testdata/test_tok_tfl_llm.litertlm";
+
+  std::stringstream output_ss;
+  absl::Status result = ProcessLiteRTLMFile(input_filename.string(), output_ss,
+                                            /*index_only=*/true);
+  ASSERT_TRUE(result.ok());
+  EXPECT_NE(output_ss.str().find("Section Index (3)"), std::string::npos);
+  EXPECT_NE(output_ss.str().find("AnySectionDataType_TFLiteModel"),
+            std::string::npos);
+  // The sections themselves are not read.
+  EXPECT_EQ(output_ss.str().find("start of LlmMetadata"), std::string::npos);
+}
+
 }  // namespace
 }  // namespace schema
 }  // namespace lm
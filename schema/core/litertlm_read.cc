@@ -229,27 +229,43 @@ absl::Status ReadSectionIntoTFLiteMappedFile(
   return absl::OkStatus();
 }
 
+// Function to map the bytes of a section without copying them.
+absl::Status MapSectionIntoView(const std::string& litertlm_path,
+                                uint64_t begin_offset, uint64_t end_offset,
+                                LitertlmSectionView* view) {
+  // The mapping starts at the page holding the section, as the offsets of the
+  // mappings must be aligned.
+  const uint64_t alignment = MemoryMappedFile::GetOffsetAlignment();
+  const uint64_t map_offset = begin_offset / alignment * alignment;
+  ASSIGN_OR_RETURN(auto model_file,  // NOLINT
+                   lm::ScopedFile::Open(litertlm_path));
+  absl::StatusOr<std::unique_ptr<MemoryMappedFile>> mmap_status =
+      MemoryMappedFile::Create(model_file.file(), map_offset,
+                               end_offset - map_offset, "section",
+                               MemoryMappedFile::Advice::kNormal);
+  if (!mmap_status.ok()) {
+    return absl::InternalError(absl::StrFormat(
+        "Failed to map the bytes [%d, %d) of %s: %s", begin_offset, end_offset,
+        litertlm_path, mmap_status.status().ToString()));
+  }
+  *view = LitertlmSectionView(std::move(*mmap_status),
+                              begin_offset - map_offset,
+                              end_offset - begin_offset);
+  return absl::OkStatus();
+}
+
 // Function to read LlmMetadata from a section.
 absl::Status ReadSectionIntoLlmMetadata(const std::string& litertlm_path,
                                         uint64_t begin_offset,
                                         uint64_t end_offset,
                                         LlmMetadata* llm_metadata) {
-  // Create an ifstream from the file.
-  std::ifstream input_file_stream(litertlm_path, std::ios::binary);
-  if (!input_file_stream.is_open()) {
-    return absl::InternalError(
-        absl::StrFormat("Could not open file: %s", litertlm_path));
-  }
-  input_file_stream.seekg(begin_offset);
-
-  size_t size = end_offset - begin_offset;
-  std::unique_ptr<char[]> buffer(new char[size]);
-  input_file_stream.read(buffer.get(), size);
-  if (!input_file_stream) {
-    return absl::InternalError(
-        absl::StrFormat("Could not read %d bytes from stream.", size));
+  // Parsed straight out of the mapping.
+  LitertlmSectionView view;
+  RETURN_IF_ERROR(MapSectionIntoView(litertlm_path,  // NOLINT
+                                     begin_offset, end_offset, &view));
+  if (!llm_metadata->ParseFromArray(view.data(), view.size())) {
+    return absl::InvalidArgumentError("Failed to parse the LlmMetadata.");
   }
-  llm_metadata->ParseFromArray(buffer.get(), size);
   return absl::OkStatus();
 }
 
@@ -257,44 +273,21 @@ absl::Status ReadSectionIntoLlmMetadata(const std::string& litertlm_path,
 absl::Status ReadSectionIntoSPTokenizer(
     const std::string& litertlm_path, uint64_t begin_offset,
     uint64_t end_offset, sentencepiece::SentencePieceProcessor* sp_proc) {
-  // Create an ifstream from the file.
-  std::ifstream input_file_stream(litertlm_path, std::ios::binary);
-  if (!input_file_stream.is_open()) {
-    return absl::InternalError(
-        absl::StrFormat("Could not open file: %s", litertlm_path));
-  }
-  input_file_stream.seekg(begin_offset);
-
-  size_t size = end_offset - begin_offset;
-  std::unique_ptr<char[]> buffer(new char[size]);
-  input_file_stream.read(buffer.get(), size);
-  if (!input_file_stream) {
-    return absl::InternalError(
-        absl::StrFormat("Could not read %d bytes from stream.", size));
-  }
-  absl::string_view buffer_view(buffer.get(), size);
-  return sp_proc->LoadFromSerializedProto(buffer_view);
+  LitertlmSectionView view;
+  RETURN_IF_ERROR(MapSectionIntoView(litertlm_path,  // NOLINT
+                                     begin_offset, end_offset, &view));
+  return sp_proc->LoadFromSerializedProto(view.AsStringView());
 }
 
 absl::Status ReadSectionIntoBinaryData(const std::string& litertlm_path,
                                        uint64_t begin_offset,
                                        uint64_t end_offset,
                                        std::vector<uint8_t>* data) {
-  // Create an ifstream from the file.
-  std::ifstream input_file_stream(litertlm_path, std::ios::binary);
-  if (!input_file_stream.is_open()) {
-    return absl::InternalError(
-        absl::StrFormat("Could not open file: %s", litertlm_path));
-  }
-  input_file_stream.seekg(begin_offset);
-
-  size_t size = end_offset - begin_offset;
-  data->resize(size);
-  input_file_stream.read(reinterpret_cast<char*>(data->data()), size);
-  if (!input_file_stream) {
-    return absl::InternalError(
-        absl::StrFormat("Could not read %d bytes from stream.", size));
-  }
+  // The caller owns a copy, which is done in a single pass from the mapping.
+  LitertlmSectionView view;
+  RETURN_IF_ERROR(MapSectionIntoView(litertlm_path,  // NOLINT
+                                     begin_offset, end_offset, &view));
+  data->assign(view.data(), view.data() + view.size());
   return absl::OkStatus();
 }
 
@@ -335,10 +328,11 @@ absl::Status DecompressData(const uint8_t* compressed_data,
 absl::Status ReadSectionIntoHfTokenizerJsonData(
     const std::string& litertlm_path, uint64_t begin_offset,
     uint64_t end_offset, std::string* output) {
-  std::vector<uint8_t> compressed_data;
-  RETURN_IF_ERROR(ReadSectionIntoBinaryData(litertlm_path,  // NOLINT
-                                            begin_offset, end_offset,
-                                            &compressed_data));
+  // Decompressed straight out of the mapping.
+  LitertlmSectionView compressed_data;
+  RETURN_IF_ERROR(MapSectionIntoView(litertlm_path,  // NOLINT
+                                     begin_offset, end_offset,
+                                     &compressed_data));
 
   std::vector<uint8_t> uncompressed_data;
   RETURN_IF_ERROR(DecompressData(compressed_data.data(),  // NOLINT
@@ -426,6 +420,36 @@ absl::Status ReadBinaryDataFromSection(const std::string& litertlm_path,
           ReadSectionIntoBinaryData));
 }
 
+absl::Status MapBinaryDataFromSection(const std::string& litertlm_path,
+                                      int section_idx,
+                                      LitertlmSectionView* view) {
+  return ReadValueTFromSection<AnySectionDataType_GenericBinaryData,
+                               LitertlmSectionView>(
+      litertlm_path, section_idx, view,
+      std::function<absl::Status(const std::string&, uint64_t, uint64_t,
+                                 LitertlmSectionView*)>(MapSectionIntoView));
+}
+
+absl::Status MapSectionFromLiteRTLM(const std::string& litertlm_path,
+                                    int section_idx,
+                                    LitertlmSectionView* view) {
+  LitertlmHeader header;
+  RETURN_IF_ERROR(ReadHeaderFromLiteRTLM(litertlm_path, &header));  // NOLINT
+  auto sections = header.metadata->section_metadata()->objects();
+  if (section_idx < 0 || section_idx >= sections->size()) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Invalid section index: %d, num sections = %d",
+                        section_idx, sections->size()));
+  }
+  const SectionObject* section = sections->Get(section_idx);
+  if (section->end_offset() <= section->begin_offset()) {
+    return absl::InvalidArgumentError(
+        absl::StrFormat("Section %d has zero size.", section_idx));
+  }
+  return MapSectionIntoView(litertlm_path, section->begin_offset(),
+                            section->end_offset(), view);
+}
+
 template <AnySectionDataType SectionT, typename T, typename Callable,
           typename... Args>
 absl::Status ReadAnyT(const std::string& litertlm_path, T* data,
@@ -512,6 +536,15 @@ absl::Status ReadAnyBinaryData(const std::string& litertlm_path,
           ReadBinaryDataFromSection));
 }
 
+absl::Status MapAnyBinaryData(const std::string& litertlm_path,
+                              LitertlmSectionView* view) {
+  return ReadAnyT<AnySectionDataType_GenericBinaryData, LitertlmSectionView>(
+      litertlm_path, view,
+      std::function<absl::Status(const std::string&, int,
+                                 LitertlmSectionView*)>(
+          MapBinaryDataFromSection));
+}
+
 absl::Status ReadAnyHfTokenizerJson(const std::string& litertlm_path,
                                     std::string* tokenizer_json) {
   return ReadAnyT<AnySectionDataType_HF_Tokenizer_Zlib, std::string>(
@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
 #include "runtime/proto/llm_metadata.pb.h"
 #include "runtime/util/memory_mapped_file.h"
 #include "schema/core/litertlm_header_schema_generated.h"
@@ -67,6 +68,42 @@ struct LitertlmHeader {
   }
 };
 
+// A zero-copy, read-only view of the bytes of a section of a LiteRT-LM file,
+// memory mapped from the file. The bytes are paged in from the file on
+// access, and stay valid as long as the view, which owns the mapping, is
+// alive. The view can be moved, e.g. into the object reading the bytes.
+class LitertlmSectionView {
+ public:
+  LitertlmSectionView() = default;
+  // The section is the `size` bytes at `offset` of the mapping.
+  LitertlmSectionView(std::unique_ptr<MemoryMappedFile> mapped_file,
+                      size_t offset, size_t size)
+      : mapped_file_(std::move(mapped_file)), offset_(offset), size_(size) {}
+
+  LitertlmSectionView(LitertlmSectionView&&) = default;
+  LitertlmSectionView& operator=(LitertlmSectionView&&) = default;
+
+  // Returns the first byte of the section, or nullptr if the view is empty.
+  const uint8_t* data() const {
+    return mapped_file_ == nullptr
+               ? nullptr
+               : static_cast<const uint8_t*>(mapped_file_->data()) + offset_;
+  }
+  size_t size() const { return size_; }
+  absl::string_view AsStringView() const {
+    return absl::string_view(reinterpret_cast<const char*>(data()), size_);
+  }
+
+  // The mapping holding the section, e.g. to advise the OS of how the bytes
+  // are read, or nullptr if the view is empty.
+  MemoryMappedFile* mapped_file() const { return mapped_file_.get(); }
+
+ private:
+  std::unique_ptr<MemoryMappedFile> mapped_file_;
+  size_t offset_ = 0;
+  size_t size_ = 0;
+};
+
 // Reads the LiteRTLM file header starting at `data`. It is assumed
 // that this function can read up to `length` bytes starting at `data`.
 //
@@ -190,6 +227,22 @@ absl::Status ReadBinaryDataFromSection(const std::string& litertlm_path,
 absl::Status ReadAnyBinaryData(const std::string& litertlm_path,
                                std::vector<uint8_t>* data);
 
+// Maps the bytes of the specified section in the LiteRT-LM file, whatever its
+// type, without copying them. See LitertlmSectionView for their lifetime.
+// Returns InvalidArgumentError if the section does not exist or is empty.
+absl::Status MapSectionFromLiteRTLM(const std::string& litertlm_path,
+                                    int section_idx,
+                                    LitertlmSectionView* view);
+
+// Zero-copy version of ReadBinaryDataFromSection().
+absl::Status MapBinaryDataFromSection(const std::string& litertlm_path,
+                                      int section_idx,
+                                      LitertlmSectionView* view);
+
+// Zero-copy version of ReadAnyBinaryData().
+absl::Status MapAnyBinaryData(const std::string& litertlm_path,
+                              LitertlmSectionView* view);
+
 // Decompressed Zlib data. The first uint64_t bytes should contain the
 // uncompressed data size, the remaining bytes contain the compressed data.
 absl::Status DecompressData(const uint8_t* compressed_data,
@@ -7,6 +7,7 @@
 #include <iterator>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <gmock/gmock.h>
@@ -149,6 +150,45 @@ TEST(LiteRTLMReadTest, TFLiteReadBinaryData) {
             "Dummy Binary Data Content");
 }
 
+TEST(LiteRTLMReadTest, MapBinaryData) {
+  const auto input_filename =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/schema/testdata/test_tok_tfl_llm.litertlm";
+
+  LitertlmSectionView view;
+  ASSERT_OK(MapBinaryDataFromSection(input_filename.string(), 3, &view));
+  // The view stays valid once moved.
+  LitertlmSectionView moved_view = std::move(view);
+  EXPECT_EQ(moved_view.AsStringView(), "Dummy Binary Data Content");
+
+  LitertlmSectionView any_view;
+  ASSERT_OK(MapAnyBinaryData(input_filename.string(), &any_view));
+  EXPECT_EQ(any_view.AsStringView(), "Dummy Binary Data Content");
+
+  // The wrong type of section.
+  EXPECT_THAT(MapBinaryDataFromSection(input_filename.string(), 0, &view),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
+TEST(LiteRTLMReadTest, MapSectionMatchesRead) {
+  const auto input_filename =
+      std::filesystem::path(::testing::SrcDir()) /
+      "litert_lm/schema/testdata/test_tok_tfl_llm.litertlm";
+
+  LitertlmSectionView view;
+  ASSERT_OK(MapSectionFromLiteRTLM(input_filename.string(), 2, &view));
+  proto::LlmMetadata mapped_metadata;
+  ASSERT_TRUE(mapped_metadata.ParseFromArray(view.data(), view.size()));
+  proto::LlmMetadata read_metadata;
+  ASSERT_OK(
+      ReadLlmMetadataFromSection(input_filename.string(), 2, &read_metadata));
+  EXPECT_EQ(mapped_metadata.SerializeAsString(),
+            read_metadata.SerializeAsString());
+
+  EXPECT_THAT(MapSectionFromLiteRTLM(input_filename.string(), 100, &view),
+              testing::status::StatusIs(absl::StatusCode::kInvalidArgument));
+}
+
 TEST(LiteRTLMReadTest, TFLiteReadAny) {
   const auto input_filename =
       std::filesystem::path(::testing::SrcDir()) /
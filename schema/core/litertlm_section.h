@@ -7,17 +7,20 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
-#include <iterator>
 #include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "runtime/framework/work_stealing_threadpool.h"
 #include "runtime/util/status_macros.h"  // NOLINT
+#include "schema/core/litertlm_compression.h"
 #include "zconf.h"  // from @zlib
 
 namespace litert {
@@ -77,55 +80,70 @@ class SectionStreamBase {
 
   // BufferSize:  Pure virtual function get the size of the streamed buffer.
   virtual size_t BufferSize() const = 0;
+
+  // WriteTo: Writes the section to "output_stream", after Prepare(). By
+  // default, the stream is copied in chunks of kSectionCopyChunkSize bytes.
+  // The sections produced on the fly, e.g. compressed ones, override it to
+  // write straight into "output_stream" without holding the whole section.
+  virtual absl::Status WriteTo(std::ostream& output_stream) {
+    return CopyStream(GetStream(), output_stream);
+  }
+
+  // BackingFilePath: The file holding the section bytes as is, if any, such
+  // that the writer copies it file to file, e.g. with copy_file_range(2),
+  // instead of through user space.
+  virtual std::optional<std::string> BackingFilePath() const {
+    return std::nullopt;
+  }
+
+ protected:
+  static constexpr size_t kSectionCopyChunkSize = 1024 * 1024;
+
+  // Copies "input" to "output" in chunks of kSectionCopyChunkSize bytes.
+  static absl::Status CopyStream(std::istream& input, std::ostream& output) {
+    std::vector<char> chunk(kSectionCopyChunkSize);
+    while (input) {
+      input.read(chunk.data(), chunk.size());
+      output.write(chunk.data(), input.gcount());
+    }
+    // Read to its end, unless it failed before.
+    if (!input.eof() || input.bad() || !output.good()) {
+      return absl::InternalError("Failed to copy the section stream.");
+    }
+    return absl::OkStatus();
+  }
 };
 
-// A basic derived class for a file-backed stream. Reads the provided file
-// during the Prepare(), holds it in an internal buffer, and then provides
-// an input string stream for the caller to stream its contents.
+// A basic derived class for a file-backed stream. Opens the provided file
+// during the Prepare(), and streams it from disk, such that the file is never
+// held in memory.
 class FileBackedSectionStream : public SectionStreamBase {
  public:
   // Constructor: Takes the file path.
   explicit FileBackedSectionStream(const std::string& file_path)
-      : file_path_(file_path), buffer_(nullptr), buffer_size_(0) {}
+      : file_path_(file_path), buffer_size_(0) {}
 
   ~FileBackedSectionStream() override = default;
 
-  // Prepare: Reads the file and prepares the internal buffer.  This function
-  // *must* be called before using the stream.
+  // Prepare: Opens the file and gets its size.  This function *must* be
+  // called before using the stream.
   absl::Status Prepare() override {
-    if (buffer_) {
-      ABSL_LOG(INFO) << "Buffer already prepared for file: " << file_path_;
+    if (is_ready_) {
+      ABSL_LOG(INFO) << "Stream already prepared for file: " << file_path_;
       return absl::OkStatus();
     }
 
-    // Clear the stringstream before use.
-    stream_.str(std::string());
-    stream_.clear();
-
-    std::ifstream file(file_path_, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
+    file_.open(file_path_, std::ios::binary | std::ios::ate);
+    if (!file_.is_open()) {
+      file_.clear();
       return absl::InternalError(
           absl::StrCat("Failed to open file: ", file_path_));
     }
 
-    buffer_size_ = static_cast<size_t>(file.tellg());  // Use size_t
-    file.seekg(0, std::ios::beg);
+    buffer_size_ = static_cast<size_t>(file_.tellg());  // Use size_t
+    file_.seekg(0, std::ios::beg);
     ABSL_DLOG(INFO) << "File size: " << buffer_size_ << " bytes.";
-
-    buffer_.reset(new unsigned char[buffer_size_]);
-    if (!file.read(reinterpret_cast<char*>(buffer_.get()), buffer_size_)) {
-      buffer_.reset();  // Clean up on error. Set to null
-      return absl::InternalError(
-          absl::StrCat("Failed to read all data from file: ", file_path_));
-    }
-    ABSL_DLOG(INFO) << "Successfully read " << buffer_size_
-                    << " bytes from file.";
-
-    file.close();
     is_ready_ = true;
-    stream_.write(reinterpret_cast<char*>(buffer_.get()), buffer_size_);
-    stream_.seekg(0);
-    ABSL_DLOG(INFO) << "Internal stringstream prepared.";
     return absl::OkStatus();
   }
 
@@ -134,22 +152,24 @@ class FileBackedSectionStream : public SectionStreamBase {
     if (!is_ready_) {
       ABSL_LOG(ERROR) << "Attempting to get stream before preparation.";
     }
-    return stream_;
+    return file_;
   }
 
   bool IsReady() const override { return is_ready_; }
 
   size_t BufferSize() const override { return buffer_size_; }
 
+  std::optional<std::string> BackingFilePath() const override {
+    return file_path_;
+  }
+
   absl::Status Finalize() override {
-    if (buffer_) {
-      buffer_.reset();  // Release the memory
+    if (is_ready_) {
+      file_.close();
+      file_.clear();  // Clear any error flags
       buffer_size_ = 0;
       is_ready_ = false;
-      stream_.str(std::string());  // Clear the stringstream
-      stream_.clear();             // Clear any error flags
-      ABSL_LOG(INFO) << "Buffer finalized and stream reset for file: "
-                     << file_path_;
+      ABSL_LOG(INFO) << "Stream finalized for file: " << file_path_;
     } else {
       ABSL_LOG(INFO) << "Nothing to finalize. Either Prepare() was not called "
                      << "or Finalize() has already been called.";
@@ -159,10 +179,9 @@ class FileBackedSectionStream : public SectionStreamBase {
 
  private:
   std::string file_path_;
-  std::unique_ptr<unsigned char[]> buffer_;
   size_t buffer_size_;
   bool is_ready_ = false;  // Track preparation state
-  std::stringstream stream_;
+  std::ifstream file_;
 };
 
 // Class template for a stream backed by a protocol buffer.
@@ -236,6 +255,11 @@ class ProtoBufSectionStream : public SectionStreamBase {
   size_t serialized_size_;
 };
 
+// A stream zlib compressing another one, prefixed by its uncompressed size.
+// The base stream is deflated chunk by chunk straight into the output by
+// WriteTo(), so neither the uncompressed nor the compressed data is held as a
+// whole. GetStream() compresses the section in memory for the callers reading
+// it as an std::istream.
 class ZlibBackendedSectionStream : public SectionStreamBase {
  public:
   explicit ZlibBackendedSectionStream(
@@ -249,8 +273,59 @@ class ZlibBackendedSectionStream : public SectionStreamBase {
     }
 
     RETURN_IF_ERROR(base_stream_->Prepare());  // NOLINT
+    is_ready_ = true;
+    return absl::OkStatus();
+  }
+
+  std::istream& GetStream() override {
+    if (!is_materialized_) {
+      zlib_stream_.str(std::string());
+      zlib_stream_.clear();
+      if (absl::Status status = Deflate(zlib_stream_); !status.ok()) {
+        ABSL_LOG(ERROR) << "Failed to compress the section: " << status;
+        zlib_stream_.setstate(std::ios::failbit);
+      }
+      is_materialized_ = true;
+    }
+    return zlib_stream_;
+  }
+
+  absl::Status WriteTo(std::ostream& output_stream) override {
+    if (is_materialized_) {
+      return CopyStream(zlib_stream_, output_stream);
+    }
+    return Deflate(output_stream);
+  }
+
+  bool IsReady() const override { return is_ready_; }
+
+  absl::Status Finalize() override {
+    zlib_stream_.str(std::string());
+    zlib_stream_.clear();
+    zlib_serialized_size_ = 0;
+    is_materialized_ = false;
+    is_ready_ = false;
+    RETURN_IF_ERROR(base_stream_->Finalize());  // NOLINT
+    ABSL_LOG(INFO) << "Zlib section stream finalized.";
+    return absl::OkStatus();
+  }
+
+  // The size is known once the section is written or read.
+  size_t BufferSize() const override {
+    if (!is_ready_) {
+      ABSL_LOG(ERROR) << "Attempting to get stream before preparation.";
+    }
+    return zlib_serialized_size_;
+  }
 
-    // Initialize zlib stream structure
+ private:
+  // Writes the uncompressed size and the deflated base stream to
+  // "output_stream".
+  absl::Status Deflate(std::ostream& output_stream) {
+    if (!is_ready_) {
+      return absl::FailedPreconditionError(
+          "The stream must be prepared before it is written.");
+    }
     z_stream strm;
     strm.zalloc = Z_NULL;
     strm.zfree = Z_NULL;
@@ -259,74 +334,148 @@ class ZlibBackendedSectionStream : public SectionStreamBase {
       return absl::InternalError("Failed to initialize zlib compression.");
     }
 
-    // Initialize both the compressed and uncompressed data vectors.
-    std::vector<char> uncompressed_data(
-        std::istreambuf_iterator<char>(base_stream_->GetStream()),
-        std::istreambuf_iterator<char>());
-    std::vector<char> compressed_data;
-    compressed_data.resize(deflateBound(&strm, uncompressed_data.size()));
-
-    strm.next_in = reinterpret_cast<Bytef*>(uncompressed_data.data());
-    strm.avail_in = uncompressed_data.size();
+    const uint64_t uncompressed_size = base_stream_->BufferSize();
+    output_stream.write(reinterpret_cast<const char*>(&uncompressed_size),
+                        sizeof(uncompressed_size));
+    zlib_serialized_size_ = sizeof(uncompressed_size);
 
     // Compress the data in chunks of 16KB.
     const size_t kZlibChunkSize = 16 * 1024;
-    int ret;
-    uint64_t compressed_size = 0;
+    std::vector<char> in(kZlibChunkSize);
+    std::vector<char> out(kZlibChunkSize);
+    std::istream& input = base_stream_->GetStream();
+    uint64_t read_size = 0;
+    int flush;
     do {
-      strm.next_out =
-          reinterpret_cast<Bytef*>(compressed_data.data() + compressed_size);
-      strm.avail_out = kZlibChunkSize;
-
-      ret = deflate(&strm, strm.avail_in == 0 ? Z_FINISH : Z_NO_FLUSH);
-      if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
-        deflateEnd(&strm);
-        return absl::InternalError("Compression failed with error code: " +
-                                   std::to_string(ret));
-      }
-
-      compressed_size += (kZlibChunkSize - strm.avail_out);
-    } while (ret != Z_STREAM_END);
+      input.read(in.data(), in.size());
+      strm.next_in = reinterpret_cast<Bytef*>(in.data());
+      strm.avail_in = input.gcount();
+      read_size += input.gcount();
+      flush = input ? Z_NO_FLUSH : Z_FINISH;
+      do {
+        strm.next_out = reinterpret_cast<Bytef*>(out.data());
+        strm.avail_out = out.size();
+        const int ret = deflate(&strm, flush);
+        if (ret == Z_STREAM_ERROR) {
+          deflateEnd(&strm);
+          return absl::InternalError("Compression failed with error code: " +
+                                     std::to_string(ret));
+        }
+        const size_t compressed_size = out.size() - strm.avail_out;
+        output_stream.write(out.data(), compressed_size);
+        zlib_serialized_size_ += compressed_size;
+      } while (strm.avail_out == 0);
+    } while (flush != Z_FINISH);
     deflateEnd(&strm);
 
-    // Write the uncompressed size
-    uint64_t uncompressed_size = uncompressed_data.size();
-    zlib_stream_.write(reinterpret_cast<const char*>(&uncompressed_size),
-                       sizeof(uncompressed_size));
-    zlib_serialized_size_ += sizeof(uncompressed_size);
+    if (input.bad() || read_size != uncompressed_size) {
+      return absl::DataLossError(
+          absl::StrCat("Read ", read_size, " bytes of the ", uncompressed_size,
+                       " bytes of the base stream."));
+    }
+    if (!output_stream.good()) {
+      return absl::InternalError("Failed to write the compressed section.");
+    }
+    return absl::OkStatus();
+  }
+
+  std::unique_ptr<SectionStreamBase> base_stream_;
+  std::stringstream zlib_stream_;
+  size_t zlib_serialized_size_ = 0;
+  bool is_materialized_ = false;
+  bool is_ready_ = false;
+};
 
-    // Write the compressed data
-    zlib_stream_.write(compressed_data.data(), compressed_size);
-    zlib_serialized_size_ += compressed_size;
+// A stream compressing another one in chunks, each zlib compressed on its own,
+// such that the loader decompresses them in parallel. The chunks are
+// compressed on "num_threads" threads, one batch of them at a time, straight
+// into the output by WriteTo(). See litertlm_compression.h for the layout, and
+// the section must carry the kSectionCompressionKey item.
+class ChunkedZlibSectionStream : public SectionStreamBase {
+ public:
+  explicit ChunkedZlibSectionStream(
+      std::unique_ptr<SectionStreamBase> base_stream,
+      uint64_t chunk_size = kDefaultCompressionChunkSize,
+      size_t num_threads = std::thread::hardware_concurrency())
+      : base_stream_(std::move(base_stream)),
+        chunk_size_(chunk_size),
+        num_threads_(num_threads) {}
 
+  absl::Status Prepare() override {
+    if (is_ready_) {
+      ABSL_LOG(INFO) << "Stream already prepared.";
+      return absl::OkStatus();
+    }
+
+    RETURN_IF_ERROR(base_stream_->Prepare());  // NOLINT
     is_ready_ = true;
     return absl::OkStatus();
   }
 
-  std::istream& GetStream() override { return zlib_stream_; }
+  std::istream& GetStream() override {
+    if (!is_materialized_) {
+      stream_.str(std::string());
+      stream_.clear();
+      if (absl::Status status = Compress(stream_); !status.ok()) {
+        ABSL_LOG(ERROR) << "Failed to compress the section: " << status;
+        stream_.setstate(std::ios::failbit);
+      }
+      is_materialized_ = true;
+    }
+    return stream_;
+  }
 
-  bool IsReady() const override { return !is_ready_; }
+  absl::Status WriteTo(std::ostream& output_stream) override {
+    if (is_materialized_) {
+      return CopyStream(stream_, output_stream);
+    }
+    return Compress(output_stream);
+  }
+
+  bool IsReady() const override { return is_ready_; }
 
   absl::Status Finalize() override {
-    zlib_stream_.str(std::string());
-    zlib_stream_.clear();
-    zlib_serialized_size_ = 0;
+    stream_.str(std::string());
+    stream_.clear();
+    serialized_size_ = 0;
+    is_materialized_ = false;
     is_ready_ = false;
-    ABSL_LOG(INFO) << "Zlib section stream finalized.";
+    RETURN_IF_ERROR(base_stream_->Finalize());  // NOLINT
+    ABSL_LOG(INFO) << "Chunked zlib section stream finalized.";
     return absl::OkStatus();
   }
 
+  // The size is known once the section is written or read.
   size_t BufferSize() const override {
     if (!is_ready_) {
       ABSL_LOG(ERROR) << "Attempting to get stream before preparation.";
     }
-    return zlib_serialized_size_;
+    return serialized_size_;
   }
 
  private:
+  absl::Status Compress(std::ostream& output_stream) {
+    if (!is_ready_) {
+      return absl::FailedPreconditionError(
+          "The stream must be prepared before it is written.");
+    }
+    const uint64_t uncompressed_size = base_stream_->BufferSize();
+    WorkStealingThreadPool pool("section_compression", num_threads_);
+    ASSIGN_OR_RETURN(serialized_size_,  // NOLINT
+                     CompressChunkedToStream(base_stream_->GetStream(),
+                                             uncompressed_size, chunk_size_,
+                                             output_stream, &pool));
+    ABSL_LOG(INFO) << "Compressed " << uncompressed_size << " bytes to "
+                   << serialized_size_ << " bytes.";
+    return absl::OkStatus();
+  }
+
   std::unique_ptr<SectionStreamBase> base_stream_;
-  std::stringstream zlib_stream_;
-  size_t zlib_serialized_size_ = 0;
+  const uint64_t chunk_size_;
+  const size_t num_threads_;
+  std::stringstream stream_;
+  size_t serialized_size_ = 0;
+  bool is_materialized_ = false;
   bool is_ready_ = false;
 };
 
@@ -1,10 +1,16 @@
 #include "schema/core/litertlm_section.h"
 
+#include <zlib.h>
+
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <filesystem>  // NOLINT: Required for path manipulation.
 #include <fstream>
 #include <ios>
+#include <iterator>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -12,6 +18,7 @@
 #include <gtest/gtest.h>
 #include "absl/status/status.h"  // from @com_google_absl
 #include "runtime/proto/llm_metadata.pb.h"
+#include "schema/core/litertlm_compression.h"
 
 namespace litert::lm::schema {
 namespace {
@@ -137,5 +144,95 @@ TEST(LiteRTLMSectionTest, TestProtoSectionStream) {
   }
 }
 
+// Writes a compressible file of "size" bytes and returns its path.
+std::string WriteDataFile(const std::string& name, size_t size) {
+  const std::string path =
+      (std::filesystem::path(::testing::TempDir()) / name).string();
+  std::ofstream file(path, std::ios::binary);
+  for (size_t i = 0; i < size; ++i) {
+    file.put(static_cast<char>((i * 7) % 13 + (i / 1000) % 5));
+  }
+  return path;
+}
+
+std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+TEST(LiteRTLMSectionTest, FileBackedSectionStreamWritesTheFile) {
+  const std::string path = WriteDataFile("file_backed.bin", 3000000);
+  FileBackedSectionStream stream(path);
+  ASSERT_TRUE(stream.Prepare().ok());
+  EXPECT_EQ(stream.BufferSize(), 3000000);
+  EXPECT_EQ(stream.BackingFilePath(), path);
+
+  std::stringstream output;
+  ASSERT_TRUE(stream.WriteTo(output).ok());
+  EXPECT_EQ(output.str(), ReadFile(path));
+  ASSERT_TRUE(stream.Finalize().ok());
+  EXPECT_FALSE(stream.IsReady());
+
+  FileBackedSectionStream missing("/does/not/exist");
+  EXPECT_FALSE(missing.Prepare().ok());
+}
+
+TEST(LiteRTLMSectionTest, ZlibSectionStreamDeflatesTheFile) {
+  const std::string path = WriteDataFile("zlib.bin", 100000);
+  ZlibBackendedSectionStream stream(
+      std::make_unique<FileBackedSectionStream>(path));
+  ASSERT_TRUE(stream.Prepare().ok());
+  EXPECT_TRUE(stream.IsReady());
+
+  std::stringstream output;
+  ASSERT_TRUE(stream.WriteTo(output).ok());
+  const std::string section = output.str();
+  EXPECT_EQ(stream.BufferSize(), section.size());
+  EXPECT_LT(section.size(), 100000);
+
+  uint64_t uncompressed_size;
+  std::memcpy(&uncompressed_size, section.data(), sizeof(uncompressed_size));
+  ASSERT_EQ(uncompressed_size, 100000);
+  std::string uncompressed(uncompressed_size, '\0');
+  uLongf size = uncompressed.size();
+  ASSERT_EQ(uncompress(reinterpret_cast<Bytef*>(uncompressed.data()), &size,
+                       reinterpret_cast<const Bytef*>(section.data()) +
+                           sizeof(uncompressed_size),
+                       section.size() - sizeof(uncompressed_size)),
+            Z_OK);
+  EXPECT_EQ(uncompressed, ReadFile(path));
+  ASSERT_TRUE(stream.Finalize().ok());
+
+  // Read as an std::istream, the section is the same.
+  ASSERT_TRUE(stream.Prepare().ok());
+  std::stringstream streamed;
+  streamed << stream.GetStream().rdbuf();
+  EXPECT_EQ(streamed.str(), section);
+}
+
+TEST(LiteRTLMSectionTest, ChunkedZlibSectionStreamCompressesTheFile) {
+  const std::string path = WriteDataFile("chunked_zlib.bin", 100000);
+  ChunkedZlibSectionStream stream(
+      std::make_unique<FileBackedSectionStream>(path), /*chunk_size=*/4096,
+      /*num_threads=*/3);
+  ASSERT_TRUE(stream.Prepare().ok());
+
+  std::stringstream output;
+  ASSERT_TRUE(stream.WriteTo(output).ok());
+  const std::string section = output.str();
+  EXPECT_EQ(stream.BufferSize(), section.size());
+
+  const std::string data = ReadFile(path);
+  std::string uncompressed(data.size(), '\0');
+  ASSERT_TRUE(
+      DecompressChunked(reinterpret_cast<const uint8_t*>(section.data()),
+                        section.size(),
+                        reinterpret_cast<uint8_t*>(uncompressed.data()),
+                        uncompressed.size())
+          .ok());
+  EXPECT_EQ(uncompressed, data);
+}
+
 }  // namespace
 }  // namespace litert::lm::schema
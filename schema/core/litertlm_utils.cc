@@ -1,7 +1,14 @@
 #include "schema/core/litertlm_utils.h"
 
+#include <cstddef>
+#include <optional>
 #include <string>
+#include <vector>
 
+#include "absl/strings/match.h"  // from @com_google_absl
+#include "absl/strings/str_cat.h"  // from @com_google_absl
+#include "absl/strings/string_view.h"  // from @com_google_absl
+#include "schema/core/litertlm_header.h"
 #include "schema/core/litertlm_header_schema_generated.h"
 
 namespace litert {
@@ -24,12 +31,79 @@ std::string AnySectionDataTypeToString(AnySectionDataType value) {
       return "AnySectionDataType_GenericBinaryData";
     case AnySectionDataType_HF_Tokenizer_Zlib:
       return "AnySectionDataType_HF_Tokenizer_Zlib";
+    case AnySectionDataType_LoRA_Adapter:
+      return "AnySectionDataType_LoRA_Adapter";
+    case AnySectionDataType_HF_Tokenizer_Json:
+      return "AnySectionDataType_HF_Tokenizer_Json";
     default:
       // Handle cases for MIN/MAX or potentially invalid values.
       return "Unknown AnySectionDataType value";
   }
 }
 
+std::vector<SectionIndexEntry> BuildSectionIndex(
+    const LiteRTLMMetaData& metadata) {
+  std::vector<SectionIndexEntry> index;
+  if (metadata.section_metadata() == nullptr ||
+      metadata.section_metadata()->objects() == nullptr) {
+    return index;
+  }
+  const auto* sections = metadata.section_metadata()->objects();
+  index.reserve(sections->size());
+  for (size_t i = 0; i < sections->size(); ++i) {
+    const SectionObject* section = sections->Get(i);
+    SectionIndexEntry& entry = index.emplace_back();
+    entry.section_index = i;
+    entry.data_type = section->data_type();
+    entry.begin_offset = section->begin_offset();
+    entry.end_offset = section->end_offset();
+    if (section->items() == nullptr) {
+      continue;
+    }
+    for (const KeyValuePair* item : *section->items()) {
+      if (item->key() == nullptr) {
+        continue;
+      }
+      const absl::string_view key(item->key()->c_str(), item->key()->size());
+      if (key == kSectionAlignmentKey && item->value_as_UInt64()) {
+        entry.alignment = item->value_as_UInt64()->value();
+      } else if (key == kSectionCompressionKey &&
+                 item->value_as_StringValue() &&
+                 item->value_as_StringValue()->value()) {
+        entry.compression = item->value_as_StringValue()->value()->str();
+      } else if (key == kSectionContentHashKey &&
+                 item->value_as_StringValue() &&
+                 item->value_as_StringValue()->value()) {
+        entry.content_hash = item->value_as_StringValue()->value()->str();
+      } else if (section->data_type() == AnySectionDataType_TFLiteModel &&
+                 entry.model_type.empty() &&
+                 absl::EqualsIgnoreCase(key, "model_type") &&
+                 item->value_as_StringValue() &&
+                 item->value_as_StringValue()->value()) {
+        entry.model_type = item->value_as_StringValue()->value()->str();
+      }
+    }
+  }
+  return index;
+}
+
+std::optional<std::string> GetContentKey(
+    const std::vector<SectionIndexEntry>& index) {
+  if (index.empty()) {
+    return std::nullopt;
+  }
+  std::string key;
+  for (const SectionIndexEntry& entry : index) {
+    if (entry.content_hash.empty()) {
+      return std::nullopt;
+    }
+    // The type is part of the key, as the same bytes may play another role.
+    absl::StrAppend(&key, key.empty() ? "" : ",", static_cast<int>(entry.data_type), ":",
+                    entry.content_hash);
+  }
+  return key;
+}
+
 }  // namespace schema
 }  // namespace lm
 }  // namespace litert
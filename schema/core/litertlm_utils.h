@@ -1,9 +1,11 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_PRINT_H_
 #define THIRD_PARTY_ODML_LITERT_LM_SCHEMA_CORE_LITERTLM_PRINT_H_
 
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -19,6 +21,37 @@ namespace schema {
 // values.
 std::string AnySectionDataTypeToString(AnySectionDataType value);
 
+// The location and the items of a section the runtime looks up, read once
+// from the header such that the sections are then found without going
+// through their items again.
+struct SectionIndexEntry {
+  // The index of the section in the header.
+  int section_index = 0;
+  AnySectionDataType data_type = AnySectionDataType_NONE;
+  // The "model_type" item of a TFLite model, if any, as written.
+  std::string model_type;
+  // The kSectionAlignmentKey item, or 0.
+  uint64_t alignment = 0;
+  // The kSectionCompressionKey item, or empty if the section is stored as is.
+  std::string compression;
+  // The kSectionContentHashKey item, or empty if it is not recorded.
+  std::string content_hash;
+  uint64_t begin_offset = 0;
+  uint64_t end_offset = 0;
+};
+
+// Builds the index of the sections of the header, in their order, from a
+// single pass over their items.
+std::vector<SectionIndexEntry> BuildSectionIndex(
+    const LiteRTLMMetaData& metadata);
+
+// Returns a key identifying the content of the file of the sections in
+// "index", from their content hashes, such that the caches built from the
+// model are keyed without reading it, or std::nullopt if a section has no
+// content hash.
+std::optional<std::string> GetContentKey(
+    const std::vector<SectionIndexEntry>& index);
+
 // Useful class that works around the lack of std::spanstream in C++23.
 // It *should* be possible to make an inputstream from a known buffer
 // (i.e. some pointer plus some length). MemoryStreamBuf provides the
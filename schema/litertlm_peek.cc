@@ -4,6 +4,7 @@
 //
 // Example usage:
 // bazel run :litertlm_peek -- --litertlm_file=/path/to/your/file.litertlm
+//   --index_only (optional, to only print the section index from the header)
 
 #include <iostream>
 #include <string>
@@ -18,6 +19,10 @@
 ABSL_FLAG(std::string, litertlm_file, "",
           "The path to the LiteRT-LM file to inspect.");
 
+ABSL_FLAG(bool, index_only, false,
+          "Whether to only print the header and the section index, without "
+          "reading the sections.");
+
 namespace {
 
 using litert::lm::schema::ProcessLiteRTLMFile;
@@ -33,7 +38,8 @@ absl::Status MainHelper(int argc, char** argv) {
   }
 
   // Use std::cout as the output stream.
-  return ProcessLiteRTLMFile(litertlm_file, std::cout);
+  return ProcessLiteRTLMFile(litertlm_file, std::cout,
+                             absl::GetFlag(FLAGS_index_only));
 }
 
 }  // namespace
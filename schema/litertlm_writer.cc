@@ -10,8 +10,19 @@
 //   /path/to/model.tflite \
 //   /path/to/llm_metadata.pbtext \ (or binary proto via .pb or .proto)
 //   /path/to/model2.tflite \
+//   /path/to/adapter.lora \ (a serialized LoraAdapter, repeated per adapter)
+//   /path/to/tokenizer.json \ (zlib compressed unless
+//     --compress_hf_tokenizer=false)
 //   --section_metadata="tokenizer:key1=value1,key2=value2;\
 //     tflite:key3=123,key4=true;llm_metadata:key5=abc;tflite:z=9.8"
+//   --section_alignment=65536 (optional, for the sections to be mapped in
+//     place where the mapping granularity is larger than 16KB)
+//   --compressed_inputs=/path/to/embedder.tflite (optional, the inputs stored
+//     compressed in chunks, decompressed in parallel when loaded)
+//   --record_content_hashes (optional, records the content hash of each
+//     section, identifying the model from its header)
+//   --order_for_progressive_loading (optional, writes the sections in the
+//     order they are needed, for the file to be served while downloaded)
 
 #include <cstdint>
 #include <fstream>
@@ -39,6 +50,36 @@ ABSL_FLAG(std::string, section_metadata, "",
           "Supported value types: int32, int64, uint32, uint64, bool, float, "
           "string.");
 
+ABSL_FLAG(bool, compress_hf_tokenizer, true,
+          "Whether to zlib compress the HuggingFace tokenizer.json. An "
+          "uncompressed tokenizer is larger but loads faster, as it is read "
+          "from the mapped file instead of being inflated.");
+
+ABSL_FLAG(uint64_t, section_alignment, 0,
+          "If not 0, the alignment of the sections in the file, recorded in "
+          "their metadata, e.g. 65536 for the sections to be mapped in place "
+          "on Windows. Must be a multiple of 16384. If 0, the sections are "
+          "padded to 16KB.");
+
+ABSL_FLAG(std::vector<std::string>, compressed_inputs, {},
+          "Comma separated input files to store zlib compressed in "
+          "independent chunks, which are decompressed in parallel when the "
+          "file is loaded, e.g. the embedder models. A compressed section is "
+          "read into memory instead of being mapped.");
+
+ABSL_FLAG(bool, record_content_hashes, false,
+          "Whether to record the content hash of each section in its "
+          "metadata, such that the caches built from the model are keyed, "
+          "and the sections changed between two files are found, without "
+          "reading the sections.");
+
+ABSL_FLAG(bool, order_for_progressive_loading, false,
+          "Whether to write the sections in the order they are needed to "
+          "serve the model: the metadata and the tokenizers, then the models, "
+          "then the optional sections, e.g. a draft model or the LoRA "
+          "adapters. A file still being downloaded is then served once its "
+          "first sections are in.");
+
 const char* const ANSI_RESET = "\033[0m";
 const char* const ANSI_BOLD_GREEN = "\033[1;32m";
 const char* const CAKE_EMOJI_UTF8 = "\xF0\x9F\x8E\x82";  // 🎂 UTF-8 literal
@@ -93,8 +134,13 @@ absl::Status MainHelper(int argc, char** argv) {
     ABSL_LOG(INFO) << ca;
   }
 
-  return ::litert::lm::schema::LitertLmWrite(command_args, section_metadata_str,
-                                             output_path);
+  return ::litert::lm::schema::LitertLmWrite(
+      command_args, section_metadata_str, output_path,
+      absl::GetFlag(FLAGS_compress_hf_tokenizer),
+      absl::GetFlag(FLAGS_section_alignment),
+      absl::GetFlag(FLAGS_compressed_inputs),
+      absl::GetFlag(FLAGS_record_content_hashes),
+      absl::GetFlag(FLAGS_order_for_progressive_loading));
 }
 
 }  // namespace
@@ -2,6 +2,7 @@
 #include <filesystem>  // NOLINT: Required for path manipulation.
 #include <fstream>
 #include <ios>
+#include <optional>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -10,7 +11,12 @@
 #include <gtest/gtest.h>
 #include "absl/status/status.h"  // from @com_google_absl
 #include "runtime/proto/llm_metadata.pb.h"  // For LlmMetadata
+#include "schema/core/litertlm_compression.h"
+#include "schema/core/litertlm_header.h"
+#include "schema/core/litertlm_header_schema_generated.h"
 #include "schema/core/litertlm_print.h"
+#include "schema/core/litertlm_read.h"
+#include "schema/core/litertlm_utils.h"
 #include "schema/litertlm_writer_utils.h"
 #include "google/protobuf/text_format.h"  // from @com_google_protobuf  // For TextFormat::PrintToString
 
@@ -172,6 +178,193 @@ TEST_F(LiteRTLMWriteTest, NoMetadataTest) {
               testing::Not(testing::HasSubstr("tok_version")));
 }
 
+// Test case: The HuggingFace tokenizer stored uncompressed.
+TEST_F(LiteRTLMWriteTest, UncompressedHfTokenizerTest) {
+  const std::string hf_tokenizer_json_path = temp_dir_path_ + "/tokenizer.json";
+  const std::string output_litertlm_path =
+      temp_dir_path_ + "/output_hf_json.litertlm";
+
+  CreateDummyFile(hf_tokenizer_json_path, "Dummy HF Tokenizer JSON Content");
+
+  const absl::Status result =
+      LitertLmWrite({hf_tokenizer_json_path}, "hf_tokenizer_json:;",
+                    output_litertlm_path, /*compress_hf_tokenizer=*/false);
+  ASSERT_TRUE(result.ok()) << "LitertLmWrite failed: " << result.message();
+  VerifyFile(output_litertlm_path);
+
+  std::stringstream inspection_output_ss;
+  const absl::Status print_result =
+      ProcessLiteRTLMFile(output_litertlm_path, inspection_output_ss);
+  ASSERT_TRUE(print_result.ok())
+      << "ProcessLiteRTLMFile failed: " << print_result.message();
+  EXPECT_THAT(inspection_output_ss.str(),
+              testing::HasSubstr("AnySectionDataType_HF_Tokenizer_Json"));
+  EXPECT_THAT(inspection_output_ss.str(),
+              testing::Not(testing::HasSubstr("HF_Tokenizer_Zlib")));
+}
+
+TEST_F(LiteRTLMWriteTest, AlignedLayoutTest) {
+  const std::string tokenizer_path = temp_dir_path_ + "/tokenizer.spiece";
+  const std::string tflite_model_path = temp_dir_path_ + "/model.tflite";
+  const std::string output_litertlm_path =
+      temp_dir_path_ + "/output_aligned.litertlm";
+  CreateDummyFile(tokenizer_path, "Dummy SentencePiece Model Content");
+  CreateDummyFile(tflite_model_path,
+                  "Dummy TFLite Model Content. Not a real model.");
+
+  const uint64_t kAlignment = 64 * 1024;
+  const absl::Status result = LitertLmWrite(
+      {tokenizer_path, tflite_model_path}, "", output_litertlm_path,
+      /*compress_hf_tokenizer=*/true, /*section_alignment=*/kAlignment);
+  ASSERT_TRUE(result.ok()) << "LitertLmWrite failed: " << result.message();
+
+  LitertlmHeader header;
+  ASSERT_TRUE(ReadHeaderFromLiteRTLM(output_litertlm_path, &header).ok());
+  auto sections = header.metadata->section_metadata()->objects();
+  ASSERT_EQ(sections->size(), 2);
+  for (const SectionObject* section : *sections) {
+    EXPECT_EQ(section->begin_offset() % kAlignment, 0);
+    ASSERT_EQ(section->items()->size(), 1);
+    const KeyValuePair* item = section->items()->Get(0);
+    EXPECT_EQ(item->key()->str(), kSectionAlignmentKey);
+    ASSERT_NE(item->value_as_UInt64(), nullptr);
+    EXPECT_EQ(item->value_as_UInt64()->value(), kAlignment);
+  }
+}
+
+TEST_F(LiteRTLMWriteTest, UnalignableLayoutTest) {
+  const std::string tokenizer_path = temp_dir_path_ + "/tokenizer.spiece";
+  CreateDummyFile(tokenizer_path, "Dummy SentencePiece Model Content");
+
+  const absl::Status result = LitertLmWrite(
+      {tokenizer_path}, "", temp_dir_path_ + "/output_unaligned.litertlm",
+      /*compress_hf_tokenizer=*/true, /*section_alignment=*/4096);
+  EXPECT_EQ(result.code(), absl::StatusCode::kInvalidArgument);
+}
+
+TEST_F(LiteRTLMWriteTest, CompressedInputTest) {
+  const std::string binary_path = temp_dir_path_ + "/embedding.bin";
+  const std::string output_litertlm_path =
+      temp_dir_path_ + "/output_compressed.litertlm";
+  const std::string contents(100000, 'e');
+  CreateDummyFile(binary_path, contents);
+
+  const absl::Status result = LitertLmWrite(
+      {binary_path}, "", output_litertlm_path,
+      /*compress_hf_tokenizer=*/true, /*section_alignment=*/0,
+      /*compressed_inputs=*/{binary_path});
+  ASSERT_TRUE(result.ok()) << "LitertLmWrite failed: " << result.message();
+
+  LitertlmHeader header;
+  ASSERT_TRUE(ReadHeaderFromLiteRTLM(output_litertlm_path, &header).ok());
+  auto sections = header.metadata->section_metadata()->objects();
+  ASSERT_EQ(sections->size(), 1);
+  ASSERT_EQ(sections->Get(0)->items()->size(), 1);
+  const KeyValuePair* item = sections->Get(0)->items()->Get(0);
+  EXPECT_EQ(item->key()->str(), kSectionCompressionKey);
+  ASSERT_NE(item->value_as_StringValue(), nullptr);
+  EXPECT_EQ(item->value_as_StringValue()->value()->str(),
+            kChunkedZlibCompression);
+
+  std::vector<uint8_t> compressed;
+  ASSERT_TRUE(ReadAnyBinaryData(output_litertlm_path, &compressed).ok());
+  EXPECT_LT(compressed.size(), contents.size());
+  std::vector<uint8_t> decompressed(contents.size());
+  ASSERT_TRUE(DecompressChunked(compressed.data(), compressed.size(),
+                                decompressed.data(), decompressed.size())
+                  .ok());
+  EXPECT_EQ(std::string(decompressed.begin(), decompressed.end()), contents);
+}
+
+TEST_F(LiteRTLMWriteTest, ContentHashesTest) {
+  const std::string tokenizer_path = temp_dir_path_ + "/tokenizer.spiece";
+  const std::string tflite_model_path = temp_dir_path_ + "/model.tflite";
+  CreateDummyFile(tokenizer_path, "Dummy SentencePiece Model Content");
+  CreateDummyFile(tflite_model_path,
+                  "Dummy TFLite Model Content. Not a real model.");
+
+  // Returns the content key of the file written from the inputs.
+  auto write = [&](const std::string& output_path,
+                   bool record_content_hashes) -> std::optional<std::string> {
+    EXPECT_TRUE(LitertLmWrite({tokenizer_path, tflite_model_path}, "",
+                              output_path, /*compress_hf_tokenizer=*/true,
+                              /*section_alignment=*/0,
+                              /*compressed_inputs=*/{}, record_content_hashes)
+                    .ok());
+    LitertlmHeader header;
+    EXPECT_TRUE(ReadHeaderFromLiteRTLM(output_path, &header).ok());
+    const auto index = BuildSectionIndex(*header.metadata);
+    for (const SectionIndexEntry& entry : index) {
+      EXPECT_EQ(entry.content_hash.empty(), !record_content_hashes);
+    }
+    return GetContentKey(index);
+  };
+
+  const auto key = write(temp_dir_path_ + "/output_hashed.litertlm", true);
+  ASSERT_TRUE(key.has_value());
+  // The key depends on the contents, not on the path of the file.
+  EXPECT_EQ(write(temp_dir_path_ + "/output_hashed_copy.litertlm", true), key);
+  EXPECT_EQ(write(temp_dir_path_ + "/output_unhashed.litertlm", false),
+            std::nullopt);
+
+  CreateDummyFile(tflite_model_path,
+                  "Another Dummy TFLite Model Content. Not a real model.");
+  const auto changed_key =
+      write(temp_dir_path_ + "/output_changed.litertlm", true);
+  ASSERT_TRUE(changed_key.has_value());
+  EXPECT_NE(changed_key, key);
+}
+
+TEST_F(LiteRTLMWriteTest, OrderForProgressiveLoadingTest) {
+  const std::string draft_model_path = temp_dir_path_ + "/draft.tflite";
+  const std::string tflite_model_path = temp_dir_path_ + "/model.tflite";
+  const std::string tokenizer_path = temp_dir_path_ + "/tokenizer.spiece";
+  const std::string output_litertlm_path =
+      temp_dir_path_ + "/output_progressive.litertlm";
+  CreateDummyFile(draft_model_path, "Dummy Draft Model Content");
+  CreateDummyFile(tflite_model_path,
+                  "Dummy TFLite Model Content. Not a real model.");
+  CreateDummyFile(tokenizer_path, "Dummy SentencePiece Model Content");
+
+  const absl::Status result = LitertLmWrite(
+      {draft_model_path, tflite_model_path, tokenizer_path},
+      "tflite:model_type=tf_lite_draft;"
+      "tflite:model_type=tf_lite_prefill_decode;"
+      "tokenizer:",
+      output_litertlm_path, /*compress_hf_tokenizer=*/true,
+      /*section_alignment=*/0, /*compressed_inputs=*/{},
+      /*record_content_hashes=*/false, /*order_for_progressive_loading=*/true);
+  ASSERT_TRUE(result.ok()) << "LitertLmWrite failed: " << result.message();
+
+  LitertlmHeader header;
+  ASSERT_TRUE(ReadHeaderFromLiteRTLM(output_litertlm_path, &header).ok());
+  auto sections = header.metadata->section_metadata()->objects();
+  ASSERT_EQ(sections->size(), 3);
+  EXPECT_EQ(sections->Get(0)->data_type(), AnySectionDataType_SP_Tokenizer);
+  EXPECT_EQ(sections->Get(1)->data_type(), AnySectionDataType_TFLiteModel);
+  EXPECT_EQ(sections->Get(1)->items()->Get(0)->value_as_StringValue()->value()
+                ->str(),
+            "tf_lite_prefill_decode");
+  EXPECT_EQ(sections->Get(2)->data_type(), AnySectionDataType_TFLiteModel);
+  EXPECT_EQ(sections->Get(2)->items()->Get(0)->value_as_StringValue()->value()
+                ->str(),
+            "tf_lite_draft");
+  // The sections are written in the order of the header.
+  EXPECT_LE(sections->Get(0)->end_offset(), sections->Get(1)->begin_offset());
+  EXPECT_LE(sections->Get(1)->end_offset(), sections->Get(2)->begin_offset());
+}
+
+TEST_F(LiteRTLMWriteTest, UnknownCompressedInputTest) {
+  const std::string tokenizer_path = temp_dir_path_ + "/tokenizer.spiece";
+  CreateDummyFile(tokenizer_path, "Dummy SentencePiece Model Content");
+
+  const absl::Status result = LitertLmWrite(
+      {tokenizer_path}, "", temp_dir_path_ + "/output_unknown.litertlm",
+      /*compress_hf_tokenizer=*/true, /*section_alignment=*/0,
+      /*compressed_inputs=*/{temp_dir_path_ + "/model.tflite"});
+  EXPECT_EQ(result.code(), absl::StatusCode::kInvalidArgument);
+}
+
 // Test case: Mismatched order between input files and section_metadata.
 TEST_F(LiteRTLMWriteTest, MismatchedMetadataOrderTest) {
   const std::string tokenizer_path = temp_dir_path_ + "/tokenizer.spiece";
@@ -12,14 +12,17 @@
 #include <utility>
 #include <vector>
 
+#include "absl/algorithm/container.h"  // from @com_google_absl
 #include "absl/log/absl_log.h"  // from @com_google_absl
 #include "absl/status/status.h"  // from @com_google_absl
+#include "absl/strings/match.h"  // from @com_google_absl
 #include "absl/strings/numbers.h"  // from @com_google_absl
 #include "absl/strings/str_cat.h"  // from @com_google_absl
 #include "absl/strings/str_split.h"  // from @com_google_absl
 #include "absl/strings/string_view.h"  // from @com_google_absl
 #include "flatbuffers/flatbuffer_builder.h"  // from @flatbuffers
 #include "runtime/proto/llm_metadata.pb.h"
+#include "schema/core/litertlm_compression.h"
 #include "schema/core/litertlm_export.h"
 #include "schema/core/litertlm_header.h"
 #include "schema/core/litertlm_header_schema_generated.h"
@@ -34,6 +37,8 @@ constexpr char kTfliteSectionName[] = "tflite";
 constexpr char kLlmMetadataSectionName[] = "llm_metadata";
 constexpr char kBinaryDataSectionName[] = "binary_data";
 constexpr char kHfTokenizerZlibSectionName[] = "hf_tokenizer_zlib";
+constexpr char kHfTokenizerJsonSectionName[] = "hf_tokenizer_json";
+constexpr char kLoraAdapterSectionName[] = "lora_adapter";
 
 using ::litert::lm::proto::LlmMetadata;
 
@@ -80,6 +85,25 @@ KVPair ConvertKeyValue(flatbuffers::FlatBufferBuilder& builder,
   }
 }
 
+// Returns the rank of a section in the order of progressive loading, where
+// the sections to serve the model with come first: the metadata and the
+// tokenizers, then the models to run it, then the optional sections, e.g. the
+// draft model for speculative decoding and the LoRA adapters.
+int GetProgressiveLoadingRank(AnySectionDataType section_type,
+                              absl::string_view model_type) {
+  switch (section_type) {
+    case AnySectionDataType_LlmMetadataProto:
+    case AnySectionDataType_SP_Tokenizer:
+    case AnySectionDataType_HF_Tokenizer_Zlib:
+    case AnySectionDataType_HF_Tokenizer_Json:
+      return 0;
+    case AnySectionDataType_TFLiteModel:
+      return absl::EqualsIgnoreCase(model_type, "tf_lite_draft") ? 2 : 1;
+    default:
+      return 2;
+  }
+}
+
 // Helper function to get file extension
 std::string GetFileExtension(const std::string& filename) {
   size_t dot_pos = filename.rfind('.');
@@ -91,16 +115,29 @@ std::string GetFileExtension(const std::string& filename) {
 
 absl::Status LitertLmWrite(const std::vector<std::string>& command_args,
                            const std::string& section_metadata_str,
-                           const std::string& output_path) {
+                           const std::string& output_path,
+                           bool compress_hf_tokenizer,
+                           uint64_t section_alignment,
+                           const std::vector<std::string>& compressed_inputs,
+                           bool record_content_hashes,
+                           bool order_for_progressive_loading) {
   std::vector<std::unique_ptr<SectionStreamBase>> sections;
   std::vector<AnySectionDataType> section_types;
   // To store the order of section names derived from input filenames.
   std::vector<std::string> section_name_order;
+  // The indices of the sections stored chunk compressed.
+  std::vector<size_t> compressed_section_indices;
 
   if (command_args.empty()) {
     return absl::InvalidArgumentError(
         "At least one input file must be provided.");
   }
+  for (const auto& filename : compressed_inputs) {
+    if (!absl::c_linear_search(command_args, filename)) {
+      return absl::InvalidArgumentError(absl::StrCat(
+          "Compressed input ", filename, " is not one of the input files."));
+    }
+  }
 
   for (const auto& filename : command_args) {
     std::string extension = GetFileExtension(filename);
@@ -160,10 +197,23 @@ absl::Status LitertLmWrite(const std::vector<std::string>& command_args,
                          ". Only tokenizer.json is supported."));
       }
       auto tokenizer_json = std::make_unique<FileBackedSectionStream>(filename);
-      sections.push_back(std::make_unique<ZlibBackendedSectionStream>(
-          std::move(tokenizer_json)));
-      section_types.push_back(AnySectionDataType_HF_Tokenizer_Zlib);
-      section_name_order.push_back(kHfTokenizerZlibSectionName);
+      if (compress_hf_tokenizer) {
+        sections.push_back(std::make_unique<ZlibBackendedSectionStream>(
+            std::move(tokenizer_json)));
+        section_types.push_back(AnySectionDataType_HF_Tokenizer_Zlib);
+        section_name_order.push_back(kHfTokenizerZlibSectionName);
+      } else {
+        // Stored as is, such that the runtime reads it from the mapped file
+        // instead of inflating it on every load.
+        sections.push_back(std::move(tokenizer_json));
+        section_types.push_back(AnySectionDataType_HF_Tokenizer_Json);
+        section_name_order.push_back(kHfTokenizerJsonSectionName);
+      }
+    } else if (extension == ".lora") {
+      // A serialized LoraAdapter flatbuffer.
+      sections.push_back(std::make_unique<FileBackedSectionStream>(filename));
+      section_types.push_back(AnySectionDataType_LoRA_Adapter);
+      section_name_order.push_back(kLoraAdapterSectionName);
     } else {
       // TODO(b/421217080) Writer should export what happened.
       ABSL_LOG(WARNING) << "Unknown extension for: " << filename
@@ -172,6 +222,17 @@ absl::Status LitertLmWrite(const std::vector<std::string>& command_args,
       section_types.push_back(AnySectionDataType_GenericBinaryData);
       section_name_order.push_back(kBinaryDataSectionName);
     }
+
+    if (absl::c_linear_search(compressed_inputs, filename)) {
+      if (section_types.back() == AnySectionDataType_HF_Tokenizer_Zlib) {
+        return absl::InvalidArgumentError(absl::StrCat(
+            "Input ", filename, " is already zlib compressed. Set "
+            "compress_hf_tokenizer to false to compress it in chunks."));
+      }
+      sections.back() = std::make_unique<ChunkedZlibSectionStream>(
+          std::move(sections.back()));
+      compressed_section_indices.push_back(sections.size() - 1);
+    }
   }
 
   if (sections.empty()) {
@@ -224,6 +285,8 @@ absl::Status LitertLmWrite(const std::vector<std::string>& command_args,
     }
   }
 
+  // The "model_type" items of the sections, for their order.
+  std::vector<std::string> section_model_types(sections.size());
   if (!section_metadata_str.empty()) {
     int current_metadata_section_index = 0;
     std::vector<std::string> section_parts =
@@ -250,20 +313,54 @@ absl::Status LitertLmWrite(const std::vector<std::string>& command_args,
           }
           section_items_list[current_metadata_section_index].push_back(
               ConvertKeyValue(builder, key, value_str));
+          if (absl::EqualsIgnoreCase(key, "model_type")) {
+            section_model_types[current_metadata_section_index] = value_str;
+          }
         }
       }
       ++current_metadata_section_index;
     }
   }
 
+  for (size_t index : compressed_section_indices) {
+    section_items_list[index].push_back(CreateKeyValuePair(
+        builder, std::string(kSectionCompressionKey),
+        std::string(kChunkedZlibCompression)));
+  }
+
   // Basic system metadata for now.
   std::vector<KVPair> system_meta = {CreateKeyValuePair(
       builder, std::string("author"),
       CreateStringValue(
           builder, builder.CreateString(std::string("The ODML Authors"))))};
 
+  if (order_for_progressive_loading) {
+    std::vector<size_t> order(sections.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+    absl::c_stable_sort(order, [&](size_t a, size_t b) {
+      return GetProgressiveLoadingRank(section_types[a],
+                                       section_model_types[a]) <
+             GetProgressiveLoadingRank(section_types[b],
+                                       section_model_types[b]);
+    });
+    std::vector<std::unique_ptr<SectionStreamBase>> ordered_sections;
+    std::vector<AnySectionDataType> ordered_section_types;
+    std::vector<std::vector<KVPair>> ordered_section_items_list;
+    for (size_t i : order) {
+      ordered_sections.push_back(std::move(sections[i]));
+      ordered_section_types.push_back(section_types[i]);
+      ordered_section_items_list.push_back(std::move(section_items_list[i]));
+    }
+    sections = std::move(ordered_sections);
+    section_types = std::move(ordered_section_types);
+    section_items_list = std::move(ordered_section_items_list);
+  }
+
   return MakeLiteRTLMFromSections(builder, sections, section_types, system_meta,
-                                  section_items_list, output_path);
+                                  section_items_list, output_path,
+                                  section_alignment, record_content_hashes);
 }
 
 }  // namespace litert::lm::schema
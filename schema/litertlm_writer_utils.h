@@ -1,5 +1,6 @@
 #ifndef THIRD_PARTY_ODML_LITERT_LM_SCHEMA_LITERTLM_WRITER_UTILS_H_
 #define THIRD_PARTY_ODML_LITERT_LM_SCHEMA_LITERTLM_WRITER_UTILS_H_
+#include <cstdint>
 #include <ios>
 #include <iostream>
 #include <string>
@@ -11,9 +12,31 @@
 
 namespace litert::lm::schema {
 
-absl::Status LitertLmWrite(const std::vector<std::string>& command_args,
-                           const std::string& section_metadata_str,
-                           const std::string& output_path);
+// Writes the LiteRT-LM file of the input files in `command_args`, each
+// stored as the section type of its extension.
+// - compress_hf_tokenizer: Whether a tokenizer.json is stored zlib compressed,
+//   or uncompressed for a faster load.
+// - section_alignment: If not 0, the alignment of the sections in the file,
+//   recorded in their metadata, e.g. 65536 for the sections to be mapped in
+//   place on Windows, or 2MB for huge pages. Must be a multiple of 16KB.
+// - compressed_inputs: The input files stored compressed in independent
+//   chunks, which the loader decompresses in parallel, e.g. the embedder
+//   models. Each must be one of `command_args`.
+// - record_content_hashes: Whether the content hash of each section is
+//   recorded in its metadata, for the caches to be keyed, and the changed
+//   sections of two files to be found, from the header only.
+// - order_for_progressive_loading: Whether the sections are written in the
+//   order they are needed to serve the model, instead of the order of
+//   `command_args`: the metadata and the tokenizers, then the models, then the
+//   optional sections, e.g. a draft model or the LoRA adapters. The loader of
+//   a file still being downloaded then waits for the fewest bytes.
+absl::Status LitertLmWrite(
+    const std::vector<std::string>& command_args,
+    const std::string& section_metadata_str, const std::string& output_path,
+    bool compress_hf_tokenizer = true, uint64_t section_alignment = 0,
+    const std::vector<std::string>& compressed_inputs = {},
+    bool record_content_hashes = false,
+    bool order_for_progressive_loading = false);
 
 }  // namespace litert::lm::schema
 #endif  // THIRD_PARTY_ODML_LITERT_LM_SCHEMA_LITERTLM_WRITER_UTILS_HU